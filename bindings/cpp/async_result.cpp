@@ -20,6 +20,8 @@
 #include "../../include/elliptics/result_entry.hpp"
 #include "../../include/elliptics/session.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -30,7 +32,7 @@ template <typename T>
 class async_result<T>::data
 {
 	public:
-		data() : total(0), finished(false)
+		data() : total(0), quorum_completion(false), waiters(0), finished(false)
 		{
 			dnet_current_time(&start);
 			dnet_empty_time(&end);
@@ -53,7 +55,20 @@ class async_result<T>::data
 		std::vector<dnet_cmd> statuses;
 		size_t total;
 
-		bool finished;
+		/*
+		 * Result completed by quorum keeps @results and @statuses intact,
+		 * replies received after that are collected to @background_statuses
+		 */
+		bool quorum_completion;
+		result_error_handler background_error_handler;
+		std::vector<dnet_cmd> background_statuses;
+
+		/*
+		 * Most results are waited for by callbacks, so completion doesn't notify @condition
+		 * unless somebody waits, and wait() doesn't lock already finished result
+		 */
+		size_t waiters;
+		std::atomic<bool> finished;
 		dnet_time start;
 		dnet_time end;
 };
@@ -145,7 +160,7 @@ error_info async_result<T>::error() const
 template <typename T>
 bool async_result<T>::ready() const
 {
-	return m_data->finished;
+	return m_data->finished.load(std::memory_order_acquire);
 }
 
 template <typename T>
@@ -241,9 +256,11 @@ bool async_result<get_index_metadata_result_entry>::get(get_index_metadata_resul
 		entry.index_size = 0;
 		entry.is_valid = true;
 		entry.shard_id = -1;
+		entry.split_depth = 0;
 		for (auto it = m_data->results.begin(); it != m_data->results.end(); ++it) {
 			if (it->is_valid) {
 				entry.index_size += it->index_size;
+				entry.split_depth = std::max(entry.split_depth, it->split_depth);
 			} else {
 				entry.is_valid = false;
 				return false;
@@ -428,9 +445,14 @@ struct async_result<T>::data_keeper
 template <typename T>
 void async_result<T>::wait(uint32_t policy)
 {
-	std::unique_lock<std::mutex> locker(m_data->lock);
-	while (!m_data->finished)
-		m_data->condition.wait(locker);
+	/* error and results are not changed after result is finished */
+	if (!m_data->finished.load(std::memory_order_acquire)) {
+		std::unique_lock<std::mutex> locker(m_data->lock);
+		++m_data->waiters;
+		while (!m_data->finished)
+			m_data->condition.wait(locker);
+		--m_data->waiters;
+	}
 	if (m_data->policy & policy)
 		m_data->error.throw_error();
 }
@@ -482,7 +504,16 @@ async_result_handler<T> &async_result_handler<T>::operator =(const async_result_
 template <typename T>
 void async_result_handler<T>::set_total(size_t total)
 {
+	/* replies of the most operations fit preallocated arrays, large ones may grow */
+	static const size_t reserve_limit = 64;
+	const size_t reserve = std::min(total, reserve_limit);
+
+	std::unique_lock<std::mutex> locker(m_data->lock);
 	m_data->total = total;
+	m_data->statuses.reserve(reserve);
+	if (!m_data->result_handler)
+		m_data->results.reserve(reserve);
+	try_complete_early();
 }
 
 template <typename T>
@@ -491,20 +522,39 @@ size_t async_result_handler<T>::get_total()
 	return m_data->total;
 }
 
+template <typename T>
+void async_result_handler<T>::set_quorum_completion(const result_error_handler &background_error_handler)
+{
+	std::unique_lock<std::mutex> locker(m_data->lock);
+	m_data->quorum_completion = true;
+	m_data->background_error_handler = background_error_handler;
+	try_complete_early();
+}
+
 template <typename T>
 void async_result_handler<T>::process(const T &result)
 {
 	std::unique_lock<std::mutex> locker(m_data->lock);
 	const dnet_cmd *cmd = result.command();
-	if (!(cmd->flags & DNET_FLAGS_MORE))
-		m_data->statuses.push_back(*cmd);
-	if (!m_data->filter(result))
+	const bool last = !(cmd->flags & DNET_FLAGS_MORE);
+
+	if (m_data->finished) {
+		if (last)
+			m_data->background_statuses.push_back(*cmd);
 		return;
-	if (m_data->result_handler) {
-		m_data->result_handler(result);
-	} else {
-		m_data->results.push_back(result);
 	}
+
+	if (last)
+		m_data->statuses.push_back(*cmd);
+	if (m_data->filter(result)) {
+		if (m_data->result_handler) {
+			m_data->result_handler(result);
+		} else {
+			m_data->results.push_back(result);
+		}
+	}
+	if (last)
+		try_complete_early();
 }
 
 template <>
@@ -544,21 +594,63 @@ void async_result_handler<get_index_metadata_result_entry>::process(const get_in
 	}
 }
 
+/*
+ * Completion stays under @lock even for single-reply results: connect() installs final handler
+ * and checks @finished under the same lock, so a lock-free completion could either miss
+ * the handler or call it twice. The lock is not contended here, process() of the last reply
+ * has released it already, and nobody is woken up unless wait() was called.
+ */
 template <typename T>
 void async_result_handler<T>::complete(const error_info &error)
 {
 	std::unique_lock<std::mutex> locker(m_data->lock);
-	m_data->finished = true;
+
+	if (m_data->quorum_completion && m_data->finished) {
+		/* result has been completed by quorum, report failures of the remaining replies */
+		error_info background_error;
+		for (auto it = m_data->background_statuses.begin(); it != m_data->background_statuses.end(); ++it) {
+			if (it->status) {
+				background_error = create_error(*it);
+				break;
+			}
+		}
+		if (!background_error)
+			background_error = error;
+		if (background_error)
+			m_data->background_error_handler(background_error, m_data->background_statuses);
+		return;
+	}
+
+	complete_nolock(error);
+}
+
+template <typename T>
+void async_result_handler<T>::complete_nolock(const error_info &error)
+{
 	dnet_current_time(&m_data->end);
 	m_data->error = error;
 	if (!error) {
 		if (!check(&m_data->error))
 			m_data->error_handler(m_data->error, m_data->statuses);
 	}
+	m_data->finished.store(true, std::memory_order_release);
 	if (m_data->final_handler) {
 		m_data->final_handler(m_data->error);
 	}
-	m_data->condition.notify_all();
+	if (m_data->waiters)
+		m_data->condition.notify_all();
+}
+
+// must be called with @lock held
+template <typename T>
+void async_result_handler<T>::try_complete_early()
+{
+	if (!m_data->quorum_completion || m_data->finished || m_data->statuses.empty()
+			|| m_data->statuses.size() >= m_data->total)
+		return;
+
+	if (m_data->checker(m_data->statuses, m_data->total))
+		complete_nolock(error_info());
 }
 
 template <typename T>
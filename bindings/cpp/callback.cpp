@@ -95,6 +95,79 @@ private:
 	std::atomic_size_t m_total;
 };
 
+/*
+ * Handles DNET_FLAGS_REPLICATE write: primary relays result of every group with DNET_FLAGS_MORE,
+ * they are turned into ordinary final write replies, so checker sees one status per group.
+ * Final acknowledge only matters if primary failed the write before any group result.
+ */
+class replicate_handler
+{
+public:
+	static int handler(dnet_addr *addr, dnet_cmd *cmd, void *priv)
+	{
+		replicate_handler *that = reinterpret_cast<replicate_handler *>(priv);
+		if (that->handle(addr, cmd)) {
+			delete that;
+		}
+
+		return 0;
+	}
+
+	replicate_handler(const elliptics::logger *logger, async_generic_result &result, const std::vector<int> &groups) :
+		m_logger(*logger),
+		m_handler(result), m_groups(groups), m_replied(groups.size(), false), m_processed(false)
+	{
+		m_handler.set_total(groups.size());
+	}
+
+	bool handle(dnet_addr *addr, dnet_cmd *cmd)
+	{
+		if (is_trans_destroyed(cmd)) {
+			m_handler.complete(error_info());
+			return true;
+		}
+
+		BH_LOG(m_logger, cmd->status ? DNET_LOG_ERROR : DNET_LOG_NOTICE,
+			"%s: %s: handled replicated reply from: %s, trans: %lld, cflags: %s, status: %d, size: %lld",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), addr ? dnet_addr_string(addr) : "<unknown>",
+			uint64_t(cmd->trans), dnet_flags_dump_cflags(cmd->flags), int(cmd->status), uint64_t(cmd->size));
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			if (cmd->flags & DNET_FLAGS_MORE) {
+				auto it = std::find(m_groups.begin(), m_groups.end(), int(cmd->id.group_id));
+				if (it == m_groups.end() || m_replied[it - m_groups.begin()])
+					return false;
+
+				m_replied[it - m_groups.begin()] = true;
+			} else if (m_processed || !cmd->status) {
+				return false;
+			}
+
+			m_processed = true;
+		}
+
+		auto data = std::make_shared<callback_result_data>(addr, cmd);
+		reinterpret_cast<dnet_cmd *>(data->data.data<char>() + sizeof(dnet_addr))->flags &= ~DNET_FLAGS_MORE;
+
+		if (cmd->status)
+			data->error = create_error(*cmd);
+
+		m_handler.process(callback_result_entry(data));
+
+		return false;
+	}
+
+private:
+	const elliptics::logger &m_logger;
+	async_result_handler<callback_result_entry> m_handler;
+	std::mutex m_lock;
+	std::vector<int> m_groups;
+	std::vector<bool> m_replied;
+	bool m_processed;
+};
+
 } // namespace detail
 
 template <typename Method, typename T>
@@ -118,7 +191,7 @@ async_generic_result send_impl(session &sess, T &control, Method method)
 
 static size_t send_to_single_state_impl(session &sess, dnet_trans_control &ctl)
 {
-	dnet_trans_alloc_send(sess.get_native(), &ctl);
+	dnet_trans_alloc_send(sess.get_native_shared(), &ctl);
 	return 1;
 }
 
@@ -131,7 +204,7 @@ async_generic_result send_to_single_state(session &sess, const transport_control
 
 static size_t send_to_single_state_io_impl(session &sess, dnet_io_control &ctl)
 {
-	dnet_io_trans_alloc_send(sess.get_native(), &ctl);
+	dnet_io_trans_alloc_send(sess.get_native_shared(), &ctl);
 	return 1;
 }
 
@@ -142,7 +215,7 @@ async_generic_result send_to_single_state(session &sess, dnet_io_control &contro
 
 static size_t send_to_each_backend_impl(session &sess, dnet_trans_control &ctl)
 {
-	return dnet_request_cmd(sess.get_native(), &ctl);
+	return dnet_request_cmd(sess.get_native_shared(), &ctl);
 }
 
 // Send request to each backend
@@ -155,7 +228,7 @@ async_generic_result send_to_each_backend(session &sess, const transport_control
 static size_t send_to_each_node_impl(session &sess, dnet_trans_control &ctl)
 {
 	dnet_node *node = sess.get_native_node();
-	dnet_session *native_sess = sess.get_native();
+	dnet_session *native_sess = sess.get_native_shared();
 	dnet_net_state *st;
 
 	ctl.cflags |= DNET_FLAGS_DIRECT;
@@ -182,7 +255,7 @@ async_generic_result send_to_each_node(session &sess, const transport_control &c
 
 static size_t send_to_groups_impl(session &sess, dnet_trans_control &ctl)
 {
-	dnet_session *native = sess.get_native();
+	dnet_session *native = sess.get_native_shared();
 	size_t counter = 0;
 
 	for (int i = 0; i < native->group_num; ++i) {
@@ -203,7 +276,7 @@ async_generic_result send_to_groups(session &sess, const transport_control &cont
 
 static size_t send_to_groups_io_impl(session &sess, dnet_io_control &ctl)
 {
-	return dnet_trans_create_send_all(sess.get_native(), &ctl);
+	return dnet_trans_create_send_all(sess.get_native_shared(), &ctl);
 }
 
 async_generic_result send_to_groups(session &sess, dnet_io_control &control)
@@ -211,6 +284,46 @@ async_generic_result send_to_groups(session &sess, dnet_io_control &control)
 	return send_impl(sess, control, send_to_groups_io_impl);
 }
 
+async_generic_result send_replicated_write(session &sess, dnet_io_control &control,
+	const std::vector<int> &groups, uint32_t checker)
+{
+	scoped_trace_id guard(sess);
+	async_generic_result result(sess);
+
+	const size_t hsize = sizeof(dnet_replicate_request) + groups.size() * sizeof(int);
+	data_pointer header = data_pointer::allocate(hsize);
+	memset(header.data(), 0, hsize);
+
+	dnet_replicate_request *req = header.data<dnet_replicate_request>();
+	req->group_num = groups.size();
+	req->checker = checker;
+	for (size_t i = 0; i < groups.size(); ++i)
+		req->groups[i] = dnet_bswap32(groups[i]);
+	dnet_convert_replicate_request(req);
+
+	iovec iov[2];
+	iov[0].iov_base = header.data();
+	iov[0].iov_len = hsize;
+	iov[1].iov_base = const_cast<void *>(control.data);
+	iov[1].iov_len = control.io.size;
+
+	// header is covered by io.size and stripped by the primary
+	control.iov = iov;
+	control.iovcnt = 2;
+	control.io.size += hsize;
+	control.cflags |= DNET_FLAGS_REPLICATE;
+	control.id.group_id = groups.front();
+
+	detail::replicate_handler *handler = new detail::replicate_handler(sess.get_native_node()->log, result, groups);
+
+	control.complete = detail::replicate_handler::handler;
+	control.priv = handler;
+
+	dnet_io_trans_alloc_send(sess.get_native_shared(), &control);
+
+	return result;
+}
+
 async_generic_result send_srw_command(session &sess, dnet_id *id, sph *srw_data)
 {
 	scoped_trace_id guard(sess);
@@ -218,7 +331,7 @@ async_generic_result send_srw_command(session &sess, dnet_id *id, sph *srw_data)
 
 	detail::basic_handler *handler = new detail::basic_handler(sess.get_native_node()->log, result);
 
-	const size_t count = dnet_send_cmd(sess.get_native(), id, detail::basic_handler::handler, handler, srw_data);
+	const size_t count = dnet_send_cmd(sess.get_native_shared(), id, detail::basic_handler::handler, handler, srw_data);
 
 	if (handler->set_total(count))
 		delete handler;
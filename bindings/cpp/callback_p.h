@@ -183,6 +183,10 @@ async_generic_result send_to_each_node(session &sess, const transport_control &c
 async_generic_result send_to_groups(session &sess, const transport_control &control);
 async_generic_result send_to_groups(session &sess, dnet_io_control &control);
 
+// Send write to the first of @groups, its node replicates data to the rest of them
+async_generic_result send_replicated_write(session &sess, dnet_io_control &control,
+	const std::vector<int> &groups, uint32_t checker);
+
 async_generic_result send_srw_command(session &sess, dnet_id *id, sph *srw_data);
 
 template <typename Handler, typename Entry>
@@ -207,6 +211,7 @@ public:
 			return;
 		}
 
+		dnet_node_retry_budget_deposit(m_sess.get_native_node());
 		next_group();
 	}
 
@@ -222,7 +227,7 @@ public:
 		group_finished(error);
 		++m_group_index;
 
-		if (m_group_index < m_groups.size() && need_next_group(error)) {
+		if (m_group_index < m_groups.size() && need_next_group(error) && retry_allowed()) {
 			next_group();
 		} else {
 			m_handler.complete(error_info());
@@ -250,6 +255,16 @@ protected:
 		);
 	}
 
+	bool retry_allowed()
+	{
+		if (!dnet_node_retry_budget_withdraw(m_sess.get_native_node()))
+			return true;
+
+		BH_LOG(m_sess.get_logger(), DNET_LOG_NOTICE, "retry budget is exhausted, %zu groups are left unasked",
+			m_groups.size() - m_group_index);
+		return false;
+	}
+
 	// Override this if you want to do something on each received packet
 	virtual void process_entry(const Entry &entry)
 	{
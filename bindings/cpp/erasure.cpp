@@ -0,0 +1,804 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "erasure.hpp"
+#include "callback_p.h"
+#include "functional_p.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define ERASURE_AVX2 1
+# include <immintrin.h>
+#endif
+
+namespace ioremap { namespace elliptics {
+
+#define ERASURE_CHUNK_MAGIC	0x31304345	/* "EC01" */
+
+/*
+ * Header of the chunk record, it is stored in little endian byte order
+ */
+struct erasure_chunk_header {
+	uint32_t	magic;
+	uint16_t	data_chunks;
+	uint16_t	parity_chunks;
+	uint32_t	index;
+	uint32_t	__reserved32;
+	uint64_t	size;		/* size of the whole object */
+	uint64_t	__reserved[2];
+} __attribute__ ((packed));
+
+static inline void erasure_convert_chunk_header(erasure_chunk_header *h)
+{
+	h->magic = dnet_bswap32(h->magic);
+	h->data_chunks = dnet_bswap16(h->data_chunks);
+	h->parity_chunks = dnet_bswap16(h->parity_chunks);
+	h->index = dnet_bswap32(h->index);
+	h->size = dnet_bswap64(h->size);
+}
+
+namespace {
+
+/*
+ * GF(2^8) with 0x11d polynomial
+ */
+struct gf256
+{
+	uint8_t exp[512];
+	uint8_t log[256];
+
+	gf256()
+	{
+		unsigned int x = 1;
+
+		for (int i = 0; i < 255; ++i) {
+			exp[i] = x;
+			log[x] = i;
+
+			x <<= 1;
+			if (x & 0x100)
+				x ^= 0x11d;
+		}
+
+		for (int i = 255; i < 512; ++i)
+			exp[i] = exp[i - 255];
+
+		log[0] = 0;
+	}
+
+	uint8_t mul(uint8_t a, uint8_t b) const
+	{
+		if (!a || !b)
+			return 0;
+		return exp[log[a] + log[b]];
+	}
+
+	// @a must not be zero
+	uint8_t inv(uint8_t a) const
+	{
+		return exp[255 - log[a]];
+	}
+};
+
+static const gf256 &gf()
+{
+	static const gf256 field;
+	return field;
+}
+
+#ifdef ERASURE_AVX2
+
+static int erasure_avx2_supported()
+{
+	static int supported = -1;
+
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+
+	return supported;
+}
+
+/*
+ * Multiplies 32 bytes at once by looking up products of low and high nibbles with byte shuffles,
+ * returns number of processed bytes
+ */
+__attribute__((target("avx2")))
+static size_t erasure_multiply_add_avx2(uint8_t *dst, const uint8_t *src, const uint8_t *lo, const uint8_t *hi,
+		size_t size)
+{
+	const __m128i lo128 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo));
+	const __m128i hi128 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi));
+	const __m256i lo_table = _mm256_inserti128_si256(_mm256_castsi128_si256(lo128), lo128, 1);
+	const __m256i hi_table = _mm256_inserti128_si256(_mm256_castsi128_si256(hi128), hi128, 1);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i;
+
+	for (i = 0; i + 32 <= size; i += 32) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		const __m256i l = _mm256_and_si256(v, mask);
+		const __m256i h = _mm256_and_si256(_mm256_srli_epi64(v, 4), mask);
+		const __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo_table, l), _mm256_shuffle_epi8(hi_table, h));
+		const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(d, p));
+	}
+
+	return i;
+}
+
+#endif
+
+/*
+ * Inverts @n x @n @matrix in place, returns false if it is singular
+ */
+static bool erasure_invert(std::vector<uint8_t> &matrix, size_t n)
+{
+	const gf256 &g = gf();
+	std::vector<uint8_t> inv(n * n, 0);
+
+	for (size_t i = 0; i < n; ++i)
+		inv[i * n + i] = 1;
+
+	for (size_t col = 0; col < n; ++col) {
+		size_t pivot = col;
+		while (pivot < n && !matrix[pivot * n + col])
+			++pivot;
+		if (pivot == n)
+			return false;
+
+		if (pivot != col) {
+			for (size_t j = 0; j < n; ++j) {
+				std::swap(matrix[pivot * n + j], matrix[col * n + j]);
+				std::swap(inv[pivot * n + j], inv[col * n + j]);
+			}
+		}
+
+		const uint8_t scale = g.inv(matrix[col * n + col]);
+		for (size_t j = 0; j < n; ++j) {
+			matrix[col * n + j] = g.mul(matrix[col * n + j], scale);
+			inv[col * n + j] = g.mul(inv[col * n + j], scale);
+		}
+
+		for (size_t row = 0; row < n; ++row) {
+			const uint8_t factor = matrix[row * n + col];
+			if (row == col || !factor)
+				continue;
+
+			for (size_t j = 0; j < n; ++j) {
+				matrix[row * n + j] ^= g.mul(factor, matrix[col * n + j]);
+				inv[row * n + j] ^= g.mul(factor, inv[col * n + j]);
+			}
+		}
+	}
+
+	matrix.swap(inv);
+	return true;
+}
+
+} // namespace
+
+erasure_code::erasure_code(size_t data_chunks, size_t parity_chunks) :
+	m_data_chunks(data_chunks),
+	m_parity_chunks(parity_chunks)
+{
+	if (!data_chunks || !parity_chunks || data_chunks + parity_chunks > 255) {
+		throw_error(-EINVAL, "invalid erasure code: data chunks: %zu, parity chunks: %zu, "
+				"both must be positive and their sum must not exceed 255", data_chunks, parity_chunks);
+	}
+
+	const gf256 &g = gf();
+
+	// Cauchy matrix 1 / (x_i + y_j) with x_i = data_chunks + i and y_j = j
+	m_parity.resize(parity_chunks * data_chunks);
+	for (size_t i = 0; i < parity_chunks; ++i) {
+		for (size_t j = 0; j < data_chunks; ++j)
+			m_parity[i * data_chunks + j] = g.inv((data_chunks + i) ^ j);
+	}
+}
+
+size_t erasure_code::chunk_size(uint64_t size) const
+{
+	return (size + m_data_chunks - 1) / m_data_chunks;
+}
+
+void erasure_code::multiply_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t size)
+{
+	size_t i = 0;
+
+	if (!c)
+		return;
+
+	if (c == 1) {
+		for (; i < size; ++i)
+			dst[i] ^= src[i];
+		return;
+	}
+
+	const gf256 &g = gf();
+	uint8_t lo[16], hi[16];
+
+	for (unsigned int x = 0; x < 16; ++x) {
+		lo[x] = g.mul(c, x);
+		hi[x] = g.mul(c, x << 4);
+	}
+
+#ifdef ERASURE_AVX2
+	if (size >= 32 && erasure_avx2_supported())
+		i = erasure_multiply_add_avx2(dst, src, lo, hi, size);
+#endif
+
+	for (; i < size; ++i)
+		dst[i] ^= lo[src[i] & 0x0f] ^ hi[src[i] >> 4];
+}
+
+std::vector<data_pointer> erasure_code::encode(const data_pointer &data) const
+{
+	const size_t size = chunk_size(data.size());
+	std::vector<data_pointer> chunks;
+	chunks.reserve(total_chunks());
+
+	for (size_t i = 0; i < m_data_chunks; ++i) {
+		const size_t offset = std::min(i * size, data.size());
+		const size_t length = std::min(size, data.size() - offset);
+
+		if (length == size) {
+			chunks.push_back(data.slice(offset, size));
+			continue;
+		}
+
+		data_pointer chunk = data_pointer::allocate(size);
+		if (length)
+			memcpy(chunk.data(), data.data<char>() + offset, length);
+		memset(chunk.data<char>() + length, 0, size - length);
+		chunks.push_back(chunk);
+	}
+
+	for (size_t i = 0; i < m_parity_chunks; ++i) {
+		data_pointer chunk = data_pointer::allocate(size);
+		memset(chunk.data(), 0, size);
+
+		for (size_t j = 0; j < m_data_chunks && size; ++j) {
+			multiply_add(chunk.data<uint8_t>(), chunks[j].data<uint8_t>(),
+					m_parity[i * m_data_chunks + j], size);
+		}
+
+		chunks.push_back(chunk);
+	}
+
+	return chunks;
+}
+
+bool erasure_code::decode(std::vector<data_pointer> &chunks, size_t chunk_size) const
+{
+	std::vector<size_t> rows;
+	bool data_missing = false;
+
+	if (chunks.size() != total_chunks())
+		return false;
+
+	if (!chunk_size)
+		return true;
+
+	// data chunks are preferred, they need no multiplication
+	for (size_t i = 0; i < total_chunks() && rows.size() < m_data_chunks; ++i) {
+		if (!chunks[i].empty())
+			rows.push_back(i);
+		else if (i < m_data_chunks)
+			data_missing = true;
+	}
+
+	if (rows.size() < m_data_chunks)
+		return false;
+
+	if (data_missing) {
+		std::vector<uint8_t> matrix(m_data_chunks * m_data_chunks, 0);
+
+		for (size_t r = 0; r < m_data_chunks; ++r) {
+			if (rows[r] < m_data_chunks) {
+				matrix[r * m_data_chunks + rows[r]] = 1;
+			} else {
+				memcpy(&matrix[r * m_data_chunks], &m_parity[(rows[r] - m_data_chunks) * m_data_chunks],
+						m_data_chunks);
+			}
+		}
+
+		if (!erasure_invert(matrix, m_data_chunks))
+			return false;
+
+		for (size_t j = 0; j < m_data_chunks; ++j) {
+			if (!chunks[j].empty())
+				continue;
+
+			data_pointer chunk = data_pointer::allocate(chunk_size);
+			memset(chunk.data(), 0, chunk_size);
+
+			for (size_t r = 0; r < m_data_chunks; ++r) {
+				multiply_add(chunk.data<uint8_t>(), chunks[rows[r]].data<uint8_t>(),
+						matrix[j * m_data_chunks + r], chunk_size);
+			}
+
+			chunks[j] = chunk;
+		}
+	}
+
+	for (size_t i = 0; i < m_parity_chunks; ++i) {
+		data_pointer &chunk = chunks[m_data_chunks + i];
+		if (!chunk.empty())
+			continue;
+
+		chunk = data_pointer::allocate(chunk_size);
+		memset(chunk.data(), 0, chunk_size);
+
+		for (size_t j = 0; j < m_data_chunks; ++j) {
+			multiply_add(chunk.data<uint8_t>(), chunks[j].data<uint8_t>(),
+					m_parity[i * m_data_chunks + j], chunk_size);
+		}
+	}
+
+	return true;
+}
+
+key erasure_code::chunk_key(const session &sess, const key &id, size_t index) const
+{
+	std::string name(reinterpret_cast<const char *>(id.raw_id().id), DNET_ID_SIZE);
+	name += "\nerasure-chunk:";
+	name += lexical_cast(index);
+
+	dnet_id chunk_id;
+	memset(&chunk_id, 0, sizeof(dnet_id));
+	sess.transform(name, chunk_id);
+
+	return key(chunk_id);
+}
+
+namespace {
+
+/*
+ * Collects replies of chunk writes
+ */
+struct erasure_writer
+{
+	ELLIPTICS_DISABLE_COPY(erasure_writer)
+
+	erasure_writer(const async_result_handler<write_result_entry> &handler, const key &id, size_t pending,
+			size_t required) :
+		handler(handler), id(id), pending(pending), success(0), required(required)
+	{
+	}
+
+	async_result_handler<write_result_entry> handler;
+	key id;
+	std::mutex lock;
+	size_t pending;
+	size_t success;
+	size_t required;
+
+	void process(const write_result_entry &entry)
+	{
+		if (entry.status() == 0 && !(entry.command()->flags & DNET_FLAGS_MORE)) {
+			std::lock_guard<std::mutex> guard(lock);
+			++success;
+		}
+
+		handler.process(entry);
+	}
+
+	void complete(const error_info &)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (--pending)
+			return;
+
+		if (success < required) {
+			handler.complete(create_error(-EIO, id, "erasure write: %zu chunks are written, %zu are required",
+						success, required));
+		} else {
+			handler.complete(error_info());
+		}
+	}
+};
+
+static void erasure_write_chunk(session &sess, const erasure_code &code, const key &id, const std::vector<int> &groups,
+		size_t index, uint64_t size, const dnet_time &timestamp, const data_pointer &chunk,
+		const std::shared_ptr<erasure_writer> &writer)
+{
+	erasure_chunk_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ERASURE_CHUNK_MAGIC;
+	header.data_chunks = code.data_chunks();
+	header.parity_chunks = code.parity_chunks();
+	header.index = index;
+	header.size = size;
+	erasure_convert_chunk_header(&header);
+
+	std::vector<data_pointer> segments;
+	segments.push_back(data_pointer::copy(&header, sizeof(header)));
+	segments.push_back(chunk);
+
+	session chunk_sess = sess.clean_clone();
+	chunk_sess.set_groups(std::vector<int>(1, groups[index % groups.size()]));
+	chunk_sess.set_timestamp(timestamp);
+
+	chunk_sess.write_data(code.chunk_key(sess, id, index), segments, 0).connect(
+		std::bind(&erasure_writer::process, writer, std::placeholders::_1),
+		std::bind(&erasure_writer::complete, writer, std::placeholders::_1));
+}
+
+/*
+ * Object version restored from chunks
+ */
+struct erasure_object
+{
+	std::vector<data_pointer> chunks;	// all chunks of the version
+	std::vector<bool> stored;		// whether the chunk of this version has been read from the storage
+	uint64_t size;
+	dnet_time timestamp;
+	read_result_entry reply;		// reply of one of chunks, its address and io attribute are reused
+};
+
+/*
+ * Reads chunks of the object and restores its newest version which has enough of them
+ */
+class erasure_reader : public std::enable_shared_from_this<erasure_reader>
+{
+public:
+	typedef std::function<void (const error_info &, erasure_object &)> handler_type;
+
+	erasure_reader(const session &sess, const std::shared_ptr<erasure_code> &code, const key &id,
+			const std::vector<int> &groups, bool read_all, const handler_type &handler) :
+		m_sess(sess.clean_clone()),
+		m_code(code),
+		m_id(id),
+		m_groups(groups),
+		m_read_all(read_all),
+		m_handler(handler),
+		m_chunks(code->total_chunks()),
+		m_requested(0),
+		m_pending(0)
+	{
+	}
+
+	void start()
+	{
+		read(m_read_all ? m_code->total_chunks() : m_code->data_chunks());
+	}
+
+private:
+	struct chunk_reply
+	{
+		chunk_reply() : valid(false), size(0)
+		{
+			dnet_empty_time(&timestamp);
+		}
+
+		bool valid;
+		uint64_t size;
+		dnet_time timestamp;
+		data_pointer data;
+		read_result_entry entry;
+	};
+
+	void read(size_t end)
+	{
+		const size_t begin = m_requested;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_pending += end - begin;
+			m_requested = end;
+		}
+
+		auto self = shared_from_this();
+		for (size_t i = begin; i < end; ++i) {
+			m_sess.read_data(m_code->chunk_key(m_sess, m_id, i), std::vector<int>(1, m_groups[i % m_groups.size()]), 0, 0).connect(
+				std::bind(&erasure_reader::process, self, i, std::placeholders::_1),
+				std::bind(&erasure_reader::complete, self, std::placeholders::_1));
+		}
+	}
+
+	void process(size_t index, const read_result_entry &entry)
+	{
+		if (entry.status() || !entry.io_attribute())
+			return;
+
+		const data_pointer file = entry.file();
+		if (file.size() < sizeof(erasure_chunk_header))
+			return;
+
+		erasure_chunk_header header = *file.data<erasure_chunk_header>();
+		erasure_convert_chunk_header(&header);
+
+		if (header.magic != ERASURE_CHUNK_MAGIC || header.data_chunks != m_code->data_chunks() ||
+				header.parity_chunks != m_code->parity_chunks() || header.index != index ||
+				file.size() - sizeof(erasure_chunk_header) != m_code->chunk_size(header.size))
+			return;
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		chunk_reply &chunk = m_chunks[index];
+		chunk.valid = true;
+		chunk.size = header.size;
+		chunk.timestamp = entry.io_attribute()->timestamp;
+		chunk.data = file.skip(sizeof(erasure_chunk_header));
+		chunk.entry = entry;
+	}
+
+	void complete(const error_info &error)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		if (error)
+			m_error = error;
+
+		if (--m_pending)
+			return;
+
+		erasure_object object;
+		const bool final = m_requested == m_code->total_chunks();
+
+		if (select(object, final)) {
+			guard.unlock();
+			m_handler(error_info(), object);
+			return;
+		}
+
+		if (!final) {
+			guard.unlock();
+			read(m_code->total_chunks());
+			return;
+		}
+
+		guard.unlock();
+		m_handler(m_error ? m_error : create_error(-EIO, m_id, "erasure read: not enough chunks to restore the object"),
+				object);
+	}
+
+	static bool newer(const chunk_reply &a, const chunk_reply &b)
+	{
+		const int cmp = dnet_time_cmp(&a.timestamp, &b.timestamp);
+		return cmp > 0 || (cmp == 0 && a.size > b.size);
+	}
+
+	static bool same_version(const chunk_reply &a, const chunk_reply &b)
+	{
+		return !dnet_time_cmp(&a.timestamp, &b.timestamp) && a.size == b.size;
+	}
+
+	/*
+	 * Restores the newest version from read chunks, until all chunks are read
+	 * only the newest seen version is accepted, since older one may be overwritten in missing chunks.
+	 * Must be called with @m_lock held.
+	 */
+	bool select(erasure_object &object, bool final)
+	{
+		std::vector<const chunk_reply *> versions;
+		for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it) {
+			if (!it->valid)
+				continue;
+
+			bool known = false;
+			for (auto v = versions.begin(); v != versions.end() && !known; ++v)
+				known = same_version(**v, *it);
+			if (!known)
+				versions.push_back(&*it);
+		}
+
+		std::sort(versions.begin(), versions.end(), [] (const chunk_reply *a, const chunk_reply *b) {
+			return newer(*a, *b);
+		});
+
+		if (!final && versions.size() > 1)
+			versions.resize(1);
+
+		for (auto v = versions.begin(); v != versions.end(); ++v) {
+			const chunk_reply &version = **v;
+			size_t count = 0;
+
+			object.chunks.assign(m_code->total_chunks(), data_pointer());
+			object.stored.assign(m_code->total_chunks(), false);
+
+			for (size_t i = 0; i < m_chunks.size(); ++i) {
+				if (m_chunks[i].valid && same_version(version, m_chunks[i])) {
+					object.chunks[i] = m_chunks[i].data;
+					object.stored[i] = true;
+					++count;
+				}
+			}
+
+			if (count < m_code->data_chunks())
+				continue;
+
+			if (!m_code->decode(object.chunks, m_code->chunk_size(version.size)))
+				continue;
+
+			object.size = version.size;
+			object.timestamp = version.timestamp;
+			object.reply = version.entry;
+			return true;
+		}
+
+		return false;
+	}
+
+	session m_sess;
+	std::shared_ptr<erasure_code> m_code;
+	key m_id;
+	std::vector<int> m_groups;
+	bool m_read_all;
+	handler_type m_handler;
+
+	std::mutex m_lock;
+	std::vector<chunk_reply> m_chunks;
+	size_t m_requested;
+	size_t m_pending;
+	error_info m_error;
+};
+
+/*
+ * Builds read reply of the whole object from the reply of one of its chunks
+ */
+static read_result_entry erasure_read_entry(const erasure_code &code, const key &id, const erasure_object &object)
+{
+	const size_t chunk_size = code.chunk_size(object.size);
+	auto data = std::make_shared<callback_result_data>();
+
+	data->data = data_pointer::allocate(sizeof(dnet_addr) + sizeof(dnet_cmd) + sizeof(dnet_io_attr) + object.size);
+
+	dnet_addr *addr = data->data.data<dnet_addr>();
+	dnet_cmd *cmd = reinterpret_cast<dnet_cmd *>(addr + 1);
+	dnet_io_attr *io = reinterpret_cast<dnet_io_attr *>(cmd + 1);
+	char *file = reinterpret_cast<char *>(io + 1);
+
+	*addr = *object.reply.address();
+
+	*cmd = *object.reply.command();
+	cmd->id = id.id();
+	cmd->id.group_id = object.reply.command()->id.group_id;
+	cmd->size = sizeof(dnet_io_attr) + object.size;
+	cmd->flags &= ~DNET_FLAGS_MORE;
+
+	*io = *object.reply.io_attribute();
+	memcpy(io->id, id.id().id, DNET_ID_SIZE);
+	memcpy(io->parent, id.id().id, DNET_ID_SIZE);
+	io->offset = 0;
+	io->size = object.size;
+	io->total_size = object.size;
+
+	for (size_t i = 0, offset = 0; offset < object.size; ++i) {
+		const size_t length = std::min<uint64_t>(chunk_size, object.size - offset);
+		memcpy(file + offset, object.chunks[i].data(), length);
+		offset += length;
+	}
+
+	return callback_cast<read_result_entry>(callback_result_entry(data));
+}
+
+} // namespace
+
+async_write_result erasure_write(session &sess, const std::shared_ptr<erasure_code> &code,
+		const key &id, const data_pointer &data)
+{
+	const std::vector<int> groups = sess.get_groups();
+	async_write_result result(sess);
+
+	if (groups.empty()) {
+		async_result_handler<write_result_entry> handler(result);
+		handler.complete(create_error(-ENXIO, id, "erasure write: session has no groups"));
+		return result;
+	}
+
+	const std::vector<data_pointer> chunks = code->encode(data);
+
+	dnet_time timestamp;
+	sess.get_timestamp(&timestamp);
+	if (dnet_time_is_empty(&timestamp))
+		dnet_current_time(&timestamp);
+
+	async_result_handler<write_result_entry> handler(result);
+	handler.set_total(chunks.size());
+
+	auto writer = std::make_shared<erasure_writer>(handler, id, chunks.size(), code->data_chunks());
+
+	for (size_t i = 0; i < chunks.size(); ++i)
+		erasure_write_chunk(sess, *code, id, groups, i, data.size(), timestamp, chunks[i], writer);
+
+	return result;
+}
+
+async_read_result erasure_read(session &sess, const std::shared_ptr<erasure_code> &code, const key &id)
+{
+	const std::vector<int> groups = sess.get_groups();
+	async_read_result result(sess);
+	async_result_handler<read_result_entry> handler(result);
+	handler.set_total(1);
+
+	if (groups.empty()) {
+		handler.complete(create_error(-ENXIO, id, "erasure read: session has no groups"));
+		return result;
+	}
+
+	auto reader = std::make_shared<erasure_reader>(sess, code, id, groups, false,
+		[handler, code, id] (const error_info &error, erasure_object &object) mutable {
+			if (!error)
+				handler.process(erasure_read_entry(*code, id, object));
+			handler.complete(error);
+		});
+	reader->start();
+
+	return result;
+}
+
+async_write_result erasure_recover(session &sess, const std::shared_ptr<erasure_code> &code, const key &id)
+{
+	const std::vector<int> groups = sess.get_groups();
+
+	// nothing may need to be rewritten, so result is checked only by number of rewritten chunks
+	session checked = sess.clone();
+	checked.set_checker(checkers::no_check);
+	async_write_result result(checked);
+	async_result_handler<write_result_entry> handler(result);
+
+	if (groups.empty()) {
+		handler.complete(create_error(-ENXIO, id, "erasure recover: session has no groups"));
+		return result;
+	}
+
+	auto reader = std::make_shared<erasure_reader>(sess, code, id, groups, true,
+		[handler, sess, code, id, groups] (const error_info &error, erasure_object &object) mutable {
+			if (error) {
+				handler.complete(error);
+				return;
+			}
+
+			const size_t missing = std::count(object.stored.begin(), object.stored.end(), false);
+			if (!missing) {
+				handler.complete(error_info());
+				return;
+			}
+
+			handler.set_total(missing);
+			auto writer = std::make_shared<erasure_writer>(handler, id, missing, missing);
+
+			for (size_t i = 0; i < object.chunks.size(); ++i) {
+				if (!object.stored[i]) {
+					erasure_write_chunk(sess, *code, id, groups, i, object.size, object.timestamp,
+							object.chunks[i], writer);
+				}
+			}
+		});
+	reader->start();
+
+	return result;
+}
+
+async_remove_result erasure_remove(session &sess, const std::shared_ptr<erasure_code> &code, const key &id)
+{
+	const std::vector<int> groups = sess.get_groups();
+	std::vector<async_remove_result> results;
+
+	for (size_t i = 0; i < code->total_chunks() && !groups.empty(); ++i) {
+		session chunk_sess = sess.clean_clone();
+		chunk_sess.set_groups(std::vector<int>(1, groups[i % groups.size()]));
+		results.emplace_back(chunk_sess.remove(code->chunk_key(sess, id, i)));
+	}
+
+	return aggregated(sess, results.begin(), results.end());
+}
+
+}} // namespace ioremap::elliptics
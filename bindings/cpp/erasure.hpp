@@ -0,0 +1,112 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CPP_ERASURE_HPP
+#define __CPP_ERASURE_HPP
+
+#include "elliptics/session.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace ioremap { namespace elliptics {
+
+/*
+ * Systematic Reed-Solomon code over GF(2^8) with @data_chunks data chunks and @parity_chunks parity chunks.
+ * Parity rows of the generator matrix form Cauchy matrix, so any @data_chunks of chunks restore the object.
+ *
+ * Every chunk is stored as a separate record under the key derived from the object key and chunk index,
+ * the record starts with the chunk header. Chunk i is stored in the session group i modulo number of groups,
+ * so the object survives failure of @parity_chunks groups only if there are at least total_chunks() groups.
+ */
+class erasure_code
+{
+public:
+	erasure_code(size_t data_chunks, size_t parity_chunks);
+
+	size_t data_chunks() const {
+		return m_data_chunks;
+	}
+
+	size_t parity_chunks() const {
+		return m_parity_chunks;
+	}
+
+	size_t total_chunks() const {
+		return m_data_chunks + m_parity_chunks;
+	}
+
+	/*
+	 * Size of every chunk of the object of @size bytes, the last data chunk is padded by zeroes
+	 */
+	size_t chunk_size(uint64_t size) const;
+
+	/*
+	 * Splits @data into total_chunks() chunks of chunk_size() bytes, data chunks share @data where possible
+	 */
+	std::vector<data_pointer> encode(const data_pointer &data) const;
+
+	/*
+	 * Restores empty @chunks, all non-empty ones must be of @chunk_size bytes.
+	 * Returns false if there are less than data_chunks() of them.
+	 */
+	bool decode(std::vector<data_pointer> &chunks, size_t chunk_size) const;
+
+	/*
+	 * Key of the chunk @index of the object @id, @id must already be transformed
+	 */
+	key chunk_key(const session &sess, const key &id, size_t index) const;
+
+	/*
+	 * @dst ^= @c * @src over GF(2^8), uses AVX2 if CPU supports it
+	 */
+	static void multiply_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t size);
+
+private:
+	size_t m_data_chunks;
+	size_t m_parity_chunks;
+	// @m_parity_chunks x @m_data_chunks rows of the generator matrix
+	std::vector<uint8_t> m_parity;
+};
+
+/*
+ * Writes all chunks of @data with the same timestamp, result has a reply per chunk.
+ * Write fails if less than data_chunks() of chunks are written, otherwise session checker decides.
+ */
+async_write_result erasure_write(session &sess, const std::shared_ptr<erasure_code> &code,
+		const key &id, const data_pointer &data);
+
+/*
+ * Reads data chunks and restores the object, parity chunks are read only if some data chunks
+ * are missing, corrupted or older than the rest. The newest version which has enough chunks is returned.
+ */
+async_read_result erasure_read(session &sess, const std::shared_ptr<erasure_code> &code, const key &id);
+
+/*
+ * Reads all chunks and rewrites missing, corrupted and stale ones from the newest restorable version,
+ * result has a reply per rewritten chunk
+ */
+async_write_result erasure_recover(session &sess, const std::shared_ptr<erasure_code> &code, const key &id);
+
+/*
+ * Removes all chunks of the object
+ */
+async_remove_result erasure_remove(session &sess, const std::shared_ptr<erasure_code> &code, const key &id);
+
+}} // namespace ioremap::elliptics
+
+#endif // __CPP_ERASURE_HPP
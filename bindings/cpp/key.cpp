@@ -16,14 +16,128 @@
 
 #include <elliptics/cppdef.h>
 
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 #include <boost/make_shared.hpp>
 
 namespace ioremap { namespace elliptics {
 
 enum key_reserved_flags : int {
-	KEY_INITED = 0x0001
+	KEY_INITED = 0x0001,
+	// id has been transformed from the string by namespace key::m_ns
+	KEY_TRANSFORMED = 0x0002
+};
+
+/*
+ * Process-wide LRU of transformed string keys, it is split into shards by hash of the key
+ * so that sessions of different threads do not contend for a single lock.
+ */
+class transform_cache
+{
+public:
+	transform_cache() : m_max_keys(0)
+	{
+	}
+
+	static transform_cache &instance()
+	{
+		static transform_cache cache;
+		return cache;
+	}
+
+	void set_max_keys(size_t max_keys)
+	{
+		m_max_keys = max_keys;
+
+		for (size_t i = 0; i < shards_count; ++i) {
+			std::lock_guard<std::mutex> guard(m_shards[i].lock);
+			m_shards[i].shrink(shard_max_keys());
+		}
+	}
+
+	size_t max_keys() const
+	{
+		return m_max_keys;
+	}
+
+	bool get(const std::string &ns, const std::string &remote, dnet_raw_id &id)
+	{
+		if (!m_max_keys)
+			return false;
+
+		const std::string name = cache_key(ns, remote);
+		shard &s = m_shards[std::hash<std::string>()(name) % shards_count];
+		std::lock_guard<std::mutex> guard(s.lock);
+
+		auto it = s.entries.find(name);
+		if (it == s.entries.end())
+			return false;
+
+		s.lru.splice(s.lru.begin(), s.lru, it->second);
+		id = it->second->second;
+		return true;
+	}
+
+	void put(const std::string &ns, const std::string &remote, const dnet_raw_id &id)
+	{
+		const size_t max_keys = shard_max_keys();
+		if (!max_keys)
+			return;
+
+		std::string name = cache_key(ns, remote);
+		shard &s = m_shards[std::hash<std::string>()(name) % shards_count];
+		std::lock_guard<std::mutex> guard(s.lock);
+
+		auto it = s.entries.find(name);
+		if (it != s.entries.end()) {
+			s.lru.splice(s.lru.begin(), s.lru, it->second);
+			return;
+		}
+
+		s.lru.emplace_front(name, id);
+		s.entries.emplace(std::move(name), s.lru.begin());
+		s.shrink(max_keys);
+	}
+
+private:
+	typedef std::list<std::pair<std::string, dnet_raw_id>> lru_list;
+
+	struct shard {
+		std::mutex lock;
+		lru_list lru;
+		std::unordered_map<std::string, lru_list::iterator> entries;
+
+		// must be called with @lock held
+		void shrink(size_t max_keys)
+		{
+			while (lru.size() > max_keys) {
+				entries.erase(lru.back().first);
+				lru.pop_back();
+			}
+		}
+	};
+
+	enum { shards_count = 16 };
+
+	size_t shard_max_keys() const
+	{
+		const size_t max_keys = m_max_keys;
+		return max_keys ? (max_keys + shards_count - 1) / shards_count : 0;
+	}
+
+	// namespace is length-prefixed, so that its bytes can not be mixed up with the key
+	static std::string cache_key(const std::string &ns, const std::string &remote)
+	{
+		return std::to_string(ns.size()) + ":" + ns + remote;
+	}
+
+	std::atomic<size_t> m_max_keys;
+	shard m_shards[shards_count];
 };
 
 key::key() : m_by_id(false), m_reserved(KEY_INITED)
@@ -47,7 +161,8 @@ key::key(const dnet_raw_id &id) : m_by_id(true), m_reserved(KEY_INITED)
 }
 
 key::key(const key &other)
-	: m_by_id(other.m_by_id), m_remote(other.m_remote), m_reserved(other.m_reserved), m_id(other.m_id)
+	: m_by_id(other.m_by_id), m_remote(other.m_remote), m_reserved(other.m_reserved), m_id(other.m_id),
+	m_ns(other.m_ns)
 {
 }
 
@@ -57,6 +172,7 @@ key &key::operator =(const key &other)
 	m_remote = other.m_remote;
 	m_reserved = other.m_reserved;
 	m_id = other.m_id;
+	m_ns = other.m_ns;
 	return *this;
 }
 
@@ -119,14 +235,61 @@ std::string key::to_string() const
 
 void key::transform(const session &sess) const
 {
-	if (m_by_id)
+	const std::string ns = sess.get_namespace();
+
+	if (!need_transform(ns) || lookup_transformed(ns))
 		return;
 
-	if (!inited()) {
-		memset(&m_id, 0, sizeof(m_id));
-		sess.transform(m_remote, m_id);
-		const_cast<key *>(this)->set_inited(true);
-	}
+	dnet_raw_id id;
+	sess.transform(m_remote, id);
+	set_transformed(ns, id);
+	cache_transformed();
+}
+
+bool key::need_transform(const std::string &ns) const
+{
+	if (m_by_id)
+		return false;
+
+	// default-constructed key or the one whose id has been set by the user
+	if (inited() && !(m_reserved & KEY_TRANSFORMED))
+		return false;
+
+	return !inited() || m_ns != ns;
+}
+
+bool key::lookup_transformed(const std::string &ns) const
+{
+	dnet_raw_id id;
+
+	if (!transform_cache::instance().get(ns, m_remote, id))
+		return false;
+
+	set_transformed(ns, id);
+	return true;
+}
+
+void key::set_transformed(const std::string &ns, const dnet_raw_id &id) const
+{
+	memset(&m_id, 0, sizeof(m_id));
+	memcpy(m_id.id, id.id, sizeof(id.id));
+	m_ns = ns;
+	m_reserved |= KEY_INITED | KEY_TRANSFORMED;
+}
+
+void key::cache_transformed() const
+{
+	transform_cache::instance().put(m_ns, m_remote, raw_id());
+}
+
+void key::set_transform_cache_size(size_t max_keys)
+{
+	transform_cache::instance().set_max_keys(max_keys);
+}
+
+size_t key::get_transform_cache_size()
+{
+	return transform_cache::instance().max_keys();
 }
 
 bool key::inited() const
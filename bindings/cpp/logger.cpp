@@ -14,6 +14,12 @@
 
 #include <boost/io/ios_state.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <pthread.h>
+
 __thread trace_id_t backend_trace_id_hook;
 
 namespace ioremap { namespace elliptics {
@@ -194,12 +200,212 @@ void dnet_node_unset_trace_id()
 	}
 }
 
+namespace ioremap { namespace elliptics {
+
+/*
+ * Records of one thread waiting for the background writer.
+ * The thread is the only producer and the writer is the only consumer,
+ * so both ends move without locks.
+ */
+struct log_ring {
+	struct slot {
+		dnet_logger		*logger;
+		dnet_logger_record	record;
+	};
+
+	explicit log_ring(size_t size) : slots(size), head(0), tail(0), orphaned(false) {}
+
+	std::vector<slot>	slots;
+	std::atomic<size_t>	head;
+	std::atomic<size_t>	tail;
+	// producer thread has exited, ring is freed by the writer when it is drained
+	std::atomic<bool>	orphaned;
+};
+
+/*
+ * Background writer which formats records by logger frontends and writes them to sinks,
+ * so io and network threads only put records into their own rings.
+ * Record which does not fit into the full ring is written synchronously by its thread.
+ */
+class async_log_writer {
+public:
+	static async_log_writer &instance() {
+		static async_log_writer writer;
+		return writer;
+	}
+
+	void start(size_t ring_size) {
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		// rings are per thread, the ones created from now on get the largest size asked
+		m_ring_size = std::max(m_ring_size, ring_size);
+
+		if (m_users++)
+			return;
+
+		m_need_exit = false;
+		m_thread = std::thread(std::bind(&async_log_writer::run, this));
+		m_active = true;
+	}
+
+	void stop() {
+		bool last;
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if (!m_users)
+				return;
+
+			last = !--m_users;
+			if (last) {
+				m_active = false;
+				m_need_exit = true;
+			}
+		}
+
+		if (last)
+			m_thread.join();
+
+		// caller is going to free its logger, records it has queued are written here
+		drain();
+	}
+
+	bool push(dnet_logger *logger, dnet_logger_record &record) {
+		if (!m_active)
+			return false;
+
+		log_ring *ring = thread_ring();
+		if (!ring)
+			return false;
+
+		const size_t tail = ring->tail.load(std::memory_order_relaxed);
+		if (tail - ring->head.load(std::memory_order_acquire) >= ring->slots.size())
+			return false;
+
+		log_ring::slot &slot = ring->slots[tail % ring->slots.size()];
+		slot.logger = logger;
+		slot.record = std::move(record);
+		ring->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	async_log_writer() : m_users(0), m_ring_size(0), m_active(false), m_need_exit(false) {
+		pthread_key_create(&m_key, &async_log_writer::thread_exit);
+	}
+
+	static void thread_exit(void *ring) {
+		static_cast<log_ring *>(ring)->orphaned = true;
+	}
+
+	log_ring *thread_ring() {
+		if (m_thread_ring)
+			return m_thread_ring;
+
+		try {
+			auto ring = std::make_shared<log_ring>(m_ring_size);
+
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_rings.push_back(ring);
+			m_thread_ring = ring.get();
+		} catch (...) {
+			return NULL;
+		}
+
+		pthread_setspecific(m_key, m_thread_ring);
+		return m_thread_ring;
+	}
+
+	size_t drain() {
+		size_t count = 0;
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (auto it = m_rings.begin(); it != m_rings.end();) {
+			log_ring &ring = **it;
+			// orphaned flag is read before the tail, so the last records of exited thread are not lost
+			const bool orphaned = ring.orphaned;
+			const size_t tail = ring.tail.load(std::memory_order_acquire);
+			size_t head = ring.head.load(std::memory_order_relaxed);
+
+			for (; head != tail; ++head, ++count) {
+				log_ring::slot &slot = ring.slots[head % ring.slots.size()];
+				try {
+					slot.logger->push(std::move(slot.record));
+				} catch (...) {
+				}
+				slot.record = dnet_logger_record();
+			}
+			ring.head.store(head, std::memory_order_release);
+
+			if (orphaned)
+				it = m_rings.erase(it);
+			else
+				++it;
+		}
+
+		return count;
+	}
+
+	void run() {
+		dnet_set_name("dnet_log");
+
+		while (!m_need_exit) {
+			if (!drain())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	std::mutex				m_lock;
+	std::vector<std::shared_ptr<log_ring>>	m_rings;
+	int					m_users;
+	size_t					m_ring_size;
+	std::atomic<bool>			m_active;
+	std::atomic<bool>			m_need_exit;
+	std::thread				m_thread;
+	pthread_key_t				m_key;
+
+	static __thread log_ring		*m_thread_ring;
+};
+
+__thread log_ring *async_log_writer::m_thread_ring;
+
+}} // namespace ioremap::elliptics
+
+void dnet_log_async_start(size_t ring_size)
+{
+	if (ring_size)
+		ioremap::elliptics::async_log_writer::instance().start(ring_size);
+}
+
+void dnet_log_async_stop()
+{
+	ioremap::elliptics::async_log_writer::instance().stop();
+}
+
+static void dnet_log_push(dnet_logger *logger, dnet_logger_record *record)
+{
+	if (!ioremap::elliptics::async_log_writer::instance().push(logger, *record))
+		logger->push(std::move(*record));
+}
+
+/*
+ * Rejects records below verbosity without building their attributes,
+ * records of requests with trace bit are checked by the logger itself
+ */
+static inline bool dnet_log_level_passes(dnet_logger *logger, dnet_log_level level)
+{
+	return level >= logger->log().verbosity() || backend_trace_id_hook;
+}
+
 static __thread char dnet_logger_record_buffer[sizeof(dnet_logger_record)];
 
 dnet_logger_record *dnet_log_open_record(dnet_logger *logger, dnet_log_level level)
 {
 	dnet_logger_record *record = reinterpret_cast<dnet_logger_record *>(dnet_logger_record_buffer);
 
+	if (!dnet_log_level_passes(logger, level))
+		return NULL;
+
 	try {
 		new (record) blackhole::log::record_t(logger->open_record(level));
 	} catch (...) {
@@ -216,6 +422,10 @@ dnet_logger_record *dnet_log_open_record(dnet_logger *logger, dnet_log_level lev
 int dnet_log_enabled(dnet_logger *logger, dnet_log_level level)
 {
 	dnet_logger_record *record = reinterpret_cast<dnet_logger_record *>(dnet_logger_record_buffer);
+
+	if (!dnet_log_level_passes(logger, level))
+		return 0;
+
 	try {
 		new (record) blackhole::log::record_t(logger->open_record(level));
 		int result = record->valid();
@@ -259,7 +469,7 @@ void dnet_log_vwrite(dnet_logger *logger, dnet_logger_record *record, const char
 {
 	dnet_log_add_message(record, format, args);
 
-	logger->push(std::move(*record));
+	dnet_log_push(logger, record);
 }
 
 void dnet_log_write(dnet_logger *logger, dnet_logger_record *record, const char *format, ...)
@@ -269,7 +479,7 @@ void dnet_log_write(dnet_logger *logger, dnet_logger_record *record, const char
 	dnet_log_add_message(record, format, args);
 	va_end(args);
 
-	logger->push(std::move(*record));
+	dnet_log_push(logger, record);
 }
 
 void dnet_log_write_err(dnet_logger *logger, dnet_logger_record *record, int err, const char *format, ...)
@@ -281,7 +491,7 @@ void dnet_log_write_err(dnet_logger *logger, dnet_logger_record *record, int err
 	dnet_log_add_message(record, format, args);
 	va_end(args);
 
-	logger->push(std::move(*record));
+	dnet_log_push(logger, record);
 }
 
 void dnet_log_close_record(dnet_logger_record *record)
@@ -0,0 +1,249 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "near_cache.hpp"
+#include "callback_p.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace ioremap { namespace elliptics {
+
+near_cache::near_cache(size_t max_size, long ttl_ms) :
+	m_max_size(max_size),
+	m_ttl_ms(ttl_ms),
+	m_hits(0),
+	m_size(0)
+{
+}
+
+async_read_result near_cache::read(session &sess, const key &id, const std::vector<int> &groups, const dnet_io_attr &io)
+{
+	async_read_result result(sess);
+	async_result_handler<read_result_entry> handler(result);
+	handler.set_total(1);
+
+	std::vector<int> sorted_groups(groups);
+	std::sort(sorted_groups.begin(), sorted_groups.end());
+
+	session origin = sess.clean_clone();
+	origin.set_near_cache(0, 0);
+
+	entry_ptr e, stale;
+	bool cache_reply = true;
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+
+		auto it = m_entries.find(id.raw_id());
+		if (it != m_entries.end()) {
+			e = it->second;
+
+			if (e->ready && e->groups == sorted_groups && clock::now() < e->expires) {
+				m_lru.splice(m_lru.begin(), m_lru, e->lru_position);
+				read_result_entry data = e->data;
+
+				guard.unlock();
+
+				m_hits.fetch_add(1, std::memory_order_relaxed);
+
+				handler.process(data);
+				handler.complete(error_info());
+				return result;
+			}
+
+			if (!e->ready && e->groups == sorted_groups) {
+				// the same key is being read and subscribed already, do not cache this reply
+				cache_reply = false;
+			} else {
+				erase_nolock(e);
+				stale = e;
+			}
+		}
+
+		if (cache_reply) {
+			session subscriber = origin.clean_clone();
+			subscriber.set_timeout_ms(m_ttl_ms);
+
+			e = std::make_shared<entry>(subscriber);
+			e->id = id.raw_id();
+			e->groups = std::move(sorted_groups);
+
+			m_entries.insert(std::make_pair(e->id, e));
+		}
+	}
+
+	if (stale) {
+		for (auto it = stale->groups.begin(); it != stale->groups.end(); ++it)
+			unsubscribe(stale, *it);
+	}
+
+	if (!cache_reply) {
+		origin.read_data(id, groups, io).connect(handler);
+		return result;
+	}
+
+	// subscribe before read, so that write which happens after read is not missed
+	subscribe(e);
+
+	auto data = std::make_shared<read_result_entry>();
+	auto self = shared_from_this();
+
+	origin.read_data(id, groups, io).connect(
+		[data, handler] (const read_result_entry &entry) mutable {
+			if (filters::positive(entry)) {
+				dnet_io_attr *io = entry.io_attribute();
+				if (io->offset == 0 && io->size == io->total_size)
+					*data = entry;
+			}
+
+			handler.process(entry);
+		},
+		[self, e, data, handler] (const error_info &error) mutable {
+			self->read_complete(e, data);
+			handler.complete(error);
+		}
+	);
+
+	return result;
+}
+
+void near_cache::subscribe(const entry_ptr &e)
+{
+	using std::placeholders::_1;
+
+	for (auto it = e->groups.begin(); it != e->groups.end(); ++it) {
+		dnet_id id;
+		dnet_setup_id(&id, *it, e->id.id);
+
+		session sess = e->sess;
+		transport_control control(id, DNET_CMD_NOTIFY, DNET_FLAGS_NEED_ACK);
+
+		send_to_single_state(sess, control).connect(
+			std::bind(&near_cache::on_notify, shared_from_this(), e, *it, _1),
+			[] (const error_info &) {}
+		);
+	}
+}
+
+void near_cache::unsubscribe(const entry_ptr &e, int group_id)
+{
+	dnet_id id;
+	dnet_setup_id(&id, group_id, e->id.id);
+
+	session sess = e->sess;
+	transport_control control(id, DNET_CMD_NOTIFY, DNET_ATTR_DROP_NOTIFICATION | DNET_FLAGS_NEED_ACK);
+
+	send_to_single_state(sess, control);
+}
+
+void near_cache::read_complete(const entry_ptr &e, const std::shared_ptr<read_result_entry> &data)
+{
+	std::vector<entry_ptr> evicted;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto it = m_entries.find(e->id);
+		if (it == m_entries.end() || it->second != e || e->ready)
+			return;
+
+		if (!data->is_valid()) {
+			erase_nolock(e);
+			evicted.push_back(e);
+		} else {
+			e->ready = true;
+			e->data = *data;
+			e->size = sizeof(entry) + e->data.file().size();
+			e->expires = clock::now() + std::chrono::milliseconds(m_ttl_ms);
+			e->lru_position = m_lru.insert(m_lru.begin(), e);
+			m_size += e->size;
+
+			while (m_size > m_max_size && !m_lru.empty()) {
+				entry_ptr victim = m_lru.back();
+
+				erase_nolock(victim);
+				evicted.push_back(victim);
+			}
+		}
+	}
+
+	for (auto it = evicted.begin(); it != evicted.end(); ++it) {
+		for (auto group = (*it)->groups.begin(); group != (*it)->groups.end(); ++group)
+			unsubscribe(*it, *group);
+	}
+}
+
+void near_cache::on_notify(const entry_ptr &e, int group_id, const callback_result_entry &entry)
+{
+	if (entry.is_final()) {
+		on_subscription_complete(e, group_id, entry.status() == -ETIMEDOUT);
+		return;
+	}
+
+	// key was modified in one of the groups
+	drop(e);
+}
+
+void near_cache::on_subscription_complete(const entry_ptr &e, int group_id, bool timed_out)
+{
+	bool erased = false;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto it = m_entries.find(e->id);
+		if (it != m_entries.end() && it->second == e) {
+			erase_nolock(e);
+			erased = true;
+		}
+	}
+
+	if (erased) {
+		for (auto it = e->groups.begin(); it != e->groups.end(); ++it)
+			unsubscribe(e, *it);
+	} else if (timed_out) {
+		// subscription is still registered on the server, while its transaction is already gone
+		unsubscribe(e, group_id);
+	}
+}
+
+void near_cache::erase_nolock(const entry_ptr &e)
+{
+	m_entries.erase(e->id);
+
+	if (e->ready) {
+		m_lru.erase(e->lru_position);
+		m_size -= e->size;
+		e->ready = false;
+	}
+}
+
+void near_cache::drop(const entry_ptr &e)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto it = m_entries.find(e->id);
+		if (it == m_entries.end() || it->second != e)
+			return;
+
+		erase_nolock(e);
+	}
+
+	for (auto it = e->groups.begin(); it != e->groups.end(); ++it)
+		unsubscribe(e, *it);
+}
+
+}} // namespace ioremap::elliptics
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CPP_NEAR_CACHE_HPP
+#define __CPP_NEAR_CACHE_HPP
+
+#include "elliptics/session.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace ioremap { namespace elliptics {
+
+/*
+ * In-process LRU cache of whole objects read by session::read_data().
+ *
+ * Every cached key is subscribed to DNET_CMD_NOTIFY in all groups it was read from
+ * before the read is sent. Entry is dropped when any group notifies about write or removal of the key,
+ * when any subscription is lost (timed out or its connection reset), when entry's TTL expires
+ * or when it is evicted by size limit. Subscriptions of the dropped entry are removed from servers.
+ *
+ * Subscriptions are sent with @ttl_ms timeout, so keys which were not modified
+ * are reread from the storage once per TTL.
+ *
+ * There is a small window between subscription and read when a write may be processed
+ * by other io thread of the server before the subscription is added, such change is seen after TTL.
+ */
+class near_cache : public std::enable_shared_from_this<near_cache>
+{
+public:
+	near_cache(size_t max_size, long ttl_ms);
+
+	near_cache(const near_cache &) = delete;
+	near_cache &operator =(const near_cache &) = delete;
+
+	/*
+	 * Only reads of the whole object are cached
+	 */
+	static bool is_cacheable(const dnet_io_attr &io) {
+		return io.offset == 0 && io.size == 0;
+	}
+
+	/*
+	 * Serves read from the cache or sends it to @groups and caches its reply,
+	 * @id must already be transformed
+	 */
+	async_read_result read(session &sess, const key &id, const std::vector<int> &groups, const dnet_io_attr &io);
+
+	size_t max_size() const {
+		return m_max_size;
+	}
+
+	long ttl_ms() const {
+		return m_ttl_ms;
+	}
+
+	/*
+	 * Number of reads served from the cache without sending them to the storage
+	 */
+	uint64_t hits() const {
+		return m_hits.load(std::memory_order_relaxed);
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct entry;
+	typedef std::shared_ptr<entry> entry_ptr;
+	typedef std::map<dnet_raw_id, entry_ptr> entry_map;
+
+	struct entry {
+		entry(const session &sess) : sess(sess), ready(false), size(0) {}
+
+		dnet_raw_id			id;
+		// sorted list of groups the object was read from, all of them are subscribed
+		std::vector<int>		groups;
+		// session used to subscribe to notifications, it has near cache disabled
+		session				sess;
+		bool				ready;
+		read_result_entry		data;
+		size_t				size;
+		clock::time_point		expires;
+		std::list<entry_ptr>::iterator	lru_position;
+	};
+
+	void subscribe(const entry_ptr &e);
+	void unsubscribe(const entry_ptr &e, int group_id);
+
+	void read_complete(const entry_ptr &e, const std::shared_ptr<read_result_entry> &data);
+
+	void on_notify(const entry_ptr &e, int group_id, const callback_result_entry &entry);
+	void on_subscription_complete(const entry_ptr &e, int group_id, bool timed_out);
+
+	// must be called with m_lock held, does not remove subscriptions
+	void erase_nolock(const entry_ptr &e);
+	void drop(const entry_ptr &e);
+
+	const size_t m_max_size;
+	const long m_ttl_ms;
+
+	std::atomic<uint64_t> m_hits;
+
+	std::mutex m_lock;
+	size_t m_size;
+	entry_map m_entries;
+	std::list<entry_ptr> m_lru;
+};
+
+}} // namespace ioremap::elliptics
+
+#endif // __CPP_NEAR_CACHE_HPP
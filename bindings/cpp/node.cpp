@@ -19,6 +19,7 @@
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #include "node_p.hpp"
@@ -118,6 +119,21 @@ void node::add_remote(const std::vector<address> &addrs)
 	}
 }
 
+void node::add_remote(const std::vector<address> &addrs, const std::function<void (const error_info &)> &ready)
+{
+	if (!m_data)
+		throw_error(-EINVAL, "Failed to add remote addr to null node");
+
+	// node's copy keeps it alive until all connections are completed
+	node self(*this);
+	std::thread([self, addrs, ready] () {
+		int err = dnet_add_state(self.m_data->node_ptr, reinterpret_cast<const dnet_addr *>(addrs.data()), addrs.size(), 0);
+
+		if (ready)
+			ready(err < 0 ? create_error(err, "Failed to add remote %zd addrs", addrs.size()) : error_info());
+	}).detach();
+}
+
 void node::set_timeouts(const int wait_timeout, const int check_timeout)
 {
 	if (m_data)
@@ -130,6 +146,17 @@ void node::set_keepalive(int idle, int cnt, int interval)
 		dnet_set_keepalive(m_data->node_ptr, idle, cnt, interval);
 }
 
+void node::set_retry_budget(int percent)
+{
+	if (m_data)
+		dnet_node_set_retry_budget(m_data->node_ptr, percent);
+}
+
+int node::get_retry_budget() const
+{
+	return m_data ? dnet_node_get_retry_budget(m_data->node_ptr) : 0;
+}
+
 logger &node::get_log() const
 {
 	return m_data->log;
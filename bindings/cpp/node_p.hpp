@@ -37,6 +37,12 @@ class node_data {
 		bool			destroy_node;
 };
 
+class read_collapser;
+class read_batcher;
+class near_cache;
+class erasure_code;
+class read_repairer;
+
 class session_data
 {
 	public:
@@ -45,12 +51,36 @@ class session_data
 		session_data(session_data &other);
 		~session_data();
 
-		struct dnet_session	*session_ptr;
+		/*
+		 * dnet_session is shared by clones until any of them changes it, so that clone of the session
+		 * does not copy its groups and namespace. It must be changed only through native_mutable().
+		 */
+		dnet_session *native() const {
+			return session_ptr.get();
+		}
+		dnet_session *native_mutable();
+
+		std::shared_ptr<dnet_session>	session_ptr;
 		elliptics::logger	logger;
 		result_filter		filter;
 		result_checker		checker;
 		result_error_handler	error_handler;
 		uint32_t		policy;
+		bool			quorum_completion;
+		bool			primary_replication;
+		result_error_handler	background_error_handler;
+		bool			speculative_latest;
+		uint64_t		prefetch_hint;
+		// shared by clones, NULL if read collapsing is disabled
+		std::shared_ptr<read_collapser> collapser;
+		// shared by clones, NULL if read batching is disabled
+		std::shared_ptr<read_batcher> batcher;
+		// shared by clones, NULL if near cache is disabled
+		std::shared_ptr<near_cache> near;
+		// shared by clones, NULL if erasure coding is disabled
+		std::shared_ptr<erasure_code> erasure;
+		// shared by clones, NULL if read-repair is disabled
+		std::shared_ptr<read_repairer> repairer;
 };
 
 }} // namespace ioremap::elliptics
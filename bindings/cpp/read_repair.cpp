@@ -0,0 +1,132 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "read_repair.hpp"
+#include "callback_p.h"
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+namespace ioremap { namespace elliptics {
+
+read_repairer::read_repairer(uint64_t rate_keys) :
+	m_rate_keys(rate_keys),
+	m_tokens(rate_keys),
+	m_refilled(clock::now())
+{
+}
+
+static bool is_valid_lookup(const lookup_result_entry &entry)
+{
+	return entry.status() == 0 && entry.data().size() > sizeof(dnet_file_info);
+}
+
+void read_repairer::check(const session &sess, const key &id, const std::vector<lookup_result_entry> &lookups)
+{
+	if (lookups.empty() || !is_valid_lookup(lookups.front()))
+		return;
+
+	const int latest_group = lookups.front().command()->id.group_id;
+	const dnet_time &latest = lookups.front().file_info()->mtime;
+	std::vector<int> groups;
+
+	for (auto it = lookups.begin(); it != lookups.end(); ++it) {
+		const int group_id = it->command()->id.group_id;
+		if (group_id == latest_group)
+			continue;
+
+		if (is_valid_lookup(*it)) {
+			const dnet_time &mtime = it->file_info()->mtime;
+			if (std::make_tuple(mtime.tsec, mtime.tnsec) < std::make_tuple(latest.tsec, latest.tnsec))
+				groups.push_back(group_id);
+		} else if (it->status() == -ENOENT) {
+			groups.push_back(group_id);
+		}
+	}
+
+	if (groups.empty())
+		return;
+
+	std::sort(groups.begin(), groups.end());
+	groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		if (m_in_flight.count(id.raw_id()))
+			return;
+
+		if (!acquire_nolock()) {
+			BH_LOG(sess.get_logger(), DNET_LOG_NOTICE,
+				"read-repair: %s: rate limit is reached, %zu divergent groups are left to recovery",
+				id.to_string(), groups.size());
+			return;
+		}
+
+		m_in_flight.insert(id.raw_id());
+	}
+
+	session repair = sess.clean_clone();
+	repair.set_groups(std::vector<int>(1, latest_group));
+	repair.set_exceptions_policy(session::no_exceptions);
+
+	BH_LOG(sess.get_logger(), DNET_LOG_INFO, "read-repair: %s: copying group %d to %zu divergent groups",
+		id.to_string(), latest_group, groups.size());
+
+	using std::placeholders::_1;
+	using std::placeholders::_2;
+
+	repair.server_send(std::vector<key>(1, id), 0, groups).connect(
+		std::bind(&read_repairer::complete, shared_from_this(), repair, id.raw_id(), groups, _1, _2));
+}
+
+bool read_repairer::acquire_nolock()
+{
+	const clock::time_point now = clock::now();
+	const double elapsed = std::chrono::duration<double>(now - m_refilled).count();
+
+	m_tokens = std::min<double>(m_rate_keys, m_tokens + elapsed * m_rate_keys);
+	m_refilled = now;
+
+	if (m_tokens < 1)
+		return false;
+
+	m_tokens -= 1;
+	return true;
+}
+
+void read_repairer::complete(const session &sess, const dnet_raw_id &id, const std::vector<int> &groups,
+		const std::vector<iterator_result_entry> &results, const error_info &error)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_in_flight.erase(id);
+	}
+
+	int status = error ? error.code() : 0;
+	for (auto it = results.begin(); it != results.end() && !status; ++it) {
+		if (!it->is_ack() && it->reply()->status)
+			status = it->reply()->status;
+	}
+
+	BH_LOG(sess.get_logger(), status ? DNET_LOG_ERROR : DNET_LOG_INFO,
+		"read-repair: %s: %zu groups: %s, status: %d",
+		dnet_dump_id_str(id.id), groups.size(), status ? "failed" : "repaired", status);
+}
+
+}} // namespace ioremap::elliptics
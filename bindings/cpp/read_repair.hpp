@@ -0,0 +1,74 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CPP_READ_REPAIR_HPP
+#define __CPP_READ_REPAIR_HPP
+
+#include "elliptics/session.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <set>
+
+namespace ioremap { namespace elliptics {
+
+/*
+ * Background repair of replicas which read_latest() has found older than the latest one or missing.
+ *
+ * The latest replica is copied to such groups by server_send() from the node holding it. Copy is written
+ * only if remote replica is still older than it, so repair never overwrites data written in the meantime.
+ * At most @rate_keys keys per second are repaired, divergent keys over the limit are left to dnet_recovery.
+ * The key which is being repaired is not repaired once more until the first repair completes.
+ */
+class read_repairer : public std::enable_shared_from_this<read_repairer>
+{
+public:
+	read_repairer(uint64_t rate_keys);
+
+	read_repairer(const read_repairer &) = delete;
+	read_repairer &operator =(const read_repairer &) = delete;
+
+	/*
+	 * Schedules repair of @id if @lookups sorted by prepare_latest() show divergent groups,
+	 * @id must already be transformed
+	 */
+	void check(const session &sess, const key &id, const std::vector<lookup_result_entry> &lookups);
+
+	uint64_t rate_keys() const {
+		return m_rate_keys;
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	// must be called with m_lock held
+	bool acquire_nolock();
+
+	void complete(const session &sess, const dnet_raw_id &id, const std::vector<int> &groups,
+			const std::vector<iterator_result_entry> &results, const error_info &error);
+
+	const uint64_t m_rate_keys;
+
+	std::mutex m_lock;
+	double m_tokens;
+	clock::time_point m_refilled;
+	std::set<dnet_raw_id> m_in_flight;
+};
+
+}} // namespace ioremap::elliptics
+
+#endif // __CPP_READ_REPAIR_HPP
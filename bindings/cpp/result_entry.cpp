@@ -396,6 +396,166 @@ dnet_iterator_response iterator_result_container::operator [](size_t n) const
 	return response;
 }
 
+//
+// Iterator results merger
+//
+
+iterator_result_merger::stream::stream(async_iterator_result &result)
+	: it(result.begin()), started(false), valid(false)
+{
+	memset(&current, 0, sizeof(current));
+}
+
+iterator_result_merger::iterator_result_merger()
+{
+}
+
+void iterator_result_merger::add(async_iterator_result &result)
+{
+	m_streams.emplace_back(std::make_shared<stream>(result));
+	advance(*m_streams.back());
+}
+
+//* Moves \a s to its next key response, previous key is kept to check the order
+void iterator_result_merger::advance(stream &s)
+{
+	const async_iterator_result::iterator end;
+	const bool had_current = s.valid;
+
+	s.valid = false;
+
+	try {
+		if (s.started)
+			++s.it;
+		s.started = true;
+
+		for (; s.it != end; ++s.it) {
+			const iterator_result_entry entry = *s.it;
+
+			if (entry.status()) {
+				s.error = entry.error();
+				return;
+			}
+
+			if (entry.size() < sizeof(dnet_iterator_response) || entry.reply()->status)
+				continue;
+
+			const dnet_iterator_response *re = entry.reply();
+			if (had_current && dnet_id_cmp_str(re->key.id, s.current.key.id) < 0) {
+				s.error = create_error(-EILSEQ, "iterator result is not ordered by key");
+				return;
+			}
+
+			s.current = *re;
+			s.valid = true;
+			return;
+		}
+	} catch (const ioremap::elliptics::error &e) {
+		s.error = error_info(e.error_code(), e.error_message());
+	}
+}
+
+bool iterator_result_merger::next(std::vector<dnet_iterator_response> &responses, std::vector<size_t> &indexes)
+{
+	const dnet_raw_id *min = NULL;
+
+	responses.clear();
+	indexes.clear();
+
+	for (auto it = m_streams.begin(); it != m_streams.end(); ++it) {
+		if ((*it)->valid && (!min || dnet_id_cmp_str((*it)->current.key.id, min->id) < 0))
+			min = &(*it)->current.key;
+	}
+
+	if (!min)
+		return false;
+
+	/* @min points into the stream which is advanced below */
+	const dnet_raw_id key = *min;
+
+	for (size_t i = 0; i < m_streams.size(); ++i) {
+		stream &s = *m_streams[i];
+
+		while (s.valid && !dnet_id_cmp_str(s.current.key.id, key.id)) {
+			responses.push_back(s.current);
+			indexes.push_back(i);
+			advance(s);
+		}
+	}
+
+	return true;
+}
+
+error_info iterator_result_merger::error(size_t index) const
+{
+	if (index >= m_streams.size())
+		return create_error(-EINVAL, "invalid iterator result index: %zu", index);
+
+	return m_streams[index]->error;
+}
+
+//
+// Iterator results columns
+//
+
+iterator_result_columns::iterator_result_columns(async_iterator_result &result)
+	: m_it(result.begin()), m_started(false)
+{
+}
+
+bool iterator_result_columns::next(iterator_result_batch &batch, size_t limit)
+{
+	const async_iterator_result::iterator end;
+
+	if (!limit)
+		throw_error(-EINVAL, "iterator batch size must be positive");
+
+	data_pointer keys = data_pointer::allocate(limit * DNET_ID_SIZE);
+	data_pointer sizes = data_pointer::allocate(limit * sizeof(uint64_t));
+	data_pointer timestamps = data_pointer::allocate(limit * sizeof(int64_t));
+	data_pointer user_flags = data_pointer::allocate(limit * sizeof(uint64_t));
+	data_pointer record_flags = data_pointer::allocate(limit * sizeof(uint64_t));
+
+	size_t count = 0;
+
+	if (m_started && m_it != end)
+		++m_it;
+	m_started = true;
+
+	for (; m_it != end; ++m_it) {
+		const iterator_result_entry entry = *m_it;
+
+		if (entry.status())
+			entry.error().throw_error();
+
+		if (entry.size() < sizeof(dnet_iterator_response) || entry.reply()->status)
+			continue;
+
+		const dnet_iterator_response *re = entry.reply();
+
+		memcpy(keys.data<uint8_t>() + count * DNET_ID_SIZE, re->key.id, DNET_ID_SIZE);
+		sizes.data<uint64_t>()[count] = re->size;
+		timestamps.data<int64_t>()[count] = (int64_t)re->timestamp.tsec * 1000000000LL + re->timestamp.tnsec;
+		user_flags.data<uint64_t>()[count] = re->user_flags;
+		record_flags.data<uint64_t>()[count] = re->flags;
+
+		/* iterator is moved past the last taken response by the next call */
+		if (++count == limit)
+			break;
+	}
+
+	if (!count)
+		return false;
+
+	batch.count = count;
+	batch.keys = keys.slice(0, count * DNET_ID_SIZE);
+	batch.sizes = sizes.slice(0, count * sizeof(uint64_t));
+	batch.timestamps = timestamps.slice(0, count * sizeof(int64_t));
+	batch.user_flags = user_flags.slice(0, count * sizeof(uint64_t));
+	batch.record_flags = record_flags.slice(0, count * sizeof(uint64_t));
+	return true;
+}
+
 backend_status_result_entry::backend_status_result_entry()
 {
 }
@@ -18,11 +18,21 @@
 #include "callback_p.h"
 #include "functional_p.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <sstream>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #include "node_p.hpp"
+#include "near_cache.hpp"
+#include "erasure.hpp"
+#include "read_repair.hpp"
 
 #include "elliptics/async_result_cast.hpp"
 
@@ -347,6 +357,11 @@ void exec_context::set_src_key(int src_key) const
 	}
 }
 
+int exec_context::broadcast_nodes() const
+{
+	return m_data ? m_data->srw_data.data<sph>()->broadcast_nodes : 0;
+}
+
 data_pointer exec_context::native_data() const
 {
 	return m_data ? m_data->srw_data : data_pointer();
@@ -495,13 +510,19 @@ result_error_handler remove_on_fail(const session &sess)
 
 static void create_session_data(session_data &sess, struct dnet_node *node)
 {
-	sess.session_ptr = dnet_session_create(node);
-	if (!sess.session_ptr)
+	dnet_session *native = dnet_session_create(node);
+	if (!native)
 		throw std::bad_alloc();
+	sess.session_ptr.reset(native, dnet_session_destroy);
 	sess.filter = filters::positive;
 	sess.checker = checkers::at_least_one;
 	sess.error_handler = error_handlers::none;
 	sess.policy = session::default_exceptions;
+	sess.quorum_completion = false;
+	sess.primary_replication = false;
+	sess.background_error_handler = error_handlers::none;
+	sess.speculative_latest = false;
+	sess.prefetch_hint = 0;
 }
 
 session_data::session_data(const node &n) : logger(n.get_log(), blackhole::log::attributes_t())
@@ -515,20 +536,43 @@ session_data::session_data(dnet_node *node) : logger(*dnet_node_get_logger(node)
 }
 
 session_data::session_data(session_data &other)
-	: logger(other.logger, blackhole::log::attributes_t()),
+	: session_ptr(other.session_ptr),
+	  logger(other.logger, blackhole::log::attributes_t()),
 	  filter(other.filter),
 	  checker(other.checker),
 	  error_handler(other.error_handler),
-	  policy(other.policy)
+	  policy(other.policy),
+	  quorum_completion(other.quorum_completion),
+	  primary_replication(other.primary_replication),
+	  background_error_handler(other.background_error_handler),
+	  speculative_latest(other.speculative_latest),
+	  prefetch_hint(other.prefetch_hint),
+	  collapser(other.collapser),
+	  batcher(other.batcher),
+	  near(other.near),
+	  erasure(other.erasure),
+	  repairer(other.repairer)
 {
-	session_ptr = dnet_session_copy(other.session_ptr);
-	if (!session_ptr)
-		throw std::bad_alloc();
 }
 
 session_data::~session_data()
 {
-	dnet_session_destroy(session_ptr);
+}
+
+dnet_session *session_data::native_mutable()
+{
+	/*
+	 * Only clones of this session may hold the pointer, and the session is not changed
+	 * by several threads at once, so the count can not grow while it is copied.
+	 */
+	if (session_ptr.use_count() > 1) {
+		dnet_session *native = dnet_session_copy(session_ptr.get());
+		if (!native)
+			throw std::bad_alloc();
+		session_ptr.reset(native, dnet_session_destroy);
+	}
+
+	return session_ptr.get();
 }
 
 session::session(const node &n) : m_data(std::make_shared<session_data>(n))
@@ -563,6 +607,7 @@ session session::clean_clone() const
 	sess.set_filter(filters::all_with_ack);
 	sess.set_checker(checkers::no_check);
 	sess.set_exceptions_policy(session::no_exceptions);
+	sess.set_quorum_completion(false);
 	return sess;
 }
 
@@ -574,14 +619,14 @@ session &session::operator =(const session &other)
 
 void session::set_groups(const std::vector<int> &groups)
 {
-	if (dnet_session_set_groups(m_data->session_ptr, groups.data(), groups.size()))
+	if (dnet_session_set_groups(m_data->native_mutable(), groups.data(), groups.size()))
 		throw std::bad_alloc();
 }
 
 std::vector<int> session::get_groups() const
 {
 	int count = 0;
-	int *groups = dnet_session_get_groups(m_data->session_ptr, &count);
+	int *groups = dnet_session_get_groups(m_data->native(), &count);
 	return std::vector<int>(groups, groups + count);
 }
 
@@ -615,6 +660,60 @@ result_error_handler session::get_error_handler() const
 	return m_data->error_handler;
 }
 
+void session::set_quorum_completion(bool enable, const result_error_handler &background_error_handler)
+{
+	m_data->quorum_completion = enable;
+	m_data->background_error_handler = background_error_handler;
+}
+
+bool session::get_quorum_completion() const
+{
+	return m_data->quorum_completion;
+}
+
+void session::set_primary_replication(bool enable)
+{
+	m_data->primary_replication = enable;
+}
+
+bool session::get_primary_replication() const
+{
+	return m_data->primary_replication;
+}
+
+void session::set_speculative_read_latest(bool enable)
+{
+	m_data->speculative_latest = enable;
+}
+
+bool session::get_speculative_read_latest() const
+{
+	return m_data->speculative_latest;
+}
+
+void session::set_prefetch_hint(uint64_t count)
+{
+	m_data->prefetch_hint = count;
+}
+
+uint64_t session::get_prefetch_hint() const
+{
+	return m_data->prefetch_hint;
+}
+
+void session::set_read_repair(uint64_t rate_keys)
+{
+	if (!rate_keys)
+		m_data->repairer.reset();
+	else
+		m_data->repairer = std::make_shared<read_repairer>(rate_keys);
+}
+
+uint64_t session::get_read_repair() const
+{
+	return m_data->repairer ? m_data->repairer->rate_keys() : 0;
+}
+
 void session::set_exceptions_policy(uint32_t policy)
 {
 	m_data->policy = policy;
@@ -630,7 +729,7 @@ dnet_id session::get_direct_id()
 	if ((get_cflags() & DNET_FLAGS_DIRECT) == 0)
 		throw ioremap::elliptics::error(-EINVAL, "DNET_FLAGS_DIRECT was not set");
 
-	return *dnet_session_get_direct_id(get_native());
+	return *dnet_session_get_direct_id(get_native_shared());
 }
 
 void session::set_direct_id(const address &remote_addr)
@@ -648,17 +747,17 @@ void session::set_direct_id(const address &remote_addr, uint32_t backend_id)
 
 void session::set_cflags(uint64_t cflags)
 {
-	dnet_session_set_cflags(m_data->session_ptr, cflags);
+	dnet_session_set_cflags(m_data->native_mutable(), cflags);
 }
 
 uint64_t session::get_cflags() const
 {
-	return dnet_session_get_cflags(m_data->session_ptr);
+	return dnet_session_get_cflags(m_data->native());
 }
 
 void session::set_ioflags(uint32_t ioflags)
 {
-	dnet_session_set_ioflags(m_data->session_ptr, ioflags);
+	dnet_session_set_ioflags(m_data->native_mutable(), ioflags);
 }
 
 void session::set_namespace(const std::string &ns)
@@ -668,56 +767,233 @@ void session::set_namespace(const std::string &ns)
 
 void session::set_namespace(const char *ns, int nsize)
 {
-	int err = dnet_session_set_ns(m_data->session_ptr, ns, nsize);
+	int err = dnet_session_set_ns(m_data->native_mutable(), ns, nsize);
 	if (err) {
 		throw_error(err, "Could not set namespace '%s'", ns);
 	}
 }
 
+std::string session::get_namespace() const
+{
+	int nsize;
+	const char *ns = dnet_session_get_ns(m_data->native(), &nsize);
+
+	return ns ? std::string(ns, nsize) : std::string();
+}
+
 uint32_t session::get_ioflags() const
 {
-	return dnet_session_get_ioflags(m_data->session_ptr);
+	return dnet_session_get_ioflags(m_data->native());
 }
 
 void session::set_user_flags(uint64_t user_flags)
 {
-	dnet_session_set_user_flags(m_data->session_ptr, user_flags);
+	dnet_session_set_user_flags(m_data->native_mutable(), user_flags);
 }
 
 uint64_t session::get_user_flags() const
 {
-	return dnet_session_get_user_flags(m_data->session_ptr);
+	return dnet_session_get_user_flags(m_data->native());
 }
 
 void session::set_timestamp(const dnet_time &ts)
 {
-	dnet_session_set_timestamp(m_data->session_ptr, &ts);
+	dnet_session_set_timestamp(m_data->native_mutable(), &ts);
 }
 
 void session::set_timestamp(const dnet_time *ts)
 {
-	dnet_session_set_timestamp(m_data->session_ptr, ts);
+	dnet_session_set_timestamp(m_data->native_mutable(), ts);
 }
 
 void session::get_timestamp(dnet_time *ts)
 {
-	dnet_session_get_timestamp(m_data->session_ptr, ts);
+	dnet_session_get_timestamp(m_data->native(), ts);
 }
 
 void session::set_timeout(long timeout)
 {
-	dnet_session_set_timeout(m_data->session_ptr, timeout);
+	dnet_session_set_timeout(m_data->native_mutable(), timeout);
 }
 
 long session::get_timeout(void) const
 {
-	timespec *tm = dnet_session_get_timeout(m_data->session_ptr);
+	timespec *tm = dnet_session_get_timeout(m_data->native());
 	return tm->tv_sec;
 }
 
+void session::set_timeout_ms(long timeout)
+{
+	dnet_session_set_timeout_ms(m_data->native_mutable(), timeout);
+}
+
+long session::get_timeout_ms(void) const
+{
+	timespec *tm = dnet_session_get_timeout(m_data->native());
+	return tm->tv_sec * 1000 + tm->tv_nsec / 1000000;
+}
+
+void session::set_read_collapsing(bool enable)
+{
+	if (!enable)
+		m_data->collapser.reset();
+	else if (!m_data->collapser)
+		m_data->collapser = std::make_shared<read_collapser>();
+}
+
+bool session::get_read_collapsing() const
+{
+	return !!m_data->collapser;
+}
+
+void session::set_near_cache(size_t max_size, long ttl_ms)
+{
+	if (!max_size || ttl_ms <= 0)
+		m_data->near.reset();
+	else
+		m_data->near = std::make_shared<near_cache>(max_size, ttl_ms);
+}
+
+size_t session::get_near_cache_size() const
+{
+	return m_data->near ? m_data->near->max_size() : 0;
+}
+
+uint64_t session::get_near_cache_hits() const
+{
+	return m_data->near ? m_data->near->hits() : 0;
+}
+
+void session::set_erasure_coding(size_t data_chunks, size_t parity_chunks)
+{
+	if (!data_chunks)
+		m_data->erasure.reset();
+	else
+		m_data->erasure = std::make_shared<erasure_code>(data_chunks, parity_chunks);
+}
+
+size_t session::get_erasure_data_chunks() const
+{
+	return m_data->erasure ? m_data->erasure->data_chunks() : 0;
+}
+
+size_t session::get_erasure_parity_chunks() const
+{
+	return m_data->erasure ? m_data->erasure->parity_chunks() : 0;
+}
+
+#define DNET_SESSION_CHECK_ERASURE(RESULT_TYPE) \
+	if (!m_data->erasure) { \
+		RESULT_TYPE result(*this); \
+		async_result_handler<RESULT_TYPE::entry_type> handler(result); \
+		handler.complete(create_error(-EINVAL, id, "erasure coding is not enabled")); \
+		return result; \
+	} else do {} while (false)
+
+async_write_result session::write_erasure(const key &id, const argument_data &data)
+{
+	transform(id);
+	DNET_SESSION_CHECK_ERASURE(async_write_result);
+
+	return erasure_write(*this, m_data->erasure, id, data_pointer::from_raw(const_cast<void *>(data.data()), data.size()));
+}
+
+async_read_result session::read_erasure(const key &id)
+{
+	transform(id);
+	DNET_SESSION_CHECK_ERASURE(async_read_result);
+
+	return erasure_read(*this, m_data->erasure, id);
+}
+
+async_write_result session::recover_erasure(const key &id)
+{
+	transform(id);
+	DNET_SESSION_CHECK_ERASURE(async_write_result);
+
+	return erasure_recover(*this, m_data->erasure, id);
+}
+
+async_remove_result session::remove_erasure(const key &id)
+{
+	transform(id);
+	DNET_SESSION_CHECK_ERASURE(async_remove_result);
+
+	return erasure_remove(*this, m_data->erasure, id);
+}
+
+key session::get_erasure_chunk_key(const key &id, size_t index)
+{
+	transform(id);
+	if (!m_data->erasure)
+		throw_error(-EINVAL, id, "erasure coding is not enabled");
+
+	std::vector<int> groups = get_groups();
+	key chunk = m_data->erasure->chunk_key(*this, id, index);
+	if (!groups.empty())
+		chunk.set_group_id(groups[index % groups.size()]);
+
+	return chunk;
+}
+
+void session::set_hedged_read(int percentile)
+{
+	dnet_session_set_hedged_read(m_data->native_mutable(), percentile);
+}
+
+int session::get_hedged_read() const
+{
+	return dnet_session_get_hedged_read(m_data->native());
+}
+
+void session::set_adaptive_timeout(int percentile, int multiplier, long min_timeout_ms)
+{
+	dnet_session_set_adaptive_timeout(m_data->native_mutable(), percentile, multiplier, min_timeout_ms);
+}
+
+int session::get_adaptive_timeout_percentile() const
+{
+	return dnet_session_get_adaptive_timeout_percentile(m_data->native());
+}
+
+int session::get_adaptive_timeout_multiplier() const
+{
+	return dnet_session_get_adaptive_timeout_multiplier(m_data->native());
+}
+
+long session::get_adaptive_timeout_min_ms() const
+{
+	return dnet_session_get_adaptive_timeout_min_ms(m_data->native());
+}
+
+void session::set_background_rate(uint64_t rate_bytes, uint64_t rate_keys)
+{
+	dnet_session_set_background_rate(m_data->native_mutable(), rate_bytes, rate_keys);
+}
+
+uint64_t session::get_background_rate_bytes() const
+{
+	return dnet_session_get_background_rate_bytes(m_data->native());
+}
+
+uint64_t session::get_background_rate_keys() const
+{
+	return dnet_session_get_background_rate_keys(m_data->native());
+}
+
+void session::set_iterator_threads(uint32_t threads)
+{
+	dnet_session_set_iterator_threads(m_data->native_mutable(), threads);
+}
+
+uint32_t session::get_iterator_threads() const
+{
+	return dnet_session_get_iterator_threads(m_data->native());
+}
+
 void session::set_trace_id(trace_id_t trace_id)
 {
-	dnet_session_set_trace_id(m_data->session_ptr, trace_id);
+	dnet_session_set_trace_id(m_data->native_mutable(), trace_id);
 	blackhole::log::attributes_t attributes = {
 		keyword::request_id() = trace_id
 	};
@@ -726,17 +1002,17 @@ void session::set_trace_id(trace_id_t trace_id)
 
 trace_id_t session::get_trace_id() const
 {
-	return dnet_session_get_trace_id(m_data->session_ptr);
+	return dnet_session_get_trace_id(m_data->native());
 }
 
 void session::set_trace_bit(bool trace)
 {
-	dnet_session_set_trace_bit(m_data->session_ptr, trace);
+	dnet_session_set_trace_bit(m_data->native_mutable(), trace);
 }
 
 bool session::get_trace_bit() const
 {
-	return dnet_session_get_trace_bit(m_data->session_ptr);
+	return dnet_session_get_trace_bit(m_data->native());
 }
 
 class read_handler : public multigroup_handler<read_handler, read_result_entry>
@@ -833,129 +1109,900 @@ private:
 	std::vector<int> m_failed_groups;
 };
 
-async_read_result session::read_data(const key &id, const std::vector<int> &groups, const dnet_io_attr &io, unsigned int cmd)
+/*
+ * Sends read to the first group and, if it has not replied within @delay_ms, to the next one too.
+ * Failed attempt is retried in the next group immediately. The first positive reply wins,
+ * replies of other attempts are dropped. Read-recovery is not performed, since slow group
+ * is not distinguished from the one which does not have the object.
+ */
+class hedged_read_handler : public std::enable_shared_from_this<hedged_read_handler>
 {
-	transform(id);
+public:
+	hedged_read_handler(const session &sess, const async_read_result &result,
+		std::vector<int> &&groups, const dnet_io_control &control, long delay_ms) :
+		m_sess(sess.clean_clone()),
+		m_handler(result),
+		m_groups(std::move(groups)),
+		m_control(control),
+		m_delay_ms(delay_ms),
+		m_next(0),
+		m_outstanding(0),
+		m_winner(-1),
+		m_completed(false)
+	{
+		m_sess.set_checker(sess.get_checker());
+	}
 
-	dnet_io_control control;
-	memset(&control, 0, sizeof(control));
+	void set_total(size_t total)
+	{
+		m_handler.set_total(total);
+	}
 
-	control.fd = -1;
-	control.cmd = cmd;
-	control.cflags = DNET_FLAGS_NEED_ACK;
-	control.id = id.id();
+	void start()
+	{
+		if (m_groups.empty()) {
+			m_handler.complete(error_info());
+			return;
+		}
 
-	memcpy(&control.io, &io, sizeof(dnet_io_attr));
+		std::weak_ptr<hedged_read_handler> *weak = new std::weak_ptr<hedged_read_handler>(shared_from_this());
+		if (dnet_node_schedule_call(m_sess.get_native_node(), m_delay_ms, &hedged_read_handler::on_delay, weak))
+			delete weak;
 
-	async_read_result result(*this);
-	auto handler = std::make_shared<read_handler>(*this, result, std::vector<int>(groups), control);
-	handler->set_total(1);
-	handler->start();
+		dnet_node_retry_budget_deposit(m_sess.get_native_node());
+		send(reserve_next());
+	}
 
-	return result;
-}
+private:
+	static void on_delay(void *priv, int err)
+	{
+		std::weak_ptr<hedged_read_handler> *weak = static_cast<std::weak_ptr<hedged_read_handler> *>(priv);
+		std::shared_ptr<hedged_read_handler> handler = weak->lock();
+		delete weak;
 
-async_read_result session::read_data(const key &id, const std::vector<int> &groups, const dnet_io_attr &io)
-{
-	return read_data(id, groups, io, DNET_CMD_READ);
-}
+		if (!handler || err)
+			return;
 
-async_read_result session::read_data(const key &id, int group, const dnet_io_attr &io)
-{
-	const std::vector<int> groups(1, group);
-	return read_data(id, groups, io);
-}
+		int index;
+		{
+			std::lock_guard<std::mutex> guard(handler->m_lock);
+			if (handler->m_completed || handler->m_winner >= 0 || !handler->retry_allowed())
+				return;
 
-async_read_result session::read_data(const key &id, const std::vector<int> &groups, uint64_t offset, uint64_t size)
-{
-	transform(id);
+			index = handler->reserve_next();
+		}
 
-	dnet_io_attr io;
-	memset(&io, 0, sizeof(io));
+		handler->send(index);
+	}
 
-	io.size   = size;
-	io.offset = offset;
-	io.flags  = get_ioflags();
+	// must be called with m_lock held, withdraws retry from the budget if there is a group left to ask
+	bool retry_allowed()
+	{
+		return m_next < m_groups.size() && !dnet_node_retry_budget_withdraw(m_sess.get_native_node());
+	}
 
-	memcpy(io.id, id.id().id, DNET_ID_SIZE);
-	memcpy(io.parent, id.id().id, DNET_ID_SIZE);
+	// must be called with m_lock held unless there are no attempts in flight, returns -1 if groups are over
+	int reserve_next()
+	{
+		if (m_next >= m_groups.size())
+			return -1;
 
-	return read_data(id, groups, io);
-}
+		++m_outstanding;
+		return m_next++;
+	}
 
-async_read_result session::read_data(const key &id, uint64_t offset, uint64_t size)
-{
-	DNET_SESSION_GET_GROUPS(async_read_result);
+	void send(int index)
+	{
+		using std::placeholders::_1;
 
-	return read_data(id, std::move(groups), offset, size);
-}
+		if (index < 0)
+			return;
 
-// It could be a lambda functor! :`(
-struct read_latest_callback
-{
-	session sess;
-	key id;
-	uint64_t offset;
-	uint64_t size;
-	async_result_handler<read_result_entry> handler;
-	std::vector<int> groups;
+		dnet_io_control control = m_control;
+		control.id.group_id = m_groups[index];
 
-	void operator() (const std::vector<lookup_result_entry> &result, const error_info &error)
+		async_result_cast<read_result_entry>(m_sess, send_to_single_state(m_sess, control)).connect(
+			std::bind(&hedged_read_handler::process, shared_from_this(), index, _1),
+			std::bind(&hedged_read_handler::complete, shared_from_this(), index, _1)
+		);
+	}
+
+	void process(int index, const read_result_entry &entry)
 	{
-		if (error) {
-			handler.complete(error);
-			return;
-		} else if (result.empty()) {
-			handler.complete(create_error(-ENOENT, id, "prepare_latest failed"));
-			return;
-		}
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if (m_completed || (m_winner >= 0 && m_winner != index))
+				return;
 
-		groups.clear();
-		groups.reserve(result.size());
-		for (auto it = result.begin(); it != result.end(); ++it)
-			groups.push_back(it->command()->id.group_id);
+			if (m_winner < 0 && filters::positive(entry))
+				m_winner = index;
+		}
 
-		sess.set_filter(filters::all_with_ack);
-		sess.set_checker(checkers::no_check);
-		sess.read_data(id, groups, offset, size).connect(handler);
+		m_handler.process(entry);
 	}
-};
 
-async_read_result session::read_latest(const key &id, uint64_t offset, uint64_t size)
-{
-	DNET_SESSION_GET_GROUPS(async_read_result);
+	void complete(int index, const error_info &error)
+	{
+		(void) error;
 
-	session sess = clone();
-	sess.set_exceptions_policy(no_exceptions);
-	sess.set_filter(filters::positive);
-	sess.set_checker(checkers::no_check);
+		int next = -1;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			--m_outstanding;
 
-	async_read_result result(*this);
-	read_latest_callback callback = { sess, id, offset, size, result, std::move(groups) };
-	callback.handler.set_total(1);
-	prepare_latest(id, callback.groups).connect(callback);
-	return result;
-}
+			if (m_completed)
+				return;
 
-async_write_result session::write_data(const dnet_io_control &ctl)
-{
-	dnet_io_control ctl_copy = ctl;
+			if (m_winner < 0) {
+				if (retry_allowed())
+					next = reserve_next();
+				if (next < 0 && m_outstanding > 0)
+					return;
+			} else if (m_winner != index) {
+				return;
+			}
 
-	ctl_copy.cmd = DNET_CMD_WRITE;
-	ctl_copy.cflags |= DNET_FLAGS_NEED_ACK;
-	ctl_copy.io.user_flags |= get_user_flags();
+			m_completed = (next < 0);
+		}
 
-	memcpy(ctl_copy.io.id, ctl_copy.id.id, DNET_ID_SIZE);
+		if (next >= 0)
+			send(next);
+		else
+			m_handler.complete(error_info());
+	}
 
-	if (dnet_time_is_empty(&ctl_copy.io.timestamp)) {
-		get_timestamp(&ctl_copy.io.timestamp);
+	session m_sess;
+	async_result_handler<read_result_entry> m_handler;
+	const std::vector<int> m_groups;
+	dnet_io_control m_control;
+	long m_delay_ms;
+
+	std::mutex m_lock;
+	size_t m_next;
+	size_t m_outstanding;
+	int m_winner;
+	bool m_completed;
+};
+
+/*
+ * Attaches concurrent reads of the same key, groups and range to one read.
+ *
+ * The origin read is sent by a clean clone of the first caller's session, its replies are kept
+ * (reads have one data reply per group at most) and passed to every waiter, including those
+ * which have joined after some replies were already received. Every waiter's result applies
+ * filters and checkers of its own session.
+ */
+class read_collapser : public std::enable_shared_from_this<read_collapser>
+{
+public:
+	async_read_result read(session &sess, const key &id, const std::vector<int> &groups, const dnet_io_attr &io)
+	{
+		using std::placeholders::_1;
+
+		request_key request;
+		memcpy(&request.id, id.id().id, DNET_ID_SIZE);
+		request.groups = groups;
+		request.offset = io.offset;
+		request.size = io.size;
+		request.flags = io.flags;
+
+		async_read_result result(sess);
+		async_result_handler<read_result_entry> handler(result);
+		handler.set_total(1);
+
+		std::shared_ptr<inflight_read> read;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			auto it = m_reads.find(request);
+			if (it != m_reads.end()) {
+				for (auto entry = it->second->entries.begin(); entry != it->second->entries.end(); ++entry)
+					handler.process(*entry);
+
+				it->second->waiters.push_back(handler);
+				return result;
+			}
+
+			read = std::make_shared<inflight_read>();
+			read->waiters.push_back(handler);
+			m_reads.insert(std::make_pair(request, read));
+		}
+
+		session origin = sess.clean_clone();
+		origin.set_read_collapsing(false);
+
+		origin.read_data(id, groups, io).connect(
+			std::bind(&read_collapser::process, shared_from_this(), read, _1),
+			std::bind(&read_collapser::complete, shared_from_this(), request, read, _1)
+		);
+
+		return result;
+	}
+
+private:
+	struct request_key {
+		dnet_raw_id		id;
+		std::vector<int>	groups;
+		uint64_t		offset;
+		uint64_t		size;
+		uint64_t		flags;
+
+		bool operator <(const request_key &other) const {
+			int cmp = dnet_id_cmp_str(id.id, other.id.id);
+			if (cmp)
+				return cmp < 0;
+			if (offset != other.offset)
+				return offset < other.offset;
+			if (size != other.size)
+				return size < other.size;
+			if (flags != other.flags)
+				return flags < other.flags;
+			return groups < other.groups;
+		}
+	};
+
+	struct inflight_read {
+		std::vector<read_result_entry> entries;
+		std::vector<async_result_handler<read_result_entry>> waiters;
+	};
+
+	void process(const std::shared_ptr<inflight_read> &read, const read_result_entry &entry)
+	{
+		std::vector<async_result_handler<read_result_entry>> waiters;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			read->entries.push_back(entry);
+			waiters = read->waiters;
+		}
+
+		for (auto it = waiters.begin(); it != waiters.end(); ++it)
+			it->process(entry);
+	}
+
+	void complete(const request_key &request, const std::shared_ptr<inflight_read> &read, const error_info &error)
+	{
+		std::vector<async_result_handler<read_result_entry>> waiters;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			auto it = m_reads.find(request);
+			if (it != m_reads.end() && it->second == read)
+				m_reads.erase(it);
+
+			waiters.swap(read->waiters);
+		}
+
+		for (auto it = waiters.begin(); it != waiters.end(); ++it)
+			it->complete(error);
+	}
+
+	std::mutex m_lock;
+	std::map<request_key, std::shared_ptr<inflight_read>> m_reads;
+};
+
+/*
+ * Coalesces whole-object reads routed to the same backend into bulk reads.
+ *
+ * Read joins the pending batch of its state, backend, groups and flags. Batch is sent by bulk_read()
+ * of a clean clone of its first caller's session when it has got @max_keys keys or @delay_us
+ * microseconds after its first read, whatever happens earlier. When bulk read is completed,
+ * every read's result gets its entries and an ack with the status of its key,
+ * so filters and checkers of the caller's session work as for the plain read.
+ *
+ * Batches are sent by own thread, since transaction timer has too coarse resolution for such delays.
+ */
+class read_batcher
+{
+public:
+	read_batcher(long delay_us, size_t max_keys) :
+		m_delay_us(delay_us),
+		m_max_keys(max_keys),
+		m_stop(false),
+		m_thread(&read_batcher::run, this)
+	{
+	}
+
+	~read_batcher()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		m_thread.join();
+	}
+
+	long delay_us() const
+	{
+		return m_delay_us;
+	}
+
+	static bool is_batchable(const std::vector<int> &groups, const dnet_io_attr &io)
+	{
+		return !groups.empty() && io.offset == 0 && io.size == 0;
+	}
+
+	async_read_result read(session &sess, const key &id, const std::vector<int> &groups, const dnet_io_attr &io)
+	{
+		dnet_id first;
+		dnet_setup_id(&first, groups.front(), id.id().id);
+
+		net_state_id state(sess.get_native_node(), &first);
+		if (!state) {
+			session direct = sess.clone();
+			direct.set_read_batching(0, 0);
+			return direct.read_data(id, groups, io);
+		}
+
+		async_read_result result(sess);
+		async_result_handler<read_result_entry> handler(result);
+		handler.set_total(1);
+
+		batch_key request;
+		request.state = state.operator ->();
+		request.backend = state.backend();
+		request.groups = groups;
+		request.ioflags = io.flags;
+		request.cflags = sess.get_cflags();
+
+		dnet_raw_id raw;
+		memcpy(raw.id, id.id().id, DNET_ID_SIZE);
+
+		std::shared_ptr<batch> ready;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			std::shared_ptr<batch> &current = m_batches[request];
+			if (!current) {
+				current = std::make_shared<batch>();
+				current->origin = std::make_shared<session>(sess.clean_clone());
+				current->origin->set_read_batching(0, 0);
+				current->origin->set_groups(groups);
+				// keeps @request.state alive while batch is pending
+				current->state = std::move(state);
+				current->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(m_delay_us);
+				m_cond.notify_all();
+			}
+
+			auto it = current->reads.find(raw);
+			if (it == current->reads.end()) {
+				it = current->reads.insert(std::make_pair(raw, pending_read())).first;
+				it->second.io = io;
+				memcpy(it->second.io.id, raw.id, DNET_ID_SIZE);
+			}
+			it->second.waiters.push_back(handler);
+
+			if (current->reads.size() >= m_max_keys) {
+				ready = current;
+				m_batches.erase(request);
+			}
+		}
+
+		if (ready)
+			send(ready);
+
+		return result;
+	}
+
+private:
+	struct batch_key {
+		dnet_net_state		*state;
+		int			backend;
+		std::vector<int>	groups;
+		uint64_t		ioflags;
+		uint64_t		cflags;
+
+		bool operator <(const batch_key &other) const {
+			if (state != other.state)
+				return state < other.state;
+			if (backend != other.backend)
+				return backend < other.backend;
+			if (ioflags != other.ioflags)
+				return ioflags < other.ioflags;
+			if (cflags != other.cflags)
+				return cflags < other.cflags;
+			return groups < other.groups;
+		}
+	};
+
+	struct raw_id_less {
+		bool operator ()(const dnet_raw_id &a, const dnet_raw_id &b) const {
+			return dnet_id_cmp_str(a.id, b.id) < 0;
+		}
+	};
+
+	struct pending_read {
+		dnet_io_attr io;
+		std::vector<read_result_entry> entries;
+		std::vector<async_result_handler<read_result_entry>> waiters;
+	};
+
+	struct batch {
+		std::shared_ptr<session> origin;
+		net_state_id state;
+		std::chrono::steady_clock::time_point deadline;
+
+		std::mutex lock;
+		std::map<dnet_raw_id, pending_read, raw_id_less> reads;
+	};
+
+	void run()
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+
+		while (!m_stop) {
+			if (m_batches.empty()) {
+				m_cond.wait(guard);
+				continue;
+			}
+
+			const auto now = std::chrono::steady_clock::now();
+			auto deadline = std::chrono::steady_clock::time_point::max();
+			std::vector<std::shared_ptr<batch>> expired;
+
+			for (auto it = m_batches.begin(); it != m_batches.end();) {
+				if (it->second->deadline <= now) {
+					expired.push_back(it->second);
+					m_batches.erase(it++);
+				} else {
+					deadline = std::min(deadline, it->second->deadline);
+					++it;
+				}
+			}
+
+			if (expired.empty()) {
+				m_cond.wait_until(guard, deadline);
+				continue;
+			}
+
+			guard.unlock();
+			for (auto it = expired.begin(); it != expired.end(); ++it)
+				send(*it);
+			guard.lock();
+		}
+
+		// nobody has to wait for reads queued before batching is disabled
+		std::vector<std::shared_ptr<batch>> rest;
+		for (auto it = m_batches.begin(); it != m_batches.end(); ++it)
+			rest.push_back(it->second);
+		m_batches.clear();
+		guard.unlock();
+
+		for (auto it = rest.begin(); it != rest.end(); ++it)
+			send(*it);
+	}
+
+	static void send(const std::shared_ptr<batch> &b)
+	{
+		using std::placeholders::_1;
+
+		std::vector<dnet_io_attr> ios;
+		ios.reserve(b->reads.size());
+		for (auto it = b->reads.begin(); it != b->reads.end(); ++it)
+			ios.push_back(it->second.io);
+
+		b->origin->bulk_read(ios).connect(
+			std::bind(&read_batcher::process, b, _1),
+			std::bind(&read_batcher::complete, b, _1)
+		);
+	}
+
+	static void process(const std::shared_ptr<batch> &b, const read_result_entry &entry)
+	{
+		if (!filters::positive(entry) || !entry.io_attribute())
+			return;
+
+		dnet_raw_id raw;
+		memcpy(raw.id, entry.io_attribute()->id, DNET_ID_SIZE);
+
+		std::lock_guard<std::mutex> guard(b->lock);
+		auto it = b->reads.find(raw);
+		if (it != b->reads.end())
+			it->second.entries.push_back(entry);
+	}
+
+	static read_result_entry create_ack(const dnet_raw_id &id, int group_id, int status, const read_result_entry *entry)
+	{
+		dnet_cmd cmd;
+		memset(&cmd, 0, sizeof(cmd));
+		memcpy(cmd.id.id, id.id, DNET_ID_SIZE);
+		cmd.id.group_id = group_id;
+		cmd.cmd = DNET_CMD_READ;
+		cmd.status = status;
+		cmd.flags = DNET_FLAGS_REPLY;
+
+		if (entry) {
+			cmd.id.group_id = entry->command()->id.group_id;
+			cmd.backend_id = entry->command()->backend_id;
+			cmd.trans = entry->command()->trans;
+		}
+
+		auto data = std::make_shared<callback_result_data>(entry ? entry->address() : NULL, &cmd);
+		if (status)
+			data->error = create_error(cmd);
+
+		return callback_cast<read_result_entry>(callback_result_entry(data));
+	}
+
+	static void complete(const std::shared_ptr<batch> &b, const error_info &error)
+	{
+		std::lock_guard<std::mutex> guard(b->lock);
+		const int group_id = b->origin->get_groups().front();
+		const int missing = error ? error.code() : -ENOENT;
+
+		for (auto it = b->reads.begin(); it != b->reads.end(); ++it) {
+			pending_read &read = it->second;
+			const read_result_entry ack = read.entries.empty() ?
+				create_ack(it->first, group_id, missing, NULL) :
+				create_ack(it->first, group_id, 0, &read.entries.front());
+
+			for (auto waiter = read.waiters.begin(); waiter != read.waiters.end(); ++waiter) {
+				for (auto entry = read.entries.begin(); entry != read.entries.end(); ++entry)
+					waiter->process(*entry);
+				waiter->process(ack);
+				waiter->complete(error_info());
+			}
+		}
+	}
+
+	const long m_delay_us;
+	const size_t m_max_keys;
+
+	std::mutex m_lock;
+	std::condition_variable m_cond;
+	bool m_stop;
+	std::map<batch_key, std::shared_ptr<batch>> m_batches;
+	std::thread m_thread;
+};
+
+void session::set_read_batching(long delay_us, size_t max_keys)
+{
+	if (delay_us <= 0)
+		m_data->batcher.reset();
+	else
+		m_data->batcher = std::make_shared<read_batcher>(delay_us, max_keys ? max_keys : 1);
+}
+
+long session::get_read_batching_delay() const
+{
+	return m_data->batcher ? m_data->batcher->delay_us() : 0;
+}
+
+async_read_result session::read_data(const key &id, const std::vector<int> &groups, const dnet_io_attr &io, unsigned int cmd)
+{
+	transform(id);
+
+	if (cmd == DNET_CMD_READ && m_data->near && near_cache::is_cacheable(io))
+		return m_data->near->read(*this, id, groups, io);
+
+	if (cmd == DNET_CMD_READ && m_data->collapser)
+		return m_data->collapser->read(*this, id, groups, io);
+
+	if (cmd == DNET_CMD_READ && m_data->batcher && read_batcher::is_batchable(groups, io))
+		return m_data->batcher->read(*this, id, groups, io);
+
+	dnet_io_control control;
+	memset(&control, 0, sizeof(control));
+
+	control.fd = -1;
+	control.cmd = cmd;
+	control.cflags = DNET_FLAGS_NEED_ACK;
+	control.id = id.id();
+
+	memcpy(&control.io, &io, sizeof(dnet_io_attr));
+
+	async_read_result result(*this);
+
+	const int hedge_percentile = get_hedged_read();
+	long latency_us;
+
+	if (hedge_percentile > 0 && cmd == DNET_CMD_READ && groups.size() > 1) {
+		dnet_id first = control.id;
+		first.group_id = groups.front();
+
+		if (!dnet_get_read_latency(get_native_node(), &first, hedge_percentile, &latency_us)) {
+			auto handler = std::make_shared<hedged_read_handler>(*this, result, std::vector<int>(groups),
+					control, std::max(1L, latency_us / 1000));
+			handler->set_total(1);
+			handler->start();
+
+			return result;
+		}
+	}
+
+	auto handler = std::make_shared<read_handler>(*this, result, std::vector<int>(groups), control);
+	handler->set_total(1);
+	handler->start();
+
+	return result;
+}
+
+async_read_result session::read_data(const key &id, const std::vector<int> &groups, const dnet_io_attr &io)
+{
+	return read_data(id, groups, io, DNET_CMD_READ);
+}
+
+async_read_result session::read_data(const key &id, int group, const dnet_io_attr &io)
+{
+	const std::vector<int> groups(1, group);
+	return read_data(id, groups, io);
+}
+
+async_read_result session::read_data(const key &id, const std::vector<int> &groups, uint64_t offset, uint64_t size)
+{
+	transform(id);
+
+	dnet_io_attr io;
+	memset(&io, 0, sizeof(io));
+
+	io.size   = size;
+	io.offset = offset;
+	io.flags  = get_ioflags();
+
+	memcpy(io.id, id.id().id, DNET_ID_SIZE);
+	memcpy(io.parent, id.id().id, DNET_ID_SIZE);
+
+	return read_data(id, groups, io);
+}
+
+async_read_result session::read_data(const key &id, uint64_t offset, uint64_t size)
+{
+	DNET_SESSION_GET_GROUPS(async_read_result);
+
+	return read_data(id, std::move(groups), offset, size);
+}
+
+// It could be a lambda functor! :`(
+struct read_latest_callback
+{
+	session sess;
+	key id;
+	uint64_t offset;
+	uint64_t size;
+	async_result_handler<read_result_entry> handler;
+	std::vector<int> groups;
+	std::shared_ptr<read_repairer> repairer;
+
+	void operator() (const std::vector<lookup_result_entry> &result, const error_info &error)
+	{
+		if (error) {
+			handler.complete(error);
+			return;
+		}
+
+		if (repairer)
+			repairer->check(sess, id, result);
+
+		groups.clear();
+		groups.reserve(result.size());
+		for (auto it = result.begin(); it != result.end(); ++it) {
+			if (filters::positive(*it))
+				groups.push_back(it->command()->id.group_id);
+		}
+
+		if (groups.empty()) {
+			handler.complete(create_error(-ENOENT, id, "prepare_latest failed"));
+			return;
+		}
+
+		sess.set_filter(filters::all_with_ack);
+		sess.set_checker(checkers::no_check);
+		sess.read_data(id, groups, offset, size).connect(handler);
+	}
+};
+
+/*
+ * Lookup of all groups and read of the first one are sent at once, read's result is used
+ * if lookup shows that its group has the latest data, otherwise the latest groups are read again.
+ */
+class speculative_latest_reader : public std::enable_shared_from_this<speculative_latest_reader>
+{
+public:
+	speculative_latest_reader(const session &sess, const key &id, uint64_t offset, uint64_t size,
+			const async_result_handler<read_result_entry> &handler, int expected_group,
+			const std::shared_ptr<read_repairer> &repairer) :
+		m_sess(sess),
+		m_id(id),
+		m_offset(offset),
+		m_size(size),
+		m_handler(handler),
+		m_expected_group(expected_group),
+		m_repairer(repairer),
+		m_pending(2)
+	{
+	}
+
+	void start(const std::vector<int> &groups)
+	{
+		using std::placeholders::_1;
+		using std::placeholders::_2;
+
+		m_sess.read_data(m_id, std::vector<int>(1, m_expected_group), m_offset, m_size).connect(
+			std::bind(&speculative_latest_reader::read_completed, shared_from_this(), _1, _2));
+		m_sess.prepare_latest(m_id, groups).connect(
+			std::bind(&speculative_latest_reader::lookup_completed, shared_from_this(), _1, _2));
+	}
+
+private:
+	void read_completed(const std::vector<read_result_entry> &results, const error_info &error)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_read = results;
+		m_read_error = error;
+		finish(guard);
+	}
+
+	void lookup_completed(const std::vector<lookup_result_entry> &results, const error_info &error)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_lookup = results;
+		m_lookup_error = error;
+		finish(guard);
+	}
+
+	static bool is_valid(const lookup_result_entry &entry)
+	{
+		return entry.status() == 0 && entry.data().size() > sizeof(dnet_file_info);
+	}
+
+	// expected group is the latest if its record is not older than the first, freshest one
+	bool is_expected_latest() const
+	{
+		if (m_read_error || m_lookup.empty() || !is_valid(m_lookup.front()))
+			return false;
+
+		const dnet_time &latest = m_lookup.front().file_info()->mtime;
+		for (auto it = m_lookup.begin(); it != m_lookup.end(); ++it) {
+			if ((int)it->command()->id.group_id != m_expected_group)
+				continue;
+
+			if (!is_valid(*it))
+				return false;
+
+			const dnet_time &mtime = it->file_info()->mtime;
+			return mtime.tsec == latest.tsec && mtime.tnsec == latest.tnsec;
+		}
+
+		return false;
+	}
+
+	void finish(std::unique_lock<std::mutex> &guard)
+	{
+		if (--m_pending > 0)
+			return;
+		guard.unlock();
+
+		if (m_lookup_error) {
+			m_handler.complete(m_lookup_error);
+			return;
+		} else if (m_lookup.empty()) {
+			m_handler.complete(create_error(-ENOENT, m_id, "prepare_latest failed"));
+			return;
+		}
+
+		if (m_repairer)
+			m_repairer->check(m_sess, m_id, m_lookup);
+
+		if (is_expected_latest()) {
+			for (auto it = m_read.begin(); it != m_read.end(); ++it)
+				m_handler.process(*it);
+			m_handler.complete(m_read_error);
+			return;
+		}
+
+		std::vector<int> groups;
+		groups.reserve(m_lookup.size());
+		for (auto it = m_lookup.begin(); it != m_lookup.end(); ++it) {
+			if (filters::positive(*it))
+				groups.push_back(it->command()->id.group_id);
+		}
+
+		if (groups.empty()) {
+			m_handler.complete(create_error(-ENOENT, m_id, "prepare_latest failed"));
+			return;
+		}
+
+		m_sess.read_data(m_id, groups, m_offset, m_size).connect(m_handler);
+	}
+
+	session m_sess;
+	key m_id;
+	uint64_t m_offset;
+	uint64_t m_size;
+	async_result_handler<read_result_entry> m_handler;
+	int m_expected_group;
+	std::shared_ptr<read_repairer> m_repairer;
+
+	std::mutex m_lock;
+	int m_pending;
+	std::vector<read_result_entry> m_read;
+	error_info m_read_error;
+	std::vector<lookup_result_entry> m_lookup;
+	error_info m_lookup_error;
+};
+
+async_read_result session::read_latest(const key &id, uint64_t offset, uint64_t size)
+{
+	DNET_SESSION_GET_GROUPS(async_read_result);
+
+	if (m_data->speculative_latest) {
+		session sess = clone();
+		sess.set_exceptions_policy(no_exceptions);
+		sess.set_filter(filters::all_with_ack);
+		sess.set_checker(checkers::no_check);
+
+		async_read_result result(*this);
+		async_result_handler<read_result_entry> handler(result);
+		handler.set_total(1);
+
+		auto reader = std::make_shared<speculative_latest_reader>(sess, id, offset, size, handler,
+				groups.front(), m_data->repairer);
+		reader->start(groups);
+		return result;
+	}
+
+	// negative lookups are needed by read-repair, they are skipped by the callback
+	session sess = clone();
+	sess.set_exceptions_policy(no_exceptions);
+	sess.set_filter(filters::all_with_ack);
+	sess.set_checker(checkers::no_check);
+
+	async_read_result result(*this);
+	read_latest_callback callback = { sess, id, offset, size, result, std::move(groups), m_data->repairer };
+	callback.handler.set_total(1);
+	prepare_latest(id, callback.groups).connect(callback);
+	return result;
+}
+
+// checker which primary applies to acknowledge replicated write, see dnet_replicate_checkers
+static uint32_t replicate_checker(const result_checker &checker)
+{
+	typedef bool (*checker_function)(const std::vector<dnet_cmd> &, size_t);
+
+	if (const checker_function *function = checker.target<checker_function>()) {
+		if (*function == checkers::at_least_one)
+			return DNET_REPLICATE_CHECKER_AT_LEAST_ONE;
+		if (*function == checkers::quorum)
+			return DNET_REPLICATE_CHECKER_QUORUM;
+	}
+
+	return DNET_REPLICATE_CHECKER_ALL;
+}
+
+async_write_result session::write_data(const dnet_io_control &ctl)
+{
+	dnet_io_control ctl_copy = ctl;
+
+	ctl_copy.cmd = DNET_CMD_WRITE;
+	ctl_copy.cflags |= DNET_FLAGS_NEED_ACK;
+	ctl_copy.io.user_flags |= get_user_flags();
+
+	memcpy(ctl_copy.io.id, ctl_copy.id.id, DNET_ID_SIZE);
+
+	if (dnet_time_is_empty(&ctl_copy.io.timestamp)) {
+		get_timestamp(&ctl_copy.io.timestamp);
 
 		if (dnet_time_is_empty(&ctl_copy.io.timestamp))
 			dnet_current_time(&ctl_copy.io.timestamp);
 	}
 
 	session sess = clean_clone();
-	return async_result_cast<write_result_entry>(*this, send_to_groups(sess, ctl_copy));
+	std::vector<int> groups;
+
+	// only plain in-memory data can be prefixed by replication header
+	if (m_data->primary_replication && ctl_copy.fd < 0 && !ctl_copy.iovcnt && !ctl_copy.data_release)
+		groups = get_groups();
+
+	async_write_result result = async_result_cast<write_result_entry>(*this, groups.size() > 1 ?
+		send_replicated_write(sess, ctl_copy, groups, replicate_checker(m_data->checker)) :
+		send_to_groups(sess, ctl_copy));
+
+	if (m_data->quorum_completion) {
+		async_result_handler<write_result_entry> handler(result);
+		handler.set_quorum_completion(m_data->background_error_handler);
+	}
+
+	return result;
 }
 
 async_write_result session::write_data(const dnet_io_attr &io, const argument_data &file)
@@ -981,105 +2028,307 @@ async_write_result session::write_data(const dnet_io_attr &io, const argument_da
 }
 
 
-async_write_result session::write_data(const key &id, const argument_data &file, uint64_t remote_offset)
+async_write_result session::write_data(const key &id, const argument_data &file, uint64_t remote_offset)
+{
+	transform(id);
+
+	dnet_io_control ctl;
+
+	memset(&ctl, 0, sizeof(ctl));
+	dnet_empty_time(&ctl.io.timestamp);
+
+	ctl.cflags = get_cflags();
+	ctl.data = file.data();
+
+	ctl.io.flags = get_ioflags();
+	ctl.io.user_flags = get_user_flags();
+	ctl.io.offset = remote_offset;
+	ctl.io.size = file.size();
+
+	ctl.id = id.id();
+
+	ctl.fd = -1;
+
+	return write_data(ctl);
+}
+
+/*
+ * Keeps data segments alive while transactions reference them,
+ * every transaction holds its own reference, see dnet_io_control.data_acquire
+ */
+struct data_segments_reference
+{
+	data_segments_reference(const std::vector<data_pointer> &segments) : segments(segments), refs(1)
+	{
+	}
+
+	static void acquire(void *priv)
+	{
+		++static_cast<data_segments_reference *>(priv)->refs;
+	}
+
+	static void release(void *priv)
+	{
+		data_segments_reference *ref = static_cast<data_segments_reference *>(priv);
+		if (--ref->refs == 0)
+			delete ref;
+	}
+
+	std::vector<data_pointer> segments;
+	std::atomic_int refs;
+};
+
+async_write_result session::write_data(const key &id, const std::vector<data_pointer> &segments, uint64_t remote_offset)
 {
 	transform(id);
 
+	data_segments_reference *ref = new data_segments_reference(segments);
+
+	std::vector<iovec> iov;
+	iov.reserve(segments.size());
+
+	uint64_t size = 0;
+	for (auto it = ref->segments.begin(); it != ref->segments.end(); ++it) {
+		if (it->empty())
+			continue;
+
+		iovec segment;
+		segment.iov_base = it->data();
+		segment.iov_len = it->size();
+		iov.push_back(segment);
+
+		size += it->size();
+	}
+
 	dnet_io_control ctl;
 
 	memset(&ctl, 0, sizeof(ctl));
 	dnet_empty_time(&ctl.io.timestamp);
 
 	ctl.cflags = get_cflags();
-	ctl.data = file.data();
+	ctl.iov = iov.data();
+	ctl.iovcnt = iov.size();
+	ctl.data_acquire = data_segments_reference::acquire;
+	ctl.data_release = data_segments_reference::release;
+	ctl.data_priv = ref;
 
 	ctl.io.flags = get_ioflags();
 	ctl.io.user_flags = get_user_flags();
 	ctl.io.offset = remote_offset;
-	ctl.io.size = file.size();
+	ctl.io.size = size;
 
 	ctl.id = id.id();
 
 	ctl.fd = -1;
 
-	return write_data(ctl);
+	async_write_result result = write_data(ctl);
+	data_segments_reference::release(ref);
+	return result;
 }
 
-struct chunk_handler : public std::enable_shared_from_this<chunk_handler> {
-
+/*
+ * Writes object chunk by chunk: prepare with the first chunk, then plain writes of the middle ones
+ * with up to @window of them in flight, and commit with the last chunk after all others are written.
+ * Every chunk is sent only to groups which have successfully written all previous ones.
+ */
+class chunk_handler : public std::enable_shared_from_this<chunk_handler>
+{
+public:
 	chunk_handler(const async_write_result::handler &handler, const session &sess,
-			const key &id, const data_pointer &content,
-			const uint64_t &remote_offset, const uint64_t &local_offset,
-			const uint64_t &chunk_size)
-		: handler(handler)
-		, sess(sess.clone())
-		, id (id)
-		, content(content)
-		, remote_offset(remote_offset)
-		, local_offset(local_offset)
-		, chunk_size(chunk_size)
-	{
-		//this->sess.set_filter(filters::all_with_ack);
-	}
-
-	void write_next(const std::vector<write_result_entry> &entries, const error_info &error) {
-		if (error.code() != 0) {
-			handler.complete(error);
-			return;
-		}
+			const dnet_io_control &control, const data_pointer &content,
+			uint64_t chunk_size, size_t window) :
+		m_handler(handler),
+		m_sess(sess.clone()),
+		m_control(control),
+		m_content(content),
+		m_chunk_size(chunk_size),
+		m_window(window ? window : 1),
+		m_next(chunk_size),
+		m_commit_offset((control.io.size - 1) / chunk_size * chunk_size),
+		m_in_flight(0)
+	{
+	}
+
+	void start()
+	{
+		using std::placeholders::_1;
+		using std::placeholders::_2;
+
+		m_sess.write_data(chunk(0, DNET_IO_FLAGS_PREPARE)).connect(
+			std::bind(&chunk_handler::prepared, shared_from_this(), _1, _2));
+	}
+
+private:
+	dnet_io_control chunk(uint64_t offset, uint64_t flags)
+	{
+		dnet_io_control ctl = m_control;
+
+		ctl.io.flags = m_control.io.flags | flags | DNET_IO_FLAGS_PLAIN_WRITE;
+		ctl.io.offset = m_control.io.offset + offset;
+		ctl.io.size = std::min<uint64_t>(m_chunk_size, m_control.io.size - offset);
+		if (flags & (DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_COMMIT))
+			ctl.io.num = m_control.io.offset + m_control.io.size;
+		else
+			ctl.io.num = ctl.io.offset + ctl.io.size;
+
+		if (ctl.fd >= 0)
+			ctl.local_offset = m_control.local_offset + offset;
+		else
+			ctl.data = static_cast<const char *>(m_control.data) + offset;
+
+		return ctl;
+	}
 
+	void update_groups(const std::vector<write_result_entry> &entries)
+	{
 		std::vector<int> groups;
 		for (auto it = entries.begin(); it != entries.end(); ++it) {
-			groups.push_back(it->command()->id.group_id);
-		}
-		sess.set_groups(groups);
-
-		local_offset += chunk_size;
-		if (local_offset + chunk_size >= content.size()) {
-			auto write_content = content.slice(local_offset, content.size() - local_offset);
-			auto awr = sess.write_commit(id, write_content,
-					remote_offset + local_offset,
-					remote_offset + content.size());
-			awr.connect(std::bind(&chunk_handler::finish, shared_from_this(),
-						std::placeholders::_1, std::placeholders::_2));
+			const int group_id = it->command()->id.group_id;
+			if (m_groups.empty() || std::find(m_groups.begin(), m_groups.end(), group_id) != m_groups.end())
+				groups.push_back(group_id);
+		}
+		m_groups.swap(groups);
+	}
+
+	void prepared(const std::vector<write_result_entry> &entries, const error_info &error)
+	{
+		if (error) {
+			m_handler.complete(error);
+			return;
+		}
+
+		std::unique_lock<std::mutex> guard(m_lock);
+		update_groups(entries);
+		send_next(guard);
+	}
+
+	void written(const std::vector<write_result_entry> &entries, const error_info &error)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		--m_in_flight;
+
+		if (error) {
+			if (!m_error)
+				m_error = error;
 		} else {
-			auto write_content = content.slice(local_offset, chunk_size);
-			auto awr = sess.write_plain(id, write_content, remote_offset + local_offset);
-			awr.connect(std::bind(&chunk_handler::write_next, shared_from_this(),
-						std::placeholders::_1, std::placeholders::_2));
+			update_groups(entries);
+			if (m_groups.empty() && !m_error)
+				m_error = create_error(-ENXIO, "chunk write: no group has written all chunks");
+		}
+
+		send_next(guard);
+	}
+
+	// sends chunks which fit the window, @guard is released before sending
+	void send_next(std::unique_lock<std::mutex> &guard)
+	{
+		using std::placeholders::_1;
+		using std::placeholders::_2;
+
+		std::vector<uint64_t> offsets;
+		while (!m_error && m_next < m_commit_offset && m_in_flight < m_window) {
+			offsets.push_back(m_next);
+			m_next += m_chunk_size;
+			++m_in_flight;
+		}
+
+		const bool done = m_in_flight == 0;
+		const error_info error = m_error;
+
+		session sess = m_sess.clone();
+		sess.set_groups(m_groups);
+		guard.unlock();
+
+		if (done) {
+			if (error) {
+				m_handler.complete(error);
+			} else {
+				sess.write_data(chunk(m_commit_offset, DNET_IO_FLAGS_COMMIT)).connect(
+					std::bind(&chunk_handler::finish, shared_from_this(), _1, _2));
+			}
+			return;
+		}
+
+		for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+			sess.write_data(chunk(*it, 0)).connect(
+				std::bind(&chunk_handler::written, shared_from_this(), _1, _2));
 		}
 	}
 
-	void finish(const std::vector<write_result_entry> &entries, const error_info &error) {
+	void finish(const std::vector<write_result_entry> &entries, const error_info &error)
+	{
 		for (auto it = entries.begin(); it != entries.end(); ++it)
-			handler.process(*it);
-		handler.complete(error);
+			m_handler.process(*it);
+		m_handler.complete(error);
 	}
 
-	async_write_result::handler handler;
-	session sess;
+	async_write_result::handler m_handler;
+	session m_sess;
+
+	const dnet_io_control m_control;
+	// keeps data of @m_control alive
+	data_pointer m_content;
+	const uint64_t m_chunk_size;
+	const size_t m_window;
+
+	std::mutex m_lock;
+	std::vector<int> m_groups;
+	uint64_t m_next;
+	const uint64_t m_commit_offset;
+	size_t m_in_flight;
+	error_info m_error;
+};
 
-	key id;
-	data_pointer content;
-	const uint64_t remote_offset;
-	uint64_t local_offset;
-	uint64_t chunk_size;
+async_write_result session::write_data(const dnet_io_control &ctl, uint64_t chunk_size, size_t window)
+{
+	// segmented data is not split into chunks
+	if (ctl.io.size <= chunk_size || chunk_size == 0 || ctl.iovcnt)
+		return write_data(ctl);
 
-};
+	async_write_result res(*this);
+	async_write_result::handler handler(res);
+
+	auto ch = std::make_shared<chunk_handler>(handler, *this, ctl, data_pointer(), chunk_size, window);
+	ch->start();
+
+	return res;
+}
 
 async_write_result session::write_data(const key &id, const data_pointer &file, uint64_t remote_offset, uint64_t chunk_size)
+{
+	return write_data(id, file, remote_offset, chunk_size, 1);
+}
+
+async_write_result session::write_data(const key &id, const data_pointer &file, uint64_t remote_offset,
+		uint64_t chunk_size, size_t window)
 {
 	if (file.size() <= chunk_size || chunk_size == 0)
 		return write_data(id, file, remote_offset);
 
-	data_pointer write_content = file.slice(0, chunk_size);
-	auto awr = write_prepare(id, write_content, remote_offset, remote_offset + file.size());
+	transform(id);
+
+	dnet_io_control ctl;
+
+	memset(&ctl, 0, sizeof(ctl));
+	dnet_empty_time(&ctl.io.timestamp);
+
+	ctl.cflags = get_cflags();
+	ctl.data = file.data();
+
+	ctl.io.flags = get_ioflags();
+	ctl.io.user_flags = get_user_flags();
+	ctl.io.offset = remote_offset;
+	ctl.io.size = file.size();
+
+	ctl.id = id.id();
+
+	ctl.fd = -1;
 
 	async_write_result res(*this);
 	async_write_result::handler handler(res);
 
-	auto ch = std::make_shared<chunk_handler>(handler, *this, id, file, remote_offset, 0, chunk_size);
-	awr.connect(std::bind(&chunk_handler::write_next, ch, std::placeholders::_1, std::placeholders::_2));
+	auto ch = std::make_shared<chunk_handler>(handler, *this, ctl, file, chunk_size, window);
+	ch->start();
 
 	return res;
 }
@@ -1301,6 +2550,76 @@ async_write_result session::write_cas(const key &id, const argument_data &file,
 	return write_data(ctl);
 }
 
+async_write_result session::atomic_update(const key &id, int type, const argument_data &arg,
+		const std::string &filter, const dnet_time *version)
+{
+	transform(id);
+
+	dnet_id raw = id.id();
+
+	const size_t name_size = (type == DNET_ATOMIC_FILTER) ? filter.size() + 1 : 0;
+	data_buffer buffer(sizeof(dnet_atomic_update) + name_size + arg.size());
+
+	dnet_atomic_update update;
+	memset(&update, 0, sizeof(update));
+	update.type = type;
+	if (version) {
+		update.flags |= DNET_ATOMIC_FLAGS_IF_VERSION;
+		update.version = *version;
+	}
+	/* name is sent only for filters, it includes trailing null-byte */
+	update.name_size = name_size;
+	update.arg_size = arg.size();
+	dnet_convert_atomic_update(&update);
+
+	buffer.write(update);
+	if (name_size)
+		buffer.write(filter.c_str(), name_size);
+	buffer.write(arg.data(), arg.size());
+
+	data_pointer request(std::move(buffer));
+
+	dnet_io_control ctl;
+	memset(&ctl, 0, sizeof(ctl));
+
+	ctl.cflags = get_cflags();
+	ctl.data = request.data();
+
+	ctl.io.flags = get_ioflags();
+	ctl.io.size = request.size();
+
+	memcpy(&ctl.id, &raw, sizeof(dnet_id));
+	ctl.fd = -1;
+
+	ctl.cmd = DNET_CMD_ATOMIC_UPDATE;
+	ctl.cflags |= DNET_FLAGS_NEED_ACK;
+	ctl.io.user_flags = get_user_flags();
+	memcpy(ctl.io.id, ctl.id.id, DNET_ID_SIZE);
+
+	get_timestamp(&ctl.io.timestamp);
+	if (dnet_time_is_empty(&ctl.io.timestamp))
+		dnet_current_time(&ctl.io.timestamp);
+
+	session sess = clean_clone();
+	return async_result_cast<write_result_entry>(*this, send_to_groups(sess, ctl));
+}
+
+async_write_result session::atomic_append(const key &id, const argument_data &data, const dnet_time *version)
+{
+	return atomic_update(id, DNET_ATOMIC_APPEND, data, std::string(), version);
+}
+
+async_write_result session::atomic_increment(const key &id, int64_t delta)
+{
+	uint64_t value = dnet_bswap64(static_cast<uint64_t>(delta));
+	return atomic_update(id, DNET_ATOMIC_INCREMENT, data_pointer::from_raw(&value, sizeof(value)));
+}
+
+async_write_result session::atomic_json_merge(const key &id, const argument_data &patch)
+{
+	return atomic_update(id, DNET_ATOMIC_JSON_MERGE, patch);
+}
+
 async_write_result session::write_prepare(const key &id, const argument_data &file, uint64_t remote_offset, uint64_t psize)
 {
 	transform(id);
@@ -1410,7 +2729,7 @@ std::string session::lookup_address(const key &id, int group_id)
 
 	memset(&addr, 0, sizeof(struct dnet_addr));
 
-	int err = dnet_lookup_addr(m_data->session_ptr,
+	int err = dnet_lookup_addr(m_data->native(),
 		id.by_id() ? NULL : id.remote().c_str(),
 		id.by_id() ? 0 : id.remote().size(),
 		id.by_id() ? &id.id() : NULL,
@@ -1431,17 +2750,17 @@ std::string session::lookup_address(const key &id, int group_id)
 
 void session::transform(const std::string &data, dnet_id &id) const
 {
-	dnet_transform(m_data->session_ptr, (void *)data.data(), data.size(), &id);
+	dnet_transform(m_data->native(), (void *)data.data(), data.size(), &id);
 }
 
 void session::transform(const std::string &data, dnet_raw_id &id) const
 {
-	dnet_transform_raw(m_data->session_ptr, (void *)data.data(), data.size(), (char *)id.id, sizeof(id.id));
+	dnet_transform_raw(m_data->native(), (void *)data.data(), data.size(), (char *)id.id, sizeof(id.id));
 }
 
 void session::transform(const data_pointer &data, dnet_id &id) const
 {
-	dnet_transform(m_data->session_ptr, data.data(), data.size(), &id);
+	dnet_transform(m_data->native(), data.data(), data.size(), &id);
 }
 
 void session::transform(const key &id) const
@@ -1449,6 +2768,48 @@ void session::transform(const key &id) const
 	id.transform(*this);
 }
 
+void session::transform(const std::vector<std::string> &data, std::vector<dnet_raw_id> &ids) const
+{
+	std::vector<const void *> src(data.size());
+	std::vector<uint64_t> size(data.size());
+
+	for (size_t i = 0; i < data.size(); ++i) {
+		src[i] = data[i].data();
+		size[i] = data[i].size();
+	}
+
+	ids.resize(data.size());
+	dnet_transform_multi(m_data->native(), src.data(), size.data(), data.size(), ids.data());
+}
+
+void session::transform(const std::vector<key> &keys) const
+{
+	std::vector<const void *> src;
+	std::vector<uint64_t> size;
+	std::vector<const key *> pending;
+	const std::string ns = get_namespace();
+
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		if (!it->need_transform(ns) || it->lookup_transformed(ns))
+			continue;
+
+		src.push_back(it->remote().data());
+		size.push_back(it->remote().size());
+		pending.push_back(&*it);
+	}
+
+	if (pending.empty())
+		return;
+
+	std::vector<dnet_raw_id> ids(pending.size());
+	dnet_transform_multi(m_data->native(), src.data(), size.data(), pending.size(), ids.data());
+
+	for (size_t i = 0; i < pending.size(); ++i) {
+		pending[i]->set_transformed(ns, ids[i]);
+		pending[i]->cache_transformed();
+	}
+}
+
 class lookup_handler : public multigroup_handler<lookup_handler, lookup_result_entry>
 {
 public:
@@ -1744,7 +3105,7 @@ async_remove_result session::remove(const key &id)
 
 	memcpy(&ctl.io.id, id.id().id, DNET_ID_SIZE);
 	memcpy(&ctl.io.parent, id.id().id, DNET_ID_SIZE);
-	ctl.io.flags = dnet_session_get_ioflags(get_native());
+	ctl.io.flags = dnet_session_get_ioflags(get_native_shared());
 
 	ctl.fd = -1;
 
@@ -1771,10 +3132,16 @@ async_monitor_stat_result session::monitor_stat(uint64_t categories)
 }
 
 async_monitor_stat_result session::monitor_stat(const address &addr, uint64_t categories)
+{
+	return monitor_stat(addr, categories, 0);
+}
+
+async_monitor_stat_result session::monitor_stat(const address &addr, uint64_t categories, uint64_t generation)
 {
 	dnet_monitor_stat_request request;
 	memset(&request, 0, sizeof(struct dnet_monitor_stat_request));
 	request.categories = categories;
+	request.generation = generation;
 	dnet_convert_monitor_stat_request(&request);
 
 	transport_control control;
@@ -1789,7 +3156,7 @@ async_monitor_stat_result session::monitor_stat(const address &addr, uint64_t ca
 
 int session::state_num(void)
 {
-	return dnet_state_num(m_data->session_ptr);
+	return dnet_state_num(m_data->native());
 }
 
 async_generic_result session::request_cmd(const transport_control &ctl)
@@ -1837,7 +3204,10 @@ struct backend_status_params
 	 backend_id(id_backend),
 	 command(cmd),
 	 defrag_level(DNET_BACKEND_DEFRAG_FULL),
-	 delay(0)
+	 delay(0),
+	 rate_bytes(0),
+	 rate_keys(0),
+	 cache_size(0)
 	{}
 
 	session &orig_sess;
@@ -1846,26 +3216,48 @@ struct backend_status_params
 	dnet_backend_command command;
 	dnet_backend_defrag_level defrag_level;
 	uint32_t delay;
+	uint64_t rate_bytes;
+	uint64_t rate_keys;
 	std::vector<dnet_raw_id> ids;
+	std::vector<dnet_fault_rule> faults;
+	uint64_t cache_size;
+	std::vector<uint32_t> cache_pages;
 };
 
 static async_backend_control_result update_backend_status(const backend_status_params &params)
 {
-	data_pointer data = data_pointer::allocate(sizeof(dnet_backend_control) + params.ids.size() * sizeof(dnet_raw_id));
+	data_pointer data = data_pointer::allocate(sizeof(dnet_backend_control) + params.ids.size() * sizeof(dnet_raw_id) +
+			params.faults.size() * sizeof(dnet_fault_rule) + params.cache_pages.size() * sizeof(uint32_t));
 	dnet_backend_control *backend_control = data.data<dnet_backend_control>();
 	memset(backend_control, 0, sizeof(dnet_backend_control));
 
 	backend_control->backend_id = params.backend_id;
 	backend_control->command = params.command;
 	backend_control->ids_count = params.ids.size();
+	backend_control->faults_count = params.faults.size();
 	backend_control->defrag_level = params.defrag_level;
 	backend_control->delay = params.delay;
+	backend_control->rate_bytes = params.rate_bytes;
+	backend_control->rate_keys = params.rate_keys;
+	backend_control->cache_size = params.cache_size;
+	backend_control->cache_pages_count = params.cache_pages.size();
 
 	if (!params.ids.empty()) {
 		data_pointer tmp = data.skip<dnet_backend_control>();
 		memcpy(tmp.data(), params.ids.data(), params.ids.size() * sizeof(dnet_raw_id));
 	}
 
+	if (!params.faults.empty()) {
+		data_pointer tmp = data.skip(sizeof(dnet_backend_control) + params.ids.size() * sizeof(dnet_raw_id));
+		memcpy(tmp.data(), params.faults.data(), params.faults.size() * sizeof(dnet_fault_rule));
+	}
+
+	if (!params.cache_pages.empty()) {
+		data_pointer tmp = data.skip(sizeof(dnet_backend_control) + params.ids.size() * sizeof(dnet_raw_id) +
+				params.faults.size() * sizeof(dnet_fault_rule));
+		memcpy(tmp.data(), params.cache_pages.data(), params.cache_pages.size() * sizeof(uint32_t));
+	}
+
 	// We want to set random dnet_id to ensure that we won't occupy all IO threads
 	// by accident control calls for single backend.
 	dnet_id id;
@@ -1896,6 +3288,11 @@ async_backend_control_result session::disable_backend(const address &addr, uint3
 	return update_backend_status(backend_status_params(*this, addr, backend_id, DNET_BACKEND_DISABLE));
 }
 
+async_backend_control_result session::reload_backend(const address &addr, uint32_t backend_id)
+{
+	return update_backend_status(backend_status_params(*this, addr, backend_id, DNET_BACKEND_RELOAD));
+}
+
 async_backend_control_result session::start_defrag(const address &addr, uint32_t backend_id)
 {
 	backend_status_params params(*this, addr, backend_id, DNET_BACKEND_START_DEFRAG);
@@ -1940,6 +3337,32 @@ async_backend_control_result session::set_delay(const address &addr, uint32_t ba
 	return update_backend_status(params);
 }
 
+async_backend_control_result session::set_faults(const address &addr, uint32_t backend_id,
+		const std::vector<dnet_fault_rule> &rules)
+{
+	backend_status_params params(*this, addr, backend_id, DNET_BACKEND_SET_FAULTS);
+	params.faults = rules;
+	return update_backend_status(params);
+}
+
+async_backend_control_result session::set_background_rate(const address &addr, uint32_t backend_id,
+		uint64_t rate_bytes, uint64_t rate_keys)
+{
+	backend_status_params params(*this, addr, backend_id, DNET_BACKEND_SET_RATE);
+	params.rate_bytes = rate_bytes;
+	params.rate_keys = rate_keys;
+	return update_backend_status(params);
+}
+
+async_backend_control_result session::resize_cache(const address &addr, uint32_t backend_id,
+		uint64_t size, const std::vector<uint32_t> &pages_proportions)
+{
+	backend_status_params params(*this, addr, backend_id, DNET_BACKEND_RESIZE_CACHE);
+	params.cache_size = size;
+	params.cache_pages = pages_proportions;
+	return update_backend_status(params);
+}
+
 async_backend_status_result session::request_backends_status(const address &addr)
 {
 	transport_control control;
@@ -2189,7 +3612,7 @@ std::vector<dnet_route_entry> session::get_routes()
 	scoped_trace_id guard(*this);
 	cstyle_scoped_pointer<dnet_route_entry> entries;
 
-	int count = dnet_get_routes(m_data->session_ptr, &entries.data());
+	int count = dnet_get_routes(m_data->native(), &entries.data());
 
 	if (count < 0)
 		return std::vector<dnet_route_entry>();
@@ -2242,7 +3665,7 @@ error_info session::mix_states(const key &id, std::vector<int> &groups)
 
 	dnet_id raw = id.id();
 
-	int num = dnet_mix_states(m_data->session_ptr, &raw, get_ioflags(), &groups_ptr.data());
+	int num = dnet_mix_states(m_data->native(), &raw, get_ioflags(), &groups_ptr.data());
 	if (num < 0)
 		return create_error(num, id, "could not fetch groups, num: %zd, ioflags: %s",
 				groups.size(), dnet_flags_dump_ioflags(get_ioflags()));
@@ -2275,10 +3698,123 @@ async_iterator_result session::start_iterator(const key &id, const std::vector<d
 	req->time_begin = time_begin;
 	req->time_end = time_end;
 	req->range_num = ranges.size();
+	req->rate_bytes = get_background_rate_bytes();
+	req->rate_keys = get_background_rate_keys();
+	req->threads = get_iterator_threads();
+
+	if (ranges_size)
+		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+
+	return iterator(id, data);
+}
+
+async_iterator_result session::start_changes_iterator(const key &id,
+		const std::vector<dnet_iterator_range>& ranges,
+		uint64_t flags, uint64_t since)
+{
+	size_t ranges_size = ranges.size() * sizeof(ranges.front());
+
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size);
+	memset(data.data(), 0, sizeof(dnet_iterator_request));
+
+	auto req = data.data<dnet_iterator_request>();
+
+	req->action = DNET_ITERATOR_ACTION_START;
+	req->itype = DNET_ITYPE_NETWORK;
+	req->flags = flags | DNET_IFLAGS_CHANGES;
+	req->range_num = ranges.size();
+	req->rate_bytes = get_background_rate_bytes();
+	req->rate_keys = get_background_rate_keys();
+	req->changes_since = since;
+
+	if (ranges_size)
+		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+
+	return iterator(id, data);
+}
+
+async_iterator_result session::start_resumable_iterator(const key &id,
+		const std::vector<dnet_iterator_range>& ranges,
+		uint64_t flags,
+		const dnet_time& time_begin, const dnet_time& time_end,
+		const data_pointer &checkpoint)
+{
+	size_t ranges_size = ranges.size() * sizeof(ranges.front());
+
+	if (!checkpoint.empty() && checkpoint.size() != sizeof(dnet_iterator_checkpoint)) {
+		async_iterator_result result(*this);
+		async_result_handler<iterator_result_entry> handler(result);
+		handler.complete(create_error(-EINVAL, "iterator: invalid checkpoint size: %zu", checkpoint.size()));
+		return result;
+	}
+
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size +
+			sizeof(dnet_iterator_checkpoint));
+	memset(data.data(), 0, data.size());
+
+	auto req = data.data<dnet_iterator_request>();
+
+	req->action = DNET_ITERATOR_ACTION_START;
+	req->itype = DNET_ITYPE_NETWORK;
+	req->flags = flags | DNET_IFLAGS_CHECKPOINTS;
+	req->time_begin = time_begin;
+	req->time_end = time_end;
+	req->range_num = ranges.size();
+	req->rate_bytes = get_background_rate_bytes();
+	req->rate_keys = get_background_rate_keys();
+
+	if (ranges_size)
+		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+
+	/* checkpoint is sent as it has been received from the server */
+	if (!checkpoint.empty())
+		memcpy(data.skip(sizeof(dnet_iterator_request) + ranges_size).data(), checkpoint.data(), checkpoint.size());
+
+	return iterator(id, data);
+}
+
+async_iterator_result session::start_filter_iterator(const key &id,
+		const std::vector<dnet_iterator_range>& ranges,
+		const std::string &filter, const data_pointer &arg,
+		uint64_t flags,
+		const dnet_time& time_begin, const dnet_time& time_end)
+{
+	size_t ranges_size = ranges.size() * sizeof(ranges.front());
+	/* filter name with trailing zero is followed by its argument */
+	size_t filter_size = filter.size() + 1 + arg.size();
+
+	if (filter.empty() || filter_size > UINT32_MAX) {
+		async_iterator_result result(*this);
+		async_result_handler<iterator_result_entry> handler(result);
+		handler.complete(create_error(-EINVAL, "iterator: invalid filter: '%s', argument size: %zu",
+					filter.c_str(), arg.size()));
+		return result;
+	}
+
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size + filter_size);
+	memset(data.data(), 0, sizeof(dnet_iterator_request));
+
+	auto req = data.data<dnet_iterator_request>();
+
+	req->action = DNET_ITERATOR_ACTION_START;
+	req->itype = DNET_ITYPE_FILTER;
+	req->flags = flags;
+	req->time_begin = time_begin;
+	req->time_end = time_end;
+	req->range_num = ranges.size();
+	req->rate_bytes = get_background_rate_bytes();
+	req->rate_keys = get_background_rate_keys();
+	req->threads = get_iterator_threads();
+	req->filter_size = filter_size;
 
 	if (ranges_size)
 		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
 
+	char *spec = data.skip(sizeof(dnet_iterator_request) + ranges_size).data<char>();
+	memcpy(spec, filter.c_str(), filter.size() + 1);
+	if (!arg.empty())
+		memcpy(spec + filter.size() + 1, arg.data(), arg.size());
+
 	return iterator(id, data);
 }
 
@@ -2311,6 +3847,9 @@ async_iterator_result session::start_copy_iterator(const key &id,
 	req->range_num = ranges.size();
 	req->group_num = dst_groups.size();
 	req->timeout = get_timeout();
+	req->rate_bytes = get_background_rate_bytes();
+	req->rate_keys = get_background_rate_keys();
+	req->threads = get_iterator_threads();
 
 	if (ranges_size)
 		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
@@ -2402,7 +3941,7 @@ async_iterator_result session::server_send(const std::vector<key> &keys, uint64_
 	for (auto key_it = keys.begin(), id_end = keys.end(); key_it != id_end; ++key_it) {
 		la l;
 
-		err = dnet_lookup_addr(get_native(), NULL, 0, &key_it->id(), local_group, &l.addr, &l.backend_id);
+		err = dnet_lookup_addr(get_native_shared(), NULL, 0, &key_it->id(), local_group, &l.addr, &l.backend_id);
 		if (err != 0) {
 			l.id = key_it->id();
 			l.id.group_id = local_group;
@@ -2455,6 +3994,8 @@ async_iterator_result session::server_send(const std::vector<key> &keys, uint64_
 			req->group_num = groups.size();
 			req->iflags = iflags;
 			req->timeout = get_timeout();
+			req->rate_bytes = get_background_rate_bytes();
+			req->rate_keys = get_background_rate_keys();
 
 			dnet_convert_server_send_request(req);
 
@@ -2489,14 +4030,9 @@ async_iterator_result session::server_send(const std::vector<dnet_raw_id> &ids,
 }
 
 async_iterator_result session::server_send(const std::vector<std::string> &strs, uint64_t iflags, const std::vector<int> &groups)
-{
-	std::vector<key> keys;
-	for (auto s = strs.begin(), send = strs.end(); s != send; ++s) {
-		key k(*s);
-		k.transform(*this);
-
-		keys.emplace_back(k);
-	}
+{
+	std::vector<key> keys(strs.begin(), strs.end());
+	transform(keys);
 
 	return server_send(keys, iflags, groups);
 }
@@ -2533,6 +4069,72 @@ async_exec_result session::exec(const exec_context &tmp_context, const std::stri
 	return request(&id, context);
 }
 
+async_exec_result session::exec_broadcast(const std::string &event, const argument_data &data,
+		const std::string &reducer, int fanout)
+{
+	if (reducer.empty() || reducer.size() >= DNET_EXEC_REDUCER_SIZE || fanout <= 0) {
+		async_exec_result result(*this);
+		async_result_handler<exec_result_entry> handler(result);
+		handler.complete(create_error(-EINVAL, "exec_broadcast: invalid reducer: '%s' or fanout: %d",
+				reducer.c_str(), fanout));
+		return result;
+	}
+
+	const std::vector<int> groups = get_groups();
+	const std::vector<dnet_route_entry> routes = get_routes();
+
+	/* root of the tree is the first node, its id routes the request and replies of its workers */
+	std::vector<dnet_addr> addrs;
+	dnet_id root;
+	memset(&root, 0, sizeof(root));
+
+	for (auto it = routes.begin(); it != routes.end(); ++it) {
+		if (std::find(groups.begin(), groups.end(), it->group_id) == groups.end())
+			continue;
+
+		auto found = std::find_if(addrs.begin(), addrs.end(),
+			[&] (const dnet_addr &addr) { return dnet_addr_equal(&addr, &it->addr); });
+		if (found != addrs.end())
+			continue;
+
+		if (addrs.empty())
+			dnet_setup_id(&root, it->group_id, it->id.id);
+		addrs.push_back(it->addr);
+	}
+
+	if (addrs.empty()) {
+		async_exec_result result(*this);
+		async_result_handler<exec_result_entry> handler(result);
+		handler.complete(create_error(-ENXIO, "exec_broadcast: no nodes in groups of the session"));
+		return result;
+	}
+
+	const size_t subtree = addrs.size() - 1;
+	std::string payload(sizeof(dnet_exec_broadcast) + subtree * sizeof(dnet_addr), '\0');
+
+	dnet_exec_broadcast *header = reinterpret_cast<dnet_exec_broadcast *>(&payload[0]);
+	memcpy(header->reducer, reducer.data(), reducer.size());
+	header->fanout = fanout;
+	header->addr_num = subtree;
+	header->timeout_ms = get_timeout_ms();
+	for (size_t i = 0; i < subtree; ++i) {
+		header->addrs[i] = addrs[i + 1];
+		dnet_convert_addr(&header->addrs[i]);
+	}
+	dnet_convert_exec_broadcast(header);
+
+	payload.append(static_cast<const char *>(data.data()), data.size());
+
+	exec_context context = exec_context_data::create(event, payload);
+
+	sph *s = context.m_data->srw_data.data<sph>();
+	s->flags = DNET_SPH_FLAGS_SRC_BLOCK | DNET_SPH_FLAGS_BROADCAST;
+	s->src_key = -1;
+	memcpy(s->src.id, root.id, sizeof(s->src.id));
+
+	return request(&root, context);
+}
+
 async_push_result session::push(dnet_id *id, const exec_context &tmp_context,
 		const std::string &event, const argument_data &data)
 {
@@ -2746,11 +4348,11 @@ async_read_result session::bulk_read(const std::vector<std::string> &keys)
 
 	ios.reserve(keys.size());
 
-	for (size_t i = 0; i < keys.size(); ++i) {
-		dnet_id id;
+	std::vector<dnet_raw_id> ids;
+	transform(keys, ids);
 
-		transform(keys[i], id);
-		memcpy(io.id, id.id, sizeof(io.id));
+	for (size_t i = 0; i < keys.size(); ++i) {
+		memcpy(io.id, ids[i].id, sizeof(io.id));
 		ios.push_back(io);
 	}
 
@@ -2767,9 +4369,9 @@ async_read_result session::bulk_read(const std::vector<key> &keys)
 
 	ios.reserve(keys.size());
 
-	for (size_t i = 0; i < keys.size(); ++i) {
-		transform(keys[i]);
+	transform(keys);
 
+	for (size_t i = 0; i < keys.size(); ++i) {
 		memcpy(io.id, keys[i].id().id, sizeof(io.id));
 		ios.push_back(io);
 	}
@@ -2777,6 +4379,262 @@ async_read_result session::bulk_read(const std::vector<key> &keys)
 	return bulk_read(ios);
 }
 
+async_read_result session::prefetch(const std::vector<dnet_raw_id> &keys)
+{
+	session sess = clone();
+	sess.set_ioflags(get_ioflags() | DNET_IO_FLAGS_CACHE_PREFETCH);
+
+	std::vector<dnet_io_attr> ios;
+	dnet_io_attr io;
+	memset(&io, 0, sizeof(io));
+
+	io.flags = sess.get_ioflags();
+
+	ios.reserve(keys.size());
+
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		memcpy(io.id, it->id, sizeof(io.id));
+		ios.push_back(io);
+	}
+
+	return sess.bulk_read(ios);
+}
+
+async_read_result session::prefetch(const std::vector<key> &keys)
+{
+	transform(keys);
+
+	std::vector<dnet_raw_id> ids;
+	ids.reserve(keys.size());
+
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+		ids.push_back(it->raw_id());
+
+	return prefetch(ids);
+}
+
+/*
+ * Limits of DNET_CMD_BULK_WRITE sent by bulk_write(), larger keys are written by separate WRITE commands
+ */
+static const size_t bulk_write_max_keys = 256;
+static const size_t bulk_write_max_size = 1024 * 1024;
+static const size_t bulk_write_max_key_size = 64 * 1024;
+
+/*
+ * Packs keys served by the same backend into one DNET_CMD_BULK_WRITE and turns its replies
+ * into write results of every key, as if keys were written one by one.
+ * If file info of written keys is not needed, server replies with statuses of all keys at once,
+ * see DNET_ATTR_BULK_WRITE_STATUSES.
+ */
+class bulk_write_handler : public std::enable_shared_from_this<bulk_write_handler>
+{
+public:
+	bulk_write_handler(const session &sess, const async_write_result &result, bool statuses) :
+		m_sess(sess.clean_clone()), m_handler(result), m_cflags(sess.get_cflags()), m_statuses(statuses),
+		m_pending(1)
+	{
+		m_sess.set_checker(checkers::no_check);
+		m_sess.set_filter(filters::all_with_ack);
+		m_sess.set_exceptions_policy(session::no_exceptions);
+	}
+
+	/*
+	 * @ios are in CPU byte order and are already prepared for writing, @data[i] is written by @ios[i]
+	 */
+	void start(const std::vector<int> &groups, const std::vector<dnet_io_attr> &ios,
+			const std::vector<argument_data> &data)
+	{
+		m_handler.set_total(groups.size() * ios.size());
+
+		/* keys of the same backend are neighbours in id order, the same keys keep their order */
+		std::vector<size_t> order(ios.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+
+		std::stable_sort(order.begin(), order.end(), [&ios] (size_t i1, size_t i2) {
+			return memcmp(ios[i1].id, ios[i2].id, DNET_ID_SIZE) < 0;
+		});
+
+		for (auto it = groups.begin(); it != groups.end(); ++it)
+			send_to_group(*it, order, ios, data);
+
+		finish();
+	}
+
+private:
+	struct chunk
+	{
+		int group_id;
+		bool replied;
+		std::vector<dnet_io_attr> ios;
+		/* keys which have got their replies, used only if server replies for every key */
+		std::vector<bool> done;
+		std::vector<char> request;
+	};
+
+	void send_to_group(int group_id, const std::vector<size_t> &order, const std::vector<dnet_io_attr> &ios,
+			const std::vector<argument_data> &data)
+	{
+		dnet_node *node = m_sess.get_native_node();
+		std::shared_ptr<chunk> current;
+		net_state_id cur;
+
+		for (auto it = order.begin(); it != order.end(); ++it) {
+			const dnet_io_attr &io = ios[*it];
+			const size_t size = sizeof(dnet_io_attr) + io.size;
+
+			dnet_id id;
+			memset(&id, 0, sizeof(id));
+			dnet_setup_id(&id, group_id, io.id);
+
+			net_state_id next(node, &id);
+			if (!next) {
+				add_entry(NULL, group_id, io, -ENXIO);
+				continue;
+			}
+
+			if (!current || !(cur == next) || current->ios.size() >= bulk_write_max_keys ||
+					current->request.size() + size > bulk_write_max_size) {
+				send(current);
+
+				current = std::make_shared<chunk>();
+				current->group_id = group_id;
+				current->replied = false;
+				cur = std::move(next);
+			}
+
+			dnet_io_attr raw = io;
+			dnet_convert_io_attr(&raw);
+
+			const char *raw_data = reinterpret_cast<const char *>(&raw);
+			const char *key_data = reinterpret_cast<const char *>(data[*it].data());
+			current->request.insert(current->request.end(), raw_data, raw_data + sizeof(raw));
+			current->request.insert(current->request.end(), key_data, key_data + io.size);
+			current->ios.push_back(io);
+		}
+
+		send(current);
+	}
+
+	void send(const std::shared_ptr<chunk> &c)
+	{
+		if (!c)
+			return;
+
+		c->done.assign(c->ios.size(), false);
+
+		dnet_id id;
+		memset(&id, 0, sizeof(id));
+		dnet_setup_id(&id, c->group_id, c->ios.front().id);
+
+		transport_control control(id, DNET_CMD_BULK_WRITE,
+			m_cflags | DNET_FLAGS_NEED_ACK | (m_statuses ? DNET_ATTR_BULK_WRITE_STATUSES : 0));
+		control.set_data(c->request.data(), c->request.size());
+
+		++m_pending;
+
+		auto self = shared_from_this();
+		send_to_single_state(m_sess, control).connect(
+			[self, c] (const callback_result_entry &entry) { self->process(*c, entry); },
+			[self, c] (const error_info &error) { self->complete(*c, error); });
+
+		/* request has been copied into the transaction */
+		std::vector<char>().swap(c->request);
+	}
+
+	void process(chunk &c, const callback_result_entry &entry)
+	{
+		const dnet_cmd *cmd = entry.command();
+
+		if (m_statuses) {
+			process_statuses(c, entry);
+			return;
+		}
+
+		/* the final ack of the whole request, keys without replies are failed by complete() */
+		if (cmd->cmd != DNET_CMD_WRITE)
+			return;
+
+		/* server replies for keys in the order they have been packed */
+		for (size_t i = 0; i < c.ios.size(); ++i) {
+			if (!c.done[i] && !memcmp(c.ios[i].id, cmd->id.id, DNET_ID_SIZE)) {
+				c.done[i] = true;
+				m_handler.process(*static_cast<const write_result_entry *>(&entry));
+				break;
+			}
+		}
+	}
+
+	void process_statuses(chunk &c, const callback_result_entry &entry)
+	{
+		const dnet_cmd *cmd = entry.command();
+		if (cmd->status || !(cmd->flags & DNET_FLAGS_MORE) || entry.size() < sizeof(dnet_bulk_write_reply))
+			return;
+
+		dnet_bulk_write_reply reply = *entry.data<dnet_bulk_write_reply>();
+		dnet_convert_bulk_write_reply(&reply);
+
+		if (reply.num != c.ios.size() || entry.size() < sizeof(reply) + reply.num * sizeof(int32_t))
+			return;
+
+		const int32_t *statuses = reinterpret_cast<const int32_t *>(entry.data().data<char>() + sizeof(reply));
+		for (size_t i = 0; i < c.ios.size(); ++i)
+			add_entry(&entry, cmd->id.group_id, c.ios[i], static_cast<int32_t>(dnet_bswap32(statuses[i])));
+
+		c.replied = true;
+	}
+
+	void complete(chunk &c, const error_info &error)
+	{
+		const int status = error ? error.code() : -EPROTO;
+
+		for (size_t i = 0; i < c.ios.size(); ++i) {
+			if (!c.replied && !c.done[i])
+				add_entry(NULL, c.group_id, c.ios[i], status);
+		}
+
+		finish();
+	}
+
+	void add_entry(const callback_result_entry *entry, int group_id, const dnet_io_attr &io, int status)
+	{
+		dnet_cmd cmd;
+		memset(&cmd, 0, sizeof(cmd));
+		dnet_setup_id(&cmd.id, group_id, io.id);
+		cmd.cmd = DNET_CMD_WRITE;
+		cmd.status = status;
+		cmd.flags = DNET_FLAGS_REPLY;
+
+		if (entry) {
+			cmd.backend_id = entry->command()->backend_id;
+			cmd.trans = entry->command()->trans;
+		}
+
+		auto data = std::make_shared<callback_result_data>(entry ? entry->address() : NULL, &cmd);
+		if (status)
+			data->error = create_error(cmd);
+
+		callback_result_entry result(data);
+		m_handler.process(*static_cast<const write_result_entry *>(&result));
+	}
+
+	void finish()
+	{
+		if (--m_pending == 0)
+			m_handler.complete(error_info());
+	}
+
+	session m_sess;
+	async_result_handler<write_result_entry> m_handler;
+	uint64_t m_cflags;
+	bool m_statuses;
+	std::atomic_size_t m_pending;
+};
+
+/*
+ * Keys are written by DNET_CMD_BULK_WRITE requests, one per backend, unless they are large
+ * or session writes them through primary replication or completes on quorum
+ */
 async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, const std::vector<argument_data> &data)
 {
 	if (ios.size() != data.size()) {
@@ -2793,6 +4651,8 @@ async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, con
 	}
 
 	std::vector<async_write_result> results;
+	std::vector<dnet_io_attr> bulk_ios;
+	std::vector<argument_data> bulk_data;
 
 	{
 		session_scope scope(*this);
@@ -2802,32 +4662,254 @@ async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, con
 		set_checker(checkers::no_check);
 		set_exceptions_policy(no_exceptions);
 
+		const bool bulk = !m_data->primary_replication && !m_data->quorum_completion;
+
 		for(size_t i = 0; i < ios.size(); ++i) {
-			results.emplace_back(std::move(write_data(ios[i], data[i])));
+			if (!bulk || data[i].size() > bulk_write_max_key_size) {
+				results.emplace_back(std::move(write_data(ios[i], data[i])));
+				continue;
+			}
+
+			// the same io attribute which write_data() would send
+			dnet_io_attr io = ios[i];
+			io.size = data[i].size();
+			io.flags |= get_ioflags();
+			io.user_flags |= get_user_flags();
+
+			if (dnet_time_is_empty(&io.timestamp)) {
+				get_timestamp(&io.timestamp);
+
+				if (dnet_time_is_empty(&io.timestamp))
+					dnet_current_time(&io.timestamp);
+			}
+
+			bulk_ios.push_back(io);
+			bulk_data.push_back(data[i]);
+		}
+
+		if (!bulk_ios.empty()) {
+			dnet_raw_id id;
+			memcpy(id.id, bulk_ios.front().id, DNET_ID_SIZE);
+
+			async_write_result result(*this);
+
+			std::vector<int> groups;
+			if (error_info error = mix_states(id, groups)) {
+				async_result_handler<write_result_entry> handler(result);
+				handler.complete(error);
+			} else {
+				const bool statuses = get_ioflags() & DNET_IO_FLAGS_WRITE_NO_FILE_INFO;
+				auto handler = std::make_shared<bulk_write_handler>(*this, result, statuses);
+				handler->start(groups, bulk_ios, bulk_data);
+			}
+
+			results.emplace_back(std::move(result));
 		}
 	}
 
 	return aggregated(*this, results.begin(), results.end());
 }
 
-async_remove_result session::bulk_remove(const std::vector<key> &keys)
+/*
+ * Sends DNET_CMD_BULK_REMOVE of keys served by the same backend and turns its reply
+ * into remove result of every key, as if keys were removed one by one
+ */
+class bulk_remove_handler : public std::enable_shared_from_this<bulk_remove_handler>
 {
-	std::vector<async_remove_result> results;
+public:
+	bulk_remove_handler(const session &sess, const async_remove_result &result) :
+		m_sess(sess.clean_clone()), m_handler(result), m_pending(1)
+	{
+		m_sess.set_checker(checkers::no_check);
+		m_sess.set_filter(filters::all_with_ack);
+		m_sess.set_exceptions_policy(session::no_exceptions);
+	}
 
+	void start(const std::vector<int> &groups, const dnet_io_control &control, const std::vector<dnet_io_attr> &ios)
 	{
-		session_scope scope(*this);
+		m_handler.set_total(groups.size() * ios.size());
 
-		// Ensure checkers and filters will work only for aggregated request
-		set_checker(checkers::no_check);
-		set_filter(filters::all_with_ack);
-		set_exceptions_policy(no_exceptions);
+		for (auto it = groups.begin(); it != groups.end(); ++it)
+			send_to_group(*it, control, ios);
+
+		finish();
+	}
+
+private:
+	struct chunk
+	{
+		int group_id;
+		bool replied;
+		std::vector<dnet_io_attr> ios;
+	};
+
+	void send_to_group(int group_id, const dnet_io_control &control, const std::vector<dnet_io_attr> &ios)
+	{
+		dnet_node *node = m_sess.get_native_node();
+		std::shared_ptr<chunk> current;
+		net_state_id cur;
 
-		for(size_t i = 0; i < keys.size(); ++i) {
-			results.emplace_back(std::move(remove(keys[i])));
+		for (auto it = ios.begin(); it != ios.end(); ++it) {
+			dnet_id id;
+			memset(&id, 0, sizeof(id));
+			dnet_setup_id(&id, group_id, it->id);
+
+			net_state_id next(node, &id);
+			if (!next) {
+				add_entry(NULL, group_id, *it, -ENXIO);
+				continue;
+			}
+
+			if (!current || !(cur == next)) {
+				send(control, current);
+
+				current = std::make_shared<chunk>();
+				current->group_id = group_id;
+				current->replied = false;
+				cur = std::move(next);
+			}
+
+			current->ios.push_back(*it);
 		}
+
+		send(control, current);
 	}
 
-	return aggregated(*this, results.begin(), results.end());
+	void send(dnet_io_control control, const std::shared_ptr<chunk> &c)
+	{
+		if (!c)
+			return;
+
+		dnet_setup_id(&control.id, c->group_id, c->ios.front().id);
+		control.data = c->ios.data();
+		control.io.size = c->ios.size() * sizeof(dnet_io_attr);
+
+		++m_pending;
+
+		auto self = shared_from_this();
+		send_to_single_state(m_sess, control).connect(
+			[self, c] (const callback_result_entry &entry) { self->process(*c, entry); },
+			[self, c] (const error_info &error) { self->complete(*c, error); });
+	}
+
+	void process(chunk &c, const callback_result_entry &entry)
+	{
+		const dnet_cmd *cmd = entry.command();
+		if (cmd->status || !(cmd->flags & DNET_FLAGS_MORE) || entry.size() < sizeof(dnet_bulk_remove_reply))
+			return;
+
+		dnet_bulk_remove_reply reply = *entry.data<dnet_bulk_remove_reply>();
+		dnet_convert_bulk_remove_reply(&reply);
+
+		if (reply.num != c.ios.size() || entry.size() < sizeof(reply) + reply.num * sizeof(int32_t))
+			return;
+
+		const int32_t *statuses = reinterpret_cast<const int32_t *>(entry.data().data<char>() + sizeof(reply));
+		for (size_t i = 0; i < c.ios.size(); ++i)
+			add_entry(&entry, cmd->id.group_id, c.ios[i], static_cast<int32_t>(dnet_bswap32(statuses[i])));
+
+		c.replied = true;
+	}
+
+	void complete(chunk &c, const error_info &error)
+	{
+		if (!c.replied) {
+			const int status = error ? error.code() : -EPROTO;
+			for (auto it = c.ios.begin(); it != c.ios.end(); ++it)
+				add_entry(NULL, c.group_id, *it, status);
+		}
+
+		finish();
+	}
+
+	void add_entry(const callback_result_entry *entry, int group_id, const dnet_io_attr &io, int status)
+	{
+		dnet_cmd cmd;
+		memset(&cmd, 0, sizeof(cmd));
+		dnet_setup_id(&cmd.id, group_id, io.id);
+		cmd.cmd = DNET_CMD_DEL;
+		cmd.status = status;
+		cmd.flags = DNET_FLAGS_REPLY;
+
+		if (entry) {
+			cmd.backend_id = entry->command()->backend_id;
+			cmd.trans = entry->command()->trans;
+		}
+
+		auto data = std::make_shared<callback_result_data>(entry ? entry->address() : NULL, &cmd);
+		if (status)
+			data->error = create_error(cmd);
+
+		m_handler.process(callback_result_entry(data));
+	}
+
+	void finish()
+	{
+		if (--m_pending == 0)
+			m_handler.complete(error_info());
+	}
+
+	session m_sess;
+	async_result_handler<remove_result_entry> m_handler;
+	std::atomic_size_t m_pending;
+};
+
+async_remove_result session::bulk_remove(const std::vector<key> &keys)
+{
+	if (keys.empty()) {
+		error_info error = create_error(-EINVAL, "bulk_remove failed: keys list is empty");
+		if (get_exceptions_policy() & throw_at_start) {
+			error.throw_error();
+		} else {
+			async_remove_result result(*this);
+			async_result_handler<remove_result_entry> handler(result);
+			handler.complete(error);
+			return result;
+		}
+	}
+
+	transform(keys);
+
+	dnet_raw_id id;
+	memcpy(id.id, keys[0].id().id, DNET_ID_SIZE);
+
+	DNET_SESSION_GET_GROUPS(async_remove_result);
+
+	std::vector<dnet_io_attr> ios;
+	ios.reserve(keys.size());
+
+	dnet_io_attr io;
+	memset(&io, 0, sizeof(io));
+	io.flags = get_ioflags();
+
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		memcpy(io.id, it->id().id, DNET_ID_SIZE);
+		memcpy(io.parent, it->id().id, DNET_ID_SIZE);
+		ios.push_back(io);
+	}
+
+	/* keys of the same backend are neighbours in id order */
+	std::sort(ios.begin(), ios.end(), io_attr_comparator());
+	ios.erase(std::unique(ios.begin(), ios.end(), [] (const dnet_io_attr &io1, const dnet_io_attr &io2) {
+		return !memcmp(io1.id, io2.id, DNET_ID_SIZE);
+	}), ios.end());
+
+	for (auto it = ios.begin(); it != ios.end(); ++it)
+		dnet_convert_io_attr(&*it);
+
+	dnet_io_control control;
+	memset(&control, 0, sizeof(control));
+
+	control.fd = -1;
+	control.cmd = DNET_CMD_BULK_REMOVE;
+	control.cflags = DNET_FLAGS_NEED_ACK;
+	control.io.flags = get_ioflags();
+
+	async_remove_result result(*this);
+	auto handler = std::make_shared<bulk_remove_handler>(*this, result);
+	handler->start(groups, control, ios);
+
+	return result;
 }
 
 async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, const std::vector<std::string> &data)
@@ -2846,12 +4928,17 @@ logger &session::get_logger() const
 
 dnet_node *session::get_native_node() const
 {
-	return dnet_session_get_node(m_data->session_ptr);
+	return dnet_session_get_node(m_data->native());
 }
 
 dnet_session *session::get_native()
 {
-	return m_data->session_ptr;
+	return m_data->native_mutable();
+}
+
+dnet_session *session::get_native_shared() const
+{
+	return m_data->native();
 }
 
 } } // namespace ioremap::elliptics
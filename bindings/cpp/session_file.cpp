@@ -1,4 +1,7 @@
 #include "elliptics/session.hpp"
+
+#include <deque>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -55,8 +58,78 @@ void session::read_file(const key &id, const std::string &file, uint64_t offset,
 			dnet_dump_id(&id.id()), file, offset, uint64_t(io->size), int(result.command()->status));
 }
 
+void session::read_file(const key &id, const std::string &file, uint64_t offset, uint64_t size,
+				uint64_t chunk_size, size_t window)
+{
+	if (!chunk_size) {
+		read_file(id, file, offset, size);
+		return;
+	}
+
+	transform(id);
+
+	session sess = clone();
+	sess.set_exceptions_policy(throw_at_get);
+
+	if (!size) {
+		lookup_result_entry lookup = sess.lookup(id).get_one();
+		const uint64_t total = lookup.file_info()->size;
+
+		// let the server report reading out of the object
+		if (offset >= total) {
+			read_file(id, file, offset, size);
+			return;
+		}
+
+		size = total - offset;
+	}
+
+	int err;
+
+	file_descriptor fd(open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+	if (fd.fd() < 0) {
+		err = -errno;
+		throw_error(err, id, "Failed to open read completion file: '%s'", file.c_str());
+	}
+
+	// reads are sent in order of offsets, so the oldest one is waited for first
+	std::deque<std::pair<uint64_t, async_read_result>> reads;
+	const uint64_t end = offset + size;
+	uint64_t next = offset;
+
+	if (!window)
+		window = 1;
+
+	while (next < end || !reads.empty()) {
+		while (next < end && reads.size() < window) {
+			const uint64_t chunk = std::min(chunk_size, end - next);
+			reads.emplace_back(next, sess.read_data(id, next, chunk));
+			next += chunk;
+		}
+
+		const uint64_t chunk_offset = reads.front().first;
+		read_result_entry result = reads.front().second.get_one();
+		reads.pop_front();
+
+		err = pwrite(fd.fd(), result.file().data(), result.file().size(), chunk_offset);
+		if (err < 0 || (size_t)err != result.file().size()) {
+			err = err < 0 ? -errno : -EIO;
+			throw_error(err, id, "Failed to write data into completion file: '%s'", file.c_str());
+		}
+	}
+
+	BH_LOG(get_logger(), DNET_LOG_NOTICE, "%s: read completed: file: '%s', offset: %llu, size: %llu, chunk: %llu, window: %zu.",
+			dnet_dump_id(&id.id()), file, offset, size, chunk_size, window);
+}
+
 void session::write_file(const key &id, const std::string &file, uint64_t local_offset,
 				uint64_t offset, uint64_t size)
+{
+	write_file(id, file, local_offset, offset, size, 0, 1);
+}
+
+void session::write_file(const key &id, const std::string &file, uint64_t local_offset,
+				uint64_t offset, uint64_t size, uint64_t chunk_size, size_t window)
 {
 	transform(id);
 
@@ -105,7 +178,7 @@ void session::write_file(const key &id, const std::string &file, uint64_t local_
 	ctl.io.timestamp.tnsec = 0;
 	ctl.id = id.id();
 
-	write_data(ctl).wait();
+	write_data(ctl, chunk_size, window).wait();
 }
 
 }} // namespace ioremap::elliptics
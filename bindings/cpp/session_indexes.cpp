@@ -31,6 +31,7 @@ namespace ioremap { namespace elliptics {
 
 typedef async_result_handler<callback_result_entry> async_update_indexes_handler;
 
+#define DNET_INDEXES_FLAGS_CAPPED_REMOVE_DATA (1<<27)
 #define DNET_INDEXES_FLAGS_CAPPED_COLLECTION (1<<28)
 #define DNET_INDEXES_FLAGS_NOINTERNAL (1 << 29)
 #define DNET_INDEXES_FLAGS_NOUPDATE (1 << 30)
@@ -62,6 +63,25 @@ static void on_update_index_finished(async_update_indexes_handler handler, const
 	handler.complete(error);
 }
 
+/*!
+ * Merges replies of all update requests, statuses of every updated index are reported as separate entries
+ */
+static async_set_indexes_result session_aggregate_indexes_results(session &orig_sess, session &sess,
+		std::list<async_generic_result> &results)
+{
+	auto result = aggregated(sess, results.begin(), results.end());
+
+	async_update_indexes_result final_result(orig_sess);
+
+	async_update_indexes_handler handler(final_result);
+	handler.set_total(result.total());
+
+	result.connect(std::bind(on_update_index_entry, handler, std::placeholders::_1),
+		std::bind(on_update_index_finished, handler, std::placeholders::_1));
+
+	return final_result;
+}
+
 /*!
  * There are several modifying index methods with similiar behaviour.
  * Some of them send requests to 'object's list of indexes', other to
@@ -103,9 +123,11 @@ static async_set_indexes_result session_set_indexes(session &orig_sess, const ke
 	dnet_indexes_transform_object_id(node, &request_id.id(), &indexes_id);
 
 	const bool capped = (flags & DNET_INDEXES_FLAGS_CAPPED_COLLECTION);
+	const bool capped_remove_data = (flags & DNET_INDEXES_FLAGS_CAPPED_REMOVE_DATA);
 	const bool noupdate = (flags & DNET_INDEXES_FLAGS_NOUPDATE);
 	const bool nointernal = (flags & DNET_INDEXES_FLAGS_NOINTERNAL);
-	flags &= ~(DNET_INDEXES_FLAGS_CAPPED_COLLECTION | DNET_INDEXES_FLAGS_NOUPDATE | DNET_INDEXES_FLAGS_NOINTERNAL);
+	flags &= ~(DNET_INDEXES_FLAGS_CAPPED_COLLECTION | DNET_INDEXES_FLAGS_CAPPED_REMOVE_DATA
+		| DNET_INDEXES_FLAGS_NOUPDATE | DNET_INDEXES_FLAGS_NOINTERNAL);
 
 	if (!noupdate) {
 		data_buffer buffer(sizeof(dnet_indexes_request) +
@@ -199,6 +221,8 @@ static async_set_indexes_result session_set_indexes(session &orig_sess, const ke
 			entry->flags = (flags & DNET_INDEXES_FLAGS_UPDATE_ONLY) ? DNET_INDEXES_FLAGS_INTERNAL_INSERT : DNET_INDEXES_FLAGS_INTERNAL_REMOVE;
 			if (capped)
 				entry->flags |= DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION;
+			if (capped_remove_data)
+				entry->flags |= DNET_INDEXES_FLAGS_INTERNAL_CAPPED_REMOVE_DATA;
 
 			control.set_data(data.data(), sizeof(dnet_indexes_request) +
 					sizeof(dnet_indexes_request_entry) + index.data.size());
@@ -217,31 +241,21 @@ static async_set_indexes_result session_set_indexes(session &orig_sess, const ke
 		}
 	}
 
-	auto result = aggregated(sess, results.begin(), results.end());
-
-	async_update_indexes_result final_result(orig_sess);
-
-	async_update_indexes_handler handler(final_result);
-	handler.set_total(result.total());
-
-	result.connect(std::bind(on_update_index_entry, handler, std::placeholders::_1),
-		std::bind(on_update_index_finished, handler, std::placeholders::_1));
-
 	dnet_log(orig_sess.get_native_node(), DNET_LOG_INFO, "%s: key: %s, indexes: %zd",
 			dnet_dump_id(&request_id.id()), request_id.to_string().c_str(), indexes.size());
 
-	return final_result;
+	return session_aggregate_indexes_results(orig_sess, sess, results);
 }
 
 static void session_convert_indexes(session &sess, std::vector<index_entry> &raw_indexes,
 	const std::vector<std::string> &indexes, const std::vector<data_pointer> &datas)
 {
-	dnet_id tmp;
+	std::vector<dnet_raw_id> ids;
+	sess.transform(indexes, ids);
 	raw_indexes.resize(indexes.size());
 
 	for (size_t i = 0; i < indexes.size(); ++i) {
-		sess.transform(indexes[i], tmp);
-		memcpy(raw_indexes[i].index.id, tmp.id, sizeof(tmp.id));
+		raw_indexes[i].index = ids[i];
 		raw_indexes[i].data = datas[i];
 	}
 }
@@ -249,11 +263,7 @@ static void session_convert_indexes(session &sess, std::vector<index_entry> &raw
 static std::vector<dnet_raw_id> session_convert_indexes(session &sess, const std::vector<std::string> &indexes)
 {
 	std::vector<dnet_raw_id> raw_indexes;
-	raw_indexes.resize(indexes.size());
-
-	for (size_t i = 0; i < indexes.size(); ++i) {
-		sess.transform(indexes[i], raw_indexes[i]);
-	}
+	sess.transform(indexes, raw_indexes);
 
 	return std::move(raw_indexes);
 }
@@ -296,6 +306,146 @@ async_set_indexes_result session::update_indexes_internal(const key &id,
 	return update_indexes_internal(id, raw_indexes);
 }
 
+async_set_indexes_result session::bulk_update_indexes(const std::vector<key> &ids,
+		const std::vector<std::vector<index_entry> > &indexes)
+{
+	if (ids.size() != indexes.size())
+		throw_error(-EINVAL, "session::bulk_update_indexes: ids and indexes sizes mismatch");
+
+	const std::vector<int> known_groups = get_groups();
+
+	if (known_groups.empty()) {
+		async_set_indexes_result result(*this);
+		async_result_handler<callback_result_entry> handler(result);
+		handler.complete(create_error(-ENXIO, "session::bulk_update_indexes: groups list is empty"));
+		return result;
+	}
+
+	session sess = clean_clone();
+	dnet_node *node = get_native_node();
+	const int shard_count = dnet_node_get_indexes_shard_count(node);
+
+	std::list<async_generic_result> results;
+
+	struct bulk_table
+	{
+		int shard_id;
+		size_t data_size;
+		std::vector<std::pair<dnet_raw_id, data_pointer> > objects;
+	};
+
+	// objects of the same index share its table if they belong to the same shard
+	std::map<dnet_raw_id, bulk_table, dnet_raw_id_less_than<> > tables;
+
+	for (size_t i = 0; i < ids.size(); ++i) {
+		const key &id = ids[i];
+		transform(id);
+
+		// list of indexes of the object is stored by the object, so it is still updated by its own request
+		results.emplace_back(session_set_indexes(*this, id, indexes[i],
+				DNET_INDEXES_FLAGS_UPDATE_ONLY | DNET_INDEXES_FLAGS_NOINTERNAL));
+
+		dnet_id indexes_id;
+		memset(&indexes_id, 0, sizeof(indexes_id));
+		dnet_indexes_transform_object_id(node, &id.id(), &indexes_id);
+
+		const int shard_id = dnet_indexes_get_shard_id(node, &key(indexes_id).raw_id());
+
+		for (auto it = indexes[i].begin(); it != indexes[i].end(); ++it) {
+			dnet_raw_id table_id;
+			dnet_indexes_transform_index_id(node, &it->index, &table_id, shard_id);
+
+			bulk_table &table = tables[table_id];
+			if (table.objects.empty()) {
+				table.shard_id = shard_id;
+				table.data_size = 0;
+			}
+
+			table.objects.emplace_back(id.raw_id(), it->data);
+			table.data_size += it->data.size();
+		}
+	}
+
+	std::vector<int> groups(1, 0);
+
+	for (auto it = tables.begin(); it != tables.end(); ++it) {
+		const bulk_table &table = it->second;
+
+		data_buffer buffer(sizeof(dnet_indexes_request) +
+				table.objects.size() * sizeof(dnet_indexes_request_entry) + table.data_size);
+
+		dnet_indexes_request request;
+		memset(&request, 0, sizeof(request));
+
+		memcpy(request.id.id, it->first.id, DNET_ID_SIZE);
+		request.flags = DNET_INDEXES_FLAGS_BULK;
+		request.shard_id = table.shard_id;
+		request.shard_count = shard_count;
+		request.entries_count = table.objects.size();
+
+		buffer.write(request);
+
+		dnet_indexes_request_entry entry;
+		memset(&entry, 0, sizeof(entry));
+
+		entry.flags = DNET_INDEXES_FLAGS_INTERNAL_INSERT;
+		entry.shard_id = table.shard_id;
+		entry.shard_count = shard_count;
+
+		for (auto jt = table.objects.begin(); jt != table.objects.end(); ++jt) {
+			entry.id = jt->first;
+			entry.size = jt->second.size();
+
+			buffer.write(entry);
+			if (entry.size > 0) {
+				buffer.write(jt->second.data<char>(), jt->second.size());
+			}
+		}
+
+		data_pointer data(std::move(buffer));
+
+		dnet_id &id = data.data<dnet_indexes_request>()->id;
+
+		transport_control control;
+		control.set_command(DNET_CMD_INDEXES_INTERNAL);
+		control.set_data(data.data(), data.size());
+		control.set_cflags(DNET_FLAGS_NEED_ACK);
+
+		for (size_t i = 0; i < known_groups.size(); ++i) {
+			id.group_id = known_groups[i];
+
+			groups[0] = id.group_id;
+			sess.set_groups(groups);
+
+			control.set_key(id);
+
+			results.emplace_back(send_to_single_state(sess, control));
+		}
+	}
+
+	dnet_log(node, DNET_LOG_INFO, "bulk_update_indexes: objects: %zu, index tables: %zu",
+			ids.size(), tables.size());
+
+	return session_aggregate_indexes_results(*this, sess, results);
+}
+
+async_set_indexes_result session::bulk_update_indexes(const std::vector<key> &ids,
+		const std::vector<std::vector<std::string> > &indexes, const std::vector<std::vector<data_pointer> > &datas)
+{
+	if (ids.size() != indexes.size() || indexes.size() != datas.size())
+		throw_error(-EINVAL, "session::bulk_update_indexes: ids, indexes and datas sizes mismatch");
+
+	std::vector<std::vector<index_entry> > raw_indexes(indexes.size());
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		if (datas[i].size() != indexes[i].size())
+			throw_error(-EINVAL, ids[i], "session::bulk_update_indexes: indexes and datas sizes mismtach");
+
+		session_convert_indexes(*this, raw_indexes[i], indexes[i], datas[i]);
+	}
+
+	return bulk_update_indexes(ids, raw_indexes);
+}
+
 struct state_container
 {
 	state_container() : entries_count(0), failed(false)
@@ -575,92 +725,19 @@ async_set_indexes_result session::update_indexes(const key &id,
 	return update_indexes(id, raw_indexes);
 }
 
-struct add_to_capped_collection_handler : public std::enable_shared_from_this<add_to_capped_collection_handler>
-{
-	add_to_capped_collection_handler(const session &sess, const async_generic_result &result)
-		: sess(sess), handler(result), counter(1)
-	{
-	}
-
-	void on_entry(const callback_result_entry &entry)
-	{
-		if (!entry.error() && entry.size() >= sizeof(dnet_indexes_reply)) {
-			const dnet_indexes_reply *reply = entry.data<dnet_indexes_reply>();
-			for (uint64_t index = 0; index < reply->entries_count; ++index) {
-				const dnet_indexes_reply_entry &entry = reply->entries[index];
-				if (entry.status == DNET_INDEXES_CAPPED_REMOVED) {
-					using std::placeholders::_1;
-
-					++counter;
-
-					sess.remove(entry.id).connect(
-						std::bind(&add_to_capped_collection_handler::on_removed_entry, shared_from_this(), _1),
-						std::bind(&add_to_capped_collection_handler::on_finished, shared_from_this(), _1));
-				}
-			}
-		}
-
-		handler.process(entry);
-	}
-
-	void on_removed_entry(const callback_result_entry &entry)
-	{
-		handler.process(entry);
-	}
-
-	void on_finished(const error_info &error)
-	{
-		if (error) {
-			std::lock_guard<std::mutex> lock(total_error_mutex);
-			total_error = error;
-		}
-
-		if (0 == --counter)
-			handler.complete(total_error);
-	}
-
-	session sess;
-	async_result_handler<callback_result_entry> handler;
-	std::atomic_size_t counter;
-	std::mutex total_error_mutex;
-	error_info total_error;
-};
-
+/*
+ * Server which keeps the index evicts the oldest objects and removes their data if needed,
+ * they are reported by DNET_INDEXES_CAPPED_REMOVED entries of the reply
+ */
 async_generic_result session::add_to_capped_collection(const key &id, const index_entry &index, int limit, bool remove_data)
 {
 	transform(id);
 
-	session sess = *this;
-
-	if (remove_data) {
-		sess = clone();
-		sess.set_filter(filters::all_with_ack);
-		sess.set_checker(checkers::no_check);
-		sess.set_exceptions_policy(no_exceptions);
-	}
-
-	async_generic_result indexes_result = session_set_indexes(sess, id, std::vector<index_entry>(1, index),
-		DNET_INDEXES_FLAGS_CAPPED_COLLECTION | DNET_INDEXES_FLAGS_UPDATE_ONLY, limit);
-
-	if (!remove_data) {
-		return indexes_result;
-	}
-
-	session remove_sess = clone();
-	remove_sess.set_filter(filters::all_with_ack);
-	remove_sess.set_checker(checkers::no_check);
-	remove_sess.set_exceptions_policy(no_exceptions);
-
-	async_generic_result result(*this);
+	uint32_t flags = DNET_INDEXES_FLAGS_CAPPED_COLLECTION | DNET_INDEXES_FLAGS_UPDATE_ONLY;
+	if (remove_data)
+		flags |= DNET_INDEXES_FLAGS_CAPPED_REMOVE_DATA;
 
-	auto handler = std::make_shared<add_to_capped_collection_handler>(remove_sess, result);
-
-	using std::placeholders::_1;
-
-	indexes_result.connect(std::bind(&add_to_capped_collection_handler::on_entry, handler, _1),
-		std::bind(&add_to_capped_collection_handler::on_finished, handler, _1));
-
-	return result;
+	return session_set_indexes(*this, id, std::vector<index_entry>(1, index), flags, limit);
 }
 
 async_set_indexes_result session::remove_indexes(const key &id, const std::vector<dnet_raw_id> &indexes)
@@ -701,13 +778,30 @@ public:
 	};
 
 	find_indexes_handler(const session &sess, const async_generic_result &result, std::vector<int> &&groups,
-		const std::vector<dnet_raw_id> &indexes, bool intersect) :
+		const std::vector<dnet_raw_id> &indexes, bool intersect, uint64_t limit, const std::string &cursor,
+		const std::vector<data_pointer> &ranges, bool read, uint64_t read_size) :
 		parent_type(sess, result, std::move(groups)),
 		m_logger(m_sess.get_logger()),
 		m_intersect(intersect),
 		m_shard_count(dnet_node_get_indexes_shard_count(sess.get_native_node())),
-		m_indexes(indexes)
+		m_indexes(indexes),
+		m_ranges(ranges)
 	{
+		memset(&m_cursor, 0, sizeof(m_cursor));
+		m_cursor.limit = limit;
+		if (!cursor.empty()) {
+			if (cursor.size() != sizeof(m_cursor.id.id))
+				throw_error(-EINVAL, "Invalid find indexes cursor size: %zu", cursor.size());
+
+			memcpy(m_cursor.id.id, cursor.data(), sizeof(m_cursor.id.id));
+			m_cursor.flags |= DNET_INDEXES_CURSOR_AFTER;
+		}
+		m_paginated = limit || !cursor.empty();
+
+		m_read = read;
+		memset(&m_fetch, 0, sizeof(m_fetch));
+		m_fetch.size = read_size;
+
 		m_sess.set_checker(checkers::no_check);
 
 		dnet_node *node = m_sess.get_native_node();
@@ -791,6 +885,10 @@ public:
 			request.flags |= DNET_INDEXES_FLAGS_INTERSECT;
 		else
 			request.flags |= DNET_INDEXES_FLAGS_UNITE;
+		if (m_paginated)
+			request.flags |= DNET_INDEXES_FLAGS_LIMIT;
+		if (m_read)
+			request.flags |= DNET_INDEXES_FLAGS_FETCH;
 
 		dnet_indexes_request_entry entry;
 		memset(&entry, 0, sizeof(entry));
@@ -835,9 +933,21 @@ public:
 
 			for (size_t i = 0; i < m_indexes.size(); ++i) {
 				entry.id = m_id_precalc[it->shard_id * m_indexes.size() + i];
+
+				const bool range = i < m_ranges.size() && !m_ranges[i].empty();
+				entry.flags = range ? DNET_INDEXES_ENTRY_RANGE : 0;
+				entry.size = range ? m_ranges[i].size() : 0;
+
 				buffer.write(entry);
+				if (range)
+					buffer.write(m_ranges[i].data<char>(), m_ranges[i].size());
 			}
 
+			if (m_paginated)
+				buffer.write(m_cursor);
+			if (m_read)
+				buffer.write(m_fetch);
+
 			if (more) {
 				continue;
 			}
@@ -894,13 +1004,35 @@ private:
 	const dnet_logger &m_logger;
 	const bool m_intersect;
 	const int m_shard_count;
+	bool m_paginated;
+	dnet_indexes_find_cursor m_cursor;
+	bool m_read;
+	dnet_indexes_fetch m_fetch;
 	std::set<index_id> m_index_requests_set;
 	id_map m_convert_map;
 	std::vector<dnet_raw_id> m_id_precalc;
 	std::vector<dnet_raw_id> m_indexes;
+	// packed dnet_indexes_range of every index, empty if whole index is requested
+	std::vector<data_pointer> m_ranges;
+};
+
+/*
+ * Objects of the page found by all shards, every shard returns up to limit objects
+ */
+struct find_indexes_page
+{
+	uint64_t limit;
+	// objects are read too, first read_size bytes of every one, 0 means whole object
+	bool read;
+	uint64_t read_size;
+	// objects which follow the page are prefetched into server caches, see session::set_prefetch_hint()
+	uint64_t prefetch;
+	std::mutex lock;
+	std::vector<find_indexes_result_entry> entries;
 };
 
 static void on_find_indexes_process(session sess, std::shared_ptr<find_indexes_handler::id_map> convert_map,
+	std::shared_ptr<find_indexes_page> page,
 	async_result_handler<find_indexes_result_entry> handler, const callback_result_entry &entry)
 {
 	if (!filters::positive(entry))
@@ -927,16 +1059,137 @@ static void on_find_indexes_process(session sess, std::shared_ptr<find_indexes_h
 			id = converted->second;
 		}
 
-		handler.process(entry);
+		if (page) {
+			std::lock_guard<std::mutex> guard(page->lock);
+			page->entries.emplace_back(std::move(entry));
+		} else {
+			handler.process(entry);
+		}
+	}
+}
+
+static bool find_indexes_entry_less_than(const find_indexes_result_entry &entry, const dnet_raw_id &id)
+{
+	return memcmp(entry.id.id, id.id, DNET_ID_SIZE) < 0;
+}
+
+static void on_find_indexes_read_process(std::shared_ptr<find_indexes_page> page, const read_result_entry &entry)
+{
+	if (!filters::positive(entry))
+		return;
+
+	dnet_raw_id id;
+	memcpy(id.id, entry.io_attribute()->id, DNET_ID_SIZE);
+
+	std::lock_guard<std::mutex> guard(page->lock);
+
+	auto it = std::lower_bound(page->entries.begin(), page->entries.end(), id, find_indexes_entry_less_than);
+	if (it != page->entries.end() && it->id == id) {
+		it->status = 0;
+		it->data = entry.file();
 	}
 }
 
-static void on_find_indexes_complete(async_result_handler<find_indexes_result_entry> handler, const error_info &error)
+/*
+ * Failed reads are not errors of the find, such objects are returned with their read status
+ */
+static void on_find_indexes_read_complete(std::shared_ptr<find_indexes_page> page,
+	async_result_handler<find_indexes_result_entry> handler, const error_info &find_error)
+{
+	for (auto it = page->entries.begin(); it != page->entries.end(); ++it)
+		handler.process(*it);
+
+	handler.complete(find_error);
+}
+
+static void on_find_indexes_complete(session sess, std::shared_ptr<find_indexes_page> page,
+	async_result_handler<find_indexes_result_entry> handler, const error_info &error)
 {
+	if (page) {
+		std::vector<find_indexes_result_entry> &entries = page->entries;
+
+		// shards are merged into one page, objects which did not fit are returned by the next one
+		std::stable_sort(entries.begin(), entries.end(), dnet_raw_id_less_than<skip_data>());
+		auto it = std::unique(entries.begin(), entries.end(),
+			[] (const find_indexes_result_entry &first, const find_indexes_result_entry &second) {
+				return first.id == second.id;
+			});
+		entries.erase(it, entries.end());
+
+		// objects beyond the limit will likely be returned by the next page, it is not waited for
+		if (page->prefetch) {
+			const size_t begin = std::min<size_t>(page->limit, entries.size());
+			const size_t end = std::min<size_t>(begin + page->prefetch, entries.size());
+
+			std::vector<dnet_raw_id> ids;
+			for (size_t i = begin; i < end; ++i)
+				ids.push_back(entries[i].id);
+
+			if (!ids.empty()) {
+				session prefetch_sess = sess.clean_clone();
+				prefetch_sess.set_exceptions_policy(session::no_exceptions);
+				prefetch_sess.set_filter(filters::all_with_ack);
+				prefetch_sess.prefetch(ids);
+			}
+		}
+
+		if (page->limit && entries.size() > page->limit)
+			entries.resize(page->limit);
+
+		/*
+		 * Servers read only objects which are stored by backends of their indexes,
+		 * the rest are read by one bulk request
+		 */
+		std::vector<dnet_io_attr> ios;
+		if (page->read) {
+			dnet_io_attr io;
+			memset(&io, 0, sizeof(io));
+			io.flags = sess.get_ioflags();
+			io.size = page->read_size;
+
+			for (auto jt = entries.begin(); jt != entries.end(); ++jt) {
+				if (jt->status != -ENOENT)
+					continue;
+
+				memcpy(io.id, jt->id.id, DNET_ID_SIZE);
+				ios.push_back(io);
+			}
+		}
+
+		if (!ios.empty()) {
+			using namespace std::placeholders;
+
+			sess.clean_clone().bulk_read(ios).connect(std::bind(on_find_indexes_read_process, page, _1),
+				std::bind(on_find_indexes_read_complete, page, handler, error));
+			return;
+		}
+
+		for (auto jt = entries.begin(); jt != entries.end(); ++jt)
+			handler.process(*jt);
+	}
+
 	handler.complete(error);
 }
 
 async_find_indexes_result session::find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect)
+{
+	return find_indexes_internal(indexes, intersect, 0, std::string());
+}
+
+async_find_indexes_result session::find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+	uint64_t limit, const std::string &cursor)
+{
+	return find_indexes_internal(indexes, intersect, limit, cursor, std::vector<data_pointer>());
+}
+
+async_find_indexes_result session::find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+	uint64_t limit, const std::string &cursor, const std::vector<data_pointer> &ranges)
+{
+	return find_indexes_internal(indexes, intersect, limit, cursor, ranges, false, 0);
+}
+
+async_find_indexes_result session::find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+	uint64_t limit, const std::string &cursor, const std::vector<data_pointer> &ranges, bool read, uint64_t read_size)
 {
 	async_find_indexes_result result(*this);
 	async_result_handler<find_indexes_result_entry> handler(result);
@@ -952,14 +1205,26 @@ async_find_indexes_result session::find_indexes_internal(const std::vector<dnet_
 
 	session sess = clean_clone();
 	async_generic_result raw_result(sess);
-	auto raw_handler = std::make_shared<find_indexes_handler>(*this, raw_result, std::move(groups), indexes, intersect);
+	auto raw_handler = std::make_shared<find_indexes_handler>(*this, raw_result, std::move(groups), indexes, intersect,
+		limit, cursor, ranges, read, read_size);
 	auto convert_map = std::make_shared<find_indexes_handler::id_map>(std::move(raw_handler->take_convert_map()));
+
+	// objects are always read page by page, so the missed ones may be read at once
+	std::shared_ptr<find_indexes_page> page;
+	if (limit || !cursor.empty() || read || m_data->prefetch_hint) {
+		page = std::make_shared<find_indexes_page>();
+		page->limit = limit;
+		page->read = read;
+		page->read_size = read_size;
+		page->prefetch = m_data->prefetch_hint;
+	}
+
 	raw_handler->start();
 
 	using namespace std::placeholders;
 
-	raw_result.connect(std::bind(on_find_indexes_process, sess, convert_map, handler, _1),
-		std::bind(on_find_indexes_complete, handler, _1));
+	raw_result.connect(std::bind(on_find_indexes_process, sess, convert_map, page, handler, _1),
+		std::bind(on_find_indexes_complete, sess, page, handler, _1));
 
 	return result;
 }
@@ -984,6 +1249,104 @@ async_find_indexes_result session::find_any_indexes(const std::vector<std::strin
 	return find_any_indexes(session_convert_indexes(*this, indexes));
 }
 
+async_find_indexes_result session::find_all_indexes(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+	const std::string &cursor)
+{
+	return find_indexes_internal(indexes, true, limit, cursor);
+}
+
+async_find_indexes_result session::find_all_indexes(const std::vector<std::string> &indexes, uint64_t limit,
+	const std::string &cursor)
+{
+	return find_all_indexes(session_convert_indexes(*this, indexes), limit, cursor);
+}
+
+async_find_indexes_result session::find_any_indexes(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+	const std::string &cursor)
+{
+	return find_indexes_internal(indexes, false, limit, cursor);
+}
+
+async_find_indexes_result session::find_any_indexes(const std::vector<std::string> &indexes, uint64_t limit,
+	const std::string &cursor)
+{
+	return find_any_indexes(session_convert_indexes(*this, indexes), limit, cursor);
+}
+
+async_find_indexes_result session::find_all_indexes_read(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+	const std::string &cursor, uint64_t size)
+{
+	return find_indexes_internal(indexes, true, limit, cursor, std::vector<data_pointer>(), true, size);
+}
+
+async_find_indexes_result session::find_all_indexes_read(const std::vector<std::string> &indexes, uint64_t limit,
+	const std::string &cursor, uint64_t size)
+{
+	return find_all_indexes_read(session_convert_indexes(*this, indexes), limit, cursor, size);
+}
+
+async_find_indexes_result session::find_any_indexes_read(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+	const std::string &cursor, uint64_t size)
+{
+	return find_indexes_internal(indexes, false, limit, cursor, std::vector<data_pointer>(), true, size);
+}
+
+async_find_indexes_result session::find_any_indexes_read(const std::vector<std::string> &indexes, uint64_t limit,
+	const std::string &cursor, uint64_t size)
+{
+	return find_any_indexes_read(session_convert_indexes(*this, indexes), limit, cursor, size);
+}
+
+std::string session::find_indexes_cursor(const find_indexes_result_entry &last)
+{
+	return std::string(reinterpret_cast<const char *>(last.id.id), sizeof(last.id.id));
+}
+
+static data_pointer session_pack_index_range(uint64_t flags, const data_pointer &start, const data_pointer &end)
+{
+	data_buffer buffer(sizeof(dnet_indexes_range) + start.size() + end.size());
+
+	dnet_indexes_range range;
+	memset(&range, 0, sizeof(range));
+	range.flags = flags;
+	range.start_size = start.size();
+	range.end_size = end.size();
+
+	buffer.write(range);
+	if (!start.empty())
+		buffer.write(start.data<char>(), start.size());
+	if (!end.empty())
+		buffer.write(end.data<char>(), end.size());
+
+	return std::move(buffer);
+}
+
+async_find_indexes_result session::find_indexes_range(const dnet_raw_id &index, const data_pointer &start,
+	const data_pointer &end)
+{
+	const uint64_t flags = end.empty() ? 0 : DNET_INDEXES_RANGE_END;
+
+	return find_indexes_internal(std::vector<dnet_raw_id>(1, index), true, 0, std::string(),
+		std::vector<data_pointer>(1, session_pack_index_range(flags, start, end)));
+}
+
+async_find_indexes_result session::find_indexes_range(const std::string &index, const data_pointer &start,
+	const data_pointer &end)
+{
+	return find_indexes_range(session_convert_indexes(*this, std::vector<std::string>(1, index))[0], start, end);
+}
+
+async_find_indexes_result session::find_indexes_prefix(const dnet_raw_id &index, const data_pointer &prefix)
+{
+	return find_indexes_internal(std::vector<dnet_raw_id>(1, index), true, 0, std::string(),
+		std::vector<data_pointer>(1, session_pack_index_range(DNET_INDEXES_RANGE_PREFIX, prefix, data_pointer())));
+}
+
+async_find_indexes_result session::find_indexes_prefix(const std::string &index, const data_pointer &prefix)
+{
+	return find_indexes_prefix(session_convert_indexes(*this, std::vector<std::string>(1, index))[0], prefix);
+}
+
 struct check_indexes_handler
 {
 	session sess;
@@ -1029,66 +1392,6 @@ async_list_indexes_result session::list_indexes(const key &request_id)
 	return result;
 }
 
-/*!
- * Auxiliary function to parse char* buffer with c-msgpack library
- */
-static bool buffer_reader(cmp_ctx_t *ctx, void *data, size_t limit)
-{
-	char *start_ptr = static_cast<char *>(ctx->buf);
-	char *ptr = start_ptr;
-	while (ptr && limit) {
-		++ptr;
-		--limit;
-	}
-	if (limit != 0) {
-		return false;
-	}
-	memcpy(data, start_ptr, ptr - start_ptr);
-	ctx->buf = ptr;
-	return true;
-}
-
-/*!
- * Structure of secondary index msgpack is following
- * Array of 4 elements
- * Version number
- * Array of indexes
- *
- * We need to get size of indexes array, that's why we
- * skip first two fields in msgpack and return size
- * of array in third position of msgpack
- */
-static uint32_t get_index_size(const std::string &index_metadata, int &err)
-{
-	err = 0;
-	cmp_ctx_t cmp;
-
-	char *buffer = new char[index_metadata.length() + 1];
-	memcpy(buffer, index_metadata.data(), index_metadata.length() + 1);
-
-	cmp_init(&cmp, buffer, buffer_reader, NULL);
-
-	uint32_t array_size;
-	if (!cmp_read_array(&cmp, &array_size)) {
-		err = -EBADMSG;
-		return 0;
-	}
-
-	int32_t version;
-	if (!cmp_read_int(&cmp, &version)) {
-		err = -EBADMSG;
-		return 0;
-	}
-
-	if (!cmp_read_array(&cmp, &array_size)) {
-		err = -EBADMSG;
-		return 0;
-	}
-
-	delete[] buffer;
-	return array_size;
-}
-
 typedef std::map<dnet_raw_id, int, dnet_raw_id_less_than<> > id_to_shard_map;
 
 /*!
@@ -1098,35 +1401,132 @@ typedef std::map<dnet_raw_id, int, dnet_raw_id_less_than<> > id_to_shard_map;
  * We extract metadata from each shard index
  * and put it into vector of answers
  */
-struct get_index_metadata_callback
+struct get_index_metadata_callback : public std::enable_shared_from_this<get_index_metadata_callback>
 {
+	get_index_metadata_callback(const session &sess, const async_get_index_metadata_result &result,
+		id_to_shard_map &&id_to_shard) :
+		sess(sess), handler(result), id_to_shard(std::move(id_to_shard))
+	{
+	}
+
 	session sess;
 	async_result_handler<get_index_metadata_result_entry> handler;
 	id_to_shard_map id_to_shard;
 
-	void operator() (const read_result_entry &result)
+	// shards whose tables have been split, their entries are counted by parts
+	std::mutex split_lock;
+	std::vector<get_index_metadata_result_entry> split;
+	std::vector<dnet_raw_id> split_ids;
+	id_to_shard_map part_to_split;
+	error_info shards_error;
+
+	/*
+	 * Only flat table without log knows its size,
+	 * entries of other tables are counted after deltas from their logs are applied
+	 */
+	bool count_entries(const data_pointer &file, size_t *size)
+	{
+		try {
+			index_table_view view;
+			if (index_table_view::is_flat(file))
+				view.parse(file);
+
+			if (index_table_view::is_flat(file) && !view.has_log()) {
+				*size = view.size();
+			} else {
+				dnet_indexes indexes;
+				indexes_unpack_raw(file, &indexes);
+				*size = indexes.indexes.size();
+			}
+		} catch (std::exception &e) {
+			BH_LOG(sess.get_logger(), DNET_LOG_ERROR, "get_index_metadata: Incorrect index table format: %s", e.what());
+			return false;
+		}
+
+		return true;
+	}
+
+	void on_shard(const read_result_entry &result)
 	{
 		get_index_metadata_result_entry metadata;
 
 		dnet_raw_id raw_id;
 		memcpy(raw_id.id, result.command()->id.id, DNET_ID_SIZE);
 		metadata.shard_id = id_to_shard[raw_id];
-
-		std::string content =  result.file().to_string().substr(DNET_INDEX_TABLE_MAGIC_SIZE);
-		int err = 0;
-		metadata.index_size = get_index_size(content, err);
-		if (err) {
-			metadata.is_valid = false;
-			BH_LOG(sess.get_logger(), DNET_LOG_ERROR, "get_index_metadata: Incorrect msgpack format: err: %d", err);
-		} else {
-			metadata.is_valid = true;
+		metadata.split_depth = indexes_split_depth(result.file());
+		metadata.index_size = 0;
+		metadata.is_valid = true;
+
+		if (metadata.split_depth) {
+			std::lock_guard<std::mutex> guard(split_lock);
+			split.push_back(metadata);
+			split_ids.push_back(raw_id);
+			return;
 		}
+
+		metadata.is_valid = count_entries(result.file(), &metadata.index_size);
 		handler.process(metadata);
 	}
 
-	void operator() (const error_info &error)
+	void on_shards_complete(const error_info &error)
 	{
-		handler.complete(error);
+		if (split.empty()) {
+			handler.complete(error);
+			return;
+		}
+
+		shards_error = error;
+
+		std::vector<dnet_io_attr> ios;
+		for (size_t i = 0; i < split.size(); ++i) {
+			for (unsigned int slot = 0; slot < (1u << split[i].split_depth); ++slot) {
+				dnet_raw_id id;
+				dnet_indexes_transform_index_split_id(&split_ids[i], split[i].split_depth, slot, &id);
+				part_to_split[id] = i;
+
+				dnet_io_attr io;
+				memset(&io, 0, sizeof(io));
+
+				io.size   = 100;
+				io.offset = 0;
+				io.flags  = sess.get_ioflags() | DNET_IO_FLAGS_CACHE;
+				memcpy(io.id, id.id, DNET_ID_SIZE);
+				memcpy(io.parent, id.id, DNET_ID_SIZE);
+				ios.push_back(io);
+			}
+		}
+
+		using namespace std::placeholders;
+
+		sess.bulk_read(ios).connect(
+			std::bind(&get_index_metadata_callback::on_part, shared_from_this(), _1),
+			std::bind(&get_index_metadata_callback::on_parts_complete, shared_from_this(), _1));
+	}
+
+	void on_part(const read_result_entry &result)
+	{
+		dnet_raw_id raw_id;
+		memcpy(raw_id.id, result.command()->id.id, DNET_ID_SIZE);
+
+		size_t size = 0;
+		const bool valid = count_entries(result.file(), &size);
+
+		std::lock_guard<std::mutex> guard(split_lock);
+
+		get_index_metadata_result_entry &metadata = split[part_to_split[raw_id]];
+		metadata.index_size += size;
+		metadata.is_valid &= valid;
+	}
+
+	/*
+	 * Parts which are not found have not got any entry yet
+	 */
+	void on_parts_complete(const error_info &)
+	{
+		for (auto it = split.begin(); it != split.end(); ++it)
+			handler.process(*it);
+
+		handler.complete(shards_error);
 	}
 };
 
@@ -1179,8 +1579,13 @@ async_get_index_metadata_result session::get_index_metadata(const dnet_raw_id &i
 	}
 
 	async_get_index_metadata_result result(*this);
-	get_index_metadata_callback callback = { sess, result, id_to_shard };
-	sess.bulk_read(request_io_attrs).connect(callback, callback);
+	auto callback = std::make_shared<get_index_metadata_callback>(sess, result, std::move(id_to_shard));
+
+	using namespace std::placeholders;
+
+	sess.bulk_read(request_io_attrs).connect(
+		std::bind(&get_index_metadata_callback::on_shard, callback, _1),
+		std::bind(&get_index_metadata_callback::on_shards_complete, callback, _1));
 
 	return result;
 }
@@ -1309,6 +1714,27 @@ struct merge_indexes_callback
 			return;
 		}
 
+		/*
+		 * Split tables do not have entries, they are copied if all replicas are split the same way,
+		 * their parts are merged by their own ids
+		 */
+		int split_depth = -1;
+		for (auto it = raw_indexes.begin(); it != raw_indexes.end(); ++it) {
+			const int depth = indexes_split_depth(it->file());
+			if (split_depth != -1 && depth != split_depth) {
+				BH_LOG(log, DNET_LOG_ERROR, "%s: mismatched split of indexes: %d vs %d",
+					dnet_dump_id(&id.id()), split_depth, depth);
+				handler.complete(create_error(-EINVAL, id, "mismatched split of indexes"));
+				return;
+			}
+			split_depth = depth;
+		}
+
+		if (split_depth > 0) {
+			write_session.write_data(id, raw_indexes.front().file(), 0).connect(handler);
+			return;
+		}
+
 		std::vector<dnet_indexes> indexes;
 		data_pointer valid_index_data;
 
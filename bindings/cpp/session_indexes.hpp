@@ -24,10 +24,12 @@
 
 #include <msgpack.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 #define DNET_INDEX_TABLE_MAGIC 0x5DA38CFBE7734027ull
 #define DNET_INDEX_TABLE_MAGIC_SIZE 8
+#define DNET_INDEX_TABLE_FLAT_MAGIC 0x5DA38CFBE7734028ull
 
 namespace ioremap { namespace elliptics {
 
@@ -57,20 +59,332 @@ struct dnet_indexes
 	std::vector<dnet_index_entry> indexes;
 };
 
+/*
+ * Index table is stored as magic, packed dnet_indexes and optional log of packed deltas appended after it.
+ * Every delta inserts (or updates) or removes single entry, the latest delta of the entry wins.
+ * Deltas are merged into the table by the reader, server rewrites the table without log when it grows.
+ *
+ * Readers which do not know about the log see table as it was at the last rewrite.
+ */
+struct dnet_index_delta
+{
+	dnet_index_delta() : action(0)
+	{}
+
+	dnet_index_delta(uint32_t action, const dnet_index_entry &entry)
+		: action(action), entry(entry)
+	{}
+
+	uint32_t action; // DNET_INDEXES_FLAGS_INTERNAL_INSERT or DNET_INDEXES_FLAGS_INTERNAL_REMOVE
+	dnet_index_entry entry;
+};
+
+static inline void indexes_apply_log(dnet_indexes *data, const char *log, size_t size);
+
+template <typename T>
+static inline void indexes_apply_log(T *, const char *, size_t)
+{
+}
+
+/*
+ * Flat index table has fixed-width entries sorted by id, they point to data region which follows them:
+ * flat magic | header | entries | data | optional log of deltas.
+ * It is searched in place without unpacking, all integers are little-endian.
+ */
+enum dnet_index_flat_version : uint16_t {
+	dnet_index_flat_version_first = 1
+};
+
+struct dnet_index_flat_header
+{
+	uint16_t		version;
+	uint16_t		split_depth;	/* table has no entries, they are in its split parts */
+	int32_t			shard_id;
+	int32_t			shard_count;
+	uint32_t		reserved2;
+	uint64_t		count;
+	uint64_t		data_size;
+} __attribute__ ((packed));
+
+struct dnet_index_flat_entry
+{
+	dnet_raw_id		index;
+	uint64_t		data_offset;	/* offset within data region */
+	uint64_t		data_size;
+	dnet_time		time;
+} __attribute__ ((packed));
+
+/*
+ * Read-only view of the flat index table, it shares memory of the table and does not allocate per entry
+ */
+class index_table_view
+{
+public:
+	index_table_view() : m_entries(NULL), m_count(0), m_log_offset(0)
+	{
+		memset(&m_header, 0, sizeof(m_header));
+	}
+
+	static bool is_flat(const data_pointer &file)
+	{
+		static const unsigned long long magic = dnet_bswap64(DNET_INDEX_TABLE_FLAT_MAGIC);
+
+		return file.size() >= DNET_INDEX_TABLE_MAGIC_SIZE &&
+			memcmp(file.data(), &magic, DNET_INDEX_TABLE_MAGIC_SIZE) == 0;
+	}
+
+	/*
+	 * Throws if @file is not a valid flat table
+	 */
+	void parse(const data_pointer &file)
+	{
+		if (!is_flat(file) || file.size() < DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(dnet_index_flat_header))
+			throw std::runtime_error("Invalid flat index table");
+
+		memcpy(&m_header, file.data<char>() + DNET_INDEX_TABLE_MAGIC_SIZE, sizeof(m_header));
+		m_header.version = dnet_bswap16(m_header.version);
+		m_header.split_depth = dnet_bswap16(m_header.split_depth);
+		m_header.shard_id = dnet_bswap32(m_header.shard_id);
+		m_header.shard_count = dnet_bswap32(m_header.shard_count);
+		m_header.count = dnet_bswap64(m_header.count);
+		m_header.data_size = dnet_bswap64(m_header.data_size);
+
+		if (m_header.version != dnet_index_flat_version_first)
+			throw std::runtime_error("Unsupported flat index table version");
+
+		const size_t entries_offset = DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(dnet_index_flat_header);
+		const uint64_t max_count = (file.size() - entries_offset) / sizeof(dnet_index_flat_entry);
+		if (m_header.count > max_count ||
+				m_header.data_size > file.size() - entries_offset - m_header.count * sizeof(dnet_index_flat_entry))
+			throw std::runtime_error("Truncated flat index table");
+
+		m_file = file;
+		m_entries = reinterpret_cast<const dnet_index_flat_entry *>(file.data<char>() + entries_offset);
+		m_count = m_header.count;
+		m_data = file.slice(entries_offset + m_count * sizeof(dnet_index_flat_entry), m_header.data_size);
+		m_log_offset = entries_offset + m_count * sizeof(dnet_index_flat_entry) + m_header.data_size;
+	}
+
+	size_t size() const
+	{
+		return m_count;
+	}
+
+	int shard_id() const
+	{
+		return m_header.shard_id;
+	}
+
+	int shard_count() const
+	{
+		return m_header.shard_count;
+	}
+
+	int split_depth() const
+	{
+		return m_header.split_depth;
+	}
+
+	const dnet_raw_id &id(size_t i) const
+	{
+		return m_entries[i].index;
+	}
+
+	/*
+	 * Data of the entry references memory of the table
+	 */
+	data_pointer data(size_t i) const
+	{
+		uint64_t offset, size;
+		memcpy(&offset, &m_entries[i].data_offset, sizeof(offset));
+		memcpy(&size, &m_entries[i].data_size, sizeof(size));
+		offset = dnet_bswap64(offset);
+		size = dnet_bswap64(size);
+
+		if (offset > m_data.size() || size > m_data.size() - offset)
+			throw std::runtime_error("Invalid flat index entry");
+
+		if (!size)
+			return data_pointer();
+		return m_data.slice(offset, size);
+	}
+
+	dnet_time time(size_t i) const
+	{
+		dnet_time time;
+		memcpy(&time, &m_entries[i].time, sizeof(time));
+		dnet_convert_time(&time);
+		return time;
+	}
+
+	/*
+	 * Returns position of the first entry not less than @index
+	 */
+	size_t lower_bound(const dnet_raw_id &index, size_t first = 0) const
+	{
+		size_t count = m_count - first;
+
+		while (count > 0) {
+			const size_t step = count / 2;
+			const size_t middle = first + step;
+
+			if (memcmp(m_entries[middle].index.id, index.id, DNET_ID_SIZE) < 0) {
+				first = middle + 1;
+				count -= step + 1;
+			} else {
+				count = step;
+			}
+		}
+
+		return first;
+	}
+
+	/*
+	 * Deltas appended to the table after it was written (see dnet_index_delta)
+	 */
+	bool has_log() const
+	{
+		return m_log_offset < m_file.size();
+	}
+
+	const char *log() const
+	{
+		return m_file.data<char>() + m_log_offset;
+	}
+
+	size_t log_size() const
+	{
+		return m_file.size() - m_log_offset;
+	}
+
+private:
+	data_pointer m_file;
+	data_pointer m_data;
+	dnet_index_flat_header m_header;
+	const dnet_index_flat_entry *m_entries;
+	size_t m_count;
+	size_t m_log_offset;
+};
+
+static inline data_pointer indexes_pack_flat(const dnet_indexes &indexes)
+{
+	uint64_t data_size = 0;
+	for (auto it = indexes.indexes.begin(); it != indexes.indexes.end(); ++it)
+		data_size += it->data.size();
+
+	dnet_index_flat_header header;
+	memset(&header, 0, sizeof(header));
+	header.version = dnet_bswap16(dnet_index_flat_version_first);
+	header.shard_id = dnet_bswap32(indexes.shard_id);
+	header.shard_count = dnet_bswap32(indexes.shard_count);
+	header.count = dnet_bswap64(indexes.indexes.size());
+	header.data_size = dnet_bswap64(data_size);
+
+	data_buffer buffer(DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(header) +
+		indexes.indexes.size() * sizeof(dnet_index_flat_entry) + data_size);
+	buffer.write(dnet_bswap64(DNET_INDEX_TABLE_FLAT_MAGIC));
+	buffer.write(header);
+
+	uint64_t offset = 0;
+	for (auto it = indexes.indexes.begin(); it != indexes.indexes.end(); ++it) {
+		dnet_index_flat_entry entry;
+		entry.index = it->index;
+		entry.data_offset = dnet_bswap64(offset);
+		entry.data_size = dnet_bswap64(it->data.size());
+		entry.time = it->time;
+		dnet_convert_time(&entry.time);
+
+		buffer.write(entry);
+		offset += it->data.size();
+	}
+
+	for (auto it = indexes.indexes.begin(); it != indexes.indexes.end(); ++it)
+		buffer.write(it->data.data(), it->data.size());
+
+	return std::move(buffer);
+}
+
+/*
+ * Table of the shard which has been split, see dnet_indexes_transform_index_split_id(),
+ * it is always flat, so readers which do not know about splits see empty table
+ */
+static inline data_pointer indexes_pack_split(int shard_id, int shard_count, int split_depth)
+{
+	dnet_index_flat_header header;
+	memset(&header, 0, sizeof(header));
+	header.version = dnet_bswap16(dnet_index_flat_version_first);
+	header.split_depth = dnet_bswap16(split_depth);
+	header.shard_id = dnet_bswap32(shard_id);
+	header.shard_count = dnet_bswap32(shard_count);
+
+	data_buffer buffer(DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(header));
+	buffer.write(dnet_bswap64(DNET_INDEX_TABLE_FLAT_MAGIC));
+	buffer.write(header);
+
+	return std::move(buffer);
+}
+
+/*
+ * Returns split depth of the table, 0 if it is not split or is not a valid flat table
+ */
+static inline int indexes_split_depth(const data_pointer &file)
+{
+	if (!index_table_view::is_flat(file) || file.size() < DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(dnet_index_flat_header))
+		return 0;
+
+	dnet_index_flat_header header;
+	memcpy(&header, file.data<char>() + DNET_INDEX_TABLE_MAGIC_SIZE, sizeof(header));
+	return dnet_bswap16(header.split_depth);
+}
+
+static inline void indexes_unpack_flat(const data_pointer &file, dnet_indexes *data)
+{
+	index_table_view view;
+	view.parse(file);
+
+	data->shard_id = view.shard_id();
+	data->shard_count = view.shard_count();
+	data->indexes.clear();
+	data->indexes.reserve(view.size());
+
+	for (size_t i = 0; i < view.size(); ++i)
+		data->indexes.emplace_back(view.id(i), view.data(i), view.time(i));
+
+	if (view.has_log())
+		indexes_apply_log(data, view.log(), view.log_size());
+}
+
+template <typename T>
+static inline void indexes_unpack_flat(const data_pointer &, T *)
+{
+	throw std::runtime_error("Flat format is supported for index tables only");
+}
 
 template <typename T>
 static inline void indexes_unpack_raw(const data_pointer &file, T *data)
 {
 	static const unsigned long long magic = dnet_bswap64(DNET_INDEX_TABLE_MAGIC);
 
+	if (index_table_view::is_flat(file)) {
+		indexes_unpack_flat(file, data);
+		return;
+	}
+
 	if (file.size() < DNET_INDEX_TABLE_MAGIC_SIZE
 		|| memcmp(file.data(), &magic, DNET_INDEX_TABLE_MAGIC_SIZE) != 0) {
 		throw std::runtime_error("Invalid magic");
 	}
 
+	const char *table = file.data<char>() + DNET_INDEX_TABLE_MAGIC_SIZE;
+	const size_t table_size = file.size() - DNET_INDEX_TABLE_MAGIC_SIZE;
+	size_t offset = 0;
+
 	msgpack::unpacked msg;
-	msgpack::unpack(&msg, file.data<char>() + DNET_INDEX_TABLE_MAGIC_SIZE, file.size() - DNET_INDEX_TABLE_MAGIC_SIZE);
+	msgpack::unpack(&msg, table, table_size, &offset);
 	msg.get().convert(data);
+
+	if (offset < table_size)
+		indexes_apply_log(data, table + offset, table_size - offset);
 }
 
 template <typename T>
@@ -119,8 +433,13 @@ enum dnet_indexes_version : uint16_t {
 	dnet_indexes_version_second = 2
 };
 
+enum dnet_index_delta_version : uint16_t {
+	dnet_index_delta_version_first = 1
+};
+
 enum find_indexes_result_entry_version : uint16_t {
-	find_indexes_result_entry_version_first = 1
+	find_indexes_result_entry_version_first = 1,
+	find_indexes_result_entry_version_data = 2
 };
 
 inline dnet_id &operator >>(msgpack::object o, dnet_id &v)
@@ -258,13 +577,59 @@ inline msgpack::packer<Stream> &operator <<(msgpack::packer<Stream> &o, const dn
 	return o;
 }
 
+inline dnet_index_delta &operator >>(msgpack::object o, dnet_index_delta &v)
+{
+	if (o.type != msgpack::type::ARRAY || o.via.array.size < 1)
+		throw msgpack::type_error();
+
+	object *p = o.via.array.ptr;
+	const uint32_t size = o.via.array.size;
+	uint16_t version = 0;
+	p[0].convert(&version);
+	switch (version) {
+	case dnet_index_delta_version_first: {
+		if (size != 3)
+			throw msgpack::type_error();
+
+		p[1].convert(&v.action);
+		p[2].convert(&v.entry);
+		break;
+	}
+	default:
+		throw msgpack::type_error();
+	}
+
+	return v;
+}
+
 template <typename Stream>
-inline msgpack::packer<Stream> &operator <<(msgpack::packer<Stream> &o, const find_indexes_result_entry &result)
+inline msgpack::packer<Stream> &operator <<(msgpack::packer<Stream> &o, const dnet_index_delta &v)
 {
 	o.pack_array(3);
-	o.pack(uint16_t(find_indexes_result_entry_version_first));
+	o.pack(uint16_t(dnet_index_delta_version_first));
+	o.pack(v.action);
+	o.pack(v.entry);
+	return o;
+}
+
+template <typename Stream>
+inline msgpack::packer<Stream> &operator <<(msgpack::packer<Stream> &o, const find_indexes_result_entry &result)
+{
+	// objects without data are packed by the first version, so older clients still understand them
+	if (result.status == 0 && result.data.empty()) {
+		o.pack_array(3);
+		o.pack(uint16_t(find_indexes_result_entry_version_first));
+		o.pack(result.id);
+		o.pack(result.indexes);
+		return o;
+	}
+
+	o.pack_array(5);
+	o.pack(uint16_t(find_indexes_result_entry_version_data));
 	o.pack(result.id);
 	o.pack(result.indexes);
+	o.pack(result.status);
+	o.pack(result.data);
 	return o;
 }
 
@@ -285,6 +650,18 @@ inline find_indexes_result_entry &operator >>(msgpack::object obj, find_indexes_
 
 		array[1].convert(&result.id);
 		array[2].convert(&result.indexes);
+		result.status = 0;
+		result.data = data_pointer();
+		break;
+	}
+	case find_indexes_result_entry_version_data: {
+		if (size != 5)
+			throw msgpack::type_error();
+
+		array[1].convert(&result.id);
+		array[2].convert(&result.indexes);
+		array[3].convert(&result.status);
+		array[4].convert(&result.data);
 		break;
 	}
 	default:
@@ -296,4 +673,78 @@ inline find_indexes_result_entry &operator >>(msgpack::object obj, find_indexes_
 
 } /* namespace msgpack */
 
+namespace ioremap { namespace elliptics {
+
+static inline bool index_delta_less_than(const dnet_index_delta &first, const dnet_index_delta &second)
+{
+	return memcmp(first.entry.index.id, second.entry.index.id, DNET_ID_SIZE) < 0;
+}
+
+/*
+ * Packs index table with magic, flat format is used only when all servers and clients support it
+ */
+static inline data_pointer indexes_pack(const dnet_indexes &indexes, bool flat)
+{
+	if (flat)
+		return indexes_pack_flat(indexes);
+
+	msgpack::sbuffer buffer;
+	msgpack::pack(&buffer, indexes);
+
+	data_buffer tmp_buffer(DNET_INDEX_TABLE_MAGIC_SIZE + buffer.size());
+	tmp_buffer.write(dnet_bswap64(DNET_INDEX_TABLE_MAGIC));
+	tmp_buffer.write(buffer.data(), buffer.size());
+
+	return std::move(tmp_buffer);
+}
+
+/*
+ * Merges log of deltas into already unpacked sorted table
+ */
+static inline void indexes_apply_log(dnet_indexes *data, const char *log, size_t size)
+{
+	std::vector<dnet_index_delta> deltas;
+	size_t offset = 0;
+
+	while (offset < size) {
+		msgpack::unpacked msg;
+		msgpack::unpack(&msg, log, size, &offset);
+
+		dnet_index_delta delta;
+		msg.get().convert(&delta);
+		deltas.emplace_back(std::move(delta));
+	}
+
+	// stable sort keeps deltas of the same entry in the order they were appended
+	std::stable_sort(deltas.begin(), deltas.end(), index_delta_less_than);
+
+	std::vector<dnet_index_entry> result;
+	result.reserve(data->indexes.size() + deltas.size());
+
+	auto it = data->indexes.begin();
+	for (auto jt = deltas.begin(); jt != deltas.end(); ++jt) {
+		auto next = jt + 1;
+		if (next != deltas.end() && !index_delta_less_than(*jt, *next))
+			continue;
+
+		while (it != data->indexes.end() && memcmp(it->index.id, jt->entry.index.id, DNET_ID_SIZE) < 0) {
+			result.emplace_back(std::move(*it));
+			++it;
+		}
+
+		if (it != data->indexes.end() && it->index == jt->entry.index)
+			++it;
+
+		if (jt->action == DNET_INDEXES_FLAGS_INTERNAL_INSERT)
+			result.emplace_back(std::move(jt->entry));
+	}
+
+	for (; it != data->indexes.end(); ++it)
+		result.emplace_back(std::move(*it));
+
+	data->indexes.swap(result);
+}
+
+}} /* namespace ioremap::elliptics */
+
 #endif /* __CPP_SESSION_INDEXES_HPP */
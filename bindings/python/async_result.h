@@ -163,12 +163,15 @@ struct python_async_result {
 
 	void connect(bp::api::object &result_handler, bp::api::object &final_handler) {
 		auto callback = boost::make_shared<callback_one_handlers<T>>(result_handler, final_handler);
+		// handlers take the GIL themselves, elliptics thread may hold result's lock while waiting for it
+		py_allow_threads_scoped pythr;
 		scope->connect(boost::bind(&callback_one_handlers<T>::on_result, callback, _1),
 		               boost::bind(&callback_one_handlers<T>::on_final, callback, _1));
 	}
 
 	void connect_all(bp::api::object &handler) {
 		auto callback = boost::make_shared<callback_all_handler<T>>(handler);
+		py_allow_threads_scoped pythr;
 		scope->connect(boost::bind(&callback_all_handler<T>::on_results, callback, _1, _2));
 	}
 
@@ -0,0 +1,89 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "data_view.h"
+
+namespace ioremap { namespace elliptics { namespace python {
+
+/*
+ * Owner of data_pointer which implements buffer protocol, memoryview references it
+ * instead of Py_buffer's copy, so the data outlives every view made from it.
+ */
+struct data_buffer_object {
+	PyObject_HEAD
+	data_pointer *data;
+};
+
+static void data_buffer_dealloc(PyObject *self)
+{
+	delete reinterpret_cast<data_buffer_object *>(self)->data;
+	Py_TYPE(self)->tp_free(self);
+}
+
+static int data_buffer_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+	data_pointer *data = reinterpret_cast<data_buffer_object *>(self)->data;
+
+	return PyBuffer_FillInfo(view, self, data->data(), data->size(), 1, flags);
+}
+
+static PyBufferProcs data_buffer_procs;
+static PyTypeObject data_buffer_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyTypeObject *data_buffer_type_ready()
+{
+	if (data_buffer_type.tp_flags & Py_TPFLAGS_READY)
+		return &data_buffer_type;
+
+	data_buffer_procs.bf_getbuffer = data_buffer_getbuffer;
+
+	data_buffer_type.tp_name = "elliptics.core.DataBuffer";
+	data_buffer_type.tp_basicsize = sizeof(data_buffer_object);
+	data_buffer_type.tp_dealloc = data_buffer_dealloc;
+	data_buffer_type.tp_as_buffer = &data_buffer_procs;
+	data_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT;
+#if PY_MAJOR_VERSION < 3
+	data_buffer_type.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+	data_buffer_type.tp_doc = "Read-only buffer over data received from Elliptics";
+
+	if (PyType_Ready(&data_buffer_type) < 0)
+		bp::throw_error_already_set();
+
+	return &data_buffer_type;
+}
+
+bp::object data_view(const data_pointer &data)
+{
+	data_buffer_object *buffer = PyObject_New(data_buffer_object, data_buffer_type_ready());
+	if (!buffer)
+		bp::throw_error_already_set();
+
+	buffer->data = NULL;
+	bp::object owner(bp::handle<>(reinterpret_cast<PyObject *>(buffer)));
+	buffer->data = new data_pointer(data);
+
+	PyObject *view = PyMemoryView_FromObject(owner.ptr());
+	if (!view)
+		bp::throw_error_already_set();
+
+	return bp::object(bp::handle<>(view));
+}
+
+} } } // namespace ioremap::elliptics::python
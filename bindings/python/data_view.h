@@ -0,0 +1,37 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELLIPTICS_PYTHON_DATA_VIEW_HPP
+#define ELLIPTICS_PYTHON_DATA_VIEW_HPP
+
+#include <boost/python.hpp>
+
+#include <elliptics/utils.hpp>
+
+namespace bp = boost::python;
+
+namespace ioremap { namespace elliptics { namespace python {
+
+/*
+ * Returns read-only memoryview over @data without copying it,
+ * the buffer is kept alive while the view or any its slice exists.
+ */
+bp::object data_view(const data_pointer &data);
+
+} } } // namespace ioremap::elliptics::python
+
+#endif // ELLIPTICS_PYTHON_DATA_VIEW_HPP
@@ -34,6 +34,7 @@
 #include "elliptics_time.h"
 #include "elliptics_io_attr.h"
 #include "elliptics_session.h"
+#include "data_view.h"
 
 namespace bp = boost::python;
 
@@ -41,6 +42,8 @@ namespace ioremap { namespace elliptics { namespace python {
 enum elliptics_iterator_types {
 	itype_disk	= DNET_ITYPE_DISK,
 	itype_network	= DNET_ITYPE_NETWORK,
+	itype_hash	= DNET_ITYPE_HASH,
+	itype_filter	= DNET_ITYPE_FILTER,
 };
 
 enum elliptics_iterator_flags {
@@ -50,7 +53,13 @@ enum elliptics_iterator_flags {
 	iflag_ts_range		= DNET_IFLAGS_TS_RANGE,
 	iflag_no_meta		= DNET_IFLAGS_NO_META,
 	iflags_move		= DNET_IFLAGS_MOVE,
-	iflags_overwrite	= DNET_IFLAGS_OVERWRITE
+	iflags_overwrite	= DNET_IFLAGS_OVERWRITE,
+	iflags_batch_replies	= DNET_IFLAGS_BATCH_REPLIES,
+	iflags_diff		= DNET_IFLAGS_DIFF,
+	iflags_bulk_write	= DNET_IFLAGS_BULK_WRITE,
+	iflags_compact		= DNET_IFLAGS_COMPACT,
+	iflags_ordered		= DNET_IFLAGS_ORDERED,
+	iflags_filter		= DNET_IFLAGS_FILTER
 };
 
 enum elliptics_cflags {
@@ -58,7 +67,9 @@ enum elliptics_cflags {
 	cflags_direct	= DNET_FLAGS_DIRECT,
 	cflags_nolock	= DNET_FLAGS_NOLOCK,
 	cflags_checksum = DNET_FLAGS_CHECKSUM,
-	cflags_nocache  = DNET_FLAGS_NOCACHE
+	cflags_nocache  = DNET_FLAGS_NOCACHE,
+	cflags_background = DNET_FLAGS_BACKGROUND,
+	cflags_no_file_path = DNET_FLAGS_NO_FILE_PATH
 };
 
 enum elliptics_ioflags {
@@ -75,6 +86,9 @@ enum elliptics_ioflags {
 	ioflags_cache_remove_from_disk	= DNET_IO_FLAGS_CACHE_REMOVE_FROM_DISK,
 	ioflags_cas_timestamp		= DNET_IO_FLAGS_CAS_TIMESTAMP,
 	ioflags_mix_states		= DNET_IO_FLAGS_MIX_STATES,
+	ioflags_streaming		= DNET_IO_FLAGS_STREAMING,
+	ioflags_filter			= DNET_IO_FLAGS_FILTER,
+	ioflags_compressed		= DNET_IO_FLAGS_COMPRESSED,
 };
 
 enum elliptics_record_flags {
@@ -84,6 +98,8 @@ enum elliptics_record_flags {
 	record_flags_exthdr		= DNET_RECORD_FLAGS_EXTHDR,
 	record_flags_uncommitted	= DNET_RECORD_FLAGS_UNCOMMITTED,
 	record_flags_chunked_csum	= DNET_RECORD_FLAGS_CHUNKED_CSUM,
+	record_flags_compressed		= DNET_RECORD_FLAGS_COMPRESSED,
+	record_flags_dedup		= DNET_RECORD_FLAGS_DEDUP,
 };
 
 enum elliptics_exceptions_policy {
@@ -103,6 +119,10 @@ enum elliptics_config_flags {
 	config_flags_mix_states			= DNET_CFG_MIX_STATES,
 	config_flags_no_csum			= DNET_CFG_NO_CSUM,
 	config_flags_randomize_states		= DNET_CFG_RANDOMIZE_STATES,
+	config_flags_latency_states		= DNET_CFG_LATENCY_STATES,
+	config_flags_flat_indexes		= DNET_CFG_FLAT_INDEXES,
+	config_flags_locality_states		= DNET_CFG_LOCALITY_STATES,
+	config_flags_outlier_states		= DNET_CFG_OUTLIER_STATES,
 };
 
 enum elliptics_node_status_flags {
@@ -134,6 +154,42 @@ std::string dnet_config_get_cookie(const dnet_config &config) {
 	return std::string(config.cookie, sizeof(config.cookie));
 }
 
+void dnet_config_set_route_cache_dir(dnet_config &config, const std::string &dir) {
+	free(const_cast<char *>(config.route_cache_dir));
+	config.route_cache_dir = dir.empty() ? NULL : strdup(dir.c_str());
+}
+
+std::string dnet_config_get_route_cache_dir(const dnet_config &config) {
+	return config.route_cache_dir ? config.route_cache_dir : "";
+}
+
+void dnet_config_set_local_socket_dir(dnet_config &config, const std::string &dir) {
+	free(const_cast<char *>(config.local_socket_dir));
+	config.local_socket_dir = dir.empty() ? NULL : strdup(dir.c_str());
+}
+
+std::string dnet_config_get_local_socket_dir(const dnet_config &config) {
+	return config.local_socket_dir ? config.local_socket_dir : "";
+}
+
+void dnet_config_set_locality(dnet_config &config, const std::string &locality) {
+	free(const_cast<char *>(config.locality));
+	config.locality = locality.empty() ? NULL : strdup(locality.c_str());
+}
+
+std::string dnet_config_get_locality(const dnet_config &config) {
+	return config.locality ? config.locality : "";
+}
+
+void dnet_config_set_localities(dnet_config &config, const std::string &localities) {
+	free(const_cast<char *>(config.localities));
+	config.localities = localities.empty() ? NULL : strdup(localities.c_str());
+}
+
+std::string dnet_config_get_localities(const dnet_config &config) {
+	return config.localities ? config.localities : "";
+}
+
 dnet_config& dnet_config_config(dnet_config &config) {
 	return config;
 }
@@ -160,6 +216,7 @@ class elliptics_node_python : public node, public bp::wrapper<node> {
 				std_remotes.emplace_back(get_host(), get_port(), get_family());
 			}
 
+			py_allow_threads_scoped pythr;
 			add_remote(std_remotes);
 		}
 };
@@ -280,6 +337,72 @@ void iterator_container_diff(iterator_result_container &left,
 void iterator_container_merge(const bp::list& /*results*/, bp::dict& /*splitted_dict*/)
 {}
 
+void iterator_merger_add(iterator_result_merger &merger, python_iterator_result &result)
+{
+	merger.add(*result.scope);
+}
+
+bp::list iterator_merger_next(iterator_result_merger &merger)
+{
+	std::vector<dnet_iterator_response> responses;
+	std::vector<size_t> indexes;
+	bool more;
+
+	{
+		py_allow_threads_scoped pythr;
+		more = merger.next(responses, indexes);
+	}
+
+	if (!more) {
+		PyErr_SetString(PyExc_StopIteration, "all iterator results are merged");
+		bp::throw_error_already_set();
+	}
+
+	bp::list ret;
+	for (size_t i = 0; i < responses.size(); ++i)
+		ret.append(bp::make_tuple(indexes[i], responses[i]));
+	return ret;
+}
+
+error iterator_merger_error(const iterator_result_merger &merger, size_t index)
+{
+	error_info err = merger.error(index);
+	return error(err.code(), err.message());
+}
+
+struct iterator_columns {
+	iterator_columns(python_iterator_result &result, size_t batch_size = 65536)
+	: columns(*result.scope), batch_size(batch_size) {}
+
+	iterator_result_columns columns;
+	size_t batch_size;
+};
+
+bp::dict iterator_columns_next(iterator_columns &columns)
+{
+	iterator_result_batch batch;
+	bool more;
+
+	{
+		py_allow_threads_scoped pythr;
+		more = columns.columns.next(batch, columns.batch_size);
+	}
+
+	if (!more) {
+		PyErr_SetString(PyExc_StopIteration, "all iterator results are read");
+		bp::throw_error_already_set();
+	}
+
+	bp::dict ret;
+	ret["count"] = batch.count;
+	ret["key"] = data_view(batch.keys);
+	ret["size"] = data_view(batch.sizes);
+	ret["timestamp"] = data_view(batch.timestamps);
+	ret["user_flags"] = data_view(batch.user_flags);
+	ret["record_flags"] = data_view(batch.record_flags);
+	return ret;
+}
+
 std::string get_cmd_string(int cmd) {
 	return std::string(dnet_cmd_string(cmd));
 }
@@ -343,6 +466,28 @@ BOOST_PYTHON_MODULE(core)
 		               "Number of IO threads in processing pool dedicated to nonblocking operations")
 		.def_readwrite("net_thread_num", &dnet_config::net_thread_num,
 		               "Number of threads in network processing pool")
+		.def_readwrite("connections_per_node", &dnet_config::connections_per_node,
+		               "Number of connections opened to every server node")
+		.def_readwrite("large_request_size", &dnet_config::large_request_size,
+		               "Requests of this size are sent via dedicated connection if there are several of them")
+		.add_property("route_cache_dir", &dnet_config_get_route_cache_dir, &dnet_config_set_route_cache_dir,
+		              "Existing directory where ids of server nodes are cached between connections,\n"
+		              "empty string disables the cache")
+		.add_property("local_socket_dir", &dnet_config_get_local_socket_dir, &dnet_config_set_local_socket_dir,
+		              "Directory of unix sockets of co-located servers, connections to them\n"
+		              "go through these sockets instead of TCP, empty string disables it")
+		.add_property("locality", &dnet_config_get_locality, &dnet_config_set_locality,
+		              "Locality label (datacenter, rack) of the node, reads prefer groups\n"
+		              "in this locality if elliptics.config_flags.locality_states is set")
+		.add_property("localities", &dnet_config_get_localities, &dnet_config_set_localities,
+		              "Localities of remote networks: 'dc-a=10.1.0.0/16;dc-b=10.2.0.0/16,fd02::/16'")
+		.def_readwrite("zerocopy_send_size", &dnet_config::zerocopy_send_size,
+		               "Minimal number of bytes sent at once with MSG_ZEROCOPY, 0 disables zero-copy sends")
+		.def_readwrite("connect_concurrency", &dnet_config::connect_concurrency,
+		               "Maximum number of connections established at once while adding remotes, 0 means no limit")
+		.def_readwrite("client_shards", &dnet_config::client_shards,
+		               "Number of client network threads which own connections to every server node\n"
+		               "and complete replies received through them, 0 disables sharding")
 		.def_readwrite("flags", &dnet_config::flags,
 		               "Bit set of elliptics.config_flags")
 		.def_readwrite("client_prio", &dnet_config::client_prio,
@@ -387,7 +532,18 @@ BOOST_PYTHON_MODULE(core)
                   "    to queue REMOVE command locally if remote write has succeeeded.\n"
 	    "overwrite\n    Overwrite data. If this flag is NOT set, we only write data if remote timestamp is less\n"
 	               "    than in data being written. When NOT set, data will still be transferred over the network,\n"
-		       "    even if remote timestamp doesn't allow us to overwrite data.")
+		       "    even if remote timestamp doesn't allow us to overwrite data.\n"
+	    "batch_replies\n    Server may pack many small iterator responses into single network reply.\n"
+	               "    Such iterator will be rejected by servers which do not support this flag.\n"
+	    "diff\n    Server-send iterator fetches metadata of the ranges from remote groups and sends\n"
+	               "    only keys which are missing or older there. Metadata is not sent to client.\n"
+	    "bulk_write\n    Server-send iterator packs small keys into bulk writes, every key is still acked separately.\n"
+	               "    Remote servers must support bulk write command.\n"
+	    "compact\n    Network iterator without data sends keys metadata in compressed batches.\n"
+	               "    Results are the same, client library unpacks them transparently.\n"
+	    "ordered\n    Network iterator without data sends keys sorted by key and timestamp,\n"
+	               "    so results of several nodes can be merged by elliptics.IteratorResultMerger.\n"
+	    "filter\n    Iterated records pass through record filters configured on the backend.")
 		.value("default", iflag_default)
 		.value("data", iflag_data)
 		.value("key_range", iflag_key_range)
@@ -395,15 +551,26 @@ BOOST_PYTHON_MODULE(core)
 		.value("no_meta", iflag_no_meta)
 		.value("move", iflags_move)
 		.value("overwrite", iflags_overwrite)
+		.value("batch_replies", iflags_batch_replies)
+		.value("diff", iflags_diff)
+		.value("bulk_write", iflags_bulk_write)
+		.value("compact", iflags_compact)
+		.value("ordered", iflags_ordered)
+		.value("filter", iflags_filter)
 	;
 
 	bp::enum_<elliptics_iterator_types>("iterator_types",
 	    "Flags which specifies how iteration results should be transmitted:\n\n"
 	    "disk\n    Iterator saves data chunks (index/metadata + (optionally) data)\n"
 	          "    locally on server to $root/iter/$id instead of sending chunks to client\n"
-	    "network\n    Iterator sends data chunks to client")
+	    "network\n    Iterator sends data chunks to client\n"
+	    "hash\n    Iterator sends hash of (key, timestamp, size) of records of every requested range\n"
+	          "    in response_data when iteration completes instead of sending keys\n"
+	    "filter\n    Iterator passes records to native filter on the node and sends only its results")
 		.value("disk", itype_disk)
 		.value("network", itype_network)
+		.value("hash", itype_hash)
+		.value("filter", itype_filter)
 	;
 
 	bp::enum_<elliptics_cflags>("command_flags",
@@ -413,12 +580,16 @@ BOOST_PYTHON_MODULE(core)
 	    "nolock\n    Server will not check the key is locked and will not lock it during this transaction.\n"
 	            "    The operation will be handled in separated io thread pool\n"
 	    "checksum\n  Only valid flag for LOOKUP command - when set, return checksum in file_info structure\n"
-	    "nocache\n   Currently only valid flag for LOOKUP command - when set, don't check fileinfo in cache\n")
+	    "nocache\n   Currently only valid flag for LOOKUP command - when set, don't check fileinfo in cache\n"
+	    "background\n Server processes request with lower priority than requests without this flag\n"
+	    "no_file_path\n Write and lookup results do not contain path of the file on the server\n")
 		.value("default", cflags_default)
 		.value("direct", cflags_direct)
 		.value("nolock", cflags_nolock)
 		.value("checksum", cflags_checksum)
 		.value("nocache", cflags_nocache)
+		.value("background", cflags_background)
+		.value("no_file_path", cflags_no_file_path)
 	;
 
 	bp::enum_<elliptics_ioflags>("io_flags",
@@ -439,7 +610,9 @@ BOOST_PYTHON_MODULE(core)
 		"cache_remove_from_disk\n    is set and object is being removed from cache,\n"
 		                        "    then remove object from disk too"
 		"cas_timestamp\n    When set, write will only succeed if data timestamp is higher than timestamp stored on disk\n"
-		"mix_states\n    Read request with this flag forces replica selection according to their weights\n")
+		"mix_states\n    Read request with this flag forces replica selection according to their weights\n"
+		"streaming\n    Read of large object which may be read by server bypassing page cache\n"
+		"filter\n    Read reply passes through record filters configured on the backend\n")
 
 		.value("default", ioflags_default)
 		.value("append", ioflags_append)
@@ -454,6 +627,9 @@ BOOST_PYTHON_MODULE(core)
 		.value("cache_remove_from_disk", ioflags_cache_remove_from_disk)
 		.value("cas_timestamp", ioflags_cas_timestamp)
 		.value("mix_states", ioflags_mix_states)
+		.value("streaming", ioflags_streaming)
+		.value("filter", ioflags_filter)
+		.value("compressed", ioflags_compressed)
 	;
 
 	bp::enum_<elliptics_record_flags>("record_flags",
@@ -470,6 +646,8 @@ BOOST_PYTHON_MODULE(core)
 		.value("exthdr", record_flags_exthdr)
 		.value("uncommitted", record_flags_uncommitted)
 		.value("chunked_csum", record_flags_chunked_csum)
+		.value("compressed", record_flags_compressed)
+		.value("dedup", record_flags_dedup)
 	;
 
 	bp::enum_<blackhole::defaults::severity>("log_level",
@@ -507,13 +685,21 @@ BOOST_PYTHON_MODULE(core)
 	    "no_route_list\n    Do not request route table from remote nodes\n"
 	    "mix_states\n    Mix states according to their weights before reading data\n"
 	    "no_csum\n    Globally disable checksum verification and update\n"
-	    "randomize_states\n    Randomize states for read requests\n\n"
+	    "randomize_states\n    Randomize states for read requests\n"
+	    "latency_states\n    Order states for read requests by their latency and load\n"
+	    "flat_indexes\n    Store secondary index tables in flat format searched in place\n"
+	    "locality_states\n    Read from groups in the same locality (datacenter, rack) first\n"
+	    "outlier_states\n    Read from backends ejected by outlier detection last\n\n"
 	    "config.flags = elliptics.config_flags.mix_stats | elliptics.config_flags.randomize_states\n"
 	    )
 		.value("no_route_list", config_flags_no_route_list)
 		.value("mix_states", config_flags_mix_states)
 		.value("no_csum", config_flags_no_csum)
 		.value("randomize_states", config_flags_randomize_states)
+		.value("latency_states", config_flags_latency_states)
+		.value("flat_indexes", config_flags_flat_indexes)
+		.value("locality_states", config_flags_locality_states)
+		.value("outlier_states", config_flags_outlier_states)
 	;
 
 	bp::enum_<elliptics_node_status_flags>("status_flags",
@@ -540,6 +726,39 @@ BOOST_PYTHON_MODULE(core)
 		.staticmethod("merge")
 	;
 
+	bp::class_<iterator_result_merger, boost::noncopyable>("IteratorResultMerger",
+	    "Merges results of iterators started with elliptics.iterator_flags.ordered while they are received.\n"
+	    "Every step returns list of (index, IteratorResultResponse) of the next smallest key,\n"
+	    "index is the number of the result in order of add() calls.\n\n"
+	    "    merger = elliptics.IteratorResultMerger()\n"
+	    "    for result in results:\n"
+	    "        merger.add(result)\n"
+	    "    for responses in merger:\n"
+	    "        missing = set(range(len(results))) - set(index for index, response in responses)\n")
+		.def("add", iterator_merger_add, bp::args("result"),
+		    "add(result)\n"
+		    "    Adds elliptics.AsyncResult of ordered iterator to the merge")
+		.def("__iter__", bp::objects::identity_function())
+		.def("next", iterator_merger_next)
+		.def("error", iterator_merger_error, bp::args("index"),
+		    "error(index)\n"
+		    "    Returns elliptics.ErrorInfo of result @index, failed result isn't merged since the failure")
+	;
+
+	bp::class_<iterator_columns, boost::noncopyable>("IteratorResultColumns",
+	    "Reads key metadata of iterator result into columnar batches while it is received.\n"
+	    "Every step returns dict of 'count' and read-only memoryviews of 'count' values each:\n"
+	    "'key' - id_size bytes per key, 'size', 'user_flags', 'record_flags' - uint64,\n"
+	    "'timestamp' - int64 nanoseconds. Views reference batch buffers without copying,\n"
+	    "so they may be wrapped by numpy.frombuffer() or pyarrow.py_buffer() directly.\n\n"
+	    "    for batch in elliptics.IteratorResultColumns(iterator, 65536):\n"
+	    "        sizes = numpy.frombuffer(batch['size'], dtype=numpy.uint64)\n",
+	    bp::init<python_iterator_result &, bp::optional<size_t>>(bp::args("result", "batch_size")))
+		.def("__iter__", bp::objects::identity_function())
+		.def("next", iterator_columns_next)
+		.def("__next__", iterator_columns_next)
+	;
+
 	init_elliptics_id();
 	init_async_results();
 	init_result_entry();
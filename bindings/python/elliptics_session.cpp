@@ -67,13 +67,19 @@ enum elliptics_monitor_categories {
 	elliptics_monitor_categories_stats = DNET_MONITOR_STATS,
 	elliptics_monitor_categories_procfs = DNET_MONITOR_PROCFS,
 	elliptics_monitor_categories_top = DNET_MONITOR_TOP,
+	elliptics_monitor_categories_slow = DNET_MONITOR_SLOW,
+	elliptics_monitor_categories_locks = DNET_MONITOR_LOCKS,
+	elliptics_monitor_categories_heatmap = DNET_MONITOR_HEATMAP,
 	elliptics_monitor_categories_all = DNET_MONITOR_CACHE |
 	                                   DNET_MONITOR_IO |
 	                                   DNET_MONITOR_COMMANDS |
 	                                   DNET_MONITOR_BACKEND |
 	                                   DNET_MONITOR_STATS |
 	                                   DNET_MONITOR_PROCFS |
-	                                   DNET_MONITOR_TOP
+	                                   DNET_MONITOR_TOP |
+	                                   DNET_MONITOR_SLOW |
+	                                   DNET_MONITOR_LOCKS |
+	                                   DNET_MONITOR_HEATMAP
 };
 
 struct write_cas_converter {
@@ -298,30 +304,38 @@ public:
 		session::set_checker(res);
 	}
 
-	void read_file(const bp::api::object &id, const std::string &file, uint64_t offset, uint64_t size) {
-		py_allow_threads_scoped pythr;
-
+	void read_file(const bp::api::object &id, const std::string &file, uint64_t offset, uint64_t size,
+			uint64_t chunk_size, size_t window) {
 		bp::extract<elliptics_io_attr&> get_io_attr(id);
-		if (!get_io_attr.check())
-			return session::read_file(transform(id).id(), file, offset, size);
+		if (!get_io_attr.check()) {
+			key k = transform(id).id();
+			py_allow_threads_scoped pythr;
+			return session::read_file(k, file, offset, size, chunk_size, window);
+		}
 
 		elliptics_io_attr &io_attr = get_io_attr;
 		transform_io_attr(io_attr);
 
-		return session::read_file(io_attr.id.id(), file, io_attr.offset, io_attr.size);
-	}
-
-	void write_file(const bp::api::object &id, const std::string &file, uint64_t local_offset, uint64_t offset, uint64_t size) {
+		key k = io_attr.id.id();
 		py_allow_threads_scoped pythr;
+		return session::read_file(k, file, io_attr.offset, io_attr.size, chunk_size, window);
+	}
 
+	void write_file(const bp::api::object &id, const std::string &file, uint64_t local_offset, uint64_t offset, uint64_t size,
+			uint64_t chunk_size, size_t window) {
 		bp::extract<elliptics_io_attr&> get_io_attr(id);
-		if (!get_io_attr.check())
-			return session::write_file(transform(id).id(), file, local_offset, offset, size);
+		if (!get_io_attr.check()) {
+			key k = transform(id).id();
+			py_allow_threads_scoped pythr;
+			return session::write_file(k, file, local_offset, offset, size, chunk_size, window);
+		}
 
 		elliptics_io_attr &io_attr = get_io_attr;
 		transform_io_attr(io_attr);
 
-		return session::write_file(io_attr.id.id(), file, local_offset, io_attr.offset, io_attr.size);
+		key k = io_attr.id.id();
+		py_allow_threads_scoped pythr;
+		return session::write_file(k, file, local_offset, io_attr.offset, io_attr.size, chunk_size, window);
 	}
 
 	python_read_result read_data(const bp::api::object &id, uint64_t offset, uint64_t size) {
@@ -382,18 +396,21 @@ public:
 		return create_result(std::move(session::write_data(io_attr, data_pointer::copy(data))));
 	}
 
-	python_write_result write_data_by_chunks(const bp::api::object &id, const std::string &data, uint64_t offset, uint64_t chunk_size) {
+	python_write_result write_data_by_chunks(const bp::api::object &id, const std::string &data, uint64_t offset,
+			uint64_t chunk_size, size_t window) {
 		if (chunk_size == 0)
 			return write_data(id, data, offset);
 
 		bp::extract<elliptics_io_attr&> get_io_attr(id);
 		if (!get_io_attr.check())
-			return create_result(std::move(session::write_data(transform(id).id(), data_pointer::copy(data), offset, chunk_size)));
+			return create_result(std::move(session::write_data(transform(id).id(), data_pointer::copy(data), offset,
+							chunk_size, window)));
 
 		elliptics_io_attr &io_attr = get_io_attr;
 		transform_io_attr(io_attr);
 
-		return create_result(std::move(session::write_data(io_attr.id.id(), data_pointer::copy(data), io_attr.offset, chunk_size)));
+		return create_result(std::move(session::write_data(io_attr.id.id(), data_pointer::copy(data), io_attr.offset,
+						chunk_size, window)));
 	}
 
 	python_write_result write_cas(const bp::api::object &id, const std::string &data, const elliptics_id &old_csum, uint64_t remote_offset) {
@@ -408,6 +425,27 @@ public:
 		                     count)));
 	}
 
+	python_write_result atomic_append(const bp::api::object &id, const std::string &data, const bp::api::object &version) {
+		if (version.ptr() == Py_None)
+			return create_result(std::move(session::atomic_append(transform(id).id(), data_pointer::copy(data))));
+
+		elliptics_time &ts = bp::extract<elliptics_time&>(version);
+		return create_result(std::move(session::atomic_append(transform(id).id(), data_pointer::copy(data), &ts.m_time)));
+	}
+
+	python_write_result atomic_increment(const bp::api::object &id, int64_t delta) {
+		return create_result(std::move(session::atomic_increment(transform(id).id(), delta)));
+	}
+
+	python_write_result atomic_json_merge(const bp::api::object &id, const std::string &patch) {
+		return create_result(std::move(session::atomic_json_merge(transform(id).id(), data_pointer::copy(patch))));
+	}
+
+	python_write_result atomic_filter(const bp::api::object &id, const std::string &filter, const std::string &arg) {
+		return create_result(std::move(session::atomic_update(transform(id).id(), DNET_ATOMIC_FILTER,
+						data_pointer::copy(arg), filter)));
+	}
+
 	python_write_result write_prepare(const bp::api::object &id, const std::string &data, uint64_t remote_offset, uint64_t psize) {
 		return create_result(std::move(session::write_prepare(transform(id).id(), data_pointer::copy(data), remote_offset, psize)));
 	}
@@ -445,6 +483,10 @@ public:
 		return create_result(std::move(session::disable_backend(address(host, port, family), backend_id)));
 	}
 
+	python_backend_status_result reload_backend(const std::string &host, int port, int family, uint32_t backend_id) {
+		return create_result(std::move(session::reload_backend(address(host, port, family), backend_id)));
+	}
+
 	python_backend_status_result start_defrag(const std::string &host, int port, int family, uint32_t backend_id) {
 		return create_result(std::move(session::start_defrag(address(host, port, family), backend_id)));
 	}
@@ -477,6 +519,60 @@ public:
 		);
 	}
 
+	python_backend_status_result set_faults(const std::string &host, int port, int family,
+	                                        uint32_t backend_id, const bp::api::object &rules) {
+		std::vector<dnet_fault_rule> std_rules;
+		std_rules.reserve(bp::len(rules));
+
+		for (bp::stl_input_iterator<bp::dict> it(rules), end; it != end; ++it) {
+			const bp::dict &rule = *it;
+			dnet_fault_rule value;
+			memset(&value, 0, sizeof(value));
+
+			value.cmd = bp::extract<uint32_t>(rule.get("cmd", 0));
+			value.probability = bp::extract<uint32_t>(rule.get("probability", DNET_FAULT_PROBABILITY_MAX));
+			value.error = bp::extract<int32_t>(rule.get("error", 0));
+			value.distribution = bp::extract<uint32_t>(rule.get("distribution", int(DNET_FAULT_DELAY_FIXED)));
+			value.delay_min = bp::extract<uint64_t>(rule.get("delay_min", 0));
+			value.delay_max = bp::extract<uint64_t>(rule.get("delay_max", 0));
+			std_rules.push_back(value);
+		}
+
+		return create_result(session::set_faults(address(host, port, family), backend_id, std_rules));
+	}
+
+	python_backend_status_result set_background_rate(const std::string &host, int port, int family,
+	                                                 uint32_t backend_id,
+	                                                 uint64_t rate_bytes,
+	                                                 uint64_t rate_keys) {
+		return create_result(
+			session::set_background_rate(address(host, port, family),
+			                             backend_id,
+			                             rate_bytes,
+			                             rate_keys)
+		);
+	}
+
+	python_backend_status_result resize_cache(const std::string &host, int port, int family,
+	                                          uint32_t backend_id,
+	                                          uint64_t size,
+	                                          const bp::api::object &pages_proportions) {
+		std::vector<uint32_t> std_proportions;
+		for (bp::stl_input_iterator<uint32_t> it(pages_proportions), end; it != end; ++it)
+			std_proportions.push_back(*it);
+
+		return create_result(session::resize_cache(address(host, port, family), backend_id,
+		                                           size, std_proportions));
+	}
+
+	void set_background_rate_bytes(uint64_t rate_bytes) {
+		session::set_background_rate(rate_bytes, get_background_rate_keys());
+	}
+
+	void set_background_rate_keys(uint64_t rate_keys) {
+		session::set_background_rate(get_background_rate_bytes(), rate_keys);
+	}
+
 	python_backend_status_result request_backends_status(const std::string &host, int port, int family) {
 		return create_result(std::move(session::request_backends_status(address(host, port, family))));
 	}
@@ -523,6 +619,35 @@ public:
 		return create_result(std::move(session::start_copy_iterator(transform(id).id(), std_ranges, flags, time_begin.m_time, time_end.m_time, std_dst_groups)));
 	}
 
+	python_iterator_result start_changes_iterator(const bp::api::object &id, const bp::api::object &ranges,
+	                                              uint64_t since, uint64_t flags = 0) {
+		auto std_ranges = convert_to_vector<dnet_iterator_range>(ranges);
+
+		return create_result(std::move(session::start_changes_iterator(transform(id).id(), std_ranges, flags, since)));
+	}
+
+	python_iterator_result start_resumable_iterator(const bp::api::object &id, const bp::api::object &ranges,
+	                                                uint64_t flags,
+	                                                const elliptics_time& time_begin = elliptics_time(0, 0),
+	                                                const elliptics_time& time_end = elliptics_time(-1, -1),
+	                                                const std::string &checkpoint = std::string()) {
+		auto std_ranges = convert_to_vector<dnet_iterator_range>(ranges);
+
+		return create_result(std::move(session::start_resumable_iterator(transform(id).id(), std_ranges, flags,
+				time_begin.m_time, time_end.m_time, data_pointer::copy(checkpoint))));
+	}
+
+	python_iterator_result start_filter_iterator(const bp::api::object &id, const bp::api::object &ranges,
+	                                             const std::string &filter, const std::string &arg = std::string(),
+	                                             uint64_t flags = 0,
+	                                             const elliptics_time& time_begin = elliptics_time(0, 0),
+	                                             const elliptics_time& time_end = elliptics_time(-1, -1)) {
+		auto std_ranges = convert_to_vector<dnet_iterator_range>(ranges);
+
+		return create_result(std::move(session::start_filter_iterator(transform(id).id(), std_ranges,
+				filter, data_pointer::copy(arg), flags, time_begin.m_time, time_end.m_time)));
+	}
+
 	python_iterator_result pause_iterator(const bp::api::object &id, const uint64_t &iterator_id) {
 		return create_result(std::move(session::pause_iterator(transform(id).id(), iterator_id)));
 	}
@@ -831,7 +956,10 @@ void init_elliptics_session() {
 		"backend\n    Category for backend statistics\n"
 		"stats\n    Category for in-process runtime statistics\n"
 		"procfs\n    Category for system statistics about process\n"
-		"top\n    Category for statistics of top keys ordered by generated traffic\n")
+		"top\n    Category for statistics of top keys ordered by generated traffic\n"
+		"slow\n    Category for the most recent slow requests of every backend\n"
+		"locks\n    Category for wait and hold times of core locks\n"
+		"heatmap\n    Category for requests and bytes of key ranges of every backend\n")
 		.value("all", elliptics_monitor_categories_all)
 		.value("cache", elliptics_monitor_categories_cache)
 		.value("io", elliptics_monitor_categories_io)
@@ -840,6 +968,9 @@ void init_elliptics_session() {
 		.value("stats", elliptics_monitor_categories_stats)
 		.value("procfs", elliptics_monitor_categories_procfs)
 		.value("top", elliptics_monitor_categories_top)
+		.value("slow", elliptics_monitor_categories_slow)
+		.value("locks", elliptics_monitor_categories_locks)
+		.value("heatmap", elliptics_monitor_categories_heatmap)
 	;
 
 	bp::enum_<exec_context::final_state>("exec_context_final_states",
@@ -989,6 +1120,24 @@ void init_elliptics_session() {
 		.def("set_timeout", &elliptics_session::set_timeout)
 		.def("get_timeout", &elliptics_session::get_timeout)
 
+		.add_property("iterator_threads",
+		              &elliptics_session::get_iterator_threads,
+		              &elliptics_session::set_iterator_threads,
+		    "Number of parallel workers of iterators started by the session\n"
+		    "Results of different workers are interleaved, 0 and 1 mean single thread\n\n"
+		    "session.iterator_threads = 4")
+
+		.add_property("background_rate_bytes",
+		              &elliptics_session::get_background_rate_bytes,
+		              &elliptics_session::set_background_rate_bytes,
+		    "Bytes per second of every iterator and server-send started by the session, 0 - unlimited\n\n"
+		    "session.background_rate_bytes = 10 * 1024 * 1024")
+		.add_property("background_rate_keys",
+		              &elliptics_session::get_background_rate_keys,
+		              &elliptics_session::set_background_rate_keys,
+		    "Keys per second of every iterator and server-send started by the session, 0 - unlimited\n\n"
+		    "session.background_rate_keys = 1000")
+
 		.add_property("routes", &elliptics_session::get_routes,
 		     "routes\n"
 		     "    Returns current routes table\n\n"
@@ -1038,14 +1187,17 @@ void init_elliptics_session() {
 
 		.def("read_file", &elliptics_session::read_file,
 		     (bp::arg("key"), bp::arg("filename"),
-		      bp::arg("offset") = 0, bp::arg("size") = 0),
-		    "read_file(key, filename, offset=0, size=0)\n"
+		      bp::arg("offset") = 0, bp::arg("size") = 0,
+		      bp::arg("chunk_size") = 0, bp::arg("window") = 1),
+		    "read_file(key, filename, offset=0, size=0, chunk_size=0, window=1)\n"
 		    "    Reads object by the key and writes it to the specified file.\n"
 		    "    The operation is asynchronous with nothing returns\n"
 		    "    -- key - string or elliptics.Id, or elliptics.IoAttr\n"
 		    "    -- filename - file path where read object will be written\n"
 		    "    -- offset - offset from which object data should be read\n"
-		    "    -- size - number of bytes to be read. If size equal ot 0 then the full object will be read\n\n"
+		    "    -- size - number of bytes to be read. If size equal ot 0 then the full object will be read\n"
+		    "    -- chunk_size - if not 0, object is read by chunks of this size\n"
+		    "    -- window - number of chunks read in parallel\n\n"
 		    "    session.read_file('key', '/path/to/file', 0, 0)\n"
 		    "    session.read_file('key1', '/path/to/file1', 10, 100)\n")
 
@@ -1162,15 +1314,18 @@ void init_elliptics_session() {
 
 		.def("write_file", &elliptics_session::write_file,
 		     (bp::arg("key"), bp::arg("filename"), bp::arg("offset") = 0,
-		      bp::arg("local_offset") = 0, bp::arg("size") = 0),
-		    "write_file(key, filename, offset=0, local_offset=0, size=0)\n"
+		      bp::arg("local_offset") = 0, bp::arg("size") = 0,
+		      bp::arg("chunk_size") = 0, bp::arg("window") = 1),
+		    "write_file(key, filename, offset=0, local_offset=0, size=0, chunk_size=0, window=1)\n"
 		    "    Writes data from file @filename by the key, offsets and size\n"
 		    "    -- key - string or elliptics.Id, or elliptics.IoAttr\n"
 		    "    -- filename - path to data which should be written to the key\n"
 		    "    -- offset - offset with which data should be written\n"
 		    "    -- local_offset - offset with which data should be read from @filename\n"
 		    "    -- size - number of bytes to be read from @filename and to be written to @key.\n"
-		    "        If it equal to 0 then full size will be read and written.\n\n"
+		    "        If it equal to 0 then full size will be read and written.\n"
+		    "    -- chunk_size - if not 0, file is written by chunks of this size\n"
+		    "    -- window - number of chunks written in parallel\n\n"
 		    "    session.write_file('key', '/path/to/file')")
 
 		.def("write_data", &elliptics_session::write_data,
@@ -1197,13 +1352,14 @@ void init_elliptics_session() {
 
 		.def("write_data", &elliptics_session::write_data_by_chunks,
 		     (bp::arg("key"), bp::arg("data"),
-		      bp::arg("offset")=0, bp::arg("chunk_size")=0),
-		    "write_data(key, data, offset=0, chunk_size=0)\n"
+		      bp::arg("offset")=0, bp::arg("chunk_size")=0, bp::arg("window")=1),
+		    "write_data(key, data, offset=0, chunk_size=0, window=1)\n"
 		    "    Writes @data splitted to pieces of @chunk_size to @key with @offset. Returns elliptics.AsyncResult\n"
 		    "    -- key - string or elliptics.Id, or elliptics.IoAttr\n"
 		    "    -- data - string data\n"
 		    "    -- offset - offset with which data should be written\n"
-		    "    -- chunk_size - maximum size of one chunk\n\n"
+		    "    -- chunk_size - maximum size of one chunk\n"
+		    "    -- window - number of chunks written in parallel\n\n"
 		    "    write_results = []\n"
 		    "    try:\n"
 		    "        result = session.write_data('key', 'key_data', 0, 3)\n"
@@ -1271,6 +1427,47 @@ void init_elliptics_session() {
 		    "        print 'timestamp:', write_result.tiemstamp\n"
 		    "        print 'filepath:', write_result.filepath\n")
 
+		.def("atomic_append", &elliptics_session::atomic_append,
+		     (bp::arg("key"), bp::arg("data"), bp::arg("version") = bp::api::object()),
+		    "atomic_append(key, data, version=None)\n"
+		    "    Appends @data to @key on the server while the key is locked.\n"
+		    "    If @version is set, append fails with -EBADFD unless timestamp of @key equals it.\n"
+		    "    Returns elliptics.AsyncResult.\n"
+		    "    -- key - string or elliptics.Id\n"
+		    "    -- data - string data\n"
+		    "    -- version - elliptics.Time, empty one matches missing key\n\n"
+		    "    result = session.lookup('key').get()[0]\n"
+		    "    session.atomic_append('key', 'tail', result.timestamp).wait()\n")
+
+		.def("atomic_increment", &elliptics_session::atomic_increment,
+		     (bp::arg("key"), bp::arg("delta")),
+		    "atomic_increment(key, delta)\n"
+		    "    Adds @delta to 8-byte little-endian counter @key on the server,\n"
+		    "    missing key is created with value @delta. Returns elliptics.AsyncResult.\n"
+		    "    -- key - string or elliptics.Id\n"
+		    "    -- delta - signed 64-bit integer\n\n"
+		    "    session.atomic_increment('counter', 1).wait()\n"
+		    "    value = struct.unpack('<q', session.read_data('counter').get()[0].data)[0]\n")
+
+		.def("atomic_json_merge", &elliptics_session::atomic_json_merge,
+		     (bp::arg("key"), bp::arg("patch")),
+		    "atomic_json_merge(key, patch)\n"
+		    "    Applies JSON merge patch (RFC 7386) @patch to JSON document @key on the server,\n"
+		    "    missing key is an empty document. Returns elliptics.AsyncResult.\n"
+		    "    -- key - string or elliptics.Id\n"
+		    "    -- patch - JSON object as a string\n\n"
+		    "    session.atomic_json_merge('doc', '{\"views\": 10, \"draft\": null}').wait()\n")
+
+		.def("atomic_filter", &elliptics_session::atomic_filter,
+		     (bp::arg("key"), bp::arg("filter"), bp::arg("arg")),
+		    "atomic_filter(key, filter, arg)\n"
+		    "    Updates @key on the server by native update filter @filter\n"
+		    "    loaded from iterator_filter_dir of the server. Returns elliptics.AsyncResult.\n"
+		    "    -- key - string or elliptics.Id\n"
+		    "    -- filter - name of the filter library without .so\n"
+		    "    -- arg - opaque string argument of the filter\n\n"
+		    "    session.atomic_filter('key', 'capped_list', '100').wait()\n")
+
 		.def("write_prepare", &elliptics_session::write_prepare,
 		     (bp::arg("key"), bp::arg("data"),
 		      bp::arg("remote_offset"), bp::arg("psize")),
@@ -1431,6 +1628,15 @@ void init_elliptics_session() {
 		     "    Returns AsyncResult which provides new status of the backend\n\n"
 		     "    new_status = session.disable_backend(elliptics.Address.from_host_port_family(host='host.com', port=1025, family=AF_INET), 0).get()[0].backends[0]")
 
+		.def("reload_backend", &elliptics_session::reload_backend,
+		     (bp::arg("host"), bp::arg("port"), bp::arg("family"), bp::arg("backend_id")),
+		     "reload_backend(host, port, family, backend_id)\n"
+		     "    Reopens storage of backend @backend_id at node addressed by @host, @port, @family\n"
+		     "    with options re-read from config file. Requests wait while storage is reopened,\n"
+		     "    cache and io pools of the backend are kept.\n"
+		     "    Returns AsyncResult which provides new status of the backend\n\n"
+		     "    new_status = session.reload_backend(elliptics.Address.from_host_port_family(host='host.com', port=1025, family=AF_INET), 0).get()[0].backends[0]")
+
 		.def("start_defrag", &elliptics_session::start_defrag,
 		     (bp::arg("host"), bp::arg("port"), bp::arg("family"), bp::arg("backend_id")),
 		     "start_defrag(host, port, family, backend_id)\n"
@@ -1472,6 +1678,40 @@ void init_elliptics_session() {
 		     "    delay = new_state.delay"
 		)
 
+		.def("set_faults", &elliptics_session::set_faults,
+		     (bp::arg("host"), bp::arg("port"), bp::arg("family"), bp::arg("backend_id"), bp::arg("rules")),
+		     "set_faults(host, port, family, backend_id, rules)\n"
+		     "    Replaces fault injection rules of backend @backend_id on node addressed by @host, @port, @family.\n"
+		     "    Every rule is a dict with optional keys: cmd (0 - every command), probability (in millionths,\n"
+		     "    1000000 by default), error (negative errno), distribution (0 - fixed, 1 - uniform, 2 - exponential),\n"
+		     "    delay_min and delay_max (usecs). The first rule which fires delays the request and replies its error.\n"
+		     "    Empty list removes all rules. Returns AsyncResult which provides new status of the backend\n\n"
+		     "    session.set_faults(host='host.com', port=1025, family=AF_INET, backend_id=0,\n"
+		     "                       rules=[{'cmd': elliptics.command.read, 'probability': 10000, 'delay_min': 50000}])"
+		)
+
+		.def("set_background_rate", &elliptics_session::set_background_rate,
+		     (bp::arg("host"), bp::arg("port"), bp::arg("family"), bp::arg("backend_id"),
+		      bp::arg("rate_bytes") = 0, bp::arg("rate_keys") = 0),
+		     "set_background_rate(host, port, family, backend_id, rate_bytes=0, rate_keys=0)\n"
+		     "    Limits bytes and keys per second of all iterators and server-sends\n"
+		     "    running at backend @backend_id on node addressed by @host, @port, @family.\n"
+		     "    Zero means no limit. Returns AsyncResult which provides new status of the backend\n\n"
+		     "    session.set_background_rate(host='host.com', port=1025, family=AF_INET, backend_id=0,\n"
+		     "                                rate_bytes=100 * 1024 * 1024).wait()"
+		)
+
+		.def("resize_cache", &elliptics_session::resize_cache,
+		     (bp::arg("host"), bp::arg("port"), bp::arg("family"), bp::arg("backend_id"),
+		      bp::arg("size"), bp::arg("pages_proportions") = bp::list()),
+		     "resize_cache(host, port, family, backend_id, size, pages_proportions=[])\n"
+		     "    Changes size of the cache of backend @backend_id on node addressed by @host, @port, @family\n"
+		     "    and proportions of its pages, empty list keeps current ones. Cached objects are kept,\n"
+		     "    shrinking pages are evicted gradually. Returns AsyncResult which provides new status of the backend\n\n"
+		     "    session.resize_cache(host='host.com', port=1025, family=AF_INET, backend_id=0,\n"
+		     "                         size=1024 * 1024 * 1024, pages_proportions=[1, 2]).wait()"
+		)
+
 		.def("request_backends_status", &elliptics_session::request_backends_status,
 		     (bp::arg("host"), bp::arg("port"), bp::arg("family")),
 		     "request_backends_status(host, port, family)\n"
@@ -1599,6 +1839,65 @@ void init_elliptics_session() {
 		    "                       result.response.timestamp.tnsec,\n"
 		    "                       result.response_data))\n")
 
+		.def("start_changes_iterator", &elliptics_session::start_changes_iterator,
+		     (bp::arg("id"), bp::arg("ranges"), bp::arg("since"), bp::arg("flags") = 0),
+		    "start_changes_iterator(id, ranges, since, flags=0)\n"
+		    "    Iterates writes and removals made on the backend specified by @id after @since\n"
+		    "    in order of changes. Backend must be configured with change_log. Return elliptics.AsyncResult.\n"
+		    "    -- id - elliptics.Id of the node where iteration should be executed\n"
+		    "    -- ranges - list of elliptics.IteratorRange by which keys should be filtered\n"
+		    "    -- since - microseconds, result.response.change_time of the last result is @since for the next call\n"
+		    "    -- flags - bits set of elliptics.iterator_flags\n\n"
+		    "    Iterator fails with -ERANGE if some changes after @since have been dropped from the log,\n"
+		    "    then full iteration is needed. Zero @since iterates all changes kept in the log.\n\n"
+		    "    cursor = 0\n"
+		    "    for result in session.start_changes_iterator(id, [], cursor):\n"
+		    "        if result.response.status == 0:\n"
+		    "            cursor = result.response.change_time\n")
+
+		.def("start_resumable_iterator", &elliptics_session::start_resumable_iterator,
+		     (bp::arg("id"), bp::arg("ranges"), bp::arg("flags"),
+		      bp::arg("time_begin") = elliptics_time(0, 0),
+		      bp::arg("time_end") = elliptics_time(-1, -1),
+		      bp::arg("checkpoint") = std::string()),
+		    "start_resumable_iterator(id, ranges, flags, time_begin, time_end, checkpoint='')\n"
+		    "    Starts single-threaded network iterator on the node specified by @id which periodically\n"
+		    "    returns results with response.status equal to 2, their response_data is a checkpoint:\n"
+		    "    all keys before it have been returned already. Return elliptics.AsyncResult.\n"
+		    "    -- id - elliptics.Id of the node where iteration should be executed\n"
+		    "    -- ranges - list of elliptics.IteratorRange by which keys should be filtered\n"
+		    "    -- flags - bits set of elliptics.iterator_flags\n"
+		    "    -- time_begin - start of time range by which keys should be filtered\n"
+		    "    -- time_end - end of time range by which keys should be filtered\n"
+		    "    -- checkpoint - response_data of the last checkpoint, iteration with the same arguments\n"
+		    "                    continues after it, empty string starts from the beginning\n\n"
+		    "    Iterator fails with -ESTALE if checkpoint is not valid anymore.\n\n"
+		    "    checkpoint = ''\n"
+		    "    for result in session.start_resumable_iterator(id, [], elliptics.iterator_flags.default,\n"
+		    "                                                   checkpoint=checkpoint):\n"
+		    "        if result.response.status == 2:\n"
+		    "            checkpoint = result.response_data\n")
+
+		.def("start_filter_iterator", &elliptics_session::start_filter_iterator,
+		     (bp::arg("id"), bp::arg("ranges"), bp::arg("filter"), bp::arg("arg") = std::string(),
+		      bp::arg("flags") = 0,
+		      bp::arg("time_begin") = elliptics_time(0, 0),
+		      bp::arg("time_end") = elliptics_time(-1, -1)),
+		    "start_filter_iterator(id, ranges, filter, arg='', flags=0, time_begin, time_end)\n"
+		    "    Runs native @filter from iterator_filter_dir of the node specified by @id over its records\n"
+		    "    and returns only results emitted by the filter. Return elliptics.AsyncResult.\n"
+		    "    -- id - elliptics.Id of the node where iteration should be executed\n"
+		    "    -- ranges - list of elliptics.IteratorRange by which keys should be filtered\n"
+		    "    -- filter - name of the filter library without .so suffix\n"
+		    "    -- arg - string passed to filter's init() as is\n"
+		    "    -- flags - bits set of elliptics.iterator_flags\n"
+		    "    -- time_begin - start of time range by which keys should be filtered\n"
+		    "    -- time_end - end of time range by which keys should be filtered\n\n"
+		    "    Results with response.status equal to 1 are keepalives.\n\n"
+		    "    for result in session.start_filter_iterator(id, [], 'grep', 'pattern'):\n"
+		    "        if result.response.status == 0:\n"
+		    "            print result.response.key, result.response_data\n")
+
 		.def("pause_iterator", &elliptics_session::pause_iterator,
 		     bp::args("id", "iterator_id"),
 		    "pause_iterator(id, iterator_id)\n"
@@ -24,6 +24,7 @@
 #include "elliptics_id.h"
 #include "elliptics_time.h"
 #include "elliptics_io_attr.h"
+#include "data_view.h"
 #include "py_converters.h"
 
 namespace bp = boost::python;
@@ -60,6 +61,11 @@ std::string iterator_result_response_data(iterator_result_entry result)
 	return result.reply_data().to_string();
 }
 
+bp::object iterator_result_response_data_view(iterator_result_entry result)
+{
+	return data_view(result.reply_data());
+}
+
 static elliptics_id iterator_response_get_key(dnet_iterator_response *response) {
 	return elliptics_id(response->key);
 }
@@ -73,6 +79,11 @@ std::string read_result_get_data(read_result_entry &result)
 	return result.file().to_string();
 }
 
+bp::object read_result_get_data_view(read_result_entry &result)
+{
+	return data_view(result.file());
+}
+
 elliptics_id read_result_get_id(read_result_entry &result)
 {
 	dnet_raw_id id;
@@ -224,6 +235,11 @@ std::string callback_result_data(callback_result_entry &result)
 	return result.data().to_string();
 }
 
+bp::object callback_result_data_view(callback_result_entry &result)
+{
+	return data_view(result.data());
+}
+
 std::string callback_entry_address(const callback_result_entry &result)
 {
 	return dnet_addr_string(result.address());
@@ -267,6 +283,14 @@ elliptics_time dnet_backend_status_get_last_start(const dnet_backend_status &res
 	return elliptics_time(result.last_start);
 }
 
+elliptics_time dnet_backend_status_get_activation_start(const dnet_backend_status &result) {
+	return elliptics_time(result.activation_start);
+}
+
+uint32_t dnet_backend_status_get_activation_stage(const dnet_backend_status &result) {
+	return result.activation_stage;
+}
+
 bool dnet_backend_status_get_read_only(const dnet_backend_status &result) {
 	return bool(result.read_only);
 }
@@ -289,6 +313,8 @@ void init_result_entry() {
 		.add_property("is_final", callback_result_is_final)
 		.add_property("status", callback_result_status)
 		.add_property("data", callback_result_data)
+		.add_property("data_view", callback_result_data_view,
+		              "Read-only memoryview over reply data, it doesn't copy the data")
 		.add_property("size", callback_result_size)
 		.add_property("error", callback_result_error)
 		.add_property("address", callback_entry_address)
@@ -316,6 +342,8 @@ void init_result_entry() {
 		              "elliptics.IteratorResultResponse which provides meta information about iterated key")
 		.add_property("response_data", iterator_result_response_data,
 		              "Data of iterated key. May be empty if elliptics.iterator_flags.data hasn't been specified for iteration.")
+		.add_property("response_data_view", iterator_result_response_data_view,
+		              "Read-only memoryview over data of iterated key, it doesn't copy the data")
 	;
 
 	bp::class_<dnet_iterator_response>("IteratorResultResponse",
@@ -338,11 +366,16 @@ void init_result_entry() {
 		              "1 - keepalive response")
 		.add_property("record_flags", &dnet_iterator_response::flags,
 		              "Backend's flags of the record")
+		.add_property("change_time", &dnet_iterator_response::change_time,
+		              "Microseconds when the change was made, set by changes iterator only")
 	;
 
 	bp::class_<read_result_entry, bp::bases<callback_result_entry> >("ReadResultEntry")
 		.add_property("data", read_result_get_data,
 		              "Read data")
+		.add_property("data_view", read_result_get_data_view,
+		              "Read-only memoryview over read data, it doesn't copy the data.\n"
+		              "Use it instead of data for large objects, bytes(entry.data_view) makes a copy")
 		.add_property("id", read_result_get_id,
 		              "elliptics.Id of read object")
 		.add_property("timestamp", read_result_get_timestamp,
@@ -419,6 +452,11 @@ void init_result_entry() {
 		.add_property("last_start", dnet_backend_status_get_last_start)
 		.add_property("last_start_err", &dnet_backend_status::last_start_err)
 		.add_property("read_only", dnet_backend_status_get_read_only)
+		.add_property("activation_stage", dnet_backend_status_get_activation_stage)
+		.add_property("activation_start", dnet_backend_status_get_activation_start)
+		.add_property("delay", &dnet_backend_status::delay)
+		.add_property("faults_count", &dnet_backend_status::faults_count)
+		.add_property("cache_size", &dnet_backend_status::cache_size)
 	;
 
 }
@@ -17,13 +17,14 @@ from __future__ import absolute_import
 
 from elliptics.core import ErrorInfo, Logger, iterator_flags, monitor_stat_categories
 from elliptics.core import iterator_types, command_flags, io_flags, log_level, record_flags
-from elliptics.core import exceptions_policy, config_flags, IteratorResultContainer
+from elliptics.core import exceptions_policy, config_flags, IteratorResultContainer, IteratorResultMerger
+from elliptics.core import IteratorResultColumns
 from elliptics.core import Time, IoAttr, status_flags, Range, IteratorRange
 from elliptics.core import Error, NotFoundError, TimeoutError, filters, checkers
 from elliptics.route import Address, Route, RouteList
 from elliptics.session import Session
 from elliptics.node import Node
-from elliptics.misc import create_node
+from elliptics.misc import create_node, future
 from elliptics.config import Config
 from elliptics.log import Handler
 from elliptics.id import Id
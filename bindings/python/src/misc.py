@@ -56,6 +56,38 @@ wrap_address([CallbackResultEntry,
               ])
 
 
+def future(async_result, loop=None):
+    """
+    Wraps elliptics.AsyncResult into asyncio.Future of @loop (current event loop by default).
+    The future is resolved from elliptics thread via loop.call_soon_threadsafe() with the list
+    of results or with elliptics.Error if the operation has failed, so it can be awaited
+    without blocking the loop:
+
+    results = yield from elliptics.future(session.read_data(key))
+    """
+    import asyncio
+    from errno import ENOENT, ETIMEDOUT
+
+    if loop is None:
+        loop = asyncio.get_event_loop()
+    fut = loop.create_future()
+
+    def resolve(results, error):
+        if fut.cancelled():
+            return
+        if error.code:
+            exc = {-ENOENT: NotFoundError, -ETIMEDOUT: TimeoutError}.get(error.code, Error)
+            fut.set_exception(exc(error))
+        else:
+            fut.set_result(results)
+
+    def on_complete(results, error):
+        loop.call_soon_threadsafe(resolve, results, error)
+
+    async_result.connect(on_complete)
+    return fut
+
+
 def create_node(elog=None, log_file='/dev/stderr', log_level=log_level.error,
                 cfg=None, wait_timeout=3600, check_timeout=60,
                 flags=0, io_thread_num=1, net_thread_num=1,
@@ -197,6 +197,17 @@ class Session(Session):
                                                     family=address.family,
                                                     backend_id=backend_id)
 
+    def reload_backend(self, address, backend_id):
+        """
+        Reopens storage of backend @backend_id on @address with options re-read from config
+        without failing requests and dropping cache.
+        Return elliptics.AsyncResult that provides new status of backend
+        """
+        return super(Session, self).reload_backend(host=address.host,
+                                                   port=address.port,
+                                                   family=address.family,
+                                                   backend_id=backend_id)
+
     def start_defrag(self, address, backend_id):
         """
         Starts defragmentation of backend @backend_id on @address.
@@ -274,6 +285,17 @@ class Session(Session):
                                               backend_id=backend_id,
                                               delay=delay)
 
+    def set_faults(self, address, backend_id, rules):
+        '''
+        Replaces fault injection rules of backend with @backend_id at node @address,
+        empty @rules remove them. Server must be built with WITH_FAULT_INJECTION.
+        '''
+        return super(Session, self).set_faults(host=address.host,
+                                               port=address.port,
+                                               family=address.family,
+                                               backend_id=backend_id,
+                                               rules=rules)
+
     def monitor_stat(self, address=None, categories=monitor_stat_categories.all):
         '''
         Gather monitor statistics of specified categories from @address.
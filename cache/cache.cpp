@@ -18,14 +18,20 @@
 #include "cache.hpp"
 #include "slru_cache.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <fstream>
 
+#include <unistd.h>
+
 #include "boost/lexical_cast.hpp"
 
 #include "monitor/monitor.h"
 #include "monitor/monitor.hpp"
 #include "monitor/statistics.hpp"
 #include "monitor/measure_points.h"
+#include "library/probes.h"
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -46,31 +52,162 @@ std::unique_ptr<cache_config> cache_config::parse(const elliptics::config::confi
 	config.count = cache.at<size_t>("shards", DNET_DEFAULT_CACHES_NUMBER);
 	config.sync_timeout = cache.at<unsigned>("sync_timeout", DNET_DEFAULT_CACHE_SYNC_TIMEOUT_SEC);
 	config.pages_proportions = cache.at("pages_proportions", std::vector<size_t>(DNET_DEFAULT_CACHE_PAGES_NUMBER, 1));
+	config.admission = cache.at<bool>("admission", false);
+	config.sync_bandwidth = cache.at<size_t>("sync_bandwidth", 0);
+	config.compressed_pages = cache.at<size_t>("compressed_pages", 0);
+	config.snapshot = cache.at<std::string>("snapshot", std::string());
+	config.snapshot_interval = cache.at<unsigned>("snapshot_interval", 600);
+	config.snapshot_prefetch_rate = cache.at<size_t>("snapshot_prefetch_rate", 1000);
+	config.prefetch_queue_size = cache.at<size_t>("prefetch_queue_size", 65536);
+	config.prefetch_rate = cache.at<size_t>("prefetch_rate", 1000);
+	config.hotset_interval = cache.at<unsigned>("hotset_interval", 0);
+	config.hotset_size = cache.at<size_t>("hotset_size", 1024);
+	config.hotset_groups = cache.at("hotset_groups", std::vector<int>());
+	config.append_buffer.size = cache.at<size_t>("append_buffer_size", 0);
+	config.append_buffer.age = cache.at<unsigned>("append_buffer_age", config.sync_timeout * 1000);
+	config.append_buffer.ack_on_flush = false;
+
+	if (cache.has("append_buffer_ack")) {
+		const elliptics::config::config ack = cache.at("append_buffer_ack");
+		const std::string value = ack.as<std::string>();
+
+		if (value != "buffer" && value != "flush") {
+			throw elliptics::config::config_error(ack.path() + " must be either \"buffer\" or \"flush\"");
+		}
+
+		config.append_buffer.ack_on_flush = (value == "flush");
+	}
+
+	if (cache.has("partitions")) {
+		const elliptics::config::config partitions = cache.at("partitions");
+		double min_shares = 0;
+
+		// one more partition is the default one, partition index is kept in a byte of every object
+		if (partitions.size() >= 255) {
+			throw elliptics::config::config_error(partitions.path() + " must have less than 255 partitions");
+		}
+
+		for (size_t index = 0; index < partitions.size(); ++index) {
+			const elliptics::config::config partition = partitions.at(index);
+
+			cache_partition_config value;
+			value.name = partition.at<std::string>("name");
+			value.user_flags_mask = partition.at<uint64_t>("user_flags_mask", ~0ULL);
+			value.user_flags = partition.at<uint64_t>("user_flags");
+			value.min_share = partition.at<double>("min_share", 0);
+			value.max_share = partition.at<double>("max_share", 1);
+
+			if (value.min_share < 0 || value.max_share > 1 || value.min_share > value.max_share) {
+				throw elliptics::config::config_error(partition.path() +
+						" must have 0 <= min_share <= max_share <= 1");
+			}
+
+			min_shares += value.min_share;
+			config.partitions.push_back(value);
+		}
+
+		if (min_shares > 1) {
+			throw elliptics::config::config_error(partitions.path() + " minimum shares must not exceed 1 in sum");
+		}
+	}
+
 	return blackhole::utils::make_unique<cache_config>(config);
 }
 
-cache_manager::cache_manager(dnet_backend_io *backend, dnet_node *n, const cache_config &config) : m_node(n) {
+/*
+ * Maximum sizes of pages of single shard out of @caches_number ones sharing @size bytes
+ */
+static std::vector<size_t> shard_pages_max_sizes(size_t size, size_t caches_number,
+		const std::vector<size_t> &pages_proportions) {
+	size_t max_size = size / caches_number;
+
+	size_t proportionsSum = 0;
+	for (size_t i = 0; i < pages_proportions.size(); ++i) {
+		proportionsSum += pages_proportions[i];
+	}
+
+	std::vector<size_t> pages_max_sizes(pages_proportions.size());
+	for (size_t i = 0; i < pages_proportions.size(); ++i) {
+		pages_max_sizes[i] = max_size * (pages_proportions[i] * 1.0 / proportionsSum);
+	}
+
+	return pages_max_sizes;
+}
+
+cache_manager::cache_manager(dnet_backend_io *backend, dnet_node *n, const cache_config &config) :
+	m_node(n),
+	m_backend(backend),
+	m_pages_proportions(config.pages_proportions),
+	m_snapshot_interval(config.snapshot_interval),
+	m_snapshot_prefetch_rate(config.snapshot_prefetch_rate),
+	m_snapshot_stop(false),
+	m_prefetch_queue_size(config.prefetch_queue_size),
+	m_prefetch_rate(config.prefetch_rate),
+	m_prefetch_stop(false),
+	m_hotset_interval(config.hotset_interval),
+	m_hotset_size(config.hotset_size),
+	m_hotset_groups(config.hotset_groups),
+	m_hotset_stop(false) {
 	size_t caches_number = config.count;
 	m_cache_pages_number = config.pages_proportions.size();
 	m_max_cache_size = config.size;
-	size_t max_size = m_max_cache_size / caches_number;
 
-	size_t proportionsSum = 0;
-	for (size_t i = 0; i < m_cache_pages_number; ++i) {
-		proportionsSum += config.pages_proportions[i];
+	const std::vector<size_t> pages_max_sizes = shard_pages_max_sizes(m_max_cache_size, caches_number,
+			config.pages_proportions);
+
+	// sync bandwidth is configured for the whole cache
+	const size_t sync_bandwidth = config.sync_bandwidth ? std::max<size_t>(config.sync_bandwidth / caches_number, 1) : 0;
+
+	for (size_t i = 0; i < caches_number; ++i) {
+		m_caches.emplace_back(std::make_shared<slru_cache_t>(backend, n, pages_max_sizes, config.sync_timeout,
+					sync_bandwidth, config.admission, config.compressed_pages, config.partitions,
+					config.append_buffer));
 	}
 
-	std::vector<size_t> pages_max_sizes(m_cache_pages_number);
-	for (size_t i = 0; i < m_cache_pages_number; ++i) {
-		pages_max_sizes[i] = max_size * (config.pages_proportions[i] * 1.0 / proportionsSum);
+	if (!config.snapshot.empty()) {
+		// the same cache config may be used by all backends
+		m_snapshot_path = config.snapshot + "." + std::to_string(static_cast<unsigned long long>(backend->backend_id));
+		m_snapshot_thread = std::thread(std::bind(&cache_manager::snapshot_thread, this));
 	}
 
-	for (size_t i = 0; i < caches_number; ++i) {
-		m_caches.emplace_back(std::make_shared<slru_cache_t>(backend, n, pages_max_sizes, config.sync_timeout));
+	if (m_prefetch_queue_size) {
+		m_prefetch_thread = std::thread(std::bind(&cache_manager::prefetch_thread, this));
+	}
+
+	if (m_hotset_interval && m_hotset_size) {
+		m_hotset_thread = std::thread(std::bind(&cache_manager::hotset_thread, this));
 	}
 }
 
 cache_manager::~cache_manager() {
+	if (m_hotset_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(m_hotset_lock);
+			m_hotset_stop = true;
+		}
+		m_hotset_cond.notify_all();
+		m_hotset_thread.join();
+	}
+
+	if (m_prefetch_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(m_prefetch_lock);
+			m_prefetch_stop = true;
+		}
+		m_prefetch_cond.notify_all();
+		m_prefetch_thread.join();
+	}
+
+	if (m_snapshot_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(m_snapshot_lock);
+			m_snapshot_stop = true;
+		}
+		m_snapshot_cond.notify_all();
+		m_snapshot_thread.join();
+
+		save_snapshot();
+	}
 }
 
 int cache_manager::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data) {
@@ -81,6 +218,10 @@ std::shared_ptr<raw_data_t> cache_manager::read(const unsigned char *id, dnet_cm
 	return m_caches[idx(id)]->read(id, cmd, io);
 }
 
+std::shared_ptr<raw_data_t> cache_manager::try_read(const unsigned char *id, dnet_io_attr *io) {
+	return m_caches[idx(id)]->try_read(id, io);
+}
+
 int cache_manager::remove(const unsigned char *id, dnet_io_attr *io) {
 	return m_caches[idx(id)]->remove(id, io);
 }
@@ -89,6 +230,23 @@ int cache_manager::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd
 	return m_caches[idx(id)]->lookup(id, st, cmd);
 }
 
+void cache_manager::read_range(const dnet_io_attr *io, std::vector<cache_range_entry_t> &entries) {
+	// every shard has its own part of the range, each of them may hold the whole answer
+	const size_t limit = io->num ? io->start + io->num : 0;
+
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		m_caches[i]->read_range(io->id, io->parent, limit, entries);
+	}
+
+	std::sort(entries.begin(), entries.end(), [] (const cache_range_entry_t &lhs, const cache_range_entry_t &rhs) {
+		return dnet_id_cmp_str(lhs.id.id, rhs.id.id) < 0;
+	});
+
+	entries.erase(entries.begin(), entries.begin() + std::min<size_t>(io->start, entries.size()));
+	if (io->num && entries.size() > io->num)
+		entries.resize(io->num);
+}
+
 int cache_manager::indexes_find(dnet_cmd *cmd, dnet_indexes_request *request) {
 	(void) cmd;
 	(void) request;
@@ -117,6 +275,22 @@ size_t cache_manager::cache_size() const {
 	return m_max_cache_size;
 }
 
+void cache_manager::resize(size_t size, const std::vector<size_t> &pages_proportions) {
+	std::lock_guard<std::mutex> guard(m_resize_lock);
+
+	if (!pages_proportions.empty())
+		m_pages_proportions = pages_proportions;
+	m_max_cache_size = size;
+
+	const std::vector<size_t> pages_max_sizes = shard_pages_max_sizes(m_max_cache_size, m_caches.size(),
+			m_pages_proportions);
+	for (auto it = m_caches.begin(); it != m_caches.end(); ++it)
+		(*it)->resize(pages_max_sizes);
+
+	dnet_log(m_node, DNET_LOG_INFO, "cache: backend: %zu: resized to %zu bytes, pages: %zu",
+			m_backend->backend_id, m_max_cache_size, m_cache_pages_number);
+}
+
 size_t cache_manager::cache_pages_number() const {
 	return m_cache_pages_number;
 }
@@ -131,11 +305,35 @@ cache_stats cache_manager::get_total_cache_stats() const {
 		stats.number_of_objects_marked_for_deletion += page_stats.number_of_objects_marked_for_deletion;
 		stats.size_of_objects_marked_for_deletion += page_stats.size_of_objects_marked_for_deletion;
 		stats.size_of_objects += page_stats.size_of_objects;
+		stats.number_of_hits += page_stats.number_of_hits;
+		stats.number_of_misses += page_stats.number_of_misses;
+		stats.admission_accepted += page_stats.admission_accepted;
+		stats.admission_rejected += page_stats.admission_rejected;
+		stats.coalesced_misses += page_stats.coalesced_misses;
+		stats.sync_queue_objects += page_stats.sync_queue_objects;
+		stats.sync_queue_size += page_stats.sync_queue_size;
+		stats.synced_objects += page_stats.synced_objects;
+		stats.synced_size += page_stats.synced_size;
+		stats.compressed_objects += page_stats.compressed_objects;
+		stats.compressed_size += page_stats.compressed_size;
+		stats.compressed_original_size += page_stats.compressed_original_size;
 
 		for (size_t j = 0; j < m_cache_pages_number; ++j) {
 			stats.pages_sizes[j] += page_stats.pages_sizes[j];
 			stats.pages_max_sizes[j] += page_stats.pages_max_sizes[j];
 		}
+
+		stats.partitions.resize(page_stats.partitions.size());
+		for (size_t j = 0; j < page_stats.partitions.size(); ++j) {
+			cache_partition_stats &partition = stats.partitions[j];
+			partition.name = page_stats.partitions[j].name;
+			partition.size += page_stats.partitions[j].size;
+			partition.min_size += page_stats.partitions[j].min_size;
+			partition.max_size += page_stats.partitions[j].max_size;
+			partition.hits += page_stats.partitions[j].hits;
+			partition.misses += page_stats.partitions[j].misses;
+			partition.evicted_size += page_stats.partitions[j].evicted_size;
+		}
 	}
 	return stats;
 }
@@ -150,7 +348,48 @@ std::vector<cache_stats> cache_manager::get_caches_stats() const {
 
 rapidjson::Value &cache_manager::get_total_caches_size_stats_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const {
 	cache_stats stats = get_total_cache_stats();
-	return stats.to_json(stat_value, allocator);
+	stats.to_json(stat_value, allocator);
+
+	// allocators are per NUMA node and are shared by caches of all backends
+	const std::vector<slab_allocator::stats> nodes_stats = slab_allocator::get_nodes_stats();
+	slab_allocator::stats slab_stats;
+	rapidjson::Value nodes_value(rapidjson::kObjectType);
+	for (size_t i = 0; i < nodes_stats.size(); ++i) {
+		const slab_allocator::stats &node_stats = nodes_stats[i];
+		slab_stats.slabs_size += node_stats.slabs_size;
+		slab_stats.huge_slabs_size += node_stats.huge_slabs_size;
+		slab_stats.used_size += node_stats.used_size;
+		slab_stats.large_size += node_stats.large_size;
+
+		if (!node_stats.slabs_size && !node_stats.large_size)
+			continue;
+
+		rapidjson::Value node_value(rapidjson::kObjectType);
+		node_value.AddMember("slabs_size", node_stats.slabs_size, allocator)
+			  .AddMember("huge_slabs_size", node_stats.huge_slabs_size, allocator)
+			  .AddMember("slabs_used_size", node_stats.used_size, allocator)
+			  .AddMember("large_values_size", node_stats.large_size, allocator);
+		nodes_value.AddMember(std::to_string(static_cast<unsigned long long>(i)).c_str(), allocator, node_value, allocator);
+	}
+
+	stat_value.AddMember("numa_node", m_backend->numa_node, allocator)
+		  .AddMember("slabs_size", slab_stats.slabs_size, allocator)
+		  .AddMember("huge_slabs_size", slab_stats.huge_slabs_size, allocator)
+		  .AddMember("slabs_used_size", slab_stats.used_size, allocator)
+		  .AddMember("large_values_size", slab_stats.large_size, allocator)
+		  .AddMember("numa_nodes", nodes_value, allocator);
+
+	// compression counters are shared by caches of all backends too
+	const value_compressor::stats compression_stats = value_compressor::get_stats();
+	rapidjson::Value compression_value(rapidjson::kObjectType);
+	compression_value.AddMember("ratio", stats.compressed_size ?
+				double(stats.compressed_original_size) / stats.compressed_size : 0., allocator)
+		  .AddMember("compressions", compression_stats.compressions, allocator)
+		  .AddMember("compress_time_us", compression_stats.compress_time, allocator)
+		  .AddMember("decompressions", compression_stats.decompressions, allocator)
+		  .AddMember("decompress_time_us", compression_stats.decompress_time, allocator);
+	stat_value.AddMember("compression", compression_value, allocator);
+	return stat_value;
 }
 
 rapidjson::Value &cache_manager::get_caches_size_stats_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const {
@@ -184,6 +423,351 @@ std::string cache_manager::stat_json() const {
 	return buffer.GetString();
 }
 
+/*
+ * Hot keys snapshot is a header followed by cache_snapshot_record's.
+ * Shards are interleaved, so the beginning of the file holds the hottest keys of every shard.
+ * Snapshot is written into temporary file which is renamed over the previous one.
+ */
+void cache_manager::save_snapshot() {
+	std::vector<std::vector<cache_snapshot_record>> keys(m_caches.size());
+	size_t records_number = 0;
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		m_caches[i]->hot_keys(keys[i]);
+		records_number += keys[i].size();
+	}
+
+	const std::string tmp_path = m_snapshot_path + ".tmp";
+	std::ofstream out(tmp_path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: could not open %s: %s",
+				m_backend->backend_id, tmp_path.c_str(), strerror(errno));
+		return;
+	}
+
+	cache_snapshot_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = cache_snapshot_header::snapshot_magic;
+	header.version = cache_snapshot_header::snapshot_version;
+	header.record_size = sizeof(cache_snapshot_record);
+	header.records_number = records_number;
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	for (size_t rank = 0, written = 0; written < records_number; ++rank) {
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (rank < keys[i].size()) {
+				out.write(reinterpret_cast<const char *>(&keys[i][rank]), sizeof(cache_snapshot_record));
+				++written;
+			}
+		}
+	}
+
+	out.close();
+	if (!out) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: could not write %s",
+				m_backend->backend_id, tmp_path.c_str());
+		unlink(tmp_path.c_str());
+		return;
+	}
+
+	if (rename(tmp_path.c_str(), m_snapshot_path.c_str())) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: could not rename %s to %s: %s",
+				m_backend->backend_id, tmp_path.c_str(), m_snapshot_path.c_str(), strerror(errno));
+		unlink(tmp_path.c_str());
+		return;
+	}
+
+	dnet_log(m_node, DNET_LOG_INFO, "cache: snapshot: backend: %zu: saved %zu keys to %s",
+			m_backend->backend_id, records_number, m_snapshot_path.c_str());
+}
+
+/*
+ * Reads keys from snapshot into the cache hottest first at most m_snapshot_prefetch_rate objects per second.
+ * Values are always read from the backend, so snapshot never brings stale data into the cache.
+ * Shard is not warmed up any more after it is full.
+ */
+void cache_manager::load_snapshot() {
+	std::ifstream in(m_snapshot_path.c_str(), std::ios::binary);
+	if (!in) {
+		dnet_log(m_node, errno == ENOENT ? DNET_LOG_NOTICE : DNET_LOG_ERROR,
+				"cache: snapshot: backend: %zu: could not open %s: %s",
+				m_backend->backend_id, m_snapshot_path.c_str(), strerror(errno));
+		return;
+	}
+
+	cache_snapshot_header header;
+	if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+			|| header.magic != cache_snapshot_header::snapshot_magic
+			|| header.version != cache_snapshot_header::snapshot_version
+			|| header.record_size != sizeof(cache_snapshot_record)) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: %s is not a valid cache snapshot",
+				m_backend->backend_id, m_snapshot_path.c_str());
+		return;
+	}
+
+	elliptics_timer timer;
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<char> full(m_caches.size(), 0);
+	size_t full_number = 0;
+	size_t processed = 0, loaded = 0;
+	cache_snapshot_record record;
+
+	while (processed < header.records_number && in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+		++processed;
+
+		const size_t index = idx(record.id);
+		if (full[index])
+			continue;
+
+		if (!m_caches[index]->prefetch(record.id, record.page_number)) {
+			full[index] = 1;
+			if (++full_number == m_caches.size())
+				break;
+			continue;
+		}
+
+		++loaded;
+
+		auto deadline = start;
+		if (m_snapshot_prefetch_rate)
+			deadline += std::chrono::microseconds(loaded * 1000000 / m_snapshot_prefetch_rate);
+
+		if (!snapshot_wait_until(deadline))
+			break;
+	}
+
+	dnet_log(m_node, DNET_LOG_INFO, "cache: snapshot: backend: %zu: prefetched %zu of %llu keys from %s in %lld ms",
+			m_backend->backend_id, loaded, (unsigned long long)header.records_number,
+			m_snapshot_path.c_str(), timer.elapsed());
+}
+
+/*
+ * Keys which do not fit into the queue are dropped, hints are not worth memory or latency of the caller
+ */
+size_t cache_manager::prefetch(const dnet_io_attr *ios, size_t count) {
+	size_t queued = 0;
+
+	{
+		std::lock_guard<std::mutex> guard(m_prefetch_lock);
+
+		for (; queued < count && m_prefetch_queue.size() < m_prefetch_queue_size; ++queued) {
+			dnet_raw_id id;
+			memcpy(id.id, ios[queued].id, DNET_ID_SIZE);
+			m_prefetch_queue.push_back(id);
+		}
+	}
+
+	if (queued)
+		m_prefetch_cond.notify_one();
+
+	return queued;
+}
+
+/*
+ * Loads hinted keys at most m_prefetch_rate objects per second with background io priority of the node
+ */
+void cache_manager::prefetch_thread() {
+	dnet_set_name("dnet_cache_pref_%zu", m_backend->backend_id);
+
+	// prefetched values are allocated by this thread
+	if (m_backend->numa_node >= 0)
+		dnet_numa_bind_thread(m_backend->numa_node);
+
+	if (m_node->bg_ionice_class)
+		dnet_ioprio_set(0, m_node->bg_ionice_class, m_node->bg_ionice_prio);
+
+	auto deadline = std::chrono::steady_clock::now();
+
+	while (true) {
+		dnet_raw_id id;
+
+		{
+			std::unique_lock<std::mutex> guard(m_prefetch_lock);
+
+			// idle thread may catch up with the rate for at most one second
+			m_prefetch_cond.wait_until(guard, deadline, [this] () { return m_prefetch_stop; });
+			m_prefetch_cond.wait(guard, [this] () { return m_prefetch_stop || !m_prefetch_queue.empty(); });
+			if (m_prefetch_stop)
+				return;
+
+			id = m_prefetch_queue.front();
+			m_prefetch_queue.pop_front();
+		}
+
+		m_caches[idx(id.id)]->prefetch_hint(id.id);
+
+		if (m_prefetch_rate) {
+			deadline = std::max(deadline, std::chrono::steady_clock::now() - std::chrono::seconds(1));
+			deadline += std::chrono::microseconds(1000000 / m_prefetch_rate);
+		}
+	}
+}
+
+/*
+ * Returns false if snapshot thread has to stop
+ */
+bool cache_manager::snapshot_wait_until(std::chrono::steady_clock::time_point deadline) {
+	std::unique_lock<std::mutex> guard(m_snapshot_lock);
+	return !m_snapshot_cond.wait_until(guard, deadline, [this] () { return m_snapshot_stop; });
+}
+
+void cache_manager::snapshot_thread() {
+	dnet_set_name("dnet_cache_snap_%zu", m_backend->backend_id);
+
+	// prefetched values are allocated by this thread
+	if (m_backend->numa_node >= 0)
+		dnet_numa_bind_thread(m_backend->numa_node);
+
+	load_snapshot();
+
+	if (!m_snapshot_interval)
+		return;
+
+	while (snapshot_wait_until(std::chrono::steady_clock::now() + std::chrono::seconds(m_snapshot_interval))) {
+		save_snapshot();
+	}
+}
+
+static int dnet_cache_hotset_complete(struct dnet_addr *, struct dnet_cmd *, void *)
+{
+	return 0;
+}
+
+/*
+ * Groups hot keys are sent to: configured ones or all groups known to the node
+ */
+std::vector<int> cache_manager::hotset_groups() const {
+	if (!m_hotset_groups.empty())
+		return m_hotset_groups;
+
+	std::vector<int> groups;
+
+	pthread_mutex_lock(&m_node->state_lock);
+	for (rb_node *it = rb_first(&m_node->group_root); it; it = rb_next(it)) {
+		const dnet_group *g = rb_entry(it, dnet_group, group_entry);
+		groups.push_back(g->group_id);
+	}
+	pthread_mutex_unlock(&m_node->state_lock);
+
+	return groups;
+}
+
+/*
+ * Sends the hottest keys of every shard as prefetch hints to their replicas in other groups,
+ * so reads which fail over to replicas find them cached. Replicas load hinted keys by their
+ * prefetch threads with background io priority and admission filter, so hints never displace
+ * objects which are hotter there.
+ */
+void cache_manager::send_hotset() {
+	const size_t shard_limit = (m_hotset_size + m_caches.size() - 1) / m_caches.size();
+
+	std::vector<cache_snapshot_record> keys;
+	for (size_t i = 0; i < m_caches.size(); ++i)
+		m_caches[i]->hot_keys(keys, shard_limit);
+
+	if (keys.empty())
+		return;
+
+	dnet_io_attr io;
+	memset(&io, 0, sizeof(io));
+	io.flags = DNET_IO_FLAGS_CACHE_PREFETCH;
+
+	// sorted keys of the same replica are sent by a single request
+	std::vector<dnet_io_attr> ios;
+	ios.reserve(keys.size());
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		memcpy(io.id, it->id, DNET_ID_SIZE);
+		ios.push_back(io);
+	}
+	std::sort(ios.begin(), ios.end(), [] (const dnet_io_attr &a, const dnet_io_attr &b) {
+		return memcmp(a.id, b.id, DNET_ID_SIZE) < 0;
+	});
+
+	dnet_session *s = dnet_session_create(m_node);
+	if (!s) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: hotset: backend: %zu: could not create session",
+				m_backend->backend_id);
+		return;
+	}
+
+	const std::vector<int> groups = hotset_groups();
+	size_t sent = 0, requests = 0;
+
+	for (auto group = groups.begin(); group != groups.end(); ++group) {
+		size_t start = 0;
+		dnet_net_state *cur = NULL;
+		int cur_backend = -1;
+
+		for (size_t i = 0; i <= ios.size(); ++i) {
+			dnet_net_state *next = NULL;
+			int next_backend = -1;
+
+			if (i < ios.size()) {
+				dnet_id id;
+				dnet_setup_id(&id, *group, ios[i].id);
+				next = dnet_state_get_first_with_backend(m_node, &id, &next_backend);
+
+				if (i > start && next == cur && next_backend == cur_backend) {
+					dnet_state_put(next);
+					continue;
+				}
+			}
+
+			// this backend holds its hot keys already
+			const bool self = cur == m_node->st && cur_backend == (int)m_backend->backend_id;
+
+			if (cur && !self) {
+				dnet_io_control ctl;
+				memset(&ctl, 0, sizeof(ctl));
+
+				dnet_setup_id(&ctl.id, *group, ios[start].id);
+				ctl.io = io;
+				ctl.io.size = (i - start) * sizeof(dnet_io_attr);
+				ctl.data = ios.data() + start;
+				ctl.fd = -1;
+				ctl.cmd = DNET_CMD_BULK_READ;
+				ctl.cflags = DNET_FLAGS_NEED_ACK;
+				ctl.complete = dnet_cache_hotset_complete;
+
+				dnet_io_trans_alloc_send(s, &ctl);
+
+				sent += i - start;
+				++requests;
+			}
+
+			dnet_state_put(cur);
+			cur = next;
+			cur_backend = next_backend;
+			start = i;
+		}
+	}
+
+	dnet_session_destroy(s);
+
+	dnet_log(m_node, DNET_LOG_INFO, "cache: hotset: backend: %zu: sent %zu hints of %zu hot keys by %zu requests "
+			"to %zu groups", m_backend->backend_id, sent, ios.size(), requests, groups.size());
+}
+
+void cache_manager::hotset_thread() {
+	dnet_set_name("dnet_cache_hot_%zu", m_backend->backend_id);
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(m_hotset_lock);
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(m_hotset_interval);
+			if (m_hotset_cond.wait_until(guard, deadline, [this] () { return m_hotset_stop; }))
+				return;
+		}
+
+		try {
+			send_hotset();
+		} catch (const std::exception &e) {
+			dnet_log(m_node, DNET_LOG_ERROR, "cache: hotset: backend: %zu: failed to send hot keys: %s",
+					m_backend->backend_id, e.what());
+		}
+	}
+}
+
 size_t cache_manager::idx(const unsigned char *id) {
 	size_t i = *(size_t *)id;
 	size_t j = *(size_t *)(id + DNET_ID_SIZE - sizeof(size_t));
@@ -194,7 +778,60 @@ size_t cache_manager::idx(const unsigned char *id) {
 
 using namespace ioremap::cache;
 
-int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, char *data)
+/*
+ * Drops reference to cached data which was pinned while read reply was queued for sending
+ */
+static void dnet_cache_data_release(void *priv)
+{
+	delete static_cast<std::shared_ptr<raw_data_t> *>(priv);
+}
+
+/*
+ * Sends part of cached object @d requested by @io
+ */
+static int dnet_cache_send_read(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		const std::shared_ptr<raw_data_t> &d)
+{
+	struct dnet_node *n = st->n;
+
+	/*!
+	 * When offset is larger then size of the file, operation is definitely incorrect
+	 */
+	if (io->offset >= d->size()) {
+		BH_LOG(*n->log, DNET_LOG_ERROR, "%s: %s cache: invalid offset: "
+				"offset: %llu, size: %llu, cached-size: %zd",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd),
+				(unsigned long long)io->offset, (unsigned long long)io->size,
+				d->size());
+		return -EINVAL;
+	}
+
+	/*!
+	 * If offset is correct, but offset + read_size is bigger then file_size
+	 * then we should return data from offset position till the end of the file
+	 * This situation happens when for example we want to read first 100 bytes of
+	 * the file and it's size appears to be less then 100 bytes.
+	 */
+	io->size = std::min(io->size, d->size() - io->offset);
+
+	/*!
+	 * 0 is special value for io operation size and in this case we should read all file
+	 */
+	if (io->size == 0)
+		io->size = d->size() - io->offset;
+
+	io->total_size = d->size();
+
+	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+	/*
+	 * Cached data is not copied, reply references it until it is sent.
+	 * Writers never modify referenced data, see data_t::writable_data().
+	 */
+	return dnet_send_read_data_ref(st, cmd, io, d->data() + io->offset,
+			dnet_cache_data_release, new std::shared_ptr<raw_data_t>(d));
+}
+
+static int dnet_cmd_cache_io_raw(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, char *data)
 {
 	struct dnet_node *n = st->n;
 	int err = -ENOTSUP;
@@ -209,7 +846,7 @@ int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st
 	cache_manager *cache = (cache_manager *)backend->cache;
 	std::shared_ptr<raw_data_t> d;
 
-	FORMATTED(HANDY_TIMER_SCOPE, ("cache.%s", dnet_cmd_string(cmd->cmd)));
+	HANDY_TIMER_SCOPE(dnet_cmd_metric_name(DNET_CMD_METRICS_CACHE, cmd->cmd));
 
 	try {
 		switch (cmd->cmd) {
@@ -227,37 +864,7 @@ int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st
 					break;
 				}
 
-				/*!
-				 * When offset is larger then size of the file, operation is definitely incorrect
-				 */
-				if (io->offset >= d->size()) {
-					BH_LOG(*n->log, DNET_LOG_ERROR, "%s: %s cache: invalid offset: "
-							"offset: %llu, size: %llu, cached-size: %zd",
-							dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd),
-							(unsigned long long)io->offset, (unsigned long long)io->size,
-							d->size());
-					err = -EINVAL;
-					break;
-				}
-
-				/*!
-				 * If offset is correct, but offset + read_size is bigger then file_size
-				 * then we should return data from offset position till the end of the file
-				 * This situation happens when for example we want to read first 100 bytes of
-				 * the file and it's size appears to be less then 100 bytes.
-				 */
-				io->size = std::min(io->size, d->size() - io->offset);
-
-				/*!
-				 * 0 is special value for io operation size and in this case we should read all file
-				 */
-				if (io->size == 0)
-					io->size = d->size() - io->offset;
-
-				io->total_size = d->size();
-
-				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-				err = dnet_send_read_data(st, cmd, io, (char *)d->data().data() + io->offset, -1, io->offset, 0);
+				err = dnet_cache_send_read(st, cmd, io, d);
 				break;
 			case DNET_CMD_DEL:
 				err = cache->remove(cmd->id.id, io);
@@ -272,6 +879,68 @@ int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st
 	return err;
 }
 
+int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, char *data)
+{
+	DNET_PROBE_CMD(cache__start, st, cmd, (int)backend->backend_id);
+
+	const int err = dnet_cmd_cache_io_raw(backend, st, cmd, io, data);
+
+	DNET_PROBE_CMD(cache__done, st, cmd, (int)backend->backend_id, err);
+	return err;
+}
+
+int dnet_cmd_cache_try_read(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io)
+{
+	struct dnet_node *n = st->n;
+
+	if (!backend->cache)
+		return -EAGAIN;
+
+	cache_manager *cache = (cache_manager *)backend->cache;
+
+	try {
+		std::shared_ptr<raw_data_t> d = cache->try_read(io->id, io);
+		if (!d)
+			return -EAGAIN;
+
+		return dnet_cache_send_read(st, cmd, io, d);
+	} catch (const std::exception &e) {
+		BH_LOG(*n->log, DNET_LOG_ERROR, "%s: %s cache operation failed: %s",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), e.what());
+		return -EAGAIN;
+	}
+}
+
+int dnet_cmd_cache_read_local(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, void **data)
+{
+	struct dnet_node *n = st->n;
+
+	if (!backend->cache)
+		return -ENOTSUP;
+
+	cache_manager *cache = (cache_manager *)backend->cache;
+
+	try {
+		std::shared_ptr<raw_data_t> d = cache->read(io->id, cmd, io);
+		if (!d)
+			return -ENOENT;
+
+		*data = malloc(d->size() ? d->size() : 1);
+		if (!*data)
+			return -ENOMEM;
+
+		if (d->size())
+			memcpy(*data, d->data(), d->size());
+		io->size = d->size();
+		return 0;
+	} catch (const std::exception &e) {
+		BH_LOG(*n->log, DNET_LOG_ERROR, "%s: %s cache local read failed: %s",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), e.what());
+		return -ENOENT;
+	}
+}
+
 int dnet_cmd_cache_lookup(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd)
 {
 	struct dnet_node *n = st->n;
@@ -294,6 +963,93 @@ int dnet_cmd_cache_lookup(struct dnet_backend_io *backend, struct dnet_net_state
 	return err;
 }
 
+/*
+ * Range read is answered from cache only when client asked not to touch the disk:
+ * cache knows nothing about keys in the range which are not cached.
+ * Replies are the same as backend sends: one per key followed by reply with number of keys.
+ */
+int dnet_cmd_cache_read_range(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io)
+{
+	struct dnet_node *n = st->n;
+	int err = 0;
+
+	if (!backend->cache || !(io->flags & DNET_IO_FLAGS_CACHE_ONLY)) {
+		return -ENOTSUP;
+	}
+
+	cache_manager *cache = (cache_manager *)backend->cache;
+
+	HANDY_TIMER_SCOPE(dnet_cmd_metric_name(DNET_CMD_METRICS_CACHE, cmd->cmd));
+
+	try {
+		std::vector<cache_range_entry_t> entries;
+		cache->read_range(io, entries);
+
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			const std::shared_ptr<raw_data_t> &d = it->data;
+
+			if (io->offset > d->size())
+				continue;
+
+			struct dnet_io_attr r;
+			memset(&r, 0, sizeof(r));
+
+			memcpy(r.id, it->id.id, DNET_ID_SIZE);
+			memcpy(r.parent, io->parent, DNET_ID_SIZE);
+			r.offset = io->offset;
+			r.size = d->size() - io->offset;
+			if (io->size && io->size < r.size)
+				r.size = io->size;
+			r.total_size = d->size();
+			r.timestamp = it->timestamp;
+			r.user_flags = it->user_flags;
+
+			if (io->flags & DNET_IO_FLAGS_NODATA) {
+				/* only the attribute of the key is sent back */
+				r.size = 0;
+				err = dnet_send_read_data(st, cmd, &r, NULL, -1, 0, 0);
+			} else {
+				err = dnet_send_read_data_ref(st, cmd, &r, d->data() + r.offset,
+						dnet_cache_data_release, new std::shared_ptr<raw_data_t>(d));
+			}
+			if (err)
+				return err;
+		}
+
+		if (!entries.empty()) {
+			struct dnet_io_attr r = *io;
+
+			r.num = entries.size();
+			r.offset = r.size = 0;
+
+			err = dnet_send_read_data(st, cmd, &r, NULL, -1, 0, 0);
+		}
+	} catch (const std::exception &e) {
+		BH_LOG(*n->log, DNET_LOG_ERROR, "%s: %s cache operation failed: %s",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), e.what());
+		err = -ENOENT;
+	}
+
+	return err;
+}
+
+int dnet_cmd_cache_prefetch(struct dnet_backend_io *backend, struct dnet_cmd *cmd, const struct dnet_io_attr *ios, uint64_t count)
+{
+	if (!backend->cache) {
+		return -ENOTSUP;
+	}
+
+	cache_manager *cache = (cache_manager *)backend->cache;
+
+	try {
+		cache->prefetch(ios, count);
+	} catch (const std::exception &) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 void *dnet_cache_init(struct dnet_node *n, struct dnet_backend_io *backend, const void *config)
 {
 	try {
@@ -308,3 +1064,29 @@ void dnet_cache_cleanup(void *cache)
 {
 	delete (cache_manager *)cache;
 }
+
+int dnet_cache_resize(void *cache, uint64_t size, const uint32_t *proportions, uint32_t count)
+{
+	cache_manager *manager = (cache_manager *)cache;
+
+	if (!size || (count && count != manager->cache_pages_number()))
+		return -EINVAL;
+
+	std::vector<size_t> pages_proportions(proportions, proportions + count);
+	for (auto it = pages_proportions.begin(); it != pages_proportions.end(); ++it) {
+		if (!*it)
+			return -EINVAL;
+	}
+
+	try {
+		manager->resize(size, pages_proportions);
+	} catch (const std::exception &) {
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+uint64_t dnet_cache_size(void *cache)
+{
+	return ((cache_manager *)cache)->cache_size();
+}
@@ -18,9 +18,12 @@
 #ifndef CACHE_HPP
 #define CACHE_HPP
 
+#include <deque>
 #include <vector>
 #include <mutex>
 #include <thread>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <unordered_map>
 #include <limits>
@@ -31,6 +34,7 @@
 #endif
 
 #include <boost/intrusive/list.hpp>
+#include <boost/intrusive/set.hpp>
 
 #include "library/elliptics.h"
 #include "indexes/local_session.h"
@@ -42,27 +46,99 @@
 #include "monitor/rapidjson/writer.h"
 #include "monitor/rapidjson/stringbuffer.h"
 
-#include "treap.hpp"
+#include "timer_wheel.hpp"
+#include "slab_allocator.hpp"
+#include "frequency_sketch.hpp"
+#include "compression.hpp"
 
 namespace ioremap { namespace cache {
 
+/*
+ * Value of cached object, its memory is taken from slab_allocator of the node it was created on.
+ * Capacity is the real size of allocated chunk and it is what cache size accounts.
+ */
 class raw_data_t {
 public:
-	raw_data_t(const char *data, size_t size) {
-		m_data.reserve(size);
-		m_data.insert(m_data.begin(), data, data + size);
+	raw_data_t(const char *data, size_t size) :
+		m_allocator(&slab_allocator::instance()), m_data(NULL), m_size(0), m_capacity(0) {
+		reserve(size);
+		if (size)
+			memcpy(m_data, data, size);
+		m_size = size;
+	}
+
+	// contents are not initialized
+	explicit raw_data_t(size_t size) :
+		m_allocator(&slab_allocator::instance()), m_data(NULL), m_size(0), m_capacity(0) {
+		reserve(size);
+		m_size = size;
+	}
+
+	raw_data_t(const raw_data_t &other) :
+		m_allocator(&slab_allocator::instance()), m_data(NULL), m_size(0), m_capacity(0) {
+		reserve(other.m_size);
+		if (other.m_size)
+			memcpy(m_data, other.m_data, other.m_size);
+		m_size = other.m_size;
+	}
+
+	raw_data_t &operator =(const raw_data_t &other) = delete;
+
+	~raw_data_t() {
+		m_allocator->deallocate(m_data, m_capacity);
+	}
+
+	char *data(void) {
+		return m_data;
 	}
 
-	std::vector<char> &data(void) {
+	const char *data(void) const {
 		return m_data;
 	}
 
-	size_t size(void) {
-		return m_data.size();
+	size_t size(void) const {
+		return m_size;
+	}
+
+	size_t capacity(void) const {
+		return m_capacity;
+	}
+
+	void append(const char *data, size_t size) {
+		if (m_size + size > m_capacity)
+			reserve(std::max(m_size + size, 2 * m_capacity));
+
+		memcpy(m_data + m_size, data, size);
+		m_size += size;
+	}
+
+	// new bytes are zeroed
+	void resize(size_t size) {
+		if (size > m_capacity)
+			reserve(size);
+
+		if (size > m_size)
+			memset(m_data + m_size, 0, size - m_size);
+		m_size = size;
 	}
 
 private:
-	std::vector<char> m_data;
+	void reserve(size_t size) {
+		size_t capacity;
+		char *data = static_cast<char *>(m_allocator->allocate(size, &capacity));
+
+		if (m_size)
+			memcpy(data, m_data, m_size);
+		m_allocator->deallocate(m_data, m_capacity);
+
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	slab_allocator *m_allocator;
+	char *m_data;
+	size_t m_size;
+	size_t m_capacity;
 };
 
 struct data_lru_tag_t;
@@ -70,16 +146,23 @@ typedef boost::intrusive::list_base_hook<boost::intrusive::tag<data_lru_tag_t>,
 boost::intrusive::link_mode<boost::intrusive::safe_link>, boost::intrusive::optimize_size<true>
 > lru_list_base_hook_t;
 
-class data_t;
+struct data_id_tag_t;
+typedef boost::intrusive::set_base_hook<boost::intrusive::tag<data_id_tag_t>,
+boost::intrusive::link_mode<boost::intrusive::normal_link>, boost::intrusive::optimize_size<true>
+> data_id_set_hook_t;
 
-template<>
-struct treap_node_traits<data_t>
-{
-	typedef const uint8_t* key_type;
-	typedef size_t priority_type;
-};
+class data_t;
 
-class data_t : public lru_list_base_hook_t, public treap_node_t<data_t> {
+/*
+ * Monotonic time in milliseconds, all lifetimes and sync times of cached objects are measured in it
+ */
+static inline uint64_t cache_time_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+class data_t : public lru_list_base_hook_t, public timer_wheel_node_t, public data_id_set_hook_t {
 public:
 	enum class sync_state_t : char {
 		NOT_SYNCING,
@@ -90,7 +173,10 @@ public:
 	data_t(const unsigned char *id) :
 		m_lifetime(0), m_synctime(0), m_user_flags(0),
 		m_remove_from_disk(false), m_remove_from_cache(false),
-		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING) {
+		m_only_append(false), m_removed_from_page(true), m_compressed(false),
+		m_sync_state(sync_state_t::NOT_SYNCING),
+		m_partition(0), m_csum_type(DNET_CHECKSUM_SHA512),
+		m_referenced(false) {
 		memcpy(m_id.id, id, DNET_ID_SIZE);
 		dnet_empty_time(&m_timestamp);
 	}
@@ -98,14 +184,17 @@ public:
 	data_t(const unsigned char *id, size_t lifetime, const char *data, size_t size, bool remove_from_disk) :
 		m_lifetime(0), m_synctime(0), m_user_flags(0),
 		m_remove_from_disk(remove_from_disk), m_remove_from_cache(false),
-		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING) {
+		m_only_append(false), m_removed_from_page(true), m_compressed(false),
+		m_sync_state(sync_state_t::NOT_SYNCING),
+		m_partition(0), m_csum_type(DNET_CHECKSUM_SHA512),
+		m_referenced(false) {
 		memcpy(m_id.id, id, DNET_ID_SIZE);
 		dnet_empty_time(&m_timestamp);
 
 		if (lifetime)
-			m_lifetime = lifetime + time(NULL);
+			m_lifetime = lifetime * 1000 + cache_time_ms();
 
-		m_data.reset(new raw_data_t(data, size));
+		m_data = std::make_shared<raw_data_t>(data, size);
 	}
 
 	data_t(const data_t &other) = delete;
@@ -121,10 +210,46 @@ public:
 		return m_id;
 	}
 
+	/*
+	 * Returns value of the object, compressed value is decompressed into a new buffer
+	 */
 	std::shared_ptr<raw_data_t> data(void) const {
+		if (m_compressed)
+			return value_compressor::decompress(*m_data);
 		return m_data;
 	}
 
+	bool compressed() const {
+		return m_compressed;
+	}
+
+	/*
+	 * Returns value as it is stored
+	 */
+	const raw_data_t &stored_data(void) const {
+		return *m_data;
+	}
+
+	/*
+	 * Replaces value by its (de)compressed representation, changes size() of the object.
+	 * Must be called under cache lock.
+	 */
+	void set_data(const std::shared_ptr<raw_data_t> &data, bool compressed) {
+		m_data = data;
+		m_compressed = compressed;
+	}
+
+	/*
+	 * Returns data which can be modified in place, object must not be compressed.
+	 * Data referenced by anybody else (for example read reply which is still queued for sending)
+	 * is immutable, so it is copied first. Must be called under cache lock.
+	 */
+	raw_data_t &writable_data(void) {
+		if (m_data.use_count() > 1)
+			m_data = std::make_shared<raw_data_t>(*m_data);
+		return *m_data;
+	}
+
 	size_t lifetime(void) const {
 		return m_lifetime;
 	}
@@ -162,6 +287,17 @@ public:
 		return m_cache_page_number;
 	}
 
+	/*
+	 * Partition object was accounted in when it has been inserted into its page
+	 */
+	size_t partition() const {
+		return m_partition;
+	}
+
+	void set_partition(size_t partition) {
+		m_partition = partition;
+	}
+
 	void set_cache_page_number(size_t cache_page_number) {
 		m_cache_page_number = cache_page_number;
 		if (!is_removed_from_page()) {
@@ -190,6 +326,18 @@ public:
 		m_user_flags = user_flags;
 	}
 
+	/*
+	 * Algorithm (one of dnet_checksum_types) of the record read from disk,
+	 * parent of compare-and-swap write is checked by it as backend would do
+	 */
+	uint8_t csum_type() const {
+		return m_csum_type;
+	}
+
+	void set_csum_type(uint8_t csum_type) {
+		m_csum_type = csum_type;
+	}
+
 	bool remove_from_disk() const {
 		return m_remove_from_disk;
 	}
@@ -230,6 +378,24 @@ public:
 		return m_removed_from_page;
 	}
 
+	/*
+	 * CLOCK reference bit: it is set by read hits which hold only shared cache lock
+	 * and is checked (and cleared) when object reaches cold end of its page.
+	 */
+	bool referenced() const {
+		return m_referenced.load(std::memory_order_relaxed);
+	}
+
+	void set_referenced() {
+		// do not dirty cache line of hot object on every hit
+		if (!m_referenced.load(std::memory_order_relaxed))
+			m_referenced.store(true, std::memory_order_relaxed);
+	}
+
+	void clear_referenced() {
+		m_referenced.store(false, std::memory_order_relaxed);
+	}
+
 	void set_removed_from_page(bool removed_from_page) {
 		m_removed_from_page = removed_from_page;
 	}
@@ -238,12 +404,18 @@ public:
 		return capacity() + overhead_size();
 	}
 
+	/*
+	 * Memory used by object besides its value: data_t itself, raw_data_t together
+	 * with shared_ptr control block (allocated by single make_shared() call)
+	 * and node of the hash index, each of them is a separate malloc() chunk.
+	 */
 	size_t overhead_size(void) const {
-		return sizeof(*this) + sizeof(*m_data);
+		return sizeof(*this) + sizeof(raw_data_t) + shared_control_block_size + index_node_size
+			+ 3 * malloc_chunk_overhead;
 	}
 
 	size_t capacity(void) const {
-		return m_data->data().capacity();
+		return m_data->capacity();
 	}
 
 	friend bool operator< (const data_t &a, const data_t &b) {
@@ -258,45 +430,26 @@ public:
 		return dnet_id_cmp_str(a.id().id, b.id().id) == 0;
 	}
 
-	// treap_node_t
-	typedef treap_node_traits<data_t>::key_type key_type;
-	typedef treap_node_traits<data_t>::priority_type priority_type;
-
-	key_type get_key() const {
-		return m_id.id;
-	}
-
-	priority_type get_priority() const {
-		return eventtime();
-	}
-
-	inline static int key_compare(const key_type &lhs, const key_type &rhs) {
-		return dnet_id_cmp_str(lhs, rhs);
-	}
-
-	inline static int priority_compare(const priority_type &lhs, const priority_type &rhs) {
-		if (lhs < rhs) {
-			return 1;
-		}
-
-		if (lhs > rhs) {
-			return -1;
-		}
-
-		return 0;
-	}
-
 private:
+	static const size_t shared_control_block_size = 2 * sizeof(void *);
+	// next pointer, key, value and cached hash
+	static const size_t index_node_size = 4 * sizeof(void *);
+	static const size_t malloc_chunk_overhead = sizeof(size_t);
+
 	size_t m_lifetime;
 	size_t m_synctime;
 	dnet_time m_timestamp;
 	uint64_t m_user_flags;
-	bool m_remove_from_disk;
-	bool m_remove_from_cache;
-	bool m_only_append;
-	bool m_removed_from_page;
+	bool m_remove_from_disk : 1;
+	bool m_remove_from_cache : 1;
+	bool m_only_append : 1;
+	bool m_removed_from_page : 1;
+	bool m_compressed : 1;
 	sync_state_t m_sync_state;
 	char m_cache_page_number;
+	unsigned char m_partition;
+	uint8_t m_csum_type;
+	std::atomic<bool> m_referenced;
 	struct dnet_raw_id m_id;
 	std::shared_ptr<raw_data_t> m_data;
 };
@@ -305,7 +458,7 @@ struct record_info {
 	record_info(data_t* obj) {
 		only_append = obj->only_append();
 		memcpy(id.id, obj->id().id, DNET_ID_SIZE);
-		data = obj->data()->data();
+		data.assign(obj->data()->data(), obj->data()->data() + obj->data()->size());
 		user_flags = obj->user_flags();
 		timestamp = obj->timestamp();
 		is_synced = false;
@@ -338,26 +491,131 @@ struct eventtime_less {
 	}
 };
 
-typedef treap<data_t> treap_t;
+typedef timer_wheel<data_t> timer_wheel_t;
+
+/*
+ * Hash index of cached objects, key points to id stored in data_t itself.
+ * Ids are already uniformly distributed, and shards are selected by the first and the last words of id,
+ * so some word from the middle is used as hash.
+ */
+struct data_id_hash {
+	size_t operator() (const unsigned char *id) const {
+		size_t hash;
+		memcpy(&hash, id + DNET_ID_SIZE / 2, sizeof(hash));
+		return hash;
+	}
+};
+
+struct data_id_equal {
+	bool operator() (const unsigned char *lhs, const unsigned char *rhs) const {
+		return memcmp(lhs, rhs, DNET_ID_SIZE) == 0;
+	}
+};
+
+typedef std::unordered_map<const unsigned char *, data_t *, data_id_hash, data_id_equal> data_index_t;
+
+/*
+ * Cached objects ordered by id, used to answer range requests from memory
+ */
+typedef boost::intrusive::set<data_t,
+	boost::intrusive::base_hook<data_id_set_hook_t>,
+	boost::intrusive::constant_time_size<false>
+> data_id_set_t;
+
+struct data_id_key_less {
+	bool operator() (const unsigned char *lhs, const data_t &rhs) const {
+		return dnet_id_cmp_str(lhs, rhs.id().id) < 0;
+	}
+
+	bool operator() (const data_t &lhs, const unsigned char *rhs) const {
+		return dnet_id_cmp_str(lhs.id().id, rhs) < 0;
+	}
+};
+
+/*
+ * Object found by range read, data is shared with the cache, so it stays valid after shard is unlocked
+ */
+struct cache_range_entry_t {
+	dnet_raw_id id;
+	std::shared_ptr<raw_data_t> data;
+	dnet_time timestamp;
+	uint64_t user_flags;
+};
+
+/*
+ * Statistics of cache partition, see cache_partition_config
+ */
+struct cache_partition_stats {
+	cache_partition_stats() : size(0), min_size(0), max_size(0), hits(0), misses(0), evicted_size(0) {}
+
+	std::string name;
+	std::size_t size;
+	std::size_t min_size;
+	std::size_t max_size;
+	std::size_t hits;
+	// misses of objects read from disk, misses of absent objects have no partition
+	std::size_t misses;
+	// bytes evicted to keep partition within its maximum share
+	std::size_t evicted_size;
+};
 
 struct cache_stats {
 	cache_stats():
 		number_of_objects(0), size_of_objects(0),
-		number_of_objects_marked_for_deletion(0), size_of_objects_marked_for_deletion(0) {}
+		number_of_objects_marked_for_deletion(0), size_of_objects_marked_for_deletion(0),
+		number_of_hits(0), number_of_misses(0),
+		admission_accepted(0), admission_rejected(0), coalesced_misses(0),
+		sync_queue_objects(0), sync_queue_size(0),
+		synced_objects(0), synced_size(0),
+		compressed_objects(0), compressed_size(0), compressed_original_size(0) {}
 
 	std::size_t number_of_objects;
 	std::size_t size_of_objects;
 	std::size_t number_of_objects_marked_for_deletion;
 	std::size_t size_of_objects_marked_for_deletion;
 
+	std::size_t number_of_hits;
+	std::size_t number_of_misses;
+	// objects read from disk which were (not) allowed to evict coldest object by admission filter
+	std::size_t admission_accepted;
+	std::size_t admission_rejected;
+	// misses which waited for disk read of the same object started by another request
+	std::size_t coalesced_misses;
+
+	// objects (and their size) due for sync which are waiting for sync bandwidth
+	std::size_t sync_queue_objects;
+	std::size_t sync_queue_size;
+	std::size_t synced_objects;
+	std::size_t synced_size;
+
+	// objects kept compressed in cold pages, their size and size they would take uncompressed
+	std::size_t compressed_objects;
+	std::size_t compressed_size;
+	std::size_t compressed_original_size;
+
 	std::vector<size_t> pages_sizes;
 	std::vector<size_t> pages_max_sizes;
 
+	// configured partitions followed by the default one, empty if cache is not partitioned
+	std::vector<cache_partition_stats> partitions;
+
 	rapidjson::Value& to_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const {
 		stat_value.AddMember("size", size_of_objects, allocator)
 				  .AddMember("removing_size", size_of_objects_marked_for_deletion, allocator)
 				  .AddMember("objects", number_of_objects, allocator)
-				  .AddMember("removing_objects", number_of_objects_marked_for_deletion, allocator);
+				  .AddMember("removing_objects", number_of_objects_marked_for_deletion, allocator)
+				  .AddMember("hits", number_of_hits, allocator)
+				  .AddMember("misses", number_of_misses, allocator)
+				  .AddMember("admission_accepted", admission_accepted, allocator)
+				  .AddMember("admission_rejected", admission_rejected, allocator)
+				  .AddMember("coalesced_misses", coalesced_misses, allocator)
+				  .AddMember("sync_queue_objects", sync_queue_objects, allocator)
+				  .AddMember("sync_queue_size", sync_queue_size, allocator)
+				  .AddMember("synced_objects", synced_objects, allocator)
+				  .AddMember("synced_size", synced_size, allocator)
+				  .AddMember("compressed_objects", compressed_objects, allocator)
+				  .AddMember("compressed_size", compressed_size, allocator)
+				  .AddMember("compressed_original_size", compressed_original_size, allocator);
 
 		rapidjson::Value pages_sizes_stat(rapidjson::kArrayType);
 		for (auto it = pages_sizes.begin(), end = pages_sizes.end(); it != end; ++it) {
@@ -370,10 +628,44 @@ struct cache_stats {
 			pages_max_sizes_stat.PushBack(*it, allocator);
 		}
 		stat_value.AddMember("pages_max_sizes", pages_max_sizes_stat, allocator);
+
+		if (!partitions.empty()) {
+			rapidjson::Value partitions_stat(rapidjson::kObjectType);
+			for (auto it = partitions.begin(), end = partitions.end(); it != end; ++it) {
+				rapidjson::Value partition_stat(rapidjson::kObjectType);
+				partition_stat.AddMember("size", it->size, allocator)
+					      .AddMember("min_size", it->min_size, allocator)
+					      .AddMember("max_size", it->max_size, allocator)
+					      .AddMember("hits", it->hits, allocator)
+					      .AddMember("misses", it->misses, allocator)
+					      .AddMember("evicted_size", it->evicted_size, allocator);
+				partitions_stat.AddMember(it->name.c_str(), allocator, partition_stat, allocator);
+			}
+			stat_value.AddMember("partitions", partitions_stat, allocator);
+		}
 		return stat_value;
 	}
 };
 
+/*
+ * Hot keys snapshot, see cache_manager::save_snapshot()
+ */
+struct cache_snapshot_header {
+	static const uint64_t snapshot_magic = 0x50414e5348434c45ULL; // "ELCHSNAP"
+	static const uint32_t snapshot_version = 1;
+
+	uint64_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t records_number;
+};
+
+struct cache_snapshot_record {
+	unsigned char id[DNET_ID_SIZE];
+	// SLRU page object was in
+	uint32_t page_number;
+};
+
 class slru_cache_t;
 
 class cache_manager {
@@ -386,10 +678,27 @@ class cache_manager {
 
 		std::shared_ptr<raw_data_t> read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io);
 
+		/*
+		 * Returns cached object without waiting for the shard lock and without reading it from disk,
+		 * NULL means either miss or contended lock
+		 */
+		std::shared_ptr<raw_data_t> try_read(const unsigned char *id, dnet_io_attr *io);
+
 		int remove(const unsigned char *id, dnet_io_attr *io);
 
 		int lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd);
 
+		/*
+		 * Collects cached objects with ids in [io->id, io->parent] ordered by id,
+		 * io->start objects are skipped and at most io->num (if not zero) are returned
+		 */
+		void read_range(const dnet_io_attr *io, std::vector<cache_range_entry_t> &entries);
+
+		/*
+		 * Queues keys of @count @ios to be loaded by prefetch thread, returns number of queued keys
+		 */
+		size_t prefetch(const dnet_io_attr *ios, size_t count);
+
 		int indexes_find(dnet_cmd *cmd, dnet_indexes_request *request);
 
 		int indexes_update(dnet_cmd *cmd, dnet_indexes_request *request);
@@ -400,6 +709,12 @@ class cache_manager {
 
 		size_t cache_size() const;
 
+		/*
+		 * Changes size of the whole cache and proportions of pages keeping cached objects,
+		 * empty @pages_proportions keeps current ones. Shards count does not change.
+		 */
+		void resize(size_t size, const std::vector<size_t> &pages_proportions);
+
 		size_t cache_pages_number() const;
 
 		cache_stats get_total_cache_stats() const;
@@ -418,19 +733,172 @@ class cache_manager {
 
 	private:
 		dnet_node *m_node;
+		dnet_backend_io *m_backend;
 		std::vector<std::shared_ptr<slru_cache_t>> m_caches;
 		size_t m_max_cache_size;
 		size_t m_cache_pages_number;
+		std::vector<size_t> m_pages_proportions;
+		// serializes resize() calls
+		std::mutex m_resize_lock;
+
+		std::string m_snapshot_path;
+		unsigned m_snapshot_interval;
+		size_t m_snapshot_prefetch_rate;
+		std::thread m_snapshot_thread;
+		std::mutex m_snapshot_lock;
+		std::condition_variable m_snapshot_cond;
+		bool m_snapshot_stop;
+
+		// keys hinted by DNET_IO_FLAGS_CACHE_PREFETCH
+		size_t m_prefetch_queue_size;
+		size_t m_prefetch_rate;
+		std::deque<dnet_raw_id> m_prefetch_queue;
+		std::thread m_prefetch_thread;
+		std::mutex m_prefetch_lock;
+		std::condition_variable m_prefetch_cond;
+		bool m_prefetch_stop;
+
+		// hot keys periodically sent to replicas as prefetch hints
+		unsigned m_hotset_interval;
+		size_t m_hotset_size;
+		std::vector<int> m_hotset_groups;
+		std::thread m_hotset_thread;
+		std::mutex m_hotset_lock;
+		std::condition_variable m_hotset_cond;
+		bool m_hotset_stop;
 
 		size_t idx(const unsigned char *id);
+
+		void save_snapshot();
+
+		void load_snapshot();
+
+		bool snapshot_wait_until(std::chrono::steady_clock::time_point deadline);
+
+		void snapshot_thread();
+
+		void prefetch_thread();
+
+		std::vector<int> hotset_groups() const;
+
+		void send_hotset();
+
+		void hotset_thread();
+};
+
+/*
+ * Reader-writer mutex for cache shards.
+ * Exclusive lock()/unlock() make it usable with elliptics_unique_lock, read hits take it in shared mode.
+ */
+class rw_mutex
+{
+public:
+	rw_mutex()
+	{
+		pthread_rwlockattr_t attr;
+		pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+		// stream of read hits must not starve writers and life check
+		pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+		pthread_rwlock_init(&m_lock, &attr);
+		pthread_rwlockattr_destroy(&attr);
+	}
+
+	~rw_mutex()
+	{
+		pthread_rwlock_destroy(&m_lock);
+	}
+
+	rw_mutex(const rw_mutex &) = delete;
+	rw_mutex &operator =(const rw_mutex &) = delete;
+
+	void lock()
+	{
+		pthread_rwlock_wrlock(&m_lock);
+	}
+
+	bool try_lock()
+	{
+		return pthread_rwlock_trywrlock(&m_lock) == 0;
+	}
+
+	void unlock()
+	{
+		pthread_rwlock_unlock(&m_lock);
+	}
+
+	void lock_shared()
+	{
+		pthread_rwlock_rdlock(&m_lock);
+	}
+
+	bool try_lock_shared()
+	{
+		return pthread_rwlock_tryrdlock(&m_lock) == 0;
+	}
+
+	void unlock_shared()
+	{
+		pthread_rwlock_unlock(&m_lock);
+	}
+
+private:
+	pthread_rwlock_t m_lock;
+};
+
+class shared_lock_guard
+{
+public:
+	shared_lock_guard(rw_mutex &mutex) : m_mutex(mutex), m_owns(true)
+	{
+		m_mutex.lock_shared();
+	}
+
+	shared_lock_guard(rw_mutex &mutex, std::try_to_lock_t) : m_mutex(mutex)
+	{
+		m_owns = m_mutex.try_lock_shared();
+	}
+
+	~shared_lock_guard()
+	{
+		if (m_owns)
+			unlock();
+	}
+
+	shared_lock_guard(const shared_lock_guard &) = delete;
+	shared_lock_guard &operator =(const shared_lock_guard &) = delete;
+
+	bool owns_lock() const
+	{
+		return m_owns;
+	}
+
+	void lock()
+	{
+		m_mutex.lock_shared();
+		m_owns = true;
+	}
+
+	void unlock()
+	{
+		m_mutex.unlock_shared();
+		m_owns = false;
+	}
+
+private:
+	rw_mutex &m_mutex;
+	bool m_owns;
 };
 
 template <typename T>
 class elliptics_unique_lock
 {
 public:
-	elliptics_unique_lock(T &mutex, dnet_node *node, const char *format, ...) __attribute__ ((format(printf, 4, 5)))
-		: m_node(node)
+	elliptics_unique_lock(T &mutex, dnet_node *node, struct dnet_lock_site *site, const char *format, ...)
+		__attribute__ ((format(printf, 5, 6)))
+		: m_mutex(mutex, site)
+		, m_node(node)
 	{
 		va_list args;
 		va_start(args, format);
@@ -440,7 +908,7 @@ public:
 		va_end(args);
 
 		long vatime = m_timer.elapsed();
-		m_guard = std::move(std::unique_lock<T>(mutex));
+		m_guard = std::move(std::unique_lock<dnet_site_mutex<T>>(m_mutex));
 		dnet_log_level level = DNET_LOG_DEBUG;
 
 		if (m_timer.elapsed() > 100)
@@ -495,7 +963,8 @@ public:
 	}
 
 private:
-	std::unique_lock<T> m_guard;
+	dnet_site_mutex<T> m_mutex;
+	std::unique_lock<dnet_site_mutex<T>> m_guard;
 	dnet_node *m_node;
 	char m_name[256];
 	elliptics_timer m_timer;
@@ -0,0 +1,119 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "compression.hpp"
+#include "cache.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#ifdef HAVE_LZ4
+#  include <lz4.h>
+#endif
+
+namespace ioremap { namespace cache {
+
+// smaller values are cheaper to keep as is, than to decompress on every read
+static const size_t min_compressed_size = 512;
+
+static std::atomic<size_t> compressions(0);
+static std::atomic<size_t> compress_time(0);
+static std::atomic<size_t> decompressions(0);
+static std::atomic<size_t> decompress_time(0);
+
+static size_t elapsed_us(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool value_compressor::enabled()
+{
+#ifdef HAVE_LZ4
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef HAVE_LZ4
+std::shared_ptr<raw_data_t> value_compressor::compress(const raw_data_t &value)
+{
+	const uint64_t size = value.size();
+	if (size < min_compressed_size || size > LZ4_MAX_INPUT_SIZE)
+		return std::shared_ptr<raw_data_t>();
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// it is worth keeping compressed only if it saves at least 1/8 of memory
+	const int max_compressed_size = size - size / 8 - sizeof(size);
+
+	std::vector<char> buffer(sizeof(size) + max_compressed_size);
+	memcpy(buffer.data(), &size, sizeof(size));
+
+	int compressed_size = LZ4_compress_default(value.data(), buffer.data() + sizeof(size), size, max_compressed_size);
+
+	compressions++;
+	compress_time += elapsed_us(start);
+
+	if (compressed_size <= 0)
+		return std::shared_ptr<raw_data_t>();
+
+	return std::make_shared<raw_data_t>(buffer.data(), sizeof(size) + compressed_size);
+}
+
+std::shared_ptr<raw_data_t> value_compressor::decompress(const raw_data_t &value)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const uint64_t size = original_size(value);
+	std::shared_ptr<raw_data_t> result = std::make_shared<raw_data_t>(size);
+
+	int err = LZ4_decompress_safe(value.data() + sizeof(size), result->data(), value.size() - sizeof(size), size);
+	if (err < 0 || uint64_t(err) != size)
+		throw std::runtime_error("cache: corrupted compressed value");
+
+	decompressions++;
+	decompress_time += elapsed_us(start);
+
+	return result;
+}
+#else
+std::shared_ptr<raw_data_t> value_compressor::compress(const raw_data_t &)
+{
+	return std::shared_ptr<raw_data_t>();
+}
+
+std::shared_ptr<raw_data_t> value_compressor::decompress(const raw_data_t &)
+{
+	throw std::logic_error("cache: compression is not supported");
+}
+#endif
+
+size_t value_compressor::original_size(const raw_data_t &value)
+{
+	uint64_t size;
+	memcpy(&size, value.data(), sizeof(size));
+	return size;
+}
+
+value_compressor::stats value_compressor::get_stats()
+{
+	stats result;
+	result.compressions = compressions;
+	result.compress_time = compress_time;
+	result.decompressions = decompressions;
+	result.decompress_time = decompress_time;
+	return result;
+}
+
+}}
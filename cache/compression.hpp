@@ -0,0 +1,63 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <memory>
+
+namespace ioremap { namespace cache {
+
+class raw_data_t;
+
+/*
+ * LZ4 compression of values stored in cold SLRU pages.
+ * Compressed value is original size followed by LZ4 block.
+ *
+ * Counters are shared by caches of all backends.
+ */
+class value_compressor {
+public:
+	struct stats {
+		stats() : compressions(0), compress_time(0), decompressions(0), decompress_time(0) {}
+
+		size_t compressions;
+		// microseconds
+		size_t compress_time;
+		size_t decompressions;
+		size_t decompress_time;
+	};
+
+	/*
+	 * Whether elliptics was built with compression support
+	 */
+	static bool enabled();
+
+	/*
+	 * Returns compressed @value or empty pointer if value is too small or is not compressible enough
+	 */
+	static std::shared_ptr<raw_data_t> compress(const raw_data_t &value);
+
+	static std::shared_ptr<raw_data_t> decompress(const raw_data_t &value);
+
+	/*
+	 * Returns size of compressed @value after decompression
+	 */
+	static size_t original_size(const raw_data_t &value);
+
+	static stats get_stats();
+};
+
+}}
+
+#endif // COMPRESSION_HPP
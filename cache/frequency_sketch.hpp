@@ -0,0 +1,113 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <cstring>
+#include <memory>
+#if __GNUC__ == 4 && __GNUC_MINOR__ < 5
+#  include <cstdatomic>
+#else
+#  include <atomic>
+#endif
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Count-min sketch of key access frequencies used by TinyLFU admission policy.
+ *
+ * There are sketch_depth rows of 4-bit saturating counters (stored in bytes for simplicity).
+ * Keys are already uniformly distributed hashes, so different words of id are used as row hashes
+ * (not the ones used to select cache shard and hash index bucket).
+ * After number of increments reaches 10 * width all counters are halved, thus old popularity fades away.
+ *
+ * increment() and estimate() may be called concurrently under shared cache lock,
+ * races may only lose some increments, which is fine for an estimate.
+ */
+class frequency_sketch {
+public:
+	frequency_sketch(size_t expected_entries) : m_additions(0) {
+		m_width = 1024;
+		while (m_width < expected_entries && m_width < max_width)
+			m_width <<= 1;
+
+		m_mask = m_width - 1;
+		m_sample_size = 10 * m_width;
+		m_table.reset(new std::atomic<uint8_t>[m_width * sketch_depth]);
+		for (size_t i = 0; i < m_width * sketch_depth; ++i)
+			m_table[i].store(0, std::memory_order_relaxed);
+	}
+
+	frequency_sketch(const frequency_sketch &) = delete;
+	frequency_sketch &operator =(const frequency_sketch &) = delete;
+
+	void increment(const unsigned char *id) {
+		bool added = false;
+
+		for (size_t row = 0; row < sketch_depth; ++row) {
+			std::atomic<uint8_t> &counter = m_table[index(id, row)];
+			uint8_t value = counter.load(std::memory_order_relaxed);
+
+			// saturated counters of hot keys are not written at all
+			if (value < max_counter) {
+				counter.store(value + 1, std::memory_order_relaxed);
+				added = true;
+			}
+		}
+
+		if (added && ++m_additions == m_sample_size)
+			reset();
+	}
+
+	uint8_t estimate(const unsigned char *id) const {
+		uint8_t result = max_counter;
+
+		for (size_t row = 0; row < sketch_depth; ++row) {
+			uint8_t value = m_table[index(id, row)].load(std::memory_order_relaxed);
+			if (value < result)
+				result = value;
+		}
+
+		return result;
+	}
+
+private:
+	static const size_t sketch_depth = 4;
+	static const size_t max_width = 1 << 20;
+	static const uint8_t max_counter = 15;
+
+	size_t index(const unsigned char *id, size_t row) const {
+		uint32_t hash;
+		memcpy(&hash, id + DNET_ID_SIZE / 4 + row * sizeof(hash), sizeof(hash));
+		return row * m_width + (hash & m_mask);
+	}
+
+	void reset() {
+		for (size_t i = 0; i < m_width * sketch_depth; ++i)
+			m_table[i].store(m_table[i].load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+
+		m_additions = 0;
+	}
+
+	size_t m_width;
+	size_t m_mask;
+	size_t m_sample_size;
+	std::atomic<size_t> m_additions;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_table;
+};
+
+}}
+
+#endif // FREQUENCY_SKETCH_HPP
@@ -0,0 +1,199 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "slab_allocator.hpp"
+#include "library/elliptics.h"
+#include "library/hugepage.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace ioremap { namespace cache {
+
+// allocators are never destroyed: values may be freed by other static objects at exit
+static std::atomic<slab_allocator *> allocators[slab_allocator::max_numa_nodes];
+static std::mutex allocators_lock;
+
+slab_allocator &slab_allocator::instance()
+{
+	// threads are bound to their node at start, so node is resolved only once
+	static __thread int numa_node = -2;
+	if (numa_node == -2)
+		numa_node = dnet_numa_current_node();
+
+	return instance(numa_node);
+}
+
+slab_allocator &slab_allocator::instance(int numa_node)
+{
+	if (numa_node < 0 || numa_node >= max_numa_nodes)
+		numa_node = 0;
+
+	slab_allocator *allocator = allocators[numa_node].load(std::memory_order_acquire);
+	if (!allocator) {
+		std::lock_guard<std::mutex> guard(allocators_lock);
+
+		allocator = allocators[numa_node].load(std::memory_order_relaxed);
+		if (!allocator) {
+			allocator = new slab_allocator();
+			allocators[numa_node].store(allocator, std::memory_order_release);
+		}
+	}
+
+	return *allocator;
+}
+
+std::vector<slab_allocator::stats> slab_allocator::get_nodes_stats()
+{
+	std::vector<stats> result;
+
+	for (int numa_node = 0; numa_node < max_numa_nodes; ++numa_node) {
+		slab_allocator *allocator = allocators[numa_node].load(std::memory_order_acquire);
+		if (allocator) {
+			result.resize(numa_node + 1);
+			result[numa_node] = allocator->get_stats();
+		}
+	}
+
+	return result;
+}
+
+slab_allocator::slab_allocator() : m_large_size(0)
+{
+	for (size_t size = min_class_size; size <= max_class_size; ) {
+		m_sizes.push_back(size);
+		m_classes.emplace_back(new size_class(size));
+
+		// grow by 1.25 keeping chunks 16-byte aligned
+		size = (size + size / 4 + 15) & ~size_t(15);
+	}
+}
+
+int slab_allocator::class_index(size_t size) const
+{
+	auto it = std::lower_bound(m_sizes.begin(), m_sizes.end(), size);
+	if (it == m_sizes.end())
+		return -1;
+
+	return it - m_sizes.begin();
+}
+
+size_t slab_allocator::chunk_size(size_t size) const
+{
+	int idx = class_index(size);
+	if (idx < 0)
+		return size;
+
+	return m_sizes[idx];
+}
+
+char *slab_allocator::allocate_slab(size_class &c, size_t *size)
+{
+	const size_t huge_size = dnet_huge_pages_size();
+	if (huge_size) {
+		int backing;
+		char *slab = static_cast<char *>(dnet_huge_alloc(huge_size, &backing));
+		if (slab) {
+			*size = huge_size;
+			c.huge_slabs_size += huge_size;
+			return slab;
+		}
+	}
+
+	*size = std::max<size_t>(1, slab_size / c.size) * c.size;
+	char *slab = static_cast<char *>(malloc(*size));
+	if (!slab)
+		throw std::bad_alloc();
+
+	return slab;
+}
+
+void *slab_allocator::allocate(size_t size, size_t *capacity)
+{
+	int idx = class_index(size);
+	if (idx < 0) {
+		void *ptr = malloc(size);
+		if (!ptr)
+			throw std::bad_alloc();
+
+		*capacity = size;
+		m_large_size += malloc_usable_size(ptr);
+		return ptr;
+	}
+
+	size_class &c = *m_classes[idx];
+	*capacity = c.size;
+
+	std::lock_guard<std::mutex> guard(c.lock);
+
+	if (!c.free_list) {
+		size_t slab_bytes;
+		char *slab = allocate_slab(c, &slab_bytes);
+		const size_t num = slab_bytes / c.size;
+
+		for (size_t i = 0; i < num; ++i) {
+			void *chunk = slab + i * c.size;
+			*static_cast<void **>(chunk) = c.free_list;
+			c.free_list = chunk;
+		}
+
+		c.slabs_size += slab_bytes;
+	}
+
+	void *chunk = c.free_list;
+	c.free_list = *static_cast<void **>(chunk);
+	c.used_size += c.size;
+
+	return chunk;
+}
+
+void slab_allocator::deallocate(void *ptr, size_t capacity)
+{
+	if (!ptr)
+		return;
+
+	int idx = class_index(capacity);
+	if (idx < 0) {
+		m_large_size -= malloc_usable_size(ptr);
+		free(ptr);
+		return;
+	}
+
+	size_class &c = *m_classes[idx];
+
+	std::lock_guard<std::mutex> guard(c.lock);
+	*static_cast<void **>(ptr) = c.free_list;
+	c.free_list = ptr;
+	c.used_size -= c.size;
+}
+
+slab_allocator::stats slab_allocator::get_stats() const
+{
+	stats result;
+
+	for (auto it = m_classes.begin(); it != m_classes.end(); ++it) {
+		size_class &c = **it;
+
+		std::lock_guard<std::mutex> guard(c.lock);
+		result.slabs_size += c.slabs_size;
+		result.huge_slabs_size += c.huge_slabs_size;
+		result.used_size += c.used_size;
+	}
+
+	result.large_size = m_large_size;
+	return result;
+}
+
+}}
@@ -0,0 +1,119 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if __GNUC__ == 4 && __GNUC_MINOR__ < 5
+#  include <cstdatomic>
+#else
+#  include <atomic>
+#endif
+
+namespace ioremap { namespace cache {
+
+/*
+ * Size-classed allocator for cached values.
+ *
+ * Class sizes grow by 1.25 starting from 32 bytes, so at most 20% of every chunk is wasted
+ * (comparing to up to 50% with power-of-two sizes and malloc headers for every small value).
+ * Chunks are carved from 1 MiB slabs which are never returned to the system,
+ * thus slabs size is what cache values really cost in RSS.
+ * Values larger than the biggest class are allocated by malloc().
+ *
+ * With huge pages enabled (see library/hugepage.h) slabs are huge page regions of the mode's page size,
+ * so hot values stay within few TLB entries. If region can not be mapped, slab is malloc()'ed as usual.
+ *
+ * Values can be freed from any thread (for example after read reply was sent), every class has its own lock.
+ *
+ * There is an allocator per NUMA node. instance() returns the one of the node calling thread runs on,
+ * so values written by io threads bound to a node are kept in that node's memory
+ * and their chunks are never reused by other nodes.
+ */
+class slab_allocator {
+public:
+	struct stats {
+		stats() : slabs_size(0), huge_slabs_size(0), used_size(0), large_size(0) {}
+
+		// memory taken from the system for slabs
+		size_t slabs_size;
+		// part of slabs size backed by huge page regions
+		size_t huge_slabs_size;
+		// part of slabs size occupied by chunks in use
+		size_t used_size;
+		// memory used by values which do not fit any class
+		size_t large_size;
+	};
+
+	static const int max_numa_nodes = 64;
+
+	/*
+	 * Allocator of the node calling thread runs on
+	 */
+	static slab_allocator &instance();
+	static slab_allocator &instance(int numa_node);
+
+	/*
+	 * Returns stats of every node which has allocator, indexed by node
+	 */
+	static std::vector<stats> get_nodes_stats();
+
+	/*
+	 * Returns memory for at least @size bytes, real size of the chunk is returned in @capacity
+	 */
+	void *allocate(size_t size, size_t *capacity);
+	void deallocate(void *ptr, size_t capacity);
+
+	/*
+	 * Returns real size of the chunk which would be allocated for @size bytes
+	 */
+	size_t chunk_size(size_t size) const;
+
+	stats get_stats() const;
+
+private:
+	static const size_t min_class_size = 32;
+	static const size_t max_class_size = 256 * 1024;
+	static const size_t slab_size = 1024 * 1024;
+
+	struct size_class {
+		size_class(size_t size) : size(size), free_list(NULL), slabs_size(0), huge_slabs_size(0), used_size(0) {}
+
+		std::mutex lock;
+		size_t size;
+		void *free_list;
+		size_t slabs_size;
+		size_t huge_slabs_size;
+		size_t used_size;
+	};
+
+	slab_allocator();
+	slab_allocator(const slab_allocator &) = delete;
+	slab_allocator &operator =(const slab_allocator &) = delete;
+
+	int class_index(size_t size) const;
+
+	// returns new slab for class @c and its size, must be called with class lock held
+	char *allocate_slab(size_class &c, size_t *size);
+
+	std::vector<size_t> m_sizes;
+	std::vector<std::unique_ptr<size_class>> m_classes;
+	std::atomic<size_t> m_large_size;
+};
+
+}}
+
+#endif // SLAB_ALLOCATOR_HPP
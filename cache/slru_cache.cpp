@@ -21,6 +21,8 @@
 #include "slru_cache.hpp"
 #include "library/request_queue.h"
 #include <cassert>
+#include <algorithm>
+#include <numeric>
 
 #include "monitor/measure_points.h"
 
@@ -46,15 +48,43 @@ namespace ioremap { namespace cache {
 // public:
 
 slru_cache_t::slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n,
-	const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout) :
+	const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout, size_t sync_bandwidth, bool admission,
+	size_t compressed_pages, const std::vector<cache_partition_config> &partitions,
+	const cache_append_buffer_config &append_buffer) :
 	m_backend(backend),
 	m_node(n),
 	m_cache_pages_number(cache_pages_max_sizes.size()),
 	m_cache_pages_max_sizes(cache_pages_max_sizes),
+	m_cache_pages_target_sizes(cache_pages_max_sizes),
 	m_cache_pages_sizes(m_cache_pages_number, 0),
 	m_cache_pages_lru(new lru_list_t[m_cache_pages_number]),
+	m_timers(cache_time_ms(), timer_tick_ms),
 	m_clear_occured(false),
-	m_sync_timeout(sync_timeout) {
+	m_sync_timeout(sync_timeout),
+	m_admission(admission),
+	// there is no way to know number of objects, so assume they are about 4k each
+	m_sketch(std::accumulate(cache_pages_max_sizes.begin(), cache_pages_max_sizes.end(), size_t(0)) / 4096),
+	m_hits(0),
+	m_misses(0),
+	m_sync_bandwidth(sync_bandwidth),
+	m_sync_tokens(sync_bandwidth),
+	m_sync_tokens_time(cache_time_ms()),
+	m_sync_queue_size(0),
+	m_compressed_page(m_cache_pages_number - std::min(compressed_pages, m_cache_pages_number)),
+	m_memory_charged(0),
+	m_partitions(partitions),
+	m_append_buffer(append_buffer) {
+	if (!m_partitions.empty()) {
+		m_partitions.push_back(cache_partition_config{"default", 0, 0, 0, 1});
+		m_partition_states.reset(new partition_state_t[m_partitions.size()]);
+	}
+
+	if (compressed_pages && !value_compressor::enabled()) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: backend: %zu: elliptics is built without compression support, "
+				"cold pages will not be compressed", m_backend->backend_id);
+		m_compressed_page = m_cache_pages_number;
+	}
+
 	m_lifecheck = std::thread(std::bind(&slru_cache_t::life_check, this));
 }
 
@@ -64,6 +94,8 @@ slru_cache_t::~slru_cache_t() {
 	m_lifecheck.join();
 	dnet_log(m_node, DNET_LOG_NOTICE, "cache: disable: backend: %zu: clearing\n", m_backend->backend_id);
 	clear();
+	if (m_memory_charged)
+		dnet_memory_charge(m_node, DNET_MEMORY_CACHE, -static_cast<int64_t>(m_memory_charged));
 	dnet_log(m_node, DNET_LOG_NOTICE, "cache: disable: backend: %zu: destructed\n", m_backend->backend_id);
 }
 
@@ -78,14 +110,20 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	const bool append = (io->flags & DNET_IO_FLAGS_APPEND);
 
 	TIMER_START("write.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE WRITE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache write"), "%s: CACHE WRITE: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("write.lock");
 
 	TIMER_START("write.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = find_data(id);
 	TIMER_STOP("write.find");
 
-	if (!it && !cache) {
+	if (m_admission)
+		m_sketch.increment(id);
+
+	// plain appends of uncached object are buffered instead of being written to disk one by one
+	const bool buffered = !it && !cache && append && append_bufferable(io);
+
+	if (!it && !cache && !buffered) {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: not a cache call", dnet_dump_id_str(id));
 		return -ENOTSUP;
 	}
@@ -97,19 +135,18 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 
 			bool new_page = false;
 			if (!it) {
-				it = create_data(id, 0, 0, false);
+				it = create_data(id, 0, 0, false, io->user_flags);
 				new_page = true;
 				it->set_only_append(true);
 				size_t previous_eventtime = it->eventtime();
-				it->set_synctime(time(NULL) + m_sync_timeout);
+				it->set_synctime(cache_time_ms() + (buffered ? m_append_buffer.age : m_sync_timeout * 1000));
 
 				if (previous_eventtime != it->eventtime()) {
-					TIMER_SCOPE("write.decrease_key");
-					m_treap.decrease_key(it);
+					TIMER_SCOPE("write.update_timer");
+					update_timer(it);
 				}
 			}
 
-			auto &raw = it->data()->data();
 			size_t page_number = it->cache_page_number();
 			size_t new_page_number = page_number;
 			size_t new_size = it->size() + io->size;
@@ -126,7 +163,10 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 				m_cache_stats.size_of_objects_marked_for_deletion -= it->size();
 			}
 			m_cache_stats.size_of_objects -= it->size();
-			raw.insert(raw.end(), data, data + io->size);
+			decompress_data(it);
+			raw_data_t &appended = it->writable_data();
+			const size_t offset = appended.size();
+			appended.append(data, io->size);
 			m_cache_stats.size_of_objects += it->size();
 			if (it->remove_from_cache()) {
 				m_cache_stats.size_of_objects_marked_for_deletion += it->size();
@@ -137,6 +177,28 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 			it->set_timestamp(io->timestamp);
 			it->set_user_flags(io->user_flags);
 
+			// only top-level writes are acked by the flush, bulk and atomic updates send their own replies
+			const bool deferred = m_append_buffer.ack_on_flush && !cache &&
+				(cmd->flags & DNET_FLAGS_NEED_ACK) && !(cmd->flags & DNET_FLAGS_MORE);
+			if (deferred) {
+				defer_append_ack(it, st, cmd, io, offset);
+				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			}
+
+			if (m_append_buffer.size && offset + io->size >= m_append_buffer.size) {
+				TIMER_SCOPE("write.append_flush");
+
+				int err = sync_after_append(guard, false, &*it);
+				if (err && !deferred)
+					return err;
+			}
+
+			if (deferred)
+				return 0;
+
+			if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO)
+				return 0;
+
 			cmd->flags &= ~DNET_FLAGS_NEED_ACK;
 			return dnet_send_file_info_ts_without_fd(st, cmd, data, io->size, &io->timestamp);
 		} else if (it && it->only_append()) {
@@ -171,12 +233,14 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 
 		// Create empty data for code simplifyng
 		if (!it) {
-			it = create_data(id, 0, 0, remove_from_disk);
+			it = create_data(id, 0, 0, remove_from_disk, io->user_flags);
 			new_page = true;
 		}
 	}
 
-	raw_data_t &raw = *it->data();
+	// keeps decompressed value alive
+	std::shared_ptr<raw_data_t> raw_data = it->data();
+	raw_data_t &raw = *raw_data;
 
 	if (io->flags & DNET_IO_FLAGS_COMPARE_AND_SWAP) {
 		TIMER_SCOPE("write.cas");
@@ -185,7 +249,10 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 		// raw.size() is zero only if there is no such file on the server
 		if (raw.size() != 0) {
 			struct dnet_raw_id csum;
-			dnet_transform_node(m_node, raw.data().data(), raw.size(), csum.id, sizeof(csum.id));
+			int err = dnet_checksum_data_type(m_node, it->csum_type(), raw.data(), raw.size(),
+					csum.id, sizeof(csum.id));
+			if (err)
+				return err;
 
 			if (memcmp(csum.id, io->parent, DNET_ID_SIZE)) {
 				dnet_log(m_node, DNET_LOG_ERROR, "%s: cas: cache checksum mismatch", dnet_dump_id(&cmd->id));
@@ -242,11 +309,13 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	m_cache_stats.size_of_objects -= it->size();
 
 	TIMER_START("write.modify");
+	decompress_data(it);
+	raw_data_t &new_raw = it->writable_data();
 	if (append) {
-		raw.data().insert(raw.data().end(), data, data + size);
+		new_raw.append(data, size);
 	} else {
-		raw.data().resize(new_data_size);
-		memcpy(raw.data().data() + io->offset, data, size);
+		new_raw.resize(new_data_size);
+		memcpy(new_raw.data() + io->offset, data, size);
 	}
 	TIMER_STOP("write.modify");
 	m_cache_stats.size_of_objects += it->size();
@@ -259,23 +328,27 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	size_t previous_eventtime = it->eventtime();
 
 	if (!it->synctime() && !(io->flags & DNET_IO_FLAGS_CACHE_ONLY)) {
-		it->set_synctime(time(NULL) + m_sync_timeout);
+		it->set_synctime(cache_time_ms() + m_sync_timeout * 1000);
 	}
 
 	if (lifetime) {
-		it->set_lifetime(lifetime + time(NULL));
+		it->set_lifetime(lifetime * 1000 + cache_time_ms());
 	}
 
 	if (previous_eventtime != it->eventtime()) {
-		TIMER_SCOPE("write.decrease_key");
-		m_treap.decrease_key(it);
+		TIMER_SCOPE("write.update_timer");
+		update_timer(it);
 	}
 
 	it->set_timestamp(io->timestamp);
 	it->set_user_flags(io->user_flags);
 
+	/* writer is acked without file info, as by backend */
+	if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO)
+		return 0;
+
 	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-	return dnet_send_file_info_ts_without_fd(st, cmd, raw.data().data() + io->offset, io->size, &io->timestamp);
+	return dnet_send_file_info_ts_without_fd(st, cmd, new_raw.data() + io->offset, io->size, &io->timestamp);
 }
 
 std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io) {
@@ -285,16 +358,25 @@ std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd
 	const bool cache_only = (io->flags & DNET_IO_FLAGS_CACHE_ONLY);
 	(void) cmd;
 
+	{
+		std::shared_ptr<raw_data_t> data;
+		if (read_hit(id, io, data))
+			return data;
+	}
+
 	TIMER_START("read.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE READ: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache read"), "%s: CACHE READ: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("read.lock");
 
 	bool new_page = false;
 
 	TIMER_START("read.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = find_data(id);
 	TIMER_STOP("read.find");
 
+	if (m_admission)
+		m_sketch.increment(id);
+
 	if (it && it->only_append()) {
 		sync_after_append(guard, true, &*it);
 		it = NULL;
@@ -302,11 +384,28 @@ std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd
 
 	if (!it && cache && !cache_only) {
 		int err = 0;
-		it = populate_from_disk(guard, id, false, &err);
+		populate_bypass_t bypass;
+
+		it = populate_from_disk(guard, id, false, &err, &bypass);
 		new_page = true;
+
+		if (!it && bypass.data) {
+			m_misses++;
+			count_partition_access(partition_of(bypass.user_flags), false);
+			io->timestamp = bypass.timestamp;
+			io->user_flags = bypass.user_flags;
+			return bypass.data;
+		}
 	}
 
+	if (new_page || !it)
+		m_misses++;
+	else
+		m_hits++;
+
 	if (it) {
+		count_partition_access(it->partition(), !new_page);
+
 		size_t page_number = it->cache_page_number();
 		size_t new_page_number = page_number;
 
@@ -337,11 +436,11 @@ int slru_cache_t::remove(const unsigned char *id, dnet_io_attr *io) {
 	int err = -ENOENT;
 
 	TIMER_START("remove.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE REMOVE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache remove"), "%s: CACHE REMOVE: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("remove.lock");
 
 	TIMER_START("remove.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = find_data(id);
 	TIMER_STOP("remove.find");
 
 	if (it) {
@@ -353,8 +452,8 @@ int slru_cache_t::remove(const unsigned char *id, dnet_io_attr *io) {
 			it->clear_synctime();
 
 			if (previous_eventtime != it->eventtime()) {
-				TIMER_SCOPE("remove.decrease_key");
-				m_treap.decrease_key(it);
+				TIMER_SCOPE("remove.update_timer");
+				update_timer(it);
 			}
 		}
 		if (it->is_syncing()) {
@@ -388,11 +487,11 @@ int slru_cache_t::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 	int err = 0;
 
 	TIMER_START("lookup.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE LOOKUP: %p", dnet_dump_id_str(id), this);
+	shared_lock_guard guard(m_lock);
 	TIMER_STOP("lookup.lock");
 
 	TIMER_START("lookup.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = find_data(id);
 	TIMER_STOP("lookup.find");
 
 	if (!it) {
@@ -428,20 +527,25 @@ int slru_cache_t::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 void slru_cache_t::clear() {
 	TIMER_SCOPE("clear");
 
-	std::vector<size_t> cache_pages_max_sizes = m_cache_pages_max_sizes;
-
 	TIMER_START("clear.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE CLEAR: %p", this);
+	elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache clear"), "CACHE CLEAR: %p", this);
 	TIMER_STOP("clear.lock");
 	m_clear_occured = true;
 
+	// copied under the lock, so concurrent resize() is not lost
+	std::vector<size_t> cache_pages_max_sizes = m_cache_pages_max_sizes;
+
+	// objects from sync queue are still in SYNC_PHASE and are written by sync_if_required() below
+	m_sync_queue.clear();
+	m_sync_queue_size = 0;
+
 	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
 		m_cache_pages_max_sizes[page_number] = 0;
 		resize_page((unsigned char *) "", page_number, 0);
 	}
 
-	while (!m_treap.empty()) {
-		data_t *obj = m_treap.top();
+	while (!m_index.empty()) {
+		data_t *obj = m_index.begin()->second;
 
 		sync_if_required(obj, guard);
 		obj->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
@@ -452,16 +556,224 @@ void slru_cache_t::clear() {
 	m_cache_pages_max_sizes = cache_pages_max_sizes;
 }
 
+void slru_cache_t::hot_keys(std::vector<cache_snapshot_record> &keys, size_t limit) {
+	TIMER_SCOPE("hot_keys");
+
+	shared_lock_guard guard(m_lock);
+
+	cache_snapshot_record record;
+	memset(&record, 0, sizeof(record));
+
+	size_t num = 0;
+
+	// page 0 is the hottest one, the most recently used objects are at the back of the page
+	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
+		const lru_list_t &lru = m_cache_pages_lru[page_number];
+		for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+			if (it->remove_from_cache())
+				continue;
+			if (limit && num >= limit)
+				return;
+
+			memcpy(record.id, it->id().id, DNET_ID_SIZE);
+			record.page_number = page_number;
+			keys.push_back(record);
+			++num;
+		}
+	}
+}
+
+bool slru_cache_t::prefetch(const unsigned char *id, size_t page_number) {
+	TIMER_SCOPE("prefetch");
+
+	// backend gate has to be passed before cache lock is taken, reload waits for the gate holding no locks
+	if (dnet_backend_gate_enter(&m_backend->gate))
+		return false;
+
+	bool ret = true;
+
+	{
+		elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache prefetch"), "%s: CACHE PREFETCH: %p", dnet_dump_id_str(id), this);
+
+		if (std::accumulate(m_cache_pages_sizes.begin(), m_cache_pages_sizes.end(), size_t(0)) >=
+				std::accumulate(m_cache_pages_max_sizes.begin(), m_cache_pages_max_sizes.end(), size_t(0))) {
+			ret = false;
+		} else if (!find_data(id)) {
+			int err = 0;
+			data_t *it = populate_from_disk(guard, id, false, &err);
+
+			// new objects are put into the last page, move it back to the page it was taken from if it has space
+			if (it && !it->is_removed_from_page()) {
+				page_number = std::min(page_number, m_cache_pages_number - 1);
+				if (m_cache_pages_sizes[page_number] + it->size() <= m_cache_pages_max_sizes[page_number])
+					move_data_between_pages(id, it->cache_page_number(), page_number, it);
+			}
+		}
+	}
+
+	dnet_backend_gate_leave(&m_backend->gate);
+	return ret;
+}
+
+void slru_cache_t::prefetch_hint(const unsigned char *id) {
+	TIMER_SCOPE("prefetch_hint");
+
+	// backend gate has to be passed before cache lock is taken, reload waits for the gate holding no locks
+	if (dnet_backend_gate_enter(&m_backend->gate))
+		return;
+
+	{
+		elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache prefetch hint"), "%s: CACHE PREFETCH HINT: %p", dnet_dump_id_str(id), this);
+
+		if (m_admission)
+			m_sketch.increment(id);
+
+		if (!find_data(id)) {
+			int err = 0;
+			// object which is not admitted is read for nothing and dropped
+			populate_bypass_t bypass;
+			populate_from_disk(guard, id, false, &err, &bypass);
+		}
+	}
+
+	dnet_backend_gate_leave(&m_backend->gate);
+}
+
+void slru_cache_t::read_range(const unsigned char *start, const unsigned char *end, size_t limit, std::vector<cache_range_entry_t> &entries) {
+	TIMER_SCOPE("read_range");
+
+	shared_lock_guard guard(m_lock);
+
+	size_t count = 0;
+	for (auto it = m_id_set.lower_bound(start, data_id_key_less()); it != m_id_set.end(); ++it) {
+		if (dnet_id_cmp_str(it->id().id, end) > 0)
+			break;
+
+		if (it->only_append() || it->remove_from_cache())
+			continue;
+
+		cache_range_entry_t entry;
+		entry.id = it->id();
+		entry.data = it->data();
+		entry.timestamp = it->timestamp();
+		entry.user_flags = it->user_flags();
+		entries.push_back(entry);
+
+		if (limit && ++count == limit)
+			break;
+	}
+
+	m_hits += count;
+}
+
+void slru_cache_t::resize(const std::vector<size_t> &cache_pages_max_sizes) {
+	TIMER_SCOPE("resize");
+
+	elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache resize"), "CACHE RESIZE: %p", this);
+
+	m_cache_pages_target_sizes = cache_pages_max_sizes;
+	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
+		if (m_cache_pages_target_sizes[page_number] >= m_cache_pages_max_sizes[page_number])
+			m_cache_pages_max_sizes[page_number] = m_cache_pages_target_sizes[page_number];
+	}
+}
+
 cache_stats slru_cache_t::get_cache_stats() const {
+	m_cache_stats.number_of_hits = m_hits;
+	m_cache_stats.number_of_misses = m_misses;
+	m_cache_stats.sync_queue_objects = m_sync_queue.size();
+	m_cache_stats.sync_queue_size = m_sync_queue_size;
 	m_cache_stats.pages_sizes = m_cache_pages_sizes;
 	m_cache_stats.pages_max_sizes = m_cache_pages_max_sizes;
+
+	m_cache_stats.partitions.resize(m_partitions.size());
+	for (size_t partition = 0; partition < m_partitions.size(); ++partition) {
+		cache_partition_stats &stats = m_cache_stats.partitions[partition];
+		const partition_state_t &state = m_partition_states[partition];
+
+		stats.name = m_partitions[partition].name;
+		stats.size = state.size;
+		stats.min_size = shard_size() * m_partitions[partition].min_share;
+		stats.max_size = shard_size() * m_partitions[partition].max_share;
+		stats.hits = state.hits;
+		stats.misses = state.misses;
+		stats.evicted_size = state.evicted_size;
+	}
 	return m_cache_stats;
 }
 
 // private:
 
+/*
+ * Serves read hit under shared lock.
+ * Returns false if request must take exclusive path: object is not cached, it is append-only or is marked for removal.
+ */
+std::shared_ptr<raw_data_t> slru_cache_t::try_read(const unsigned char *id, dnet_io_attr *io) {
+	std::shared_ptr<raw_data_t> data;
+	read_hit(id, io, data, false);
+	return data;
+}
+
+bool slru_cache_t::read_hit(const unsigned char *id, dnet_io_attr *io, std::shared_ptr<raw_data_t> &data, bool wait) {
+	TIMER_SCOPE("read_hit");
+
+	bool need_promote = false;
+
+	{
+		shared_lock_guard guard(m_lock, std::try_to_lock);
+		if (!guard.owns_lock()) {
+			if (!wait)
+				return false;
+
+			guard.lock();
+		}
+
+		data_t *it = find_data(id);
+		if (!it || it->only_append() || it->remove_from_cache())
+			return false;
+
+		it->set_referenced();
+		if (m_admission)
+			m_sketch.increment(id);
+		m_hits++;
+		count_partition_access(it->partition(), true);
+
+		io->timestamp = it->timestamp();
+		io->user_flags = it->user_flags();
+		data = it->data();
+
+		size_t page_number = it->cache_page_number();
+		need_promote = (get_next_page_number(page_number) != page_number);
+	}
+
+	if (need_promote)
+		promote(id);
+
+	return true;
+}
+
+/*
+ * Moves object into hotter page if exclusive lock can be taken without waiting.
+ * Otherwise object keeps its reference bit and gets second chance when it reaches cold end of its page.
+ */
+void slru_cache_t::promote(const unsigned char *id) {
+	std::unique_lock<rw_mutex> guard(m_lock, std::try_to_lock);
+	if (!guard.owns_lock())
+		return;
+
+	TIMER_SCOPE("promote");
 
-void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex> &guard) {
+	data_t *it = find_data(id);
+	if (!it || it->is_removed_from_page())
+		return;
+
+	size_t page_number = it->cache_page_number();
+	it->clear_referenced();
+	move_data_between_pages(id, page_number, get_next_page_number(page_number), it);
+}
+
+
+void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<rw_mutex> &guard) {
 	TIMER_SCOPE("sync_if_required");
 
 	if (it && it->is_syncing()) {
@@ -469,12 +781,13 @@ void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex
 		memset(&id, 0, sizeof(id));
 		memcpy(id.id, it->id().id, DNET_ID_SIZE);
 
-		std::vector<char> data;
+		// data is never modified in place while it is referenced, so there is no need to copy it
+		std::shared_ptr<raw_data_t> data;
 		uint64_t user_flags;
 		dnet_time timestamp;
 
 		bool only_append = it->only_append();
-		data = it->data()->data();
+		data = it->data();
 		user_flags = it->user_flags();
 		timestamp = it->timestamp();
 
@@ -482,7 +795,9 @@ void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex
 
 		// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
 		if (it->is_syncing()) {
-			sync_element(id, only_append, data, user_flags, timestamp);
+			int err = sync_element(id, only_append, *data, user_flags, timestamp);
+			if (only_append)
+				complete_append_acks(take_append_acks(it), data.get(), err);
 			it->set_sync_state(data_t::sync_state_t::ERASE_PHASE);
 		}
 
@@ -494,8 +809,20 @@ void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_nu
 	TIMER_SCOPE("add_to_page");
 
 	elliptics_timer timer;
+
+	update_compression(data, page_number);
 	size_t size = data->size();
 
+	if (!m_partitions.empty()) {
+		const size_t partition = partition_of(data->user_flags());
+		data->set_partition(partition);
+
+		const size_t partition_max_size = shard_size() * m_partitions[partition].max_share;
+		if (m_partition_states[partition].size + size > partition_max_size)
+			evict_partition(partition, size);
+		m_partition_states[partition].size += size;
+	}
+
 	// Recalc used space, free enough space for new data, move object to the end of the queue
 	if (m_cache_pages_sizes[page_number] + size > m_cache_pages_max_sizes[page_number]) {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: resize called: %lld ms", dnet_dump_id_str(id), timer.restart());
@@ -508,9 +835,66 @@ void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_nu
 	m_cache_pages_sizes[page_number] += size;
 }
 
+/*
+ * Compresses value of object which goes into compressed page and decompresses it when object leaves them.
+ * Object must be already accounted in size of objects, but not in the page.
+ */
+void slru_cache_t::update_compression(data_t *obj, size_t page_number) {
+	// append-only objects are modified too often
+	const bool compress = page_number >= m_compressed_page && !obj->only_append();
+	if (compress == obj->compressed())
+		return;
+
+	const size_t previous_size = obj->size();
+
+	if (compress)
+		compress_data(obj);
+	else
+		decompress_data(obj);
+
+	m_cache_stats.size_of_objects += obj->size();
+	m_cache_stats.size_of_objects -= previous_size;
+	if (obj->remove_from_cache()) {
+		m_cache_stats.size_of_objects_marked_for_deletion += obj->size();
+		m_cache_stats.size_of_objects_marked_for_deletion -= previous_size;
+	}
+}
+
+/*
+ * Changes representation of object's value, size accounting is up to the caller
+ */
+void slru_cache_t::compress_data(data_t *obj) {
+	HANDY_TIMER_SCOPE("slru_cache.compress");
+
+	std::shared_ptr<raw_data_t> data = value_compressor::compress(obj->stored_data());
+	if (!data)
+		return;
+
+	m_cache_stats.compressed_objects++;
+	m_cache_stats.compressed_size += data->capacity();
+	m_cache_stats.compressed_original_size += obj->stored_data().size();
+
+	obj->set_data(data, true);
+}
+
+void slru_cache_t::decompress_data(data_t *obj) {
+	if (!obj->compressed())
+		return;
+
+	HANDY_TIMER_SCOPE("slru_cache.decompress");
+
+	m_cache_stats.compressed_objects--;
+	m_cache_stats.compressed_size -= obj->stored_data().capacity();
+	m_cache_stats.compressed_original_size -= value_compressor::original_size(obj->stored_data());
+
+	obj->set_data(obj->data(), false);
+}
+
 void slru_cache_t::remove_data_from_page(const unsigned char *id, size_t page_number, data_t *data) {
 	(void) id;
 	m_cache_pages_sizes[page_number] -= data->size();
+	if (!m_partitions.empty())
+		m_partition_states[data->partition()].size -= data->size();
 	if (!data->is_removed_from_page()) {
 		m_cache_pages_lru[page_number].erase(m_cache_pages_lru[page_number].iterator_to(*data));
 		data->set_removed_from_page(true);
@@ -526,28 +910,72 @@ void slru_cache_t::move_data_between_pages(const unsigned char *id, size_t sourc
 	}
 }
 
-data_t* slru_cache_t::create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk) {
+data_t* slru_cache_t::create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk,
+		uint64_t user_flags) {
 	TIMER_SCOPE("create_data");
 
 	size_t last_page_number = m_cache_pages_number - 1;
 
 	data_t *raw = new data_t(id, 0, data, size, remove_from_disk);
+	// partition is chosen by user flags when object is inserted into the page
+	raw->set_user_flags(user_flags);
 
-	insert_data_into_page(id, last_page_number, raw);
-
+	// object is accounted before insertion, which may compress it
 	m_cache_stats.number_of_objects++;
 	m_cache_stats.size_of_objects += raw->size();
-	m_treap.insert(raw);
+
+	insert_data_into_page(id, last_page_number, raw);
+
+	m_index.emplace(raw->id().id, raw);
+	m_id_set.insert(*raw);
 	return raw;
 }
 
-data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err) {
+data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<rw_mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err,
+		populate_bypass_t *bypass) {
 	TIMER_SCOPE("populate_from_disk");
 
-	if (guard.owns_lock()) {
-		guard.unlock();
+	if (!guard.owns_lock()) {
+		guard.lock();
 	}
 
+	auto inflight = m_inflight_reads.find(id);
+	if (inflight != m_inflight_reads.end() && !remove_from_disk) {
+		// somebody is already reading this object from disk, wait for its result instead of reading it once more
+		std::shared_ptr<inflight_read_t> read = inflight->second;
+		m_cache_stats.coalesced_misses++;
+
+		TIMER_START("populate_from_disk.wait");
+		while (!read->done)
+			read->cond.wait(guard);
+		TIMER_STOP("populate_from_disk.wait");
+
+		*err = read->err;
+		if (*err)
+			return NULL;
+
+		if (data_t *it = find_data(id))
+			return it;
+
+		if (bypass && read->data) {
+			bypass->data = read->data;
+			bypass->user_flags = read->user_flags;
+			bypass->timestamp = read->timestamp;
+			return NULL;
+		}
+
+		// object was not admitted into the cache or has already gone, read it ourselves
+		inflight = m_inflight_reads.find(id);
+	}
+
+	std::shared_ptr<inflight_read_t> read;
+	if (inflight == m_inflight_reads.end()) {
+		read = std::make_shared<inflight_read_t>(id);
+		m_inflight_reads.emplace(read->id.id, read);
+	}
+
+	guard.unlock();
+
 	local_session sess(m_backend, m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE);
 
@@ -556,26 +984,88 @@ data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guar
 	memcpy(raw_id.id, id, DNET_ID_SIZE);
 
 	uint64_t user_flags = 0;
+	uint8_t csum_type = DNET_CHECKSUM_SHA512;
 	dnet_time timestamp;
 	dnet_empty_time(&timestamp);
 
-	TIMER_START("populate_from_disk.local_read");
-	ioremap::elliptics::data_pointer data = sess.read(raw_id, &user_flags, &timestamp, err);
-	TIMER_STOP("populate_from_disk.local_read");
+	ioremap::elliptics::data_pointer data;
+
+	try {
+		TIMER_START("populate_from_disk.local_read");
+		data = sess.read(raw_id, &user_flags, &timestamp, &csum_type, 0, err);
+		TIMER_STOP("populate_from_disk.local_read");
+	} catch (...) {
+		guard.lock();
+		finish_inflight_read(read, -ENOMEM);
+		throw;
+	}
 
 	TIMER_START("populate_from_disk.lock");
 	guard.lock();
 	TIMER_STOP("populate_from_disk.lock");
 
+	data_t *it = NULL;
+
 	if (*err == 0) {
-		auto it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), remove_from_disk);
-		it->set_user_flags(user_flags);
-		it->set_timestamp(timestamp);
+		// object could be created by somebody else while lock was released
+		it = find_data(id);
+
+		if (!it && bypass && !admit(id, data.size())) {
+			bypass->data = std::make_shared<raw_data_t>(reinterpret_cast<char *>(data.data()), data.size());
+			bypass->user_flags = user_flags;
+			bypass->timestamp = timestamp;
+
+			if (read) {
+				read->data = bypass->data;
+				read->user_flags = user_flags;
+				read->timestamp = timestamp;
+			}
+		} else if (!it) {
+			it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), remove_from_disk, user_flags);
+			it->set_timestamp(timestamp);
+			it->set_csum_type(csum_type);
+		}
+	}
+
+	finish_inflight_read(read, *err);
+
+	return it;
+}
+
+void slru_cache_t::finish_inflight_read(const std::shared_ptr<inflight_read_t> &read, int err) {
+	if (!read)
+		return;
+
+	m_inflight_reads.erase(read->id.id);
 
-		return it;
+	read->err = err;
+	read->done = true;
+	read->cond.notify_all();
+}
+
+/*
+ * TinyLFU admission: object which does not fit into the coldest page is allowed to evict
+ * the coldest object only if it is accessed more frequently than that object.
+ */
+bool slru_cache_t::admit(const unsigned char *id, size_t size) {
+	if (!m_admission)
+		return true;
+
+	const size_t last_page_number = m_cache_pages_number - 1;
+	const lru_list_t &lru = m_cache_pages_lru[last_page_number];
+
+	size = slab_allocator::instance().chunk_size(size) + sizeof(data_t) + sizeof(raw_data_t);
+	if (lru.empty() || m_cache_pages_sizes[last_page_number] + size <= m_cache_pages_max_sizes[last_page_number])
+		return true;
+
+	const data_t &victim = lru.front();
+	if (m_sketch.estimate(id) > m_sketch.estimate(victim.id().id)) {
+		m_cache_stats.admission_accepted++;
+		return true;
 	}
 
-	return NULL;
+	m_cache_stats.admission_rejected++;
+	return false;
 }
 
 bool slru_cache_t::have_enough_space(const unsigned char *id, size_t page_number, size_t reserve) {
@@ -583,6 +1073,101 @@ bool slru_cache_t::have_enough_space(const unsigned char *id, size_t page_number
 	return m_cache_pages_max_sizes[page_number] >= reserve;
 }
 
+bool slru_cache_t::shrink_pages() {
+	// colder pages go first, so objects moved into them from hotter pages evict only about their own size
+	for (size_t page_number = m_cache_pages_number; page_number-- > 0;) {
+		size_t &max_size = m_cache_pages_max_sizes[page_number];
+		const size_t target = m_cache_pages_target_sizes[page_number];
+		if (max_size <= target)
+			continue;
+
+		const size_t size = std::min(max_size, m_cache_pages_sizes[page_number]);
+		max_size = std::max(target, size > resize_step_size ? size - resize_step_size : 0);
+		resize_page((const unsigned char *)"", page_number, 0);
+		break;
+	}
+
+	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
+		if (m_cache_pages_max_sizes[page_number] > m_cache_pages_target_sizes[page_number])
+			return true;
+	}
+	return false;
+}
+
+size_t slru_cache_t::partition_of(uint64_t user_flags) const {
+	// the default partition has zero mask, so it matches everything
+	for (size_t partition = 0; partition < m_partitions.size(); ++partition) {
+		const cache_partition_config &config = m_partitions[partition];
+		if ((user_flags & config.user_flags_mask) == config.user_flags)
+			return partition;
+	}
+	return 0;
+}
+
+bool slru_cache_t::partition_protected(size_t partition) const {
+	if (m_partitions.empty() || m_partitions[partition].min_share <= 0)
+		return false;
+
+	return m_partition_states[partition].size <= shard_size() * m_partitions[partition].min_share;
+}
+
+void slru_cache_t::evict_partition(size_t partition, size_t reserve) {
+	TIMER_SCOPE("evict_partition");
+
+	const size_t last_page_number = m_cache_pages_number - 1;
+	const size_t max_size = shard_size() * m_partitions[partition].max_share;
+	partition_state_t &state = m_partition_states[partition];
+	lru_list_t &lru = m_cache_pages_lru[last_page_number];
+
+	// only the last page is touched: resize_page() of hotter pages may be iterating them right now
+	for (auto it = lru.begin(), end = lru.end(); it != end && state.size + reserve > max_size;) {
+		data_t *raw = &*it;
+		++it;
+
+		// dirty objects are left to sync, it must not be done under the lock here
+		if (raw->partition() != partition || raw->synctime() || raw->remove_from_cache() || raw->will_be_erased())
+			continue;
+
+		state.evicted_size += raw->size();
+		erase_element(raw);
+	}
+}
+
+void slru_cache_t::govern_memory() {
+	if (!dnet_memory_enabled(m_node))
+		return;
+
+	const size_t size = m_cache_stats.size_of_objects;
+	if (size != m_memory_charged) {
+		dnet_memory_charge(m_node, DNET_MEMORY_CACHE, static_cast<int64_t>(size) - static_cast<int64_t>(m_memory_charged));
+		m_memory_charged = size;
+	}
+
+	const uint64_t excess = dnet_memory_excess(m_node, DNET_MEMORY_CACHE);
+	if (!excess || !size)
+		return;
+
+	// every cache gives up at most 1/16 of itself per tick, so all of them shrink and none is wiped at once
+	const size_t shrink = std::min<uint64_t>(excess, std::max<size_t>(size / 16, 1));
+
+	for (size_t page_number = m_cache_pages_number; page_number-- > 0;) {
+		const size_t page_size = m_cache_pages_sizes[page_number];
+		if (!page_size)
+			continue;
+
+		// objects of the last page are evicted, others are moved to colder page and evicted by next ticks
+		const size_t max_size = m_cache_pages_max_sizes[page_number];
+		const size_t reserve = max_size + shrink > page_size ? max_size + shrink - page_size : 0;
+		resize_page((const unsigned char *)"", page_number, reserve);
+
+		if (page_number + 1 == m_cache_pages_number) {
+			const size_t shrunk = page_size - std::min(page_size, m_cache_pages_sizes[page_number]);
+			__sync_add_and_fetch(&m_node->memory.cache_shrunk, shrunk);
+		}
+		break;
+	}
+}
+
 void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size_t reserve) {
 	TIMER_SCOPE("resize_page");
 
@@ -598,9 +1183,21 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 		data_t *raw = &*it;
 		++it;
 
+		// Recently read object gets second chance at the hot end of its page (CLOCK)
+		if (raw->referenced()) {
+			raw->clear_referenced();
+			m_cache_pages_lru[page_number].erase(m_cache_pages_lru[page_number].iterator_to(*raw));
+			m_cache_pages_lru[page_number].push_back(*raw);
+			if (it == end)
+				it = m_cache_pages_lru[page_number].iterator_to(*raw);
+			continue;
+		}
+
 		// If page is not last move object to previous page
 		if (previous_page_number < m_cache_pages_number) {
 			move_data_between_pages(id, page_number, previous_page_number, raw);
+		} else if (partition_protected(raw->partition())) {
+			continue;
 		} else {
 			if (raw->synctime() || raw->remove_from_cache()) {
 				if (!raw->remove_from_cache()) {
@@ -611,8 +1208,8 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 					size_t previous_eventtime = raw->eventtime();
 					raw->set_synctime(1);
 					if (previous_eventtime != raw->eventtime()) {
-						TIMER_SCOPE("resize_page.decrease_key");
-						m_treap.decrease_key(raw);
+						TIMER_SCOPE("resize_page.update_timer");
+						update_timer(raw);
 					}
 				}
 				removed_size += raw->size();
@@ -641,13 +1238,26 @@ void slru_cache_t::erase_element(data_t *obj) {
 
 	size_t page_number = obj->cache_page_number();
 	remove_data_from_page(obj->id().id, page_number, obj);
-	m_treap.erase(obj);
+	m_timers.cancel(obj);
+	m_index.erase(obj->id().id);
+	m_id_set.erase(m_id_set.iterator_to(*obj));
 
+	// appends which were not flushed by now are lost
+	int err = -ECANCELED;
 	if (obj->synctime()) {
-		sync_element(obj);
+		err = sync_element(obj);
 		obj->clear_synctime();
 	}
 
+	if (obj->only_append())
+		complete_append_acks(take_append_acks(obj), obj->data().get(), err);
+
+	if (obj->compressed()) {
+		m_cache_stats.compressed_objects--;
+		m_cache_stats.compressed_size -= obj->stored_data().capacity();
+		m_cache_stats.compressed_original_size -= value_compressor::original_size(obj->stored_data());
+	}
+
 	if (obj->remove_from_cache()) {
 		m_cache_stats.number_of_objects_marked_for_deletion--;
 		m_cache_stats.size_of_objects_marked_for_deletion -= obj->size();
@@ -656,31 +1266,40 @@ void slru_cache_t::erase_element(data_t *obj) {
 	delete obj;
 }
 
-void slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp) {
+int slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const raw_data_t &data, uint64_t user_flags, const dnet_time &timestamp) {
 	HANDY_TIMER_SCOPE("slru_cache.sync_element");
 
+	// it is nested entry everywhere but cache destruction, which never happens during reload
+	int err = dnet_backend_gate_enter(&m_backend->gate);
+	if (err) {
+		dnet_log(m_node, DNET_LOG_ERROR, "%s: CACHE: could not sync to disk, storage is unavailable, err: %d",
+				dnet_dump_id_str(raw.id), err);
+		return err;
+	}
+
 	local_session sess(m_backend, m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | (after_append ? DNET_IO_FLAGS_APPEND : 0));
 
-	int err = sess.write(raw, data.data(), data.size(), user_flags, timestamp);
+	err = sess.write(raw, data.data(), data.size(), user_flags, timestamp);
 	if (err) {
 		dnet_log(m_node, DNET_LOG_ERROR, "%s: CACHE: forced to sync to disk, err: %d", dnet_dump_id_str(raw.id), err);
 	} else {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: forced to sync to disk, err: %d", dnet_dump_id_str(raw.id), err);
 	}
+
+	dnet_backend_gate_leave(&m_backend->gate);
+	return err;
 }
 
-void slru_cache_t::sync_element(data_t *obj) {
+int slru_cache_t::sync_element(data_t *obj) {
 	struct dnet_id raw;
 	memset(&raw, 0, sizeof(struct dnet_id));
 	memcpy(raw.id, obj->id().id, DNET_ID_SIZE);
 
-	auto &data = obj->data()->data();
-
-	sync_element(raw, obj->only_append(), data, obj->user_flags(), obj->timestamp());
+	return sync_element(raw, obj->only_append(), *obj->data(), obj->user_flags(), obj->timestamp());
 }
 
-void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj) {
+int slru_cache_t::sync_after_append(elliptics_unique_lock<rw_mutex> &guard, bool lock_guard, data_t *obj) {
 	TIMER_SCOPE("sync_after_append");
 
 	std::shared_ptr<raw_data_t> raw_data = obj->data();
@@ -694,6 +1313,9 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 	uint64_t user_flags = obj->user_flags();
 	dnet_time timestamp = obj->timestamp();
 
+	// they are acked by the write below, not cancelled by erase
+	std::vector<append_ack_t> acks = take_append_acks(obj);
+
 	erase_element(&*obj);
 
 	guard.unlock();
@@ -701,10 +1323,8 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 	local_session sess(m_backend, m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | DNET_IO_FLAGS_APPEND);
 
-	auto &raw = raw_data->data();
-
 	TIMER_START("sync_after_append.local_write");
-	int err = sess.write(id, raw.data(), raw.size(), user_flags, timestamp);
+	int err = sess.write(id, raw_data->data(), raw_data->size(), user_flags, timestamp);
 	TIMER_STOP("sync_after_append.local_write");
 
 	TIMER_START("sync_after_append.lock");
@@ -712,40 +1332,165 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 		guard.lock();
 	TIMER_STOP("sync_after_append.lock");
 
+	complete_append_acks(std::move(acks), raw_data.get(), err);
+
 	dnet_log(m_node, DNET_LOG_INFO, "%s: CACHE: sync after append, err: %d", dnet_dump_id_str(id.id), err);
+	return err;
+}
+
+bool slru_cache_t::append_bufferable(const dnet_io_attr *io) const {
+	// flags which need the backend to see every write
+	static const uint64_t unbuffered = DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_COMMIT | DNET_IO_FLAGS_PLAIN_WRITE |
+		DNET_IO_FLAGS_COMPARE_AND_SWAP | DNET_IO_FLAGS_CAS_TIMESTAMP | DNET_IO_FLAGS_CACHE_ONLY;
+
+	return m_append_buffer.size && io->size < m_append_buffer.size && !(io->flags & unbuffered);
+}
+
+void slru_cache_t::defer_append_ack(const data_t *obj, dnet_net_state *st, const dnet_cmd *cmd, const dnet_io_attr *io,
+		size_t offset) {
+	append_ack_t ack;
+	ack.st = dnet_state_get(st);
+	ack.cmd = *cmd;
+	ack.offset = offset;
+	ack.size = io->size;
+	ack.timestamp = io->timestamp;
+	ack.file_info = !(io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO);
+
+	std::lock_guard<std::mutex> guard(m_append_acks_lock);
+	m_append_acks[obj].push_back(ack);
+}
+
+std::vector<slru_cache_t::append_ack_t> slru_cache_t::take_append_acks(const data_t *obj) {
+	std::vector<append_ack_t> acks;
+
+	if (!m_append_buffer.ack_on_flush)
+		return acks;
+
+	std::lock_guard<std::mutex> guard(m_append_acks_lock);
+	auto it = m_append_acks.find(obj);
+	if (it != m_append_acks.end()) {
+		acks.swap(it->second);
+		m_append_acks.erase(it);
+	}
+
+	return acks;
+}
+
+void slru_cache_t::complete_append_acks(std::vector<append_ack_t> acks, const raw_data_t *data, int err) {
+	for (auto it = acks.begin(); it != acks.end(); ++it) {
+		if (err || !it->file_info) {
+			dnet_send_ack(it->st, &it->cmd, err, 0);
+		} else {
+			it->cmd.flags &= ~DNET_FLAGS_NEED_ACK;
+			dnet_send_file_info_ts_without_fd(it->st, &it->cmd, data->data() + it->offset, it->size, &it->timestamp);
+		}
+
+		dnet_state_put(it->st);
+	}
+}
+
+void slru_cache_t::update_timer(data_t *obj) {
+	const size_t eventtime = obj->eventtime();
+
+	if (eventtime == std::numeric_limits<size_t>::max())
+		m_timers.cancel(obj);
+	else
+		m_timers.schedule(obj, eventtime);
+}
+
+/*
+ * Moves objects due for sync from sync queue to @batch.
+ * Batch is sorted by key, so backend receives writes in key order. If sync bandwidth is limited,
+ * batch is limited by accumulated budget (one second of bandwidth at most), the rest stays in the queue.
+ */
+void slru_cache_t::take_sync_batch(uint64_t now, std::vector<data_t *> &batch) {
+	if (m_sync_bandwidth) {
+		const int64_t elapsed = now - m_sync_tokens_time;
+		m_sync_tokens = std::min<int64_t>(m_sync_tokens + elapsed * int64_t(m_sync_bandwidth) / 1000, m_sync_bandwidth);
+		m_sync_tokens_time = now;
+	}
+
+	if (m_sync_queue.empty())
+		return;
+
+	std::sort(m_sync_queue.begin(), m_sync_queue.end(), [] (const data_t *lhs, const data_t *rhs) {
+		return dnet_id_cmp_str(lhs->id().id, rhs->id().id) < 0;
+	});
+
+	size_t num = 0;
+	for (; num < m_sync_queue.size(); ++num) {
+		if (m_sync_bandwidth && m_sync_tokens <= 0)
+			break;
+
+		const size_t size = m_sync_queue[num]->size();
+		if (m_sync_bandwidth)
+			m_sync_tokens -= size;
+
+		m_cache_stats.synced_objects++;
+		m_cache_stats.synced_size += size;
+	}
+
+	batch.assign(m_sync_queue.begin(), m_sync_queue.begin() + num);
+	m_sync_queue.erase(m_sync_queue.begin(), m_sync_queue.begin() + num);
+
+	// objects may be rewritten while they wait in the queue, so its size is recalculated
+	m_sync_queue_size = 0;
+	for (auto it = m_sync_queue.begin(); it != m_sync_queue.end(); ++it)
+		m_sync_queue_size += (*it)->size();
 }
 
 void slru_cache_t::life_check(void) {
 
 	dnet_set_name("dnet_cache_%zu", m_backend->backend_id);
 
+	if (m_backend->numa_node >= 0) {
+		int err = dnet_numa_bind_thread(m_backend->numa_node);
+		if (err) {
+			dnet_log(m_node, DNET_LOG_ERROR, "cache: backend: %zu: could not bind life check thread to numa node %d: %d",
+					m_backend->backend_id, m_backend->numa_node, err);
+		}
+	}
+
 	while (!need_exit()) {
+		bool has_more = false;
+
+		// storage is not touched while backend is being reloaded, see dnet_backend_gate
+		if (dnet_backend_gate_enter(&m_backend->gate)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(timer_tick_ms));
+			continue;
+		}
+
 		{
 			TIMER_SCOPE("life_check");
 
 			std::deque<struct dnet_id> remove;
-			std::deque<data_t*> elements_for_sync;
+			std::vector<data_t*> elements_for_sync;
 			size_t last_time = 0;
 			dnet_id id;
 			memset(&id, 0, sizeof(id));
 
 			{
 				TIMER_START("life_check.lock");
-				elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE LIFE: %p", this);
+				elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache life"), "CACHE LIFE: %p", this);
 				TIMER_STOP("life_check.lock");
 
 				TIMER_SCOPE("life_check.prepare_sync");
-				while (!need_exit() && !m_treap.empty()) {
-					size_t time = ::time(NULL);
-					last_time = time;
 
-					if (m_treap.empty())
-						break;
+				last_time = cache_time_ms();
+				m_timers.advance(last_time);
 
-					data_t* it = m_treap.top();
-					if (it->eventtime() > time)
+				// do not hold the lock for too long if lots of objects expire at once,
+				// the rest will be processed by the next iteration without sleeping
+				for (size_t processed = 0; !need_exit() && processed < life_check_batch_size; ++processed) {
+					data_t* it = m_timers.pop_ready();
+					if (!it)
 						break;
 
+					if (it->eventtime() > last_time) {
+						update_timer(it);
+						continue;
+					}
+
 					if (it->eventtime() == it->lifetime())
 					{
 						if (it->remove_from_disk()) {
@@ -758,18 +1503,27 @@ void slru_cache_t::life_check(void) {
 					}
 					else if (it->eventtime() == it->synctime())
 					{
-						elements_for_sync.push_back(it);
+						// object which is still in sync queue will be written with its latest data anyway
+						if (!it->will_be_erased()) {
+							m_sync_queue.push_back(it);
+						}
 
-						size_t previous_eventtime = it->eventtime();
 						it->clear_synctime();
 						it->set_sync_state(data_t::sync_state_t::SYNC_PHASE);
 
-						if (previous_eventtime != it->eventtime()) {
-							TIMER_SCOPE("life_check.decrease_key");
-							m_treap.decrease_key(it);
-						}
+						TIMER_SCOPE("life_check.update_timer");
+						update_timer(it);
 					}
 				}
+
+				has_more = m_timers.has_ready();
+
+				take_sync_batch(last_time, elements_for_sync);
+				has_more |= (!m_sync_queue.empty() && m_sync_tokens > 0);
+
+				has_more |= shrink_pages();
+				govern_memory();
+				HANDY_GAUGE_SET("slru_cache.life_check.sync_queue.element_count", m_sync_queue.size());
 			}
 
 			{
@@ -788,7 +1542,10 @@ void slru_cache_t::life_check(void) {
 
 					// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
 					if (elem->is_syncing()) {
-						sync_element(id, elem->only_append(), elem->data()->data(), elem->user_flags(), elem->timestamp());
+						std::shared_ptr<raw_data_t> data = elem->data();
+						int err = sync_element(id, elem->only_append(), *data, elem->user_flags(), elem->timestamp());
+						if (elem->only_append())
+							complete_append_acks(take_append_acks(elem), data.get(), err);
 						elem->set_sync_state(data_t::sync_state_t::ERASE_PHASE);
 					}
 
@@ -803,14 +1560,14 @@ void slru_cache_t::life_check(void) {
 				}
 			}
 
-			{
+			if (!elements_for_sync.empty() || m_clear_occured) {
 				TIMER_START("life_check.lock");
-				elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE CLEAR PAGES: %p", this);
+				elliptics_unique_lock<rw_mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache clear pages"), "CACHE CLEAR PAGES: %p", this);
 				TIMER_STOP("life_check.lock");
 
 				if (!m_clear_occured) {
 					TIMER_SCOPE("life_check.erase_iterate");
-					for (std::deque<data_t*>::iterator it = elements_for_sync.begin(); it != elements_for_sync.end(); ++it) {
+					for (auto it = elements_for_sync.begin(); it != elements_for_sync.end(); ++it) {
 						data_t *elem = *it;
 						elem->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
 						if (elem->synctime() <= last_time) {
@@ -825,7 +1582,10 @@ void slru_cache_t::life_check(void) {
 			}
 		}
 
-		std::this_thread::sleep_for( std::chrono::milliseconds(1000) );
+		dnet_backend_gate_leave(&m_backend->gate);
+
+		if (!has_more)
+			std::this_thread::sleep_for(std::chrono::milliseconds(timer_tick_ms));
 	}
 
 }
@@ -17,13 +17,17 @@
 #ifndef SLRU_CACHE_HPP
 #define SLRU_CACHE_HPP
 
+#include <numeric>
+
 #include "cache.hpp"
 
 namespace ioremap { namespace cache {
 
 class slru_cache_t {
 public:
-	slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout);
+	slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout, size_t sync_bandwidth, bool admission,
+			size_t compressed_pages, const std::vector<cache_partition_config> &partitions,
+			const cache_append_buffer_config &append_buffer);
 
 	~slru_cache_t();
 
@@ -31,6 +35,8 @@ public:
 
 	std::shared_ptr<raw_data_t> read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io);
 
+	std::shared_ptr<raw_data_t> try_read(const unsigned char *id, dnet_io_attr *io);
+
 	int remove(const unsigned char *id, dnet_io_attr *io);
 
 	int lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd);
@@ -39,22 +45,173 @@ public:
 
 	cache_stats get_cache_stats() const;
 
+	/*
+	 * Appends keys of cached objects hottest first to @keys, at most @limit of them (0 - all)
+	 */
+	void hot_keys(std::vector<cache_snapshot_record> &keys, size_t limit = 0);
+
+	/*
+	 * Reads object from disk into @page_number page if it is not cached yet.
+	 * Returns false if cache is full.
+	 */
+	bool prefetch(const unsigned char *id, size_t page_number);
+
+	/*
+	 * Reads object from disk ahead of its expected read. The hint counts as one access of the object,
+	 * so admission filter lets it displace the coldest object only if it is accessed more often.
+	 */
+	void prefetch_hint(const unsigned char *id);
+
+	/*
+	 * Appends objects with ids in [@start, @end] to @entries in id order, at most @limit of them (0 - no limit)
+	 */
+	void read_range(const unsigned char *start, const unsigned char *end, size_t limit, std::vector<cache_range_entry_t> &entries);
+
+	/*
+	 * Sets new maximum sizes of pages, number of pages must not change.
+	 * Growing pages are resized at once, shrinking ones are evicted by life check thread step by step.
+	 */
+	void resize(const std::vector<size_t> &cache_pages_max_sizes);
+
 private:
 	struct dnet_backend_io *m_backend;
 	struct dnet_node *m_node;
-	std::mutex m_lock;
+	/* read hits take it in shared mode, everything else - exclusively */
+	rw_mutex m_lock;
 	size_t m_cache_pages_number;
 	std::vector<size_t> m_cache_pages_max_sizes;
+	// sizes set by resize(), maximum sizes go down to them by resize_step_size per step
+	std::vector<size_t> m_cache_pages_target_sizes;
 	std::vector<size_t> m_cache_pages_sizes;
 	std::unique_ptr<lru_list_t[]> m_cache_pages_lru;
 	std::thread m_lifecheck;
-	treap_t m_treap;
+	// lifetime and sync timers of objects
+	timer_wheel_t m_timers;
+	data_index_t m_index;
+	// the same objects ordered by id
+	data_id_set_t m_id_set;
 	mutable cache_stats m_cache_stats;
 	bool m_clear_occured;
 	unsigned m_sync_timeout;
+	bool m_admission;
+	frequency_sketch m_sketch;
+	// updated by read hits under shared lock
+	std::atomic<size_t> m_hits;
+	std::atomic<size_t> m_misses;
+
+	// objects waiting to be synced, in SYNC_PHASE
+	std::vector<data_t *> m_sync_queue;
+	// bytes per second, 0 - unlimited
+	size_t m_sync_bandwidth;
+	// sync budget in bytes, may become negative after big object
+	int64_t m_sync_tokens;
+	uint64_t m_sync_tokens_time;
+	size_t m_sync_queue_size;
+
+	// values of objects in this and colder pages are kept compressed
+	size_t m_compressed_page;
+
+	// size of objects charged to DNET_MEMORY_CACHE of the node's memory governor
+	size_t m_memory_charged;
+
+	// configured partitions followed by the default one, empty if cache is not partitioned
+	std::vector<cache_partition_config> m_partitions;
+	struct partition_state_t {
+		partition_state_t() : size(0), evicted_size(0), hits(0), misses(0) {}
+
+		// accounted by insert_data_into_page() and remove_data_from_page() like sizes of pages
+		size_t size;
+		size_t evicted_size;
+		// updated by read hits under shared lock
+		std::atomic<size_t> hits;
+		std::atomic<size_t> misses;
+	};
+	std::unique_ptr<partition_state_t[]> m_partition_states;
+
+	// data read from disk, which was not admitted into the cache
+	struct populate_bypass_t {
+		populate_bypass_t() : user_flags(0) {
+			dnet_empty_time(&timestamp);
+		}
+
+		std::shared_ptr<raw_data_t> data;
+		uint64_t user_flags;
+		dnet_time timestamp;
+	};
+
+	// disk read of missed object, concurrent misses of the same object wait for it instead of reading it too
+	struct inflight_read_t {
+		inflight_read_t(const unsigned char *raw_id) : done(false), err(0), user_flags(0) {
+			memcpy(id.id, raw_id, DNET_ID_SIZE);
+			dnet_empty_time(&timestamp);
+		}
+
+		dnet_raw_id id;
+		bool done;
+		int err;
+		// set only if object was not admitted into the cache
+		std::shared_ptr<raw_data_t> data;
+		uint64_t user_flags;
+		dnet_time timestamp;
+		// waited on with shard lock
+		std::condition_variable_any cond;
+	};
+
+	std::unordered_map<const unsigned char *, std::shared_ptr<inflight_read_t>, data_id_hash, data_id_equal> m_inflight_reads;
+
+	cache_append_buffer_config m_append_buffer;
+
+	// reply to buffered append, which is sent once the append is flushed to disk
+	struct append_ack_t {
+		dnet_net_state *st;
+		dnet_cmd cmd;
+		// position of appended data in the flushed object
+		size_t offset;
+		uint64_t size;
+		dnet_time timestamp;
+		bool file_info;
+	};
+
+	// taken under object's oplock by sync thread, so it has its own lock
+	std::mutex m_append_acks_lock;
+	std::unordered_map<const data_t *, std::vector<append_ack_t>> m_append_acks;
+
+	// resolution of lifetime and sync timers
+	static const uint64_t timer_tick_ms = 100;
+	// maximum number of expired objects processed under single lock
+	static const size_t life_check_batch_size = 1000;
+	// maximum number of bytes evicted from shrinking page under single lock
+	static const size_t resize_step_size = 16 * 1024 * 1024;
 
 	slru_cache_t(const slru_cache_t &) = delete;
 
+	// charges changed size of objects and shrinks the coldest page if node is short of memory
+	void govern_memory();
+
+	// makes one bounded step of shrinking pages down to their target sizes, returns true if more steps are needed
+	bool shrink_pages();
+
+	size_t partition_of(uint64_t user_flags) const;
+
+	size_t shard_size() const {
+		return std::accumulate(m_cache_pages_max_sizes.begin(), m_cache_pages_max_sizes.end(), size_t(0));
+	}
+
+	// whether objects of @partition must not be evicted by objects of other partitions
+	bool partition_protected(size_t partition) const;
+
+	// evicts the coldest clean objects of @partition from the last page until @reserve more bytes fit into its maximum share
+	void evict_partition(size_t partition, size_t reserve);
+
+	void count_partition_access(size_t partition, bool hit) {
+		if (m_partitions.empty())
+			return;
+		if (hit)
+			m_partition_states[partition].hits++;
+		else
+			m_partition_states[partition].misses++;
+	}
+
 	bool need_exit() const
 	{
 		return dnet_need_exit(m_node) || m_backend->need_exit;
@@ -71,10 +228,25 @@ private:
 		return page_number + 1;
 	}
 
-	void sync_if_required(data_t* it, elliptics_unique_lock<std::mutex> &guard);
+	data_t *find_data(const unsigned char *id) const {
+		auto it = m_index.find(id);
+		return it != m_index.end() ? it->second : NULL;
+	}
+
+	bool read_hit(const unsigned char *id, dnet_io_attr *io, std::shared_ptr<raw_data_t> &data, bool wait = true);
+
+	void promote(const unsigned char *id);
+
+	void sync_if_required(data_t* it, elliptics_unique_lock<rw_mutex> &guard);
 
 	void insert_data_into_page(const unsigned char *id, size_t page_number, data_t *data);
 
+	void update_compression(data_t *obj, size_t page_number);
+
+	void compress_data(data_t *obj);
+
+	void decompress_data(data_t *obj);
+
 	void remove_data_from_page(const unsigned char *id, size_t page_number, data_t *data);
 
 	void move_data_between_pages(const unsigned char *id,
@@ -82,9 +254,14 @@ private:
 								 size_t destination_page_number,
 								 data_t *data);
 
-	data_t* create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk);
+	data_t* create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk, uint64_t user_flags);
 
-	data_t* populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err);
+	data_t* populate_from_disk(elliptics_unique_lock<rw_mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err,
+			populate_bypass_t *bypass = NULL);
+
+	void finish_inflight_read(const std::shared_ptr<inflight_read_t> &read, int err);
+
+	bool admit(const unsigned char *id, size_t size);
 
 	bool have_enough_space(const unsigned char *id, size_t page_number, size_t reserve);
 
@@ -92,11 +269,29 @@ private:
 
 	void erase_element(data_t *obj);
 
-	void sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp);
+	int sync_element(const dnet_id &raw, bool after_append, const raw_data_t &data, uint64_t user_flags, const dnet_time &timestamp);
+
+	int sync_element(data_t *obj);
+
+	int sync_after_append(elliptics_unique_lock<rw_mutex> &guard, bool lock_guard, data_t *obj);
+
+	// whether plain append described by @io may be kept in memory instead of being written to disk at once
+	bool append_bufferable(const dnet_io_attr *io) const;
+
+	// holds reply to append of @io->size bytes at @offset of @obj until the object is flushed
+	void defer_append_ack(const data_t *obj, dnet_net_state *st, const dnet_cmd *cmd, const dnet_io_attr *io, size_t offset);
+
+	std::vector<append_ack_t> take_append_acks(const data_t *obj);
+
+	// replies to writers of flushed @data, @err is status of the flush
+	void complete_append_acks(std::vector<append_ack_t> acks, const raw_data_t *data, int err);
 
-	void sync_element(data_t *obj);
+	/*
+	 * Reschedules object's timer after its lifetime or synctime has been changed
+	 */
+	void update_timer(data_t *obj);
 
-	void sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj);
+	void take_sync_batch(uint64_t now, std::vector<data_t *> &batch);
 
 	void life_check(void);
 };
@@ -0,0 +1,193 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstdint>
+#include <limits>
+
+#include <boost/intrusive/list.hpp>
+
+namespace ioremap { namespace cache {
+
+struct timer_wheel_tag_t;
+typedef boost::intrusive::list_base_hook<boost::intrusive::tag<timer_wheel_tag_t>,
+boost::intrusive::link_mode<boost::intrusive::auto_unlink>
+> timer_wheel_hook_t;
+
+/*
+ * Base class for objects scheduled in timer_wheel.
+ * Hook unlinks itself on destruction, so destroyed object is cancelled automatically.
+ */
+class timer_wheel_node_t : public timer_wheel_hook_t {
+public:
+	timer_wheel_node_t() : m_timer_expires(0) {}
+
+	uint64_t timer_expires() const {
+		return m_timer_expires;
+	}
+
+	bool timer_scheduled() const {
+		return is_linked();
+	}
+
+private:
+	template <typename T> friend class timer_wheel;
+
+	uint64_t m_timer_expires;
+};
+
+/*
+ * Hierarchical timing wheel: timer_levels levels of timer_slots slots each.
+ * Level 0 slots are one tick wide, every next level's slot covers the whole previous level.
+ * Timers which are further than the last level can reach are parked in the farthest slot
+ * and are rescheduled when it is cascaded.
+ *
+ * schedule() and cancel() are O(1). advance() moves due timers into ready list, from where
+ * they are taken by pop_ready() one by one, so caller is free to process them in bounded
+ * batches and drop its lock in between.
+ *
+ * Time is measured in arbitrary units (cache uses milliseconds), @tick is the wheel resolution.
+ * The wheel itself is not thread-safe.
+ */
+template <typename T>
+class timer_wheel {
+public:
+	timer_wheel(uint64_t now, uint64_t tick) : m_tick(tick), m_current(now / tick) {}
+
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel &operator =(const timer_wheel &) = delete;
+
+	~timer_wheel() {
+		for (size_t level = 0; level < timer_levels; ++level) {
+			for (size_t slot = 0; slot < timer_slots; ++slot)
+				m_wheel[level][slot].clear();
+		}
+		m_ready.clear();
+	}
+
+	/*
+	 * (Re)schedules @node to expire at @expires
+	 */
+	void schedule(T *node, uint64_t expires) {
+		static_cast<timer_wheel_hook_t *>(node)->unlink();
+		node->m_timer_expires = expires;
+		insert(node);
+	}
+
+	void cancel(T *node) {
+		static_cast<timer_wheel_hook_t *>(node)->unlink();
+	}
+
+	/*
+	 * Moves all timers which expire not later than @now into ready list
+	 */
+	void advance(uint64_t now) {
+		const uint64_t target = now / m_tick;
+
+		while (m_current < target) {
+			++m_current;
+
+			// cascade upper levels when lower level wraps around
+			for (size_t level = 1; level < timer_levels; ++level) {
+				if (level_index(m_current, level - 1) != 0)
+					break;
+
+				cascade(level);
+			}
+
+			m_ready.splice(m_ready.end(), m_wheel[0][level_index(m_current, 0)]);
+		}
+	}
+
+	T *pop_ready() {
+		if (m_ready.empty())
+			return NULL;
+
+		T *node = &m_ready.front();
+		m_ready.pop_front();
+		return node;
+	}
+
+	bool has_ready() const {
+		return !m_ready.empty();
+	}
+
+	/*
+	 * Removes all timers
+	 */
+	void clear() {
+		for (size_t level = 0; level < timer_levels; ++level) {
+			for (size_t slot = 0; slot < timer_slots; ++slot)
+				m_wheel[level][slot].clear();
+		}
+		m_ready.clear();
+	}
+
+private:
+	static const size_t timer_slot_bits = 6;
+	static const size_t timer_slots = 1 << timer_slot_bits;
+	static const size_t timer_levels = 4;
+
+	typedef boost::intrusive::list<T,
+		boost::intrusive::base_hook<timer_wheel_hook_t>,
+		boost::intrusive::constant_time_size<false>
+	> timer_list_t;
+
+	static size_t level_index(uint64_t tick, size_t level) {
+		return (tick >> (level * timer_slot_bits)) & (timer_slots - 1);
+	}
+
+	void insert(T *node) {
+		// round up, so timer never fires before its time
+		uint64_t expires = (node->m_timer_expires + m_tick - 1) / m_tick;
+
+		if (expires <= m_current) {
+			m_ready.push_back(*node);
+			return;
+		}
+
+		uint64_t delta = expires - m_current;
+
+		for (size_t level = 0; level < timer_levels; ++level) {
+			if (delta < (uint64_t(1) << ((level + 1) * timer_slot_bits))) {
+				m_wheel[level][level_index(expires, level)].push_back(*node);
+				return;
+			}
+		}
+
+		// too far in the future, park it in the farthest slot and reschedule when it is cascaded
+		const uint64_t max_delta = (uint64_t(1) << (timer_levels * timer_slot_bits)) - 1;
+		m_wheel[timer_levels - 1][level_index(m_current + max_delta, timer_levels - 1)].push_back(*node);
+	}
+
+	void cascade(size_t level) {
+		timer_list_t list;
+		list.splice(list.end(), m_wheel[level][level_index(m_current, level)]);
+
+		while (!list.empty()) {
+			T *node = &list.front();
+			list.pop_front();
+			insert(node);
+		}
+	}
+
+	uint64_t m_tick;
+	uint64_t m_current;
+	timer_list_t m_wheel[timer_levels][timer_slots];
+	timer_list_t m_ready;
+};
+
+}}
+
+#endif // TIMER_WHEEL_HPP
@@ -0,0 +1,25 @@
+# Check whether io_uring syscalls and their kernel header are available
+
+include(CheckCSourceCompiles)
+
+if (UNIX OR MINGW)
+    SET(CMAKE_REQUIRED_DEFINITIONS -Werror-implicit-function-declaration)
+endif()
+
+check_c_source_compiles("#include <sys/types.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+int main()
+{
+    struct io_uring_params p = { 0 };
+    int fd = syscall(__NR_io_uring_setup, 1, &p);
+    syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    return IORING_OP_READV;
+}" HAVE_IO_URING_SUPPORT)
+unset(CMAKE_REQUIRED_DEFINITIONS)
+
+if(HAVE_IO_URING_SUPPORT)
+    add_definitions(-DHAVE_IO_URING_SUPPORT=1)
+endif()
+message(STATUS "io_uring support: ${HAVE_IO_URING_SUPPORT}")
@@ -0,0 +1,23 @@
+# Find LZ4
+#
+# This module defines
+#  LZ4_FOUND - whether the lz4 was found
+#  LZ4_LIBRARIES - lz4 libraries
+#  LZ4_INCLUDE_DIRS - the include path of the lz4 library
+#  LZ4_CFLAGS - lz4 compile flags
+
+if (NOT LZ4_INCLUDE_DIRS)
+    find_path(LZ4_INCLUDE_DIRS lz4.h)
+endif()
+
+if (NOT LZ4_LIBRARIES)
+	find_library(LZ4_LIBRARIES NAMES lz4 PATHS ${LZ4_LIBRARY_DIRS})
+endif()
+
+if (NOT LZ4_CFLAGS)
+    set(LZ4_CFLAGS "-DHAVE_LZ4=1")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 DEFAULT_MSG LZ4_LIBRARIES LZ4_INCLUDE_DIRS)
+mark_as_advanced(LZ4_LIBRARIES LZ4_INCLUDE_DIRS)
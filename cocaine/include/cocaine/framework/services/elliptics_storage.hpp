@@ -52,6 +52,16 @@ public:
 		return call<io::elliptics::bulk_read>(collection, keys);
 	}
 
+	service_traits<io::elliptics::bulk_write>::future_type
+	bulk_write(const std::string &collection, const std::vector<std::string> &keys, const std::vector<std::string> &blobs) {
+		return call<io::elliptics::bulk_write>(collection, keys, blobs);
+	}
+
+	service_traits<io::elliptics::bulk_remove>::future_type
+	bulk_remove(const std::string &collection, const std::vector<std::string> &keys) {
+		return call<io::elliptics::bulk_remove>(collection, keys);
+	}
+
 	service_traits<io::elliptics::cache_read>::future_type
 	cache_read_latest(const std::string &collection, const std::string &key) {
 		return call<io::elliptics::read_latest>(collection, key);
@@ -118,6 +118,22 @@ struct bulk_write {
 		std::map<std::string, int>
 	result_type;
 };
+
+struct bulk_remove {
+	typedef elliptics_tag tag;
+
+	typedef boost::mpl::list<
+	/* Key namespace. */
+		std::string,
+	/* Keys. Their tags are not updated, so tagged keys should be removed one by one. */
+		std::vector<std::string>
+	> tuple_type;
+
+	typedef
+	/* Remove results. If remove of some key fails errno can be accessed by the key. */
+		std::map<std::string, int>
+	result_type;
+};
 } // namespace cocaine::elliptics
 
 template<>
@@ -131,8 +147,9 @@ struct protocol<elliptics_tag> : public extends<storage_tag>
 		elliptics::cache_read,
 		elliptics::cache_write,
 		elliptics::bulk_read,
-		elliptics::read_latest
-//		elliptics::bulk_write
+		elliptics::read_latest,
+		elliptics::bulk_write,
+		elliptics::bulk_remove
 	> type;
 };
 
@@ -20,6 +20,8 @@
 #include "service.hpp"
 #include <cocaine/messages.hpp>
 
+#include <set>
+
 #define debug() if (1) {} else std::cerr
 //#define debug() std::cerr << __PRETTY_FUNCTION__ << ": " << __LINE__ << " "
 
@@ -46,6 +48,8 @@ elliptics_service_t::elliptics_service_t(context_t &context, io::reactor_t &reac
 	on<io::elliptics::cache_write>("cache_write", std::bind(&elliptics_service_t::cache_write, this, _1, _2, _3, _4));
 	on<io::elliptics::bulk_read  >("bulk_read",   std::bind(&elliptics_service_t::bulk_read,   this, _1, _2));
 	on<io::elliptics::read_latest>("read_latest", std::bind(&elliptics_service_t::read_latest, this, _1, _2));
+	on<io::elliptics::bulk_write >("bulk_write",  std::bind(&elliptics_service_t::bulk_write,  this, _1, _2, _3));
+	on<io::elliptics::bulk_remove>("bulk_remove", std::bind(&elliptics_service_t::bulk_remove, this, _1, _2));
 }
 
 deferred<std::string> elliptics_service_t::read(const std::string &collection, const std::string &key)
@@ -138,17 +142,66 @@ deferred<std::map<std::string, std::string> > elliptics_service_t::bulk_read(con
 deferred<std::map<std::string, int> > elliptics_service_t::bulk_write(const std::string &collection, const std::vector<std::string> &keys,
 	const std::vector<std::string> &blobs)
 {
-	(void) collection;
-	(void) keys;
-	(void) blobs;
+	deferred<std::map<std::string, int> > promise;
+
+	if (keys.size() != blobs.size()) {
+		promise.abort(EINVAL, "number of keys doesn't match number of blobs");
+		return promise;
+	}
+
+	auto result = m_elliptics->async_bulk_write(collection, keys, blobs);
+	result.first.connect(std::bind(&elliptics_service_t::on_bulk_write_completed,
+		promise, std::move(result.second), _1, _2));
 
+	return promise;
+}
+
+deferred<std::map<std::string, int> > elliptics_service_t::bulk_remove(const std::string &collection, const std::vector<std::string> &keys)
+{
 	deferred<std::map<std::string, int> > promise;
 
-	promise.abort(ENOTSUP, "Not supported yet");
+	auto result = m_elliptics->async_bulk_remove(collection, keys);
+	result.first.connect(std::bind(&elliptics_service_t::on_bulk_remove_completed,
+		promise, std::move(result.second), _1, _2));
 
 	return promise;
 }
 
+/*
+ * Status of every key is 0 if it is written to (or removed from) at least one group,
+ * otherwise it is errno of the last failed request, keys without any reply are timed out
+ */
+template <typename Result>
+static std::map<std::string, int> bulk_statuses(const storage::elliptics_storage_t::key_name_map &keys, const Result &result)
+{
+	std::map<std::string, int> statuses;
+
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		statuses[it->second] = ETIMEDOUT;
+	}
+
+	std::set<std::string> succeeded;
+
+	for (size_t i = 0; i < result.size(); ++i) {
+		const auto &entry = result[i];
+		const auto &id = reinterpret_cast<const dnet_raw_id &>(entry.command()->id);
+
+		auto it = keys.find(id);
+
+		if (it == keys.end() || succeeded.count(it->second)) {
+			continue;
+		}
+
+		statuses[it->second] = -entry.status();
+
+		if (entry.status() == 0) {
+			succeeded.insert(it->second);
+		}
+	}
+
+	return statuses;
+}
+
 void elliptics_service_t::on_read_completed(deferred<std::string> promise,
 	const ioremap::elliptics::sync_read_result &result,
 	const ioremap::elliptics::error_info &error)
@@ -220,16 +273,29 @@ void elliptics_service_t::on_bulk_read_completed(deferred<std::map<std::string,
 	}
 }
 
-// Not implemented yet
 void elliptics_service_t::on_bulk_write_completed(deferred<std::map<std::string, int> > promise,
 	const key_name_map &keys,
 	const ioremap::elliptics::sync_write_result &result,
 	const ioremap::elliptics::error_info &error)
 {
-	(void) promise;
-	(void) keys;
-	(void) result;
-	(void) error;
+	// statuses of the keys tell which of them have failed, unless nothing is replied at all
+	if (error && result.empty()) {
+		promise.abort(-error.code(), error.message());
+	} else {
+		promise.write(bulk_statuses(keys, result));
+	}
+}
+
+void elliptics_service_t::on_bulk_remove_completed(deferred<std::map<std::string, int> > promise,
+	const key_name_map &keys,
+	const ioremap::elliptics::sync_remove_result &result,
+	const ioremap::elliptics::error_info &error)
+{
+	if (error && result.empty()) {
+		promise.abort(-error.code(), error.message());
+	} else {
+		promise.write(bulk_statuses(keys, result));
+	}
 }
 
 }
@@ -47,6 +47,7 @@ class elliptics_service_t : public api::service_t
 		deferred<std::map<std::string, std::string> > bulk_read(const std::string &collection, const std::vector<std::string> &keys);
 		deferred<std::map<std::string, int> > bulk_write(const std::string &collection, const std::vector<std::string> &keys,
 			const std::vector<std::string> &blob);
+		deferred<std::map<std::string, int> > bulk_remove(const std::string &collection, const std::vector<std::string> &keys);
 		deferred<std::string> read_latest(const std::string &collection, const std::string &key);
 
 	private:
@@ -72,6 +73,10 @@ class elliptics_service_t : public api::service_t
 			const key_name_map &keys,
 			const ioremap::elliptics::sync_write_result &result,
 			const ioremap::elliptics::error_info &error);
+		static void on_bulk_remove_completed(deferred<std::map<std::string, int> > promise,
+			const key_name_map &keys,
+			const ioremap::elliptics::sync_remove_result &result,
+			const ioremap::elliptics::error_info &error);
 
 		// NOTE: This will keep the underlying storage active, as opposed to the usual usecase when
 		// the storage object is destroyed after the node service finishes its initialization.
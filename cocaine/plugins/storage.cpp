@@ -23,6 +23,8 @@
 #include <cocaine/context.hpp>
 #include <cocaine/logging.hpp>
 
+#include <mutex>
+
 using namespace cocaine;
 using namespace cocaine::logging;
 using namespace cocaine::storage;
@@ -254,59 +256,58 @@ ell::async_read_result elliptics_storage_t::async_read_latest(const std::string
 	return session.read_latest(key, 0, 0);
 }
 
-static void on_adding_index_finished(const elliptics_storage_t::log_ptr &log,
-	ell::async_result_handler<ell::write_result_entry> handler,
-	const ell::error_info &err)
+/*
+ * Tagged write is completed once both the data is written and the key is added to its indexes,
+ * both requests are sent at once, so the write takes one round trip instead of two
+ */
+class tagged_write_t
 {
-	if (err) {
-		COCAINE_LOG_DEBUG(
-			log,
-			"index adding failed: %s",
-			err.message()
-		);
-	} else {
-		COCAINE_LOG_DEBUG(
-			log,
-			"index adding completed"
-		);
-	}
-	handler.complete(err);
-}
+	public:
+		tagged_write_t(const elliptics_storage_t::log_ptr &log, const ell::async_write_result &result) :
+			m_log(log), m_handler(result), m_pending(2)
+		{
+		}
 
-static void on_write_finished(const elliptics_storage_t::log_ptr &log,
-	ell::async_result_handler<ell::write_result_entry> handler,
-	ell::session session,
-	const std::string &key,
-	const std::vector<std::string> &index_names,
-	const ell::sync_write_result &result,
-	const ell::error_info &err)
-{
-	using namespace std::placeholders;
+		void on_write_finished(const ell::sync_write_result &result, const ell::error_info &err)
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
 
-	if (err) {
-		COCAINE_LOG_DEBUG(
-			log,
-			"write failed: %s",
-			err.message()
-		);
-		handler.complete(err);
-		return;
-	}
-	COCAINE_LOG_DEBUG(
-		log,
-		"write partially completed"
-	);
+			COCAINE_LOG_DEBUG(m_log, "write %s: %s", err ? "failed" : "completed", err.message());
 
-	for (auto it = result.begin(); it != result.end(); ++it) {
-		handler.process(*it);
-	}
+			for (auto it = result.begin(); it != result.end(); ++it) {
+				m_handler.process(*it);
+			}
 
-	std::vector<ell::data_pointer> index_data(index_names.size(),
-		ell::data_pointer::copy(key.c_str(), key.size()));
+			finish(err);
+		}
 
-	session.set_indexes(key, index_names, index_data)
-		.connect(std::bind(on_adding_index_finished, log, handler, _2));
-}
+		void on_indexes_finished(const ell::error_info &err)
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			COCAINE_LOG_DEBUG(m_log, "index adding %s: %s", err ? "failed" : "completed", err.message());
+
+			finish(err);
+		}
+
+	private:
+		void finish(const ell::error_info &err)
+		{
+			if (err && !m_error) {
+				m_error = err;
+			}
+
+			if (--m_pending == 0) {
+				m_handler.complete(m_error);
+			}
+		}
+
+		elliptics_storage_t::log_ptr m_log;
+		ell::async_result_handler<ell::write_result_entry> m_handler;
+		std::mutex m_lock;
+		int m_pending;
+		ell::error_info m_error;
+};
 
 ell::async_write_result elliptics_storage_t::async_write(const std::string &collection, const std::string &key, const std::string &blob, const std::vector<std::string> &tags)
 {
@@ -332,9 +333,13 @@ ell::async_write_result elliptics_storage_t::async_write(const std::string &coll
 	}
 
 	ell::async_write_result result(session);
-	ell::async_result_handler<ell::write_result_entry> handler(result);
+	auto write = std::make_shared<tagged_write_t>(m_log, result);
+
+	std::vector<ell::data_pointer> index_data(tags.size(), ell::data_pointer::copy(key.c_str(), key.size()));
 
-	write_result.connect(std::bind(on_write_finished, m_log, handler, session, key, tags, _1, _2));
+	write_result.connect(std::bind(&tagged_write_t::on_write_finished, write, _1, _2));
+	session.set_indexes(key, tags, index_data)
+		.connect(std::bind(&tagged_write_t::on_indexes_finished, write, _2));
 
 	return result;
 }
@@ -459,8 +464,8 @@ std::pair<ioremap::elliptics::async_read_result, elliptics_storage_t::key_name_m
 	return std::make_pair(session.bulk_read(keys), std::move(keys_map));
 }
 
-ioremap::elliptics::async_write_result elliptics_storage_t::async_bulk_write(const std::string &collection, const std::vector<std::string> &keys,
-	const std::vector<std::string> &blobs)
+std::pair<ioremap::elliptics::async_write_result, elliptics_storage_t::key_name_map> elliptics_storage_t::async_bulk_write(
+	const std::string &collection, const std::vector<std::string> &keys, const std::vector<std::string> &blobs)
 {
 	COCAINE_LOG_DEBUG(
 		m_log,
@@ -474,6 +479,7 @@ ioremap::elliptics::async_write_result elliptics_storage_t::async_bulk_write(con
 	session.set_timeout(m_timeouts.write);
 	session.set_checker(m_success_copies_num);
 
+	key_name_map keys_map;
 	std::vector<dnet_io_attr> ios;
 	ios.reserve(blobs.size());
 
@@ -490,9 +496,40 @@ ioremap::elliptics::async_write_result elliptics_storage_t::async_bulk_write(con
 		io.size = blobs[i].size();
 
 		ios.push_back(io);
+		keys_map[reinterpret_cast<const dnet_raw_id &>(id)] = keys[i];
+	}
+
+	return std::make_pair(session.bulk_write(ios, blobs), std::move(keys_map));
+}
+
+std::pair<ioremap::elliptics::async_remove_result, elliptics_storage_t::key_name_map> elliptics_storage_t::async_bulk_remove(
+	const std::string &collection, const std::vector<std::string> &keys)
+{
+	COCAINE_LOG_DEBUG(
+		m_log,
+		"bulk removing, collection: '%s'",
+		collection
+	);
+
+	ell::session session = m_session.clone();
+	session.set_namespace(collection.data(), collection.size());
+	session.set_filter(ell::filters::all);
+	session.set_timeout(m_timeouts.remove);
+	session.set_checker(m_success_copies_num);
+
+	key_name_map keys_map;
+	std::vector<ell::key> ids;
+	ids.reserve(keys.size());
+
+	dnet_raw_id id;
+
+	for (size_t i = 0; i < keys.size(); ++i) {
+		session.transform(keys[i], id);
+		keys_map[id] = keys[i];
+		ids.emplace_back(keys[i]);
 	}
 
-	return session.bulk_write(ios, blobs);
+	return std::make_pair(session.bulk_remove(ids), std::move(keys_map));
 }
 
 std::vector<std::string> elliptics_storage_t::convert_list_result(const ioremap::elliptics::sync_find_indexes_result &result)
@@ -21,6 +21,9 @@ BuildRequires:	libev-devel libtool-ltdl-devel
 BuildRequires:	cmake python-msgpack
 BuildRequires:	handystats >= 1.10.2
 BuildRequires:  compat-msgpack-devel
+BuildRequires:	lz4-devel
+BuildRequires:	openssl-devel >= 3.0
+BuildRequires:	systemtap-sdt-devel
 
 BuildRequires:	boost-devel
 BuildRequires:	python-virtualenv
@@ -120,6 +123,9 @@ rm -rf %{buildroot}
 %defattr(-,root,root,-)
 %{_bindir}/dnet_iterate
 %{_bindir}/dnet_iterate_move
+%{_bindir}/dnet_dc_recovery
+%{_bindir}/dnet_replay
+%{_bindir}/dnet_blob_ship
 %{_bindir}/dnet_find
 %{_bindir}/dnet_ioclient
 %{_bindir}/dnet_index
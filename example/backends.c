@@ -128,10 +128,14 @@ int dnet_ext_hdr_to_list(const struct dnet_ext_list_hdr *ehdr,
 
 	memset(elist, 0, sizeof(struct dnet_ext_list));
 	elist->version = ehdr->version;
+	elist->csum_type = ehdr->csum_type;
+	elist->compression = ehdr->compression;
+	elist->dedup = ehdr->dedup;
 	elist->timestamp.tsec = dnet_bswap64(ehdr->timestamp.tsec);
 	elist->timestamp.tnsec = dnet_bswap64(ehdr->timestamp.tnsec);
 	elist->size = dnet_bswap32(ehdr->size);
 	elist->flags = dnet_bswap64(ehdr->flags);
+	elist->expire = dnet_bswap64(ehdr->expire);
 
 	return 0;
 }
@@ -148,10 +152,14 @@ int dnet_ext_list_to_hdr(const struct dnet_ext_list *elist,
 
 	memset(ehdr, 0, sizeof(struct dnet_ext_list_hdr));
 	ehdr->version = elist->version;
+	ehdr->csum_type = elist->csum_type;
+	ehdr->compression = elist->compression;
+	ehdr->dedup = elist->dedup;
 	ehdr->size = dnet_bswap32(elist->size);
 	ehdr->flags = dnet_bswap64(elist->flags);
 	ehdr->timestamp.tsec = dnet_bswap64(elist->timestamp.tsec);
 	ehdr->timestamp.tnsec = dnet_bswap64(elist->timestamp.tnsec);
+	ehdr->expire = dnet_bswap64(elist->expire);
 
 	return 0;
 }
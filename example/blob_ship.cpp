@@ -0,0 +1,250 @@
+#include <elliptics/session.hpp>
+
+#include "rapidjson/document.h"
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ioremap;
+
+/*
+ * Sealed file of the source backend, see DNET_CMD_BLOB_FILES
+ */
+struct ship_file
+{
+	std::string name;
+	uint64_t size;
+};
+
+static elliptics::async_generic_result ship_request(elliptics::session &session, const dnet_blob_file_request &request)
+{
+	dnet_blob_file_request raw = request;
+	dnet_convert_blob_file_request(&raw);
+
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+
+	elliptics::transport_control control(id, DNET_CMD_BLOB_FILES,
+		DNET_FLAGS_DIRECT | DNET_FLAGS_DIRECT_BACKEND | DNET_FLAGS_NEED_ACK);
+	control.set_data(&raw, sizeof(raw));
+
+	// request is copied into the transaction, so @raw may go away
+	return session.request_single_cmd(control);
+}
+
+static std::vector<ship_file> ship_list(elliptics::session &session)
+{
+	dnet_blob_file_request request;
+	memset(&request, 0, sizeof(request));
+
+	std::vector<ship_file> files;
+
+	auto results = ship_request(session, request).get();
+	for (auto it = results.begin(); it != results.end(); ++it) {
+		if (it->is_ack())
+			continue;
+
+		const std::string json = it->data().to_string();
+
+		rapidjson::Document doc;
+		doc.Parse<0>(json.c_str());
+		if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("files") || !doc["files"].IsArray())
+			throw std::runtime_error("invalid list of files: " + json);
+
+		const rapidjson::Value &list = doc["files"];
+		for (rapidjson::SizeType i = 0; i < list.Size(); ++i)
+			files.push_back(ship_file{list[i]["name"].GetString(), list[i]["size"].GetUint64()});
+	}
+
+	return files;
+}
+
+/*
+ * Name of the file for destination backend whose data path is @output: "/srv/2/data" + "data-0.3.index"
+ * gives "/srv/2/data-0.3.index", so source and destination may have different prefixes
+ */
+static std::string ship_destination(const std::string &output, const std::string &name)
+{
+	const size_t dot = name.find('.');
+	const size_t dash = name.rfind('-', dot);
+	if (dot == std::string::npos || dash == std::string::npos)
+		throw std::runtime_error("unexpected file name: " + name);
+
+	return output + name.substr(dash);
+}
+
+/*
+ * Copies @file by @window pieces of @chunk_size bytes requested at once,
+ * file is written under temporary name and renamed once it is complete
+ */
+static void ship_copy(elliptics::session &session, const ship_file &file, const std::string &path,
+		uint64_t chunk_size, int window)
+{
+	const std::string tmp_path = path + ".part";
+
+	int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("failed to open " + tmp_path + ": " + strerror(errno));
+
+	try {
+		uint64_t offset = 0;
+		while (offset < file.size) {
+			std::vector<elliptics::async_generic_result> pieces;
+
+			for (int i = 0; i < window && offset < file.size; ++i) {
+				dnet_blob_file_request request;
+				memset(&request, 0, sizeof(request));
+				snprintf(request.name, sizeof(request.name), "%s", file.name.c_str());
+				request.offset = offset;
+				request.size = std::min(chunk_size, file.size - offset);
+
+				pieces.emplace_back(ship_request(session, request));
+				offset += request.size;
+			}
+
+			for (auto piece = pieces.begin(); piece != pieces.end(); ++piece) {
+				auto results = piece->get();
+				for (auto it = results.begin(); it != results.end(); ++it) {
+					if (it->is_ack())
+						continue;
+
+					elliptics::data_pointer data = it->data();
+					if (data.size() < sizeof(dnet_io_attr))
+						throw std::runtime_error("short reply for " + file.name);
+
+					dnet_io_attr io = *data.data<dnet_io_attr>();
+					dnet_convert_io_attr(&io);
+					data = data.skip<dnet_io_attr>();
+
+					if (data.size() != io.size || io.total_size != file.size)
+						throw std::runtime_error("source file " + file.name + " has changed while copying");
+
+					if (pwrite(fd, data.data(), data.size(), io.offset) != (ssize_t)data.size())
+						throw std::runtime_error("failed to write " + tmp_path + ": " + strerror(errno));
+				}
+			}
+		}
+
+		if (fsync(fd))
+			throw std::runtime_error("failed to sync " + tmp_path + ": " + strerror(errno));
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path.c_str(), path.c_str()))
+		throw std::runtime_error("failed to rename " + tmp_path + ": " + strerror(errno));
+}
+
+int main(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::options_description generic("Sealed blobs copy tool options");
+
+	int backend_id, window;
+	uint64_t chunk_size;
+	long wait_timeout;
+	std::string log_level_name;
+	std::string log, remote, output;
+
+	generic.add_options()
+		("help", "This help message")
+		("log", bpo::value<std::string>(&log)->default_value("/dev/stderr"), "Elliptics log file")
+		("log-level", bpo::value<std::string>(&log_level_name)->default_value("error"), "Elliptics log level")
+		("remote", bpo::value<std::string>(&remote), "Source server node which holds replica of the same ids")
+		("backend", bpo::value<int>(&backend_id), "Source backend id")
+		("output", bpo::value<std::string>(&output),
+			"Data path of stopped destination backend, the same as its eblob \"data\" option")
+		("chunk-size", bpo::value<uint64_t>(&chunk_size)->default_value(64 * 1024 * 1024),
+			"Number of bytes requested at once")
+		("window", bpo::value<int>(&window)->default_value(4), "Number of chunks of a file requested at once")
+		("wait-timeout", bpo::value<long>(&wait_timeout)->default_value(600), "Timeout of one chunk in seconds")
+		;
+
+	bpo::variables_map vm;
+	dnet_log_level log_level;
+
+	try {
+		bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+
+		if (vm.count("help")) {
+			std::cout << "Usage: " << argv[0] << " [options]" << std::endl << generic << std::endl;
+			return 0;
+		}
+
+		bpo::notify(vm);
+
+		log_level = elliptics::file_logger::parse_level(log_level_name);
+
+		if (remote.empty() || output.empty() || !vm.count("backend"))
+			throw std::invalid_argument("remote, backend and output are required");
+		if (!chunk_size || window <= 0)
+			throw std::invalid_argument("chunk size and window must be positive");
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << "\n" << generic << std::endl;
+		return -1;
+	}
+
+	elliptics::file_logger logger(log.c_str(), log_level);
+	elliptics::node node(elliptics::logger(logger, blackhole::log::attributes_t()));
+
+	typedef std::chrono::steady_clock clock;
+
+	/* keys written to the source since this moment may be missed by the copy */
+	const time_t started = time(NULL);
+	const clock::time_point start = clock::now();
+	uint64_t copied = 0, skipped = 0;
+
+	try {
+		node.add_remote(remote);
+
+		elliptics::session session(node);
+		session.set_direct_id(elliptics::address(remote), backend_id);
+		session.set_timeout(wait_timeout);
+
+		const std::vector<ship_file> files = ship_list(session);
+
+		for (auto it = files.begin(); it != files.end(); ++it) {
+			const std::string path = ship_destination(output, it->name);
+
+			/* files which have been copied by previous run are not copied again */
+			struct stat st;
+			if (!stat(path.c_str(), &st) && (uint64_t)st.st_size == it->size) {
+				skipped += it->size;
+				continue;
+			}
+
+			ship_copy(session, *it, path, chunk_size, window);
+			copied += it->size;
+
+			std::cerr << it->name << " -> " << path << ": " << it->size << " bytes" << std::endl;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "Failed to copy blobs: " << e.what() << std::endl;
+		return -1;
+	}
+
+	const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+	std::cout << "{\"copied\": " << copied
+		<< ", \"skipped\": " << skipped
+		<< ", \"seconds\": " << seconds
+		<< ", \"bytes_per_second\": " << (seconds > 0 ? copied / seconds : 0)
+		<< ", \"started\": " << started
+		<< "}" << std::endl;
+
+	std::cerr << "Start destination backend and recover keys written since the copy has started, for example: "
+		"dnet_recovery -r <destination> -g <groups> -t " << started << " dc" << std::endl;
+
+	return 0;
+}
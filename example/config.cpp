@@ -49,6 +49,7 @@
 #include "elliptics/session.hpp"
 
 #include "../library/elliptics.h"
+#include "../library/hugepage.h"
 #include "../monitor/monitor.h"
 #include "../cache/cache.hpp"
 
@@ -88,7 +89,21 @@ extern "C" void dnet_config_data_destroy(dnet_config_data *public_data)
 {
 	config_data *data = static_cast<config_data *>(public_data);
 
+	// all threads of the node have been stopped already, its pending records are written before logger is gone
+	if (data->logger_async_ring_size)
+		dnet_log_async_stop();
+
 	free(data->cfg_addrs);
+	free(data->iterator_filter_dir);
+	free((char *)data->cfg_state.route_cache_dir);
+	free((char *)data->cfg_state.local_socket_dir);
+	free((char *)data->cfg_state.wire_compression_networks);
+	free((char *)data->cfg_state.tls_networks);
+	free((char *)data->cfg_state.tls_cert_file);
+	free((char *)data->cfg_state.tls_key_file);
+	free((char *)data->cfg_state.tls_ca_file);
+	free((char *)data->cfg_state.locality);
+	free((char *)data->cfg_state.localities);
 
 	delete data;
 }
@@ -150,6 +165,9 @@ static void parse_logger(config_data *data, const config &logger)
 	}
 
 	data->cfg_state.log = &data->logger;
+
+	data->logger_async_ring_size = logger.at<size_t>("async_ring_size", 0);
+	dnet_log_async_start(data->logger_async_ring_size);
 }
 
 struct dnet_addr_wrap {
@@ -262,10 +280,13 @@ void parse_options(config_data *data, const config &options)
 	data->cfg_state.wait_timeout = options.at("wait_timeout", 0u);
 	data->cfg_state.check_timeout = options.at("check_timeout", 0l);
 	data->cfg_state.stall_count = options.at("stall_count", DNET_DEFAULT_STALL_TRANSACTIONS);
+	data->cfg_state.connections_per_node = options.at("connections_per_node", 1);
+	data->cfg_state.large_request_size = options.at("large_request_size", DNET_DEFAULT_LARGE_REQUEST_SIZE);
 	data->cfg_state.flags |= (options.at("join", false) ? DNET_CFG_JOIN_NETWORK : 0);
 	data->cfg_state.flags |= (options.at("flags", 0) & ~DNET_CFG_JOIN_NETWORK);
 	data->cfg_state.io_thread_num = options.at<unsigned>("io_thread_num");
 	data->cfg_state.nonblocking_io_thread_num = options.at<unsigned>("nonblocking_io_thread_num");
+	data->cfg_state.nonblocking_io_steal = options.at("nonblocking_io_steal", false);
 	data->cfg_state.net_thread_num = options.at<unsigned>("net_thread_num");
 	data->cfg_state.bg_ionice_class = options.at("bg_ionice_class", 0);
 	data->cfg_state.bg_ionice_prio = options.at("bg_ionice_prio", 0);
@@ -273,8 +294,27 @@ void parse_options(config_data *data, const config &options)
 	data->cfg_state.server_prio = options.at("server_net_prio", 0);
 	data->cfg_state.client_prio = options.at("client_net_prio", 0);
 	data->cfg_state.indexes_shard_count = options.at("indexes_shard_count", 0);
+	data->cfg_state.indexes_split_size = options.at("indexes_split_size", uint64_t(0));
+	data->cfg_state.server_shards = options.at("server_shards", 0);
+	data->cfg_state.recv_memory_limit = options.at("recv_memory_limit", uint64_t(0));
+	data->cfg_state.recv_connection_limit = options.at("recv_connection_limit", uint64_t(0));
+	if (options.has("memory")) {
+		const config memory = options.at("memory");
+		data->cfg_state.memory_limit = memory.at("limit", uint64_t(0));
+		data->cfg_state.memory_cache_budget = memory.at("cache_budget", uint64_t(0));
+		data->cfg_state.memory_recv_budget = memory.at("recv_budget", uint64_t(0));
+		data->cfg_state.memory_send_budget = memory.at("send_budget", uint64_t(0));
+	}
+	data->cfg_state.stream_write_size = options.at("stream_write_size", uint64_t(0));
+	data->cfg_state.zerocopy_send_size = options.at("zerocopy_send_size", uint64_t(0));
+	data->cfg_state.socket_send_buffer = options.at("socket_send_buffer", 0);
+	data->cfg_state.socket_receive_buffer = options.at("socket_receive_buffer", 0);
+	data->cfg_state.busy_poll_usecs = options.at("busy_poll_usecs", 0);
+	data->cfg_state.wire_compression_threshold = options.at("wire_compression_threshold", uint64_t(0));
+	data->cfg_state.short_header = options.at("short_header", false);
 	data->daemon_mode = options.at("daemon", false);
 	data->parallel_start = options.at("parallel", true);
+	data->warm_start = options.at("warm_start", false);
 	snprintf(data->cfg_state.cookie, DNET_AUTH_COOKIE_SIZE, "%s", options.at<std::string>("auth_cookie").c_str());
 
 	if (options.has("srw_config")) {
@@ -283,6 +323,96 @@ void parse_options(config_data *data, const config &options)
 			throw std::bad_alloc();
 	}
 
+	if (options.has("route_cache_dir")) {
+		data->cfg_state.route_cache_dir = strdup(options.at<std::string>("route_cache_dir").c_str());
+		if (!data->cfg_state.route_cache_dir)
+			throw std::bad_alloc();
+	}
+
+	if (options.has("local_socket_dir")) {
+		data->cfg_state.local_socket_dir = strdup(options.at<std::string>("local_socket_dir").c_str());
+		if (!data->cfg_state.local_socket_dir)
+			throw std::bad_alloc();
+	}
+
+	const std::vector<std::string> compressed = options.at("wire_compression_networks", std::vector<std::string>());
+	if (!compressed.empty()) {
+		std::string networks;
+		for (auto it = compressed.cbegin(); it != compressed.cend(); ++it) {
+			if (!networks.empty())
+				networks += ",";
+			networks += *it;
+		}
+
+		data->cfg_state.wire_compression_networks = strdup(networks.c_str());
+		if (!data->cfg_state.wire_compression_networks)
+			throw std::bad_alloc();
+	}
+
+	const std::vector<std::string> encrypted = options.at("tls_networks", std::vector<std::string>());
+	if (!encrypted.empty()) {
+		std::string networks;
+		for (auto it = encrypted.cbegin(); it != encrypted.cend(); ++it) {
+			if (!networks.empty())
+				networks += ",";
+			networks += *it;
+		}
+
+		data->cfg_state.tls_networks = strdup(networks.c_str());
+		data->cfg_state.tls_cert_file = strdup(options.at<std::string>("tls_cert_file").c_str());
+		data->cfg_state.tls_key_file = strdup(options.at<std::string>("tls_key_file").c_str());
+		data->cfg_state.tls_ca_file = strdup(options.at<std::string>("tls_ca_file").c_str());
+		if (!data->cfg_state.tls_networks || !data->cfg_state.tls_cert_file ||
+				!data->cfg_state.tls_key_file || !data->cfg_state.tls_ca_file)
+			throw std::bad_alloc();
+	}
+
+	if (options.has("huge_pages")) {
+		const std::string mode = options.at<std::string>("huge_pages");
+		const int value = dnet_huge_pages_mode_parse(mode.c_str());
+		if (value < 0) {
+			throw config_error() << options.at("huge_pages").path()
+				<< " must be one of \"none\", \"madvise\", \"2m\" or \"1g\", got: \"" << mode << "\"";
+		}
+
+		data->cfg_state.huge_pages = value;
+	}
+
+	if (options.has("locality")) {
+		data->cfg_state.locality = strdup(options.at<std::string>("locality").c_str());
+		if (!data->cfg_state.locality)
+			throw std::bad_alloc();
+	}
+
+	if (options.has("localities")) {
+		const config localities = options.at("localities");
+		std::string value;
+
+		for (size_t index = 0; index < localities.size(); ++index) {
+			const config locality = localities.at(index);
+			const std::vector<std::string> networks = locality.at<std::vector<std::string>>("networks");
+
+			if (!value.empty())
+				value += ";";
+			value += locality.at<std::string>("label") + "=";
+			for (auto it = networks.cbegin(); it != networks.cend(); ++it) {
+				if (it != networks.cbegin())
+					value += ",";
+				value += *it;
+			}
+		}
+
+		data->cfg_state.localities = strdup(value.c_str());
+		if (!data->cfg_state.localities)
+			throw std::bad_alloc();
+	}
+
+	if (options.has("iterator_filter_dir")) {
+		data->iterator_filter_dir = strdup(options.at<std::string>("iterator_filter_dir").c_str());
+		if (!data->iterator_filter_dir)
+			throw std::bad_alloc();
+	}
+
 	dnet_set_addr(data, options.at("address", std::vector<std::string>()));
 
 	const std::vector<std::string> remotes = options.at("remote", std::vector<std::string>());
@@ -309,6 +439,21 @@ void parse_options(config_data *data, const config &options)
 		const config cache = options.at("cache");
 		data->cache_config = ioremap::cache::cache_config::parse(cache);
 	}
+
+	if (options.has("defrag_scheduler")) {
+		const config defrag = options.at("defrag_scheduler");
+		data->defrag_config = dnet_defrag_config::parse(defrag);
+	}
+
+	if (options.has("qos")) {
+		const config qos = options.at("qos");
+		data->qos_config = dnet_qos_config::parse(qos);
+	}
+
+	if (options.has("capture")) {
+		const config capture = options.at("capture");
+		data->capture_config = dnet_capture_config::parse(capture);
+	}
 }
 
 void parse_backends(config_data *data, const config &backends)
@@ -343,7 +343,7 @@ private:
 
 struct config_data : public dnet_config_data
 {
-	config_data() : logger(logger_base, blackhole::log::attributes_t())
+	config_data() : logger(logger_base, blackhole::log::attributes_t()), logger_async_ring_size(0)
 	{
 		dnet_empty_time(&config_timestamp);
 	}
@@ -358,9 +358,14 @@ struct config_data : public dnet_config_data
 	std::string					logger_value;
 	ioremap::elliptics::logger_base			logger_base;
 	ioremap::elliptics::logger			logger;
+	// records of every thread pending for background log writer, 0 - logger writes synchronously
+	size_t						logger_async_ring_size;
 	std::vector<address>				remotes;
 	std::unique_ptr<cache::cache_config>		cache_config;
 	std::unique_ptr<monitor::monitor_config>	monitor_config;
+	std::unique_ptr<dnet_defrag_config>		defrag_config;
+	std::unique_ptr<dnet_qos_config>		qos_config;
+	std::unique_ptr<dnet_capture_config>		capture_config;
 };
 
 } } } // namespace ioremap::elliptics::config
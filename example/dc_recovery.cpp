@@ -0,0 +1,564 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native dc recovery: iterates metadata of every replica of every route range,
+ * merges it and copies the newest replica of every key to the groups where it is missing
+ * or outdated. Keys are copied by server_send() in batches, keys which have not been sent
+ * are read and written by the client. Every worker thread processes one part of a range
+ * at a time, so memory is bounded by the number of keys in (range / split) times threads.
+ */
+
+#include <elliptics/session.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <endian.h>
+
+using namespace ioremap;
+
+struct recovery_options
+{
+	std::vector<int> groups;
+	dnet_time time_begin;
+	int threads;
+	int window;
+	int batch;
+	int split;
+	bool dry_run;
+	bool no_server_send;
+};
+
+/*
+ * Backend which holds the range in one of the groups
+ */
+struct replica
+{
+	int group_id;
+	dnet_id id;
+	dnet_addr addr;
+	uint32_t backend_id;
+};
+
+struct recovery_range
+{
+	dnet_iterator_range range;
+	std::vector<replica> replicas;
+};
+
+struct recovery_stats
+{
+	std::atomic<uint64_t> iterated_keys;
+	std::atomic<uint64_t> recover_keys;
+	std::atomic<uint64_t> server_sent_keys;
+	std::atomic<uint64_t> copied_keys;
+	std::atomic<uint64_t> failed_keys;
+	std::atomic<uint64_t> failed_iterators;
+
+	recovery_stats() : iterated_keys(0), recover_keys(0), server_sent_keys(0), copied_keys(0),
+		failed_keys(0), failed_iterators(0) {}
+};
+
+/*
+ * Limits number of requests in flight
+ */
+class request_window
+{
+public:
+	explicit request_window(int size) : m_size(size), m_inflight(0) {}
+
+	void acquire()
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_cond.wait(guard, [this] () { return m_inflight < m_size; });
+		++m_inflight;
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		--m_inflight;
+		m_cond.notify_all();
+	}
+
+	void wait_all()
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_cond.wait(guard, [this] () { return m_inflight == 0; });
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_cond;
+	int m_size;
+	int m_inflight;
+};
+
+/*
+ * Metadata of the key at one of the replicas, zero size and timestamp mean there is no key
+ */
+struct replica_key
+{
+	dnet_time timestamp;
+	uint64_t size;
+	bool exists;
+
+	replica_key() : size(0), exists(false)
+	{
+		dnet_empty_time(&timestamp);
+	}
+
+	bool newer(const replica_key &other) const
+	{
+		if (!other.exists)
+			return exists;
+
+		int cmp = dnet_time_cmp(&timestamp, &other.timestamp);
+		return cmp > 0 || (cmp == 0 && size > other.size);
+	}
+};
+
+typedef elliptics::dnet_raw_id_less_than<elliptics::skip_data> id_less;
+typedef std::map<dnet_raw_id, std::vector<replica_key>, id_less> merged_keys;
+
+/*
+ * Splits [begin, end] into @parts adjacent ranges, ids are treated as big-endian numbers
+ */
+static std::vector<dnet_iterator_range> split_range(const dnet_iterator_range &range, int parts)
+{
+	std::vector<dnet_iterator_range> result;
+
+	// only the first 8 bytes are split, it is enough for any reasonable number of parts
+	uint64_t begin = be64toh(*(const uint64_t *)range.key_begin.id);
+	uint64_t end = be64toh(*(const uint64_t *)range.key_end.id);
+	uint64_t step = (end - begin) / parts;
+
+	if (parts <= 1 || step == 0) {
+		result.push_back(range);
+		return result;
+	}
+
+	dnet_iterator_range part = range;
+	for (int i = 0; i < parts; ++i) {
+		if (i + 1 < parts) {
+			uint64_t border = htobe64(begin + (i + 1) * step);
+			memset(part.key_end.id, 0, DNET_ID_SIZE);
+			memcpy(part.key_end.id, &border, sizeof(border));
+		} else {
+			part.key_end = range.key_end;
+		}
+
+		result.push_back(part);
+		part.key_begin = part.key_end;
+	}
+
+	return result;
+}
+
+/*
+ * Key belongs to the backend with the largest route id not greater than the key,
+ * keys below the first id of the group belong to its last backend.
+ */
+static std::vector<recovery_range> make_ranges(std::vector<dnet_route_entry> routes, const recovery_options &options)
+{
+	std::vector<recovery_range> result;
+	std::map<int, std::vector<dnet_route_entry>> groups;
+
+	for (auto it = routes.begin(); it != routes.end(); ++it) {
+		if (std::find(options.groups.begin(), options.groups.end(), it->group_id) != options.groups.end())
+			groups[it->group_id].push_back(*it);
+	}
+
+	std::vector<dnet_raw_id> borders;
+	for (auto it = groups.begin(); it != groups.end(); ++it) {
+		std::sort(it->second.begin(), it->second.end(), [] (const dnet_route_entry &a, const dnet_route_entry &b) {
+			return id_less()(a.id, b.id);
+		});
+
+		for (auto r = it->second.begin(); r != it->second.end(); ++r)
+			borders.push_back(r->id);
+	}
+
+	dnet_raw_id id_min, id_max;
+	memset(id_min.id, 0, DNET_ID_SIZE);
+	memset(id_max.id, 0xff, DNET_ID_SIZE);
+	borders.push_back(id_min);
+
+	std::sort(borders.begin(), borders.end(), id_less());
+	borders.erase(std::unique(borders.begin(), borders.end(), [] (const dnet_raw_id &a, const dnet_raw_id &b) {
+		return !id_less()(a, b) && !id_less()(b, a);
+	}), borders.end());
+
+	for (size_t i = 0; i < borders.size(); ++i) {
+		recovery_range range;
+		range.range.key_begin = borders[i];
+		range.range.key_end = (i + 1 < borders.size()) ? borders[i + 1] : id_max;
+
+		for (auto g = groups.begin(); g != groups.end(); ++g) {
+			const std::vector<dnet_route_entry> &group_routes = g->second;
+			auto owner = std::upper_bound(group_routes.begin(), group_routes.end(), range.range.key_begin,
+				[] (const dnet_raw_id &id, const dnet_route_entry &r) { return id_less()(id, r.id); });
+			owner = (owner == group_routes.begin()) ? group_routes.end() - 1 : owner - 1;
+
+			replica rep;
+			dnet_setup_id(&rep.id, owner->group_id, owner->id.id);
+			rep.group_id = owner->group_id;
+			rep.addr = owner->addr;
+			rep.backend_id = owner->backend_id;
+			range.replicas.push_back(rep);
+		}
+
+		auto parts = split_range(range.range, options.split);
+		for (auto p = parts.begin(); p != parts.end(); ++p) {
+			recovery_range part = range;
+			part.range = *p;
+			result.push_back(part);
+		}
+	}
+
+	return result;
+}
+
+class range_recovery
+{
+public:
+	range_recovery(const elliptics::session &sess, const recovery_options &options, recovery_stats &stats) :
+		m_session(sess.clean_clone()), m_options(options), m_stats(stats), m_window(options.window)
+	{
+		m_session.set_exceptions_policy(elliptics::session::no_exceptions);
+	}
+
+	void run(const recovery_range &range)
+	{
+		merged_keys keys;
+		std::vector<bool> failed(range.replicas.size(), false);
+
+		iterate(range, keys, failed);
+		recover(range, keys, failed);
+	}
+
+private:
+	elliptics::session m_session;
+	const recovery_options &m_options;
+	recovery_stats &m_stats;
+	request_window m_window;
+
+	std::mutex m_failed_lock;
+	std::vector<std::pair<dnet_raw_id, std::pair<int, std::vector<int>>>> m_failed_sends;
+
+	/*
+	 * Iterators of all replicas run concurrently, their results are merged by io threads
+	 */
+	void iterate(const recovery_range &range, merged_keys &keys, std::vector<bool> &failed)
+	{
+		std::mutex lock;
+		std::condition_variable cond;
+		size_t completed = 0;
+		const size_t num = range.replicas.size();
+
+		uint64_t flags = DNET_IFLAGS_KEY_RANGE;
+		dnet_time time_end;
+		dnet_empty_time(&time_end);
+		if (m_options.time_begin.tsec || m_options.time_begin.tnsec) {
+			flags |= DNET_IFLAGS_TS_RANGE;
+			time_end.tsec = ~0ULL;
+			time_end.tnsec = ~0ULL;
+		}
+
+		for (size_t i = 0; i < num; ++i) {
+			const int group_id = range.replicas[i].group_id;
+
+			elliptics::session sess = m_session.clean_clone();
+			sess.set_groups(std::vector<int>(1, group_id));
+
+			auto result = sess.start_iterator(elliptics::key(range.replicas[i].id),
+				std::vector<dnet_iterator_range>(1, range.range), DNET_ITYPE_NETWORK, flags,
+				m_options.time_begin, time_end);
+
+			result.connect(
+				[this, i, num, &keys, &lock] (const elliptics::iterator_result_entry &entry) {
+					if (entry.status() || !entry.reply() || entry.reply()->status)
+						return;
+
+					const dnet_iterator_response *re = entry.reply();
+					std::lock_guard<std::mutex> guard(lock);
+
+					std::vector<replica_key> &infos = keys[re->key];
+					if (infos.empty())
+						infos.resize(num);
+
+					infos[i].timestamp = re->timestamp;
+					infos[i].size = re->size;
+					infos[i].exists = true;
+					++m_stats.iterated_keys;
+				},
+				[this, i, group_id, &failed, &completed, &lock, &cond] (const elliptics::error_info &error) {
+					std::lock_guard<std::mutex> guard(lock);
+					if (error) {
+						std::cerr << "Iterator failed: group: " << group_id << ": " << error.message() << std::endl;
+						failed[i] = true;
+						++m_stats.failed_iterators;
+					}
+					++completed;
+					cond.notify_all();
+				});
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		cond.wait(guard, [&] () { return completed == num; });
+	}
+
+	void recover(const recovery_range &range, const merged_keys &keys, const std::vector<bool> &failed)
+	{
+		// (source replica, destination groups) -> keys
+		std::map<std::pair<size_t, std::vector<int>>, std::vector<dnet_raw_id>> batches;
+
+		for (auto it = keys.begin(); it != keys.end(); ++it) {
+			const std::vector<replica_key> &infos = it->second;
+
+			size_t newest = 0;
+			for (size_t i = 1; i < infos.size(); ++i) {
+				if (infos[i].newer(infos[newest]))
+					newest = i;
+			}
+
+			// replica which failed to iterate may have newer key, it is neither source nor destination
+			std::vector<int> dst;
+			for (size_t i = 0; i < infos.size(); ++i) {
+				if (i != newest && !failed[i] && infos[newest].newer(infos[i]))
+					dst.push_back(range.replicas[i].group_id);
+			}
+
+			if (dst.empty())
+				continue;
+
+			++m_stats.recover_keys;
+			if (m_options.dry_run)
+				continue;
+
+			auto &batch = batches[std::make_pair(newest, dst)];
+			batch.push_back(it->first);
+
+			if (batch.size() >= (size_t)m_options.batch) {
+				send(range.replicas[newest].group_id, dst, batch);
+				batch.clear();
+			}
+		}
+
+		for (auto it = batches.begin(); it != batches.end(); ++it) {
+			if (!it->second.empty())
+				send(range.replicas[it->first.first].group_id, it->first.second, it->second);
+		}
+
+		m_window.wait_all();
+
+		std::vector<std::pair<dnet_raw_id, std::pair<int, std::vector<int>>>> copies;
+		{
+			std::lock_guard<std::mutex> guard(m_failed_lock);
+			copies.swap(m_failed_sends);
+		}
+
+		for (auto it = copies.begin(); it != copies.end(); ++it)
+			copy(it->first, it->second.first, it->second.second);
+
+		m_window.wait_all();
+	}
+
+	void send(int src_group, const std::vector<int> &dst, const std::vector<dnet_raw_id> &ids)
+	{
+		if (m_options.no_server_send) {
+			for (auto it = ids.begin(); it != ids.end(); ++it)
+				copy(*it, src_group, dst);
+			return;
+		}
+
+		auto sent = std::make_shared<std::set<dnet_raw_id, id_less>>();
+
+		elliptics::session sess = m_session.clean_clone();
+		sess.set_groups(std::vector<int>(1, src_group));
+
+		m_window.acquire();
+		sess.server_send(ids, 0, dst).connect(
+			[this, sent] (const elliptics::iterator_result_entry &entry) {
+				if (entry.status() || !entry.reply() || entry.reply()->status)
+					return;
+
+				sent->insert(entry.reply()->key);
+				++m_stats.server_sent_keys;
+			},
+			[this, sent, ids, src_group, dst] (const elliptics::error_info &) {
+				// every key which has not been confirmed is copied by the client
+				{
+					std::lock_guard<std::mutex> guard(m_failed_lock);
+					for (auto it = ids.begin(); it != ids.end(); ++it) {
+						if (sent->find(*it) == sent->end())
+							m_failed_sends.emplace_back(*it, std::make_pair(src_group, dst));
+					}
+				}
+				m_window.release();
+			});
+	}
+
+	void copy(const dnet_raw_id &id, int src_group, const std::vector<int> &dst)
+	{
+		dnet_id key;
+		dnet_setup_id(&key, src_group, id.id);
+
+		elliptics::session reader = m_session.clean_clone();
+		elliptics::session writer = m_session.clean_clone();
+		writer.set_groups(dst);
+
+		m_window.acquire();
+		reader.read_data(elliptics::key(key), std::vector<int>(1, src_group), 0, 0).connect(
+			[this, key, writer] (const elliptics::sync_read_result &result, const elliptics::error_info &error) mutable {
+				if (error || result.empty()) {
+					++m_stats.failed_keys;
+					m_window.release();
+					return;
+				}
+
+				const dnet_io_attr *io = result[0].io_attribute();
+				writer.set_timestamp(&io->timestamp);
+				writer.set_user_flags(io->user_flags);
+
+				writer.write_data(elliptics::key(key), result[0].file(), 0).connect(
+					[this] (const elliptics::sync_write_result &, const elliptics::error_info &error) {
+						if (error)
+							++m_stats.failed_keys;
+						else
+							++m_stats.copied_keys;
+						m_window.release();
+					});
+			});
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::options_description generic("Native dc recovery options");
+
+	recovery_options options;
+	std::string log, log_level_name, groups;
+	std::vector<std::string> remotes;
+	uint64_t timestamp;
+	long wait_timeout;
+
+	generic.add_options()
+		("help", "This help message")
+		("log", bpo::value<std::string>(&log)->default_value("/dev/stderr"), "Elliptics log file")
+		("log-level", bpo::value<std::string>(&log_level_name)->default_value("error"), "Elliptics log level")
+		("remote,r", bpo::value<std::vector<std::string>>(&remotes)->required(), "Elliptics node address")
+		("groups,g", bpo::value<std::string>(&groups)->required(), "Colon separated groups to recover")
+		("time,t", bpo::value<uint64_t>(&timestamp)->default_value(0), "Recover keys modified since timestamp")
+		("threads,n", bpo::value<int>(&options.threads)->default_value(4), "Number of ranges processed at once")
+		("window,w", bpo::value<int>(&options.window)->default_value(64),
+			"Number of server-send batches or copied keys in flight per thread")
+		("batch,b", bpo::value<int>(&options.batch)->default_value(1024), "Number of keys in server-send batch")
+		("split,s", bpo::value<int>(&options.split)->default_value(16),
+			"Number of parts every route range is split into, bounds number of keys held in memory")
+		("wait-timeout", bpo::value<long>(&wait_timeout)->default_value(3600), "Timeout of elliptics operations")
+		("no-server-send,U", "Copy keys by client instead of server-send")
+		("dry-run,N", "Only count keys which have to be recovered")
+		;
+
+	bpo::variables_map vm;
+	dnet_log_level log_level;
+
+	try {
+		bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+
+		if (vm.count("help")) {
+			std::cout << generic << std::endl;
+			return 0;
+		}
+
+		bpo::notify(vm);
+
+		log_level = elliptics::file_logger::parse_level(log_level_name);
+		options.groups = elliptics::parse_groups(groups.c_str());
+		options.dry_run = vm.count("dry-run");
+		options.no_server_send = vm.count("no-server-send");
+		options.time_begin.tsec = timestamp;
+		options.time_begin.tnsec = 0;
+
+		if (options.groups.size() < 2)
+			throw std::invalid_argument("at least 2 groups are required");
+		if (options.threads <= 0 || options.window <= 0 || options.batch <= 0 || options.split <= 0)
+			throw std::invalid_argument("threads, window, batch and split must be positive");
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << "\n" << generic << std::endl;
+		return -1;
+	}
+
+	elliptics::file_logger logger(log.c_str(), log_level);
+	elliptics::node node(elliptics::logger(logger, blackhole::log::attributes_t()));
+	node.set_timeouts(wait_timeout, 60);
+
+	std::vector<recovery_range> ranges;
+	recovery_stats stats;
+
+	try {
+		for (auto it = remotes.begin(); it != remotes.end(); ++it)
+			node.add_remote(*it);
+
+		elliptics::session session(node);
+		session.set_cflags(DNET_FLAGS_NOLOCK | DNET_FLAGS_BACKGROUND);
+		session.set_timeout(wait_timeout);
+
+		ranges = make_ranges(session.get_routes(), options);
+
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+
+		for (int t = 0; t < options.threads; ++t) {
+			workers.emplace_back([&] () {
+				range_recovery recovery(session, options, stats);
+
+				for (size_t i = next++; i < ranges.size(); i = next++)
+					recovery.run(ranges[i]);
+			});
+		}
+
+		for (auto it = workers.begin(); it != workers.end(); ++it)
+			it->join();
+	} catch (const std::exception &e) {
+		std::cerr << "Exception caught: " << e.what() << std::endl;
+		return -1;
+	}
+
+	std::cout << "{\"ranges\": " << ranges.size()
+		<< ", \"iterated_keys\": " << stats.iterated_keys
+		<< ", \"recover_keys\": " << stats.recover_keys
+		<< ", \"server_sent_keys\": " << stats.server_sent_keys
+		<< ", \"copied_keys\": " << stats.copied_keys
+		<< ", \"failed_keys\": " << stats.failed_keys
+		<< ", \"failed_iterators\": " << stats.failed_iterators
+		<< "}" << std::endl;
+
+	return (stats.failed_keys || stats.failed_iterators) ? 1 : 0;
+}
@@ -19,6 +19,8 @@
  */
 
 #define _XOPEN_SOURCE 600
+/* O_DIRECT */
+#define _GNU_SOURCE
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -31,15 +33,21 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <ftw.h>
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <eblob/blob.h>
 
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
 #include "elliptics/backends.h"
@@ -50,7 +58,11 @@
 
 #include "example/eblob_backend.h"
 
+#include "library/crypto/sha512.h"
+#include "library/cuckoo.h"
 #include "library/elliptics.h"
+#include "library/probes.h"
+#include "library/uring.h"
 /*
  * FIXME: __unused is used internally by glibc, so it may cause conflicts.
  */
@@ -93,6 +105,7 @@ static int blob_iterate_callback_common(struct eblob_disk_control *dc, int fd, u
 	struct dnet_ext_list_hdr ehdr;
 	struct dnet_ext_list elist;
 	struct eblob_backend_config *c = ictl->iterate_private;
+	uint64_t flags = dc->flags;
 	uint64_t size;
 	int err;
 
@@ -105,12 +118,19 @@ static int blob_iterate_callback_common(struct eblob_disk_control *dc, int fd, u
 	if (dc->flags & BLOB_DISK_CTL_EXTHDR) {
 		/*
 		 * Skip reading/extracting header of the committed records if iterator runs with no_meta.
-		 * Header of uncommitted records should be read in any cases for correct recovery.
+		 * Header of uncommitted records should be read in any cases for correct recovery,
+		 * as well as headers of backend which may have deduplicated records.
 		 */
-		if (!no_meta || (dc->flags & BLOB_DISK_CTL_UNCOMMITTED)) {
+		if (!no_meta || (dc->flags & BLOB_DISK_CTL_UNCOMMITTED) || c->dedup) {
 			err = dnet_ext_hdr_read(&ehdr, fd, data_offset);
 			if (!err) {
 				dnet_ext_hdr_to_list(&ehdr, &elist);
+
+				/* expired record waits for removal of its bucket */
+				if (elist.expire && elist.expire <= (uint64_t)time(NULL)) {
+					dnet_ext_list_destroy(&elist);
+					return 0;
+				}
 			} else {
 				/* If extended header couldn't be extracted reset elist,
 				 * call callback for key with empty elist
@@ -147,9 +167,22 @@ static int blob_iterate_callback_common(struct eblob_disk_control *dc, int fd, u
 		}
 	}
 
+	if (elist.compression != DNET_COMPRESSION_NONE)
+		flags |= DNET_RECORD_FLAGS_COMPRESSED;
+
+	/* size of the original data is reported for deduplicated record, it is the first field of its manifest */
+	if (elist.dedup && size >= sizeof(struct eblob_dedup_manifest)) {
+		struct eblob_dedup_manifest m;
+
+		if (!dnet_read_ll(fd, &m, sizeof(m), data_offset)) {
+			size = dnet_bswap64(m.size);
+			flags |= DNET_RECORD_FLAGS_DEDUP;
+		}
+	}
+
 	err = ictl->callback(ictl->callback_private,
-	                     (struct dnet_raw_id *)&dc->key, dc->flags,
-	                     fd, data_offset, size, &elist);
+	                     (struct dnet_raw_id *)&dc->key,
+	                     flags, fd, data_offset, size, &elist);
 
 	dnet_ext_list_destroy(&elist);
 	return err;
@@ -182,1222 +215,5899 @@ static int blob_lookup(struct eblob_backend *b, struct eblob_key *key, struct eb
 	return err;
 }
 
-static int blob_write(struct eblob_backend_config *c, void *state,
-		struct dnet_cmd *cmd, void *data)
+/*
+ * Cached lookups expire quickly: records may be moved by defragmentation started by eblob itself,
+ * such moves are not seen by the backend
+ */
+#define EBLOB_LOOKUP_CACHE_TTL_MS	1000
+
+static uint64_t blob_lookup_cache_now(void)
 {
-	struct dnet_ext_list elist;
-	struct dnet_io_attr *io = data;
-	struct eblob_backend *b = c->eblob;
-	struct eblob_write_control wc = { .data_fd = -1 };
-	struct eblob_key key;
-	struct dnet_ext_list_hdr ehdr;
-	uint64_t flags = BLOB_DISK_CTL_EXTHDR;
-	uint64_t fd_offset;
-	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
-	int err;
+	struct timespec ts;
 
-	dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: WRITE: start: %s",
-		dnet_dump_id_str(io->id), dnet_print_io(io));
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
 
-	dnet_convert_io_attr(io);
+static struct eblob_lookup_cache_shard *blob_lookup_cache_shard(struct eblob_backend_config *c,
+		struct eblob_key *key, struct eblob_lookup_cache_entry **e)
+{
+	struct eblob_lookup_cache_shard *shard;
+	uint64_t hash;
 
-	dnet_ext_list_init(&elist);
-	dnet_ext_io_to_list(io, &elist);
-	dnet_ext_list_to_hdr(&elist, &ehdr);
+	memcpy(&hash, key->id, sizeof(hash));
 
-	data += sizeof(struct dnet_io_attr);
+	shard = &c->lookup_cache[hash % EBLOB_LOOKUP_CACHE_SHARDS];
+	*e = &shard->entries[(hash / EBLOB_LOOKUP_CACHE_SHARDS) % c->lookup_cache_shard_size];
+	return shard;
+}
 
-	if (io->flags & DNET_IO_FLAGS_APPEND)
-		flags |= BLOB_DISK_CTL_APPEND;
+static int blob_lookup_cache_init(struct eblob_backend_config *c)
+{
+	int i, err;
 
-	if (io->flags & DNET_IO_FLAGS_NOCSUM)
-		flags |= BLOB_DISK_CTL_NOCSUM;
+	if (!c->lookup_cache_size)
+		return 0;
 
-	memcpy(key.id, io->id, EBLOB_ID_SIZE);
+	c->lookup_cache_shard_size = (c->lookup_cache_size + EBLOB_LOOKUP_CACHE_SHARDS - 1) / EBLOB_LOOKUP_CACHE_SHARDS;
 
-	if (io->flags & DNET_IO_FLAGS_PREPARE) {
-		/*
-		 * We have to put ext header flag into prepare command, since otherwise
-		 * we can not overwrite data later with this flag.
-		 *
-		 * Eblob correctly believes that existing on-disk record without ext header
-		 * (this will be the case after prepare has been completed) can not be
-		 * overwritten with chunk containing ext-header.
-		 *
-		 * Setting this flag opens a window for race with iterator.
-		 * Iterator will see the record with ext header bit set,
-		 * but without actual data.
-		 *
-		 * XXX Alternative way is to fix eblob not to check ext header flag if uncommitted bit is set.
-		 * XXX See eblob_plain_writev_prepare() and ext header check.
-		 */
-		err = eblob_write_prepare(b, &key, io->num + ehdr_size, flags);
-		if (err) {
-			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_write_prepare: "
-					"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
-					io->num + ehdr_size, strerror(-err), err);
-			goto err_out_exit;
-		}
+	c->lookup_cache = calloc(EBLOB_LOOKUP_CACHE_SHARDS, sizeof(struct eblob_lookup_cache_shard));
+	if (!c->lookup_cache)
+		return -ENOMEM;
 
-		const struct eblob_iovec iov[1] = {
-			{ .offset = 0, .size = ehdr_size, .base = &ehdr },
-		};
+	for (i = 0; i < EBLOB_LOOKUP_CACHE_SHARDS; ++i) {
+		struct eblob_lookup_cache_shard *shard = &c->lookup_cache[i];
 
-		err = eblob_plain_writev(b, &key, iov, 1, flags);
-		if (err) {
-			dnet_backend_log(c->blog, DNET_LOG_ERROR,
-				"%s: EBLOB: blob-write: eblob_plain_writev: header WRITE: %d: %s",
-				dnet_dump_id_str(io->id), err, strerror(-err));
-			goto err_out_exit;
+		shard->entries = calloc(c->lookup_cache_shard_size, sizeof(struct eblob_lookup_cache_entry));
+		if (!shard->entries) {
+			err = -ENOMEM;
+			goto err_out_destroy;
 		}
 
-		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: eblob_write_prepare: "
-				"size: %" PRIu64 ": Ok", dnet_dump_id_str(io->id), io->num + ehdr_size);
+		err = -pthread_mutex_init(&shard->lock, NULL);
+		if (err) {
+			free(shard->entries);
+			goto err_out_destroy;
+		}
 	}
 
-	if (io->size) {
-		/*
-		 * Although we have already filled ext header above (at prepare time),
-		 * we update it each time chunk has been written to change timestamp and user flags.
-		 */
-		const struct eblob_iovec iov[2] = {
-			{ .offset = 0, .size = ehdr_size, .base = &ehdr },
-			{ .offset = ehdr_size + io->offset, .size = io->size, .base = data },
-		};
+	return 0;
 
-		if (io->flags & DNET_IO_FLAGS_PLAIN_WRITE) {
-			err = eblob_plain_writev(b, &key, iov, 2, flags);
-		} else {
-			err = eblob_writev_return(b, &key, iov, 2, flags, &wc);
-		}
+err_out_destroy:
+	while (--i >= 0) {
+		pthread_mutex_destroy(&c->lookup_cache[i].lock);
+		free(c->lookup_cache[i].entries);
+	}
+	free(c->lookup_cache);
+	c->lookup_cache = NULL;
+	return err;
+}
 
-		if (err) {
-			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: WRITE: %d: %s",
-				dnet_dump_id_str(io->id), err, strerror(-err));
-			goto err_out_exit;
-		}
+static void blob_lookup_cache_destroy(struct eblob_backend_config *c)
+{
+	int i;
 
-		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: WRITE: Ok: "
-				"offset: %" PRIu64 ", size: %" PRIu64 ".",
-				dnet_dump_id_str(io->id), io->offset, io->size);
+	if (!c->lookup_cache)
+		return;
+
+	for (i = 0; i < EBLOB_LOOKUP_CACHE_SHARDS; ++i) {
+		pthread_mutex_destroy(&c->lookup_cache[i].lock);
+		free(c->lookup_cache[i].entries);
 	}
+	free(c->lookup_cache);
+	c->lookup_cache = NULL;
+}
 
-	if (io->flags & DNET_IO_FLAGS_COMMIT) {
-		/*
-		 * If io->size is not zero, ext header has been written above.
-		 */
-		if (io->size == 0) {
-			const struct eblob_iovec iov[1] = {
-				{ .offset = 0, .size = ehdr_size, .base = &ehdr },
-			};
+/*
+ * Must be called after key has been modified, so that lookup started before modification is not cached
+ */
+static void blob_lookup_cache_invalidate(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_lookup_cache_shard *shard;
+	struct eblob_lookup_cache_entry *e;
 
-			err = eblob_plain_writev(b, &key, iov, 1, flags);
-			if (err) {
-				dnet_backend_log(c->blog, DNET_LOG_ERROR,
-					"%s: EBLOB: blob-write: eblob_plain_writev: commit WRITE: %d: %s",
-					dnet_dump_id_str(io->id), err, strerror(-err));
-				goto err_out_exit;
-			}
-		}
+	if (!c->lookup_cache)
+		return;
 
-		if (io->flags & DNET_IO_FLAGS_PLAIN_WRITE) {
-			uint64_t csize = io->num + ehdr_size;
-			if (io->flags & DNET_IO_FLAGS_PREPARE) {
-				// client has set PREPARE, PLAIN_WRITE and COMMIT flags,
-				// there is no way he could write more data than io->size,
-				// thus it is an error to commit more than io->size + io->offset,
-				// otherwise it will commit empty (zeroed) space (io->num) as data
-				//
-				// this set of flags is used to reserve disk (not data) space for future updates
-				csize = io->size + io->offset + ehdr_size;
-			}
-			err = eblob_write_commit(b, &key, csize, flags);
-			if (err) {
-				dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_write_commit: "
-						"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
-						csize, strerror(-err), err);
-				goto err_out_exit;
-			}
+	shard = blob_lookup_cache_shard(c, key, &e);
 
-			dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: eblob_write_commit: "
-					"size: %" PRIu64 ": Ok", dnet_dump_id_str(io->id), csize);
-		}
-	}
+	pthread_mutex_lock(&shard->lock);
+	shard->generation++;
+	if (e->valid && !memcmp(&e->key, key, sizeof(struct eblob_key)))
+		e->valid = 0;
+	pthread_mutex_unlock(&shard->lock);
+}
 
-	if (!err && wc.data_fd == -1) {
-		err = eblob_read_return(b, &key, EBLOB_READ_NOCSUM, &wc);
-		if (err) {
-			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_read: "
-					"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
-					io->num, strerror(-err), err);
-			goto err_out_exit;
-		}
-	}
+static void blob_lookup_cache_clear(struct eblob_backend_config *c)
+{
+	struct eblob_lookup_cache_shard *shard;
+	uint64_t j;
+	int i;
 
-	if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO) {
-		cmd->flags |= DNET_FLAGS_NEED_ACK;
-		err = 0;
-		goto err_out_exit;
-	}
+	if (!c->lookup_cache)
+		return;
 
-	fd_offset = wc.ctl_data_offset + sizeof(struct eblob_disk_control);
-	if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
-		fd_offset += ehdr_size;
-		if (wc.size) {
-			wc.size -= ehdr_size;
-		}
-	}
+	for (i = 0; i < EBLOB_LOOKUP_CACHE_SHARDS; ++i) {
+		shard = &c->lookup_cache[i];
 
-	err = dnet_send_file_info_ts(state, cmd, wc.data_fd, fd_offset, wc.size, &elist.timestamp, wc.flags);
-	if (err) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: dnet_send_file_info: "
-				"fd: %d, offset: %" PRIu64 ", offset-within-fd: %" PRIu64 ", size: %" PRIu64 ": %s %d",
-				dnet_dump_id_str(io->id), wc.data_fd, wc.offset, fd_offset, wc.size,
-				strerror(-err), err);
-		goto err_out_exit;
+		pthread_mutex_lock(&shard->lock);
+		shard->generation++;
+		for (j = 0; j < c->lookup_cache_shard_size; ++j)
+			shard->entries[j].valid = 0;
+		pthread_mutex_unlock(&shard->lock);
 	}
+}
 
-	dnet_backend_log(c->blog, DNET_LOG_INFO, "%s: EBLOB: blob-write: fd: %d, offset: %" PRIu64
-			", offset-within-fd: %" PRIu64 ", size: %" PRIu64 "",
-			dnet_dump_id_str(io->id), wc.data_fd, wc.offset, fd_offset, wc.size);
+static struct eblob_absent_cache_shard *blob_absent_cache_shard(struct eblob_backend_config *c,
+		struct eblob_key *key, struct eblob_absent_cache_entry **e)
+{
+	struct eblob_absent_cache_shard *shard;
+	uint64_t hash;
 
-err_out_exit:
-	dnet_ext_list_destroy(&elist);
-	return err;
-}
+	/* bits lookup cache does not take */
+	memcpy(&hash, key->id + sizeof(hash), sizeof(hash));
 
+	shard = &c->absent_cache[hash % EBLOB_ABSENT_CACHE_SHARDS];
+	*e = &shard->entries[(hash / EBLOB_ABSENT_CACHE_SHARDS) % c->absent_cache_shard_size];
+	return shard;
+}
 
-static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data, int last)
+static int blob_absent_cache_init(struct eblob_backend_config *c)
 {
-	struct dnet_ext_list elist;
-	struct dnet_io_attr *io = data;
-	struct eblob_backend *b = c->eblob;
-	struct eblob_key key;
-	struct eblob_write_control wc;
-	uint64_t offset = 0, size = 0, record_offset = io->offset;
-	int err, fd = -1, on_close = 0;
-	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	int i, err;
 
-	dnet_ext_list_init(&elist);
-	dnet_convert_io_attr(io);
+	if (!c->absent_cache_size)
+		return 0;
 
-	memcpy(key.id, io->id, EBLOB_ID_SIZE);
+	c->absent_cache_shard_size = (c->absent_cache_size + EBLOB_ABSENT_CACHE_SHARDS - 1) / EBLOB_ABSENT_CACHE_SHARDS;
 
-	err = blob_lookup(b, &key, &wc);
-	if (err < 0) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-read-fd: READ: %d: %s",
-		                 dnet_dump_id_str(io->id), err, strerror(-err));
-		goto err_out_exit;
-	}
+	c->absent_cache = calloc(EBLOB_ABSENT_CACHE_SHARDS, sizeof(struct eblob_absent_cache_shard));
+	if (!c->absent_cache)
+		return -ENOMEM;
 
-	/* Existing entry */
-	offset = wc.data_offset;
-	size = wc.total_data_size;
-	fd = wc.data_fd;
+	for (i = 0; i < EBLOB_ABSENT_CACHE_SHARDS; ++i) {
+		struct eblob_absent_cache_shard *shard = &c->absent_cache[i];
 
-	/* Existing new-format entry */
-	if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
-		struct dnet_ext_list_hdr ehdr;
+		shard->entries = calloc(c->absent_cache_shard_size, sizeof(struct eblob_absent_cache_entry));
+		if (!shard->entries) {
+			err = -ENOMEM;
+			goto err_out_destroy;
+		}
 
-		/* Sanity */
-		if (size < ehdr_size) {
-			err = -ERANGE;
-			goto err_out_exit;
+		err = -pthread_mutex_init(&shard->lock, NULL);
+		if (err) {
+			free(shard->entries);
+			goto err_out_destroy;
 		}
+	}
 
-		err = dnet_ext_hdr_read(&ehdr, fd, offset);
-		if (err != 0)
-			goto err_out_exit;
-		dnet_ext_hdr_to_list(&ehdr, &elist);
-		dnet_ext_list_to_io(&elist, io);
+	return 0;
 
-		/* Take into an account extended header's len */
-		size -= sizeof(struct dnet_ext_list_hdr);
-		offset += sizeof(struct dnet_ext_list_hdr);
-		record_offset += sizeof(struct dnet_ext_list_hdr);
+err_out_destroy:
+	while (--i >= 0) {
+		pthread_mutex_destroy(&c->absent_cache[i].lock);
+		free(c->absent_cache[i].entries);
 	}
+	free(c->absent_cache);
+	c->absent_cache = NULL;
+	return err;
+}
 
-	err = dnet_backend_check_get_size(io, &offset, &size);
-	if (err) {
-		goto err_out_exit;
-	}
+static void blob_absent_cache_destroy(struct eblob_backend_config *c)
+{
+	int i;
 
-	io->record_flags = wc.flags;
+	if (!c->absent_cache)
+		return;
 
-	if (!(io->flags & DNET_IO_FLAGS_NOCSUM)) {
-		wc.offset = record_offset;
-		wc.size = size;
-		err = eblob_verify_checksum(b, &key, &wc);
-		if (err)
-			goto err_out_exit;
+	for (i = 0; i < EBLOB_ABSENT_CACHE_SHARDS; ++i) {
+		pthread_mutex_destroy(&c->absent_cache[i].lock);
+		free(c->absent_cache[i].entries);
 	}
+	free(c->absent_cache);
+	c->absent_cache = NULL;
+}
 
-	if (size && last)
-		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+/* miss of the lookup started when shard had @generation is cached only if the shard has not been modified since */
+static uint64_t blob_absent_cache_generation(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_absent_cache_shard *shard;
+	struct eblob_absent_cache_entry *e;
+	uint64_t generation;
 
-	if (fd >= 0) {
-		struct eblob_read_params *p, *prev;
-		int i;
+	if (!c->absent_cache)
+		return 0;
 
-		pthread_mutex_lock(&c->last_read_lock);
-		p = &c->last_reads[c->last_read_index];
+	shard = blob_absent_cache_shard(c, key, &e);
 
-		if (++c->last_read_index >= (int)ARRAY_SIZE(c->last_reads)) {
-			int64_t tmp;
-			int64_t mult = 1;
-			int64_t mean = 0;
-			int old_ra;
+	pthread_mutex_lock(&shard->lock);
+	generation = shard->generation;
+	pthread_mutex_unlock(&shard->lock);
 
-			qsort(c->last_reads, ARRAY_SIZE(c->last_reads), sizeof(struct eblob_read_params),
-					eblob_read_params_compare);
+	return generation;
+}
 
-			prev = &c->last_reads[0];
-			tmp = prev->offset;
-
-			for (i = 1; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
-				p = &c->last_reads[i];
+static void blob_absent_cache_add(struct eblob_backend_config *c, struct eblob_key *key, uint64_t generation)
+{
+	struct eblob_absent_cache_shard *shard;
+	struct eblob_absent_cache_entry *e;
 
-				if (p->fd != prev->fd)
-					mult++;
+	if (!c->absent_cache)
+		return;
 
-				tmp += p->offset * mult;
-				prev = p;
-			}
+	shard = blob_absent_cache_shard(c, key, &e);
 
-			/* found mean offset */
-			mean = tmp / ARRAY_SIZE(c->last_reads);
+	pthread_mutex_lock(&shard->lock);
+	if (generation == shard->generation) {
+		memcpy(&e->key, key, sizeof(struct eblob_key));
+		e->valid = 1;
+		__sync_add_and_fetch(&c->absent_stat.cached, 1);
+	}
+	pthread_mutex_unlock(&shard->lock);
+}
 
-			/* calculating mean squared error */
-			tmp = 0;
-			for (i = 0; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
-				p = &c->last_reads[i];
+static void blob_absent_cache_invalidate(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_absent_cache_shard *shard;
+	struct eblob_absent_cache_entry *e;
 
-				tmp += ((int64_t)p->offset - mean) * ((int64_t)p->offset - mean);
-			}
-			tmp /= ARRAY_SIZE(c->last_reads);
+	if (!c->absent_cache)
+		return;
 
-			/*
-			 * tmp and vm_total are squared, so if this check is true,
-			 * mean offset difference (error) is more than 25% of RAM
-			 */
-			old_ra = c->random_access;
-			if (tmp > c->vm_total / 16)
-				c->random_access = 1;
-			else
-				c->random_access = 0;
+	shard = blob_absent_cache_shard(c, key, &e);
 
-			if (old_ra != c->random_access) {
-				dnet_backend_log(c->blog, DNET_LOG_NOTICE,
-					"EBLOB: switch RA %d -> %d, offset MSE: %llu, squared VM total: %llu",
-					old_ra, c->random_access, (unsigned long long)tmp, (unsigned long long)c->vm_total);
-			}
+	pthread_mutex_lock(&shard->lock);
+	shard->generation++;
+	if (e->valid && !memcmp(&e->key, key, sizeof(struct eblob_key)))
+		e->valid = 0;
+	pthread_mutex_unlock(&shard->lock);
+}
 
-			c->last_read_index = 0;
-		}
+/*
+ * Returns true if @key is known to be absent: it has recently been missed or it is not in key filter.
+ * Never blocks on io, so it is also called by net threads before request is queued.
+ */
+static int blob_key_absent(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_absent_cache_shard *shard;
+	struct eblob_absent_cache_entry *e;
+	int hit = 0;
 
-		p->fd = fd;
-		p->offset = offset;
-		pthread_mutex_unlock(&c->last_read_lock);
+	if (c->key_filter && !dnet_cuckoo_filter_contains(c->key_filter, key->id)) {
+		__sync_add_and_fetch(&c->absent_stat.filter_hits, 1);
+		return 1;
 	}
 
-	if (c->random_access)
-		on_close = DNET_IO_REQ_FLAGS_CACHE_FORGET;
+	if (!c->absent_cache)
+		return 0;
 
-	err = dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
+	shard = blob_absent_cache_shard(c, key, &e);
 
-err_out_exit:
-	dnet_ext_list_destroy(&elist);
-	return err;
+	pthread_mutex_lock(&shard->lock);
+	hit = e->valid && !memcmp(&e->key, key, sizeof(struct eblob_key));
+	pthread_mutex_unlock(&shard->lock);
+
+	if (hit)
+		__sync_add_and_fetch(&c->absent_stat.cache_hits, 1);
+	return hit;
 }
 
-struct eblob_read_range_priv {
-	void			*state;
-	struct dnet_cmd		*cmd;
-	dnet_logger		*blog;
-	struct eblob_range_request	*keys;
-	uint64_t		keys_size;
-	uint64_t		keys_cnt;
-	uint32_t		flags;
-};
+/*
+ * Must be called after key has been modified and before modification is replied,
+ * so that neither cached lookup nor cached miss started before it is used afterwards
+ */
+static void blob_key_modified(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	if (c->key_filter)
+		dnet_cuckoo_filter_add(c->key_filter, key->id);
 
-static int blob_cmp_range_request(const void *req1, const void *req2)
+	blob_absent_cache_invalidate(c, key);
+	blob_lookup_cache_invalidate(c, key);
+}
+
+static int blob_key_filter_callback(struct eblob_disk_control *dc, struct eblob_ram_control *rctl __unused,
+		int fd __unused, uint64_t data_offset __unused, void *priv, void *thread_priv __unused)
 {
-	return memcmp(((struct eblob_range_request *)(req1))->record_key,
-	              ((struct eblob_range_request *)(req2))->record_key,
-	              EBLOB_ID_SIZE);
+	struct eblob_backend_config *c = priv;
+
+	dnet_cuckoo_filter_add(c->key_filter, dc->key.id);
+	return 0;
 }
 
-static int blob_read_range_callback(struct eblob_range_request *req)
+/* fills key filter by keys of the index, writes are not served yet */
+static int blob_key_filter_init(struct eblob_backend_config *c)
 {
-	struct eblob_read_range_priv *p = req->priv;
-	struct dnet_io_attr io;
+	struct eblob_iterate_control eictl = {
+		.priv = c,
+		.b = c->eblob,
+		.log = c->data.log,
+		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
+		.thread_num = 1,
+		.iterator_cb = {
+			.iterator = blob_key_filter_callback,
+		},
+	};
 	int err;
 
-	if (req->requested_offset > req->record_size) {
-		err = 0;
-		goto err_out_exit;
+	if (!c->key_filter_capacity)
+		return 0;
+
+	err = dnet_cuckoo_filter_create(c->key_filter_capacity, &c->key_filter);
+	if (err)
+		return err;
+
+	err = eblob_iterate(c->eblob, &eictl);
+	if (err) {
+		dnet_cuckoo_filter_destroy(c->key_filter);
+		c->key_filter = NULL;
+		return err;
 	}
 
-	if (!(p->flags & DNET_IO_FLAGS_NODATA)) {
-		struct eblob_write_control wc;
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: key filter of %" PRIu64 " keys is filled by %" PRIu64 " keys%s.",
+			c->key_filter_capacity, dnet_cuckoo_filter_keys(c->key_filter),
+			dnet_cuckoo_filter_saturated(c->key_filter) ? ", it is saturated and does not filter keys" : "");
+	return 0;
+}
 
-		io.flags = 0;
-		io.size = req->record_size - req->requested_offset;
-		io.offset = req->requested_offset;
+static void blob_key_filter_destroy(struct eblob_backend_config *c)
+{
+	dnet_cuckoo_filter_destroy(c->key_filter);
+	c->key_filter = NULL;
+}
 
-		/* FIXME: This is slow! */
-		err = blob_lookup(req->back, (struct eblob_key *)req->record_key, &wc);
-		if (err)
-			goto err_out_exit;
+/* expired record is not removed from disk until its bucket is, but it is not found anymore */
+static int blob_hdr_expired(const struct eblob_write_control *wc, const struct dnet_ext_list_hdr *ehdr)
+{
+	uint64_t expire;
 
-		if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
-			struct dnet_ext_list_hdr ehdr;
-			struct dnet_ext_list elist;
+	if (!(wc->flags & BLOB_DISK_CTL_EXTHDR) || wc->total_data_size < sizeof(struct dnet_ext_list_hdr))
+		return 0;
 
-			err = dnet_ext_hdr_read(&ehdr, req->record_fd, req->record_offset);
-			if (err != 0)
-				goto err_out_exit;
+	expire = dnet_bswap64(ehdr->expire);
+	return expire && expire <= (uint64_t)time(NULL);
+}
 
-			dnet_ext_hdr_to_list(&ehdr, &elist);
-			dnet_ext_list_to_io(&elist, &io);
+/* prefix of the key as a number, so that prefixes are ordered like keys are */
+static inline uint64_t blob_compact_prefix(const struct eblob_key *key)
+{
+	uint64_t prefix = 0;
+	int i;
 
-			io.offset += sizeof(struct dnet_ext_list_hdr);
-			io.size -= sizeof(struct dnet_ext_list_hdr);
-		}
+	for (i = 0; i < 8; ++i)
+		prefix = (prefix << 8) | key->id[i];
+	return prefix;
+}
 
-		memcpy(io.id, req->record_key, DNET_ID_SIZE);
-		memcpy(io.parent, req->end, DNET_ID_SIZE);
+static inline uint64_t blob_compact_predict(const struct eblob_compact_base *b, uint64_t prefix)
+{
+	return ((unsigned __int128)prefix * b->num) >> 64;
+}
 
-		err = dnet_send_read_data(p->state, p->cmd, &io, NULL, req->record_fd,
-				req->record_offset + io.offset, 0);
-		if (!err)
-			req->current_pos++;
-	} else {
-		req->current_pos++;
-		err = 0;
+static inline uint64_t blob_compact_position(const struct eblob_compact_base *b, uint64_t i)
+{
+	const unsigned char *p = b->positions + i * EBLOB_COMPACT_POSITION_SIZE;
+	uint64_t position = 0;
+	int j;
+
+	for (j = EBLOB_COMPACT_POSITION_SIZE - 1; j >= 0; --j)
+		position = (position << 8) | p[j];
+	return position;
+}
+
+/*
+ * Checks that record at @position of base @b is alive version of @key and fills @wc and @ehdr
+ * like eblob lookup does. Record header and ext header are read at once.
+ */
+static int blob_compact_verify(struct eblob_compact_base *b, struct eblob_key *key, uint64_t position,
+		struct eblob_write_control *wc, struct dnet_ext_list_hdr *ehdr)
+{
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	struct {
+		struct eblob_disk_control	dc;
+		struct dnet_ext_list_hdr	ehdr;
+	} __attribute__ ((packed)) hdr;
+	ssize_t bytes;
+
+	bytes = pread(b->data_fd, &hdr, sizeof(hdr), position);
+	if (bytes < (ssize_t)sizeof(hdr.dc))
+		return -ENOENT;
+
+	eblob_convert_disk_control(&hdr.dc);
+	if (memcmp(&hdr.dc.key, key, sizeof(struct eblob_key)) || hdr.dc.position != position ||
+			(hdr.dc.flags & (BLOB_DISK_CTL_REMOVE | BLOB_DISK_CTL_UNCOMMITTED)))
+		return -ENOENT;
+
+	if ((hdr.dc.flags & BLOB_DISK_CTL_EXTHDR) && hdr.dc.data_size >= ehdr_size) {
+		if (bytes < (ssize_t)sizeof(hdr))
+			return -ENOENT;
+		*ehdr = hdr.ehdr;
 	}
 
-err_out_exit:
-	return err;
+	memset(wc, 0, sizeof(struct eblob_write_control));
+	wc->data_fd = b->data_fd;
+	wc->index_fd = -1;
+	wc->flags = hdr.dc.flags;
+	wc->size = hdr.dc.data_size;
+	wc->total_data_size = hdr.dc.data_size;
+	wc->total_size = hdr.dc.disk_size;
+	wc->ctl_data_offset = position;
+	wc->data_offset = position + sizeof(struct eblob_disk_control);
+	return 0;
 }
 
-static int blob_del_range_callback(struct eblob_backend_config *c, struct eblob_range_request *req)
+/*
+ * Looks @key up in compact indexes of sealed bases, newest first. -ENOENT means eblob is to be asked:
+ * key may be in the base being written or its version found here may have been replaced.
+ * Indexes are not used while defragmentation rewrites bases.
+ */
+static int blob_compact_lookup(struct eblob_backend_config *c, struct eblob_key *key,
+		struct eblob_write_control *wc, struct dnet_ext_list_hdr *ehdr)
 {
-	struct eblob_key key;
-	int err;
+	struct eblob_compact_index *ci = c->compact;
+	struct eblob_compact_base *b;
+	uint64_t prefix, guess, lo, hi, mid;
+	struct stat st;
+	int err = -ENOENT;
 
-	dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL",
-			dnet_dump_id_str(req->record_key));
+	if (!ci || eblob_defrag_status(c->eblob))
+		return -ENOENT;
 
-	memcpy(key.id, req->record_key, EBLOB_ID_SIZE);
-	err = eblob_remove(req->back, &key);
-	if (err) {
-		dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL: err: %d",
-				dnet_dump_id_str(req->record_key), err);
+	prefix = blob_compact_prefix(key);
+
+	pthread_rwlock_rdlock(&ci->bases_lock);
+	for (b = ci->bases; b && err; b = b->next) {
+		guess = blob_compact_predict(b, prefix);
+		lo = guess > b->error ? guess - b->error : 0;
+		hi = guess + b->error + 1 < b->num ? guess + b->error + 1 : b->num;
+
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (b->prefixes[mid] < prefix)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo >= b->num || b->prefixes[lo] != prefix)
+			continue;
+
+		/* data file replaced by defragmentation does not get removal marks anymore */
+		if (fstat(b->data_fd, &st) || !st.st_nlink)
+			continue;
+
+		for (; lo < b->num && b->prefixes[lo] == prefix && err; ++lo)
+			err = blob_compact_verify(b, key, blob_compact_position(b, lo), wc, ehdr);
 	}
+	pthread_rwlock_unlock(&ci->bases_lock);
 
+	__sync_add_and_fetch(err ? &ci->stat.misses : &ci->stat.hits, 1);
 	return err;
 }
 
-static int blob_range_callback(struct eblob_range_request *req)
+/*
+ * Looks @key up and reads ext header of the record into @ehdr if it has one,
+ * results are taken from and put into lookup cache when it is enabled.
+ * Caller must still check that record is large enough to have ext header,
+ * @ehdr is not filled otherwise. Expired records are not found.
+ */
+static int blob_lookup_hdr(struct eblob_backend_config *c, struct eblob_key *key,
+		struct eblob_write_control *wc, struct dnet_ext_list_hdr *ehdr)
 {
-	struct eblob_read_range_priv *p = req->priv;
-	int len = 10;
-	char start_id[len*2+1], end_id[len*2+1], cur_id[2*len+1];
-	int err = 0;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	struct eblob_lookup_cache_shard *shard = NULL;
+	struct eblob_lookup_cache_entry *e = NULL;
+	uint64_t generation = 0, absent_generation, now = 0;
+	struct stat st;
+	int hit = 0, err;
 
-	dnet_dump_id_len_raw(req->start, len, start_id);
-	dnet_dump_id_len_raw(req->end, len, end_id);
-	dnet_dump_id_len_raw(req->record_key, len, cur_id);
+	if (blob_key_absent(c, key))
+		return -ENOENT;
 
-	dnet_backend_log(p->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-range: limit: %llu [%llu, %llu]: "
-			"start: %s, end: %s: io record/requested: offset: %llu/%llu, size: %llu/%llu",
-			cur_id,
-			(unsigned long long)req->current_pos,
-			(unsigned long long)req->requested_limit_start, (unsigned long long)req->requested_limit_num,
-			start_id, end_id,
-			(unsigned long long)req->record_offset, (unsigned long long)req->requested_offset,
-			(unsigned long long)req->record_size, (unsigned long long)req->requested_size);
+	absent_generation = blob_absent_cache_generation(c, key);
 
-	if (req->requested_offset > req->record_size) {
-		err = 0;
-		goto err_out_exit;
+	if (c->lookup_cache && !eblob_defrag_status(c->eblob)) {
+		shard = blob_lookup_cache_shard(c, key, &e);
+		now = blob_lookup_cache_now();
+
+		pthread_mutex_lock(&shard->lock);
+		if (e->valid && e->expires > now && !memcmp(&e->key, key, sizeof(struct eblob_key))) {
+			*wc = e->wc;
+			*ehdr = e->ehdr;
+			st.st_dev = e->dev;
+			st.st_ino = e->ino;
+			hit = 1;
+		}
+		generation = shard->generation;
+		pthread_mutex_unlock(&shard->lock);
+
+		if (hit) {
+			dev_t dev = st.st_dev;
+			ino_t ino = st.st_ino;
+
+			if (!fstat(wc->data_fd, &st) && st.st_dev == dev && st.st_ino == ino)
+				return blob_hdr_expired(wc, ehdr) ? -ENOENT : 0;
+		}
 	}
 
-	if (p->keys_size == p->keys_cnt) {
-		/* On first pass allocate 1000, otherwise double allocation size */
-		p->keys_size = p->keys_size ? p->keys_size * 2 : 1000;
-		p->keys = realloc(p->keys, sizeof(struct eblob_range_request) * p->keys_size);
-		if (p->keys == NULL) {
-			err = -ENOMEM;
-			dnet_backend_log(p->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-del-range: can't (re-)allocate memory, "
-					"new size: %" PRIu64 "", cur_id, p->keys_size);
-			goto err_out_exit;
+	err = blob_compact_lookup(c, key, wc, ehdr);
+	if (err) {
+		err = blob_lookup(c->eblob, key, wc);
+		if (err) {
+			if (err == -ENOENT)
+				blob_absent_cache_add(c, key, absent_generation);
+			return err;
+		}
+
+		if ((wc->flags & BLOB_DISK_CTL_EXTHDR) && wc->total_data_size >= ehdr_size) {
+			err = dnet_ext_hdr_read(ehdr, wc->data_fd, wc->data_offset);
+			if (err)
+				return err;
 		}
 	}
 
-	memcpy(&p->keys[p->keys_cnt], req, sizeof(struct eblob_range_request));
-	dnet_dump_id_len_raw(p->keys[p->keys_cnt].record_key, len, cur_id);
-	dnet_backend_log(p->blog, DNET_LOG_DEBUG, "%s: count: %llu", cur_id, (unsigned long long)(p->keys_cnt));
-	p->keys_cnt++;
+	if (!shard || fstat(wc->data_fd, &st))
+		return blob_hdr_expired(wc, ehdr) ? -ENOENT : 0;
+
+	pthread_mutex_lock(&shard->lock);
+	if (generation == shard->generation) {
+		memcpy(&e->key, key, sizeof(struct eblob_key));
+		e->wc = *wc;
+		e->ehdr = *ehdr;
+		e->dev = st.st_dev;
+		e->ino = st.st_ino;
+		e->expires = now + EBLOB_LOOKUP_CACHE_TTL_MS;
+		e->valid = 1;
+	}
+	pthread_mutex_unlock(&shard->lock);
 
-	if (!err)
-		req->current_pos++;
-err_out_exit:
-	return err;
+	return blob_hdr_expired(wc, ehdr) ? -ENOENT : 0;
 }
 
-static int blob_read_range(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+static void blob_path_cache_destroy(struct eblob_backend_config *c)
 {
-	struct eblob_read_range_priv p;
-	struct dnet_io_attr *io = data;
-	struct eblob_backend *b = c->eblob;
-	struct eblob_range_request req;
-	uint64_t i, start_from = 0;
-	int err;
+	int i;
 
-	memset(&p, 0, sizeof(p));
+	for (i = 0; i < EBLOB_PATH_CACHE_SLOTS; ++i) {
+		free(c->path_cache[i].path);
+		c->path_cache[i].path = NULL;
+	}
+	pthread_mutex_destroy(&c->path_cache_lock);
+}
 
-	p.cmd = cmd;
-	p.state = state;
-	p.keys = NULL;
-	p.keys_size= 0;
-	p.keys_cnt = 0;
-	p.flags = io->flags;
-	p.blog = c->blog;
+/*
+ * Copies path of data file @fd into @path of @size bytes, resolves it only if it is not cached yet
+ */
+static int blob_path_cache_get(struct eblob_backend_config *c, int fd, char *path, size_t size)
+{
+	struct eblob_path_cache_entry *e = &c->path_cache[fd % EBLOB_PATH_CACHE_SLOTS];
+	char proc[64];
+	struct stat st;
+	ssize_t len;
+	char *copy;
 
-	dnet_convert_io_attr(io);
+	if (fstat(fd, &st))
+		return -errno;
 
-	memset(&req, 0, sizeof(req));
+	pthread_mutex_lock(&c->path_cache_lock);
+	if (e->path && e->fd == fd && e->dev == st.st_dev && e->ino == st.st_ino && strlen(e->path) < size) {
+		strcpy(path, e->path);
+		pthread_mutex_unlock(&c->path_cache_lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&c->path_cache_lock);
 
-	memcpy(req.start, io->id, EBLOB_ID_SIZE);
-	memcpy(req.end, io->parent, EBLOB_ID_SIZE);
-	req.requested_offset = io->offset;
-	req.requested_size = io->size;
-	req.requested_limit_start = 0;
-	req.requested_limit_num = ~0ULL;
+	snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+	len = readlink(proc, path, size - 1);
+	if (len < 0)
+		return -errno;
+	path[len] = '\0';
 
-	req.callback = blob_range_callback;
-	req.back = b;
-	req.priv = &p;
+	copy = strdup(path);
+	if (!copy)
+		return 0;
 
-	err = eblob_read_range(&req);
-	if (err) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-read-range: %d: %s",
-			dnet_dump_id_str(io->id), err, strerror(-err));
-		goto err_out_exit;
-	}
+	pthread_mutex_lock(&c->path_cache_lock);
+	free(e->path);
+	e->path = copy;
+	e->fd = fd;
+	e->dev = st.st_dev;
+	e->ino = st.st_ino;
+	pthread_mutex_unlock(&c->path_cache_lock);
+
+	return 0;
+}
+
+/*
+ * Sends file info reply of the record at @offset of data file @fd
+ */
+static int blob_send_file_info(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		int fd, uint64_t offset, uint64_t size, struct dnet_time *timestamp, uint64_t record_flags)
+{
+	char path[PATH_MAX];
+	const char *file = NULL;
+
+	if (!(cmd->flags & DNET_FLAGS_NO_FILE_PATH) && !blob_path_cache_get(c, fd, path, sizeof(path)))
+		file = path;
+
+	return dnet_send_file_info_ts_path(state, cmd, fd, file, offset, size, timestamp, record_flags);
+}
+
+#define EBLOB_GROUP_COMMIT_BYTES_DEFAULT	(1024 * 1024)
+
+static int blob_group_commit_init(struct eblob_backend_config *c)
+{
+	struct eblob_group_commit *gc = &c->group_commit;
+	int err;
+
+	/* eblob syncs every write itself only when sync is 0 */
+	if (!c->group_commit_window_us || c->data.sync != 0)
+		return 0;
+
+	memset(gc, 0, sizeof(struct eblob_group_commit));
+
+	err = -pthread_mutex_init(&gc->lock, NULL);
+	if (err)
+		return err;
+
+	err = -pthread_cond_init(&gc->cond, NULL);
+	if (err) {
+		pthread_mutex_destroy(&gc->lock);
+		return err;
+	}
+
+	if (!c->group_commit_bytes)
+		c->group_commit_bytes = EBLOB_GROUP_COMMIT_BYTES_DEFAULT;
+
+	/* writes are synced by groups now */
+	c->data.sync = -1;
+	c->group_commit_enabled = 1;
+	return 0;
+}
+
+static void blob_group_commit_destroy(struct eblob_backend_config *c)
+{
+	if (!c->group_commit_enabled)
+		return;
+
+	pthread_cond_destroy(&c->group_commit.cond);
+	pthread_mutex_destroy(&c->group_commit.lock);
+	c->group_commit_enabled = 0;
+}
+
+static void blob_group_commit_add_fd(struct eblob_group_commit *gc, int fd)
+{
+	int i;
+
+	if (fd < 0)
+		return;
+
+	for (i = 0; i < gc->fd_num; ++i) {
+		if (gc->fds[i] == fd)
+			return;
+	}
+
+	/* group is closed by the leader when there is no room, see blob_group_commit_wait() */
+	gc->fds[gc->fd_num++] = fd;
+}
+
+/*
+ * Waits until data of @size bytes written to @write_num files @write_fds is synced to disk together
+ * with other concurrent writes. The first writer which finds no sync in progress becomes the leader:
+ * it waits for the group to collect for up to @group_commit_window_us, syncs all files written by the group
+ * and wakes the others up.
+ */
+static int blob_group_commit_wait(struct eblob_backend_config *c, const int *write_fds, int write_num, uint64_t size)
+{
+	struct eblob_group_commit *gc = &c->group_commit;
+	int fds[EBLOB_GROUP_COMMIT_FDS];
+	struct timespec deadline;
+	uint64_t seq, target;
+	int i, num, err = 0;
+
+	pthread_mutex_lock(&gc->lock);
+
+	/* there must be room for files of this write */
+	while (gc->fd_num > EBLOB_GROUP_COMMIT_FDS - write_num)
+		pthread_cond_wait(&gc->cond, &gc->lock);
+
+	seq = ++gc->written_seq;
+	gc->pending_bytes += size;
+	for (i = 0; i < write_num; ++i)
+		blob_group_commit_add_fd(gc, write_fds[i]);
+
+	if (gc->pending_bytes >= c->group_commit_bytes || gc->fd_num > EBLOB_GROUP_COMMIT_FDS - 2)
+		pthread_cond_broadcast(&gc->cond);
+
+	while (gc->synced_seq < seq) {
+		if (gc->syncing) {
+			pthread_cond_wait(&gc->cond, &gc->lock);
+			continue;
+		}
+
+		gc->syncing = 1;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += (c->group_commit_window_us % 1000000) * 1000;
+		deadline.tv_sec += c->group_commit_window_us / 1000000 + deadline.tv_nsec / 1000000000;
+		deadline.tv_nsec %= 1000000000;
+
+		while (gc->pending_bytes < c->group_commit_bytes && gc->fd_num <= EBLOB_GROUP_COMMIT_FDS - 2) {
+			if (pthread_cond_timedwait(&gc->cond, &gc->lock, &deadline) == ETIMEDOUT)
+				break;
+		}
+
+		target = gc->written_seq;
+		num = gc->fd_num;
+		memcpy(fds, gc->fds, num * sizeof(int));
+		gc->fd_num = 0;
+		gc->pending_bytes = 0;
+		/* writers waiting for room in the group may continue into the next one */
+		pthread_cond_broadcast(&gc->cond);
+		pthread_mutex_unlock(&gc->lock);
+
+		err = 0;
+		for (i = 0; i < num; ++i) {
+			/* file may have been closed by defragmentation, which syncs moved data itself */
+			if (fdatasync(fds[i]) < 0 && errno != EBADF && !err) {
+				err = -errno;
+				dnet_backend_log(c->blog, DNET_LOG_ERROR, "EBLOB: group-commit: fdatasync: fd: %d: %s %d",
+						fds[i], strerror(-err), err);
+			}
+		}
+
+		pthread_mutex_lock(&gc->lock);
+		if (err) {
+			/* writes of the previous failed group have been woken up already */
+			while (gc->error_waiters)
+				pthread_cond_wait(&gc->cond, &gc->lock);
+
+			gc->error_from = gc->synced_seq;
+			gc->error_to = target;
+			gc->error_waiters = target - gc->synced_seq;
+			gc->error = err;
+		}
+		gc->synced_seq = target;
+		gc->syncing = 0;
+		pthread_cond_broadcast(&gc->cond);
+	}
+
+	err = 0;
+	if (gc->error_waiters && seq > gc->error_from && seq <= gc->error_to) {
+		err = gc->error;
+		if (!--gc->error_waiters)
+			pthread_cond_broadcast(&gc->cond);
+	}
+	pthread_mutex_unlock(&gc->lock);
+
+	return err;
+}
+
+static int blob_bulk_commit(struct dnet_bulk_commit *bc)
+{
+	return blob_group_commit_wait(bc->priv, bc->fds, bc->fd_num, bc->size);
+}
+
+/*
+ * Remembers files of the write made by DNET_CMD_BULK_WRITE to sync them once for the whole request,
+ * see struct dnet_bulk_commit. Returns 0 if there is no room for them and write has to be synced right now.
+ */
+static int blob_bulk_commit_defer(struct eblob_backend_config *c, int data_fd, int index_fd, uint64_t size)
+{
+	struct dnet_bulk_commit *bc = dnet_bulk_commit;
+	int fds[2] = { data_fd, index_fd };
+	int i, j, num = bc ? bc->fd_num : 0;
+
+	if (!bc || (bc->priv && bc->priv != c))
+		return 0;
+
+	for (i = 0; i < 2; ++i) {
+		if (fds[i] < 0)
+			continue;
+
+		for (j = 0; j < num && bc->fds[j] != fds[i]; ++j)
+			;
+
+		if (j == num) {
+			if (num == DNET_BULK_COMMIT_FDS)
+				return 0;
+			bc->fds[num++] = fds[i];
+		}
+	}
+
+	bc->commit = blob_bulk_commit;
+	bc->priv = c;
+	bc->fd_num = num;
+	bc->size += size;
+	return 1;
+}
+
+/* compressed data starts with the original size, see dnet_compression_types */
+#define EBLOB_COMPRESSED_HDR_SIZE	sizeof(uint64_t)
+
+/* smaller records are cheaper to store as is, than to decompress on every read */
+#define EBLOB_COMPRESSION_MIN_SIZE	512
+
+static int blob_compression_supported(void)
+{
+#ifdef HAVE_LZ4
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Compresses @size bytes of @data into newly allocated *@out of *@out_size bytes.
+ * Returns 1 if data does not shrink by at least 1/8 and is not worth storing compressed.
+ */
+static int blob_compress(struct eblob_backend_config *c, const void *data, uint64_t size,
+		void **out, uint64_t *out_size)
+{
+#ifdef HAVE_LZ4
+	struct eblob_compression_stat *s = &c->compression_stat;
+	uint64_t start = dnet_monotonic_usecs();
+	uint64_t orig = dnet_bswap64(size);
+	int max_size, compressed;
+	char *buf;
+
+	if (size > LZ4_MAX_INPUT_SIZE)
+		return 1;
+
+	max_size = size - size / 8 - EBLOB_COMPRESSED_HDR_SIZE;
+
+	buf = malloc(EBLOB_COMPRESSED_HDR_SIZE + max_size);
+	if (!buf)
+		return -ENOMEM;
+
+	compressed = LZ4_compress_default(data, buf + EBLOB_COMPRESSED_HDR_SIZE, size, max_size);
+	__sync_add_and_fetch(&s->compress_time, dnet_monotonic_usecs() - start);
+
+	if (compressed <= 0) {
+		__sync_add_and_fetch(&s->incompressible, 1);
+		free(buf);
+		return 1;
+	}
+
+	memcpy(buf, &orig, sizeof(orig));
+
+	__sync_add_and_fetch(&s->compressed, 1);
+	__sync_add_and_fetch(&s->input_bytes, size);
+	__sync_add_and_fetch(&s->output_bytes, EBLOB_COMPRESSED_HDR_SIZE + compressed);
+
+	*out = buf;
+	*out_size = EBLOB_COMPRESSED_HDR_SIZE + compressed;
+	return 0;
+#else
+	(void) c;
+	(void) data;
+	(void) size;
+	(void) out;
+	(void) out_size;
+	return 1;
+#endif
+}
+
+/*
+ * Reads @size bytes of compressed data from @fd at @offset and decompresses it,
+ * reference to the buffer with original data is returned in *@bufp
+ */
+static int blob_decompress(struct eblob_backend_config *c, int fd, uint64_t offset, uint64_t size,
+		struct dnet_buffer **bufp)
+{
+#ifdef HAVE_LZ4
+	struct eblob_compression_stat *s = &c->compression_stat;
+	uint64_t start = dnet_monotonic_usecs();
+	struct dnet_buffer *buf;
+	char *compressed;
+	uint64_t orig;
+	int err;
+
+	if (size < EBLOB_COMPRESSED_HDR_SIZE || size - EBLOB_COMPRESSED_HDR_SIZE > LZ4_MAX_INPUT_SIZE) {
+		err = -EILSEQ;
+		goto err_out_exit;
+	}
+
+	compressed = malloc(size);
+	if (!compressed) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	err = dnet_read_ll(fd, compressed, size, offset);
+	if (err)
+		goto err_out_free;
+
+	memcpy(&orig, compressed, sizeof(orig));
+	orig = dnet_bswap64(orig);
+	if (orig > LZ4_MAX_INPUT_SIZE) {
+		err = -EILSEQ;
+		goto err_out_free;
+	}
+
+	buf = dnet_buffer_alloc(orig);
+	if (!buf) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	err = LZ4_decompress_safe(compressed + EBLOB_COMPRESSED_HDR_SIZE, buf->data,
+			size - EBLOB_COMPRESSED_HDR_SIZE, orig);
+	if (err < 0 || (uint64_t)err != orig) {
+		dnet_buffer_put(buf);
+		err = -EILSEQ;
+		goto err_out_free;
+	}
+
+	__sync_add_and_fetch(&s->decompressed, 1);
+	__sync_add_and_fetch(&s->decompress_time, dnet_monotonic_usecs() - start);
+
+	*bufp = buf;
+	err = 0;
+
+err_out_free:
+	free(compressed);
+err_out_exit:
+	if (err == -EILSEQ) {
+		__sync_add_and_fetch(&s->decompress_errors, 1);
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "EBLOB: corrupted compressed data: fd: %d, "
+				"offset: %" PRIu64 ", size: %" PRIu64, fd, offset, size);
+	}
+	return err;
+#else
+	(void) c;
+	(void) fd;
+	(void) offset;
+	(void) size;
+	(void) bufp;
+	return -ENOTSUP;
+#endif
+}
+
+/* record is written at once by this request */
+static int blob_write_whole(const struct dnet_io_attr *io)
+{
+	static const uint64_t partial = DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_COMMIT |
+		DNET_IO_FLAGS_PLAIN_WRITE;
+
+	return !(io->flags & partial) && !io->offset;
+}
+
+/*
+ * Records written at once are compressed if the backend is configured to,
+ * data which is already compressed (DNET_IO_FLAGS_COMPRESSED) is stored as is.
+ * On return *@data and *@size describe data to be stored, *@buffer is set if it has been allocated for it.
+ */
+static int blob_write_compress(struct eblob_backend_config *c, struct dnet_io_attr *io, struct dnet_ext_list *elist,
+		void **data, uint64_t *size, void **buffer)
+{
+	const int whole = blob_write_whole(io);
+	int err;
+
+	if (io->flags & DNET_IO_FLAGS_COMPRESSED) {
+		if (!blob_compression_supported())
+			return -ENOTSUP;
+		if (!whole || io->size < EBLOB_COMPRESSED_HDR_SIZE)
+			return -EINVAL;
+
+		elist->compression = DNET_COMPRESSION_LZ4;
+		return 0;
+	}
+
+	if (c->compression == DNET_COMPRESSION_NONE || !whole ||
+			io->size < c->compression_threshold || io->size < EBLOB_COMPRESSION_MIN_SIZE)
+		return 0;
+
+	err = blob_compress(c, *data, io->size, buffer, size);
+	if (err)
+		return err < 0 ? err : 0;
+
+	*data = *buffer;
+	elist->compression = c->compression;
+	return 0;
+}
+
+/*
+ * Deduplication
+ *
+ * Chunks are referenced before the manifest which lists them is written and are released after
+ * the manifest has been replaced or removed, so a crash may only leak references, it never loses data.
+ */
+
+static pthread_mutex_t *blob_dedup_lock(pthread_mutex_t *locks, const struct eblob_key *key)
+{
+	return &locks[(key->id[0] | (key->id[1] << 8)) % EBLOB_DEDUP_LOCKS];
+}
+
+/*
+ * Returns size of the chunk which starts at @data, @size bytes of the record are left.
+ * Gear hash depends on the last 64 bytes only, so the same content is cut at the same places
+ * wherever it is in the record.
+ */
+static uint64_t blob_dedup_chunk_end(struct eblob_dedup *d, const unsigned char *data, uint64_t size)
+{
+	uint64_t hash = 0, i;
+
+	if (size <= d->min_size)
+		return size;
+	if (size > d->max_size)
+		size = d->max_size;
+
+	for (i = d->min_size - 64; i < d->min_size; ++i)
+		hash = (hash << 1) + d->gear[data[i]];
+
+	for (; i < size; ++i) {
+		hash = (hash << 1) + d->gear[data[i]];
+		if (!(hash & d->mask))
+			return i + 1;
+	}
+
+	return size;
+}
+
+static void blob_dedup_manifest_convert(struct eblob_dedup_manifest *m, uint64_t num)
+{
+	struct eblob_dedup_chunk_ref *refs = (struct eblob_dedup_chunk_ref *)(m + 1);
+	uint64_t i;
+
+	m->size = dnet_bswap64(m->size);
+	m->num = dnet_bswap64(m->num);
+	for (i = 0; i < num; ++i)
+		refs[i].size = dnet_bswap64(refs[i].size);
+}
+
+/*
+ * Splits @size bytes of @data into chunks, manifest of them is allocated in *@mp.
+ * Chunks are hashed in batches, so that SHA512 processes several of them at once.
+ */
+static int blob_dedup_split(struct eblob_dedup *d, const void *data, uint64_t size, struct eblob_dedup_manifest **mp)
+{
+	unsigned char hash[16][SHA512_DIGEST_SIZE];
+	const void *buffers[ARRAY_SIZE(hash)];
+	uint64_t lens[ARRAY_SIZE(hash)];
+	struct eblob_dedup_chunk_ref *refs;
+	struct eblob_dedup_manifest *m;
+	uint64_t num = 0, pos, i, j, batch;
+
+	m = malloc(sizeof(struct eblob_dedup_manifest) + (size / d->min_size + 1) * sizeof(struct eblob_dedup_chunk_ref));
+	if (!m)
+		return -ENOMEM;
+
+	refs = (struct eblob_dedup_chunk_ref *)(m + 1);
+	for (pos = 0; pos < size; pos += refs[num++].size)
+		refs[num].size = blob_dedup_chunk_end(d, data + pos, size - pos);
+
+	for (i = 0, pos = 0; i < num; i += batch) {
+		batch = num - i;
+		if (batch > ARRAY_SIZE(hash))
+			batch = ARRAY_SIZE(hash);
+
+		for (j = 0; j < batch; ++j) {
+			buffers[j] = data + pos;
+			lens[j] = refs[i + j].size;
+			pos += lens[j];
+		}
+
+		sha512_buffers(NULL, 0, buffers, lens, batch, hash);
+
+		for (j = 0; j < batch; ++j)
+			memcpy(refs[i + j].key.id, hash[j], EBLOB_ID_SIZE);
+	}
+
+	m->size = size;
+	m->num = num;
+	*mp = m;
+	return 0;
+}
+
+/*
+ * References chunk @ref, it is stored with @data if it does not exist yet
+ */
+static int blob_dedup_chunk_get(struct eblob_dedup *d, const struct eblob_dedup_chunk_ref *ref, const void *data)
+{
+	struct eblob_backend *b = d->blob->eblob;
+	struct eblob_write_control wc = { .data_fd = -1 };
+	struct eblob_dedup_chunk_hdr hdr;
+	struct eblob_key key = ref->key;
+	pthread_mutex_t *lock = blob_dedup_lock(d->chunk_locks, &key);
+	int err;
+
+	pthread_mutex_lock(lock);
+
+	err = blob_lookup(b, &key, &wc);
+	if (!err) {
+		err = dnet_read_ll(wc.data_fd, (char *)&hdr, sizeof(hdr), wc.data_offset);
+		if (err)
+			goto err_out_unlock;
+
+		hdr.refs = dnet_bswap64(dnet_bswap64(hdr.refs) + 1);
+
+		const struct eblob_iovec iov[1] = {
+			{ .offset = 0, .size = sizeof(hdr), .base = &hdr },
+		};
+
+		err = eblob_plain_writev(b, &key, iov, 1, BLOB_DISK_CTL_NOCSUM);
+		if (!err) {
+			__sync_add_and_fetch(&d->stat.chunks_shared, 1);
+			__sync_add_and_fetch(&d->stat.shared_bytes, ref->size);
+		}
+	} else if (err == -ENOENT) {
+		hdr.refs = dnet_bswap64(1);
+
+		/* chunk is verified against its key, so eblob does not checksum it */
+		const struct eblob_iovec iov[2] = {
+			{ .offset = 0, .size = sizeof(hdr), .base = &hdr },
+			{ .offset = sizeof(hdr), .size = ref->size, .base = (void *)data },
+		};
+
+		err = eblob_writev_return(b, &key, iov, 2, BLOB_DISK_CTL_NOCSUM, &wc);
+		if (!err) {
+			__sync_add_and_fetch(&d->stat.chunks_stored, 1);
+			__sync_add_and_fetch(&d->stat.stored_bytes, ref->size);
+		}
+	}
+
+err_out_unlock:
+	pthread_mutex_unlock(lock);
+
+	if (err) {
+		dnet_backend_log(d->blob->blog, DNET_LOG_ERROR, "%s: EBLOB: dedup: could not reference chunk: %d: %s",
+				dnet_dump_id_str(key.id), err, strerror(-err));
+	}
+	return err;
+}
+
+/*
+ * Drops reference of chunk @key, chunk is removed along with the last one
+ */
+static void blob_dedup_chunk_put(struct eblob_dedup *d, const struct eblob_key *ckey)
+{
+	struct eblob_backend *b = d->blob->eblob;
+	struct eblob_write_control wc = { .data_fd = -1 };
+	struct eblob_dedup_chunk_hdr hdr;
+	struct eblob_key key = *ckey;
+	pthread_mutex_t *lock = blob_dedup_lock(d->chunk_locks, &key);
+	uint64_t refs;
+	int err;
+
+	pthread_mutex_lock(lock);
+
+	err = blob_lookup(b, &key, &wc);
+	if (err)
+		goto err_out_unlock;
+
+	err = dnet_read_ll(wc.data_fd, (char *)&hdr, sizeof(hdr), wc.data_offset);
+	if (err)
+		goto err_out_unlock;
+
+	refs = dnet_bswap64(hdr.refs);
+	if (refs <= 1) {
+		err = eblob_remove(b, &key);
+		if (!err)
+			__sync_add_and_fetch(&d->stat.chunks_removed, 1);
+	} else {
+		hdr.refs = dnet_bswap64(refs - 1);
+
+		const struct eblob_iovec iov[1] = {
+			{ .offset = 0, .size = sizeof(hdr), .base = &hdr },
+		};
+
+		err = eblob_plain_writev(b, &key, iov, 1, BLOB_DISK_CTL_NOCSUM);
+	}
+
+err_out_unlock:
+	pthread_mutex_unlock(lock);
+
+	/* reference is leaked, chunk stays on disk */
+	if (err) {
+		dnet_backend_log(d->blob->blog, DNET_LOG_ERROR, "%s: EBLOB: dedup: could not release chunk: %d: %s",
+				dnet_dump_id_str(key.id), err, strerror(-err));
+	}
+}
+
+static void blob_dedup_release(struct eblob_dedup *d, const struct eblob_dedup_manifest *m, uint64_t num)
+{
+	const struct eblob_dedup_chunk_ref *refs = (const struct eblob_dedup_chunk_ref *)(m + 1);
+	uint64_t i;
+
+	for (i = 0; i < num; ++i)
+		blob_dedup_chunk_put(d, &refs[i].key);
+}
+
+/*
+ * Reads manifest which takes @size bytes at @offset of @fd and checks that it is consistent
+ */
+static int blob_dedup_manifest_load(struct eblob_backend_config *c, int fd, uint64_t offset, uint64_t size,
+		struct eblob_dedup_manifest **mp)
+{
+	static const uint64_t hsize = sizeof(struct eblob_dedup_manifest);
+	struct eblob_dedup_chunk_ref *refs;
+	struct eblob_dedup_manifest *m = NULL;
+	uint64_t num, total = 0, i;
+	int err;
+
+	if (size < hsize || (size - hsize) % sizeof(struct eblob_dedup_chunk_ref)) {
+		err = -EILSEQ;
+		goto err_out_exit;
+	}
+
+	m = malloc(size);
+	if (!m) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	err = dnet_read_ll(fd, (char *)m, size, offset);
+	if (err)
+		goto err_out_exit;
+
+	num = (size - hsize) / sizeof(struct eblob_dedup_chunk_ref);
+	blob_dedup_manifest_convert(m, num);
+
+	refs = (struct eblob_dedup_chunk_ref *)(m + 1);
+	for (i = 0; i < num; ++i)
+		total += refs[i].size;
+
+	if (m->num != num || m->size != total) {
+		err = -EILSEQ;
+		goto err_out_exit;
+	}
+
+	*mp = m;
+	return 0;
+
+err_out_exit:
+	if (err == -EILSEQ) {
+		__sync_add_and_fetch(&c->dedup->stat.read_errors, 1);
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "EBLOB: dedup: corrupted manifest: fd: %d, "
+				"offset: %" PRIu64 ", size: %" PRIu64, fd, offset, size);
+	}
+	free(m);
+	return err;
+}
+
+/*
+ * Reads manifest of the current version of record @key, *@mp is set to NULL if record is not deduplicated.
+ * Must be called with lock of the key held, returns lookup error if record does not exist.
+ */
+static int blob_dedup_manifest_read(struct eblob_backend_config *c, struct eblob_key *key,
+		struct eblob_dedup_manifest **mp)
+{
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	struct eblob_write_control wc;
+	struct dnet_ext_list_hdr ehdr;
+	int err;
+
+	*mp = NULL;
+
+	err = blob_lookup_hdr(c, key, &wc, &ehdr);
+	if (err < 0)
+		return err;
+
+	if (!(wc.flags & BLOB_DISK_CTL_EXTHDR) || wc.total_data_size < ehdr_size || !ehdr.dedup)
+		return 0;
+
+	return blob_dedup_manifest_load(c, wc.data_fd, wc.data_offset + ehdr_size, wc.total_data_size - ehdr_size, mp);
+}
+
+/*
+ * Writes @size bytes of @data as deduplicated record @key, its ext header is made of @elist.
+ * On success @wc describes the record and *@stored is set to the size of its manifest.
+ */
+static int blob_dedup_store(struct eblob_backend_config *c, struct eblob_key *key, const void *data, uint64_t size,
+		struct dnet_ext_list *elist, uint64_t flags, struct eblob_write_control *wc, uint64_t *stored)
+{
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	struct eblob_dedup *d = c->dedup;
+	struct eblob_dedup_chunk_ref *refs;
+	struct eblob_dedup_manifest *m;
+	struct dnet_ext_list_hdr ehdr;
+	uint64_t num, msize, pos = 0, i;
+	int err;
+
+	err = blob_dedup_split(d, data, size, &m);
+	if (err)
+		return err;
+
+	num = m->num;
+	msize = sizeof(struct eblob_dedup_manifest) + num * sizeof(struct eblob_dedup_chunk_ref);
+	refs = (struct eblob_dedup_chunk_ref *)(m + 1);
+
+	for (i = 0; i < num; ++i) {
+		err = blob_dedup_chunk_get(d, &refs[i], data + pos);
+		if (err) {
+			m->num = i;
+			goto err_out_release;
+		}
+		pos += refs[i].size;
+	}
+
+	elist->dedup = 1;
+	dnet_ext_list_to_hdr(elist, &ehdr);
+
+	blob_dedup_manifest_convert(m, num);
+
+	const struct eblob_iovec iov[2] = {
+		{ .offset = 0, .size = ehdr_size, .base = &ehdr },
+		{ .offset = ehdr_size, .size = msize, .base = m },
+	};
+
+	err = eblob_writev_return(c->eblob, key, iov, 2, flags, wc);
+	blob_dedup_manifest_convert(m, num);
+	if (err)
+		goto err_out_release;
+
+	__sync_add_and_fetch(&d->stat.records, 1);
+	__sync_add_and_fetch(&d->stat.input_bytes, size);
+
+	*stored = msize;
+	free(m);
+	return 0;
+
+err_out_release:
+	blob_dedup_release(d, m, m->num);
+	free(m);
+	return err;
+}
+
+static int blob_write(struct eblob_backend_config *c, void *state,
+		struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_ext_list elist;
+	struct dnet_io_attr *io = data;
+	struct eblob_backend *b = c->eblob;
+	struct eblob_write_control wc = { .data_fd = -1 };
+	struct eblob_key key;
+	struct dnet_ext_list_hdr ehdr;
+	struct eblob_dedup_manifest *replaced = NULL;
+	pthread_mutex_t *key_lock = NULL;
+	uint64_t flags = BLOB_DISK_CTL_EXTHDR;
+	uint64_t fd_offset, size;
+	void *compressed = NULL;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	int dedup = 0;
+	int err;
+
+	dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: WRITE: start: %s",
+		dnet_dump_id_str(io->id), dnet_print_io(io));
+
+	dnet_convert_io_attr(io);
+
+	memcpy(key.id, io->id, EBLOB_ID_SIZE);
+
+	dnet_ext_list_init(&elist);
+	dnet_ext_io_to_list(io, &elist);
+	elist.csum_type = c->checksum_type;
+
+	/* records of a TTL bucket never outlive it */
+	if (c->ttl_bucket_end) {
+		elist.expire = c->ttl_bucket_end;
+		if (io->start && time(NULL) + io->start < (uint64_t)c->ttl_bucket_end)
+			elist.expire = time(NULL) + io->start;
+	}
+
+	data += sizeof(struct dnet_io_attr);
+	size = io->size;
+
+	/*
+	 * Chunks of the manifest replaced by this write are released once the write has succeeded,
+	 * deduplicated record can not be updated in place, but it can be rewritten or prepared anew
+	 */
+	if (c->dedup) {
+		key_lock = blob_dedup_lock(c->dedup->key_locks, &key);
+		pthread_mutex_lock(key_lock);
+
+		err = blob_dedup_manifest_read(c, &key, &replaced);
+		if (err == -ENOENT)
+			err = 0;
+		if (err)
+			goto err_out_exit;
+
+		if (replaced && !blob_write_whole(io) && !(io->flags & DNET_IO_FLAGS_PREPARE)) {
+			__sync_add_and_fetch(&c->dedup->stat.rejected_writes, 1);
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: deduplicated record "
+					"can only be rewritten as a whole: %s", dnet_dump_id_str(io->id), dnet_print_io(io));
+			err = -ENOTSUP;
+			goto err_out_exit;
+		}
+
+		dedup = c->dedup_threshold && io->size >= c->dedup_threshold && blob_write_whole(io) &&
+			!(io->flags & DNET_IO_FLAGS_COMPRESSED);
+	}
+
+	if (!dedup) {
+		err = blob_write_compress(c, io, &elist, &data, &size, &compressed);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: compression: %d: %s",
+				dnet_dump_id_str(io->id), err, strerror(-err));
+			goto err_out_exit;
+		}
+	}
+
+	dnet_ext_list_to_hdr(&elist, &ehdr);
+
+	if (io->flags & DNET_IO_FLAGS_APPEND)
+		flags |= BLOB_DISK_CTL_APPEND;
+
+	if (io->flags & DNET_IO_FLAGS_NOCSUM)
+		flags |= BLOB_DISK_CTL_NOCSUM;
+
+	if (dedup) {
+		err = blob_dedup_store(c, &key, data, io->size, &elist, flags, &wc, &size);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: dedup: %d: %s",
+				dnet_dump_id_str(io->id), err, strerror(-err));
+			goto err_out_exit;
+		}
+
+		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: dedup: Ok: "
+				"size: %" PRIu64 ", manifest-size: %" PRIu64 ".",
+				dnet_dump_id_str(io->id), io->size, size);
+	}
+
+	if (io->flags & DNET_IO_FLAGS_PREPARE) {
+		/*
+		 * We have to put ext header flag into prepare command, since otherwise
+		 * we can not overwrite data later with this flag.
+		 *
+		 * Eblob correctly believes that existing on-disk record without ext header
+		 * (this will be the case after prepare has been completed) can not be
+		 * overwritten with chunk containing ext-header.
+		 *
+		 * Setting this flag opens a window for race with iterator.
+		 * Iterator will see the record with ext header bit set,
+		 * but without actual data.
+		 *
+		 * XXX Alternative way is to fix eblob not to check ext header flag if uncommitted bit is set.
+		 * XXX See eblob_plain_writev_prepare() and ext header check.
+		 */
+		err = eblob_write_prepare(b, &key, io->num + ehdr_size, flags);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_write_prepare: "
+					"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
+					io->num + ehdr_size, strerror(-err), err);
+			goto err_out_exit;
+		}
+
+		const struct eblob_iovec iov[1] = {
+			{ .offset = 0, .size = ehdr_size, .base = &ehdr },
+		};
+
+		err = eblob_plain_writev(b, &key, iov, 1, flags);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR,
+				"%s: EBLOB: blob-write: eblob_plain_writev: header WRITE: %d: %s",
+				dnet_dump_id_str(io->id), err, strerror(-err));
+			goto err_out_exit;
+		}
+
+		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: eblob_write_prepare: "
+				"size: %" PRIu64 ": Ok", dnet_dump_id_str(io->id), io->num + ehdr_size);
+	}
+
+	if (size && !dedup) {
+		/*
+		 * Although we have already filled ext header above (at prepare time),
+		 * we update it each time chunk has been written to change timestamp and user flags.
+		 */
+		const struct eblob_iovec iov[2] = {
+			{ .offset = 0, .size = ehdr_size, .base = &ehdr },
+			{ .offset = ehdr_size + io->offset, .size = size, .base = data },
+		};
+
+		if (io->flags & DNET_IO_FLAGS_PLAIN_WRITE) {
+			err = eblob_plain_writev(b, &key, iov, 2, flags);
+		} else {
+			err = eblob_writev_return(b, &key, iov, 2, flags, &wc);
+		}
+
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: WRITE: %d: %s",
+				dnet_dump_id_str(io->id), err, strerror(-err));
+			goto err_out_exit;
+		}
+
+		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: WRITE: Ok: "
+				"offset: %" PRIu64 ", size: %" PRIu64 ", stored-size: %" PRIu64 ".",
+				dnet_dump_id_str(io->id), io->offset, io->size, size);
+	}
+
+	if (io->flags & DNET_IO_FLAGS_COMMIT) {
+		/*
+		 * If io->size is not zero, ext header has been written above.
+		 */
+		if (io->size == 0) {
+			const struct eblob_iovec iov[1] = {
+				{ .offset = 0, .size = ehdr_size, .base = &ehdr },
+			};
+
+			err = eblob_plain_writev(b, &key, iov, 1, flags);
+			if (err) {
+				dnet_backend_log(c->blog, DNET_LOG_ERROR,
+					"%s: EBLOB: blob-write: eblob_plain_writev: commit WRITE: %d: %s",
+					dnet_dump_id_str(io->id), err, strerror(-err));
+				goto err_out_exit;
+			}
+		}
+
+		if (io->flags & DNET_IO_FLAGS_PLAIN_WRITE) {
+			uint64_t csize = io->num + ehdr_size;
+			if (io->flags & DNET_IO_FLAGS_PREPARE) {
+				// client has set PREPARE, PLAIN_WRITE and COMMIT flags,
+				// there is no way he could write more data than io->size,
+				// thus it is an error to commit more than io->size + io->offset,
+				// otherwise it will commit empty (zeroed) space (io->num) as data
+				//
+				// this set of flags is used to reserve disk (not data) space for future updates
+				csize = io->size + io->offset + ehdr_size;
+			}
+			err = eblob_write_commit(b, &key, csize, flags);
+			if (err) {
+				dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_write_commit: "
+						"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
+						csize, strerror(-err), err);
+				goto err_out_exit;
+			}
+
+			dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write: eblob_write_commit: "
+					"size: %" PRIu64 ": Ok", dnet_dump_id_str(io->id), csize);
+		}
+	}
+
+	/* before reply is sent, so that reads which follow it do not get stale lookup */
+	blob_key_modified(c, &key);
+
+	if (!err && wc.data_fd == -1) {
+		err = eblob_read_return(b, &key, EBLOB_READ_NOCSUM, &wc);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: eblob_read: "
+					"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
+					io->num, strerror(-err), err);
+			goto err_out_exit;
+		}
+	}
+
+	/* write is acked only after it is durable, bulk write acks its keys after they are synced together */
+	if (c->group_commit_enabled && !blob_bulk_commit_defer(c, wc.data_fd, wc.index_fd, size + ehdr_size)) {
+		int fds[2] = { wc.data_fd, wc.index_fd };
+
+		err = blob_group_commit_wait(c, fds, 2, size + ehdr_size);
+		if (err)
+			goto err_out_exit;
+	}
+
+	if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO) {
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+		err = 0;
+		goto err_out_exit;
+	}
+
+	fd_offset = wc.ctl_data_offset + sizeof(struct eblob_disk_control);
+	if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
+		fd_offset += ehdr_size;
+		if (wc.size) {
+			wc.size -= ehdr_size;
+		}
+	}
+
+	err = blob_send_file_info(c, state, cmd, wc.data_fd, fd_offset, wc.size, &elist.timestamp, wc.flags);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write: dnet_send_file_info: "
+				"fd: %d, offset: %" PRIu64 ", offset-within-fd: %" PRIu64 ", size: %" PRIu64 ": %s %d",
+				dnet_dump_id_str(io->id), wc.data_fd, wc.offset, fd_offset, wc.size,
+				strerror(-err), err);
+		goto err_out_exit;
+	}
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "%s: EBLOB: blob-write: fd: %d, offset: %" PRIu64
+			", offset-within-fd: %" PRIu64 ", size: %" PRIu64 "",
+			dnet_dump_id_str(io->id), wc.data_fd, wc.offset, fd_offset, wc.size);
+
+err_out_exit:
+	/* failed write may have modified the record too */
+	if (err)
+		blob_key_modified(c, &key);
+	if (replaced) {
+		if (!err)
+			blob_dedup_release(c->dedup, replaced, replaced->num);
+		free(replaced);
+	}
+	if (key_lock)
+		pthread_mutex_unlock(key_lock);
+	free(compressed);
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+/*
+ * Removes record @key, chunks of deduplicated record are released once it has been removed.
+ * Chunks of the record whose manifest can not be read are leaked.
+ */
+static int blob_remove(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_dedup_manifest *m = NULL;
+	pthread_mutex_t *key_lock = NULL;
+	int err;
+
+	if (c->dedup) {
+		key_lock = blob_dedup_lock(c->dedup->key_locks, key);
+		pthread_mutex_lock(key_lock);
+
+		blob_dedup_manifest_read(c, key, &m);
+	}
+
+	err = eblob_remove(c->eblob, key);
+	blob_key_modified(c, key);
+
+	if (!err && m)
+		blob_dedup_release(c->dedup, m, m->num);
+
+	free(m);
+	if (key_lock)
+		pthread_mutex_unlock(key_lock);
+	return err;
+}
+
+/*
+ * Size of parts large records are verified and sent by, eblob checksums records by 1 MiB chunks,
+ * so every part covers several of them
+ */
+#define EBLOB_BACKEND_VERIFY_CHUNK_SIZE		(8 * 1024 * 1024)
+
+/*
+ * Once a key is read by consecutive chunks, data up to this size after the current chunk
+ * is asked to be read into page cache, so the next chunks are served without waiting for disk
+ */
+#define EBLOB_BACKEND_READ_AHEAD_WINDOW		(16 * 1024 * 1024)
+
+static void blob_read_ahead(struct eblob_backend_config *c, struct eblob_key *key,
+		int fd, uint64_t offset, uint64_t size, uint64_t record_end)
+{
+	struct eblob_read_ahead *ra;
+	uint64_t start = 0, end = 0;
+
+	ra = &c->read_ahead[(key->id[0] | key->id[1] << 8) % EBLOB_READ_AHEAD_SLOTS];
+
+	pthread_mutex_lock(&c->last_read_lock);
+	if (ra->fd == fd && !memcmp(&ra->key, key, sizeof(struct eblob_key)) && ra->next_offset == offset) {
+		ra->sequential++;
+	} else {
+		memcpy(&ra->key, key, sizeof(struct eblob_key));
+		ra->fd = fd;
+		ra->sequential = 0;
+		ra->end_offset = 0;
+	}
+	ra->next_offset = offset + size;
+
+	/* window is moved by halves, so that every chunk does not issue its own fadvise */
+	if (ra->sequential && ra->end_offset < record_end &&
+			ra->end_offset < offset + size + EBLOB_BACKEND_READ_AHEAD_WINDOW / 2) {
+		start = ra->end_offset > offset + size ? ra->end_offset : offset + size;
+		end = offset + size + EBLOB_BACKEND_READ_AHEAD_WINDOW;
+		if (end > record_end)
+			end = record_end;
+		ra->end_offset = end;
+	}
+	pthread_mutex_unlock(&c->last_read_lock);
+
+	if (end > start)
+		posix_fadvise(fd, start, end - start, POSIX_FADV_WILLNEED);
+}
+
+/*
+ * Direct reads bypass page cache: data is read by pieces with O_DIRECT into aligned buffers
+ * and every piece is sent as soon as it has been read.
+ * Buffers are shared by all backends and are never freed while they are in use by others,
+ * up to @EBLOB_DIRECT_IO_BUFFERS of them are kept, readers wait for a free one when all are in flight.
+ */
+#define EBLOB_DIRECT_IO_PIECE_SIZE	(1024 * 1024)
+#define EBLOB_DIRECT_IO_ALIGN		4096
+#define EBLOB_DIRECT_IO_BUFFER_SIZE	(EBLOB_DIRECT_IO_PIECE_SIZE + 2 * EBLOB_DIRECT_IO_ALIGN)
+#define EBLOB_DIRECT_IO_BUFFERS		64
+/* reader which could not get a buffer for this long allocates a new one above the limit */
+#define EBLOB_DIRECT_IO_WAIT_MS		100
+
+struct blob_direct_buffer {
+	struct blob_direct_buffer	*next;
+	void				*data;
+};
+
+static struct {
+	pthread_mutex_t			lock;
+	pthread_cond_t			wait;
+	struct blob_direct_buffer	*free_list;
+	int				free_num;
+	int				total_num;
+} blob_direct_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wait = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Thread which can not wait, i.e. io_uring completion thread, does not wait for a free buffer
+ * and allocates it above the limit right away
+ */
+static struct blob_direct_buffer *blob_direct_buffer_get(int wait)
+{
+	struct blob_direct_buffer *buf = NULL;
+	struct timespec deadline;
+	int err = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_nsec += EBLOB_DIRECT_IO_WAIT_MS * 1000000;
+	deadline.tv_sec += deadline.tv_nsec / 1000000000;
+	deadline.tv_nsec %= 1000000000;
+
+	pthread_mutex_lock(&blob_direct_pool.lock);
+	while (wait && !blob_direct_pool.free_list && blob_direct_pool.total_num >= EBLOB_DIRECT_IO_BUFFERS &&
+			err != ETIMEDOUT)
+		err = pthread_cond_timedwait(&blob_direct_pool.wait, &blob_direct_pool.lock, &deadline);
+
+	if (blob_direct_pool.free_list) {
+		buf = blob_direct_pool.free_list;
+		blob_direct_pool.free_list = buf->next;
+		blob_direct_pool.free_num--;
+		pthread_mutex_unlock(&blob_direct_pool.lock);
+		return buf;
+	}
+
+	blob_direct_pool.total_num++;
+	pthread_mutex_unlock(&blob_direct_pool.lock);
+
+	buf = malloc(sizeof(struct blob_direct_buffer));
+	if (buf && posix_memalign(&buf->data, EBLOB_DIRECT_IO_ALIGN, EBLOB_DIRECT_IO_BUFFER_SIZE)) {
+		free(buf);
+		buf = NULL;
+	}
+
+	if (!buf) {
+		pthread_mutex_lock(&blob_direct_pool.lock);
+		blob_direct_pool.total_num--;
+		pthread_mutex_unlock(&blob_direct_pool.lock);
+	}
+
+	return buf;
+}
+
+static void blob_direct_buffer_put(void *priv)
+{
+	struct blob_direct_buffer *buf = priv;
+
+	pthread_mutex_lock(&blob_direct_pool.lock);
+	if (blob_direct_pool.total_num > EBLOB_DIRECT_IO_BUFFERS) {
+		/* allocated above the limit by a reader which could not wait */
+		blob_direct_pool.total_num--;
+		pthread_mutex_unlock(&blob_direct_pool.lock);
+
+		free(buf->data);
+		free(buf);
+		return;
+	}
+
+	buf->next = blob_direct_pool.free_list;
+	blob_direct_pool.free_list = buf;
+	blob_direct_pool.free_num++;
+	pthread_cond_signal(&blob_direct_pool.wait);
+	pthread_mutex_unlock(&blob_direct_pool.lock);
+}
+
+struct blob_direct_read {
+	int				fd;
+	uint64_t			offset;
+};
+
+static int blob_direct_read_piece(void *priv, uint64_t piece_offset, uint64_t piece_size,
+		void **data, void (**release)(void *release_priv), void **release_priv)
+{
+	struct blob_direct_read *r = priv;
+	struct blob_direct_buffer *buf;
+	uint64_t start = r->offset + piece_offset;
+	uint64_t aligned_start = start & ~(uint64_t)(EBLOB_DIRECT_IO_ALIGN - 1);
+	uint64_t need = start + piece_size - aligned_start;
+	uint64_t aligned_size = (need + EBLOB_DIRECT_IO_ALIGN - 1) & ~(uint64_t)(EBLOB_DIRECT_IO_ALIGN - 1);
+	uint64_t done = 0;
+	ssize_t n;
+
+	if (aligned_size > EBLOB_DIRECT_IO_BUFFER_SIZE)
+		return -EINVAL;
+
+	buf = blob_direct_buffer_get(1);
+	if (!buf)
+		return -ENOMEM;
+
+	while (done < need) {
+		n = pread(r->fd, buf->data + done, aligned_size - done, aligned_start + done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			n = -errno;
+			blob_direct_buffer_put(buf);
+			return n;
+		}
+
+		/* blob file ends before the record */
+		if (n == 0) {
+			blob_direct_buffer_put(buf);
+			return -ESPIPE;
+		}
+
+		done += n;
+	}
+
+	*data = buf->data + (start - aligned_start);
+	*release = blob_direct_buffer_put;
+	*release_priv = buf;
+	return 0;
+}
+
+/*
+ * Blob files are opened by eblob without O_DIRECT, so direct reads go through their own descriptor
+ */
+static int blob_direct_open(struct eblob_backend_config *c, struct dnet_io_attr *io, int fd)
+{
+	char path[64];
+	int dfd;
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	dfd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (dfd < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-read: direct: could not reopen fd: %d: %s %d",
+				dnet_dump_id_str(io->id), fd, strerror(errno), -errno);
+	}
+
+	return dfd;
+}
+
+/*
+ * Asynchronous direct reads: io thread queues held reply pieces, submits reads of the first
+ * @EBLOB_ASYNC_READ_SLOTS pieces to the ring and returns. Every completed piece is released
+ * to the network by the ring's thread, which submits read of the next piece into the same slot,
+ * so pieces may be filled out of order. The last finished slot completes the command.
+ */
+#define EBLOB_ASYNC_READ_SLOTS		4
+
+struct blob_async_read;
+
+struct blob_async_slot {
+	struct dnet_uring_op		op;
+	struct blob_async_read		*r;
+	struct blob_direct_buffer	*buf;
+	int				index;
+	/* piece position in the blob, it is read by aligned blocks */
+	uint64_t			start;
+	uint64_t			size;
+	uint64_t			aligned_start;
+	uint64_t			aligned_size;
+	uint64_t			need;
+	uint64_t			done;
+};
+
+struct blob_async_read {
+	struct eblob_backend_config	*c;
+	struct dnet_async_cmd		*ac;
+	struct dnet_send_pieces		*pieces;
+	int				fd;
+	uint64_t			offset;
+	uint64_t			size;
+
+	pthread_mutex_t			lock;
+	int				num;
+	int				next;
+	/* one reference per active slot and one of the submitter */
+	int				refs;
+	int				err;
+
+	struct blob_async_slot		slots[EBLOB_ASYNC_READ_SLOTS];
+};
+
+static void blob_async_read_put(struct blob_async_read *r, int err)
+{
+	int last;
+
+	pthread_mutex_lock(&r->lock);
+	if (err && !r->err)
+		r->err = err;
+	last = --r->refs == 0;
+	pthread_mutex_unlock(&r->lock);
+
+	if (!last)
+		return;
+
+	err = dnet_send_pieces_complete(r->pieces, r->err);
+	if (err) {
+		dnet_backend_log(r->c->blog, DNET_LOG_ERROR, "EBLOB: blob-read: async: fd: %d, offset: %" PRIu64
+				", size: %" PRIu64 ": %s %d", r->fd, r->offset, r->size, strerror(-err), err);
+	}
+
+	close(r->fd);
+	dnet_async_cmd_complete(r->ac, err);
+
+	pthread_mutex_destroy(&r->lock);
+	free(r);
+}
+
+/*
+ * Assigns the next unread piece to the slot, returns 0 if there is nothing to read
+ */
+static int blob_async_slot_next(struct blob_async_slot *s, int wait)
+{
+	struct blob_async_read *r = s->r;
+	int index;
+
+	pthread_mutex_lock(&r->lock);
+	index = (r->err || r->next >= r->num) ? -1 : r->next++;
+	pthread_mutex_unlock(&r->lock);
+
+	if (index < 0)
+		return 0;
+
+	s->index = index;
+	s->start = r->offset + (uint64_t)index * EBLOB_DIRECT_IO_PIECE_SIZE;
+	s->size = r->size - (uint64_t)index * EBLOB_DIRECT_IO_PIECE_SIZE;
+	if (s->size > EBLOB_DIRECT_IO_PIECE_SIZE)
+		s->size = EBLOB_DIRECT_IO_PIECE_SIZE;
+
+	s->aligned_start = s->start & ~(uint64_t)(EBLOB_DIRECT_IO_ALIGN - 1);
+	s->need = s->start + s->size - s->aligned_start;
+	s->aligned_size = (s->need + EBLOB_DIRECT_IO_ALIGN - 1) & ~(uint64_t)(EBLOB_DIRECT_IO_ALIGN - 1);
+	s->done = 0;
+
+	s->buf = blob_direct_buffer_get(wait);
+	if (!s->buf)
+		return -ENOMEM;
+
+	return 1;
+}
+
+/*
+ * Handles result @res of the slot's previous read if @have_res is set and submits the next one.
+ * Completion thread can not wait for the ring, so if it is full the read is done synchronously.
+ */
+static void blob_async_slot_run(struct blob_async_slot *s, int have_res, int res, int wait)
+{
+	struct blob_async_read *r = s->r;
+	int err;
+
+	for (;;) {
+		if (have_res) {
+			if (res < 0) {
+				err = res;
+				goto err_out_put;
+			}
+
+			/* blob file ends before the record */
+			if (res == 0) {
+				err = -ESPIPE;
+				goto err_out_put;
+			}
+
+			s->done += res;
+			if (s->done >= s->need) {
+				dnet_send_pieces_release(r->pieces, s->index, s->buf->data + (s->start - s->aligned_start),
+						s->size, blob_direct_buffer_put, s->buf);
+				s->buf = NULL;
+
+				err = blob_async_slot_next(s, wait);
+				if (err <= 0)
+					goto err_out_put;
+			}
+		}
+
+		err = dnet_uring_read(r->c->uring, &s->op, r->fd, s->buf->data + s->done, s->aligned_size - s->done,
+				s->aligned_start + s->done, wait);
+		if (!err)
+			return;
+
+		if (err != -EAGAIN)
+			goto err_out_put;
+
+		do {
+			res = pread(r->fd, s->buf->data + s->done, s->aligned_size - s->done, s->aligned_start + s->done);
+		} while (res < 0 && errno == EINTR);
+
+		if (res < 0)
+			res = -errno;
+		have_res = 1;
+	}
+
+err_out_put:
+	if (s->buf) {
+		blob_direct_buffer_put(s->buf);
+		s->buf = NULL;
+	}
+	blob_async_read_put(r, err);
+}
+
+static void blob_async_slot_complete(struct dnet_uring_op *op, int res)
+{
+	struct blob_async_slot *s = (struct blob_async_slot *)op;
+
+	blob_async_slot_run(s, 1, res, 0);
+}
+
+/*
+ * Returns 0 if read has been started, it completes the command itself, positive value if asynchronous
+ * reading is not possible and data has to be sent the usual way
+ */
+static int blob_async_read_send(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, int fd, uint64_t offset)
+{
+	struct blob_async_read *r;
+	struct blob_async_slot *s;
+	int i, err;
+
+	r = calloc(1, sizeof(struct blob_async_read));
+	if (!r)
+		return 1;
+
+	r->fd = blob_direct_open(c, io, fd);
+	if (r->fd < 0) {
+		err = 1;
+		goto err_out_free;
+	}
+
+	err = pthread_mutex_init(&r->lock, NULL);
+	if (err) {
+		err = 1;
+		goto err_out_close;
+	}
+
+	r->pieces = dnet_send_read_data_pieces_queue(state, cmd, io, EBLOB_DIRECT_IO_PIECE_SIZE, &err);
+	if (!r->pieces)
+		goto err_out_destroy;
+
+	r->ac = dnet_async_cmd_start(state, cmd);
+	if (!r->ac) {
+		err = dnet_send_pieces_complete(r->pieces, -ENOMEM);
+		goto err_out_destroy;
+	}
+
+	r->c = c;
+	r->offset = offset;
+	r->size = io->size;
+	r->num = (io->size + EBLOB_DIRECT_IO_PIECE_SIZE - 1) / EBLOB_DIRECT_IO_PIECE_SIZE;
+	r->refs = 1;
+
+	/* command is completed by the last slot, io thread must not send ack */
+	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	for (i = 0; i < EBLOB_ASYNC_READ_SLOTS && i < r->num; ++i) {
+		s = &r->slots[i];
+		s->op.complete = blob_async_slot_complete;
+		s->r = r;
+
+		pthread_mutex_lock(&r->lock);
+		r->refs++;
+		pthread_mutex_unlock(&r->lock);
+
+		err = blob_async_slot_next(s, 1);
+		if (err <= 0) {
+			blob_async_read_put(r, err);
+			break;
+		}
+
+		blob_async_slot_run(s, 0, 0, 1);
+	}
+
+	blob_async_read_put(r, 0);
+	return 0;
+
+err_out_destroy:
+	pthread_mutex_destroy(&r->lock);
+err_out_close:
+	close(r->fd);
+err_out_free:
+	free(r);
+	return err;
+}
+
+/*
+ * Returns 0 if reply has been sent by direct reads, positive value if direct reading is not possible
+ * and data has to be sent the usual way
+ */
+static int blob_direct_read_send(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, int fd, uint64_t offset)
+{
+	struct blob_direct_read r;
+	int err;
+
+	r.fd = blob_direct_open(c, io, fd);
+	if (r.fd < 0)
+		return 1;
+	r.offset = offset;
+
+	err = dnet_send_read_data_pieces(state, cmd, io, EBLOB_DIRECT_IO_PIECE_SIZE, blob_direct_read_piece, &r);
+
+	/* pieces reference only pool buffers, the file can be closed right after they have been read */
+	close(r.fd);
+	return err;
+}
+
+/*
+ * Mapped reads: small records are sent by reference into read-only shared mapping of the whole blob data file,
+ * so there is neither pread nor sendfile of the data. Every reply holds a reference to its mapping,
+ * mapping is unmapped when it is dropped from the table and the last reply has been sent.
+ *
+ * Blob which is being written grows, its record which is beyond the mapping causes remap
+ * not more often than once per @EBLOB_MMAP_REMAP_MS, until then such records are sent the usual way.
+ * Mappings are dropped when defragmentation is started or seen running and when their file has been unlinked,
+ * otherwise they would keep removed blobs on disk.
+ */
+#define EBLOB_MMAP_REMAP_MS		1000
+
+struct eblob_mmap_file {
+	struct eblob_mmap_file		*next;
+	dev_t				dev;
+	ino_t				ino;
+	void				*data;
+	uint64_t			size;
+	uint64_t			mapped;		/* msecs of monotonic clock */
+	/* one reference is held by the table, others by replies */
+	atomic_t			refcnt;
+};
+
+static void blob_mmap_put(void *priv)
+{
+	struct eblob_mmap_file *m = priv;
+
+	if (atomic_dec_and_test(&m->refcnt)) {
+		munmap(m->data, m->size);
+		free(m);
+	}
+}
+
+static struct eblob_mmap_file **blob_mmap_bucket(struct eblob_backend_config *c, dev_t dev, ino_t ino)
+{
+	return &c->mmap_files[((uint64_t)dev * 31 + (uint64_t)ino) % EBLOB_MMAP_BUCKETS];
+}
+
+/*
+ * Must be called with @mmap_lock held, returns mapping removed from the table, its reference is owned by caller
+ */
+static struct eblob_mmap_file *blob_mmap_unlink_nolock(struct eblob_backend_config *c, dev_t dev, ino_t ino)
+{
+	struct eblob_mmap_file **pm, *m;
+
+	for (pm = blob_mmap_bucket(c, dev, ino); (m = *pm) != NULL; pm = &m->next) {
+		if (m->dev == dev && m->ino == ino) {
+			*pm = m->next;
+			return m;
+		}
+	}
+
+	return NULL;
+}
+
+static void blob_mmap_clear(struct eblob_backend_config *c)
+{
+	struct eblob_mmap_file *list[EBLOB_MMAP_BUCKETS], *m;
+	int i;
+
+	if (!c->mmap_read_threshold)
+		return;
+
+	pthread_mutex_lock(&c->mmap_lock);
+	for (i = 0; i < EBLOB_MMAP_BUCKETS; ++i) {
+		list[i] = c->mmap_files[i];
+		c->mmap_files[i] = NULL;
+	}
+	pthread_mutex_unlock(&c->mmap_lock);
+
+	for (i = 0; i < EBLOB_MMAP_BUCKETS; ++i) {
+		while ((m = list[i]) != NULL) {
+			list[i] = m->next;
+			blob_mmap_put(m);
+		}
+	}
+}
+
+/*
+ * Returns referenced mapping of file @fd which covers its first @end bytes or NULL
+ */
+static struct eblob_mmap_file *blob_mmap_get(struct eblob_backend_config *c, int fd, struct stat *st, uint64_t end)
+{
+	struct eblob_mmap_file *m, *old = NULL;
+	uint64_t now = blob_lookup_cache_now();
+	void *data;
+
+	pthread_mutex_lock(&c->mmap_lock);
+	for (m = *blob_mmap_bucket(c, st->st_dev, st->st_ino); m; m = m->next) {
+		if (m->dev == st->st_dev && m->ino == st->st_ino)
+			break;
+	}
+
+	if (m && m->size >= end) {
+		atomic_inc(&m->refcnt);
+		pthread_mutex_unlock(&c->mmap_lock);
+		return m;
+	}
+
+	if (m && m->mapped + EBLOB_MMAP_REMAP_MS > now) {
+		pthread_mutex_unlock(&c->mmap_lock);
+		return NULL;
+	}
+	pthread_mutex_unlock(&c->mmap_lock);
+
+	if ((uint64_t)st->st_size < end)
+		return NULL;
+
+	data = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		dnet_backend_log(c->blog, DNET_LOG_NOTICE, "EBLOB: blob-read: mmap: could not map fd: %d, size: %llu: %s %d",
+				fd, (unsigned long long)st->st_size, strerror(errno), -errno);
+		return NULL;
+	}
+
+	m = malloc(sizeof(struct eblob_mmap_file));
+	if (!m) {
+		munmap(data, st->st_size);
+		return NULL;
+	}
+
+	m->dev = st->st_dev;
+	m->ino = st->st_ino;
+	m->data = data;
+	m->size = st->st_size;
+	m->mapped = now;
+	atomic_init(&m->refcnt, 2);
+
+	/* mapping made by other io thread meanwhile is replaced, it is not larger than this one */
+	pthread_mutex_lock(&c->mmap_lock);
+	old = blob_mmap_unlink_nolock(c, m->dev, m->ino);
+	m->next = *blob_mmap_bucket(c, m->dev, m->ino);
+	*blob_mmap_bucket(c, m->dev, m->ino) = m;
+	pthread_mutex_unlock(&c->mmap_lock);
+
+	if (old)
+		blob_mmap_put(old);
+
+	return m;
+}
+
+/*
+ * Returns referenced mapping of data file @fd which covers data at @offset of @size bytes or NULL
+ */
+static struct eblob_mmap_file *blob_mmap_data(struct eblob_backend_config *c, int fd, uint64_t offset, uint64_t size)
+{
+	struct eblob_mmap_file *m;
+	struct stat st;
+
+	if (eblob_defrag_status(c->eblob)) {
+		blob_mmap_clear(c);
+		return NULL;
+	}
+
+	if (fstat(fd, &st))
+		return NULL;
+
+	if (st.st_nlink == 0) {
+		pthread_mutex_lock(&c->mmap_lock);
+		m = blob_mmap_unlink_nolock(c, st.st_dev, st.st_ino);
+		pthread_mutex_unlock(&c->mmap_lock);
+
+		if (m)
+			blob_mmap_put(m);
+		return NULL;
+	}
+
+	return blob_mmap_get(c, fd, &st, offset + size);
+}
+
+/*
+ * Returns 0 if reply has been sent from the mapping, positive value if record has to be sent the usual way
+ */
+static int blob_mmap_read_send(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, int fd, uint64_t offset)
+{
+	struct eblob_mmap_file *m;
+
+	m = blob_mmap_data(c, fd, offset, io->size);
+	if (!m)
+		return 1;
+
+	/* reference is consumed even if sending fails */
+	return dnet_send_read_data_ref(state, cmd, io, m->data + offset, blob_mmap_put, m);
+}
+
+struct blob_read_verify {
+	struct eblob_backend		*b;
+	struct eblob_key		*key;
+	struct eblob_write_control	*wc;
+	uint64_t			record_offset;
+};
+
+static int blob_read_verify_chunk(void *priv, uint64_t chunk_offset, uint64_t chunk_size)
+{
+	struct blob_read_verify *v = priv;
+
+	v->wc->offset = v->record_offset + chunk_offset;
+	v->wc->size = chunk_size;
+	return eblob_verify_checksum(v->b, v->key, v->wc);
+}
+
+/*
+ * Compressed records are sent as is to clients which accept compressed data and read the whole record,
+ * otherwise they are verified, decompressed and the requested part of the original data is sent.
+ * @offset and @size describe stored data of the record.
+ */
+static int blob_read_compressed(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, struct eblob_key *key, struct eblob_write_control *wc,
+		uint64_t offset, uint64_t size, uint64_t record_offset, int last)
+{
+	struct dnet_buffer *buf;
+	uint64_t data_offset = 0;
+	int err;
+
+	if (!(io->flags & DNET_IO_FLAGS_NOCSUM)) {
+		wc->offset = record_offset;
+		wc->size = size;
+		err = eblob_verify_checksum(c->eblob, key, wc);
+		if (err)
+			return err;
+	}
+
+	io->record_flags = wc->flags | DNET_RECORD_FLAGS_COMPRESSED;
+
+	if ((io->flags & DNET_IO_FLAGS_COMPRESSED) && !io->offset && !io->size) {
+		dnet_backend_check_get_size(io, &offset, &size);
+		if (size && last)
+			cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+		__sync_add_and_fetch(&c->compression_stat.sent_compressed, 1);
+		return dnet_send_read_data(state, cmd, io, NULL, wc->data_fd, offset, 0);
+	}
+
+	io->flags &= ~DNET_IO_FLAGS_COMPRESSED;
+
+	err = blob_decompress(c, wc->data_fd, offset, size, &buf);
+	if (err)
+		return err;
+
+	size = buf->size;
+	err = dnet_backend_check_get_size(io, &data_offset, &size);
+	if (err) {
+		dnet_buffer_put(buf);
+		return err;
+	}
+
+	if (size && last)
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	/* reference is consumed even if sending fails */
+	return dnet_send_read_data_ref(state, cmd, io, buf->data + data_offset, dnet_buffer_put, buf);
+}
+
+/*
+ * Data of a chunk and reference which keeps it alive until it is sent or copied
+ */
+struct blob_dedup_piece {
+	void				*data;
+	uint64_t			size;
+	void				(*release)(void *priv);
+	void				*priv;
+};
+
+/*
+ * Chunk is taken right from the mapping of its data file, it is read into memory if file can not be mapped
+ */
+static int blob_dedup_chunk_map(struct eblob_dedup *d, const struct eblob_dedup_chunk_ref *ref,
+		struct blob_dedup_piece *piece)
+{
+	static const uint64_t hsize = sizeof(struct eblob_dedup_chunk_hdr);
+	struct eblob_write_control wc = { .data_fd = -1 };
+	struct eblob_key key = ref->key;
+	struct eblob_mmap_file *m;
+	struct dnet_buffer *buf;
+	int err;
+
+	err = blob_lookup(d->blob->eblob, &key, &wc);
+	if (err)
+		goto err_out_exit;
+
+	if (wc.total_data_size != hsize + ref->size) {
+		err = -EILSEQ;
+		goto err_out_exit;
+	}
+
+	piece->size = ref->size;
+
+	m = blob_mmap_data(d->blob, wc.data_fd, wc.data_offset + hsize, ref->size);
+	if (m) {
+		piece->data = m->data + wc.data_offset + hsize;
+		piece->release = blob_mmap_put;
+		piece->priv = m;
+		return 0;
+	}
+
+	buf = dnet_buffer_alloc(ref->size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	err = dnet_read_ll(wc.data_fd, buf->data, ref->size, wc.data_offset + hsize);
+	if (err) {
+		dnet_buffer_put(buf);
+		goto err_out_exit;
+	}
+
+	piece->data = buf->data;
+	piece->release = dnet_buffer_put;
+	piece->priv = buf;
+	return 0;
+
+err_out_exit:
+	__sync_add_and_fetch(&d->stat.read_errors, 1);
+	dnet_backend_log(d->blob->blog, DNET_LOG_ERROR, "%s: EBLOB: dedup: could not read chunk: %d: %s",
+			dnet_dump_id_str(key.id), err, strerror(-err));
+	return err;
+}
+
+static void blob_dedup_pieces_release(struct blob_dedup_piece *pieces, uint64_t num)
+{
+	uint64_t i;
+
+	for (i = 0; i < num; ++i)
+		pieces[i].release(pieces[i].priv);
+}
+
+/*
+ * Checks that whole chunks @pieces match their keys, several chunks are hashed at once
+ */
+static int blob_dedup_verify(struct eblob_dedup *d, const struct eblob_dedup_chunk_ref *refs,
+		const struct blob_dedup_piece *pieces, uint64_t num)
+{
+	unsigned char hash[16][SHA512_DIGEST_SIZE];
+	const void *buffers[ARRAY_SIZE(hash)];
+	uint64_t lens[ARRAY_SIZE(hash)];
+	uint64_t i, j, batch;
+
+	for (i = 0; i < num; i += batch) {
+		batch = num - i;
+		if (batch > ARRAY_SIZE(hash))
+			batch = ARRAY_SIZE(hash);
+
+		for (j = 0; j < batch; ++j) {
+			buffers[j] = pieces[i + j].data;
+			lens[j] = pieces[i + j].size;
+		}
+
+		sha512_buffers(NULL, 0, buffers, lens, batch, hash);
+
+		for (j = 0; j < batch; ++j) {
+			if (memcmp(hash[j], refs[i + j].key.id, EBLOB_ID_SIZE)) {
+				__sync_add_and_fetch(&d->stat.read_errors, 1);
+				dnet_backend_log(d->blob->blog, DNET_LOG_ERROR, "%s: EBLOB: dedup: corrupted chunk",
+						dnet_dump_id_str(refs[i + j].key.id));
+				return -EILSEQ;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Takes chunks of deduplicated record @key which cover the part of its data requested by @io,
+ * they are verified unless @nocsum is set. *@piecesp is set to the array of *@num pieces trimmed to the part,
+ * @io is updated the way dnet_backend_check_get_size() does.
+ */
+static int blob_dedup_pieces_get(struct eblob_backend_config *c, struct eblob_key *key, struct dnet_io_attr *io,
+		int nocsum, struct blob_dedup_piece **piecesp, uint64_t *num)
+{
+	struct eblob_dedup *d = c->dedup;
+	struct blob_dedup_piece *pieces = NULL;
+	struct eblob_dedup_chunk_ref *refs;
+	struct eblob_dedup_manifest *m = NULL;
+	pthread_mutex_t *key_lock;
+	uint64_t offset = 0, size, pos = 0, end, first, last, i;
+	int err;
+
+	if (!d) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: dedup: record is deduplicated, "
+				"but there is no chunk store", dnet_dump_id_str(key->id));
+		return -ENOTSUP;
+	}
+
+	/* chunks can not be released by a concurrent rewrite while they are being taken */
+	key_lock = blob_dedup_lock(d->key_locks, key);
+	pthread_mutex_lock(key_lock);
+
+	err = blob_dedup_manifest_read(c, key, &m);
+	if (err)
+		goto err_out_unlock;
+
+	/* record has been rewritten since it was looked up */
+	if (!m) {
+		err = -EAGAIN;
+		goto err_out_unlock;
+	}
+
+	size = m->size;
+	err = dnet_backend_check_get_size(io, &offset, &size);
+	if (err)
+		goto err_out_unlock;
+
+	refs = (struct eblob_dedup_chunk_ref *)(m + 1);
+
+	if (!size) {
+		*piecesp = NULL;
+		*num = 0;
+		goto err_out_unlock;
+	}
+
+	for (first = 0; pos + refs[first].size <= offset; ++first)
+		pos += refs[first].size;
+	for (last = first, end = pos + refs[first].size; end < offset + size; end += refs[++last].size)
+		;
+
+	*num = last - first + 1;
+	pieces = calloc(*num, sizeof(struct blob_dedup_piece));
+	if (!pieces) {
+		err = -ENOMEM;
+		goto err_out_unlock;
+	}
+
+	for (i = 0; i < *num; ++i) {
+		err = blob_dedup_chunk_map(d, &refs[first + i], &pieces[i]);
+		if (err) {
+			blob_dedup_pieces_release(pieces, i);
+			goto err_out_unlock;
+		}
+	}
+
+	if (!nocsum) {
+		err = blob_dedup_verify(d, refs + first, pieces, *num);
+		if (err) {
+			blob_dedup_pieces_release(pieces, *num);
+			goto err_out_unlock;
+		}
+	}
+
+	/* chunks are verified as a whole, only the requested part of them is used */
+	pieces[*num - 1].size -= end - (offset + size);
+	pieces[0].data += offset - pos;
+	pieces[0].size -= offset - pos;
+
+	*piecesp = pieces;
+	pieces = NULL;
+
+err_out_unlock:
+	pthread_mutex_unlock(key_lock);
+	free(pieces);
+	free(m);
+	return err;
+}
+
+/*
+ * Reads requested part of deduplicated record @key into memory, see blob_dedup_pieces_get()
+ */
+static int blob_dedup_load(struct eblob_backend_config *c, struct eblob_key *key, struct dnet_io_attr *io,
+		int nocsum, struct dnet_buffer **bufp)
+{
+	struct blob_dedup_piece *pieces = NULL;
+	struct dnet_buffer *buf;
+	uint64_t num = 0, pos = 0, i;
+	int err;
+
+	err = blob_dedup_pieces_get(c, key, io, nocsum, &pieces, &num);
+	if (err)
+		return err;
+
+	buf = dnet_buffer_alloc(io->size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto err_out_release;
+	}
+
+	for (i = 0; i < num; ++i) {
+		memcpy(buf->data + pos, pieces[i].data, pieces[i].size);
+		pos += pieces[i].size;
+	}
+
+	*bufp = buf;
+
+err_out_release:
+	blob_dedup_pieces_release(pieces, num);
+	free(pieces);
+	return err;
+}
+
+/*
+ * Reply to the read of deduplicated record consists of its chunks taken right from their mappings.
+ * Replies which can not be queued by pieces and replies to the local state are assembled in memory.
+ */
+static int blob_dedup_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, struct eblob_key *key, uint64_t record_flags, int last)
+{
+	const int nocsum = !!(io->flags & DNET_IO_FLAGS_NOCSUM);
+	struct blob_dedup_piece *pieces = NULL;
+	struct dnet_send_pieces *p;
+	struct dnet_buffer *buf;
+	uint64_t num = 0, i;
+	int err;
+
+	io->record_flags = record_flags | DNET_RECORD_FLAGS_DEDUP;
+	io->flags &= ~DNET_IO_FLAGS_COMPRESSED;
+
+	if ((io->flags & (DNET_IO_FLAGS_CHECKSUM | DNET_IO_FLAGS_SKIP_SENDING | DNET_IO_FLAGS_FILTER)) ||
+			dnet_state_is_local(state)) {
+		err = blob_dedup_load(c, key, io, nocsum, &buf);
+		if (err)
+			return err;
+
+		if (io->size && last)
+			cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+		/* reference is consumed even if sending fails */
+		return dnet_send_read_data_ref(state, cmd, io, buf->data, dnet_buffer_put, buf);
+	}
+
+	err = blob_dedup_pieces_get(c, key, io, nocsum, &pieces, &num);
+	if (err)
+		return err;
+
+	if (io->size && last)
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	p = dnet_send_read_data_parts_queue(state, cmd, io, num ? (int)num : 1, &err);
+	if (!p) {
+		blob_dedup_pieces_release(pieces, num);
+		goto err_out_free;
+	}
+
+	if (!num)
+		dnet_send_pieces_release(p, 0, NULL, 0, NULL, NULL);
+
+	/* pieces are referenced until they are sent */
+	for (i = 0; i < num; ++i)
+		dnet_send_pieces_release(p, i, pieces[i].data, pieces[i].size, pieces[i].release, pieces[i].priv);
+
+	err = dnet_send_pieces_complete(p, 0);
+
+err_out_free:
+	free(pieces);
+	return err;
+}
+
+static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data, int last)
+{
+	struct blob_read_verify verify = { .b = NULL };
+	int direct = 0;
+	struct dnet_ext_list_hdr ehdr;
+	struct dnet_ext_list elist;
+	struct dnet_io_attr *io = data;
+	struct eblob_backend *b = c->eblob;
+	struct eblob_key key;
+	struct eblob_write_control wc;
+	uint64_t offset = 0, size = 0, record_offset = io->offset;
+	int err, fd = -1, on_close = 0;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+
+	dnet_ext_list_init(&elist);
+	dnet_convert_io_attr(io);
+
+	/* Records without ext header are checksummed by SHA512 */
+	io->csum_type = DNET_CHECKSUM_SHA512;
+
+	memcpy(key.id, io->id, EBLOB_ID_SIZE);
+
+	err = blob_lookup_hdr(c, &key, &wc, &ehdr);
+	if (err < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-read-fd: READ: %d: %s",
+		                 dnet_dump_id_str(io->id), err, strerror(-err));
+		goto err_out_exit;
+	}
+
+	/* Existing entry */
+	offset = wc.data_offset;
+	size = wc.total_data_size;
+	fd = wc.data_fd;
+
+	/* Existing new-format entry */
+	if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
+		/* Sanity */
+		if (size < ehdr_size) {
+			err = -ERANGE;
+			goto err_out_exit;
+		}
+
+		dnet_ext_hdr_to_list(&ehdr, &elist);
+		dnet_ext_list_to_io(&elist, io);
+		io->csum_type = elist.csum_type;
+
+		/* Take into an account extended header's len */
+		size -= sizeof(struct dnet_ext_list_hdr);
+		offset += sizeof(struct dnet_ext_list_hdr);
+		record_offset += sizeof(struct dnet_ext_list_hdr);
+
+		if (elist.dedup) {
+			err = blob_dedup_read(c, state, cmd, io, &key, wc.flags, last);
+			goto err_out_exit;
+		}
+
+		if (elist.compression != DNET_COMPRESSION_NONE) {
+			err = blob_read_compressed(c, state, cmd, io, &key, &wc, offset, size, record_offset, last);
+			goto err_out_exit;
+		}
+	}
+
+	/* data is stored as is, it can be sent only uncompressed */
+	io->flags &= ~DNET_IO_FLAGS_COMPRESSED;
+
+	err = dnet_backend_check_get_size(io, &offset, &size);
+	if (err) {
+		goto err_out_exit;
+	}
+
+	io->record_flags = wc.flags;
+
+	/*
+	 * Large and streaming reads should not displace hot small objects from page cache,
+	 * DNET_IO_FLAGS_CHECKSUM reply is computed over the fd, so it is always sent from it.
+	 * Local state reads only the first reply entry synchronously, so it never gets pieces.
+	 */
+	if (c->direct_io_threshold && fd >= 0 && !(io->flags & DNET_IO_FLAGS_CHECKSUM) && !dnet_state_is_local(state) &&
+			(size >= c->direct_io_threshold || (io->flags & DNET_IO_FLAGS_STREAMING)))
+		direct = 1;
+
+	/* only partial reads can be continued by the next chunk */
+	if (fd >= 0 && size < io->total_size && !direct)
+		blob_read_ahead(c, &key, fd, offset, size, wc.data_offset + wc.total_data_size);
+
+	/*
+	 * Large records checksummed by chunks are verified while being sent,
+	 * DNET_IO_FLAGS_CHECKSUM reply needs checksum of the whole data in its header, so it can not be streamed
+	 */
+	if (!(io->flags & (DNET_IO_FLAGS_NOCSUM | DNET_IO_FLAGS_CHECKSUM)) && (wc.flags & DNET_RECORD_FLAGS_CHUNKED_CSUM) &&
+			fd >= 0 && size > EBLOB_BACKEND_VERIFY_CHUNK_SIZE) {
+		verify.b = b;
+		verify.key = &key;
+		verify.wc = &wc;
+		verify.record_offset = record_offset;
+	} else if (!(io->flags & DNET_IO_FLAGS_NOCSUM)) {
+		wc.offset = record_offset;
+		wc.size = size;
+		err = eblob_verify_checksum(b, &key, &wc);
+		if (err)
+			goto err_out_exit;
+	}
+
+	if (size && last)
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	if (fd >= 0) {
+		struct eblob_read_params *p, *prev;
+		int i;
+
+		pthread_mutex_lock(&c->last_read_lock);
+		p = &c->last_reads[c->last_read_index];
+
+		if (++c->last_read_index >= (int)ARRAY_SIZE(c->last_reads)) {
+			int64_t tmp;
+			int64_t mult = 1;
+			int64_t mean = 0;
+			int old_ra;
+
+			qsort(c->last_reads, ARRAY_SIZE(c->last_reads), sizeof(struct eblob_read_params),
+					eblob_read_params_compare);
+
+			prev = &c->last_reads[0];
+			tmp = prev->offset;
+
+			for (i = 1; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
+				p = &c->last_reads[i];
+
+				if (p->fd != prev->fd)
+					mult++;
+
+				tmp += p->offset * mult;
+				prev = p;
+			}
+
+			/* found mean offset */
+			mean = tmp / ARRAY_SIZE(c->last_reads);
+
+			/* calculating mean squared error */
+			tmp = 0;
+			for (i = 0; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
+				p = &c->last_reads[i];
+
+				tmp += ((int64_t)p->offset - mean) * ((int64_t)p->offset - mean);
+			}
+			tmp /= ARRAY_SIZE(c->last_reads);
+
+			/*
+			 * tmp and vm_total are squared, so if this check is true,
+			 * mean offset difference (error) is more than 25% of RAM
+			 */
+			old_ra = c->random_access;
+			if (tmp > c->vm_total / 16)
+				c->random_access = 1;
+			else
+				c->random_access = 0;
+
+			if (old_ra != c->random_access) {
+				dnet_backend_log(c->blog, DNET_LOG_NOTICE,
+					"EBLOB: switch RA %d -> %d, offset MSE: %llu, squared VM total: %llu",
+					old_ra, c->random_access, (unsigned long long)tmp, (unsigned long long)c->vm_total);
+			}
+
+			c->last_read_index = 0;
+		}
+
+		p->fd = fd;
+		p->offset = offset;
+		pthread_mutex_unlock(&c->last_read_lock);
+	}
+
+	if (c->random_access)
+		on_close = DNET_IO_REQ_FLAGS_CACHE_FORGET;
+
+	if (direct) {
+		/*
+		 * Verification reads data through page cache, so verified records are sent from the fd as usual,
+		 * but their pages are dropped after being sent
+		 */
+		if ((io->flags & DNET_IO_FLAGS_NOCSUM) || (wc.flags & BLOB_DISK_CTL_NOCSUM)) {
+			err = 1;
+			if (c->uring && size && last && !(io->flags & DNET_IO_FLAGS_SKIP_SENDING))
+				err = blob_async_read_send(c, state, cmd, io, fd, offset);
+			if (err > 0)
+				err = blob_direct_read_send(c, state, cmd, io, fd, offset);
+			if (err <= 0)
+				goto err_out_exit;
+		}
+
+		on_close |= DNET_IO_REQ_FLAGS_CACHE_FORGET;
+	}
+
+	if (c->mmap_read_threshold && !direct && !verify.b && fd >= 0 && size && size <= c->mmap_read_threshold) {
+		err = blob_mmap_read_send(c, state, cmd, io, fd, offset);
+		if (err <= 0)
+			goto err_out_exit;
+	}
+
+	if (verify.b)
+		err = dnet_send_read_data_verified(state, cmd, io, fd, offset, on_close,
+				EBLOB_BACKEND_VERIFY_CHUNK_SIZE, blob_read_verify_chunk, &verify);
+	else
+		err = dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
+
+err_out_exit:
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+struct eblob_read_range_priv {
+	struct eblob_backend_config	*c;
+	void			*state;
+	struct dnet_cmd		*cmd;
+	dnet_logger		*blog;
+	struct eblob_range_request	*keys;
+	uint64_t		keys_size;
+	uint64_t		keys_cnt;
+	uint32_t		flags;
+};
+
+static int blob_cmp_range_request(const void *req1, const void *req2)
+{
+	return memcmp(((struct eblob_range_request *)(req1))->record_key,
+	              ((struct eblob_range_request *)(req2))->record_key,
+	              EBLOB_ID_SIZE);
+}
+
+static int blob_cmp_range_position(const void *req1, const void *req2)
+{
+	const struct eblob_range_request *r1 = req1;
+	const struct eblob_range_request *r2 = req2;
+
+	if (r1->record_fd != r2->record_fd)
+		return r1->record_fd < r2->record_fd ? -1 : 1;
+	if (r1->record_offset != r2->record_offset)
+		return r1->record_offset < r2->record_offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Range keys are collected in index order, which is random across blob files.
+ * Unless client asked for sorted reply, keys are sent in the order of their position on disk,
+ * records closer than @EBLOB_RANGE_MERGE_GAP to each other are read ahead by a single sequential
+ * read of up to @EBLOB_BACKEND_READ_AHEAD_WINDOW bytes.
+ */
+#define EBLOB_RANGE_MERGE_GAP		(128 * 1024)
+
+static void blob_read_range_plan(struct eblob_range_request *keys, uint64_t num)
+{
+	uint64_t i, run_start = 0, run_end = 0;
+	int run_fd = -1, run_num = 0;
+
+	qsort(keys, num, sizeof(struct eblob_range_request), blob_cmp_range_position);
+
+	for (i = 0; i <= num; ++i) {
+		struct eblob_range_request *k = i < num ? &keys[i] : NULL;
+
+		if (k && k->record_fd == run_fd && k->record_offset <= run_end + EBLOB_RANGE_MERGE_GAP &&
+				k->record_offset + k->record_size - run_start <= EBLOB_BACKEND_READ_AHEAD_WINDOW) {
+			if (k->record_offset + k->record_size > run_end)
+				run_end = k->record_offset + k->record_size;
+			run_num++;
+			continue;
+		}
+
+		if (run_num > 1)
+			posix_fadvise(run_fd, run_start, run_end - run_start, POSIX_FADV_WILLNEED);
+
+		if (!k)
+			break;
+
+		run_fd = k->record_fd;
+		run_start = k->record_offset;
+		run_end = k->record_offset + k->record_size;
+		run_num = 1;
+	}
+}
+
+static int blob_read_range_callback(struct eblob_range_request *req)
+{
+	struct eblob_read_range_priv *p = req->priv;
+	struct dnet_io_attr io;
+	struct dnet_buffer *buf;
+	int err;
+
+	if (req->requested_offset > req->record_size) {
+		err = 0;
+		goto err_out_exit;
+	}
+
+	if (!(p->flags & DNET_IO_FLAGS_NODATA)) {
+		struct eblob_write_control wc;
+
+		io.flags = 0;
+		io.size = req->record_size - req->requested_offset;
+		io.offset = req->requested_offset;
+
+		/* FIXME: This is slow! */
+		err = blob_lookup(req->back, (struct eblob_key *)req->record_key, &wc);
+		if (err)
+			goto err_out_exit;
+
+		if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
+			struct dnet_ext_list_hdr ehdr;
+			struct dnet_ext_list elist;
+
+			err = dnet_ext_hdr_read(&ehdr, req->record_fd, req->record_offset);
+			if (err != 0)
+				goto err_out_exit;
+
+			dnet_ext_hdr_to_list(&ehdr, &elist);
+			dnet_ext_list_to_io(&elist, &io);
+
+			if (elist.dedup) {
+				io.size = 0;
+				err = blob_dedup_load(p->c, (struct eblob_key *)req->record_key, &io, 0, &buf);
+				if (err) {
+					if (err == -E2BIG)
+						err = 0;
+					goto err_out_exit;
+				}
+
+				io.record_flags = wc.flags | DNET_RECORD_FLAGS_DEDUP;
+				memcpy(io.id, req->record_key, DNET_ID_SIZE);
+				memcpy(io.parent, req->end, DNET_ID_SIZE);
+
+				err = dnet_send_read_data_ref(p->state, p->cmd, &io, buf->data, dnet_buffer_put, buf);
+				if (!err)
+					req->current_pos++;
+				goto err_out_exit;
+			}
+
+			if (elist.compression != DNET_COMPRESSION_NONE) {
+				err = blob_decompress(p->c, req->record_fd,
+						req->record_offset + sizeof(struct dnet_ext_list_hdr),
+						req->record_size - sizeof(struct dnet_ext_list_hdr), &buf);
+				if (err)
+					goto err_out_exit;
+
+				if (req->requested_offset > buf->size) {
+					dnet_buffer_put(buf);
+					goto err_out_exit;
+				}
+
+				io.offset = req->requested_offset;
+				io.size = buf->size - req->requested_offset;
+				io.total_size = buf->size;
+				io.record_flags = wc.flags | DNET_RECORD_FLAGS_COMPRESSED;
+				memcpy(io.id, req->record_key, DNET_ID_SIZE);
+				memcpy(io.parent, req->end, DNET_ID_SIZE);
+
+				err = dnet_send_read_data_ref(p->state, p->cmd, &io, buf->data + io.offset,
+						dnet_buffer_put, buf);
+				if (!err)
+					req->current_pos++;
+				goto err_out_exit;
+			}
+
+			io.offset += sizeof(struct dnet_ext_list_hdr);
+			io.size -= sizeof(struct dnet_ext_list_hdr);
+		}
+
+		memcpy(io.id, req->record_key, DNET_ID_SIZE);
+		memcpy(io.parent, req->end, DNET_ID_SIZE);
+
+		err = dnet_send_read_data(p->state, p->cmd, &io, NULL, req->record_fd,
+				req->record_offset + io.offset, 0);
+		if (!err)
+			req->current_pos++;
+	} else {
+		req->current_pos++;
+		err = 0;
+	}
+
+err_out_exit:
+	return err;
+}
+
+static int blob_del_range_callback(struct eblob_backend_config *c, struct eblob_range_request *req)
+{
+	struct eblob_key key;
+	int err;
+
+	dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL",
+			dnet_dump_id_str(req->record_key));
+
+	memcpy(key.id, req->record_key, EBLOB_ID_SIZE);
+	err = blob_remove(c, &key);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL: err: %d",
+				dnet_dump_id_str(req->record_key), err);
+	}
+
+	return err;
+}
+
+static int blob_range_callback(struct eblob_range_request *req)
+{
+	struct eblob_read_range_priv *p = req->priv;
+	int len = 10;
+	char start_id[len*2+1], end_id[len*2+1], cur_id[2*len+1];
+	int err = 0;
+
+	dnet_dump_id_len_raw(req->start, len, start_id);
+	dnet_dump_id_len_raw(req->end, len, end_id);
+	dnet_dump_id_len_raw(req->record_key, len, cur_id);
+
+	dnet_backend_log(p->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-range: limit: %llu [%llu, %llu]: "
+			"start: %s, end: %s: io record/requested: offset: %llu/%llu, size: %llu/%llu",
+			cur_id,
+			(unsigned long long)req->current_pos,
+			(unsigned long long)req->requested_limit_start, (unsigned long long)req->requested_limit_num,
+			start_id, end_id,
+			(unsigned long long)req->record_offset, (unsigned long long)req->requested_offset,
+			(unsigned long long)req->record_size, (unsigned long long)req->requested_size);
+
+	if (req->requested_offset > req->record_size) {
+		err = 0;
+		goto err_out_exit;
+	}
+
+	if (p->keys_size == p->keys_cnt) {
+		/* On first pass allocate 1000, otherwise double allocation size */
+		p->keys_size = p->keys_size ? p->keys_size * 2 : 1000;
+		p->keys = realloc(p->keys, sizeof(struct eblob_range_request) * p->keys_size);
+		if (p->keys == NULL) {
+			err = -ENOMEM;
+			dnet_backend_log(p->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-del-range: can't (re-)allocate memory, "
+					"new size: %" PRIu64 "", cur_id, p->keys_size);
+			goto err_out_exit;
+		}
+	}
+
+	memcpy(&p->keys[p->keys_cnt], req, sizeof(struct eblob_range_request));
+	dnet_dump_id_len_raw(p->keys[p->keys_cnt].record_key, len, cur_id);
+	dnet_backend_log(p->blog, DNET_LOG_DEBUG, "%s: count: %llu", cur_id, (unsigned long long)(p->keys_cnt));
+	p->keys_cnt++;
+
+	if (!err)
+		req->current_pos++;
+err_out_exit:
+	return err;
+}
+
+static int blob_read_range(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_read_range_priv p;
+	struct dnet_io_attr *io = data;
+	struct eblob_backend *b = c->eblob;
+	struct eblob_range_request req;
+	uint64_t i, start_from = 0;
+	int err;
+
+	memset(&p, 0, sizeof(p));
+
+	p.c = c;
+	p.cmd = cmd;
+	p.state = state;
+	p.keys = NULL;
+	p.keys_size= 0;
+	p.keys_cnt = 0;
+	p.flags = io->flags;
+	p.blog = c->blog;
+
+	dnet_convert_io_attr(io);
+
+	memset(&req, 0, sizeof(req));
+
+	memcpy(req.start, io->id, EBLOB_ID_SIZE);
+	memcpy(req.end, io->parent, EBLOB_ID_SIZE);
+	req.requested_offset = io->offset;
+	req.requested_size = io->size;
+	req.requested_limit_start = 0;
+	req.requested_limit_num = ~0ULL;
+
+	req.callback = blob_range_callback;
+	req.back = b;
+	req.priv = &p;
+
+	err = eblob_read_range(&req);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-read-range: %d: %s",
+			dnet_dump_id_str(io->id), err, strerror(-err));
+		goto err_out_exit;
+	}
+
+	if ((cmd->cmd == DNET_CMD_READ_RANGE) && (cmd->flags & DNET_ATTR_SORT)) {
+		dnet_backend_log(c->blog, DNET_LOG_DEBUG, "Sorting keys before sending");
+		qsort(p.keys, p.keys_cnt, sizeof(struct eblob_range_request), &blob_cmp_range_request);
+	}
+
+	if (cmd->cmd == DNET_CMD_READ_RANGE) {
+		start_from = io->start;
+
+		/* limit is applied to index order, only keys which are going to be sent are reordered */
+		if (!(cmd->flags & DNET_ATTR_SORT) && !(io->flags & DNET_IO_FLAGS_NODATA) && start_from < p.keys_cnt) {
+			uint64_t num = p.keys_cnt - start_from;
+
+			if (io->num > 0 && io->num < num)
+				num = io->num;
+
+			blob_read_range_plan(p.keys + start_from, num);
+		}
+	}
+
+	for (i = start_from; i < p.keys_cnt; ++i) {
+		switch(cmd->cmd) {
+			case DNET_CMD_READ_RANGE:
+				if ((io->num > 0) && (i >= (io->num + start_from)))
+					break;
+				dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: READ",
+						dnet_dump_id_str(p.keys[i].record_key));
+				err = blob_read_range_callback(&p.keys[i]);
+				break;
+			case DNET_CMD_DEL_RANGE:
+				dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL",
+						dnet_dump_id_str(p.keys[i].record_key));
+				err = blob_del_range_callback(c, &p.keys[i]);
+				break;
+		}
+
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: err: %d",
+					dnet_dump_id_str(p.keys[i].record_key), err);
+			goto err_out_exit;
+		}
+	}
+
+	if (req.current_pos) {
+		struct dnet_io_attr r;
+
+		memcpy(&r, io, sizeof(struct dnet_io_attr));
+		r.num = req.current_pos - start_from;
+		r.offset = r.size = 0;
+
+		err = dnet_send_read_data(state, cmd, &r, NULL, -1, 0, 0);
+	}
+
+err_out_exit:
+	if (p.keys)
+		free(p.keys);
+
+	return err;
+}
+
+static int blob_del(struct eblob_backend_config *c, struct dnet_cmd *cmd)
+{
+	struct eblob_key key;
+	int err;
+
+	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+
+	err = blob_remove(c, &key);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-del: REMOVE: %d: %s",
+			dnet_dump_id_str(cmd->id.id), err, strerror(-err));
+	}
+
+	return err;
+}
+
+static int blob_file_info(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd)
+{
+	struct eblob_backend *b = c->eblob;
+	struct eblob_key key;
+	struct eblob_write_control wc;
+	struct dnet_ext_list_hdr ehdr;
+	struct dnet_ext_list elist;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	uint64_t offset = 0, size = 0, record_offset = 0;
+	int fd, err;
+
+	dnet_ext_list_init(&elist);
+
+	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+	err = blob_lookup_hdr(c, &key, &wc, &ehdr);
+	if (err < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-file-info: info-read: %d: %s.",
+				dnet_dump_id(&cmd->id), err, strerror(-err));
+		goto err_out_exit;
+	}
+
+	/* Existing entry */
+	offset = wc.data_offset;
+	size = wc.total_data_size;
+	fd = wc.data_fd;
+
+	/* Existing new-format entry */
+	if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
+		/* Sanity */
+		if (size < ehdr_size) {
+			err = -ERANGE;
+			goto err_out_exit;
+		}
+
+		dnet_ext_hdr_to_list(&ehdr, &elist);
+
+		/* Take into an account extended header's len */
+		size -= ehdr_size;
+		offset += ehdr_size;
+		record_offset += sizeof(struct dnet_ext_list_hdr);
+	}
+
+	if (size == 0) {
+		err = -ENOENT;
+		dnet_backend_log(c->blog, DNET_LOG_INFO, "%s: EBLOB: blob-file-info: info-read: ZERO-SIZE-FILE.",
+				dnet_dump_id(&cmd->id));
+		goto err_out_exit;
+	}
+
+	/* Validate record's data if its checksum is requested */
+	if (cmd->flags & DNET_FLAGS_CHECKSUM) {
+		wc.offset = record_offset;
+		wc.size = size;
+		err = eblob_verify_checksum(b, &key, &wc);
+		if (err) {
+			goto err_out_exit;
+		}
+	}
+
+	err = blob_send_file_info(c, state, cmd, fd, offset, size, &elist.timestamp, wc.flags);
+
+err_out_exit:
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+static int eblob_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize) {
+	struct eblob_backend_config *c = priv;
+	struct eblob_write_control wc;
+	struct dnet_ext_list_hdr ehdr;
+	struct eblob_key key;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	int csum_type = DNET_CHECKSUM_SHA512;
+	int err;
+
+	memcpy(key.id, id->id, EBLOB_ID_SIZE);
+	err = blob_lookup_hdr(c, &key, &wc, &ehdr);
+	if (err < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-checksum: read: %d: %s.",
+							dnet_dump_id_str(id->id), err, strerror(-err));
+		goto err_out_exit;
+	}
+	err = 0;
+
+	if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
+		/* Sanity */
+		if (wc.total_data_size < ehdr_size) {
+			err = -EINVAL;
+			goto err_out_exit;
+		}
+
+		/* Record is compared with checksum computed by the same algorithm it was written with */
+		csum_type = ehdr.csum_type;
+
+		wc.data_offset += ehdr_size;
+		wc.total_data_size -= ehdr_size;
+
+		/* checksum is compared with the one of the original data */
+		if (ehdr.dedup) {
+			struct dnet_io_attr io;
+			struct dnet_buffer *buf;
+
+			memset(&io, 0, sizeof(struct dnet_io_attr));
+			err = blob_dedup_load(c, &key, &io, 0, &buf);
+			if (err)
+				goto err_out_exit;
+
+			err = dnet_checksum_data_type(n, csum_type, buf->data, buf->size, csum, *csize);
+			dnet_buffer_put(buf);
+			goto err_out_exit;
+		}
+
+		if (ehdr.compression != DNET_COMPRESSION_NONE) {
+			struct dnet_buffer *buf;
+
+			err = blob_decompress(c, wc.data_fd, wc.data_offset, wc.total_data_size, &buf);
+			if (err)
+				goto err_out_exit;
+
+			err = dnet_checksum_data_type(n, csum_type, buf->data, buf->size, csum, *csize);
+			dnet_buffer_put(buf);
+			goto err_out_exit;
+		}
+	}
+
+	if (wc.total_data_size == 0)
+		memset(csum, 0, *csize);
+	else
+		err = dnet_checksum_fd_type(n, csum_type, wc.data_fd, wc.data_offset,
+				wc.total_data_size, csum, *csize);
+
+err_out_exit:
+	return err;
+}
+
+/*
+ * Reserves record for streamed write, its ext header is written by the commit, see blob_write()
+ */
+static int eblob_backend_write_stream_prepare(void *priv, struct dnet_io_attr *io, int *fd, uint64_t *offset)
+{
+	struct eblob_backend_config *c = priv;
+	struct eblob_write_control wc = { .data_fd = -1 };
+	struct eblob_key key;
+	uint64_t flags = BLOB_DISK_CTL_EXTHDR;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	int err;
+
+	if (io->flags & DNET_IO_FLAGS_NOCSUM)
+		flags |= BLOB_DISK_CTL_NOCSUM;
+
+	memcpy(key.id, io->id, EBLOB_ID_SIZE);
+
+	err = eblob_write_prepare(c->eblob, &key, io->size + ehdr_size, flags);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write-stream: eblob_write_prepare: "
+				"size: %" PRIu64 ": %s %d", dnet_dump_id_str(io->id),
+				io->size + ehdr_size, strerror(-err), err);
+		goto err_out_exit;
+	}
+
+	blob_key_modified(c, &key);
+
+	err = eblob_read_return(c->eblob, &key, EBLOB_READ_NOCSUM, &wc);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-write-stream: eblob_read: %s %d",
+				dnet_dump_id_str(io->id), strerror(-err), err);
+		goto err_out_exit;
+	}
+
+	/* blob may be closed by defragmentation while net thread writes into it */
+	*fd = dup(wc.data_fd);
+	if (*fd < 0) {
+		err = -errno;
+		goto err_out_exit;
+	}
+	*offset = wc.data_offset + ehdr_size;
+
+	dnet_backend_log(c->blog, DNET_LOG_NOTICE, "%s: EBLOB: blob-write-stream: fd: %d, offset-within-fd: %" PRIu64
+			", size: %" PRIu64, dnet_dump_id_str(io->id), wc.data_fd, *offset, io->size);
+
+err_out_exit:
+	return err;
+}
+
+static int eblob_backend_lookup(struct dnet_node *n, void *priv, struct dnet_io_local *io)
+{
+	struct eblob_backend_config *c = priv;
+	struct eblob_key key;
+	struct dnet_ext_list_hdr ehdr;
+	struct dnet_ext_list elist;
+	struct eblob_write_control wc = { .data_fd = -1 };
+	uint64_t size, offset;
+	int err;
+
+	(void) n;
+	memcpy(key.id, io->key, EBLOB_ID_SIZE);
+
+	dnet_ext_list_init(&elist);
+
+	err = blob_lookup_hdr(c, &key, &wc, &ehdr);
+	if (err < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-backend-lookup: LOOKUP: %d: %s",
+			 dnet_dump_id_str(io->key), err, strerror(-err));
+		goto err_out_exit;
+	}
+
+	io->record_flags = wc.flags;
+	io->fd = wc.data_fd;
+
+	size = wc.total_data_size;
+	offset = wc.data_offset;
+
+	if (!(wc.flags & BLOB_DISK_CTL_EXTHDR)) {
+		err = 0;
+		goto err_out_set_sizes;
+	}
+
+	/* Sanity */
+	if (wc.total_data_size < sizeof(struct dnet_ext_list_hdr)) {
+		err = -ERANGE;
+		goto err_out_set_sizes;
+	}
+
+	dnet_ext_hdr_to_list(&ehdr, &elist);
+
+	io->timestamp = elist.timestamp;
+	io->user_flags = elist.flags;
+
+	size -= sizeof(struct dnet_ext_list_hdr);
+	offset += sizeof(struct dnet_ext_list_hdr);
+
+	err = 0;
+
+err_out_set_sizes:
+	io->total_size = size;
+	io->fd_offset = offset;
+
+err_out_exit:
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+/*
+ * Records are moved between tiers of the tiered backend by parts of this size
+ */
+#define EBLOB_BACKEND_COPY_CHUNK_SIZE		(4 * 1024 * 1024)
+
+int dnet_blob_lookup_record(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	struct eblob_write_control wc = { .data_fd = -1 };
+
+	return eblob_read_return(c->eblob, key, EBLOB_READ_NOCSUM, &wc);
+}
+
+int dnet_blob_copy_record(struct eblob_backend_config *src, struct eblob_backend_config *dst,
+		struct eblob_key *key, uint64_t *size)
+{
+	struct eblob_write_control wc = { .data_fd = -1 };
+	uint64_t flags, offset, chunk;
+	char *buf = NULL;
+	int fd = -1;
+	int err;
+
+	err = blob_lookup(src->eblob, key, &wc);
+	if (err)
+		goto err_out_exit;
+
+	/* blob may be closed by defragmentation while record is being copied */
+	fd = dup(wc.data_fd);
+	if (fd < 0) {
+		err = -errno;
+		goto err_out_exit;
+	}
+
+	buf = malloc(EBLOB_BACKEND_COPY_CHUNK_SIZE);
+	if (!buf) {
+		err = -ENOMEM;
+		goto err_out_close;
+	}
+
+	/* ext header is copied as is, so record keeps its timestamp, checksum and compression */
+	flags = wc.flags & (BLOB_DISK_CTL_EXTHDR | BLOB_DISK_CTL_NOCSUM);
+	*size = wc.total_data_size;
+
+	err = eblob_write_prepare(dst->eblob, key, *size, flags);
+	if (err)
+		goto err_out_free;
+
+	blob_key_modified(dst, key);
+
+	for (offset = 0; offset < *size; offset += chunk) {
+		chunk = *size - offset;
+		if (chunk > EBLOB_BACKEND_COPY_CHUNK_SIZE)
+			chunk = EBLOB_BACKEND_COPY_CHUNK_SIZE;
+
+		err = dnet_read_ll(fd, buf, chunk, wc.data_offset + offset);
+		if (err)
+			goto err_out_free;
+
+		const struct eblob_iovec iov[1] = {
+			{ .offset = offset, .size = chunk, .base = buf },
+		};
+
+		err = eblob_plain_writev(dst->eblob, key, iov, 1, flags);
+		if (err)
+			goto err_out_free;
+	}
+
+	err = eblob_write_commit(dst->eblob, key, *size, flags);
+	if (err)
+		goto err_out_free;
+
+	blob_key_modified(dst, key);
+
+	/* record must be durable before the caller removes its source */
+	memset(&wc, 0, sizeof(wc));
+	wc.data_fd = -1;
+	err = eblob_read_return(dst->eblob, key, EBLOB_READ_NOCSUM, &wc);
+	if (!err && fdatasync(wc.data_fd) < 0)
+		err = -errno;
+
+err_out_free:
+	if (err) {
+		dnet_backend_log(src->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-copy-record: size: %" PRIu64 ": %s %d",
+				dnet_dump_id_str(key->id), *size, strerror(-err), err);
+	}
+	free(buf);
+err_out_close:
+	close(fd);
+err_out_exit:
+	return err;
+}
+
+int dnet_blob_remove_record(struct eblob_backend_config *c, struct eblob_key *key)
+{
+	return blob_remove(c, key);
+}
+
+static int eblob_backend_key_absent(void *priv, const struct dnet_raw_id *id)
+{
+	struct eblob_backend_config *c = priv;
+	struct eblob_key key;
+
+	memcpy(key.id, id->id, EBLOB_ID_SIZE);
+	return blob_key_absent(c, &key);
+}
+
+static int blob_defrag_status(void *priv)
+{
+	struct eblob_backend_config *c = priv;
+
+	return eblob_defrag_status(c->eblob);
+}
+
+static int blob_defrag_start(void *priv, enum dnet_backend_defrag_level level)
+{
+	struct eblob_backend_config *c = priv;
+	enum eblob_defrag_state defrag_level;
+	switch (level) {
+		case DNET_BACKEND_DEFRAG_FULL:
+			defrag_level = EBLOB_DEFRAG_STATE_DATA_SORT;
+			break;
+		case DNET_BACKEND_DEFRAG_COMPACT:
+			defrag_level = EBLOB_DEFRAG_STATE_DATA_COMPACT;
+			break;
+		default:
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "DEFRAG: unknown defragmetation level: %d", (int)level);
+			return -ENOTSUP;
+	}
+
+	int err = eblob_start_defrag_level(c->eblob, defrag_level);
+
+	/* lookups are not cached while defragmentation is running, drop ones cached before it */
+	blob_lookup_cache_clear(c);
+	/* defragmentation replaces blob files, their mappings would keep removed ones on disk */
+	blob_mmap_clear(c);
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "DEFRAG: defragmetation request: status: %d", err);
+
+	return err;
+}
+
+static int blob_defrag_stop(void *priv)
+{
+	struct eblob_backend_config *c = priv;
+
+	return eblob_stop_defrag(c->eblob);
+}
+
+static int blob_send_reply(void *state, struct dnet_cmd *cmd, struct dnet_iterator_response *re, int more)
+{
+	int err;
+
+	dnet_convert_iterator_response(re);
+	err = dnet_send_reply_threshold(state, cmd, re, sizeof(struct dnet_iterator_response), more);
+
+	/* we have to convert response back, since it can be reused, for example like error response */
+	dnet_convert_iterator_response(re);
+	return err;
+}
+
+static int blob_send(struct eblob_backend_config *cfg, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_backend *b = cfg->eblob;
+	struct dnet_server_send_request *req = data;
+	struct dnet_raw_id *ids;
+	struct dnet_iterator_response re;
+	struct dnet_server_send_ctl *ctl;
+	int *groups;
+	int i, err;
+	int backend_id;
+
+	struct dnet_ext_list elist;
+	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
+	struct eblob_key key;
+	struct eblob_write_control wc;
+	uint64_t data_offset, record_offset;
+
+	dnet_ext_list_init(&elist);
+
+
+	/* structure has been already checked and has been proved to be correct no need to perform sanity checks */
+	dnet_convert_server_send_request(req);
+
+	ids = (struct dnet_raw_id *)(req + 1);
+	groups = (int *)(ids + req->id_num);
+
+	/*
+	 * Set NEED_ACK bit to signal server-send controller that we want
+	 * to send final ACK when controller will be destroyed, which in turn
+	 * will happen after all WRITE commands are completed.
+	 *
+	 * Command will be copied internally in @dnet_server_send_alloc(),
+	 * thus it is safe to clear that bit afterward.
+	 */
+	cmd->flags |= DNET_FLAGS_NEED_ACK;
+
+	backend_id = cfg->data.stat_id;
+	ctl = dnet_server_send_alloc(state, cmd, groups, req->group_num);
+	if (!ctl) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	ctl->iflags = req->iflags;
+	ctl->backend_id = backend_id;
+	ctl->timeout = req->timeout;
+	dnet_throttle_set(&ctl->throttle, req->rate_bytes, req->rate_keys);
+
+	/*
+	 * Deliberately clear NEED_ACK bit
+	 * This function will iterate over provided ids,
+	 * read them from the blob and queue WRITE command to remote groups.
+	 * When single WRITE command completes, it will send response back to client.
+	 *
+	 * If we send ACK in the middle, it will force client to stop accepting further responses.
+	 *
+	 * If there will be an error, it will be sent to client too.
+	 * If there is an error with command processing (like fail to allocate memory),
+	 * iteration will stop and error will be returned from this function to the higher layer,
+	 * which in turn will force ACK message to client with error code.
+	 */
+	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+
+
+	for (i = 0; i < req->id_num; ++i) {
+		memset(&re, 0, sizeof(struct dnet_iterator_response));
+		// set iterator response id to differentiate various commands
+		// client can use cmd->backend_id from reply though
+		re.id = cmd->backend_id;
+		re.key = ids[i];
+		re.iterated_keys = i;
+		re.total_keys = req->id_num;
+
+		memcpy(key.id, ids[i].id, EBLOB_ID_SIZE);
+
+		err = blob_lookup(b, &key, &wc);
+		if (err < 0) {
+			dnet_backend_log(cfg->blog, DNET_LOG_ERROR, "%s: EBLOB: blob_send: lookup: %d: %s",
+					 dnet_dump_id_str(key.id), err, strerror(-err));
+			goto err_out_send_fail_reply;
+		}
+
+		re.flags = wc.flags; // these flags correspond to DNET_RECORD_FLAGS_*
+		re.size = wc.total_data_size;
+
+		data_offset = wc.data_offset;
+		record_offset = 0;
+
+		if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
+			struct dnet_ext_list_hdr ehdr;
+
+			/* Sanity */
+			if (re.size < ehdr_size) {
+				err = -ERANGE;
+				goto err_out_send_fail_reply;
+			}
+
+			err = dnet_ext_hdr_read(&ehdr, wc.data_fd, wc.data_offset);
+			if (err != 0)
+				goto err_out_send_fail_reply;
+
+			dnet_ext_hdr_to_list(&ehdr, &elist);
+
+			re.timestamp = elist.timestamp;
+			re.user_flags = elist.flags;
+
+			/* chunks of deduplicated record are not copied as is, it is recovered by read and write */
+			if (elist.dedup) {
+				re.flags |= DNET_RECORD_FLAGS_DEDUP;
+				err = -ENOTSUP;
+				goto err_out_send_fail_reply;
+			}
+
+			/* Take into an account extended header's len */
+			re.size -= sizeof(struct dnet_ext_list_hdr);
+			data_offset += sizeof(struct dnet_ext_list_hdr);
+			record_offset += sizeof(struct dnet_ext_list_hdr);
+		}
+
+		wc.offset = record_offset;
+		wc.size = re.size;
+		err = eblob_verify_checksum(b, &key, &wc);
+		if (err)
+			goto err_out_send_fail_reply;
+
+		err = dnet_server_send_write(ctl, &re, sizeof(struct dnet_iterator_response), wc.data_fd, data_offset);
+		if (err)
+			goto err_out_send_fail_reply;
+
+		/* stop if an error is occurred during write */
+		if (ctl->write_error)
+			goto err_out_put;
+
+		continue;
+
+err_out_send_fail_reply:
+		re.status = err;
+		err = blob_send_reply(state, cmd, &re, 1);
+
+		// server has failed to send a reply to client, likely because of lack of memory
+		// we can not proceed with this request anymore, so its better to exit earlier
+		if (err)
+			goto err_out_put;
+	}
+
+	err = 0;
+
+err_out_put:
+	dnet_server_send_put(ctl);
+err_out_exit:
+	return err;
+}
+
+/*
+ * File of sealed base: base "<data>-<type>.<index>" consists of data file itself
+ * and its ".index" and ".index.sorted" files
+ */
+struct blob_file_entry {
+	char			name[DNET_BLOB_FILE_NAME_MAX];
+	uint64_t		size;
+	int			index;
+};
+
+/*
+ * Collects files of bases of the backend except the last one, which is still written to.
+ * @dir is filled with directory of the files.
+ */
+static int blob_files_collect(struct eblob_backend_config *c, char *dir, size_t dir_size,
+		struct blob_file_entry **entries, int *num)
+{
+	struct blob_file_entry *files = NULL, *tmp;
+	const char *prefix;
+	struct dirent *ent;
+	struct stat st;
+	char path[PATH_MAX];
+	size_t prefix_len;
+	int count = 0, allocated = 0, max_index = -1;
+	int i, j, type, index, pos, err = 0;
+	char *ptr;
+	DIR *d;
+
+	snprintf(dir, dir_size, "%s", c->data.file);
+	ptr = strrchr(dir, '/');
+	if (ptr) {
+		*ptr = '\0';
+		prefix = c->data.file + (ptr - dir) + 1;
+	} else {
+		snprintf(dir, dir_size, ".");
+		prefix = c->data.file;
+	}
+	prefix_len = strlen(prefix);
+
+	d = opendir(dir);
+	if (!d)
+		return -errno;
+
+	while ((ent = readdir(d)) != NULL) {
+		const char *suffix;
+
+		if (strncmp(ent->d_name, prefix, prefix_len) || strlen(ent->d_name) >= DNET_BLOB_FILE_NAME_MAX)
+			continue;
+
+		pos = 0;
+		if (sscanf(ent->d_name + prefix_len, "-%d.%d%n", &type, &index, &pos) != 2 || !pos)
+			continue;
+
+		suffix = ent->d_name + prefix_len + pos;
+		if (*suffix && strcmp(suffix, ".index") && strcmp(suffix, ".index.sorted"))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		if (count == allocated) {
+			allocated = allocated ? allocated * 2 : 64;
+			tmp = realloc(files, allocated * sizeof(struct blob_file_entry));
+			if (!tmp) {
+				err = -ENOMEM;
+				goto err_out_close;
+			}
+			files = tmp;
+		}
+
+		snprintf(files[count].name, sizeof(files[count].name), "%s", ent->d_name);
+		files[count].size = st.st_size;
+		files[count].index = index;
+		++count;
+
+		if (index > max_index)
+			max_index = index;
+	}
+
+	for (i = 0, j = 0; i < count; ++i) {
+		if (files[i].index != max_index)
+			files[j++] = files[i];
+	}
+
+	*entries = files;
+	*num = j;
+	closedir(d);
+	return 0;
+
+err_out_close:
+	free(files);
+	closedir(d);
+	return err;
+}
+
+static int blob_files_send_list(void *state, struct dnet_cmd *cmd, struct blob_file_entry *files, int num)
+{
+	size_t size = 0;
+	char *json = NULL;
+	FILE *out;
+	int i, err;
+
+	out = open_memstream(&json, &size);
+	if (!out)
+		return -ENOMEM;
+
+	fprintf(out, "{\"files\": [");
+	for (i = 0; i < num; ++i)
+		fprintf(out, "%s{\"name\": \"%s\", \"size\": %" PRIu64 "}", i ? ", " : "", files[i].name, files[i].size);
+	fprintf(out, "]}");
+
+	if (fclose(out)) {
+		free(json);
+		return -ENOMEM;
+	}
+
+	err = dnet_send_reply(state, cmd, json, size, 1);
+	free(json);
+	return err;
+}
+
+/*
+ * Serves DNET_CMD_BLOB_FILES: sealed bases are copied to another node as is and at disk speed,
+ * only keys written meanwhile have to be recovered one by one
+ */
+static int blob_files(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_blob_file_request *req = data;
+	struct blob_file_entry *files = NULL, *file = NULL;
+	struct dnet_io_attr io;
+	char dir[PATH_MAX], path[PATH_MAX];
+	int i, num = 0, fd, err;
+
+	if (cmd->size < sizeof(struct dnet_blob_file_request))
+		return -EINVAL;
+
+	dnet_convert_blob_file_request(req);
+	req->name[sizeof(req->name) - 1] = '\0';
+
+	/* defragmentation rewrites sealed bases, their files can not be copied meanwhile */
+	if (eblob_defrag_status(c->eblob))
+		return -EBUSY;
+
+	err = blob_files_collect(c, dir, sizeof(dir), &files, &num);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: BLOB_FILES: failed to list files of %s: %s [%d]",
+				c->data.file, strerror(-err), err);
+		return err;
+	}
+
+	if (!req->name[0]) {
+		err = blob_files_send_list(state, cmd, files, num);
+		goto err_out_free;
+	}
+
+	for (i = 0; i < num; ++i) {
+		if (!strcmp(files[i].name, req->name))
+			file = &files[i];
+	}
+
+	if (!file) {
+		err = -ENOENT;
+		goto err_out_free;
+	}
+
+	if (req->offset > file->size) {
+		err = -E2BIG;
+		goto err_out_free;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file->name);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		goto err_out_free;
+	}
+
+	memset(&io, 0, sizeof(io));
+	memcpy(io.id, cmd->id.id, DNET_ID_SIZE);
+	memcpy(io.parent, cmd->id.id, DNET_ID_SIZE);
+	io.offset = req->offset;
+	io.size = file->size - req->offset;
+	if (req->size && req->size < io.size)
+		io.size = req->size;
+	io.total_size = file->size;
+
+	/* copied data is not going to be read again, it would only push hot records out of page cache */
+	err = dnet_send_read_data(state, cmd, &io, NULL, fd, req->offset,
+			DNET_IO_REQ_FLAGS_CLOSE | DNET_IO_REQ_FLAGS_CACHE_FORGET);
+	if (err)
+		close(fd);
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: BLOB_FILES: %s: offset: %" PRIu64 ", size: %" PRIu64
+			", file-size: %" PRIu64 ", err: %d", path, io.offset, io.size, file->size, err);
+
+err_out_free:
+	free(files);
+	return err;
+}
+
+/* bases are indexed and retired bases are closed by scans made this often */
+#define EBLOB_COMPACT_SCAN_SECONDS	30
+#define EBLOB_COMPACT_READ_RECORDS	16384
+
+static void blob_compact_base_free(struct eblob_compact_base *b)
+{
+	if (b->data_fd >= 0)
+		close(b->data_fd);
+	free(b->prefixes);
+	free(b->positions);
+	free(b);
+}
+
+/*
+ * Builds compact index of base @index from its sorted index file @name in @dir.
+ * Every record is then at most @error entries away from the position predicted by its prefix.
+ */
+static int blob_compact_base_build(const char *dir, const char *name, int index, struct eblob_compact_base **base)
+{
+	static const char suffix[] = ".index.sorted";
+	struct eblob_disk_control *dcs = NULL;
+	struct eblob_compact_base *b;
+	char path[PATH_MAX];
+	uint64_t total, offset, i, guess, diff, num = 0;
+	struct stat st;
+	ssize_t bytes;
+	int index_fd, j, err;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	index_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (index_fd < 0)
+		return -errno;
+
+	b = calloc(1, sizeof(struct eblob_compact_base));
+	if (!b) {
+		err = -ENOMEM;
+		goto err_out_close;
+	}
+	b->index = index;
+
+	path[strlen(path) - (sizeof(suffix) - 1)] = '\0';
+	b->data_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (b->data_fd < 0) {
+		err = -errno;
+		goto err_out_free;
+	}
+
+	if (fstat(index_fd, &st)) {
+		err = -errno;
+		goto err_out_free;
+	}
+	total = st.st_size / sizeof(struct eblob_disk_control);
+
+	b->prefixes = malloc(total * sizeof(uint64_t) + 1);
+	b->positions = malloc(total * EBLOB_COMPACT_POSITION_SIZE + 1);
+	dcs = malloc(EBLOB_COMPACT_READ_RECORDS * sizeof(struct eblob_disk_control));
+	if (!b->prefixes || !b->positions || !dcs) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	for (offset = 0; offset < total; offset += bytes / sizeof(struct eblob_disk_control)) {
+		bytes = pread(index_fd, dcs, EBLOB_COMPACT_READ_RECORDS * sizeof(struct eblob_disk_control),
+				offset * sizeof(struct eblob_disk_control));
+		if (bytes < (ssize_t)sizeof(struct eblob_disk_control)) {
+			err = bytes < 0 ? -errno : -EINVAL;
+			goto err_out_free;
+		}
+
+		for (i = 0; i < bytes / sizeof(struct eblob_disk_control) && offset + i < total; ++i) {
+			struct eblob_disk_control *dc = &dcs[i];
+			unsigned char *p = b->positions + num * EBLOB_COMPACT_POSITION_SIZE;
+			uint64_t position;
+
+			eblob_convert_disk_control(dc);
+			if (dc->flags & (BLOB_DISK_CTL_REMOVE | BLOB_DISK_CTL_UNCOMMITTED))
+				continue;
+
+			if (dc->position >> (EBLOB_COMPACT_POSITION_SIZE * 8)) {
+				err = -E2BIG;
+				goto err_out_free;
+			}
+
+			b->prefixes[num] = blob_compact_prefix(&dc->key);
+			if (num && b->prefixes[num] < b->prefixes[num - 1]) {
+				err = -EILSEQ;
+				goto err_out_free;
+			}
+
+			for (j = 0, position = dc->position; j < EBLOB_COMPACT_POSITION_SIZE; ++j, position >>= 8)
+				p[j] = position & 0xff;
+			++num;
+		}
+	}
+	b->num = num;
+
+	for (i = 0; i < num; ++i) {
+		guess = blob_compact_predict(b, b->prefixes[i]);
+		diff = guess > i ? guess - i : i - guess;
+		if (diff > b->error)
+			b->error = diff;
+	}
+
+	free(dcs);
+	close(index_fd);
+	*base = b;
+	return 0;
+
+err_out_free:
+	free(dcs);
+	blob_compact_base_free(b);
+err_out_close:
+	close(index_fd);
+	return err;
+}
+
+static int blob_compact_base_listed(struct blob_file_entry *files, int num, int index)
+{
+	int i;
+
+	for (i = 0; i < num; ++i) {
+		if (files[i].index == index)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Retires bases whose files have been rewritten or removed and indexes sealed bases which are not indexed yet.
+ * Bases are built without @bases_lock held, lookups only wait for the list to be changed.
+ */
+static void blob_compact_scan(struct eblob_backend_config *c)
+{
+	static const char suffix[] = ".index.sorted";
+	struct eblob_compact_index *ci = c->compact;
+	struct eblob_compact_base *b, **pos, *tmp;
+	struct blob_file_entry *files = NULL;
+	char dir[PATH_MAX];
+	time_t now = time(NULL);
+	struct stat st;
+	size_t len;
+	int i, num = 0, err;
+
+	for (pos = &ci->retired; (b = *pos) != NULL;) {
+		if (b->retired + EBLOB_COMPACT_SCAN_SECONDS <= now) {
+			*pos = b->next;
+			blob_compact_base_free(b);
+		} else {
+			pos = &b->next;
+		}
+	}
+
+	if (eblob_defrag_status(c->eblob))
+		return;
+
+	err = blob_files_collect(c, dir, sizeof(dir), &files, &num);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: compact index: failed to list files of %s: %d.",
+				c->data.file, err);
+		return;
+	}
+
+	pthread_rwlock_wrlock(&ci->bases_lock);
+	for (pos = &ci->bases; (b = *pos) != NULL;) {
+		if (fstat(b->data_fd, &st) || !st.st_nlink || !blob_compact_base_listed(files, num, b->index)) {
+			*pos = b->next;
+			ci->base_num--;
+			ci->records -= b->num;
+
+			b->retired = now;
+			b->next = ci->retired;
+			ci->retired = b;
+			__sync_add_and_fetch(&ci->stat.retired, 1);
+		} else {
+			pos = &b->next;
+		}
+	}
+	pthread_rwlock_unlock(&ci->bases_lock);
+
+	for (i = 0; i < num; ++i) {
+		len = strlen(files[i].name);
+		if (len < sizeof(suffix) || strcmp(files[i].name + len - (sizeof(suffix) - 1), suffix))
+			continue;
+
+		pthread_rwlock_rdlock(&ci->bases_lock);
+		for (b = ci->bases; b && b->index != files[i].index; b = b->next)
+			;
+		pthread_rwlock_unlock(&ci->bases_lock);
+
+		/* list is changed by this thread only */
+		if (b)
+			continue;
+
+		err = blob_compact_base_build(dir, files[i].name, files[i].index, &tmp);
+		if (err) {
+			__sync_add_and_fetch(&ci->stat.build_errors, 1);
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: compact index: failed to index %s/%s: %d.",
+					dir, files[i].name, err);
+			continue;
+		}
+
+		pthread_rwlock_wrlock(&ci->bases_lock);
+		for (pos = &ci->bases; *pos && (*pos)->index > tmp->index; pos = &(*pos)->next)
+			;
+		tmp->next = *pos;
+		*pos = tmp;
+		ci->base_num++;
+		ci->records += tmp->num;
+		pthread_rwlock_unlock(&ci->bases_lock);
+
+		__sync_add_and_fetch(&ci->stat.built, 1);
+		dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: compact index: %s/%s: records: %" PRIu64
+				", error: %" PRIu64 ".", dir, files[i].name, tmp->num, tmp->error);
+	}
+
+	free(files);
+}
+
+static void *blob_compact_scan_process(void *data)
+{
+	struct eblob_backend_config *c = data;
+	struct eblob_compact_index *ci = c->compact;
+	struct timespec deadline;
+
+	dnet_set_name("dnet_blob_index");
+
+	pthread_mutex_lock(&ci->lock);
+	while (!ci->need_exit) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += EBLOB_COMPACT_SCAN_SECONDS;
+
+		pthread_cond_timedwait(&ci->wait, &ci->lock, &deadline);
+		if (ci->need_exit)
+			break;
+
+		pthread_mutex_unlock(&ci->lock);
+		blob_compact_scan(c);
+		pthread_mutex_lock(&ci->lock);
+	}
+	pthread_mutex_unlock(&ci->lock);
+
+	return NULL;
+}
+
+static void blob_compact_destroy(struct eblob_backend_config *c)
+{
+	struct eblob_compact_index *ci = c->compact;
+	struct eblob_compact_base *b;
+
+	if (!ci)
+		return;
+
+	if (ci->scan_started) {
+		pthread_mutex_lock(&ci->lock);
+		ci->need_exit = 1;
+		pthread_cond_broadcast(&ci->wait);
+		pthread_mutex_unlock(&ci->lock);
+
+		pthread_join(ci->scan_thread, NULL);
+	}
+
+	while ((b = ci->bases) != NULL) {
+		ci->bases = b->next;
+		blob_compact_base_free(b);
+	}
+
+	while ((b = ci->retired) != NULL) {
+		ci->retired = b->next;
+		blob_compact_base_free(b);
+	}
+
+	pthread_cond_destroy(&ci->wait);
+	pthread_mutex_destroy(&ci->lock);
+	pthread_rwlock_destroy(&ci->bases_lock);
+
+	free(ci);
+	c->compact = NULL;
+}
+
+/* indexes sealed bases before requests are served, later ones are indexed by scan thread */
+static int blob_compact_init(struct eblob_backend_config *c)
+{
+	struct eblob_compact_index *ci;
+	int err;
+
+	if (!c->compact_index)
+		return 0;
+
+	ci = calloc(1, sizeof(struct eblob_compact_index));
+	if (!ci)
+		return -ENOMEM;
+
+	err = -pthread_rwlock_init(&ci->bases_lock, NULL);
+	if (err)
+		goto err_out_free;
+
+	err = -pthread_mutex_init(&ci->lock, NULL);
+	if (err)
+		goto err_out_rwlock_destroy;
+
+	err = -pthread_cond_init(&ci->wait, NULL);
+	if (err)
+		goto err_out_lock_destroy;
+
+	/* from here on blob_compact_destroy() cleans up everything */
+	c->compact = ci;
+
+	blob_compact_scan(c);
+
+	err = pthread_create(&ci->scan_thread, NULL, blob_compact_scan_process, c);
+	if (err) {
+		blob_compact_destroy(c);
+		return -err;
+	}
+	ci->scan_started = 1;
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: compact index: bases: %d, records: %" PRIu64 ".",
+			ci->base_num, ci->records);
+	return 0;
+
+err_out_lock_destroy:
+	pthread_mutex_destroy(&ci->lock);
+err_out_rwlock_destroy:
+	pthread_rwlock_destroy(&ci->bases_lock);
+err_out_free:
+	free(ci);
+	return err;
+}
+
+static int eblob_backend_command_handler_raw(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_backend_config *c = priv;
+
+	HANDY_TIMER_SCOPE(dnet_cmd_metric_name(c->cmd_metrics, cmd->cmd));
+
+	int err;
+
+	switch (cmd->cmd) {
+		case DNET_CMD_LOOKUP:
+			err = blob_file_info(c, state, cmd);
+			break;
+		case DNET_CMD_WRITE:
+			err = blob_write(c, state, cmd, data);
+			break;
+		case DNET_CMD_READ:
+			err = blob_read(c, state, cmd, data, 1);
+			break;
+		case DNET_CMD_READ_RANGE:
+		case DNET_CMD_DEL_RANGE:
+			err = blob_read_range(c, state, cmd, data);
+			break;
+		case DNET_CMD_DEL:
+			err = blob_del(c, cmd);
+			break;
+		case DNET_CMD_SEND:
+			err = blob_send(c, state, cmd, data);
+			break;
+		case DNET_CMD_BLOB_FILES:
+			err = blob_files(c, state, cmd, data);
+			break;
+		default:
+			err = -ENOTSUP;
+			break;
+	}
+
+	return err;
+}
+
+static int eblob_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+{
+	int err;
+
+	DNET_PROBE_CMD(backend__start, state, cmd, (int)cmd->backend_id);
+
+	err = eblob_backend_command_handler_raw(state, priv, cmd, data);
+
+	DNET_PROBE_CMD(backend__done, state, cmd, (int)cmd->backend_id, err);
+	return err;
+}
+
+static int dnet_blob_set_sync(struct dnet_config_backend *b,
+                              const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.sync = atoi(value);
+	return 0;
+}
+
+static int dnet_blob_set_data(struct dnet_config_backend *b,
+                              const char *key __unused, const char *file)
+{
+	struct eblob_backend_config *c = b->data;
+	int err;
+
+	err = backend_storage_size(b, file);
+	if (err) {
+		char root[strlen(file)+1], *ptr;
+
+		snprintf(root, sizeof(root), "%s", file);
+		ptr = strrchr(root, '/');
+		if (ptr) {
+			*ptr = '\0';
+			err = backend_storage_size(b, root);
+		}
+
+		if (err)
+			return err;
+	}
+
+	free(c->data.file);
+	c->data.file = strdup(file);
+	if (!c->data.file)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int dnet_blob_set_datasort_dir(struct dnet_config_backend *b,
+				      const char *key __unused, const char *dir)
+{
+	struct eblob_backend_config *c = b->data;
+	struct stat st;
+	int err;
+
+	err = stat(dir, &st);
+	if (err == -1)
+		return -errno;
+
+	if (!S_ISDIR(st.st_mode))
+		return -ENOTDIR;
+
+	free(c->data.chunks_dir);
+	c->data.chunks_dir = strdup(dir);
+	if (!c->data.chunks_dir)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int dnet_blob_set_blob_size(struct dnet_config_backend *b,
+                                   const char *key, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+	uint64_t val = strtoul(value, NULL, 0);
+
+	if (strchr(value, 'T') || strchr(value, 't'))
+		val *= 1024*1024*1024*1024ULL;
+	else if (strchr(value, 'G') || strchr(value, 'g'))
+		val *= 1024*1024*1024ULL;
+	else if (strchr(value, 'M') || strchr(value, 'm'))
+		val *= 1024*1024;
+	else if (strchr(value, 'K') || strchr(value, 'k'))
+		val *= 1024;
+
+	if (!strcmp(key, "blob_size"))
+		c->data.blob_size = val;
+	else if (!strcmp(key, "blob_size_limit"))
+		c->data.blob_size_limit = val;
+
+	return 0;
+}
+
+static int dnet_blob_set_index_block_size(struct dnet_config_backend *b,
+                                          const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.index_block_size = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_index_block_bloom_length(struct dnet_config_backend *b,
+                                                  const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.index_block_bloom_length = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_periodic_timeout(struct dnet_config_backend *b,
+                                          const char *key __unused, const char *value) {
+	struct eblob_backend_config *c = b->data;
+
+	c->data.periodic_timeout = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_records_in_blob(struct dnet_config_backend *b,
+                                         const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+	uint64_t val = strtoul(value, NULL, 0);
+
+	c->data.records_in_blob = val;
+	return 0;
+}
+
+static int dnet_blob_set_defrag_timeout(struct dnet_config_backend *b,
+                                        const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.defrag_timeout = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_defrag_time(struct dnet_config_backend *b,
+                                     const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.defrag_time = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_defrag_splay(struct dnet_config_backend *b,
+                                      const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.defrag_splay = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_defrag_percentage(struct dnet_config_backend *b,
+                                           const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.defrag_percentage = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_blob_flags(struct dnet_config_backend *b,
+                                    const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->data.blob_flags = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_group_commit_window(struct dnet_config_backend *b,
+                                             const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->group_commit_window_us = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_group_commit_bytes(struct dnet_config_backend *b,
+                                            const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->group_commit_bytes = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_compact_index(struct dnet_config_backend *b,
+                                       const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->compact_index = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_direct_io_threshold(struct dnet_config_backend *b,
+                                             const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->direct_io_threshold = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_mmap_read_threshold(struct dnet_config_backend *b,
+                                             const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->mmap_read_threshold = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_async_io_depth(struct dnet_config_backend *b,
+                                        const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->async_io_depth = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_lookup_cache_size(struct dnet_config_backend *b,
+                                           const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->lookup_cache_size = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_absent_cache_size(struct dnet_config_backend *b,
+                                           const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->absent_cache_size = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_key_filter_capacity(struct dnet_config_backend *b,
+                                             const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->key_filter_capacity = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_checksum_type(struct dnet_config_backend *b,
+                                       const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	if (!strcmp(value, "sha512")) {
+		c->checksum_type = DNET_CHECKSUM_SHA512;
+	} else if (!strcmp(value, "crc32c")) {
+		c->checksum_type = DNET_CHECKSUM_CRC32C;
+	} else {
+		dnet_backend_log(b->log, DNET_LOG_ERROR, "EBLOB: unknown checksum_type: '%s', "
+				"supported: sha512, crc32c", value);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int dnet_blob_set_compression(struct dnet_config_backend *b,
+                                     const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	if (!strcmp(value, "none")) {
+		c->compression = DNET_COMPRESSION_NONE;
+	} else if (!strcmp(value, "lz4") && blob_compression_supported()) {
+		c->compression = DNET_COMPRESSION_LZ4;
+	} else {
+		dnet_backend_log(b->log, DNET_LOG_ERROR, "EBLOB: unknown or unsupported compression: '%s', "
+				"supported: none%s", value, blob_compression_supported() ? ", lz4" : "");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int dnet_blob_set_compression_threshold(struct dnet_config_backend *b,
+                                               const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->compression_threshold = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_ttl_bucket_seconds(struct dnet_config_backend *b,
+                                            const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->ttl_bucket_seconds = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_dedup_threshold(struct dnet_config_backend *b,
+                                         const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->dedup_threshold = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_dedup_chunk_size(struct dnet_config_backend *b,
+                                          const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->dedup_chunk_size = strtoull(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_backend_id(struct dnet_config_backend *b,
+                                    const char *key __unused, const char *value) {
+	struct eblob_backend_config *c = b->data;
+
+	c->data.stat_id = strtoul(value, NULL, 0);
+	return 0;
+}
+
+
+uint64_t eblob_backend_total_elements(void *priv) {
+	struct eblob_backend_config *r = priv;
+	return eblob_total_elements(r->eblob);
+}
+
+int eblob_backend_storage_stat_json(void *priv, char **json_stat, size_t *size)
+{
+	int err;
+	struct eblob_backend_config *r = priv;
+
+	err = eblob_stat_json_get(r->eblob, json_stat, size);
+	if (err) {
+		return err;
+	}
+
+	err = dnet_blob_stat_json_add_compression(r, json_stat, size);
+	if (err)
+		return err;
+
+	err = dnet_blob_stat_json_add_absent(r, json_stat, size);
+	if (err)
+		return err;
+
+	if (r->compact) {
+		err = dnet_blob_stat_json_add_compact(r, json_stat, size);
+		if (err)
+			return err;
+	}
+
+	if (r->dedup) {
+		err = dnet_blob_stat_json_add_dedup(r, json_stat, size);
+		if (err)
+			return err;
+	}
+
+	if (!r->ttl)
+		return 0;
+
+	return dnet_blob_stat_json_add_ttl(r, json_stat, size);
+}
+
+static void blob_ttl_destroy(struct eblob_backend_config *c);
+static void blob_dedup_destroy(struct eblob_backend_config *c);
+
+static void eblob_backend_cleanup(void *priv)
+{
+	struct eblob_backend_config *c = priv;
+
+	blob_ttl_destroy(c);
+	blob_dedup_destroy(c);
+	blob_compact_destroy(c);
+
+	/* waits for asynchronous reads in flight */
+	dnet_uring_destroy(c->uring);
+	c->uring = NULL;
+
+	eblob_cleanup(c->eblob);
+
+	blob_mmap_clear(c);
+	pthread_mutex_destroy(&c->mmap_lock);
+	blob_group_commit_destroy(c);
+	blob_key_filter_destroy(c);
+	blob_absent_cache_destroy(c);
+	blob_lookup_cache_destroy(c);
+	blob_path_cache_destroy(c);
+	pthread_mutex_destroy(&c->last_read_lock);
+}
+
+static int dnet_eblob_iterator(struct dnet_iterator_ctl *ictl, struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
+{
+	struct eblob_index_block *range = NULL;
+	struct eblob_backend_config *c = ictl->iterate_private;
+	struct eblob_backend *b = c->eblob;
+	int err;
+	const int no_meta = ireq->flags & DNET_IFLAGS_NO_META && !(ireq->flags & (DNET_IFLAGS_TS_RANGE | DNET_IFLAGS_DATA));
+
+	/* Init iterator config */
+	struct eblob_iterate_control eictl = {
+		.priv = ictl,
+		.b = b,
+		.log = c->data.log,
+		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
+		/* blobs are shared between workers, elliptics callbacks are thread-safe */
+		.thread_num = ireq->threads > 1 ? ireq->threads : 1,
+		.iterator_cb = {
+			.iterator = no_meta ? blob_iterate_callback_without_meta : blob_iterate_callback_with_meta,
+		},
+	};
+
+	if (ireq->itype == DNET_ITYPE_SERVER_SEND)
+		eictl.flags |= EBLOB_ITERATE_FLAGS_VERIFY_CHECKSUM;
+
+	if (ireq->range_num) {
+		unsigned int i;
+
+		range = calloc(ireq->range_num, sizeof(struct eblob_index_block));
+		if (!range) {
+			err = -ENOMEM;
+			goto err_out_exit;
+		}
+
+		for (i = 0; i < ireq->range_num; ++i) {
+			memcpy(range[i].start_key.id, irange[i].key_begin.id, DNET_ID_SIZE);
+			memcpy(range[i].end_key.id, irange[i].key_end.id, DNET_ID_SIZE);
+		}
+
+		eictl.range = range;
+		eictl.range_num = ireq->range_num;
+	}
+
+	err = eblob_iterate(b, &eictl);
+
+	free(range);
+err_out_exit:
+	return err;
+}
+
+/*
+ * TTL buckets
+ *
+ * Records written with lifetime go to bucket eblobs by their expiration time, keys of the main eblob
+ * and of buckets never overlap for long: stale copy is removed once the key has been written to its new place.
+ * Keys are locked by the server while being modified, so writers of the same key do not race here.
+ */
+
+/* buckets end on multiples of bucket seconds, so that records expiring at close times share a bucket */
+static inline time_t blob_ttl_bucket_end(struct eblob_backend_config *c, time_t expire)
+{
+	return (expire + c->ttl_bucket_seconds - 1) / c->ttl_bucket_seconds * c->ttl_bucket_seconds;
+}
+
+static struct eblob_ttl_shard *blob_ttl_shard(struct eblob_ttl *t, const struct eblob_key *key)
+{
+	uint32_t hash;
 
-	if ((cmd->cmd == DNET_CMD_READ_RANGE) && (cmd->flags & DNET_ATTR_SORT)) {
-		dnet_backend_log(c->blog, DNET_LOG_DEBUG, "Sorting keys before sending");
-		qsort(p.keys, p.keys_cnt, sizeof(struct eblob_range_request), &blob_cmp_range_request);
-	}
+	memcpy(&hash, key->id, sizeof(hash));
+	return &t->shards[hash % EBLOB_TTL_SHARDS];
+}
 
-	if (cmd->cmd == DNET_CMD_READ_RANGE) {
-		start_from = io->start;
+static struct rb_node **blob_ttl_entry_find(struct eblob_ttl_shard *s, const struct eblob_key *key,
+		struct rb_node **parent)
+{
+	struct rb_node **n = &s->root.rb_node;
+
+	*parent = NULL;
+	while (*n) {
+		struct eblob_ttl_entry *e = rb_entry(*n, struct eblob_ttl_entry, node);
+		int cmp = memcmp(key->id, e->key.id, EBLOB_ID_SIZE);
+
+		*parent = *n;
+		if (cmp < 0)
+			n = &(*n)->rb_left;
+		else if (cmp > 0)
+			n = &(*n)->rb_right;
+		else
+			break;
 	}
 
-	for (i = start_from; i < p.keys_cnt; ++i) {
-		switch(cmd->cmd) {
-			case DNET_CMD_READ_RANGE:
-				if ((io->num > 0) && (i >= (io->num + start_from)))
-					break;
-				dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: READ",
-						dnet_dump_id_str(p.keys[i].record_key));
-				err = blob_read_range_callback(&p.keys[i]);
-				break;
-			case DNET_CMD_DEL_RANGE:
-				dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL",
-						dnet_dump_id_str(p.keys[i].record_key));
-				err = blob_del_range_callback(c, &p.keys[i]);
-				break;
-		}
+	return n;
+}
 
-		if (err) {
-			dnet_backend_log(c->blog, DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: err: %d",
-					dnet_dump_id_str(p.keys[i].record_key), err);
-			goto err_out_exit;
+static void blob_ttl_entry_erase(struct eblob_ttl_shard *s, struct eblob_ttl_entry *e)
+{
+	rb_erase(&e->node, &s->root);
+	s->num--;
+	free(e);
+}
+
+/*
+ * End of the bucket @key is stored in, 0 if it is stored in the main eblob.
+ * Entry of the bucket which has already expired is erased.
+ */
+static time_t blob_ttl_location(struct eblob_ttl *t, const struct eblob_key *key)
+{
+	struct eblob_ttl_shard *s = blob_ttl_shard(t, key);
+	struct eblob_ttl_entry *e;
+	struct rb_node **n, *parent;
+	time_t end = 0;
+
+	pthread_mutex_lock(&s->lock);
+	n = blob_ttl_entry_find(s, key, &parent);
+	if (*n) {
+		e = rb_entry(*n, struct eblob_ttl_entry, node);
+		if (e->end > time(NULL)) {
+			end = e->end;
+		} else {
+			blob_ttl_entry_erase(s, e);
+			__sync_add_and_fetch(&t->stat.stale_entries, 1);
 		}
 	}
+	pthread_mutex_unlock(&s->lock);
 
-	if (req.current_pos) {
-		struct dnet_io_attr r;
+	return end;
+}
 
-		memcpy(&r, io, sizeof(struct dnet_io_attr));
-		r.num = req.current_pos - start_from;
-		r.offset = r.size = 0;
+/* sets location of @key, @end is 0 if the key has been moved to the main eblob or removed */
+static int blob_ttl_set_location(struct eblob_ttl *t, const struct eblob_key *key, time_t end)
+{
+	struct eblob_ttl_shard *s = blob_ttl_shard(t, key);
+	struct eblob_ttl_entry *e;
+	struct rb_node **n, *parent;
+	int err = 0;
 
-		err = dnet_send_read_data(state, cmd, &r, NULL, -1, 0, 0);
+	pthread_mutex_lock(&s->lock);
+	n = blob_ttl_entry_find(s, key, &parent);
+	if (*n) {
+		e = rb_entry(*n, struct eblob_ttl_entry, node);
+		if (end)
+			e->end = end;
+		else
+			blob_ttl_entry_erase(s, e);
+	} else if (end) {
+		e = malloc(sizeof(struct eblob_ttl_entry));
+		if (e) {
+			e->key = *key;
+			e->end = end;
+
+			rb_link_node(&e->node, parent, n);
+			rb_insert_color(&e->node, &s->root);
+			s->num++;
+		} else {
+			err = -ENOMEM;
+		}
 	}
-
-err_out_exit:
-	if (p.keys)
-		free(p.keys);
+	pthread_mutex_unlock(&s->lock);
 
 	return err;
 }
 
-static int blob_del(struct eblob_backend_config *c, struct dnet_cmd *cmd)
+/* erases entries of buckets which have expired by @now, they are not looked up anymore */
+static void blob_ttl_sweep(struct eblob_ttl *t, time_t now)
 {
-	struct eblob_key key;
-	int err;
+	struct rb_node *n, *next;
+	uint64_t stale = 0;
+	int i;
 
-	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+	for (i = 0; i < EBLOB_TTL_SHARDS; ++i) {
+		struct eblob_ttl_shard *s = &t->shards[i];
 
-	err = eblob_remove(c->eblob, &key);
-	if (err) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-del: REMOVE: %d: %s",
-			dnet_dump_id_str(cmd->id.id), err, strerror(-err));
+		pthread_mutex_lock(&s->lock);
+		for (n = rb_first(&s->root); n; n = next) {
+			struct eblob_ttl_entry *e = rb_entry(n, struct eblob_ttl_entry, node);
+
+			next = rb_next(n);
+			if (e->end <= now) {
+				blob_ttl_entry_erase(s, e);
+				stale++;
+			}
+		}
+		pthread_mutex_unlock(&s->lock);
 	}
 
-	return err;
+	__sync_add_and_fetch(&t->stat.stale_entries, stale);
 }
 
-static int blob_file_info(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd)
+static int blob_ttl_remove_dir_entry(const char *path, const struct stat *st __unused, int flag __unused,
+		struct FTW *ftw __unused)
 {
-	struct eblob_backend *b = c->eblob;
-	struct eblob_key key;
-	struct eblob_write_control wc;
-	struct dnet_ext_list elist;
-	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
-	uint64_t offset = 0, size = 0, record_offset = 0;
-	int fd, err;
+	return remove(path) ? -errno : 0;
+}
 
-	dnet_ext_list_init(&elist);
+static void blob_ttl_bucket_free(struct eblob_ttl_bucket *b)
+{
+	if (b->config && b->config->data)
+		b->config->cleanup(b->config);
 
-	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
-	err = blob_lookup(b, &key, &wc);
-	if (err < 0) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-file-info: info-read: %d: %s.",
-				dnet_dump_id(&cmd->id), err, strerror(-err));
-		goto err_out_exit;
-	}
+	free(b->config);
+	free(b->blob);
+	free(b);
+}
 
-	/* Existing entry */
-	offset = wc.data_offset;
-	size = wc.total_data_size;
-	fd = wc.data_fd;
+/*
+ * Opens bucket ending at @end in its own directory, which is created if it does not exist.
+ * Caches and filters of the bucket are disabled: location map already knows which keys it has.
+ */
+static int blob_ttl_bucket_open(struct eblob_backend_config *c, time_t end, struct eblob_ttl_bucket **bucket)
+{
+	struct eblob_ttl *t = c->ttl;
+	struct eblob_ttl_bucket *b;
+	char path[PATH_MAX];
+	int err;
 
-	/* Existing new-format entry */
-	if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
-		struct dnet_ext_list_hdr ehdr;
+	b = calloc(1, sizeof(struct eblob_ttl_bucket));
+	if (!b) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
 
-		/* Sanity */
-		if (size < ehdr_size) {
-			err = -ERANGE;
-			goto err_out_exit;
-		}
+	b->end = end;
+	snprintf(b->dir, sizeof(b->dir), "%s/%lld", t->dir, (long long)end);
+	snprintf(path, sizeof(path), "%s/data", b->dir);
 
-		err = dnet_ext_hdr_read(&ehdr, fd, offset);
-		if (err != 0)
-			goto err_out_exit;
-		dnet_ext_hdr_to_list(&ehdr, &elist);
+	if (mkdir(b->dir, 0755) && errno != EEXIST) {
+		err = -errno;
+		goto err_out_free;
+	}
 
-		/* Take into an account extended header's len */
-		size -= ehdr_size;
-		offset += ehdr_size;
-		record_offset += sizeof(struct dnet_ext_list_hdr);
+	b->config = calloc(1, sizeof(struct dnet_config_backend));
+	b->blob = calloc(1, sizeof(struct eblob_backend_config));
+	if (!b->config || !b->blob) {
+		err = -ENOMEM;
+		goto err_out_free;
 	}
 
-	if (size == 0) {
-		err = -ENOENT;
-		dnet_backend_log(c->blog, DNET_LOG_INFO, "%s: EBLOB: blob-file-info: info-read: ZERO-SIZE-FILE.",
-				dnet_dump_id(&cmd->id));
-		goto err_out_exit;
+	*b->blob = t->options;
+	b->blob->data.file = strdup(path);
+	b->blob->data.chunks_dir = NULL;
+	b->blob->ttl_bucket_seconds = 0;
+	b->blob->ttl_bucket_end = end;
+	b->blob->dedup_threshold = 0;
+	b->blob->lookup_cache_size = 0;
+	b->blob->absent_cache_size = 0;
+	b->blob->key_filter_capacity = 0;
+	b->blob->compact_index = 0;
+	b->blob->async_io_depth = 0;
+
+	*b->config = *dnet_eblob_backend_info();
+	b->config->data = b->blob;
+	b->config->log = c->blog;
+
+	if (!b->blob->data.file) {
+		err = -ENOMEM;
+		goto err_out_free;
 	}
 
-	/* Validate record's data if its checksum is requested */
-	if (cmd->flags & DNET_FLAGS_CHECKSUM) {
-		wc.offset = record_offset;
-		wc.size = size;
-		err = eblob_verify_checksum(b, &key, &wc);
-		if (err) {
-			goto err_out_exit;
-		}
+	err = b->config->init(b->config);
+	if (err) {
+		/* config of failed bucket is only freed */
+		b->config->cleanup(b->config);
+		free(b->config);
+		b->config = NULL;
+		goto err_out_free;
 	}
 
-	err = dnet_send_file_info_ts(state, cmd, fd, offset, size, &elist.timestamp, wc.flags);
+	*bucket = b;
+	return 0;
 
+err_out_free:
+	dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: ttl: could not open bucket %s: %d.", b->dir, err);
+	blob_ttl_bucket_free(b);
 err_out_exit:
-	dnet_ext_list_destroy(&elist);
 	return err;
 }
 
-static int eblob_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize) {
-	struct eblob_backend_config *c = priv;
-	struct eblob_backend *b = c->eblob;
-	struct eblob_write_control wc;
-	struct eblob_key key;
-	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
-	int err;
+/* inserts @b into the list sorted by ends, called with @lock held */
+static void blob_ttl_bucket_link(struct eblob_ttl *t, struct eblob_ttl_bucket *b)
+{
+	struct eblob_ttl_bucket **pos = &t->buckets;
 
-	memcpy(key.id, id->id, EBLOB_ID_SIZE);
-	err = blob_lookup(b, &key, &wc);
-	if (err < 0) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-checksum: read: %d: %s.",
-							dnet_dump_id_str(id->id), err, strerror(-err));
-		goto err_out_exit;
-	}
-	err = 0;
+	while (*pos && (*pos)->end < b->end)
+		pos = &(*pos)->next;
 
-	if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
-		/* Sanity */
-		if (wc.total_data_size < ehdr_size) {
-			err = -EINVAL;
-			goto err_out_exit;
+	b->next = *pos;
+	*pos = b;
+	t->bucket_num++;
+}
+
+/*
+ * Grabs bucket ending at @end, it is created if @create is set.
+ * Returns -ENOENT if there is no such bucket, for example it has already expired.
+ */
+static int blob_ttl_bucket_get(struct eblob_backend_config *c, time_t end, int create, struct eblob_ttl_bucket **bucket)
+{
+	struct eblob_ttl *t = c->ttl;
+	struct eblob_ttl_bucket *b;
+	int err = 0;
+
+	pthread_mutex_lock(&t->lock);
+	for (b = t->buckets; b && b->end < end; b = b->next)
+		;
+
+	if (!b || b->end != end) {
+		if (!create) {
+			err = -ENOENT;
+			goto err_out_unlock;
 		}
-		wc.data_offset += ehdr_size;
-		wc.total_data_size -= ehdr_size;
+
+		/* buckets are created rarely, once per bucket seconds, so writers wait for it under the lock */
+		err = blob_ttl_bucket_open(c, end, &b);
+		if (err)
+			goto err_out_unlock;
+
+		blob_ttl_bucket_link(t, b);
+		__sync_add_and_fetch(&t->stat.created, 1);
+
+		dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: ttl: created bucket %s.", b->dir);
 	}
 
-	if (wc.total_data_size == 0)
-		memset(csum, 0, *csize);
-	else
-		err = dnet_checksum_fd(n, wc.data_fd, wc.data_offset,
-				wc.total_data_size, csum, *csize);
+	b->refs++;
+	*bucket = b;
 
-err_out_exit:
+err_out_unlock:
+	pthread_mutex_unlock(&t->lock);
 	return err;
 }
 
-static int eblob_backend_lookup(struct dnet_node *n, void *priv, struct dnet_io_local *io)
+static void blob_ttl_bucket_put(struct eblob_ttl *t, struct eblob_ttl_bucket *b)
 {
-	struct eblob_backend_config *c = priv;
-	struct eblob_backend *b = c->eblob;
-	struct eblob_key key;
-	struct dnet_ext_list_hdr ehdr;
-	struct dnet_ext_list elist;
-	struct eblob_write_control wc = { .data_fd = -1 };
-	uint64_t size, offset;
+	pthread_mutex_lock(&t->lock);
+	if (--b->refs == 0)
+		pthread_cond_broadcast(&t->wait);
+	pthread_mutex_unlock(&t->lock);
+}
+
+/* closes bucket which is not in the list anymore and removes its directory */
+static void blob_ttl_bucket_remove(struct eblob_backend_config *c, struct eblob_ttl_bucket *b)
+{
+	struct eblob_ttl *t = c->ttl;
+	uint64_t records = eblob_backend_total_elements(b->blob);
 	int err;
 
-	(void) n;
-	memcpy(key.id, io->key, EBLOB_ID_SIZE);
+	b->config->cleanup(b->config);
+	free(b->config);
+	b->config = NULL;
 
-	dnet_ext_list_init(&elist);
+	err = nftw(b->dir, blob_ttl_remove_dir_entry, 16, FTW_DEPTH | FTW_PHYS);
 
-	err = blob_lookup(b, &key, &wc);
-	if (err < 0) {
-		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-backend-lookup: LOOKUP: %d: %s",
-			 dnet_dump_id_str(io->key), err, strerror(-err));
-		goto err_out_exit;
-	}
+	__sync_add_and_fetch(&t->stat.removed, 1);
+	__sync_add_and_fetch(&t->stat.removed_records, records);
 
-	io->record_flags = wc.flags;
-	io->fd = wc.data_fd;
+	dnet_backend_log(c->blog, err ? DNET_LOG_ERROR : DNET_LOG_INFO,
+			"blob: ttl: removed expired bucket %s, records: %" PRIu64 ": %d.", b->dir, records, err);
 
-	size = wc.total_data_size;
-	offset = wc.data_offset;
+	blob_ttl_bucket_free(b);
+}
 
-	if (!(wc.flags & BLOB_DISK_CTL_EXTHDR)) {
-		err = 0;
-		goto err_out_set_sizes;
+/*
+ * Removes buckets whose records have all expired, waiting for commands which still hold them.
+ * Commands do not find them anymore once they are unlinked from the list.
+ */
+static void blob_ttl_expire(struct eblob_backend_config *c)
+{
+	struct eblob_ttl *t = c->ttl;
+	struct eblob_ttl_bucket *b;
+	time_t now = time(NULL);
+	int removed = 0;
+
+	pthread_mutex_lock(&t->lock);
+	while (t->buckets && t->buckets->end <= now) {
+		b = t->buckets;
+		t->buckets = b->next;
+		t->bucket_num--;
+
+		while (b->refs)
+			pthread_cond_wait(&t->wait, &t->lock);
+
+		pthread_mutex_unlock(&t->lock);
+		blob_ttl_bucket_remove(c, b);
+		removed++;
+		pthread_mutex_lock(&t->lock);
 	}
+	pthread_mutex_unlock(&t->lock);
 
-	/* Sanity */
-	if (wc.total_data_size < sizeof(struct dnet_ext_list_hdr)) {
-		err = -ERANGE;
-		goto err_out_set_sizes;
+	if (removed)
+		blob_ttl_sweep(t, now);
+}
+
+static void *blob_ttl_expire_process(void *data)
+{
+	struct eblob_backend_config *c = data;
+	struct eblob_ttl *t = c->ttl;
+	struct timespec deadline;
+
+	dnet_set_name("dnet_blob_ttl");
+
+	pthread_mutex_lock(&t->lock);
+	while (!t->need_exit) {
+		/* checking the first bucket is cheap, buckets are removed within a second of their end */
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += 1;
+
+		pthread_cond_timedwait(&t->wait, &t->lock, &deadline);
+		if (t->need_exit)
+			break;
+
+		pthread_mutex_unlock(&t->lock);
+		blob_ttl_expire(c);
+		pthread_mutex_lock(&t->lock);
 	}
+	pthread_mutex_unlock(&t->lock);
 
-	err = dnet_ext_hdr_read(&ehdr, wc.data_fd, wc.data_offset);
-	if (err != 0)
-		goto err_out_set_sizes;
+	return NULL;
+}
 
-	dnet_ext_hdr_to_list(&ehdr, &elist);
+static int blob_ttl_end_compare(const void *e1, const void *e2)
+{
+	const time_t *end1 = e1, *end2 = e2;
 
-	io->timestamp = elist.timestamp;
-	io->user_flags = elist.flags;
+	return (*end1 > *end2) - (*end1 < *end2);
+}
 
-	size -= sizeof(struct dnet_ext_list_hdr);
-	offset += sizeof(struct dnet_ext_list_hdr);
+struct blob_ttl_scan {
+	struct eblob_ttl		*ttl;
+	time_t				end;
+};
 
-	err = 0;
+/* location map does not survive restart, it is filled from indexes of buckets */
+static int blob_ttl_scan_callback(struct eblob_disk_control *dc, struct eblob_ram_control *rctl __unused,
+		int fd __unused, uint64_t data_offset __unused, void *priv, void *thread_priv __unused)
+{
+	struct blob_ttl_scan *scan = priv;
 
-err_out_set_sizes:
-	io->total_size = size;
-	io->fd_offset = offset;
+	if (dc->flags & BLOB_DISK_CTL_REMOVE)
+		return 0;
 
-err_out_exit:
-	dnet_ext_list_destroy(&elist);
-	return err;
+	return blob_ttl_set_location(scan->ttl, &dc->key, scan->end);
 }
 
-static int blob_defrag_status(void *priv)
+static int blob_ttl_scan_bucket(struct eblob_ttl *t, struct eblob_ttl_bucket *b)
 {
-	struct eblob_backend_config *c = priv;
+	struct blob_ttl_scan scan = {
+		.ttl = t,
+		.end = b->end,
+	};
+	struct eblob_iterate_control eictl = {
+		.priv = &scan,
+		.b = b->blob->eblob,
+		.log = b->blob->data.log,
+		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
+		.thread_num = 1,
+		.iterator_cb = {
+			.iterator = blob_ttl_scan_callback,
+		},
+	};
 
-	return eblob_defrag_status(c->eblob);
+	return eblob_iterate(b->blob->eblob, &eictl);
 }
 
-static int blob_defrag_start(void *priv, enum dnet_backend_defrag_level level)
+/*
+ * Opens buckets left by previous run, ones which have expired meanwhile are removed right away.
+ * Buckets are opened in order of their ends, so that key found in several buckets is located in the latest one.
+ */
+static int blob_ttl_open_buckets(struct eblob_backend_config *c)
 {
-	struct eblob_backend_config *c = priv;
-	enum eblob_defrag_state defrag_level;
-	switch (level) {
-		case DNET_BACKEND_DEFRAG_FULL:
-			defrag_level = EBLOB_DEFRAG_STATE_DATA_SORT;
-			break;
-		case DNET_BACKEND_DEFRAG_COMPACT:
-			defrag_level = EBLOB_DEFRAG_STATE_DATA_COMPACT;
-			break;
-		default:
-			dnet_backend_log(c->blog, DNET_LOG_ERROR, "DEFRAG: unknown defragmetation level: %d", (int)level);
-			return -ENOTSUP;
+	struct eblob_ttl *t = c->ttl;
+	struct eblob_ttl_bucket *b;
+	struct dirent *ent;
+	time_t now = time(NULL), *ends = NULL, *tmp;
+	int i, num = 0, size = 0, err = 0;
+	char path[PATH_MAX];
+	DIR *dir;
+
+	dir = opendir(t->dir);
+	if (!dir)
+		return -errno;
+
+	while ((ent = readdir(dir)) != NULL) {
+		char *end;
+		long long value = strtoll(ent->d_name, &end, 10);
+
+		if (*end || end == ent->d_name || value <= 0)
+			continue;
+
+		if (value <= now) {
+			snprintf(path, sizeof(path), "%s/%s", t->dir, ent->d_name);
+			nftw(path, blob_ttl_remove_dir_entry, 16, FTW_DEPTH | FTW_PHYS);
+			dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: ttl: removed bucket %s expired while stopped.", path);
+			continue;
+		}
+
+		if (num == size) {
+			size = size ? size * 2 : 16;
+			tmp = realloc(ends, size * sizeof(time_t));
+			if (!tmp) {
+				err = -ENOMEM;
+				goto err_out_close;
+			}
+			ends = tmp;
+		}
+		ends[num++] = value;
 	}
 
-	int err = eblob_start_defrag_level(c->eblob, defrag_level);
+	qsort(ends, num, sizeof(time_t), blob_ttl_end_compare);
 
-	dnet_backend_log(c->blog, DNET_LOG_INFO, "DEFRAG: defragmetation request: status: %d", err);
+	for (i = 0; i < num; ++i) {
+		err = blob_ttl_bucket_open(c, ends[i], &b);
+		if (err)
+			goto err_out_close;
+
+		blob_ttl_bucket_link(t, b);
+
+		err = blob_ttl_scan_bucket(t, b);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: ttl: could not scan bucket %s: %d.", b->dir, err);
+			goto err_out_close;
+		}
+	}
 
+err_out_close:
+	free(ends);
+	closedir(dir);
 	return err;
 }
 
-static int blob_defrag_stop(void *priv)
+static void blob_ttl_destroy(struct eblob_backend_config *c)
 {
-	struct eblob_backend_config *c = priv;
+	struct eblob_ttl *t = c->ttl;
+	struct eblob_ttl_bucket *b;
+	struct rb_node *n;
+	int i;
 
-	return eblob_stop_defrag(c->eblob);
+	if (!t)
+		return;
+
+	if (t->expire_started) {
+		pthread_mutex_lock(&t->lock);
+		t->need_exit = 1;
+		pthread_cond_broadcast(&t->wait);
+		pthread_mutex_unlock(&t->lock);
+
+		pthread_join(t->expire_thread, NULL);
+	}
+
+	while ((b = t->buckets) != NULL) {
+		t->buckets = b->next;
+		blob_ttl_bucket_free(b);
+	}
+
+	for (i = 0; i < EBLOB_TTL_SHARDS; ++i) {
+		struct eblob_ttl_shard *s = &t->shards[i];
+
+		while ((n = rb_first(&s->root)) != NULL)
+			blob_ttl_entry_erase(s, rb_entry(n, struct eblob_ttl_entry, node));
+
+		pthread_mutex_destroy(&s->lock);
+	}
+
+	pthread_cond_destroy(&t->wait);
+	pthread_mutex_destroy(&t->lock);
+
+	free(t);
+	c->ttl = NULL;
 }
 
-static int blob_send_reply(void *state, struct dnet_cmd *cmd, struct dnet_iterator_response *re, int more)
+/*
+ * Remembers options buckets are configured by, must be called before @c is initialized
+ */
+static int blob_ttl_prepare(struct eblob_backend_config *c)
 {
-	int err;
+	struct eblob_ttl *t;
 
-	dnet_convert_iterator_response(re);
-	err = dnet_send_reply_threshold(state, cmd, re, sizeof(struct dnet_iterator_response), more);
+	if (!c->ttl_bucket_seconds)
+		return 0;
 
-	/* we have to convert response back, since it can be reused, for example like error response */
-	dnet_convert_iterator_response(re);
-	return err;
+	if (c->ttl_bucket_seconds < 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: ttl: invalid bucket seconds: %ld.", c->ttl_bucket_seconds);
+		return -EINVAL;
+	}
+
+	t = calloc(1, sizeof(struct eblob_ttl));
+	if (!t)
+		return -ENOMEM;
+
+	t->options = *c;
+	snprintf(t->dir, sizeof(t->dir), "%s.ttl", c->data.file);
+
+	c->ttl = t;
+	return 0;
 }
 
-static int blob_send(struct eblob_backend_config *cfg, void *state, struct dnet_cmd *cmd, void *data)
+static int blob_ttl_init(struct eblob_backend_config *c)
 {
-	struct eblob_backend *b = cfg->eblob;
-	struct dnet_server_send_request *req = data;
-	struct dnet_raw_id *ids;
-	struct dnet_iterator_response re;
-	struct dnet_server_send_ctl *ctl;
-	int *groups;
+	struct eblob_ttl *t = c->ttl;
 	int i, err;
-	int backend_id;
 
-	struct dnet_ext_list elist;
-	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
-	struct eblob_key key;
-	struct eblob_write_control wc;
-	uint64_t data_offset, record_offset;
-
-	dnet_ext_list_init(&elist);
+	err = pthread_mutex_init(&t->lock, NULL);
+	if (err)
+		goto err_out_free;
 
+	err = pthread_cond_init(&t->wait, NULL);
+	if (err)
+		goto err_out_lock_destroy;
 
-	/* structure has been already checked and has been proved to be correct no need to perform sanity checks */
-	dnet_convert_server_send_request(req);
+	for (i = 0; i < EBLOB_TTL_SHARDS; ++i) {
+		err = pthread_mutex_init(&t->shards[i].lock, NULL);
+		if (err) {
+			while (--i >= 0)
+				pthread_mutex_destroy(&t->shards[i].lock);
+			goto err_out_cond_destroy;
+		}
+		t->shards[i].root = RB_ROOT;
+	}
 
-	ids = (struct dnet_raw_id *)(req + 1);
-	groups = (int *)(ids + req->id_num);
+	/* from here on blob_ttl_destroy() cleans up everything */
+	if (mkdir(t->dir, 0755) && errno != EEXIST) {
+		err = -errno;
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: ttl: could not create %s: %d.", t->dir, err);
+		goto err_out_destroy;
+	}
 
-	/*
-	 * Set NEED_ACK bit to signal server-send controller that we want
-	 * to send final ACK when controller will be destroyed, which in turn
-	 * will happen after all WRITE commands are completed.
-	 *
-	 * Command will be copied internally in @dnet_server_send_alloc(),
-	 * thus it is safe to clear that bit afterward.
-	 */
-	cmd->flags |= DNET_FLAGS_NEED_ACK;
+	err = blob_ttl_open_buckets(c);
+	if (err)
+		goto err_out_destroy;
 
-	backend_id = cfg->data.stat_id;
-	ctl = dnet_server_send_alloc(state, cmd, groups, req->group_num);
-	if (!ctl) {
-		err = -ENOMEM;
-		goto err_out_exit;
+	err = pthread_create(&t->expire_thread, NULL, blob_ttl_expire_process, c);
+	if (err) {
+		err = -err;
+		goto err_out_destroy;
 	}
+	t->expire_started = 1;
 
-	ctl->iflags = req->iflags;
-	ctl->backend_id = backend_id;
-	ctl->timeout = req->timeout;
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: ttl: %s: bucket seconds: %ld, buckets: %d.",
+			t->dir, c->ttl_bucket_seconds, t->bucket_num);
+	return 0;
 
-	/*
-	 * Deliberately clear NEED_ACK bit
-	 * This function will iterate over provided ids,
-	 * read them from the blob and queue WRITE command to remote groups.
-	 * When single WRITE command completes, it will send response back to client.
-	 *
-	 * If we send ACK in the middle, it will force client to stop accepting further responses.
-	 *
-	 * If there will be an error, it will be sent to client too.
-	 * If there is an error with command processing (like fail to allocate memory),
-	 * iteration will stop and error will be returned from this function to the higher layer,
-	 * which in turn will force ACK message to client with error code.
-	 */
-	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+err_out_destroy:
+	blob_ttl_destroy(c);
+	return err;
 
+err_out_cond_destroy:
+	pthread_cond_destroy(&t->wait);
+err_out_lock_destroy:
+	pthread_mutex_destroy(&t->lock);
+err_out_free:
+	free(t);
+	c->ttl = NULL;
+	return err > 0 ? -err : err;
+}
 
+/*
+ * Commands
+ */
 
-	for (i = 0; i < req->id_num; ++i) {
-		memset(&re, 0, sizeof(struct dnet_iterator_response));
-		// set iterator response id to differentiate various commands
-		// client can use cmd->backend_id from reply though
-		re.id = cmd->backend_id;
-		re.key = ids[i];
-		re.iterated_keys = i;
-		re.total_keys = req->id_num;
+static int blob_ttl_bucket_command(struct eblob_backend_config *c, time_t end, void *state,
+		struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_ttl_bucket *b;
+	int err;
 
-		memcpy(key.id, ids[i].id, EBLOB_ID_SIZE);
+	err = blob_ttl_bucket_get(c, end, 0, &b);
+	if (err)
+		return err;
 
-		err = blob_lookup(b, &key, &wc);
-		if (err < 0) {
-			dnet_backend_log(cfg->blog, DNET_LOG_ERROR, "%s: EBLOB: blob_send: lookup: %d: %s",
-					 dnet_dump_id_str(key.id), err, strerror(-err));
-			goto err_out_send_fail_reply;
-		}
+	err = eblob_backend_command_handler_raw(state, b->blob, cmd, data);
 
-		re.flags = wc.flags; // these flags correspond to DNET_RECORD_FLAGS_*
-		re.size = wc.total_data_size;
+	blob_ttl_bucket_put(c->ttl, b);
+	return err;
+}
 
-		data_offset = wc.data_offset;
-		record_offset = 0;
+static int blob_ttl_write(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_ttl *t = c->ttl;
+	struct dnet_io_attr io = *(struct dnet_io_attr *)data;
+	struct eblob_ttl_bucket *b;
+	struct eblob_key key;
+	time_t prev, end;
+	int partial, err;
 
-		if ((wc.flags & BLOB_DISK_CTL_EXTHDR) != 0) {
-			struct dnet_ext_list_hdr ehdr;
+	dnet_convert_io_attr(&io);
+	memcpy(key.id, io.id, EBLOB_ID_SIZE);
 
-			/* Sanity */
-			if (re.size < ehdr_size) {
-				err = -ERANGE;
-				goto err_out_send_fail_reply;
-			}
+	prev = blob_ttl_location(t, &key);
 
-			err = dnet_ext_hdr_read(&ehdr, wc.data_fd, wc.data_offset);
-			if (err != 0)
-				goto err_out_send_fail_reply;
+	/* record which is not rewritten as a whole stays where it is, its lifetime is set by its first write */
+	partial = !(io.flags & DNET_IO_FLAGS_PREPARE) &&
+		(io.offset || (io.flags & (DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_COMMIT)));
+	if (partial)
+		end = prev;
+	else
+		end = io.start ? blob_ttl_bucket_end(c, time(NULL) + io.start) : 0;
 
-			dnet_ext_hdr_to_list(&ehdr, &elist);
+	if (end) {
+		err = blob_ttl_bucket_get(c, end, !partial, &b);
+		if (err)
+			return err;
 
-			re.timestamp = elist.timestamp;
-			re.user_flags = elist.flags;
+		err = eblob_backend_command_handler_raw(state, b->blob, cmd, data);
+		blob_ttl_bucket_put(t, b);
+	} else {
+		err = eblob_backend_command_handler_raw(state, c, cmd, data);
+	}
 
-			/* Take into an account extended header's len */
-			re.size -= sizeof(struct dnet_ext_list_hdr);
-			data_offset += sizeof(struct dnet_ext_list_hdr);
-			record_offset += sizeof(struct dnet_ext_list_hdr);
-		}
+	if (err || end == prev)
+		return err;
 
-		wc.offset = record_offset;
-		wc.size = re.size;
-		err = eblob_verify_checksum(b, &key, &wc);
-		if (err)
-			goto err_out_send_fail_reply;
+	/* readers see the key in its new place before stale copy is removed */
+	err = blob_ttl_set_location(t, &key, end);
+	if (err)
+		return err;
 
-		err = dnet_server_send_write(ctl, &re, sizeof(struct dnet_iterator_response), wc.data_fd, data_offset);
-		if (err)
-			goto err_out_send_fail_reply;
+	if (prev) {
+		if (!blob_ttl_bucket_get(c, prev, 0, &b)) {
+			dnet_blob_remove_record(b->blob, &key);
+			blob_ttl_bucket_put(t, b);
+		}
+	} else if (!blob_key_absent(c, &key)) {
+		dnet_blob_remove_record(c, &key);
+	}
 
-		/* stop if an error is occurred during write */
-		if (ctl->write_error)
-			goto err_out_put;
+	return 0;
+}
 
-		continue;
+static int blob_ttl_del(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_key key;
+	time_t end;
+	int err;
 
-err_out_send_fail_reply:
-		re.status = err;
-		err = blob_send_reply(state, cmd, &re, 1);
+	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
 
-		// server has failed to send a reply to client, likely because of lack of memory
-		// we can not proceed with this request anymore, so its better to exit earlier
-		if (err)
-			goto err_out_put;
-	}
+	end = blob_ttl_location(c->ttl, &key);
+	if (!end)
+		return eblob_backend_command_handler_raw(state, c, cmd, data);
 
-	err = 0;
+	err = blob_ttl_bucket_command(c, end, state, cmd, data);
+	if (!err || err == -ENOENT)
+		blob_ttl_set_location(c->ttl, &key, 0);
 
-err_out_put:
-	dnet_server_send_put(ctl);
-err_out_exit:
 	return err;
 }
 
-static int eblob_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+/* keys of server-send request are sent by a single controller, so they all must be in the same eblob */
+static int blob_ttl_send(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
 {
-	FORMATTED(HANDY_TIMER_SCOPE, ("eblob_backend.cmd.%s", dnet_cmd_string(cmd->cmd)));
+	struct dnet_server_send_request req = *(struct dnet_server_send_request *)data;
+	struct dnet_raw_id *ids = (struct dnet_raw_id *)((struct dnet_server_send_request *)data + 1);
+	struct eblob_key key;
+	time_t end = 0, e;
+	int i;
 
-	int err;
-	struct eblob_backend_config *c = priv;
+	dnet_convert_server_send_request(&req);
+
+	for (i = 0; i < req.id_num; ++i) {
+		memcpy(key.id, ids[i].id, EBLOB_ID_SIZE);
+
+		e = blob_ttl_location(c->ttl, &key);
+		if (i && e != end) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: EBLOB: ttl: server-send: keys of the request "
+					"have different lifetimes, send them by separate requests", dnet_dump_id(&cmd->id));
+			return -ENOTSUP;
+		}
+		end = e;
+	}
+
+	if (end)
+		return blob_ttl_bucket_command(c, end, state, cmd, data);
+
+	return eblob_backend_command_handler_raw(state, c, cmd, data);
+}
+
+static int blob_ttl_command(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct eblob_key key;
+	time_t end;
 
 	switch (cmd->cmd) {
 		case DNET_CMD_LOOKUP:
-			err = blob_file_info(c, state, cmd);
-			break;
-		case DNET_CMD_WRITE:
-			err = blob_write(c, state, cmd, data);
-			break;
 		case DNET_CMD_READ:
-			err = blob_read(c, state, cmd, data, 1);
-			break;
-		case DNET_CMD_READ_RANGE:
-		case DNET_CMD_DEL_RANGE:
-			err = blob_read_range(c, state, cmd, data);
+			memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+
+			end = blob_ttl_location(c->ttl, &key);
+			if (end)
+				return blob_ttl_bucket_command(c, end, state, cmd, data);
 			break;
+		case DNET_CMD_WRITE:
+			return blob_ttl_write(c, state, cmd, data);
 		case DNET_CMD_DEL:
-			err = blob_del(c, cmd);
-			break;
+			return blob_ttl_del(c, state, cmd, data);
 		case DNET_CMD_SEND:
-			err = blob_send(c, state, cmd, data);
-			break;
+			return blob_ttl_send(c, state, cmd, data);
 		default:
-			err = -ENOTSUP;
+			/* range requests and blob files are served by the main eblob only */
 			break;
 	}
 
-	return err;
+	return eblob_backend_command_handler_raw(state, c, cmd, data);
 }
 
-static int dnet_blob_set_sync(struct dnet_config_backend *b,
-                              const char *key __unused, const char *value)
+static int blob_ttl_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
 {
-	struct eblob_backend_config *c = b->data;
+	int err;
 
-	c->data.sync = atoi(value);
-	return 0;
+	DNET_PROBE_CMD(backend__start, state, cmd, (int)cmd->backend_id);
+
+	err = blob_ttl_command(priv, state, cmd, data);
+
+	DNET_PROBE_CMD(backend__done, state, cmd, (int)cmd->backend_id, err);
+	return err;
 }
 
-static int dnet_blob_set_data(struct dnet_config_backend *b,
-                              const char *key __unused, const char *file)
+/*
+ * Backend callbacks
+ */
+
+static int blob_ttl_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize)
 {
-	struct eblob_backend_config *c = b->data;
+	struct eblob_backend_config *c = priv;
+	struct eblob_ttl_bucket *b;
+	struct eblob_key key;
+	time_t end;
 	int err;
 
-	err = backend_storage_size(b, file);
-	if (err) {
-		char root[strlen(file)+1], *ptr;
+	memcpy(key.id, id->id, EBLOB_ID_SIZE);
 
-		snprintf(root, sizeof(root), "%s", file);
-		ptr = strrchr(root, '/');
-		if (ptr) {
-			*ptr = '\0';
-			err = backend_storage_size(b, root);
-		}
+	end = blob_ttl_location(c->ttl, &key);
+	if (!end)
+		return eblob_backend_checksum(n, c, id, csum, csize);
 
-		if (err)
-			return err;
-	}
+	err = blob_ttl_bucket_get(c, end, 0, &b);
+	if (err)
+		return err;
 
-	free(c->data.file);
-	c->data.file = strdup(file);
-	if (!c->data.file)
-		return -ENOMEM;
+	err = eblob_backend_checksum(n, b->blob, id, csum, csize);
 
-	return 0;
+	blob_ttl_bucket_put(c->ttl, b);
+	return err;
 }
 
-static int dnet_blob_set_datasort_dir(struct dnet_config_backend *b,
-				      const char *key __unused, const char *dir)
+/* descriptor of bucket's record stays valid after the bucket is put, bucket is closed only once it has expired */
+static int blob_ttl_lookup(struct dnet_node *n, void *priv, struct dnet_io_local *io)
 {
-	struct eblob_backend_config *c = b->data;
-	struct stat st;
+	struct eblob_backend_config *c = priv;
+	struct eblob_ttl_bucket *b;
+	struct eblob_key key;
+	time_t end;
 	int err;
 
-	err = stat(dir, &st);
-	if (err == -1)
-		return -errno;
+	memcpy(key.id, io->key, EBLOB_ID_SIZE);
 
-	if (!S_ISDIR(st.st_mode))
-		return -ENOTDIR;
+	end = blob_ttl_location(c->ttl, &key);
+	if (!end)
+		return eblob_backend_lookup(n, c, io);
 
-	free(c->data.chunks_dir);
-	c->data.chunks_dir = strdup(dir);
-	if (!c->data.chunks_dir)
-		return -ENOMEM;
+	err = blob_ttl_bucket_get(c, end, 0, &b);
+	if (err)
+		return err;
 
-	return 0;
+	err = eblob_backend_lookup(n, b->blob, io);
+
+	blob_ttl_bucket_put(c->ttl, b);
+	return err;
 }
 
-static int dnet_blob_set_blob_size(struct dnet_config_backend *b,
-                                   const char *key, const char *value)
+/* streamed record is reserved where the key is, new keys are streamed into the main eblob without lifetime */
+static int blob_ttl_write_stream_prepare(void *priv, struct dnet_io_attr *io, int *fd, uint64_t *offset)
 {
-	struct eblob_backend_config *c = b->data;
-	uint64_t val = strtoul(value, NULL, 0);
+	struct eblob_backend_config *c = priv;
+	struct eblob_ttl_bucket *b;
+	struct eblob_key key;
+	time_t end;
+	int err;
 
-	if (strchr(value, 'T') || strchr(value, 't'))
-		val *= 1024*1024*1024*1024ULL;
-	else if (strchr(value, 'G') || strchr(value, 'g'))
-		val *= 1024*1024*1024ULL;
-	else if (strchr(value, 'M') || strchr(value, 'm'))
-		val *= 1024*1024;
-	else if (strchr(value, 'K') || strchr(value, 'k'))
-		val *= 1024;
+	memcpy(key.id, io->id, EBLOB_ID_SIZE);
 
-	if (!strcmp(key, "blob_size"))
-		c->data.blob_size = val;
-	else if (!strcmp(key, "blob_size_limit"))
-		c->data.blob_size_limit = val;
+	end = blob_ttl_location(c->ttl, &key);
+	if (!end)
+		return eblob_backend_write_stream_prepare(c, io, fd, offset);
 
-	return 0;
-}
+	err = blob_ttl_bucket_get(c, end, 0, &b);
+	if (err)
+		return err;
 
-static int dnet_blob_set_index_block_size(struct dnet_config_backend *b,
-                                          const char *key __unused, const char *value)
-{
-	struct eblob_backend_config *c = b->data;
+	err = eblob_backend_write_stream_prepare(b->blob, io, fd, offset);
 
-	c->data.index_block_size = strtoul(value, NULL, 0);
-	return 0;
+	blob_ttl_bucket_put(c->ttl, b);
+	return err;
 }
 
-static int dnet_blob_set_index_block_bloom_length(struct dnet_config_backend *b,
-                                                  const char *key __unused, const char *value)
+/* location map knows every key of buckets */
+static int blob_ttl_key_absent(void *priv, const struct dnet_raw_id *id)
 {
-	struct eblob_backend_config *c = b->data;
-
-	c->data.index_block_bloom_length = strtoul(value, NULL, 0);
-	return 0;
-}
+	struct eblob_backend_config *c = priv;
+	struct eblob_key key;
 
-static int dnet_blob_set_periodic_timeout(struct dnet_config_backend *b,
-                                          const char *key __unused, const char *value) {
-	struct eblob_backend_config *c = b->data;
+	memcpy(key.id, id->id, EBLOB_ID_SIZE);
+	if (blob_ttl_location(c->ttl, &key))
+		return 0;
 
-	c->data.periodic_timeout = strtoul(value, NULL, 0);
-	return 0;
+	return blob_key_absent(c, &key);
 }
 
-static int dnet_blob_set_records_in_blob(struct dnet_config_backend *b,
-                                         const char *key __unused, const char *value)
+/* grabs all buckets, returns their number or error */
+static int blob_ttl_buckets_get(struct eblob_ttl *t, struct eblob_ttl_bucket ***buckets)
 {
-	struct eblob_backend_config *c = b->data;
-	uint64_t val = strtoul(value, NULL, 0);
+	struct eblob_ttl_bucket *b, **array;
+	int num = 0;
+
+	pthread_mutex_lock(&t->lock);
+	array = malloc((t->bucket_num + 1) * sizeof(struct eblob_ttl_bucket *));
+	if (array) {
+		for (b = t->buckets; b; b = b->next) {
+			b->refs++;
+			array[num++] = b;
+		}
+	}
+	pthread_mutex_unlock(&t->lock);
 
-	c->data.records_in_blob = val;
-	return 0;
+	if (!array)
+		return -ENOMEM;
+
+	*buckets = array;
+	return num;
 }
 
-static int dnet_blob_set_defrag_timeout(struct dnet_config_backend *b,
-                                        const char *key __unused, const char *value)
+static void blob_ttl_buckets_put(struct eblob_ttl *t, struct eblob_ttl_bucket **buckets, int num)
 {
-	struct eblob_backend_config *c = b->data;
+	int i;
 
-	c->data.defrag_timeout = strtoul(value, NULL, 0);
-	return 0;
+	for (i = 0; i < num; ++i)
+		blob_ttl_bucket_put(t, buckets[i]);
+	free(buckets);
 }
 
-static int dnet_blob_set_defrag_time(struct dnet_config_backend *b,
-                                     const char *key __unused, const char *value)
+/* records of buckets are iterated after the main eblob, expired ones are skipped */
+static int blob_ttl_iterator(struct dnet_iterator_ctl *ictl, struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
 {
-	struct eblob_backend_config *c = b->data;
+	struct eblob_backend_config *c = ictl->iterate_private;
+	struct eblob_ttl_bucket **buckets;
+	struct dnet_iterator_ctl bctl = *ictl;
+	int i, num, err;
 
-	c->data.defrag_time = strtoul(value, NULL, 0);
-	return 0;
+	err = dnet_eblob_iterator(ictl, ireq, irange);
+	if (err)
+		return err;
+
+	num = blob_ttl_buckets_get(c->ttl, &buckets);
+	if (num < 0)
+		return num;
+
+	for (i = 0; i < num && !err; ++i) {
+		bctl.iterate_private = buckets[i]->blob;
+		err = dnet_eblob_iterator(&bctl, ireq, irange);
+	}
+
+	blob_ttl_buckets_put(c->ttl, buckets, num);
+	return err;
 }
 
-static int dnet_blob_set_defrag_splay(struct dnet_config_backend *b,
-                                      const char *key __unused, const char *value)
+static uint64_t blob_ttl_total_elements(void *priv)
 {
-	struct eblob_backend_config *c = b->data;
+	struct eblob_backend_config *c = priv;
+	struct eblob_ttl_bucket **buckets;
+	uint64_t total = eblob_backend_total_elements(c);
+	int i, num;
 
-	c->data.defrag_splay = strtoul(value, NULL, 0);
-	return 0;
+	num = blob_ttl_buckets_get(c->ttl, &buckets);
+	if (num < 0)
+		return total;
+
+	for (i = 0; i < num; ++i)
+		total += eblob_backend_total_elements(buckets[i]->blob);
+
+	blob_ttl_buckets_put(c->ttl, buckets, num);
+	return total;
 }
 
-static int dnet_blob_set_defrag_percentage(struct dnet_config_backend *b,
-                                           const char *key __unused, const char *value)
+/* records in buckets, they are not counted by eblob stats of the main eblob */
+uint64_t dnet_blob_ttl_records(struct eblob_backend_config *c)
 {
-	struct eblob_backend_config *c = b->data;
-
-	c->data.defrag_percentage = strtoul(value, NULL, 0);
-	return 0;
+	return blob_ttl_total_elements(c) - eblob_backend_total_elements(c);
 }
 
-static int dnet_blob_set_blob_flags(struct dnet_config_backend *b,
-                                    const char *key __unused, const char *value)
+#define EBLOB_DEDUP_CHUNK_SIZE_DEFAULT	(1024 * 1024)
+/* minimal chunk is a quarter of the average one and rolling hash needs 64 bytes before it */
+#define EBLOB_DEDUP_CHUNK_SIZE_MIN	4096
+
+static void blob_dedup_destroy(struct eblob_backend_config *c)
 {
-	struct eblob_backend_config *c = b->data;
+	struct eblob_dedup *d = c->dedup;
+	int i;
 
-	c->data.blob_flags = strtoul(value, NULL, 0);
-	return 0;
-}
+	if (!d)
+		return;
 
-static int dnet_blob_set_backend_id(struct dnet_config_backend *b,
-                                    const char *key __unused, const char *value) {
-	struct eblob_backend_config *c = b->data;
+	if (d->config && d->config->data)
+		d->config->cleanup(d->config);
 
-	c->data.stat_id = strtoul(value, NULL, 0);
-	return 0;
-}
+	free(d->config);
+	free(d->blob);
 
+	for (i = 0; i < EBLOB_DEDUP_LOCKS; ++i) {
+		pthread_mutex_destroy(&d->key_locks[i]);
+		pthread_mutex_destroy(&d->chunk_locks[i]);
+	}
 
-uint64_t eblob_backend_total_elements(void *priv) {
-	struct eblob_backend_config *r = priv;
-	return eblob_total_elements(r->eblob);
+	free(d);
+	c->dedup = NULL;
 }
 
-int eblob_backend_storage_stat_json(void *priv, char **json_stat, size_t *size)
+/*
+ * Remembers options chunk store is configured by, must be called before @c is initialized.
+ * Store is opened if deduplication is enabled or if it has been created before.
+ */
+static int blob_dedup_prepare(struct eblob_backend_config *c)
 {
-	int err;
-	struct eblob_backend_config *r = priv;
+	struct eblob_dedup *d;
+	char dir[PATH_MAX];
+	struct stat st;
 
-	err = eblob_stat_json_get(r->eblob, json_stat, size);
-	if (err) {
-		return err;
+	snprintf(dir, sizeof(dir), "%s.chunks", c->data.file);
+	if (!c->dedup_threshold && stat(dir, &st))
+		return 0;
+
+	if (!c->dedup_chunk_size)
+		c->dedup_chunk_size = EBLOB_DEDUP_CHUNK_SIZE_DEFAULT;
+
+	if (c->dedup_chunk_size < EBLOB_DEDUP_CHUNK_SIZE_MIN) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: dedup: chunk size %" PRIu64 " is less than %d.",
+				c->dedup_chunk_size, EBLOB_DEDUP_CHUNK_SIZE_MIN);
+		return -EINVAL;
 	}
 
+	d = calloc(1, sizeof(struct eblob_dedup));
+	if (!d)
+		return -ENOMEM;
+
+	d->options = *c;
+	memcpy(d->dir, dir, sizeof(d->dir));
+
+	c->dedup = d;
 	return 0;
 }
 
-static void eblob_backend_cleanup(void *priv)
+/*
+ * Opens chunk store, it is plain eblob without caches, filters and compression of its own.
+ * Chunks are never larger than @max_size, so they are always read through mmap.
+ */
+static int blob_dedup_init(struct eblob_backend_config *c)
 {
-	struct eblob_backend_config *c = priv;
-
-	eblob_cleanup(c->eblob);
+	struct eblob_dedup *d = c->dedup;
+	char path[PATH_MAX];
+	uint64_t seed = 0, z;
+	int i, bits, err;
+
+	for (i = 0; i < EBLOB_DEDUP_LOCKS; ++i) {
+		err = pthread_mutex_init(&d->key_locks[i], NULL);
+		if (!err) {
+			err = pthread_mutex_init(&d->chunk_locks[i], NULL);
+			if (err)
+				pthread_mutex_destroy(&d->key_locks[i]);
+		}
 
-	pthread_mutex_destroy(&c->last_read_lock);
-}
+		if (err) {
+			while (--i >= 0) {
+				pthread_mutex_destroy(&d->key_locks[i]);
+				pthread_mutex_destroy(&d->chunk_locks[i]);
+			}
+			free(d);
+			c->dedup = NULL;
+			return -err;
+		}
+	}
 
-static int dnet_eblob_iterator(struct dnet_iterator_ctl *ictl, struct dnet_iterator_request *ireq,
-		struct dnet_iterator_range *irange)
-{
-	struct eblob_index_block *range = NULL;
-	struct eblob_backend_config *c = ictl->iterate_private;
-	struct eblob_backend *b = c->eblob;
-	int err;
-	const int no_meta = ireq->flags & DNET_IFLAGS_NO_META && !(ireq->flags & (DNET_IFLAGS_TS_RANGE | DNET_IFLAGS_DATA));
+	/* from here on blob_dedup_destroy() cleans up everything */
 
-	/* Init iterator config */
-	struct eblob_iterate_control eictl = {
-		.priv = ictl,
-		.b = b,
-		.log = c->data.log,
-		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
-		.iterator_cb = {
-			.iterator = no_meta ? blob_iterate_callback_without_meta : blob_iterate_callback_with_meta,
-		},
-	};
+	/* table is fixed, otherwise chunks written before restart would never be shared again */
+	for (i = 0; i < 256; ++i) {
+		z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		d->gear[i] = z ^ (z >> 31);
+	}
 
-	if (ireq->itype == DNET_ITYPE_SERVER_SEND)
-		eictl.flags |= EBLOB_ITERATE_FLAGS_VERIFY_CHECKSUM;
+	d->min_size = c->dedup_chunk_size / 4;
+	d->max_size = c->dedup_chunk_size * 4;
+	for (bits = 0; (2ULL << bits) <= c->dedup_chunk_size - d->min_size; ++bits)
+		;
+	d->mask = ((1ULL << bits) - 1) << (64 - bits);
 
-	if (ireq->range_num) {
-		unsigned int i;
+	if (mkdir(d->dir, 0755) && errno != EEXIST) {
+		err = -errno;
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: dedup: could not create %s: %d.", d->dir, err);
+		goto err_out_destroy;
+	}
+	snprintf(path, sizeof(path), "%s/data", d->dir);
 
-		range = calloc(ireq->range_num, sizeof(struct eblob_index_block));
-		if (!range) {
-			err = -ENOMEM;
-			goto err_out_exit;
-		}
+	d->config = calloc(1, sizeof(struct dnet_config_backend));
+	d->blob = calloc(1, sizeof(struct eblob_backend_config));
+	if (!d->config || !d->blob) {
+		err = -ENOMEM;
+		goto err_out_destroy;
+	}
 
-		for (i = 0; i < ireq->range_num; ++i) {
-			memcpy(range[i].start_key.id, irange[i].key_begin.id, DNET_ID_SIZE);
-			memcpy(range[i].end_key.id, irange[i].key_end.id, DNET_ID_SIZE);
-		}
+	*d->blob = d->options;
+	d->blob->data.file = strdup(path);
+	d->blob->data.chunks_dir = NULL;
+	d->blob->ttl_bucket_seconds = 0;
+	d->blob->ttl = NULL;
+	d->blob->dedup_threshold = 0;
+	d->blob->dedup = NULL;
+	d->blob->compression = DNET_COMPRESSION_NONE;
+	d->blob->lookup_cache_size = 0;
+	d->blob->absent_cache_size = 0;
+	d->blob->key_filter_capacity = 0;
+	d->blob->compact_index = 0;
+	d->blob->async_io_depth = 0;
+	d->blob->mmap_read_threshold = d->max_size;
+
+	*d->config = *dnet_eblob_backend_info();
+	d->config->data = d->blob;
+	d->config->log = c->blog;
+
+	if (!d->blob->data.file) {
+		err = -ENOMEM;
+		goto err_out_destroy;
+	}
 
-		eictl.range = range;
-		eictl.range_num = ireq->range_num;
+	err = d->config->init(d->config);
+	if (err) {
+		/* config of failed store is only freed */
+		d->config->cleanup(d->config);
+		free(d->config);
+		d->config = NULL;
+		goto err_out_destroy;
 	}
 
-	err = eblob_iterate(b, &eictl);
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: dedup: %s: threshold: %" PRIu64 ", chunk size: %" PRIu64
+			", chunks: %" PRIu64 ".", d->dir, c->dedup_threshold, c->dedup_chunk_size,
+			eblob_backend_total_elements(d->blob));
+	return 0;
 
-	free(range);
-err_out_exit:
+err_out_destroy:
+	blob_dedup_destroy(c);
 	return err;
 }
 
@@ -1464,11 +6174,69 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 
 	c->data.log = &c->log;
 
+	err = blob_ttl_prepare(c);
+	if (err)
+		goto err_out_exit;
+
+	err = blob_dedup_prepare(c);
+	if (err)
+		goto err_out_prepared_free;
+
 	err = pthread_mutex_init(&c->last_read_lock, NULL);
 	if (err) {
 		err = -err;
 		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create last-read lock: %d.", err);
-		goto err_out_exit;
+		goto err_out_prepared_free;
+	}
+
+	err = pthread_mutex_init(&c->mmap_lock, NULL);
+	if (err) {
+		err = -err;
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create mmap lock: %d.", err);
+		pthread_mutex_destroy(&c->last_read_lock);
+		goto err_out_prepared_free;
+	}
+
+	memset(c->path_cache, 0, sizeof(c->path_cache));
+	err = pthread_mutex_init(&c->path_cache_lock, NULL);
+	if (err) {
+		err = -err;
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create path cache lock: %d.", err);
+		pthread_mutex_destroy(&c->mmap_lock);
+		pthread_mutex_destroy(&c->last_read_lock);
+		goto err_out_prepared_free;
+	}
+
+	err = blob_lookup_cache_init(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create lookup cache of %" PRIu64 " entries: %d.",
+				c->lookup_cache_size, err);
+		goto err_out_last_read_lock_destroy;
+	}
+
+	err = blob_absent_cache_init(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create absent cache of %" PRIu64 " entries: %d.",
+				c->absent_cache_size, err);
+		goto err_out_last_read_lock_destroy;
+	}
+
+	err = blob_group_commit_init(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not initialize group commit: %d.", err);
+		goto err_out_last_read_lock_destroy;
+	}
+
+	if (c->async_io_depth) {
+		err = dnet_uring_create(c->async_io_depth, &c->uring);
+		if (err) {
+			/* reads are done by io threads if the kernel does not support io_uring */
+			dnet_backend_log(c->blog, err == -ENOTSUP ? DNET_LOG_NOTICE : DNET_LOG_ERROR,
+					"blob: could not create io_uring of %u reads, asynchronous reads are disabled: %d.",
+					c->async_io_depth, err);
+			c->uring = NULL;
+			err = 0;
+		}
 	}
 
 	c->eblob = eblob_init(&c->data);
@@ -1486,8 +6254,28 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 
 	eblob_set_trace_id_function(&get_trace_id);
 
+	err = blob_key_filter_init(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not fill key filter of %" PRIu64 " keys: %d.",
+				c->key_filter_capacity, err);
+		goto err_out_last_read_lock_destroy;
+	}
+
+	err = blob_compact_init(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not build compact index: %d.", err);
+		goto err_out_last_read_lock_destroy;
+	}
+
 	c->vm_total = st.vm_total * st.vm_total * 1024 * 1024;
 
+	c->cmd_metrics = dnet_cmd_metrics_register("eblob_backend.cmd.");
+	if (c->cmd_metrics < 0) {
+		err = c->cmd_metrics;
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not register command metrics: %d.", err);
+		goto err_out_last_read_lock_destroy;
+	}
+
 	b->cb.storage_stat_json = eblob_backend_storage_stat_json;
 	b->cb.total_elements = eblob_backend_total_elements;
 
@@ -1496,17 +6284,63 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 	b->cb.backend_cleanup = eblob_backend_cleanup;
 	b->cb.checksum = eblob_backend_checksum;
 	b->cb.lookup = eblob_backend_lookup;
+	b->cb.write_stream_prepare = eblob_backend_write_stream_prepare;
 
 	b->cb.iterator = dnet_eblob_iterator;
 
 	b->cb.defrag_start = blob_defrag_start;
 	b->cb.defrag_stop = blob_defrag_stop;
 	b->cb.defrag_status = blob_defrag_status;
+	b->cb.fragmentation = eblob_backend_fragmentation;
+
+	if (c->absent_cache || c->key_filter)
+		b->cb.key_absent = eblob_backend_key_absent;
+
+	if (c->dedup) {
+		err = blob_dedup_init(c);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not open chunk store: %d.", err);
+			goto err_out_last_read_lock_destroy;
+		}
+	}
+
+	if (c->ttl) {
+		err = blob_ttl_init(c);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not initialize TTL buckets: %d.", err);
+			blob_dedup_destroy(c);
+			goto err_out_last_read_lock_destroy;
+		}
+
+		b->cb.total_elements = blob_ttl_total_elements;
+		b->cb.command_handler = blob_ttl_command_handler;
+		b->cb.checksum = blob_ttl_checksum;
+		b->cb.lookup = blob_ttl_lookup;
+		b->cb.write_stream_prepare = blob_ttl_write_stream_prepare;
+		b->cb.iterator = blob_ttl_iterator;
+
+		if (b->cb.key_absent)
+			b->cb.key_absent = blob_ttl_key_absent;
+	}
 
 	return 0;
 
 err_out_last_read_lock_destroy:
+	blob_compact_destroy(c);
+	dnet_uring_destroy(c->uring);
+	c->uring = NULL;
+	blob_group_commit_destroy(c);
+	blob_key_filter_destroy(c);
+	blob_absent_cache_destroy(c);
+	blob_lookup_cache_destroy(c);
+	blob_path_cache_destroy(c);
+	pthread_mutex_destroy(&c->mmap_lock);
 	pthread_mutex_destroy(&c->last_read_lock);
+err_out_prepared_free:
+	free(c->dedup);
+	c->dedup = NULL;
+	free(c->ttl);
+	c->ttl = NULL;
 err_out_exit:
 	return err;
 }
@@ -1552,7 +6386,22 @@ static struct dnet_config_entry dnet_cfg_entries_blobsystem[] = {
 	{"index_block_size", dnet_blob_set_index_block_size},
 	{"index_block_bloom_length", dnet_blob_set_index_block_bloom_length},
 	{"periodic_timeout", dnet_blob_set_periodic_timeout},
-	{"backend_id", dnet_blob_set_backend_id}
+	{"backend_id", dnet_blob_set_backend_id},
+	{"checksum_type", dnet_blob_set_checksum_type},
+	{"compression", dnet_blob_set_compression},
+	{"compression_threshold", dnet_blob_set_compression_threshold},
+	{"lookup_cache_size", dnet_blob_set_lookup_cache_size},
+	{"absent_cache_size", dnet_blob_set_absent_cache_size},
+	{"key_filter_capacity", dnet_blob_set_key_filter_capacity},
+	{"compact_index", dnet_blob_set_compact_index},
+	{"direct_io_threshold", dnet_blob_set_direct_io_threshold},
+	{"async_io_depth", dnet_blob_set_async_io_depth},
+	{"mmap_read_threshold", dnet_blob_set_mmap_read_threshold},
+	{"group_commit_window_us", dnet_blob_set_group_commit_window},
+	{"group_commit_bytes", dnet_blob_set_group_commit_bytes},
+	{"ttl_bucket_seconds", dnet_blob_set_ttl_bucket_seconds},
+	{"dedup_threshold", dnet_blob_set_dedup_threshold},
+	{"dedup_chunk_size", dnet_blob_set_dedup_chunk_size}
 };
 
 static struct dnet_config_backend dnet_eblob_backend = {
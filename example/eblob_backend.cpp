@@ -26,6 +26,15 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include "library/cuckoo.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/stat.h>
+
 int dnet_blob_config_to_json(struct dnet_config_backend *b, char **json_stat, size_t *size) {
 	struct eblob_backend_config *c = static_cast<struct eblob_backend_config *>(b->data);
 	int err = 0;
@@ -49,6 +58,18 @@ int dnet_blob_config_to_json(struct dnet_config_backend *b, char **json_stat, si
 	doc.AddMember("blob_size_limit", c->data.blob_size_limit, allocator);
 	doc.AddMember("defrag_time", c->data.defrag_time, allocator);
 	doc.AddMember("defrag_splay", c->data.defrag_splay, allocator);
+	doc.AddMember("lookup_cache_size", c->lookup_cache_size, allocator);
+	doc.AddMember("absent_cache_size", c->absent_cache_size, allocator);
+	doc.AddMember("key_filter_capacity", c->key_filter_capacity, allocator);
+	doc.AddMember("compact_index", c->compact_index, allocator);
+	doc.AddMember("async_io_depth", c->async_io_depth, allocator);
+	doc.AddMember("mmap_read_threshold", c->mmap_read_threshold, allocator);
+	doc.AddMember("checksum_type", c->checksum_type == DNET_CHECKSUM_CRC32C ? "crc32c" : "sha512", allocator);
+	doc.AddMember("compression", c->compression == DNET_COMPRESSION_LZ4 ? "lz4" : "none", allocator);
+	doc.AddMember("compression_threshold", c->compression_threshold, allocator);
+	doc.AddMember("ttl_bucket_seconds", static_cast<int64_t>(c->ttl_bucket_seconds), allocator);
+	doc.AddMember("dedup_threshold", c->dedup_threshold, allocator);
+	doc.AddMember("dedup_chunk_size", c->dedup_chunk_size, allocator);
 
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -73,3 +94,238 @@ err_out_reset:
 	return err;
 }
 
+
+int dnet_blob_stat_json_add_compression(struct eblob_backend_config *c, char **json_stat, size_t *size) {
+	const struct eblob_compression_stat &s = c->compression_stat;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(*json_stat, *size).c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+		return 0;
+
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	rapidjson::Value compression(rapidjson::kObjectType);
+	compression.AddMember("codec", c->compression == DNET_COMPRESSION_LZ4 ? "lz4" : "none", allocator);
+	compression.AddMember("threshold", c->compression_threshold, allocator);
+	compression.AddMember("compressed", s.compressed, allocator);
+	compression.AddMember("incompressible", s.incompressible, allocator);
+	compression.AddMember("input_bytes", s.input_bytes, allocator);
+	compression.AddMember("output_bytes", s.output_bytes, allocator);
+	compression.AddMember("compress_time", s.compress_time, allocator);
+	compression.AddMember("decompressed", s.decompressed, allocator);
+	compression.AddMember("decompress_time", s.decompress_time, allocator);
+	compression.AddMember("decompress_errors", s.decompress_errors, allocator);
+	compression.AddMember("sent_compressed", s.sent_compressed, allocator);
+	doc.AddMember("compression", compression, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json)
+		return -ENOMEM;
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	free(*json_stat);
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int dnet_blob_stat_json_add_absent(struct eblob_backend_config *c, char **json_stat, size_t *size) {
+	const struct eblob_absent_stat &s = c->absent_stat;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(*json_stat, *size).c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+		return 0;
+
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	rapidjson::Value absent(rapidjson::kObjectType);
+	absent.AddMember("cache_size", c->absent_cache_size, allocator);
+	absent.AddMember("cache_hits", s.cache_hits, allocator);
+	absent.AddMember("cached", s.cached, allocator);
+	absent.AddMember("filter_capacity", c->key_filter_capacity, allocator);
+	if (c->key_filter) {
+		absent.AddMember("filter_keys", dnet_cuckoo_filter_keys(c->key_filter), allocator);
+		absent.AddMember("filter_saturated", dnet_cuckoo_filter_saturated(c->key_filter) != 0, allocator);
+	}
+	absent.AddMember("filter_hits", s.filter_hits, allocator);
+	doc.AddMember("absent", absent, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json)
+		return -ENOMEM;
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	free(*json_stat);
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int dnet_blob_stat_json_add_ttl(struct eblob_backend_config *c, char **json_stat, size_t *size) {
+	const struct eblob_ttl_stat &s = c->ttl->stat;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(*json_stat, *size).c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+		return 0;
+
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	rapidjson::Value ttl(rapidjson::kObjectType);
+	ttl.AddMember("bucket_seconds", static_cast<int64_t>(c->ttl_bucket_seconds), allocator);
+	ttl.AddMember("buckets", c->ttl->bucket_num, allocator);
+	ttl.AddMember("records", dnet_blob_ttl_records(c), allocator);
+	ttl.AddMember("created", s.created, allocator);
+	ttl.AddMember("removed", s.removed, allocator);
+	ttl.AddMember("removed_records", s.removed_records, allocator);
+	ttl.AddMember("stale_entries", s.stale_entries, allocator);
+	doc.AddMember("ttl", ttl, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json)
+		return -ENOMEM;
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	free(*json_stat);
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int dnet_blob_stat_json_add_compact(struct eblob_backend_config *c, char **json_stat, size_t *size) {
+	struct eblob_compact_index *ci = c->compact;
+	const struct eblob_compact_stat &s = ci->stat;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(*json_stat, *size).c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+		return 0;
+
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	pthread_rwlock_rdlock(&ci->bases_lock);
+	const int bases = ci->base_num;
+	const uint64_t records = ci->records;
+	pthread_rwlock_unlock(&ci->bases_lock);
+
+	rapidjson::Value compact(rapidjson::kObjectType);
+	compact.AddMember("bases", bases, allocator);
+	compact.AddMember("records", records, allocator);
+	compact.AddMember("memory_bytes", records * (sizeof(uint64_t) + EBLOB_COMPACT_POSITION_SIZE), allocator);
+	compact.AddMember("hits", s.hits, allocator);
+	compact.AddMember("misses", s.misses, allocator);
+	compact.AddMember("built", s.built, allocator);
+	compact.AddMember("retired", s.retired, allocator);
+	compact.AddMember("build_errors", s.build_errors, allocator);
+	doc.AddMember("compact_index", compact, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json)
+		return -ENOMEM;
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	free(*json_stat);
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int dnet_blob_stat_json_add_dedup(struct eblob_backend_config *c, char **json_stat, size_t *size) {
+	const struct eblob_dedup_stat &s = c->dedup->stat;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(*json_stat, *size).c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+		return 0;
+
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	rapidjson::Value dedup(rapidjson::kObjectType);
+	dedup.AddMember("threshold", c->dedup_threshold, allocator);
+	dedup.AddMember("chunk_size", c->dedup_chunk_size, allocator);
+	dedup.AddMember("chunks", eblob_backend_total_elements(c->dedup->blob), allocator);
+	dedup.AddMember("records", s.records, allocator);
+	dedup.AddMember("input_bytes", s.input_bytes, allocator);
+	dedup.AddMember("chunks_stored", s.chunks_stored, allocator);
+	dedup.AddMember("stored_bytes", s.stored_bytes, allocator);
+	dedup.AddMember("chunks_shared", s.chunks_shared, allocator);
+	dedup.AddMember("shared_bytes", s.shared_bytes, allocator);
+	dedup.AddMember("chunks_removed", s.chunks_removed, allocator);
+	dedup.AddMember("rejected_writes", s.rejected_writes, allocator);
+	dedup.AddMember("read_errors", s.read_errors, allocator);
+	doc.AddMember("dedup", dedup, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json)
+		return -ENOMEM;
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	free(*json_stat);
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int eblob_backend_fragmentation(void *priv, double *ratio, uint64_t *disk) {
+	struct eblob_backend_config *c = static_cast<struct eblob_backend_config *>(priv);
+	char *json = NULL;
+	size_t size = 0;
+
+	int err = eblob_stat_json_get(c->eblob, &json, &size);
+	if (err)
+		return err;
+
+	rapidjson::Document doc;
+	doc.Parse<0>(std::string(json, size).c_str());
+	free(json);
+
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("summary_stats"))
+		return -EINVAL;
+
+	const rapidjson::Value &summary = doc["summary_stats"];
+	if (!summary.HasMember("base_size") || !summary.HasMember("records_removed_size"))
+		return -EINVAL;
+
+	const uint64_t base_size = summary["base_size"].GetUint64();
+	const uint64_t removed_size = summary["records_removed_size"].GetUint64();
+	*ratio = base_size ? std::min(1., double(removed_size) / base_size) : 0;
+
+	/* blobs are files with @file prefix in its directory */
+	std::string dir = c->data.file;
+	const size_t slash = dir.rfind('/');
+	dir = slash == std::string::npos ? "." : dir.substr(0, slash + 1);
+
+	struct stat st;
+	if (stat(dir.c_str(), &st))
+		return -errno;
+
+	*disk = st.st_dev;
+	return 0;
+}
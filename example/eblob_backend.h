@@ -21,16 +21,29 @@
 #define __DNET_EBLOB_BACKEND_H
 
 #include <sys/types.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <eblob/blob.h>
 
 #include "elliptics/interface.h"
+#include "elliptics/packet.h"
+
+#include "library/rbtree.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct dnet_config_backend;
+struct dnet_cuckoo_filter;
+struct dnet_uring;
+struct eblob_dedup;
+struct eblob_mmap_file;
+struct eblob_ttl;
+
+#define EBLOB_MMAP_BUCKETS		64
 
 struct eblob_read_params {
 	int			fd;
@@ -38,6 +51,181 @@ struct eblob_read_params {
 	uint64_t		offset;
 };
 
+/*
+ * Sequential reader of a large record: where its next chunk is expected
+ * and how far the record has been read ahead
+ */
+struct eblob_read_ahead {
+	struct eblob_key		key;
+	int				fd;
+	int				sequential;
+	uint64_t			next_offset;
+	uint64_t			end_offset;
+};
+
+#define EBLOB_READ_AHEAD_SLOTS		64
+
+/*
+ * Cached result of key lookup in eblob index together with record's ext header.
+ * @dev and @ino identify file @wc.data_fd pointed to, so that reused descriptor is not trusted.
+ */
+struct eblob_lookup_cache_entry {
+	struct eblob_key		key;
+	struct eblob_write_control	wc;
+	struct dnet_ext_list_hdr	ehdr;
+	dev_t				dev;
+	ino_t				ino;
+	uint64_t			expires;	/* msecs of monotonic clock */
+	int				valid;
+};
+
+/*
+ * Every modification of a key bumps @generation of its shard,
+ * lookup result is not cached if shard has been modified while lookup was being made
+ */
+struct eblob_lookup_cache_shard {
+	pthread_mutex_t			lock;
+	uint64_t			generation;
+	struct eblob_lookup_cache_entry	*entries;
+};
+
+#define EBLOB_LOOKUP_CACHE_SHARDS	16
+
+/*
+ * Key recently missed by lookup. Shards are invalidated like ones of lookup cache,
+ * miss is not cached if shard has been modified while lookup was being made.
+ */
+struct eblob_absent_cache_entry {
+	struct eblob_key		key;
+	int				valid;
+};
+
+struct eblob_absent_cache_shard {
+	pthread_mutex_t			lock;
+	uint64_t			generation;
+	struct eblob_absent_cache_entry	*entries;
+};
+
+#define EBLOB_ABSENT_CACHE_SHARDS	16
+
+/*
+ * Counters of lookups answered without eblob, updated atomically
+ */
+struct eblob_absent_stat {
+	uint64_t			cache_hits;		/* keys found in absent cache */
+	uint64_t			filter_hits;		/* keys not found in key filter */
+	uint64_t			cached;			/* misses put into absent cache */
+};
+
+/*
+ * In-memory index of a sealed base built from its sorted index, records removed before are left out.
+ * Keys are hashes and are spread evenly, so position of a key is predicted by its 64-bit prefix
+ * and is looked for within @error entries of the prediction. Only prefixes and packed data file offsets
+ * are kept, so full key is verified against record header read from the data file.
+ */
+struct eblob_compact_base {
+	struct eblob_compact_base	*next;
+	int				index;			/* number of the base */
+	int				data_fd;
+	uint64_t			num;
+	uint64_t			error;
+	uint64_t			*prefixes;
+	unsigned char			*positions;		/* EBLOB_COMPACT_POSITION_SIZE bytes per record */
+	time_t				retired;
+};
+
+#define EBLOB_COMPACT_POSITION_SIZE	5
+
+/*
+ * Counters of compact index lookups, updated atomically
+ */
+struct eblob_compact_stat {
+	uint64_t			hits;			/* keys found and verified */
+	uint64_t			misses;			/* keys looked up in eblob index */
+	uint64_t			built;			/* bases indexed */
+	uint64_t			retired;		/* bases rewritten by defragmentation */
+	uint64_t			build_errors;
+};
+
+struct eblob_compact_index {
+	/* protects @bases list sorted by number of the base, newest first */
+	pthread_rwlock_t		bases_lock;
+	struct eblob_compact_base	*bases;
+	int				base_num;
+	uint64_t			records;
+
+	/*
+	 * Bases dropped from the list, their descriptors may still be used by replies in flight,
+	 * so they are closed by a scan made after EBLOB_COMPACT_SCAN_SECONDS. Used by scan thread only.
+	 */
+	struct eblob_compact_base	*retired;
+
+	pthread_mutex_t			lock;
+	pthread_cond_t			wait;
+	pthread_t			scan_thread;
+	int				scan_started;
+	int				need_exit;
+
+	struct eblob_compact_stat	stat;
+};
+
+/*
+ * Path of blob data file opened as @fd, file info replies take it from here instead of readlink().
+ * @dev and @ino identify the file, descriptor may be reused by another file after blob is closed.
+ */
+struct eblob_path_cache_entry {
+	int				fd;
+	dev_t				dev;
+	ino_t				ino;
+	char				*path;
+};
+
+#define EBLOB_PATH_CACHE_SLOTS		64
+
+/*
+ * Counters of record compression, updated atomically
+ */
+struct eblob_compression_stat {
+	uint64_t			compressed;		/* records stored compressed */
+	uint64_t			incompressible;		/* records which did not shrink enough and were stored as is */
+	uint64_t			input_bytes;		/* original size of compressed records */
+	uint64_t			output_bytes;		/* stored size of compressed records */
+	uint64_t			compress_time;		/* usecs */
+	uint64_t			decompressed;
+	uint64_t			decompress_time;	/* usecs */
+	uint64_t			decompress_errors;
+	uint64_t			sent_compressed;	/* records sent as is to clients accepting compressed data */
+};
+
+#define EBLOB_GROUP_COMMIT_FDS		16
+
+/*
+ * Group commit: writes are not synced by eblob one by one,
+ * instead the first writer waits for others for a short window and syncs files all of them have written to,
+ * every writer replies after sync covering its write has completed
+ */
+struct eblob_group_commit {
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+
+	/* number of writes which have been made and have been synced */
+	uint64_t			written_seq;
+	uint64_t			synced_seq;
+	/*
+	 * writes in (@error_from, @error_to] got error @error from sync, @error_waiters of them have not read it yet,
+	 * error of the next failed group waits until they have
+	 */
+	uint64_t			error_from, error_to;
+	uint64_t			error_waiters;
+	int				error;
+
+	int				syncing;
+	uint64_t			pending_bytes;
+
+	int				fds[EBLOB_GROUP_COMMIT_FDS];
+	int				fd_num;
+};
+
 struct eblob_backend_config {
 	struct eblob_config		data;
 	struct eblob_backend		*eblob;
@@ -46,12 +234,267 @@ struct eblob_backend_config {
 
 	pthread_mutex_t			last_read_lock;
 	int64_t				vm_total;		/* squared in bytes */
+	/* handle of "eblob_backend.cmd." metrics, see dnet_cmd_metrics_register() */
+	int				cmd_metrics;
 	int				random_access;
 	int				last_read_index;
 	struct eblob_read_params	last_reads[100];
+	/* protected by @last_read_lock */
+	struct eblob_read_ahead		read_ahead[EBLOB_READ_AHEAD_SLOTS];
+
+	/*
+	 * Group commit is enabled by non-zero @group_commit_window_us if eblob is configured to sync every write,
+	 * group is synced earlier if it has collected @group_commit_bytes
+	 */
+	long				group_commit_window_us;
+	uint64_t			group_commit_bytes;
+	int				group_commit_enabled;
+	struct eblob_group_commit	group_commit;
+
+	/*
+	 * Reads of at least this size or with DNET_IO_FLAGS_STREAMING bypass page cache, 0 disables direct reads
+	 */
+	uint64_t			direct_io_threshold;
+
+	/*
+	 * Direct reads are submitted to io_uring ring of this many reads and are completed by ring's thread,
+	 * so io thread does not wait for the disk. 0 disables asynchronous reads.
+	 */
+	unsigned int			async_io_depth;
+	struct dnet_uring		*uring;
+
+	/*
+	 * Records of at most this size are sent right from the mapping of their blob data file,
+	 * 0 disables mapped reads. Mappings are hashed by inode, protected by @mmap_lock.
+	 */
+	uint64_t			mmap_read_threshold;
+	pthread_mutex_t			mmap_lock;
+	struct eblob_mmap_file		*mmap_files[EBLOB_MMAP_BUCKETS];
+
+	/* number of cached lookups, 0 disables the cache */
+	uint64_t			lookup_cache_size;
+	uint64_t			lookup_cache_shard_size;
+	struct eblob_lookup_cache_shard	*lookup_cache;
+
+	/* number of cached misses, 0 disables absent cache */
+	uint64_t			absent_cache_size;
+	uint64_t			absent_cache_shard_size;
+	struct eblob_absent_cache_shard	*absent_cache;
+
+	/*
+	 * Filter of all keys of the backend sized for @key_filter_capacity keys, 0 disables it.
+	 * It is filled from the index at start and by every modification.
+	 */
+	uint64_t			key_filter_capacity;
+	struct dnet_cuckoo_filter	*key_filter;
+	struct eblob_absent_stat	absent_stat;
+
+	/*
+	 * Sealed bases are indexed in memory by 13 bytes per record, so their keys are located
+	 * without reading eblob index blocks, 0 disables it. New and defragmented bases are indexed
+	 * by background scan, eblob index is used for keys not found there.
+	 */
+	int				compact_index;
+	struct eblob_compact_index	*compact;
+
+	/* dnet_checksum_types of records written by this backend, stored in their ext headers */
+	int				checksum_type;
+
+	/*
+	 * dnet_compression_types of records written by this backend, stored in their ext headers.
+	 * Only records written at once and of at least @compression_threshold bytes are compressed.
+	 */
+	int				compression;
+	uint64_t			compression_threshold;
+	struct eblob_compression_stat	compression_stat;
+
+	/* data file paths hashed by descriptor, protected by @path_cache_lock */
+	pthread_mutex_t			path_cache_lock;
+	struct eblob_path_cache_entry	path_cache[EBLOB_PATH_CACHE_SLOTS];
+
+	/*
+	 * Records written with lifetime are stored in buckets of @ttl_bucket_seconds by their expiration time,
+	 * bucket is removed as a whole once all its records have expired, 0 disables it.
+	 * Config of a bucket itself has @ttl_bucket_end set to the end of the bucket.
+	 */
+	long				ttl_bucket_seconds;
+	time_t				ttl_bucket_end;
+	struct eblob_ttl		*ttl;
+
+	/*
+	 * Records written at once of at least @dedup_threshold bytes are split into chunks of about
+	 * @dedup_chunk_size bytes by their content and every distinct chunk is stored only once, 0 disables it.
+	 * Chunk store is opened whenever it exists, so deduplicated records stay readable if it is disabled later.
+	 */
+	uint64_t			dedup_threshold;
+	uint64_t			dedup_chunk_size;
+	struct eblob_dedup		*dedup;
+};
+
+/*
+ * Data of deduplicated record: the header followed by references of its chunks in order, in little-endian.
+ * Chunks are stored in "<data>.chunks" eblob keyed by SHA512 of their data.
+ */
+struct eblob_dedup_manifest {
+	uint64_t			size;		/* size of the original data */
+	uint64_t			num;		/* number of chunks */
+} __attribute__ ((packed));
+
+struct eblob_dedup_chunk_ref {
+	struct eblob_key		key;
+	uint64_t			size;
+} __attribute__ ((packed));
+
+/* chunk record starts with the number of references to it followed by chunk's data */
+struct eblob_dedup_chunk_hdr {
+	uint64_t			refs;
+} __attribute__ ((packed));
+
+#define EBLOB_DEDUP_LOCKS		256
+
+/*
+ * Counters of deduplication, updated atomically
+ */
+struct eblob_dedup_stat {
+	uint64_t			records;		/* records written deduplicated */
+	uint64_t			input_bytes;		/* original size of those records */
+	uint64_t			chunks_stored;		/* new chunks */
+	uint64_t			stored_bytes;
+	uint64_t			chunks_shared;		/* references to chunks which have already been stored */
+	uint64_t			shared_bytes;
+	uint64_t			chunks_removed;		/* chunks whose last reference has been dropped */
+	uint64_t			rejected_writes;	/* partial writes into deduplicated records */
+	uint64_t			read_errors;		/* missing or corrupted chunks */
+};
+
+struct eblob_dedup {
+	/* @data + ".chunks", directory of the chunk store */
+	char				dir[PATH_MAX];
+	/* options as parsed, chunk store is configured by them */
+	struct eblob_backend_config	options;
+	struct dnet_config_backend	*config;
+	struct eblob_backend_config	*blob;
+
+	/* chunk boundaries are cut where rolling hash of the data matches @mask, see blob_dedup_chunk_end() */
+	uint64_t			min_size, max_size;
+	uint64_t			mask;
+	uint64_t			gear[256];
+
+	/*
+	 * Manifest of a record is replaced under lock of its key, reference counter of a chunk is changed
+	 * under lock of its hash. Chunk locks are taken one at a time with or without a key lock held.
+	 */
+	pthread_mutex_t			key_locks[EBLOB_DEDUP_LOCKS];
+	pthread_mutex_t			chunk_locks[EBLOB_DEDUP_LOCKS];
+
+	struct eblob_dedup_stat		stat;
+};
+
+/*
+ * Location of the key written with lifetime: end of the bucket it is stored in.
+ * Entries of removed buckets are erased lazily, by lookups of their keys and by sweep after removal.
+ */
+struct eblob_ttl_entry {
+	struct rb_node			node;
+	struct eblob_key		key;
+	time_t				end;
+};
+
+struct eblob_ttl_shard {
+	pthread_mutex_t			lock;
+	struct rb_root			root;
+	uint64_t			num;
 };
 
+#define EBLOB_TTL_SHARDS		64
+
+/*
+ * Bucket is a regular eblob in its own directory which keeps records expiring in (@end - bucket seconds, @end].
+ * Commands hold references to the bucket, expired bucket is unlinked from the list and removed once they are dropped.
+ */
+struct eblob_ttl_bucket {
+	struct eblob_ttl_bucket		*next;
+	time_t				end;
+	int				refs;
+	char				dir[PATH_MAX];
+	struct dnet_config_backend	*config;
+	struct eblob_backend_config	*blob;
+};
+
+/*
+ * Counters of TTL buckets, updated atomically
+ */
+struct eblob_ttl_stat {
+	uint64_t			created;		/* buckets */
+	uint64_t			removed;		/* expired buckets */
+	uint64_t			removed_records;
+	uint64_t			stale_entries;		/* location entries of removed buckets erased */
+};
+
+struct eblob_ttl {
+	/* options as parsed, every new bucket is configured by them */
+	struct eblob_backend_config	options;
+	/* @data + ".ttl", directory of buckets named by their ends */
+	char				dir[PATH_MAX];
+
+	/* protects @buckets list sorted by end and references of buckets */
+	pthread_mutex_t			lock;
+	pthread_cond_t			wait;
+	struct eblob_ttl_bucket		*buckets;
+	int				bucket_num;
+
+	struct eblob_ttl_shard		shards[EBLOB_TTL_SHARDS];
+
+	pthread_t			expire_thread;
+	int				expire_started;
+	int				need_exit;
+
+	struct eblob_ttl_stat		stat;
+};
+
+uint64_t eblob_backend_total_elements(void *priv);
+int eblob_backend_storage_stat_json(void *priv, char **json_stat, size_t *size);
+/*
+ * Share of blobs' size taken by removed records and device of the data directory
+ */
+int eblob_backend_fragmentation(void *priv, double *ratio, uint64_t *disk);
+
+/*
+ * Record helpers of the tiered backend which moves records between two eblob backends.
+ * dnet_blob_lookup_record() returns 0 if record @key exists, even if it has not been committed yet.
+ * dnet_blob_copy_record() copies record with its ext header from @src to @dst, syncs it and sets @size of the record.
+ */
+int dnet_blob_lookup_record(struct eblob_backend_config *c, struct eblob_key *key);
+int dnet_blob_copy_record(struct eblob_backend_config *src, struct eblob_backend_config *dst,
+		struct eblob_key *key, uint64_t *size);
+int dnet_blob_remove_record(struct eblob_backend_config *c, struct eblob_key *key);
+
 int dnet_blob_config_to_json(struct dnet_config_backend *b, char **json_stat, size_t *size);
+/*
+ * Appends compression stats of the backend to eblob's @json_stat of @size bytes, which is reallocated
+ */
+int dnet_blob_stat_json_add_compression(struct eblob_backend_config *c, char **json_stat, size_t *size);
+/*
+ * Appends counters of absent cache and key filter to @json_stat
+ */
+int dnet_blob_stat_json_add_absent(struct eblob_backend_config *c, char **json_stat, size_t *size);
+/*
+ * Appends counters of TTL buckets to @json_stat
+ */
+int dnet_blob_stat_json_add_ttl(struct eblob_backend_config *c, char **json_stat, size_t *size);
+/*
+ * Appends counters of compact index to @json_stat
+ */
+int dnet_blob_stat_json_add_compact(struct eblob_backend_config *c, char **json_stat, size_t *size);
+
+/*
+ * Appends counters of deduplication to @json_stat
+ */
+int dnet_blob_stat_json_add_dedup(struct eblob_backend_config *c, char **json_stat, size_t *size);
+/*
+ * Number of records in TTL buckets of the backend
+ */
+uint64_t dnet_blob_ttl_records(struct eblob_backend_config *c);
 
 #ifdef __cplusplus
 }
@@ -2,20 +2,142 @@
 #include <elliptics/timer.hpp>
 
 #include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <endian.h>
 
 using namespace ioremap;
 
+/*
+ * Latencies and errors of one benchmarked operation
+ */
+struct perf_stat
+{
+	std::string operation;
+	uint64_t index_size = 0;
+	int concurrency = 0;
+	uint64_t errors = 0;
+	double seconds = 0;
+	std::vector<double> latencies;
+
+	std::mutex lock;
+
+	void add(double latency_us, bool failed)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		latencies.push_back(latency_us);
+		if (failed)
+			++errors;
+	}
+
+	double percentile(double p) const
+	{
+		if (latencies.empty())
+			return 0;
+
+		size_t position = std::min(latencies.size() - 1, size_t(p * latencies.size()));
+		return latencies[position];
+	}
+
+	void dump(std::ostream &out)
+	{
+		std::sort(latencies.begin(), latencies.end());
+
+		out << "{\"operation\": \"" << operation << "\""
+			<< ", \"index_size\": " << index_size
+			<< ", \"concurrency\": " << concurrency
+			<< ", \"count\": " << latencies.size()
+			<< ", \"errors\": " << errors
+			<< ", \"seconds\": " << seconds
+			<< ", \"throughput\": " << (seconds > 0 ? latencies.size() / seconds : 0)
+			<< ", \"latency_us\": {"
+			<< "\"p50\": " << percentile(0.5)
+			<< ", \"p90\": " << percentile(0.9)
+			<< ", \"p99\": " << percentile(0.99)
+			<< ", \"p999\": " << percentile(0.999)
+			<< ", \"max\": " << (latencies.empty() ? 0 : latencies.back())
+			<< "}}";
+	}
+};
+
+/*
+ * Runs @op(i) for every i in [0, count) by @concurrency threads, @op returns false on error
+ */
+static void perf_run(perf_stat &stat, int concurrency, uint64_t count, const std::function<bool (uint64_t)> &op)
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	std::atomic<uint64_t> next(0);
+	std::vector<std::thread> threads;
+
+	stat.concurrency = concurrency;
+
+	const clock::time_point start = clock::now();
+
+	for (int t = 0; t < concurrency; ++t) {
+		threads.emplace_back([&] () {
+			for (uint64_t i = next++; i < count; i = next++) {
+				const clock::time_point op_start = clock::now();
+				bool ok = false;
+
+				try {
+					ok = op(i);
+				} catch (const std::exception &) {
+				}
+
+				stat.add(std::chrono::duration<double, std::micro>(clock::now() - op_start).count(), !ok);
+			}
+		});
+	}
+
+	for (auto it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	stat.seconds = std::chrono::duration<double>(clock::now() - start).count();
+}
+
+/*
+ * Index data starts with big-endian number of the object, so range queries select known amount of objects
+ */
+static elliptics::data_pointer perf_index_data(uint64_t number, int data_size)
+{
+	elliptics::data_pointer data = elliptics::data_pointer::allocate(std::max<size_t>(data_size, sizeof(number)));
+	memset(data.data(), 0, data.size());
+
+	number = htobe64(number);
+	memcpy(data.data(), &number, sizeof(number));
+
+	return data;
+}
+
+template <typename Result>
+static bool perf_wait(Result result)
+{
+	result.wait();
+	return !result.error();
+}
+
 int main(int argc, char *argv[])
 {
 	namespace bpo = boost::program_options;
 
 	bpo::options_description generic("Index performance tool options");
 
-	int data_size, num;
+	int data_size, concurrency, readers, indexes_count, bulk_size;
+	uint64_t queries;
 	std::string log_level_name;
-	std::string log, remote, index, groups;
+	std::string log, remote, index, groups, sizes_list, operations_list, json;
 
 	generic.add_options()
 		("help", "This help message")
@@ -23,9 +145,19 @@ int main(int argc, char *argv[])
 		("log-level", bpo::value<std::string>(&log_level_name)->default_value("info"), "Elliptics log level")
 		("remote", bpo::value<std::string>(&remote), "Elliptics remote node to connect to")
 		("groups", bpo::value<std::string>(&groups), "Elliptics remote groups to work with")
-		("index", bpo::value<std::string>(&index)->default_value("test-index"), "Elliptics secondary index name")
-		("num", bpo::value<int>(&num)->default_value(1000000), "Number of entries to put into the index")
+		("index", bpo::value<std::string>(&index)->default_value("test-index"), "Prefix of secondary index names")
+		("sizes", bpo::value<std::string>(&sizes_list)->default_value("1000,10000,100000"),
+			"Comma separated numbers of entries to put into the indexes, every size uses its own indexes")
+		("operations", bpo::value<std::string>(&operations_list)->default_value("set,find_all,find_any"),
+			"Comma separated operations to benchmark: set, update, bulk, find_all, find_any, range")
+		("indexes", bpo::value<int>(&indexes_count)->default_value(2), "Number of indexes every object is added to")
 		("size", bpo::value<int>(&data_size)->default_value(100), "Size of every index entry")
+		("concurrency", bpo::value<int>(&concurrency)->default_value(16), "Number of concurrent requests")
+		("readers", bpo::value<int>(&readers)->default_value(0),
+			"Number of threads running find_all while the indexes are being written")
+		("queries", bpo::value<uint64_t>(&queries)->default_value(100), "Number of every find request")
+		("bulk-size", bpo::value<int>(&bulk_size)->default_value(1000), "Number of objects in every bulk update")
+		("json", bpo::value<std::string>(&json)->default_value("/dev/stdout"), "File to write results to")
 		;
 
 	bpo::options_description cmdline_options;
@@ -34,6 +166,9 @@ int main(int argc, char *argv[])
 	bpo::variables_map vm;
 	dnet_log_level log_level;
 
+	std::vector<uint64_t> sizes;
+	std::vector<std::string> operations;
+
 	try {
 		bpo::store(bpo::command_line_parser(argc, argv).options(cmdline_options).run(), vm);
 
@@ -45,51 +180,159 @@ int main(int argc, char *argv[])
 		bpo::notify(vm);
 
 		log_level = elliptics::file_logger::parse_level(log_level_name);
+
+		std::vector<std::string> tokens;
+		boost::split(tokens, sizes_list, boost::is_any_of(","), boost::token_compress_on);
+		for (auto it = tokens.begin(); it != tokens.end(); ++it)
+			sizes.push_back(std::stoull(*it));
+
+		boost::split(operations, operations_list, boost::is_any_of(","), boost::token_compress_on);
+
+		if (concurrency <= 0 || indexes_count <= 0 || bulk_size <= 0)
+			throw std::invalid_argument("concurrency, indexes and bulk-size must be positive");
 	} catch (const std::exception &e) {
 		std::cerr << "Invalid options: " << e.what() << "\n" << generic << std::endl;
 		return -1;
 	}
 
+	auto enabled = [&operations] (const std::string &name) {
+		return std::find(operations.begin(), operations.end(), name) != operations.end();
+	};
 
 	elliptics::file_logger logger(log.c_str(), log_level);
 	elliptics::node node(elliptics::logger(logger, blackhole::log::attributes_t()));
 
+	std::vector<std::shared_ptr<perf_stat>> results;
+
 	try {
 		node.add_remote(remote);
 
 		elliptics::session session(node);
 		session.set_groups(elliptics::parse_groups(groups.c_str()));
 
-		elliptics::data_pointer index_data = elliptics::data_pointer::allocate(data_size);
+		for (auto size = sizes.begin(); size != sizes.end(); ++size) {
+			std::vector<std::string> indexes;
+			for (int i = 0; i < indexes_count; ++i)
+				indexes.push_back(index + "-" + elliptics::lexical_cast(*size) + "-" + elliptics::lexical_cast(i));
 
-		for (int i = 0; i < num;) {
-			int wait_size = 1000;
-			std::vector<elliptics::async_set_indexes_result> wait;
-			wait.reserve(wait_size);
+			auto key_name = [&size] (uint64_t i) {
+				return "perf-" + elliptics::lexical_cast(*size) + "-" + elliptics::lexical_cast(i);
+			};
 
-			std::vector<std::string> indexes;
-			std::vector<elliptics::data_pointer> datas;
+			auto add_stat = [&results, &size] (const std::string &operation) {
+				auto stat = std::make_shared<perf_stat>();
+				stat->operation = operation;
+				stat->index_size = *size;
+				results.push_back(stat);
+				return stat;
+			};
+
+			auto find_all = [&] (uint64_t) {
+				return perf_wait(session.find_all_indexes(indexes));
+			};
 
-			indexes.push_back(index);
-			datas.push_back(index_data);
+			/*
+			 * Readers run find_all concurrently with the writer until it finishes
+			 */
+			std::atomic_bool writing(true);
+			std::vector<std::thread> reader_threads;
+			std::shared_ptr<perf_stat> mixed;
+			if (readers > 0) {
+				mixed = add_stat("find_all_while_writing");
+				mixed->concurrency = readers;
 
-			elliptics::timer tm;
-			for (int j = 0; j < wait_size && i < num; ++j, ++i) {
-				std::string key = "test-" + elliptics::lexical_cast(i);
+				for (int r = 0; r < readers; ++r) {
+					reader_threads.emplace_back([&] () {
+						elliptics::timer tm;
+						while (writing) {
+							auto start = std::chrono::high_resolution_clock::now();
+							bool ok = false;
+							try {
+								ok = find_all(0);
+							} catch (const std::exception &) {
+							}
+							mixed->add(std::chrono::duration<double, std::micro>(
+								std::chrono::high_resolution_clock::now() - start).count(), !ok);
+						}
+						mixed->seconds = tm.elapsed() / 1000.;
+					});
+				}
+			}
 
-				wait.emplace_back(session.set_indexes(key, indexes, datas));
+			if (enabled("set")) {
+				perf_run(*add_stat("set_indexes"), concurrency, *size, [&] (uint64_t i) {
+					std::vector<elliptics::data_pointer> data(indexes.size(), perf_index_data(i, data_size));
+					return perf_wait(session.set_indexes(key_name(i), indexes, data));
+				});
 			}
 
-			for (size_t j = 0; j < wait.size(); ++j) {
-				wait[j].wait();
+			if (enabled("update")) {
+				perf_run(*add_stat("update_indexes"), concurrency, *size, [&] (uint64_t i) {
+					std::vector<elliptics::data_pointer> data(indexes.size(), perf_index_data(i, data_size));
+					return perf_wait(session.update_indexes(key_name(i), indexes, data));
+				});
 			}
 
-			printf("processed keys: %d/%d, speed: %.3f updates/sec\n",
-					i, num, (double)(wait.size() * 1000) / (double)tm.elapsed());
+			if (enabled("bulk")) {
+				const uint64_t batches = (*size + bulk_size - 1) / bulk_size;
+
+				perf_run(*add_stat("bulk_update_indexes"), concurrency, batches, [&] (uint64_t batch) {
+					std::vector<elliptics::key> keys;
+					std::vector<std::vector<std::string>> keys_indexes;
+					std::vector<std::vector<elliptics::data_pointer>> keys_data;
+
+					for (uint64_t i = batch * bulk_size; i < std::min<uint64_t>(*size, (batch + 1) * bulk_size); ++i) {
+						keys.emplace_back(key_name(i));
+						keys_indexes.push_back(indexes);
+						keys_data.emplace_back(indexes.size(), perf_index_data(i, data_size));
+					}
+
+					return perf_wait(session.bulk_update_indexes(keys, keys_indexes, keys_data));
+				});
+			}
+
+			writing = false;
+			for (auto it = reader_threads.begin(); it != reader_threads.end(); ++it)
+				it->join();
+
+			if (enabled("find_all"))
+				perf_run(*add_stat("find_all_indexes"), concurrency, queries, find_all);
+
+			if (enabled("find_any")) {
+				perf_run(*add_stat("find_any_indexes"), concurrency, queries, [&] (uint64_t) {
+					return perf_wait(session.find_any_indexes(indexes));
+				});
+			}
+
+			if (enabled("range")) {
+				// every query selects tenth part of the index, bounds are shorter than the data
+				perf_run(*add_stat("find_indexes_range"), concurrency, queries, [&] (uint64_t i) {
+					const uint64_t width = std::max<uint64_t>(*size / 10, 1);
+					const uint64_t start = (i * width) % *size;
+
+					return perf_wait(session.find_indexes_range(indexes[0],
+						perf_index_data(start, 0), perf_index_data(start + width, 0)));
+				});
+			}
 		}
 	} catch (const std::exception &e) {
 		std::cerr << "Exception caught: " << e.what() << std::endl;
 		return -1;
 	}
 
+	std::ofstream out(json.c_str());
+
+	out << "{\"shard_count\": " << dnet_node_get_indexes_shard_count(node.get_native())
+		<< ", \"groups\": \"" << groups << "\""
+		<< ", \"indexes\": " << indexes_count
+		<< ", \"entry_size\": " << data_size
+		<< ", \"results\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		if (i)
+			out << ", ";
+		results[i]->dump(out);
+	}
+	out << "]}" << std::endl;
+
+	return 0;
 }
@@ -68,7 +68,7 @@ static void dnet_usage(char *p)
 			" -i flags             - IO flags (see DNET_IO_FLAGS_* in include/elliptics/packet.h\n"
 			" -H                   - do not hash id, use it as is\n"
 			" -b backend_id        - operate with given backend ID, it is needed for defragmentation request or backend status update\n"
-			" -B status            - change backend status, possible options are: enable, disable, "
+			" -B status            - change backend status, possible options are: enable, disable, reload, "
 							"enable_write, disable_write, delay, status (default)\n"
 			" -p delay             - number of milliseconds for given backend to sleep after every command, "
 							"can be set with backend-status command (-B option)\n"
@@ -329,6 +329,8 @@ int main(int argc, char *argv[])
 				result = sess.enable_backend(ra, backend_id);
 			} else if (backend_status == "disable") {
 				result = sess.disable_backend(ra, backend_id);
+			} else if (backend_status == "reload") {
+				result = sess.reload_backend(ra, backend_id);
 			} else if (backend_status == "enable_write") {
 				result = sess.make_writable(ra, backend_id);
 			} else if (backend_status == "disable_write") {
@@ -353,6 +355,10 @@ int main(int argc, char *argv[])
 					std::cout << "       backend_id: " << status->backend_id << std::endl;
 					std::cout << "          address: " << dnet_addr_string(entry.address()) << std::endl;
 					std::cout << "    backend state: " << dnet_backend_state_string(status->state) << std::endl;
+					if (status->state == DNET_BACKEND_ACTIVATING) {
+						std::cout << " activation stage: " << dnet_backend_activation_stage_string(status->activation_stage) << std::endl;
+						std::cout << " activating since: " << dnet_print_time(&status->activation_start) << std::endl;
+					}
 					std::cout << "    defrag  state: " << dnet_backend_defrag_state_string(status->defrag_state) << std::endl;
 					std::cout << "        read-only: " << (status->read_only != 0 ? "true" : "false") << std::endl;
 					std::cout << "            delay: " << status->delay << std::endl;
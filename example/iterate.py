@@ -83,6 +83,10 @@ def iterate_node(ctx, node, eid):
     for r in ranges:
         print repr(r.key_begin), repr(r.key_end)
 
+    if ctx.parquet:
+        write_parquet(ctx, iterator)
+        return
+
     for result in iterator:
         if result.status != 0:
             raise AssertionError("Wrong status: {0}".format(result.status))
@@ -100,6 +104,34 @@ def iterate_node(ctx, node, eid):
                        result.response_data))
 
 
+COLUMNS = ('size', 'timestamp', 'user_flags', 'record_flags')
+
+
+def write_parquet(ctx, iterator):
+    '''
+    Appends key metadata of all records to parquet file, records are decoded by batches
+    straight into arrow arrays without creating python object per record
+    '''
+    import pyarrow
+    import pyarrow.parquet
+
+    types = {'size': pyarrow.uint64(), 'timestamp': pyarrow.timestamp('ns'),
+             'user_flags': pyarrow.uint64(), 'record_flags': pyarrow.uint64()}
+
+    for batch in elliptics.IteratorResultColumns(iterator, ctx.batch_size):
+        count = batch['count']
+        arrays = [pyarrow.Array.from_buffers(pyarrow.binary(len(batch['key']) // count), count,
+                                             [None, pyarrow.py_buffer(batch['key'])])]
+        for name in COLUMNS:
+            arrays.append(pyarrow.Array.from_buffers(types[name], count,
+                                                     [None, pyarrow.py_buffer(batch[name])]))
+
+        record_batch = pyarrow.RecordBatch.from_arrays(arrays, ('key',) + COLUMNS)
+        if ctx.parquet_writer is None:
+            ctx.parquet_writer = pyarrow.parquet.ParquetWriter(ctx.parquet, record_batch.schema)
+        ctx.parquet_writer.write_table(pyarrow.Table.from_batches([record_batch]))
+
+
 def iterate_groups(ctx):
     routes = ctx.session.routes
     group_routes = routes.filter_by_groups(ctx.session.groups)
@@ -197,6 +229,10 @@ def parse_args():
                       help="Address to lookup in route file. This address will be used to determine iterator ranges - ranges which DO NOT belong to selected node.")
     parser.add_option("-R", "--route-file", action="store", dest="route_file", default=None,
                       help="Route file contains 'dnet_balance' tool's output - route table dump, which will be parsed to find out ranges which DO NOT belong to selected address.")
+    parser.add_option("-P", "--parquet", action="store", dest="parquet", default=None, metavar="FILE",
+                      help="Write key, size, timestamp, user_flags and record_flags of records to parquet file instead of printing them, requires pyarrow")
+    parser.add_option("-B", "--batch-size", action="store", type="int", dest="batch_size", default=65536,
+                      help="Number of records in parquet row group [default: %default]")
 
     (options, args) = parser.parse_args()
 
@@ -264,6 +300,11 @@ def parse_args():
     print("Using time_end: {0}".format(ctx.time_end))
 
     ctx.data = options.data
+    ctx.parquet = options.parquet
+    ctx.parquet_writer = None
+    ctx.batch_size = options.batch_size
+    if ctx.parquet and ctx.data:
+        raise ValueError("--parquet writes metadata only and conflicts with --data")
 
     key_range = elliptics.IteratorRange()
 
@@ -328,4 +369,7 @@ if __name__ == '__main__':
         raise RuntimeError("Unknown iteration mode '{0}' "
                            .format(ctx.iterate_mode))
 
+    if ctx.parquet_writer:
+        ctx.parquet_writer.close()
+
     exit(0)
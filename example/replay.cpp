@@ -0,0 +1,379 @@
+#include <elliptics/session.hpp>
+
+#include "../library/capture.h"
+
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace ioremap;
+
+/*
+ * Flags of recorded requests which are replayed as is, others depend on requests before them
+ * (like prepare/commit sequences of chunked writes) and are dropped
+ */
+#define REPLAY_IOFLAGS (DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY | DNET_IO_FLAGS_NOCSUM)
+
+/*
+ * Latencies and errors of one replayed command
+ */
+struct replay_stat
+{
+	std::string command;
+	uint64_t errors = 0;
+	uint64_t bytes = 0;
+	std::vector<double> latencies;
+
+	void add(double latency_us, uint64_t size, bool failed)
+	{
+		latencies.push_back(latency_us);
+		bytes += size;
+		if (failed)
+			++errors;
+	}
+
+	double percentile(double p) const
+	{
+		if (latencies.empty())
+			return 0;
+
+		size_t position = std::min(latencies.size() - 1, size_t(p * latencies.size()));
+		return latencies[position];
+	}
+
+	void dump(std::ostream &out, double seconds)
+	{
+		std::sort(latencies.begin(), latencies.end());
+
+		out << "{\"command\": \"" << command << "\""
+			<< ", \"count\": " << latencies.size()
+			<< ", \"errors\": " << errors
+			<< ", \"bytes\": " << bytes
+			<< ", \"throughput\": " << (seconds > 0 ? latencies.size() / seconds : 0)
+			<< ", \"latency_us\": {"
+			<< "\"p50\": " << percentile(0.5)
+			<< ", \"p90\": " << percentile(0.9)
+			<< ", \"p99\": " << percentile(0.99)
+			<< ", \"p999\": " << percentile(0.999)
+			<< ", \"max\": " << (latencies.empty() ? 0 : latencies.back())
+			<< "}}";
+	}
+};
+
+/*
+ * Reads all records of capture file @path, the file may contain several captures appended one after another
+ */
+static void replay_load(const std::string &path, std::vector<dnet_capture_record> &records)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+		throw std::runtime_error("failed to open " + path);
+
+	char magic[sizeof(DNET_CAPTURE_MAGIC)];
+	while (in.read(magic, sizeof(magic))) {
+		if (!memcmp(magic, DNET_CAPTURE_MAGIC, sizeof(DNET_CAPTURE_MAGIC))) {
+			dnet_capture_header header;
+			memcpy(header.magic, magic, sizeof(magic));
+			if (!in.read(reinterpret_cast<char *>(&header) + sizeof(magic), sizeof(header) - sizeof(magic)))
+				break;
+
+			if (header.version != DNET_CAPTURE_VERSION || header.record_size != sizeof(dnet_capture_record)) {
+				throw std::runtime_error(path + ": unsupported capture version: " +
+					std::to_string(static_cast<unsigned long long>(header.version)));
+			}
+			continue;
+		}
+
+		dnet_capture_record record;
+		memcpy(&record, magic, sizeof(magic));
+		if (!in.read(reinterpret_cast<char *>(&record) + sizeof(magic), sizeof(record) - sizeof(magic)))
+			break;
+
+		records.push_back(record);
+	}
+}
+
+/*
+ * Limits number of requests in flight
+ */
+class replay_window
+{
+public:
+	replay_window(int size) : m_free(size) {}
+
+	void acquire()
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_condition.wait(guard, [this] { return m_free > 0; });
+		--m_free;
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		++m_free;
+		m_condition.notify_all();
+	}
+
+	// waits until all requests are completed
+	void drain(int size)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_condition.wait(guard, [this, size] { return m_free == size; });
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_condition;
+	int m_free;
+};
+
+static elliptics::key replay_key(const dnet_capture_record &record)
+{
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+	memcpy(id.id, record.id, DNET_CAPTURE_ID_SIZE);
+	return elliptics::key(id);
+}
+
+int main(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::options_description generic("Traffic replay tool options");
+
+	double speed;
+	int concurrency;
+	uint64_t max_size;
+	std::string log_level_name;
+	std::string log, remote, groups, commands_list, json;
+	std::vector<std::string> captures;
+
+	generic.add_options()
+		("help", "This help message")
+		("log", bpo::value<std::string>(&log)->default_value("/dev/stdout"), "Elliptics log file")
+		("log-level", bpo::value<std::string>(&log_level_name)->default_value("info"), "Elliptics log level")
+		("remote", bpo::value<std::string>(&remote), "Elliptics remote node to connect to")
+		("groups", bpo::value<std::string>(&groups), "Elliptics remote groups to replay requests to")
+		("capture", bpo::value<std::vector<std::string>>(&captures),
+			"Capture files written by server nodes, requests of all files are merged by time")
+		("speed", bpo::value<double>(&speed)->default_value(1),
+			"Replay speed relative to the recorded one, 0 sends requests as fast as window allows")
+		("concurrency", bpo::value<int>(&concurrency)->default_value(128), "Maximum number of requests in flight")
+		("commands", bpo::value<std::string>(&commands_list)->default_value("READ,WRITE,DEL,LOOKUP"),
+			"Comma separated recorded commands to replay")
+		("max-size", bpo::value<uint64_t>(&max_size)->default_value(100 * 1024 * 1024),
+			"Maximum size of replayed write, bigger ones are truncated")
+		("prefill", "Write keys which are read before they are written, so reads do not fail with -ENOENT")
+		("json", bpo::value<std::string>(&json)->default_value("/dev/stdout"), "File to write results to")
+		;
+
+	bpo::positional_options_description positional;
+	positional.add("capture", -1);
+
+	bpo::variables_map vm;
+	dnet_log_level log_level;
+
+	std::set<int> commands;
+
+	try {
+		bpo::store(bpo::command_line_parser(argc, argv).options(generic).positional(positional).run(), vm);
+
+		if (vm.count("help")) {
+			std::cout << "Usage: " << argv[0] << " [options] capture..." << std::endl << generic << std::endl;
+			return 0;
+		}
+
+		bpo::notify(vm);
+
+		log_level = elliptics::file_logger::parse_level(log_level_name);
+
+		std::vector<std::string> tokens;
+		boost::split(tokens, commands_list, boost::is_any_of(","), boost::token_compress_on);
+		for (auto it = tokens.begin(); it != tokens.end(); ++it) {
+			int cmd = -1;
+			for (int i = 1; i < __DNET_CMD_MAX; ++i) {
+				if (*it == dnet_cmd_string(i))
+					cmd = i;
+			}
+			if (cmd != DNET_CMD_READ && cmd != DNET_CMD_WRITE && cmd != DNET_CMD_DEL && cmd != DNET_CMD_LOOKUP)
+				throw std::invalid_argument("only READ, WRITE, DEL and LOOKUP can be replayed, got: " + *it);
+			commands.insert(cmd);
+		}
+
+		if (captures.empty())
+			throw std::invalid_argument("no capture files");
+		if (concurrency <= 0 || speed < 0)
+			throw std::invalid_argument("concurrency must be positive and speed must not be negative");
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << "\n" << generic << std::endl;
+		return -1;
+	}
+
+	std::vector<dnet_capture_record> records;
+	try {
+		for (auto it = captures.begin(); it != captures.end(); ++it)
+			replay_load(*it, records);
+	} catch (const std::exception &e) {
+		std::cerr << "Failed to load capture: " << e.what() << std::endl;
+		return -1;
+	}
+
+	records.erase(std::remove_if(records.begin(), records.end(), [&commands] (const dnet_capture_record &record) {
+		return !commands.count(record.cmd);
+	}), records.end());
+	std::stable_sort(records.begin(), records.end(), [] (const dnet_capture_record &a, const dnet_capture_record &b) {
+		return a.timestamp < b.timestamp;
+	});
+
+	if (records.empty()) {
+		std::cerr << "No requests to replay" << std::endl;
+		return -1;
+	}
+
+	elliptics::file_logger logger(log.c_str(), log_level);
+	elliptics::node node(elliptics::logger(logger, blackhole::log::attributes_t()));
+
+	typedef std::chrono::steady_clock clock;
+
+	std::map<int, replay_stat> stats;
+	std::mutex stats_lock;
+	replay_window window(concurrency);
+
+	// payload of every replayed write is taken from this buffer
+	uint64_t largest = 0;
+	for (auto it = records.begin(); it != records.end(); ++it)
+		largest = std::max(largest, it->size + it->offset);
+	std::string payload(std::min(largest, max_size), 'x');
+
+	double seconds = 0;
+	double max_lag_us = 0;
+
+	try {
+		node.add_remote(remote);
+
+		elliptics::session session(node);
+		session.set_groups(elliptics::parse_groups(groups.c_str()));
+		session.set_exceptions_policy(elliptics::session::no_exceptions);
+
+		auto write = [&] (const dnet_capture_record &record, const std::function<void (const elliptics::error_info &)> &handler) {
+			const uint64_t size = std::min(record.size, payload.size() - std::min<uint64_t>(record.offset, payload.size()));
+			session.write_data(replay_key(record),
+				elliptics::data_pointer::from_raw(const_cast<char *>(payload.data()), size),
+				record.offset).connect(elliptics::async_write_result::result_function(), handler);
+		};
+
+		if (vm.count("prefill")) {
+			std::set<std::string> written;
+			std::map<std::string, dnet_capture_record> missed;
+
+			for (auto it = records.begin(); it != records.end(); ++it) {
+				const std::string id(reinterpret_cast<const char *>(it->id), DNET_CAPTURE_ID_SIZE);
+
+				if (it->cmd == DNET_CMD_WRITE) {
+					written.insert(id);
+				} else if (!written.count(id)) {
+					dnet_capture_record &largest_read = missed[id];
+					if (largest_read.size + largest_read.offset <= it->size + it->offset)
+						largest_read = *it;
+				}
+			}
+
+			session.set_ioflags(0);
+			for (auto it = missed.begin(); it != missed.end(); ++it) {
+				dnet_capture_record record = it->second;
+				record.size += record.offset;
+				record.offset = 0;
+
+				window.acquire();
+				write(record, [&window] (const elliptics::error_info &) { window.release(); });
+			}
+			window.drain(concurrency);
+
+			std::cerr << "prefill: " << missed.size() << " keys written" << std::endl;
+		}
+
+		const uint64_t base = records.front().timestamp;
+		const clock::time_point start = clock::now();
+
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			const dnet_capture_record &record = *it;
+
+			if (speed > 0) {
+				const clock::time_point deadline = start +
+					std::chrono::microseconds(static_cast<uint64_t>((record.timestamp - base) / speed));
+				std::this_thread::sleep_until(deadline);
+
+				max_lag_us = std::max(max_lag_us,
+					std::chrono::duration<double, std::micro>(clock::now() - deadline).count());
+			}
+
+			window.acquire();
+
+			const clock::time_point sent = clock::now();
+			auto handler = [&stats, &stats_lock, &window, sent, record] (const elliptics::error_info &error) {
+				const double latency = std::chrono::duration<double, std::micro>(clock::now() - sent).count();
+				{
+					std::lock_guard<std::mutex> guard(stats_lock);
+					replay_stat &stat = stats[record.cmd];
+					stat.add(latency, record.size, !!error);
+				}
+				window.release();
+			};
+
+			session.set_ioflags(record.ioflags & REPLAY_IOFLAGS);
+
+			switch (record.cmd) {
+			case DNET_CMD_READ:
+				session.read_data(replay_key(record), record.offset, record.size)
+					.connect(elliptics::async_read_result::result_function(), handler);
+				break;
+			case DNET_CMD_WRITE:
+				write(record, handler);
+				break;
+			case DNET_CMD_DEL:
+				session.remove(replay_key(record))
+					.connect(elliptics::async_remove_result::result_function(), handler);
+				break;
+			case DNET_CMD_LOOKUP:
+				session.lookup(replay_key(record))
+					.connect(elliptics::async_lookup_result::result_function(), handler);
+				break;
+			}
+		}
+
+		window.drain(concurrency);
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+	} catch (const std::exception &e) {
+		std::cerr << "Exception caught: " << e.what() << std::endl;
+		return -1;
+	}
+
+	std::ofstream out(json.c_str());
+
+	out << "{\"requests\": " << records.size()
+		<< ", \"recorded_seconds\": " << (records.back().timestamp - records.front().timestamp) / 1000000.
+		<< ", \"seconds\": " << seconds
+		<< ", \"speed\": " << speed
+		<< ", \"max_lag_us\": " << max_lag_us
+		<< ", \"results\": [";
+	for (auto it = stats.begin(); it != stats.end(); ++it) {
+		if (it != stats.begin())
+			out << ", ";
+		it->second.command = dnet_cmd_string(it->first);
+		it->second.dump(out, seconds);
+	}
+	out << "]}" << std::endl;
+
+	return 0;
+}
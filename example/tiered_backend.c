@@ -0,0 +1,1089 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tiered backend keeps two eblob backends: records are written into the hot one (SSD),
+ * records which are neither written nor read for a while are moved into the cold one (HDD).
+ * Reads, lookups and checksums are served by the tier the key is expected to be in
+ * and fall back to the other one, so keys not known to the location map after restart are found too.
+ */
+
+#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <eblob/blob.h>
+
+#include "elliptics/packet.h"
+#include "elliptics/interface.h"
+#include "elliptics/backends.h"
+
+#include "example/tiered_backend.h"
+
+#include "library/elliptics.h"
+
+#ifndef __unused
+#define __unused	__attribute__ ((unused))
+#endif
+
+/* eblob options with this prefix configure the cold tier only */
+#define TIERED_BACKEND_COLD_PREFIX	"cold_"
+
+/* at most this many keys of a shard are demoted by a single pass */
+#define TIERED_BACKEND_DEMOTE_BATCH	1024
+
+static const char *tiered_tier_names[TIERED_TIER_NUM] = { "hot", "cold" };
+
+static struct tiered_backend_config *tiered_prepare(struct dnet_config_backend *b)
+{
+	struct tiered_backend_config *c = b->data;
+	int i;
+
+	if (!c->prepared) {
+		for (i = 0; i < TIERED_TIER_NUM; ++i) {
+			struct tiered_backend_tier *t = &c->tiers[i];
+
+			t->config = *dnet_eblob_backend_info();
+			t->config.data = &t->blob;
+		}
+
+		c->demote_interval = 60;
+		c->demote_age = 3600;
+		c->demote_frequency = 1;
+		c->prepared = 1;
+	}
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i)
+		c->tiers[i].config.log = b->log;
+
+	return c;
+}
+
+static inline void *tiered_priv(struct tiered_backend_config *c, int tier)
+{
+	return c->tiers[tier].config.cb.command_private;
+}
+
+static inline struct eblob_backend_config *tiered_blob(struct tiered_backend_config *c, int tier)
+{
+	return &c->tiers[tier].blob;
+}
+
+/*
+ * Location map
+ */
+
+static struct tiered_backend_shard *tiered_shard(struct tiered_backend_config *c, const struct eblob_key *key)
+{
+	uint32_t hash;
+
+	memcpy(&hash, key->id, sizeof(hash));
+	return &c->shards[hash % TIERED_BACKEND_SHARDS];
+}
+
+static struct tiered_backend_entry *tiered_entry_search(struct tiered_backend_shard *s, const struct eblob_key *key)
+{
+	struct rb_node *n = s->root.rb_node;
+
+	while (n) {
+		struct tiered_backend_entry *e = rb_entry(n, struct tiered_backend_entry, node);
+		int cmp = memcmp(key->id, e->key.id, EBLOB_ID_SIZE);
+
+		if (cmp < 0)
+			n = n->rb_left;
+		else if (cmp > 0)
+			n = n->rb_right;
+		else
+			return e;
+	}
+
+	return NULL;
+}
+
+/* returns existing entry of @key or inserts new one of unknown tier, NULL if there is no memory for it */
+static struct tiered_backend_entry *tiered_entry_get(struct tiered_backend_shard *s, const struct eblob_key *key)
+{
+	struct rb_node **n = &s->root.rb_node, *parent = NULL;
+	struct tiered_backend_entry *e;
+
+	while (*n) {
+		int cmp;
+
+		parent = *n;
+		e = rb_entry(parent, struct tiered_backend_entry, node);
+		cmp = memcmp(key->id, e->key.id, EBLOB_ID_SIZE);
+
+		if (cmp < 0)
+			n = &parent->rb_left;
+		else if (cmp > 0)
+			n = &parent->rb_right;
+		else
+			return e;
+	}
+
+	e = calloc(1, sizeof(struct tiered_backend_entry));
+	if (!e)
+		return NULL;
+
+	e->key = *key;
+	e->tier = TIERED_TIER_UNKNOWN;
+
+	rb_link_node(&e->node, parent, n);
+	rb_insert_color(&e->node, &s->root);
+	s->num++;
+	return e;
+}
+
+static void tiered_entry_erase(struct tiered_backend_shard *s, struct tiered_backend_entry *e)
+{
+	rb_erase(&e->node, &s->root);
+	s->num--;
+	free(e);
+}
+
+/* the same moving sum as frequency of top keys: reads older than @window seconds are forgotten */
+static double tiered_frequency(const struct tiered_backend_entry *e, time_t now, long window)
+{
+	double delta = 1. - (now - e->access_time) / (double)window;
+
+	if (delta < 0.)
+		delta = 0.;
+	return e->frequency * delta;
+}
+
+static int tiered_shards_init(struct tiered_backend_config *c)
+{
+	int i, err;
+
+	for (i = 0; i < TIERED_BACKEND_SHARDS; ++i) {
+		struct tiered_backend_shard *s = &c->shards[i];
+
+		err = pthread_mutex_init(&s->lock, NULL);
+		if (err) {
+			err = -err;
+			goto err_out_destroy;
+		}
+
+		s->root = RB_ROOT;
+		s->num = 0;
+	}
+
+	c->shards_ready = 1;
+	return 0;
+
+err_out_destroy:
+	while (--i >= 0)
+		pthread_mutex_destroy(&c->shards[i].lock);
+	return err;
+}
+
+static void tiered_shards_destroy(struct tiered_backend_config *c)
+{
+	struct rb_node *n;
+	int i;
+
+	if (!c->shards_ready)
+		return;
+
+	for (i = 0; i < TIERED_BACKEND_SHARDS; ++i) {
+		struct tiered_backend_shard *s = &c->shards[i];
+
+		while ((n = rb_first(&s->root)) != NULL)
+			tiered_entry_erase(s, rb_entry(n, struct tiered_backend_entry, node));
+
+		pthread_mutex_destroy(&s->lock);
+	}
+
+	c->shards_ready = 0;
+}
+
+/*
+ * Tier the key is expected to be in, and generation of its entry
+ */
+static int tiered_route(struct tiered_backend_config *c, const struct eblob_key *key, uint64_t *generation)
+{
+	struct tiered_backend_shard *s = tiered_shard(c, key);
+	struct tiered_backend_entry *e;
+	int tier = TIERED_TIER_HOT;
+
+	*generation = 0;
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_search(s, key);
+	if (e) {
+		if (e->tier != TIERED_TIER_UNKNOWN)
+			tier = e->tier;
+		*generation = e->generation;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	return tier;
+}
+
+/*
+ * Accounts read of the key found in @tier, location is updated only if the key has not been modified meanwhile
+ */
+static void tiered_access(struct tiered_backend_config *c, const struct eblob_key *key, int tier, uint64_t generation)
+{
+	struct tiered_backend_shard *s = tiered_shard(c, key);
+	struct tiered_backend_entry *e;
+	time_t now = time(NULL);
+
+	__sync_add_and_fetch(tier == TIERED_TIER_HOT ? &c->stat.hot_reads : &c->stat.cold_reads, 1);
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_get(s, key);
+	if (e) {
+		if (e->generation == generation && !e->writers)
+			e->tier = tier;
+
+		e->frequency = tiered_frequency(e, now, c->demote_age) + 1;
+		e->access_time = now;
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * Writers of the key hold it, so that it is not demoted while being modified.
+ * Returns tier the key has been in before, or error.
+ */
+static int tiered_hold(struct tiered_backend_config *c, const struct eblob_key *key)
+{
+	struct tiered_backend_shard *s = tiered_shard(c, key);
+	struct tiered_backend_entry *e;
+	int tier;
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_get(s, key);
+	if (e) {
+		e->writers++;
+		tier = e->tier;
+	} else {
+		tier = -ENOMEM;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	return tier;
+}
+
+/* @tier is where the key is after modification, TIERED_TIER_UNKNOWN if it has been removed */
+static void tiered_release(struct tiered_backend_config *c, const struct eblob_key *key, int tier, int modified)
+{
+	struct tiered_backend_shard *s = tiered_shard(c, key);
+	struct tiered_backend_entry *e;
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_search(s, key);
+	if (e) {
+		e->writers--;
+		if (modified) {
+			e->generation++;
+			e->tier = tier;
+			e->write_time = time(NULL);
+		}
+
+		if (e->tier == TIERED_TIER_UNKNOWN && !e->writers)
+			tiered_entry_erase(s, e);
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * Commands
+ */
+
+static int tiered_tier_command(struct tiered_backend_config *c, int tier, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct tiered_backend_tier *t = &c->tiers[tier];
+
+	return t->config.cb.command_handler(state, t->config.cb.command_private, cmd, data);
+}
+
+/* serves command by the tier @key is expected to be in, and by the other one if it is not found there */
+static int tiered_read_command(struct tiered_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_cmd orig_cmd = *cmd;
+	struct dnet_io_attr orig_io;
+	struct eblob_key key;
+	uint64_t generation;
+	int tier, err;
+
+	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+
+	/* tier converts io attribute in place */
+	if (cmd->cmd == DNET_CMD_READ)
+		memcpy(&orig_io, data, sizeof(struct dnet_io_attr));
+
+	tier = tiered_route(c, &key, &generation);
+
+	err = tiered_tier_command(c, tier, state, cmd, data);
+	if (err == -ENOENT) {
+		__sync_add_and_fetch(&c->stat.misses, 1);
+
+		*cmd = orig_cmd;
+		if (cmd->cmd == DNET_CMD_READ)
+			memcpy(data, &orig_io, sizeof(struct dnet_io_attr));
+
+		tier = !tier;
+		err = tiered_tier_command(c, tier, state, cmd, data);
+	}
+
+	if (!err)
+		tiered_access(c, &key, tier, generation);
+
+	return err;
+}
+
+static int tiered_write(struct tiered_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr io = *(struct dnet_io_attr *)data;
+	struct eblob_key key;
+	uint64_t size;
+	int prev_tier, partial, err;
+
+	dnet_convert_io_attr(&io);
+	memcpy(key.id, io.id, EBLOB_ID_SIZE);
+
+	prev_tier = tiered_hold(c, &key);
+	if (prev_tier == -ENOMEM)
+		return -ENOMEM;
+
+	/*
+	 * Record which is not rewritten as a whole has to be in the hot tier to be modified there,
+	 * cold record is copied back first
+	 */
+	partial = !(io.flags & DNET_IO_FLAGS_PREPARE) &&
+		(io.offset || (io.flags & (DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_COMMIT)));
+	if (partial && prev_tier != TIERED_TIER_HOT &&
+			dnet_blob_lookup_record(tiered_blob(c, TIERED_TIER_HOT), &key) == -ENOENT) {
+		err = dnet_blob_copy_record(tiered_blob(c, TIERED_TIER_COLD), tiered_blob(c, TIERED_TIER_HOT), &key, &size);
+		if (!err)
+			__sync_add_and_fetch(&c->stat.promoted, 1);
+		else if (err != -ENOENT)
+			goto err_out_release;
+	}
+
+	err = tiered_tier_command(c, TIERED_TIER_HOT, state, cmd, data);
+	if (err)
+		goto err_out_release;
+
+	/* stale cold copy is removed while the key is still held, so that it can not be demoted meanwhile */
+	if (prev_tier != TIERED_TIER_HOT)
+		dnet_blob_remove_record(tiered_blob(c, TIERED_TIER_COLD), &key);
+
+err_out_release:
+	tiered_release(c, &key, TIERED_TIER_HOT, !err);
+	return err;
+}
+
+static int tiered_del(struct tiered_backend_config *c, struct dnet_cmd *cmd)
+{
+	struct eblob_key key;
+	int err, i, ret;
+
+	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
+
+	ret = tiered_hold(c, &key);
+	if (ret == -ENOMEM)
+		return -ENOMEM;
+
+	err = -ENOENT;
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		/* key is removed if it has been found in either tier and neither has failed */
+		ret = dnet_blob_remove_record(tiered_blob(c, i), &key);
+		if (ret && ret != -ENOENT)
+			err = ret;
+		else if (!ret && err == -ENOENT)
+			err = 0;
+	}
+
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: TIERED: del: REMOVE: %d: %s",
+			dnet_dump_id_str(cmd->id.id), err, strerror(-err));
+	}
+
+	tiered_release(c, &key, TIERED_TIER_UNKNOWN, 1);
+	return err;
+}
+
+/*
+ * Server-send is served by the tier if all keys are expected to be there,
+ * keys of the request are sent by a single controller which can not span both tiers
+ */
+static int tiered_send(struct tiered_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_server_send_request req = *(struct dnet_server_send_request *)data;
+	struct dnet_raw_id *ids = (struct dnet_raw_id *)((struct dnet_server_send_request *)data + 1);
+	struct eblob_key key;
+	uint64_t generation;
+	int tier = TIERED_TIER_UNKNOWN, t, i;
+
+	dnet_convert_server_send_request(&req);
+
+	for (i = 0; i < req.id_num; ++i) {
+		memcpy(key.id, ids[i].id, EBLOB_ID_SIZE);
+
+		t = tiered_route(c, &key, &generation);
+		if (tier == TIERED_TIER_UNKNOWN) {
+			tier = t;
+		} else if (tier != t) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: TIERED: server-send: keys of the request "
+					"are in both tiers, send them by separate requests", dnet_dump_id(&cmd->id));
+			return -ENOTSUP;
+		}
+	}
+
+	if (tier == TIERED_TIER_UNKNOWN)
+		tier = TIERED_TIER_HOT;
+
+	return tiered_tier_command(c, tier, state, cmd, data);
+}
+
+static int tiered_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+{
+	struct tiered_backend_config *c = priv;
+	int err;
+
+	switch (cmd->cmd) {
+		case DNET_CMD_LOOKUP:
+		case DNET_CMD_READ:
+			err = tiered_read_command(c, state, cmd, data);
+			break;
+		case DNET_CMD_WRITE:
+			err = tiered_write(c, state, cmd, data);
+			break;
+		case DNET_CMD_DEL:
+			err = tiered_del(c, cmd);
+			break;
+		case DNET_CMD_SEND:
+			err = tiered_send(c, state, cmd, data);
+			break;
+		default:
+			/* range requests are served by eblob index of a single tier */
+			err = -ENOTSUP;
+			break;
+	}
+
+	return err;
+}
+
+/*
+ * Backend callbacks
+ */
+
+static int tiered_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize)
+{
+	struct tiered_backend_config *c = priv;
+	struct eblob_key key;
+	uint64_t generation;
+	int tier, size = *csize, err;
+
+	memcpy(key.id, id->id, EBLOB_ID_SIZE);
+	tier = tiered_route(c, &key, &generation);
+
+	err = c->tiers[tier].config.cb.checksum(n, tiered_priv(c, tier), id, csum, csize);
+	if (err == -ENOENT) {
+		*csize = size;
+		tier = !tier;
+		err = c->tiers[tier].config.cb.checksum(n, tiered_priv(c, tier), id, csum, csize);
+	}
+
+	return err;
+}
+
+static int tiered_backend_lookup(struct dnet_node *n, void *priv, struct dnet_io_local *io)
+{
+	struct tiered_backend_config *c = priv;
+	struct eblob_key key;
+	uint64_t generation;
+	int tier, err;
+
+	memcpy(key.id, io->key, EBLOB_ID_SIZE);
+	tier = tiered_route(c, &key, &generation);
+
+	err = c->tiers[tier].config.cb.lookup(n, tiered_priv(c, tier), io);
+	if (err == -ENOENT) {
+		tier = !tier;
+		err = c->tiers[tier].config.cb.lookup(n, tiered_priv(c, tier), io);
+	}
+
+	return err;
+}
+
+/* streamed record is committed by write command, which removes stale cold copy */
+static int tiered_backend_write_stream_prepare(void *priv, struct dnet_io_attr *io, int *fd, uint64_t *offset)
+{
+	struct tiered_backend_config *c = priv;
+	struct tiered_backend_tier *t = &c->tiers[TIERED_TIER_HOT];
+
+	return t->config.cb.write_stream_prepare(t->config.cb.command_private, io, fd, offset);
+}
+
+/* record which has just been demoted may be iterated twice if iteration of hot tier has already passed it */
+static int tiered_backend_iterator(struct dnet_iterator_ctl *ictl, struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
+{
+	struct tiered_backend_config *c = ictl->iterate_private;
+	struct dnet_iterator_ctl tctl = *ictl;
+	int i, err;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		tctl.iterate_private = tiered_priv(c, i);
+
+		err = c->tiers[i].config.cb.iterator(&tctl, ireq, irange);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int tiered_defrag_status(void *priv)
+{
+	struct tiered_backend_config *c = priv;
+	int i, status, ret = 0;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		status = c->tiers[i].config.cb.defrag_status(tiered_priv(c, i));
+		if (status > ret)
+			ret = status;
+	}
+
+	return ret;
+}
+
+/* key is absent only if neither tier may have it */
+static int tiered_backend_key_absent(void *priv, const struct dnet_raw_id *key)
+{
+	struct tiered_backend_config *c = priv;
+	int i;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		if (!c->tiers[i].config.cb.key_absent(tiered_priv(c, i), key))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int tiered_defrag_start(void *priv, enum dnet_backend_defrag_level level)
+{
+	struct tiered_backend_config *c = priv;
+	int i, err, ret = 0;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		err = c->tiers[i].config.cb.defrag_start(tiered_priv(c, i), level);
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+static int tiered_defrag_stop(void *priv)
+{
+	struct tiered_backend_config *c = priv;
+	int i, err, ret = 0;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		err = c->tiers[i].config.cb.defrag_stop(tiered_priv(c, i));
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+static uint64_t tiered_backend_total_elements(void *priv)
+{
+	struct tiered_backend_config *c = priv;
+
+	return eblob_backend_total_elements(tiered_priv(c, TIERED_TIER_HOT)) +
+		eblob_backend_total_elements(tiered_priv(c, TIERED_TIER_COLD));
+}
+
+/*
+ * Demotion
+ */
+
+struct tiered_demote_candidate {
+	struct eblob_key		key;
+	uint64_t			generation;
+};
+
+static void tiered_demote_key(struct tiered_backend_config *c, struct tiered_demote_candidate *cand)
+{
+	struct tiered_backend_shard *s = tiered_shard(c, &cand->key);
+	struct tiered_backend_entry *e;
+	uint64_t size = 0;
+	int err;
+
+	err = dnet_blob_copy_record(tiered_blob(c, TIERED_TIER_HOT), tiered_blob(c, TIERED_TIER_COLD), &cand->key, &size);
+	if (err == -ENOENT)
+		return;
+	if (err) {
+		__sync_add_and_fetch(&c->stat.demote_errors, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_search(s, &cand->key);
+	if (!e || e->writers || e->generation != cand->generation) {
+		pthread_mutex_unlock(&s->lock);
+		__sync_add_and_fetch(&c->stat.demote_aborted, 1);
+		goto err_out_remove_copy;
+	}
+
+	/* under the shard lock, so that writers do not see the key in the hot tier until it is removed */
+	err = dnet_blob_remove_record(tiered_blob(c, TIERED_TIER_HOT), &cand->key);
+	if (!err) {
+		e->tier = TIERED_TIER_COLD;
+		e->generation++;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "%s: TIERED: demote: hot REMOVE: %d: %s",
+				dnet_dump_id_str(cand->key.id), err, strerror(-err));
+		__sync_add_and_fetch(&c->stat.demote_errors, 1);
+		goto err_out_remove_copy;
+	}
+
+	__sync_add_and_fetch(&c->stat.demoted, 1);
+	__sync_add_and_fetch(&c->stat.demoted_bytes, size);
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "%s: TIERED: demote: size: %" PRIu64,
+			dnet_dump_id_str(cand->key.id), size);
+	return;
+
+err_out_remove_copy:
+	dnet_blob_remove_record(tiered_blob(c, TIERED_TIER_COLD), &cand->key);
+}
+
+/*
+ * Demotes hot keys which are neither written nor read for a while,
+ * entries of other keys are forgotten once their reads are out of the window
+ */
+static void tiered_demote(struct tiered_backend_config *c)
+{
+	struct tiered_demote_candidate *cands;
+	struct tiered_backend_entry *e;
+	struct rb_node *n, *next;
+	time_t now = time(NULL);
+	int i, j, num;
+
+	/* writes keep landing on the hot tier, they are applied to the cold one once it is not busy */
+	if (c->stage_writes && eblob_defrag_status(tiered_blob(c, TIERED_TIER_COLD)->eblob)) {
+		__sync_add_and_fetch(&c->stat.demote_deferred, 1);
+		return;
+	}
+
+	cands = malloc(TIERED_BACKEND_DEMOTE_BATCH * sizeof(struct tiered_demote_candidate));
+	if (!cands)
+		return;
+
+	for (i = 0; i < TIERED_BACKEND_SHARDS && !c->need_exit; ++i) {
+		struct tiered_backend_shard *s = &c->shards[i];
+
+		num = 0;
+
+		pthread_mutex_lock(&s->lock);
+		for (n = rb_first(&s->root); n && num < TIERED_BACKEND_DEMOTE_BATCH; n = next) {
+			next = rb_next(n);
+			e = rb_entry(n, struct tiered_backend_entry, node);
+
+			if (e->writers || now - e->write_time < c->demote_age)
+				continue;
+
+			if (!c->stage_writes && tiered_frequency(e, now, c->demote_age) >= c->demote_frequency)
+				continue;
+
+			if (e->tier != TIERED_TIER_HOT) {
+				if (now - e->access_time >= c->demote_age)
+					tiered_entry_erase(s, e);
+				continue;
+			}
+
+			cands[num].key = e->key;
+			cands[num].generation = e->generation;
+			num++;
+		}
+		pthread_mutex_unlock(&s->lock);
+
+		for (j = 0; j < num && !c->need_exit; ++j)
+			tiered_demote_key(c, &cands[j]);
+	}
+
+	free(cands);
+}
+
+static void *tiered_demote_process(void *data)
+{
+	struct tiered_backend_config *c = data;
+	struct timespec deadline;
+
+	dnet_set_name("dnet_tier_demote");
+
+	pthread_mutex_lock(&c->demote_lock);
+	while (!c->need_exit) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += c->demote_interval;
+
+		pthread_cond_timedwait(&c->demote_wait, &c->demote_lock, &deadline);
+		if (c->need_exit)
+			break;
+
+		pthread_mutex_unlock(&c->demote_lock);
+		tiered_demote(c);
+		pthread_mutex_lock(&c->demote_lock);
+	}
+	pthread_mutex_unlock(&c->demote_lock);
+
+	return NULL;
+}
+
+static int tiered_demote_start(struct tiered_backend_config *c)
+{
+	int err;
+
+	err = pthread_mutex_init(&c->demote_lock, NULL);
+	if (err)
+		return -err;
+
+	err = pthread_cond_init(&c->demote_wait, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_lock_destroy;
+	}
+
+	c->need_exit = 0;
+	err = pthread_create(&c->demote_thread, NULL, tiered_demote_process, c);
+	if (err) {
+		err = -err;
+		goto err_out_cond_destroy;
+	}
+
+	c->demote_started = 1;
+	return 0;
+
+err_out_cond_destroy:
+	pthread_cond_destroy(&c->demote_wait);
+err_out_lock_destroy:
+	pthread_mutex_destroy(&c->demote_lock);
+	return err;
+}
+
+static void tiered_demote_stop(struct tiered_backend_config *c)
+{
+	if (!c->demote_started)
+		return;
+
+	pthread_mutex_lock(&c->demote_lock);
+	c->need_exit = 1;
+	pthread_cond_signal(&c->demote_wait);
+	pthread_mutex_unlock(&c->demote_lock);
+
+	pthread_join(c->demote_thread, NULL);
+
+	pthread_cond_destroy(&c->demote_wait);
+	pthread_mutex_destroy(&c->demote_lock);
+	c->demote_started = 0;
+}
+
+/* location map does not survive restart, keys of the hot tier get their demotion age from the start */
+static int tiered_scan_callback(struct eblob_disk_control *dc, struct eblob_ram_control *rctl __unused,
+		int fd __unused, uint64_t data_offset __unused, void *priv, void *thread_priv __unused)
+{
+	struct tiered_backend_config *c = priv;
+	struct tiered_backend_shard *s = tiered_shard(c, &dc->key);
+	struct tiered_backend_entry *e;
+	int err = 0;
+
+	pthread_mutex_lock(&s->lock);
+	e = tiered_entry_get(s, &dc->key);
+	if (e) {
+		e->tier = TIERED_TIER_HOT;
+		e->write_time = time(NULL);
+	} else {
+		err = -ENOMEM;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	return err;
+}
+
+static int tiered_scan_hot(struct tiered_backend_config *c)
+{
+	struct eblob_backend_config *hot = tiered_blob(c, TIERED_TIER_HOT);
+	struct eblob_iterate_control eictl = {
+		.priv = c,
+		.b = hot->eblob,
+		.log = hot->data.log,
+		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
+		.thread_num = 1,
+		.iterator_cb = {
+			.iterator = tiered_scan_callback,
+		},
+	};
+
+	return eblob_iterate(hot->eblob, &eictl);
+}
+
+/*
+ * Config
+ */
+
+static struct dnet_config_entry *tiered_blob_entry(const char *key)
+{
+	struct dnet_config_backend *blob = dnet_eblob_backend_info();
+	int i;
+
+	for (i = 0; i < blob->num; ++i) {
+		if (!strcmp(blob->ent[i].key, key))
+			return &blob->ent[i];
+	}
+
+	return NULL;
+}
+
+static int tiered_set_tier_option(struct tiered_backend_config *c, int tier, const char *key, const char *value)
+{
+	struct dnet_config_entry *entry = tiered_blob_entry(key);
+
+	if (!entry)
+		return -ENOENT;
+
+	return entry->callback(&c->tiers[tier].config, key, value);
+}
+
+/* eblob options configure both tiers, "data" of the cold tier must be overridden by "cold_data" */
+static int dnet_tiered_set_option(struct dnet_config_backend *b, const char *key, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+	int i, err;
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		err = tiered_set_tier_option(c, i, key, value);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int dnet_tiered_set_cold_option(struct dnet_config_backend *b, const char *key, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+
+	return tiered_set_tier_option(c, TIERED_TIER_COLD, key + strlen(TIERED_BACKEND_COLD_PREFIX), value);
+}
+
+static int dnet_tiered_set_demote_interval(struct dnet_config_backend *b, const char *key __unused, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+
+	c->demote_interval = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_tiered_set_demote_age(struct dnet_config_backend *b, const char *key __unused, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+
+	c->demote_age = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_tiered_set_demote_frequency(struct dnet_config_backend *b, const char *key __unused, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+
+	c->demote_frequency = strtod(value, NULL);
+	return 0;
+}
+
+static int dnet_tiered_set_stage_writes(struct dnet_config_backend *b, const char *key __unused, const char *value)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+
+	c->stage_writes = strtol(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_tiered_config_init(struct dnet_config_backend *b)
+{
+	struct tiered_backend_config *c = tiered_prepare(b);
+	struct eblob_backend_config *hot = tiered_blob(c, TIERED_TIER_HOT), *cold = tiered_blob(c, TIERED_TIER_COLD);
+	int i, err;
+
+	c->blog = b->log;
+
+	if (!hot->data.file || !cold->data.file || !strcmp(hot->data.file, cold->data.file)) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "tiered: 'data' and 'cold_data' must be set to different paths.");
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	if (c->demote_interval <= 0 || c->demote_age <= 0) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "tiered: invalid demote interval %ld or age %ld.",
+				c->demote_interval, c->demote_age);
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i) {
+		struct tiered_backend_tier *t = &c->tiers[i];
+
+		err = t->config.init(&t->config);
+		if (err) {
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "tiered: could not initialize %s tier: %d.",
+					tiered_tier_names[i], err);
+			goto err_out_tiers_cleanup;
+		}
+	}
+
+	err = tiered_shards_init(c);
+	if (err)
+		goto err_out_tiers_cleanup;
+
+	err = tiered_scan_hot(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "tiered: could not scan hot tier: %d.", err);
+		goto err_out_shards_destroy;
+	}
+
+	err = tiered_demote_start(c);
+	if (err) {
+		dnet_backend_log(c->blog, DNET_LOG_ERROR, "tiered: could not start demotion thread: %d.", err);
+		goto err_out_shards_destroy;
+	}
+
+	b->storage_size = c->tiers[TIERED_TIER_HOT].config.storage_size + c->tiers[TIERED_TIER_COLD].config.storage_size;
+	b->storage_free = c->tiers[TIERED_TIER_HOT].config.storage_free + c->tiers[TIERED_TIER_COLD].config.storage_free;
+
+	b->cb.storage_stat_json = dnet_tiered_storage_stat_json;
+	b->cb.total_elements = tiered_backend_total_elements;
+
+	b->cb.command_private = c;
+	b->cb.command_handler = tiered_backend_command_handler;
+	b->cb.checksum = tiered_backend_checksum;
+	b->cb.lookup = tiered_backend_lookup;
+	b->cb.write_stream_prepare = tiered_backend_write_stream_prepare;
+
+	b->cb.iterator = tiered_backend_iterator;
+
+	b->cb.defrag_start = tiered_defrag_start;
+	b->cb.defrag_stop = tiered_defrag_stop;
+	b->cb.defrag_status = tiered_defrag_status;
+
+	if (c->tiers[TIERED_TIER_HOT].config.cb.key_absent && c->tiers[TIERED_TIER_COLD].config.cb.key_absent)
+		b->cb.key_absent = tiered_backend_key_absent;
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "tiered: hot: %s, cold: %s, hot keys: %" PRIu64
+			", demote interval: %ld, age: %ld, frequency: %f%s",
+			hot->data.file, cold->data.file, eblob_backend_total_elements(hot),
+			c->demote_interval, c->demote_age, c->demote_frequency,
+			c->stage_writes ? ", hot tier stages writes" : "");
+
+	return 0;
+
+err_out_shards_destroy:
+	tiered_shards_destroy(c);
+err_out_tiers_cleanup:
+	/* initialization failure leaves config to be parsed again, so the tiers are reset completely */
+	for (i = 0; i < TIERED_TIER_NUM; ++i)
+		c->tiers[i].config.cleanup(&c->tiers[i].config);
+	c->prepared = 0;
+err_out_exit:
+	return err;
+}
+
+/* like eblob's one, may be called for config which has only been parsed */
+static void dnet_tiered_config_cleanup(struct dnet_config_backend *b)
+{
+	struct tiered_backend_config *c = b->data;
+	int i;
+
+	if (!c->prepared)
+		return;
+
+	tiered_demote_stop(c);
+
+	for (i = 0; i < TIERED_TIER_NUM; ++i)
+		c->tiers[i].config.cleanup(&c->tiers[i].config);
+
+	tiered_shards_destroy(c);
+}
+
+/*
+ * Every eblob option is accepted as is for both tiers and with "cold_" prefix for the cold tier only,
+ * the table is built from eblob's one. Prefixed options follow plain ones, so that they override them.
+ */
+#define TIERED_BACKEND_MAX_ENTRIES	128
+
+static struct dnet_config_entry dnet_cfg_entries_tiered[TIERED_BACKEND_MAX_ENTRIES] = {
+	{"demote_interval", dnet_tiered_set_demote_interval},
+	{"demote_age", dnet_tiered_set_demote_age},
+	{"demote_frequency", dnet_tiered_set_demote_frequency},
+	{"stage_writes", dnet_tiered_set_stage_writes},
+};
+
+static struct dnet_config_backend dnet_tiered_backend = {
+	.name			= "tiered",
+	.ent			= dnet_cfg_entries_tiered,
+	.num			= 4,
+	.size			= sizeof(struct tiered_backend_config),
+	.init			= dnet_tiered_config_init,
+	.cleanup		= dnet_tiered_config_cleanup,
+	.to_json		= dnet_tiered_config_to_json,
+};
+
+static pthread_once_t dnet_tiered_backend_once = PTHREAD_ONCE_INIT;
+
+static void dnet_tiered_backend_init_entries(void)
+{
+	struct dnet_config_backend *blob = dnet_eblob_backend_info();
+	int i, num = dnet_tiered_backend.num;
+
+	for (i = 0; i < blob->num && num < TIERED_BACKEND_MAX_ENTRIES; ++i, ++num) {
+		snprintf(dnet_cfg_entries_tiered[num].key, sizeof(dnet_cfg_entries_tiered[num].key), "%s", blob->ent[i].key);
+		dnet_cfg_entries_tiered[num].callback = dnet_tiered_set_option;
+	}
+
+	for (i = 0; i < blob->num && num < TIERED_BACKEND_MAX_ENTRIES; ++i, ++num) {
+		snprintf(dnet_cfg_entries_tiered[num].key, sizeof(dnet_cfg_entries_tiered[num].key),
+				TIERED_BACKEND_COLD_PREFIX "%s", blob->ent[i].key);
+		dnet_cfg_entries_tiered[num].callback = dnet_tiered_set_cold_option;
+	}
+
+	dnet_tiered_backend.num = num;
+}
+
+struct dnet_config_backend *dnet_tiered_backend_info(void)
+{
+	pthread_once(&dnet_tiered_backend_once, dnet_tiered_backend_init_entries);
+	return &dnet_tiered_backend;
+}
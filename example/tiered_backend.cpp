@@ -0,0 +1,135 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "example/tiered_backend.h"
+
+#include "elliptics/packet.h"
+#include "elliptics/backends.h"
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/* parses json of @size bytes allocated by eblob backend and frees it */
+static bool tiered_parse_json(rapidjson::Document &doc, char *json, size_t size) {
+	doc.Parse<0>(std::string(json, size).c_str());
+	free(json);
+	return !doc.HasParseError() && doc.IsObject();
+}
+
+static int tiered_json_result(rapidjson::Document &doc, char **json_stat, size_t *size) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	char *json = static_cast<char *>(malloc(buffer.Size() + 1));
+	if (!json) {
+		*json_stat = NULL;
+		*size = 0;
+		return -ENOMEM;
+	}
+
+	memcpy(json, buffer.GetString(), buffer.Size() + 1);
+
+	*json_stat = json;
+	*size = buffer.Size();
+	return 0;
+}
+
+int dnet_tiered_config_to_json(struct dnet_config_backend *b, char **json_stat, size_t *size) {
+	struct tiered_backend_config *c = static_cast<struct tiered_backend_config *>(b->data);
+	char *json = NULL;
+	size_t json_size = 0;
+	int err;
+
+	*json_stat = NULL;
+	*size = 0;
+
+	if (!c->prepared)
+		return 0;
+
+	rapidjson::Document doc, cold(&doc.GetAllocator());
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	err = dnet_blob_config_to_json(&c->tiers[TIERED_TIER_HOT].config, &json, &json_size);
+	if (err)
+		return err;
+	if (!tiered_parse_json(doc, json, json_size))
+		return -EINVAL;
+
+	err = dnet_blob_config_to_json(&c->tiers[TIERED_TIER_COLD].config, &json, &json_size);
+	if (err)
+		return err;
+	if (!tiered_parse_json(cold, json, json_size))
+		return -EINVAL;
+
+	doc.AddMember("cold", static_cast<rapidjson::Value &>(cold), allocator);
+	doc.AddMember("demote_interval", static_cast<int64_t>(c->demote_interval), allocator);
+	doc.AddMember("demote_age", static_cast<int64_t>(c->demote_age), allocator);
+	doc.AddMember("demote_frequency", c->demote_frequency, allocator);
+	doc.AddMember("stage_writes", c->stage_writes, allocator);
+
+	return tiered_json_result(doc, json_stat, size);
+}
+
+int dnet_tiered_storage_stat_json(void *priv, char **json_stat, size_t *size) {
+	struct tiered_backend_config *c = static_cast<struct tiered_backend_config *>(priv);
+	const struct tiered_backend_stat &s = c->stat;
+	char *json = NULL;
+	size_t json_size = 0;
+	int err;
+
+	rapidjson::Document doc, cold(&doc.GetAllocator());
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+
+	err = eblob_backend_storage_stat_json(&c->tiers[TIERED_TIER_HOT].blob, &json, &json_size);
+	if (err)
+		return err;
+	if (!tiered_parse_json(doc, json, json_size))
+		return -EINVAL;
+
+	err = eblob_backend_storage_stat_json(&c->tiers[TIERED_TIER_COLD].blob, &json, &json_size);
+	if (err)
+		return err;
+	if (!tiered_parse_json(cold, json, json_size))
+		return -EINVAL;
+
+	uint64_t entries = 0;
+	for (int i = 0; i < TIERED_BACKEND_SHARDS; ++i)
+		entries += c->shards[i].num;
+
+	rapidjson::Value tiering(rapidjson::kObjectType);
+	tiering.AddMember("map_entries", entries, allocator);
+	tiering.AddMember("hot_reads", s.hot_reads, allocator);
+	tiering.AddMember("cold_reads", s.cold_reads, allocator);
+	tiering.AddMember("misses", s.misses, allocator);
+	tiering.AddMember("demoted", s.demoted, allocator);
+	tiering.AddMember("demoted_bytes", s.demoted_bytes, allocator);
+	tiering.AddMember("demote_errors", s.demote_errors, allocator);
+	tiering.AddMember("demote_aborted", s.demote_aborted, allocator);
+	tiering.AddMember("promoted", s.promoted, allocator);
+	tiering.AddMember("demote_deferred", s.demote_deferred, allocator);
+
+	doc.AddMember("cold", static_cast<rapidjson::Value &>(cold), allocator);
+	doc.AddMember("tiering", tiering, allocator);
+
+	return tiered_json_result(doc, json_stat, size);
+}
@@ -0,0 +1,133 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_TIERED_BACKEND_H
+#define __DNET_TIERED_BACKEND_H
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "example/eblob_backend.h"
+
+#include "elliptics/backends.h"
+
+#include "library/rbtree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum tiered_backend_tiers {
+	TIERED_TIER_UNKNOWN = -1,
+	TIERED_TIER_HOT = 0,
+	TIERED_TIER_COLD,
+	TIERED_TIER_NUM
+};
+
+/*
+ * Tier is a regular eblob backend, @config is a copy of eblob backend info with @data pointing to @blob
+ */
+struct tiered_backend_tier {
+	struct dnet_config_backend	config;
+	struct eblob_backend_config	blob;
+};
+
+/*
+ * Location of the key: tier it has been written to or found in, and how often it is read.
+ * @frequency is a moving sum of reads over demotion age window, like one of top keys statistics.
+ * Writers of the key bump @generation, demotion of the key is abandoned if it has changed meanwhile.
+ */
+struct tiered_backend_entry {
+	struct rb_node			node;
+	struct eblob_key		key;
+	int				tier;
+	int				writers;
+	uint64_t			generation;
+	time_t				write_time;
+	time_t				access_time;
+	double				frequency;
+};
+
+struct tiered_backend_shard {
+	pthread_mutex_t			lock;
+	struct rb_root			root;
+	uint64_t			num;
+};
+
+#define TIERED_BACKEND_SHARDS		64
+
+/*
+ * Counters of tiering, updated atomically
+ */
+struct tiered_backend_stat {
+	uint64_t			hot_reads;
+	uint64_t			cold_reads;
+	uint64_t			misses;			/* key was not found in the tier it was expected in */
+	uint64_t			demoted;
+	uint64_t			demoted_bytes;
+	uint64_t			demote_errors;
+	uint64_t			demote_aborted;		/* key was written while it was being demoted */
+	uint64_t			promoted;		/* cold keys copied back to be partially overwritten */
+	uint64_t			demote_deferred;	/* passes skipped while cold tier was defragmented */
+};
+
+struct tiered_backend_config {
+	struct tiered_backend_tier	tiers[TIERED_TIER_NUM];
+	int				prepared;
+	dnet_logger			*blog;
+
+	/*
+	 * Every @demote_interval seconds hot keys which have not been written for @demote_age seconds
+	 * and have been read less than @demote_frequency times over the last @demote_age seconds
+	 * are moved to the cold tier
+	 */
+	long				demote_interval;
+	long				demote_age;
+	double				demote_frequency;
+
+	/*
+	 * Hot tier is a write log in front of the cold one: every key is demoted once it has not been
+	 * written for @demote_age seconds however often it is read, and demotion waits while the cold tier
+	 * is defragmented. Writes are acknowledged once they are in the hot tier, reads check it first.
+	 */
+	int				stage_writes;
+
+	struct tiered_backend_shard	shards[TIERED_BACKEND_SHARDS];
+	int				shards_ready;
+
+	pthread_t			demote_thread;
+	pthread_mutex_t			demote_lock;
+	pthread_cond_t			demote_wait;
+	int				demote_started;
+	int				need_exit;
+
+	struct tiered_backend_stat	stat;
+};
+
+int dnet_tiered_config_to_json(struct dnet_config_backend *b, char **json_stat, size_t *size);
+/*
+ * Statistics of the hot tier extended by statistics of the cold tier and tiering counters
+ */
+int dnet_tiered_storage_stat_json(void *priv, char **json_stat, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_TIERED_BACKEND_H */
@@ -28,6 +28,8 @@ namespace ioremap { namespace elliptics {
 template <typename T> class async_result_handler;
 class session;
 
+typedef std::function<void (const error_info &, const std::vector<dnet_cmd> &)> result_error_handler;
+
 /*!
  * async_result is a template class that provides result of request processing.
  *
@@ -292,12 +294,22 @@ class async_result_handler
 
 		void set_total(size_t total);
 		size_t get_total();
+		/*!
+		 * Makes result complete as soon as received statuses satisfy its checker.
+		 *
+		 * Replies received after that are not added to the result, failed ones
+		 * are passed to \a background_error_handler with their statuses.
+		 */
+		void set_quorum_completion(const result_error_handler &background_error_handler);
 		void process(const T &result);
 		void complete(const error_info &error);
 		bool check(error_info *error);
 
 	private:
 		typedef typename async_result<T>::data data;
+		void complete_nolock(const error_info &error);
+		void try_complete_early();
+
 		std::shared_ptr<data> m_data;
 };
 
@@ -129,6 +129,7 @@ int dnet_ext_hdr_write(const struct dnet_ext_list_hdr *ehdr, int fd, uint64_t of
  * library/backend.cpp dnet_backend_info::parse() method
  */
 struct dnet_config_backend *dnet_eblob_backend_info(void);
+struct dnet_config_backend *dnet_tiered_backend_info(void);
 
 int dnet_eblob_backend_init(void);
 void dnet_eblob_backend_exit(void);
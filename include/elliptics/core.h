@@ -28,6 +28,14 @@
 #else
 #define DNET_ID_SIZE		64
 #endif
+
+/*
+ * IDs are compared by 64-bit words and are not longer than sha512 digest,
+ * the first 24 bytes of command's ID carry version and indexes shard count in reverse lookup
+ */
+#if DNET_ID_SIZE % 8 || DNET_ID_SIZE < 24 || DNET_ID_SIZE > 64
+#error "DNET_ID_SIZE has to be a multiple of 8 from 24 to 64"
+#endif
 #define DNET_MAX_NAME_LEN	64
 #define DNET_ID_STR_SIZE       2 * DNET_ID_SIZE + 4
 
@@ -65,6 +73,12 @@
  */
 #define DNET_DEFAULT_NOTIFY_HASH_SIZE	256
 
+/*
+ * Requests of this size and larger are sent via dedicated connection
+ * when there are several connections per node.
+ */
+#define DNET_DEFAULT_LARGE_REQUEST_SIZE	(1024 * 1024)
+
 /*
  * Default wait timeout in seconds.
  */
@@ -80,6 +94,7 @@
 #define DNET_DEFAULT_STALL_TRANSACTIONS 3
 
 #define DNET_DEFAULT_INDEXES_SHARD_COUNT 16
+#define DNET_INDEXES_MAX_SPLIT_DEPTH 16
 
 #define DNET_DEFAULT_CACHES_NUMBER 16
 
@@ -0,0 +1,262 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IOREMAP_ELLIPTICS_COROUTINE_HPP
+#define IOREMAP_ELLIPTICS_COROUTINE_HPP
+
+/*
+ * Awaitable adaptors of async_result, they are available only if the client is built
+ * with C++20 coroutines, the library itself doesn't depend on them.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include "result_entry.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+
+namespace ioremap { namespace elliptics {
+
+/*!
+ * Executor which runs the passed function, it is used to resume coroutines.
+ *
+ * Empty executor means that coroutine is resumed right in the elliptics thread
+ * which has received the reply, while lock of corresponding async_result is held.
+ * Such coroutine must not block and should not do heavy work, pass executor
+ * of your own thread pool otherwise.
+ */
+typedef std::function<void (std::function<void ()> &&)> coroutine_executor;
+
+namespace detail {
+
+inline void coroutine_resume(const coroutine_executor &executor, std::coroutine_handle<> handle)
+{
+	if (executor)
+		executor([handle] () { handle.resume(); });
+	else
+		handle.resume();
+}
+
+} // namespace detail
+
+/*!
+ * Awaiter of the whole async_result, co_await returns the list of all received entries
+ * the same way as async_result::get() does, so it throws if session::throw_at_get is set.
+ *
+ * Already finished result is neither locked nor suspended.
+ */
+template <typename T>
+class result_awaiter
+{
+	public:
+		result_awaiter(async_result<T> &&result, const coroutine_executor &executor = coroutine_executor())
+		: m_result(std::move(result)), m_executor(executor)
+		{
+		}
+
+		bool await_ready() const
+		{
+			return m_result.ready();
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			/*
+			 * 0 - nobody has finished yet, 1 - coroutine is suspended, 2 - result is finished.
+			 * Whoever comes second resumes the coroutine: either handler does it
+			 * or await_suspend doesn't suspend at all if handler has already been called.
+			 */
+			auto state = std::make_shared<std::atomic<int>>(0);
+			coroutine_executor executor = m_executor;
+
+			m_result.connect(typename async_result<T>::result_function(),
+				[state, executor, handle] (const error_info &) {
+					if (state->exchange(2) == 1)
+						detail::coroutine_resume(executor, handle);
+				});
+
+			return state->exchange(1) != 2;
+		}
+
+		std::vector<T> await_resume()
+		{
+			return m_result.get();
+		}
+
+	private:
+		async_result<T> m_result;
+		coroutine_executor m_executor;
+};
+
+/*!
+ * Allows to co_await result of any session operation, like
+ * \code
+ * std::vector<read_result_entry> entries = co_await sess.read_data(key, 0, 0);
+ * \endcode
+ */
+template <typename T>
+result_awaiter<T> operator co_await(async_result<T> &&result)
+{
+	return result_awaiter<T>(std::move(result));
+}
+
+/*!
+ * Same as co_await of \a result, but the coroutine is resumed by \a executor.
+ */
+template <typename T>
+result_awaiter<T> resume_on(async_result<T> &&result, const coroutine_executor &executor)
+{
+	return result_awaiter<T>(std::move(result), executor);
+}
+
+/*!
+ * Stream of entries of async_result which may be awaited one by one, it's useful for
+ * long-living requests like iterators:
+ * \code
+ * result_stream<iterator_result_entry> stream(sess.start_iterator(...));
+ * iterator_result_entry entry;
+ * while (co_await stream.next(entry)) {
+ *	...
+ * }
+ * if (stream.error())
+ *	...
+ * \endcode
+ *
+ * Entries received while nobody awaits are queued, so the stream should be drained in time.
+ * Only one coroutine may await the stream at once.
+ */
+template <typename T>
+class result_stream
+{
+	struct state
+	{
+		std::mutex lock;
+		std::deque<T> entries;
+		bool finished;
+		error_info error;
+		std::coroutine_handle<> waiter;
+		coroutine_executor executor;
+
+		state() : finished(false)
+		{
+		}
+
+		void wake(std::unique_lock<std::mutex> &locker)
+		{
+			std::coroutine_handle<> handle;
+			std::swap(handle, waiter);
+			locker.unlock();
+
+			if (handle)
+				detail::coroutine_resume(executor, handle);
+		}
+	};
+
+	public:
+		class awaiter
+		{
+			public:
+				awaiter(const std::shared_ptr<state> &st, T &entry) : m_state(st), m_entry(entry)
+				{
+				}
+
+				bool await_ready() const
+				{
+					std::lock_guard<std::mutex> locker(m_state->lock);
+					return !m_state->entries.empty() || m_state->finished;
+				}
+
+				bool await_suspend(std::coroutine_handle<> handle)
+				{
+					std::lock_guard<std::mutex> locker(m_state->lock);
+					if (!m_state->entries.empty() || m_state->finished)
+						return false;
+
+					m_state->waiter = handle;
+					return true;
+				}
+
+				/*!
+				 * Returns false if there are no more entries.
+				 */
+				bool await_resume()
+				{
+					std::lock_guard<std::mutex> locker(m_state->lock);
+					if (m_state->entries.empty())
+						return false;
+
+					m_entry = std::move(m_state->entries.front());
+					m_state->entries.pop_front();
+					return true;
+				}
+
+			private:
+				std::shared_ptr<state> m_state;
+				T &m_entry;
+		};
+
+		result_stream(async_result<T> &&result, const coroutine_executor &executor = coroutine_executor())
+		: m_result(std::move(result)), m_state(std::make_shared<state>())
+		{
+			std::shared_ptr<state> st = m_state;
+			st->executor = executor;
+
+			m_result.connect(
+				[st] (const T &entry) {
+					std::unique_lock<std::mutex> locker(st->lock);
+					st->entries.push_back(entry);
+					st->wake(locker);
+				},
+				[st] (const error_info &error) {
+					std::unique_lock<std::mutex> locker(st->lock);
+					st->finished = true;
+					st->error = error;
+					st->wake(locker);
+				});
+		}
+
+		/*!
+		 * Awaits the next entry and stores it to \a entry, co_await returns false after the last one.
+		 */
+		awaiter next(T &entry)
+		{
+			return awaiter(m_state, entry);
+		}
+
+		/*!
+		 * Returns the information about the error, it's valid after the last entry is awaited.
+		 */
+		error_info error() const
+		{
+			std::lock_guard<std::mutex> locker(m_state->lock);
+			return m_state->error;
+		}
+
+	private:
+		async_result<T> m_result;
+		std::shared_ptr<state> m_state;
+};
+
+typedef result_stream<iterator_result_entry> iterator_result_stream;
+
+}} /* namespace ioremap::elliptics */
+
+#endif /* __cpp_impl_coroutine */
+
+#endif // IOREMAP_ELLIPTICS_COROUTINE_HPP
@@ -31,6 +31,7 @@
 
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -122,6 +123,23 @@ struct dnet_io_control {
 	 */
 	const void			*data;
 
+	/*
+	 * If @iovcnt is not zero, data is gathered from @iov segments instead of @data,
+	 * io.size must be equal to their total size.
+	 */
+	const struct iovec		*iov;
+	int				iovcnt;
+
+	/*
+	 * If @data_release is set, data (either @data or @iov segments) is not copied
+	 * but referenced by every created transaction: @data_acquire(@data_priv) is called
+	 * for each of them and @data_release(@data_priv) when its request is sent or dropped.
+	 * Only @iov array itself is copied, so it may be freed right after the call.
+	 */
+	void				(*data_acquire)(void *priv);
+	void				(*data_release)(void *priv);
+	void				*data_priv;
+
 	/*
 	 * File descriptor to read data from (for the write transaction).
 	 */
@@ -161,6 +179,62 @@ int dnet_search_range(struct dnet_node *n, struct dnet_id *id,
 int __attribute__((weak)) dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
 		void *data, int fd, uint64_t offset, int on_exit);
 
+/*
+ * Sends read reply with data from @fd verified chunk by chunk: @verify(@priv, @chunk_offset, @chunk_size)
+ * is called for every @chunk_size part of the data (offset is relative to @offset) right before it is allowed
+ * to go to the network, so the reply starts to be sent after the first chunk has been verified.
+ * If verification of any chunk but the first one fails, the connection is reset since reply header
+ * has already been sent, error of the first chunk is returned as usual.
+ */
+int dnet_send_read_data_verified(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		int fd, uint64_t offset, int on_exit, uint64_t chunk_size,
+		int (*verify)(void *priv, uint64_t chunk_offset, uint64_t chunk_size), void *priv);
+
+/*
+ * Sends read reply which data is produced by @fill() piece by piece: @fill(@priv, @piece_offset, @piece_size, ...)
+ * must return in @data buffer with the next @piece_size bytes of the reply, @release(@release_priv)
+ * is called when it has been sent. Pieces go to the network as soon as they are filled,
+ * errors are handled the same way as in dnet_send_read_data_verified().
+ */
+int dnet_send_read_data_pieces(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, uint64_t piece_size,
+		int (*fill)(void *priv, uint64_t piece_offset, uint64_t piece_size,
+			void **data, void (**release)(void *release_priv), void **release_priv), void *priv);
+
+/*
+ * Read reply which pieces are filled asynchronously and in any order.
+ *
+ * dnet_send_read_data_pieces_queue() queues reply header and @io->size bytes of data split into
+ * @piece_size pieces, all of them are held in the send queue. Piece number @index is allowed
+ * to go to the network by dnet_send_pieces_release() with its @data, @release(@release_priv)
+ * is called when it has been sent. dnet_send_pieces_complete() must be called exactly once
+ * after all pieces have been released or with error: if nothing has been released yet
+ * reply is dropped and error is returned to be sent as ack, otherwise connection is reset.
+ * DNET_IO_FLAGS_CHECKSUM and DNET_IO_FLAGS_SKIP_SENDING replies can not be queued this way.
+ */
+struct dnet_send_pieces;
+struct dnet_send_pieces *dnet_send_read_data_pieces_queue(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		uint64_t piece_size, int *errp);
+/*
+ * The same, but reply is split into @num pieces of any size, sizes of all released pieces must sum up to @io->size
+ */
+struct dnet_send_pieces *dnet_send_read_data_parts_queue(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		int num, int *errp);
+void dnet_send_pieces_release(struct dnet_send_pieces *p, int index, void *data, uint64_t size,
+		void (*release)(void *release_priv), void *release_priv);
+int dnet_send_pieces_complete(struct dnet_send_pieces *p, int err);
+
+/*
+ * Command processed by backend asynchronously, after its handler has returned.
+ *
+ * Backend starts it with a copy of the command and state reference, clears DNET_FLAGS_NEED_ACK
+ * of the original command and returns 0, so io thread neither waits for the backend
+ * nor sends ack. dnet_async_cmd_complete() sends ack if it is needed or @err is set,
+ * io thread statistics count the command when it is started.
+ */
+struct dnet_async_cmd;
+struct dnet_async_cmd *dnet_async_cmd_start(void *state, struct dnet_cmd *cmd);
+void dnet_async_cmd_complete(struct dnet_async_cmd *ac, int err);
+
 #define DNET_MAX_ADDRLEN		256
 #define DNET_MAX_PORTLEN		8
 
@@ -176,6 +250,10 @@ int __attribute__((weak)) dnet_send_read_data(void *state, struct dnet_cmd *cmd,
 #define DNET_CFG_NO_CSUM		(1<<3)		/* globally disable checksum verification and update */
 #define DNET_CFG_RANDOMIZE_STATES	(1<<5)		/* randomize states for read requests */
 #define DNET_CFG_KEEPS_IDS_IN_CLUSTER	(1<<6)		/* keeps ids in elliptics cluster */
+#define DNET_CFG_LATENCY_STATES		(1<<7)		/* order states for read requests by their latency and load */
+#define DNET_CFG_FLAT_INDEXES		(1<<8)		/* store secondary index tables in flat format, all readers must support it */
+#define DNET_CFG_LOCALITY_STATES	(1<<9)		/* read from groups in the same locality (datacenter, rack) first */
+#define DNET_CFG_OUTLIER_STATES		(1<<10)		/* read from backends ejected by outlier detection last */
 
 static inline const char *dnet_flags_dump_cfgflags(uint64_t flags)
 {
@@ -187,6 +265,10 @@ static inline const char *dnet_flags_dump_cfgflags(uint64_t flags)
 		{ DNET_CFG_NO_CSUM, "no_csum" },
 		{ DNET_CFG_RANDOMIZE_STATES, "randomize_states" },
 		{ DNET_CFG_KEEPS_IDS_IN_CLUSTER, "keeps_ids_in_cluster" },
+		{ DNET_CFG_LATENCY_STATES, "latency_states" },
+		{ DNET_CFG_FLAT_INDEXES, "flat_indexes" },
+		{ DNET_CFG_LOCALITY_STATES, "locality_states" },
+		{ DNET_CFG_OUTLIER_STATES, "outlier_states" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -290,12 +372,35 @@ struct dnet_backend_callbacks {
 	int			(* defrag_start)(void *priv, enum dnet_backend_defrag_level level);
 	int			(* defrag_stop)(void *priv);
 
+	/*
+	 * Returns in @ratio share of the storage taken by removed records (0..1)
+	 * and in @disk identifier of the device it is stored on.
+	 * Used by node's defragmentation scheduler, optional.
+	 */
+	int			(* fragmentation)(void *priv, double *ratio, uint64_t *disk);
+
 	/*
 	 * Returns dir used by backend
 	 */
 	char *			(* dir)(void);
 
 	int			(* lookup)(struct dnet_node *n, void *priv, struct dnet_io_local *io);
+
+	/*
+	 * Reserves space for @io->size bytes of the record written from the beginning.
+	 * Returns in @fd a duplicated descriptor (closed by the caller) and in @offset
+	 * position within it where data has to be placed. Record is uncommitted until
+	 * DNET_CMD_WRITE with DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_COMMIT and @io->num
+	 * set to written size is processed. Optional, may return -ENOTSUP for given @io.
+	 */
+	int			(* write_stream_prepare)(void *priv, struct dnet_io_attr *io, int *fd, uint64_t *offset);
+
+	/*
+	 * Returns true if record @key is known to be absent without touching the storage,
+	 * for example it has recently been missed. Must not block, it is called by net threads
+	 * before request is queued to io pool. Optional.
+	 */
+	int			(* key_absent)(void *priv, const struct dnet_raw_id *key);
 };
 
 /*
@@ -357,6 +462,12 @@ struct dnet_config
 	 */
 	int			nonblocking_io_thread_num;
 
+	/*
+	 * If set, idle threads of backend's nonblocking pool process nonblocking requests
+	 * queued to busy nonblocking pools of other backends on the same numa node
+	 */
+	int			nonblocking_io_steal;
+
 	/*
 	 * Number of threads in network processing pool
 	 */
@@ -376,10 +487,165 @@ struct dnet_config
 	/* Number of shards to store indexes data */
 	int			indexes_shard_count;
 
+	/*
+	 * Index table of the shard which grows above this number of bytes is split in two by object ids,
+	 * split tables are stored next to the shard's table and are split again once they grow.
+	 * Zero disables splitting, tables which have already been split are still served.
+	 */
+	uint64_t		indexes_split_size;
+
 	/* Config values for srw backend */
 	struct srw_init_ctl	srw;
 
-	int			reserved_for_future_use_2[5];
+	/*
+	 * Number of connections opened to every server node (1 if not set).
+	 * With 2 or more connections requests of large_request_size bytes and reads of
+	 * the whole object or at least that size are sent through the dedicated connection,
+	 * others are spread over the rest by transaction number.
+	 */
+	int			connections_per_node;
+	int			large_request_size;
+
+	/*
+	 * Number of client shards, server nodes ignore it.
+	 * Every shard is a network thread bound to its own CPU which owns a connection to every
+	 * server node and completes replies received through it right in that thread,
+	 * data requests are sent through the shard of the submitting thread.
+	 * It overrides net_thread_num and connections_per_node, completion callbacks
+	 * must not block since they delay the whole shard.
+	 */
+	int			client_shards;
+
+	/*
+	 * Maximum number of connections being established at once while adding remotes
+	 * and nodes from their route lists, others wait for free slots. Zero means no limit.
+	 */
+	int			connect_concurrency;
+
+	/*
+	 * Number of server shards, client nodes ignore it.
+	 * Every shard is a network thread bound to its own CPU with its own SO_REUSEPORT listening
+	 * socket, connections accepted by it are served by it. Small nonblocking requests which are
+	 * served by the cache only or do not need backend are processed right in the shard instead
+	 * of being queued to io pool. It overrides net_thread_num.
+	 */
+	int			server_shards;
+
+	/*
+	 * Directory where ids received from every server node are cached with their generation.
+	 * Reconnecting node sends cached generation and server sends ids only if they have changed.
+	 * NULL disables the cache.
+	 */
+	const char		*route_cache_dir;
+
+	/*
+	 * Maximum number of bytes of received request bodies held in memory by the node
+	 * and by single connection, zero disables the limit. When a limit is reached, connection is not read
+	 * until processed requests release their memory, request larger than the limit is received
+	 * once nothing else is held. Replies are not limited.
+	 */
+	uint64_t		recv_memory_limit;
+	uint64_t		recv_connection_limit;
+
+	/*
+	 * Memory governor: limit of memory held by cache, received request bodies and queued replies
+	 * of the whole node and budgets of every of them, zero disables the limit.
+	 * Caches shrink once usage goes above 90% of the limit or budget, receives are deferred
+	 * and iterators pause while limit is reached.
+	 */
+	uint64_t		memory_limit;
+	uint64_t		memory_cache_budget;
+	uint64_t		memory_recv_budget;
+	uint64_t		memory_send_budget;
+
+	/*
+	 * Body of plain write of at least this number of bytes is not buffered in memory:
+	 * backend which supports streaming reserves space for it and net thread moves data
+	 * from socket right into the backend's file, write is committed once all bytes are there.
+	 * Zero disables streaming writes.
+	 */
+	uint64_t		stream_write_size;
+
+	/*
+	 * Low-latency network profile, zero keeps kernel defaults.
+	 * Every connection has Nagle's algorithm disabled anyway, parts of a request
+	 * are sent with MSG_MORE and leave together. @socket_send_buffer and
+	 * @socket_receive_buffer set SO_SNDBUF/SO_RCVBUF in bytes and turn off their autotuning.
+	 * @busy_poll_usecs sets SO_BUSY_POLL of every connection and makes net threads
+	 * poll their sockets for that long before they sleep in epoll_wait().
+	 * When server shards are enabled, every shard's listening socket also gets SO_INCOMING_CPU
+	 * of the CPU its net thread is bound to, so connections are accepted where their packets arrive.
+	 */
+	int			socket_send_buffer;
+	int			socket_receive_buffer;
+	int			busy_poll_usecs;
+
+	/*
+	 * Comma separated list of networks in CIDR notation (like "10.1.0.0/16,fd00::/8")
+	 * connections to which compress command payloads of at least @wire_compression_threshold
+	 * bytes (4096 if zero) with LZ4. Compression is asked by joining node and enabled
+	 * only if remote node supports it, connections to other addresses are not affected.
+	 * NULL disables wire compression.
+	 */
+	const char		*wire_compression_networks;
+	uint64_t		wire_compression_threshold;
+
+	/*
+	 * Replies are sent to joined nodes with short header which omits the key and references
+	 * request by transaction number only. Asked by joining node and used if both nodes set it.
+	 */
+	int			short_header;
+
+	/*
+	 * Comma separated list of networks (the same notation as @wire_compression_networks)
+	 * connections to and from which are encrypted with TLS. Both peers have to list each other,
+	 * present certificate @tls_cert_file with key @tls_key_file and verify peer's one against @tls_ca_file.
+	 * Only handshake is made in user space, records are encrypted by the kernel (kTLS) or NIC,
+	 * so large replies are still sent from files with sendfile(). Connection which can not
+	 * get kernel TLS is dropped. NULL disables encryption.
+	 */
+	const char		*tls_networks;
+	const char		*tls_cert_file;
+	const char		*tls_key_file;
+	const char		*tls_ca_file;
+
+	/*
+	 * Locality label (datacenter, rack) of this node and localities of remote networks:
+	 * semicolon separated list of "label=network,network" entries with networks in the notation
+	 * of @wire_compression_networks, like "dc-a=10.1.0.0/16;dc-b=10.2.0.0/16,fd02::/16",
+	 * the first entry whose network matches an address wins.
+	 * With DNET_CFG_LOCALITY_STATES reads try groups served from @locality first, in the order
+	 * of the other state selection flags, and fall back to remote groups on error or timeout.
+	 */
+	const char		*locality;
+	const char		*localities;
+
+	/*
+	 * Back cache value slabs and receive buffer pools with huge pages, one of dnet_huge_pages_mode
+	 * from library/hugepage.h: 1 - transparent huge pages asked with madvise(), 2 - 2 MB pages
+	 * of hugetlbfs, 3 - 1 GB pages of hugetlbfs for cache slabs. Regions which can not get
+	 * the requested pages fall back to transparent and then to regular pages.
+	 * Mode is process-wide, zero keeps regular allocations.
+	 */
+	int			huge_pages;
+
+	/*
+	 * Directory of unix domain sockets of co-located server nodes. Server listens a socket
+	 * named after every its address (like "/run/elliptics/10.0.0.1:1025:2") in addition to TCP,
+	 * client connects to such socket instead of TCP address if it exists and falls back to TCP
+	 * otherwise. Address of the server in the route table stays the same. Clients connected
+	 * via socket are seen by the server as loopback address of its family. NULL disables it.
+	 */
+	const char		*local_socket_dir;
+
+	/*
+	 * Queued requests whose data gathered into one send call takes at least this number of bytes
+	 * are sent with MSG_ZEROCOPY: kernel transmits their pages instead of copying them, and request
+	 * is freed once completion of the send arrives from socket's error queue. File parts are sent
+	 * with sendfile() anyway. Encrypted connections and sockets which can not enable SO_ZEROCOPY
+	 * copy data as usual. Zero disables zero-copy sends.
+	 */
+	uint64_t		zerocopy_send_size;
 
 	/* Config file name for handystats library */
 	const char 	*handystats_config;
@@ -425,11 +691,48 @@ void dnet_session_set_user_flags(struct dnet_session *s, uint64_t user_flags);
 uint64_t dnet_session_get_user_flags(struct dnet_session *s);
 
 void dnet_session_set_timeout(struct dnet_session *s, long wait_timeout);
+/* transaction deadlines are checked with DNET_TRANS_TIMER_TICK_MS (10 ms) resolution */
+void dnet_session_set_timeout_ms(struct dnet_session *s, long wait_timeout_ms);
+
+/*
+ * When @percentile is not zero, read is also sent to the next group if the first one
+ * has not replied within @percentile of its read latency, the first reply wins
+ */
+void dnet_session_set_hedged_read(struct dnet_session *s, int percentile);
+int dnet_session_get_hedged_read(struct dnet_session *s);
+
+/*
+ * When @percentile is not zero, timeout of read and lookup transactions is @multiplier times @percentile
+ * of the latency of the backend they are sent to, but not less than @min_timeout_ms. It never exceeds
+ * the session timeout, which is also used until the backend has latency samples.
+ */
+void dnet_session_set_adaptive_timeout(struct dnet_session *s, int percentile, int multiplier, long min_timeout_ms);
+int dnet_session_get_adaptive_timeout_percentile(struct dnet_session *s);
+int dnet_session_get_adaptive_timeout_multiplier(struct dnet_session *s);
+long dnet_session_get_adaptive_timeout_min_ms(struct dnet_session *s);
+
+/*
+ * Limits bytes and keys per second of every iterator and server-send started by the session, 0 - unlimited.
+ * Backend may also have its own limits of all such requests, see DNET_BACKEND_SET_RATE.
+ */
+void dnet_session_set_background_rate(struct dnet_session *s, uint64_t rate_bytes, uint64_t rate_keys);
+uint64_t dnet_session_get_background_rate_bytes(struct dnet_session *s);
+uint64_t dnet_session_get_background_rate_keys(struct dnet_session *s);
+
+/*
+ * Number of parallel workers of every iterator started by the session, 0 and 1 mean single thread.
+ * Keys iterated by different workers are sent interleaved, but progress counters are shared.
+ */
+void dnet_session_set_iterator_threads(struct dnet_session *s, uint32_t threads);
+uint32_t dnet_session_get_iterator_threads(struct dnet_session *s);
+
 struct timespec *dnet_session_get_timeout(struct dnet_session *s);
 
 void dnet_set_keepalive(struct dnet_node *n, int idle, int cnt, int interval);
 
 int dnet_session_set_ns(struct dnet_session *s, const char *ns, int nsize);
+/* returns namespace of the session and stores its size to @nsize, NULL if namespace is not set */
+const char *dnet_session_get_ns(struct dnet_session *s, int *nsize);
 
 struct dnet_node *dnet_session_get_node(struct dnet_session *s);
 
@@ -675,13 +978,25 @@ static inline int dnet_time_cmp(const struct dnet_time *t1, const struct dnet_ti
  */
 static inline int dnet_id_cmp_str(const unsigned char *id1, const unsigned char *id2)
 {
-	unsigned int i = 0;
+	unsigned int i;
 
-	for (i*=sizeof(unsigned long); i<DNET_ID_SIZE; ++i) {
-		if (id1[i] < id2[i])
-			return -1;
-		if (id1[i] > id2[i])
-			return 1;
+	/*
+	 * IDs are compared by big-endian 64-bit words, the number of words is known at compile time,
+	 * so the loop is unrolled and there is neither byte loop nor call to memcmp()
+	 */
+	for (i = 0; i < DNET_ID_SIZE; i += sizeof(uint64_t)) {
+		uint64_t w1, w2;
+
+		memcpy(&w1, id1 + i, sizeof(uint64_t));
+		memcpy(&w2, id2 + i, sizeof(uint64_t));
+
+		if (w1 != w2) {
+#ifndef WORDS_BIGENDIAN
+			w1 = __builtin_bswap64(w1);
+			w2 = __builtin_bswap64(w2);
+#endif
+			return w1 < w2 ? -1 : 1;
+		}
 	}
 
 	return 0;
@@ -725,6 +1040,14 @@ struct dnet_trans_control
 	void			*data;
 	unsigned int		size;
 
+	/*
+	 * If @data_release is set, @data is referenced instead of being copied: @data_acquire(@data_priv)
+	 * is called for the created transaction and @data_release(@data_priv) when its request is sent or dropped
+	 */
+	void			(*data_acquire)(void *priv);
+	void			(*data_release)(void *priv);
+	void			*data_priv;
+
 	int			(* complete)(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv);
 	void			*priv;
 };
@@ -751,6 +1074,12 @@ int __attribute__((weak)) dnet_transform_node(struct dnet_node *n, const void *s
 		unsigned char *csum, int csize);
 int dnet_transform_raw(struct dnet_session *s, const void *src, uint64_t size, char *csum, unsigned int csize);
 int dnet_transform_file(struct dnet_node *n, int fd, uint64_t offset, uint64_t size, char *csum, unsigned int csize);
+/*
+ * Transforms @num buffers @src of sizes @size into @ids at once,
+ * which is faster than transforming them one by one.
+ */
+int dnet_transform_multi(struct dnet_session *s, const void *const *src, const uint64_t *size,
+		size_t num, struct dnet_raw_id *ids);
 
 /*
  * Transformation implementation, currently it's sha512 hash.
@@ -790,8 +1119,21 @@ void dnet_indexes_transform_index_id_raw(struct dnet_node *node, struct dnet_raw
  * It's equal to iterative calls of _prepare and _id_raw method.
  */
 void dnet_indexes_transform_index_id(struct dnet_node *node, const struct dnet_raw_id *src, struct dnet_raw_id *id, int shard_id);
+/*
+ * Transform id of secondary index's objects table to id where to store insertion order of capped collection.
+ * It shares the shard part with the table, so both of them are stored by the same server.
+ */
+void dnet_indexes_transform_capped_ring_id(struct dnet_node *node, const struct dnet_raw_id *table_id, struct dnet_raw_id *id);
 int dnet_indexes_get_shard_id(struct dnet_node *node, const struct dnet_raw_id *object_id);
 int dnet_node_get_indexes_shard_count(struct dnet_node *node);
+/*
+ * Transform id of secondary index's objects table which has been split @split_depth times to id of its
+ * part @slot. Parts share the shard part with the table, so all of them are stored by the same server.
+ * _slot method returns the part which holds the object.
+ */
+void dnet_indexes_transform_index_split_id(const struct dnet_raw_id *table_id, int split_depth, unsigned int slot,
+		struct dnet_raw_id *id);
+unsigned int dnet_indexes_get_split_slot(const struct dnet_raw_id *object_id, int split_depth);
 
 int dnet_lookup_addr(struct dnet_session *s, const void *remote, int len, const struct dnet_id *id, int group_id,
 		struct dnet_addr *addr, int *backend);
@@ -877,18 +1219,58 @@ static inline int is_trans_destroyed(struct dnet_cmd *cmd)
 
 int dnet_mix_states(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags, int **groupsp);
 
+/*
+ * Returns in @latency_us @percentile of read latency of the backend which serves @id in @id->group_id.
+ * Returns -ENOENT if there is no such backend or nothing has been read from it yet.
+ */
+int dnet_get_read_latency(struct dnet_node *n, struct dnet_id *id, int percentile, long *latency_us);
+
+/*
+ * Calls @call(@priv, 0) from checking thread not earlier than @delay_ms milliseconds later
+ * with DNET_TRANS_TIMER_TICK_MS resolution. Calls pending at node destruction get -ECANCELED.
+ */
+int dnet_node_schedule_call(struct dnet_node *n, long delay_ms, void (*call)(void *priv, int err), void *priv);
+
+/*
+ * Limits retries of failed requests in the next group and hedged reads of all sessions of the node
+ * to @percent of requests plus a reserve of DNET_RETRY_BUDGET_RESERVE retries. 0 disables the limit.
+ */
+#define DNET_RETRY_BUDGET_RESERVE	10
+void dnet_node_set_retry_budget(struct dnet_node *n, int percent);
+int dnet_node_get_retry_budget(struct dnet_node *n);
+
+/* Accounts a new request in the retry budget */
+void dnet_node_retry_budget_deposit(struct dnet_node *n);
+/* Returns 0 and accounts a retry if the budget allows it, -EAGAIN otherwise */
+int dnet_node_retry_budget_withdraw(struct dnet_node *n);
+
 char * __attribute__((weak)) dnet_cmd_string(int cmd);
 const char *dnet_backend_state_string(uint32_t state);
 const char *dnet_backend_defrag_state_string(uint32_t state);
+const char *dnet_backend_activation_stage_string(uint32_t stage);
 
 int dnet_checksum_file(struct dnet_node *n, const char *file, uint64_t offset, uint64_t size, void *csum, int csize);
 int dnet_checksum_fd(struct dnet_node *n, int fd, uint64_t offset, uint64_t size, void *csum, int csize);
 int dnet_checksum_data(struct dnet_node *n, const void *data, uint64_t size, unsigned char *csum, int csize);
 
+/*
+ * Checksum of given algorithm (one of dnet_checksum_types),
+ * functions above always use SHA512 node transform.
+ * Shorter checksums are stored big-endian at the start of @csum and the rest of it is zeroed.
+ */
+int dnet_checksum_fd_type(struct dnet_node *n, int type, int fd, uint64_t offset, uint64_t size, void *csum, int csize);
+int dnet_checksum_data_type(struct dnet_node *n, int type, const void *data, uint64_t size, unsigned char *csum, int csize);
+
 int dnet_send_file_info(void *state, struct dnet_cmd *cmd, int fd, uint64_t offset, int64_t size);
 int dnet_send_file_info_without_fd(void *state, struct dnet_cmd *cmd, const void *data, int64_t size);
 int dnet_send_file_info_ts(void *state, struct dnet_cmd *cmd, int fd,
                            uint64_t offset, int64_t size, struct dnet_time *timestamp, uint64_t record_flags);
+/*
+ * Same as dnet_send_file_info_ts(), @path is the name of @fd's file known to the caller.
+ * If @path is NULL it is resolved via /proc/self/fd, it is not needed at all with DNET_FLAGS_NO_FILE_PATH.
+ */
+int dnet_send_file_info_ts_path(void *state, struct dnet_cmd *cmd, int fd, const char *path,
+                           uint64_t offset, int64_t size, struct dnet_time *timestamp, uint64_t record_flags);
 int dnet_send_file_info_ts_without_fd(void *state, struct dnet_cmd *cmd, const void *data, int64_t size, struct dnet_time *timestamp);
 
 
@@ -900,6 +1282,14 @@ int dnet_send_file_info_ts_without_fd(void *state, struct dnet_cmd *cmd, const v
 int dnet_send_reply(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size, int more);
 int dnet_send_reply_threshold(void *state, struct dnet_cmd *cmd,
 		const void *odata, unsigned int size, int more);
+/*
+ * Same as dnet_send_reply(), but @odata is handed over to the send queue instead of being copied:
+ * @release(@priv) is called once reply has been sent or dropped, even if this function returns error
+ */
+int dnet_send_reply_ref(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size,
+		void (*release)(void *priv), void *priv, int more);
+int dnet_send_reply_threshold_ref(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size,
+		void (*release)(void *priv), void *priv, int more);
 
 struct dnet_route_entry
 {
@@ -0,0 +1,126 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ELLIPTICS_ITERATOR_FILTER_H
+#define __ELLIPTICS_ITERATOR_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <elliptics/core.h>
+#include <elliptics/packet.h>
+
+/*
+ * Native filter of DNET_ITYPE_FILTER iterator.
+ *
+ * Filter is a shared library NAME.so in the directory set by "iterator_filter_dir" option of the server,
+ * it exports DNET_ITERATOR_FILTER_SYMBOL of type struct dnet_iterator_filter. Iterator loads the library
+ * by the name sent by client, feeds every iterated record to the filter and sends to client only results
+ * filter has emitted, each one as an iterator response with @key followed by @data.
+ */
+#define DNET_ITERATOR_FILTER_SYMBOL	"dnet_iterator_filter"
+
+/*
+ * Iterated record, its data is @size bytes of @fd at @offset, filter reads it by itself if it needs it.
+ * Descriptor is valid only until process() returns, it is negative if backend can't provide it.
+ * Records passed to record filters may have data in memory instead, then @data is not NULL and
+ * @offset is an offset within it.
+ */
+struct dnet_iterator_filter_record {
+	struct dnet_raw_id	key;
+	struct dnet_time	timestamp;
+	uint64_t		user_flags;
+	uint64_t		flags;		/* DNET_RECORD_FLAGS_* */
+	int			fd;
+	uint64_t		offset;
+	uint64_t		size;
+	const void		*data;
+};
+
+/*
+ * Sends result to client, it can be called from process() and finish() only
+ */
+typedef int (*dnet_iterator_filter_emit_t)(void *emit_priv, const struct dnet_raw_id *key,
+		const void *data, uint64_t size);
+
+struct dnet_iterator_filter {
+	/* creates filter's context for one iteration, @arg is an opaque argument sent by client */
+	int (*init)(void **priv, const void *arg, uint64_t arg_size);
+	/*
+	 * Called for every record, in parallel if iterator runs several threads.
+	 * Negative return value stops iteration with this error.
+	 */
+	int (*process)(void *priv, const struct dnet_iterator_filter_record *rec,
+			dnet_iterator_filter_emit_t emit, void *emit_priv);
+	/* called once when all records have been processed, aggregate is usually emitted here */
+	int (*finish)(void *priv, dnet_iterator_filter_emit_t emit, void *emit_priv);
+	/* frees context created by init(), it is called even if iteration has failed */
+	void (*cleanup)(void *priv);
+};
+
+/*
+ * Record filter is loaded once when backend is initialized, its libraries are listed in "record_filters"
+ * section of the backend config and are searched in "iterator_filter_dir" as NAME.so exporting
+ * DNET_RECORD_FILTER_SYMBOL of type struct dnet_record_filter.
+ *
+ * Filters are applied in order of the config to read replies with DNET_IO_FLAGS_FILTER and to records
+ * of iterators with DNET_IFLAGS_FILTER. They run right on the send path, so they must be cheap:
+ * time spent by all filters of the backend is limited by its "record_filter_budget".
+ */
+#define DNET_RECORD_FILTER_SYMBOL	"dnet_record_filter"
+
+/* record is not sent: read fails with -ENOENT, iterator skips it */
+#define DNET_RECORD_FILTER_SKIP		1
+
+struct dnet_record_filter {
+	/* creates filter's context, @config is "config" string of the filter in the backend config or NULL */
+	int (*init)(void **priv, const char *config);
+	/*
+	 * Called for every record of DNET_CMD_READ or DNET_CMD_ITERATOR @cmd, possibly from many threads at once.
+	 * Returns 0 to send the record, DNET_RECORD_FILTER_SKIP to drop it or negative error.
+	 * Filter may narrow @rec->offset and @rec->size to send only a part of the data, the part must lie
+	 * within the original one. Data itself is never copied, it is sent from the same descriptor or buffer.
+	 */
+	int (*filter)(void *priv, int cmd, struct dnet_iterator_filter_record *rec);
+	void (*cleanup)(void *priv);
+};
+
+/*
+ * Update filter executes DNET_CMD_ATOMIC_UPDATE of DNET_ATOMIC_FILTER type. It is NAME.so in
+ * "iterator_filter_dir" exporting DNET_UPDATE_FILTER_SYMBOL of type struct dnet_update_filter,
+ * the library is loaded by the first update which uses it and stays loaded until the node is stopped.
+ */
+#define DNET_UPDATE_FILTER_SYMBOL	"dnet_update_filter"
+
+struct dnet_update_filter {
+	/*
+	 * Computes new data of the record @rec from its current data and opaque argument @arg sent by client.
+	 * @rec->data holds the whole record, missing record has zero size and empty timestamp.
+	 * It is called while the key is locked, different keys are updated in parallel.
+	 * New data must be allocated by malloc(), it is freed by elliptics.
+	 * Negative return value fails the update with this error.
+	 */
+	int (*update)(const struct dnet_iterator_filter_record *rec, const void *arg, uint64_t arg_size,
+			void **data, uint64_t *size);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELLIPTICS_ITERATOR_FILTER_H */
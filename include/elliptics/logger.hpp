@@ -2,6 +2,7 @@
 #define __IOREMAP_LOGGER_HPP
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -90,6 +91,15 @@ void dnet_log_write(dnet_logger *logger, dnet_logger_record *record, const char
 void dnet_log_write_err(dnet_logger *logger, dnet_logger_record *record, int err, const char *format, ...) __attribute__ ((format(printf, 4, 5)));
 void dnet_log_close_record(dnet_logger_record *record);
 
+/*
+ * Moves writing of records to background thread, every logging thread gets its own ring of @ring_size records.
+ * Calls are reference counted, rings created after a call get the largest @ring_size asked so far.
+ * Every dnet_log_async_stop() writes all pending records before it returns, so the caller may free
+ * its logger once its own threads do not log anymore, the last call also stops the background thread.
+ */
+void dnet_log_async_start(size_t ring_size);
+void dnet_log_async_stop();
+
 #undef ELLIPTICS_LOG_LEVEL
 
 #ifdef __cplusplus
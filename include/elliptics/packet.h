@@ -76,6 +76,10 @@ enum dnet_commands {
 	DNET_CMD_BACKEND_CONTROL,		/* Special command to start or stop backends */
 	DNET_CMD_BACKEND_STATUS,		/* Special command to see current statuses of backends */
 	DNET_CMD_SEND,				/* Send given set of local keys to remote groups */
+	DNET_CMD_BULK_WRITE,			/* Write a number of keys at one time, every key is acked separately */
+	DNET_CMD_ATOMIC_UPDATE,			/* Read-modify-write of the key executed on the server under key's lock */
+	DNET_CMD_BULK_REMOVE,			/* Remove a number of keys at one time, statuses are sent in one reply */
+	DNET_CMD_BLOB_FILES,			/* List and read sealed data files of the backend to copy them to another node */
 	DNET_CMD_UNKNOWN,			/* This slot is allocated for statistics gathered for unknown commands */
 	__DNET_CMD_MAX,
 };
@@ -101,6 +105,9 @@ enum dnet_commands {
 #define DNET_MONITOR_STATS		(1<<5)				/* statistics gathered by handystats */
 #define DNET_MONITOR_PROCFS		(1<<6)				/* virtual memory statistics */
 #define DNET_MONITOR_TOP		(1<<7)				/* statistics of top keys ordered by generated traffic */
+#define DNET_MONITOR_SLOW		(1<<8)				/* the most recent slow requests of every backend */
+#define DNET_MONITOR_LOCKS		(1<<9)				/* wait and hold times of core locks */
+#define DNET_MONITOR_HEATMAP		(1<<10)				/* requests and bytes of key ranges of every backend */
 #define DNET_MONITOR_ALL		(-1)				/* all available statistics */
 
 enum dnet_backend_command {
@@ -111,7 +118,11 @@ enum dnet_backend_command {
 	DNET_BACKEND_READ_ONLY,
 	DNET_BACKEND_WRITEABLE,
 	DNET_BACKEND_CTL,		// change internal parameters like delay
-	DNET_BACKEND_STOP_DEFRAG
+	DNET_BACKEND_STOP_DEFRAG,
+	DNET_BACKEND_SET_RATE,		// change rate limits of iterators and server-send
+	DNET_BACKEND_RELOAD,		// reopen storage with new config keeping its cache and io pools
+	DNET_BACKEND_SET_FAULTS,	// replace fault injection rules, servers built without DNET_FAULT_INJECTION reply -ENOTSUP
+	DNET_BACKEND_RESIZE_CACHE,	// change cache size and pages proportions, cache keeps its objects
 };
 
 enum dnet_backend_state {
@@ -129,6 +140,20 @@ enum dnet_backend_defrag_state {
 	DNET_BACKEND_COMPACT_IN_PROGRESS,
 };
 
+/*
+ * Step of backend initialization reported in status while backend is activating,
+ * DNET_BACKEND_STAGE_STORAGE is usually the longest one as storage loads its indexes
+ */
+enum dnet_backend_activation_stage {
+	DNET_BACKEND_STAGE_NONE = 0,
+	DNET_BACKEND_STAGE_CONFIG,
+	DNET_BACKEND_STAGE_STORAGE,
+	DNET_BACKEND_STAGE_CHANGE_LOG,
+	DNET_BACKEND_STAGE_IO_POOL,
+	DNET_BACKEND_STAGE_CACHE,
+	DNET_BACKEND_STAGE_ROUTES,
+};
+
 enum dnet_backend_defrag_level {
 	DNET_BACKEND_DEFRAG_FULL = 0,
 	DNET_BACKEND_DEFRAG_COMPACT,
@@ -176,6 +201,51 @@ enum dnet_backend_defrag_level {
 /* This reply was generated on server, and it IS reply from the server */
 #define DNET_FLAGS_REPLY		(1<<9)
 
+/*
+ * Reply data contains several replies of the same transaction packed together,
+ * each one is a dnet_cmd header followed by its data. Server sends such replies
+ * only if client has asked for it (see DNET_IFLAGS_BATCH_REPLIES).
+ */
+#define DNET_FLAGS_BATCH		(1<<10)
+
+/*
+ * Background request (recovery, server-side send and so on): io pools process it
+ * only with capacity left by interactive requests, see dnet_request_queue.
+ */
+#define DNET_FLAGS_BACKGROUND		(1<<11)
+
+/*
+ * Reply data is dnet_iterator_compact_header followed by packed iterator responses,
+ * client library unpacks them into ordinary responses. See DNET_IFLAGS_COMPACT.
+ */
+#define DNET_FLAGS_COMPACT		(1<<12)
+
+/*
+ * Reverse lookup reply data is followed by dnet_route_generation of the server's ids.
+ * Server sends it only if client has sent its cached generation in the request.
+ */
+#define DNET_FLAGS_ROUTE_GENERATION	(1<<13)
+
+/*
+ * File info reply to write or lookup with this flag has no file path (its flen is 0),
+ * so server does not have to resolve path of the blob. Set it if path is not used.
+ */
+#define DNET_FLAGS_NO_FILE_PATH		(1<<14)
+
+/*
+ * Payload of the command is compressed: it starts with 64-bit original size of the payload
+ * followed by LZ4 block. Sent only over connections negotiated DNET_AUTH_FLAGS_COMPRESSION,
+ * receiver restores original payload and clears the flag before processing the command.
+ */
+#define DNET_FLAGS_COMPRESSED		(1<<15)
+
+/*
+ * WRITE is replicated by the server: io attribute is followed by struct dnet_replicate_request,
+ * which is covered by io->size. Node of the primary group writes data locally and forwards it
+ * to the rest of groups, see struct dnet_replicate_request for the replies.
+ */
+#define DNET_FLAGS_REPLICATE		(1<<16)
+
 struct flag_info
 {
 	uint64_t flag;
@@ -224,6 +294,13 @@ static inline const char *dnet_flags_dump_cflags(uint64_t flags)
 		{ DNET_FLAGS_DIRECT_BACKEND, "direct_backend" },
 		{ DNET_FLAGS_TRACE_BIT, "tracebit" },
 		{ DNET_FLAGS_REPLY, "reply" },
+		{ DNET_FLAGS_BATCH, "batch" },
+		{ DNET_FLAGS_BACKGROUND, "background" },
+		{ DNET_FLAGS_COMPACT, "compact" },
+		{ DNET_FLAGS_ROUTE_GENERATION, "route_generation" },
+		{ DNET_FLAGS_NO_FILE_PATH, "no_file_path" },
+		{ DNET_FLAGS_COMPRESSED, "compressed" },
+		{ DNET_FLAGS_REPLICATE, "replicate" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -292,6 +369,11 @@ static inline void dnet_convert_cmd(struct dnet_cmd *cmd)
 /* Bulk request for checking files */
 #define DNET_ATTR_BULK_CHECK			(1ULL<<32)
 
+/*
+ * DNET_CMD_BULK_WRITE replies with statuses of all keys at once, see struct dnet_bulk_write_reply
+ */
+#define DNET_ATTR_BULK_WRITE_STATUSES		(1ULL<<33)
+
 /*
  * ascending sort data before returning range request to user
  */
@@ -349,18 +431,68 @@ struct dnet_backend_control
 {
 	uint32_t backend_id;
 	uint32_t command;
-	uint32_t reserved[13];
+	uint32_t faults_count;		// number of dnet_fault_rules following @ids
+	uint64_t cache_size;		// DNET_BACKEND_RESIZE_CACHE: new size of the whole cache
+	uint32_t cache_pages_count;	// number of uint32_t pages proportions following fault rules, 0 keeps them
+	uint32_t reserved[5];
+	uint64_t rate_bytes;		// bytes per second of iterators and server-send, 0 - unlimited
+	uint64_t rate_keys;		// keys per second of iterators and server-send, 0 - unlimited
 	uint32_t defrag_level;
 	uint32_t delay;
 	uint32_t ids_count;
 	struct dnet_raw_id ids[0];
 } __attribute__ ((packed));
 
+enum dnet_fault_distribution {
+	DNET_FAULT_DELAY_FIXED = 0,	// every delay is @delay_min
+	DNET_FAULT_DELAY_UNIFORM,	// uniformly distributed in [@delay_min, @delay_max]
+	DNET_FAULT_DELAY_EXPONENTIAL,	// exponentially distributed with mean @delay_min, capped by @delay_max if it is not zero
+};
+
+/* probability of dnet_fault_rule is measured in millionths */
+#define DNET_FAULT_PROBABILITY_MAX	1000000
+
+/*
+ * Fault injected into backend's requests, rules are checked in order and the first one which fires
+ * delays the request and then replies @error instead of processing it if @error is not zero.
+ * Requests are delayed in io threads, so delays of blocking commands also hold their pool.
+ */
+struct dnet_fault_rule
+{
+	uint32_t cmd;			// command the rule applies to, 0 - every command
+	uint32_t probability;		// chance to fire for every matching request, in millionths
+	int32_t error;			// negative errno, 0 - request is processed after delay
+	uint32_t distribution;		// enum dnet_fault_distribution
+	uint64_t delay_min;		// usecs
+	uint64_t delay_max;		// usecs
+	uint64_t reserved[2];
+} __attribute__ ((packed));
+
 struct dnet_id_container
 {
 	int backends_count;
 } __attribute__ ((packed));
 
+/* reply has no backends, ids of @generation cached by client are still valid */
+#define DNET_ROUTE_GENERATION_UNCHANGED		(1<<0)
+
+/*
+ * Generation of ids of all enabled backends of the node, it changes every time
+ * any backend is enabled, disabled or gets new ids. Zero means unknown generation.
+ * Client sends its cached generation as DNET_CMD_REVERSE_LOOKUP request data.
+ */
+struct dnet_route_generation
+{
+	uint64_t generation;
+	uint64_t flags;
+} __attribute__ ((packed));
+
+static inline void dnet_convert_route_generation(struct dnet_route_generation *gen)
+{
+	gen->generation = dnet_bswap64(gen->generation);
+	gen->flags = dnet_bswap64(gen->flags);
+}
+
 static inline void dnet_convert_id_container(struct dnet_id_container *cnt)
 {
 	cnt->backends_count = dnet_bswap32(cnt->backends_count);
@@ -559,6 +691,33 @@ static inline void dnet_convert_list(struct dnet_list *l)
  */
 #define DNET_IO_FLAGS_MIX_STATES	(1<<16)
 
+/*
+ * Read of large object which is not going to be read again soon,
+ * server may read it bypassing page cache not to displace hot data
+ */
+#define DNET_IO_FLAGS_STREAMING		(1<<17)
+
+/*
+ * Read reply passes through record filters of the backend (see struct dnet_record_filter),
+ * which may reject the record or narrow the part of it being sent
+ */
+#define DNET_IO_FLAGS_FILTER		(1<<18)
+
+/*
+ * Data is LZ4 compressed in the format of dnet_compression_types.
+ * Read request with this flag accepts compressed data: records stored compressed by the backend
+ * are sent as is and the flag is kept in the reply, otherwise it is cleared and data is decompressed.
+ * Write request with this flag stores already compressed data as compressed record.
+ */
+#define DNET_IO_FLAGS_COMPRESSED	(1<<19)
+
+/*
+ * DNET_CMD_BULK_READ with this flag does not read the keys, but asks their backends to load them
+ * into the cache in background ahead of expected reads, request is acked as soon as keys are queued.
+ * Loaded objects go through cache admission filter as if they have been read once.
+ */
+#define DNET_IO_FLAGS_CACHE_PREFETCH	(1<<20)
+
 
 static inline const char *dnet_flags_dump_ioflags(uint64_t flags)
 {
@@ -580,6 +739,10 @@ static inline const char *dnet_flags_dump_ioflags(uint64_t flags)
 		{ DNET_IO_FLAGS_CHECKSUM, "checksum/no_file_info" },
 		{ DNET_IO_FLAGS_CAS_TIMESTAMP, "cas_timestamp" },
 		{ DNET_IO_FLAGS_MIX_STATES, "mix_states" },
+		{ DNET_IO_FLAGS_STREAMING, "streaming" },
+		{ DNET_IO_FLAGS_FILTER, "filter" },
+		{ DNET_IO_FLAGS_COMPRESSED, "compressed" },
+		{ DNET_IO_FLAGS_CACHE_PREFETCH, "cache_prefetch" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -634,6 +797,40 @@ static inline const char *dnet_flags_dump_ioflags(uint64_t flags)
  */
 #define DNET_INDEXES_FLAGS_REMOVE_ONLY		(1<<4)
 
+/*
+ * DNET_INDEXES_FLAGS_LIMIT
+ *
+ * Request is followed by struct dnet_indexes_find_cursor (after the data of its last entry).
+ * At most cursor's limit objects are returned in order of their ids,
+ * starting right after cursor's id if DNET_INDEXES_CURSOR_AFTER is set.
+ *
+ * This flag is for DNET_CMD_INDEXES_FIND request only.
+ */
+#define DNET_INDEXES_FLAGS_LIMIT		(1<<5)
+
+/*
+ * DNET_INDEXES_FLAGS_BULK
+ *
+ * Request updates the single index table @id, ids of its entries are object ids
+ * and flags of every entry are DNET_INDEXES_FLAGS_INTERNAL_INSERT or DNET_INDEXES_FLAGS_INTERNAL_REMOVE.
+ * Reply contains status of every object.
+ *
+ * This flag is for DNET_CMD_INDEXES_INTERNAL request only.
+ */
+#define DNET_INDEXES_FLAGS_BULK			(1<<6)
+
+/*
+ * DNET_INDEXES_FLAGS_FETCH
+ *
+ * Request is followed by struct dnet_indexes_fetch (after the cursor if DNET_INDEXES_FLAGS_LIMIT is set).
+ * Every found object which belongs to the backend serving the request is read by the server
+ * and returned together with its index data. Other objects are returned with -ENOENT status,
+ * client has to read them itself.
+ *
+ * This flag is for DNET_CMD_INDEXES_FIND request only.
+ */
+#define DNET_INDEXES_FLAGS_FETCH		(1<<7)
+
 static inline const char *dnet_flags_dump_indexes(uint64_t flags)
 {
 	static __thread char buffer[256];
@@ -643,6 +840,9 @@ static inline const char *dnet_flags_dump_indexes(uint64_t flags)
 		{ DNET_INDEXES_FLAGS_UPDATE_ONLY, "update_only" },
 		{ DNET_INDEXES_FLAGS_MORE, "more" },
 		{ DNET_INDEXES_FLAGS_REMOVE_ONLY, "remove_only" },
+		{ DNET_INDEXES_FLAGS_LIMIT, "limit" },
+		{ DNET_INDEXES_FLAGS_BULK, "bulk" },
+		{ DNET_INDEXES_FLAGS_FETCH, "fetch" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -704,6 +904,13 @@ static inline const char *dnet_flags_dump_indexes(uint64_t flags)
  * This flag is for DNET_CMD_INDEXES_INTERNAL request only.
  */
 #define DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION	(1<<5)
+/*
+ * Objects evicted from capped collection are removed from the storage
+ * by the server which keeps the index.
+ *
+ * Use it in addition to DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION.
+ */
+#define DNET_INDEXES_FLAGS_INTERNAL_CAPPED_REMOVE_DATA	(1<<6)
 
 static inline const char *dnet_flags_dump_indexes_internal(uint64_t flags)
 {
@@ -715,6 +922,7 @@ static inline const char *dnet_flags_dump_indexes_internal(uint64_t flags)
 		{ DNET_INDEXES_FLAGS_INTERNAL_REMOVE_FROM_OBJECTS, "remove_from_objects" },
 		{ DNET_INDEXES_FLAGS_INTERNAL_REMOVE_FROM_STORAGE, "remove_from_storage" },
 		{ DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION, "capped_collection" },
+		{ DNET_INDEXES_FLAGS_INTERNAL_CAPPED_REMOVE_DATA, "capped_remove_data" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -780,10 +988,15 @@ struct dnet_backend_status
 	struct dnet_time last_start;
 	int32_t last_start_err;
 	uint8_t read_only;
-	uint8_t reserved_flags[7];
+	uint8_t activation_stage;	// dnet_backend_activation_stage, valid for activating backend
+	uint8_t reserved_flags[6];
 	uint32_t delay;			// delay in ms for each backend operation
-	uint32_t reserved1;
-	uint64_t reserved2[6];
+	uint32_t faults_count;		// number of fault injection rules set by DNET_BACKEND_SET_FAULTS
+	uint64_t rate_bytes;		// limits of iterators and server-send set by DNET_BACKEND_SET_RATE
+	uint64_t rate_keys;
+	struct dnet_time activation_start;	// when current activation has started
+	uint64_t cache_size;		// size of the cache changed by DNET_BACKEND_RESIZE_CACHE, 0 if there is no cache
+	uint64_t reserved2[1];
 } __attribute__ ((packed));
 
 struct dnet_backend_status_list
@@ -805,6 +1018,7 @@ struct dnet_io_attr
 	 *
 	 * @start is used in cache writes: it is treated as object lifetime in seconds, if zero, object is never removed.
 	 * When object's lifetime is over, it is removed from cache, but not from disk.
+	 * Eblob backend with "ttl_bucket_seconds" also treats @start of disk writes as lifetime of the record.
 	 */
 	uint64_t		start, num;
 
@@ -823,7 +1037,9 @@ struct dnet_io_attr
 	/* Combination of DNET_RECORD_FLAGS_* */
 	uint64_t		record_flags;
 
-	uint32_t		reserved2;
+	/* Algorithm (one of dnet_checksum_types) of checksum sent in @parent for DNET_IO_FLAGS_CHECKSUM reads */
+	uint8_t			csum_type;
+	uint8_t			reserved2[3];
 
 	uint32_t		flags;
 	uint64_t		offset;
@@ -944,6 +1160,27 @@ static inline void dnet_convert_node_status(struct dnet_node_status *st)
 
 #define DNET_AUTH_COOKIE_SIZE	32
 
+/*
+ * Joining node asks for compression of large command payloads on this connection.
+ * Server which supports it echoes dnet_auth with this flag in the reply.
+ */
+#define DNET_AUTH_FLAGS_COMPRESSION	(1<<0)
+
+/*
+ * Joining node asks server to send short headers over this connection, see DNET_SHORT_HEADER_MAX.
+ * Server which supports it echoes the flag, every header it sends after this reply is short.
+ */
+#define DNET_AUTH_FLAGS_SHORT_HEADER	(1<<1)
+
+/*
+ * Short header starts with its length byte. Zero length is followed by ordinary struct dnet_cmd,
+ * otherwise reply is described by that many bytes of LEB128 varints: trans, flags, size, status,
+ * cmd, backend_id and trace_id, status and backend_id are zigzag-encoded. They are followed by
+ * group_id varint and DNET_ID_SIZE bytes of key if key differs from the one of previous short
+ * header on this connection, otherwise receiver reuses that key. Both sides start with zero key.
+ */
+#define DNET_SHORT_HEADER_MAX		128
+
 struct dnet_auth {
 	char			cookie[DNET_AUTH_COOKIE_SIZE];
 	uint64_t		flags;
@@ -973,25 +1210,53 @@ enum dnet_ext_versions {
 	DNET_EXT_VERSION_LAST,
 };
 
+/*
+ * Algorithms of records' integrity checksums.
+ * Records written before checksum type was stored in extension header have zero there,
+ * so SHA512 must remain the first one.
+ */
+enum dnet_checksum_types {
+	DNET_CHECKSUM_SHA512 = 0,
+	DNET_CHECKSUM_CRC32C,
+	DNET_CHECKSUM_LAST,
+};
+
+/*
+ * Codecs of record's data stored by the backend.
+ * LZ4 compressed data starts with 64-bit little-endian size of the original data followed by LZ4 block.
+ */
+enum dnet_compression_types {
+	DNET_COMPRESSION_NONE = 0,
+	DNET_COMPRESSION_LZ4,
+	DNET_COMPRESSION_LAST,
+};
+
 /*! In-memory extension header */
 struct dnet_ext;
 
 /*! On-disk extension list header */
 struct dnet_ext_list_hdr {
 	uint8_t			version;	/* Extension header version */
-	uint8_t			__pad1[3];	/* For future use (should be NULLed) */
+	uint8_t			csum_type;	/* Algorithm of record's integrity checksum: dnet_checksum_types */
+	uint8_t			compression;	/* Codec of record's data: dnet_compression_types */
+	uint8_t			dedup;		/* Record's data is a list of chunks, see eblob backend's dedup_threshold */
 	uint32_t		size;		/* Size of all extensions */
 	struct dnet_time	timestamp;	/* Time stamp of record */
 	uint64_t		flags;		/* Custom flags for this record */
-	uint64_t		__pad2[2];	/* For future use (should be NULLed) */
+	uint64_t		expire;		/* Expiration time of record in seconds, 0 if it never expires */
+	uint64_t		__pad2[1];	/* For future use (should be NULLed) */
 } __attribute__ ((packed));
 
 /*! In-memory extension conatiner */
 struct dnet_ext_list {
 	uint8_t			version;	/* Extension header version */
+	uint8_t			csum_type;	/* Algorithm of record's integrity checksum */
+	uint8_t			compression;	/* Codec of record's data */
+	uint8_t			dedup;		/* Record's data is a list of chunks */
 	uint32_t		size;		/* Total size of extensions */
 	uint64_t		flags;		/* Custom flags for this record */
 	struct dnet_time	timestamp;	/* TS of header */
+	uint64_t		expire;		/* Expiration time of record in seconds, 0 if it never expires */
 	struct dnet_ext		**exts;		/* Array of pointers to extensions */
 	void			*data;		/* Pointer to original data before extraction */
 };
@@ -1029,6 +1294,62 @@ enum {
  * even if remote timestamp doesn't allow us to overwrite data.
  */
 #define DNET_IFLAGS_OVERWRITE		(1<<5)
+/*
+ * Network iterator may pack many small responses into single DNET_FLAGS_BATCH reply.
+ * Client library unpacks them transparently, but servers which do not know this flag reject such iterator.
+ */
+#define DNET_IFLAGS_BATCH_REPLIES	(1<<6)
+/*
+ * For DNET_ITYPE_SERVER_SEND only: before iteration server fetches metadata of the ranges
+ * from every remote group and sends only keys which are missing or older there.
+ * Metadata is transferred between servers only, it is never sent to client.
+ */
+#define DNET_IFLAGS_DIFF		(1<<7)
+
+/*
+ * For DNET_ITYPE_SERVER_SEND only: small keys are packed into DNET_CMD_BULK_WRITE commands
+ * instead of sending every key as separate WRITE command.
+ * Remote nodes must support DNET_CMD_BULK_WRITE.
+ */
+#define DNET_IFLAGS_BULK_WRITE		(1<<8)
+
+/*
+ * For DNET_ITYPE_NETWORK without DNET_IFLAGS_DATA only: metadata of iterated keys is sent
+ * in DNET_FLAGS_COMPACT replies. Keys are prefix-compressed against the previous key in the reply,
+ * other fields are varint-encoded, progress is sent once per reply.
+ */
+#define DNET_IFLAGS_COMPACT		(1<<9)
+
+/*
+ * For DNET_ITYPE_NETWORK without DNET_IFLAGS_DATA only: iterates the change log of the backend
+ * instead of its records, only writes and removals made after @changes_since are sent in order of changes.
+ * Response's @change_time is a cursor for the next request. Iterator fails with -ERANGE
+ * if some of these changes have been dropped from the log, then full iteration is needed.
+ * Zero @changes_since iterates all changes kept in the log.
+ * Backend must be configured with change_log.
+ */
+#define DNET_IFLAGS_CHANGES		(1<<10)
+
+/*
+ * For single-threaded DNET_ITYPE_NETWORK iterator only: responses with DNET_ITERATOR_STATUS_CHECKPOINT status
+ * and @dnet_iterator_checkpoint data are sent periodically, all keys before the checkpoint have been sent already.
+ * Request is followed by @dnet_iterator_checkpoint after ranges and groups, iteration continues after it
+ * if it is not zero. Iterator fails with -ESTALE if position of the checkpoint doesn't exist anymore.
+ */
+#define DNET_IFLAGS_CHECKPOINTS		(1<<11)
+
+/*
+ * For DNET_ITYPE_NETWORK without DNET_IFLAGS_DATA only: keys are sent in order of dnet_iterator_response_cmp(),
+ * so results of several backends can be merged on the fly. Server collects and sorts metadata of iterated keys
+ * before sending them, only keepalives are sent meanwhile.
+ */
+#define DNET_IFLAGS_ORDERED		(1<<12)
+
+/*
+ * Iterated records pass through record filters of the backend (see struct dnet_record_filter)
+ * before they are sent or processed, filters may skip records or narrow their data
+ */
+#define DNET_IFLAGS_FILTER		(1<<13)
 
 /* Sanity */
 #define DNET_IFLAGS_ALL			(DNET_IFLAGS_DATA | \
@@ -1036,7 +1357,15 @@ enum {
 					 DNET_IFLAGS_TS_RANGE | \
 					 DNET_IFLAGS_NO_META | \
 					 DNET_IFLAGS_MOVE | \
-					 DNET_IFLAGS_OVERWRITE)
+					 DNET_IFLAGS_OVERWRITE | \
+					 DNET_IFLAGS_BATCH_REPLIES | \
+					 DNET_IFLAGS_DIFF | \
+					 DNET_IFLAGS_BULK_WRITE | \
+					 DNET_IFLAGS_COMPACT | \
+					 DNET_IFLAGS_CHANGES | \
+					 DNET_IFLAGS_CHECKPOINTS | \
+					 DNET_IFLAGS_ORDERED | \
+					 DNET_IFLAGS_FILTER)
 
 /*
  * Defines how iterator should behave
@@ -1056,6 +1385,12 @@ enum dnet_iterator_types {
 	DNET_ITYPE_SERVER_SEND,		/* send iterated data to other servers in the storage via WRITE commands,
 					 * it doesn't sent uncommitted keys to servers, but sends response to client
 					 */
+	DNET_ITYPE_HASH,		/* iterator doesn't send keys, but sends one @dnet_iterator_range_hash
+					 * per requested range when iteration completes
+					 */
+	DNET_ITYPE_FILTER,		/* records are passed to native filter loaded by the server,
+					 * only results emitted by the filter are sent, see iterator_filter.h
+					 */
 	DNET_ITYPE_LAST,		/* Sanity */
 };
 
@@ -1092,7 +1427,12 @@ struct dnet_iterator_request
 	uint32_t			group_num;	/* Number of remote groups to send iterated data for server-send
 							   iterator type */
 	uint32_t			timeout;	/* write session timeout */
-	uint64_t			reserved[4];
+	uint64_t			rate_bytes;	/* bytes per second, 0 - unlimited */
+	uint64_t			rate_keys;	/* keys per second, 0 - unlimited */
+	uint32_t			threads;	/* number of parallel workers, 0 or 1 - single thread */
+	uint32_t			filter_size;	/* DNET_ITYPE_FILTER: size of filter name with trailing zero
+							   and its argument, they follow the rest of request */
+	uint64_t			changes_since;	/* DNET_IFLAGS_CHANGES: usecs, changes after it are iterated */
 } __attribute__ ((packed));
 
 static inline void dnet_convert_iterator_request(struct dnet_iterator_request *r)
@@ -1104,6 +1444,11 @@ static inline void dnet_convert_iterator_request(struct dnet_iterator_request *r
 	r->range_num = dnet_bswap64(r->range_num);
 	r->group_num = dnet_bswap32(r->group_num);
 	r->timeout = dnet_bswap32(r->timeout);
+	r->rate_bytes = dnet_bswap64(r->rate_bytes);
+	r->rate_keys = dnet_bswap64(r->rate_keys);
+	r->threads = dnet_bswap32(r->threads);
+	r->filter_size = dnet_bswap32(r->filter_size);
+	r->changes_since = dnet_bswap64(r->changes_since);
 	dnet_convert_time(&r->time_begin);
 	dnet_convert_time(&r->time_end);
 }
@@ -1128,6 +1473,19 @@ static inline void dnet_convert_iterator_request(struct dnet_iterator_request *r
 /* This flags is set for records that is checksummed by chunks */
 #define DNET_RECORD_FLAGS_CHUNKED_CSUM		(1<<8)
 
+/*
+ * Record's data is compressed by the backend (see dnet_compression_types),
+ * it is not an eblob flag, elliptics sets it in iterator responses and read replies of such records
+ */
+#define DNET_RECORD_FLAGS_COMPRESSED		(1ULL<<32)
+
+/*
+ * Record is stored by the backend as a list of deduplicated chunks, it is not an eblob flag either.
+ * Iterator reports the size of the original data, but fd and offset passed along with such record
+ * describe the list, so its data is neither sent by iterators nor copied by server-send as is.
+ */
+#define DNET_RECORD_FLAGS_DEDUP			(1ULL<<33)
+
 /*
  * Iterator response
  * TODO: Maybe it's better to include whole ehdr in response
@@ -1143,7 +1501,7 @@ struct dnet_iterator_response
 	uint64_t			iterated_keys;	/* Number of keys that has been iterated */
 	uint64_t			total_keys;	/* Total number of keys that will be iterated */
 	uint64_t			flags;		/* Combination of DNET_RECORD_FLAGS_* */
-	uint64_t			reserved[1];
+	uint64_t			change_time;	/* DNET_IFLAGS_CHANGES: usecs when the change was made */
 } __attribute__ ((packed));
 
 static inline void dnet_convert_iterator_response(struct dnet_iterator_response *r)
@@ -1155,9 +1513,78 @@ static inline void dnet_convert_iterator_response(struct dnet_iterator_response
 	r->iterated_keys = dnet_bswap64(r->iterated_keys);
 	r->total_keys = dnet_bswap64(r->total_keys);
 	r->flags = dnet_bswap64(r->flags);
+	r->change_time = dnet_bswap64(r->change_time);
 	dnet_convert_time(&r->timestamp);
 }
 
+/*
+ * Header of DNET_FLAGS_COMPACT reply. It is followed by @num records, every record is:
+ * 1 byte - number of leading bytes of the key equal to the previous key of the reply (zero key for the first one),
+ * the rest bytes of the key, then varints (7 bits per byte, low bits first) of
+ * record flags, user_flags, timestamp.tsec, timestamp.tnsec and size.
+ * @iterated_keys and @total_keys are progress of the iterator at the moment reply was sent.
+ */
+struct dnet_iterator_compact_header
+{
+	uint64_t			id;
+	uint64_t			iterated_keys;
+	uint64_t			total_keys;
+	uint32_t			num;
+	uint32_t			reserved;
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_compact_header(struct dnet_iterator_compact_header *h)
+{
+	h->id = dnet_bswap64(h->id);
+	h->iterated_keys = dnet_bswap64(h->iterated_keys);
+	h->total_keys = dnet_bswap64(h->total_keys);
+	h->num = dnet_bswap32(h->num);
+}
+
+/*
+ * Resume point of DNET_IFLAGS_CHECKPOINTS iterator.
+ * @blob identifies backend file being iterated, @position is the number of its records processed so far,
+ * so checkpoint stays valid while the file is only appended to.
+ */
+#define DNET_ITERATOR_STATUS_CHECKPOINT	2
+
+struct dnet_iterator_checkpoint
+{
+	uint64_t			blob;
+	uint64_t			position;
+	uint64_t			iterated_keys;
+	uint64_t			reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_checkpoint(struct dnet_iterator_checkpoint *c)
+{
+	c->blob = dnet_bswap64(c->blob);
+	c->position = dnet_bswap64(c->position);
+	c->iterated_keys = dnet_bswap64(c->iterated_keys);
+}
+
+/*
+ * Summary of one key range sent by DNET_ITYPE_HASH iterator as data of @dnet_iterator_response.
+ * @hash is a sum of 64-bit hashes of (key, timestamp, size) of every record in the range,
+ * it doesn't depend on iteration order, so replicas with the same records have the same hash.
+ * Requested ranges must not overlap, key on the border is accounted in the range which starts with it.
+ */
+struct dnet_iterator_range_hash
+{
+	struct dnet_iterator_range	range;
+	uint64_t			hash;
+	uint64_t			keys;		/* Number of records in the range */
+	uint64_t			size;		/* Total size of records in the range */
+	uint64_t			reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_range_hash(struct dnet_iterator_range_hash *h)
+{
+	h->hash = dnet_bswap64(h->hash);
+	h->keys = dnet_bswap64(h->keys);
+	h->size = dnet_bswap64(h->size);
+}
+
 /*
  * Indexes request entry
  */
@@ -1187,6 +1614,47 @@ struct dnet_indexes_request
 	struct dnet_indexes_request_entry	entries[0];	/* List of indexes to set */
 } __attribute__ ((packed));
 
+/*
+ * Continuation of paginated find, see DNET_INDEXES_FLAGS_LIMIT
+ */
+#define DNET_INDEXES_CURSOR_AFTER		(1<<0)		/* return only objects with ids greater than @id */
+
+struct dnet_indexes_find_cursor
+{
+	uint64_t			limit;		/* Maximum number of objects, 0 means no limit */
+	uint64_t			flags;		/* DNET_INDEXES_CURSOR_* */
+	struct dnet_raw_id		id;
+	uint64_t			reserved[2];
+} __attribute__ ((packed));
+
+/*
+ * Data of found objects, see DNET_INDEXES_FLAGS_FETCH
+ */
+struct dnet_indexes_fetch
+{
+	uint64_t			size;		/* Number of first bytes of every object, 0 means whole object */
+	uint64_t			reserved[3];
+} __attribute__ ((packed));
+
+/*
+ * Selection of index entries by their data, it is the data of DNET_CMD_INDEXES_FIND request entry
+ * flagged with DNET_INDEXES_ENTRY_RANGE. Data is compared bytewise, shorter data is less than
+ * longer one with the same beginning.
+ */
+#define DNET_INDEXES_ENTRY_RANGE		(1<<0)		/* request entry is followed by struct dnet_indexes_range */
+
+#define DNET_INDEXES_RANGE_END			(1<<0)		/* select data which is not greater than end */
+#define DNET_INDEXES_RANGE_PREFIX		(1<<1)		/* select data which starts with start, end is ignored */
+
+struct dnet_indexes_range
+{
+	uint64_t			flags;		/* DNET_INDEXES_RANGE_* */
+	uint64_t			start_size;
+	uint64_t			end_size;
+	uint64_t			reserved[2];
+	char				data[0];	/* start followed by end */
+} __attribute__ ((packed));
+
 /*
  * Indexes reply entry
  */
@@ -1232,12 +1700,14 @@ static inline void dnet_convert_defrag_ctl(struct dnet_defrag_ctl *ctl)
 struct dnet_monitor_stat_request {
 	uint64_t	categories;
 	int			reserved_int; // reserved for packing
-	uint64_t	reserved[4];
+	uint64_t	generation; // if non zero, only statistics changed since report of this generation is sent
+	uint64_t	reserved[3];
 } __attribute__ ((packed));
 
 static inline void dnet_convert_monitor_stat_request(struct dnet_monitor_stat_request *r)
 {
 	r->categories = dnet_bswap32(r->categories);
+	r->generation = dnet_bswap64(r->generation);
 }
 
 
@@ -1247,7 +1717,9 @@ struct dnet_server_send_request {
 	int		timeout;
 	int		__reserved32;
 	uint64_t	iflags;
-	uint64_t	__reserved[9];
+	uint64_t	rate_bytes;	/* bytes per second, 0 - unlimited */
+	uint64_t	rate_keys;	/* keys per second, 0 - unlimited */
+	uint64_t	__reserved[7];
 };
 
 static inline void dnet_convert_server_send_request(struct dnet_server_send_request *req)
@@ -1256,6 +1728,140 @@ static inline void dnet_convert_server_send_request(struct dnet_server_send_requ
 	req->group_num = dnet_bswap32(req->group_num);
 	req->timeout = dnet_bswap32(req->timeout);
 	req->iflags = dnet_bswap64(req->iflags);
+	req->rate_bytes = dnet_bswap64(req->rate_bytes);
+	req->rate_keys = dnet_bswap64(req->rate_keys);
+}
+
+/*
+ * DNET_CMD_ATOMIC_UPDATE request is struct dnet_io_attr followed by struct dnet_atomic_update,
+ * filter's name (DNET_ATOMIC_FILTER only) and the argument, io->size covers all of them.
+ *
+ * Server reads the record, computes its new data and writes it with io->flags while the key is locked,
+ * so concurrent updates of the same key never lose each other and need no retries.
+ * Reply is the same as the reply of the write. Every group applies the update independently.
+ */
+enum dnet_atomic_update_types {
+	DNET_ATOMIC_APPEND = 1,			/* append the argument to the record */
+	DNET_ATOMIC_INCREMENT,			/* add int64 argument to 8-byte counter, missing record is 0 */
+	DNET_ATOMIC_JSON_MERGE,			/* apply JSON merge patch (RFC 7386) argument to the document */
+	DNET_ATOMIC_FILTER,			/* run native update filter, see elliptics/iterator_filter.h */
+	__DNET_ATOMIC_MAX
+};
+
+/* update fails with -EBADFD unless record's timestamp equals @version, missing record has empty one */
+#define DNET_ATOMIC_FLAGS_IF_VERSION		(1<<0)
+
+struct dnet_atomic_update {
+	uint32_t		type;
+	uint32_t		flags;
+	struct dnet_time	version;
+	uint32_t		name_size;
+	uint32_t		__reserved32;
+	uint64_t		arg_size;
+	uint64_t		__reserved[4];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_atomic_update(struct dnet_atomic_update *u)
+{
+	u->type = dnet_bswap32(u->type);
+	u->flags = dnet_bswap32(u->flags);
+	dnet_convert_time(&u->version);
+	u->name_size = dnet_bswap32(u->name_size);
+	u->arg_size = dnet_bswap64(u->arg_size);
+}
+
+/*
+ * DNET_CMD_BULK_REMOVE request is struct dnet_io_attr whose size covers the rest of the request,
+ * followed by io attributes of the keys, every one removes its key with its own flags.
+ * All keys are expected to be served by the same backend.
+ *
+ * Keys are removed in one pass in id order, reply is struct dnet_bulk_remove_reply followed by
+ * @num int32 statuses of the keys in the order of the request, then the final ack comes.
+ */
+struct dnet_bulk_remove_reply {
+	uint64_t		num;
+	uint64_t		removed;
+	uint64_t		__reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_bulk_remove_reply(struct dnet_bulk_remove_reply *r)
+{
+	r->num = dnet_bswap64(r->num);
+	r->removed = dnet_bswap64(r->removed);
+}
+
+/*
+ * DNET_CMD_BULK_WRITE request is a sequence of io attributes each followed by its data,
+ * all keys are expected to be served by the same backend.
+ *
+ * By default every key is written as separate WRITE command with its own replies.
+ * With DNET_ATTR_BULK_WRITE_STATUSES keys are written without file info and, if backend makes writes
+ * durable in groups, are synced together once the last key is written. Reply is struct dnet_bulk_write_reply
+ * followed by @num int32 statuses of the keys in the order of the request, then the final ack comes.
+ */
+struct dnet_bulk_write_reply {
+	uint64_t		num;
+	uint64_t		written;
+	uint64_t		__reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_bulk_write_reply(struct dnet_bulk_write_reply *r)
+{
+	r->num = dnet_bswap64(r->num);
+	r->written = dnet_bswap64(r->written);
+}
+
+#define DNET_BLOB_FILE_NAME_MAX			128
+
+/*
+ * DNET_CMD_BLOB_FILES request, it is served by the backend of @cmd->backend_id.
+ *
+ * Empty @name lists sealed data files of the backend, reply is JSON object
+ * {"files": [{"name": "data-0.3", "size": 1073741824}, ...]}, files of bases which are
+ * still written to are not listed, defragmenting backend refuses request with -EBUSY.
+ * Otherwise @size bytes (0 - till the end) of listed file @name starting from @offset
+ * are sent as read reply: struct dnet_io_attr with @offset, @size and @total_size of the file
+ * followed by the bytes, then the final ack comes.
+ */
+struct dnet_blob_file_request {
+	uint64_t		offset;
+	uint64_t		size;
+	uint64_t		__reserved[2];
+	char			name[DNET_BLOB_FILE_NAME_MAX];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_blob_file_request(struct dnet_blob_file_request *r)
+{
+	r->offset = dnet_bswap64(r->offset);
+	r->size = dnet_bswap64(r->size);
+}
+
+/*
+ * DNET_FLAGS_REPLICATE write header, it is followed by @group_num groups to write data into,
+ * one of them is the group the command is sent to.
+ *
+ * Result of every group is sent as a reply with DNET_FLAGS_MORE and id of the group,
+ * the final acknowledge is sent as soon as results satisfy @checker or can not satisfy it anymore,
+ * writes to the rest of groups are completed in background.
+ */
+enum dnet_replicate_checkers {
+	DNET_REPLICATE_CHECKER_ALL = 0,		/* every group must succeed */
+	DNET_REPLICATE_CHECKER_QUORUM,		/* more than half of groups must succeed */
+	DNET_REPLICATE_CHECKER_AT_LEAST_ONE,	/* any group must succeed */
+	__DNET_REPLICATE_CHECKER_MAX
+};
+
+struct dnet_replicate_request {
+	uint32_t		group_num;
+	uint32_t		checker;
+	uint64_t		__reserved[2];
+	int			groups[0];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_replicate_request(struct dnet_replicate_request *r)
+{
+	r->group_num = dnet_bswap32(r->group_num);
+	r->checker = dnet_bswap32(r->checker);
 }
 
 
@@ -72,6 +72,9 @@ class exec_context
 		int src_key() const;
 		void set_src_key(int src_key) const;
 
+		// number of nodes whose results are combined into reply of broadcast exec
+		int broadcast_nodes() const;
+
 		// get back original data block of the entire request
 		data_pointer native_data() const;
 
@@ -259,8 +262,16 @@ struct index_entry
 
 struct find_indexes_result_entry
 {
+	find_indexes_result_entry() : status(0) {}
+
 	dnet_raw_id id;
 	std::vector<index_entry> indexes;
+	/*
+	 * Object itself if it has been requested, see session::find_all_indexes_read(),
+	 * status is 0 or negative error of its read
+	 */
+	int status;
+	data_pointer data;
 };
 
 /*!
@@ -271,6 +282,8 @@ struct get_index_metadata_result_entry
 {
 	size_t index_size;
 	int shard_id;
+	// number of times table of the shard has been split, index_size counts entries of all its parts
+	int split_depth;
 	bool is_valid;
 };
 
@@ -300,6 +313,89 @@ typedef std::vector<backend_status_result_entry> sync_backend_status_result;
 typedef async_result<iterator_result_entry> async_iterator_result;
 typedef std::vector<iterator_result_entry> sync_iterator_result;
 
+/*!
+ * Merges results of DNET_IFLAGS_ORDERED iterators of several backends while they are received,
+ * so they don't have to be stored and sorted to be compared.
+ * Keepalives and other responses with non-zero dnet_iterator_response::status are skipped.
+ */
+class iterator_result_merger
+{
+	public:
+		iterator_result_merger();
+
+		//! Adds \a result to the merge, it is identified by the order of add() calls
+		void add(async_iterator_result &result);
+
+		/*!
+		 * Blocks until the next smallest key is received from all results, then fills \a responses
+		 * with its responses and \a indexes with numbers of results they came from.
+		 * Returns false when all results are over.
+		 */
+		bool next(std::vector<dnet_iterator_response> &responses, std::vector<size_t> &indexes);
+
+		/*!
+		 * Error of result \a index, failed result doesn't take part in the merge since the failure.
+		 * Result fails with -EILSEQ if it isn't ordered by key.
+		 */
+		error_info error(size_t index) const;
+
+	private:
+		struct stream {
+			stream(async_iterator_result &result);
+
+			async_iterator_result::iterator it;
+			bool started;
+			bool valid;
+			dnet_iterator_response current;
+			error_info error;
+		};
+
+		void advance(stream &s);
+
+		std::vector<std::shared_ptr<stream>> m_streams;
+};
+
+/*!
+ * Key metadata of up to batch size iterator records laid out by columns, \a count values in each.
+ * Buffers are plain arrays and may be handed to columnar formats without copying,
+ * like Arrow's fixed_size_binary(DNET_ID_SIZE) and uint64/timestamp[ns] arrays.
+ */
+struct iterator_result_batch
+{
+	size_t count;
+	//! DNET_ID_SIZE bytes of every key
+	data_pointer keys;
+	//! uint64_t size of every record
+	data_pointer sizes;
+	//! int64_t nanoseconds since epoch of every record's timestamp
+	data_pointer timestamps;
+	//! uint64_t user flags of every record
+	data_pointer user_flags;
+	//! uint64_t combination of DNET_RECORD_FLAGS_* of every record
+	data_pointer record_flags;
+};
+
+/*!
+ * Decodes iterator result into columnar batches while it is received,
+ * so scans of key metadata don't build an object per record.
+ * Keepalives and other responses with non-zero dnet_iterator_response::status are skipped.
+ */
+class iterator_result_columns
+{
+	public:
+		iterator_result_columns(async_iterator_result &result);
+
+		/*!
+		 * Blocks until \a limit next records are received or result is over and fills \a batch with them.
+		 * Returns false if there are no records left. Throws error if iterator has failed.
+		 */
+		bool next(iterator_result_batch &batch, size_t limit);
+
+	private:
+		async_iterator_result::iterator m_it;
+		bool m_started;
+};
+
 typedef async_result<exec_result_entry> async_exec_result;
 typedef std::vector<exec_result_entry> sync_exec_result;
 typedef async_result<exec_result_entry> async_push_result;
@@ -32,7 +32,6 @@ class callback_result_entry;
 
 typedef std::function<bool (const callback_result_entry &)> result_filter;
 typedef std::function<bool (const std::vector<dnet_cmd> &, size_t)> result_checker;
-typedef std::function<void (const error_info &, const std::vector<dnet_cmd> &)> result_error_handler;
 
 /*!
  * Built-in filters.
@@ -171,11 +170,26 @@ class node
 
 		void add_remote(const address &addr);
 		void add_remote(const std::vector<address> &addrs);
+		/*!
+		 * Connects to \a addrs and nodes from their route lists in background thread,
+		 * \a ready is called from that thread once the route table is complete
+		 * with error if no remote node has been connected.
+		 */
+		void add_remote(const std::vector<address> &addrs, const std::function<void (const error_info &)> &ready);
 
 		void set_timeouts(const int wait_timeout, const int check_timeout);
 
 		void set_keepalive(int idle, int cnt, int interval);
 
+		/*!
+		 * Set/get retry budget of all sessions of the node.
+		 *
+		 * If it is not zero, retries of failed requests in the next group and hedged reads
+		 * are limited to this percent of requests, see dnet_node_set_retry_budget().
+		 */
+		void set_retry_budget(int percent);
+		int get_retry_budget() const;
+
 		logger &get_log() const;
 		dnet_node *get_native() const;
 
@@ -210,16 +224,39 @@ class key
 		void set_id(const dnet_raw_id &id);
 		void set_group_id(uint32_t group);
 
+		/*!
+		 * Transforms string key by the namespace of \a sess. Transformed id is kept by the key
+		 * and its copies, it is computed once again only for session with other namespace.
+		 */
 		void transform(const session &sess) const;
 
+		/*!
+		 * Enables process-wide LRU cache of at most \a max_keys ids of string keys
+		 * transformed by any session, zero disables it. Keys are cached per namespace.
+		 */
+		static void set_transform_cache_size(size_t max_keys);
+		static size_t get_transform_cache_size();
+
 	private:
+		friend class session;
+
 		bool inited() const;
 		void set_inited(bool inited);
 
+		// true if the key has to be transformed for namespace @ns
+		bool need_transform(const std::string &ns) const;
+		// takes id from the transform cache, returns false if key is not cached
+		bool lookup_transformed(const std::string &ns) const;
+		void set_transformed(const std::string &ns, const dnet_raw_id &id) const;
+		// puts transformed id into the transform cache
+		void cache_transformed() const;
+
 		bool m_by_id;
 		std::string m_remote;
-		int m_reserved;
+		mutable int m_reserved;
 		mutable dnet_id m_id;
+		// namespace the id has been transformed with
+		mutable std::string m_ns;
 };
 
 class session
@@ -261,6 +298,14 @@ class session
 		 * Makes dnet_id be accessible by key::id() in the key \a id.
 		 */
 		void transform(const key &id) const;
+		/*!
+		 * Converts strings \a data to dnet_raw_id \a ids, all strings are hashed at once.
+		 */
+		void transform(const std::vector<std::string> &data, std::vector<dnet_raw_id> &ids) const;
+		/*!
+		 * Makes dnet_id be accessible by key::id() in all \a keys, they are hashed at once.
+		 */
+		void transform(const std::vector<key> &keys) const;
 
 		/*!
 		 * Sets \a groups to the session.
@@ -296,6 +341,35 @@ class session
 		void set_error_handler(const result_error_handler &error_handler);
 		result_error_handler get_error_handler() const;
 
+		/*!
+		 * Set/get quorum completion of writes.
+		 *
+		 * If enabled, write result completes as soon as received replies satisfy the checker,
+		 * so write to 3 groups with checkers::quorum waits only for 2 fastest of them.
+		 * Remaining replies are handled in background and are not added to the result,
+		 * failed ones are passed to \a background_error_handler.
+		 *
+		 * Default value is false.
+		 */
+		void set_quorum_completion(bool enable,
+			const result_error_handler &background_error_handler = error_handlers::none);
+		bool get_quorum_completion() const;
+
+		/*!
+		 * Set/get primary replication of writes.
+		 *
+		 * If enabled, in-memory write to several groups is sent only once to the first group,
+		 * its node writes data locally and forwards it to the rest of groups, so client sends
+		 * payload once instead of once per group. Primary acknowledges write as soon as group
+		 * results satisfy the checker, checkers::all, checkers::quorum and checkers::at_least_one
+		 * are recognized, any other one waits for every group.
+		 * All nodes must support DNET_FLAGS_REPLICATE.
+		 *
+		 * Default value is false.
+		 */
+		void set_primary_replication(bool enable);
+		bool get_primary_replication() const;
+
 		/*!
 		 * Set exception policy \a policies.
 		 *
@@ -322,6 +396,10 @@ class session
 		 * \override
 		 */
 		void set_namespace(const char *ns, int nsize);
+		/*!
+		 * Returns namespace of the session, empty string if it is not set.
+		 */
+		std::string get_namespace() const;
 
 		/*!
 		 * Get id that this session was stuck to.
@@ -376,6 +454,156 @@ class session
 		void set_timeout(long timeout);
 		long get_timeout() const;
 
+		/*!
+		 * Set/get transaction timeout in milliseconds
+		 */
+		void set_timeout_ms(long timeout);
+		long get_timeout_ms() const;
+
+		/*!
+		 * Set/get hedged read percentile.
+		 *
+		 * If it is not zero, read is also sent to the next group when the first one
+		 * has not replied within this percentile of its read latency.
+		 */
+		void set_hedged_read(int percentile);
+		int get_hedged_read() const;
+
+		/*!
+		 * Set/get adaptive timeout of reads and lookups.
+		 *
+		 * If \a percentile is not zero, transaction timeout is \a multiplier times this percentile
+		 * of the latency of the backend it is sent to, but not less than \a min_timeout_ms
+		 * and never more than the session timeout.
+		 */
+		void set_adaptive_timeout(int percentile, int multiplier, long min_timeout_ms);
+		int get_adaptive_timeout_percentile() const;
+		int get_adaptive_timeout_multiplier() const;
+		long get_adaptive_timeout_min_ms() const;
+
+		/*!
+		 * Set/get limits of bytes and keys per second for iterators and server-send
+		 * started by this session, zero means no limit.
+		 */
+		void set_background_rate(uint64_t rate_bytes, uint64_t rate_keys);
+		uint64_t get_background_rate_bytes() const;
+		uint64_t get_background_rate_keys() const;
+
+		/*!
+		 * Set/get number of parallel workers of iterators started by this session.
+		 * Results of different workers come interleaved, so keys are not ordered.
+		 */
+		void set_iterator_threads(uint32_t threads);
+		uint32_t get_iterator_threads() const;
+
+		/*!
+		 * Enables/disables read collapsing.
+		 *
+		 * When it is enabled, read_data() of the key, groups, offset and size
+		 * which are already being read by this session or any of its clones
+		 * does not send new request but waits for the one in flight.
+		 */
+		void set_read_collapsing(bool enable);
+		bool get_read_collapsing() const;
+
+		/*!
+		 * Enables/disables speculative read_latest().
+		 *
+		 * When it is enabled, read_latest() reads the first group of the key in parallel
+		 * with lookups of all groups, so it takes one round trip if that group has the latest data.
+		 * Otherwise the read is discarded and the latest groups are read as usual.
+		 */
+		void set_speculative_read_latest(bool enable);
+		bool get_speculative_read_latest() const;
+
+		/*!
+		 * Enables read-repair of at most \a rate_keys keys per second, zero disables it.
+		 * Repair limit is shared by this session and all its clones made afterwards.
+		 *
+		 * When it is enabled, read_latest() which finds groups with older or missing replica
+		 * of the key copies the latest replica to them in background by server_send().
+		 * Remote replica is overwritten only if it is still older than the copy.
+		 */
+		void set_read_repair(uint64_t rate_keys);
+		uint64_t get_read_repair() const;
+
+		/*!
+		 * Sets number of objects found by find_*_indexes() which are prefetched into server caches,
+		 * zero disables it.
+		 *
+		 * When it is set, paginated find hints servers by prefetch() about up to \a count objects
+		 * which did not fit into the page, so reads of the next page are served from cache.
+		 * Find without limit hints about its first \a count objects.
+		 */
+		void set_prefetch_hint(uint64_t count);
+		uint64_t get_prefetch_hint() const;
+
+		/*!
+		 * Enables/disables read batching, zero \a delay_us disables it.
+		 *
+		 * When it is enabled, read_data() of the whole object (zero offset and size)
+		 * is not sent at once but is coalesced with other such reads of this session
+		 * and its clones routed to the same backend into single bulk read.
+		 * Bulk read is sent \a delay_us microseconds after its first read
+		 * or as soon as it has \a max_keys keys, results are completed when it is completed.
+		 */
+		void set_read_batching(long delay_us, size_t max_keys);
+		long get_read_batching_delay() const;
+
+		/*!
+		 * Enables in-process cache of whole objects read by read_data(),
+		 * it is shared by this session and all its clones made afterwards.
+		 *
+		 * Cached keys are subscribed to modification notifications in all groups,
+		 * so writes and removals done by any client invalidate them.
+		 * Objects are reread at least once per \a ttl_ms, cache is limited by \a max_size bytes.
+		 * Zero \a max_size disables the cache.
+		 */
+		void set_near_cache(size_t max_size, long ttl_ms);
+		size_t get_near_cache_size() const;
+		/*!
+		 * Returns number of reads served by the near cache without contacting the storage.
+		 */
+		uint64_t get_near_cache_hits() const;
+
+		/*!
+		 * Enables Reed-Solomon erasure coding of objects written by write_erasure(),
+		 * zero \a data_chunks disables it.
+		 *
+		 * Object is split into \a data_chunks data chunks and \a parity_chunks parity chunks,
+		 * any \a data_chunks of them restore it. Chunks are stored under keys derived from the object key,
+		 * chunk i is stored in the session group i modulo number of groups, so with at least
+		 * \a data_chunks + \a parity_chunks groups object survives loss of \a parity_chunks of them
+		 * taking (\a data_chunks + \a parity_chunks) / \a data_chunks of its size.
+		 */
+		void set_erasure_coding(size_t data_chunks, size_t parity_chunks);
+		size_t get_erasure_data_chunks() const;
+		size_t get_erasure_parity_chunks() const;
+
+		/*!
+		 * Writes all chunks of \a data erasure coded object \a id, result has a reply per chunk.
+		 * Write fails if less than data chunks are written, otherwise checker decides.
+		 */
+		async_write_result write_erasure(const key &id, const argument_data &data);
+		/*!
+		 * Reads erasure coded object \a id. Parity chunks are read and missing data is reconstructed
+		 * only if some data chunks are missing, corrupted or older than the rest.
+		 */
+		async_read_result read_erasure(const key &id);
+		/*!
+		 * Rewrites missing, corrupted and stale chunks of erasure coded object \a id
+		 * restored from the rest of them, result has a reply per rewritten chunk.
+		 */
+		async_write_result recover_erasure(const key &id);
+		/*!
+		 * Removes all chunks of erasure coded object \a id.
+		 */
+		async_remove_result remove_erasure(const key &id);
+		/*!
+		 * Returns key and group of chunk \a index of erasure coded object \a id.
+		 */
+		key get_erasure_chunk_key(const key &id, size_t index);
+
 		/*!
 		 * Sets/gets trace_id for all elliptics commands
 		 */
@@ -389,10 +617,24 @@ class session
 		 * Read file by key \a id to \a file by \a offset and \a size.
 		 */
 		void read_file(const key &id, const std::string &file, uint64_t offset, uint64_t size);
+		/*!
+		 * Same as above, but data is read by chunks of \a chunk_size with up to \a window of them
+		 * in parallel, so no more than \a window chunks are kept in memory at once.
+		 *
+		 * Zero \a size means the rest of the object after \a offset.
+		 */
+		void read_file(const key &id, const std::string &file, uint64_t offset, uint64_t size,
+				uint64_t chunk_size, size_t window);
 		/*!
 		 * Write file from \a file to server by key \a id, \a offset and \a size.
 		 */
 		void write_file(const key &id, const std::string &file, uint64_t local_offset, uint64_t offset, uint64_t size);
+		/*!
+		 * Same as above, but file is written by chunks of \a chunk_size with up to \a window of them
+		 * in parallel, see write_data(const dnet_io_control &, uint64_t, size_t).
+		 */
+		void write_file(const key &id, const std::string &file, uint64_t local_offset, uint64_t offset, uint64_t size,
+				uint64_t chunk_size, size_t window);
 
 		/*!
 		 * Reads data from server by \a key id and dnet_io_attr \a io.
@@ -439,6 +681,8 @@ class session
 		/*!
 		 * Reads the latest data from server by the key \a id, \a offset and \a size.
 		 *
+		 * If speculative read_latest is enabled, read from the first group is sent together
+		 * with the lookups and the latest groups are read again only if that group is stale.
 		 *
 		 * Returns async_read_result.
 		 */
@@ -466,6 +710,13 @@ class session
 		 * of write_prepare(), write_plain() and write_commit().
 		 */
 		async_write_result write_data(const key &id, const argument_data &file, uint64_t remote_offset);
+		/*!
+		 * Writes concatenation of \a segments by the key \a id and remote offset \a remote_offset.
+		 *
+		 * Segments are neither gathered into single buffer nor copied, they are referenced
+		 * until sent to every group and are sent by single sendmsg() call.
+		 */
+		async_write_result write_data(const key &id, const std::vector<data_pointer> &segments, uint64_t remote_offset);
 
 		/*!
 		 * Writes data \a file by the key \a id and remote offset \a remote_offset chunk by chunk
@@ -478,6 +729,19 @@ class session
 		 */
 		async_write_result write_data(const key &id, const data_pointer &file,
 				uint64_t remote_offset, uint64_t chunk_size);
+		/*!
+		 * Same as above, but up to \a window chunks between the first and the last ones
+		 * are written in parallel.
+		 */
+		async_write_result write_data(const key &id, const data_pointer &file,
+				uint64_t remote_offset, uint64_t chunk_size, size_t window);
+		/*!
+		 * Writes data described by \a ctl chunk by chunk with up to \a window chunks in parallel.
+		 *
+		 * Data is taken either from ctl.data or from ctl.fd starting at ctl.local_offset,
+		 * it must stay valid until result is completed.
+		 */
+		async_write_result write_data(const dnet_io_control &ctl, uint64_t chunk_size, size_t window);
 
 
 		/*!
@@ -504,6 +768,36 @@ class session
 		async_write_result write_cas(const key &id, const argument_data &file,
 				const dnet_id &old_csum, uint64_t remote_offset);
 
+		/*!
+		 * Updates object \a id by the server itself: it reads the object, applies update of \a type
+		 * (one of DNET_ATOMIC_*) with argument \a arg and writes the result while the key is locked.
+		 * Concurrent updates of the same key never overwrite each other, so unlike write_cas
+		 * it takes one round trip and needs no retries.
+		 *
+		 * \a filter is the name of native update filter for DNET_ATOMIC_FILTER.
+		 * If \a version is not null, update is refused with -EBADFD unless object's timestamp equals it,
+		 * empty timestamp matches missing object.
+		 *
+		 * Returns async_write_result of the written object.
+		 */
+		async_write_result atomic_update(const key &id, int type, const argument_data &arg,
+				const std::string &filter = std::string(), const dnet_time *version = NULL);
+
+		/*!
+		 * Appends \a data to object \a id, only if its timestamp equals \a version when it is not null.
+		 */
+		async_write_result atomic_append(const key &id, const argument_data &data, const dnet_time *version = NULL);
+
+		/*!
+		 * Adds \a delta to 8-byte little-endian counter \a id, missing object is created with value \a delta.
+		 */
+		async_write_result atomic_increment(const key &id, int64_t delta);
+
+		/*!
+		 * Applies JSON merge patch (RFC 7386) \a patch to JSON document \a id, missing object is an empty one.
+		 */
+		async_write_result atomic_json_merge(const key &id, const argument_data &patch);
+
 		/*!
 		 * Prepares \a psize bytes place to write data by \a id and writes data by \a file and by \a remote_offset
 		 *
@@ -614,6 +908,13 @@ class session
 		 */
 		async_monitor_stat_result monitor_stat(const address &addr, uint64_t categories);
 
+		/*!
+		 * Queries monitor statistics information changed since report of \a generation
+		 * from the server node specified by \a addr. Report contains its own "generation",
+		 * providers whose statistics has not been changed are listed in "unchanged_providers".
+		 */
+		async_monitor_stat_result monitor_stat(const address &addr, uint64_t categories, uint64_t generation);
+
 		/*!
 		 * Returns the number of session states.
 		 */
@@ -645,6 +946,12 @@ class session
 
 		async_backend_control_result enable_backend(const address &addr, uint32_t backend_id);
 		async_backend_control_result disable_backend(const address &addr, uint32_t backend_id);
+		/*!
+		 * Reopens storage of enabled backend with options re-read from config file.
+		 * Requests are delayed while reload is in progress instead of failing,
+		 * cache and io pools of the backend are kept.
+		 */
+		async_backend_control_result reload_backend(const address &addr, uint32_t backend_id);
 		async_backend_control_result start_defrag(const address &addr, uint32_t backend_id);
 		async_backend_control_result start_compact(const address &addr, uint32_t backend_id);
 		async_backend_control_result stop_defrag(const address &addr, uint32_t backend_id);
@@ -653,6 +960,27 @@ class session
 		async_backend_control_result make_readonly(const address &addr, uint32_t backend_id);
 		async_backend_control_result make_writable(const address &addr, uint32_t backend_id);
 		async_backend_control_result set_delay(const address &addr, uint32_t backend_id, uint32_t delay);
+		/*!
+		 * Replaces fault injection rules of the backend, empty \a rules remove them.
+		 * Every request of the backend is checked against rules in order and the first one which fires
+		 * delays it by its distribution and replies its error if any.
+		 * Servers built without WITH_FAULT_INJECTION reply -ENOTSUP.
+		 */
+		async_backend_control_result set_faults(const address &addr, uint32_t backend_id,
+				const std::vector<dnet_fault_rule> &rules);
+		/*!
+		 * Limits bytes and keys per second of all iterators and server-sends running on the backend,
+		 * zero means no limit. It is applied to already running requests too.
+		 */
+		async_backend_control_result set_background_rate(const address &addr, uint32_t backend_id,
+				uint64_t rate_bytes, uint64_t rate_keys);
+		/*!
+		 * Changes size of the backend's cache and proportions of its pages without dropping cached objects,
+		 * empty @pages_proportions keeps current ones, their number must match configured number of pages.
+		 * Pages grow at once and shrink gradually. Restarted backend gets configured size back.
+		 */
+		async_backend_control_result resize_cache(const address &addr, uint32_t backend_id,
+				uint64_t size, const std::vector<uint32_t> &pages_proportions = std::vector<uint32_t>());
 		async_backend_status_result request_backends_status(const address &addr);
 
 		/*!
@@ -685,6 +1013,10 @@ class session
 		 *
 		 * Please note, that all iterators and @server_send() method only process keys in the first
 		 * group among those set in given session.
+		 *
+		 * DNET_ITYPE_HASH iterator returns one entry per range (sorted by range start) when iteration
+		 * completes, its reply_data() contains @dnet_iterator_range_hash, intermediate entries
+		 * with dnet_iterator_response::status set to 1 are keepalives.
 		 */
 		async_iterator_result start_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
 								uint32_t type, uint64_t flags,
@@ -704,6 +1036,42 @@ class session
 								const dnet_time& time_end,
 								const std::vector<int> &dst_groups);
 
+		/*!
+		 * Iterates writes and removals made on the backend after @since (usecs) in order of changes,
+		 * backend must be configured with change_log. Entries are filtered by @ranges and by @flags
+		 * like in @start_iterator(), dnet_iterator_response::change_time of the last entry is @since
+		 * of the next call. Iterator fails with -ERANGE if log does not contain all changes since @since,
+		 * zero @since iterates all changes kept in the log.
+		 */
+		async_iterator_result start_changes_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
+								uint64_t flags, uint64_t since);
+
+		/*!
+		 * Single-threaded network iterator which periodically returns entries with
+		 * dnet_iterator_response::status set to DNET_ITERATOR_STATUS_CHECKPOINT, their reply_data()
+		 * is an opaque @checkpoint, all keys before it have been returned already.
+		 * Iteration with the same arguments continues after @checkpoint, empty one starts from the beginning.
+		 * Iterator fails with -ESTALE if checkpoint is not valid anymore, then iteration has to be started over.
+		 */
+		async_iterator_result start_resumable_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
+								uint64_t flags,
+								const dnet_time& time_begin,
+								const dnet_time& time_end,
+								const data_pointer &checkpoint);
+
+		/*!
+		 * Runs native @filter (see elliptics/iterator_filter.h) on the node over records matching
+		 * @ranges and @flags like in @start_iterator(), @arg is passed to filter's init() as is.
+		 * Only results emitted by the filter are returned, reply_data() of such entry is emitted data,
+		 * entries with dnet_iterator_response::status set to 1 are keepalives.
+		 * Node must be configured with iterator_filter_dir, filter is loaded from it by name.
+		 */
+		async_iterator_result start_filter_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
+								const std::string &filter, const data_pointer &arg,
+								uint64_t flags,
+								const dnet_time& time_begin = dnet_time(),
+								const dnet_time& time_end = dnet_time());
+
 		/*!
 		 * Every iterator result entry contains iterator ID (unique for each iterator running on given node),
 		 * which can be used to pause/continue and cancel (stop) iterator.
@@ -757,6 +1125,19 @@ class session
 		 * Result contains all replies sent by nodes processing this event.
 		 */
 		async_exec_result exec(const exec_context &context, const std::string &event, const argument_data &data);
+		/*!
+		 * Starts execution of the given \a event with \a data on every node of groups specified in the session.
+		 *
+		 * Request is sent to one node which forwards it to at most \a fanout nodes, and so on down the tree,
+		 * every node combines its own result with results of its subtree by \a reducer registered on servers
+		 * by dnet_srw_register_reducer() and replies once.
+		 *
+		 * Returns async_exec_result.
+		 * Result contains the only reply combined from all nodes, exec_context::broadcast_nodes()
+		 * tells how many nodes it covers.
+		 */
+		async_exec_result exec_broadcast(const std::string &event, const argument_data &data,
+				const std::string &reducer, int fanout = 16);
 
 		/*!
 		 * Send an \a event with \a data to \a id continuing the process specified by \a context.
@@ -800,6 +1181,21 @@ class session
 		 */
 		async_read_result bulk_read(const std::vector<key> &keys);
 
+		/*!
+		 * Hints servers that \a keys are going to be read soon.
+		 * Servers queue them and load into backend cache in background at limited rate,
+		 * keys which are queued or already cached are acknowledged at once, nothing is read back.
+		 *
+		 * Returns async_read_result which contains only acknowledgements.
+		 */
+		async_read_result prefetch(const std::vector<dnet_raw_id> &keys);
+		/*!
+		 * \overload
+		 *
+		 * Allows to specify the list of key \a keys.
+		 */
+		async_read_result prefetch(const std::vector<key> &keys);
+
 		/*!
 		 * Writes all data \a data to server nodes by the list \a ios.
 		 * Exception is thrown if no entry is written successfully.
@@ -841,6 +1237,22 @@ class session
 		 */
 		async_set_indexes_result update_indexes(const key &id, const std::vector<std::string> &indexes,
 				const std::vector<data_pointer> &data);
+		/*!
+		 * \brief Update indexes of many objects, \a indexes[i] are added to object \a ids[i].
+		 *
+		 * Works as update_indexes() called for every object, but all objects added to the same
+		 * shard of the index are sent to it by single request.
+		 *
+		 * Returns async_set_indexes_result.
+		 */
+		async_set_indexes_result bulk_update_indexes(const std::vector<key> &ids,
+				const std::vector<std::vector<index_entry> > &indexes);
+		/*!
+		 * \overload
+		 */
+		async_set_indexes_result bulk_update_indexes(const std::vector<key> &ids,
+				const std::vector<std::vector<std::string> > &indexes,
+				const std::vector<std::vector<data_pointer> > &data);
 		/*!
 		 * \brief Adds object \a id to capped collection \a index.
 		 *
@@ -848,6 +1260,8 @@ class session
 		 * the \a limit is reached.
 		 *
 		 * If \a remove_data is true in addition to displacing of the object it's data is also removed from the storage.
+		 * Both are done by the server which keeps the collection within the same request,
+		 * displaced objects are reported by entries with DNET_INDEXES_CAPPED_REMOVED status.
 		 *
 		 * \note The \a limit is satisfied for each shard and not for whole collection.
 		 *
@@ -920,6 +1334,96 @@ class session
 		 */
 		async_find_indexes_result find_any_indexes(const std::vector<std::string> &indexes);
 
+		/*!
+		 * \brief Returns one page of find_all_indexes() result.
+		 *
+		 * At most \a limit objects are returned sorted by their ids, 0 means no limit.
+		 * Pass empty \a cursor for the first page and find_indexes_cursor() of the last returned
+		 * object for the next one. Page with less than \a limit objects is the last one.
+		 *
+		 * Results are streamed by the servers, so neither side holds the whole result set.
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_all_indexes(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+			const std::string &cursor);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_all_indexes(const std::vector<std::string> &indexes, uint64_t limit,
+			const std::string &cursor);
+		/*!
+		 * \brief Returns one page of find_any_indexes() result, see paginated find_all_indexes().
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_any_indexes(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+			const std::string &cursor);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_any_indexes(const std::vector<std::string> &indexes, uint64_t limit,
+			const std::string &cursor);
+		/*!
+		 * \brief Returns one page of find_all_indexes() result together with the objects.
+		 *
+		 * Every found object is returned with first \a size bytes of its data, 0 means whole object,
+		 * and status of its read. Servers read objects stored by the same backends as the indexes,
+		 * the rest are read by one bulk_read() once the page is found.
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_all_indexes_read(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+			const std::string &cursor, uint64_t size = 0);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_all_indexes_read(const std::vector<std::string> &indexes, uint64_t limit,
+			const std::string &cursor, uint64_t size = 0);
+		/*!
+		 * \brief Returns one page of find_any_indexes() result together with the objects,
+		 * see find_all_indexes_read().
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_any_indexes_read(const std::vector<dnet_raw_id> &indexes, uint64_t limit,
+			const std::string &cursor, uint64_t size = 0);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_any_indexes_read(const std::vector<std::string> &indexes, uint64_t limit,
+			const std::string &cursor, uint64_t size = 0);
+		/*!
+		 * \brief Returns opaque cursor of the page which ends with \a last object.
+		 */
+		static std::string find_indexes_cursor(const find_indexes_result_entry &last);
+		/*!
+		 * \brief Finds objects of \a index whose index data is within [\a start, \a end].
+		 *
+		 * Data is compared bytewise and shorter data is less than longer one with the same beginning,
+		 * so numbers (timestamps) have to be stored big-endian. Empty \a end means there is no upper bound.
+		 * Entries are selected by the servers, only matching ones are returned.
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_indexes_range(const dnet_raw_id &index, const data_pointer &start,
+			const data_pointer &end);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_indexes_range(const std::string &index, const data_pointer &start,
+			const data_pointer &end);
+		/*!
+		 * \brief Finds objects of \a index whose index data starts with \a prefix.
+		 *
+		 * Returns async_find_indexes_result.
+		 */
+		async_find_indexes_result find_indexes_prefix(const dnet_raw_id &index, const data_pointer &prefix);
+		/*!
+		 * \overload
+		 */
+		async_find_indexes_result find_indexes_prefix(const std::string &index, const data_pointer &prefix);
+
 		/*!
 		 * \brief List all indexes where \a id is added.
 		 *
@@ -965,9 +1469,16 @@ class session
 		 */
 		dnet_node *get_native_node() const;
 		/*!
-		 * Returns pointer to dnet_session.
+		 * Returns pointer to dnet_session which may be changed.
+		 * Clones share dnet_session until one of them changes it, so this call
+		 * copies it if it is shared.
 		 */
 		dnet_session *get_native();
+		/*!
+		 * Returns pointer to dnet_session which may be shared with clones of the session,
+		 * it must not be changed.
+		 */
+		dnet_session *get_native_shared() const;
 
 	protected:
 		std::shared_ptr<session_data> m_data;
@@ -975,6 +1486,13 @@ class session
 		async_exec_result request(dnet_id *id, const exec_context &context);
 		async_iterator_result iterator(const key &id, const data_pointer& request);
 		async_find_indexes_result find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect);
+		async_find_indexes_result find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+			uint64_t limit, const std::string &cursor);
+		async_find_indexes_result find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+			uint64_t limit, const std::string &cursor, const std::vector<data_pointer> &ranges);
+		async_find_indexes_result find_indexes_internal(const std::vector<dnet_raw_id> &indexes, bool intersect,
+			uint64_t limit, const std::string &cursor, const std::vector<data_pointer> &ranges,
+			bool read, uint64_t read_size);
 
 		error_info mix_states(const key &id, std::vector<int> &groups) __attribute__((warn_unused_result));
 };
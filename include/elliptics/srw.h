@@ -30,6 +30,8 @@ extern "C" {
 #define DNET_SPH_FLAGS_SRC_BLOCK	(1<<0)		/* when set data in @src is valid ID and can be used to send reply data, caller blocks */
 #define DNET_SPH_FLAGS_REPLY		(1<<1)		/* this packet is a reply to the blocked request with ID stored in @src */
 #define DNET_SPH_FLAGS_FINISH		(1<<2)		/* complete request with ID stored in @src, this packet will unblock client */
+#define DNET_SPH_FLAGS_BROADCAST	(1<<3)		/* data starts with dnet_exec_broadcast, event runs on every listed node
+							 * and replies are combined by reducer on the way back */
 
 struct sph {
 	struct dnet_raw_id	src;			/* reply has to be sent to this id */
@@ -37,7 +39,7 @@ struct sph {
 	uint64_t		flags;
 	int			event_size;		/* size of the event string - it is located first in @data */
 	int			status;			/* processing status - negative errno code or zero on success */
-	int			__key;			/* unused */
+	int			broadcast_nodes;	/* number of nodes whose replies are combined into broadcast reply */
 	int			src_key;		/* blocked client generates this key and waits for it to complete */
 	struct dnet_addr	addr;
 	char			data[0];
@@ -49,11 +51,58 @@ static inline void dnet_convert_sph(struct sph *e)
 	e->flags = dnet_bswap64(e->flags);
 	e->event_size = dnet_bswap32(e->event_size);
 	e->status = dnet_bswap32(e->status);
-	e->__key = dnet_bswap32(e->__key);
+	e->broadcast_nodes = dnet_bswap32(e->broadcast_nodes);
 	e->src_key = dnet_bswap32(e->src_key);
 	dnet_convert_addr(&e->addr);
 }
 
+#define DNET_EXEC_REDUCER_SIZE		32
+
+/*
+ * Subtree of broadcast exec: node which receives it runs the event and forwards it to at most @fanout
+ * of @addrs, every one of them gets an equal part of the rest of @addrs as its own subtree.
+ * Every node replies once with results of its subtree combined by @reducer.
+ */
+struct dnet_exec_broadcast {
+	char			reducer[DNET_EXEC_REDUCER_SIZE];
+	uint32_t		fanout;
+	uint32_t		addr_num;
+	/* subtree has to reply within this time, children get a smaller part of it */
+	uint64_t		timeout_ms;
+	uint64_t		reserved[2];
+	struct dnet_addr	addrs[0];
+} __attribute__ ((packed));
+
+/*
+ * Converts header only, @addrs are converted by the caller which knows their number
+ */
+static inline void dnet_convert_exec_broadcast(struct dnet_exec_broadcast *b)
+{
+	b->fanout = dnet_bswap32(b->fanout);
+	b->addr_num = dnet_bswap32(b->addr_num);
+	b->timeout_ms = dnet_bswap64(b->timeout_ms);
+}
+
+/*
+ * Partial result of broadcast exec
+ */
+struct dnet_exec_partial {
+	const void		*data;
+	uint64_t		size;
+};
+
+/*
+ * Combines @num partial results of broadcast exec into @result of @size bytes allocated by malloc(),
+ * returns negative errno if they can not be combined
+ */
+typedef int (* dnet_exec_reducer)(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size);
+
+/*
+ * Registers @reducer under @name for broadcast execs of this process, "concat", "lines", "sum", "min"
+ * and "max" are registered by default. Returns -EINVAL if @name is too long.
+ */
+int dnet_srw_register_reducer(const char *name, dnet_exec_reducer reducer);
+
 struct srw_init_ctl {
 	char			*config;
 };
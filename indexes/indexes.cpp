@@ -19,15 +19,28 @@
  */
 
 
+#include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define FIND_INDEXES_AVX2 1
+# include <immintrin.h>
+#endif
 
 #include "../bindings/cpp/session_indexes.hpp"
 #include "../library/elliptics.h"
+#include "../library/common.hpp"
 #include "../bindings/cpp/functional_p.h"
 #include "local_session.h"
 
 #include "elliptics/debug.hpp"
+#include "monitor/measure_points.h"
 
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 
 namespace {
@@ -456,7 +469,7 @@ err_out_complete:
 				cmd.flags &= (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
 			}
 
-			dnet_send_reply(state, &cmd, data.data(), data.size(), more);
+			dnet_send_reply_move(state, &cmd, std::move(data), more);
 		}
 
 		return err;
@@ -477,10 +490,8 @@ static bool entry_time_less_than(const dnet_index_entry &first, const dnet_index
  */
 data_pointer convert_index_table(dnet_node *node, dnet_id *cmd_id, const dnet_indexes_request *request,
 	const data_pointer &index_data, const data_pointer &data, uint32_t action,
-	std::vector<dnet_indexes_reply_entry> * &removed, const dnet_indexes_request_entry &entry)
+	const dnet_indexes_request_entry &entry)
 {
-	const uint32_t limit = entry.limit;
-
 	elliptics_timer timer;
 
 	dnet_indexes indexes;
@@ -502,8 +513,8 @@ data_pointer convert_index_table(dnet_node *node, dnet_id *cmd_id, const dnet_in
 	if (it != indexes.indexes.end() && it->index == request_index.index) {
 		// It's already there
 		if (action == DNET_INDEXES_FLAGS_INTERNAL_INSERT) {
-			// Item exists, update it's data and time if it's capped collection
-			if (!removed && it->data == request_index.data) {
+			// Item exists, update it's data
+			if (it->data == request_index.data) {
 				const int64_t timer_compare = timer.restart();
 				DNET_DUMP_ID_LEN(id_str, cmd_id, DNET_DUMP_NUM);
 				typedef long long int lld;
@@ -523,30 +534,7 @@ data_pointer convert_index_table(dnet_node *node, dnet_id *cmd_id, const dnet_in
 	} else {
 		// Index is not created yet
 		if (action == DNET_INDEXES_FLAGS_INTERNAL_INSERT) {
-			// Remove extra elements from capped collection
-			if (removed && limit != 0 && indexes.indexes.size() + 1 > limit) {
-				dnet_indexes_reply_entry entry;
-				memset(&entry, 0, sizeof(entry));
-
-				auto position = it - indexes.indexes.begin();
-
-				while (indexes.indexes.size() + 1 > limit && !indexes.indexes.empty()) {
-					auto jt = std::min_element(indexes.indexes.begin(), indexes.indexes.end(), entry_time_less_than);
-
-					// jt will be removed, so it should be modified to be still valid
-					if (position > jt - indexes.indexes.begin())
-						--position;
-
-					memcpy(entry.id.id, jt->index.id, DNET_ID_SIZE);
-					entry.status = DNET_INDEXES_CAPPED_REMOVED;
-
-					indexes.indexes.erase(jt);
-					removed->push_back(entry);
-				}
-
-				it = indexes.indexes.begin() + position;
-			}
-			// And just insert new index
+			// Just insert new index
 			indexes.indexes.insert(it, 1, request_index);
 		} else {
 			const int64_t timer_compare = timer.restart();
@@ -566,332 +554,2381 @@ data_pointer convert_index_table(dnet_node *node, dnet_id *cmd_id, const dnet_in
 	indexes.shard_id = entry.shard_id;
 	indexes.shard_count = entry.shard_count;
 
-	msgpack::sbuffer buffer;
-	msgpack::pack(&buffer, indexes);
+	data_pointer new_buffer = indexes_pack(indexes, node->flags & DNET_CFG_FLAT_INDEXES);
 
 	const int64_t timer_pack = timer.restart();
 
-	data_buffer new_buffer(DNET_INDEX_TABLE_MAGIC_SIZE + buffer.size());
-	new_buffer.write(dnet_bswap64(DNET_INDEX_TABLE_MAGIC));
-	new_buffer.write(buffer.data(), buffer.size());
-
-	const int64_t timer_write = timer.restart();
-
 	DNET_DUMP_ID_LEN(id_str, cmd_id, DNET_DUMP_NUM);
 	typedef long long int lld;
 	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: convert: id: %s, data size: %zu, new data size: %zu,"
-		 "unpack: %lld ms, lower_bound: %lld ms, update: %lld ms, pack: %lld ms, write: %lld ms",
+		 "unpack: %lld ms, lower_bound: %lld ms, update: %lld ms, pack: %lld ms",
 		 id_str, data.size(), new_buffer.size(), lld(timer_unpack), lld(timer_lower_bound),
-		 lld(timer_update), lld(timer_pack), lld(timer_write));
+		 lld(timer_update), lld(timer_pack));
 
-	return std::move(new_buffer);
+	return new_buffer;
 }
 
-int process_internal_indexes_entry(struct dnet_backend_io *backend, dnet_node *node, const dnet_indexes_request &request,
-	dnet_indexes_request_entry &entry, std::vector<dnet_indexes_reply_entry> * &removed)
+/*
+ * Bytes of deltas appended to index tables since their last rewrite.
+ * It is not persisted, after restart tables are rewritten when the same amount is appended once again.
+ */
+class index_log_tracker
 {
-	elliptics_timer timer;
+public:
+	enum {
+		min_log_size = 64 * 1024,
+		max_tables = 64 * 1024
+	};
 
-	local_session sess(backend, node);
+	/*
+	 * Returns true if log of the table became large enough to be merged into the table
+	 */
+	bool append(dnet_backend_io *backend, const dnet_id &id, size_t size, uint64_t table_size)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-	dnet_id id;
-	memset(&id, 0, sizeof(id));
-	memcpy(id.id, entry.id.id, DNET_ID_SIZE);
+		// most tables are never compacted while server lives, do not let the map grow unbounded
+		if (m_tables.size() >= max_tables)
+			m_tables.clear();
 
-	const data_pointer entry_data = data_pointer::from_raw(entry.data, entry.size);
+		uint64_t &log_size = m_tables[key(backend, id)];
+		log_size += size;
 
-	if (dnet_log_enabled(node->log, DNET_LOG_DEBUG)) {
-		char index_buffer[DNET_ID_SIZE * 2 + 1];
-		char object_buffer[DNET_DUMP_NUM * 2 + 1];
+		if (log_size < std::max<uint64_t>(min_log_size, table_size / 4))
+			return false;
 
-		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: index: %s, object: %s, flags: %s",
-			dnet_dump_id_len_raw(entry.id.id, DNET_ID_SIZE, index_buffer),
-			dnet_dump_id_len_raw(request.id.id, DNET_DUMP_NUM, object_buffer),
-			dnet_flags_dump_indexes_internal(entry.flags));
+		m_tables.erase(key(backend, id));
+		return true;
 	}
 
-	uint32_t action = entry.flags & (DNET_INDEXES_FLAGS_INTERNAL_INSERT
-		| DNET_INDEXES_FLAGS_INTERNAL_REMOVE | DNET_INDEXES_FLAGS_INTERNAL_REMOVE_ALL);
-	const bool capped = entry.flags & DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION;
+	void reset(dnet_backend_io *backend, const dnet_id &id)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_tables.erase(key(backend, id));
+	}
 
-	if (!capped)
-		removed = NULL;
+private:
+	typedef std::pair<dnet_backend_io *, std::string> key_type;
 
-	switch (action) {
-		case DNET_INDEXES_FLAGS_INTERNAL_INSERT:
-		case DNET_INDEXES_FLAGS_INTERNAL_REMOVE:
-			break;
-		case DNET_INDEXES_FLAGS_INTERNAL_REMOVE_ALL: {
-			const int64_t timer_checks = timer.restart();
-			int err = sess.remove(id);
-			const int64_t timer_remove = timer.restart();
+	static key_type key(dnet_backend_io *backend, const dnet_id &id)
+	{
+		return key_type(backend, std::string(reinterpret_cast<const char *>(id.id), DNET_ID_SIZE));
+	}
 
-			DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
-			typedef long long int lld;
-			dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, checks: %lld ms, remove: %lld ms",
-				 id_str, lld(timer_checks), lld(timer_remove));
+	std::mutex m_lock;
+	std::map<key_type, uint64_t> m_tables;
+};
 
-			removed = NULL;
-			return err;
-		}
-		default: {
-			dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: invalid flags: %s",
-				dnet_flags_dump_indexes_internal(entry.flags));
-			removed = NULL;
-			return -EINVAL;
-		}
+static index_log_tracker index_logs;
+
+/*
+ * Local index updates do not go through the request queue, so tables are serialized here:
+ * read-modify-write and compaction of the table must not lose concurrently appended delta
+ */
+static std::mutex &index_table_lock(const dnet_id &id)
+{
+	static std::mutex locks[64];
+	return locks[id.id[0] % (sizeof(locks) / sizeof(locks[0]))];
+}
+
+/*
+ * Identity of the stored table, it changes with every write of the table
+ */
+struct index_table_version
+{
+	uint64_t size;
+	dnet_time mtime;
+
+	bool operator ==(const index_table_version &other) const
+	{
+		return size == other.size && !dnet_time_cmp(&mtime, &other.mtime);
 	}
+};
 
-	const int64_t timer_checks = timer.restart();
+/*
+ * Looks up the table through the cache, returns -ENOENT if there is no such table
+ */
+static int lookup_index_table(local_session &sess, const dnet_id &id, index_table_version *version)
+{
+	dnet_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.id = id;
+	cmd.cmd = DNET_CMD_LOOKUP;
 
 	int err = 0;
-	data_pointer data = sess.read(id, &err);
-	const int64_t timer_read = timer.restart();
+	data_pointer lookup = sess.lookup(cmd, &err);
+	if (err)
+		return err;
 
-	data_pointer new_data = convert_index_table(node, &id, &request, entry_data, data, action, removed, entry);
-	const int64_t timer_convert = timer.restart();
+	if (lookup.size() < sizeof(dnet_addr) + sizeof(dnet_file_info))
+		return -ENOENT;
 
-	const bool data_equal = data == new_data;
+	dnet_file_info info = *lookup.skip<dnet_addr>().data<dnet_file_info>();
+	dnet_convert_file_info(&info);
 
-	const int64_t timer_compare = timer.restart();
+	version->size = info.size;
+	version->mtime = info.mtime;
+	return 0;
+}
 
-	int64_t timer_write = 0;
+/*
+ * Returns split depth of the table, split table has no entries, so the table is read only if it is that small
+ */
+static int lookup_split_depth(local_session &sess, const dnet_id &id)
+{
+	static const size_t split_table_size = DNET_INDEX_TABLE_MAGIC_SIZE + sizeof(dnet_index_flat_header);
 
-	if (data_equal) {
-		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: data is the same");
-		err = 0;
-	} else {
-		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: data is different");
-		err = sess.write(id, new_data);
-		timer_write = timer.restart();
-	}
+	index_table_version version;
+	if (lookup_index_table(sess, id, &version) || version.size != split_table_size)
+		return 0;
 
-	DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
-	typedef long long int lld;
-	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, data size: %zu, new data size: %zu, checks: %lld ms, "
-		 "read: %lld ms, convert: %lld ms, compare: %lld ms, write: %lld ms",
-		 id_str, data.size(), new_data.size(), lld(timer_checks), lld(timer_read),
-		 lld(timer_convert), lld(timer_compare), lld(timer_write));
+	int err = 0;
+	data_pointer data = sess.read(id, split_table_size, &err);
+	if (err)
+		return 0;
 
-	return err;
+	return indexes_split_depth(data);
 }
 
-int process_internal_indexes(struct dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, dnet_indexes_request *request)
+static dnet_id split_part_id(const dnet_id &table_id, int split_depth, unsigned int slot)
 {
-	if (request->entries_count == 0) {
-		return -EINVAL;
-	}
+	dnet_raw_id table, part;
+	memcpy(table.id, table_id.id, DNET_ID_SIZE);
+	dnet_indexes_transform_index_split_id(&table, split_depth, slot, &part);
 
-	data_buffer buffer(sizeof(dnet_indexes_reply) + request->entries_count * 2 * sizeof(dnet_indexes_reply_entry));
+	dnet_id id = table_id;
+	memcpy(id.id, part.id, DNET_ID_SIZE);
+	return id;
+}
 
-	dnet_indexes_reply reply;
-	memset(&reply, 0, sizeof(reply));
-	buffer.write(reply);
+/*
+ * Returns id of the part of the table @id which holds @object, it is @id itself if the table is not split
+ */
+static dnet_id split_object_table_id(local_session &sess, const dnet_id &id, const dnet_raw_id &object)
+{
+	const int split_depth = lookup_split_depth(sess, id);
+	if (!split_depth)
+		return id;
 
-	size_t entries_count = request->entries_count;
+	return split_part_id(id, split_depth, dnet_indexes_get_split_slot(&object, split_depth));
+}
 
-	dnet_indexes_reply_entry reply_entry;
-	memset(&reply_entry, 0, sizeof(reply_entry));
-	dnet_indexes_reply_entry reply_entry_removed;
-	memset(&reply_entry, 0, sizeof(reply_entry_removed));
+/*
+ * Bloom filters of object ids of index tables, they are kept in memory only
+ * and are built when the whole table is read by INDEXES_FIND.
+ *
+ * Filter is valid only for the version of the table it was built or updated for,
+ * so tables written bypassing this server (merge, recovery) just lose their filters.
+ * Inserts done by this server set bits of new objects, removals do not clear anything.
+ */
+class index_filter_cache
+{
+public:
+	enum {
+		hashes = 3,
+		bits_per_entry = 16,
+		min_bits = 1024,
+		max_bits = 512 * 1024,
+		max_memory = 64 * 1024 * 1024
+	};
 
-	std::vector<dnet_indexes_reply_entry> removed;
+	template <typename Table>
+	void build(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version, const Table &table)
+	{
+		auto f = std::make_shared<filter>();
+		f->version = version;
+		f->capacity = table.size();
 
-	int err = -1;
+		size_t bits = min_bits;
+		while (bits < table.size() * bits_per_entry && bits < max_bits)
+			bits *= 2;
+		f->bits.assign(bits / 64, 0);
 
-	for (uint64_t i = 0; i < request->entries_count; ++i) {
-		dnet_indexes_request_entry &entry = request->entries[i];
-		removed.clear();
-		auto *tmp = &removed;
-		int ret = process_internal_indexes_entry(backend, state->n, *request, entry, tmp);
+		for (size_t i = 0; i < table.size(); ++i)
+			f->insert(table.id(i));
 
-		reply_entry.id = entry.id;
-		reply_entry.status = ret;
+		std::lock_guard<std::mutex> guard(m_lock);
 
-		buffer.write(reply_entry);
+		auto &current = m_filters[key(backend, id)];
+		if (current)
+			m_memory -= current->memory();
 
-		if (tmp) {
-			entries_count += removed.size();
-			for (auto it = removed.begin(); it != removed.end(); ++it)
-				buffer.write(*it);
+		// filters are rebuilt by the next reads, do not let them take more than the limit
+		if (m_memory + f->memory() > max_memory) {
+			m_filters.clear();
+			m_memory = 0;
 		}
 
-		if (!ret) {
-			err = 0;
-		} else if (err == -1) {
-			err = ret;
-		}
+		m_filters[key(backend, id)] = f;
+		m_memory += f->memory();
 	}
 
-	if (!err) {
-		data_pointer reply_data = std::move(buffer);
-		reply_data.data<dnet_indexes_reply>()->entries_count = entries_count;
-
-		cmd->flags &= (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
+	/*
+	 * Returns true if filter of the table should be (re)built
+	 */
+	bool need_build(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-		dnet_send_reply(state, cmd, reply_data.data(), reply_data.size(), 0);
-		return 0;
+		auto it = m_filters.find(key(backend, id));
+		return it == m_filters.end() || !(it->second->version == version) || it->second->overloaded();
 	}
 
-	return err;
-}
-
-int process_find_indexes(struct dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, const dnet_id &request_id, dnet_indexes_request *request, bool more)
-{
-	local_session sess(backend, state->n);
+	/*
+	 * Moves filter of the table from @old_version to @version, @inserted objects are added to it
+	 */
+	void update(dnet_backend_io *backend, const dnet_id &id, const index_table_version &old_version,
+		const index_table_version &version, const std::vector<const dnet_raw_id *> &inserted)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-	const bool intersection = request->flags & DNET_INDEXES_FLAGS_INTERSECT;
-	const bool unite = request->flags & DNET_INDEXES_FLAGS_UNITE;
+		auto it = m_filters.find(key(backend, id));
+		if (it == m_filters.end())
+			return;
 
-	dnet_log(state->n, DNET_LOG_DEBUG, "INDEXES_FIND: indexes count: %u, flags: %s, more: %d",
-		 (unsigned) request->entries_count, dnet_flags_dump_indexes(request->flags), int(more));
+		if (!(it->second->version == old_version)) {
+			m_memory -= it->second->memory();
+			m_filters.erase(it);
+			return;
+		}
 
-	if ((intersection && unite) || !(intersection || unite)) {
-		return -EINVAL;
+		for (auto jt = inserted.begin(); jt != inserted.end(); ++jt)
+			it->second->insert(**jt);
+		it->second->capacity += inserted.size();
+		it->second->version = version;
 	}
 
-	std::vector<find_indexes_result_entry> result;
-	std::vector<data_pointer> data_cache;
-
-	std::map<dnet_raw_id, size_t, dnet_raw_id_less_than<> > result_map;
+	void erase(dnet_backend_io *backend, const dnet_id &id)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-	dnet_indexes tmp;
+		auto it = m_filters.find(key(backend, id));
+		if (it != m_filters.end()) {
+			m_memory -= it->second->memory();
+			m_filters.erase(it);
+		}
+	}
 
-	int err = -1;
-	dnet_id id = request_id;
+	/*
+	 * Returns false only if intersection of the tables is surely empty,
+	 * @checked is set if all tables have valid filters
+	 */
+	bool may_intersect(dnet_backend_io *backend, const std::vector<dnet_id> &ids,
+		const std::vector<index_table_version> &versions, bool *checked)
+	{
+		*checked = false;
 
-	size_t data_offset = 0;
-	char *data_start = reinterpret_cast<char *>(request->entries);
-	for (uint64_t i = 0; i < request->entries_count; ++i) {
-		dnet_indexes_request_entry &request_entry = *reinterpret_cast<dnet_indexes_request_entry *>(data_start + data_offset);
-		data_offset += sizeof(dnet_indexes_request_entry) + request_entry.size;
+		std::lock_guard<std::mutex> guard(m_lock);
 
-		memcpy(id.id, request_entry.id.id, sizeof(id.id));
+		std::vector<const filter *> filters;
+		size_t words = max_bits / 64;
 
-		int ret = 0;
-		data_pointer data = sess.read(id, &ret);
-		data_cache.push_back(data);
+		for (size_t i = 0; i < ids.size(); ++i) {
+			auto it = m_filters.find(key(backend, ids[i]));
+			if (it == m_filters.end() || !(it->second->version == versions[i]))
+				return true;
 
-		if (ret) {
-			dnet_log(state->n, DNET_LOG_DEBUG, "%s: INDEXES_FIND, err: %d",
-				 dnet_dump_id(&id), ret);
+			filters.push_back(it->second.get());
+			words = std::min(words, it->second->bits.size());
 		}
 
-		if (ret && unite) {
-			if (err == -1)
-				err = ret;
-			continue;
-		} else if (ret && intersection) {
-			return ret;
+		*checked = true;
+
+		/*
+		 * Filters have power of two sizes and bit position is hash modulo size,
+		 * so larger filter is folded to the size of the smallest one by oring its parts
+		 */
+		std::vector<uint64_t> common(words, ~0ull);
+		for (auto f = filters.begin(); f != filters.end(); ++f) {
+			std::vector<uint64_t> folded(words, 0);
+			for (size_t j = 0; j < (*f)->bits.size(); ++j)
+				folded[j % words] |= (*f)->bits[j];
+
+			for (size_t j = 0; j < words; ++j)
+				common[j] &= folded[j];
 		}
-		err = 0;
 
-		tmp.indexes.clear();
-		indexes_unpack(state->n, &id, data, &tmp, "process_find_indexes");
+		// object presented in all tables sets all its bits in every filter
+		size_t set = 0;
+		for (size_t j = 0; j < words && set < hashes; ++j)
+			set += __builtin_popcountll(common[j]);
 
-		if (unite) {
-			for (size_t j = 0; j < tmp.indexes.size(); ++j) {
-				const auto &entry = tmp.indexes[j];
+		return set >= hashes;
+	}
 
-				auto it = result_map.find(entry.index);
-				if (it == result_map.end()) {
-					it = result_map.insert(std::make_pair(entry.index, result.size())).first;
-					result.resize(result.size() + 1);
-					result.back().id = entry.index;
-				}
+private:
+	struct filter
+	{
+		index_table_version version;
+		uint64_t capacity;
+		std::vector<uint64_t> bits;
 
-				index_entry result_entry = { request_entry.id, entry.data };
-				result[it->second].indexes.push_back(result_entry);
-			}
-		} else if (intersection && i == 0) {
-			result.resize(tmp.indexes.size());
-			for (size_t j = 0; j < tmp.indexes.size(); ++j) {
-				auto &entry = result[j];
-				entry.id = tmp.indexes[j].index;
-				index_entry result_entry = { request_entry.id, tmp.indexes[j].data };
-				entry.indexes.push_back(result_entry);
-			}
-		} else if (intersection) {
-			// Remove all objects from result, which are not presented for this index
-			auto it = std::set_intersection(result.begin(), result.end(),
-				tmp.indexes.begin(), tmp.indexes.end(),
-				result.begin(),
-				dnet_raw_id_less_than<skip_data>());
-			result.resize(it - result.begin());
-
-			// Remove all objects from this index, which are not presented in result
-			std::set_intersection(tmp.indexes.begin(), tmp.indexes.end(),
-				result.begin(), result.end(),
-				tmp.indexes.begin(),
-				dnet_raw_id_less_than<skip_data>());
-
-			// As lists contain othe same objects - it's possible to add index data by one cycle
-			auto jt = tmp.indexes.begin();
-			for (auto kt = result.begin(); kt != result.end(); ++kt, ++jt) {
-				index_entry result_entry = { request_entry.id, jt->data };
-				kt->indexes.push_back(result_entry);
+		static uint64_t hash(const dnet_raw_id &id, int i)
+		{
+			// ids are hashes, their first bytes are used for sharding, so hashes are taken from the tail
+			uint64_t h;
+			memcpy(&h, id.id + DNET_ID_SIZE - (i + 1) * sizeof(h), sizeof(h));
+			return h;
+		}
+
+		void insert(const dnet_raw_id &id)
+		{
+			const uint64_t mask = bits.size() * 64 - 1;
+
+			for (int i = 0; i < hashes; ++i) {
+				const uint64_t bit = hash(id, i) & mask;
+				bits[bit / 64] |= 1ull << (bit % 64);
 			}
 		}
-	}
 
-	if (err != 0)
-		return err;
+		bool overloaded() const
+		{
+			return bits.size() * 64 < max_bits && capacity * bits_per_entry > bits.size() * 64 * 2;
+		}
 
-	dnet_log(state->n, DNET_LOG_DEBUG, "%s: INDEXES_FIND: result of find: %zu objects",
-		dnet_dump_id(&id), result.size());
+		size_t memory() const
+		{
+			return sizeof(*this) + bits.size() * sizeof(uint64_t);
+		}
+	};
 
-	msgpack::sbuffer buffer;
-	msgpack::pack(&buffer, result);
+	typedef std::pair<dnet_backend_io *, std::string> key_type;
 
-	if (!more) {
-		/*
-		 * Unset NEED_ACK flag if and only if it is the last reply.
-		 * We have to send positive reply in such case, also we don't want to send
-		 * useless acknowledge packet.
-		 */
-		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+	static key_type key(dnet_backend_io *backend, const dnet_id &id)
+	{
+		return key_type(backend, std::string(reinterpret_cast<const char *>(id.id), DNET_ID_SIZE));
 	}
-	dnet_cmd cmd_copy = *cmd;
-	dnet_setup_id(&cmd_copy.id, cmd->id.group_id, request_id.id);
-	dnet_send_reply(state, &cmd_copy, buffer.data(), buffer.size(), more);
 
-	return err;
-}
+	std::mutex m_lock;
+	size_t m_memory = 0;
+	std::map<key_type, std::shared_ptr<filter> > m_filters;
+};
 
-}
+static index_filter_cache index_filters;
 
-int dnet_indexes_init(struct dnet_node *, struct dnet_config *)
+/*
+ * Unpacked msgpack index tables read by INDEXES_FIND, so hot tables are not decoded by every request.
+ * Flat tables without log are searched in place and are not kept here.
+ * Positions of entries of the table sorted by their data are kept for range queries of any table.
+ *
+ * Table is valid only for the version it was read for, updates done by this server drop it.
+ * Memory is accounted by the stored size of the tables, the least recently used ones are evicted.
+ */
+class index_table_cache
 {
-	return 0;
-}
+public:
+	enum {
+		max_size = 256 * 1024 * 1024
+	};
 
-void dnet_indexes_cleanup(struct dnet_node *)
-{
-}
+	typedef std::vector<uint32_t> data_order;
 
-int dnet_process_indexes(struct dnet_backend_io *backend, dnet_net_state *st, dnet_cmd *cmd, void *data)
-{
-	dnet_indexes_request *request = static_cast<dnet_indexes_request*>(data);
-	int err = -ENOTSUP;
+	std::shared_ptr<const dnet_indexes> get(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-	switch (cmd->cmd) {
-		case DNET_CMD_INDEXES_UPDATE: {
-			// We are able only update, set or remove in one shot
-			if ((request->flags & DNET_INDEXES_FLAGS_UPDATE_ONLY) && (request->flags & DNET_INDEXES_FLAGS_REMOVE_ONLY)) {
-				err = -EINVAL;
-				break;
-			}
+		entry *e = find_nolock(key(backend, id), version);
+		return e ? e->table : std::shared_ptr<const dnet_indexes>();
+	}
 
-			auto functor = std::make_shared<update_indexes_functor>(backend, st, cmd, request);
+	std::shared_ptr<const data_order> get_order(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-			bool finished = false;
+		entry *e = find_nolock(key(backend, id), version);
+		return e ? e->order : std::shared_ptr<const data_order>();
+	}
 
-			err = functor->process(&finished);
+	void insert(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version,
+		const std::shared_ptr<const dnet_indexes> &table)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
 
-			if (!(finished && !err)) {
-				// Do not send final ACK, it will be sent when all indexes are fully updated
-				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-			}
+		entry *e = find_nolock(key(backend, id), version);
+		if (e && e->table)
+			return;
+
+		e = insert_nolock(key(backend, id), version, version.size);
+		if (e)
+			e->table = table;
+	}
+
+	void insert_order(dnet_backend_io *backend, const dnet_id &id, const index_table_version &version,
+		const std::shared_ptr<const data_order> &order)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		entry *e = find_nolock(key(backend, id), version);
+		if (e && e->order)
+			return;
+
+		e = insert_nolock(key(backend, id), version, order->size() * sizeof(uint32_t));
+		if (e)
+			e->order = order;
+	}
+
+	void erase(dnet_backend_io *backend, const dnet_id &id)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		erase_nolock(key(backend, id));
+	}
+
+private:
+	typedef std::pair<dnet_backend_io *, std::string> key_type;
+
+	static key_type key(dnet_backend_io *backend, const dnet_id &id)
+	{
+		return key_type(backend, std::string(reinterpret_cast<const char *>(id.id), DNET_ID_SIZE));
+	}
+
+	struct entry
+	{
+		index_table_version version;
+		size_t size;
+		std::shared_ptr<const dnet_indexes> table;
+		std::shared_ptr<const data_order> order;
+		std::list<key_type>::iterator lru_position;
+	};
+
+	entry *find_nolock(const key_type &table_key, const index_table_version &version)
+	{
+		auto it = m_tables.find(table_key);
+		if (it == m_tables.end() || !(it->second.version == version))
+			return NULL;
+
+		m_lru.splice(m_lru.begin(), m_lru, it->second.lru_position);
+		return &it->second;
+	}
+
+	/*
+	 * Returns entry of the @version of the table with @size more bytes accounted for it,
+	 * entry of other version is replaced by the new one
+	 */
+	entry *insert_nolock(const key_type &table_key, const index_table_version &version, size_t size)
+	{
+		if (size > max_size)
+			return NULL;
+
+		auto it = m_tables.find(table_key);
+		if (it != m_tables.end() && !(it->second.version == version))
+			erase_nolock(table_key);
+
+		while (m_size + size > max_size && !m_lru.empty() && !(m_lru.back() == table_key))
+			erase_nolock(m_lru.back());
+
+		it = m_tables.find(table_key);
+		if (it == m_tables.end()) {
+			it = m_tables.insert(std::make_pair(table_key, entry())).first;
+			it->second.version = version;
+			it->second.size = 0;
+			it->second.lru_position = m_lru.insert(m_lru.begin(), table_key);
+		}
+
+		it->second.size += size;
+		m_size += size;
+		return &it->second;
+	}
+
+	void erase_nolock(const key_type &table_key)
+	{
+		auto it = m_tables.find(table_key);
+		if (it == m_tables.end())
+			return;
+
+		m_size -= it->second.size;
+		m_lru.erase(it->second.lru_position);
+		m_tables.erase(it);
+	}
+
+	std::mutex m_lock;
+	size_t m_size = 0;
+	std::map<key_type, entry> m_tables;
+	std::list<key_type> m_lru;
+};
+
+static index_table_cache index_tables;
+
+/*
+ * Appends @deltas to existing index table by single write.
+ *
+ * Returns -ENOENT if there is no table yet, it has to be created with the whole content.
+ */
+static int append_index_deltas(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id,
+	const std::vector<dnet_index_delta> &deltas, bool *compact)
+{
+	index_table_version version;
+	int err = lookup_index_table(sess, id, &version);
+	if (err)
+		return err;
+
+	msgpack::sbuffer buffer;
+	std::vector<const dnet_raw_id *> inserted;
+	for (auto it = deltas.begin(); it != deltas.end(); ++it) {
+		msgpack::pack(&buffer, *it);
+
+		if (it->action == DNET_INDEXES_FLAGS_INTERNAL_INSERT)
+			inserted.push_back(&it->entry.index);
+	}
+
+	sess.set_ioflags(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
+	err = sess.write(id, buffer.data(), buffer.size());
+	sess.set_ioflags(DNET_IO_FLAGS_CACHE);
+
+	if (err)
+		return err;
+
+	index_tables.erase(backend, id);
+
+	index_table_version new_version;
+	if (lookup_index_table(sess, id, &new_version)) {
+		index_filters.erase(backend, id);
+	} else {
+		index_filters.update(backend, id, version, new_version, inserted);
+	}
+
+	*compact = index_logs.append(backend, id, buffer.size(), version.size);
+
+	DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+	dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: id: %s, appended deltas: %zu, size: %zu, table size: %llu, compact: %d",
+		id_str, deltas.size(), buffer.size(), static_cast<unsigned long long>(version.size), int(*compact));
+
+	return 0;
+}
+
+/*
+ * Appends delta of the entry to existing index table.
+ *
+ * Returns -ENOENT if there is no table yet, it has to be created with the whole content.
+ */
+static int append_index_delta(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id,
+	const dnet_indexes_request &request, const data_pointer &entry_data, uint32_t action, bool *compact)
+{
+	dnet_index_entry request_index;
+	memcpy(request_index.index.id, request.id.id, sizeof(request_index.index.id));
+	request_index.data = entry_data;
+	dnet_current_time(&request_index.time);
+
+	return append_index_deltas(sess, backend, node, id, std::vector<dnet_index_delta>(1, dnet_index_delta(action, request_index)), compact);
+}
+
+static dnet_id capped_ring_id(dnet_node *node, const dnet_id &table_id);
+
+/*
+ * Splits every part of the table which @id belongs to in two, so the table holds twice as many parts.
+ * New parts are written first, then the table is rewritten with the new depth and old parts are removed,
+ * table stays consistent if it fails in between. Called under index_table_lock() shared by all parts.
+ */
+static int split_index_table(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id)
+{
+	elliptics_timer timer;
+
+	const int split_depth = id.id[4];
+	dnet_id table_id = id;
+	memset(table_id.id + 4, 0, 4);
+
+	if (split_depth >= DNET_INDEXES_MAX_SPLIT_DEPTH)
+		return 0;
+
+	// the table has been split since this part was written
+	if (split_depth && lookup_split_depth(sess, table_id) != split_depth)
+		return 0;
+
+	// capped collections are limited anyway, their rings are kept next to their tables
+	index_table_version ring_version;
+	if (!lookup_index_table(sess, capped_ring_id(node, table_id), &ring_version))
+		return 0;
+
+	const bool flat = node->flags & DNET_CFG_FLAT_INDEXES;
+	const unsigned int parts = 1u << split_depth;
+	int shard_id = 0, shard_count = 0;
+	size_t entries = 0;
+
+	for (unsigned int slot = 0; slot < parts; ++slot) {
+		const dnet_id part_id = split_depth ? split_part_id(table_id, split_depth, slot) : table_id;
+
+		int err = 0;
+		data_pointer data = sess.read(part_id, &err);
+		if (err && err != -ENOENT)
+			return err;
+
+		dnet_indexes halves[2];
+		if (!err) {
+			dnet_indexes indexes;
+			try {
+				indexes_unpack_raw(data, &indexes);
+			} catch (const std::exception &e) {
+				DNET_DUMP_ID_LEN(id_str, &part_id, DNET_DUMP_NUM);
+				dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: split: id: %s, unpack exception: %s, size: %zu",
+					id_str, e.what(), data.size());
+				return -EINVAL;
+			}
+
+			shard_id = indexes.shard_id;
+			shard_count = indexes.shard_count;
+			entries += indexes.indexes.size();
+
+			for (auto it = indexes.indexes.begin(); it != indexes.indexes.end(); ++it) {
+				const unsigned int half = dnet_indexes_get_split_slot(&it->index, split_depth + 1) & 1;
+				halves[half].indexes.emplace_back(std::move(*it));
+			}
+		}
+
+		// both halves are written, so parts left by failed split do not survive
+		for (int half = 0; half < 2; ++half) {
+			halves[half].shard_id = shard_id;
+			halves[half].shard_count = shard_count;
+
+			const dnet_id half_id = split_part_id(table_id, split_depth + 1, slot * 2 + half);
+			err = sess.write(half_id, indexes_pack(halves[half], flat));
+			if (err)
+				return err;
+
+			index_logs.reset(backend, half_id);
+			index_filters.erase(backend, half_id);
+			index_tables.erase(backend, half_id);
+		}
+	}
+
+	int err = sess.write(table_id, indexes_pack_split(shard_id, shard_count, split_depth + 1));
+	index_logs.reset(backend, table_id);
+	index_filters.erase(backend, table_id);
+	index_tables.erase(backend, table_id);
+	if (err)
+		return err;
+
+	for (unsigned int slot = 0; split_depth && slot < parts; ++slot) {
+		const dnet_id part_id = split_part_id(table_id, split_depth, slot);
+
+		sess.remove(part_id);
+		index_logs.reset(backend, part_id);
+		index_filters.erase(backend, part_id);
+		index_tables.erase(backend, part_id);
+	}
+
+	DNET_DUMP_ID_LEN(id_str, &table_id, DNET_DUMP_NUM);
+	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: split: id: %s, depth: %d, entries: %zu, time: %lld ms",
+		id_str, split_depth + 1, entries, static_cast<long long int>(timer.elapsed()));
+
+	return 0;
+}
+
+/*
+ * Rewrites index table with its log merged
+ */
+static int compact_index_table(dnet_backend_io *backend, dnet_node *node, const dnet_id &table_id)
+{
+	elliptics_timer timer;
+
+	local_session sess(backend, node);
+	dnet_id id = table_id;
+
+	std::lock_guard<std::mutex> guard(index_table_lock(id));
+
+	int err = 0;
+	data_pointer data = sess.read(id, &err);
+	if (err)
+		return err;
+
+	dnet_indexes indexes;
+	try {
+		indexes_unpack_raw(data, &indexes);
+	} catch (const std::exception &e) {
+		DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+		dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: compact: id: %s, unpack exception: %s, size: %zu",
+			id_str, e.what(), data.size());
+		return -EINVAL;
+	}
+
+	data_pointer new_data = indexes_pack(indexes, node->flags & DNET_CFG_FLAT_INDEXES);
+	err = sess.write(id, new_data);
+	index_filters.erase(backend, id);
+	index_tables.erase(backend, id);
+
+	DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+	typedef long long int lld;
+	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: compact: id: %s, data size: %zu, new data size: %zu, "
+		"entries: %zu, time: %lld ms, err: %d",
+		id_str, data.size(), new_data.size(), indexes.indexes.size(), lld(timer.elapsed()), err);
+
+	if (!err && node->indexes_split_size && new_data.size() > node->indexes_split_size) {
+		int split_err = split_index_table(sess, backend, node, id);
+		if (split_err) {
+			dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: compact: id: %s, split failed: %d",
+				id_str, split_err);
+		}
+	}
+
+	return err;
+}
+
+/*
+ * Acks the update with @err and only then rewrites @tables with their logs merged,
+ * so the client does not wait for compaction
+ */
+static void compact_index_tables_after_ack(dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd,
+	int err, const std::vector<dnet_id> &tables)
+{
+	if (tables.empty())
+		return;
+
+	dnet_send_ack(state, cmd, err, 0);
+	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	for (auto it = tables.begin(); it != tables.end(); ++it)
+		compact_index_table(backend, state->n, *it);
+}
+
+/*
+ * Insertion order of capped collection, the oldest members are evicted from the head of the ring.
+ *
+ * It is stored next to the index table (see dnet_indexes_transform_capped_ring_id) as log of packed deltas without data:
+ * insert moves the entry to the tail, the latest delta of the entry wins. Superseded slots are skipped
+ * when they reach the head, the log is rewritten with members only when it becomes twice as long as the collection.
+ */
+class capped_ring
+{
+public:
+	capped_ring() : stored(false), log_count(0), m_seq(0)
+	{}
+
+	/*
+	 * Moves @id to the tail of the ring, returns true if it was not a member
+	 */
+	bool push(const dnet_raw_id &id)
+	{
+		auto result = m_members.insert(std::make_pair(id, m_seq));
+		result.first->second = m_seq;
+		m_order.emplace_back(id, m_seq);
+		++m_seq;
+
+		return result.second;
+	}
+
+	void remove(const dnet_raw_id &id)
+	{
+		m_members.erase(id);
+	}
+
+	/*
+	 * Removes the oldest member and stores it to @id, returns false if the ring is empty
+	 */
+	bool pop(dnet_raw_id *id)
+	{
+		while (!m_order.empty()) {
+			const slot front = m_order.front();
+			m_order.pop_front();
+
+			auto it = m_members.find(front.first);
+			if (it != m_members.end() && it->second == front.second) {
+				*id = front.first;
+				m_members.erase(it);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	size_t size() const
+	{
+		return m_members.size();
+	}
+
+	/*
+	 * Drops superseded slots, returns members from the oldest one
+	 */
+	std::vector<dnet_raw_id> compact()
+	{
+		std::deque<slot> order;
+		std::vector<dnet_raw_id> result;
+		result.reserve(m_members.size());
+
+		for (auto it = m_order.begin(); it != m_order.end(); ++it) {
+			auto jt = m_members.find(it->first);
+			if (jt != m_members.end() && jt->second == it->second) {
+				order.push_back(*it);
+				result.push_back(it->first);
+			}
+		}
+
+		m_order.swap(order);
+		return result;
+	}
+
+	// ring is written to the storage
+	bool stored;
+	// number of deltas in the stored log
+	size_t log_count;
+
+private:
+	typedef std::pair<dnet_raw_id, uint64_t> slot;
+
+	std::deque<slot> m_order;
+	std::map<dnet_raw_id, uint64_t, dnet_raw_id_less_than<>> m_members;
+	uint64_t m_seq;
+};
+
+/*
+ * Rings of recently updated capped collections, they are read from the storage only after eviction from the cache.
+ * Ring is changed under index_table_lock() of its table.
+ */
+class capped_ring_cache
+{
+public:
+	enum {
+		max_rings = 1024
+	};
+
+	std::shared_ptr<capped_ring> find(dnet_backend_io *backend, const dnet_id &id)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto it = m_rings.find(key(backend, id));
+		if (it == m_rings.end())
+			return std::shared_ptr<capped_ring>();
+
+		m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+		return it->second.first;
+	}
+
+	void insert(dnet_backend_io *backend, const dnet_id &id, const std::shared_ptr<capped_ring> &ring)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		const key_type ring_key = key(backend, id);
+		erase_nolock(ring_key);
+
+		while (m_rings.size() >= max_rings && !m_lru.empty())
+			erase_nolock(m_lru.back());
+
+		auto position = m_lru.insert(m_lru.begin(), ring_key);
+		m_rings.insert(std::make_pair(ring_key, std::make_pair(ring, position)));
+	}
+
+	void erase(dnet_backend_io *backend, const dnet_id &id)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		erase_nolock(key(backend, id));
+	}
+
+private:
+	typedef std::pair<dnet_backend_io *, std::string> key_type;
+
+	static key_type key(dnet_backend_io *backend, const dnet_id &id)
+	{
+		return key_type(backend, std::string(reinterpret_cast<const char *>(id.id), DNET_ID_SIZE));
+	}
+
+	void erase_nolock(const key_type &ring_key)
+	{
+		auto it = m_rings.find(ring_key);
+		if (it == m_rings.end())
+			return;
+
+		m_lru.erase(it->second.second);
+		m_rings.erase(it);
+	}
+
+	std::mutex m_lock;
+	std::map<key_type, std::pair<std::shared_ptr<capped_ring>, std::list<key_type>::iterator>> m_rings;
+	std::list<key_type> m_lru;
+};
+
+static capped_ring_cache capped_rings;
+
+static dnet_id capped_ring_id(dnet_node *node, const dnet_id &table_id)
+{
+	dnet_raw_id table_raw_id;
+	memcpy(table_raw_id.id, table_id.id, DNET_ID_SIZE);
+
+	dnet_raw_id ring_raw_id;
+	dnet_indexes_transform_capped_ring_id(node, &table_raw_id, &ring_raw_id);
+
+	dnet_id id = table_id;
+	memcpy(id.id, ring_raw_id.id, DNET_ID_SIZE);
+	return id;
+}
+
+/*
+ * Writes @deltas of the @ring to the storage, the whole ring is written if there is no stored log yet
+ * or it has grown twice as long as the collection
+ */
+static int store_capped_ring(local_session &sess, const dnet_id &ring_id, capped_ring &ring,
+	const std::vector<dnet_index_delta> &deltas, uint32_t limit)
+{
+	enum {
+		min_log_count = 64
+	};
+
+	msgpack::sbuffer buffer;
+	size_t log_count;
+	int err;
+
+	if (!ring.stored || ring.log_count + deltas.size() > 2 * std::max<size_t>(limit, ring.size()) + min_log_count) {
+		const std::vector<dnet_raw_id> members = ring.compact();
+
+		dnet_index_entry entry;
+		for (auto it = members.begin(); it != members.end(); ++it) {
+			entry.index = *it;
+			msgpack::pack(&buffer, dnet_index_delta(DNET_INDEXES_FLAGS_INTERNAL_INSERT, entry));
+		}
+
+		err = sess.write(ring_id, buffer.data(), buffer.size());
+		log_count = members.size();
+	} else {
+		for (auto it = deltas.begin(); it != deltas.end(); ++it)
+			msgpack::pack(&buffer, *it);
+
+		sess.set_ioflags(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
+		err = sess.write(ring_id, buffer.data(), buffer.size());
+		sess.set_ioflags(DNET_IO_FLAGS_CACHE);
+		log_count = ring.log_count + deltas.size();
+	}
+
+	if (!err) {
+		ring.stored = true;
+		ring.log_count = log_count;
+	}
+
+	return err;
+}
+
+/*
+ * Returns ring of capped collection @id from the cache or the storage.
+ * With @create ring which is not stored yet is restored from timestamps of the table entries, so collections
+ * created before rings keep their order, otherwise empty ring is returned for it.
+ */
+static int load_capped_ring(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id,
+	bool create, std::shared_ptr<capped_ring> *result)
+{
+	*result = capped_rings.find(backend, id);
+	if (*result && ((*result)->stored || !create))
+		return 0;
+
+	const dnet_id ring_id = capped_ring_id(node, id);
+	auto ring = std::make_shared<capped_ring>();
+
+	int err = 0;
+	data_pointer data = sess.read(ring_id, &err);
+	if (!err) {
+		try {
+			const char *log = data.data<char>();
+			size_t offset = 0;
+
+			while (offset < data.size()) {
+				msgpack::unpacked msg;
+				msgpack::unpack(&msg, log, data.size(), &offset);
+
+				dnet_index_delta delta;
+				msg.get().convert(&delta);
+
+				if (delta.action == DNET_INDEXES_FLAGS_INTERNAL_INSERT)
+					ring->push(delta.entry.index);
+				else
+					ring->remove(delta.entry.index);
+
+				++ring->log_count;
+			}
+
+			ring->stored = true;
+		} catch (const std::exception &e) {
+			DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+			dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: capped ring: id: %s, unpack exception: %s, size: %zu",
+				id_str, e.what(), data.size());
+
+			ring = std::make_shared<capped_ring>();
+		}
+	} else if (err != -ENOENT) {
+		return err;
+	}
+
+	if (!ring->stored && create) {
+		err = 0;
+		data_pointer table = sess.read(id, &err);
+		if (err && err != -ENOENT)
+			return err;
+
+		if (!err) {
+			dnet_id table_id = id;
+			dnet_indexes indexes;
+			indexes_unpack(node, &table_id, table, &indexes, "load_capped_ring");
+
+			std::stable_sort(indexes.indexes.begin(), indexes.indexes.end(), entry_time_less_than);
+			for (auto it = indexes.indexes.begin(); it != indexes.indexes.end(); ++it)
+				ring->push(it->index);
+		}
+
+		err = store_capped_ring(sess, ring_id, *ring, std::vector<dnet_index_delta>(), 0);
+		if (err)
+			return err;
+	}
+
+	capped_rings.insert(backend, id, ring);
+	*result = ring;
+	return 0;
+}
+
+/*
+ * Rings are rebuilt from the table when they can not be trusted anymore
+ */
+static void reset_capped_ring(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id)
+{
+	capped_rings.erase(backend, id);
+	sess.remove(capped_ring_id(node, id));
+}
+
+static int on_capped_object_removed(dnet_addr *addr __unused, dnet_cmd *cmd __unused, void *priv __unused)
+{
+	return 0;
+}
+
+/*
+ * Removes object evicted from capped collection, it is removed by the local backend if it is stored there
+ * or by the request sent to the server which stores it without waiting for the reply
+ */
+static int remove_capped_object(local_session &sess, dnet_node *node, int group_id, const dnet_raw_id &object)
+{
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+	memcpy(id.id, object.id, DNET_ID_SIZE);
+	id.group_id = group_id;
+
+	int backend_id = sess.backend_id();
+	net_state_ptr state(dnet_state_get_first_with_backend(node, &id, &backend_id));
+	if (!state)
+		return -ENXIO;
+
+	if (state.get() == node->st && backend_id == sess.backend_id())
+		return sess.remove(id);
+
+	dnet_io_attr io;
+	memset(&io, 0, sizeof(io));
+	memcpy(io.id, id.id, DNET_ID_SIZE);
+	memcpy(io.parent, id.id, DNET_ID_SIZE);
+	dnet_convert_io_attr(&io);
+
+	dnet_trans_control control;
+	memset(&control, 0, sizeof(control));
+
+	control.cflags = DNET_FLAGS_NEED_ACK;
+	control.cmd = DNET_CMD_DEL;
+	control.id = id;
+	control.size = sizeof(io);
+	control.data = &io;
+	control.complete = on_capped_object_removed;
+
+	dnet_session *remove_sess = dnet_session_create(node);
+	if (!remove_sess)
+		return -ENOMEM;
+
+	dnet_session_set_groups(remove_sess, &group_id, 1);
+	int err = dnet_trans_alloc_send_state(remove_sess, state.get(), &control);
+	dnet_session_destroy(remove_sess);
+
+	return err;
+}
+
+/*
+ * Inserts entry into capped collection by single append of the entry and of removals of evicted entries to the table,
+ * the oldest entries are found by the ring, so the table is not read. Evicted objects are removed
+ * with DNET_INDEXES_FLAGS_INTERNAL_CAPPED_REMOVE_DATA.
+ */
+static int insert_capped_entry(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id,
+	const dnet_indexes_request &request, const dnet_indexes_request_entry &entry, const data_pointer &entry_data,
+	std::vector<dnet_indexes_reply_entry> *removed, bool *compact)
+{
+	std::shared_ptr<capped_ring> ring;
+	int err = load_capped_ring(sess, backend, node, id, true, &ring);
+	if (err)
+		return err;
+
+	dnet_index_entry request_index;
+	memcpy(request_index.index.id, request.id.id, sizeof(request_index.index.id));
+	request_index.data = entry_data;
+	dnet_current_time(&request_index.time);
+
+	std::vector<dnet_index_delta> deltas(1, dnet_index_delta(DNET_INDEXES_FLAGS_INTERNAL_INSERT, request_index));
+	std::vector<dnet_index_delta> ring_deltas(1, dnet_index_delta(DNET_INDEXES_FLAGS_INTERNAL_INSERT,
+		dnet_index_entry(request_index.index, data_pointer(), request_index.time)));
+
+	if (ring->push(request_index.index) && entry.limit != 0) {
+		dnet_index_entry evicted;
+		evicted.time = request_index.time;
+
+		while (ring->size() > entry.limit && ring->pop(&evicted.index)) {
+			deltas.emplace_back(DNET_INDEXES_FLAGS_INTERNAL_REMOVE, evicted);
+			ring_deltas.emplace_back(DNET_INDEXES_FLAGS_INTERNAL_REMOVE, evicted);
+		}
+	}
+
+	err = append_index_deltas(sess, backend, node, id, deltas, compact);
+	if (err == -ENOENT) {
+		// there is no table yet, so nothing is evicted from it
+		dnet_indexes indexes;
+		indexes.shard_id = entry.shard_id;
+		indexes.shard_count = entry.shard_count;
+		indexes.indexes.push_back(request_index);
+
+		err = sess.write(id, indexes_pack(indexes, node->flags & DNET_CFG_FLAT_INDEXES));
+
+		index_logs.reset(backend, id);
+		index_filters.erase(backend, id);
+		index_tables.erase(backend, id);
+	}
+
+	if (err) {
+		// ring is ahead of the table now
+		capped_rings.erase(backend, id);
+		return err;
+	}
+
+	if (store_capped_ring(sess, capped_ring_id(node, id), *ring, ring_deltas, entry.limit)) {
+		// stored ring does not know about this update, it will be restored from the table
+		reset_capped_ring(sess, backend, node, id);
+	}
+
+	dnet_indexes_reply_entry reply_entry;
+	memset(&reply_entry, 0, sizeof(reply_entry));
+	reply_entry.status = DNET_INDEXES_CAPPED_REMOVED;
+
+	for (auto it = deltas.begin() + 1; it != deltas.end(); ++it) {
+		reply_entry.id = it->entry.index;
+		removed->push_back(reply_entry);
+
+		if (entry.flags & DNET_INDEXES_FLAGS_INTERNAL_CAPPED_REMOVE_DATA) {
+			int remove_err = remove_capped_object(sess, node, request.id.group_id, it->entry.index);
+			if (remove_err) {
+				DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+				dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: id: %s, object: %s, evicted object removal failed: %d",
+					id_str, dnet_dump_id_str(it->entry.index.id), remove_err);
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Entry removed from the table is removed from the ring of capped collection if the table has it
+ */
+static void remove_capped_entry(local_session &sess, dnet_backend_io *backend, dnet_node *node, const dnet_id &id,
+	const dnet_indexes_request &request)
+{
+	std::shared_ptr<capped_ring> ring;
+	if (load_capped_ring(sess, backend, node, id, false, &ring) || !ring->stored)
+		return;
+
+	dnet_index_entry removed_index;
+	memcpy(removed_index.index.id, request.id.id, sizeof(removed_index.index.id));
+	dnet_current_time(&removed_index.time);
+
+	ring->remove(removed_index.index);
+
+	if (store_capped_ring(sess, capped_ring_id(node, id), *ring,
+			std::vector<dnet_index_delta>(1, dnet_index_delta(DNET_INDEXES_FLAGS_INTERNAL_REMOVE, removed_index)), 0)) {
+		reset_capped_ring(sess, backend, node, id);
+	}
+}
+
+/*
+ * @updated_id is set to id of the table or its split part which has been updated
+ */
+int process_internal_indexes_entry(struct dnet_backend_io *backend, dnet_node *node, const dnet_indexes_request &request,
+	dnet_indexes_request_entry &entry, std::vector<dnet_indexes_reply_entry> * &removed, bool *compact,
+	dnet_id *updated_id)
+{
+	elliptics_timer timer;
+
+	local_session sess(backend, node);
+
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+	memcpy(id.id, entry.id.id, DNET_ID_SIZE);
+	*updated_id = id;
+
+	const data_pointer entry_data = data_pointer::from_raw(entry.data, entry.size);
+
+	if (dnet_log_enabled(node->log, DNET_LOG_DEBUG)) {
+		char index_buffer[DNET_ID_SIZE * 2 + 1];
+		char object_buffer[DNET_DUMP_NUM * 2 + 1];
+
+		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: index: %s, object: %s, flags: %s",
+			dnet_dump_id_len_raw(entry.id.id, DNET_ID_SIZE, index_buffer),
+			dnet_dump_id_len_raw(request.id.id, DNET_DUMP_NUM, object_buffer),
+			dnet_flags_dump_indexes_internal(entry.flags));
+	}
+
+	uint32_t action = entry.flags & (DNET_INDEXES_FLAGS_INTERNAL_INSERT
+		| DNET_INDEXES_FLAGS_INTERNAL_REMOVE | DNET_INDEXES_FLAGS_INTERNAL_REMOVE_ALL);
+	const bool capped = entry.flags & DNET_INDEXES_FLAGS_INTERNAL_CAPPED_COLLECTION;
+
+	if (!capped)
+		removed = NULL;
+
+	switch (action) {
+		case DNET_INDEXES_FLAGS_INTERNAL_INSERT:
+		case DNET_INDEXES_FLAGS_INTERNAL_REMOVE:
+			break;
+		case DNET_INDEXES_FLAGS_INTERNAL_REMOVE_ALL: {
+			const int64_t timer_checks = timer.restart();
+
+			const int split_depth = lookup_split_depth(sess, id);
+			for (unsigned int slot = 0; split_depth && slot < (1u << split_depth); ++slot) {
+				const dnet_id part_id = split_part_id(id, split_depth, slot);
+
+				sess.remove(part_id);
+				index_logs.reset(backend, part_id);
+				index_filters.erase(backend, part_id);
+				index_tables.erase(backend, part_id);
+			}
+
+			int err = sess.remove(id);
+			const int64_t timer_remove = timer.restart();
+
+			DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+			typedef long long int lld;
+			dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, checks: %lld ms, remove: %lld ms",
+				 id_str, lld(timer_checks), lld(timer_remove));
+
+			index_logs.reset(backend, id);
+			index_filters.erase(backend, id);
+			index_tables.erase(backend, id);
+			{
+				std::lock_guard<std::mutex> guard(index_table_lock(id));
+				reset_capped_ring(sess, backend, node, id);
+			}
+			removed = NULL;
+			return err;
+		}
+		default: {
+			dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: invalid flags: %s",
+				dnet_flags_dump_indexes_internal(entry.flags));
+			removed = NULL;
+			return -EINVAL;
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(index_table_lock(id));
+
+	const int64_t timer_checks = timer.restart();
+
+	int err = 0;
+
+	/*
+	 * Updates are appended to the table without reading it,
+	 * the oldest entries of capped collection are known from its ring
+	 */
+	if (capped && action == DNET_INDEXES_FLAGS_INTERNAL_INSERT) {
+		err = insert_capped_entry(sess, backend, node, id, request, entry, entry_data, removed, compact);
+		const int64_t timer_append = timer.restart();
+
+		DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+		typedef long long int lld;
+		dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, checks: %lld ms, capped append: %lld ms, "
+			"evicted: %zu, err: %d",
+			id_str, lld(timer_checks), lld(timer_append), removed->size(), err);
+		return err;
+	}
+
+	removed = NULL;
+
+	const dnet_raw_id &object = reinterpret_cast<const dnet_raw_id &>(request.id);
+	id = split_object_table_id(sess, id, object);
+	*updated_id = id;
+
+	err = append_index_delta(sess, backend, node, id, request, entry_data, action, compact);
+	if (err != -ENOENT) {
+		if (!err && action == DNET_INDEXES_FLAGS_INTERNAL_REMOVE)
+			remove_capped_entry(sess, backend, node, id, request);
+
+		const int64_t timer_append = timer.restart();
+
+		DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+		typedef long long int lld;
+		dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, checks: %lld ms, append: %lld ms, err: %d",
+			 id_str, lld(timer_checks), lld(timer_append), err);
+		return err;
+	}
+	err = 0;
+
+	data_pointer data = sess.read(id, &err);
+	const int64_t timer_read = timer.restart();
+
+	data_pointer new_data = convert_index_table(node, &id, &request, entry_data, data, action, entry);
+	const int64_t timer_convert = timer.restart();
+
+	const bool data_equal = data == new_data;
+
+	const int64_t timer_compare = timer.restart();
+
+	int64_t timer_write = 0;
+
+	if (data_equal) {
+		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: data is the same");
+		err = 0;
+	} else {
+		dnet_log(node, DNET_LOG_DEBUG, "INDEXES_INTERNAL: data is different");
+		err = sess.write(id, new_data);
+		timer_write = timer.restart();
+
+		// table is written without log
+		index_logs.reset(backend, id);
+		index_filters.erase(backend, id);
+		index_tables.erase(backend, id);
+	}
+
+	DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+	typedef long long int lld;
+	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: id: %s, data size: %zu, new data size: %zu, checks: %lld ms, "
+		 "read: %lld ms, convert: %lld ms, compare: %lld ms, write: %lld ms",
+		 id_str, data.size(), new_data.size(), lld(timer_checks), lld(timer_read),
+		 lld(timer_convert), lld(timer_compare), lld(timer_write));
+
+	return err;
+}
+
+/*
+ * Applies all entries of DNET_INDEXES_FLAGS_BULK request to its index table at once,
+ * they are appended by single write or the table is created with all of them
+ */
+static int process_internal_indexes_bulk(struct dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, dnet_indexes_request *request)
+{
+	elliptics_timer timer;
+
+	dnet_node *node = state->n;
+	local_session sess(backend, node);
+
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+	memcpy(id.id, request->id.id, DNET_ID_SIZE);
+
+	dnet_time time;
+	dnet_current_time(&time);
+
+	std::vector<dnet_index_delta> deltas;
+	deltas.reserve(request->entries_count);
+
+	size_t data_offset = 0;
+	char *data_start = reinterpret_cast<char *>(request->entries);
+	for (uint64_t i = 0; i < request->entries_count; ++i) {
+		dnet_indexes_request_entry *entry = reinterpret_cast<dnet_indexes_request_entry *>(data_start + data_offset);
+		data_offset += sizeof(dnet_indexes_request_entry) + entry->size;
+
+		if (entry->flags != DNET_INDEXES_FLAGS_INTERNAL_INSERT && entry->flags != DNET_INDEXES_FLAGS_INTERNAL_REMOVE) {
+			dnet_log(node, DNET_LOG_ERROR, "INDEXES_INTERNAL: bulk: invalid flags: %s",
+				dnet_flags_dump_indexes_internal(entry->flags));
+			return -EINVAL;
+		}
+
+		dnet_index_entry index;
+		index.index = entry->id;
+		index.data = data_pointer::copy(entry->data, entry->size);
+		index.time = time;
+
+		deltas.emplace_back(entry->flags, index);
+	}
+
+	std::vector<dnet_id> compact;
+	int err = 0;
+	{
+		std::lock_guard<std::mutex> guard(index_table_lock(id));
+
+		/*
+		 * Objects of split table are spread over its parts, parts are ordered by object ids,
+		 * so every part gets contiguous range of deltas sorted by them
+		 */
+		std::map<unsigned int, std::vector<dnet_index_delta>> parts;
+		const int split_depth = lookup_split_depth(sess, id);
+		if (split_depth) {
+			for (auto it = deltas.begin(); it != deltas.end(); ++it)
+				parts[dnet_indexes_get_split_slot(&it->entry.index, split_depth)].emplace_back(std::move(*it));
+		} else {
+			parts[0] = std::move(deltas);
+		}
+
+		for (auto part = parts.begin(); part != parts.end() && !err; ++part) {
+			const dnet_id part_id = split_depth ? split_part_id(id, split_depth, part->first) : id;
+			const std::vector<dnet_index_delta> &part_deltas = part->second;
+
+			bool need_compact = false;
+			err = append_index_deltas(sess, backend, node, part_id, part_deltas, &need_compact);
+			if (err == -ENOENT) {
+				msgpack::sbuffer buffer;
+				for (auto it = part_deltas.begin(); it != part_deltas.end(); ++it)
+					msgpack::pack(&buffer, *it);
+
+				dnet_indexes indexes;
+				indexes_apply_log(&indexes, buffer.data(), buffer.size());
+				indexes.shard_id = request->shard_id;
+				indexes.shard_count = request->shard_count;
+
+				err = sess.write(part_id, indexes_pack(indexes, node->flags & DNET_CFG_FLAT_INDEXES));
+
+				index_logs.reset(backend, part_id);
+				index_filters.erase(backend, part_id);
+				index_tables.erase(backend, part_id);
+			}
+
+			if (need_compact)
+				compact.push_back(part_id);
+		}
+
+		deltas.clear();
+		for (auto part = parts.begin(); part != parts.end(); ++part) {
+			for (auto it = part->second.begin(); it != part->second.end(); ++it)
+				deltas.emplace_back(std::move(*it));
+		}
+	}
+
+	DNET_DUMP_ID_LEN(id_str, &id, DNET_DUMP_NUM);
+	typedef long long int lld;
+	dnet_log(node, DNET_LOG_INFO, "INDEXES_INTERNAL: bulk: id: %s, objects: %zu, total: %lld ms, err: %d",
+		 id_str, deltas.size(), lld(timer.elapsed()), err);
+
+	if (!err) {
+		data_buffer reply_buffer(sizeof(dnet_indexes_reply) + deltas.size() * sizeof(dnet_indexes_reply_entry));
+
+		dnet_indexes_reply reply;
+		memset(&reply, 0, sizeof(reply));
+		reply.entries_count = deltas.size();
+		reply_buffer.write(reply);
+
+		dnet_indexes_reply_entry reply_entry;
+		memset(&reply_entry, 0, sizeof(reply_entry));
+		for (auto it = deltas.begin(); it != deltas.end(); ++it) {
+			reply_entry.id = it->entry.index;
+			reply_buffer.write(reply_entry);
+		}
+
+		data_pointer reply_data = std::move(reply_buffer);
+
+		cmd->flags &= (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
+
+		dnet_send_reply_move(state, cmd, std::move(reply_data), 0);
+	}
+
+	compact_index_tables_after_ack(backend, state, cmd, err, compact);
+
+	return err;
+}
+
+int process_internal_indexes(struct dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, dnet_indexes_request *request)
+{
+	if (request->flags & DNET_INDEXES_FLAGS_BULK) {
+		return process_internal_indexes_bulk(backend, state, cmd, request);
+	}
+
+	if (request->entries_count == 0) {
+		return -EINVAL;
+	}
+
+	data_buffer buffer(sizeof(dnet_indexes_reply) + request->entries_count * 2 * sizeof(dnet_indexes_reply_entry));
+
+	dnet_indexes_reply reply;
+	memset(&reply, 0, sizeof(reply));
+	buffer.write(reply);
+
+	size_t entries_count = request->entries_count;
+
+	dnet_indexes_reply_entry reply_entry;
+	memset(&reply_entry, 0, sizeof(reply_entry));
+	dnet_indexes_reply_entry reply_entry_removed;
+	memset(&reply_entry, 0, sizeof(reply_entry_removed));
+
+	std::vector<dnet_indexes_reply_entry> removed;
+	std::vector<dnet_id> compact;
+
+	int err = -1;
+
+	for (uint64_t i = 0; i < request->entries_count; ++i) {
+		dnet_indexes_request_entry &entry = request->entries[i];
+		removed.clear();
+		auto *tmp = &removed;
+		bool need_compact = false;
+		dnet_id updated_id;
+		int ret = process_internal_indexes_entry(backend, state->n, *request, entry, tmp, &need_compact, &updated_id);
+
+		if (need_compact)
+			compact.push_back(updated_id);
+
+		reply_entry.id = entry.id;
+		reply_entry.status = ret;
+
+		buffer.write(reply_entry);
+
+		if (tmp) {
+			entries_count += removed.size();
+			for (auto it = removed.begin(); it != removed.end(); ++it)
+				buffer.write(*it);
+		}
+
+		if (!ret) {
+			err = 0;
+		} else if (err == -1) {
+			err = ret;
+		}
+	}
+
+	if (!err) {
+		data_pointer reply_data = std::move(buffer);
+		reply_data.data<dnet_indexes_reply>()->entries_count = entries_count;
+
+		cmd->flags &= (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
+
+		dnet_send_reply_move(state, cmd, std::move(reply_data), 0);
+	}
+
+	compact_index_tables_after_ack(backend, state, cmd, err, compact);
+
+	return err;
+}
+
+#ifdef FIND_INDEXES_AVX2
+/*
+ * Compares ids 32 bytes at once, the first different byte is found in the mask of equal bytes
+ */
+__attribute__((target("avx2")))
+static int find_indexes_compare_avx2(const dnet_raw_id &first, const dnet_raw_id &second)
+{
+	for (size_t offset = 0; offset < DNET_ID_SIZE; offset += sizeof(__m256i)) {
+		const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first.id + offset));
+		const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second.id + offset));
+		const uint32_t diff = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+
+		if (diff) {
+			const size_t pos = offset + __builtin_ctz(diff);
+			return first.id[pos] < second.id[pos] ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+static bool find_indexes_avx2_supported()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static const bool find_indexes_avx2 = find_indexes_avx2_supported();
+#endif
+
+/*
+ * Compares ids as memcmp() does. Without AVX2 ids are compared on their first 64 bits,
+ * ids are hashes, so they almost always differ there.
+ */
+static inline int find_indexes_compare(const dnet_raw_id &first, const dnet_raw_id &second)
+{
+#ifdef FIND_INDEXES_AVX2
+	if (find_indexes_avx2)
+		return find_indexes_compare_avx2(first, second);
+#endif
+
+	uint64_t a, b;
+	memcpy(&a, first.id, sizeof(a));
+	memcpy(&b, second.id, sizeof(b));
+
+	if (a != b)
+		return be64toh(a) < be64toh(b) ? -1 : 1;
+
+	return memcmp(first.id + sizeof(a), second.id + sizeof(b), DNET_ID_SIZE - sizeof(a));
+}
+
+/*
+ * Index table read by INDEXES_FIND, flat table without log is searched in place, other ones are unpacked
+ */
+class find_index_table
+{
+public:
+	find_index_table(dnet_node *node, dnet_id *id, const dnet_raw_id &table_id, const data_pointer &data)
+		: m_table_id(table_id), m_flat(false)
+	{
+		if (index_table_view::is_flat(data)) {
+			try {
+				m_view.parse(data);
+				m_flat = !m_view.has_log();
+			} catch (const std::exception &) {
+				// reported by indexes_unpack() below
+			}
+		}
+
+		if (!m_flat) {
+			auto unpacked = std::make_shared<dnet_indexes>();
+			indexes_unpack(node, id, data, unpacked.get(), "process_find_indexes");
+			m_unpacked = unpacked;
+		}
+	}
+
+	find_index_table(const dnet_raw_id &table_id, const std::shared_ptr<const dnet_indexes> &unpacked)
+		: m_table_id(table_id), m_flat(false), m_unpacked(unpacked)
+	{
+	}
+
+	/*
+	 * Returns unpacked table, it is empty for tables searched in place
+	 */
+	const std::shared_ptr<const dnet_indexes> &unpacked() const
+	{
+		return m_unpacked;
+	}
+
+	const dnet_raw_id &table_id() const
+	{
+		return m_table_id;
+	}
+
+	size_t size() const
+	{
+		return m_flat ? m_view.size() : m_unpacked->indexes.size();
+	}
+
+	const dnet_raw_id &id(size_t i) const
+	{
+		return m_flat ? m_view.id(i) : m_unpacked->indexes[i].index;
+	}
+
+	data_pointer data(size_t i) const
+	{
+		return m_flat ? m_view.data(i) : m_unpacked->indexes[i].data;
+	}
+
+	/*
+	 * Returns position of the first entry not less than @index starting from @first,
+	 * cost is logarithmic in distance between them
+	 */
+	size_t gallop(const dnet_raw_id &index, size_t first) const
+	{
+		const size_t count = size();
+		size_t step = 1;
+
+		if (first >= count || find_indexes_compare(id(first), index) >= 0)
+			return first;
+
+		// id(first) is always less than @index here
+		while (first + step < count && find_indexes_compare(id(first + step), index) < 0) {
+			first += step;
+			step *= 2;
+		}
+
+		size_t last = std::min(first + step, count);
+		++first;
+		while (first < last) {
+			const size_t middle = first + (last - first) / 2;
+
+			if (find_indexes_compare(id(middle), index) < 0)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+
+		return first;
+	}
+
+private:
+	dnet_raw_id m_table_id;
+	bool m_flat;
+	index_table_view m_view;
+	std::shared_ptr<const dnet_indexes> m_unpacked;
+};
+
+/*
+ * Reads all parts of the split table, parts are ordered by object ids, so their entries are just concatenated
+ */
+static int find_indexes_read_split(local_session &sess, dnet_node *node, const dnet_id &id, int split_depth,
+	std::shared_ptr<dnet_indexes> *united)
+{
+	*united = std::make_shared<dnet_indexes>();
+	(*united)->shard_id = 0;
+	(*united)->shard_count = 0;
+
+	for (unsigned int slot = 0; slot < (1u << split_depth); ++slot) {
+		dnet_id part_id = split_part_id(id, split_depth, slot);
+
+		int err = 0;
+		data_pointer data = sess.read(part_id, &err);
+		if (err == -ENOENT)
+			continue;
+		if (err)
+			return err;
+
+		dnet_raw_id table_id;
+		memcpy(table_id.id, part_id.id, DNET_ID_SIZE);
+
+		find_index_table part(node, &part_id, table_id, data);
+		for (size_t i = 0; i < part.size(); ++i) {
+			dnet_index_entry entry;
+			entry.index = part.id(i);
+			entry.data = part.data(i);
+			(*united)->indexes.emplace_back(std::move(entry));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Keeps only @ids presented in @table.
+ * Galloping search is used when the table is much larger than current intersection, merge otherwise.
+ */
+static void find_indexes_filter(const find_index_table &table, std::vector<const dnet_raw_id *> &ids, bool first,
+	const dnet_indexes_find_cursor &cursor)
+{
+	static const size_t gallop_ratio = 8;
+
+	if (first) {
+		size_t j = 0;
+		if (cursor.flags & DNET_INDEXES_CURSOR_AFTER) {
+			j = table.gallop(cursor.id, 0);
+			if (j < table.size() && find_indexes_compare(table.id(j), cursor.id) == 0)
+				++j;
+		}
+
+		ids.reserve(table.size() - j);
+		for (; j < table.size(); ++j)
+			ids.push_back(&table.id(j));
+		return;
+	}
+
+	auto kept = ids.begin();
+	size_t position = 0;
+
+	if (table.size() > ids.size() * gallop_ratio) {
+		for (auto it = ids.begin(); it != ids.end(); ++it) {
+			position = table.gallop(**it, position);
+			if (position == table.size())
+				break;
+
+			if (find_indexes_compare(table.id(position), **it) == 0) {
+				*kept++ = *it;
+				++position;
+			}
+		}
+	} else {
+		for (auto it = ids.begin(); it != ids.end() && position < table.size();) {
+			const int cmp = find_indexes_compare(**it, table.id(position));
+
+			if (cmp < 0) {
+				++it;
+			} else if (cmp > 0) {
+				++position;
+			} else {
+				*kept++ = *it;
+				++it;
+				++position;
+			}
+		}
+	}
+
+	ids.erase(kept, ids.end());
+}
+
+/*
+ * Sends found objects by chunks, so neither server nor client has to hold the whole reply at once.
+ * If @fetch is set, objects which belong to @backend are read and sent together with their index data.
+ */
+class find_indexes_reply
+{
+public:
+	enum {
+		chunk_size = 1024,
+		chunk_data_size = 4 * 1024 * 1024
+	};
+
+	find_indexes_reply(dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, const dnet_id &request_id,
+		uint64_t limit, const dnet_indexes_fetch *fetch)
+		: m_backend(backend), m_state(state), m_cmd(cmd), m_limit(limit), m_count(0), m_chunk_data_size(0), m_fetch_size(0)
+	{
+		m_cmd_copy = *cmd;
+		dnet_setup_id(&m_cmd_copy.id, cmd->id.group_id, request_id.id);
+		m_chunk.reserve(chunk_size);
+
+		if (fetch) {
+			m_fetch_size = fetch->size;
+			m_fetch_session.reset(new local_session(backend, state->n));
+		}
+	}
+
+	bool full() const
+	{
+		return m_limit && m_count >= m_limit;
+	}
+
+	void add(find_indexes_result_entry &&entry)
+	{
+		if (m_fetch_session) {
+			fetch(entry);
+			m_chunk_data_size += entry.data.size();
+		}
+
+		m_chunk.emplace_back(std::move(entry));
+		++m_count;
+
+		if (m_chunk.size() >= chunk_size || m_chunk_data_size >= chunk_data_size)
+			send(true);
+	}
+
+	uint64_t count() const
+	{
+		return m_count;
+	}
+
+	/*
+	 * Sends the rest of objects, @more is true if there are other requests in this command
+	 */
+	void finish(bool more)
+	{
+		if (!more) {
+			/*
+			 * Unset NEED_ACK flag if and only if it is the last reply.
+			 * We have to send positive reply in such case, also we don't want to send
+			 * useless acknowledge packet.
+			 */
+			m_cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			m_cmd_copy.flags &= ~DNET_FLAGS_NEED_ACK;
+		}
+
+		send(more);
+	}
+
+private:
+	/*
+	 * Objects of other backends are not read, they may be stored anywhere in the cluster
+	 */
+	void fetch(find_indexes_result_entry &entry)
+	{
+		dnet_id id;
+		dnet_setup_id(&id, m_cmd->id.group_id, entry.id.id);
+
+		if (dnet_state_search_backend(m_state->n, &id) != m_backend->backend_id) {
+			entry.status = -ENOENT;
+			return;
+		}
+
+		int err = 0;
+		entry.data = m_fetch_session->read(id, m_fetch_size, &err);
+		entry.status = err;
+	}
+
+	void send(bool more)
+	{
+		msgpack::sbuffer buffer;
+		msgpack::pack(&buffer, m_chunk);
+
+		const size_t size = buffer.size();
+		char *data = buffer.release();
+		dnet_send_reply_ref(m_state, &m_cmd_copy, data, size, free, data, more);
+
+		m_chunk.clear();
+		m_chunk_data_size = 0;
+	}
+
+	dnet_backend_io *m_backend;
+	dnet_net_state *m_state;
+	dnet_cmd *m_cmd;
+	dnet_cmd m_cmd_copy;
+	const uint64_t m_limit;
+	uint64_t m_count;
+	std::vector<find_indexes_result_entry> m_chunk;
+	size_t m_chunk_data_size;
+	uint64_t m_fetch_size;
+	std::unique_ptr<local_session> m_fetch_session;
+};
+
+/*
+ * Collects index data of objects which are presented in every table, @tables are in request order
+ */
+static void find_indexes_collect(const std::vector<const find_index_table *> &tables, const std::vector<const dnet_raw_id *> &ids,
+	find_indexes_reply &reply)
+{
+	std::vector<size_t> positions(tables.size(), 0);
+
+	for (auto it = ids.begin(); it != ids.end() && !reply.full(); ++it) {
+		find_indexes_result_entry entry;
+		entry.id = **it;
+		entry.indexes.reserve(tables.size());
+
+		for (size_t i = 0; i < tables.size(); ++i) {
+			const find_index_table &table = *tables[i];
+			size_t &position = positions[i];
+
+			position = table.gallop(entry.id, position);
+
+			index_entry result_entry = { table.table_id(), table.data(position) };
+			entry.indexes.push_back(result_entry);
+			++position;
+		}
+
+		reply.add(std::move(entry));
+	}
+}
+
+/*
+ * Asks the kernel to read all requested tables at once, so they are not read from disk one after another.
+ * Returns sizes of the tables stored by the backend, tables which are not found there get zero size.
+ */
+static std::vector<uint64_t> find_indexes_prefetch(dnet_backend_io *backend, dnet_node *node, const std::vector<dnet_raw_id> &ids)
+{
+	std::vector<uint64_t> sizes(ids.size(), 0);
+
+	if (!backend || !backend->cb->lookup)
+		return sizes;
+
+	for (size_t i = 0; i < ids.size(); ++i) {
+		dnet_io_local io;
+		memset(&io, 0, sizeof(io));
+		memcpy(io.key, ids[i].id, DNET_ID_SIZE);
+		io.fd = -1;
+
+		int err = backend->cb->lookup(node, backend->cb->command_private, &io);
+		if (err || io.fd < 0)
+			continue;
+
+		sizes[i] = io.total_size;
+		if (ids.size() > 1)
+			posix_fadvise(io.fd, io.fd_offset, io.total_size, POSIX_FADV_WILLNEED);
+	}
+
+	return sizes;
+}
+
+/*
+ * Unites tables by k-way merge, index data of every object are listed in request order
+ */
+static void find_indexes_unite(const std::vector<find_index_table> &tables, const dnet_indexes_find_cursor &cursor,
+	find_indexes_reply &reply)
+{
+	typedef std::pair<size_t, size_t> position; // table and position in it
+
+	auto greater = [&tables] (const position &first, const position &second) {
+		const int cmp = find_indexes_compare(tables[first.first].id(first.second),
+			tables[second.first].id(second.second));
+		return cmp > 0 || (cmp == 0 && first.first > second.first);
+	};
+
+	std::vector<position> heap;
+	heap.reserve(tables.size());
+	for (size_t i = 0; i < tables.size(); ++i) {
+		size_t j = 0;
+		if (cursor.flags & DNET_INDEXES_CURSOR_AFTER) {
+			j = tables[i].gallop(cursor.id, 0);
+			if (j < tables[i].size() && find_indexes_compare(tables[i].id(j), cursor.id) == 0)
+				++j;
+		}
+
+		if (j < tables[i].size())
+			heap.push_back(position(i, j));
+	}
+	std::make_heap(heap.begin(), heap.end(), greater);
+
+	find_indexes_result_entry entry;
+	bool has_entry = false;
+
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		position &top = heap.back();
+		const find_index_table &table = tables[top.first];
+
+		if (!has_entry || find_indexes_compare(entry.id, table.id(top.second)) != 0) {
+			if (has_entry)
+				reply.add(std::move(entry));
+			if (reply.full())
+				return;
+
+			entry = find_indexes_result_entry();
+			entry.id = table.id(top.second);
+			has_entry = true;
+		}
+
+		index_entry result_entry = { table.table_id(), table.data(top.second) };
+		entry.indexes.push_back(result_entry);
+
+		if (++top.second < table.size())
+			std::push_heap(heap.begin(), heap.end(), greater);
+		else
+			heap.pop_back();
+	}
+
+	if (has_entry)
+		reply.add(std::move(entry));
+}
+
+/*
+ * Compares index data bytewise, shorter data is less than longer one with the same beginning
+ */
+static inline int find_indexes_data_compare(const data_pointer &first, const data_pointer &second)
+{
+	const size_t size = std::min(first.size(), second.size());
+
+	int cmp = size ? memcmp(first.data(), second.data(), size) : 0;
+	if (cmp)
+		return cmp;
+
+	return first.size() < second.size() ? -1 : (first.size() > second.size() ? 1 : 0);
+}
+
+/*
+ * Selection of index entries by their data requested by DNET_INDEXES_ENTRY_RANGE entry
+ */
+struct find_indexes_range
+{
+	uint64_t flags;
+	data_pointer start;
+	data_pointer end;
+
+	int parse(const dnet_indexes_request_entry &entry)
+	{
+		if (entry.size < sizeof(dnet_indexes_range))
+			return -EINVAL;
+
+		const dnet_indexes_range *range = reinterpret_cast<const dnet_indexes_range *>(entry.data);
+		if (range->start_size + range->end_size != entry.size - sizeof(dnet_indexes_range))
+			return -EINVAL;
+
+		flags = range->flags;
+		start = data_pointer::from_raw(const_cast<char *>(range->data), range->start_size);
+		end = data_pointer::from_raw(const_cast<char *>(range->data) + range->start_size, range->end_size);
+		return 0;
+	}
+
+	/*
+	 * Returns true if @data is after the selection, entries are checked in order of their data
+	 */
+	bool after(const data_pointer &data) const
+	{
+		if (flags & DNET_INDEXES_RANGE_PREFIX)
+			return data.size() < start.size() || memcmp(data.data(), start.data(), start.size());
+
+		return (flags & DNET_INDEXES_RANGE_END) && find_indexes_data_compare(data, end) > 0;
+	}
+};
+
+/*
+ * Returns positions of entries of the table sorted by their data
+ */
+static std::shared_ptr<const index_table_cache::data_order> find_indexes_data_order(const find_index_table &table)
+{
+	auto order = std::make_shared<index_table_cache::data_order>(table.size());
+	for (size_t i = 0; i < order->size(); ++i)
+		(*order)[i] = i;
+
+	std::stable_sort(order->begin(), order->end(), [&table] (uint32_t first, uint32_t second) {
+		return find_indexes_data_compare(table.data(first), table.data(second)) < 0;
+	});
+
+	return order;
+}
+
+/*
+ * Returns entries of the table selected by @range, they are sorted by id as the table is
+ */
+static std::shared_ptr<const dnet_indexes> find_indexes_select(const find_index_table &table,
+	const index_table_cache::data_order &order, const find_indexes_range &range)
+{
+	auto it = std::lower_bound(order.begin(), order.end(), range.start, [&table] (uint32_t position, const data_pointer &start) {
+		return find_indexes_data_compare(table.data(position), start) < 0;
+	});
+
+	std::vector<uint32_t> positions;
+	for (; it != order.end() && !range.after(table.data(*it)); ++it)
+		positions.push_back(*it);
+
+	std::sort(positions.begin(), positions.end());
+
+	auto selected = std::make_shared<dnet_indexes>();
+	selected->indexes.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		dnet_index_entry &entry = selected->indexes[i];
+
+		entry.index = table.id(positions[i]);
+		entry.data = table.data(positions[i]);
+		entry.time.tsec = 0;
+		entry.time.tnsec = 0;
+	}
+
+	return selected;
+}
+
+/*
+ * Checks that find request with its entries, cursor and fetch parameters fits into @size bytes
+ * and stores its full size to @request_size
+ */
+static int find_indexes_request_size(const dnet_indexes_request *request, uint64_t size, uint64_t *request_size)
+{
+	uint64_t offset = sizeof(dnet_indexes_request);
+	if (size < offset)
+		return -EINVAL;
+
+	const char *data = reinterpret_cast<const char *>(request);
+	for (uint64_t i = 0; i < request->entries_count; ++i) {
+		if (size - offset < sizeof(dnet_indexes_request_entry))
+			return -EINVAL;
+
+		const dnet_indexes_request_entry *entry = reinterpret_cast<const dnet_indexes_request_entry *>(data + offset);
+		offset += sizeof(dnet_indexes_request_entry);
+
+		if (size - offset < entry->size)
+			return -EINVAL;
+		offset += entry->size;
+	}
+
+	if (request->flags & DNET_INDEXES_FLAGS_LIMIT) {
+		if (size - offset < sizeof(dnet_indexes_find_cursor))
+			return -EINVAL;
+		offset += sizeof(dnet_indexes_find_cursor);
+	}
+
+	if (request->flags & DNET_INDEXES_FLAGS_FETCH) {
+		if (size - offset < sizeof(dnet_indexes_fetch))
+			return -EINVAL;
+		offset += sizeof(dnet_indexes_fetch);
+	}
+
+	*request_size = offset;
+	return 0;
+}
+
+int process_find_indexes(struct dnet_backend_io *backend, dnet_net_state *state, dnet_cmd *cmd, const dnet_id &request_id, dnet_indexes_request *request, bool more)
+{
+	local_session sess(backend, state->n);
+
+	const bool intersection = request->flags & DNET_INDEXES_FLAGS_INTERSECT;
+	const bool unite = request->flags & DNET_INDEXES_FLAGS_UNITE;
+
+	dnet_log(state->n, DNET_LOG_DEBUG, "INDEXES_FIND: indexes count: %u, flags: %s, more: %d",
+		 (unsigned) request->entries_count, dnet_flags_dump_indexes(request->flags), int(more));
+
+	if ((intersection && unite) || !(intersection || unite)) {
+		return -EINVAL;
+	}
+
+	std::vector<dnet_indexes_request_entry *> entries;
+	std::vector<dnet_raw_id> table_ids;
+	entries.reserve(request->entries_count);
+	table_ids.reserve(request->entries_count);
+
+	size_t data_offset = 0;
+	char *data_start = reinterpret_cast<char *>(request->entries);
+	for (uint64_t i = 0; i < request->entries_count; ++i) {
+		dnet_indexes_request_entry *request_entry = reinterpret_cast<dnet_indexes_request_entry *>(data_start + data_offset);
+		data_offset += sizeof(dnet_indexes_request_entry) + request_entry->size;
+
+		entries.push_back(request_entry);
+		table_ids.push_back(request_entry->id);
+	}
+
+	dnet_indexes_find_cursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	if (request->flags & DNET_INDEXES_FLAGS_LIMIT) {
+		memcpy(&cursor, data_start + data_offset, sizeof(cursor));
+		data_offset += sizeof(cursor);
+	}
+
+	dnet_indexes_fetch fetch;
+	memset(&fetch, 0, sizeof(fetch));
+	if (request->flags & DNET_INDEXES_FLAGS_FETCH)
+		memcpy(&fetch, data_start + data_offset, sizeof(fetch));
+	const dnet_indexes_fetch *fetch_request = (request->flags & DNET_INDEXES_FLAGS_FETCH) ? &fetch : NULL;
+
+	const std::vector<uint64_t> sizes = find_indexes_prefetch(backend, state->n, table_ids);
+
+	/*
+	 * Intersection reads the smallest tables first and stops as soon as nothing is left,
+	 * tables which are not found in the backend (cached or missing) are the cheapest ones
+	 */
+	std::vector<size_t> order(entries.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	if (intersection) {
+		std::stable_sort(order.begin(), order.end(), [&sizes] (size_t first, size_t second) {
+			return sizes[first] < sizes[second];
+		});
+	}
+
+	int err = -1;
+	dnet_id id = request_id;
+
+	/*
+	 * Versions of the tables validate their filters and unpacked tables kept by this server
+	 */
+	std::vector<dnet_id> table_keys(entries.size(), request_id);
+	std::vector<index_table_version> versions(entries.size());
+	std::vector<char> versioned(entries.size());
+	bool all_versioned = true;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		memcpy(table_keys[i].id, entries[i]->id.id, sizeof(table_keys[i].id));
+
+		versioned[i] = !lookup_index_table(sess, table_keys[i], &versions[i]);
+		all_versioned &= bool(versioned[i]);
+	}
+
+	/*
+	 * Bloom filters of the tables are checked before any of them is read
+	 */
+	bool filters_checked = false;
+	if (intersection && entries.size() > 1 && all_versioned) {
+		if (!index_filters.may_intersect(backend, table_keys, versions, &filters_checked)) {
+			HANDY_COUNTER_INCREMENT("indexes.filter.checks", 1);
+			HANDY_COUNTER_INCREMENT("indexes.filter.skipped", 1);
+
+			dnet_log(state->n, DNET_LOG_DEBUG, "%s: INDEXES_FIND: intersection is empty by filters",
+				dnet_dump_id(&id));
+
+			find_indexes_reply reply(backend, state, cmd, request_id, cursor.limit, fetch_request);
+			reply.finish(more);
+			return 0;
+		}
+	}
+
+	std::vector<find_index_table> tables;
+	std::vector<size_t> table_positions;
+	std::vector<const dnet_raw_id *> ids;
+	tables.reserve(entries.size());
+
+	for (auto it = order.begin(); it != order.end(); ++it) {
+		const dnet_indexes_request_entry &request_entry = *entries[*it];
+
+		memcpy(id.id, request_entry.id.id, sizeof(id.id));
+
+		std::shared_ptr<const dnet_indexes> unpacked;
+		if (versioned[*it])
+			unpacked = index_tables.get(backend, id, versions[*it]);
+
+		if (unpacked) {
+			HANDY_COUNTER_INCREMENT("indexes.table_cache.hits", 1);
+			tables.emplace_back(request_entry.id, unpacked);
+		} else {
+			int ret = 0;
+			data_pointer data = sess.read(id, &ret);
+
+			if (ret) {
+				dnet_log(state->n, DNET_LOG_DEBUG, "%s: INDEXES_FIND, err: %d",
+					 dnet_dump_id(&id), ret);
+			}
+
+			const int split_depth = ret ? 0 : indexes_split_depth(data);
+			if (split_depth) {
+				// parts change without the table, so neither the parts united here nor filters are kept
+				versioned[*it] = false;
+				all_versioned = false;
+
+				std::shared_ptr<dnet_indexes> united;
+				ret = find_indexes_read_split(sess, state->n, id, split_depth, &united);
+				if (!ret)
+					tables.emplace_back(request_entry.id, united);
+			}
+
+			if (ret && unite) {
+				if (err == -1)
+					err = ret;
+				continue;
+			} else if (ret && intersection) {
+				return ret;
+			}
+
+			if (!split_depth)
+				tables.emplace_back(state->n, &id, request_entry.id, data);
+
+			if (versioned[*it] && tables.back().unpacked()) {
+				HANDY_COUNTER_INCREMENT("indexes.table_cache.misses", 1);
+				index_tables.insert(backend, id, versions[*it], tables.back().unpacked());
+			}
+		}
+		err = 0;
+
+		table_positions.push_back(*it);
+
+		if (intersection && entries.size() > 1 && all_versioned && index_filters.need_build(backend, id, versions[*it]))
+			index_filters.build(backend, id, versions[*it], tables.back());
+
+		if (request_entry.flags & DNET_INDEXES_ENTRY_RANGE) {
+			find_indexes_range range;
+			if (range.parse(request_entry))
+				return -EINVAL;
+
+			std::shared_ptr<const index_table_cache::data_order> order;
+			if (versioned[*it])
+				order = index_tables.get_order(backend, id, versions[*it]);
+
+			if (!order) {
+				order = find_indexes_data_order(tables.back());
+				if (versioned[*it])
+					index_tables.insert_order(backend, id, versions[*it], order);
+			}
+
+			tables.back() = find_index_table(request_entry.id, find_indexes_select(tables.back(), *order, range));
+		}
+
+		if (intersection) {
+			find_indexes_filter(tables.back(), ids, tables.size() == 1, cursor);
+			if (ids.empty())
+				break;
+		}
+	}
+
+	if (err != 0)
+		return err;
+
+	find_indexes_reply reply(backend, state, cmd, request_id, cursor.limit, fetch_request);
+
+	if (intersection && !ids.empty()) {
+		std::vector<const find_index_table *> request_order(entries.size());
+		for (size_t i = 0; i < tables.size(); ++i)
+			request_order[table_positions[i]] = &tables[i];
+
+		find_indexes_collect(request_order, ids, reply);
+	} else if (unite) {
+		find_indexes_unite(tables, cursor, reply);
+	}
+
+	if (filters_checked) {
+		HANDY_COUNTER_INCREMENT("indexes.filter.checks", 1);
+		if (ids.empty())
+			HANDY_COUNTER_INCREMENT("indexes.filter.false_positives", 1);
+	}
+
+	dnet_log(state->n, DNET_LOG_DEBUG, "%s: INDEXES_FIND: result of find: %llu objects",
+		dnet_dump_id(&id), static_cast<unsigned long long>(reply.count()));
+
+	reply.finish(more);
+
+	return err;
+}
+
+}
+
+int dnet_indexes_init(struct dnet_node *, struct dnet_config *)
+{
+	return 0;
+}
+
+void dnet_indexes_cleanup(struct dnet_node *)
+{
+}
+
+int dnet_process_indexes(struct dnet_backend_io *backend, dnet_net_state *st, dnet_cmd *cmd, void *data)
+{
+	dnet_indexes_request *request = static_cast<dnet_indexes_request*>(data);
+	int err = -ENOTSUP;
+
+	switch (cmd->cmd) {
+		case DNET_CMD_INDEXES_UPDATE: {
+			// We are able only update, set or remove in one shot
+			if ((request->flags & DNET_INDEXES_FLAGS_UPDATE_ONLY) && (request->flags & DNET_INDEXES_FLAGS_REMOVE_ONLY)) {
+				err = -EINVAL;
+				break;
+			}
+
+			auto functor = std::make_shared<update_indexes_functor>(backend, st, cmd, request);
+
+			bool finished = false;
+
+			err = functor->process(&finished);
+
+			if (!(finished && !err)) {
+				// Do not send final ACK, it will be sent when all indexes are fully updated
+				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			}
 		}
 			break;
 		case DNET_CMD_INDEXES_INTERNAL:
@@ -899,12 +2936,22 @@ int dnet_process_indexes(struct dnet_backend_io *backend, dnet_net_state *st, dn
 			break;
 		case DNET_CMD_INDEXES_FIND: {
 			bool first = true;
+			uint64_t size = cmd->size;
 
 			err = -1;
 
 			while (request) {
+				uint64_t request_size;
+				int ret = find_indexes_request_size(request, size, &request_size);
+				if (ret) {
+					dnet_log(st->n, DNET_LOG_ERROR, "%s: INDEXES_FIND: request does not fit into %llu bytes of payload",
+						dnet_dump_id(&cmd->id), static_cast<unsigned long long>(size));
+					err = ret;
+					break;
+				}
+
 				bool more = (request->flags & DNET_INDEXES_FLAGS_MORE);
-				int ret = process_find_indexes(backend, st, cmd, first ? cmd->id : request->id, request, more);
+				ret = process_find_indexes(backend, st, cmd, first ? cmd->id : request->id, request, more);
 				first = false;
 
 				if (err == -1)
@@ -916,12 +2963,8 @@ int dnet_process_indexes(struct dnet_backend_io *backend, dnet_net_state *st, dn
 					break;
 				}
 
-				char *data = reinterpret_cast<char *>(request + 1);
-				for (size_t i = 0; i < request->entries_count; ++i) {
-					auto entry = reinterpret_cast<dnet_indexes_request_entry *>(data);
-					data += sizeof(*entry) + entry->size;
-				}
-				request = reinterpret_cast<dnet_indexes_request *>(data);
+				size -= request_size;
+				request = reinterpret_cast<dnet_indexes_request *>(reinterpret_cast<char *>(request) + request_size);
 			}
 			break;
 		}
@@ -81,14 +81,35 @@ int local_session::backend_id() const
 
 data_pointer local_session::read(const dnet_id &id, int *errp)
 {
-	return read(id, NULL, NULL, errp);
+	return read(id, NULL, NULL, 0, errp);
+}
+
+data_pointer local_session::read(const dnet_id &id, uint64_t size, int *errp)
+{
+	return read(id, NULL, NULL, size, errp);
 }
 
 data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, int *errp)
+{
+	return read(id, user_flags, timestamp, 0, errp);
+}
+
+data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, uint64_t size, int *errp)
+{
+	return read(id, user_flags, timestamp, NULL, size, errp);
+}
+
+/*
+ * Reads first @size bytes of the object, 0 means whole object,
+ * @csum_type gets algorithm of record's checksum
+ */
+data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, uint8_t *csum_type,
+		uint64_t size, int *errp)
 {
 	dnet_io_attr io;
 	memset(&io, 0, sizeof(io));
 	dnet_empty_time(&io.timestamp);
+	io.size = size;
 
 	memcpy(io.id, id.id, DNET_ID_SIZE);
 	memcpy(io.parent, id.id, DNET_ID_SIZE);
@@ -130,6 +151,8 @@ data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_t
 				*user_flags = req_io->user_flags;
 			if (timestamp)
 				*timestamp = req_io->timestamp;
+			if (csum_type)
+				*csum_type = req_io->csum_type;
 
 			dnet_log(m_state->n, DNET_LOG_DEBUG, "entry in list, size: %llu",
 				static_cast<unsigned long long>(req_io->size));
@@ -39,7 +39,12 @@ class local_session
 		int backend_id() const;
 
 		ioremap::elliptics::data_pointer read(const dnet_id &id, int *errp);
+		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t size, int *errp);
 		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, int *errp);
+		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp,
+			uint64_t size, int *errp);
+		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp,
+			uint8_t *csum_type, uint64_t size, int *errp);
 		int write(const dnet_id &id, const ioremap::elliptics::data_pointer &data);
 		int write(const dnet_id &id, const char *data, size_t size);
 		int write(const dnet_id &id, const char *data, size_t size, uint64_t user_flags, const dnet_time &timestamp);
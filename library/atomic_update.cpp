@@ -0,0 +1,403 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "elliptics.h"
+
+#include "elliptics/iterator_filter.h"
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+struct malloc_deleter {
+	void operator() (void *ptr) const {
+		free(ptr);
+	}
+};
+
+typedef std::unique_ptr<char, malloc_deleter> malloc_ptr;
+
+/* record as it is seen by the update, missing record has empty timestamp and no data */
+struct atomic_record {
+	atomic_record() : exists(false), user_flags(0), size(0) {
+		dnet_empty_time(&timestamp);
+	}
+
+	bool		exists;
+	dnet_time	timestamp;
+	uint64_t	user_flags;
+	uint64_t	size;
+	malloc_ptr	data;
+};
+
+/* new data of the record, it points either to @storage or to the argument of the request */
+struct atomic_result {
+	atomic_result() : data(NULL), size(0) {}
+
+	const char	*data;
+	uint64_t	size;
+	std::string	storage;
+	malloc_ptr	filter_data;
+};
+
+} /* namespace */
+
+/*
+ * Reads the record from cache or, if it is not cached, right from the backend's descriptor.
+ * Only metadata is read if @with_data is false.
+ */
+static int dnet_atomic_read(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		bool with_data, atomic_record &rec)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_io_attr io;
+	struct dnet_io_local local;
+	void *data = NULL;
+	int err;
+
+	memset(&io, 0, sizeof(struct dnet_io_attr));
+	memcpy(io.id, cmd->id.id, DNET_ID_SIZE);
+
+	err = dnet_cmd_cache_read_local(backend, st, cmd, &io, &data);
+	if (!err) {
+		rec.exists = true;
+		rec.timestamp = io.timestamp;
+		rec.user_flags = io.user_flags;
+		rec.size = io.size;
+		rec.data.reset(static_cast<char *>(data));
+		return 0;
+	}
+
+	if (err != -ENOENT && err != -ENOTSUP)
+		return err;
+
+	if (!backend->cb->lookup) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: lookup operation is not supported in backend",
+				dnet_dump_id(&cmd->id));
+		return -ENOTSUP;
+	}
+
+	memset(&local, 0, sizeof(struct dnet_io_local));
+	memcpy(local.key, cmd->id.id, DNET_ID_SIZE);
+	local.fd = -1;
+
+	err = backend->cb->lookup(n, backend->cb->command_private, &local);
+	if (err == -ENOENT)
+		return 0;
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: lookup operation has failed: %d",
+				dnet_dump_id(&cmd->id), err);
+		return err;
+	}
+
+	/* the record is being written by prepare/plain/commit sequence, it can't be updated until commit */
+	if (local.record_flags & DNET_RECORD_FLAGS_UNCOMMITTED) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: record is not committed", dnet_dump_id(&cmd->id));
+		return -EBUSY;
+	}
+
+	rec.exists = true;
+	rec.timestamp = local.timestamp;
+	rec.user_flags = local.user_flags;
+	rec.size = local.total_size;
+
+	if (!with_data)
+		return 0;
+
+	if (local.fd < 0) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: backend does not provide record's descriptor",
+				dnet_dump_id(&cmd->id));
+		return -ENOTSUP;
+	}
+
+	rec.data.reset(static_cast<char *>(malloc(rec.size ? rec.size : 1)));
+	if (!rec.data)
+		return -ENOMEM;
+
+	for (uint64_t offset = 0; offset < rec.size; ) {
+		ssize_t bytes = pread(local.fd, rec.data.get() + offset, rec.size - offset, local.fd_offset + offset);
+		if (bytes < 0 && errno == EINTR)
+			continue;
+
+		if (bytes <= 0) {
+			err = bytes < 0 ? -errno : -ERANGE;
+			dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: failed to read %llu bytes at %llu: %d",
+					dnet_dump_id(&cmd->id), (unsigned long long)rec.size,
+					(unsigned long long)local.fd_offset, err);
+			return err;
+		}
+
+		offset += bytes;
+	}
+
+	return 0;
+}
+
+static int dnet_atomic_increment(struct dnet_node *n, struct dnet_cmd *cmd, const atomic_record &rec,
+		const char *arg, uint64_t arg_size, atomic_result &result)
+{
+	uint64_t value = 0, delta;
+
+	if (arg_size != sizeof(int64_t)) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic increment: invalid argument size: %llu",
+				dnet_dump_id(&cmd->id), (unsigned long long)arg_size);
+		return -EINVAL;
+	}
+
+	if (rec.size && rec.size != sizeof(uint64_t)) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic increment: record of %llu bytes is not a counter",
+				dnet_dump_id(&cmd->id), (unsigned long long)rec.size);
+		return -EINVAL;
+	}
+
+	memcpy(&delta, arg, sizeof(uint64_t));
+	delta = dnet_bswap64(delta);
+
+	if (rec.size) {
+		memcpy(&value, rec.data.get(), sizeof(uint64_t));
+		value = dnet_bswap64(value);
+	}
+
+	/* counter wraps around as unsigned, adding negative delta decrements it */
+	value = dnet_bswap64(value + delta);
+
+	result.storage.assign(reinterpret_cast<const char *>(&value), sizeof(uint64_t));
+	result.data = result.storage.data();
+	result.size = result.storage.size();
+	return 0;
+}
+
+/*
+ * RFC 7386: members of @patch replace members of @target, null members remove them,
+ * objects are merged recursively and any other @patch replaces the @target as a whole.
+ * Values of @patch are moved into @target, so patch's document must outlive the result.
+ */
+static void dnet_json_merge_patch(rapidjson::Value &target, rapidjson::Value &patch,
+		rapidjson::Document::AllocatorType &allocator)
+{
+	if (!patch.IsObject()) {
+		target = patch;
+		return;
+	}
+
+	if (!target.IsObject())
+		target.SetObject();
+
+	for (rapidjson::Value::MemberIterator it = patch.MemberBegin(); it != patch.MemberEnd(); ++it) {
+		if (it->value.IsNull()) {
+			target.RemoveMember(it->name.GetString());
+			continue;
+		}
+
+		if (target.HasMember(it->name.GetString())) {
+			dnet_json_merge_patch(target[it->name.GetString()], it->value, allocator);
+		} else {
+			rapidjson::Value value;
+			dnet_json_merge_patch(value, it->value, allocator);
+			target.AddMember(it->name, value, allocator);
+		}
+	}
+}
+
+static int dnet_atomic_json_merge(struct dnet_node *n, struct dnet_cmd *cmd, const atomic_record &rec,
+		const char *arg, uint64_t arg_size, atomic_result &result)
+{
+	rapidjson::Document document, patch;
+
+	/* rapidjson parses zero-terminated strings only */
+	const std::string patch_string(arg, arg_size);
+	patch.Parse<0>(patch_string.c_str());
+	if (patch.HasParseError()) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic json merge: invalid patch: %s at %zu",
+				dnet_dump_id(&cmd->id), patch.GetParseError(), patch.GetErrorOffset());
+		return -EINVAL;
+	}
+
+	if (rec.size) {
+		const std::string document_string(rec.data.get(), rec.size);
+		document.Parse<0>(document_string.c_str());
+		if (document.HasParseError()) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: atomic json merge: record is not a json document: %s at %zu",
+					dnet_dump_id(&cmd->id), document.GetParseError(), document.GetErrorOffset());
+			return -EINVAL;
+		}
+	}
+
+	dnet_json_merge_patch(document, patch, document.GetAllocator());
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	document.Accept(writer);
+
+	result.storage.assign(buffer.GetString(), buffer.Size());
+	result.data = result.storage.data();
+	result.size = result.storage.size();
+	return 0;
+}
+
+static int dnet_atomic_filter(struct dnet_node *n, struct dnet_cmd *cmd, const atomic_record &rec,
+		const char *name, uint32_t name_size, const char *arg, uint64_t arg_size, atomic_result &result)
+{
+	const struct dnet_update_filter *ops;
+	struct dnet_iterator_filter_record frec;
+	const std::string filter_name(name, strnlen(name, name_size));
+	void *data = NULL;
+	uint64_t size = 0;
+	int err;
+
+	err = dnet_update_filter_get(n, filter_name.c_str(), &ops);
+	if (err)
+		return err;
+
+	memset(&frec, 0, sizeof(struct dnet_iterator_filter_record));
+	memcpy(frec.key.id, cmd->id.id, DNET_ID_SIZE);
+	frec.timestamp = rec.timestamp;
+	frec.user_flags = rec.user_flags;
+	frec.fd = -1;
+	frec.size = rec.size;
+	frec.data = rec.data.get();
+
+	err = ops->update(&frec, arg, arg_size, &data, &size);
+	result.filter_data.reset(static_cast<char *>(data));
+	if (err < 0) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: filter: %s failed: %d",
+				dnet_dump_id(&cmd->id), filter_name.c_str(), err);
+		return err;
+	}
+
+	if (size && !data) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: filter: %s returned %llu bytes without data",
+				dnet_dump_id(&cmd->id), filter_name.c_str(), (unsigned long long)size);
+		return -EINVAL;
+	}
+
+	result.data = result.filter_data.get();
+	result.size = size;
+	return 0;
+}
+
+int dnet_atomic_update_prepare(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		void *data, void **request, uint64_t *request_size)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_io_attr io, *wio;
+	struct dnet_atomic_update update;
+	const char *name, *arg;
+	atomic_record rec;
+	atomic_result result;
+	int err;
+
+	if (cmd->size < sizeof(struct dnet_io_attr) + sizeof(struct dnet_atomic_update)) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: invalid size: %llu",
+				dnet_dump_id(&cmd->id), (unsigned long long)cmd->size);
+		return -EINVAL;
+	}
+
+	memcpy(&io, data, sizeof(struct dnet_io_attr));
+	dnet_convert_io_attr(&io);
+
+	memcpy(&update, static_cast<char *>(data) + sizeof(struct dnet_io_attr), sizeof(struct dnet_atomic_update));
+	dnet_convert_atomic_update(&update);
+
+	name = static_cast<const char *>(data) + sizeof(struct dnet_io_attr) + sizeof(struct dnet_atomic_update);
+	arg = name + update.name_size;
+
+	if (io.size != cmd->size - sizeof(struct dnet_io_attr) ||
+			update.name_size > io.size - sizeof(struct dnet_atomic_update) ||
+			update.arg_size != io.size - sizeof(struct dnet_atomic_update) - update.name_size) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: size mismatch: cmd size: %llu, io size: %llu, "
+				"name size: %u, argument size: %llu",
+				dnet_dump_id(&cmd->id), (unsigned long long)cmd->size, (unsigned long long)io.size,
+				update.name_size, (unsigned long long)update.arg_size);
+		return -EINVAL;
+	}
+
+	if (n->ro || backend->read_only)
+		return -EROFS;
+
+	err = dnet_atomic_read(backend, st, cmd, update.type != DNET_ATOMIC_APPEND, rec);
+	if (err)
+		return err;
+
+	if ((update.flags & DNET_ATOMIC_FLAGS_IF_VERSION) && dnet_time_cmp(&rec.timestamp, &update.version)) {
+		dnet_log(n, DNET_LOG_NOTICE, "%s: atomic update: version mismatch: record-ts: %lld.%lld, "
+				"expected-ts: %lld.%lld", dnet_dump_id(&cmd->id),
+				(long long)rec.timestamp.tsec, (long long)rec.timestamp.tnsec,
+				(long long)update.version.tsec, (long long)update.version.tnsec);
+		return -EBADFD;
+	}
+
+	switch (update.type) {
+	case DNET_ATOMIC_APPEND:
+		/* appended part is written as is, the record itself is not read */
+		result.data = arg;
+		result.size = update.arg_size;
+		break;
+	case DNET_ATOMIC_INCREMENT:
+		err = dnet_atomic_increment(n, cmd, rec, arg, update.arg_size, result);
+		break;
+	case DNET_ATOMIC_JSON_MERGE:
+		err = dnet_atomic_json_merge(n, cmd, rec, arg, update.arg_size, result);
+		break;
+	case DNET_ATOMIC_FILTER:
+		err = dnet_atomic_filter(n, cmd, rec, name, update.name_size, arg, update.arg_size, result);
+		break;
+	default:
+		dnet_log(n, DNET_LOG_ERROR, "%s: atomic update: unsupported type: %u",
+				dnet_dump_id(&cmd->id), update.type);
+		err = -ENOTSUP;
+		break;
+	}
+
+	if (err)
+		return err;
+
+	*request_size = sizeof(struct dnet_io_attr) + result.size;
+	*request = malloc(*request_size);
+	if (!*request)
+		return -ENOMEM;
+
+	wio = static_cast<struct dnet_io_attr *>(*request);
+	*wio = io;
+	memcpy(wio->id, cmd->id.id, DNET_ID_SIZE);
+	wio->offset = 0;
+	wio->size = result.size;
+	wio->num = 0;
+	wio->flags &= ~(DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_COMMIT |
+			DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_COMPARE_AND_SWAP | DNET_IO_FLAGS_CAS_TIMESTAMP);
+	if (update.type == DNET_ATOMIC_APPEND)
+		wio->flags |= DNET_IO_FLAGS_APPEND;
+	if (dnet_time_is_empty(&wio->timestamp))
+		dnet_current_time(&wio->timestamp);
+
+	if (result.size)
+		memcpy(wio + 1, result.data, result.size);
+
+	dnet_log(n, DNET_LOG_NOTICE, "%s: atomic update: type: %u, record size: %llu, new size: %llu",
+			dnet_dump_id(&cmd->id), update.type, (unsigned long long)rec.size,
+			(unsigned long long)result.size);
+
+	dnet_convert_io_attr(wio);
+	return 0;
+}
@@ -133,11 +133,12 @@ err_out_exit:
 }
 
 static int dnet_backend_io_init(struct dnet_node *n, struct dnet_backend_io *io,
-		int io_thread_num, int nonblocking_io_thread_num)
+		int io_thread_num, int nonblocking_io_thread_num,
+		int io_thread_num_min, int nonblocking_io_thread_num_min)
 {
 	int err;
 
-	err = dnet_backend_command_stats_init(io);
+	err = dnet_backend_command_stats_init(n, io);
 	if (err) {
 		dnet_log(n, DNET_LOG_ERROR, "dnet_backend_io_init: backend: %zu, "
 				"failed to allocate command stat structure: %d",
@@ -160,6 +161,9 @@ static int dnet_backend_io_init(struct dnet_node *n, struct dnet_backend_io *io,
 		goto err_out_free_recv_pool;
 	}
 
+	dnet_work_pool_set_min_threads(&io->pool.recv_pool, io_thread_num_min);
+	dnet_work_pool_set_min_threads(&io->pool.recv_pool_nb, nonblocking_io_thread_num_min);
+
 	return 0;
 
 err_out_free_recv_pool:
@@ -196,6 +200,87 @@ static const char *elapsed(const dnet_time &start)
 	return buffer;
 }
 
+static void dnet_backend_set_stage(dnet_backend_info &backend, dnet_backend_activation_stage stage)
+{
+	std::lock_guard<std::mutex> guard(*backend.state_mutex);
+	backend.activation_stage = stage;
+}
+
+/* re-reads backend's section of the configuration file */
+static int dnet_backend_read_config(struct dnet_node *node, size_t backend_id, dnet_backend_info &backend,
+		const dnet_time &start, const char *func)
+{
+	try {
+		using namespace ioremap::elliptics::config;
+		auto &data = *static_cast<config_data *>(node->config_data);
+		auto parser = data.parse_config();
+		config cfg = parser->root();
+		const config backends_config = cfg.at("backends");
+		bool found = false;
+
+		for (size_t index = 0; index < backends_config.size(); ++index) {
+			const config backend_config = backends_config.at(index);
+			const uint32_t config_backend_id = backend_config.at<uint32_t>("backend_id");
+			if (backend_id == config_backend_id) {
+				backend.parse(&data, backend_config);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			dnet_log(node, DNET_LOG_ERROR, "%s: backend: %zu, "
+				"have not found backend section in configuration file, elapsed: %s",
+				func, backend_id, elapsed(start));
+			return -EBADF;
+		}
+	} catch (std::bad_alloc &) {
+		dnet_log(node, DNET_LOG_ERROR, "%s: backend: %zu, failed as not enouh memory, elapsed: %s",
+			func, backend_id, elapsed(start));
+		return -ENOMEM;
+	} catch (std::exception &exc) {
+		dnet_log(node, DNET_LOG_ERROR, "%s: backend: %zu, failed to read configuration file: %s, elapsed: %s",
+			func, backend_id, exc.what(), elapsed(start));
+		return -EBADF;
+	}
+
+	return 0;
+}
+
+/* opens storage with the options read from configuration file */
+static int dnet_backend_open_storage(dnet_backend_info &backend)
+{
+	backend.config = backend.config_template;
+	backend.data.assign(backend.data.size(), '\0');
+	backend.config.data = backend.data.data();
+	backend.config.log = backend.log.get();
+
+	for (auto it = backend.options.begin(); it != backend.options.end(); ++it) {
+		const dnet_backend_config_entry &entry = *it;
+		entry.entry->callback(&backend.config, entry.entry->key, entry.value_template.data());
+	}
+
+	return backend.config.init(&backend.config);
+}
+
+/* loads record filters listed in the config, @filters is NULL if there are none */
+static int dnet_backend_load_record_filters(struct dnet_node *node, size_t backend_id, const dnet_backend_info &backend,
+		dnet_record_filters **filters)
+{
+	*filters = NULL;
+	if (backend.record_filters.empty())
+		return 0;
+
+	std::vector<const char *> names, configs;
+	for (auto it = backend.record_filters.begin(); it != backend.record_filters.end(); ++it) {
+		names.push_back(it->first.c_str());
+		configs.push_back(it->second.empty() ? NULL : it->second.c_str());
+	}
+
+	return dnet_record_filters_load(node, backend_id, names.size(), names.data(), configs.data(),
+			backend.record_filter_budget, filters);
+}
+
 int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 {
 	int ids_num;
@@ -231,6 +316,8 @@ int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 			}
 		}
 		backend.state = DNET_BACKEND_ACTIVATING;
+		backend.activation_stage = DNET_BACKEND_STAGE_CONFIG;
+		backend.activation_start = start;
 	}
 
 	dnet_log(node, DNET_LOG_INFO, "backend_init: backend: %zu, initializing", backend_id);
@@ -238,58 +325,21 @@ int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 	int err;
 	dnet_backend_io *backend_io;
 
-	try {
-		using namespace ioremap::elliptics::config;
-		auto &data = *static_cast<config_data *>(node->config_data);
-		auto parser = data.parse_config();
-		config cfg = parser->root();
-		const config backends_config = cfg.at("backends");
-		bool found = false;
-
-		for (size_t index = 0; index < backends_config.size(); ++index) {
-			const config backend_config = backends_config.at(index);
-			const uint32_t config_backend_id = backend_config.at<uint32_t>("backend_id");
-			if (backend_id == config_backend_id) {
-				backend.parse(&data, backend_config);
-				found = true;
-				break;
-			}
-		}
-
-		if (!found) {
-			err = -EBADF;
-			dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, "
-				"have not found backend section in configuration file, elapsed: %s",
-				backend_id, elapsed(start));
-			goto err_out_exit;
-		}
-	} catch (std::bad_alloc &) {
-		err = -ENOMEM;
-		dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, failed as not enouh memory, elapsed: %s",
-			backend_id, elapsed(start));
-		goto err_out_exit;
-	} catch (std::exception &exc) {
-		dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, failed to read configuration file: %s, elapsed: %s",
-			backend_id, exc.what(), elapsed(start));
-		err = -EBADF;
+	err = dnet_backend_read_config(node, backend_id, backend, start, "backend_init");
+	if (err)
 		goto err_out_exit;
-	}
-
-	backend.config = backend.config_template;
-	backend.data.assign(backend.data.size(), '\0');
-	backend.config.data = backend.data.data();
-	backend.config.log = backend.log.get();
 
 	backend_io = &node->io->backends[backend_id];
 	backend_io->need_exit = 0;
 	backend_io->read_only = backend.read_only_at_start;
+	backend_io->numa_node = backend.numa_node;
+	memset(&backend_io->inline_budget, 0, sizeof(backend_io->inline_budget));
+	backend_io->inline_budget.limit = backend.inline_cache_budget;
+	dnet_backend_gate_open(&backend_io->gate, 0);
 
-	for (auto it = backend.options.begin(); it != backend.options.end(); ++it) {
-		const dnet_backend_config_entry &entry = *it;
-		entry.entry->callback(&backend.config, entry.entry->key, entry.value_template.data());
-	}
+	dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_STORAGE);
 
-	err = backend.config.init(&backend.config);
+	err = dnet_backend_open_storage(backend);
 	if (err) {
 		dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, failed to init backend: %d, elapsed: %s",
 			backend_id, err, elapsed(start));
@@ -298,14 +348,36 @@ int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 
 	backend_io->cb = &backend.config.cb;
 
-	err = dnet_backend_io_init(node, backend_io, backend.io_thread_num, backend.nonblocking_io_thread_num);
+	if (backend.change_log) {
+		dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_CHANGE_LOG);
+		err = dnet_change_log_open(backend.history.c_str(), backend.change_log_size, &backend_io->change_log);
+		if (err) {
+			dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, history path: %s, "
+					"failed to open change log, elapsed: %s: %s [%d]",
+					backend_id, backend.history.c_str(), elapsed(start), strerror(-err), err);
+			goto err_out_backend_cleanup;
+		}
+	}
+
+	err = dnet_backend_load_record_filters(node, backend_id, backend, &backend_io->record_filters);
+	if (err) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, failed to load record filters, err: %d, "
+				"elapsed: %s", backend_id, err, elapsed(start));
+		goto err_out_change_log_close;
+	}
+
+	dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_IO_POOL);
+
+	err = dnet_backend_io_init(node, backend_io, backend.io_thread_num, backend.nonblocking_io_thread_num,
+			backend.io_thread_num_min, backend.nonblocking_io_thread_num_min);
 	if (err) {
 		dnet_log(node, DNET_LOG_ERROR, "backend_init: backend: %zu, failed to init io pool, err: %d, elapsed: %s",
 			backend_id, err, elapsed(start));
-		goto err_out_backend_cleanup;
+		goto err_out_record_filters_unload;
 	}
 
 	if (backend.cache_config) {
+		dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_CACHE);
 		backend_io->cache = backend.cache = dnet_cache_init(node, backend_io, backend.cache_config.get());
 		if (!backend.cache) {
 			err = -ENOMEM;
@@ -315,6 +387,8 @@ int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 		}
 	}
 
+	dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_ROUTES);
+
 	ids_num = 0;
 	ids = dnet_ids_init(node, backend.history.c_str(), &ids_num, backend.config.storage_free, node->addrs, backend_id);
 	if (ids == NULL) {
@@ -339,6 +413,7 @@ int dnet_backend_init(struct dnet_node *node, size_t backend_id, int *state)
 		std::lock_guard<std::mutex> guard(*backend.state_mutex);
 		dnet_current_time(&backend.last_start);
 		backend.last_start_err = 0;
+		backend.activation_stage = DNET_BACKEND_STAGE_NONE;
 		backend.state = DNET_BACKEND_ENABLED;
 	}
 	return 0;
@@ -356,6 +431,12 @@ err_out_backend_io_cleanup:
 	backend_io->need_exit = 1;
 	dnet_backend_io_cleanup(node, backend_io);
 	node->io->backends[backend_id].cb = NULL;
+err_out_record_filters_unload:
+	dnet_record_filters_unload(backend_io->record_filters);
+	backend_io->record_filters = NULL;
+err_out_change_log_close:
+	dnet_change_log_close(backend_io->change_log);
+	backend_io->change_log = NULL;
 err_out_backend_cleanup:
 	backend.config.cleanup(&backend.config);
 err_out_exit:
@@ -363,6 +444,7 @@ err_out_exit:
 		std::lock_guard<std::mutex> guard(*backend.state_mutex);
 		dnet_current_time(&backend.last_start);
 		backend.last_start_err = err;
+		backend.activation_stage = DNET_BACKEND_STAGE_NONE;
 		backend.state = DNET_BACKEND_DISABLED;
 	}
 	return err;
@@ -415,13 +497,29 @@ int dnet_backend_cleanup(struct dnet_node *node, size_t backend_id, int *state)
 	dnet_cache_cleanup(backend.cache);
 	backend.cache = NULL;
 
+	// requests processed by server shards without io pool have to finish before storage is closed,
+	// those which come later fail until backend is enabled again
+	const bool storage_failed = backend_io && backend_io->gate.failed;
+	if (backend_io) {
+		dnet_backend_gate_close(&backend_io->gate);
+		dnet_backend_gate_open(&backend_io->gate, 1);
+	}
+
 	dnet_log(node, DNET_LOG_INFO, "backend_cleanup: backend: %zu: cleaning io: %p", backend_id, backend_io);
 	if (backend_io) {
 		dnet_backend_io_cleanup(node, backend_io);
 		backend_io->cb = NULL;
+
+		dnet_change_log_close(backend_io->change_log);
+		backend_io->change_log = NULL;
+
+		dnet_record_filters_unload(backend_io->record_filters);
+		backend_io->record_filters = NULL;
 	}
 
-	backend.config.cleanup(&backend.config);
+	// storage has already been closed by failed reload
+	if (!storage_failed)
+		backend.config.cleanup(&backend.config);
 	memset(&backend.config.cb, 0, sizeof(backend.config.cb));
 
 	{
@@ -434,6 +532,195 @@ int dnet_backend_cleanup(struct dnet_node *node, size_t backend_id, int *state)
 	return 0;
 }
 
+/*
+ * Reopens storage of enabled backend with storage options re-read from configuration file.
+ * Io pools, cache, change log and routes are kept as is, so are the group, the history and
+ * the sizes of pools and cache, they are applied only by disabling and enabling the backend.
+ *
+ * New requests wait in io threads while requests being processed and cache syncs drain,
+ * so reload costs a short pause instead of errors and cold cache. If storage can not be
+ * opened with new options, previous ones are used, if it fails too backend is removed
+ * from the route list and its requests fail until it is disabled.
+ */
+int dnet_backend_reload(struct dnet_node *node, size_t backend_id, int *state)
+{
+	auto &backends = node->config_data->backends->backends;
+	if (backends.size() <= backend_id) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_reload: backend: %zu, invalid backend id", backend_id);
+		return -EINVAL;
+	}
+
+	auto &data = *static_cast<ioremap::elliptics::config::config_data *>(node->config_data);
+	dnet_backend_info &backend = backends[backend_id];
+	dnet_backend_io *backend_io = &node->io->backends[backend_id];
+	dnet_time start;
+	dnet_current_time(&start);
+
+	{
+		std::lock_guard<std::mutex> guard(*backend.state_mutex);
+		*state = backend.state;
+		if (backend.state != DNET_BACKEND_ENABLED || backend_io->gate.failed) {
+			dnet_log(node, DNET_LOG_ERROR, "backend_reload: backend: %zu, trying to reload not enabled backend",
+				backend_id);
+			switch (*state) {
+				case DNET_BACKEND_ENABLED:
+					return -ENXIO;
+				case DNET_BACKEND_DISABLED:
+					return -ENOENT;
+				case DNET_BACKEND_ACTIVATING:
+				case DNET_BACKEND_DEACTIVATING:
+					return -EAGAIN;
+				case DNET_BACKEND_UNITIALIZED:
+				default:
+					return -EINVAL;
+			}
+		}
+		// nobody can enable or disable backend until reload completes
+		backend.state = DNET_BACKEND_ACTIVATING;
+		backend.activation_stage = DNET_BACKEND_STAGE_CONFIG;
+		backend.activation_start = start;
+	}
+
+	dnet_log(node, DNET_LOG_INFO, "backend_reload: backend: %zu, reloading", backend_id);
+
+	// parsing overwrites config of the live storage, so new options are read into a scratch copy
+	dnet_backend_info fresh(data.logger, backend_id);
+	dnet_record_filters *filters = NULL;
+	int err = dnet_backend_read_config(node, backend_id, fresh, start, "backend_reload");
+	if (err)
+		goto err_out_exit;
+
+	// filters are loaded before anything is changed, so failure leaves backend as it was
+	err = dnet_backend_load_record_filters(node, backend_id, fresh, &filters);
+	if (err) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_reload: backend: %zu, failed to load record filters, err: %d, "
+				"elapsed: %s", backend_id, err, elapsed(start));
+		goto err_out_exit;
+	}
+
+	dnet_backend_set_stage(backend, DNET_BACKEND_STAGE_STORAGE);
+
+	dnet_backend_gate_close(&backend_io->gate);
+
+	dnet_log(node, DNET_LOG_INFO, "backend_reload: backend: %zu, requests have been drained, elapsed: %s",
+		backend_id, elapsed(start));
+
+	backend.config.cleanup(&backend.config);
+
+	std::swap(backend.config_template, fresh.config_template);
+	std::swap(backend.options, fresh.options);
+	std::swap(backend.data, fresh.data);
+
+	err = dnet_backend_open_storage(backend);
+	if (err) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_reload: backend: %zu, failed to reopen storage with new config: %d, "
+				"reopening with previous one, elapsed: %s", backend_id, err, elapsed(start));
+
+		std::swap(backend.config_template, fresh.config_template);
+		std::swap(backend.options, fresh.options);
+		std::swap(backend.data, fresh.data);
+
+		int prev_err = dnet_backend_open_storage(backend);
+		if (prev_err) {
+			dnet_log(node, DNET_LOG_ERROR, "backend_reload: backend: %zu, failed to reopen storage: %d, "
+					"backend is unavailable until it is disabled, elapsed: %s",
+					backend_id, prev_err, elapsed(start));
+
+			if (node->route)
+				dnet_route_list_disable_backend(node->route, backend_id);
+		}
+
+		dnet_backend_gate_open(&backend_io->gate, prev_err != 0);
+		dnet_record_filters_unload(filters);
+		goto err_out_exit;
+	}
+
+	// nobody uses filters while gate is closed
+	std::swap(backend_io->record_filters, filters);
+	dnet_record_filters_unload(filters);
+	std::swap(backend.record_filters, fresh.record_filters);
+	backend.record_filter_budget = fresh.record_filter_budget;
+
+	/* budget is not a storage option, it is applied right away */
+	backend.inline_cache_budget = fresh.inline_cache_budget;
+	backend_io->inline_budget.limit = fresh.inline_cache_budget;
+
+	dnet_backend_gate_open(&backend_io->gate, 0);
+
+	dnet_log(node, DNET_LOG_INFO, "backend_reload: backend: %zu, reloaded, elapsed: %s", backend_id, elapsed(start));
+
+err_out_exit:
+	{
+		std::lock_guard<std::mutex> guard(*backend.state_mutex);
+		dnet_current_time(&backend.last_start);
+		backend.last_start_err = err;
+		backend.activation_stage = DNET_BACKEND_STAGE_NONE;
+		backend.state = DNET_BACKEND_ENABLED;
+	}
+	return err;
+}
+
+static void dnet_backend_warm_init(struct dnet_node *node, const std::vector<uint32_t> &backend_ids)
+{
+	int state;
+
+	for (auto it = backend_ids.begin(); it != backend_ids.end(); ++it) {
+		if (node->need_exit)
+			break;
+
+		int err = dnet_backend_init(node, *it, &state);
+		if (err) {
+			dnet_log(node, DNET_LOG_ERROR, "backend_init_all: backend: %u, failed to warm up: %s [%d]",
+					*it, strerror(-err), err);
+		}
+	}
+}
+
+/*
+ * Warm start does not wait for backends: node joins the network with none of them in the route list,
+ * and every backend is announced as soon as its storage has loaded, so node serves ready backends
+ * while the others are still activating. Their progress is reported by backend status.
+ */
+static int dnet_backend_warm_init_all(struct dnet_node *node, const ioremap::elliptics::config::config &backends_config)
+{
+	using namespace ioremap::elliptics::config;
+
+	auto &list = *node->config_data->backends;
+	auto &data = *static_cast<config_data *>(node->config_data);
+	std::vector<uint32_t> backend_ids;
+
+	try {
+		for (size_t index = 0; index < backends_config.size(); ++index) {
+			const config backend_config = backends_config.at(index);
+			const uint32_t backend_id = backend_config.at<uint32_t>("backend_id");
+			dnet_backend_info &backend = list.backends[backend_id];
+			if (!backend.enable_at_start) {
+				backend.parse(&data, backend_config);
+				continue;
+			}
+
+			backend_ids.push_back(backend_id);
+		}
+
+		if (node->config_data->parallel_start) {
+			for (auto it = backend_ids.begin(); it != backend_ids.end(); ++it) {
+				list.warm_threads.emplace_back(dnet_backend_warm_init, node, std::vector<uint32_t>(1, *it));
+			}
+		} else {
+			list.warm_threads.emplace_back(dnet_backend_warm_init, node, backend_ids);
+		}
+	} catch (std::bad_alloc &) {
+		return -ENOMEM;
+	} catch (std::system_error &exc) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_init_all: failed to start warm up thread: %s", exc.what());
+		return -exc.code().value();
+	}
+
+	dnet_log(node, DNET_LOG_NOTICE, "backend_init_all: started warming up %zu backends in background",
+			backend_ids.size());
+	return 0;
+}
+
 int dnet_backend_init_all(struct dnet_node *node)
 {
 	int err = 1;
@@ -447,6 +734,9 @@ int dnet_backend_init_all(struct dnet_node *node)
 	config cfg = parser->root();
 	const config backends_config = cfg.at("backends");
 
+	if (node->config_data->warm_start)
+		return dnet_backend_warm_init_all(node, backends_config);
+
 	if (node->config_data->parallel_start) {
 		try {
 			using ioremap::elliptics::session;
@@ -516,6 +806,14 @@ void dnet_backend_cleanup_all(struct dnet_node *node)
 {
 	int state = DNET_BACKEND_ENABLED;
 
+	/* backends which are still warming up are cleaned up after their activation finishes */
+	auto &warm_threads = node->config_data->backends->warm_threads;
+	for (auto it = warm_threads.begin(); it != warm_threads.end(); ++it) {
+		if (it->joinable())
+			it->join();
+	}
+	warm_threads.clear();
+
 	auto &backends = node->config_data->backends->backends;
 	for (size_t backend_id = 0; backend_id < backends.size(); ++backend_id) {
 		if (backends[backend_id].state != DNET_BACKEND_DISABLED)
@@ -601,7 +899,7 @@ void backend_fill_status_nolock(struct dnet_node *node, struct dnet_backend_stat
 
 	const auto &backends = node->config_data->backends->backends;
 	const dnet_backend_info &backend = backends[backend_id];
-	const dnet_backend_io &io = node->io->backends[backend_id];
+	dnet_backend_io &io = node->io->backends[backend_id];
 
 	const auto &cb = backend.config.cb;
 
@@ -611,8 +909,19 @@ void backend_fill_status_nolock(struct dnet_node *node, struct dnet_backend_stat
 		status->defrag_state = cb.defrag_status(cb.command_private);
 	status->last_start = backend.last_start;
 	status->last_start_err = backend.last_start_err;
+	status->activation_stage = backend.activation_stage;
+	status->activation_start = backend.activation_start;
 	status->read_only = io.read_only;
 	status->delay = io.delay;
+	status->faults_count = io.faults_num;
+
+	uint64_t rate_bytes, rate_keys;
+	dnet_throttle_get(&io.background_throttle, &rate_bytes, &rate_keys);
+	status->rate_bytes = rate_bytes;
+	status->rate_keys = rate_keys;
+
+	if (backend.state == DNET_BACKEND_ENABLED && io.cache)
+		status->cache_size = dnet_cache_size(io.cache);
 }
 
 void backend_fill_status(dnet_node *node, dnet_backend_status *status, size_t backend_id)
@@ -637,8 +946,10 @@ static int dnet_cmd_backend_control_dangerous(struct dnet_net_state *st, struct
 		return -EINVAL;
 	}
 
-	if (cmd->size != sizeof(dnet_backend_control) + control->ids_count * sizeof(dnet_raw_id)) {
-		dnet_log(node, DNET_LOG_ERROR, "backend_control: command size is not enough for ids, state: %s",
+	if (cmd->size != sizeof(dnet_backend_control) + control->ids_count * sizeof(dnet_raw_id) +
+			control->faults_count * sizeof(dnet_fault_rule) + control->cache_pages_count * sizeof(uint32_t)) {
+		dnet_log(node, DNET_LOG_ERROR, "backend_control: command size is not enough for ids, fault rules "
+				"and pages proportions, state: %s",
 				dnet_state_dump_addr(st));
 		return -EINVAL;
 	}
@@ -666,6 +977,9 @@ static int dnet_cmd_backend_control_dangerous(struct dnet_net_state *st, struct
 	case DNET_BACKEND_DISABLE:
 		err = dnet_backend_cleanup(node, control->backend_id, &state);
 		break;
+	case DNET_BACKEND_RELOAD:
+		err = dnet_backend_reload(node, control->backend_id, &state);
+		break;
 	case DNET_BACKEND_START_DEFRAG:
 		if (cb.defrag_start) {
 			err = cb.defrag_start(cb.command_private,
@@ -704,6 +1018,40 @@ static int dnet_cmd_backend_control_dangerous(struct dnet_net_state *st, struct
 		io.delay = control->delay;
 		err = 0;
 		break;
+	case DNET_BACKEND_SET_RATE:
+		dnet_throttle_set(&io.background_throttle, control->rate_bytes, control->rate_keys);
+		dnet_log(node, DNET_LOG_INFO, "backend_control: backend: %u, background rate: bytes: %llu/s, keys: %llu/s",
+			control->backend_id, (unsigned long long)control->rate_bytes,
+			(unsigned long long)control->rate_keys);
+		err = 0;
+		break;
+	case DNET_BACKEND_SET_FAULTS:
+#ifdef DNET_FAULT_INJECTION
+		err = dnet_backend_faults_set(&io,
+			reinterpret_cast<const dnet_fault_rule *>(control->ids + control->ids_count), control->faults_count);
+		dnet_log(node, err ? DNET_LOG_ERROR : DNET_LOG_INFO, "backend_control: backend: %u, fault rules: %u: %d",
+			control->backend_id, control->faults_count, err);
+#else
+		dnet_log(node, DNET_LOG_ERROR, "backend_control: backend: %u, fault injection is disabled at compile time",
+			control->backend_id);
+		err = -ENOTSUP;
+#endif
+		break;
+	case DNET_BACKEND_RESIZE_CACHE: {
+		/* state lock keeps cache from being destroyed by concurrent disable */
+		std::lock_guard<std::mutex> guard(*backend.state_mutex);
+		if (backend.state != DNET_BACKEND_ENABLED || !io.cache) {
+			err = -ENOTSUP;
+		} else {
+			const uint32_t *proportions = reinterpret_cast<const uint32_t *>(
+				reinterpret_cast<const dnet_fault_rule *>(control->ids + control->ids_count) + control->faults_count);
+			err = dnet_cache_resize(io.cache, control->cache_size, proportions, control->cache_pages_count);
+		}
+		dnet_log(node, err ? DNET_LOG_ERROR : DNET_LOG_INFO, "backend_control: backend: %u, cache size: %llu, "
+			"pages proportions: %u: %d", control->backend_id, (unsigned long long)control->cache_size,
+			control->cache_pages_count, err);
+		break;
+	}
 	}
 
 	char buffer[sizeof(dnet_backend_status_list) + sizeof(dnet_backend_status)];
@@ -804,6 +1152,7 @@ void dnet_backend_info::parse(ioremap::elliptics::config::config_data *data,
 
 	dnet_config_backend *backends_info[] = {
 		dnet_eblob_backend_info(),
+		dnet_tiered_backend_info(),
 	};
 
 	bool found_backend = false;
@@ -837,6 +1186,23 @@ void dnet_backend_info::parse(ioremap::elliptics::config::config_data *data,
 
 	io_thread_num = backend.at("io_thread_num", data->cfg_state.io_thread_num);
 	nonblocking_io_thread_num = backend.at("nonblocking_io_thread_num", data->cfg_state.nonblocking_io_thread_num);
+	io_thread_num_min = backend.at("io_thread_num_min", io_thread_num);
+	nonblocking_io_thread_num_min = backend.at("nonblocking_io_thread_num_min", nonblocking_io_thread_num);
+	numa_node = backend.at<int>("numa_node", -1);
+	change_log = backend.at<bool>("change_log", false);
+	change_log_size = backend.at<uint64_t>("change_log_size", 256 * 1024 * 1024);
+	inline_cache_budget = backend.at<uint64_t>("inline_cache_budget", 0);
+	record_filter_budget = backend.at<uint64_t>("record_filter_budget", 0);
+
+	record_filters.clear();
+	if (backend.has("record_filters")) {
+		const auto filters = backend.at("record_filters");
+		for (size_t i = 0; i < filters.size(); ++i) {
+			const auto filter = filters.at(i);
+			record_filters.emplace_back(filter.at<std::string>("name"),
+					filter.at<std::string>("config", std::string()));
+		}
+	}
 
 	for (int i = 0; i < config.num; ++i) {
 		dnet_config_entry &entry = config.ent[i];
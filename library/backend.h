@@ -9,6 +9,7 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <thread>
 
 #include <elliptics/error.hpp>
 
@@ -19,12 +20,63 @@ class config_data;
 
 namespace ioremap { namespace cache {
 
+/*
+ * Part of every cache shard taken by objects whose (user_flags & @user_flags_mask) == @user_flags.
+ * Objects of partition are not evicted by others while it holds less than @min_share of the shard,
+ * partition which grows above @max_share evicts its own objects. Objects which match no partition
+ * belong to the default one, which has no minimum share.
+ */
+struct cache_partition_config
+{
+	std::string		name;
+	uint64_t		user_flags_mask;
+	uint64_t		user_flags;
+	double			min_share;
+	double			max_share;
+};
+
+struct cache_append_buffer_config
+{
+	/* bytes of appends kept per key before they are written to disk at once, 0 - plain appends are not buffered */
+	size_t			size;
+	/* milliseconds buffered appends may wait for the flush */
+	unsigned		age;
+	/* whether writers are acked when their appends are flushed, not when they are buffered */
+	bool			ack_on_flush;
+};
+
 struct cache_config
 {
 	size_t			size;
 	size_t			count;
 	unsigned		sync_timeout;
 	std::vector<size_t>	pages_proportions;
+	/* bytes per second written by background sync, 0 means unlimited */
+	size_t			sync_bandwidth;
+	/* whether TinyLFU admission filter is enabled, off by default */
+	bool			admission;
+	/* number of the coldest SLRU pages which keep values compressed */
+	size_t			compressed_pages;
+	/* path prefix of hot keys snapshot, empty means snapshot is disabled */
+	std::string		snapshot;
+	/* seconds between periodic snapshots, 0 - save snapshot only on shutdown */
+	unsigned		snapshot_interval;
+	/* objects per second read from disk while cache is warmed up from snapshot, 0 - unlimited */
+	size_t			snapshot_prefetch_rate;
+	/* partitions of every shard, empty if objects of all user flags share the whole cache */
+	std::vector<cache_partition_config> partitions;
+	/* maximum number of keys waiting to be prefetched by DNET_IO_FLAGS_CACHE_PREFETCH hints, 0 - hints are ignored */
+	size_t			prefetch_queue_size;
+	/* objects per second read from disk by prefetch hints, 0 - unlimited */
+	size_t			prefetch_rate;
+	/* seconds between hot keys sent to replicas as prefetch hints, 0 - hot keys are not exchanged */
+	unsigned		hotset_interval;
+	/* maximum number of the hottest keys sent at once */
+	size_t			hotset_size;
+	/* groups replicas are looked for in, empty means all groups of the route table */
+	std::vector<int>	hotset_groups;
+	/* buffering of DNET_IO_FLAGS_APPEND writes sent without DNET_IO_FLAGS_CACHE */
+	cache_append_buffer_config append_buffer;
 
 	static std::unique_ptr<cache_config> parse(const ioremap::elliptics::config::config &cache);
 };
@@ -60,9 +112,13 @@ struct dnet_backend_info
 		log(new dnet_logger(logger, make_attributes(backend_id))),
 		group(0), cache(NULL), enable_at_start(false), read_only_at_start(false),
 		state_mutex(new std::mutex), state(DNET_BACKEND_UNITIALIZED),
-		io_thread_num(0), nonblocking_io_thread_num(0)
+		activation_stage(DNET_BACKEND_STAGE_NONE),
+		io_thread_num(0), nonblocking_io_thread_num(0),
+		io_thread_num_min(0), nonblocking_io_thread_num_min(0), numa_node(-1),
+		change_log(false), change_log_size(0), inline_cache_budget(0), record_filter_budget(0)
 	{
 		dnet_empty_time(&last_start);
+		dnet_empty_time(&activation_start);
 		last_start_err = 0;
 		memset(&config_template, 0, sizeof(config_template));
 		memset(&config, 0, sizeof(config));
@@ -84,11 +140,21 @@ struct dnet_backend_info
 		state(other.state),
 		last_start(other.last_start),
 		last_start_err(other.last_start_err),
+		activation_stage(other.activation_stage),
+		activation_start(other.activation_start),
 		config(other.config),
 		data(std::move(other.data)),
 		cache_config(std::move(other.cache_config)),
 		io_thread_num(other.io_thread_num),
-		nonblocking_io_thread_num(other.nonblocking_io_thread_num)
+		nonblocking_io_thread_num(other.nonblocking_io_thread_num),
+		io_thread_num_min(other.io_thread_num_min),
+		nonblocking_io_thread_num_min(other.nonblocking_io_thread_num_min),
+		numa_node(other.numa_node),
+		change_log(other.change_log),
+		change_log_size(other.change_log_size),
+		inline_cache_budget(other.inline_cache_budget),
+		record_filters(std::move(other.record_filters)),
+		record_filter_budget(other.record_filter_budget)
 	{
 	}
 
@@ -106,11 +172,21 @@ struct dnet_backend_info
 		state = other.state;
 		last_start = other.last_start;
 		last_start_err = other.last_start_err;
+		activation_stage = other.activation_stage;
+		activation_start = other.activation_start;
 		config = other.config;
 		data = std::move(other.data);
 		cache_config = std::move(other.cache_config);
 		io_thread_num = other.io_thread_num;
 		nonblocking_io_thread_num = other.nonblocking_io_thread_num;
+		io_thread_num_min = other.io_thread_num_min;
+		nonblocking_io_thread_num_min = other.nonblocking_io_thread_num_min;
+		numa_node = other.numa_node;
+		change_log = other.change_log;
+		change_log_size = other.change_log_size;
+		inline_cache_budget = other.inline_cache_budget;
+		record_filters = std::move(other.record_filters);
+		record_filter_budget = other.record_filter_budget;
 
 		return *this;
 	}
@@ -130,6 +206,9 @@ struct dnet_backend_info
 	dnet_backend_state state;
 	dnet_time last_start;
 	int last_start_err;
+	/* progress of activation, both are protected by @state_mutex */
+	dnet_backend_activation_stage activation_stage;
+	dnet_time activation_start;
 
 	dnet_config_backend config;
 	std::vector<char> data;
@@ -137,11 +216,27 @@ struct dnet_backend_info
 	std::unique_ptr<ioremap::cache::cache_config> cache_config;
 	int io_thread_num;
 	int nonblocking_io_thread_num;
+	/* pools are scaled between these bounds and thread numbers above by queue wait time */
+	int io_thread_num_min;
+	int nonblocking_io_thread_num_min;
+	/* NUMA node io threads and cache are bound to, -1 means no binding */
+	int numa_node;
+	/* log of writes and removals in @history used by DNET_IFLAGS_CHANGES iterators */
+	bool change_log;
+	uint64_t change_log_size;
+	/* microseconds per second net threads may spend replying to cache hits, 0 disables it */
+	uint64_t inline_cache_budget;
+	/* names and configs of record filters loaded from iterator_filter_dir, in order they are applied */
+	std::vector<std::pair<std::string, std::string>> record_filters;
+	/* microseconds per second all record filters may spend, 0 means unlimited */
+	uint64_t record_filter_budget;
 };
 
 struct dnet_backend_info_list
 {
 	std::vector<dnet_backend_info> backends;
+	/* threads which activate backends in background when warm start is enabled */
+	std::vector<std::thread> warm_threads;
 };
 
 extern "C" {
@@ -151,6 +246,7 @@ typedef struct dnet_backend_info_list_t dnet_backend_info_list;
 
 int dnet_backend_init(struct dnet_node *n, size_t backend_id, int *state);
 int dnet_backend_cleanup(struct dnet_node *n, size_t backend_id, int *state);
+int dnet_backend_reload(struct dnet_node *n, size_t backend_id, int *state);
 
 int dnet_backend_init_all(struct dnet_node *n);
 void dnet_backend_cleanup_all(struct dnet_node *n);
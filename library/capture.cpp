@@ -0,0 +1,156 @@
+#include "elliptics.h"
+#include "../example/config.hpp"
+
+#include <string.h>
+
+/* records are buffered by stdio, so capture costs one copy per sampled request */
+#define DNET_CAPTURE_BUFFER_SIZE	(1024 * 1024)
+
+std::unique_ptr<dnet_capture_config> dnet_capture_config::parse(const ioremap::elliptics::config::config &cfg)
+{
+	std::unique_ptr<dnet_capture_config> result(new dnet_capture_config);
+
+	result->path = cfg.at<std::string>("path");
+	result->sample_rate = cfg.at<uint32_t>("sample_rate", 1);
+	result->max_size = cfg.at<uint64_t>("max_size", 0);
+
+	if (!result->sample_rate) {
+		throw ioremap::elliptics::config::config_error() << cfg.at("sample_rate").path()
+			<< " must be positive";
+	}
+
+	return result;
+}
+
+static uint64_t dnet_capture_now()
+{
+	struct dnet_time t;
+	dnet_current_time(&t);
+	return t.tsec * 1000000 + t.tnsec / 1000;
+}
+
+dnet_capture::dnet_capture(const dnet_capture_config &config) :
+	m_sample_rate(config.sample_rate),
+	m_max_size(config.max_size),
+	m_counter(0),
+	m_file(NULL),
+	m_size(0),
+	m_full(false)
+{
+	m_file = fopen(config.path.c_str(), "ab");
+	if (!m_file)
+		throw std::runtime_error("failed to open " + config.path + ": " + strerror(errno));
+
+	setvbuf(m_file, NULL, _IOFBF, DNET_CAPTURE_BUFFER_SIZE);
+
+	dnet_capture_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DNET_CAPTURE_MAGIC, sizeof(DNET_CAPTURE_MAGIC));
+	header.version = DNET_CAPTURE_VERSION;
+	header.record_size = sizeof(dnet_capture_record);
+	header.sample_rate = m_sample_rate;
+	header.start = dnet_capture_now();
+
+	if (fwrite(&header, sizeof(header), 1, m_file) != 1) {
+		fclose(m_file);
+		throw std::runtime_error("failed to write header to " + config.path + ": " + strerror(errno));
+	}
+	m_size = sizeof(header);
+}
+
+dnet_capture::~dnet_capture()
+{
+	fclose(m_file);
+}
+
+bool dnet_capture::sampled()
+{
+	return m_counter.fetch_add(1, std::memory_order_relaxed) % m_sample_rate == 0;
+}
+
+bool dnet_capture::write(const dnet_capture_record &record)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_full)
+		return true;
+
+	if (m_max_size && m_size + sizeof(record) > m_max_size) {
+		m_full = true;
+		fflush(m_file);
+		return false;
+	}
+
+	if (fwrite(&record, sizeof(record), 1, m_file) == 1)
+		m_size += sizeof(record);
+
+	return true;
+}
+
+int dnet_capture_init(struct dnet_node *n)
+{
+	const auto &data = *static_cast<const ioremap::elliptics::config::config_data *>(n->config_data);
+	if (!data.capture_config)
+		return 0;
+
+	try {
+		n->capture = new dnet_capture(*data.capture_config);
+	} catch (const std::exception &e) {
+		dnet_log(n, DNET_LOG_ERROR, "capture: failed to start traffic capture: %s", e.what());
+		return -EINVAL;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "capture: recording every %u request to %s, max size: %" PRIu64,
+			data.capture_config->sample_rate, data.capture_config->path.c_str(),
+			data.capture_config->max_size);
+	return 0;
+}
+
+void dnet_capture_cleanup(struct dnet_node *n)
+{
+	if (n->capture) {
+		dnet_log(n, DNET_LOG_INFO, "capture: stopped, %" PRIu64 " bytes written", n->capture->written());
+		delete n->capture;
+		n->capture = NULL;
+	}
+}
+
+void dnet_capture_request(struct dnet_node *n, struct dnet_cmd *cmd, const void *data)
+{
+	if (!n->capture->sampled())
+		return;
+
+	dnet_capture_record record;
+	memset(&record, 0, sizeof(record));
+
+	record.timestamp = dnet_capture_now();
+	record.size = cmd->size;
+	record.cflags = cmd->flags;
+	record.cmd = cmd->cmd;
+	record.group_id = cmd->id.group_id;
+	memcpy(record.id, cmd->id.id, DNET_CAPTURE_ID_SIZE);
+
+	switch (cmd->cmd) {
+	case DNET_CMD_READ:
+	case DNET_CMD_WRITE:
+	case DNET_CMD_DEL:
+		if (cmd->size >= sizeof(struct dnet_io_attr)) {
+			struct dnet_io_attr io;
+			memcpy(&io, data, sizeof(io));
+			dnet_convert_io_attr(&io);
+
+			record.size = io.size;
+			record.offset = io.offset;
+			record.ioflags = io.flags;
+		}
+		break;
+	default:
+		break;
+	}
+
+	try {
+		if (!n->capture->write(record))
+			dnet_log(n, DNET_LOG_NOTICE, "capture: file has reached its maximum size, capture is stopped");
+	} catch (...) {
+	}
+}
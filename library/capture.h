@@ -0,0 +1,123 @@
+#ifndef IOREMAP_ELLIPTICS_CAPTURE_H
+#define IOREMAP_ELLIPTICS_CAPTURE_H
+
+#include <elliptics/packet.h>
+#include <elliptics/interface.h>
+
+/*
+ * Capture file starts with dnet_capture_header followed by dnet_capture_records,
+ * all numbers are in host byte order of the server which has written the file.
+ */
+#define DNET_CAPTURE_MAGIC	"DNETCAP"
+#define DNET_CAPTURE_VERSION	1
+
+/* number of leading bytes of the key kept in the record, enough to reproduce its routing and popularity */
+#define DNET_CAPTURE_ID_SIZE	16
+
+struct dnet_capture_header
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	record_size;
+	/* every sample_rate'th request has been recorded */
+	uint32_t	sample_rate;
+	uint32_t	reserved;
+	/* usecs since the epoch when capture has been started */
+	uint64_t	start;
+} __attribute__ ((packed));
+
+struct dnet_capture_record
+{
+	/* usecs since the epoch when request has been received */
+	uint64_t	timestamp;
+	/* io size and offset of read, write and remove commands, payload size and zero for others */
+	uint64_t	size;
+	uint64_t	offset;
+	uint64_t	cflags;
+	uint32_t	ioflags;
+	uint32_t	cmd;
+	uint32_t	group_id;
+	uint32_t	reserved;
+	uint8_t		id[DNET_CAPTURE_ID_SIZE];
+} __attribute__ ((packed));
+
+#ifdef __cplusplus
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ioremap { namespace elliptics { namespace config {
+class config;
+}}}
+
+/*
+ * Node options of traffic capture, "capture" section of the config
+ */
+struct dnet_capture_config
+{
+	std::string	path;
+	/* every sample_rate'th client request is recorded */
+	uint32_t	sample_rate;
+	/* capture stops once the file reaches this size, 0 - unlimited */
+	uint64_t	max_size;
+
+	static std::unique_ptr<dnet_capture_config> parse(const ioremap::elliptics::config::config &cfg);
+};
+
+/*
+ * Writer of sampled client requests, file is opened in append mode
+ * and every node start adds its own header.
+ */
+class dnet_capture
+{
+public:
+	dnet_capture(const dnet_capture_config &config);
+	~dnet_capture();
+
+	dnet_capture(const dnet_capture &) = delete;
+	dnet_capture &operator =(const dnet_capture &) = delete;
+
+	/* Returns true if the next request should be recorded */
+	bool sampled();
+
+	/* Returns false once the file has reached its maximum size */
+	bool write(const dnet_capture_record &record);
+
+	uint64_t written() const { return m_size; }
+
+private:
+	const uint32_t		m_sample_rate;
+	const uint64_t		m_max_size;
+	std::atomic<uint64_t>	m_counter;
+
+	std::mutex		m_lock;
+	FILE			*m_file;
+	uint64_t		m_size;
+	bool			m_full;
+};
+
+extern "C" {
+#else // __cplusplus
+typedef struct dnet_capture_t dnet_capture;
+#endif // __cplusplus
+
+/*
+ * Opens capture file of the node if capture is configured
+ */
+int dnet_capture_init(struct dnet_node *n);
+/*
+ * Must be called after io threads are stopped
+ */
+void dnet_capture_cleanup(struct dnet_node *n);
+
+/*
+ * Records client request @cmd if it is sampled, @data is request's payload in wire byte order
+ */
+void dnet_capture_request(struct dnet_node *n, struct dnet_cmd *cmd, const void *data);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // IOREMAP_ELLIPTICS_CAPTURE_H
@@ -0,0 +1,343 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "elliptics.h"
+
+/*
+ * Change log consists of two files: @changes is appended, when it grows larger than @max_size
+ * it replaces @changes.old. Every file starts with DNET_CHANGE_LOG_START record whose @change_time
+ * is the time since which the file (with previous one if it still exists) contains all changes.
+ * Change times strictly increase, so records with the time above any cursor are found by binary search.
+ */
+#define DNET_CHANGE_LOG_START		(1ULL<<63)
+
+struct dnet_change_log {
+	pthread_mutex_t			lock;
+	char				path[PATH_MAX];
+	char				old_path[PATH_MAX];
+	int				fd;
+	uint64_t			size;
+	uint64_t			max_size;
+	uint64_t			last_time;
+};
+
+static uint64_t dnet_change_log_now(struct dnet_change_log *log)
+{
+	struct timeval tv;
+	uint64_t now;
+
+	gettimeofday(&tv, NULL);
+	now = tv.tv_sec * 1000000ULL + tv.tv_usec;
+
+	if (now <= log->last_time)
+		now = log->last_time + 1;
+
+	log->last_time = now;
+	return now;
+}
+
+static int dnet_change_log_write(int fd, const struct dnet_change_log_record *rec)
+{
+	ssize_t err;
+
+	err = write(fd, rec, sizeof(struct dnet_change_log_record));
+	if (err < 0)
+		return -errno;
+	if (err != sizeof(struct dnet_change_log_record))
+		return -EIO;
+
+	return 0;
+}
+
+static int dnet_change_log_read_record(int fd, uint64_t idx, struct dnet_change_log_record *rec)
+{
+	return dnet_read_ll(fd, (char *)rec, sizeof(struct dnet_change_log_record),
+			idx * sizeof(struct dnet_change_log_record));
+}
+
+/* creates new file which contains all changes since now */
+static int dnet_change_log_create_nolock(struct dnet_change_log *log)
+{
+	struct dnet_change_log_record start;
+	int err;
+
+	log->fd = open(log->path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (log->fd < 0)
+		return -errno;
+
+	memset(&start, 0, sizeof(struct dnet_change_log_record));
+	start.flags = DNET_CHANGE_LOG_START;
+	start.change_time = dnet_change_log_now(log);
+
+	err = dnet_change_log_write(log->fd, &start);
+	if (err) {
+		close(log->fd);
+		log->fd = -1;
+		return err;
+	}
+
+	log->size = sizeof(struct dnet_change_log_record);
+	return 0;
+}
+
+int dnet_change_log_open(const char *dir, uint64_t max_size, struct dnet_change_log **ret)
+{
+	struct dnet_change_log_record rec;
+	struct dnet_change_log *log;
+	struct stat st;
+	int err;
+
+	log = calloc(1, sizeof(struct dnet_change_log));
+	if (!log)
+		return -ENOMEM;
+
+	snprintf(log->path, sizeof(log->path), "%s/changes", dir);
+	snprintf(log->old_path, sizeof(log->old_path), "%s/changes.old", dir);
+	log->max_size = max_size;
+	log->fd = -1;
+
+	err = pthread_mutex_init(&log->lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_free;
+	}
+
+	log->fd = open(log->path, O_RDWR | O_APPEND | O_CLOEXEC);
+	if (log->fd < 0) {
+		err = -errno;
+		if (err != -ENOENT)
+			goto err_out_destroy;
+
+		/* there is no log yet, older changes are unknown */
+		unlink(log->old_path);
+
+		err = dnet_change_log_create_nolock(log);
+		if (err)
+			goto err_out_destroy;
+	} else {
+		err = fstat(log->fd, &st);
+		if (err) {
+			err = -errno;
+			goto err_out_close;
+		}
+
+		/* the last record could be written partially when node was killed */
+		log->size = st.st_size - st.st_size % sizeof(struct dnet_change_log_record);
+		if (log->size != (uint64_t)st.st_size && ftruncate(log->fd, log->size)) {
+			err = -errno;
+			goto err_out_close;
+		}
+
+		if (!log->size) {
+			err = -EINVAL;
+			goto err_out_close;
+		}
+
+		err = dnet_change_log_read_record(log->fd, log->size / sizeof(struct dnet_change_log_record) - 1, &rec);
+		if (err)
+			goto err_out_close;
+
+		log->last_time = rec.change_time;
+	}
+
+	*ret = log;
+	return 0;
+
+err_out_close:
+	close(log->fd);
+err_out_destroy:
+	pthread_mutex_destroy(&log->lock);
+err_out_free:
+	free(log);
+	return err;
+}
+
+void dnet_change_log_close(struct dnet_change_log *log)
+{
+	if (!log)
+		return;
+
+	if (log->fd >= 0)
+		close(log->fd);
+	pthread_mutex_destroy(&log->lock);
+	free(log);
+}
+
+int dnet_change_log_append(struct dnet_change_log *log, const struct dnet_raw_id *key, const struct dnet_time *timestamp,
+		uint64_t size, uint64_t flags)
+{
+	struct dnet_change_log_record rec;
+	int err;
+
+	memset(&rec, 0, sizeof(struct dnet_change_log_record));
+	rec.key = *key;
+	rec.timestamp = *timestamp;
+	rec.size = size;
+	rec.flags = flags;
+
+	pthread_mutex_lock(&log->lock);
+
+	if (log->size + sizeof(struct dnet_change_log_record) > log->max_size) {
+		if (log->fd >= 0)
+			close(log->fd);
+
+		err = rename(log->path, log->old_path);
+		if (err) {
+			err = -errno;
+			log->fd = -1;
+			goto err_out_unlock;
+		}
+
+		err = dnet_change_log_create_nolock(log);
+		if (err)
+			goto err_out_unlock;
+	}
+
+	if (log->fd < 0) {
+		err = -EBADF;
+		goto err_out_unlock;
+	}
+
+	rec.change_time = dnet_change_log_now(log);
+
+	err = dnet_change_log_write(log->fd, &rec);
+	if (!err)
+		log->size += sizeof(struct dnet_change_log_record);
+
+err_out_unlock:
+	pthread_mutex_unlock(&log->lock);
+	return err;
+}
+
+/* returns index of the first record in @fd with change time above @since, @num - number of records */
+static int dnet_change_log_find(int fd, uint64_t num, uint64_t since, uint64_t *idx)
+{
+	struct dnet_change_log_record rec;
+	uint64_t low = 1, high = num;
+	int err;
+
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+
+		err = dnet_change_log_read_record(fd, mid, &rec);
+		if (err)
+			return err;
+
+		if (rec.change_time > since)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	*idx = low;
+	return 0;
+}
+
+static uint64_t dnet_change_log_records(int fd)
+{
+	struct stat st;
+
+	if (fd < 0 || fstat(fd, &st))
+		return 0;
+
+	return st.st_size / sizeof(struct dnet_change_log_record);
+}
+
+int dnet_change_log_iterate(struct dnet_change_log *log, uint64_t since,
+		int (*callback)(void *priv, const struct dnet_change_log_record *rec, uint64_t pos, uint64_t total),
+		void *priv)
+{
+	struct dnet_change_log_record rec;
+	int fds[2] = {-1, -1};
+	uint64_t num[2] = {0, 0}, start[2] = {0, 0};
+	uint64_t total = 0, pos = 0, i;
+	int err, f;
+
+	/* opened files stay consistent even if log is rotated during iteration */
+	pthread_mutex_lock(&log->lock);
+	fds[0] = open(log->old_path, O_RDONLY | O_CLOEXEC);
+	fds[1] = open(log->path, O_RDONLY | O_CLOEXEC);
+	pthread_mutex_unlock(&log->lock);
+
+	if (fds[1] < 0) {
+		err = -errno;
+		goto err_out_close;
+	}
+
+	for (f = 0; f < 2; ++f)
+		num[f] = dnet_change_log_records(fds[f]);
+
+	/* changes older than the first file's start have been dropped, zero @since means all kept changes */
+	f = num[0] ? 0 : 1;
+	err = dnet_change_log_read_record(fds[f], 0, &rec);
+	if (err)
+		goto err_out_close;
+
+	if (!(rec.flags & DNET_CHANGE_LOG_START)) {
+		err = -EINVAL;
+		goto err_out_close;
+	}
+
+	if (since && since < rec.change_time) {
+		err = -ERANGE;
+		goto err_out_close;
+	}
+
+	for (f = 0; f < 2; ++f) {
+		if (!num[f])
+			continue;
+
+		err = dnet_change_log_find(fds[f], num[f], since, &start[f]);
+		if (err)
+			goto err_out_close;
+
+		total += num[f] - start[f];
+	}
+
+	for (f = 0; f < 2; ++f) {
+		for (i = start[f]; i < num[f]; ++i) {
+			err = dnet_change_log_read_record(fds[f], i, &rec);
+			if (err)
+				goto err_out_close;
+
+			if (rec.flags & DNET_CHANGE_LOG_START)
+				continue;
+
+			err = callback(priv, &rec, ++pos, total);
+			if (err)
+				goto err_out_close;
+		}
+	}
+
+err_out_close:
+	for (f = 0; f < 2; ++f) {
+		if (fds[f] >= 0)
+			close(fds[f]);
+	}
+	return err;
+}
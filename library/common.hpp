@@ -1,30 +1,39 @@
 #ifndef IOREMAP_ELLIPTICS_COMMON_HPP
 #define IOREMAP_ELLIPTICS_COMMON_HPP
 
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "lock.h"
+#include "elliptics/interface.h"
+
 class dnet_pthread_mutex
 {
 public:
-	dnet_pthread_mutex(pthread_mutex_t &mutex) : m_mutex(mutex)
+	dnet_pthread_mutex(pthread_mutex_t &mutex, struct dnet_lock_site *site = NULL) : m_mutex(mutex), m_site(site)
 	{
 	}
 
 	void lock()
 	{
-		pthread_mutex_lock(&m_mutex);
+		dnet_mutex_lock_site(&m_mutex, m_site);
 	}
 
 	void unlock()
 	{
-		pthread_mutex_unlock(&m_mutex);
+		dnet_mutex_unlock_site(&m_mutex);
 	}
 private:
 	pthread_mutex_t &m_mutex;
+	struct dnet_lock_site *m_site;
 };
 
 class dnet_pthread_lock_guard
 {
 public:
-	dnet_pthread_lock_guard(pthread_mutex_t &mutex) : m_mutex(mutex), m_lock_guard(m_mutex)
+	dnet_pthread_lock_guard(pthread_mutex_t &mutex, struct dnet_lock_site *site = NULL)
+	: m_mutex(mutex, site), m_lock_guard(m_mutex)
 	{
 	}
 
@@ -41,6 +50,23 @@ struct free_destroyer
 	}
 };
 
+/*
+ * Moves @data (any container with data() and size()) into send queue of @state
+ * without copying the payload, container is destroyed once reply has been sent or dropped
+ */
+template <typename Container>
+inline static int dnet_send_reply_move(void *state, struct dnet_cmd *cmd, Container &&data, int more)
+{
+	typedef typename std::decay<Container>::type container_type;
+
+	container_type *holder = new (std::nothrow) container_type(std::move(data));
+	if (!holder)
+		return -ENOMEM;
+
+	return dnet_send_reply_ref(state, cmd, holder->data(), holder->size(),
+		[] (void *priv) { delete static_cast<container_type *>(priv); }, holder, more);
+}
+
 template <typename Class, typename Method, typename... Args>
 inline static int safe_call(Class *obj, Method method, Args &&...args)
 {
@@ -17,6 +17,8 @@
  * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
@@ -174,6 +176,85 @@ int dnet_sendfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t
 }
 #endif
 
+/*
+ * Moves no more than @size bytes received by @st into @fd at *@offset, which is advanced.
+ * Returns number of moved bytes, -EAGAIN if socket has nothing to read.
+ */
+#ifdef HAVE_SENDFILE4_SUPPORT
+int dnet_recvfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t size)
+{
+	loff_t off = *offset;
+	ssize_t err, sz;
+
+	if (st->stream_pipe[0] < 0) {
+		err = pipe2(st->stream_pipe, O_CLOEXEC);
+		if (err < 0) {
+			st->stream_pipe[0] = st->stream_pipe[1] = -1;
+			return -errno;
+		}
+	}
+
+	/* pipe holds 64k by default, larger splice just returns less */
+	err = splice(st->read_s, NULL, st->stream_pipe[1], NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (err < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return -EAGAIN;
+		return -errno;
+	}
+	if (err == 0)
+		return -ECONNRESET;
+
+	sz = err;
+	while (sz) {
+		err = splice(st->stream_pipe[0], NULL, fd, &off, sz, SPLICE_F_MOVE);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		sz -= err;
+	}
+
+	err = off - *offset;
+	*offset = off;
+	return err;
+}
+#else
+int dnet_recvfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t size)
+{
+	char buf[4096];
+	ssize_t err, total, written = 0;
+
+	if (size > sizeof(buf))
+		size = sizeof(buf);
+
+	err = recv(st->read_s, buf, size, 0);
+	if (err < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return -EAGAIN;
+		return -errno;
+	}
+	if (err == 0)
+		return -ECONNRESET;
+
+	total = err;
+	while (written < total) {
+		err = pwrite(fd, buf + written, total - written, *offset);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		*offset += err;
+		written += err;
+	}
+
+	return total;
+}
+#endif
+
 #ifdef HAVE_IOPRIO_SUPPORT
 
 enum {
@@ -216,3 +297,106 @@ int dnet_ioprio_set(long pid __attribute__ ((unused)), int class __attribute__ (
 int dnet_ioprio_get(long pid __attribute__ ((unused))) { return 0; }
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+/*
+ * Fills @cpus with CPUs of @numa_node, sysfs lists them as "0-5,12-17"
+ */
+static int dnet_numa_node_cpus(int numa_node, cpu_set_t *cpus)
+{
+	char path[128];
+	FILE *f;
+	int first, last, sep, err = 0;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numa_node);
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	CPU_ZERO(cpus);
+
+	while (fscanf(f, "%d", &first) == 1) {
+		last = first;
+
+		sep = fgetc(f);
+		if (sep == '-') {
+			if (fscanf(f, "%d", &last) != 1) {
+				err = -EINVAL;
+				break;
+			}
+			sep = fgetc(f);
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; ++first)
+			CPU_SET(first, cpus);
+
+		if (sep != ',')
+			break;
+	}
+
+	fclose(f);
+
+	if (!err && !CPU_COUNT(cpus))
+		err = -ENOENT;
+
+	return err;
+}
+
+int dnet_numa_bind_thread(int numa_node)
+{
+	cpu_set_t cpus;
+	unsigned long nodemask;
+	int err;
+
+	if (numa_node < 0 || numa_node >= (int)(sizeof(nodemask) * 8))
+		return -EINVAL;
+
+	err = dnet_numa_node_cpus(numa_node, &cpus);
+	if (err)
+		return err;
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus))
+		return -errno;
+
+	/* memory first touched by this thread is taken from its node while the node has free pages */
+	nodemask = 1UL << numa_node;
+	if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8 + 1))
+		return -errno;
+
+	return 0;
+}
+
+int dnet_numa_current_node(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL))
+		return -errno;
+
+	return node;
+}
+
+int dnet_cpu_bind_thread(int cpu)
+{
+	cpu_set_t cpus;
+
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return -EINVAL;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus))
+		return -errno;
+
+	return 0;
+}
+#else
+int dnet_numa_bind_thread(int numa_node __attribute__ ((unused))) { return -ENOTSUP; }
+int dnet_numa_current_node(void) { return -ENOTSUP; }
+int dnet_cpu_bind_thread(int cpu __attribute__ ((unused))) { return -ENOTSUP; }
+#endif
@@ -66,6 +66,47 @@ static int dnet_local_digest_transform(void *priv __unused, struct dnet_session
 	return 0;
 }
 
+static int dnet_local_digest_transform_multi(void *priv, struct dnet_session *s,
+		const void *const *src, const uint64_t *size, size_t num,
+		void *dst, unsigned int dsize)
+{
+	/* hash keys in batches, so that digests fit on stack */
+	unsigned char hash[16][SHA512_DIGEST_SIZE];
+	char prefix[256];
+	size_t prefix_len = 0;
+	size_t i, j, batch;
+
+	if (s && s->ns && s->nsize) {
+		if ((size_t)s->nsize + 1 > sizeof(prefix)) {
+			for (i = 0; i < num; ++i) {
+				unsigned int rs = dsize;
+				dnet_local_digest_transform(priv, s, src[i], size[i], (char *)dst + i * dsize, &rs, 0);
+			}
+			return 0;
+		}
+
+		/* namespace is separated from the key by zero byte, see dnet_local_digest_transform() */
+		memcpy(prefix, s->ns, s->nsize);
+		prefix[s->nsize] = '\0';
+		prefix_len = s->nsize + 1;
+	}
+
+	for (i = 0; i < num; i += batch) {
+		batch = num - i;
+		if (batch > ARRAY_SIZE(hash))
+			batch = ARRAY_SIZE(hash);
+
+		sha512_buffers(prefix, prefix_len, src + i, size + i, batch, hash);
+
+		for (j = 0; j < batch; ++j) {
+			unsigned int rs = dsize;
+			dnet_transform_final((char *)dst + (i + j) * dsize, hash[j], &rs, dsize);
+		}
+	}
+
+	return 0;
+}
+
 static int dnet_local_digest_transform_file(void *priv __unused, struct dnet_session *s,
 		int fd, uint64_t offset, uint64_t size,
 		void *dst, unsigned int *dsize, unsigned int flags __unused)
@@ -115,18 +156,19 @@ int dnet_digest_auth_transform_raw(const void *src, uint64_t size, const void *k
 	/*
 	 * Calculate HMAC-SHA512 according to http://tools.ietf.org/html/rfc2104
 	 */
-	char hashed_message[DNET_ID_SIZE];
+	/* digests are always full sha512 ones, only result is cut to @csum_size */
+	char hashed_message[SHA512_DIGEST_SIZE];
 	char hashed_key[SHA512_BLOCK_SIZE];
 	char ikeypad[SHA512_BLOCK_SIZE];
 	char okeypad[SHA512_BLOCK_SIZE];
-	char result[DNET_ID_SIZE];
+	char result[SHA512_DIGEST_SIZE];
 	size_t i;
 	unsigned int rs = csum_size;
 	struct sha512_ctx ctx;
 
 	if (key_size > SHA512_BLOCK_SIZE) {
 		dnet_digest_transform_raw(key, key_size, hashed_key, SHA512_BLOCK_SIZE);
-		key_size = DNET_ID_SIZE;
+		key_size = SHA512_DIGEST_SIZE;
 	} else {
 		memcpy(hashed_key, key, key_size);
 	}
@@ -146,7 +188,7 @@ int dnet_digest_auth_transform_raw(const void *src, uint64_t size, const void *k
 
 	sha512_init_ctx(&ctx);
 	sha512_process_bytes(okeypad, SHA512_BLOCK_SIZE, &ctx);
-	sha512_process_bytes(hashed_message, DNET_ID_SIZE, &ctx);
+	sha512_process_bytes(hashed_message, SHA512_DIGEST_SIZE, &ctx);
 	sha512_finish_ctx(&ctx, result);
 
 	/*
@@ -166,6 +208,7 @@ int dnet_crypto_init(struct dnet_node *n)
 
 	t->transform = dnet_local_digest_transform;
 	t->transform_file = dnet_local_digest_transform_file;
+	t->transform_multi = dnet_local_digest_transform_multi;
 	t->priv = NULL;
 
 	return 0;
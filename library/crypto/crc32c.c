@@ -0,0 +1,185 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+/*
+ * CRC32C is used as a cheap data integrity checksum, it is an order of magnitude
+ * faster than SHA512 and SSE4.2 computes it in hardware.
+ *
+ * SSE4.2 code is compiled with target attribute and selected at runtime,
+ * other CPUs use slicing-by-8 tables.
+ */
+
+#include "crc32c.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CRC32C_SSE42 1
+# include <nmmintrin.h>
+#endif
+
+#define CRC32C_POLY		0x82f63b78
+#define CRC32C_FILE_BLOCK_SIZE	(128 * 1024)
+
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init_table(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; ++i) {
+		crc = i;
+		for (j = 0; j < 8; ++j)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc32c_table[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; ++i) {
+		crc = crc32c_table[0][i];
+		for (j = 1; j < 8; ++j) {
+			crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+			crc32c_table[j][i] = crc;
+		}
+	}
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t word;
+
+	pthread_once(&crc32c_table_once, crc32c_init_table);
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		--len;
+	}
+
+	while (len >= 8) {
+		memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		word = __builtin_bswap64(word);
+#endif
+		word ^= crc;
+
+		crc = crc32c_table[7][word & 0xff] ^
+			crc32c_table[6][(word >> 8) & 0xff] ^
+			crc32c_table[5][(word >> 16) & 0xff] ^
+			crc32c_table[4][(word >> 24) & 0xff] ^
+			crc32c_table[3][(word >> 32) & 0xff] ^
+			crc32c_table[2][(word >> 40) & 0xff] ^
+			crc32c_table[1][(word >> 48) & 0xff] ^
+			crc32c_table[0][word >> 56];
+
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#ifdef CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t crc64 = crc;
+	uint64_t word;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc64 = _mm_crc32_u8((uint32_t)crc64, *p++);
+		--len;
+	}
+
+	while (len >= 8) {
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc64 = _mm_crc32_u8((uint32_t)crc64, *p++);
+
+	return (uint32_t)crc64;
+}
+
+static int crc32c_has_sse42(void)
+{
+	static int supported = -1;
+
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+	}
+
+	return supported;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buffer, size_t len)
+{
+	crc = ~crc;
+
+#ifdef CRC32C_SSE42
+	if (crc32c_has_sse42())
+		return ~crc32c_hw(crc, buffer, len);
+#endif
+
+	return ~crc32c_sw(crc, buffer, len);
+}
+
+int crc32c_file(int fd, off_t offset, size_t count, uint32_t *crc)
+{
+	size_t total = 0;
+	ssize_t n;
+	char *buffer;
+
+	buffer = malloc(CRC32C_FILE_BLOCK_SIZE);
+	if (!buffer)
+		return -ENOMEM;
+
+	*crc = 0;
+
+	while (total < count) {
+		size_t size = count - total;
+		if (size > CRC32C_FILE_BLOCK_SIZE)
+			size = CRC32C_FILE_BLOCK_SIZE;
+
+		n = pread(fd, buffer, size, offset + total);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+
+			free(buffer);
+			return -errno;
+		}
+
+		if (n == 0) {
+			free(buffer);
+			return -ESPIPE;
+		}
+
+		*crc = crc32c(*crc, buffer, n);
+		total += n;
+	}
+
+	free(buffer);
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CRC32C (Castagnoli polynomial, the one used by iSCSI and ext4).
+ * @crc is the result of the previous call or 0 for the first chunk.
+ */
+uint32_t crc32c(uint32_t crc, const void *buffer, size_t len);
+
+/*
+ * Computes CRC32C of @count bytes of @fd starting from @offset,
+ * returns negative error code if file is shorter.
+ */
+int crc32c_file(int fd, off_t offset, size_t count, uint32_t *crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC32C_H */
@@ -93,6 +93,14 @@ extern int sha512_file_ctx (int fd, off_t offset, size_t count, struct sha512_ct
    digest.  */
 extern void *sha512_buffer (const char *buffer, size_t len, void *resblock);
 
+/* Compute SHA512 message digests of NUM buffers each prefixed by PREFIX_LEN
+   bytes of PREFIX.  Digest of I-th buffer is written into 64 bytes at
+   RESBLOCKS + 64 * I.  Short buffers are hashed several at once with SIMD
+   instructions when CPU supports them (see sha512_mb.c).  */
+extern void sha512_buffers (const void *prefix, size_t prefix_len,
+                            const void *const *buffers, const uint64_t *lens,
+                            size_t num, void *resblocks);
+
 # ifdef __cplusplus
 }
 # endif
@@ -0,0 +1,269 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+/*
+ * Multi-buffer SHA512: several independent short messages are hashed at once,
+ * every 64-bit lane of AVX2 registers holds state of its own message.
+ * It is used for transforms of many keys (bulk operations, index ids),
+ * single long buffers are still hashed by sha512_process_block().
+ *
+ * AVX2 code is compiled with target attribute and selected at runtime,
+ * so the library still runs on CPUs without AVX2.
+ */
+
+#include "sha512.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define SHA512_MB_AVX2 1
+# include <immintrin.h>
+#endif
+
+/* Number of messages hashed at once */
+#define SHA512_MB_LANES		4
+/* Messages which do not fit into this number of blocks after padding are hashed one by one */
+#define SHA512_MB_MAX_BLOCKS	4
+#define SHA512_MB_BLOCK_SIZE	128
+
+static void sha512_single(const void *prefix, size_t prefix_len, const void *buffer, uint64_t len, void *resblock)
+{
+	struct sha512_ctx ctx;
+
+	sha512_init_ctx(&ctx);
+	if (prefix_len)
+		sha512_process_bytes(prefix, prefix_len, &ctx);
+	sha512_process_bytes(buffer, len, &ctx);
+	sha512_finish_ctx(&ctx, resblock);
+}
+
+#ifdef SHA512_MB_AVX2
+
+static const uint64_t sha512_mb_init[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+static const uint64_t sha512_mb_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static int sha512_mb_avx2_supported(void)
+{
+	static int supported = -1;
+
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+
+	return supported;
+}
+
+/*
+ * Puts message with prefix and SHA512 padding into @dst, returns number of blocks
+ */
+static size_t sha512_mb_pad(unsigned char *dst, const void *prefix, size_t prefix_len, const void *buffer, uint64_t len)
+{
+	const size_t total = prefix_len + len;
+	const size_t blocks = (total + 1 + 16 + SHA512_MB_BLOCK_SIZE - 1) / SHA512_MB_BLOCK_SIZE;
+	const uint64_t bits = (uint64_t)total << 3;
+	unsigned char *end = dst + blocks * SHA512_MB_BLOCK_SIZE;
+	int i;
+
+	memcpy(dst, prefix, prefix_len);
+	memcpy(dst + prefix_len, buffer, len);
+	dst[total] = 0x80;
+	memset(dst + total + 1, 0, end - 8 - (dst + total + 1));
+
+	for (i = 0; i < 8; ++i)
+		end[-1 - i] = bits >> (8 * i);
+
+	return blocks;
+}
+
+#define MB_ROR(x, n)	_mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+#define MB_ADD(x, y)	_mm256_add_epi64((x), (y))
+#define MB_XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+
+#define MB_S0(x)	MB_XOR3(MB_ROR(x, 1), MB_ROR(x, 8), _mm256_srli_epi64(x, 7))
+#define MB_S1(x)	MB_XOR3(MB_ROR(x, 19), MB_ROR(x, 61), _mm256_srli_epi64(x, 6))
+#define MB_SS0(x)	MB_XOR3(MB_ROR(x, 28), MB_ROR(x, 34), MB_ROR(x, 39))
+#define MB_SS1(x)	MB_XOR3(MB_ROR(x, 14), MB_ROR(x, 18), MB_ROR(x, 41))
+#define MB_CH(e, f, g)	_mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g))
+#define MB_MAJ(a, b, c)	_mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)))
+
+static inline uint64_t sha512_mb_load_be64(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return __builtin_bswap64(v);
+}
+
+/*
+ * Hashes SHA512_MB_LANES padded messages, message of lane i has @blocks[i] blocks,
+ * lanes with 0 blocks are ignored. Digests are written in big endian byte order into @res.
+ */
+__attribute__((target("avx2")))
+static void sha512_mb_avx2(const unsigned char *const *msgs, const size_t *blocks, unsigned char *const *res)
+{
+	__m256i s[8], w[16];
+	size_t max_blocks = 0, blk;
+	int i, t, lane;
+
+	for (lane = 0; lane < SHA512_MB_LANES; ++lane) {
+		if (blocks[lane] > max_blocks)
+			max_blocks = blocks[lane];
+	}
+
+	for (i = 0; i < 8; ++i)
+		s[i] = _mm256_set1_epi64x(sha512_mb_init[i]);
+
+	for (blk = 0; blk < max_blocks; ++blk) {
+		const size_t offset = blk * SHA512_MB_BLOCK_SIZE;
+		__m256i a = s[0], b = s[1], c = s[2], d = s[3];
+		__m256i e = s[4], f = s[5], g = s[6], h = s[7];
+		/* lanes whose message has already ended keep their state */
+		const __m256i mask = _mm256_set_epi64x(
+				blk < blocks[3] ? -1LL : 0, blk < blocks[2] ? -1LL : 0,
+				blk < blocks[1] ? -1LL : 0, blk < blocks[0] ? -1LL : 0);
+
+		for (t = 0; t < 16; ++t) {
+			w[t] = _mm256_set_epi64x(
+				sha512_mb_load_be64(msgs[3] + offset + t * 8),
+				sha512_mb_load_be64(msgs[2] + offset + t * 8),
+				sha512_mb_load_be64(msgs[1] + offset + t * 8),
+				sha512_mb_load_be64(msgs[0] + offset + t * 8));
+		}
+
+		for (t = 0; t < 80; ++t) {
+			__m256i t1, t2;
+
+			if (t >= 16) {
+				w[t & 15] = MB_ADD(MB_ADD(w[t & 15], MB_S1(w[(t - 2) & 15])),
+						MB_ADD(w[(t - 7) & 15], MB_S0(w[(t - 15) & 15])));
+			}
+
+			t1 = MB_ADD(MB_ADD(h, MB_SS1(e)), MB_ADD(MB_CH(e, f, g),
+					MB_ADD(_mm256_set1_epi64x(sha512_mb_k[t]), w[t & 15])));
+			t2 = MB_ADD(MB_SS0(a), MB_MAJ(a, b, c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = MB_ADD(d, t1);
+			d = c;
+			c = b;
+			b = a;
+			a = MB_ADD(t1, t2);
+		}
+
+		s[0] = _mm256_blendv_epi8(s[0], MB_ADD(s[0], a), mask);
+		s[1] = _mm256_blendv_epi8(s[1], MB_ADD(s[1], b), mask);
+		s[2] = _mm256_blendv_epi8(s[2], MB_ADD(s[2], c), mask);
+		s[3] = _mm256_blendv_epi8(s[3], MB_ADD(s[3], d), mask);
+		s[4] = _mm256_blendv_epi8(s[4], MB_ADD(s[4], e), mask);
+		s[5] = _mm256_blendv_epi8(s[5], MB_ADD(s[5], f), mask);
+		s[6] = _mm256_blendv_epi8(s[6], MB_ADD(s[6], g), mask);
+		s[7] = _mm256_blendv_epi8(s[7], MB_ADD(s[7], h), mask);
+	}
+
+	for (i = 0; i < 8; ++i) {
+		uint64_t words[SHA512_MB_LANES];
+
+		_mm256_storeu_si256((__m256i *)words, s[i]);
+
+		for (lane = 0; lane < SHA512_MB_LANES; ++lane) {
+			uint64_t v;
+
+			if (!blocks[lane])
+				continue;
+
+			v = __builtin_bswap64(words[lane]);
+			memcpy(res[lane] + i * 8, &v, sizeof(v));
+		}
+	}
+}
+
+#endif /* SHA512_MB_AVX2 */
+
+void sha512_buffers(const void *prefix, size_t prefix_len,
+		const void *const *buffers, const uint64_t *lens, size_t num, void *resblocks)
+{
+	unsigned char *res = resblocks;
+	size_t i = 0;
+
+#ifdef SHA512_MB_AVX2
+	if (num > 1 && sha512_mb_avx2_supported()) {
+		unsigned char pad[SHA512_MB_LANES][SHA512_MB_MAX_BLOCKS * SHA512_MB_BLOCK_SIZE];
+		const unsigned char *msgs[SHA512_MB_LANES];
+		unsigned char *lane_res[SHA512_MB_LANES];
+		size_t blocks[SHA512_MB_LANES], idx[SHA512_MB_LANES];
+		int lanes = 0, lane;
+
+		for (i = 0; i < num; ++i) {
+			if (prefix_len + lens[i] + 1 + 16 > sizeof(pad[0])) {
+				sha512_single(prefix, prefix_len, buffers[i], lens[i], res + i * SHA512_DIGEST_SIZE);
+				continue;
+			}
+
+			blocks[lanes] = sha512_mb_pad(pad[lanes], prefix, prefix_len, buffers[i], lens[i]);
+			msgs[lanes] = pad[lanes];
+			idx[lanes] = i;
+			lane_res[lanes] = res + i * SHA512_DIGEST_SIZE;
+
+			if (++lanes == SHA512_MB_LANES) {
+				sha512_mb_avx2(msgs, blocks, lane_res);
+				lanes = 0;
+			}
+		}
+
+		if (lanes == 1) {
+			/* the only message is already padded, but scalar code is faster for it */
+			sha512_single(prefix, prefix_len, buffers[idx[0]], lens[idx[0]], lane_res[0]);
+		} else if (lanes > 1) {
+			for (lane = lanes; lane < SHA512_MB_LANES; ++lane) {
+				blocks[lane] = 0;
+				msgs[lane] = pad[lane];
+				lane_res[lane] = NULL;
+			}
+
+			sha512_mb_avx2(msgs, blocks, lane_res);
+		}
+
+		return;
+	}
+#endif
+
+	for (; i < num; ++i)
+		sha512_single(prefix, prefix_len, buffers[i], lens[i], res + i * SHA512_DIGEST_SIZE);
+}
@@ -0,0 +1,207 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cuckoo.h"
+
+#define DNET_CUCKOO_SLOTS		4
+/* buckets are filled up to this share of slots by @capacity keys */
+#define DNET_CUCKOO_LOAD_PERCENT	90
+#define DNET_CUCKOO_MAX_KICKS		500
+
+struct dnet_cuckoo_bucket {
+	uint16_t		fp[DNET_CUCKOO_SLOTS];
+};
+
+struct dnet_cuckoo_filter {
+	pthread_rwlock_t		lock;
+	uint64_t			mask;
+	uint64_t			keys;
+	uint64_t			random;
+	int				saturated;
+	struct dnet_cuckoo_bucket	*buckets;
+};
+
+int dnet_cuckoo_filter_create(uint64_t capacity, struct dnet_cuckoo_filter **filter)
+{
+	struct dnet_cuckoo_filter *f;
+	uint64_t num = 1, need;
+	int err;
+
+	need = capacity * 100 / DNET_CUCKOO_LOAD_PERCENT / DNET_CUCKOO_SLOTS + 1;
+	while (num < need)
+		num <<= 1;
+
+	f = calloc(1, sizeof(struct dnet_cuckoo_filter));
+	if (!f) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	f->buckets = calloc(num, sizeof(struct dnet_cuckoo_bucket));
+	if (!f->buckets) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	err = -pthread_rwlock_init(&f->lock, NULL);
+	if (err)
+		goto err_out_free_buckets;
+
+	f->mask = num - 1;
+	f->random = 0x9e3779b97f4a7c15ULL;
+
+	*filter = f;
+	return 0;
+
+err_out_free_buckets:
+	free(f->buckets);
+err_out_free:
+	free(f);
+err_out_exit:
+	return err;
+}
+
+void dnet_cuckoo_filter_destroy(struct dnet_cuckoo_filter *f)
+{
+	if (!f)
+		return;
+
+	pthread_rwlock_destroy(&f->lock);
+	free(f->buckets);
+	free(f);
+}
+
+/* fingerprint 0 marks empty slot */
+static void dnet_cuckoo_hash(const struct dnet_cuckoo_filter *f, const unsigned char *key, uint64_t *index, uint16_t *fp)
+{
+	uint64_t h;
+
+	memcpy(&h, key, sizeof(h));
+	memcpy(fp, key + sizeof(h), sizeof(*fp));
+	if (!*fp)
+		*fp = 1;
+
+	*index = h & f->mask;
+}
+
+static inline uint64_t dnet_cuckoo_alt_index(const struct dnet_cuckoo_filter *f, uint64_t index, uint16_t fp)
+{
+	/* depends on fingerprint only, so that either bucket of the pair leads to the other one */
+	return (index ^ (fp * 0xc6a4a7935bd1e995ULL)) & f->mask;
+}
+
+static int dnet_cuckoo_bucket_has(const struct dnet_cuckoo_bucket *b, uint16_t fp)
+{
+	int i;
+
+	for (i = 0; i < DNET_CUCKOO_SLOTS; ++i) {
+		if (b->fp[i] == fp)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int dnet_cuckoo_bucket_put(struct dnet_cuckoo_bucket *b, uint16_t fp)
+{
+	int i;
+
+	for (i = 0; i < DNET_CUCKOO_SLOTS; ++i) {
+		if (!b->fp[i]) {
+			b->fp[i] = fp;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void dnet_cuckoo_filter_add(struct dnet_cuckoo_filter *f, const unsigned char *key)
+{
+	uint64_t i1, i2, index;
+	uint16_t fp, victim;
+	int kick, slot;
+
+	dnet_cuckoo_hash(f, key, &i1, &fp);
+	i2 = dnet_cuckoo_alt_index(f, i1, fp);
+
+	pthread_rwlock_wrlock(&f->lock);
+
+	if (f->saturated)
+		goto err_out_unlock;
+
+	if (dnet_cuckoo_bucket_has(&f->buckets[i1], fp) || dnet_cuckoo_bucket_has(&f->buckets[i2], fp))
+		goto err_out_unlock;
+
+	f->keys++;
+
+	if (dnet_cuckoo_bucket_put(&f->buckets[i1], fp) || dnet_cuckoo_bucket_put(&f->buckets[i2], fp))
+		goto err_out_unlock;
+
+	index = (f->random & 1) ? i1 : i2;
+	for (kick = 0; kick < DNET_CUCKOO_MAX_KICKS; ++kick) {
+		f->random ^= f->random << 13;
+		f->random ^= f->random >> 7;
+		f->random ^= f->random << 17;
+
+		slot = f->random % DNET_CUCKOO_SLOTS;
+		victim = f->buckets[index].fp[slot];
+		f->buckets[index].fp[slot] = fp;
+
+		fp = victim;
+		index = dnet_cuckoo_alt_index(f, index, fp);
+		if (dnet_cuckoo_bucket_put(&f->buckets[index], fp))
+			goto err_out_unlock;
+	}
+
+	/* fingerprint of some key has been lost, filter can not answer "absent" anymore */
+	f->saturated = 1;
+
+err_out_unlock:
+	pthread_rwlock_unlock(&f->lock);
+}
+
+int dnet_cuckoo_filter_contains(struct dnet_cuckoo_filter *f, const unsigned char *key)
+{
+	uint64_t i1, i2;
+	uint16_t fp;
+	int ret;
+
+	dnet_cuckoo_hash(f, key, &i1, &fp);
+	i2 = dnet_cuckoo_alt_index(f, i1, fp);
+
+	pthread_rwlock_rdlock(&f->lock);
+	ret = f->saturated || dnet_cuckoo_bucket_has(&f->buckets[i1], fp) || dnet_cuckoo_bucket_has(&f->buckets[i2], fp);
+	pthread_rwlock_unlock(&f->lock);
+
+	return ret;
+}
+
+uint64_t dnet_cuckoo_filter_keys(struct dnet_cuckoo_filter *f)
+{
+	return f->keys;
+}
+
+int dnet_cuckoo_filter_saturated(struct dnet_cuckoo_filter *f)
+{
+	return f->saturated;
+}
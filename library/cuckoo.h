@@ -0,0 +1,61 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_CUCKOO_H
+#define __DNET_CUCKOO_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cuckoo filter of keys: 16-bit fingerprints in buckets of 4 slots, every key may be in one of two buckets.
+ * Keys are expected to be hashes already (dnet ids are), filter does not hash them once more.
+ *
+ * Keys are never removed, so that filter may only answer "maybe present" for removed ones.
+ * If a key can not be placed after a number of relocations, the filter is saturated and
+ * answers "maybe present" for every key from then on, it never answers "absent" for a key which has been added.
+ * Filter is safe to be used by many threads.
+ */
+struct dnet_cuckoo_filter;
+
+/*
+ * Creates filter sized for @capacity keys, about 2 bytes per key
+ */
+int dnet_cuckoo_filter_create(uint64_t capacity, struct dnet_cuckoo_filter **filter);
+void dnet_cuckoo_filter_destroy(struct dnet_cuckoo_filter *filter);
+
+/* @key must be at least 16 bytes */
+void dnet_cuckoo_filter_add(struct dnet_cuckoo_filter *filter, const unsigned char *key);
+
+/*
+ * Returns 0 if @key has never been added, 1 if it may have been
+ */
+int dnet_cuckoo_filter_contains(struct dnet_cuckoo_filter *filter, const unsigned char *key);
+
+/* number of keys added, and whether filter is saturated */
+uint64_t dnet_cuckoo_filter_keys(struct dnet_cuckoo_filter *filter);
+int dnet_cuckoo_filter_saturated(struct dnet_cuckoo_filter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_CUCKOO_H */
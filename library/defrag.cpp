@@ -0,0 +1,226 @@
+#include "elliptics.h"
+#include "../monitor/statistics.hpp"
+#include "../example/config.hpp"
+
+#include <algorithm>
+#include <map>
+
+std::unique_ptr<dnet_defrag_config> dnet_defrag_config::parse(const ioremap::elliptics::config::config &cfg)
+{
+	std::unique_ptr<dnet_defrag_config> result(new dnet_defrag_config);
+
+	result->interval = cfg.at<unsigned int>("interval", 60);
+	result->fragmentation = cfg.at<double>("fragmentation", 0.3);
+	result->per_disk = cfg.at<unsigned int>("per_disk", 1);
+	result->percentile = cfg.at<double>("percentile", 99) / 100;
+	result->latency_threshold = cfg.at<uint64_t>("latency_threshold_usecs", 0);
+
+	const std::string level = cfg.at<std::string>("level", "compact");
+	if (level == "compact") {
+		result->level = DNET_BACKEND_DEFRAG_COMPACT;
+	} else if (level == "full") {
+		result->level = DNET_BACKEND_DEFRAG_FULL;
+	} else {
+		throw ioremap::elliptics::config::config_error() << cfg.at("level").path()
+			<< " must be either \"compact\" or \"full\"";
+	}
+
+	if (!result->interval || !result->per_disk) {
+		throw ioremap::elliptics::config::config_error() << cfg.path()
+			<< " interval and per_disk must be positive";
+	}
+
+	if (result->percentile <= 0 || result->percentile > 1) {
+		throw ioremap::elliptics::config::config_error() << cfg.at("percentile").path()
+			<< " must be within (0, 100]";
+	}
+
+	return result;
+}
+
+dnet_defrag_scheduler::dnet_defrag_scheduler(dnet_node *node, const dnet_defrag_config &config) :
+	m_node(node), m_config(config), m_backends(node->io->backends_count), m_need_exit(false)
+{
+	m_thread = std::thread(&dnet_defrag_scheduler::run, this);
+}
+
+dnet_defrag_scheduler::~dnet_defrag_scheduler()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_need_exit = true;
+	}
+	m_wait.notify_all();
+	m_thread.join();
+}
+
+void dnet_defrag_scheduler::run()
+{
+	dnet_set_name("dnet_defrag");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_need_exit) {
+		m_wait.wait_for(lock, std::chrono::seconds(m_config.interval));
+		if (m_need_exit)
+			break;
+
+		lock.unlock();
+		try {
+			check();
+		} catch (const std::exception &e) {
+			dnet_log(m_node, DNET_LOG_ERROR, "defrag: scheduler check failed: %s", e.what());
+		}
+		lock.lock();
+	}
+}
+
+/*
+ * Takes fragmentation, defragmentation state and latency of every enabled backend
+ * which supports scheduling and decides per disk which of them to start, pause or resume
+ */
+void dnet_defrag_scheduler::check()
+{
+	const auto &backends = m_node->config_data->backends->backends;
+	std::map<uint64_t, std::vector<backend_check>> disks;
+
+	for (size_t backend_id = 0; backend_id < backends.size() && backend_id < m_backends.size(); ++backend_id) {
+		const dnet_backend_info &backend = backends[backend_id];
+		backend_state &state = m_backends[backend_id];
+		std::lock_guard<std::mutex> guard(*backend.state_mutex);
+
+		const dnet_backend_callbacks &cb = backend.config.cb;
+		if (backend.state != DNET_BACKEND_ENABLED || !cb.fragmentation || !cb.defrag_status ||
+				!cb.defrag_start || !cb.defrag_stop) {
+			state = backend_state();
+			continue;
+		}
+
+		backend_check bc;
+		uint64_t disk;
+
+		bc.backend_id = backend_id;
+		if (cb.fragmentation(cb.command_private, &bc.ratio, &disk))
+			continue;
+
+		bc.defrag_state = cb.defrag_status(cb.command_private);
+		if (bc.defrag_state == DNET_BACKEND_DEFRAG_NOT_STARTED && !state.paused)
+			state.started = false;
+
+		auto stats = static_cast<ioremap::monitor::command_stats *>(m_node->io->backends[backend_id].command_stats);
+		bc.latency = stats ? stats->disk_latency_percentile(m_config.percentile, state.latencies) : 0;
+
+		disks[disk].push_back(bc);
+	}
+
+	for (auto it = disks.begin(); it != disks.end(); ++it)
+		check_disk(it->first, it->second);
+}
+
+void dnet_defrag_scheduler::check_disk(uint64_t disk, std::vector<backend_check> &backends)
+{
+	uint64_t latency = 0;
+	size_t running = 0;
+
+	for (auto it = backends.begin(); it != backends.end(); ++it) {
+		latency = std::max(latency, it->latency);
+		if (it->defrag_state != DNET_BACKEND_DEFRAG_NOT_STARTED)
+			++running;
+	}
+
+	if (m_config.latency_threshold && latency > m_config.latency_threshold) {
+		for (auto it = backends.begin(); it != backends.end(); ++it) {
+			backend_state &state = m_backends[it->backend_id];
+			if (!state.started || state.paused || it->defrag_state == DNET_BACKEND_DEFRAG_NOT_STARTED)
+				continue;
+
+			int err = stop_defrag(it->backend_id);
+			dnet_log(m_node, err ? DNET_LOG_ERROR : DNET_LOG_INFO,
+				"defrag: backend: %zu, disk: %" PRIx64 ": paused, latency: %" PRIu64 " usecs, err: %d",
+				it->backend_id, disk, latency, err);
+			if (!err)
+				state.paused = true;
+		}
+		return;
+	}
+
+	if (m_config.latency_threshold && latency > m_config.latency_threshold * 3 / 4)
+		return;
+
+	/* paused ones are resumed first, then the most fragmented are started */
+	std::sort(backends.begin(), backends.end(), [this] (const backend_check &b1, const backend_check &b2) {
+		const bool paused1 = m_backends[b1.backend_id].paused, paused2 = m_backends[b2.backend_id].paused;
+		if (paused1 != paused2)
+			return paused1;
+		return b1.ratio > b2.ratio;
+	});
+
+	for (auto it = backends.begin(); it != backends.end() && running < m_config.per_disk; ++it) {
+		backend_state &state = m_backends[it->backend_id];
+
+		if (it->defrag_state != DNET_BACKEND_DEFRAG_NOT_STARTED)
+			continue;
+		if (!state.paused && it->ratio < m_config.fragmentation)
+			continue;
+
+		int err = start_defrag(it->backend_id);
+		dnet_log(m_node, err ? DNET_LOG_ERROR : DNET_LOG_INFO,
+			"defrag: backend: %zu, disk: %" PRIx64 ": %s, fragmentation: %.3f, latency: %" PRIu64 " usecs, err: %d",
+			it->backend_id, disk, state.paused ? "resumed" : "started", it->ratio, latency, err);
+		if (err)
+			continue;
+
+		state.started = true;
+		state.paused = false;
+		++running;
+	}
+}
+
+int dnet_defrag_scheduler::start_defrag(size_t backend_id)
+{
+	const dnet_backend_info &backend = m_node->config_data->backends->backends[backend_id];
+	std::lock_guard<std::mutex> guard(*backend.state_mutex);
+
+	const dnet_backend_callbacks &cb = backend.config.cb;
+	if (backend.state != DNET_BACKEND_ENABLED || !cb.defrag_start)
+		return -ENOTSUP;
+
+	return cb.defrag_start(cb.command_private, static_cast<enum dnet_backend_defrag_level>(m_config.level));
+}
+
+int dnet_defrag_scheduler::stop_defrag(size_t backend_id)
+{
+	const dnet_backend_info &backend = m_node->config_data->backends->backends[backend_id];
+	std::lock_guard<std::mutex> guard(*backend.state_mutex);
+
+	const dnet_backend_callbacks &cb = backend.config.cb;
+	if (backend.state != DNET_BACKEND_ENABLED || !cb.defrag_stop)
+		return -ENOTSUP;
+
+	return cb.defrag_stop(cb.command_private);
+}
+
+int dnet_defrag_scheduler_start(struct dnet_node *n)
+{
+	const auto &data = *static_cast<const ioremap::elliptics::config::config_data *>(n->config_data);
+	if (!data.defrag_config)
+		return 0;
+
+	try {
+		n->defrag_scheduler = new dnet_defrag_scheduler(n, *data.defrag_config);
+	} catch (const std::exception &e) {
+		dnet_log(n, DNET_LOG_ERROR, "defrag: failed to start scheduler: %s", e.what());
+		return -ENOMEM;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "defrag: scheduler started: interval: %u, fragmentation: %.3f, per_disk: %u, "
+			"threshold: %" PRIu64 " usecs",
+			data.defrag_config->interval, data.defrag_config->fragmentation,
+			data.defrag_config->per_disk, data.defrag_config->latency_threshold);
+	return 0;
+}
+
+void dnet_defrag_scheduler_stop(struct dnet_node *n)
+{
+	delete n->defrag_scheduler;
+	n->defrag_scheduler = NULL;
+}
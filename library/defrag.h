@@ -0,0 +1,105 @@
+#ifndef IOREMAP_ELLIPTICS_DEFRAG_H
+#define IOREMAP_ELLIPTICS_DEFRAG_H
+
+#include <elliptics/packet.h>
+#include <elliptics/interface.h>
+
+#ifdef __cplusplus
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ioremap { namespace elliptics { namespace config {
+class config;
+}}}
+
+/*
+ * Node options of defragmentation scheduler, "defrag_scheduler" section of the config
+ */
+struct dnet_defrag_config
+{
+	/* seconds between checks of backends' fragmentation and latency */
+	unsigned int	interval;
+	/* backends whose removed records take more than this share of blobs are defragmented */
+	double		fragmentation;
+	/* defragmentations which may run at the same time on one disk, manual ones included */
+	unsigned int	per_disk;
+	/* enum dnet_backend_defrag_level of started defragmentations */
+	int		level;
+	/*
+	 * Defragmentation of the disk is paused while @percentile of disk commands
+	 * of any of its backends is above @latency_threshold usecs, 0 disables pausing.
+	 * It is resumed once the latency falls below 3/4 of the threshold.
+	 */
+	double		percentile;
+	uint64_t	latency_threshold;
+
+	static std::unique_ptr<dnet_defrag_config> parse(const ioremap::elliptics::config::config &cfg);
+};
+
+/*
+ * Starts defragmentation of the most fragmented backends of every disk, at most @per_disk at a time,
+ * and pauses them while foreground latency of the disk is high. Eblob resumes paused defragmentation
+ * with the blobs which have not been processed yet.
+ */
+class dnet_defrag_scheduler
+{
+public:
+	dnet_defrag_scheduler(dnet_node *node, const dnet_defrag_config &config);
+	~dnet_defrag_scheduler();
+
+private:
+	struct backend_state {
+		backend_state() : started(false), paused(false)
+		{
+		}
+
+		/* defragmentation has been started by the scheduler and has not finished yet */
+		bool			started;
+		/* defragmentation has been stopped by the scheduler because of latency */
+		bool			paused;
+		/* disk latency histogram at the previous check */
+		std::vector<uint64_t>	latencies;
+	};
+
+	struct backend_check {
+		size_t		backend_id;
+		int		defrag_state;
+		double		ratio;
+		uint64_t	latency;
+	};
+
+	void run();
+	void check();
+	void check_disk(uint64_t disk, std::vector<backend_check> &backends);
+	int start_defrag(size_t backend_id);
+	int stop_defrag(size_t backend_id);
+
+	dnet_node			*m_node;
+	const dnet_defrag_config	m_config;
+	std::vector<backend_state>	m_backends;
+
+	std::mutex			m_mutex;
+	std::condition_variable		m_wait;
+	bool				m_need_exit;
+	std::thread			m_thread;
+};
+
+extern "C" {
+#else // __cplusplus
+typedef struct dnet_defrag_scheduler_t dnet_defrag_scheduler;
+#endif // __cplusplus
+
+/*
+ * Starts defragmentation scheduler of the node if it is configured, backends have to be initialized
+ */
+int dnet_defrag_scheduler_start(struct dnet_node *n);
+void dnet_defrag_scheduler_stop(struct dnet_node *n);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // IOREMAP_ELLIPTICS_DEFRAG_H
@@ -41,8 +41,15 @@
 
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
+#include "elliptics/iterator_filter.h"
 
 #include "monitor/measure_points.h"
+#include "probes.h"
+
+#include "crypto/crc32c.h"
+
+__thread uint64_t dnet_backend_stage_time = DNET_IO_STAGE_NONE;
+__thread struct dnet_bulk_commit *dnet_bulk_commit;
 
 int dnet_remove_local(struct dnet_backend_io *backend, struct dnet_node *n, struct dnet_id *id)
 {
@@ -82,7 +89,7 @@ static int dnet_cmd_route_list(struct dnet_net_state *orig, struct dnet_cmd *cmd
 	size_t states_num = 0;
 	int err;
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	list_for_each_entry(st, &n->dht_state_list, node_entry) {
 		if (dnet_addr_equal(&st->addr, &orig->addr) || !st->addrs)
 			continue;
@@ -93,7 +100,7 @@ static int dnet_cmd_route_list(struct dnet_net_state *orig, struct dnet_cmd *cmd
 	acmd = calloc(1, total_size);
 
 	if (!acmd) {
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 		return -ENOMEM;
 	}
 
@@ -134,7 +141,7 @@ static int dnet_cmd_route_list(struct dnet_net_state *orig, struct dnet_cmd *cmd
 		memcpy(addrs, st->addrs, n->addr_num * sizeof(struct dnet_addr));
 		addrs += n->addr_num;
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 	memcpy(&acmd->cmd.id, &cmd->id, sizeof(struct dnet_id));
 	acmd->cmd.size = total_size - sizeof(struct dnet_cmd);
 
@@ -226,7 +233,7 @@ static int dnet_cmd_status(struct dnet_net_state *orig, struct dnet_cmd *cmd __u
 	return dnet_send_reply(orig, cmd, st, sizeof(struct dnet_node_status), 1);
 }
 
-static int dnet_cmd_auth(struct dnet_net_state *orig, struct dnet_cmd *cmd __unused, void *data)
+static int dnet_cmd_auth(struct dnet_net_state *orig, struct dnet_cmd *cmd, void *data)
 {
 	struct dnet_node *n = orig->n;
 	struct dnet_auth *a = data;
@@ -243,6 +250,34 @@ static int dnet_cmd_auth(struct dnet_net_state *orig, struct dnet_cmd *cmd __unu
 		dnet_log(n, DNET_LOG_ERROR, "%s: auth cookies do not match", dnet_state_dump_addr(orig));
 	} else {
 		dnet_log(n, DNET_LOG_INFO, "%s: authentication succeeded", dnet_state_dump_addr(orig));
+
+		struct dnet_auth reply;
+
+		memset(&reply, 0, sizeof(struct dnet_auth));
+
+		/* reply with the same flag confirms compression, peer starts compressing once it receives it */
+		if ((a->flags & DNET_AUTH_FLAGS_COMPRESSION) && dnet_wire_compression_match(n, dnet_state_addr(orig)))
+			reply.flags |= DNET_AUTH_FLAGS_COMPRESSION;
+
+		/* headers put into the send list after the reply are short, see dnet_send_list_add_nolock() */
+		if ((a->flags & DNET_AUTH_FLAGS_SHORT_HEADER) && n->short_header) {
+			reply.flags |= DNET_AUTH_FLAGS_SHORT_HEADER;
+			orig->short_header_pending = 1;
+		}
+
+		if (reply.flags) {
+			const uint64_t flags = reply.flags;
+
+			dnet_convert_auth(&reply);
+
+			err = dnet_send_reply(orig, cmd, &reply, sizeof(struct dnet_auth), 1);
+			if (!err && (flags & DNET_AUTH_FLAGS_COMPRESSION)) {
+				orig->wire_compression = 1;
+				dnet_log(n, DNET_LOG_INFO, "%s: wire compression is enabled", dnet_state_dump_addr(orig));
+			}
+			if (!err && (flags & DNET_AUTH_FLAGS_SHORT_HEADER))
+				dnet_log(n, DNET_LOG_INFO, "%s: short headers are enabled", dnet_state_dump_addr(orig));
+		}
 	}
 
 err_out_exit:
@@ -277,43 +312,66 @@ int dnet_send_ack(struct dnet_net_state *st, struct dnet_cmd *cmd, int err, int
 	return err;
 }
 
-int dnet_send_reply(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size, int more)
+static int dnet_send_reply_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, const void *header, unsigned int hsize,
+		const void *odata, unsigned int size, void (*release)(void *priv), void *priv, int more)
 {
-	struct dnet_net_state *st = state;
 	struct dnet_cmd *c;
-	void *data;
 	int err;
 
-	c = calloc(1, sizeof(struct dnet_cmd) + size);
-	if (!c)
+	c = calloc(1, sizeof(struct dnet_cmd) + hsize);
+	if (!c) {
+		if (release)
+			release(priv);
 		return -ENOMEM;
+	}
 
-	data = c + 1;
 	*c = *cmd;
 
 	if ((cmd->flags & DNET_FLAGS_NEED_ACK) || more)
 		c->flags |= DNET_FLAGS_MORE;
 
-	c->size = size;
+	c->size = hsize + size;
 	c->flags |= DNET_FLAGS_REPLY;
 	c->flags &= ~DNET_FLAGS_NEED_ACK; // this is a reply, it may not contain ACK bit
 
-	if (size)
-		memcpy(data, odata, size);
+	if (hsize)
+		memcpy(c + 1, header, hsize);
 
 	dnet_log(st->n, DNET_LOG_NOTICE, "%s: %s: reply trans: %lld -> %s (%p): size: %u, cflags: %s",
 		dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)c->trans,
 		dnet_state_dump_addr(st), st,
-		size, dnet_flags_dump_cflags(c->flags));
+		hsize + size, dnet_flags_dump_cflags(c->flags));
 
 	dnet_convert_cmd(c);
 
-	err = dnet_send(st, c, sizeof(struct dnet_cmd) + size);
+	if (release)
+		err = dnet_send_data_ref(st, c, sizeof(struct dnet_cmd) + hsize, (void *)odata, size, release, priv);
+	else if (size)
+		err = dnet_send_data(st, c, sizeof(struct dnet_cmd) + hsize, (void *)odata, size);
+	else
+		err = dnet_send(st, c, sizeof(struct dnet_cmd) + hsize);
 	free(c);
 
 	return err;
 }
 
+int dnet_send_reply_split(void *state, struct dnet_cmd *cmd, const void *header, unsigned int hsize,
+		const void *odata, unsigned int size, int more)
+{
+	return dnet_send_reply_raw(state, cmd, header, hsize, odata, size, NULL, NULL, more);
+}
+
+int dnet_send_reply(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size, int more)
+{
+	return dnet_send_reply_raw(state, cmd, NULL, 0, odata, size, NULL, NULL, more);
+}
+
+int dnet_send_reply_ref(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size,
+		void (*release)(void *priv), void *priv, int more)
+{
+	return dnet_send_reply_raw(state, cmd, NULL, 0, odata, size, release, priv, more);
+}
+
 static void dnet_queue_wait_threshold(struct dnet_net_state *st)
 {
 	/* If send succeeded then we should increase queue size */
@@ -361,6 +419,276 @@ int dnet_send_reply_threshold(void *state, struct dnet_cmd *cmd,
 	return err;
 }
 
+int dnet_send_reply_threshold_ref(void *state, struct dnet_cmd *cmd, const void *odata, unsigned int size,
+		void (*release)(void *priv), void *priv, int more)
+{
+	struct dnet_net_state *st = state;
+	int err;
+
+	if (st == st->n->st) {
+		release(priv);
+		return 0;
+	}
+
+	err = dnet_send_reply_ref(state, cmd, odata, size, release, priv, more);
+	if (err == 0) {
+		atomic_inc(&st->send_queue_size);
+		dnet_queue_wait_threshold(st);
+	}
+
+	return err;
+}
+
+static int dnet_reply_batch_flush_nolock(struct dnet_reply_batch *b);
+
+static void *dnet_reply_batch_flusher(void *data)
+{
+	struct dnet_reply_batch *b = data;
+	struct timeval tv;
+	struct timespec ts;
+	int err;
+
+	dnet_set_name("dnet_batch");
+
+	pthread_mutex_lock(&b->lock);
+	while (!b->need_exit) {
+		gettimeofday(&tv, NULL);
+
+		if (b->num && DIFF(b->start, tv) >= DNET_REPLY_BATCH_TIMEOUT * 1000) {
+			err = dnet_reply_batch_flush_nolock(b);
+			if (err && !b->flush_err)
+				b->flush_err = err;
+			continue;
+		}
+
+		/* wait until the first pending reply times out, empty batch is checked once per timeout */
+		if (b->num)
+			tv = b->start;
+
+		tv.tv_usec += DNET_REPLY_BATCH_TIMEOUT * 1000;
+		ts.tv_sec = tv.tv_sec + tv.tv_usec / 1000000;
+		ts.tv_nsec = (tv.tv_usec % 1000000) * 1000;
+
+		pthread_cond_timedwait(&b->cond, &b->lock, &ts);
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	return NULL;
+}
+
+int dnet_reply_batch_init(struct dnet_reply_batch *b, struct dnet_net_state *st, struct dnet_cmd *cmd)
+{
+	int err;
+
+	memset(b, 0, sizeof(struct dnet_reply_batch));
+
+	b->st = st;
+	b->cmd = cmd;
+
+	b->buffer = malloc(DNET_REPLY_BATCH_SIZE);
+	if (!b->buffer) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	err = -pthread_mutex_init(&b->lock, NULL);
+	if (err)
+		goto err_out_free;
+
+	err = -pthread_cond_init(&b->cond, NULL);
+	if (err)
+		goto err_out_destroy_lock;
+
+	err = -pthread_create(&b->flusher, NULL, dnet_reply_batch_flusher, b);
+	if (err)
+		goto err_out_destroy_cond;
+
+	return 0;
+
+err_out_destroy_cond:
+	pthread_cond_destroy(&b->cond);
+err_out_destroy_lock:
+	pthread_mutex_destroy(&b->lock);
+err_out_free:
+	free(b->buffer);
+err_out_exit:
+	return err;
+}
+
+static int dnet_reply_batch_flush_nolock(struct dnet_reply_batch *b)
+{
+	struct dnet_cmd cmd;
+	char *buffer;
+	int err;
+
+	if (!b->num)
+		return 0;
+
+	cmd = *b->cmd;
+	if (b->compact) {
+		struct dnet_iterator_compact_header *h = (struct dnet_iterator_compact_header *)b->buffer;
+
+		h->num = b->num;
+		dnet_convert_iterator_compact_header(h);
+		memset(&b->prev_key, 0, sizeof(struct dnet_raw_id));
+		cmd.flags |= DNET_FLAGS_COMPACT;
+	} else {
+		cmd.flags |= DNET_FLAGS_BATCH;
+	}
+
+	dnet_log(b->st->n, DNET_LOG_DEBUG, "%s: %s: sending %s batch of %d replies: size: %zu",
+		dnet_dump_id(&cmd.id), dnet_cmd_string(cmd.cmd), b->compact ? "compact" : "plain", b->num, b->size);
+
+	/* full buffer is handed over to send queue, the next batch is collected into a new one */
+	buffer = b->buffer;
+	b->buffer = malloc(DNET_REPLY_BATCH_SIZE);
+	if (b->buffer) {
+		err = dnet_send_reply_threshold_ref(b->st, &cmd, buffer, b->size, free, buffer, 1);
+	} else {
+		b->buffer = buffer;
+		err = dnet_send_reply_threshold(b->st, &cmd, b->buffer, b->size, 1);
+	}
+
+	b->size = 0;
+	b->num = 0;
+	return err;
+}
+
+int dnet_reply_batch_add(struct dnet_reply_batch *b, const void *data, size_t size)
+{
+	const size_t total_size = sizeof(struct dnet_cmd) + size;
+	struct dnet_cmd *c;
+	struct timeval tv;
+	int err = 0;
+
+	/* Too large replies are sent as is */
+	if (total_size > DNET_REPLY_BATCH_SIZE) {
+		pthread_mutex_lock(&b->lock);
+		err = dnet_reply_batch_flush_nolock(b);
+		pthread_mutex_unlock(&b->lock);
+		if (err)
+			return err;
+
+		return dnet_send_reply_threshold(b->st, b->cmd, data, size, 1);
+	}
+
+	pthread_mutex_lock(&b->lock);
+
+	err = b->flush_err;
+	b->flush_err = 0;
+	if (err)
+		goto err_out_unlock;
+
+	if (b->size + total_size > DNET_REPLY_BATCH_SIZE) {
+		err = dnet_reply_batch_flush_nolock(b);
+		if (err)
+			goto err_out_unlock;
+	}
+
+	c = (struct dnet_cmd *)(b->buffer + b->size);
+	*c = *b->cmd;
+	c->size = size;
+	c->flags |= DNET_FLAGS_MORE | DNET_FLAGS_REPLY;
+	c->flags &= ~DNET_FLAGS_NEED_ACK;
+	dnet_convert_cmd(c);
+
+	memcpy(c + 1, data, size);
+	b->size += total_size;
+
+	gettimeofday(&tv, NULL);
+	if (!b->num++)
+		b->start = tv;
+
+	if (DIFF(b->start, tv) > DNET_REPLY_BATCH_TIMEOUT * 1000)
+		err = dnet_reply_batch_flush_nolock(b);
+
+err_out_unlock:
+	pthread_mutex_unlock(&b->lock);
+	return err;
+}
+
+int dnet_reply_batch_add_compact(struct dnet_reply_batch *b, const struct dnet_iterator_response *re)
+{
+	struct dnet_iterator_compact_header *h;
+	unsigned char *p;
+	struct timeval tv;
+	int prefix, err = 0;
+
+	pthread_mutex_lock(&b->lock);
+
+	err = b->flush_err;
+	b->flush_err = 0;
+	if (err)
+		goto err_out_unlock;
+
+	if (b->size + DNET_COMPACT_RECORD_MAX > DNET_REPLY_BATCH_SIZE) {
+		err = dnet_reply_batch_flush_nolock(b);
+		if (err)
+			goto err_out_unlock;
+	}
+
+	gettimeofday(&tv, NULL);
+	if (!b->num) {
+		b->start = tv;
+		b->size = sizeof(struct dnet_iterator_compact_header);
+		memset(b->buffer, 0, b->size);
+	}
+
+	/* progress of the last packed response is sent for the whole batch */
+	h = (struct dnet_iterator_compact_header *)b->buffer;
+	h->id = re->id;
+	h->iterated_keys = re->iterated_keys;
+	h->total_keys = re->total_keys;
+
+	for (prefix = 0; prefix < DNET_ID_SIZE; ++prefix) {
+		if (re->key.id[prefix] != b->prev_key.id[prefix])
+			break;
+	}
+
+	p = (unsigned char *)b->buffer + b->size;
+	*p++ = prefix;
+	memcpy(p, re->key.id + prefix, DNET_ID_SIZE - prefix);
+	p += DNET_ID_SIZE - prefix;
+
+	p = dnet_varint_put(p, re->flags);
+	p = dnet_varint_put(p, re->user_flags);
+	p = dnet_varint_put(p, re->timestamp.tsec);
+	p = dnet_varint_put(p, re->timestamp.tnsec);
+	p = dnet_varint_put(p, re->size);
+
+	b->size = p - (unsigned char *)b->buffer;
+	b->prev_key = re->key;
+	b->num++;
+
+	if (DIFF(b->start, tv) > DNET_REPLY_BATCH_TIMEOUT * 1000)
+		err = dnet_reply_batch_flush_nolock(b);
+
+err_out_unlock:
+	pthread_mutex_unlock(&b->lock);
+	return err;
+}
+
+int dnet_reply_batch_destroy(struct dnet_reply_batch *b)
+{
+	int err;
+
+	pthread_mutex_lock(&b->lock);
+	b->need_exit = 1;
+	pthread_cond_signal(&b->cond);
+	pthread_mutex_unlock(&b->lock);
+
+	pthread_join(b->flusher, NULL);
+
+	err = b->flush_err;
+	if (!err)
+		err = dnet_reply_batch_flush_nolock(b);
+
+	pthread_cond_destroy(&b->cond);
+	pthread_mutex_destroy(&b->lock);
+	free(b->buffer);
+	return err;
+}
+
 /*!
  * Internal callback that writes result to \a fd opened in append mode
  */
@@ -386,6 +714,7 @@ static int dnet_iterator_callback_file(void *priv, void *data, uint64_t dsize, i
 static int dnet_iterator_callback_send(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
 {
 	struct dnet_iterator_send_private *send = priv;
+	int err;
 
 	(void) fd;
 	(void) data_offset;
@@ -401,194 +730,523 @@ static int dnet_iterator_callback_send(void *priv, void *data, uint64_t dsize, i
 		return -EINTR;
 	}
 
+	if (send->batch && send->batch->compact) {
+		struct dnet_iterator_response re;
+
+		memcpy(&re, data, sizeof(struct dnet_iterator_response));
+		dnet_convert_iterator_response(&re);
+
+		if (!re.status)
+			return dnet_reply_batch_add_compact(send->batch, &re);
+
+		/* keepalives and checkpoints are rare, they are sent as is after already packed responses */
+		pthread_mutex_lock(&send->batch->lock);
+		err = dnet_reply_batch_flush_nolock(send->batch);
+		if (!err)
+			err = dnet_send_reply_threshold(send->st, send->cmd, data, dsize, 1);
+		pthread_mutex_unlock(&send->batch->lock);
+		return err;
+	} else if (send->batch) {
+		return dnet_reply_batch_add(send->batch, data, dsize);
+	}
+
 	return dnet_send_reply_threshold(send->st, send->cmd, data, dsize, 1);
 }
 
-struct dnet_iterator_server_send_write_private {
-	atomic_t			refcnt;
-	struct dnet_server_send_ctl	*send;
-	struct timeval			start;
-	uint64_t			dsize;
-	char				data[0];
-};
-
-static int dnet_iterator_server_send_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv)
+static int dnet_iterator_ordered_init(struct dnet_iterator_ordered_private *ordered,
+		struct dnet_iterator_send_private *send)
 {
-	struct dnet_iterator_server_send_write_private *wp = priv;
-	struct dnet_server_send_ctl *send = wp->send;
-	struct dnet_net_state *st = send->state;
-	int err = 0;
+	char tmp[] = "/tmp/dnet-ordered-XXXXXX";
+	int err;
 
-	(void) addr;
+	memset(ordered, 0, sizeof(struct dnet_iterator_ordered_private));
+	ordered->send = send;
 
-	/*
-	 * We only care about write transaction completion, thus we only check number
-	 * of transaction destructions. There will be many transactions (one for each remote
-	 * group to write data into) and therefore this code chunk will be invoked multiple times.
-	 *
-	 * If we would like to accumulate write results, we would have to check transaction
-	 * replies and associated data.
-	 */
-	if (is_trans_destroyed(cmd)) {
-		err = cmd->status;
+	ordered->fd = mkstemp(tmp);
+	if (ordered->fd < 0)
+		return -errno;
+	unlink(tmp);
 
-		/*
-		 * Write CAS error is not a real 'error' in that regard, that we do not remove
-		 * local record, but also do not stop iterator.
-		 *
-		 * Setting @write_error forces iterator to stop.
-		 */
-		if (err && !send->write_error && (err != -EBADFD))
-			send->write_error = err;
+	err = pthread_mutex_init(&ordered->lock, NULL);
+	if (err) {
+		close(ordered->fd);
+		ordered->fd = -1;
+		return -err;
+	}
 
-		if (atomic_dec_and_test(&wp->refcnt)) {
-			// it is in CPU byte order, has to be converted to before sending it to client
-			struct dnet_iterator_response *re = (struct dnet_iterator_response *)wp->data;
-			uint64_t resize = re->size;
-			long new_pending = 0;
-
-			if (send->iflags & DNET_IFLAGS_MOVE) {
-				if (!err) {
-					struct dnet_io_req *r;
-					struct dnet_cmd *lc;
-					struct dnet_io_attr *io;
-					size_t cmd_size = sizeof(struct dnet_io_req) +
-							sizeof(struct dnet_cmd) +
-							sizeof(struct dnet_io_attr);
-
-					r = malloc(cmd_size);
-					if (!r) {
-						err = -ENOMEM;
-						if (!send->write_error)
-							send->write_error = err;
-						// we could update wp->data here, which is dnet_iterator_response
-						// but we do not really care about local errors, for example
-						// remove error is not handled too
-						goto err_out_send;
-					}
-
-					memset(r, 0, cmd_size);
-
-					r->header = r + 1;
-					r->hsize = sizeof(struct dnet_cmd);
-					r->data = r->header + sizeof(struct dnet_cmd);
-					r->dsize = sizeof(struct dnet_io_attr);
-					r->st = dnet_state_get(st);
-
-					lc = r->header;
-					dnet_setup_id(&lc->id, send->cmd.id.group_id, cmd->id.id);
-					lc->cmd = DNET_CMD_DEL;
-					lc->backend_id = send->backend_id;
-					lc->trace_id = cmd->trace_id;
-					lc->flags = DNET_FLAGS_NOLOCK | DNET_FLAGS_DIRECT | DNET_FLAGS_DIRECT_BACKEND;
-					if (send->cmd.flags & DNET_FLAGS_TRACE_BIT)
-						lc->flags |= DNET_FLAGS_TRACE_BIT;
-					lc->size = sizeof(struct dnet_io_attr);
-
-					io = r->data;
-					io->flags = DNET_IO_FLAGS_SKIP_SENDING;
-					memcpy(io->id, lc->id.id, DNET_ID_SIZE);
-					memcpy(io->parent, lc->id.id, DNET_ID_SIZE);
-					dnet_convert_io_attr(io);
-
-					dnet_schedule_io(st->n, r);
-				}
-			}
+	return 0;
+}
 
-err_out_send:
-			if (send->write_error)
-				re->status = send->write_error;
-			if (!re->status)
-				re->status = err;
+static void dnet_iterator_ordered_destroy(struct dnet_iterator_ordered_private *ordered)
+{
+	pthread_mutex_destroy(&ordered->lock);
+	close(ordered->fd);
+}
 
-			if (!err && !re->status) {
-				long usec;
-				struct timeval tv;
+/*!
+ * Internal callback that stores responses of DNET_IFLAGS_ORDERED iterator,
+ * they are sent by dnet_iterator_ordered_send() when iteration completes
+ */
+static int dnet_iterator_callback_ordered(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
+{
+	struct dnet_iterator_ordered_private *ordered = priv;
+	struct dnet_iterator_response keepalive;
+	static const ssize_t response_size = sizeof(struct dnet_iterator_response);
+	uint64_t keys;
+	ssize_t err;
 
-				gettimeofday(&tv, NULL);
+	/* keepalives of skipped keys are not reordered */
+	if (((struct dnet_iterator_response *)data)->status)
+		return dnet_iterator_callback_send(ordered->send, data, dsize, fd, data_offset);
 
-				usec = (tv.tv_sec - wp->start.tv_sec) * 1000000 + (tv.tv_usec - wp->start.tv_usec);
+	pthread_mutex_lock(&ordered->lock);
+	err = pwrite(ordered->fd, data, response_size, ordered->size);
+	if (err == response_size) {
+		ordered->size += response_size;
+		err = 0;
+	} else {
+		err = (err == -1) ? -errno : -EINTR;
+	}
+	keys = ordered->size / response_size;
+	pthread_mutex_unlock(&ordered->lock);
 
-				/*
-				 * Maximum number of bytes written into the wire and not yet acknowledged.
-				 * It is equal to 'current speed' times 5 seconds, since 5 seconds is default wait timeout
-				 * for write command.
-				 *
-				 * This '5 seconds' rule could be extended to 60 seconds or million of seconds,
-				 * but practice shows that 60 seconds of data at the current speed overflows pipe
-				 * if remote backend starts to slow down.
-				 *
-				 * '5 seconds' is quite enough to fill 1gbit pipe.
-				 *
-				 * Write command timeout has been increased to 60 seconds to cover this 5 seconds of in-flight
-				 * transactions.
-				 */
-				new_pending = 5 * re->size * 1000000 / usec;
-			}
+	if (err || keys % 10000)
+		return err;
 
-			dnet_log(st->n, DNET_LOG_INFO, "%s: %s: sending response: %s to client: %s, "
-					"user_flags: %llx, ts: %s (%lld.%09lld), "
-					"status: %d, size: %lld, iterated_keys: %lld/%lld, write_error: %d, "
-					"pending_bytes: %ld, limit: %ld -> %ld",
-					__func__,
-					dnet_dump_id(&send->cmd.id), dnet_dump_id_str(re->key.id),
-					dnet_addr_string(&st->addr),
-					(unsigned long long)re->user_flags,
-					dnet_print_time(&re->timestamp),
-					(unsigned long long)re->timestamp.tsec, (unsigned long long)re->timestamp.tnsec,
-					re->status, (unsigned long long)re->size,
-					(unsigned long long)re->iterated_keys, (unsigned long long)re->total_keys,
-					send->write_error,
-					atomic_read(&send->bytes_pending), send->bytes_pending_max, new_pending);
+	/* client's transaction is kept alive and disconnected client is noticed while keys are collected */
+	memcpy(&keepalive, data, response_size);
+	dnet_convert_iterator_response(&keepalive);
+	memset(&keepalive.key, 0, sizeof(struct dnet_raw_id));
+	keepalive.status = 1;
+	dnet_convert_iterator_response(&keepalive);
 
+	return dnet_iterator_callback_send(ordered->send, &keepalive, response_size, fd, data_offset);
+}
 
-			dnet_convert_iterator_response(re);
+/*
+ * Sorts collected responses of DNET_IFLAGS_ORDERED iterator and sends them
+ */
+static int dnet_iterator_ordered_send(struct dnet_iterator_ordered_private *ordered)
+{
+	static const size_t response_size = sizeof(struct dnet_iterator_response);
+	const size_t chunk_num = DNET_REPLY_BATCH_SIZE / response_size;
+	struct dnet_iterator_response *chunk;
+	uint64_t offset, size, i;
+	int err;
 
-			err = dnet_send_reply(send->state, &send->cmd, wp->data, wp->dsize, 1);
-			if (err && !send->write_error)
-				send->write_error = err;
+	err = dnet_iterator_response_container_sort(ordered->fd, ordered->size);
+	if (err)
+		return err;
 
+	chunk = malloc(chunk_num * response_size);
+	if (!chunk)
+		return -ENOMEM;
 
-			pthread_mutex_lock(&send->write_lock);
-			if ((atomic_sub(&send->bytes_pending, resize) < send->bytes_pending_max/2) || send->write_error)
-				pthread_cond_broadcast(&send->write_wait);
+	posix_fadvise(ordered->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-			if (new_pending > 0 && new_pending < DNET_SERVER_SEND_WATERMARK_HIGH) {
-				send->bytes_pending_max = new_pending;
-			} else {
-				send->bytes_pending_max = DNET_SERVER_SEND_WATERMARK_HIGH;
-			}
-			pthread_mutex_unlock(&send->write_lock);
+	for (offset = 0; offset < ordered->size; offset += size) {
+		size = ordered->size - offset;
+		if (size > chunk_num * response_size)
+			size = chunk_num * response_size;
 
-			dnet_server_send_put(send);
-			free(wp);
-			return err;
+		err = dnet_read_ll(ordered->fd, (char *)chunk, size, offset);
+		if (err)
+			goto err_out_free;
+
+		for (i = 0; i < size / response_size; ++i) {
+			err = dnet_iterator_callback_send(ordered->send, &chunk[i], response_size, -1, 0);
+			if (err)
+				goto err_out_free;
 		}
 	}
 
+err_out_free:
+	free(chunk);
 	return err;
 }
 
-struct dnet_server_send_ctl *dnet_server_send_alloc(void *state, struct dnet_cmd *cmd, int *groups, int group_num)
+static inline uint64_t dnet_iterator_hash_mix(uint64_t h)
 {
-	int err;
-	struct dnet_net_state *st = state;
-	struct dnet_server_send_ctl *ctl;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
 
-	dnet_state_get(st);
+/*
+ * Hash of the record does not depend on host byte order, so hashes of replicas can be compared
+ */
+static uint64_t dnet_iterator_record_hash(const struct dnet_iterator_response *re)
+{
+	uint64_t h = 0, word;
+	size_t i;
 
-	ctl = malloc(sizeof(struct dnet_server_send_ctl) + sizeof(int) * group_num);
-	if (!ctl) {
-		err = -ENOMEM;
-		goto err_out_exit;
+	for (i = 0; i < DNET_ID_SIZE; i += sizeof(word)) {
+		memcpy(&word, re->key.id + i, sizeof(word));
+		h = dnet_iterator_hash_mix(h ^ dnet_bswap64(word));
 	}
 
-	memset(ctl, 0, sizeof(struct dnet_server_send_ctl));
+	h = dnet_iterator_hash_mix(h ^ re->timestamp.tsec);
+	h = dnet_iterator_hash_mix(h ^ re->timestamp.tnsec);
+	return dnet_iterator_hash_mix(h ^ re->size);
+}
 
-	ctl->state = state;
-	ctl->cmd = *cmd;
-	ctl->bytes_pending_max = DNET_SERVER_SEND_WATERMARK_HIGH;
-	ctl->groups = (int *)(ctl + 1);
+static int dnet_iterator_hash_entry_cmp(const void *a, const void *b)
+{
+	const struct dnet_iterator_hash_entry *e1 = a;
+	const struct dnet_iterator_hash_entry *e2 = b;
+
+	return dnet_id_cmp_str(e1->range.key_begin.id, e2->range.key_begin.id);
+}
+
+/*
+ * Returns the last range which starts not after @key if it contains @key
+ */
+static struct dnet_iterator_hash_entry *dnet_iterator_hash_find(struct dnet_iterator_hash_private *hash,
+		const struct dnet_raw_id *key)
+{
+	uint64_t low = 0, high = hash->entry_num;
+	struct dnet_iterator_hash_entry *e;
+
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+
+		if (dnet_id_cmp_str(hash->entries[mid].range.key_begin.id, key->id) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (!low)
+		return NULL;
+
+	e = &hash->entries[low - 1];
+	if (dnet_id_cmp_str(key->id, e->range.key_end.id) > 0)
+		return NULL;
+
+	return e;
+}
+
+static int dnet_iterator_hash_init(struct dnet_iterator_hash_private *hash, struct dnet_net_state *st,
+		struct dnet_cmd *cmd, struct dnet_iterator_request *ireq, struct dnet_iterator_range *irange)
+{
+	uint64_t i;
+
+	memset(hash, 0, sizeof(struct dnet_iterator_hash_private));
+	hash->st = st;
+	hash->cmd = cmd;
+	atomic_init(&hash->hashed_keys, 0);
+
+	/* without key ranges the whole backend is summarized as one range */
+	hash->entry_num = (ireq->flags & DNET_IFLAGS_KEY_RANGE) ? ireq->range_num : 1;
+	hash->entries = calloc(hash->entry_num, sizeof(struct dnet_iterator_hash_entry));
+	if (!hash->entries)
+		return -ENOMEM;
+
+	if (ireq->flags & DNET_IFLAGS_KEY_RANGE) {
+		for (i = 0; i < hash->entry_num; ++i)
+			hash->entries[i].range = irange[i];
+
+		qsort(hash->entries, hash->entry_num, sizeof(struct dnet_iterator_hash_entry),
+				dnet_iterator_hash_entry_cmp);
+	} else {
+		memset(&hash->entries[0].range.key_end, 0xff, sizeof(struct dnet_raw_id));
+	}
+
+	return 0;
+}
+
+/*
+ * Internal callback that accumulates hashes of iterated records,
+ * nothing is sent to client except keepalive responses until iteration is over
+ */
+static int dnet_iterator_callback_hash(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
+{
+	struct dnet_iterator_hash_private *hash = priv;
+	struct dnet_iterator_hash_entry *e;
+	struct dnet_iterator_response re;
+
+	(void) fd;
+	(void) data_offset;
+
+	if (hash->st->__need_exit) {
+		dnet_log(hash->st->n, DNET_LOG_ERROR,
+				"%s: Interrupting iterator because peer has been disconnected",
+				dnet_dump_id(&hash->cmd->id));
+		return -EINTR;
+	}
+
+	if (dsize < sizeof(struct dnet_iterator_response))
+		return -EINVAL;
+
+	memcpy(&re, data, sizeof(struct dnet_iterator_response));
+	dnet_convert_iterator_response(&re);
+
+	/* keepalive of keys skipped by timestamp */
+	if (re.status)
+		return dnet_send_reply_threshold(hash->st, hash->cmd, data, sizeof(struct dnet_iterator_response), 1);
+
+	e = dnet_iterator_hash_find(hash, &re.key);
+	if (e) {
+		__sync_fetch_and_add(&e->hash, dnet_iterator_record_hash(&re));
+		__sync_fetch_and_add(&e->keys, 1);
+		__sync_fetch_and_add(&e->size, re.size);
+	}
+
+	if (atomic_inc(&hash->hashed_keys) % 10000 == 0) {
+		struct dnet_iterator_response keepalive;
+
+		memset(&keepalive, 0, sizeof(struct dnet_iterator_response));
+		keepalive.status = 1;
+		keepalive.total_keys = re.total_keys;
+		keepalive.iterated_keys = re.iterated_keys;
+		dnet_convert_iterator_response(&keepalive);
+
+		return dnet_send_reply_threshold(hash->st, hash->cmd, &keepalive, sizeof(keepalive), 1);
+	}
+
+	return 0;
+}
+
+/*
+ * Sends accumulated summary of every range, key of the response is the start of the range
+ */
+static int dnet_iterator_hash_send(struct dnet_iterator_hash_private *hash, uint64_t total_keys)
+{
+	struct {
+		struct dnet_iterator_response	re;
+		struct dnet_iterator_range_hash	rh;
+	} __attribute__ ((packed)) reply;
+	uint64_t i;
+	int err;
+
+	for (i = 0; i < hash->entry_num; ++i) {
+		struct dnet_iterator_hash_entry *e = &hash->entries[i];
+
+		memset(&reply, 0, sizeof(reply));
+
+		reply.re.key = e->range.key_begin;
+		reply.re.size = e->size;
+		reply.re.iterated_keys = e->keys;
+		reply.re.total_keys = total_keys;
+		dnet_convert_iterator_response(&reply.re);
+
+		reply.rh.range = e->range;
+		reply.rh.hash = e->hash;
+		reply.rh.keys = e->keys;
+		reply.rh.size = e->size;
+		dnet_convert_iterator_range_hash(&reply.rh);
+
+		err = dnet_send_reply_threshold(hash->st, hash->cmd, &reply, sizeof(reply), 1);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+struct dnet_iterator_server_send_write_private {
+	atomic_t			refcnt;
+	struct dnet_server_send_ctl	*send;
+	struct timeval			start;
+	uint64_t			dsize;
+	char				data[0];
+};
+
+/*
+ * Sends iterator response @data of the key which has been written to all remote groups with final status @err,
+ * removes local copy of the key if DNET_IFLAGS_MOVE is set and updates limit of in-flight bytes
+ * by the speed @rate_size bytes have been written with since @start.
+ */
+static int dnet_server_send_key_complete(struct dnet_server_send_ctl *send, void *data, uint64_t dsize,
+		struct timeval *start, uint64_t rate_size, uint64_t trace_id, int err)
+{
+	struct dnet_net_state *st = send->state;
+	// it is in CPU byte order, has to be converted to before sending it to client
+	struct dnet_iterator_response *re = data;
+	uint64_t resize = re->size;
+	long new_pending = 0;
+
+	if (send->iflags & DNET_IFLAGS_MOVE) {
+		if (!err) {
+			struct dnet_io_req *r;
+			struct dnet_cmd *lc;
+			struct dnet_io_attr *io;
+			size_t cmd_size = sizeof(struct dnet_io_req) +
+					sizeof(struct dnet_cmd) +
+					sizeof(struct dnet_io_attr);
+
+			r = malloc(cmd_size);
+			if (!r) {
+				err = -ENOMEM;
+				if (!send->write_error)
+					send->write_error = err;
+				// we could update @data here, which is dnet_iterator_response
+				// but we do not really care about local errors, for example
+				// remove error is not handled too
+				goto err_out_send;
+			}
+
+			memset(r, 0, cmd_size);
+
+			r->header = r + 1;
+			r->hsize = sizeof(struct dnet_cmd);
+			r->data = r->header + sizeof(struct dnet_cmd);
+			r->dsize = sizeof(struct dnet_io_attr);
+			r->st = dnet_state_get(st);
+
+			lc = r->header;
+			dnet_setup_id(&lc->id, send->cmd.id.group_id, re->key.id);
+			lc->cmd = DNET_CMD_DEL;
+			lc->backend_id = send->backend_id;
+			lc->trace_id = trace_id;
+			lc->flags = DNET_FLAGS_NOLOCK | DNET_FLAGS_DIRECT | DNET_FLAGS_DIRECT_BACKEND;
+			if (send->cmd.flags & DNET_FLAGS_TRACE_BIT)
+				lc->flags |= DNET_FLAGS_TRACE_BIT;
+			lc->size = sizeof(struct dnet_io_attr);
+
+			io = r->data;
+			io->flags = DNET_IO_FLAGS_SKIP_SENDING;
+			memcpy(io->id, lc->id.id, DNET_ID_SIZE);
+			memcpy(io->parent, lc->id.id, DNET_ID_SIZE);
+			dnet_convert_io_attr(io);
+
+			dnet_schedule_io(st->n, r);
+		}
+	}
+
+err_out_send:
+	if (send->write_error)
+		re->status = send->write_error;
+	if (!re->status)
+		re->status = err;
+
+	if (!err && !re->status) {
+		long usec;
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+
+		usec = (tv.tv_sec - start->tv_sec) * 1000000 + (tv.tv_usec - start->tv_usec);
+
+		/*
+		 * Maximum number of bytes written into the wire and not yet acknowledged.
+		 * It is equal to 'current speed' times 5 seconds, since 5 seconds is default wait timeout
+		 * for write command.
+		 *
+		 * This '5 seconds' rule could be extended to 60 seconds or million of seconds,
+		 * but practice shows that 60 seconds of data at the current speed overflows pipe
+		 * if remote backend starts to slow down.
+		 *
+		 * '5 seconds' is quite enough to fill 1gbit pipe.
+		 *
+		 * Write command timeout has been increased to 60 seconds to cover this 5 seconds of in-flight
+		 * transactions.
+		 */
+		new_pending = 5 * rate_size * 1000000 / usec;
+	}
+
+	dnet_log(st->n, DNET_LOG_INFO, "%s: %s: sending response: %s to client: %s, "
+			"user_flags: %llx, ts: %s (%lld.%09lld), "
+			"status: %d, size: %lld, iterated_keys: %lld/%lld, write_error: %d, "
+			"pending_bytes: %ld, limit: %ld -> %ld",
+			__func__,
+			dnet_dump_id(&send->cmd.id), dnet_dump_id_str(re->key.id),
+			dnet_addr_string(&st->addr),
+			(unsigned long long)re->user_flags,
+			dnet_print_time(&re->timestamp),
+			(unsigned long long)re->timestamp.tsec, (unsigned long long)re->timestamp.tnsec,
+			re->status, (unsigned long long)re->size,
+			(unsigned long long)re->iterated_keys, (unsigned long long)re->total_keys,
+			send->write_error,
+			atomic_read(&send->bytes_pending), send->bytes_pending_max, new_pending);
+
+
+	dnet_convert_iterator_response(re);
+
+	err = dnet_send_reply(send->state, &send->cmd, data, dsize, 1);
+	if (err && !send->write_error)
+		send->write_error = err;
+
+
+	pthread_mutex_lock(&send->write_lock);
+	if ((atomic_sub(&send->bytes_pending, resize) < send->bytes_pending_max/2) || send->write_error)
+		pthread_cond_broadcast(&send->write_wait);
+
+	if (new_pending > 0 && new_pending < DNET_SERVER_SEND_WATERMARK_HIGH) {
+		send->bytes_pending_max = new_pending;
+	} else {
+		send->bytes_pending_max = DNET_SERVER_SEND_WATERMARK_HIGH;
+	}
+	pthread_mutex_unlock(&send->write_lock);
+
+	dnet_server_send_put(send);
+	return err;
+}
+
+static int dnet_iterator_server_send_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv)
+{
+	struct dnet_iterator_server_send_write_private *wp = priv;
+	struct dnet_server_send_ctl *send = wp->send;
+	int err = 0;
+
+	(void) addr;
+
+	/*
+	 * We only care about write transaction completion, thus we only check number
+	 * of transaction destructions. There will be many transactions (one for each remote
+	 * group to write data into) and therefore this code chunk will be invoked multiple times.
+	 *
+	 * If we would like to accumulate write results, we would have to check transaction
+	 * replies and associated data.
+	 */
+	if (is_trans_destroyed(cmd)) {
+		err = cmd->status;
+
+		/*
+		 * Write CAS error is not a real 'error' in that regard, that we do not remove
+		 * local record, but also do not stop iterator.
+		 *
+		 * Setting @write_error forces iterator to stop.
+		 */
+		if (err && !send->write_error && (err != -EBADFD))
+			send->write_error = err;
+
+		if (atomic_dec_and_test(&wp->refcnt)) {
+			struct dnet_iterator_response *re = (struct dnet_iterator_response *)wp->data;
+
+			err = dnet_server_send_key_complete(send, wp->data, wp->dsize, &wp->start, re->size,
+					cmd->trace_id, err);
+			free(wp);
+			return err;
+		}
+	}
+
+	return err;
+}
+
+struct dnet_server_send_ctl *dnet_server_send_alloc(void *state, struct dnet_cmd *cmd, int *groups, int group_num)
+{
+	int err;
+	struct dnet_net_state *st = state;
+	struct dnet_server_send_ctl *ctl;
+
+	dnet_state_get(st);
+
+	ctl = malloc(sizeof(struct dnet_server_send_ctl) + sizeof(int) * group_num);
+	if (!ctl) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	memset(ctl, 0, sizeof(struct dnet_server_send_ctl));
+
+	ctl->state = state;
+	ctl->cmd = *cmd;
+	ctl->bytes_pending_max = DNET_SERVER_SEND_WATERMARK_HIGH;
+	ctl->groups = (int *)(ctl + 1);
 	memcpy(ctl->groups, groups, sizeof(int) * group_num);
 	ctl->group_num = group_num;
 	atomic_set(&ctl->bytes_pending, 0);
@@ -608,8 +1266,27 @@ struct dnet_server_send_ctl *dnet_server_send_alloc(void *state, struct dnet_cmd
 		goto err_out_cond_destroy;
 	}
 
+	err = pthread_mutex_init(&ctl->bulk_lock, NULL);
+	if (err) {
+		err = -err;
+		dnet_log(st->n, DNET_LOG_ERROR, "Failed to initialize server send bulk lock: %d", err);
+		goto err_out_mutex_destroy;
+	}
+
+	INIT_LIST_HEAD(&ctl->bulks);
+
+	err = dnet_throttle_init(&ctl->throttle, 0, 0);
+	if (err) {
+		dnet_log(st->n, DNET_LOG_ERROR, "Failed to initialize server send throttle: %d", err);
+		goto err_out_bulk_destroy;
+	}
+
 	return ctl;
 
+err_out_bulk_destroy:
+	pthread_mutex_destroy(&ctl->bulk_lock);
+err_out_mutex_destroy:
+	pthread_mutex_destroy(&ctl->write_lock);
 err_out_cond_destroy:
 	pthread_cond_destroy(&ctl->write_wait);
 err_out_free:
@@ -619,6 +1296,24 @@ err_out_exit:
 	return NULL;
 }
 
+static void dnet_server_send_diff_destroy(struct dnet_server_send_ctl *ctl)
+{
+	int i;
+
+	if (!ctl->diffs)
+		return;
+
+	for (i = 0; i < ctl->group_num; ++i) {
+		if (ctl->diffs[i].mapped_data)
+			dnet_data_unmap(&ctl->diffs[i]);
+		if (ctl->diffs[i].fd >= 0)
+			close(ctl->diffs[i].fd);
+	}
+
+	free(ctl->diffs);
+	ctl->diffs = NULL;
+}
+
 static int dnet_server_send_cleanup(struct dnet_server_send_ctl *ctl)
 {
 	int err = ctl->write_error;
@@ -636,6 +1331,10 @@ static int dnet_server_send_cleanup(struct dnet_server_send_ctl *ctl)
 		dnet_send_ack(ctl->state, &ctl->cmd, err, 0);
 	}
 
+	dnet_server_send_diff_destroy(ctl);
+
+	dnet_throttle_destroy(&ctl->throttle);
+	pthread_mutex_destroy(&ctl->bulk_lock);
 	pthread_cond_destroy(&ctl->write_wait);
 	pthread_mutex_destroy(&ctl->write_lock);
 
@@ -658,67 +1357,399 @@ int dnet_server_send_put(struct dnet_server_send_ctl *ctl)
 	return 0;
 }
 
-static int dnet_server_send_sync(struct dnet_server_send_ctl *ctl)
+/*
+ * Key sent by DNET_CMD_BULK_WRITE, it is shared by bulks of all remote groups it is written to
+ */
+struct dnet_server_send_bulk_key {
+	atomic_t			refcnt;		/* Number of remote groups which have not completed the key yet */
+	int				err;		/* The first error returned by remote groups */
+	uint64_t			dsize;		/* Size of iterator response */
+	char				data[0];	/* Iterator response in CPU byte order followed by key's data */
+};
+
+/*
+ * Keys which are packed into one DNET_CMD_BULK_WRITE request to remote backend
+ */
+struct dnet_server_send_bulk {
+	struct list_head		bulk_entry;	/* Entry in @dnet_server_send_ctl.bulks */
+	struct dnet_server_send_ctl	*send;
+
+	struct dnet_net_state		*st;		/* Remote node and backend which own all the keys */
+	int				backend_id;
+	int				group_id;
+
+	struct timeval			start;		/* Time when request has been sent */
+	uint64_t			size;		/* Size of request: io attribute and data of every key */
+	int				key_num;
+	int				acked;		/* All keys before this one have been replied */
+	struct dnet_server_send_bulk_key	*keys[DNET_SERVER_SEND_BULK_KEYS];
+	int				status[DNET_SERVER_SEND_BULK_KEYS];
+	char				replied[DNET_SERVER_SEND_BULK_KEYS];
+};
+
+static void dnet_server_send_bulk_key_put(struct dnet_server_send_ctl *send, struct dnet_server_send_bulk_key *key,
+		int err, struct timeval *start, uint64_t rate_size, uint64_t trace_id)
 {
-	pthread_mutex_lock(&ctl->write_lock);
-	while (atomic_read(&ctl->bytes_pending) > 0) {
-		pthread_cond_wait(&ctl->write_wait, &ctl->write_lock);
-	}
-	pthread_mutex_unlock(&ctl->write_lock);
+	/* the same rules as for separate WRITE: CAS error doesn't stop iterator */
+	if (err && !send->write_error && (err != -EBADFD))
+		send->write_error = err;
 
-	return dnet_server_send_put(ctl);
+	if (err)
+		__sync_bool_compare_and_swap(&key->err, 0, err);
+
+	if (atomic_dec_and_test(&key->refcnt)) {
+		dnet_server_send_key_complete(send, key->data, key->dsize, start, rate_size, trace_id, key->err);
+		free(key);
+	}
 }
 
 /*
- * Helper function which sends given data as WRITE command to remote groups
+ * Completes every key of the bulk, keys which have not been replied by remote node get @err.
+ * @b is freed, server send control may be freed too when the last key is completed.
  */
-int dnet_server_send_write(struct dnet_server_send_ctl *send,
-		struct dnet_iterator_response *re, uint64_t dsize,
-		int fd, uint64_t data_offset)
+static void dnet_server_send_bulk_destroy(struct dnet_server_send_bulk *b, int err, uint64_t trace_id)
 {
-	struct dnet_net_state *client_state = send->state;
-	struct dnet_node *n = client_state->n;
-	struct dnet_io_control ctl;
-	struct dnet_session *s;
-	struct dnet_iterator_server_send_write_private *wp;
-	int err;
+	int i;
 
-	dnet_server_send_get(send);
+	if (!err)
+		err = -EIO;
 
-	/*
-	 * If need_exit is set - skips sending reply and return -EINTR to
-	 * interrupt execution of current iterator
-	 */
-	if (client_state->__need_exit) {
-		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because peer has been disconnected",
-				dnet_dump_id(&send->cmd.id));
-		err = -EINTR;
-		goto err_out_exit;
+	for (i = 0; i < b->key_num; ++i) {
+		dnet_server_send_bulk_key_put(b->send, b->keys[i], b->replied[i] ? b->status[i] : err,
+				&b->start, b->size, trace_id);
 	}
 
-	memset(&ctl, 0, sizeof(struct dnet_io_control));
+	if (b->st)
+		dnet_state_put(b->st);
+	free(b);
+}
 
-	memcpy(ctl.id.id, re->key.id, DNET_ID_SIZE);
-	ctl.id.group_id = 0; // will be rewritten in dnet_trans_create_send_all()
+static int dnet_server_send_bulk_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv)
+{
+	struct dnet_server_send_bulk *b = priv;
+	int i;
 
-	memcpy(ctl.io.id, re->key.id, DNET_ID_SIZE);
-	ctl.io.timestamp = re->timestamp;
-	ctl.io.user_flags = re->user_flags;
-	ctl.io.total_size = re->size;
-	ctl.io.size = re->size;
-	ctl.io.flags = DNET_IO_FLAGS_WRITE_NO_FILE_INFO | DNET_IO_FLAGS_CAS_TIMESTAMP;
+	(void) addr;
 
-	// overwrite doesn't care whether remote timestamp differs from local
-	// when this flag is set, we overwrite data no matter what lives at destination node
-	if (send->iflags & DNET_IFLAGS_OVERWRITE)
+	if (is_trans_destroyed(cmd)) {
+		dnet_server_send_bulk_destroy(b, cmd->status, cmd->trace_id);
+		return 0;
+	}
+
+	/* remote node replies for keys in the order they have been packed */
+	for (i = b->acked; i < b->key_num; ++i) {
+		struct dnet_iterator_response *re = (struct dnet_iterator_response *)b->keys[i]->data;
+
+		if (!b->replied[i] && !dnet_id_cmp_str(re->key.id, cmd->id.id)) {
+			b->replied[i] = 1;
+			b->status[i] = cmd->status;
+			break;
+		}
+	}
+
+	while (b->acked < b->key_num && b->replied[b->acked])
+		b->acked++;
+
+	return 0;
+}
+
+static void dnet_server_send_bulk_send(struct dnet_server_send_bulk *b)
+{
+	struct dnet_server_send_ctl *send = b->send;
+	struct dnet_node *n = ((struct dnet_net_state *)send->state)->n;
+	struct dnet_iterator_response *re;
+	struct dnet_trans_control ctl;
+	struct dnet_session *s;
+	struct dnet_buffer *data;
+	char *ptr;
+	int i, err;
+
+	data = dnet_buffer_alloc(b->size);
+	if (!data) {
+		err = -ENOMEM;
+		goto err_out_destroy;
+	}
+
+	ptr = data->data;
+	for (i = 0; i < b->key_num; ++i) {
+		struct dnet_io_attr *io = (struct dnet_io_attr *)ptr;
+		uint64_t size;
+
+		re = (struct dnet_iterator_response *)b->keys[i]->data;
+		size = re->size;
+
+		memset(io, 0, sizeof(struct dnet_io_attr));
+		memcpy(io->id, re->key.id, DNET_ID_SIZE);
+		memcpy(io->parent, re->key.id, DNET_ID_SIZE);
+		io->timestamp = re->timestamp;
+		io->user_flags = re->user_flags;
+		io->total_size = size;
+		io->size = size;
+		io->flags = DNET_IO_FLAGS_WRITE_NO_FILE_INFO | DNET_IO_FLAGS_CAS_TIMESTAMP;
+		if (send->iflags & DNET_IFLAGS_OVERWRITE)
+			io->flags &= ~DNET_IO_FLAGS_CAS_TIMESTAMP;
+		/* compressed record is copied as is */
+		if (re->flags & DNET_RECORD_FLAGS_COMPRESSED)
+			io->flags |= DNET_IO_FLAGS_COMPRESSED;
+		dnet_convert_io_attr(io);
+
+		memcpy(io + 1, b->keys[i]->data + b->keys[i]->dsize, size);
+		ptr += sizeof(struct dnet_io_attr) + size;
+	}
+
+	s = dnet_session_create(n);
+	if (!s) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	dnet_session_set_trace_id(s, send->cmd.trace_id);
+	dnet_session_set_trace_bit(s, !!(send->cmd.flags & DNET_FLAGS_TRACE_BIT));
+	if (send->timeout)
+		dnet_session_set_timeout(s, send->timeout);
+
+	if (dnet_session_get_timeout(s)->tv_sec < 60)
+		dnet_session_set_timeout(s, 60);
+
+	/* request is routed by the first key, all keys of the bulk belong to the same remote backend */
+	re = (struct dnet_iterator_response *)b->keys[0]->data;
+
+	memset(&ctl, 0, sizeof(struct dnet_trans_control));
+	dnet_setup_id(&ctl.id, b->group_id, re->key.id);
+	ctl.cmd = DNET_CMD_BULK_WRITE;
+	ctl.cflags = DNET_FLAGS_NEED_ACK | DNET_FLAGS_BACKGROUND;
+	ctl.data = data->data;
+	ctl.size = b->size;
+	/* transaction references packed keys instead of copying them once more */
+	ctl.data_acquire = dnet_buffer_get;
+	ctl.data_release = dnet_buffer_put;
+	ctl.data_priv = data;
+	ctl.complete = dnet_server_send_bulk_complete;
+	ctl.priv = b;
+
+	dnet_log(n, DNET_LOG_INFO, "%s: %s: sending BULK_WRITE request: group: %d, backend: %d, keys: %d, size: %llu, "
+			"pending_bytes: %ld, limit: %ld",
+			__func__, dnet_dump_id(&send->cmd.id), b->group_id, b->backend_id, b->key_num,
+			(unsigned long long)b->size, atomic_read(&send->bytes_pending), send->bytes_pending_max);
+
+	gettimeofday(&b->start, NULL);
+
+	/* completion is called even if sending has failed, after that @b is not owned anymore */
+	dnet_trans_alloc_send(s, &ctl);
+	dnet_session_destroy(s);
+	dnet_buffer_put(data);
+	return;
+
+err_out_free:
+	dnet_buffer_put(data);
+err_out_destroy:
+	dnet_server_send_bulk_destroy(b, err, send->cmd.trace_id);
+}
+
+/*
+ * Returns bulk of the remote backend which owns @id in @group, must be called under @send->bulk_lock
+ */
+static struct dnet_server_send_bulk *dnet_server_send_bulk_find(struct dnet_server_send_ctl *send, int group,
+		const struct dnet_raw_id *id)
+{
+	struct dnet_node *n = ((struct dnet_net_state *)send->state)->n;
+	struct dnet_server_send_bulk *b;
+	struct dnet_net_state *st;
+	struct dnet_id raw;
+	int backend_id = -1;
+
+	dnet_setup_id(&raw, group, (unsigned char *)id->id);
+	st = dnet_state_get_first_with_backend(n, &raw, &backend_id);
+
+	list_for_each_entry(b, &send->bulks, bulk_entry) {
+		if (b->group_id == group && b->st == st && b->backend_id == backend_id) {
+			if (st)
+				dnet_state_put(st);
+			return b;
+		}
+	}
+
+	b = calloc(1, sizeof(struct dnet_server_send_bulk));
+	if (!b) {
+		if (st)
+			dnet_state_put(st);
+		return NULL;
+	}
+
+	b->send = send;
+	b->st = st;
+	b->backend_id = backend_id;
+	b->group_id = group;
+	list_add_tail(&b->bulk_entry, &send->bulks);
+
+	return b;
+}
+
+/*
+ * Sends all bulks which are being packed, they hold keys counted as pending bytes
+ */
+static void dnet_server_send_bulk_flush(struct dnet_server_send_ctl *send)
+{
+	struct dnet_server_send_bulk *b, *tmp;
+	LIST_HEAD(bulks);
+
+	pthread_mutex_lock(&send->bulk_lock);
+	list_splice_init(&send->bulks, &bulks);
+	pthread_mutex_unlock(&send->bulk_lock);
+
+	list_for_each_entry_safe(b, tmp, &bulks, bulk_entry) {
+		list_del(&b->bulk_entry);
+		dnet_server_send_bulk_send(b);
+	}
+}
+
+/*
+ * Packs given key into bulks of @groups, which are a subset of @send->groups,
+ * full bulks are sent as DNET_CMD_BULK_WRITE to remote backends
+ */
+static int dnet_server_send_bulk_write(struct dnet_server_send_ctl *send, int *groups, int group_num,
+		struct dnet_iterator_response *re, uint64_t dsize,
+		int fd, uint64_t data_offset)
+{
+	struct dnet_net_state *client_state = send->state;
+	struct dnet_node *n = client_state->n;
+	struct dnet_server_send_bulk *full[group_num];
+	struct dnet_server_send_bulk_key *key;
+	struct timeval start;
+	int i, full_num = 0, err = 0;
+	ssize_t rsize;
+
+	if (client_state->__need_exit) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because peer has been disconnected",
+				dnet_dump_id(&send->cmd.id));
+		return -EINTR;
+	}
+
+	key = malloc(sizeof(struct dnet_server_send_bulk_key) + dsize + re->size);
+	if (!key) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because failed to allocate bulk key",
+				dnet_dump_id(&send->cmd.id));
+		return -ENOMEM;
+	}
+
+	memset(key, 0, sizeof(struct dnet_server_send_bulk_key));
+	memcpy(key->data, re, dsize);
+	key->dsize = dsize;
+
+	rsize = pread(fd, key->data + dsize, re->size, data_offset);
+	if (rsize != (ssize_t)re->size) {
+		err = (rsize < 0) ? -errno : -EIO;
+		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because failed to read key %s: %d",
+				dnet_dump_id(&send->cmd.id), dnet_dump_id_str(re->key.id), err);
+		free(key);
+		return err;
+	}
+
+	atomic_init(&key->refcnt, group_num);
+
+	/* key is completed only once, like group writes of separate WRITE command */
+	dnet_server_send_get(send);
+	atomic_add(&send->bytes_pending, re->size);
+
+	pthread_mutex_lock(&send->bulk_lock);
+	for (i = 0; i < group_num; ++i) {
+		struct dnet_server_send_bulk *b = dnet_server_send_bulk_find(send, groups[i], &re->key);
+		if (!b) {
+			err = -ENOMEM;
+			break;
+		}
+
+		b->keys[b->key_num++] = key;
+		b->size += sizeof(struct dnet_io_attr) + re->size;
+
+		if (b->key_num == DNET_SERVER_SEND_BULK_KEYS || b->size >= DNET_SERVER_SEND_BULK_SIZE) {
+			list_del(&b->bulk_entry);
+			full[full_num++] = b;
+		}
+	}
+	pthread_mutex_unlock(&send->bulk_lock);
+
+	if (err) {
+		gettimeofday(&start, NULL);
+		for (; i < group_num; ++i)
+			dnet_server_send_bulk_key_put(send, key, err, &start, 0, send->cmd.trace_id);
+	}
+
+	for (i = 0; i < full_num; ++i)
+		dnet_server_send_bulk_send(full[i]);
+
+	return err;
+}
+
+static int dnet_server_send_sync(struct dnet_server_send_ctl *ctl)
+{
+	dnet_server_send_bulk_flush(ctl);
+
+	pthread_mutex_lock(&ctl->write_lock);
+	while (atomic_read(&ctl->bytes_pending) > 0) {
+		pthread_cond_wait(&ctl->write_wait, &ctl->write_lock);
+	}
+	pthread_mutex_unlock(&ctl->write_lock);
+
+	return dnet_server_send_put(ctl);
+}
+
+/*
+ * Sends given data as WRITE command to @groups, which are a subset of @send->groups
+ */
+static int dnet_server_send_write_groups(struct dnet_server_send_ctl *send, int *groups, int group_num,
+		struct dnet_iterator_response *re, uint64_t dsize,
+		int fd, uint64_t data_offset)
+{
+	struct dnet_net_state *client_state = send->state;
+	struct dnet_node *n = client_state->n;
+	struct dnet_io_control ctl;
+	struct dnet_session *s;
+	struct dnet_iterator_server_send_write_private *wp;
+	int err;
+
+	dnet_server_send_get(send);
+
+	/*
+	 * If need_exit is set - skips sending reply and return -EINTR to
+	 * interrupt execution of current iterator
+	 */
+	if (client_state->__need_exit) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because peer has been disconnected",
+				dnet_dump_id(&send->cmd.id));
+		err = -EINTR;
+		goto err_out_exit;
+	}
+
+	memset(&ctl, 0, sizeof(struct dnet_io_control));
+
+	memcpy(ctl.id.id, re->key.id, DNET_ID_SIZE);
+	ctl.id.group_id = 0; // will be rewritten in dnet_trans_create_send_all()
+
+	memcpy(ctl.io.id, re->key.id, DNET_ID_SIZE);
+	ctl.io.timestamp = re->timestamp;
+	ctl.io.user_flags = re->user_flags;
+	ctl.io.total_size = re->size;
+	ctl.io.size = re->size;
+	ctl.io.flags = DNET_IO_FLAGS_WRITE_NO_FILE_INFO | DNET_IO_FLAGS_CAS_TIMESTAMP;
+
+	// overwrite doesn't care whether remote timestamp differs from local
+	// when this flag is set, we overwrite data no matter what lives at destination node
+	if (send->iflags & DNET_IFLAGS_OVERWRITE)
 		ctl.io.flags &= ~DNET_IO_FLAGS_CAS_TIMESTAMP;
 
+	/* compressed record is copied as is, destination stores it compressed too */
+	if (re->flags & DNET_RECORD_FLAGS_COMPRESSED)
+		ctl.io.flags |= DNET_IO_FLAGS_COMPRESSED;
+
 	// deliberately do not set DNET_FLAGS_NEED_ACK
 	// if WRITE command has failed, @dnet_process_cmd_with_backend_raw() will set this bit automatically,
 	// and will send acknowledge with error
 	//
 	// if there is no error, @dnet_file_info structure will be returned
-	ctl.cflags = 0;
+	//
+	// copied data is written with background priority not to delay frontend requests on remote nodes
+	ctl.cflags = DNET_FLAGS_BACKGROUND;
 
 	ctl.fd = fd;
 	ctl.local_offset = data_offset;
@@ -736,7 +1767,7 @@ int dnet_server_send_write(struct dnet_server_send_ctl *send,
 
 	memset(wp, 0, sizeof(struct dnet_iterator_server_send_write_private));
 
-	atomic_init(&wp->refcnt, send->group_num);
+	atomic_init(&wp->refcnt, group_num);
 	wp->send = send;
 	gettimeofday(&wp->start, NULL);
 
@@ -763,10 +1794,10 @@ int dnet_server_send_write(struct dnet_server_send_ctl *send,
 	if (dnet_session_get_timeout(s)->tv_sec < 60)
 		dnet_session_set_timeout(s, 60);
 
-	err = dnet_session_set_groups(s, send->groups, send->group_num);
+	err = dnet_session_set_groups(s, groups, group_num);
 	if (err) {
 		dnet_log(n, DNET_LOG_ERROR, "%s: Interrupting iterator because failed to set %d groups",
-				dnet_dump_id(&send->cmd.id), send->group_num);
+				dnet_dump_id(&send->cmd.id), group_num);
 		err = -ENOMEM;
 		goto err_out_session_destroy;
 	}
@@ -803,110 +1834,518 @@ err_out_exit:
 	return err;
 }
 
-/*!
- * Internal callback that sends result to different server in the storage as WRITE command
+/*
+ * Helper function which sends given data as WRITE command to remote groups
  */
-static int dnet_iterator_callback_server_send(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
+int dnet_server_send_write(struct dnet_server_send_ctl *send,
+		struct dnet_iterator_response *re, uint64_t dsize,
+		int fd, uint64_t data_offset)
 {
-	struct dnet_server_send_ctl *send = priv;
-	struct dnet_net_state *st = send->state;
-	struct dnet_iterator_response *re = data;
-	int err;
+	struct dnet_node *n = ((struct dnet_net_state *)send->state)->n;
+	struct dnet_throttle *backend_throttle = NULL;
 
-	dnet_convert_iterator_response(re);
+	if (n->io && send->backend_id >= 0 && (size_t)send->backend_id < n->io->backends_count)
+		backend_throttle = &n->io->backends[send->backend_id].background_throttle;
 
-	/*
-	 * Skip sending uncommitted keys to remote servers - we can not write them
-	 * since this will commit those keys on remote nodes, while they are uncommitted here locally.
-	 */
-	if (re->flags & DNET_RECORD_FLAGS_UNCOMMITTED) {
-		err = dnet_send_reply(send->state, &send->cmd, data, dsize, 1);
-		if (err && !send->write_error)
-			send->write_error = err;
-		return err;
-	}
+	dnet_throttle_wait(&send->throttle, backend_throttle, re->size, 1);
 
-	err = dnet_server_send_write(send, re, dsize, fd, data_offset);
+	return dnet_server_send_write_groups(send, send->groups, send->group_num, re, dsize, fd, data_offset);
+}
 
-	/* stop iterator if an error is occurred during write */
-	if (!err)
-		err = send->write_error;
+struct dnet_server_send_diff_fetch {
+	pthread_mutex_t			lock;
+	pthread_cond_t			wait;
+	int				done;
+	int				err;
 
-	if (atomic_read(&send->bytes_pending) > send->bytes_pending_max) {
-		pthread_mutex_lock(&send->write_lock);
+	int				fd;
+	uint64_t			size;
+};
 
-		while ((atomic_read(&send->bytes_pending) > send->bytes_pending_max / 2) &&
-				!st->__need_exit && !send->write_error) {
-			pthread_cond_wait(&send->write_wait, &send->write_lock);
-		}
+static int dnet_server_send_diff_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv)
+{
+	struct dnet_server_send_diff_fetch *f = priv;
+	struct dnet_iterator_response *re = (struct dnet_iterator_response *)(cmd + 1);
+	ssize_t err;
 
-		pthread_mutex_unlock(&send->write_lock);
+	(void) addr;
+
+	if (is_trans_destroyed(cmd)) {
+		pthread_mutex_lock(&f->lock);
+		if (!f->err && cmd)
+			f->err = cmd->status;
+		f->done = 1;
+		pthread_cond_broadcast(&f->wait);
+		pthread_mutex_unlock(&f->lock);
+		return 0;
 	}
 
-	return err;
-}
+	if (cmd->status) {
+		f->err = cmd->status;
+		return 0;
+	}
 
-/*!
- * This routine decides whenever it's time for iterator to pause/cancel.
- *
- * While state is 'paused' - wait on condition variable.
- * If state is 'canceled' - exit with error.
- */
-static int dnet_iterator_flow_control(struct dnet_iterator_common_private *ipriv)
-{
-	int err = 0;
+	/* skip final ack and keepalives, responses are stored as they came from the network */
+	if (cmd->size < sizeof(struct dnet_iterator_response) || re->status)
+		return 0;
 
-	pthread_mutex_lock(&ipriv->it->lock);
-	while (ipriv->it->state == DNET_ITERATOR_ACTION_PAUSE)
-		err = pthread_cond_wait(&ipriv->it->wait, &ipriv->it->lock);
-	if (ipriv->it->state == DNET_ITERATOR_ACTION_CANCEL)
-		err = -ENOEXEC;
-	pthread_mutex_unlock(&ipriv->it->lock);
+	err = pwrite(f->fd, re, sizeof(struct dnet_iterator_response), f->size);
+	if (err != sizeof(struct dnet_iterator_response)) {
+		f->err = (err == -1) ? -errno : -EINTR;
+		return 0;
+	}
 
-	return err;
+	f->size += sizeof(struct dnet_iterator_response);
+	return 0;
 }
 
-/*!
- * Common callback part that is run by all iterator types.
- * It's responsible for sanity checks and flow control.
- *
- * Also now it "prepares" data for next callback by combining data itself with
- * fixed-size response header.
+/*
+ * Runs metadata iterator over @irange at remote @group and stores its responses into @map->fd.
+ * Request is routed by the start of the first range, keys of the ranges which live at other backends
+ * of that group are considered missing, they are sent anyway and rejected by timestamp check there.
  */
-static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key, uint64_t flags,
-                                         int fd, uint64_t data_offset, uint64_t dsize, struct dnet_ext_list *elist)
+static int dnet_server_send_diff_fetch(struct dnet_server_send_ctl *send, struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange, int group, struct dnet_map_fd *map)
 {
-	struct dnet_iterator_common_private *ipriv = priv;
-	struct dnet_iterator_response *response;
-	static const uint64_t response_size = sizeof(struct dnet_iterator_response);
-	uint64_t size;
-	const uint64_t fsize = dsize;
-	void *combined = NULL;
-	char *data_read;
-	int err = 0;
-	uint64_t iterated_keys = 0;
-
-	/* Sanity */
-	if (ipriv == NULL || key == NULL || fd < 0 || elist == NULL)
-		return -EINVAL;
+	struct dnet_net_state *st = send->state;
+	struct dnet_node *n = st->n;
+	struct dnet_server_send_diff_fetch f;
+	struct dnet_iterator_request *req;
+	struct dnet_trans_control ctl;
+	struct dnet_session *s;
+	size_t size = sizeof(struct dnet_iterator_request) + ireq->range_num * sizeof(struct dnet_iterator_range);
+	char tmp[] = "/tmp/dnet-diff-XXXXXX";
+	int err;
 
-	iterated_keys = atomic_inc(&ipriv->iterated_keys);
+	memset(&f, 0, sizeof(f));
+	pthread_mutex_init(&f.lock, NULL);
+	pthread_cond_init(&f.wait, NULL);
 
-	/* If DNET_IFLAGS_TS_RANGE is set... */
-	if (ipriv->req->flags & DNET_IFLAGS_TS_RANGE) {
-		/* ...skip ts not in ts range */
-		if (dnet_time_cmp(&elist->timestamp, &ipriv->req->time_begin) < 0 ||
-		    dnet_time_cmp(&elist->timestamp, &ipriv->req->time_end) > 0) {
-			goto key_skipped;
-		}
+	f.fd = mkstemp(tmp);
+	if (f.fd < 0) {
+		err = -errno;
+		goto err_out_destroy;
 	}
+	unlink(tmp);
 
-	/* Set data to NULL in case it's not requested */
-	if (!(ipriv->req->flags & DNET_IFLAGS_DATA)) {
-		dsize = 0;
+	req = calloc(1, size);
+	if (!req) {
+		err = -ENOMEM;
+		goto err_out_close;
 	}
+
+	req->action = DNET_ITERATOR_ACTION_START;
+	req->itype = DNET_ITYPE_NETWORK;
+	req->flags = ireq->range_num ? DNET_IFLAGS_KEY_RANGE : 0;
+	req->range_num = ireq->range_num;
+	memcpy(req + 1, irange, ireq->range_num * sizeof(struct dnet_iterator_range));
+	dnet_convert_iterator_request(req);
+
+	s = dnet_session_create(n);
+	if (!s) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	dnet_session_set_trace_id(s, send->cmd.trace_id);
+	dnet_session_set_trace_bit(s, !!(send->cmd.flags & DNET_FLAGS_TRACE_BIT));
+	/* transaction timeout is restarted by every response, so it only limits silence of remote iterator */
+	dnet_session_set_timeout(s, send->timeout > 60 ? send->timeout : 60);
+
+	memset(&ctl, 0, sizeof(struct dnet_trans_control));
+	if (ireq->range_num)
+		memcpy(ctl.id.id, irange[0].key_begin.id, DNET_ID_SIZE);
+	ctl.id.group_id = group;
+	ctl.cmd = DNET_CMD_ITERATOR;
+	ctl.cflags = DNET_FLAGS_NEED_ACK | DNET_FLAGS_BACKGROUND;
+	ctl.data = req;
+	ctl.size = size;
+	ctl.complete = dnet_server_send_diff_complete;
+	ctl.priv = &f;
+
+	err = dnet_trans_alloc_send(s, &ctl);
+	dnet_session_destroy(s);
+
+	/* completion is invoked with destroyed transaction even if sending has failed */
+	pthread_mutex_lock(&f.lock);
+	while (!f.done)
+		pthread_cond_wait(&f.wait, &f.lock);
+	pthread_mutex_unlock(&f.lock);
+
+	if (!err)
+		err = f.err;
+	if (err)
+		goto err_out_free;
+
+	if (f.size) {
+		err = dnet_iterator_response_container_sort(f.fd, f.size);
+		if (err)
+			goto err_out_free;
+	}
+
+	map->fd = f.fd;
+	map->size = f.size;
+	if (f.size) {
+		err = dnet_data_map(map);
+		if (err) {
+			map->fd = -1;
+			goto err_out_free;
+		}
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "%s: fetched metadata of %llu keys from group %d",
+			dnet_dump_id(&send->cmd.id),
+			(unsigned long long)(f.size / sizeof(struct dnet_iterator_response)), group);
+
+	free(req);
+	pthread_cond_destroy(&f.wait);
+	pthread_mutex_destroy(&f.lock);
+	return 0;
+
+err_out_free:
+	free(req);
+err_out_close:
+	close(f.fd);
+err_out_destroy:
+	pthread_cond_destroy(&f.wait);
+	pthread_mutex_destroy(&f.lock);
+	dnet_log(n, DNET_LOG_ERROR, "%s: failed to fetch metadata from group %d: %d",
+			dnet_dump_id(&send->cmd.id), group, err);
+	return err;
+}
+
+static int dnet_server_send_diff_init(struct dnet_server_send_ctl *send, struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
+{
+	int i, err;
+
+	send->diffs = calloc(send->group_num, sizeof(struct dnet_map_fd));
+	if (!send->diffs)
+		return -ENOMEM;
+
+	for (i = 0; i < send->group_num; ++i)
+		send->diffs[i].fd = -1;
+
+	for (i = 0; i < send->group_num; ++i) {
+		err = dnet_server_send_diff_fetch(send, ireq, irange, send->groups[i], &send->diffs[i]);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns non-zero if sorted metadata @map doesn't have @re key with the same or newer timestamp
+ */
+static int dnet_server_send_diff_needed(struct dnet_map_fd *map, struct dnet_iterator_response *re)
+{
+	const struct dnet_iterator_response *responses = map->data;
+	struct dnet_iterator_response remote;
+	uint64_t low = 0, high = map->size / sizeof(struct dnet_iterator_response);
+
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+
+		if (dnet_id_cmp_str(responses[mid].key.id, re->key.id) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low == map->size / sizeof(struct dnet_iterator_response) ||
+			dnet_id_cmp_str(responses[low].key.id, re->key.id))
+		return 1;
+
+	/* equal keys are sorted by timestamp in descending order */
+	remote = responses[low];
+	dnet_convert_iterator_response(&remote);
+
+	return dnet_time_cmp(&remote.timestamp, &re->timestamp) < 0;
+}
+
+/*!
+ * Internal callback that sends result to different server in the storage as WRITE command
+ */
+static int dnet_iterator_callback_server_send(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
+{
+	struct dnet_server_send_ctl *send = priv;
+	struct dnet_net_state *st = send->state;
+	struct dnet_iterator_response *re = data;
+	int diff_groups[send->group_num];
+	int *groups = send->groups;
+	int group_num = send->group_num;
+	int err;
+
+	dnet_convert_iterator_response(re);
+
+	/*
+	 * Skip sending uncommitted keys to remote servers - we can not write them
+	 * since this will commit those keys on remote nodes, while they are uncommitted here locally.
+	 */
+	if (re->flags & DNET_RECORD_FLAGS_UNCOMMITTED) {
+		err = dnet_send_reply(send->state, &send->cmd, data, dsize, 1);
+		if (err && !send->write_error)
+			send->write_error = err;
+		return err;
+	}
+
+	/* deduplicated record is not stored contiguously, client recovers it by read and write */
+	if (re->flags & DNET_RECORD_FLAGS_DEDUP) {
+		re->status = -ENOTSUP;
+		dnet_convert_iterator_response(re);
+		err = dnet_send_reply(send->state, &send->cmd, data, dsize, 1);
+		if (err && !send->write_error)
+			send->write_error = err;
+		return err;
+	}
+
+	if (send->diffs) {
+		int i;
+
+		groups = diff_groups;
+		group_num = 0;
+
+		for (i = 0; i < send->group_num; ++i) {
+			if (dnet_server_send_diff_needed(&send->diffs[i], re))
+				groups[group_num++] = send->groups[i];
+		}
+
+		if (!group_num) {
+			if (atomic_inc(&send->diff_skipped) % 10000 != 0)
+				return send->write_error;
+
+			/* keepalive for keys which are not sent anywhere */
+			re->status = 1;
+			dnet_convert_iterator_response(re);
+			err = dnet_send_reply(send->state, &send->cmd, re, sizeof(struct dnet_iterator_response), 1);
+			return err ? err : send->write_error;
+		}
+	}
+
+	if ((send->iflags & DNET_IFLAGS_BULK_WRITE) && re->size <= DNET_SERVER_SEND_BULK_KEY_SIZE)
+		err = dnet_server_send_bulk_write(send, groups, group_num, re, dsize, fd, data_offset);
+	else
+		err = dnet_server_send_write_groups(send, groups, group_num, re, dsize, fd, data_offset);
+
+	/* stop iterator if an error is occurred during write */
+	if (!err)
+		err = send->write_error;
+
+	if (atomic_read(&send->bytes_pending) > send->bytes_pending_max) {
+		/* packed keys are counted as pending, they will not be completed until bulks are sent */
+		dnet_server_send_bulk_flush(send);
+
+		pthread_mutex_lock(&send->write_lock);
+
+		while ((atomic_read(&send->bytes_pending) > send->bytes_pending_max / 2) &&
+				!st->__need_exit && !send->write_error) {
+			pthread_cond_wait(&send->write_wait, &send->write_lock);
+		}
+
+		pthread_mutex_unlock(&send->write_lock);
+	}
+
+	return err;
+}
+
+/*!
+ * This routine decides whenever it's time for iterator to pause/cancel.
+ *
+ * While state is 'paused' - wait on condition variable.
+ * While memory governor reports critical pressure - wait for queued replies to be sent.
+ * If state is 'canceled' - exit with error.
+ */
+static int dnet_iterator_flow_control(struct dnet_iterator_common_private *ipriv)
+{
+	struct dnet_node *n = ipriv->n;
+	struct timespec deadline;
+	int err = 0;
+
+	pthread_mutex_lock(&ipriv->it->lock);
+	for (;;) {
+		while (ipriv->it->state == DNET_ITERATOR_ACTION_PAUSE)
+			err = pthread_cond_wait(&ipriv->it->wait, &ipriv->it->lock);
+		if (ipriv->it->state == DNET_ITERATOR_ACTION_CANCEL) {
+			err = -ENOEXEC;
+			break;
+		}
+
+		if (dnet_need_exit(n) || dnet_memory_pressure(n, DNET_MEMORY_SEND) != DNET_MEMORY_PRESSURE_CRITICAL)
+			break;
+
+		/* cancel and pause signal @wait, so they are not delayed by this sleep */
+		__sync_add_and_fetch(&n->memory.iterator_pauses, 1);
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += 100 * 1000 * 1000;
+		if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000 * 1000 * 1000;
+		}
+		pthread_cond_timedwait(&ipriv->it->wait, &ipriv->it->lock, &deadline);
+		err = 0;
+	}
+	pthread_mutex_unlock(&ipriv->it->lock);
+
+	return err;
+}
+
+/*
+ * Updates position of the current record of DNET_IFLAGS_CHECKPOINTS iterator,
+ * returns 1 if the record precedes checkpoint iteration resumes from and has to be skipped
+ */
+static int dnet_iterator_checkpoint_update(struct dnet_iterator_common_private *ipriv, int fd)
+{
+	struct stat st;
+
+	/* backend keeps files open during iteration, so fd changes only when the next file is iterated */
+	if (fd != ipriv->last_fd) {
+		if (fstat(fd, &st))
+			return -errno;
+
+		ipriv->last_fd = fd;
+		if ((uint64_t)st.st_ino != ipriv->current.blob) {
+			ipriv->current.blob = st.st_ino;
+			ipriv->current.position = 0;
+		}
+	}
+	ipriv->current.position++;
+
+	if (!ipriv->resume.blob)
+		return 0;
+
+	if (ipriv->current.blob == ipriv->resume.blob) {
+		ipriv->resume_found = 1;
+		if (ipriv->current.position <= ipriv->resume.position)
+			return 1;
+	} else if (!ipriv->resume_found) {
+		return 1;
+	}
+
+	/* checkpoint has been passed, the rest records are processed as usual */
+	ipriv->resume.blob = 0;
+	return 0;
+}
+
+/*
+ * Sends checkpoint of DNET_IFLAGS_CHECKPOINTS iterator after every DNET_ITERATOR_CHECKPOINT_KEYS processed keys,
+ * it is sent via the same callback as keys, so the client gets it after all preceding keys
+ */
+static int dnet_iterator_checkpoint_send(struct dnet_iterator_common_private *ipriv, int fd, uint64_t data_offset)
+{
+	struct {
+		struct dnet_iterator_response	re;
+		struct dnet_iterator_checkpoint	checkpoint;
+	} __attribute__ ((packed)) reply;
+	uint64_t iterated_keys;
+
+	if (++ipriv->checkpoint_keys < DNET_ITERATOR_CHECKPOINT_KEYS)
+		return 0;
+	ipriv->checkpoint_keys = 0;
+
+	iterated_keys = atomic_read(&ipriv->iterated_keys);
+
+	memset(&reply, 0, sizeof(reply));
+	reply.re.status = DNET_ITERATOR_STATUS_CHECKPOINT;
+	reply.re.size = sizeof(struct dnet_iterator_checkpoint);
+	reply.re.total_keys = ipriv->total_keys;
+	reply.re.iterated_keys = iterated_keys;
+	dnet_convert_iterator_response(&reply.re);
+
+	reply.checkpoint = ipriv->current;
+	reply.checkpoint.iterated_keys = iterated_keys;
+	dnet_convert_iterator_checkpoint(&reply.checkpoint);
+
+	return ipriv->next_callback(ipriv->next_private, &reply, sizeof(reply), fd, data_offset);
+}
+
+/*!
+ * Common callback part that is run by all iterator types.
+ * It's responsible for sanity checks and flow control.
+ *
+ * Also now it "prepares" data for next callback by combining data itself with
+ * fixed-size response header.
+ */
+static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key, uint64_t flags,
+                                         int fd, uint64_t data_offset, uint64_t dsize, struct dnet_ext_list *elist)
+{
+	struct dnet_iterator_common_private *ipriv = priv;
+	struct dnet_iterator_response *response;
+	static const uint64_t response_size = sizeof(struct dnet_iterator_response);
+	uint64_t size;
+	uint64_t fsize = dsize;
+	void *combined = NULL;
+	char *data_read;
+	int err = 0, resume_skip = 0;
+	uint64_t iterated_keys = 0;
+
+	/* Sanity */
+	if (ipriv == NULL || key == NULL || fd < 0 || elist == NULL)
+		return -EINVAL;
+
+	if (ipriv->req->flags & DNET_IFLAGS_CHECKPOINTS) {
+		resume_skip = dnet_iterator_checkpoint_update(ipriv, fd);
+		if (resume_skip < 0)
+			return resume_skip;
+
+		/* records before the checkpoint have been sent and accounted already */
+		if (resume_skip) {
+			iterated_keys = atomic_read(&ipriv->iterated_keys);
+			goto key_skipped;
+		}
+	}
+
+	iterated_keys = atomic_inc(&ipriv->iterated_keys);
+
+	/* If DNET_IFLAGS_TS_RANGE is set... */
+	if (ipriv->req->flags & DNET_IFLAGS_TS_RANGE) {
+		/* ...skip ts not in ts range */
+		if (dnet_time_cmp(&elist->timestamp, &ipriv->req->time_begin) < 0 ||
+		    dnet_time_cmp(&elist->timestamp, &ipriv->req->time_end) > 0) {
+			goto key_skipped;
+		}
+	}
+
+	if (ipriv->filters) {
+		struct dnet_iterator_filter_record rec;
+
+		memset(&rec, 0, sizeof(struct dnet_iterator_filter_record));
+		rec.key = *key;
+		rec.timestamp = elist->timestamp;
+		rec.user_flags = elist->flags;
+		rec.flags = flags;
+		rec.fd = fd;
+		rec.offset = data_offset;
+		rec.size = fsize;
+
+		err = dnet_record_filters_apply(ipriv->filters, DNET_CMD_ITERATOR, &rec, 1);
+		if (err < 0)
+			goto err_out_exit;
+		if (err == DNET_RECORD_FILTER_SKIP) {
+			err = 0;
+			goto key_skipped;
+		}
+
+		/* the rest is done with narrowed data as if it was the whole record */
+		data_offset = rec.offset;
+		dsize = fsize = rec.size;
+	}
+
+	/* Set data to NULL in case it's not requested */
+	if (!(ipriv->req->flags & DNET_IFLAGS_DATA)) {
+		dsize = 0;
+	}
+
+	/* data of deduplicated record is scattered over its chunks, it has to be read by the key */
+	if (flags & DNET_RECORD_FLAGS_DEDUP)
+		dsize = 0;
+
 	size = response_size + dsize;
 
+	/* server-send reads the data by itself, it is accounted like the data sent to client */
+	dnet_throttle_wait(&ipriv->throttle, ipriv->backend_throttle,
+			(dsize || ipriv->req->itype == DNET_ITYPE_SERVER_SEND) ? fsize : 0, 1);
+
 	/* Prepare combined buffer */
 	combined = malloc(size);
 	if (combined == NULL) {
@@ -928,6 +2367,8 @@ static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key, ui
 	response->total_keys = ipriv->total_keys;
 	response->iterated_keys = iterated_keys;
 	response->flags = flags;
+	if ((flags & DNET_RECORD_FLAGS_DEDUP) && (ipriv->req->flags & DNET_IFLAGS_DATA))
+		response->status = -ENOTSUP;
 	dnet_convert_iterator_response(response);
 
 	if (dsize) {
@@ -971,9 +2412,75 @@ key_skipped:
 
 err_out_exit:
 	free(combined);
+
+	if (!err && !resume_skip && (ipriv->req->flags & DNET_IFLAGS_CHECKPOINTS))
+		err = dnet_iterator_checkpoint_send(ipriv, fd, data_offset);
 	return err;
 }
 
+/*
+ * Callback of DNET_IFLAGS_CHANGES iterator, it filters change log records by key and timestamp ranges
+ * like backend iterator and dnet_iterator_callback_common() filter backend records
+ */
+static int dnet_iterator_callback_changes(void *priv, const struct dnet_change_log_record *rec, uint64_t pos,
+		uint64_t total)
+{
+	struct dnet_iterator_common_private *ipriv = priv;
+	struct dnet_iterator_response re;
+	uint64_t i;
+	int err;
+
+	if (ipriv->req->flags & DNET_IFLAGS_KEY_RANGE) {
+		for (i = 0; i < ipriv->req->range_num; ++i) {
+			if (dnet_id_cmp_str(rec->key.id, ipriv->range[i].key_begin.id) >= 0 &&
+			    dnet_id_cmp_str(rec->key.id, ipriv->range[i].key_end.id) <= 0)
+				break;
+		}
+
+		if (i == ipriv->req->range_num)
+			goto key_skipped;
+	}
+
+	if (ipriv->req->flags & DNET_IFLAGS_TS_RANGE) {
+		if (dnet_time_cmp(&rec->timestamp, &ipriv->req->time_begin) < 0 ||
+		    dnet_time_cmp(&rec->timestamp, &ipriv->req->time_end) > 0)
+			goto key_skipped;
+	}
+
+	atomic_inc(&ipriv->iterated_keys);
+	atomic_set(&ipriv->skipped_keys, 0);
+
+	dnet_throttle_wait(&ipriv->throttle, ipriv->backend_throttle, 0, 1);
+
+	memset(&re, 0, sizeof(struct dnet_iterator_response));
+	re.key = rec->key;
+	re.timestamp = rec->timestamp;
+	re.size = rec->size;
+	re.flags = rec->flags;
+	re.change_time = rec->change_time;
+	re.iterated_keys = pos;
+	re.total_keys = total;
+	dnet_convert_iterator_response(&re);
+
+	err = ipriv->next_callback(ipriv->next_private, &re, sizeof(struct dnet_iterator_response), -1, 0);
+	if (err)
+		return err;
+
+	return dnet_iterator_flow_control(ipriv);
+
+key_skipped:
+	if (atomic_inc(&ipriv->skipped_keys) % 10000 != 0)
+		return 0;
+
+	memset(&re, 0, sizeof(struct dnet_iterator_response));
+	re.status = 1;
+	re.iterated_keys = pos;
+	re.total_keys = total;
+	dnet_convert_iterator_response(&re);
+
+	return ipriv->next_callback(ipriv->next_private, &re, sizeof(struct dnet_iterator_response), -1, 0);
+}
+
 static int dnet_iterator_check_key_range(struct dnet_net_state *st, struct dnet_cmd *cmd,
 		struct dnet_iterator_request *ireq,
 		struct dnet_iterator_range *irange)
@@ -1069,10 +2576,15 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 {
 	struct dnet_iterator_range *irange = (struct dnet_iterator_range *)(ireq + 1);
 	int *dst_groups = (int *)(irange + ireq->range_num);
+	struct dnet_iterator_checkpoint *checkpoint = (struct dnet_iterator_checkpoint *)(dst_groups + ireq->group_num);
+	/* name of DNET_ITYPE_FILTER filter and its argument */
+	char *filter_spec = (char *)checkpoint +
+		((ireq->flags & DNET_IFLAGS_CHECKPOINTS) ? sizeof(struct dnet_iterator_checkpoint) : 0);
 
 	struct dnet_iterator_common_private cpriv = {
 		.req = ireq,
 		.range = irange,
+		.n = st->n,
 	};
 	struct dnet_iterator_ctl ictl = {
 		.iterate_private = backend->cb->command_private,
@@ -1080,12 +2592,21 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 		.callback_private = &cpriv,
 	};
 	struct dnet_iterator_send_private spriv;
+	struct dnet_iterator_ordered_private opriv;
+	struct dnet_reply_batch batch;
 	struct dnet_iterator_file_private fpriv;
 	struct dnet_server_send_ctl *sspriv;
+	struct dnet_iterator_hash_private hpriv;
+	struct dnet_iterator_filter_private fltpriv;
 	int err = 0;
 
-	/* Check that backend supports iterator */
-	if (!backend->cb->iterator) {
+	err = dnet_throttle_init(&cpriv.throttle, ireq->rate_bytes, ireq->rate_keys);
+	if (err)
+		return err;
+	cpriv.backend_throttle = &backend->background_throttle;
+
+	/* Check that backend supports iterator */
+	if (!backend->cb->iterator) {
 		err = -ENOTSUP;
 		dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: backend doesn't support iteration",
 		         dnet_dump_id(&cmd->id));
@@ -1108,13 +2629,74 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 		goto err_out_exit;
 	}
 
+	if (ireq->threads > DNET_ITERATOR_MAX_THREADS) {
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: iterator threads: %" PRIu32 " are limited to %d",
+		         dnet_dump_id(&cmd->id), ireq->threads, DNET_ITERATOR_MAX_THREADS);
+		ireq->threads = DNET_ITERATOR_MAX_THREADS;
+	}
+
 	/* Check ranges */
 	if ((err = dnet_iterator_check_key_range(st, cmd, ireq, irange)) ||
 	    (err = dnet_iterator_check_ts_range(st, cmd, ireq)))
 		goto err_out_exit;
 
+	if (ireq->flags & DNET_IFLAGS_FILTER) {
+		if (!backend->record_filters) {
+			err = -ENOTSUP;
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: backend has no record filters",
+					dnet_dump_id(&cmd->id));
+			goto err_out_exit;
+		}
+
+		cpriv.filters = backend->record_filters;
+	}
+
+	if (ireq->flags & DNET_IFLAGS_CHANGES) {
+		if (ireq->itype != DNET_ITYPE_NETWORK || (ireq->flags & (DNET_IFLAGS_DATA | DNET_IFLAGS_FILTER)) ||
+				!backend->change_log) {
+			err = -ENOTSUP;
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: changes can be iterated only by network "
+					"iterator without data and filters on backend with change log, change log: %s",
+					dnet_dump_id(&cmd->id), backend->change_log ? "enabled" : "disabled");
+			goto err_out_exit;
+		}
+
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: iterating changes since: %" PRIu64,
+				dnet_dump_id(&cmd->id), ireq->changes_since);
+	}
+
 	atomic_init(&cpriv.iterated_keys, 0);
 
+	if (ireq->flags & DNET_IFLAGS_ORDERED) {
+		if (ireq->itype != DNET_ITYPE_NETWORK ||
+				(ireq->flags & (DNET_IFLAGS_DATA | DNET_IFLAGS_CHECKPOINTS | DNET_IFLAGS_CHANGES))) {
+			err = -ENOTSUP;
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: keys can be ordered only by network "
+					"iterator of backend records without data and checkpoints",
+					dnet_dump_id(&cmd->id));
+			goto err_out_exit;
+		}
+	}
+
+	if (ireq->flags & DNET_IFLAGS_CHECKPOINTS) {
+		if (ireq->itype != DNET_ITYPE_NETWORK || ireq->threads > 1 || (ireq->flags & DNET_IFLAGS_CHANGES)) {
+			err = -ENOTSUP;
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: checkpoints are supported only by "
+					"single-threaded network iterator of backend records",
+					dnet_dump_id(&cmd->id));
+			goto err_out_exit;
+		}
+
+		dnet_convert_iterator_checkpoint(checkpoint);
+		cpriv.resume = *checkpoint;
+		cpriv.last_fd = -1;
+		atomic_set(&cpriv.iterated_keys, cpriv.resume.iterated_keys);
+
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: resuming from checkpoint: blob: %" PRIu64 ", position: %" PRIu64
+				", iterated_keys: %" PRIu64, dnet_dump_id(&cmd->id),
+				cpriv.resume.blob, cpriv.resume.position, cpriv.resume.iterated_keys);
+	}
+
 	if (backend->cb->total_elements)
 		cpriv.total_keys = backend->cb->total_elements(backend->cb->command_private);
 	else
@@ -1127,8 +2709,37 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 		spriv.st = st;
 		spriv.cmd = cmd;
 
+		if (ireq->flags & DNET_IFLAGS_COMPACT) {
+			if (ireq->flags & DNET_IFLAGS_DATA) {
+				err = -ENOTSUP;
+				dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: compact replies can not carry data",
+				         dnet_dump_id(&cmd->id));
+				goto err_out_exit;
+			}
+		}
+
+		if (ireq->flags & (DNET_IFLAGS_BATCH_REPLIES | DNET_IFLAGS_COMPACT)) {
+			err = dnet_reply_batch_init(&batch, st, cmd);
+			if (err)
+				goto err_out_exit;
+			batch.compact = !!(ireq->flags & DNET_IFLAGS_COMPACT);
+			spriv.batch = &batch;
+		}
+
 		cpriv.next_callback = dnet_iterator_callback_send;
 		cpriv.next_private = &spriv;
+
+		if (ireq->flags & DNET_IFLAGS_ORDERED) {
+			err = dnet_iterator_ordered_init(&opriv, &spriv);
+			if (err) {
+				if (spriv.batch)
+					dnet_reply_batch_destroy(spriv.batch);
+				goto err_out_exit;
+			}
+
+			cpriv.next_callback = dnet_iterator_callback_ordered;
+			cpriv.next_private = &opriv;
+		}
 		break;
 	case DNET_ITYPE_DISK:
 		memset(&fpriv, 0, sizeof(struct dnet_iterator_file_private));
@@ -1174,9 +2785,39 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 		sspriv->iflags = ireq->flags;
 		sspriv->backend_id = backend->backend_id;
 
+		if (ireq->flags & DNET_IFLAGS_DIFF) {
+			err = dnet_server_send_diff_init(sspriv, ireq, irange);
+			if (err) {
+				dnet_server_send_put(sspriv);
+				goto err_out_exit;
+			}
+		}
+
 		cpriv.next_callback = dnet_iterator_callback_server_send;
 		cpriv.next_private = sspriv;
 		break;
+	case DNET_ITYPE_HASH:
+		/* only metadata is hashed, there is no need to read the data */
+		ireq->flags &= ~DNET_IFLAGS_DATA;
+
+		err = dnet_iterator_hash_init(&hpriv, st, cmd, ireq, irange);
+		if (err)
+			goto err_out_exit;
+
+		cpriv.next_callback = dnet_iterator_callback_hash;
+		cpriv.next_private = &hpriv;
+		break;
+	case DNET_ITYPE_FILTER:
+		/* filter gets descriptor of the data and reads only what it needs */
+		ireq->flags &= ~DNET_IFLAGS_DATA;
+
+		err = dnet_iterator_filter_init(&fltpriv, st, cmd, filter_spec, ireq->filter_size);
+		if (err)
+			goto err_out_exit;
+
+		cpriv.next_callback = dnet_iterator_callback_filter;
+		cpriv.next_private = &fltpriv;
+		break;
 	default:
 		err = -EINVAL;
 		dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: unknown iteration type: %" PRIu32,
@@ -1192,7 +2833,18 @@ static int dnet_iterator_start(struct dnet_backend_io *backend, struct dnet_net_
 	}
 
 	/* Run iterator */
-	err = backend->cb->iterator(&ictl, ireq, irange);
+	if (ireq->flags & DNET_IFLAGS_CHANGES)
+		err = dnet_change_log_iterate(backend->change_log, ireq->changes_since,
+				dnet_iterator_callback_changes, &cpriv);
+	else
+		err = backend->cb->iterator(&ictl, ireq, irange);
+
+	/* file of the checkpoint has been removed or rewritten, iteration has to be started over */
+	if (!err && cpriv.resume.blob && !cpriv.resume_found) {
+		err = -ESTALE;
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: iteration failed: checkpoint blob: %" PRIu64 " not found",
+				dnet_dump_id(&cmd->id), cpriv.resume.blob);
+	}
 
 	/* Remove iterator */
 	dnet_iterator_destroy(st->n, cpriv.it);
@@ -1204,12 +2856,39 @@ err_out_put:
 			err = sserr;
 	}
 
+	if (ireq->itype == DNET_ITYPE_HASH) {
+		if (!err)
+			err = dnet_iterator_hash_send(&hpriv, cpriv.total_keys);
+		free(hpriv.entries);
+	}
+
+	if (ireq->itype == DNET_ITYPE_FILTER) {
+		if (!err)
+			err = dnet_iterator_filter_finish(&fltpriv, cpriv.total_keys);
+		dnet_iterator_filter_cleanup(&fltpriv);
+	}
+
+	if (ireq->itype == DNET_ITYPE_NETWORK && (ireq->flags & DNET_IFLAGS_ORDERED)) {
+		if (!err)
+			err = dnet_iterator_ordered_send(&opriv);
+		dnet_iterator_ordered_destroy(&opriv);
+	}
+
+	/* pending responses must be sent before final ack */
+	if (ireq->itype == DNET_ITYPE_NETWORK && spriv.batch) {
+		int berr = dnet_reply_batch_destroy(spriv.batch);
+		if (!err)
+			err = berr;
+	}
+
 err_out_exit:
+	dnet_throttle_destroy(&cpriv.throttle);
 	dnet_log(st->n, err ? DNET_LOG_ERROR : DNET_LOG_NOTICE, "%s: %s: iteration finished: "
-		"iterated_keys: %ld/%lld, skipped_keys: %ld, err: %d",
+		"iterated_keys: %ld/%lld, skipped_keys: %ld, threads: %" PRIu32 ", err: %d",
 			__func__, dnet_dump_id(&cmd->id),
 			atomic_read(&cpriv.iterated_keys), (unsigned long long)cpriv.total_keys,
 			atomic_read(&cpriv.skipped_keys),
+			ireq->threads ? ireq->threads : 1,
 			err);
 	return err;
 }
@@ -1231,7 +2910,9 @@ static int dnet_cmd_iterator(struct dnet_backend_io *backend, struct dnet_net_st
 
 	if (sizeof(struct dnet_iterator_request) +
 		ireq->range_num * sizeof(struct dnet_iterator_range) +
-		ireq->group_num * sizeof(int) != cmd->size) {
+		ireq->group_num * sizeof(int) +
+		((ireq->flags & DNET_IFLAGS_CHECKPOINTS) ? sizeof(struct dnet_iterator_checkpoint) : 0) +
+		ireq->filter_size != cmd->size) {
 		dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid iterator request: "
 				"%s: id: %" PRIu64 ", action: %d, ranges: %" PRIu64 ", groups: %d: size mismatch",
 				__func__,
@@ -1270,51 +2951,668 @@ err_out_exit:
 	return err;
 }
 
-static int dnet_cmd_bulk_read(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+/*
+ * Bulk read is split into separate read requests which are put into backend's pool
+ * and processed by all its threads in parallel, key locks are taken by request queue as usual.
+ * Context is shared by all sub-requests, every sub-request sends replies as soon as it is completed,
+ * the last one sends final ack for the whole bulk read.
+ */
+struct dnet_bulk_read {
+	atomic_t		refcnt;
+	pthread_mutex_t		lock;
+	/* 0 if at least one key has been read, the first error otherwise */
+	int			err;
+	struct dnet_net_state	*st;
+	struct dnet_cmd		cmd;
+};
+
+struct dnet_bulk_read_entry {
+	struct dnet_io_attr	*io;
+	int			fd;
+	uint64_t		offset;
+	/* size of the requested part of the record */
+	uint64_t		size;
+};
+
+/*
+ * Sorted keys which are closer than @DNET_BULK_READ_MERGE_GAP to each other are prefetched
+ * by a single sequential read of up to @DNET_BULK_READ_MERGE_MAX bytes
+ */
+#define DNET_BULK_READ_MERGE_GAP	(128 * 1024)
+#define DNET_BULK_READ_MERGE_MAX	(16 * 1024 * 1024)
+
+static void dnet_bulk_read_update_err(struct dnet_bulk_read *b, int err)
 {
-	int err = -1, ret;
-	struct dnet_io_attr *io = data;
-	struct dnet_io_attr *ios = io + 1;
-	uint64_t count = 0;
-	uint64_t i;
-	int use_oplock;
-	struct dnet_id lock_id = { .group_id = cmd->id.group_id };
+	pthread_mutex_lock(&b->lock);
+	if (!err)
+		b->err = 0;
+	else if (b->err == -1)
+		b->err = err;
+	pthread_mutex_unlock(&b->lock);
+}
+
+static void dnet_bulk_read_put(struct dnet_bulk_read *b)
+{
+	if (!atomic_dec_and_test(&b->refcnt))
+		return;
+
+	dnet_send_ack(b->st, &b->cmd, b->err, 0);
+
+	dnet_log(b->st->n, DNET_LOG_NOTICE, "%s: finished BULK_READ, err: %d",
+		dnet_dump_id(&b->cmd.id), b->err);
+
+	dnet_state_put(b->st);
+	pthread_mutex_destroy(&b->lock);
+	free(b);
+}
+
+static void dnet_bulk_read_complete(struct dnet_io_req *r, int err)
+{
+	struct dnet_bulk_read *b = r->priv;
+	struct dnet_cmd *cmd = r->header;
+
+	/* sub-request is processed without ack, send it here keeping DNET_FLAGS_MORE */
+	if (b->cmd.flags & DNET_FLAGS_NEED_ACK) {
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+		dnet_send_ack(b->st, cmd, err, 1);
+	}
+
+	dnet_bulk_read_update_err(b, err);
+	dnet_bulk_read_put(b);
+}
+
+static int dnet_bulk_read_entry_cmp(const void *p1, const void *p2)
+{
+	const struct dnet_bulk_read_entry *e1 = p1;
+	const struct dnet_bulk_read_entry *e2 = p2;
+
+	if (e1->fd != e2->fd)
+		return e1->fd < e2->fd ? -1 : 1;
+	if (e1->offset != e2->offset)
+		return e1->offset < e2->offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Sorts keys by their position on disk if backend is able to tell it,
+ * keys which were not found go to the end of the list.
+ * Returns zero if backend can not tell it, entries then have only their keys set.
+ */
+static int dnet_bulk_read_sort(struct dnet_backend_io *backend, struct dnet_node *n,
+		struct dnet_bulk_read_entry *entries, uint64_t count)
+{
+	struct dnet_io_local io;
+	uint64_t i, offset, size;
+	int err;
+
+	if (!backend->cb->lookup)
+		return 0;
+
+	for (i = 0; i < count; ++i) {
+		memset(&io, 0, sizeof(struct dnet_io_local));
+		memcpy(io.key, entries[i].io->id, DNET_ID_SIZE);
+		io.fd = -1;
+
+		err = backend->cb->lookup(n, backend->cb->command_private, &io);
+		if (err || io.fd < 0) {
+			entries[i].fd = INT_MAX;
+			entries[i].offset = 0;
+			continue;
+		}
+
+		/* attributes of the keys are converted by their own read commands */
+		offset = dnet_bswap64(entries[i].io->offset);
+		size = dnet_bswap64(entries[i].io->size);
+
+		if (offset > io.total_size) {
+			entries[i].fd = INT_MAX;
+			entries[i].offset = 0;
+			continue;
+		}
+
+		entries[i].fd = io.fd;
+		entries[i].offset = io.fd_offset + offset;
+		entries[i].size = io.total_size - offset;
+		if (size && size < entries[i].size)
+			entries[i].size = size;
+	}
 
+	qsort(entries, count, sizeof(struct dnet_bulk_read_entry), dnet_bulk_read_entry_cmp);
+	return 1;
+}
+
+/*
+ * Merges adjacent extents of sorted keys and asks the kernel to read every merged run at once,
+ * so keys read by separate io threads hit page cache instead of seeking one after another
+ */
+static void dnet_bulk_read_prefetch(struct dnet_bulk_read_entry *entries, uint64_t count)
+{
+	uint64_t i, run_start = 0, run_end = 0;
+	int run_fd = INT_MAX, run_num = 0;
+
+	for (i = 0; i <= count; ++i) {
+		struct dnet_bulk_read_entry *e = i < count ? &entries[i] : NULL;
+
+		if (e && e->fd == run_fd && e->offset <= run_end + DNET_BULK_READ_MERGE_GAP &&
+				e->offset + e->size - run_start <= DNET_BULK_READ_MERGE_MAX) {
+			if (e->offset + e->size > run_end)
+				run_end = e->offset + e->size;
+			run_num++;
+			continue;
+		}
+
+		/* single record is read by its own request anyway */
+		if (run_num > 1)
+			posix_fadvise(run_fd, run_start, run_end - run_start, POSIX_FADV_WILLNEED);
+
+		/* keys which were not found are at the end of the list */
+		if (!e || e->fd == INT_MAX)
+			break;
+
+		run_fd = e->fd;
+		run_start = e->offset;
+		run_end = e->offset + e->size;
+		run_num = 1;
+	}
+}
+
+static int dnet_bulk_read_single(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io)
+{
+	struct dnet_id lock_id = { .group_id = cmd->id.group_id };
 	struct dnet_cmd read_cmd = *cmd;
+	int use_oplock, err;
+
 	read_cmd.size = sizeof(struct dnet_io_attr);
 	read_cmd.cmd = DNET_CMD_READ;
 	read_cmd.flags |= DNET_FLAGS_MORE;
 
+	/*
+	 * Bulk read key is already locked by request_queue::take_request().
+	 */
+	use_oplock = !(cmd->flags & DNET_FLAGS_NOLOCK) &&
+				dnet_id_cmp_str((const unsigned char *)&io->id, (const unsigned char *)&cmd->id.id);
+	if (use_oplock) {
+		memcpy(&lock_id.id, &io->id, DNET_ID_SIZE);
+		dnet_oplock(backend, &lock_id);
+	}
+
+	err = dnet_process_cmd_raw(backend, st, &read_cmd, io, 1);
+
+	if (use_oplock) {
+		dnet_opunlock(backend, &lock_id);
+	}
+
+	return err;
+}
+
+static int dnet_bulk_read_schedule(struct dnet_backend_io *backend, struct dnet_bulk_read *b, struct dnet_io_attr *io)
+{
+	struct dnet_io_req *r;
+	struct dnet_cmd *cmd;
+	int err;
+
+	r = malloc(sizeof(struct dnet_io_req) + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr));
+	if (!r)
+		return -ENOMEM;
+
+	memset(r, 0, sizeof(struct dnet_io_req));
+	r->fd = -1;
+
+	cmd = (struct dnet_cmd *)(r + 1);
+	*cmd = b->cmd;
+	dnet_setup_id(&cmd->id, b->cmd.id.group_id, io->id);
+	cmd->size = sizeof(struct dnet_io_attr);
+	cmd->cmd = DNET_CMD_READ;
+	/* key has been already routed to this backend, do not forward it anywhere */
+	cmd->flags |= DNET_FLAGS_MORE | DNET_FLAGS_DIRECT;
+	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	r->header = cmd;
+	r->hsize = sizeof(struct dnet_cmd);
+	r->data = cmd + 1;
+	r->dsize = sizeof(struct dnet_io_attr);
+	memcpy(r->data, io, sizeof(struct dnet_io_attr));
+
+	r->st = dnet_state_get(b->st);
+	r->complete = dnet_bulk_read_complete;
+	r->priv = b;
+
+	atomic_inc(&b->refcnt);
+
+	err = dnet_schedule_backend_io(backend, r);
+	if (err) {
+		atomic_dec(&b->refcnt);
+		dnet_state_put(r->st);
+		free(r);
+	}
+
+	return err;
+}
+
+static int dnet_cmd_bulk_read(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	int err = -1;
+	struct dnet_io_attr *io = data;
+	struct dnet_io_attr *ios = io + 1;
+	struct dnet_bulk_read_entry *entries = NULL;
+	struct dnet_bulk_read *b = NULL;
+	uint64_t count = 0;
+	uint64_t i = 0;
+
 	dnet_convert_io_attr(io);
 	count = io->size / sizeof(struct dnet_io_attr);
 
 	dnet_log(st->n, DNET_LOG_NOTICE, "%s: starting BULK_READ for %d commands",
 		dnet_dump_id(&cmd->id), (int) count);
 
-	for (i = 0; i < count; i++) {
+	if (io->flags & DNET_IO_FLAGS_CACHE_PREFETCH)
+		return dnet_cmd_cache_prefetch(backend, cmd, ios, count);
+
+	if (count > 1) {
+		entries = malloc(count * sizeof(struct dnet_bulk_read_entry));
+		b = malloc(sizeof(struct dnet_bulk_read));
+	}
+
+	if (entries && b) {
+		atomic_init(&b->refcnt, 1);
+		pthread_mutex_init(&b->lock, NULL);
+		b->err = -1;
+		b->st = dnet_state_get(st);
+		b->cmd = *cmd;
+
+		for (i = 0; i < count; ++i)
+			entries[i].io = &ios[i];
+
+		if (dnet_bulk_read_sort(backend, st->n, entries, count))
+			dnet_bulk_read_prefetch(entries, count);
+
+		for (i = 0; i < count; ++i) {
+			if (dnet_bulk_read_schedule(backend, b, entries[i].io))
+				break;
+		}
+
+		/*
+		 * Final ack will be sent by the last completed sub-request.
+		 * Keys which could not be scheduled are read right here.
+		 */
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+		err = 0;
+	} else {
+		free(b);
+		b = NULL;
+	}
+
+	for (; i < count; ++i) {
+		struct dnet_io_attr *rio = entries ? entries[i].io : &ios[i];
+		int ret;
+
+		ret = dnet_bulk_read_single(backend, st, b ? &b->cmd : cmd, rio);
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: processing BULK_READ.READ for %d/%d command, err: %d",
+			dnet_dump_id(&cmd->id), (int) i, (int) count, ret);
+
+		if (b) {
+			dnet_bulk_read_update_err(b, ret);
+		} else if (!ret) {
+			err = 0;
+		} else if (err == -1) {
+			err = ret;
+		}
+	}
+
+	if (b)
+		dnet_bulk_read_put(b);
+	free(entries);
+
+	return err;
+}
+
+static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, struct dnet_net_state *st,
+		struct dnet_cmd *cmd, void *data, int *handled_in_cache);
+
+/*
+ * Returns number of keys in DNET_CMD_BULK_WRITE request or negative error if request is malformed
+ */
+static int64_t dnet_bulk_write_count(struct dnet_cmd *cmd, void *data)
+{
+	uint64_t offset = 0;
+	int64_t count = 0;
+
+	while (offset < cmd->size) {
+		struct dnet_io_attr io;
+
+		if (cmd->size - offset < sizeof(struct dnet_io_attr))
+			return -EINVAL;
+
+		io = *(struct dnet_io_attr *)(data + offset);
+		dnet_convert_io_attr(&io);
+
+		if (io.size > cmd->size - offset - sizeof(struct dnet_io_attr))
+			return -EINVAL;
+
+		offset += sizeof(struct dnet_io_attr) + io.size;
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * DNET_CMD_BULK_WRITE with DNET_ATTR_BULK_WRITE_STATUSES: keys are written without per-key replies
+ * within commit scope of the backend, so durable writes are synced once for the whole request.
+ * Statuses are sent together in one reply in the order of the request.
+ */
+static int dnet_cmd_bulk_write_statuses(struct dnet_backend_io *backend, struct dnet_net_state *st,
+		struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_bulk_write_reply *reply;
+	struct dnet_bulk_commit bc;
+	int32_t *statuses;
+	uint64_t offset = 0, i, written = 0;
+	int64_t count;
+	size_t reply_size;
+	int err;
+
+	count = dnet_bulk_write_count(cmd, data);
+	if (count < 0) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: invalid BULK_WRITE command: size: %llu",
+				dnet_dump_id(&cmd->id), (unsigned long long)cmd->size);
+		return count;
+	}
+
+	reply_size = sizeof(struct dnet_bulk_write_reply) + count * sizeof(int32_t);
+	reply = calloc(1, reply_size);
+	if (!reply)
+		return -ENOMEM;
+
+	statuses = (int32_t *)(reply + 1);
+
+	memset(&bc, 0, sizeof(bc));
+	dnet_bulk_commit = &bc;
+
+	for (i = 0; i < (uint64_t)count; ++i) {
+		struct dnet_io_attr *wio = data + offset;
+		struct dnet_id lock_id = { .group_id = cmd->id.group_id };
+		struct dnet_cmd write_cmd = *cmd;
+		struct dnet_io_attr io;
+		int handled_in_cache = 0, use_oplock;
+
+		io = *wio;
+		dnet_convert_io_attr(&io);
+
+		write_cmd.cmd = DNET_CMD_WRITE;
+		write_cmd.size = sizeof(struct dnet_io_attr) + io.size;
+		offset += write_cmd.size;
+
+		/* file info of the key is not sent, its status goes into the reply */
+		io.flags |= DNET_IO_FLAGS_WRITE_NO_FILE_INFO;
+		dnet_convert_io_attr(&io);
+		*wio = io;
+
+		write_cmd.flags &= ~(DNET_FLAGS_NEED_ACK | DNET_ATTR_BULK_WRITE_STATUSES);
+		memcpy(write_cmd.id.id, io.id, DNET_ID_SIZE);
+
+		/*
+		 * The first key is already locked by request_queue::take_request().
+		 */
+		use_oplock = !(cmd->flags & DNET_FLAGS_NOLOCK) && dnet_id_cmp_str(io.id, cmd->id.id);
+		if (use_oplock) {
+			memcpy(&lock_id.id, io.id, DNET_ID_SIZE);
+			dnet_oplock(backend, &lock_id);
+		}
+
+		statuses[i] = dnet_process_cmd_with_backend_raw(backend, st, &write_cmd, wio, &handled_in_cache);
+
+		if (use_oplock)
+			dnet_opunlock(backend, &lock_id);
+	}
+
+	dnet_bulk_commit = NULL;
+
+	/* keys are not durable until their files are synced */
+	err = bc.commit ? bc.commit(&bc) : 0;
+
+	for (i = 0; i < (uint64_t)count; ++i) {
+		if (!statuses[i] && err)
+			statuses[i] = err;
+		if (!statuses[i])
+			written++;
+		statuses[i] = dnet_bswap32(statuses[i]);
+	}
+
+	reply->num = count;
+	reply->written = written;
+	dnet_convert_bulk_write_reply(reply);
+
+	err = dnet_send_reply(st, cmd, reply, reply_size, 1);
+
+	dnet_log(n, DNET_LOG_NOTICE, "%s: BULK_WRITE: written %llu of %lld keys, synced files: %d, err: %d",
+			dnet_dump_id(&cmd->id), (unsigned long long)written, (long long)count, bc.fd_num, err);
+
+	free(reply);
+	return err;
+}
+
+/*
+ * Every key of DNET_CMD_BULK_WRITE is written as separate WRITE command, which replies with the key's status,
+ * so the client gets per-key results and the final ack of the whole request.
+ */
+static int dnet_cmd_bulk_write(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	uint64_t offset = 0, count = 0;
+	int err = 0;
+
+	if (cmd->flags & DNET_ATTR_BULK_WRITE_STATUSES)
+		return dnet_cmd_bulk_write_statuses(backend, st, cmd, data);
+
+	while (offset < cmd->size) {
+		struct dnet_io_attr *wio = data + offset;
+		struct dnet_id lock_id = { .group_id = cmd->id.group_id };
+		struct dnet_cmd write_cmd = *cmd;
+		struct dnet_io_attr io;
+		int use_oplock;
+
+		if (cmd->size - offset < sizeof(struct dnet_io_attr)) {
+			err = -EINVAL;
+			break;
+		}
+
+		io = *wio;
+		dnet_convert_io_attr(&io);
+
+		if (io.size > cmd->size - offset - sizeof(struct dnet_io_attr)) {
+			err = -EINVAL;
+			break;
+		}
+
+		write_cmd.cmd = DNET_CMD_WRITE;
+		write_cmd.size = sizeof(struct dnet_io_attr) + io.size;
+		write_cmd.flags |= DNET_FLAGS_MORE;
+		memcpy(write_cmd.id.id, io.id, DNET_ID_SIZE);
+
+		/*
+		 * The first key is already locked by request_queue::take_request().
+		 */
+		use_oplock = !(cmd->flags & DNET_FLAGS_NOLOCK) && dnet_id_cmp_str(io.id, cmd->id.id);
+		if (use_oplock) {
+			memcpy(&lock_id.id, io.id, DNET_ID_SIZE);
+			dnet_oplock(backend, &lock_id);
+		}
+
+		dnet_process_cmd_raw(backend, st, &write_cmd, wio, 1);
+
+		if (use_oplock)
+			dnet_opunlock(backend, &lock_id);
+
+		offset += write_cmd.size;
+		count++;
+	}
+
+	if (err) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid BULK_WRITE command: size: %llu, offset: %llu, keys: %llu",
+				dnet_dump_id(&cmd->id), (unsigned long long)cmd->size,
+				(unsigned long long)offset, (unsigned long long)count);
+	} else {
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: BULK_WRITE: processed %llu keys",
+				dnet_dump_id(&cmd->id), (unsigned long long)count);
+	}
+
+	return err;
+}
+
+struct dnet_bulk_remove_entry {
+	struct dnet_io_attr	io;
+	uint64_t		index;
+};
+
+static int dnet_bulk_remove_entry_cmp(const void *a, const void *b)
+{
+	const struct dnet_bulk_remove_entry *e1 = a, *e2 = b;
+
+	return dnet_id_cmp_str(e1->io.id, e2->io.id);
+}
+
+/*
+ * Removes keys of DNET_CMD_BULK_REMOVE in id order, so that neighbouring keys hit the same index blocks
+ * and every key is locked only for its own removal. Every key goes through the same path as DNET_CMD_DEL,
+ * including cache, notifications and change log, but no per-key replies are sent.
+ * Statuses are sent together in one reply in the order of the request.
+ */
+static int dnet_cmd_bulk_remove(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_io_attr *io = data;
+	struct dnet_bulk_remove_entry *entries = NULL;
+	struct dnet_bulk_remove_reply *reply = NULL;
+	int32_t *statuses;
+	uint64_t count, i, removed = 0;
+	size_t reply_size;
+	int err;
+
+	if (cmd->size < sizeof(struct dnet_io_attr)) {
+		err = -EINVAL;
+		goto err_out_invalid;
+	}
+
+	dnet_convert_io_attr(io);
+
+	if (io->size != cmd->size - sizeof(struct dnet_io_attr) || io->size % sizeof(struct dnet_io_attr)) {
+		err = -EINVAL;
+		goto err_out_invalid;
+	}
+
+	if (n->ro || backend->read_only) {
+		err = -EROFS;
+		goto err_out_exit;
+	}
+
+	count = io->size / sizeof(struct dnet_io_attr);
+	reply_size = sizeof(struct dnet_bulk_remove_reply) + count * sizeof(int32_t);
+
+	entries = malloc(count * sizeof(struct dnet_bulk_remove_entry));
+	reply = calloc(1, reply_size);
+	if (!entries || !reply) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	statuses = (int32_t *)(reply + 1);
+
+	for (i = 0; i < count; ++i) {
+		memcpy(&entries[i].io, (struct dnet_io_attr *)(io + 1) + i, sizeof(struct dnet_io_attr));
+		entries[i].index = i;
+	}
+
+	qsort(entries, count, sizeof(struct dnet_bulk_remove_entry), dnet_bulk_remove_entry_cmp);
+
+	for (i = 0; i < count; ++i) {
+		struct dnet_bulk_remove_entry *e = &entries[i];
+		struct dnet_id lock_id = { .group_id = cmd->id.group_id };
+		struct dnet_cmd del_cmd = *cmd;
+		int handled_in_cache = 0, use_oplock, ret;
+
+		del_cmd.cmd = DNET_CMD_DEL;
+		del_cmd.size = sizeof(struct dnet_io_attr);
+		del_cmd.flags &= ~DNET_FLAGS_NEED_ACK;
+		memcpy(del_cmd.id.id, e->io.id, DNET_ID_SIZE);
+
 		/*
-		 * First key is already locked by request_queue::take_request().
-		 * Check that i-th key is not equal to the first key.
+		 * The first key is already locked by request_queue::take_request().
 		 */
-		use_oplock = (i > 0) && !(cmd->flags & DNET_FLAGS_NOLOCK) &&
-					!dnet_id_cmp_str((const unsigned char *)&ios[i].id, (const unsigned char *)&cmd->id.id);
+		use_oplock = !(cmd->flags & DNET_FLAGS_NOLOCK) && dnet_id_cmp_str(e->io.id, cmd->id.id);
 		if (use_oplock) {
-			memcpy(&lock_id.id, &ios[i].id, DNET_ID_SIZE);
+			memcpy(&lock_id.id, e->io.id, DNET_ID_SIZE);
 			dnet_oplock(backend, &lock_id);
 		}
 
-		ret = dnet_process_cmd_raw(backend, st, &read_cmd, &ios[i], 1);
-		dnet_log(st->n, DNET_LOG_NOTICE, "%s: processing BULK_READ.READ for %d/%d command, err: %d",
-			dnet_dump_id(&cmd->id), (int) i, (int) count, ret);
+		ret = dnet_process_cmd_with_backend_raw(backend, st, &del_cmd, &e->io, &handled_in_cache);
 
-		if (use_oplock) {
+		if (use_oplock)
 			dnet_opunlock(backend, &lock_id);
-		}
 
+		statuses[e->index] = dnet_bswap32(ret);
 		if (!ret)
-			err = 0;
-		else if (err == -1)
-			err = ret;
+			removed++;
+	}
+
+	reply->num = count;
+	reply->removed = removed;
+	dnet_convert_bulk_remove_reply(reply);
+
+	err = dnet_send_reply(st, cmd, reply, reply_size, 1);
+
+	dnet_log(n, DNET_LOG_NOTICE, "%s: BULK_REMOVE: removed %llu of %llu keys, err: %d",
+			dnet_dump_id(&cmd->id), (unsigned long long)removed, (unsigned long long)count, err);
+
+err_out_free:
+	free(reply);
+	free(entries);
+err_out_exit:
+	return err;
+
+err_out_invalid:
+	dnet_log(n, DNET_LOG_ERROR, "%s: invalid BULK_REMOVE command: size: %llu",
+			dnet_dump_id(&cmd->id), (unsigned long long)cmd->size);
+	return err;
+}
+
+/*
+ * DNET_CMD_ATOMIC_UPDATE computes new data of the record and writes it as DNET_CMD_WRITE while the key is locked,
+ * client gets reply of the write followed by the final ack of the update.
+ */
+static int dnet_cmd_atomic_update(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_cmd write_cmd = *cmd;
+	void *request = NULL;
+	uint64_t request_size = 0;
+	int handled_in_cache = 0;
+	int err;
+
+	/*
+	 * Key is already locked by request_queue::take_request() unless client has asked not to lock it,
+	 * the update is not atomic without the lock, so it is taken anyway.
+	 */
+	if (cmd->flags & DNET_FLAGS_NOLOCK)
+		dnet_oplock(backend, &cmd->id);
+
+	err = dnet_atomic_update_prepare(backend, st, cmd, data, &request, &request_size);
+	if (err)
+		goto err_out_unlock;
+
+	write_cmd.cmd = DNET_CMD_WRITE;
+	write_cmd.size = request_size;
+	write_cmd.flags |= DNET_FLAGS_MORE;
+
+	err = dnet_process_cmd_with_backend_raw(backend, st, &write_cmd, request, &handled_in_cache);
+
+	free(request);
+err_out_unlock:
+	if (cmd->flags & DNET_FLAGS_NOLOCK)
+		dnet_opunlock(backend, &cmd->id);
+
+	if (err) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: ATOMIC_UPDATE failed: %d", dnet_dump_id(&cmd->id), err);
 	}
 
 	return err;
@@ -1458,12 +3756,38 @@ static int dnet_process_cmd_without_backend_raw(struct dnet_net_state *st, struc
 	return err;
 }
 
+/*
+ * Appends committed write or removal to the backend's change log, @io is in network byte order
+ */
+static void dnet_change_log_update(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io)
+{
+	struct dnet_io_attr attr;
+	int err;
+
+	memcpy(&attr, io, sizeof(struct dnet_io_attr));
+	dnet_convert_io_attr(&attr);
+
+	/* uncommitted records are not visible, their commit is logged */
+	if (cmd->cmd == DNET_CMD_WRITE && (attr.flags & (DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_PLAIN_WRITE)) &&
+			!(attr.flags & DNET_IO_FLAGS_COMMIT))
+		return;
+
+	err = dnet_change_log_append(backend->change_log, (struct dnet_raw_id *)attr.id, &attr.timestamp, attr.size,
+			cmd->cmd == DNET_CMD_DEL ? DNET_RECORD_FLAGS_REMOVE : 0);
+	if (err) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: failed to update change log: %d",
+				dnet_dump_id(&cmd->id), err);
+	}
+}
+
 static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, struct dnet_net_state *st,
 		struct dnet_cmd *cmd, void *data, int *handled_in_cache)
 {
 	int err = 0;
 	struct dnet_node *n = st->n;
 	struct dnet_io_attr *io = NULL;
+	struct dnet_io_attr range_io;
 	uint64_t iosize = 0;
 	long diff;
 	struct timeval start, end;
@@ -1486,6 +3810,12 @@ static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, st
 		}
 	}
 
+#ifdef DNET_FAULT_INJECTION
+	err = dnet_backend_faults_inject(backend, cmd);
+	if (err)
+		goto err_out_complete;
+#endif
+
 	switch (cmd->cmd) {
 		case DNET_CMD_ITERATOR:
 			err = dnet_cmd_iterator(backend, st, cmd, data);
@@ -1552,6 +3882,38 @@ static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, st
 				err = dnet_cmd_bulk_read(backend, st, cmd, data);
 			}
 			break;
+		case DNET_CMD_BULK_WRITE:
+			err = dnet_cmd_bulk_write(backend, st, cmd, data);
+			break;
+		case DNET_CMD_ATOMIC_UPDATE:
+			err = dnet_cmd_atomic_update(backend, st, cmd, data);
+			break;
+		case DNET_CMD_BULK_REMOVE:
+			err = dnet_cmd_bulk_remove(backend, st, cmd, data);
+			break;
+		case DNET_CMD_READ_RANGE:
+			if (cmd->size < sizeof(struct dnet_io_attr)) {
+				dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid size: cmd: %u, cmd.size: %llu",
+					dnet_dump_id(&cmd->id), cmd->cmd, (unsigned long long)cmd->size);
+				err = -EINVAL;
+				break;
+			}
+
+			/* backend converts io attribute itself, so cache works with a copy */
+			memcpy(&range_io, data, sizeof(struct dnet_io_attr));
+			dnet_convert_io_attr(&range_io);
+
+			if (range_io.flags & DNET_IO_FLAGS_CACHE_ONLY) {
+				err = dnet_cmd_cache_read_range(backend, st, cmd, &range_io);
+
+				if (err != -ENOTSUP) {
+					*handled_in_cache = 1;
+					break;
+				}
+			}
+
+			err = backend->cb->command_handler(st, backend->cb->command_private, cmd, data);
+			break;
 		case DNET_CMD_READ:
 		case DNET_CMD_WRITE:
 		case DNET_CMD_DEL:
@@ -1619,56 +3981,456 @@ static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, st
 				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
 			}
 			err = backend->cb->command_handler(st, backend->cb->command_private, cmd, data);
+			break;
+	}
 
-			if (!err && (cmd->cmd == DNET_CMD_WRITE)) {
-				dnet_update_notify(st, cmd, data);
-			}
+	/* writes and removals served by cache are notified too, clients may cache objects by notifications */
+	if (!err && io && ((cmd->cmd == DNET_CMD_WRITE) || (cmd->cmd == DNET_CMD_DEL))) {
+		dnet_update_notify(st, cmd, io);
+
+		if (backend->change_log)
+			dnet_change_log_update(backend, st, cmd, io);
+	}
+
+#ifdef DNET_FAULT_INJECTION
+err_out_complete:
+#endif
+	gettimeofday(&end, NULL);
+	diff = DIFF(start, end);
+
+	/* nested commands (bulk reads, for example) are accounted into the backend stage of the outer one */
+	if (dnet_backend_stage_time == DNET_IO_STAGE_NONE)
+		dnet_backend_stage_time = diff;
+	else
+		dnet_backend_stage_time += diff;
+
+	/* If there was any error - send ACK to notify client with error code and destroy transaction */
+	if (err)
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+
+	if (io) {
+		iosize = io->size;
+
+		// do not count error read size
+		// otherwise it leads to HUGE read traffic stats, although nothing was actually read
+		if (cmd->cmd == DNET_CMD_READ && err < 0)
+			iosize = 0;
+	}
+
+	dnet_backend_command_stats_update(n, backend, cmd, iosize, *handled_in_cache, err, diff);
+	return err;
+}
+
+/*
+ * Logs processed command, updates statistics and sends final ack, @io is already converted if not NULL
+ */
+static int dnet_process_cmd_complete(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		int err, int handled_in_cache, long diff, int recursive)
+{
+	struct dnet_node *n = st->n;
+	const unsigned long long tid = cmd->trans;
+	uint64_t iosize = 0;
+
+	if (((cmd->cmd == DNET_CMD_READ) || (cmd->cmd == DNET_CMD_WRITE)) && io) {
+		// do not count error read size
+		// otherwise it leads to HUGE read traffic stats, although nothing was actually read
+		iosize = io->size;
+		if (cmd->cmd == DNET_CMD_READ && err < 0)
+			iosize = 0;
+
+		dnet_log(n, DNET_LOG_INFO, "%s: %s: client: %s, trans: %llu, cflags: %s, %s, "
+				"time: %ld usecs, err: %d.",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_state_dump_addr(st),
+				tid, dnet_flags_dump_cflags(cmd->flags),
+				dnet_print_io(io),
+				diff, err);
+	} else {
+		dnet_log(n, DNET_LOG_INFO, "%s: %s: client: %s, trans: %llu, cflags: %s, time: %ld usecs, err: %d.",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_state_dump_addr(st),
+				tid, dnet_flags_dump_cflags(cmd->flags), diff, err);
+	}
+
+	// we must provide real error from the backend into statistics
+	dnet_monitor_stats_update(n, cmd, err, handled_in_cache, iosize, diff);
+
+	err = dnet_send_ack(st, cmd, err, recursive);
+
+	dnet_stat_inc(st->stat, cmd->cmd, err);
+	__sync_add_and_fetch(&st->peer_stat.ops, 1);
+	__sync_add_and_fetch(&st->peer_stat.latency[dnet_peer_latency_bucket(diff > 0 ? diff : 0)], 1);
+	if (st->__join_state == DNET_JOIN)
+		dnet_counter_inc(n, cmd->cmd, err);
+	else
+		dnet_counter_inc(n, cmd->cmd + __DNET_CMD_MAX, err);
+
+	return err;
+}
+
+int dnet_process_cache_hit(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct timeval start, end;
+	long diff;
+	int err;
+
+	HANDY_TIMER_SCOPE("io.cmd_cache_hit");
+
+	gettimeofday(&start, NULL);
+
+	dnet_convert_io_attr(io);
+
+	err = dnet_cmd_cache_try_read(backend, st, cmd, io);
+	if (err == -EAGAIN) {
+		/* request is going to be queued as it has been received */
+		dnet_convert_io_attr(io);
+		return err;
+	}
+
+	gettimeofday(&end, NULL);
+	diff = DIFF(start, end);
+
+	if (err)
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+
+	dnet_backend_command_stats_update(st->n, backend, cmd, err < 0 ? 0 : io->size, 1, err, diff);
+
+	dnet_process_cmd_complete(st, cmd, io, err, 1, diff, 0);
+	return 0;
+}
+
+void dnet_process_absent_key(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = NULL;
+	int err = -ENOENT;
+
+	if (cmd->cmd == DNET_CMD_READ) {
+		io = data;
+		dnet_convert_io_attr(io);
+	}
+
+	cmd->flags |= DNET_FLAGS_NEED_ACK;
+
+	dnet_backend_command_stats_update(st->n, backend, cmd, 0, 0, err, 0);
+
+	dnet_process_cmd_complete(st, cmd, io, err, 0, 0, 0);
+}
+
+/*
+ * Primary side of DNET_FLAGS_REPLICATE write: data is written locally and forwarded to the rest of groups,
+ * result of every group is relayed to the client on its transaction.
+ */
+struct dnet_replicate_write {
+	atomic_t		refcnt;
+	pthread_mutex_t		lock;
+	struct dnet_net_state	*st;
+	struct dnet_cmd		cmd;
+	int			checker;
+	int			group_num;
+	int			received;
+	int			success;
+	int			status;
+	int			finished;
+	int			*groups;
+	int			*replied;
+};
+
+static int dnet_replicate_write_enough(struct dnet_replicate_write *rw, int success)
+{
+	switch (rw->checker) {
+	case DNET_REPLICATE_CHECKER_AT_LEAST_ONE:
+		return success > 0;
+	case DNET_REPLICATE_CHECKER_QUORUM:
+		return success > rw->group_num / 2;
+	default:
+		return success == rw->group_num;
+	}
+}
+
+/* sends the final acknowledge, must be called with @rw->lock held */
+static void dnet_replicate_write_finish(struct dnet_replicate_write *rw)
+{
+	int err = 0;
+
+	if (!dnet_replicate_write_enough(rw, rw->success))
+		err = rw->status ? rw->status : -EIO;
+
+	rw->finished = 1;
+
+	dnet_log(rw->st->n, err ? DNET_LOG_ERROR : DNET_LOG_INFO, "%s: %s: replicated write: client: %s, trans: %llu, "
+			"groups: %d, received: %d, succeeded: %d, err: %d",
+			dnet_dump_id(&rw->cmd.id), dnet_cmd_string(rw->cmd.cmd), dnet_state_dump_addr(rw->st),
+			(unsigned long long)rw->cmd.trans, rw->group_num, rw->received, rw->success, err);
+
+	dnet_send_ack(rw->st, &rw->cmd, err, 0);
+}
+
+/*
+ * Accounts result of the group @reply->id.group_id, sends it to the client unless @relay is false
+ * (local write has already sent its reply) and finishes the write when checker is decided.
+ * Every group is accounted only once, results received after the final acknowledge are dropped.
+ */
+static void dnet_replicate_write_result(struct dnet_replicate_write *rw, const struct dnet_cmd *reply,
+		const void *data, uint64_t size, int relay)
+{
+	struct dnet_cmd cmd;
+	int i;
+
+	pthread_mutex_lock(&rw->lock);
+
+	for (i = 0; i < rw->group_num; ++i) {
+		if ((uint32_t)rw->groups[i] == reply->id.group_id && !rw->replied[i])
 			break;
 	}
 
-	gettimeofday(&end, NULL);
-	diff = DIFF(start, end);
+	if (i == rw->group_num || rw->finished)
+		goto err_out_unlock;
+
+	rw->replied[i] = 1;
+	rw->received++;
+	if (reply->status)
+		rw->status = reply->status;
+	else
+		rw->success++;
+
+	if (relay) {
+		cmd = rw->cmd;
+		cmd.id = reply->id;
+		cmd.status = reply->status;
+		cmd.backend_id = reply->backend_id;
+		cmd.flags &= ~DNET_FLAGS_NEED_ACK;
+
+		dnet_send_reply(rw->st, &cmd, data, size, 1);
+	}
+
+	if (dnet_replicate_write_enough(rw, rw->success) ||
+			!dnet_replicate_write_enough(rw, rw->success + rw->group_num - rw->received))
+		dnet_replicate_write_finish(rw);
+
+err_out_unlock:
+	pthread_mutex_unlock(&rw->lock);
+}
+
+static void dnet_replicate_write_put(struct dnet_replicate_write *rw)
+{
+	if (!atomic_dec_and_test(&rw->refcnt))
+		return;
+
+	if (!rw->finished)
+		dnet_replicate_write_finish(rw);
+
+	dnet_state_put(rw->st);
+	pthread_mutex_destroy(&rw->lock);
+	free(rw);
+}
+
+static int dnet_replicate_write_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void *priv)
+{
+	struct dnet_replicate_write *rw = priv;
+
+	(void) addr;
+
+	/* transaction destroyed without final reply (timeout or send failure) still has to be accounted */
+	if (is_trans_destroyed(cmd)) {
+		struct dnet_cmd reply = *cmd;
+
+		if (!reply.status)
+			reply.status = -ETIMEDOUT;
+
+		dnet_replicate_write_result(rw, &reply, NULL, 0, 1);
+		dnet_replicate_write_put(rw);
+		return 0;
+	}
+
+	if (!(cmd->flags & DNET_FLAGS_MORE))
+		dnet_replicate_write_result(rw, cmd, cmd + 1, cmd->size, 1);
+
+	return 0;
+}
+
+/*
+ * Strips struct dnet_replicate_request from the write command, so it can be processed as usual,
+ * and forwards the data to the rest of groups. Local write reply is marked with DNET_FLAGS_MORE,
+ * its result has to be passed to dnet_replicate_write_local().
+ */
+static int dnet_replicate_write_start(struct dnet_net_state *st, struct dnet_cmd *cmd, void **datap,
+		struct dnet_replicate_write **rwp)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_replicate_request req;
+	struct dnet_replicate_write *rw;
+	struct dnet_io_control ctl;
+	struct dnet_io_attr io, wio;
+	struct dnet_session *s;
+	void *data = *datap;
+	int *forward;
+	uint64_t hsize;
+	int forward_num = 0, i, err;
+
+	cmd->flags &= ~DNET_FLAGS_REPLICATE;
+
+	if (cmd->size < sizeof(struct dnet_io_attr) + sizeof(struct dnet_replicate_request)) {
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	memcpy(&io, data, sizeof(struct dnet_io_attr));
+	dnet_convert_io_attr(&io);
+
+	memcpy(&req, data + sizeof(struct dnet_io_attr), sizeof(struct dnet_replicate_request));
+	dnet_convert_replicate_request(&req);
+
+	hsize = sizeof(struct dnet_replicate_request) + (uint64_t)req.group_num * sizeof(int);
+	if (!req.group_num || req.group_num > 0xffff || req.checker >= __DNET_REPLICATE_CHECKER_MAX ||
+			io.size < hsize || cmd->size < sizeof(struct dnet_io_attr) + hsize) {
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	rw = calloc(1, sizeof(struct dnet_replicate_write) + req.group_num * 3 * sizeof(int));
+	if (!rw) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	err = pthread_mutex_init(&rw->lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_free;
+	}
+
+	rw->groups = (int *)(rw + 1);
+	rw->replied = rw->groups + req.group_num;
+	forward = rw->replied + req.group_num;
+
+	rw->st = dnet_state_get(st);
+	rw->cmd = *cmd;
+	rw->checker = req.checker;
+	rw->group_num = req.group_num;
+
+	memcpy(rw->groups, data + sizeof(struct dnet_io_attr) + sizeof(struct dnet_replicate_request),
+			req.group_num * sizeof(int));
+	for (i = 0; i < rw->group_num; ++i) {
+		rw->groups[i] = dnet_bswap32(rw->groups[i]);
+		if ((uint32_t)rw->groups[i] != cmd->id.group_id)
+			forward[forward_num++] = rw->groups[i];
+	}
+
+	/* io attribute is moved right before the data, command looks like usual write from now on */
+	io.size -= hsize;
+	wio = io;
+	dnet_convert_io_attr(&wio);
+
+	data += hsize;
+	memcpy(data, &wio, sizeof(struct dnet_io_attr));
+	cmd->size -= hsize;
+	*datap = data;
+
+	/* local write reply is one of the group results, the final acknowledge is sent by @rw */
+	cmd->flags |= DNET_FLAGS_MORE;
+
+	atomic_init(&rw->refcnt, forward_num + 1);
+	*rwp = rw;
+
+	if (!forward_num)
+		return 0;
+
+	memset(&ctl, 0, sizeof(struct dnet_io_control));
+
+	ctl.id = cmd->id;
+	ctl.io = io;
+	ctl.data = data + sizeof(struct dnet_io_attr);
+	ctl.fd = -1;
+	ctl.cmd = DNET_CMD_WRITE;
+	ctl.cflags = DNET_FLAGS_NEED_ACK | (cmd->flags & DNET_FLAGS_NOLOCK);
+	ctl.ts.tv_sec = io.timestamp.tsec;
+	ctl.ts.tv_nsec = io.timestamp.tnsec;
+	ctl.complete = dnet_replicate_write_complete;
+	ctl.priv = rw;
+
+	s = dnet_session_create(n);
+	if (!s || dnet_session_set_groups(s, forward, forward_num)) {
+		struct dnet_cmd reply = *cmd;
 
-	/* If there was any error - send ACK to notify client with error code and destroy transaction */
-	if (err)
-		cmd->flags |= DNET_FLAGS_NEED_ACK;
+		dnet_log(n, DNET_LOG_ERROR, "%s: %s: replicated write: failed to create forward session",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd));
 
-	if (io) {
-		iosize = io->size;
+		if (s)
+			dnet_session_destroy(s);
 
-		// do not count error read size
-		// otherwise it leads to HUGE read traffic stats, although nothing was actually read
-		if (cmd->cmd == DNET_CMD_READ && err < 0)
-			iosize = 0;
+		reply.status = -ENOMEM;
+		for (i = 0; i < forward_num; ++i) {
+			reply.id.group_id = forward[i];
+			dnet_replicate_write_result(rw, &reply, NULL, 0, 1);
+			dnet_replicate_write_put(rw);
+		}
+		return 0;
 	}
 
-	dnet_backend_command_stats_update(n, backend, cmd, iosize, *handled_in_cache, err, diff);
+	dnet_session_set_trace_id(s, cmd->trace_id);
+	dnet_session_set_trace_bit(s, !!(cmd->flags & DNET_FLAGS_TRACE_BIT));
+
+	dnet_trans_create_send_all(s, &ctl);
+	dnet_session_destroy(s);
+
+	return 0;
+
+err_out_free:
+	free(rw);
+err_out_exit:
+	dnet_log(n, DNET_LOG_ERROR, "%s: %s: invalid replicated write: cmd.size: %llu, err: %d",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->size, err);
 	return err;
 }
 
+/*
+ * Accounts the local write result, its reply has already been sent unless the write failed
+ * or backend left acknowledge to be sent instead of file info.
+ */
+static void dnet_replicate_write_local(struct dnet_replicate_write *rw, struct dnet_cmd *cmd, int err)
+{
+	struct dnet_cmd reply = *cmd;
+
+	reply.status = err;
+	dnet_replicate_write_result(rw, &reply, NULL, 0, err || (cmd->flags & DNET_FLAGS_NEED_ACK));
+
+	cmd->flags &= ~(DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
+	dnet_replicate_write_put(rw);
+}
+
 int dnet_process_cmd_raw(struct dnet_backend_io *backend, struct dnet_net_state *st,
 		struct dnet_cmd *cmd, void *data, int recursive)
 {
 	int err = 0;
-	struct dnet_node *n = st->n;
-	const unsigned long long tid = cmd->trans;
 	struct dnet_io_attr *io = NULL;
+	struct dnet_replicate_write *rw = NULL;
 	struct timeval start, end;
-	uint64_t iosize = 0;
 
 	long diff;
 	int handled_in_cache = 0;
 
 	HANDY_TIMER_SCOPE(recursive ? "io.cmd_recursive" : "io.cmd");
-	FORMATTED(HANDY_TIMER_SCOPE, ("io.cmd%s.%s", (recursive ? "_recursive" : ""), dnet_cmd_string(cmd->cmd)));
+	HANDY_TIMER_SCOPE(dnet_cmd_metric_name(recursive ? DNET_CMD_METRICS_IO_RECURSIVE : DNET_CMD_METRICS_IO, cmd->cmd));
+
+	DNET_PROBE_CMD(cmd__start, st, cmd, (int)cmd->backend_id);
+
+	if (st->n->capture && !recursive)
+		dnet_capture_request(st->n, cmd, data);
 
 	gettimeofday(&start, NULL);
 
-	err = dnet_process_cmd_without_backend_raw(st, cmd, data);
-	if (err == -ENOTSUP && backend) {
-		err = dnet_process_cmd_with_backend_raw(backend, st, cmd, data, &handled_in_cache);
+	if ((cmd->cmd == DNET_CMD_WRITE) && (cmd->flags & DNET_FLAGS_REPLICATE))
+		err = dnet_replicate_write_start(st, cmd, &data, &rw);
+
+	if (!err) {
+		err = dnet_process_cmd_without_backend_raw(st, cmd, data);
+		if (err == -ENOTSUP && backend) {
+			err = dnet_process_cmd_with_backend_raw(backend, st, cmd, data, &handled_in_cache);
+		}
 	}
 
+	if (rw)
+		dnet_replicate_write_local(rw, cmd, err);
+
 	gettimeofday(&end, NULL);
 	diff = DIFF(start, end);
 
@@ -1692,45 +4454,112 @@ int dnet_process_cmd_raw(struct dnet_backend_io *backend, struct dnet_net_state
 			break;
 	}
 
-	if (((cmd->cmd == DNET_CMD_READ) || (cmd->cmd == DNET_CMD_WRITE)) && io) {
-		/* io has been already set in the switch above */
+	DNET_PROBE_CMD(cmd__done, st, cmd, (int)cmd->backend_id, err);
 
-		// do not count error read size
-		// otherwise it leads to HUGE read traffic stats, although nothing was actually read
-		iosize = io->size;
-		if (cmd->cmd == DNET_CMD_READ && err < 0)
-			iosize = 0;
+	return dnet_process_cmd_complete(st, cmd, io, err, handled_in_cache, diff, recursive);
+}
 
-		dnet_log(n, DNET_LOG_INFO, "%s: %s: client: %s, trans: %llu, cflags: %s, %s, "
-				"time: %ld usecs, err: %d.",
-				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_state_dump_addr(st),
-				tid, dnet_flags_dump_cflags(cmd->flags),
-				dnet_print_io(io),
-				diff, err);
-	} else {
-		dnet_log(n, DNET_LOG_INFO, "%s: %s: client: %s, trans: %llu, cflags: %s, time: %ld usecs, err: %d.",
-				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_state_dump_addr(st),
-				tid, dnet_flags_dump_cflags(cmd->flags), diff, err);
+/*
+ * Allocates read reply header in network byte order, it is followed by reply's io attribute
+ */
+static struct dnet_cmd *dnet_read_reply_alloc(struct dnet_cmd *cmd, struct dnet_io_attr *io)
+{
+	struct dnet_cmd *c;
+	struct dnet_io_attr *rio;
+
+	c = calloc(1, sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr));
+	if (!c)
+		return NULL;
+
+	rio = (struct dnet_io_attr *)(c + 1);
+
+	dnet_setup_id(&c->id, cmd->id.group_id, io->id);
+
+	c->flags = cmd->flags & ~(DNET_FLAGS_NEED_ACK);
+	if (cmd->flags & DNET_FLAGS_NEED_ACK)
+		c->flags |= DNET_FLAGS_MORE;
+	c->flags |= DNET_FLAGS_REPLY;
+
+	c->size = sizeof(struct dnet_io_attr) + io->size;
+	c->trans = cmd->trans;
+	c->trace_id = cmd->trace_id;
+	c->cmd = DNET_CMD_READ;
+	c->backend_id = cmd->backend_id;
+
+	memcpy(rio, io, sizeof(struct dnet_io_attr));
+
+	dnet_convert_cmd(c);
+	dnet_convert_io_attr(rio);
+	return c;
+}
+
+/*
+ * Passes DNET_IO_FLAGS_FILTER read reply through record filters of the backend,
+ * @io, @data and @offset are narrowed to the part of the data which has to be sent.
+ * Callers which don't send replies from a single descriptor or buffer pass NULL @offset,
+ * then filters may only reject the record.
+ */
+static int dnet_read_filter(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		void **data, int fd, uint64_t *offset)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_record_filters *filters = NULL;
+	struct dnet_iterator_filter_record rec;
+	uint64_t base;
+	int err;
+
+	if (n->io && cmd->backend_id >= 0 && (size_t)cmd->backend_id < n->io->backends_count)
+		filters = n->io->backends[cmd->backend_id].record_filters;
+
+	if (!filters) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: %s: backend has no record filters",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd));
+		return -ENOTSUP;
 	}
 
-	// we must provide real error from the backend into statistics
-	dnet_monitor_stats_update(n, cmd, err, handled_in_cache, iosize, diff);
+	base = (data && *data) || !offset ? 0 : *offset;
+
+	memset(&rec, 0, sizeof(struct dnet_iterator_filter_record));
+	memcpy(rec.key.id, io->id, DNET_ID_SIZE);
+	rec.timestamp = io->timestamp;
+	rec.user_flags = io->user_flags;
+	rec.flags = io->record_flags;
+	rec.data = data ? *data : NULL;
+	rec.fd = rec.data || !offset ? -1 : fd;
+	rec.offset = base;
+	rec.size = io->size;
+
+	err = dnet_record_filters_apply(filters, DNET_CMD_READ, &rec, 0);
+	if (err == DNET_RECORD_FILTER_SKIP)
+		return -ENOENT;
+	if (err)
+		return err;
 
-	err = dnet_send_ack(st, cmd, err, recursive);
+	if (rec.offset == base && rec.size == io->size)
+		return 0;
 
-	dnet_stat_inc(st->stat, cmd->cmd, err);
-	if (st->__join_state == DNET_JOIN)
-		dnet_counter_inc(n, cmd->cmd, err);
-	else
-		dnet_counter_inc(n, cmd->cmd + __DNET_CMD_MAX, err);
+	if (!offset) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: %s: record filters can not narrow data of this read",
+				dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd));
+		return -ENOTSUP;
+	}
 
-	return err;
+	io->offset += rec.offset - base;
+	io->size = rec.size;
+	if (rec.data)
+		*data = (char *)*data + (rec.offset - base);
+	else
+		*offset = rec.offset;
+	return 0;
 }
 
-int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
-		int fd, uint64_t offset, int on_exit)
+static int dnet_send_read_data_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		int fd, uint64_t offset, int on_exit, void (*release)(void *priv), void *priv,
+		uint64_t chunk_size, int (*verify)(void *priv, uint64_t chunk_offset, uint64_t chunk_size),
+		int (*fill)(void *priv, uint64_t piece_offset, uint64_t piece_size,
+			void **data, void (**release)(void *release_priv), void **release_priv),
+		void *chunk_priv)
 {
-	struct dnet_net_state *st = state;
 	struct dnet_node *n = st->n;
 	struct dnet_cmd *c;
 	struct dnet_io_attr *rio;
@@ -1745,52 +4574,49 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 	 * back to parental client, instead server will wrap data into
 	 * proper transaction reply next to this obscure packet.
 	 */
-	if (io->flags & DNET_IO_FLAGS_SKIP_SENDING)
-		return 0;
+	if (io->flags & DNET_IO_FLAGS_SKIP_SENDING) {
+		err = 0;
+		goto err_out_release;
+	}
 
 	gettimeofday(&start_tv, NULL);
 
-	c = calloc(1, hsize);
+	if (io->flags & DNET_IO_FLAGS_FILTER) {
+		/* chunked sends use the requested size, their data can't be narrowed */
+		err = dnet_read_filter(st, cmd, io, &data, fd, (verify || fill) ? NULL : &offset);
+		if (err)
+			goto err_out_release;
+	}
+
+	c = dnet_read_reply_alloc(cmd, io);
 	if (!c) {
 		err = -ENOMEM;
-		goto err_out_exit;
+		goto err_out_release;
 	}
 
 	rio = (struct dnet_io_attr *)(c + 1);
 
-	dnet_setup_id(&c->id, cmd->id.group_id, io->id);
-
-	c->flags = cmd->flags & ~(DNET_FLAGS_NEED_ACK);
-	if (cmd->flags & DNET_FLAGS_NEED_ACK)
-		c->flags |= DNET_FLAGS_MORE;
-	c->flags |= DNET_FLAGS_REPLY;
-
-	c->size = sizeof(struct dnet_io_attr) + io->size;
-	c->trans = cmd->trans;
-	c->trace_id = cmd->trace_id;
-	c->cmd = DNET_CMD_READ;
-	c->backend_id = cmd->backend_id;
-
-	memcpy(rio, io, sizeof(struct dnet_io_attr));
-
-	dnet_convert_cmd(c);
-	dnet_convert_io_attr(rio);
-
 	if (io->flags & DNET_IO_FLAGS_CHECKSUM) {
 		if (data) {
-			err = dnet_checksum_data(n, data, rio->size, rio->parent, sizeof(rio->parent));
+			err = dnet_checksum_data_type(n, io->csum_type, data, rio->size, rio->parent, sizeof(rio->parent));
 		} else {
-			err = dnet_checksum_fd(n, fd, offset, rio->size, rio->parent, sizeof(rio->parent));
+			err = dnet_checksum_fd_type(n, io->csum_type, fd, offset, rio->size, rio->parent, sizeof(rio->parent));
 		}
 
 		if (err)
-			goto err_out_free;
+			goto err_out_free_release;
 	}
 
 	gettimeofday(&csum_tv, NULL);
 
-	if (data)
+	if (release)
+		err = dnet_send_data_ref(st, c, hsize, data, rio->size, release, priv);
+	else if (data)
 		err = dnet_send_data(st, c, hsize, data, rio->size);
+	else if (fill)
+		err = dnet_send_data_pieces(st, c, hsize, io->size, chunk_size, fill, chunk_priv);
+	else if (verify)
+		err = dnet_send_fd_verified(st, c, hsize, fd, offset, io->size, on_exit, chunk_size, verify, chunk_priv);
 	else
 		err = dnet_send_fd(st, c, hsize, fd, offset, rio->size, on_exit);
 
@@ -1805,13 +4631,142 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 			dnet_flags_dump_cflags(cmd->flags), dnet_print_io(io),
 			csum_time, send_time, total_time);
 
+	free(c);
+	return err;
 
-err_out_free:
+err_out_free_release:
 	free(c);
-err_out_exit:
+err_out_release:
+	if (release)
+		release(priv);
 	return err;
 }
 
+int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		int fd, uint64_t offset, int on_exit)
+{
+	return dnet_send_read_data_raw(state, cmd, io, data, fd, offset, on_exit, NULL, NULL, 0, NULL, NULL, NULL);
+}
+
+int dnet_send_read_data_verified(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		int fd, uint64_t offset, int on_exit, uint64_t chunk_size,
+		int (*verify)(void *priv, uint64_t chunk_offset, uint64_t chunk_size), void *priv)
+{
+	return dnet_send_read_data_raw(state, cmd, io, NULL, fd, offset, on_exit, NULL, NULL, chunk_size, verify, NULL, priv);
+}
+
+int dnet_send_read_data_pieces(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, uint64_t piece_size,
+		int (*fill)(void *priv, uint64_t piece_offset, uint64_t piece_size,
+			void **data, void (**release)(void *release_priv), void **release_priv), void *priv)
+{
+	return dnet_send_read_data_raw(state, cmd, io, NULL, -1, 0, 0, NULL, NULL, piece_size, NULL, fill, priv);
+}
+
+/*
+ * Queues read reply split into @piece_size pieces or into @num pieces of any size if @piece_size is zero
+ */
+static struct dnet_send_pieces *dnet_send_read_reply_pieces_queue(void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, uint64_t piece_size, int num, int *errp)
+{
+	static const uint64_t hsize = sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr);
+	struct dnet_send_pieces *p;
+	struct dnet_cmd *c;
+
+	/* checksum of the whole data is not known before the pieces are read, skipped reply is not queued at all */
+	if (io->flags & (DNET_IO_FLAGS_CHECKSUM | DNET_IO_FLAGS_SKIP_SENDING)) {
+		*errp = -EINVAL;
+		return NULL;
+	}
+
+	if (io->flags & DNET_IO_FLAGS_FILTER) {
+		*errp = dnet_read_filter(state, cmd, io, NULL, -1, NULL);
+		if (*errp)
+			return NULL;
+	}
+
+	c = dnet_read_reply_alloc(cmd, io);
+	if (!c) {
+		*errp = -ENOMEM;
+		return NULL;
+	}
+
+	if (piece_size)
+		p = dnet_send_pieces_queue(state, c, hsize, io->size, piece_size, errp);
+	else
+		p = dnet_send_pieces_queue_num(state, c, hsize, num, errp);
+	free(c);
+	return p;
+}
+
+struct dnet_send_pieces *dnet_send_read_data_pieces_queue(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		uint64_t piece_size, int *errp)
+{
+	if (!piece_size) {
+		*errp = -EINVAL;
+		return NULL;
+	}
+
+	return dnet_send_read_reply_pieces_queue(state, cmd, io, piece_size, 0, errp);
+}
+
+struct dnet_send_pieces *dnet_send_read_data_parts_queue(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
+		int num, int *errp)
+{
+	return dnet_send_read_reply_pieces_queue(state, cmd, io, 0, num, errp);
+}
+
+struct dnet_async_cmd {
+	struct dnet_net_state		*st;
+	struct dnet_cmd			cmd;
+	struct timeval			start;
+};
+
+struct dnet_async_cmd *dnet_async_cmd_start(void *state, struct dnet_cmd *cmd)
+{
+	struct dnet_async_cmd *ac;
+
+	ac = malloc(sizeof(struct dnet_async_cmd));
+	if (!ac)
+		return NULL;
+
+	ac->st = dnet_state_get(state);
+	ac->cmd = *cmd;
+	gettimeofday(&ac->start, NULL);
+
+	return ac;
+}
+
+void dnet_async_cmd_complete(struct dnet_async_cmd *ac, int err)
+{
+	struct dnet_net_state *st = ac->st;
+	struct dnet_cmd *cmd = &ac->cmd;
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+
+	/* there is no other reply, client has to get an error to destroy its transaction */
+	if (err)
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+
+	dnet_node_set_trace_id(st->n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, cmd->backend_id);
+	dnet_log(st->n, err ? DNET_LOG_ERROR : DNET_LOG_INFO, "%s: %s: async completion: client: %s, trans: %llu, "
+			"cflags: %s, time: %ld usecs, err: %d.",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_state_dump_addr(st),
+			(unsigned long long)cmd->trans, dnet_flags_dump_cflags(cmd->flags), DIFF(ac->start, end), err);
+
+	dnet_send_ack(st, cmd, err, 0);
+	dnet_node_unset_trace_id();
+
+	dnet_state_put(st);
+	free(ac);
+}
+
+int dnet_send_read_data_ref(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		void (*release)(void *priv), void *priv)
+{
+	return dnet_send_read_data_raw(st, cmd, io, data, -1, 0, 0, release, priv, 0, NULL, NULL, NULL);
+}
+
 static void dnet_fill_state_addr(void *state, struct dnet_addr *addr)
 {
 	struct dnet_net_state *st = state;
@@ -1849,26 +4804,56 @@ err_out_exit:
 	return err;
 }
 
+/*
+ * Resolves name of @fd's file into @file unless reply must not contain it,
+ * returns length of the name including 0-byte or 0 if there is no name
+ */
+static int dnet_file_info_path(struct dnet_cmd *cmd, int fd, const char **path, char **file)
+{
+	int flen;
+
+	*file = NULL;
+
+	if (cmd->flags & DNET_FLAGS_NO_FILE_PATH) {
+		*path = "";
+		return 0;
+	}
+
+	if (*path)
+		return strlen(*path) + 1;
+
+	flen = dnet_fd_readlink(fd, file);
+	if (flen >= 0)
+		*path = *file;
+
+	return flen;
+}
+
+/* reply without file name still carries its 0-byte */
+#define DNET_FILE_INFO_REPLY_SIZE(flen) \
+	(sizeof(struct dnet_addr) + sizeof(struct dnet_file_info) + ((flen) ? (flen) : 1))
+
 int dnet_send_file_info(void *state, struct dnet_cmd *cmd, int fd, uint64_t offset, int64_t size)
 {
 	struct dnet_node *n = dnet_get_node_from_state(state);
 	struct dnet_file_info *info;
 	struct dnet_addr *addr;
+	const char *path = NULL;
+	size_t addr_size;
 	int flen, err;
 	char *file;
 	struct stat st;
 
-	err = dnet_fd_readlink(fd, &file);
+	err = dnet_file_info_path(cmd, fd, &path, &file);
 	if (err < 0)
 		goto err_out_exit;
 
 	flen = err;
 
-	addr = calloc(1, sizeof(struct dnet_addr) + sizeof(struct dnet_file_info) + flen);
-	if (!addr) {
-		err = -ENOMEM;
-		goto err_out_free_file;
-	}
+	/* dnet_send_reply() copies reply, so it is built on the stack */
+	addr_size = DNET_FILE_INFO_REPLY_SIZE(flen);
+	addr = alloca(addr_size);
+	memset(addr, 0, addr_size);
 	info = (struct dnet_file_info *)(addr + 1);
 
 	dnet_fill_state_addr(state, addr);
@@ -1878,8 +4863,8 @@ int dnet_send_file_info(void *state, struct dnet_cmd *cmd, int fd, uint64_t offs
 	if (err) {
 		err = -errno;
 		dnet_log(n, DNET_LOG_ERROR, "%s: file-info: %s: info-stat: %d: %s.",
-				dnet_dump_id(&cmd->id), file, err, strerror(-err));
-		goto err_out_free;
+				dnet_dump_id(&cmd->id), path, err, strerror(-err));
+		goto err_out_free_file;
 	}
 
 	dnet_info_from_stat(info, &st);
@@ -1895,27 +4880,25 @@ int dnet_send_file_info(void *state, struct dnet_cmd *cmd, int fd, uint64_t offs
 		err = dnet_checksum_fd(n, fd, info->offset, info->size, info->checksum, sizeof(info->checksum));
 		if (err) {
 			dnet_log(n, DNET_LOG_ERROR, "%s: file-info: %s: checksum: %d: %s.",
-					dnet_dump_id(&cmd->id), file, err, strerror(-err));
-			goto err_out_free;
+					dnet_dump_id(&cmd->id), path, err, strerror(-err));
+			goto err_out_free_file;
 		}
 	}
 
 	if (info->size == 0) {
 		err = -EINVAL;
 		dnet_log(n, DNET_LOG_NOTICE, "%s: EBLOB: %s: info-stat: ZERO-FILE-SIZE, fd: %d.",
-				dnet_dump_id(&cmd->id), file, fd);
-		goto err_out_free;
+				dnet_dump_id(&cmd->id), path, fd);
+		goto err_out_free_file;
 	}
 
 	info->flen = flen;
-	memcpy(info + 1, file, flen);
+	memcpy(info + 1, path, flen);
 
 	dnet_convert_file_info(info);
 
-	err = dnet_send_reply(state, cmd, addr, sizeof(struct dnet_addr) + sizeof(struct dnet_file_info) + flen, 0);
+	err = dnet_send_reply(state, cmd, addr, addr_size, 0);
 
-err_out_free:
-	free(addr);
 err_out_free_file:
 	free(file);
 err_out_exit:
@@ -1928,6 +4911,12 @@ err_out_exit:
  */
 int dnet_send_file_info_ts(void *state, struct dnet_cmd *cmd, int fd, uint64_t offset, int64_t size,
                            struct dnet_time *timestamp, uint64_t record_flags)
+{
+	return dnet_send_file_info_ts_path(state, cmd, fd, NULL, offset, size, timestamp, record_flags);
+}
+
+int dnet_send_file_info_ts_path(void *state, struct dnet_cmd *cmd, int fd, const char *path,
+                           uint64_t offset, int64_t size, struct dnet_time *timestamp, uint64_t record_flags)
 {
 	struct dnet_net_state *st = state;
 	struct dnet_file_info *info;
@@ -1942,18 +4931,16 @@ int dnet_send_file_info_ts(void *state, struct dnet_cmd *cmd, int fd, uint64_t o
 	if (size < 0 || fd < 0)
 		return -EINVAL;
 
-	flen = dnet_fd_readlink(fd, &file);
+	flen = dnet_file_info_path(cmd, fd, &path, &file);
 	if (flen < 0) {
 		err = flen;
 		goto err_out_exit;
 	}
 
-	a_size = sizeof(struct dnet_addr) + sizeof(struct dnet_file_info) + flen;
-	a = calloc(1, a_size);
-	if (a == NULL) {
-		err = -ENOMEM;
-		goto err_out_free_file;
-	}
+	/* dnet_send_reply() copies reply, so it is built on the stack */
+	a_size = DNET_FILE_INFO_REPLY_SIZE(flen);
+	a = alloca(a_size);
+	memset(a, 0, a_size);
 
 	info = (struct dnet_file_info *)(a + 1);
 
@@ -1965,7 +4952,7 @@ int dnet_send_file_info_ts(void *state, struct dnet_cmd *cmd, int fd, uint64_t o
 	info->offset = offset;
 	info->mtime = *timestamp;
 	info->flen = flen;
-	memcpy(info + 1, file, flen);
+	memcpy(info + 1, path, flen);
 
 	if (cmd->flags & DNET_FLAGS_CHECKSUM)
 		dnet_checksum_fd(st->n, fd, info->offset,
@@ -1973,9 +4960,7 @@ int dnet_send_file_info_ts(void *state, struct dnet_cmd *cmd, int fd, uint64_t o
 
 	dnet_convert_file_info(info);
 	err = dnet_send_reply(state, cmd, a, a_size, 0);
-	free(a);
 
-err_out_free_file:
 	free(file);
 err_out_exit:
 	return err;
@@ -2019,6 +5004,33 @@ int dnet_checksum_data(struct dnet_node *n, const void *data, uint64_t size, uns
 	return dnet_transform_node(n, data, size, csum, csize);
 }
 
+static int dnet_checksum_store_crc32c(uint32_t crc, void *csum, int csize)
+{
+	unsigned char *dst = csum;
+
+	if (csize < (int)sizeof(crc))
+		return -EINVAL;
+
+	memset(dst, 0, csize);
+	dst[0] = crc >> 24;
+	dst[1] = crc >> 16;
+	dst[2] = crc >> 8;
+	dst[3] = crc;
+	return 0;
+}
+
+int dnet_checksum_data_type(struct dnet_node *n, int type, const void *data, uint64_t size, unsigned char *csum, int csize)
+{
+	switch (type) {
+	case DNET_CHECKSUM_SHA512:
+		return dnet_checksum_data(n, data, size, csum, csize);
+	case DNET_CHECKSUM_CRC32C:
+		return dnet_checksum_store_crc32c(crc32c(0, data, size), csum, csize);
+	default:
+		return -ENOTSUP;
+	}
+}
+
 int dnet_checksum_file(struct dnet_node *n, const char *file, uint64_t offset, uint64_t size, void *csum, int csize)
 {
 	int fd, err;
@@ -2060,3 +5072,25 @@ int dnet_checksum_fd(struct dnet_node *n, int fd, uint64_t offset, uint64_t size
 err_out_exit:
 	return err;
 }
+
+int dnet_checksum_fd_type(struct dnet_node *n, int type, int fd, uint64_t offset, uint64_t size, void *csum, int csize)
+{
+	uint32_t crc;
+	int err;
+
+	switch (type) {
+	case DNET_CHECKSUM_SHA512:
+		return dnet_checksum_fd(n, fd, offset, size, csum, csize);
+	case DNET_CHECKSUM_CRC32C:
+		err = crc32c_file(fd, offset, size, &crc);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "CSUM: crc32c: fd: %d, offset: %" PRIu64 ", size: %" PRIu64 ": %s [%d]",
+					fd, offset, size, strerror(-err), err);
+			return err;
+		}
+
+		return dnet_checksum_store_crc32c(crc, csum, csize);
+	default:
+		return -ENOTSUP;
+	}
+}
@@ -68,6 +68,28 @@ int dnet_transform(struct dnet_session *s, const void *src, uint64_t size, struc
 	return dnet_transform_raw(s, src, size, (char *)id->id, sizeof(id->id));
 }
 
+int dnet_transform_multi(struct dnet_session *s, const void *const *src, const uint64_t *size,
+		size_t num, struct dnet_raw_id *ids)
+{
+	struct dnet_node *n = s->node;
+	struct dnet_transform *t = &n->transform;
+	size_t i;
+	int err;
+
+	if (t->transform_multi)
+		return t->transform_multi(t->priv, s, src, size, num, ids, sizeof(ids[0].id));
+
+	for (i = 0; i < num; ++i) {
+		unsigned int csize = sizeof(ids[i].id);
+
+		err = t->transform(t->priv, s, src[i], size[i], ids[i].id, &csize, 0);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 static void dnet_indexes_transform_id(struct dnet_node *node, const uint8_t *src, uint8_t *id,
 				      const char *suffix, int suffix_len)
 {
@@ -118,6 +140,15 @@ void dnet_indexes_transform_index_id(struct dnet_node *node, const struct dnet_r
 	dnet_indexes_transform_index_id_raw(node, id, shard_id);
 }
 
+void dnet_indexes_transform_capped_ring_id(struct dnet_node *node, const struct dnet_raw_id *table_id, struct dnet_raw_id *id)
+{
+	char suffix[] = "\0capped_ring";
+
+	dnet_indexes_transform_id(node, table_id->id, id->id, suffix, sizeof(suffix));
+
+	memcpy(id->id, table_id->id, DNET_ID_SIZE / 2);
+}
+
 int dnet_indexes_get_shard_id(struct dnet_node *node, const struct dnet_raw_id *object_id)
 {
 	int indexes_shard_count = node->indexes_shard_count;
@@ -136,6 +167,29 @@ int dnet_node_get_indexes_shard_count(struct dnet_node *node)
 	return node->indexes_shard_count;
 }
 
+void dnet_indexes_transform_index_split_id(const struct dnet_raw_id *table_id, int split_depth, unsigned int slot,
+		struct dnet_raw_id *id)
+{
+	memcpy(id, table_id, sizeof(struct dnet_raw_id));
+
+	/* bytes right after the shard part are zero in ids of the tables themselves */
+	id->id[4] = split_depth;
+	id->id[5] = slot >> 16;
+	id->id[6] = slot >> 8;
+	id->id[7] = slot;
+}
+
+unsigned int dnet_indexes_get_split_slot(const struct dnet_raw_id *object_id, int split_depth)
+{
+	unsigned int prefix = (object_id->id[0] << 8) | object_id->id[1];
+
+	if (!split_depth)
+		return 0;
+
+	/* the highest bits do not depend on remainder used by dnet_indexes_get_shard_id() */
+	return prefix >> (16 - split_depth);
+}
+
 static char *dnet_cmd_strings[] = {
 	[DNET_CMD_LOOKUP] = "LOOKUP",
 	[DNET_CMD_REVERSE_LOOKUP] = "REVERSE_LOOKUP",
@@ -164,6 +218,10 @@ static char *dnet_cmd_strings[] = {
 	[DNET_CMD_BACKEND_CONTROL] = "BACKEND_CONTROL",
 	[DNET_CMD_BACKEND_STATUS] = "BACKEND_STATUS",
 	[DNET_CMD_SEND] = "SERVER_SEND",
+	[DNET_CMD_BULK_WRITE] = "BULK_WRITE",
+	[DNET_CMD_ATOMIC_UPDATE] = "ATOMIC_UPDATE",
+	[DNET_CMD_BULK_REMOVE] = "BULK_REMOVE",
+	[DNET_CMD_BLOB_FILES] = "BLOB_FILES",
 	[DNET_CMD_UNKNOWN] = "UNKNOWN",
 };
 
@@ -175,6 +233,71 @@ char *dnet_cmd_string(int cmd)
 	return dnet_cmd_strings[cmd];
 }
 
+static char dnet_cmd_metric_prefixes[DNET_CMD_METRICS_MAX][DNET_CMD_METRIC_NAME_SIZE];
+static char dnet_cmd_metric_names[DNET_CMD_METRICS_MAX][__DNET_CMD_MAX][DNET_CMD_METRIC_NAME_SIZE];
+static int dnet_cmd_metric_family_num;
+static pthread_mutex_t dnet_cmd_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t dnet_cmd_metrics_once = PTHREAD_ONCE_INIT;
+
+static int dnet_cmd_metrics_register_nolock(const char *prefix)
+{
+	int family, cmd;
+
+	for (family = 0; family < dnet_cmd_metric_family_num; ++family) {
+		if (!strcmp(dnet_cmd_metric_prefixes[family], prefix))
+			return family;
+	}
+
+	if (family >= DNET_CMD_METRICS_MAX)
+		return -ENOSPC;
+
+	for (cmd = 1; cmd < __DNET_CMD_MAX; ++cmd) {
+		const int len = snprintf(dnet_cmd_metric_names[family][cmd], DNET_CMD_METRIC_NAME_SIZE,
+				"%s%s", prefix, dnet_cmd_string(cmd));
+		if (len >= DNET_CMD_METRIC_NAME_SIZE)
+			return -ENAMETOOLONG;
+	}
+	snprintf(dnet_cmd_metric_prefixes[family], DNET_CMD_METRIC_NAME_SIZE, "%s", prefix);
+
+	/* names of the family are visible to everyone who gets its handle */
+	__atomic_store_n(&dnet_cmd_metric_family_num, family + 1, __ATOMIC_RELEASE);
+	return family;
+}
+
+static void dnet_cmd_metrics_init_builtin(void)
+{
+	pthread_mutex_lock(&dnet_cmd_metrics_lock);
+	dnet_cmd_metrics_register_nolock("io.cmd.");
+	dnet_cmd_metrics_register_nolock("io.cmd_recursive.");
+	dnet_cmd_metrics_register_nolock("cache.");
+	pthread_mutex_unlock(&dnet_cmd_metrics_lock);
+}
+
+int dnet_cmd_metrics_register(const char *prefix)
+{
+	int family;
+
+	pthread_once(&dnet_cmd_metrics_once, dnet_cmd_metrics_init_builtin);
+
+	pthread_mutex_lock(&dnet_cmd_metrics_lock);
+	family = dnet_cmd_metrics_register_nolock(prefix);
+	pthread_mutex_unlock(&dnet_cmd_metrics_lock);
+
+	return family;
+}
+
+const char *dnet_cmd_metric_name(int family, int cmd)
+{
+	pthread_once(&dnet_cmd_metrics_once, dnet_cmd_metrics_init_builtin);
+
+	if (family < 0 || family >= __atomic_load_n(&dnet_cmd_metric_family_num, __ATOMIC_ACQUIRE))
+		family = DNET_CMD_METRICS_IO;
+	if (cmd <= 0 || cmd >= __DNET_CMD_MAX || cmd >= DNET_CMD_UNKNOWN)
+		cmd = DNET_CMD_UNKNOWN;
+
+	return dnet_cmd_metric_names[family][cmd];
+}
+
 const char *dnet_backend_state_string(uint32_t state)
 {
 	switch ((enum dnet_backend_state)state) {
@@ -207,6 +330,28 @@ const char *dnet_backend_defrag_state_string(uint32_t state)
 	}
 }
 
+const char *dnet_backend_activation_stage_string(uint32_t stage)
+{
+	switch ((enum dnet_backend_activation_stage)stage) {
+		case DNET_BACKEND_STAGE_NONE:
+			return "none";
+		case DNET_BACKEND_STAGE_CONFIG:
+			return "reading config";
+		case DNET_BACKEND_STAGE_STORAGE:
+			return "loading storage";
+		case DNET_BACKEND_STAGE_CHANGE_LOG:
+			return "opening change log";
+		case DNET_BACKEND_STAGE_IO_POOL:
+			return "starting io pool";
+		case DNET_BACKEND_STAGE_CACHE:
+			return "starting cache";
+		case DNET_BACKEND_STAGE_ROUTES:
+			return "announcing routes";
+		default:
+			return "unknown";
+	}
+}
+
 int dnet_copy_addrs_nolock(struct dnet_net_state *nst, struct dnet_addr *addrs, int addr_num)
 {
 	char addr_str[128];
@@ -390,6 +535,7 @@ void dnet_io_trans_alloc_send(struct dnet_session *s, struct dnet_io_control *ct
 
 	memcpy(&t->cmd, cmd, sizeof(struct dnet_cmd));
 
+	dnet_trans_set_adaptive_timeout(s, t, cmd->backend_id);
 	dnet_get_backend_weight(t->st, cmd->backend_id, io->flags, &backend_weight);
 	request_addr = dnet_state_addr(t->st);
 
@@ -419,6 +565,19 @@ void dnet_io_trans_alloc_send(struct dnet_session *s, struct dnet_io_control *ct
 	} else {
 		req.data = (void *)ctl->data;
 		req.dsize = size;
+
+		if (ctl->iovcnt && size) {
+			req.iov = (struct iovec *)ctl->iov;
+			req.iovcnt = ctl->iovcnt;
+		}
+
+		/* every transaction holds its own reference, it is dropped by dnet_trans_send() */
+		if (ctl->data_release && size) {
+			if (ctl->data_acquire)
+				ctl->data_acquire(ctl->data_priv);
+			req.data_release = ctl->data_release;
+			req.data_priv = ctl->data_priv;
+		}
 	}
 
 	err = dnet_trans_send(t, &req);
@@ -543,7 +702,7 @@ int dnet_send_cmd(struct dnet_session *s,
 	} else if (id && id->group_id == 0) {
 		ctl.id = *id;
 
-		pthread_mutex_lock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
 		for (i = 0; i < s->group_num; ++i) {
 			ctl.id.group_id = s->groups[i];
 
@@ -560,10 +719,10 @@ int dnet_send_cmd(struct dnet_session *s,
 				num++;
 			}
 		}
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 	} else {
 		// TODO: refactor code below
-		pthread_mutex_lock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
 		list_for_each_entry(st, &n->dht_state_list, node_entry) {
 			if (st == n->st)
 				continue;
@@ -591,7 +750,7 @@ int dnet_send_cmd(struct dnet_session *s,
 			}
 			pthread_rwlock_unlock(&st->idc_lock);
 		}
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 	}
 
 	return num;
@@ -636,7 +795,7 @@ int dnet_request_cmd(struct dnet_session *s, struct dnet_trans_control *ctl)
 
 	gettimeofday(&start, NULL);
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
 		g = rb_entry(it, struct dnet_group, group_entry);
 		list_for_each_entry(idc, &g->idc_list, group_entry) {
@@ -655,7 +814,7 @@ int dnet_request_cmd(struct dnet_session *s, struct dnet_trans_control *ctl)
 			num++;
 		}
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	gettimeofday(&end, NULL);
 	diff = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
@@ -756,7 +915,144 @@ static int dnet_weight_get_winner(struct dnet_weight *w, int num)
 	return num - 1;
 }
 
-int dnet_mix_states(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags, int **groupsp)
+static int dnet_latency_compare(const void *v1, const void *v2)
+{
+	const struct dnet_weight *w1 = v1;
+	const struct dnet_weight *w2 = v2;
+
+	if (w1->weight < w2->weight)
+		return -1;
+	if (w1->weight > w2->weight)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Orders groups by expected read cost of their backends: mean of latency EWMA and 99th percentile
+ * multiplied by number of requests queued to the backend's node.
+ *
+ * The first group is selected by two random choices (the cheaper of two random groups wins),
+ * so that all clients do not jump onto the same fastest replica at once, the rest are sorted by cost.
+ * Backends without latency samples yet are the cheapest ones, so they are probed.
+ */
+static int dnet_mix_states_latency(struct dnet_node *n, struct dnet_id *id, int *groups, int group_num)
+{
+	struct dnet_weight *costs;
+	struct dnet_backend_latency latency;
+	struct dnet_net_state *st;
+	int i, num, backend_id;
+
+	costs = alloca(group_num * sizeof(*costs));
+
+	for (i = 0, num = 0; i < group_num; ++i) {
+		id->group_id = groups[i];
+
+		st = dnet_state_get_first_with_backend(n, id, &backend_id);
+		if (!st)
+			continue;
+
+		costs[num].group_id = id->group_id;
+		costs[num].weight = 0;
+
+		if (!dnet_get_backend_latency(st, backend_id, 99, &latency))
+			costs[num].weight = (latency.ewma + latency.percentile) / 2 * (latency.outstanding + 1);
+
+		num++;
+		dnet_state_put(st);
+	}
+
+	if (num > 1) {
+		int first = rand() % num;
+		int second = rand() % (num - 1);
+		struct dnet_weight tmp;
+
+		if (second >= first)
+			second++;
+
+		if (costs[second].weight < costs[first].weight)
+			first = second;
+
+		tmp = costs[0];
+		costs[0] = costs[first];
+		costs[first] = tmp;
+
+		qsort(costs + 1, num - 1, sizeof(struct dnet_weight), dnet_latency_compare);
+	}
+
+	for (i = 0; i < num; ++i)
+		groups[i] = costs[i].group_id;
+
+	return num;
+}
+
+/*
+ * Moves groups whose backend for @id lives in the node's locality to the front keeping the order
+ * selected so far among both local and remote groups, so that reads go to remote replicas
+ * only after local ones have failed or timed out.
+ */
+static void dnet_mix_states_locality(struct dnet_node *n, struct dnet_id *id, int *groups, int group_num)
+{
+	struct dnet_net_state *st;
+	const char *label;
+	int *remote;
+	int i, local_num, remote_num, backend_id;
+
+	remote = alloca(group_num * sizeof(*remote));
+
+	for (i = 0, local_num = 0, remote_num = 0; i < group_num; ++i) {
+		id->group_id = groups[i];
+		label = NULL;
+
+		st = dnet_state_get_first_with_backend(n, id, &backend_id);
+		if (st) {
+			label = dnet_locality_match(n, &st->addr);
+			dnet_state_put(st);
+		}
+
+		if (label && !strcmp(label, n->locality))
+			groups[local_num++] = groups[i];
+		else
+			remote[remote_num++] = groups[i];
+	}
+
+	memcpy(groups + local_num, remote, remote_num * sizeof(*remote));
+}
+
+/*
+ * Moves groups whose backends for @id are ejected by outlier detection to the end keeping the order
+ * selected so far, backends recovering after ejection are moved with probability falling during recovery.
+ * If all of them are ejected, the order is not changed.
+ */
+static void dnet_mix_states_outliers(struct dnet_node *n, struct dnet_id *id, int *groups, int group_num)
+{
+	const uint64_t now = dnet_monotonic_usecs();
+	struct dnet_net_state *st;
+	int *ejected;
+	int i, healthy_num, ejected_num, backend_id, deprioritized;
+
+	ejected = alloca(group_num * sizeof(*ejected));
+
+	for (i = 0, healthy_num = 0, ejected_num = 0; i < group_num; ++i) {
+		id->group_id = groups[i];
+		deprioritized = 0;
+
+		st = dnet_state_get_first_with_backend(n, id, &backend_id);
+		if (st) {
+			deprioritized = dnet_backend_deprioritized(st, backend_id, now);
+			dnet_state_put(st);
+		}
+
+		if (deprioritized)
+			ejected[ejected_num++] = groups[i];
+		else
+			groups[healthy_num++] = groups[i];
+	}
+
+	memcpy(groups + healthy_num, ejected, ejected_num * sizeof(*ejected));
+}
+
+static int dnet_mix_states_ordered(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags, int **groupsp)
 {
 	struct dnet_node *n = s->node;
 	struct dnet_weight *weights;
@@ -779,6 +1075,17 @@ int dnet_mix_states(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags
 		return -ENOMEM;
 	}
 
+	if (id && (n->flags & DNET_CFG_LATENCY_STATES) && !(ioflags & DNET_IO_FLAGS_MIX_STATES)) {
+		num = dnet_mix_states_latency(n, id, groups, group_num);
+		if (num == 0) {
+			free(groups);
+			return -ENXIO;
+		}
+
+		*groupsp = groups;
+		return num;
+	}
+
 	/*
 	 * ioflags has highest priority, if it has mix-states bit, it must be taken into account
 	 */
@@ -841,6 +1148,20 @@ int dnet_mix_states(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags
 	return group_num;
 }
 
+int dnet_mix_states(struct dnet_session *s, struct dnet_id *id, uint32_t ioflags, int **groupsp)
+{
+	struct dnet_node *n = s->node;
+	int num;
+
+	num = dnet_mix_states_ordered(s, id, ioflags, groupsp);
+	if (num > 1 && id && (n->flags & DNET_CFG_LOCALITY_STATES) && n->locality)
+		dnet_mix_states_locality(n, id, *groupsp, num);
+	if (num > 1 && id && (n->flags & DNET_CFG_OUTLIER_STATES))
+		dnet_mix_states_outliers(n, id, *groupsp, num);
+
+	return num;
+}
+
 static int dnet_data_map_ll(struct dnet_map_fd *map, int prot)
 {
 	uint64_t off;
@@ -893,7 +1214,7 @@ int dnet_get_routes(struct dnet_session *s, struct dnet_route_entry **entries) {
 
 	*entries = NULL;
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	list_for_each_entry(st, &n->dht_state_list, node_entry) {
 		pthread_rwlock_rdlock(&st->idc_lock);
 		for (it = rb_first(&st->idc_root); it; it = rb_next(it)) {
@@ -922,7 +1243,7 @@ int dnet_get_routes(struct dnet_session *s, struct dnet_route_entry **entries) {
 		}
 		pthread_rwlock_unlock(&st->idc_lock);
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	return count;
 
@@ -960,14 +1281,314 @@ static int dnet_iterator_response_cmp(const void *r1, const void *r2)
 	return diff;
 }
 
+/*
+ * Responses are sorted by chunks which fit into memory, every chunk is sorted by its own thread.
+ * Sorted chunks (runs) are stored in temporary file and then merged back into original file.
+ * Memory used for sorting is bounded by 2 * chunk size * number of threads.
+ */
+#define DNET_ITERATOR_SORT_CHUNK_SIZE		(32 * 1024 * 1024)
+#define DNET_ITERATOR_SORT_MAX_THREADS		8
+/* Total size of read buffers of all runs during merge phase */
+#define DNET_ITERATOR_SORT_MERGE_MEMORY		(256 * 1024 * 1024)
+#define DNET_ITERATOR_SORT_MERGE_MIN_BUFFER	64
+
+/*!
+ * Sorts \a nel responses from \a src in memory, \a tmp must be able to hold \a nel responses.
+ * Responses are distributed into buckets by the first byte of the key and then every bucket
+ * is sorted using \fn dnet_iterator_response_cmp, result is put into \a src.
+ */
+static void dnet_iterator_response_sort_chunk(struct dnet_iterator_response *src,
+		struct dnet_iterator_response *tmp, size_t nel)
+{
+	size_t offsets[257];
+	size_t i;
+
+	memset(offsets, 0, sizeof(offsets));
+
+	for (i = 0; i < nel; ++i)
+		offsets[src[i].key.id[0] + 1]++;
+	for (i = 1; i < 257; ++i)
+		offsets[i] += offsets[i - 1];
+
+	for (i = 0; i < nel; ++i)
+		tmp[offsets[src[i].key.id[0]]++] = src[i];
+
+	for (i = 256; i > 0; --i)
+		offsets[i] = offsets[i - 1];
+	offsets[0] = 0;
+
+	for (i = 0; i < 256; ++i) {
+		const size_t num = offsets[i + 1] - offsets[i];
+
+		if (num > 1)
+			qsort(tmp + offsets[i], num, sizeof(struct dnet_iterator_response), dnet_iterator_response_cmp);
+	}
+
+	memcpy(src, tmp, nel * sizeof(struct dnet_iterator_response));
+}
+
+struct dnet_iterator_sort_ctl {
+	int			fd;
+	int			tmp_fd;
+	size_t			size;
+	size_t			chunk_size;
+	size_t			chunks_num;
+
+	pthread_mutex_t		lock;
+	size_t			next_chunk;
+	int			err;
+};
+
+static void *dnet_iterator_sort_chunks(void *priv)
+{
+	struct dnet_iterator_sort_ctl *ctl = priv;
+	struct dnet_iterator_response *src, *tmp = NULL;
+	size_t idx, offset, size;
+	int err = 0;
+
+	src = malloc(ctl->chunk_size);
+	if (src)
+		tmp = malloc(ctl->chunk_size);
+	if (!src || !tmp) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	while (1) {
+		pthread_mutex_lock(&ctl->lock);
+		idx = ctl->next_chunk++;
+		err = ctl->err;
+		pthread_mutex_unlock(&ctl->lock);
+
+		if (err || idx >= ctl->chunks_num)
+			break;
+
+		offset = idx * ctl->chunk_size;
+		size = ctl->size - offset;
+		if (size > ctl->chunk_size)
+			size = ctl->chunk_size;
+
+		err = dnet_read_ll(ctl->fd, (char *)src, size, offset);
+		if (err)
+			break;
+
+		dnet_iterator_response_sort_chunk(src, tmp, size / sizeof(struct dnet_iterator_response));
+
+		/* the only chunk is put back in place, there is nothing to merge */
+		err = dnet_write_ll(ctl->tmp_fd >= 0 ? ctl->tmp_fd : ctl->fd, (char *)src, size, offset);
+		if (err)
+			break;
+	}
+
+err_out_free:
+	free(tmp);
+	free(src);
+
+	if (err) {
+		pthread_mutex_lock(&ctl->lock);
+		if (!ctl->err)
+			ctl->err = err;
+		pthread_mutex_unlock(&ctl->lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Sorted run which is being merged, responses are read by @buffer_size pieces
+ */
+struct dnet_iterator_sort_run {
+	struct dnet_iterator_response	*buffer;
+	size_t				buffer_num, buffer_pos;
+	off_t				offset, end;
+};
+
+static int dnet_iterator_sort_run_fill(int fd, struct dnet_iterator_sort_run *run, size_t buffer_size)
+{
+	size_t size = run->end - run->offset;
+	int err;
+
+	if (size > buffer_size)
+		size = buffer_size;
+
+	run->buffer_pos = 0;
+	run->buffer_num = size / sizeof(struct dnet_iterator_response);
+	if (!size)
+		return 0;
+
+	err = dnet_read_ll(fd, (char *)run->buffer, size, run->offset);
+	if (err)
+		return err;
+
+	run->offset += size;
+	return 0;
+}
+
+static inline int dnet_iterator_sort_run_cmp(struct dnet_iterator_sort_run *r1, struct dnet_iterator_sort_run *r2)
+{
+	return dnet_iterator_response_cmp(&r1->buffer[r1->buffer_pos], &r2->buffer[r2->buffer_pos]);
+}
+
+static void dnet_iterator_sort_heap_down(struct dnet_iterator_sort_run **heap, size_t num, size_t pos)
+{
+	while (1) {
+		size_t min = pos, left = 2 * pos + 1, right = 2 * pos + 2;
+		struct dnet_iterator_sort_run *tmp;
+
+		if (left < num && dnet_iterator_sort_run_cmp(heap[left], heap[min]) < 0)
+			min = left;
+		if (right < num && dnet_iterator_sort_run_cmp(heap[right], heap[min]) < 0)
+			min = right;
+		if (min == pos)
+			break;
+
+		tmp = heap[pos];
+		heap[pos] = heap[min];
+		heap[min] = tmp;
+		pos = min;
+	}
+}
+
+/*
+ * Merges sorted runs from @ctl->tmp_fd into @ctl->fd
+ */
+static int dnet_iterator_sort_merge(struct dnet_iterator_sort_ctl *ctl)
+{
+	const size_t resp_size = sizeof(struct dnet_iterator_response);
+	struct dnet_iterator_sort_run *runs, **heap;
+	struct dnet_iterator_response *out;
+	size_t buffer_size, heap_num = 0, out_num = 0, i;
+	off_t out_offset = 0;
+	int err = 0;
+
+	buffer_size = DNET_ITERATOR_SORT_MERGE_MEMORY / (ctl->chunks_num + 1);
+	buffer_size -= buffer_size % resp_size;
+	if (buffer_size < DNET_ITERATOR_SORT_MERGE_MIN_BUFFER * resp_size)
+		buffer_size = DNET_ITERATOR_SORT_MERGE_MIN_BUFFER * resp_size;
+
+	runs = calloc(ctl->chunks_num, sizeof(struct dnet_iterator_sort_run));
+	heap = calloc(ctl->chunks_num, sizeof(struct dnet_iterator_sort_run *));
+	out = malloc(buffer_size);
+	if (!runs || !heap || !out) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	for (i = 0; i < ctl->chunks_num; ++i) {
+		struct dnet_iterator_sort_run *run = &runs[i];
+
+		run->buffer = malloc(buffer_size);
+		if (!run->buffer) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+
+		run->offset = i * ctl->chunk_size;
+		run->end = run->offset + ctl->chunk_size;
+		if (run->end > (off_t)ctl->size)
+			run->end = ctl->size;
+
+		err = dnet_iterator_sort_run_fill(ctl->tmp_fd, run, buffer_size);
+		if (err)
+			goto err_out_free;
+
+		if (run->buffer_num)
+			heap[heap_num++] = run;
+	}
+
+	for (i = heap_num; i > 0; --i)
+		dnet_iterator_sort_heap_down(heap, heap_num, i - 1);
+
+	while (heap_num) {
+		struct dnet_iterator_sort_run *run = heap[0];
+
+		out[out_num++] = run->buffer[run->buffer_pos++];
+		if (out_num * resp_size == buffer_size) {
+			err = dnet_write_ll(ctl->fd, (char *)out, out_num * resp_size, out_offset);
+			if (err)
+				goto err_out_free;
+
+			out_offset += out_num * resp_size;
+			out_num = 0;
+		}
+
+		if (run->buffer_pos == run->buffer_num) {
+			err = dnet_iterator_sort_run_fill(ctl->tmp_fd, run, buffer_size);
+			if (err)
+				goto err_out_free;
+
+			if (!run->buffer_num)
+				heap[0] = heap[--heap_num];
+		}
+
+		dnet_iterator_sort_heap_down(heap, heap_num, 0);
+	}
+
+	if (out_num)
+		err = dnet_write_ll(ctl->fd, (char *)out, out_num * resp_size, out_offset);
+
+err_out_free:
+	if (runs) {
+		for (i = 0; i < ctl->chunks_num; ++i)
+			free(runs[i].buffer);
+	}
+	free(out);
+	free(heap);
+	free(runs);
+	return err;
+}
+
+/*
+ * Creates unlinked temporary file in the same directory as @fd if possible
+ */
+static int dnet_iterator_sort_tmpfile(int fd)
+{
+	char path[PATH_MAX], link[64];
+	const char *dir;
+	ssize_t len;
+	int tmp_fd;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+	len = readlink(link, path, sizeof(path) - sizeof("/.dnet-sort-XXXXXX"));
+	if (len > 0 && path[0] == '/') {
+		char *slash;
+
+		path[len] = '\0';
+		slash = strrchr(path, '/');
+		*slash = '\0';
+		strcat(path, "/.dnet-sort-XXXXXX");
+
+		tmp_fd = mkstemp(path);
+		if (tmp_fd >= 0)
+			goto out_unlink;
+	}
+
+	dir = getenv("TMPDIR");
+	if (!dir)
+		dir = "/tmp";
+
+	snprintf(path, sizeof(path), "%s/.dnet-sort-XXXXXX", dir);
+	tmp_fd = mkstemp(path);
+	if (tmp_fd < 0)
+		return -errno;
+
+out_unlink:
+	unlink(path);
+	return tmp_fd;
+}
+
 /*!
  * Sort responses using \fn dnet_iterator_response_cmp
+ *
+ * File is sorted by chunks in parallel and than chunks are merged,
+ * thus whole file is never mapped or loaded into memory.
  */
 int dnet_iterator_response_container_sort(int fd, size_t size)
 {
-	struct dnet_map_fd map = { .fd = fd, .size = size };
 	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
-	const size_t nel = size / resp_size;
+	struct dnet_iterator_sort_ctl ctl;
+	pthread_t threads[DNET_ITERATOR_SORT_MAX_THREADS];
+	long threads_num, i;
 	int err;
 
 	/* Sanity */
@@ -980,16 +1601,63 @@ int dnet_iterator_response_container_sort(int fd, size_t size)
 	if (size == 0)
 		return 0;
 
-	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.fd = fd;
+	ctl.tmp_fd = -1;
+	ctl.size = size;
+	ctl.chunk_size = DNET_ITERATOR_SORT_CHUNK_SIZE - DNET_ITERATOR_SORT_CHUNK_SIZE % resp_size;
+	if (ctl.chunk_size > size)
+		ctl.chunk_size = size;
+	ctl.chunks_num = (size + ctl.chunk_size - 1) / ctl.chunk_size;
+
+	if (ctl.chunks_num > 1) {
+		ctl.tmp_fd = dnet_iterator_sort_tmpfile(fd);
+		if (ctl.tmp_fd < 0)
+			return ctl.tmp_fd;
+	}
 
-	if ((err = dnet_data_map_rw(&map)) != 0)
-		return err;
-	qsort(map.data, nel, resp_size, dnet_iterator_response_cmp);
-	dnet_data_unmap(&map);
+	err = pthread_mutex_init(&ctl.lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_close;
+	}
 
 	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-	return 0;
+	threads_num = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads_num > DNET_ITERATOR_SORT_MAX_THREADS)
+		threads_num = DNET_ITERATOR_SORT_MAX_THREADS;
+	if (threads_num > (long)ctl.chunks_num)
+		threads_num = ctl.chunks_num;
+	if (threads_num < 1)
+		threads_num = 1;
+
+	/* The current thread sorts chunks too */
+	for (i = 1; i < threads_num; ++i) {
+		if (pthread_create(&threads[i], NULL, dnet_iterator_sort_chunks, &ctl))
+			break;
+	}
+	threads_num = i;
+
+	dnet_iterator_sort_chunks(&ctl);
+
+	for (i = 1; i < threads_num; ++i)
+		pthread_join(threads[i], NULL);
+
+	err = ctl.err;
+	if (!err && ctl.tmp_fd >= 0) {
+		posix_fadvise(ctl.tmp_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		err = dnet_iterator_sort_merge(&ctl);
+	}
+
+	pthread_mutex_destroy(&ctl.lock);
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+err_out_close:
+	if (ctl.tmp_fd >= 0)
+		close(ctl.tmp_fd);
+	return err;
 }
 
 /*!
@@ -1039,29 +1707,192 @@ int dnet_iterator_response_container_read(int fd, uint64_t pos,
 	return 0;
 }
 
+/*
+ * Right container is split into ranges of whole keys which are diffed in parallel,
+ * every range is at least this big
+ */
+#define DNET_ITERATOR_DIFF_MIN_RANGE		(32 * 1024 * 1024)
+/* Diff of every range is written by pieces of this size */
+#define DNET_ITERATOR_DIFF_BUFFER_SIZE		(1024 * 1024)
+
+struct dnet_iterator_diff_range {
+	const struct dnet_iterator_response	*left, *right;
+	size_t					left_num, right_num;
+	/* number of responses in the diff of the range and their position in diff container */
+	uint64_t				diff_num;
+	uint64_t				diff_offset;
+};
+
+struct dnet_iterator_diff_ctl {
+	int				diff_fd;
+	/* 0 - only count diff of every range, 1 - write it */
+	int				write;
+	struct dnet_iterator_diff_range	*ranges;
+	size_t				ranges_num;
+
+	pthread_mutex_t			lock;
+	size_t				next_range;
+	int				err;
+};
+
+/*!
+ * Returns position of the first response after \a pos with key different from it
+ */
+static inline size_t dnet_iterator_response_next_key(const struct dnet_iterator_response *resp, size_t pos, size_t num)
+{
+	size_t next = pos + 1;
+
+	while (next < num && !dnet_id_cmp_str(resp[pos].key.id, resp[next].key.id))
+		++next;
+
+	return next;
+}
+
 /*!
- * Shifts offset and skips response with equal keys.
+ * Returns position of the first response with key not less than \a id
  */
-static inline void dnet_iterator_response_skip_equal_keys(const struct dnet_iterator_response *resp,
-		uint64_t *offset, uint64_t size)
+static size_t dnet_iterator_response_lower_bound(const struct dnet_iterator_response *resp, size_t num,
+		const unsigned char *id)
 {
-	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
-	uint64_t next_offset = *offset + resp_size;
+	size_t begin = 0, end = num;
+
+	while (begin < end) {
+		const size_t middle = begin + (end - begin) / 2;
+
+		if (dnet_id_cmp_str(resp[middle].key.id, id) < 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return begin;
+}
+
+/*!
+ * Counts diff of \a range or, if \a buffer is set, writes it to \a diff_fd through \a buffer.
+ *
+ * Responses of the same key are sorted newest first, so only the first ones are compared:
+ * right one goes into diff unless left container has the same key which is not older.
+ */
+static int dnet_iterator_diff_range(struct dnet_iterator_diff_range *range, int diff_fd,
+		struct dnet_iterator_response *buffer)
+{
+	const size_t buffer_num = DNET_ITERATOR_DIFF_BUFFER_SIZE / sizeof(struct dnet_iterator_response);
+	const size_t resp_size = sizeof(struct dnet_iterator_response);
+	uint64_t offset = range->diff_offset;
+	size_t left = 0, right = 0, buffered = 0;
+	uint64_t diff_num = 0;
+	int err;
+
+	while (right < range->right_num) {
+		const struct dnet_iterator_response *resp = range->right + right;
+		int cmp = 1;
+
+		while (left < range->left_num) {
+			cmp = dnet_id_cmp_str(range->left[left].key.id, resp->key.id);
+			if (cmp >= 0)
+				break;
+
+			left = dnet_iterator_response_next_key(range->left, left, range->left_num);
+			cmp = 1;
+		}
+
+		if (cmp > 0 || dnet_iterator_response_cmp(range->left + left, resp) > 0) {
+			if (buffer) {
+				buffer[buffered] = *resp;
+				dnet_convert_iterator_response(&buffer[buffered]);
+
+				if (++buffered == buffer_num) {
+					err = dnet_write_ll(diff_fd, (char *)buffer, buffered * resp_size, offset);
+					if (err)
+						return err;
+
+					offset += buffered * resp_size;
+					buffered = 0;
+				}
+			}
+
+			++diff_num;
+		}
+
+		right = dnet_iterator_response_next_key(range->right, right, range->right_num);
+	}
+
+	if (buffered) {
+		err = dnet_write_ll(diff_fd, (char *)buffer, buffered * resp_size, offset);
+		if (err)
+			return err;
+	}
+
+	range->diff_num = diff_num;
+	return 0;
+}
+
+static void *dnet_iterator_diff_ranges(void *priv)
+{
+	struct dnet_iterator_diff_ctl *ctl = priv;
+	struct dnet_iterator_response *buffer = NULL;
+	size_t idx;
+	int err = 0;
+
+	if (ctl->write) {
+		buffer = malloc(DNET_ITERATOR_DIFF_BUFFER_SIZE);
+		if (!buffer) {
+			err = -ENOMEM;
+			goto err_out_exit;
+		}
+	}
 
-	while (next_offset < size) {
-		const uint64_t current_pos = *offset / resp_size;
-		const uint64_t next_pos = next_offset / resp_size;
-		const struct dnet_iterator_response *curr = resp + current_pos;
-		const struct dnet_iterator_response *next = resp + next_pos;
+	while (1) {
+		pthread_mutex_lock(&ctl->lock);
+		idx = ctl->next_range++;
+		err = ctl->err;
+		pthread_mutex_unlock(&ctl->lock);
 
-		if (dnet_id_cmp_str(curr->key.id, next->key.id))
+		if (err || idx >= ctl->ranges_num)
 			break;
 
-		*offset += resp_size;
-		next_offset += resp_size;
+		err = dnet_iterator_diff_range(&ctl->ranges[idx], ctl->diff_fd, buffer);
+		if (err)
+			break;
+	}
+
+	free(buffer);
+
+err_out_exit:
+	if (err) {
+		pthread_mutex_lock(&ctl->lock);
+		if (!ctl->err)
+			ctl->err = err;
+		pthread_mutex_unlock(&ctl->lock);
 	}
 
-	*offset += resp_size;
+	return NULL;
+}
+
+/*!
+ * Runs one pass over all ranges by \a threads_num threads including the current one
+ */
+static int dnet_iterator_diff_pass(struct dnet_iterator_diff_ctl *ctl, long threads_num, int write)
+{
+	pthread_t threads[DNET_ITERATOR_SORT_MAX_THREADS];
+	long i;
+
+	ctl->write = write;
+	ctl->next_range = 0;
+
+	for (i = 1; i < threads_num; ++i) {
+		if (pthread_create(&threads[i], NULL, dnet_iterator_diff_ranges, ctl))
+			break;
+	}
+	threads_num = i;
+
+	dnet_iterator_diff_ranges(ctl);
+
+	for (i = 1; i < threads_num; ++i)
+		pthread_join(threads[i], NULL);
+
+	return ctl->err;
 }
 
 /*!
@@ -1071,6 +1902,10 @@ static inline void dnet_iterator_response_skip_equal_keys(const struct dnet_iter
  * NB! For now only right outer difference is supported, so returned container
  * has only items that exist only in right, or exist in both but right one is
  * newer (w.r.t. timestamp).
+ *
+ * Right container is split into ranges which are diffed in parallel with the matching
+ * ranges of the left one. Diffs are counted first, so that every range knows where its diff
+ * starts, and then they are written by big sequential pieces.
  */
 int64_t dnet_iterator_response_container_diff(int diff_fd, int left_fd, uint64_t left_size,
 		int right_fd, uint64_t right_size)
@@ -1078,8 +1913,12 @@ int64_t dnet_iterator_response_container_diff(int diff_fd, int left_fd, uint64_t
 	struct dnet_map_fd left_map = { .fd = left_fd, .size = left_size };
 	struct dnet_map_fd right_map = { .fd = right_fd, .size = right_size };
 	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
-	uint64_t left_offset = 0, right_offset = 0;
-	int64_t diff_offset = 0, err = 0;
+	const struct dnet_iterator_response *left, *right;
+	struct dnet_iterator_diff_ctl ctl;
+	size_t left_num, right_num, i, begin;
+	uint64_t diff_num = 0;
+	long threads_num;
+	int64_t err = 0;
 
 	/* Sanity */
 	if (diff_fd < 0 || left_fd < 0 || right_fd < 0)
@@ -1089,68 +1928,102 @@ int64_t dnet_iterator_response_container_diff(int diff_fd, int left_fd, uint64_t
 	if (right_size % resp_size != 0)
 		return -EINVAL;
 
-	/* mmap both containers */
-	if ((err = dnet_data_map(&left_map)) != 0)
+	if (right_size == 0)
+		return 0;
+
+	/* mmap both containers, empty one can not be mapped */
+	if (left_size && (err = dnet_data_map(&left_map)) != 0)
 		goto err;
 	if ((err = dnet_data_map(&right_map)) != 0)
 		goto err_unmap_left;
 
-	/*
-	 * Compute difference between two sorted lists.
-	 * - We add elements from right list to diff until they are than
-	 *   current element in left list;
-	 * - We skip elements in left list until they are ge then current
-	 * element in right one;
-	 * - In case elements are equal skip both.
-	 */
-	while (right_offset < right_size) {
-		const uint64_t left_pos = left_offset / resp_size;
-		const uint64_t right_pos = right_offset / resp_size;
-		const struct dnet_iterator_response *left =
-			(struct dnet_iterator_response *)left_map.data + left_pos;
-		const struct dnet_iterator_response *right =
-			(struct dnet_iterator_response *)right_map.data + right_pos;
-		const int cmp_id = dnet_id_cmp_str(left->key.id, right->key.id);
-		const int cmp = dnet_iterator_response_cmp(left, right);
-
-		if (left_offset < left_size && cmp <= 0) {
-			/*
-			 * If we can move left pointer and left key is less or
-			 * same but with lesser timestamp we skip record.
-			 */
-			dnet_iterator_response_skip_equal_keys(left_map.data, &left_offset, left_size);
-
-			/* For same key we move both pointers */
-			if (cmp_id == 0)
-				dnet_iterator_response_skip_equal_keys(right_map.data, &right_offset, right_size);
-		} else {
-			/*
-			 * If we can move left pointer or left key is greater
-			 * or same but less timestamp we add record to
-			 * differene because it should be recovered.
-			 */
-			err = dnet_iterator_response_container_append(right, diff_fd, diff_offset);
-			if (err != 0)
-				goto err_unmap_right;
-			diff_offset += resp_size;
-
-			dnet_iterator_response_skip_equal_keys(right_map.data, &right_offset, right_size);
-
-			/* For same key we move both pointers */
-			if (cmp_id == 0 && left_offset < left_size)
-				dnet_iterator_response_skip_equal_keys(left_map.data, &left_offset, left_size);
+	left = left_map.data;
+	right = right_map.data;
+	left_num = left_size / resp_size;
+	right_num = right_size / resp_size;
+
+	threads_num = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads_num > DNET_ITERATOR_SORT_MAX_THREADS)
+		threads_num = DNET_ITERATOR_SORT_MAX_THREADS;
+	if (threads_num < 1)
+		threads_num = 1;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.diff_fd = diff_fd;
+	ctl.ranges_num = right_size / DNET_ITERATOR_DIFF_MIN_RANGE;
+	if (ctl.ranges_num > (size_t)threads_num)
+		ctl.ranges_num = threads_num;
+	if (ctl.ranges_num < 1)
+		ctl.ranges_num = 1;
+
+	ctl.ranges = calloc(ctl.ranges_num, sizeof(struct dnet_iterator_diff_range));
+	if (!ctl.ranges) {
+		err = -ENOMEM;
+		goto err_unmap_right;
+	}
+
+	/* range boundaries are moved forward to the next key, so every key is diffed by one range only */
+	begin = 0;
+	for (i = 0; i < ctl.ranges_num; ++i) {
+		struct dnet_iterator_diff_range *range = &ctl.ranges[i];
+		size_t end = right_num;
+
+		if (i + 1 < ctl.ranges_num) {
+			end = right_num / ctl.ranges_num * (i + 1);
+			if (end <= begin)
+				end = begin;
+			else
+				end = dnet_iterator_response_next_key(right, end - 1, right_num);
+		}
+
+		range->right = right + begin;
+		range->right_num = end - begin;
+		range->left = left;
+		range->left_num = 0;
+
+		if (range->right_num) {
+			const size_t left_begin = dnet_iterator_response_lower_bound(left, left_num, right[begin].key.id);
+			const size_t left_end = end < right_num ?
+				dnet_iterator_response_lower_bound(left, left_num, right[end].key.id) : left_num;
+
+			range->left = left + left_begin;
+			range->left_num = left_end - left_begin;
 		}
-		assert(left_offset <= left_size);
-		assert(diff_offset <= (int64_t)right_size);
+
+		begin = end;
 	}
-	assert(right_offset == right_size);
 
+	if (ctl.ranges_num < (size_t)threads_num)
+		threads_num = ctl.ranges_num;
+
+	err = pthread_mutex_init(&ctl.lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_free;
+	}
+
+	err = dnet_iterator_diff_pass(&ctl, threads_num, 0);
+	if (err)
+		goto err_out_destroy;
+
+	for (i = 0; i < ctl.ranges_num; ++i) {
+		ctl.ranges[i].diff_offset = diff_num * resp_size;
+		diff_num += ctl.ranges[i].diff_num;
+	}
+
+	err = dnet_iterator_diff_pass(&ctl, threads_num, 1);
+
+err_out_destroy:
+	pthread_mutex_destroy(&ctl.lock);
+err_out_free:
+	free(ctl.ranges);
 err_unmap_right:
 	dnet_data_unmap(&right_map);
 err_unmap_left:
-	dnet_data_unmap(&left_map);
+	if (left_size)
+		dnet_data_unmap(&left_map);
 err:
-	return err ? err : diff_offset;
+	return err ? err : (int64_t)(diff_num * resp_size);
 }
 
 int dnet_parse_numeric_id(const char *value, unsigned char *id)
@@ -48,7 +48,11 @@ typedef unsigned short u_short;
 #include "atomic.h"
 #include "lock.h"
 #include "route.h"
+#include "defrag.h"
+#include "qos.h"
+#include "capture.h"
 #include "backend.h"
+#include "slab.h"
 
 #include "elliptics/packet.h"
 #include "elliptics/logger.hpp"
@@ -66,9 +70,44 @@ struct dnet_test_settings;
 struct dnet_node;
 struct dnet_group;
 struct dnet_net_state;
+struct dnet_tls_context;
 
 extern __thread uint64_t trace_id;
 
+/*
+ * Time in usecs spent by backend and cache handlers on the request processed by the calling io thread,
+ * it is DNET_IO_STAGE_NONE if request was not passed to backend
+ */
+extern __thread uint64_t dnet_backend_stage_time;
+
+#define DNET_BULK_COMMIT_FDS		8
+
+/*
+ * Set by DNET_CMD_BULK_WRITE with DNET_ATTR_BULK_WRITE_STATUSES while it writes its keys: backend which acks
+ * writes only after they are durable may remember written files here instead of waiting for every key,
+ * then @commit is called once after the last key has been written and syncs them all
+ */
+struct dnet_bulk_commit {
+	int			(* commit)(struct dnet_bulk_commit *bc);
+	void			*priv;
+	int			fds[DNET_BULK_COMMIT_FDS];
+	int			fd_num;
+	uint64_t		size;
+};
+
+extern __thread struct dnet_bulk_commit *dnet_bulk_commit;
+
+/*
+ * Usecs of monotonic clock, it is the clock of steady_clock used by C++ code
+ */
+static inline uint64_t dnet_monotonic_usecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 #define DNET_LOG_BEGIN_ONLY_LOG(log, level) \
 	do { \
 		dnet_logger * const local_dnet_log = log; \
@@ -109,8 +148,43 @@ extern __thread uint64_t trace_id;
 	DNET_LOG_PRINT_ERR(-errno, format, ##a) \
 	DNET_LOG_END()
 
+/*
+ * Processing times of peer's requests are counted in log2 buckets of usecs:
+ * bucket 0 is less than 1 usec, bucket i is [2^(i-1), 2^i) usecs, the last one takes the rest
+ */
+#define DNET_PEER_LATENCY_BUCKETS	24
+
+/*
+ * Traffic of one peer, updated by network and io threads with atomic operations,
+ * so monitor reads it without taking any lock of the state
+ */
+struct dnet_peer_stat {
+	/* bytes of requests and replies received from and sent to the peer */
+	uint64_t		recv_bytes;
+	uint64_t		send_bytes;
+	/* requests of the peer processed by this node */
+	uint64_t		ops;
+	/* requests of the peer which are queued or being processed */
+	uint64_t		inflight;
+	uint64_t		latency[DNET_PEER_LATENCY_BUCKETS];
+	/* original and on-wire sizes of payloads compressed for and by the peer, see DNET_FLAGS_COMPRESSED */
+	uint64_t		send_compress_orig;
+	uint64_t		send_compress_wire;
+	uint64_t		recv_compress_orig;
+	uint64_t		recv_compress_wire;
+};
+
+static inline int dnet_peer_latency_bucket(uint64_t usecs)
+{
+	int bucket = usecs ? 64 - __builtin_clzll(usecs) : 0;
+
+	return bucket < DNET_PEER_LATENCY_BUCKETS ? bucket : DNET_PEER_LATENCY_BUCKETS - 1;
+}
+
 struct dnet_io_req {
 	struct list_head	req_entry;
+	/* link in lock-free @send_inbox of the state, requests are moved from there into @send_list */
+	struct dnet_io_req	*send_next;
 
 	struct dnet_net_state	*st;
 
@@ -124,6 +198,61 @@ struct dnet_io_req {
 	int			fd;
 	off_t			local_offset;
 	size_t			fsize;
+
+	/* Request was allocated from the network thread receive pool (see slab.h) */
+	int			slab;
+
+	/*
+	 * When set, @data is not copied into request's buffer but referenced,
+	 * @data_release(@data_priv) is called when request is destroyed.
+	 */
+	void			(*data_release)(void *priv);
+	void			*data_priv;
+
+	/*
+	 * If @iovcnt is not zero, data consists of @iov segments of @dsize bytes in total, @data is unused.
+	 * Segments are referenced only together with @data_release, otherwise they are gathered into @data.
+	 */
+	struct iovec		*iov;
+	int			iovcnt;
+
+	/*
+	 * Called by io thread right after request has been processed with processing result,
+	 * used by requests created by server itself (see dnet_cmd_bulk_read()).
+	 */
+	void			(*complete)(struct dnet_io_req *r, int err);
+	void			*priv;
+
+	/*
+	 * Time request was put into io pool queue or reply was put into send queue,
+	 * usecs of monotonic clock, 0 if it was not measured
+	 */
+	uint64_t		queue_time;
+	/* Number of requests in io pool queue when this one was put into it */
+	uint64_t		queue_depth;
+	/* Request is counted in @peer_stat.inflight of its state */
+	int			peer_inflight;
+
+	/*
+	 * Request is queued, but must not be sent yet (its data is being verified),
+	 * network thread stops at it and is rescheduled when it is released, protected by @send_lock
+	 */
+	int			held;
+	/* Request continues message of the previous one, it does not start with command header */
+	int			continuation;
+	/* Request has been sent with MSG_ZEROCOPY, it is freed once send call @zerocopy_seq is completed */
+	int			zerocopy;
+	uint32_t		zerocopy_seq;
+
+	/* Bytes of receive memory budget taken by request's body and the state which has received it */
+	uint64_t		recv_reserved;
+	struct dnet_net_state	*recv_st;
+	/* Bytes of the queued reply charged to DNET_MEMORY_SEND of @memory_node */
+	uint64_t		memory_charged;
+	struct dnet_node	*memory_node;
+
+	/* Queued request has @header converted into short header form, see dnet_io_req_cmd() */
+	int			wire_header;
 };
 
 /*
@@ -137,6 +266,21 @@ struct dnet_io_req {
 /* Attached data should be discarded */
 #define DNET_IO_DROP		(1<<1)
 
+/* Command is received, but its body is not until receive memory budget allows it */
+#define DNET_IO_DEFERRED	(1<<2)
+
+/* io attribute of write which may be streamed into the backend is being received */
+#define DNET_IO_STREAM_ATTR	(1<<3)
+
+/* Write body is moved from socket into dnet_net_state::stream_fd */
+#define DNET_IO_STREAM		(1<<4)
+
+/* Short header is being read into dnet_net_state::rcv_short, see DNET_AUTH_FLAGS_SHORT_HEADER */
+#define DNET_IO_SHORT		(1<<5)
+
+/* length byte and seven one-byte varints, the least header sent once short headers are enabled */
+#define DNET_SHORT_HEADER_MIN	8
+
 #define DNET_STATE_DEFAULT_WEIGHT	1.0
 
 /* Iterator watermarks for sending data and sleeping */
@@ -152,6 +296,40 @@ struct dnet_net_epoll_data
 	int fd;
 };
 
+struct dnet_trans;
+
+/*
+ * Open addressing table of in-flight transactions of the state keyed by transaction number, see trans.c
+ */
+struct dnet_trans_table_slot
+{
+	uint64_t		trans;
+	struct dnet_trans	*t;
+};
+
+struct dnet_trans_table
+{
+	struct dnet_trans_table_slot	*slots;
+	/* table has 1 << bits slots, it is allocated on the first insertion */
+	unsigned int			bits;
+	size_t				used;
+};
+
+#define DNET_TRANS_TIMER_SLOTS		256
+#define DNET_TRANS_TIMER_TICK_MS	10
+
+/*
+ * Hashed timing wheel of transaction deadlines of the state or of states of the node, see trans.c
+ */
+struct dnet_trans_timer_wheel
+{
+	struct list_head	slots[DNET_TRANS_TIMER_SLOTS];
+	/* the first tick which has not been completely checked yet */
+	uint64_t		current;
+	/* number of scheduled entries, maintained only by state's wheel */
+	size_t			num;
+};
+
 struct dnet_net_state
 {
 	// To store state either at node::empty_state_list (List of all client nodes, used for statistics)
@@ -188,6 +366,7 @@ struct dnet_net_state
 	struct dnet_addr	addr;
 
 	struct dnet_cmd		rcv_cmd;
+	uint8_t			rcv_short[DNET_SHORT_HEADER_MAX];
 	uint64_t		rcv_offset;
 	uint64_t		rcv_end;
 	unsigned int		rcv_flags;
@@ -197,6 +376,17 @@ struct dnet_net_state
 	size_t			send_offset;
 	pthread_mutex_t		send_lock;
 	struct list_head	send_list;
+	/*
+	 * Replies are pushed by their producers into lock-free @send_inbox stack (linked by @send_next)
+	 * without taking @send_lock, network thread moves them into @send_list in FIFO order.
+	 * Whoever moves requests from the inbox must hold @send_lock, so that pieces queued directly
+	 * into @send_list stay after replies pushed earlier.
+	 *
+	 * @send_scheduled is set by the producer which has found the queue idle, only that one schedules
+	 * send event, others just push. Network thread clears it under @send_lock when queue is empty.
+	 */
+	struct dnet_io_req	*send_inbox;
+	int			send_scheduled;
 	/*
 	 * Condition variable to wait when send_queue_size reaches high
 	 * watermark
@@ -206,14 +396,64 @@ struct dnet_net_state
 	atomic_t		send_queue_size;
 
 	pthread_mutex_t		trans_lock;
-	struct rb_root		trans_root;
-	struct rb_root		timer_root;
+	struct dnet_trans_table	trans_table;
+	struct dnet_trans_timer_wheel	timer_wheel;
+	/* tick state is scheduled at in node's wheel or 0, protected by @trans_lock */
+	uint64_t		trans_check_next;
+	/* entry and tick of node's wheel, protected by node's @trans_timer_lock */
+	struct list_head	trans_check_entry;
+	uint64_t		trans_check_tick;
 
+	/*
+	 * Additional connections to the same node, see dnet_state_lane(), protected by @trans_lock.
+	 * Lanes do not reference this state and are reset together with it.
+	 */
+	struct dnet_net_state	**lanes;
+	int			lane_num;
 
 	int			la;
 	unsigned long long	free;
 
 	struct dnet_stat_count	stat[__DNET_CMD_MAX];
+	struct dnet_peer_stat	peer_stat;
+
+	/* bytes of received request bodies held in memory, see dnet_node::recv_memory_limit */
+	uint64_t		recv_memory_used;
+	/* entry of dnet_node::recv_deferred_list, state is not read while it is there */
+	struct list_head	recv_deferred_entry;
+
+	/* file and position streamed write body is placed at, -1 if not streaming, see DNET_IO_STREAM */
+	int			stream_fd;
+	uint64_t		stream_offset;
+	/* pipe body is spliced through, created on the first streamed write */
+	int			stream_pipe[2];
+
+	/* non-zero if large command payloads are compressed in both directions, see DNET_AUTH_FLAGS_COMPRESSION */
+	int			wire_compression;
+
+	/*
+	 * Short headers, see DNET_AUTH_FLAGS_SHORT_HEADER. Joining node sets @short_header_asked and
+	 * its network thread switches @short_header_recv on once it receives confirmation.
+	 * Server sets @short_header_pending before it confirms and network thread switches
+	 * @short_header_send on when confirmation is put into the send list.
+	 * Keys of the last short headers sent and received, key is omitted while it does not change.
+	 */
+	int			short_header_asked;
+	int			short_header_recv;
+	int			short_header_pending;
+	int			short_header_send;
+	struct dnet_id		short_send_key;
+	struct dnet_id		rcv_short_key;
+
+	/*
+	 * Large batches are sent with MSG_ZEROCOPY, see dnet_config::zerocopy_send_size.
+	 * @zerocopy_seq counts zero-copy send calls, @zerocopy_done - calls completed by the kernel,
+	 * requests sent by them wait in @zerocopy_list. Used by network thread only.
+	 */
+	int			zerocopy;
+	uint32_t		zerocopy_seq;
+	uint32_t		zerocopy_done;
+	struct list_head	zerocopy_list;
 
 	/* Remote protocol version */
 	int version[4];
@@ -224,6 +464,47 @@ struct dnet_net_state
 };
 
 int dnet_socket_local_addr(int s, struct dnet_addr *addr);
+
+/* network of dnet_config::wire_compression_networks */
+struct dnet_net_prefix {
+	int			family;
+	int			bits;
+	uint8_t			addr[16];
+};
+
+int dnet_net_prefix_parse(const char *networks, struct dnet_net_prefix **nets, int *num);
+int dnet_net_prefix_match(const struct dnet_net_prefix *nets, int num, const struct dnet_addr *addr);
+
+/* networks of a locality from dnet_config::localities */
+struct dnet_locality {
+	char			*label;
+	struct dnet_net_prefix	*nets;
+	int			net_num;
+};
+
+int dnet_locality_parse(const char *localities, struct dnet_locality **localitiesp, int *num);
+void dnet_locality_free(struct dnet_locality *localities, int num);
+/* returns label of the locality @addr belongs to or NULL */
+const char *dnet_locality_match(struct dnet_node *n, const struct dnet_addr *addr);
+
+int dnet_wire_compression_init(struct dnet_node *n, const char *networks);
+int dnet_wire_compression_match(struct dnet_node *n, const struct dnet_addr *addr);
+int dnet_wire_compression_supported(void);
+
+/* encodes host order @cmd into @buf of DNET_SHORT_HEADER_MAX bytes, returns number of bytes used */
+int dnet_short_header_encode(const struct dnet_cmd *cmd, uint8_t *buf, int with_key);
+/*
+ * Decodes @size bytes which follow length byte of short header into host order @cmd.
+ * Header without key gets @key, the one with key stores it into @key, @key may be NULL.
+ */
+int dnet_short_header_decode(const uint8_t *buf, size_t size, struct dnet_cmd *cmd, struct dnet_id *key);
+/* non-zero if host order @cmd with @data is a reply which confirms short headers */
+int dnet_short_header_confirmed(const struct dnet_cmd *cmd, const void *data);
+/* command of queued request in network byte order, @tmp is used if header is short, NULL for continuation */
+struct dnet_cmd *dnet_io_req_cmd(struct dnet_io_req *r, struct dnet_cmd *tmp);
+
+/* non-zero if connection to or from @addr has to be encrypted, see dnet_config::tls_networks */
+int dnet_tls_match(struct dnet_node *n, const struct dnet_addr *addr);
 int dnet_local_addr_index(struct dnet_node *n, struct dnet_addr *addr);
 
 int dnet_copy_addrs_nolock(struct dnet_net_state *nst, struct dnet_addr *addrs, int addr_num);
@@ -235,17 +516,96 @@ struct dnet_state_id {
 };
 
 /* container of dnet_state_id */
+#define DNET_LATENCY_BUCKETS		32
+/* histogram is halved after this number of samples, so old latencies fade away */
+#define DNET_LATENCY_WINDOW		1024
+
 struct dnet_idc {
 	struct rb_node		state_entry;
 	struct list_head	group_entry;
 	struct dnet_net_state	*st;
 	int			backend_id;
 	double			disk_weight, cache_weight;
+	/* read latency of the backend in microseconds: moving average and log2 histogram */
+	double			latency_ewma;
+	atomic_t		latency_hist[DNET_LATENCY_BUCKETS];
+	atomic_t		latency_samples;
+	/* outlier detection: requests and errors since the last check, ejection deadlines in monotonic usecs */
+	atomic_t		health_requests;
+	atomic_t		health_errors;
+	atomic_t		consecutive_errors;
+	int			ejection_num;
+	uint64_t		ejected_until;
+	uint64_t		recovery_until;
 	struct dnet_group	*group;
 	int			id_num;
 	struct dnet_state_id	ids[];
 };
 
+/*
+ * Immutable snapshot of the routing table.
+ *
+ * It is rebuilt under @state_lock every time groups or backends are changed and
+ * published into @dnet_node::route_table, so lookups do not touch @state_lock at all.
+ * Reader takes a snapshot reference with dnet_route_table_get(), does its lookups and drops it.
+ * Writer, after publishing new snapshot, waits until all readers of the old one are gone
+ * and frees it, thus states referenced by an old snapshot are not freed under readers.
+ *
+ * Ids of every group live in a separate refcounted block, new snapshot shares blocks of groups
+ * which have not been changed since the previous one, so backend churn in one group does not
+ * copy routes of all other groups.
+ */
+struct dnet_route_table_entry {
+	/* must be the first field, search code shares it with dnet_state_id */
+	struct dnet_raw_id	raw;
+	struct dnet_net_state	*st;
+	int			backend_id;
+};
+
+/* big-endian first 8 bytes of @id, ids are ordered as their prefixes unless prefixes are equal */
+static inline uint64_t dnet_id_prefix(const uint8_t *id)
+{
+	uint64_t prefix = 0;
+	int i;
+
+	for (i = 0; i < 8; ++i)
+		prefix = (prefix << 8) | id[i];
+
+	return prefix;
+}
+
+/* followed by id_num entries and id_num prefixes of the group */
+struct dnet_route_group_ids {
+	/* number of snapshots sharing this block, guarded by @state_lock */
+	int			refcnt;
+};
+
+struct dnet_route_group {
+	unsigned int		group_id;
+	int			id_num;
+	struct dnet_route_table_entry	*ids;
+	uint64_t		*id_prefixes;
+	struct dnet_route_group_ids	*block;
+};
+
+struct dnet_route_table {
+	atomic_t		refcnt;
+	/* incremented by every published snapshot */
+	uint64_t		version;
+	int			group_num;
+	/* sorted by group_id */
+	struct dnet_route_group	*groups;
+};
+
+/* Returns current snapshot (or NULL if there is no valid snapshot) which must be released by dnet_route_table_put() */
+struct dnet_route_table *dnet_route_table_get(struct dnet_node *n);
+static inline void dnet_route_table_put(struct dnet_route_table *t)
+{
+	if (t)
+		atomic_dec(&t->refcnt);
+}
+struct dnet_net_state *dnet_route_table_search(struct dnet_route_table *t, const struct dnet_id *id, int *backend_id);
+
 int dnet_idc_insert(struct dnet_net_state *st, struct dnet_idc *idc);
 void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id);
 int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *ids);
@@ -255,6 +615,19 @@ int dnet_state_micro_init(struct dnet_net_state *st, struct dnet_node *n, struct
 int dnet_state_set_server_prio(struct dnet_net_state *st);
 
 int dnet_state_move_to_dht(struct dnet_net_state *st, struct dnet_addr *addrs, int addrs_count);
+
+/* Opens additional connections to the node of @st according to node's connections_per_node */
+int dnet_state_add_lanes(struct dnet_net_state *st);
+/*
+ * Returns referenced lane transaction @t with request @req should be sent through instead of @st,
+ * or NULL if it should be sent through @st itself
+ */
+struct dnet_net_state *dnet_state_lane(struct dnet_net_state *st, struct dnet_trans *t, struct dnet_io_req *req);
+/*
+ * Makes requests submitted by calling thread go via connections of @shard in client shard mode,
+ * in server shard mode states created by calling thread are served by net thread of @shard
+ */
+void dnet_set_client_shard(int shard);
 struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 		struct dnet_backend_ids **backends, int backends_count,
 		struct dnet_addr *addr, int s, int *errp, int join, int server_node, int idx,
@@ -270,6 +643,44 @@ ssize_t dnet_state_search_backend(struct dnet_node *n, const struct dnet_id *id)
 int dnet_get_backend_weight(struct dnet_net_state *st, int backend_id, uint32_t ioflags, double *weight);
 void dnet_set_backend_weight(struct dnet_net_state *st, int backend_id, uint32_t ioflags, double weight);
 void dnet_update_backend_weight(struct dnet_net_state *st, const struct dnet_cmd *, uint64_t ioflags, long time);
+
+struct dnet_backend_latency {
+	/* microseconds */
+	double			ewma;
+	long			percentile;
+	/* transactions in flight to the backend's node */
+	size_t			outstanding;
+};
+
+void dnet_update_backend_latency(struct dnet_net_state *st, int backend_id, long time);
+
+/*
+ * Outlier detection of backends, enabled by DNET_CFG_OUTLIER_STATES.
+ *
+ * Backend is ejected after DNET_OUTLIER_CONSECUTIVE_ERRORS errors (timeouts, -EIO, -ENOMEM) in a row,
+ * or by the check made every DNET_OUTLIER_INTERVAL_MS if at least DNET_OUTLIER_ERROR_PERCENT of its
+ * requests have failed, or if its read latency is DNET_OUTLIER_LATENCY_FACTOR times the median of peers.
+ * Only backends with DNET_OUTLIER_MIN_REQUESTS requests per interval are checked and at most
+ * DNET_OUTLIER_MAX_EJECTED_PERCENT of backends are ejected by the check.
+ *
+ * Ejected backend is read last for DNET_OUTLIER_EJECTION_MS times number of its recent ejections,
+ * then during DNET_OUTLIER_RECOVERY_MS it gets back its reads gradually.
+ */
+#define DNET_OUTLIER_CONSECUTIVE_ERRORS		5
+#define DNET_OUTLIER_INTERVAL_MS		10000
+#define DNET_OUTLIER_MIN_REQUESTS		20
+#define DNET_OUTLIER_ERROR_PERCENT		50
+#define DNET_OUTLIER_LATENCY_FACTOR		3
+#define DNET_OUTLIER_MAX_EJECTED_PERCENT	50
+#define DNET_OUTLIER_EJECTION_MS		10000
+#define DNET_OUTLIER_MAX_EJECTIONS		10
+#define DNET_OUTLIER_RECOVERY_MS		30000
+
+void dnet_update_backend_health(struct dnet_net_state *st, int backend_id, int status);
+/* Returns 1 if backend has to be read after other replicas, it is a random choice during recovery */
+int dnet_backend_deprioritized(struct dnet_net_state *st, int backend_id, uint64_t now);
+void dnet_outlier_check(struct dnet_node *n);
+int dnet_get_backend_latency(struct dnet_net_state *st, int backend_id, int percentile, struct dnet_backend_latency *latency);
 struct dnet_net_state *dnet_state_search_nolock(struct dnet_node *n, const struct dnet_id *id, int *backend_id);
 struct dnet_net_state *dnet_node_state(struct dnet_node *n);
 
@@ -290,13 +701,33 @@ void dnet_schedule_command(struct dnet_net_state *st);
 
 int dnet_schedule_send(struct dnet_net_state *st);
 int dnet_schedule_recv(struct dnet_net_state *st);
+/*
+ * Schedules send event unless it has already been scheduled since the queue became idle, must be called with @send_lock held
+ */
+void dnet_schedule_send_once_nolock(struct dnet_net_state *st);
+/*
+ * Moves requests pushed into @send_inbox to the tail of @send_list, must be called with @send_lock held
+ */
+void dnet_send_inbox_drain_nolock(struct dnet_net_state *st);
+/*
+ * Accounts @num requests put into send queues in output stats, they are uncounted as being sent
+ */
+void dnet_output_stats_increase(struct dnet_node *n, int num);
 
 void dnet_unschedule_send(struct dnet_net_state *st);
 void dnet_unschedule_all(struct dnet_net_state *st);
+/*
+ * Returns receive memory taken by request @r to the budget, deferred states are scheduled to be read again
+ */
+void dnet_recv_budget_release(struct dnet_io_req *r);
+void dnet_recv_budget_cleanup(struct dnet_node *n);
 
 int dnet_setup_control_nolock(struct dnet_net_state *st);
 
-int dnet_add_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr, unsigned int join_state);
+int dnet_add_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr, unsigned int join_state, double route_share);
+void dnet_remove_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr);
+/* Part of group routes served by @st: 1.0 is one whole group */
+double dnet_state_route_share(struct dnet_net_state *st);
 
 static inline struct dnet_net_state *dnet_state_get(struct dnet_net_state *st)
 {
@@ -304,6 +735,16 @@ static inline struct dnet_net_state *dnet_state_get(struct dnet_net_state *st)
 	return st;
 }
 
+/*
+ * State without sockets is the fake one used by the server to process commands locally (see local_session),
+ * its replies are consumed from send_list right after command handler returns,
+ * so they must be complete and contiguous by that moment
+ */
+static inline int dnet_state_is_local(struct dnet_net_state *st)
+{
+	return st->read_s < 0 && st->write_s < 0 && st->accept_s < 0;
+}
+
 struct dnet_wait
 {
 	pthread_cond_t		wait;
@@ -355,10 +796,35 @@ static inline void dnet_wait_put(struct dnet_wait *w)
 		dnet_wait_destroy(w);
 }
 
-struct dnet_notify_bucket
+#define DNET_NOTIFY_SHARDS		16
+
+/*
+ * Subscriptions are kept in DNET_NOTIFY_SHARDS shards selected by id,
+ * every shard has its own lock and hash table which doubles when it becomes twice as long as the number of entries.
+ */
+struct dnet_notify_shard
 {
-	struct list_head		notify_list;
-	pthread_rwlock_t		notify_lock;
+	pthread_rwlock_t		lock;
+	struct list_head		*buckets;
+	unsigned int			bucket_num;
+	unsigned int			entry_num;
+};
+
+/*
+ * Notifications are not sent by io threads: dnet_update_notify() only queues modification event
+ * and sender thread fans it out to subscribers, replies to the same state are sent as one buffer.
+ */
+struct dnet_notify_table
+{
+	struct dnet_notify_shard	shards[DNET_NOTIFY_SHARDS];
+	/* total number of subscriptions, events are not queued if it is zero */
+	atomic_t			entry_num;
+
+	pthread_mutex_t			queue_lock;
+	pthread_cond_t			queue_wait;
+	struct list_head		queue;
+	int				need_exit;
+	pthread_t			tid;
 };
 
 int dnet_update_notify(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
@@ -382,6 +848,16 @@ struct dnet_group
 
 	int			id_num;
 	struct dnet_state_id	*ids;
+
+	/*
+	 * First 8 bytes of every id from @ids as big-endian integer, in the same order.
+	 * Route lookup searches this compact array and only compares full ids within
+	 * (extremely rare) ranges of equal prefixes. NULL if allocation has failed.
+	 */
+	uint64_t		*id_prefixes;
+
+	/* @ids have been changed since the last routing snapshot */
+	int			route_changed;
 };
 
 static inline struct dnet_group *dnet_group_get(struct dnet_group *g)
@@ -405,6 +881,9 @@ struct dnet_transform
 					void *dst, unsigned int *dsize, unsigned int flags);
 	int 			(* transform_file)(void *priv, struct dnet_session *s, int fd, uint64_t offset,
 					uint64_t size, void *dst, unsigned int *dsize, unsigned int flags);
+	/* optional, transforms @num buffers into @num consecutive @dsize bytes results in @dst */
+	int 			(* transform_multi)(void *priv, struct dnet_session *s, const void *const *src,
+					const uint64_t *size, size_t num, void *dst, unsigned int dsize);
 };
 
 int dnet_crypto_init(struct dnet_node *n);
@@ -414,6 +893,9 @@ struct dnet_net_io {
 	int			epoll_fd;
 	pthread_t		tid;
 	struct dnet_node	*n;
+
+	/* Buffers for inbound requests received by this thread */
+	struct dnet_slab_pool	*recv_pool;
 };
 
 enum dnet_work_io_mode {
@@ -435,10 +917,13 @@ struct dnet_work_io {
 
 struct list_stat {
 	uint64_t		list_size;
+	/* number of pool threads allowed to process requests, see dnet_io_scale_pools() */
+	uint64_t		active_threads;
 };
 
 static inline void list_stat_init(struct list_stat *st) {
 	st->list_size = 0ULL;
+	st->active_threads = 0ULL;
 }
 
 static inline void list_stat_size_increase(struct list_stat *st, int num) {
@@ -449,16 +934,172 @@ static inline void list_stat_size_decrease(struct list_stat *st, int num) {
 	st->list_size -= num;
 }
 
+/*
+ * Token bucket, @rate is in units per second, 0 means no limit
+ */
+struct dnet_rate_limit {
+	pthread_mutex_t		lock;
+	uint64_t		rate;
+	int64_t			tokens;		/* negative if consumers have to wait */
+	struct timespec		last;		/* time tokens have been added last time */
+
+	struct timespec		window_start;	/* measurement of the actual rate */
+	uint64_t		window_units;
+	uint64_t		current;	/* units per second consumed during the last window */
+};
+
+/*
+ * Limits of bytes and keys per second processed by background operations: iterators and server-send
+ */
+struct dnet_throttle {
+	struct dnet_rate_limit	bytes;
+	struct dnet_rate_limit	keys;
+};
+
+int dnet_throttle_init(struct dnet_throttle *t, uint64_t rate_bytes, uint64_t rate_keys);
+void dnet_throttle_destroy(struct dnet_throttle *t);
+void dnet_throttle_set(struct dnet_throttle *t, uint64_t rate_bytes, uint64_t rate_keys);
+void dnet_throttle_get(struct dnet_throttle *t, uint64_t *rate_bytes, uint64_t *rate_keys);
+void dnet_throttle_current(struct dnet_throttle *t, uint64_t *rate_bytes, uint64_t *rate_keys);
+/* Sleeps until both @request and @backend limits allow @bytes and @keys, any of them may be NULL */
+void dnet_throttle_wait(struct dnet_throttle *request, struct dnet_throttle *backend, uint64_t bytes, uint64_t keys);
+
+/*
+ * Subsystems which hold memory accounted by the node-wide memory governor
+ */
+enum dnet_memory_subsystem {
+	DNET_MEMORY_CACHE = 0,		/* objects of all caches */
+	DNET_MEMORY_RECV,		/* bodies of received requests, see dnet_node::recv_memory_used */
+	DNET_MEMORY_SEND,		/* replies queued for sending, mostly iterator responses */
+	DNET_MEMORY_SUBSYSTEMS
+};
+
+enum dnet_memory_pressure {
+	DNET_MEMORY_PRESSURE_NONE = 0,
+	DNET_MEMORY_PRESSURE_HIGH,	/* usage is above high watermark, caches shrink */
+	DNET_MEMORY_PRESSURE_CRITICAL,	/* limit is reached, receives are deferred and iterators pause */
+};
+
+/*
+ * Memory governor: limit of the whole node and budgets of subsystems, 0 means no limit.
+ * Subsystems charge memory they hold and react to pressure of their own budget or of the node.
+ */
+struct dnet_memory {
+	uint64_t		limit;
+	uint64_t		budget[DNET_MEMORY_SUBSYSTEMS];
+	/* DNET_MEMORY_RECV is not charged here, receive budget keeps its own counter */
+	uint64_t		used[DNET_MEMORY_SUBSYSTEMS];
+
+	uint64_t		recv_deferred;	/* receives deferred because of memory pressure */
+	uint64_t		iterator_pauses;	/* 100 ms pauses made by iterators */
+	uint64_t		cache_shrunk;	/* bytes evicted from caches because of memory pressure */
+};
+
+/* non-zero if there is any limit or budget, otherwise nothing has to be charged */
+int dnet_memory_enabled(struct dnet_node *n);
+void dnet_memory_charge(struct dnet_node *n, enum dnet_memory_subsystem subsystem, int64_t delta);
+uint64_t dnet_memory_used(struct dnet_node *n, enum dnet_memory_subsystem subsystem);
+uint64_t dnet_memory_total(struct dnet_node *n);
+/* the worst of pressure of the node and of @subsystem's budget */
+enum dnet_memory_pressure dnet_memory_pressure(struct dnet_node *n, enum dnet_memory_subsystem subsystem);
+/* bytes @subsystem has to release to get below high watermark of the node and of its budget */
+uint64_t dnet_memory_excess(struct dnet_node *n, enum dnet_memory_subsystem subsystem);
+const char *dnet_memory_subsystem_string(enum dnet_memory_subsystem subsystem);
+const char *dnet_memory_pressure_string(enum dnet_memory_pressure pressure);
+
+/*
+ * Per-backend log of committed writes and removals, it is iterated by DNET_IFLAGS_CHANGES iterators.
+ * Log is kept in backend's history directory and is rotated when it grows above configured size.
+ */
+struct dnet_change_log_record {
+	struct dnet_raw_id		key;
+	struct dnet_time		timestamp;	/* timestamp of the record */
+	uint64_t			change_time;	/* usecs since epoch, unique and increasing within the log */
+	uint64_t			size;		/* size of the last write */
+	uint64_t			flags;		/* DNET_RECORD_FLAGS_REMOVE for removals */
+} __attribute__ ((packed));
+
+struct dnet_change_log;
+
+int dnet_change_log_open(const char *dir, uint64_t max_size, struct dnet_change_log **log);
+void dnet_change_log_close(struct dnet_change_log *log);
+int dnet_change_log_append(struct dnet_change_log *log, const struct dnet_raw_id *key, const struct dnet_time *timestamp,
+		uint64_t size, uint64_t flags);
+/*
+ * Runs @callback for every change made after @since in order of changes, @pos and @total are progress.
+ * Returns -ERANGE if some changes made after @since have already been dropped by rotation,
+ * zero @since iterates all changes kept in the log.
+ */
+int dnet_change_log_iterate(struct dnet_change_log *log, uint64_t since,
+		int (*callback)(void *priv, const struct dnet_change_log_record *rec, uint64_t pos, uint64_t total),
+		void *priv);
+
+/*
+ * Statistics metrics of io pool, their names are formatted once when pool is created
+ * in order not to format them for every request
+ */
+enum dnet_pool_metric {
+	DNET_POOL_METRIC_QUEUE_SIZE = 0,
+	DNET_POOL_METRIC_QUEUE_WAIT_TIME,
+	DNET_POOL_METRIC_ACTIVE_THREADS,
+	DNET_POOL_METRIC_REJECTED,
+	DNET_POOL_METRIC_SEARCH_TRANS_TIME,
+	/* requests processed by threads of other pools, see dnet_config::nonblocking_io_steal */
+	DNET_POOL_METRIC_STOLEN,
+	__DNET_POOL_METRIC_MAX
+};
+
+#define DNET_POOL_METRIC_NAME_SIZE	64
+
+#define dnet_pool_metric(pool, metric)	((const char *)(pool)->metrics[DNET_POOL_METRIC_##metric])
+
+/*
+ * Families of per-command metrics, name of command's metric is "<prefix><COMMAND>".
+ * Names of every family are formatted once, hot path takes metric by family handle and command.
+ */
+enum dnet_cmd_metric_family {
+	/* "io.cmd." */
+	DNET_CMD_METRICS_IO = 0,
+	/* "io.cmd_recursive." */
+	DNET_CMD_METRICS_IO_RECURSIVE,
+	/* "cache." */
+	DNET_CMD_METRICS_CACHE,
+	__DNET_CMD_METRICS_BUILTIN
+};
+
+#define DNET_CMD_METRICS_MAX		16
+#define DNET_CMD_METRIC_NAME_SIZE	64
+
+/*
+ * Registers family of metrics with @prefix (like "eblob_backend.cmd.") and returns its handle,
+ * the same prefix gets the same handle. Returns -ENOSPC if there are too many families
+ * and -ENAMETOOLONG if names do not fit DNET_CMD_METRIC_NAME_SIZE.
+ */
+int dnet_cmd_metrics_register(const char *prefix);
+/*
+ * Returns name of @cmd metric of @family, unknown commands are reported as UNKNOWN
+ */
+const char *dnet_cmd_metric_name(int family, int cmd);
+
 struct dnet_backend_io;
 struct dnet_work_pool {
 	struct dnet_node	*n;
 	struct dnet_backend_io	*io;
 	int			mode;
 	int			num;
+	/*
+	 * Lower bound of active threads, pool is scaled between @min_num and @num threads
+	 * by its queue wait time. Pool is not scaled if @min_num equals @num.
+	 */
+	int			min_num;
 	pthread_mutex_t		lock;
 	struct dnet_work_io	*wio_list;
+	/* number of requests taken from this pool by threads of other pools and being processed */
+	int			thieves;
 
 	void			*request_queue;
+
+	char			metrics[__DNET_POOL_METRIC_MAX][DNET_POOL_METRIC_NAME_SIZE];
 };
 
 struct dnet_work_pool_place
@@ -471,6 +1112,32 @@ struct dnet_work_pool_place
 void dnet_work_pool_exit(struct dnet_work_pool_place *place);
 int dnet_work_pool_alloc(struct dnet_work_pool_place *place, struct dnet_node *n,
 	struct dnet_backend_io *io, int num, int mode, void *(* process)(void *));
+void dnet_work_pool_set_min_threads(struct dnet_work_pool_place *place, int min_num);
+
+/*
+ * Every request processed by backend and every background access of its cache passes the gate,
+ * reload closes it to wait until storage is not used by anyone and reopens it afterwards.
+ * Requests which come while the gate is closed wait for it in io threads.
+ */
+struct dnet_backend_gate {
+	pthread_mutex_t		lock;
+	pthread_cond_t		wait;
+	int			closed;
+	/* storage could not be reopened, requests fail with -ENXIO */
+	int			failed;
+	int			active;
+};
+
+int dnet_backend_gate_init(struct dnet_backend_gate *gate);
+void dnet_backend_gate_destroy(struct dnet_backend_gate *gate);
+/* nested entries made by the thread which has already passed the gate never wait */
+int dnet_backend_gate_enter(struct dnet_backend_gate *gate);
+/* does not wait, returns -EAGAIN if the gate is closed */
+int dnet_backend_gate_try_enter(struct dnet_backend_gate *gate);
+void dnet_backend_gate_leave(struct dnet_backend_gate *gate);
+/* closes the gate and waits until everybody leaves it */
+void dnet_backend_gate_close(struct dnet_backend_gate *gate);
+void dnet_backend_gate_open(struct dnet_backend_gate *gate, int failed);
 
 struct dnet_io_pool
 {
@@ -478,19 +1145,57 @@ struct dnet_io_pool
 	struct dnet_work_pool_place	recv_pool_nb;
 };
 
+/*
+ * Time net threads may spend per second replying to cache hits of the backend,
+ * hits beyond it are queued to io pool as usual. Accounting is approximate, it is lock-free.
+ */
+struct dnet_inline_budget {
+	/* microseconds per second, 0 disables processing by net threads */
+	uint64_t			limit;
+	/* second of monotonic clock @used is counted for */
+	uint64_t			window;
+	uint64_t			used;
+};
+
 struct dnet_backend_io
 {
 	int				need_exit;
 	int				read_only;
 	uint32_t			delay; // delay in ms for every command
 	size_t				backend_id;
+	/* NUMA node io threads and cache of the backend are bound to, -1 if not bound */
+	int				numa_node;
 	struct dnet_io_pool		pool;
 	struct dnet_backend_callbacks	*cb;
 	void				*cache;
 	void				*command_stats;
+	/* access counters of key ranges, NULL if monitor.heatmap is not configured */
+	void				*range_stats;
+	/* rate of all iterators and server-sends of the backend, changed by DNET_BACKEND_SET_RATE */
+	struct dnet_throttle		background_throttle;
+	/* not NULL if backend is configured with change_log */
+	struct dnet_change_log		*change_log;
+	struct dnet_backend_gate	gate;
+	struct dnet_inline_budget	inline_budget;
+	/* not NULL if backend is configured with record_filters */
+	struct dnet_record_filters	*record_filters;
+	/* fault injection rules set by DNET_BACKEND_SET_FAULTS, see faults.c */
+	pthread_mutex_t			faults_lock;
+	struct dnet_fault_rule		*faults;
+	int				faults_num;
 };
 
-int dnet_backend_command_stats_init(struct dnet_backend_io *backend_io);
+/*
+ * Replaces fault injection rules of the backend, zero @num removes them.
+ * Returns -EINVAL if any rule is malformed.
+ */
+int dnet_backend_faults_set(struct dnet_backend_io *backend, const struct dnet_fault_rule *rules, int num);
+/*
+ * Delays @cmd if a rule fires for it and returns error it should be replied with or zero
+ */
+int dnet_backend_faults_inject(struct dnet_backend_io *backend, struct dnet_cmd *cmd);
+
+int dnet_backend_command_stats_init(struct dnet_node *node, struct dnet_backend_io *backend_io);
 void dnet_backend_command_stats_cleanup(struct dnet_backend_io *backend_io);
 void dnet_backend_command_stats_update(struct dnet_node *node, struct dnet_backend_io *backend_io,
 		struct dnet_cmd *cmd, uint64_t size, int handled_in_cache, int err, long diff);
@@ -538,6 +1243,10 @@ struct dnet_config_data {
 	struct dnet_config cfg_state;
 	int daemon_mode;
 	int parallel_start;
+	/* node joins the network without waiting for backends, each of them is announced when it is ready */
+	int warm_start;
+	/* directory of native DNET_ITYPE_FILTER iterator filters, NULL if they are disabled */
+	char *iterator_filter_dir;
 
 	dnet_backend_info_list *backends;
 };
@@ -564,6 +1273,10 @@ struct dnet_node
 	pthread_mutex_t		state_lock;
 	struct rb_root		group_root;
 
+	/* guards only loading of @route_table pointer and taking its reference */
+	struct dnet_lock	route_lock;
+	struct dnet_route_table	*route_table;
+
 	/* hosts client states, i.e. those who didn't join network */
 	struct list_head	empty_state_list;
 	/* hosts server states, i.e. those who joined network */
@@ -575,6 +1288,9 @@ struct dnet_node
 	atomic_t		trans;
 
 	dnet_route_list		*route;
+	dnet_defrag_scheduler	*defrag_scheduler;
+	dnet_qos		*qos;
+	dnet_capture		*capture;
 	struct dnet_net_state	*st;
 
 	int			error;
@@ -597,8 +1313,66 @@ struct dnet_node
 	pthread_t		reconnect_tid;
 	long			stall_count;
 
+	/* retry budget in hundredths of a retry, see dnet_node_set_retry_budget() */
+	int			retry_budget_percent;
+	long			retry_tokens;
+
+	/* states which have transactions waiting for timeout and delayed calls, see trans.c */
+	pthread_mutex_t		trans_timer_lock;
+	struct dnet_trans_timer_wheel	trans_timer;
+	struct dnet_trans_timer_wheel	delayed_calls;
+
+	/* number of connections to every server node and size of request which is sent to dedicated one */
+	int			net_lanes;
+	uint64_t		large_request_size;
+	/* non-zero if every lane is served by its own net thread and requests are routed by submitting thread */
+	int			client_shards;
+	/* number of connections established at once by dnet_add_state(), 0 if not limited */
+	int			connect_concurrency;
+	/* non-zero if every net thread has its own listening socket and serves connections accepted by it */
+	int			server_shards;
+	/* directory of cached server ids, NULL if route cache is disabled, see dnet_config::route_cache_dir */
+	char			*route_cache_dir;
+	/* directory of unix sockets of co-located servers, NULL if disabled, see dnet_config::local_socket_dir */
+	char			*local_socket_dir;
+
+	/* receive memory budget of the node and of every connection, 0 if not limited, see dnet_config */
+	uint64_t		recv_memory_limit;
+	uint64_t		recv_connection_limit;
+	/* bytes of received request bodies held in memory by all states */
+	uint64_t		recv_memory_used;
+	/* states which wait for released memory to receive body of the next request, they are referenced */
+	pthread_mutex_t		recv_deferred_lock;
+	struct list_head	recv_deferred_list;
+	/* node-wide memory limit and per-subsystem budgets, see dnet_config::memory_limit */
+	struct dnet_memory	memory;
+	/* minimal body size of write which is streamed into the backend, 0 if disabled, see dnet_config */
+	uint64_t		stream_write_size;
+	/* minimal size of send call made with MSG_ZEROCOPY, 0 if disabled, see dnet_config */
+	uint64_t		zerocopy_send_size;
+	/* nonblocking requests are processed by idle threads of other backends, see dnet_config */
+	int			nonblocking_io_steal;
+	/* low-latency network profile, see dnet_config */
+	int			socket_send_buffer;
+	int			socket_receive_buffer;
+	int			busy_poll_usecs;
+	/* networks connections to which are compressed and minimal compressed payload, see dnet_config */
+	struct dnet_net_prefix	*wire_compression_nets;
+	int			wire_compression_net_num;
+	uint64_t		wire_compression_threshold;
+	int			short_header;
+	/* encrypted networks and their TLS context, NULL if encryption is disabled, see dnet_config::tls_networks */
+	struct dnet_net_prefix	*tls_nets;
+	int			tls_net_num;
+	struct dnet_tls_context	*tls_ctx;
+	/* locality of this node, NULL if not set, and localities of remote networks, see dnet_config::localities */
+	char			*locality;
+	struct dnet_locality	*localities;
+	int			locality_num;
+
+	/* initial number of notify hash buckets, see notify.c */
 	unsigned int		notify_hash_size;
-	struct dnet_notify_bucket	*notify_hash;
+	struct dnet_notify_table	*notify;
 
 	pthread_mutex_t		reconnect_lock;
 	struct list_head	reconnect_list;
@@ -636,6 +1410,7 @@ struct dnet_node
 	void			*srw;
 	void			*indexes;
 	int			indexes_shard_count;
+	uint64_t		indexes_split_size;
 
 	int			server_prio;
 	int			client_prio;
@@ -650,6 +1425,12 @@ struct dnet_node
 	 */
 	pthread_mutex_t		iterator_lock;
 
+	/*
+	 * Update filters of DNET_CMD_ATOMIC_UPDATE loaded so far, they are unloaded with the node
+	 */
+	struct list_head	update_filter_list;
+	pthread_mutex_t		update_filter_lock;
+
 	void			*monitor;
 
 	struct dnet_config_data *config_data;
@@ -691,6 +1472,19 @@ struct dnet_session {
 	/* Namespace */
 	char			*ns;
 	int			nsize;
+
+	/* latency percentile of the first group after which read is also sent to the next one, 0 - disabled */
+	int			hedge_percentile;
+
+	/* adaptive timeout of reads and lookups, see dnet_session_set_adaptive_timeout(), 0 percentile - disabled */
+	int			adaptive_percentile;
+	int			adaptive_multiplier;
+	long			adaptive_min_ms;
+
+	/* limits of iterators and server-sends started by this session, 0 - unlimited */
+	uint64_t		background_rate_bytes;
+	uint64_t		background_rate_keys;
+	uint32_t		iterator_threads;
 };
 
 static inline int dnet_counter_init(struct dnet_node *n)
@@ -737,23 +1531,65 @@ static inline void dnet_counter_set(struct dnet_node *n, int counter, int err, i
 
 struct dnet_trans;
 int __attribute__((weak)) dnet_process_cmd_raw(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data, int recursive);
+/*
+ * Processes read request by net thread if it is served by cache without waiting,
+ * returns -EAGAIN leaving request untouched if it has to be queued to io pool
+ */
+int dnet_process_cache_hit(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
+/* Replies -ENOENT to read or lookup of the key which backend knows to be absent */
+void dnet_process_absent_key(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
 int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_io_req *r);
 void dnet_trans_update_timestamp(struct dnet_trans *t);
 
 int dnet_recv(struct dnet_net_state *st, void *data, unsigned int size);
 int dnet_sendfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t size);
+int dnet_recvfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t size);
 
-int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r);
+int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r, int more);
+/*
+ * Maximum number of queued requests whose headers and data are sent by single sendmsg() call
+ */
+#define DNET_SEND_BATCH_MAX	32
+/*
+ * Maximum number of iovec entries of single sendmsg() call, header and data of every batched request
+ * take two of them, data segments (see @dnet_io_req.iov) may take more
+ */
+#define DNET_SEND_IOV_MAX	(4 * DNET_SEND_BATCH_MAX)
+/*
+ * Sends in-memory parts (header and data) of @num requests with single sendmsg() call
+ * starting from @st->send_offset in the first one. Returns number of bytes sent or negative error.
+ */
+ssize_t dnet_send_request_iov(struct dnet_net_state *st, struct dnet_io_req **reqs, int num, int more);
+/*
+ * Frees requests whose zero-copy sends are completed by the kernel,
+ * returns negative error if socket has failed
+ */
+int dnet_state_zerocopy_complete(struct dnet_net_state *st);
 
 
 int __attribute__((weak)) dnet_send_ack(struct dnet_net_state *st, struct dnet_cmd *cmd, int err, int recursive);
 void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r);
+int dnet_schedule_backend_io(struct dnet_backend_io *backend, struct dnet_io_req *r);
 
 struct dnet_config;
 
 int dnet_socket_create_listening(struct dnet_node *node, const struct dnet_addr *addr);
 
+/*
+ * Unix sockets of co-located server, see dnet_config::local_socket_dir.
+ * dnet_local_socket_listen() returns listening socket for server address @addr,
+ * dnet_local_socket_connect() returns socket connected to server @addr or negative error
+ * if there is no usable local socket, TCP has to be used then.
+ */
+int dnet_local_socket_listen(struct dnet_node *n, const struct dnet_addr *addr);
+void dnet_local_socket_unlink(struct dnet_node *n, const struct dnet_addr *addr);
+int dnet_local_socket_connect(struct dnet_node *n, const struct dnet_addr *addr);
+
 void dnet_set_sockopt(struct dnet_node *n, int s);
+void dnet_set_socket_buffers(struct dnet_node *n, int s);
+void dnet_set_incoming_cpu(struct dnet_node *n, int s, int shard);
+/* CPU net thread of server or client shard @shard is bound to, negative if unknown */
+int dnet_server_shard_cpu(int shard);
 void dnet_sock_close(struct dnet_node *n, int s);
 
 enum dnet_join_state {
@@ -765,16 +1601,18 @@ int __attribute__((weak)) dnet_state_join(struct dnet_net_state *st);
 
 struct dnet_trans
 {
-	struct rb_node			trans_entry;
-	struct rb_node			timer_entry;
+	/* set while transaction is in its state's transaction table */
+	int				in_trans_table;
+	struct list_head		timer_entry;
 
-	/* is used when checking thread moves transaction out of the above trees because of timeout */
+	/* is used when checking thread moves transaction out of the table and timer wheel because of timeout */
 	struct list_head		trans_list_entry;
 
 	struct timeval			time, start;
 	struct timespec			wait_ts;
 
 	struct dnet_net_state		*orig; /* only for forward */
+	struct dnet_net_state		*owner; /* route table state if transaction is sent via its lane */
 	size_t				alloc_size;
 
 	struct dnet_node		*n;
@@ -793,6 +1631,7 @@ struct dnet_trans
 };
 
 void dnet_trans_destroy(struct dnet_trans *t);
+void dnet_trans_set_adaptive_timeout(struct dnet_session *s, struct dnet_trans *t, int backend_id);
 int dnet_trans_send_fail(struct dnet_session *s, struct dnet_addr *addr, struct dnet_trans_control *ctl, int err, int destroy);
 struct dnet_trans *dnet_trans_alloc(struct dnet_node *n, uint64_t size);
 int dnet_trans_alloc_send_state(struct dnet_session *s, struct dnet_net_state *st, struct dnet_trans_control *ctl);
@@ -819,6 +1658,13 @@ void dnet_trans_remove_timer_nolock(struct dnet_net_state *st, struct dnet_trans
 
 void dnet_trans_remove(struct dnet_trans *t);
 
+int dnet_node_trans_timer_init(struct dnet_node *n);
+void dnet_node_trans_timer_cleanup(struct dnet_node *n);
+void dnet_state_trans_init(struct dnet_net_state *st);
+void dnet_state_trans_cleanup(struct dnet_net_state *st);
+/* removes all transactions of the state and moves them into @head, references are kept */
+int dnet_state_trans_move_all(struct dnet_net_state *st, struct list_head *head);
+
 void dnet_trans_clean_list(struct list_head *head, int error);
 int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_head *head);
 int dnet_state_reset_nolock_noclean(struct dnet_net_state *st, int error, struct list_head *head);
@@ -829,13 +1675,80 @@ int dnet_recv_list(struct dnet_node *n, struct dnet_net_state *st);
 
 ssize_t dnet_send_fd(struct dnet_net_state *st, void *header, uint64_t hsize,
 		int fd, uint64_t offset, uint64_t dsize, int on_exit);
+/*
+ * Queues file part split into @chunk_size pieces, every piece is held in the send queue
+ * until @verify() of its range succeeds, see dnet_send_read_data_verified()
+ */
+int dnet_send_fd_verified(struct dnet_net_state *st, void *header, uint64_t hsize,
+		int fd, uint64_t offset, uint64_t fsize, int on_exit, uint64_t chunk_size,
+		int (*verify)(void *priv, uint64_t chunk_offset, uint64_t chunk_size), void *priv);
+/*
+ * Queues reply of @size bytes split into @piece_size pieces, data of every piece is provided by @fill()
+ * in order and is referenced until sent, see dnet_send_read_data_pieces()
+ */
+int dnet_send_data_pieces(struct dnet_net_state *st, void *header, uint64_t hsize, uint64_t size, uint64_t piece_size,
+		int (*fill)(void *priv, uint64_t piece_offset, uint64_t piece_size,
+			void **data, void (**release)(void *release_priv), void **release_priv), void *priv);
+/*
+ * Queues held pieces of the reply, see dnet_send_read_data_pieces_queue()
+ */
+struct dnet_send_pieces *dnet_send_pieces_queue(struct dnet_net_state *st, void *header, uint64_t hsize,
+		uint64_t size, uint64_t piece_size, int *errp);
+/*
+ * The same, but reply consists of @num pieces of sizes set when they are released
+ */
+struct dnet_send_pieces *dnet_send_pieces_queue_num(struct dnet_net_state *st, void *header, uint64_t hsize,
+		int num, int *errp);
 ssize_t dnet_send_data(struct dnet_net_state *st, void *header, uint64_t hsize, void *data, uint64_t dsize);
+/*
+ * Same as dnet_send_reply(), but reply's data consists of @header followed by @odata,
+ * both are copied only once when queued
+ */
+int dnet_send_reply_split(void *state, struct dnet_cmd *cmd, const void *header, unsigned int hsize,
+		const void *odata, unsigned int size, int more);
+/*
+ * Queues @data without copying it, @release(@priv) is called when data has been sent
+ * or sending has failed. Reference is consumed even if this function returns error.
+ */
+ssize_t dnet_send_data_ref(struct dnet_net_state *st, void *header, uint64_t hsize, void *data, uint64_t dsize,
+		void (*release)(void *priv), void *priv);
+/*
+ * Reference counted buffer shared by send queues instead of being copied into each of them,
+ * dnet_buffer_get() and dnet_buffer_put() fit @data_acquire/@data_release of dnet_trans_control
+ * and @release of dnet_send_data_ref(), allocated buffer holds one reference
+ */
+struct dnet_buffer {
+	atomic_t		refcnt;
+	size_t			size;
+	char			data[0];
+};
+
+struct dnet_buffer *dnet_buffer_alloc(size_t size);
+void dnet_buffer_get(void *buffer);
+void dnet_buffer_put(void *buffer);
+/*
+ * Sends read reply with @data referenced the same way dnet_send_data_ref() does
+ */
+int dnet_send_read_data_ref(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		void (*release)(void *priv), void *priv);
 ssize_t dnet_send(struct dnet_net_state *st, void *data, uint64_t size);
 ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size);
 
+/*
+ * Address lost or not yet connected, it stays in @dnet_node::reconnect_list until the state is connected.
+ *
+ * Each attempt doubles @reconnect_time backoff in seconds up to @reconnect_time_max, the next one
+ * is made at random time within the second half of it (@next_attempt, monotonic seconds), so clients
+ * which have lost the same server do not reconnect to it simultaneously.
+ * @route_share is the part of group routes the lost state has served, such addresses are reconnected first.
+ */
+#define DNET_RECONNECT_BACKOFF_MAX	16
+
 struct dnet_addr_storage
 {
 	int				reconnect_time, reconnect_time_max;
+	long				next_attempt;
+	double				route_share;
 	struct list_head		reconnect_entry;
 	struct dnet_addr		addr;
 	unsigned int			__join_state;
@@ -843,12 +1756,29 @@ struct dnet_addr_storage
 
 int dnet_check_thread_start(struct dnet_node *n);
 void dnet_check_thread_stop(struct dnet_node *n);
-void dnet_reconnect_and_check_route_table(struct dnet_node *node);
+/*
+ * Reconnects addresses of @node->reconnect_list whose backoff has expired,
+ * if @check_route_table is set also requests route lists from a few connected states
+ */
+void dnet_reconnect_and_check_route_table(struct dnet_node *node, int check_route_table);
 
 int dnet_set_name(const char *format, ...);
 int dnet_ioprio_set(long pid, int class_id, int prio);
 int dnet_ioprio_get(long pid);
 
+/*
+ * Binds calling thread to CPUs of @numa_node and makes it prefer memory of that node
+ */
+int dnet_numa_bind_thread(int numa_node);
+/*
+ * Returns NUMA node calling thread is running on or negative error
+ */
+int dnet_numa_current_node(void);
+/*
+ * Binds calling thread to @cpu
+ */
+int dnet_cpu_bind_thread(int cpu);
+
 struct dnet_map_fd {
 	int			fd;
 	uint64_t		offset, size;
@@ -871,8 +1801,30 @@ int dnet_cmd_exec_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, struct sp
 
 void *dnet_cache_init(struct dnet_node *n, struct dnet_backend_io *backend, const void *config);
 void dnet_cache_cleanup(void *);
+/*
+ * Changes size of the cache and proportions of its @count pages, zero @count keeps proportions.
+ * Returns -EINVAL if @size is zero or number of pages differs from the configured one.
+ */
+int dnet_cache_resize(void *cache, uint64_t size, const uint32_t *proportions, uint32_t count);
+uint64_t dnet_cache_size(void *cache);
 int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, char *data);
+/*
+ * Replies to read request if object is cached and cache shard is not locked exclusively,
+ * returns -EAGAIN without sending anything otherwise, it never blocks
+ */
+int dnet_cmd_cache_try_read(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io);
 int dnet_cmd_cache_lookup(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd);
+/*
+ * Copies cached object @io->id into @data allocated by malloc(), sets its size, timestamp and user flags into @io.
+ * Returns -ENOENT without touching disk if object is not cached, @io->flags must not request cache population.
+ */
+int dnet_cmd_cache_read_local(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, void **data);
+int dnet_cmd_cache_read_range(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io);
+/*
+ * Queues @count keys of @ios to be loaded into the cache by background thread, see DNET_IO_FLAGS_CACHE_PREFETCH
+ */
+int dnet_cmd_cache_prefetch(struct dnet_backend_io *backend, struct dnet_cmd *cmd, const struct dnet_io_attr *ios, uint64_t count);
 
 int dnet_indexes_init(struct dnet_node *, struct dnet_config *);
 void dnet_indexes_cleanup(struct dnet_node *);
@@ -918,6 +1870,12 @@ int dnet_iterator_list_remove(struct dnet_node *n, uint64_t id);
 /* Misc routines */
 uint64_t dnet_iterator_list_next_id_nolock(struct dnet_node *n);
 
+/* upper limit of parallel workers of single iterator */
+#define DNET_ITERATOR_MAX_THREADS	16
+
+/* number of processed keys between checkpoints of DNET_IFLAGS_CHECKPOINTS iterator */
+#define DNET_ITERATOR_CHECKPOINT_KEYS	100000
+
 /*
  * Common private data:
  * Request + next callback and it's argument.
@@ -926,6 +1884,7 @@ struct dnet_iterator_common_private {
 	struct dnet_iterator_request	*req;		/* Original request */
 	struct dnet_iterator_range	*range;		/* Original ranges */
 	struct dnet_iterator		*it;		/* Iterator control structure */
+	struct dnet_node		*n;		/* Node whose memory pressure pauses iteration */
 
 	/* This callback will be invoked by dnet_iterator_callback_common(), which is invoked by low-level backend iterator
 	 * @priv - callback specific private data, @next_private below, like @dnet_iterator_send_private
@@ -941,16 +1900,202 @@ struct dnet_iterator_common_private {
 	uint64_t			total_keys;	/* number of keys that will be iterated */
 	atomic_t			iterated_keys;	/* number of keys that have been already iterated */
 	atomic_t			skipped_keys;	/* number of keys that have been skipped */
+
+	struct dnet_throttle		throttle;	/* limits of this iterator from @req */
+	struct dnet_throttle		*backend_throttle; /* limits of all background operations of the backend */
+	struct dnet_record_filters	*filters;	/* DNET_IFLAGS_FILTER: record filters of the backend */
+
+	/* DNET_IFLAGS_CHECKPOINTS: checkpoint to resume from, position of the current record */
+	struct dnet_iterator_checkpoint	resume;
+	int				resume_found;
+	int				last_fd;
+	struct dnet_iterator_checkpoint	current;
+	uint64_t			checkpoint_keys; /* keys processed since the last sent checkpoint */
 };
 
+/*
+ * Packs small DNET_FLAGS_MORE replies of single transaction into one DNET_FLAGS_BATCH reply.
+ * Batch is sent when it is full or when its first reply waits for more than DNET_REPLY_BATCH_TIMEOUT,
+ * own thread of the batch sends it when no more replies come for that long.
+ */
+#define DNET_REPLY_BATCH_SIZE		(64 * 1024)
+#define DNET_REPLY_BATCH_TIMEOUT	100	/* msecs */
+
+struct dnet_reply_batch {
+	struct dnet_net_state		*st;
+	struct dnet_cmd			*cmd;
+
+	pthread_mutex_t			lock;
+	char				*buffer;
+	size_t				size;
+	int				num;
+	struct timeval			start;
+
+	/* flushes batch on timeout, its error is returned by the next add or destroy */
+	pthread_t			flusher;
+	pthread_cond_t			cond;
+	int				need_exit;
+	int				flush_err;
+
+	/* batch is sent as DNET_FLAGS_COMPACT reply, see dnet_reply_batch_add_compact() */
+	int				compact;
+	struct dnet_raw_id		prev_key;
+};
+
+int dnet_reply_batch_init(struct dnet_reply_batch *b, struct dnet_net_state *st, struct dnet_cmd *cmd);
+/* Flushes pending replies and frees batch resources */
+int dnet_reply_batch_destroy(struct dnet_reply_batch *b);
+int dnet_reply_batch_add(struct dnet_reply_batch *b, const void *data, size_t size);
+/* Packs iterator response @re in host byte order into compact batch */
+int dnet_reply_batch_add_compact(struct dnet_reply_batch *b, const struct dnet_iterator_response *re);
+
+/* the longest compact record: prefix byte, whole key and five 64-bit varints */
+#define DNET_COMPACT_RECORD_MAX		(1 + DNET_ID_SIZE + 5 * 10)
+
+static inline unsigned char *dnet_varint_put(unsigned char *p, uint64_t value)
+{
+	while (value >= 0x80) {
+		*p++ = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+	return p;
+}
+
+static inline int dnet_varint_get(const unsigned char **p, const unsigned char *end, uint64_t *value)
+{
+	const unsigned char *ptr = *p;
+	int shift;
+
+	*value = 0;
+	for (shift = 0; ptr < end && shift < 64; shift += 7) {
+		*value |= (uint64_t)(*ptr & 0x7f) << shift;
+		if (!(*ptr++ & 0x80)) {
+			*p = ptr;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
 /*
  * Send over network callback private.
  */
 struct dnet_iterator_send_private {
 	struct dnet_net_state		*st;		/* State to send data to */
 	struct dnet_cmd			*cmd;		/* Command */
+	struct dnet_reply_batch		*batch;		/* Not NULL if client accepts batched replies */
+};
+
+/*
+ * DNET_IFLAGS_ORDERED private: responses are stored into unlinked temporary file,
+ * which is sorted and sent via @send when iteration completes
+ */
+struct dnet_iterator_ordered_private {
+	struct dnet_iterator_send_private *send;
+	pthread_mutex_t			lock;
+	int				fd;
+	uint64_t			size;
+};
+
+/*
+ * Range hash callback private, see DNET_ITYPE_HASH.
+ */
+struct dnet_iterator_hash_entry {
+	struct dnet_iterator_range	range;
+	uint64_t			hash;
+	uint64_t			keys;
+	uint64_t			size;
+};
+
+struct dnet_iterator_hash_private {
+	struct dnet_net_state		*st;		/* State to send ranges to */
+	struct dnet_cmd			*cmd;		/* Command */
+	struct dnet_iterator_hash_entry	*entries;	/* Requested ranges sorted by their start */
+	uint64_t			entry_num;
+	atomic_t			hashed_keys;
+};
+
+/*
+ * Native filter callback private, see DNET_ITYPE_FILTER and elliptics/iterator_filter.h
+ */
+struct dnet_iterator_filter;
+struct dnet_iterator_filter_private {
+	struct dnet_net_state		*st;		/* State to send results to */
+	struct dnet_cmd			*cmd;		/* Command */
+	void				*handle;	/* dlopen() handle of the filter library */
+	const struct dnet_iterator_filter *ops;
+	void				*priv;		/* Filter's context created by its init() */
+	atomic_t			processed_keys;
+	atomic_t			emitted;
+	uint64_t			total_keys;
 };
 
+int dnet_iterator_filter_init(struct dnet_iterator_filter_private *filter, struct dnet_net_state *st,
+		struct dnet_cmd *cmd, const char *spec, uint32_t spec_size);
+int dnet_iterator_callback_filter(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset);
+int dnet_iterator_filter_finish(struct dnet_iterator_filter_private *filter, uint64_t total_keys);
+void dnet_iterator_filter_cleanup(struct dnet_iterator_filter_private *filter);
+
+/*
+ * Record filters of the backend loaded by its config, see struct dnet_record_filter
+ */
+struct dnet_record_filter;
+struct dnet_iterator_filter_record;
+struct dnet_record_filter_plugin {
+	char				*name;
+	void				*handle;
+	const struct dnet_record_filter	*ops;
+	void				*priv;
+	atomic_t			calls;
+	atomic_t			skipped;
+	atomic_t			narrowed;
+	atomic_t			failed;
+	atomic_t			usecs;
+};
+
+struct dnet_record_filters {
+	int				num;
+	struct dnet_record_filter_plugin *plugins;
+	/* microseconds per second all filters may spend, 0 means unlimited */
+	struct dnet_inline_budget	budget;
+	/* records which have waited for or have been rejected by the exhausted budget */
+	atomic_t			throttled;
+};
+
+int dnet_record_filters_load(struct dnet_node *n, size_t backend_id, int num, const char **names,
+		const char **configs, uint64_t budget, struct dnet_record_filters **filters);
+void dnet_record_filters_unload(struct dnet_record_filters *filters);
+/*
+ * Returns 0 if record has to be sent, DNET_RECORD_FILTER_SKIP if it is dropped or negative error.
+ * When budget is exhausted, caller either waits for the next second if @wait is set or gets -EBUSY.
+ */
+int dnet_record_filters_apply(struct dnet_record_filters *filters, int cmd, struct dnet_iterator_filter_record *rec,
+		int wait);
+
+/*
+ * Update filters of DNET_CMD_ATOMIC_UPDATE, see struct dnet_update_filter
+ */
+struct dnet_update_filter;
+struct dnet_update_filter_plugin {
+	struct list_head		entry;
+	char				*name;
+	void				*handle;
+	const struct dnet_update_filter	*ops;
+};
+
+/* loads update filter @name on the first call, the same @ops are returned until the node is destroyed */
+int dnet_update_filter_get(struct dnet_node *n, const char *name, const struct dnet_update_filter **ops);
+void dnet_update_filters_unload(struct dnet_node *n);
+
+/*
+ * Reads the record of DNET_CMD_ATOMIC_UPDATE @cmd and builds DNET_CMD_WRITE request with its new data,
+ * @request is allocated by malloc() and is in network byte order. The key must be locked by caller.
+ */
+int dnet_atomic_update_prepare(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		void *data, void **request, uint64_t *request_size);
+
 /*
  * Save to file callback private.
  */
@@ -1034,11 +2179,40 @@ again:
 	return 0;
 }
 
+/**
+ * dnet_write_ll() - interruption-safe wrapper for pwrite(2)
+ */
+static inline int dnet_write_ll(int fd, const char *data, size_t size, off_t offset)
+{
+	ssize_t bytes;
+
+	while (size) {
+		bytes = pwrite(fd, data, size, offset);
+		if (bytes == -1) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += bytes;
+		size -= bytes;
+		offset += bytes;
+	}
+	return 0;
+}
+
 /*
  * Watermarks for number of bytes written into the wire
  */
 #define DNET_SERVER_SEND_WATERMARK_HIGH		(100*1024*1024L)
 
+/*
+ * Limits of DNET_CMD_BULK_WRITE request sent by server-send iterator with DNET_IFLAGS_BULK_WRITE,
+ * keys larger than DNET_SERVER_SEND_BULK_KEY_SIZE are sent as separate WRITE commands
+ */
+#define DNET_SERVER_SEND_BULK_KEYS		256
+#define DNET_SERVER_SEND_BULK_SIZE		(1024*1024)
+#define DNET_SERVER_SEND_BULK_KEY_SIZE		(64*1024)
+
 /*
  * Send data over network to another server as set of WRITE commands
  */
@@ -1064,6 +2238,13 @@ struct dnet_server_send_ctl {
 	int				write_error;	/* Set to the first error occurred during write
 							 * This will stop iterator. */
 
+	struct dnet_map_fd		*diffs;		/* Sorted metadata of every remote group, see DNET_IFLAGS_DIFF */
+	atomic_t			diff_skipped;	/* Number of keys which remote groups already have */
+
+	struct dnet_throttle		throttle;	/* Per-request limits of DNET_CMD_SEND */
+
+	pthread_mutex_t			bulk_lock;	/* Lock for @bulks */
+	struct list_head		bulks;		/* Keys being packed for every remote backend, see DNET_IFLAGS_BULK_WRITE */
 
 	atomic_t			refcnt;		/* Reference counter which will be increased for every
 							 * async WRITE operation. get/put methods should be used
@@ -0,0 +1,158 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fault injection rules of backends. Rules are checked by io threads only in servers
+ * built with DNET_FAULT_INJECTION, see dnet_process_cmd_with_backend_raw().
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "elliptics.h"
+
+/* the longest injected delay, so disabled rules and stopping node are not waited for too long */
+#define DNET_FAULT_MAX_DELAY_US		(60 * 1000000ULL)
+
+static __thread unsigned short dnet_fault_seed[3];
+static __thread int dnet_fault_seeded;
+
+/* uniformly distributed in [0, 1) */
+static double dnet_fault_random(void)
+{
+	if (!dnet_fault_seeded) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		dnet_fault_seed[0] = ts.tv_nsec;
+		dnet_fault_seed[1] = ts.tv_nsec >> 16;
+		dnet_fault_seed[2] = (unsigned short)(uintptr_t)&dnet_fault_seeded;
+		dnet_fault_seeded = 1;
+	}
+
+	return erand48(dnet_fault_seed);
+}
+
+static uint64_t dnet_fault_delay(const struct dnet_fault_rule *rule)
+{
+	double delay;
+
+	switch (rule->distribution) {
+	case DNET_FAULT_DELAY_UNIFORM:
+		delay = rule->delay_min + dnet_fault_random() * (rule->delay_max - rule->delay_min);
+		break;
+	case DNET_FAULT_DELAY_EXPONENTIAL:
+		delay = -log(1 - dnet_fault_random()) * rule->delay_min;
+		if (rule->delay_max && delay > rule->delay_max)
+			delay = rule->delay_max;
+		break;
+	case DNET_FAULT_DELAY_FIXED:
+	default:
+		delay = rule->delay_min;
+		break;
+	}
+
+	if (delay > DNET_FAULT_MAX_DELAY_US)
+		delay = DNET_FAULT_MAX_DELAY_US;
+	return delay;
+}
+
+static int dnet_fault_rule_check(const struct dnet_fault_rule *rule)
+{
+	if (rule->cmd >= __DNET_CMD_MAX || rule->probability > DNET_FAULT_PROBABILITY_MAX || rule->error > 0)
+		return -EINVAL;
+
+	switch (rule->distribution) {
+	case DNET_FAULT_DELAY_FIXED:
+	case DNET_FAULT_DELAY_EXPONENTIAL:
+		return 0;
+	case DNET_FAULT_DELAY_UNIFORM:
+		return rule->delay_min <= rule->delay_max ? 0 : -EINVAL;
+	default:
+		return -EINVAL;
+	}
+}
+
+int dnet_backend_faults_set(struct dnet_backend_io *backend, const struct dnet_fault_rule *rules, int num)
+{
+	struct dnet_fault_rule *copy = NULL, *old;
+	int i, err;
+
+	for (i = 0; i < num; ++i) {
+		err = dnet_fault_rule_check(&rules[i]);
+		if (err)
+			return err;
+	}
+
+	if (num) {
+		copy = malloc(num * sizeof(struct dnet_fault_rule));
+		if (!copy)
+			return -ENOMEM;
+		memcpy(copy, rules, num * sizeof(struct dnet_fault_rule));
+	}
+
+	pthread_mutex_lock(&backend->faults_lock);
+	old = backend->faults;
+	backend->faults = copy;
+	backend->faults_num = num;
+	pthread_mutex_unlock(&backend->faults_lock);
+
+	free(old);
+	return 0;
+}
+
+int dnet_backend_faults_inject(struct dnet_backend_io *backend, struct dnet_cmd *cmd)
+{
+	struct dnet_fault_rule rule;
+	int i, fired = 0;
+
+	/* read without the lock, the rule set is checked again under it */
+	if (!backend->faults_num)
+		return 0;
+
+	pthread_mutex_lock(&backend->faults_lock);
+	for (i = 0; i < backend->faults_num; ++i) {
+		const struct dnet_fault_rule *r = &backend->faults[i];
+
+		if (r->cmd && r->cmd != (uint32_t)cmd->cmd)
+			continue;
+
+		if (dnet_fault_random() * DNET_FAULT_PROBABILITY_MAX < r->probability) {
+			rule = *r;
+			fired = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&backend->faults_lock);
+
+	if (!fired)
+		return 0;
+
+	const uint64_t delay = dnet_fault_delay(&rule);
+	if (delay) {
+		struct timespec ts = {delay / 1000000, (delay % 1000000) * 1000};
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR && !backend->need_exit)
+			;
+	}
+
+	return rule.error;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2008+ Evgeniy Polyakov <zbr@ioremap.net>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "hugepage.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB	(21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB	(30 << MAP_HUGE_SHIFT)
+#endif
+
+static int dnet_huge_mode = DNET_HUGE_PAGES_NONE;
+
+static uint64_t dnet_huge_sizes[DNET_HUGE_BACKING_REGULAR + 1];
+
+static const char *dnet_huge_mode_names[] = {
+	[DNET_HUGE_PAGES_NONE] = "none",
+	[DNET_HUGE_PAGES_MADVISE] = "madvise",
+	[DNET_HUGE_PAGES_2M] = "2m",
+	[DNET_HUGE_PAGES_1G] = "1g",
+};
+
+int dnet_huge_pages_set_mode(int mode)
+{
+	int old;
+
+	if (mode < DNET_HUGE_PAGES_NONE || mode > DNET_HUGE_PAGES_1G)
+		return -EINVAL;
+
+	old = __sync_val_compare_and_swap(&dnet_huge_mode, DNET_HUGE_PAGES_NONE, mode);
+	if (old != DNET_HUGE_PAGES_NONE && old != mode)
+		return -EBUSY;
+
+	return 0;
+}
+
+int dnet_huge_pages_mode(void)
+{
+	return __atomic_load_n(&dnet_huge_mode, __ATOMIC_RELAXED);
+}
+
+const char *dnet_huge_pages_mode_string(int mode)
+{
+	if (mode < DNET_HUGE_PAGES_NONE || mode > DNET_HUGE_PAGES_1G)
+		return "unknown";
+
+	return dnet_huge_mode_names[mode];
+}
+
+int dnet_huge_pages_mode_parse(const char *str)
+{
+	int mode;
+
+	for (mode = DNET_HUGE_PAGES_NONE; mode <= DNET_HUGE_PAGES_1G; ++mode) {
+		if (!strcasecmp(str, dnet_huge_mode_names[mode]))
+			return mode;
+	}
+
+	return -EINVAL;
+}
+
+size_t dnet_huge_pages_size(void)
+{
+	switch (dnet_huge_pages_mode()) {
+	case DNET_HUGE_PAGES_MADVISE:
+	case DNET_HUGE_PAGES_2M:
+		return DNET_HUGE_PAGE_2M_SIZE;
+	case DNET_HUGE_PAGES_1G:
+		return DNET_HUGE_PAGE_1G_SIZE;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Maps @size bytes aligned to 2 MB, so that transparent huge pages can back the whole region
+ */
+static void *dnet_huge_map_aligned(size_t size)
+{
+	const size_t align = DNET_HUGE_PAGE_2M_SIZE;
+	char *ptr, *aligned;
+	size_t head, tail;
+
+	ptr = mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	aligned = (char *)(((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1));
+	head = aligned - ptr;
+	tail = align - head;
+
+	if (head)
+		munmap(ptr, head);
+	if (tail)
+		munmap(aligned + size, tail);
+
+	return aligned;
+}
+
+void *dnet_huge_alloc(size_t size, int *backing)
+{
+	int mode = dnet_huge_pages_mode();
+	void *ptr;
+
+	if (mode == DNET_HUGE_PAGES_NONE || !size)
+		return NULL;
+
+	size = (size + DNET_HUGE_PAGE_2M_SIZE - 1) & ~(DNET_HUGE_PAGE_2M_SIZE - 1);
+
+	if (mode == DNET_HUGE_PAGES_2M || mode == DNET_HUGE_PAGES_1G) {
+		int page_flag = MAP_HUGE_2MB;
+
+		if (mode == DNET_HUGE_PAGES_1G && !(size & (DNET_HUGE_PAGE_1G_SIZE - 1)))
+			page_flag = MAP_HUGE_1GB;
+
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | page_flag, -1, 0);
+		if (ptr != MAP_FAILED) {
+			*backing = DNET_HUGE_BACKING_HUGETLB;
+			goto out;
+		}
+	}
+
+	ptr = dnet_huge_map_aligned(size);
+	if (!ptr)
+		return NULL;
+
+	*backing = DNET_HUGE_BACKING_REGULAR;
+#ifdef MADV_HUGEPAGE
+	if (!madvise(ptr, size, MADV_HUGEPAGE))
+		*backing = DNET_HUGE_BACKING_MADVISE;
+#endif
+
+out:
+	__sync_add_and_fetch(&dnet_huge_sizes[*backing], size);
+	return ptr;
+}
+
+void dnet_huge_free(void *ptr, size_t size, int backing)
+{
+	if (!ptr)
+		return;
+
+	size = (size + DNET_HUGE_PAGE_2M_SIZE - 1) & ~(DNET_HUGE_PAGE_2M_SIZE - 1);
+
+	munmap(ptr, size);
+	__sync_sub_and_fetch(&dnet_huge_sizes[backing], size);
+}
+
+void dnet_huge_pages_stat(struct dnet_huge_pages_stat *stat)
+{
+	stat->hugetlb_size = __atomic_load_n(&dnet_huge_sizes[DNET_HUGE_BACKING_HUGETLB], __ATOMIC_RELAXED);
+	stat->madvise_size = __atomic_load_n(&dnet_huge_sizes[DNET_HUGE_BACKING_MADVISE], __ATOMIC_RELAXED);
+	stat->fallback_size = __atomic_load_n(&dnet_huge_sizes[DNET_HUGE_BACKING_REGULAR], __ATOMIC_RELAXED);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2008+ Evgeniy Polyakov <zbr@ioremap.net>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_HUGEPAGE_H
+#define __DNET_HUGEPAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Huge page backed regions for long living pools: cache value slabs and receive buffers.
+ *
+ * Region is mapped from hugetlbfs pool with pages of the mode's size first. If the pool
+ * is exhausted or not configured, region is mapped aligned to 2 MB and transparent huge pages
+ * are asked with madvise(MADV_HUGEPAGE), and if this is not supported either, pages are regular.
+ * Regions are not touched on allocation, so their memory lands on the NUMA node of the thread
+ * which first writes there, like malloc()'ed one.
+ *
+ * Mode is process-wide, it is set once by the first node created with non-zero @huge_pages option.
+ */
+enum dnet_huge_pages_mode {
+	DNET_HUGE_PAGES_NONE = 0,
+	/* transparent huge pages only */
+	DNET_HUGE_PAGES_MADVISE,
+	/* 2 MB pages of hugetlbfs */
+	DNET_HUGE_PAGES_2M,
+	/* 1 GB pages of hugetlbfs for regions of at least 1 GB, 2 MB pages for smaller ones */
+	DNET_HUGE_PAGES_1G,
+};
+
+/* How region returned by dnet_huge_alloc() is really backed */
+enum dnet_huge_backing {
+	DNET_HUGE_BACKING_HUGETLB = 0,
+	DNET_HUGE_BACKING_MADVISE,
+	DNET_HUGE_BACKING_REGULAR,
+};
+
+#define DNET_HUGE_PAGE_2M_SIZE		(2UL * 1024 * 1024)
+#define DNET_HUGE_PAGE_1G_SIZE		(1024UL * 1024 * 1024)
+
+struct dnet_huge_pages_stat {
+	/* bytes mapped from hugetlbfs pool */
+	uint64_t		hugetlb_size;
+	/* bytes mapped with MADV_HUGEPAGE */
+	uint64_t		madvise_size;
+	/* bytes which had to be mapped with regular pages */
+	uint64_t		fallback_size;
+};
+
+/* Returns 0 on success, -EINVAL for unknown mode and -EBUSY if other mode is already set */
+int dnet_huge_pages_set_mode(int mode);
+int dnet_huge_pages_mode(void);
+const char *dnet_huge_pages_mode_string(int mode);
+/* Parses "none", "madvise", "2m" or "1g", returns -EINVAL for anything else */
+int dnet_huge_pages_mode_parse(const char *str);
+
+/*
+ * Size of the largest page of current mode, regions should be multiple of it. 0 if huge pages are off.
+ */
+size_t dnet_huge_pages_size(void);
+
+/*
+ * Maps region of @size bytes (rounded up to 2 MB) and stores its dnet_huge_backing into @backing.
+ * Returns NULL if huge pages are off or mmap() failed.
+ * Region must be returned by dnet_huge_free() with the same @size and @backing.
+ */
+void *dnet_huge_alloc(size_t size, int *backing);
+void dnet_huge_free(void *ptr, size_t size, int backing);
+
+void dnet_huge_pages_stat(struct dnet_huge_pages_stat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_HUGEPAGE_H */
@@ -0,0 +1,470 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elliptics.h"
+
+#include "elliptics/iterator_filter.h"
+
+/* filter's name is a file name, it must not point outside of the filter directory */
+static int dnet_iterator_filter_name_valid(const char *name, size_t size)
+{
+	size_t i;
+
+	if (!size || size > NAME_MAX - 3)
+		return 0;
+
+	for (i = 0; i < size; ++i) {
+		if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-')
+			return 0;
+	}
+
+	return 1;
+}
+
+/* loads NAME.so from iterator_filter_dir and returns its @symbol */
+static int dnet_filter_open(struct dnet_node *n, const char *name, const char *symbol, void **handle, void **sym)
+{
+	const char *dir = n->config_data ? n->config_data->iterator_filter_dir : NULL;
+	char path[PATH_MAX];
+
+	if (!dir) {
+		dnet_log(n, DNET_LOG_ERROR, "filter: %s: iterator_filter_dir is not configured", name);
+		return -ENOTSUP;
+	}
+
+	if (!dnet_iterator_filter_name_valid(name, strlen(name))) {
+		dnet_log(n, DNET_LOG_ERROR, "filter: %s: invalid filter name", name);
+		return -EINVAL;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s.so", dir, name);
+
+	*handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!*handle) {
+		dnet_log(n, DNET_LOG_ERROR, "filter: %s: could not load: %s", path, dlerror());
+		return -ENOENT;
+	}
+
+	*sym = dlsym(*handle, symbol);
+	if (!*sym) {
+		dnet_log(n, DNET_LOG_ERROR, "filter: %s: does not export %s", path, symbol);
+		dlclose(*handle);
+		*handle = NULL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int dnet_iterator_filter_init(struct dnet_iterator_filter_private *filter, struct dnet_net_state *st,
+		struct dnet_cmd *cmd, const char *spec, uint32_t spec_size)
+{
+	struct dnet_node *n = st->n;
+	void *ops;
+	size_t name_size;
+	int err;
+
+	memset(filter, 0, sizeof(struct dnet_iterator_filter_private));
+	filter->st = st;
+	filter->cmd = cmd;
+	atomic_init(&filter->processed_keys, 0);
+
+	name_size = strnlen(spec, spec_size);
+	if (name_size == spec_size) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: iteration failed: invalid filter name", dnet_dump_id(&cmd->id));
+		return -EINVAL;
+	}
+
+	err = dnet_filter_open(n, spec, DNET_ITERATOR_FILTER_SYMBOL, &filter->handle, &ops);
+	if (err)
+		return err;
+
+	filter->ops = ops;
+	if (!filter->ops->process) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: iteration failed: filter: %s does not provide process()",
+				dnet_dump_id(&cmd->id), spec);
+		err = -EINVAL;
+		goto err_out_close;
+	}
+
+	if (filter->ops->init) {
+		err = filter->ops->init(&filter->priv, spec + name_size + 1, spec_size - name_size - 1);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: iteration failed: filter: %s init failed: %d",
+					dnet_dump_id(&cmd->id), spec, err);
+			goto err_out_close;
+		}
+	}
+
+	dnet_log(n, DNET_LOG_NOTICE, "%s: iterating with filter: %s", dnet_dump_id(&cmd->id), spec);
+	return 0;
+
+err_out_close:
+	dlclose(filter->handle);
+	filter->handle = NULL;
+	filter->ops = NULL;
+	return err;
+}
+
+void dnet_iterator_filter_cleanup(struct dnet_iterator_filter_private *filter)
+{
+	if (!filter->handle)
+		return;
+
+	if (filter->ops->cleanup)
+		filter->ops->cleanup(filter->priv);
+
+	dlclose(filter->handle);
+	filter->handle = NULL;
+}
+
+static int dnet_iterator_filter_emit(void *priv, const struct dnet_raw_id *key, const void *data, uint64_t size)
+{
+	struct dnet_iterator_filter_private *filter = priv;
+	struct dnet_iterator_response *re;
+	int err;
+
+	re = malloc(sizeof(struct dnet_iterator_response) + size);
+	if (!re)
+		return -ENOMEM;
+
+	memset(re, 0, sizeof(struct dnet_iterator_response));
+	re->key = *key;
+	re->size = size;
+	re->iterated_keys = atomic_read(&filter->processed_keys);
+	re->total_keys = filter->total_keys;
+	dnet_convert_iterator_response(re);
+
+	if (size)
+		memcpy(re + 1, data, size);
+
+	err = dnet_send_reply_threshold(filter->st, filter->cmd, re, sizeof(struct dnet_iterator_response) + size, 1);
+	free(re);
+
+	if (!err)
+		atomic_inc(&filter->emitted);
+	return err;
+}
+
+/*
+ * Passes iterated record with descriptor of its data to the filter,
+ * client gets only emitted results and keepalives
+ */
+int dnet_iterator_callback_filter(void *priv, void *data, uint64_t dsize, int fd, uint64_t data_offset)
+{
+	struct dnet_iterator_filter_private *filter = priv;
+	struct dnet_iterator_filter_record rec;
+	struct dnet_iterator_response re;
+	int err;
+
+	if (filter->st->__need_exit) {
+		dnet_log(filter->st->n, DNET_LOG_ERROR,
+				"%s: Interrupting iterator because peer has been disconnected",
+				dnet_dump_id(&filter->cmd->id));
+		return -EINTR;
+	}
+
+	if (dsize < sizeof(struct dnet_iterator_response))
+		return -EINVAL;
+
+	memcpy(&re, data, sizeof(struct dnet_iterator_response));
+	dnet_convert_iterator_response(&re);
+
+	/* keepalive of keys skipped by timestamp */
+	if (re.status)
+		return dnet_send_reply_threshold(filter->st, filter->cmd, data, sizeof(struct dnet_iterator_response), 1);
+
+	filter->total_keys = re.total_keys;
+
+	rec.key = re.key;
+	rec.timestamp = re.timestamp;
+	rec.user_flags = re.user_flags;
+	rec.flags = re.flags;
+	rec.fd = fd;
+	rec.offset = data_offset;
+	rec.size = re.size;
+	rec.data = NULL;
+
+	err = filter->ops->process(filter->priv, &rec, dnet_iterator_filter_emit, filter);
+	if (err < 0)
+		return err;
+
+	if (atomic_inc(&filter->processed_keys) % 10000 == 0) {
+		struct dnet_iterator_response keepalive;
+
+		memset(&keepalive, 0, sizeof(struct dnet_iterator_response));
+		keepalive.status = 1;
+		keepalive.total_keys = re.total_keys;
+		keepalive.iterated_keys = re.iterated_keys;
+		dnet_convert_iterator_response(&keepalive);
+
+		return dnet_send_reply_threshold(filter->st, filter->cmd, &keepalive, sizeof(keepalive), 1);
+	}
+
+	return 0;
+}
+
+int dnet_iterator_filter_finish(struct dnet_iterator_filter_private *filter, uint64_t total_keys)
+{
+	int err = 0;
+
+	filter->total_keys = total_keys;
+
+	if (filter->ops->finish)
+		err = filter->ops->finish(filter->priv, dnet_iterator_filter_emit, filter);
+
+	dnet_log(filter->st->n, err ? DNET_LOG_ERROR : DNET_LOG_NOTICE, "%s: filter finished: processed_keys: %ld, "
+			"emitted: %ld, err: %d", dnet_dump_id(&filter->cmd->id),
+			atomic_read(&filter->processed_keys), atomic_read(&filter->emitted), err);
+	return err < 0 ? err : 0;
+}
+
+int dnet_record_filters_load(struct dnet_node *n, size_t backend_id, int num, const char **names,
+		const char **configs, uint64_t budget, struct dnet_record_filters **ret)
+{
+	struct dnet_record_filters *filters;
+	struct dnet_record_filter_plugin *p;
+	void *ops;
+	int err, i;
+
+	filters = calloc(1, sizeof(struct dnet_record_filters) + num * sizeof(struct dnet_record_filter_plugin));
+	if (!filters)
+		return -ENOMEM;
+
+	filters->plugins = (struct dnet_record_filter_plugin *)(filters + 1);
+	filters->budget.limit = budget;
+	atomic_init(&filters->throttled, 0);
+
+	for (i = 0; i < num; ++i) {
+		p = &filters->plugins[i];
+
+		p->name = strdup(names[i]);
+		if (!p->name) {
+			err = -ENOMEM;
+			goto err_out_unload;
+		}
+
+		err = dnet_filter_open(n, names[i], DNET_RECORD_FILTER_SYMBOL, &p->handle, &ops);
+		if (err)
+			goto err_out_free_name;
+
+		p->ops = ops;
+		if (!p->ops->filter) {
+			dnet_log(n, DNET_LOG_ERROR, "backend: %zu: record filter: %s does not provide filter()",
+					backend_id, names[i]);
+			err = -EINVAL;
+			goto err_out_close;
+		}
+
+		if (p->ops->init) {
+			err = p->ops->init(&p->priv, configs[i]);
+			if (err) {
+				dnet_log(n, DNET_LOG_ERROR, "backend: %zu: record filter: %s init failed: %d",
+						backend_id, names[i], err);
+				goto err_out_close;
+			}
+		}
+
+		atomic_init(&p->calls, 0);
+		atomic_init(&p->skipped, 0);
+		atomic_init(&p->narrowed, 0);
+		atomic_init(&p->failed, 0);
+		atomic_init(&p->usecs, 0);
+
+		filters->num++;
+
+		dnet_log(n, DNET_LOG_INFO, "backend: %zu: loaded record filter: %s", backend_id, names[i]);
+	}
+
+	*ret = filters;
+	return 0;
+
+err_out_close:
+	dlclose(p->handle);
+err_out_free_name:
+	free(p->name);
+err_out_unload:
+	dnet_record_filters_unload(filters);
+	return err;
+}
+
+void dnet_record_filters_unload(struct dnet_record_filters *filters)
+{
+	int i;
+
+	if (!filters)
+		return;
+
+	for (i = 0; i < filters->num; ++i) {
+		struct dnet_record_filter_plugin *p = &filters->plugins[i];
+
+		if (p->ops->cleanup)
+			p->ops->cleanup(p->priv);
+		dlclose(p->handle);
+		free(p->name);
+	}
+
+	free(filters);
+}
+
+static int dnet_record_filters_budget_exhausted(struct dnet_inline_budget *b, uint64_t now)
+{
+	uint64_t window = now / 1000000;
+	uint64_t prev = b->window;
+
+	if (!b->limit)
+		return 0;
+
+	if (prev != window && __sync_bool_compare_and_swap(&b->window, prev, window))
+		b->used = 0;
+
+	return b->used >= b->limit;
+}
+
+int dnet_record_filters_apply(struct dnet_record_filters *filters, int cmd, struct dnet_iterator_filter_record *rec,
+		int wait)
+{
+	const uint64_t offset = rec->offset, size = rec->size;
+	uint64_t begin, start, end;
+	int err = 0, i;
+
+	start = dnet_monotonic_usecs();
+	if (dnet_record_filters_budget_exhausted(&filters->budget, start)) {
+		atomic_inc(&filters->throttled);
+		if (!wait)
+			return -EBUSY;
+
+		do {
+			usleep(1000000 - start % 1000000);
+			start = dnet_monotonic_usecs();
+		} while (dnet_record_filters_budget_exhausted(&filters->budget, start));
+	}
+
+	begin = end = start;
+	for (i = 0; i < filters->num; ++i) {
+		struct dnet_record_filter_plugin *p = &filters->plugins[i];
+		const uint64_t prev_offset = rec->offset, prev_size = rec->size;
+
+		atomic_inc(&p->calls);
+
+		err = p->ops->filter(p->priv, cmd, rec);
+
+		end = dnet_monotonic_usecs();
+		atomic_add(&p->usecs, end - start);
+		start = end;
+
+		if (err < 0) {
+			atomic_inc(&p->failed);
+			break;
+		}
+
+		/* narrowed part must lie within the original one, data is sent from the same place */
+		if (rec->offset < offset || rec->offset > offset + size ||
+				rec->size > offset + size - rec->offset) {
+			atomic_inc(&p->failed);
+			err = -ERANGE;
+			break;
+		}
+
+		if (rec->offset != prev_offset || rec->size != prev_size)
+			atomic_inc(&p->narrowed);
+
+		if (err == DNET_RECORD_FILTER_SKIP) {
+			atomic_inc(&p->skipped);
+			break;
+		}
+	}
+
+	__sync_add_and_fetch(&filters->budget.used, end - begin);
+	return err;
+}
+
+int dnet_update_filter_get(struct dnet_node *n, const char *name, const struct dnet_update_filter **ops)
+{
+	struct dnet_update_filter_plugin *p;
+	void *sym;
+	int err = 0;
+
+	pthread_mutex_lock(&n->update_filter_lock);
+
+	list_for_each_entry(p, &n->update_filter_list, entry) {
+		if (!strcmp(p->name, name)) {
+			*ops = p->ops;
+			goto err_out_unlock;
+		}
+	}
+
+	p = calloc(1, sizeof(struct dnet_update_filter_plugin));
+	if (!p) {
+		err = -ENOMEM;
+		goto err_out_unlock;
+	}
+
+	p->name = strdup(name);
+	if (!p->name) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	err = dnet_filter_open(n, name, DNET_UPDATE_FILTER_SYMBOL, &p->handle, &sym);
+	if (err)
+		goto err_out_free_name;
+
+	p->ops = sym;
+	if (!p->ops->update) {
+		dnet_log(n, DNET_LOG_ERROR, "update filter: %s does not provide update()", name);
+		err = -EINVAL;
+		goto err_out_close;
+	}
+
+	list_add_tail(&p->entry, &n->update_filter_list);
+	*ops = p->ops;
+
+	dnet_log(n, DNET_LOG_INFO, "loaded update filter: %s", name);
+	goto err_out_unlock;
+
+err_out_close:
+	dlclose(p->handle);
+err_out_free_name:
+	free(p->name);
+err_out_free:
+	free(p);
+err_out_unlock:
+	pthread_mutex_unlock(&n->update_filter_lock);
+	return err;
+}
+
+void dnet_update_filters_unload(struct dnet_node *n)
+{
+	struct dnet_update_filter_plugin *p, *tmp;
+
+	list_for_each_entry_safe(p, tmp, &n->update_filter_list, entry) {
+		list_del(&p->entry);
+		dlclose(p->handle);
+		free(p->name);
+		free(p);
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "lock.h"
+
+int dnet_lock_stat_enabled;
+
+static struct dnet_lock_site *dnet_lock_sites;
+
+/*
+ * Locks held by the thread, so hold time is counted at the site which has taken the lock
+ * even if it is released somewhere else. Locks nested deeper are not counted.
+ */
+#define DNET_LOCK_STAT_HELD	8
+
+struct dnet_held_lock {
+	const void		*lock;
+	struct dnet_lock_site	*site;
+	uint64_t		start;
+};
+
+static __thread struct dnet_held_lock dnet_held_locks[DNET_LOCK_STAT_HELD];
+static __thread int dnet_held_count;
+
+static int dnet_lock_stat_bucket(uint64_t usecs)
+{
+	int bucket = usecs ? 64 - __builtin_clzll(usecs) : 0;
+
+	return bucket < DNET_LOCK_STAT_BUCKETS ? bucket : DNET_LOCK_STAT_BUCKETS - 1;
+}
+
+static void dnet_lock_stat_register(struct dnet_lock_site *site)
+{
+	struct dnet_lock_site *head;
+
+	if (site->registered || !__sync_bool_compare_and_swap(&site->registered, 0, 1))
+		return;
+
+	do {
+		head = dnet_lock_sites;
+		site->next = head;
+	} while (!__sync_bool_compare_and_swap(&dnet_lock_sites, head, site));
+}
+
+void dnet_lock_stat_acquired(struct dnet_lock_site *site, const void *lock, uint64_t start, int contended)
+{
+	uint64_t now = dnet_lock_stat_usecs();
+	uint64_t wait = now - start;
+
+	dnet_lock_stat_register(site);
+
+	__sync_add_and_fetch(&site->acquired, 1);
+	if (contended) {
+		__sync_add_and_fetch(&site->contended, 1);
+		__sync_add_and_fetch(&site->wait_time, wait);
+	}
+	__sync_add_and_fetch(&site->wait[dnet_lock_stat_bucket(wait)], 1);
+
+	if (dnet_held_count < DNET_LOCK_STAT_HELD) {
+		struct dnet_held_lock *held = &dnet_held_locks[dnet_held_count];
+
+		held->lock = lock;
+		held->site = site;
+		held->start = now;
+	}
+	dnet_held_count++;
+}
+
+void dnet_lock_stat_released(const void *lock)
+{
+	struct dnet_held_lock *held;
+	uint64_t hold;
+	int i;
+
+	for (i = (dnet_held_count < DNET_LOCK_STAT_HELD ? dnet_held_count : DNET_LOCK_STAT_HELD) - 1; i >= 0; --i) {
+		if (dnet_held_locks[i].lock == lock)
+			break;
+	}
+
+	/* lock was taken by not instrumented site or before statistics was enabled */
+	if (i < 0) {
+		if (dnet_held_count > DNET_LOCK_STAT_HELD)
+			dnet_held_count--;
+		return;
+	}
+
+	held = &dnet_held_locks[i];
+	hold = dnet_lock_stat_usecs() - held->start;
+
+	__sync_add_and_fetch(&held->site->hold_time, hold);
+	__sync_add_and_fetch(&held->site->hold[dnet_lock_stat_bucket(hold)], 1);
+
+	for (; i < dnet_held_count - 1 && i < DNET_LOCK_STAT_HELD - 1; ++i)
+		dnet_held_locks[i] = dnet_held_locks[i + 1];
+	dnet_held_count--;
+}
+
+struct dnet_lock_site *dnet_lock_stat_sites(void)
+{
+	return __sync_add_and_fetch(&dnet_lock_sites, 0);
+}
@@ -72,4 +72,174 @@ static inline void dnet_lock_unlock(struct dnet_lock *l)
 }
 #endif
 
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wait and hold times of lock sites are counted in log2 buckets of usecs:
+ * bucket 0 is less than 1 usec, bucket i is [2^(i-1), 2^i) usecs, the last one takes the rest
+ */
+#define DNET_LOCK_STAT_BUCKETS		24
+
+/*
+ * Statistics of one place in the code which takes the lock.
+ * Sites are static objects created by DNET_LOCK_SITE(), they are put
+ * into the global list when lock statistics is enabled and the site is taken first time.
+ */
+struct dnet_lock_site {
+	const char		*name;
+	const char		*func;
+	const char		*file;
+	int			line;
+	int			registered;
+	struct dnet_lock_site	*next;
+
+	uint64_t		acquired;
+	uint64_t		contended;
+	uint64_t		wait_time;
+	uint64_t		hold_time;
+	uint64_t		wait[DNET_LOCK_STAT_BUCKETS];
+	uint64_t		hold[DNET_LOCK_STAT_BUCKETS];
+};
+
+#define DNET_LOCK_SITE(lock_name) ({ \
+		static struct dnet_lock_site __dnet_lock_site = { (lock_name), __func__, __FILE__, __LINE__, 0, NULL, 0, 0, 0, 0, {0}, {0} }; \
+		&__dnet_lock_site; \
+	})
+
+/* set by monitor.lock_stats, when it is not set instrumented locks cost one extra branch */
+extern int dnet_lock_stat_enabled;
+
+void dnet_lock_stat_acquired(struct dnet_lock_site *site, const void *lock, uint64_t start, int contended);
+void dnet_lock_stat_released(const void *lock);
+
+/*
+ * Returns head of the list of sites which have been taken since lock statistics is enabled
+ */
+struct dnet_lock_site *dnet_lock_stat_sites(void);
+
+static inline uint64_t dnet_lock_stat_usecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Takes @lock and counts its wait and hold times at @site, @site may be NULL
+ */
+static inline void dnet_mutex_lock_site(pthread_mutex_t *lock, struct dnet_lock_site *site)
+{
+	uint64_t start;
+
+	if (!dnet_lock_stat_enabled || !site) {
+		pthread_mutex_lock(lock);
+		return;
+	}
+
+	start = dnet_lock_stat_usecs();
+	if (!pthread_mutex_trylock(lock)) {
+		dnet_lock_stat_acquired(site, lock, start, 0);
+		return;
+	}
+
+	pthread_mutex_lock(lock);
+	dnet_lock_stat_acquired(site, lock, start, 1);
+}
+
+static inline void dnet_mutex_unlock_site(pthread_mutex_t *lock)
+{
+	if (dnet_lock_stat_enabled)
+		dnet_lock_stat_released(lock);
+	pthread_mutex_unlock(lock);
+}
+
+/*
+ * Takes @lock at the calling site, @lock must be released by dnet_mutex_unlock()
+ */
+#define dnet_mutex_lock(lock) dnet_mutex_lock_site((lock), DNET_LOCK_SITE(#lock))
+#define dnet_mutex_unlock(lock) dnet_mutex_unlock_site(lock)
+
+#ifdef __cplusplus
+}
+
+/*
+ * Mutex wrapper which counts statistics of @site, usable with std::unique_lock and std::lock_guard
+ */
+template <typename Mutex>
+class dnet_site_mutex
+{
+public:
+	dnet_site_mutex(Mutex &mutex, struct dnet_lock_site *site) : m_mutex(mutex), m_site(site)
+	{
+	}
+
+	void lock()
+	{
+		uint64_t start;
+
+		if (!dnet_lock_stat_enabled) {
+			m_mutex.lock();
+			return;
+		}
+
+		start = dnet_lock_stat_usecs();
+		if (m_mutex.try_lock()) {
+			dnet_lock_stat_acquired(m_site, &m_mutex, start, 0);
+			return;
+		}
+
+		m_mutex.lock();
+		dnet_lock_stat_acquired(m_site, &m_mutex, start, 1);
+	}
+
+	bool try_lock()
+	{
+		if (!m_mutex.try_lock())
+			return false;
+
+		if (dnet_lock_stat_enabled)
+			dnet_lock_stat_acquired(m_site, &m_mutex, dnet_lock_stat_usecs(), 0);
+		return true;
+	}
+
+	void unlock()
+	{
+		if (dnet_lock_stat_enabled)
+			dnet_lock_stat_released(&m_mutex);
+		m_mutex.unlock();
+	}
+
+private:
+	Mutex			&m_mutex;
+	struct dnet_lock_site	*m_site;
+};
+
+template <typename Mutex>
+class dnet_site_lock_guard
+{
+public:
+	dnet_site_lock_guard(Mutex &mutex, struct dnet_lock_site *site) : m_mutex(mutex, site)
+	{
+		m_mutex.lock();
+	}
+
+	~dnet_site_lock_guard()
+	{
+		m_mutex.unlock();
+	}
+
+	dnet_site_lock_guard(const dnet_site_lock_guard &) = delete;
+	dnet_site_lock_guard &operator =(const dnet_site_lock_guard &) = delete;
+
+private:
+	dnet_site_mutex<Mutex>	m_mutex;
+};
+#endif
+
 #endif /* __DNET_LOCK_H */
@@ -0,0 +1,131 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "elliptics.h"
+
+/* caches start to shrink once usage is above this percent of the limit */
+#define DNET_MEMORY_HIGH_WATERMARK	90
+
+int dnet_memory_enabled(struct dnet_node *n)
+{
+	int i;
+
+	if (n->memory.limit)
+		return 1;
+
+	for (i = 0; i < DNET_MEMORY_SUBSYSTEMS; ++i) {
+		if (n->memory.budget[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+void dnet_memory_charge(struct dnet_node *n, enum dnet_memory_subsystem subsystem, int64_t delta)
+{
+	if (delta >= 0)
+		__sync_add_and_fetch(&n->memory.used[subsystem], (uint64_t)delta);
+	else
+		__sync_sub_and_fetch(&n->memory.used[subsystem], (uint64_t)-delta);
+}
+
+uint64_t dnet_memory_used(struct dnet_node *n, enum dnet_memory_subsystem subsystem)
+{
+	if (subsystem == DNET_MEMORY_RECV)
+		return n->recv_memory_used;
+
+	return n->memory.used[subsystem];
+}
+
+uint64_t dnet_memory_total(struct dnet_node *n)
+{
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < DNET_MEMORY_SUBSYSTEMS; ++i)
+		total += dnet_memory_used(n, i);
+
+	return total;
+}
+
+static enum dnet_memory_pressure dnet_memory_level(uint64_t used, uint64_t limit)
+{
+	if (!limit)
+		return DNET_MEMORY_PRESSURE_NONE;
+	if (used >= limit)
+		return DNET_MEMORY_PRESSURE_CRITICAL;
+	if (used >= limit / 100 * DNET_MEMORY_HIGH_WATERMARK)
+		return DNET_MEMORY_PRESSURE_HIGH;
+	return DNET_MEMORY_PRESSURE_NONE;
+}
+
+enum dnet_memory_pressure dnet_memory_pressure(struct dnet_node *n, enum dnet_memory_subsystem subsystem)
+{
+	enum dnet_memory_pressure node, own;
+
+	node = dnet_memory_level(dnet_memory_total(n), n->memory.limit);
+	own = dnet_memory_level(dnet_memory_used(n, subsystem), n->memory.budget[subsystem]);
+
+	return node > own ? node : own;
+}
+
+static uint64_t dnet_memory_above(uint64_t used, uint64_t limit)
+{
+	const uint64_t high = limit / 100 * DNET_MEMORY_HIGH_WATERMARK;
+
+	if (!limit || used <= high)
+		return 0;
+	return used - high;
+}
+
+uint64_t dnet_memory_excess(struct dnet_node *n, enum dnet_memory_subsystem subsystem)
+{
+	uint64_t node, own;
+
+	node = dnet_memory_above(dnet_memory_total(n), n->memory.limit);
+	own = dnet_memory_above(dnet_memory_used(n, subsystem), n->memory.budget[subsystem]);
+
+	return node > own ? node : own;
+}
+
+const char *dnet_memory_subsystem_string(enum dnet_memory_subsystem subsystem)
+{
+	switch (subsystem) {
+	case DNET_MEMORY_CACHE:
+		return "cache";
+	case DNET_MEMORY_RECV:
+		return "recv";
+	case DNET_MEMORY_SEND:
+		return "send";
+	default:
+		return "unknown";
+	}
+}
+
+const char *dnet_memory_pressure_string(enum dnet_memory_pressure pressure)
+{
+	switch (pressure) {
+	case DNET_MEMORY_PRESSURE_NONE:
+		return "none";
+	case DNET_MEMORY_PRESSURE_HIGH:
+		return "high";
+	case DNET_MEMORY_PRESSURE_CRITICAL:
+		return "critical";
+	default:
+		return "unknown";
+	}
+}
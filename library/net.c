@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,13 +30,21 @@
 #include <fcntl.h>
 
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
 #include "elliptics.h"
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
 
 #include "../monitor/measure_points.h"
+#include "probes.h"
 #include "tests.h"
+#include "tls.h"
 
 #ifndef POLLRDHUP
 #define POLLRDHUP 0x2000
@@ -142,30 +151,16 @@ err_out_exit:
 
 void dnet_state_clean(struct dnet_net_state *st)
 {
-	struct rb_node *rb_node;
-	struct dnet_trans *t;
-	int num = 0;
-
-	while (1) {
-		t = NULL;
-
-		pthread_mutex_lock(&st->trans_lock);
-		rb_node = rb_first(&st->trans_root);
-		if (rb_node) {
-			t = rb_entry(rb_node, struct dnet_trans, trans_entry);
-			dnet_trans_get(t);
+	struct dnet_trans *t, *tmp;
+	LIST_HEAD(head);
+	int num;
 
-			dnet_trans_remove_nolock(st, t);
-			list_del_init(&t->trans_list_entry);
-		}
-		pthread_mutex_unlock(&st->trans_lock);
+	num = dnet_state_trans_move_all(st, &head);
 
-		if (!t)
-			break;
+	list_for_each_entry_safe(t, tmp, &head, trans_list_entry) {
+		list_del_init(&t->trans_list_entry);
 
 		dnet_trans_put(t);
-		dnet_trans_put(t);
-		num++;
 	}
 
 	dnet_log(st->n, DNET_LOG_NOTICE, "Cleaned state %s, transactions freed: %d", dnet_state_dump_addr(st), num);
@@ -175,10 +170,17 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 {
 	void *buf;
 	struct dnet_io_req *r;
+	size_t data_size = orig->dsize;
 	int offset = 0;
 	int err = 0;
+	int i;
 
-	buf = r = malloc(sizeof(struct dnet_io_req) + orig->dsize + orig->hsize);
+	/* referenced data takes no space in the buffer except for segments descriptors */
+	if (orig->data_release)
+		data_size = orig->iovcnt * sizeof(struct iovec);
+
+	/* one byte in front of header is kept for length byte of short header, see dnet_io_req_short_header() */
+	r = malloc(sizeof(struct dnet_io_req) + 1 + data_size + orig->hsize);
 	if (!r) {
 		dnet_log(st->n, DNET_LOG_ERROR, "Not enough memory for io req queue fd: %d : %s %d", orig->fd, strerror(-err), err);
 		return NULL;
@@ -186,6 +188,8 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 	memset(r, 0, sizeof(struct dnet_io_req));
 	r->fd = -1;
 
+	buf = (void *)r + 1;
+
 	if (orig->header && orig->hsize) {
 		r->header = buf + sizeof(struct dnet_io_req);
 		r->hsize = orig->hsize;
@@ -194,7 +198,26 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 		memcpy(r->header, orig->header, r->hsize);
 	}
 
-	if (orig->data && orig->dsize) {
+	if (orig->data_release) {
+		r->data = orig->data;
+		r->dsize = orig->dsize;
+		r->data_release = orig->data_release;
+		r->data_priv = orig->data_priv;
+
+		if (orig->iovcnt) {
+			r->iov = buf + sizeof(struct dnet_io_req) + offset;
+			r->iovcnt = orig->iovcnt;
+			memcpy(r->iov, orig->iov, orig->iovcnt * sizeof(struct iovec));
+		}
+	} else if (orig->iovcnt && orig->dsize) {
+		r->data = buf + sizeof(struct dnet_io_req) + offset;
+		r->dsize = orig->dsize;
+
+		for (i = 0; i < orig->iovcnt; ++i) {
+			memcpy(buf + sizeof(struct dnet_io_req) + offset, orig->iov[i].iov_base, orig->iov[i].iov_len);
+			offset += orig->iov[i].iov_len;
+		}
+	} else if (orig->data && orig->dsize) {
 		r->data = buf + sizeof(struct dnet_io_req) + offset;
 		r->dsize = orig->dsize;
 
@@ -212,27 +235,581 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 	return r;
 }
 
+void dnet_schedule_send_once_nolock(struct dnet_net_state *st)
+{
+	if (!__sync_lock_test_and_set(&st->send_scheduled, 1) && !st->__need_exit)
+		dnet_schedule_send(st);
+}
+
+static inline uint32_t dnet_zigzag_encode(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t dnet_zigzag_decode(uint64_t v)
+{
+	return (int32_t)((v >> 1) ^ -(v & 1));
+}
+
+static inline int dnet_short_header_same_key(const struct dnet_id *a, const struct dnet_id *b)
+{
+	return a->group_id == b->group_id && !memcmp(a->id, b->id, DNET_ID_SIZE);
+}
+
+int dnet_short_header_encode(const struct dnet_cmd *cmd, uint8_t *buf, int with_key)
+{
+	uint8_t *p = buf + 1;
+
+	p = dnet_varint_put(p, cmd->trans);
+	p = dnet_varint_put(p, cmd->flags);
+	p = dnet_varint_put(p, cmd->size);
+	p = dnet_varint_put(p, dnet_zigzag_encode(cmd->status));
+	p = dnet_varint_put(p, (uint32_t)cmd->cmd);
+	p = dnet_varint_put(p, dnet_zigzag_encode(cmd->backend_id));
+	p = dnet_varint_put(p, cmd->trace_id);
+
+	if (with_key) {
+		p = dnet_varint_put(p, cmd->id.group_id);
+		memcpy(p, cmd->id.id, DNET_ID_SIZE);
+		p += DNET_ID_SIZE;
+	}
+
+	buf[0] = p - buf - 1;
+	return p - buf;
+}
+
+int dnet_short_header_decode(const uint8_t *buf, size_t size, struct dnet_cmd *cmd, struct dnet_id *key)
+{
+	const uint8_t *end = buf + size;
+	uint64_t v[7], group_id;
+	int i;
+
+	for (i = 0; i < 7; ++i) {
+		if (dnet_varint_get(&buf, end, &v[i]))
+			return -EPROTO;
+	}
+
+	memset(cmd, 0, sizeof(struct dnet_cmd));
+
+	if (buf != end) {
+		if (dnet_varint_get(&buf, end, &group_id) || group_id > UINT32_MAX || end - buf != DNET_ID_SIZE)
+			return -EPROTO;
+
+		cmd->id.group_id = group_id;
+		memcpy(cmd->id.id, buf, DNET_ID_SIZE);
+		if (key)
+			*key = cmd->id;
+	} else if (key) {
+		cmd->id = *key;
+	}
+
+	cmd->trans = v[0];
+	cmd->flags = v[1];
+	cmd->size = v[2];
+	cmd->status = dnet_zigzag_decode(v[3]);
+	cmd->cmd = v[4];
+	cmd->backend_id = dnet_zigzag_decode(v[5]);
+	cmd->trace_id = v[6];
+	return 0;
+}
+
+int dnet_short_header_confirmed(const struct dnet_cmd *cmd, const void *data)
+{
+	const struct dnet_auth *a = data;
+
+	return cmd->cmd == DNET_CMD_AUTH && (cmd->flags & DNET_FLAGS_REPLY) && cmd->size == sizeof(struct dnet_auth) &&
+		(dnet_bswap64(a->flags) & DNET_AUTH_FLAGS_SHORT_HEADER);
+}
+
+/* command which lies entirely in header or in own data of @r */
+static struct dnet_cmd *dnet_io_req_cmd_raw(struct dnet_io_req *r)
+{
+	if (r->header && r->hsize >= sizeof(struct dnet_cmd))
+		return r->header;
+	if (!r->hsize && !r->iovcnt && r->data && r->dsize >= sizeof(struct dnet_cmd))
+		return r->data;
+	return NULL;
+}
+
+struct dnet_cmd *dnet_io_req_cmd(struct dnet_io_req *r, struct dnet_cmd *tmp)
+{
+	const uint8_t *h = r->header;
+
+	if (r->continuation)
+		return NULL;
+	if (!r->wire_header)
+		return r->header ? r->header : r->data;
+
+	/* full command follows zero length byte, either in header or in data if header is that byte only */
+	if (!h[0])
+		return r->hsize > 1 ? (struct dnet_cmd *)(h + 1) : r->data;
+
+	if (dnet_short_header_decode(h + 1, h[0], tmp, NULL)) {
+		memset(tmp, 0, sizeof(struct dnet_cmd));
+	} else if ((size_t)h[0] + 1 <= sizeof(struct dnet_cmd) - sizeof(struct dnet_id)) {
+		/* keyless header has been written over the tail of the command and has not reached its key */
+		memcpy(&tmp->id, h + h[0] + 1 - sizeof(struct dnet_cmd), sizeof(struct dnet_id));
+		dnet_convert_id(&tmp->id);
+	}
+	dnet_convert_cmd(tmp);
+	return tmp;
+}
+
+/*
+ * Converts header of request queued after short headers have been enabled.
+ * Replies whose command is in request's own buffer get short header written over the tail
+ * of the command, other requests are prefixed with zero length byte which dnet_io_req_copy()
+ * keeps in front of the header. Key is sent only if it differs from the key of previous
+ * short header of this connection, that is why it is called in the order requests go into the socket.
+ */
+static void dnet_io_req_short_header(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = dnet_io_req_cmd_raw(r), host;
+	uint8_t buf[DNET_SHORT_HEADER_MAX];
+	void *end;
+	int size, with_key;
+
+	r->wire_header = 1;
+
+	/* referenced data belongs to somebody else and may be shared, it is not modified */
+	if (cmd && (cmd == r->header || !r->data_release)) {
+		host = *cmd;
+		dnet_convert_cmd(&host);
+
+		with_key = !dnet_short_header_same_key(&host.id, &st->short_send_key);
+		size = (host.flags & DNET_FLAGS_REPLY) ? dnet_short_header_encode(&host, buf, with_key) : 0;
+
+		/* header has to fit into the command it is written over */
+		if (size && size <= (int)sizeof(struct dnet_cmd)) {
+			if (with_key)
+				st->short_send_key = host.id;
+
+			end = cmd + 1;
+			memcpy(end - size, buf, size);
+
+			if (cmd == r->header) {
+				r->hsize -= sizeof(struct dnet_cmd) - size;
+			} else {
+				r->hsize = size;
+				r->data = end;
+				r->dsize -= sizeof(struct dnet_cmd);
+			}
+			r->header = end - size;
+			return;
+		}
+	}
+
+	if (r->hsize) {
+		r->header -= 1;
+		r->hsize += 1;
+	} else {
+		r->header = (void *)r + sizeof(struct dnet_io_req);
+		r->hsize = 1;
+	}
+	*(uint8_t *)r->header = 0;
+}
+
+/*
+ * Puts request into the send list. The list is ordered the same way requests go into the socket,
+ * so short headers are switched on right after confirmation, see DNET_AUTH_FLAGS_SHORT_HEADER.
+ */
+static void dnet_send_list_add_nolock(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd;
+
+	if (st->short_header_send && !r->continuation)
+		dnet_io_req_short_header(st, r);
+
+	list_add_tail(&r->req_entry, &st->send_list);
+
+	if (st->short_header_pending && !r->continuation) {
+		cmd = dnet_io_req_cmd_raw(r);
+		if (cmd && dnet_bswap32(cmd->cmd) == DNET_CMD_AUTH && (dnet_bswap64(cmd->flags) & DNET_FLAGS_REPLY) &&
+				dnet_bswap64(cmd->size) == sizeof(struct dnet_auth)) {
+			st->short_header_pending = 0;
+			st->short_header_send = 1;
+		}
+	}
+}
+
+void dnet_send_inbox_drain_nolock(struct dnet_net_state *st)
+{
+	struct dnet_io_req *head, *prev = NULL, *next;
+
+	do {
+		head = st->send_inbox;
+		if (!head)
+			return;
+	} while (!__sync_bool_compare_and_swap(&st->send_inbox, head, NULL));
+
+	/* inbox is a stack, the most recent request is on top */
+	while (head) {
+		next = head->send_next;
+		head->send_next = prev;
+		prev = head;
+		head = next;
+	}
+
+	for (head = prev; head; head = next) {
+		next = head->send_next;
+		dnet_send_list_add_nolock(st, head);
+	}
+}
+
+int dnet_wire_compression_supported(void)
+{
+#ifdef HAVE_LZ4
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Parses comma separated list of networks like "10.1.0.0/16,fd00::/8", address without prefix length
+ * matches only itself
+ */
+int dnet_net_prefix_parse(const char *networks, struct dnet_net_prefix **netsp, int *nump)
+{
+	struct dnet_net_prefix *nets = NULL, *p;
+	char *tmp, *token, *saveptr, *bits, *end;
+	long len;
+	int num = 0, err = 0;
+
+	*netsp = NULL;
+	*nump = 0;
+
+	if (!networks || !*networks)
+		return 0;
+
+	tmp = strdup(networks);
+	if (!tmp)
+		return -ENOMEM;
+
+	for (token = strtok_r(tmp, ", ", &saveptr); token; token = strtok_r(NULL, ", ", &saveptr)) {
+		p = realloc(nets, (num + 1) * sizeof(struct dnet_net_prefix));
+		if (!p) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+		nets = p;
+		p = &nets[num];
+		memset(p, 0, sizeof(struct dnet_net_prefix));
+
+		bits = strchr(token, '/');
+		if (bits)
+			*bits++ = '\0';
+
+		if (inet_pton(AF_INET, token, p->addr) == 1) {
+			p->family = AF_INET;
+			p->bits = 32;
+		} else if (inet_pton(AF_INET6, token, p->addr) == 1) {
+			p->family = AF_INET6;
+			p->bits = 128;
+		} else {
+			err = -EINVAL;
+			goto err_out_free;
+		}
+
+		if (bits) {
+			len = strtol(bits, &end, 10);
+			if (end == bits || *end || len < 0 || len > p->bits) {
+				err = -EINVAL;
+				goto err_out_free;
+			}
+			p->bits = len;
+		}
+
+		num++;
+	}
+
+	free(tmp);
+	*netsp = nets;
+	*nump = num;
+	return 0;
+
+err_out_free:
+	free(nets);
+	free(tmp);
+	return err;
+}
+
+int dnet_net_prefix_match(const struct dnet_net_prefix *nets, int num, const struct dnet_addr *addr)
+{
+	const struct dnet_net_prefix *p;
+	const uint8_t *a;
+	int i, bytes, rest;
+
+	for (i = 0; i < num; ++i) {
+		p = &nets[i];
+
+		if (p->family != addr->family)
+			continue;
+
+		if (p->family == AF_INET)
+			a = addr->addr + offsetof(struct sockaddr_in, sin_addr);
+		else
+			a = addr->addr + offsetof(struct sockaddr_in6, sin6_addr);
+
+		bytes = p->bits / 8;
+		rest = p->bits % 8;
+
+		if (memcmp(a, p->addr, bytes))
+			continue;
+		if (rest && ((a[bytes] ^ p->addr[bytes]) & (0xff00 >> rest) & 0xff))
+			continue;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+void dnet_locality_free(struct dnet_locality *localities, int num)
+{
+	int i;
+
+	for (i = 0; i < num; ++i) {
+		free(localities[i].label);
+		free(localities[i].nets);
+	}
+
+	free(localities);
+}
+
+int dnet_locality_parse(const char *localities, struct dnet_locality **localitiesp, int *nump)
+{
+	struct dnet_locality *locs = NULL, *l;
+	char *tmp, *token, *saveptr, *networks;
+	int num = 0, err = 0;
+
+	*localitiesp = NULL;
+	*nump = 0;
+
+	if (!localities || !*localities)
+		return 0;
+
+	tmp = strdup(localities);
+	if (!tmp)
+		return -ENOMEM;
+
+	for (token = strtok_r(tmp, ";", &saveptr); token; token = strtok_r(NULL, ";", &saveptr)) {
+		networks = strchr(token, '=');
+		if (!networks || networks == token) {
+			err = -EINVAL;
+			goto err_out_free;
+		}
+		*networks++ = '\0';
+
+		l = realloc(locs, (num + 1) * sizeof(struct dnet_locality));
+		if (!l) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+		locs = l;
+		l = &locs[num];
+
+		err = dnet_net_prefix_parse(networks, &l->nets, &l->net_num);
+		if (err)
+			goto err_out_free;
+
+		l->label = strdup(token);
+		if (!l->label) {
+			free(l->nets);
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+
+		num++;
+	}
+
+	free(tmp);
+	*localitiesp = locs;
+	*nump = num;
+	return 0;
+
+err_out_free:
+	dnet_locality_free(locs, num);
+	free(tmp);
+	return err;
+}
+
+const char *dnet_locality_match(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	int i;
+
+	for (i = 0; i < n->locality_num; ++i) {
+		if (dnet_net_prefix_match(n->localities[i].nets, n->localities[i].net_num, addr))
+			return n->localities[i].label;
+	}
+
+	return NULL;
+}
+
+/*
+ * Connections to these networks are asked to compress payloads in dnet_auth_send()
+ */
+int dnet_wire_compression_init(struct dnet_node *n, const char *networks)
+{
+	return dnet_net_prefix_parse(networks, &n->wire_compression_nets, &n->wire_compression_net_num);
+}
+
+int dnet_wire_compression_match(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	return dnet_wire_compression_supported() &&
+		dnet_net_prefix_match(n->wire_compression_nets, n->wire_compression_net_num, addr);
+}
+
+int dnet_tls_match(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	return n->tls_ctx && dnet_net_prefix_match(n->tls_nets, n->tls_net_num, addr);
+}
+
+/*
+ * Replaces payload of a single command queued into connection with wire compression by LZ4 block,
+ * see DNET_FLAGS_COMPRESSED. Only request which holds the whole command in memory is compressed,
+ * file and scattered parts are sent as is. Returns 0 and fills @r if payload has been compressed,
+ * original data reference is dropped in this case.
+ */
+static int dnet_io_req_compress(struct dnet_net_state *st, struct dnet_io_req *orig, struct dnet_io_req *r)
+{
+#ifdef HAVE_LZ4
+	struct dnet_cmd *cmd;
+	uint64_t size, wire_size;
+	char *buf, *src, *gathered = NULL;
+	int bound, csize;
+
+	if ((orig->fd >= 0 && orig->fsize) || orig->iovcnt)
+		return 1;
+
+	if (orig->header && orig->hsize >= sizeof(struct dnet_cmd))
+		cmd = orig->header;
+	else if (!orig->hsize && orig->data && orig->dsize >= sizeof(struct dnet_cmd))
+		cmd = orig->data;
+	else
+		return 1;
+
+	size = dnet_bswap64(cmd->size);
+	if (size < st->n->wire_compression_threshold || size > LZ4_MAX_INPUT_SIZE ||
+			(dnet_bswap64(cmd->flags) & DNET_FLAGS_COMPRESSED) ||
+			orig->hsize + orig->dsize != sizeof(struct dnet_cmd) + size)
+		return 1;
+
+	if (cmd == orig->data)
+		src = orig->data + sizeof(struct dnet_cmd);
+	else if (!orig->dsize)
+		src = orig->header + sizeof(struct dnet_cmd);
+	else if (orig->hsize == sizeof(struct dnet_cmd))
+		src = orig->data;
+	else {
+		gathered = malloc(size);
+		if (!gathered)
+			return 1;
+
+		memcpy(gathered, orig->header + sizeof(struct dnet_cmd), orig->hsize - sizeof(struct dnet_cmd));
+		memcpy(gathered + orig->hsize - sizeof(struct dnet_cmd), orig->data, orig->dsize);
+		src = gathered;
+	}
+
+	bound = LZ4_compressBound(size);
+	buf = malloc(sizeof(struct dnet_cmd) + sizeof(uint64_t) + bound);
+	if (!buf) {
+		free(gathered);
+		return 1;
+	}
+
+	csize = LZ4_compress_default(src, buf + sizeof(struct dnet_cmd) + sizeof(uint64_t), size, bound);
+	free(gathered);
+
+	/* the same rule as for cache pages: payload has to shrink by at least 1/8 */
+	wire_size = sizeof(uint64_t) + csize;
+	if (csize <= 0 || wire_size > size - size / 8) {
+		free(buf);
+		return 1;
+	}
+
+	__sync_add_and_fetch(&st->peer_stat.send_compress_orig, size);
+	__sync_add_and_fetch(&st->peer_stat.send_compress_wire, wire_size);
+
+	memcpy(buf, cmd, sizeof(struct dnet_cmd));
+	cmd = (struct dnet_cmd *)buf;
+	cmd->flags = dnet_bswap64(dnet_bswap64(cmd->flags) | DNET_FLAGS_COMPRESSED);
+	cmd->size = dnet_bswap64(wire_size);
+
+	size = dnet_bswap64(size);
+	memcpy(buf + sizeof(struct dnet_cmd), &size, sizeof(uint64_t));
+
+	if (orig->data_release)
+		orig->data_release(orig->data_priv);
+
+	memset(r, 0, sizeof(struct dnet_io_req));
+	r->data = buf;
+	r->dsize = sizeof(struct dnet_cmd) + wire_size;
+	r->data_release = free;
+	r->data_priv = buf;
+	r->fd = -1;
+	return 0;
+#else
+	(void) st;
+	(void) orig;
+	(void) r;
+	return 1;
+#endif
+}
+
 /*
- * Eventually we may end up with proper reference counters here, but for now let's just copy the whole buf.
- * Large data blocks are being sent through sendfile anyway, so it should not be _that_ costly operation.
+ * Header and data are copied into request's buffer unless data is referenced (@data_release is set),
+ * in this case only pointer is queued and reference is dropped when request is destroyed.
+ * Large data blocks are being sent through sendfile anyway, so copying small ones should not be _that_ costly operation.
+ *
+ * Request is pushed into lock-free inbox of the state, @send_lock is taken only by the producer
+ * which finds the queue idle to schedule send event, so a burst of replies costs only one epoll_ctl().
  */
 static int dnet_io_req_queue(struct dnet_net_state *st, struct dnet_io_req *orig)
 {
 	int err = 0;
-	struct dnet_io_req *r;
+	struct dnet_io_req *r, *head, compressed;
+
+	if (st->wire_compression && !dnet_io_req_compress(st, orig, &compressed))
+		orig = &compressed;
 
 	r = dnet_io_req_copy(st, orig);
 	if (!r) {
+		if (orig->data_release)
+			orig->data_release(orig->data_priv);
 		err = -ENOMEM;
 		goto err_out_exit;
 	}
 
-	pthread_mutex_lock(&st->send_lock);
-	list_add_tail(&r->req_entry, &st->send_list);
+	r->queue_time = dnet_monotonic_usecs();
 
-	if (!st->__need_exit)
-		dnet_schedule_send(st);
-	pthread_mutex_unlock(&st->send_lock);
+	if (dnet_memory_enabled(st->n)) {
+		r->memory_charged = r->hsize + r->dsize;
+		r->memory_node = st->n;
+		dnet_memory_charge(st->n, DNET_MEMORY_SEND, r->memory_charged);
+	}
+
+	if (dnet_state_is_local(st)) {
+		/* there is no network thread, replies are consumed from send_list by the caller */
+		dnet_mutex_lock(&st->send_lock);
+		list_add_tail(&r->req_entry, &st->send_list);
+		dnet_mutex_unlock(&st->send_lock);
+		goto err_out_exit;
+	}
+
+	dnet_output_stats_increase(st->n, 1);
+
+	do {
+		head = st->send_inbox;
+		r->send_next = head;
+	} while (!__sync_bool_compare_and_swap(&st->send_inbox, head, r));
+
+	if (!__sync_lock_test_and_set(&st->send_scheduled, 1)) {
+		dnet_mutex_lock(&st->send_lock);
+		if (!st->__need_exit)
+			dnet_schedule_send(st);
+		dnet_mutex_unlock(&st->send_lock);
+	}
 
 err_out_exit:
 	return err;
@@ -246,7 +823,20 @@ void dnet_io_req_free(struct dnet_io_req *r)
 		if (r->on_exit & DNET_IO_REQ_FLAGS_CLOSE)
 			close(r->fd);
 	}
-	free(r);
+
+	if (r->data_release)
+		r->data_release(r->data_priv);
+
+	if (r->recv_st)
+		dnet_recv_budget_release(r);
+
+	if (r->memory_charged)
+		dnet_memory_charge(r->memory_node, DNET_MEMORY_SEND, -(int64_t)r->memory_charged);
+
+	if (r->slab)
+		dnet_slab_free(r);
+	else
+		free(r);
 }
 
 static int dnet_wait(struct dnet_net_state *st, unsigned int events, long timeout)
@@ -300,13 +890,13 @@ out_exit:
 	return err;
 }
 
-ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
+static ssize_t dnet_send_nolock_flags(struct dnet_net_state *st, void *data, uint64_t size, int flags)
 {
 	ssize_t err = 0;
 	struct dnet_node *n = st->n;
 
 	while (size) {
-		err = send(st->write_s, data, size, 0);
+		err = send(st->write_s, data, size, flags);
 		if (err < 0) {
 			err = -errno;
 			if (err != -EAGAIN)
@@ -331,6 +921,11 @@ ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
 	return err;
 }
 
+ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
+{
+	return dnet_send_nolock_flags(st, data, size, 0);
+}
+
 ssize_t dnet_send(struct dnet_net_state *st, void *data, uint64_t size)
 {
 	struct dnet_io_req r;
@@ -357,6 +952,51 @@ ssize_t dnet_send_data(struct dnet_net_state *st, void *header, uint64_t hsize,
 	return dnet_io_req_queue(st, &r);
 }
 
+struct dnet_buffer *dnet_buffer_alloc(size_t size)
+{
+	struct dnet_buffer *b;
+
+	b = malloc(sizeof(struct dnet_buffer) + size);
+	if (!b)
+		return NULL;
+
+	atomic_init(&b->refcnt, 1);
+	b->size = size;
+	return b;
+}
+
+void dnet_buffer_get(void *buffer)
+{
+	struct dnet_buffer *b = buffer;
+
+	atomic_inc(&b->refcnt);
+}
+
+void dnet_buffer_put(void *buffer)
+{
+	struct dnet_buffer *b = buffer;
+
+	if (b && atomic_dec_and_test(&b->refcnt))
+		free(b);
+}
+
+ssize_t dnet_send_data_ref(struct dnet_net_state *st, void *header, uint64_t hsize, void *data, uint64_t dsize,
+		void (*release)(void *priv), void *priv)
+{
+	struct dnet_io_req r;
+
+	memset(&r, 0, sizeof(r));
+	r.header = header;
+	r.hsize = hsize;
+	r.data = data;
+	r.dsize = dsize;
+	r.fd = -1;
+	r.data_release = release;
+	r.data_priv = priv;
+
+	return dnet_io_req_queue(st, &r);
+}
+
 static ssize_t dnet_send_fd_nolock(struct dnet_net_state *st, int fd, uint64_t offset, uint64_t dsize)
 {
 	ssize_t err;
@@ -396,20 +1036,328 @@ ssize_t dnet_send_fd(struct dnet_net_state *st, void *header, uint64_t hsize,
 	return dnet_io_req_queue(st, &r);
 }
 
-void dnet_trans_update_timestamp(struct dnet_trans *t)
+int dnet_send_fd_verified(struct dnet_net_state *st, void *header, uint64_t hsize,
+		int fd, uint64_t offset, uint64_t fsize, int on_exit, uint64_t chunk_size,
+		int (*verify)(void *priv, uint64_t chunk_offset, uint64_t chunk_size), void *priv)
 {
-	gettimeofday(&t->time, NULL);
+	struct dnet_io_req **pieces, r;
+	uint64_t pos, size;
+	int i, num, err = 0;
+
+	if (!chunk_size || fsize <= chunk_size) {
+		err = verify(priv, 0, fsize);
+		if (err)
+			return err;
+
+		return dnet_send_fd(st, header, hsize, fd, offset, fsize, on_exit);
+	}
+
+	num = (fsize + chunk_size - 1) / chunk_size;
+	pieces = calloc(num, sizeof(struct dnet_io_req *));
+	if (!pieces)
+		return -ENOMEM;
+
+	for (i = 0; i < num; ++i) {
+		pos = i * chunk_size;
+		size = fsize - pos;
+		if (size > chunk_size)
+			size = chunk_size;
+
+		memset(&r, 0, sizeof(r));
+		if (i == 0) {
+			r.header = header;
+			r.hsize = hsize;
+		}
+		r.fd = fd;
+		/* fd must be closed only after the last piece has been sent */
+		r.on_exit = (i == num - 1) ? on_exit : (on_exit & ~DNET_IO_REQ_FLAGS_CLOSE);
+		r.local_offset = offset + pos;
+		r.fsize = size;
+
+		pieces[i] = dnet_io_req_copy(st, &r);
+		if (!pieces[i]) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+		pieces[i]->held = 1;
+		pieces[i]->continuation = i != 0;
+	}
+
+	/*
+	 * All pieces are queued at once, so that no other reply can be put between them.
+	 * State reference guarantees that held pieces are not freed while we are working with them,
+	 * they are removed only by network thread after being sent or when state is destroyed.
+	 */
+	dnet_state_get(st);
+
+	dnet_mutex_lock(&st->send_lock);
+	dnet_send_inbox_drain_nolock(st);
+	for (i = 0; i < num; ++i)
+		dnet_send_list_add_nolock(st, pieces[i]);
+	dnet_mutex_unlock(&st->send_lock);
+
+	for (i = 0; i < num; ++i) {
+		pos = i * chunk_size;
+
+		err = verify(priv, pos, pieces[i]->fsize);
+		if (err)
+			break;
+
+		dnet_output_stats_increase(st->n, 1);
+
+		dnet_mutex_lock(&st->send_lock);
+		pieces[i]->held = 0;
+		dnet_schedule_send_once_nolock(st);
+		dnet_mutex_unlock(&st->send_lock);
+	}
+
+	if (err && i == 0) {
+		/* nothing has been sent, drop the reply and return error as usual */
+		dnet_mutex_lock(&st->send_lock);
+		for (i = 0; i < num; ++i)
+			list_del(&pieces[i]->req_entry);
+		dnet_mutex_unlock(&st->send_lock);
+
+		dnet_state_put(st);
+		goto err_out_free;
+	}
+
+	if (err) {
+		/* reply header and part of the data are already on the wire, the only way to signal error is to drop connection */
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: verification of %" PRIu64 " bytes at %" PRIu64 " failed, "
+				"resetting state: %s [%d]", dnet_state_dump_addr(st), pieces[i]->fsize,
+				(uint64_t)i * chunk_size, strerror(-err), err);
+
+		dnet_state_reset(st, err);
+
+		dnet_mutex_lock(&st->send_lock);
+		dnet_unschedule_all(st);
+		dnet_mutex_unlock(&st->send_lock);
+	}
+
+	dnet_state_put(st);
+	free(pieces);
+	return err;
+
+err_out_free:
+	for (i = 0; i < num; ++i) {
+		if (pieces[i]) {
+			/* caller owns @fd if reply has not been queued */
+			pieces[i]->on_exit = 0;
+			dnet_io_req_free(pieces[i]);
+		}
+	}
+	free(pieces);
+	return err;
+}
+
+struct dnet_send_pieces {
+	struct dnet_net_state		*st;
+	struct dnet_io_req		**pieces;
+	int				num;
+	/* number of pieces released to the network, protected by state's send lock */
+	int				released;
+};
+
+struct dnet_send_pieces *dnet_send_pieces_queue(struct dnet_net_state *st, void *header, uint64_t hsize,
+		uint64_t size, uint64_t piece_size, int *errp)
+{
+	if (!piece_size) {
+		*errp = -EINVAL;
+		return NULL;
+	}
+
+	return dnet_send_pieces_queue_num(st, header, hsize, size ? (size + piece_size - 1) / piece_size : 1, errp);
+}
+
+struct dnet_send_pieces *dnet_send_pieces_queue_num(struct dnet_net_state *st, void *header, uint64_t hsize,
+		int num, int *errp)
+{
+	struct dnet_send_pieces *p;
+	struct dnet_io_req r;
+	int i, err;
+
+	if (num <= 0) {
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	p = calloc(1, sizeof(struct dnet_send_pieces));
+	if (!p) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	p->num = num;
+	p->pieces = calloc(p->num, sizeof(struct dnet_io_req *));
+	if (!p->pieces) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.fd = -1;
+
+	for (i = 0; i < p->num; ++i) {
+		r.header = i ? NULL : header;
+		r.hsize = i ? 0 : hsize;
+
+		p->pieces[i] = dnet_io_req_copy(st, &r);
+		if (!p->pieces[i]) {
+			err = -ENOMEM;
+			goto err_out_free_pieces;
+		}
+		p->pieces[i]->held = 1;
+		p->pieces[i]->continuation = i != 0;
+	}
+
+	/* pieces are queued and released the same way dnet_send_fd_verified() does */
+	p->st = dnet_state_get(st);
+
+	dnet_mutex_lock(&st->send_lock);
+	dnet_send_inbox_drain_nolock(st);
+	for (i = 0; i < p->num; ++i)
+		dnet_send_list_add_nolock(st, p->pieces[i]);
+	dnet_mutex_unlock(&st->send_lock);
+
+	return p;
+
+err_out_free_pieces:
+	for (i = 0; i < p->num; ++i) {
+		if (p->pieces[i])
+			dnet_io_req_free(p->pieces[i]);
+	}
+	free(p->pieces);
+err_out_free:
+	free(p);
+err_out_exit:
+	*errp = err;
+	return NULL;
+}
+
+void dnet_send_pieces_release(struct dnet_send_pieces *p, int index, void *data, uint64_t size,
+		void (*release)(void *release_priv), void *release_priv)
+{
+	struct dnet_net_state *st = p->st;
+	struct dnet_io_req *r = p->pieces[index];
+
+	/* network thread does not touch held piece, so it can be filled without the lock */
+	r->data = data;
+	r->dsize = size;
+	r->data_release = release;
+	r->data_priv = release_priv;
+
+	dnet_output_stats_increase(st->n, 1);
+
+	dnet_mutex_lock(&st->send_lock);
+	r->held = 0;
+	p->released++;
+	dnet_schedule_send_once_nolock(st);
+	dnet_mutex_unlock(&st->send_lock);
+}
+
+int dnet_send_pieces_complete(struct dnet_send_pieces *p, int err)
+{
+	struct dnet_net_state *st = p->st;
+	int i;
+
+	if (err && !p->released) {
+		dnet_mutex_lock(&st->send_lock);
+		for (i = 0; i < p->num; ++i)
+			list_del(&p->pieces[i]->req_entry);
+		dnet_mutex_unlock(&st->send_lock);
+
+		for (i = 0; i < p->num; ++i)
+			dnet_io_req_free(p->pieces[i]);
+	} else if (err || p->released != p->num) {
+		if (!err)
+			err = -EINVAL;
+
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: could not fill reply, %d of %d pieces have been sent, "
+				"resetting state: %s [%d]", dnet_state_dump_addr(st), p->released, p->num,
+				strerror(-err), err);
+
+		dnet_state_reset(st, err);
+
+		dnet_mutex_lock(&st->send_lock);
+		dnet_unschedule_all(st);
+		dnet_mutex_unlock(&st->send_lock);
+	}
+
+	dnet_state_put(st);
+	free(p->pieces);
+	free(p);
+	return err;
+}
+
+int dnet_send_data_pieces(struct dnet_net_state *st, void *header, uint64_t hsize, uint64_t size, uint64_t piece_size,
+		int (*fill)(void *priv, uint64_t piece_offset, uint64_t piece_size,
+			void **data, void (**release)(void *release_priv), void **release_priv), void *priv)
+{
+	struct dnet_send_pieces *p;
+	void (*release)(void *release_priv);
+	void *release_priv;
+	void *data;
+	int i, err = 0;
+
+	p = dnet_send_pieces_queue(st, header, hsize, size, piece_size, &err);
+	if (!p)
+		return err;
+
+	/* empty reply consists of header only */
+	if (!size) {
+		dnet_send_pieces_release(p, 0, NULL, 0, NULL, NULL);
+		return dnet_send_pieces_complete(p, 0);
+	}
+
+	for (i = 0; i < p->num; ++i) {
+		uint64_t pos = (uint64_t)i * piece_size;
+		uint64_t psize = size - pos < piece_size ? size - pos : piece_size;
+
+		err = fill(priv, pos, psize, &data, &release, &release_priv);
+		if (err)
+			break;
+
+		dnet_send_pieces_release(p, i, data, psize, release, release_priv);
+	}
+
+	return dnet_send_pieces_complete(p, err);
+}
+
+void dnet_trans_update_timestamp(struct dnet_trans *t)
+{
+	gettimeofday(&t->time, NULL);
 
 	t->time.tv_sec += t->wait_ts.tv_sec;
 	t->time.tv_usec += t->wait_ts.tv_nsec / 1000;
+	if (t->time.tv_usec >= 1000000) {
+		t->time.tv_sec++;
+		t->time.tv_usec -= 1000000;
+	}
 }
 
 int dnet_trans_send(struct dnet_trans *t, struct dnet_io_req *req)
 {
 	struct dnet_net_state *st = req->st;
+	struct dnet_net_state *lane;
 	struct dnet_test_settings test_settings;
 	int err;
 
+	lane = dnet_state_lane(st, t, req);
+	if (lane) {
+		/* transaction and its reply live in lane, route table state is kept for backend statistics */
+		if (t->st == st) {
+			t->owner = t->st;
+			t->st = lane;
+		} else {
+			t->owner = dnet_state_get(st);
+			dnet_state_put(t->st);
+			t->st = lane;
+		}
+
+		req->st = st = lane;
+	}
+
 	dnet_trans_get(t);
 
 	pthread_mutex_lock(&st->trans_lock);
@@ -420,12 +1368,13 @@ int dnet_trans_send(struct dnet_trans *t, struct dnet_io_req *req)
 	}
 	pthread_mutex_unlock(&st->trans_lock);
 	if (err)
-		goto err_out_put;
+		goto err_out_release;
 
 	if (t->n->test_settings && !dnet_node_get_test_settings(t->n, &test_settings) &&
 	    test_settings.commands_mask & (1 << t->command))
-		goto err_out_put;
+		goto err_out_release;
 
+	/* queue drops referenced data itself if it fails */
 	err = dnet_io_req_queue(st, req);
 	if (err)
 		goto err_out_remove;
@@ -435,6 +1384,10 @@ int dnet_trans_send(struct dnet_trans *t, struct dnet_io_req *req)
 
 err_out_remove:
 	dnet_trans_remove(t);
+	goto err_out_put;
+err_out_release:
+	if (req->data_release)
+		req->data_release(req->data_priv);
 err_out_put:
 	dnet_trans_put(t);
 	return err;
@@ -477,7 +1430,7 @@ int dnet_recv(struct dnet_net_state *st, void *data, unsigned int size)
 	return 0;
 }
 
-int dnet_add_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr, unsigned int join_state)
+int dnet_add_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr, unsigned int join_state, double route_share)
 {
 	struct dnet_addr_storage *a, *it;
 	int err = 0;
@@ -498,10 +1451,18 @@ int dnet_add_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr,
 
 	memcpy(&a->addr, addr, sizeof(struct dnet_addr));
 	a->__join_state = join_state;
+	a->route_share = route_share;
+	a->reconnect_time_max = (n->check_timeout ? n->check_timeout : 10) * DNET_RECONNECT_BACKOFF_MAX;
+	/* the first attempt is spread over the check period */
+	a->next_attempt = dnet_monotonic_usecs() / 1000000 + 1 + rand() % (n->check_timeout ? n->check_timeout : 10);
 
 	pthread_mutex_lock(&n->reconnect_lock);
 	list_for_each_entry(it, &n->reconnect_list, reconnect_entry) {
 		if (!memcmp(&it->addr, &a->addr, sizeof(struct dnet_addr))) {
+			/* address keeps its backoff, but its priority is not lowered by failed reconnects */
+			if (it->route_share < route_share)
+				it->route_share = route_share;
+
 			dnet_log(n, DNET_LOG_INFO, "Address already exists in reconnection array: addr: %s, join state: 0x%x.",
 				dnet_addr_string(&a->addr), join_state);
 			err = -EEXIST;
@@ -524,6 +1485,40 @@ out_exit:
 	return err;
 }
 
+void dnet_remove_reconnect_state(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct dnet_addr_storage *it, *tmp;
+
+	pthread_mutex_lock(&n->reconnect_lock);
+	list_for_each_entry_safe(it, tmp, &n->reconnect_list, reconnect_entry) {
+		if (!memcmp(&it->addr, addr, sizeof(struct dnet_addr))) {
+			list_del(&it->reconnect_entry);
+			n->reconnect_num--;
+			free(it);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&n->reconnect_lock);
+}
+
+double dnet_state_route_share(struct dnet_net_state *st)
+{
+	struct dnet_idc *idc;
+	struct rb_node *it;
+	double share = 0;
+
+	pthread_rwlock_rdlock(&st->idc_lock);
+	for (it = rb_first(&st->idc_root); it; it = rb_next(it)) {
+		idc = rb_entry(it, struct dnet_idc, state_entry);
+
+		if (idc->group && idc->group->id_num > 0)
+			share += (double)idc->id_num / idc->group->id_num;
+	}
+	pthread_rwlock_unlock(&st->idc_lock);
+
+	return share;
+}
+
 static int dnet_trans_complete_forward(struct dnet_addr *addr __unused, struct dnet_cmd *cmd, void *priv)
 {
 	struct dnet_trans *t = priv;
@@ -640,6 +1635,117 @@ static int dnet_process_control(struct dnet_net_state *st, struct dnet_cmd *cmd,
 	}
 }
 
+/*
+ * Unpacks DNET_FLAGS_BATCH reply and passes every packed reply to transaction's completion callback
+ */
+static void dnet_trans_complete_batch(struct dnet_trans *t, struct dnet_cmd *cmd)
+{
+	char *data = (char *)(cmd + 1);
+	uint64_t offset = 0;
+	int num = 0;
+
+	while (offset + sizeof(struct dnet_cmd) <= cmd->size) {
+		struct dnet_cmd *c = (struct dnet_cmd *)(data + offset);
+
+		dnet_convert_cmd(c);
+
+		if (offset + sizeof(struct dnet_cmd) + c->size > cmd->size) {
+			dnet_log(t->n, DNET_LOG_ERROR, "%s: %s: trans: %llu: corrupted batch reply: "
+					"offset: %llu, packed-size: %llu, size: %llu",
+					dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd),
+					(unsigned long long)cmd->trans, (unsigned long long)offset,
+					(unsigned long long)c->size, (unsigned long long)cmd->size);
+			break;
+		}
+
+		/* batch never finishes transaction, the last reply comes separately */
+		c->flags |= DNET_FLAGS_MORE;
+		t->complete(dnet_state_addr(t->st), c, t->priv);
+
+		offset += sizeof(struct dnet_cmd) + c->size;
+		++num;
+	}
+
+	dnet_log(t->n, DNET_LOG_DEBUG, "%s: %s: trans: %llu: unpacked batch of %d replies",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans, num);
+}
+
+/*
+ * Unpacks DNET_FLAGS_COMPACT iterator reply into ordinary iterator responses
+ */
+static void dnet_trans_complete_compact(struct dnet_trans *t, struct dnet_cmd *cmd)
+{
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_response	re;
+	} __attribute__ ((packed)) reply;
+	struct dnet_iterator_compact_header h;
+	const unsigned char *p = (const unsigned char *)(cmd + 1);
+	const unsigned char *end = p + cmd->size;
+	struct dnet_raw_id key;
+	uint64_t fields[5];
+	unsigned int prefix, j;
+	uint32_t i;
+
+	if (cmd->size < sizeof(struct dnet_iterator_compact_header))
+		goto err_out_corrupted;
+
+	memcpy(&h, p, sizeof(struct dnet_iterator_compact_header));
+	dnet_convert_iterator_compact_header(&h);
+	p += sizeof(struct dnet_iterator_compact_header);
+
+	memset(&key, 0, sizeof(struct dnet_raw_id));
+
+	for (i = 0; i < h.num; ++i) {
+		struct dnet_iterator_response *re = &reply.re;
+
+		if (p >= end)
+			goto err_out_corrupted;
+
+		prefix = *p++;
+		if (prefix > DNET_ID_SIZE || (size_t)(end - p) < DNET_ID_SIZE - prefix)
+			goto err_out_corrupted;
+
+		memcpy(key.id + prefix, p, DNET_ID_SIZE - prefix);
+		p += DNET_ID_SIZE - prefix;
+
+		for (j = 0; j < ARRAY_SIZE(fields); ++j) {
+			if (dnet_varint_get(&p, end, &fields[j]))
+				goto err_out_corrupted;
+		}
+
+		memset(re, 0, sizeof(struct dnet_iterator_response));
+		re->id = h.id;
+		re->key = key;
+		re->flags = fields[0];
+		re->user_flags = fields[1];
+		re->timestamp.tsec = fields[2];
+		re->timestamp.tnsec = fields[3];
+		re->size = fields[4];
+		re->iterated_keys = h.iterated_keys;
+		re->total_keys = h.total_keys;
+
+		/* responses are passed in network byte order like uncompressed ones */
+		dnet_convert_iterator_response(re);
+
+		reply.cmd = *cmd;
+		reply.cmd.size = sizeof(struct dnet_iterator_response);
+		reply.cmd.flags = (cmd->flags & ~DNET_FLAGS_COMPACT) | DNET_FLAGS_MORE;
+
+		t->complete(dnet_state_addr(t->st), &reply.cmd, t->priv);
+	}
+
+	dnet_log(t->n, DNET_LOG_DEBUG, "%s: %s: trans: %llu: unpacked compact reply of %u responses, size: %llu",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
+			h.num, (unsigned long long)cmd->size);
+	return;
+
+err_out_corrupted:
+	dnet_log(t->n, DNET_LOG_ERROR, "%s: %s: trans: %llu: corrupted compact reply: record: %u, size: %llu",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
+			i, (unsigned long long)cmd->size);
+}
+
 int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_io_req *r)
 {
 	int err = 0;
@@ -665,13 +1771,13 @@ int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st
 			 * Remove transaction for the duration of callback processing,
 			 * otherwise timeout checking thread can catch up.
 			 *
-			 * Network thread also removes transaction from the tree, but network
+			 * Network thread also removes transaction from the timer wheel, but network
 			 * thread can read multiple replies and put multiple packets into the IO queue,
-			 * which if processed here. Since code below inserts transaction into the timer tree
+			 * which if processed here. Since code below inserts transaction into the timer wheel
 			 * again after its callback has been completed, someone has to remove it.
 			 *
-			 * It is safe to remove transaction multiple times, but subsequent insertion will lead to crash,
-			 * if timestamp has been updated, since it is used as a key in the timer tree.
+			 * It is safe to remove transaction multiple times, insertion of already scheduled
+			 * transaction is refused.
 			 */
 			dnet_trans_remove_timer_nolock(st, t);
 		}
@@ -691,156 +1797,605 @@ int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st
 						(t->alloc_size >= sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr))) {
 					struct dnet_io_attr *recv_io = (struct dnet_io_attr *)(cmd + 1);
 
-					struct dnet_cmd *local_cmd = (struct dnet_cmd *)(t + 1);
-					struct dnet_io_attr *local_io = (struct dnet_io_attr *)(local_cmd + 1);
+					struct dnet_cmd *local_cmd = (struct dnet_cmd *)(t + 1);
+					struct dnet_io_attr *local_io = (struct dnet_io_attr *)(local_cmd + 1);
+
+					ioflags = local_io->flags = recv_io->flags;
+					local_io->size = recv_io->size;
+					local_io->offset = recv_io->offset;
+					local_io->user_flags = recv_io->user_flags;
+					local_io->total_size = recv_io->total_size;
+					local_io->timestamp = recv_io->timestamp;
+
+					dnet_convert_io_attr(local_io);
+				}
+
+				if (st && !(flags & DNET_FLAGS_MORE)) {
+					struct timeval tv;
+					long diff;
+
+					gettimeofday(&tv, NULL);
+					diff = (tv.tv_sec - t->start.tv_sec) * 1000000 + (tv.tv_usec - t->start.tv_usec);
+
+					struct dnet_net_state *owner = t->owner ? t->owner : st;
+
+					dnet_update_backend_weight(owner, cmd, ioflags, diff);
+					dnet_update_backend_latency(owner, cmd->backend_id, diff);
+				}
+			}
+			if (st && !(flags & DNET_FLAGS_MORE))
+				dnet_update_backend_health(t->owner ? t->owner : st, cmd->backend_id, cmd->status);
+			if (flags & DNET_FLAGS_BATCH)
+				dnet_trans_complete_batch(t, cmd);
+			else if (flags & DNET_FLAGS_COMPACT)
+				dnet_trans_complete_compact(t, cmd);
+			else
+				t->complete(dnet_state_addr(t->st), cmd, t->priv);
+		}
+
+		dnet_trans_put(t);
+		if (!(flags & DNET_FLAGS_MORE)) {
+			memcpy(&t->cmd, cmd, sizeof(struct dnet_cmd));
+			dnet_trans_put(t);
+		} else {
+			/*
+			 * Put transaction back into the timer wheel with updated timestamp.
+			 * Transaction had been removed from timer wheel in @dnet_update_trans_timestamp_network() in network
+			 * thread right after whole data was read.
+			 */
+
+			pthread_mutex_lock(&st->trans_lock);
+			dnet_trans_update_timestamp(t);
+			dnet_trans_insert_timer_nolock(st, t);
+			pthread_mutex_unlock(&st->trans_lock);
+		}
+
+		goto out;
+	}
+
+	err = dnet_process_control(st, cmd, r->data);
+	if (err != -ENOTSUP) {
+		goto out;
+	}
+
+	if (!(cmd->flags & DNET_FLAGS_DIRECT)) {
+		forward_state = dnet_state_get_first(n, &cmd->id);
+	}
+
+	if (!forward_state || forward_state == st || forward_state == n->st) {
+		dnet_state_put(forward_state);
+
+		HANDY_COUNTER_INCREMENT("io.cmds", 1);
+
+		if (backend) {
+			/* waits here while backend is being reloaded */
+			err = dnet_backend_gate_enter(&backend->gate);
+			if (err) {
+				dnet_send_ack(st, cmd, err, 0);
+				goto out;
+			}
+		}
+
+		err = dnet_process_cmd_raw(backend, st, cmd, r->data, 0);
+
+		if (backend)
+			dnet_backend_gate_leave(&backend->gate);
+	} else {
+		if (!forward_state) {
+			err = -ENXIO;
+			goto err_out_put_forward;
+		}
+
+		HANDY_COUNTER_INCREMENT("io.forwards", 1);
+		err = dnet_trans_forward(r, st, forward_state);
+		if (err)
+			goto err_out_put_forward;
+
+		dnet_state_put(forward_state);
+	}
+
+out:
+	return err;
+
+err_out_put_forward:
+	dnet_state_put(forward_state);
+err_out_exit:
+	return err;
+}
+
+void dnet_state_remove_nolock(struct dnet_net_state *st)
+{
+	list_del_init(&st->node_entry);
+	list_del_init(&st->storage_state_entry);
+	dnet_idc_destroy_nolock(st);
+}
+
+static void dnet_state_remove(struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+
+	dnet_mutex_lock(&n->state_lock);
+	dnet_state_remove_nolock(st);
+	dnet_mutex_unlock(&n->state_lock);
+}
+
+static void dnet_state_remove_and_shutdown(struct dnet_net_state *st, int error)
+{
+	int level = DNET_LOG_NOTICE;
+
+	if (error && (error != -EUCLEAN && error != -EEXIST))
+		level = DNET_LOG_ERROR;
+
+	dnet_log(st->n, level, "%s: resetting state: %p: %s [%d], sockets: %d/%d",
+			dnet_state_dump_addr(st), st, strerror(-error), error,
+			st->read_s, st->write_s);
+
+	dnet_mutex_lock(&st->send_lock);
+
+	dnet_state_remove_nolock(st);
+
+	if (!st->__need_exit) {
+		if (!error)
+			error = -123;
+
+		st->__need_exit = error;
+
+		shutdown(st->read_s, SHUT_RDWR);
+		shutdown(st->write_s, SHUT_RDWR);
+
+		//Wakes up sleeping threads and makes them exit because state is removed
+		if ((atomic_read(&st->send_queue_size) > 0))
+			pthread_cond_broadcast(&st->send_wait);
+	}
+
+	dnet_mutex_unlock(&st->send_lock);
+}
+
+int dnet_state_reset_nolock_noclean(struct dnet_net_state *st, int error, struct list_head *head)
+{
+	dnet_state_remove_and_shutdown(st, error);
+
+	return dnet_trans_iterate_move_transaction(st, head);
+}
+
+static void dnet_state_drop_lanes(struct dnet_net_state *st, int error)
+{
+	struct dnet_net_state **lanes;
+	int i, num;
+
+	pthread_mutex_lock(&st->trans_lock);
+	lanes = st->lanes;
+	num = st->lane_num;
+	st->lanes = NULL;
+	st->lane_num = 0;
+	pthread_mutex_unlock(&st->trans_lock);
+
+	for (i = 0; i < num; ++i) {
+		dnet_state_reset(lanes[i], error);
+		dnet_state_put(lanes[i]);
+	}
+
+	free(lanes);
+}
+
+void dnet_state_reset(struct dnet_net_state *st, int error)
+{
+	LIST_HEAD(head);
+
+	/*
+	 * Prevent route table access and update, check given state, move and then drop all its transactions
+	 */
+	dnet_mutex_lock(&st->n->state_lock);
+	dnet_state_reset_nolock_noclean(st, error, &head);
+	dnet_mutex_unlock(&st->n->state_lock);
+
+	dnet_trans_clean_list(&head, error);
+
+	dnet_state_drop_lanes(st, error);
+}
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define DNET_HAVE_ZEROCOPY 1
+#endif
+
+static void dnet_state_zerocopy_init(struct dnet_net_state *st)
+{
+#ifdef DNET_HAVE_ZEROCOPY
+	int opt = 1;
+
+	/* unix sockets and old kernels do not support it, such connection just copies */
+	if (setsockopt(st->write_s, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt))) {
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: zero-copy sends are not supported: %s [%d]",
+				dnet_addr_string(&st->addr), strerror(errno), -errno);
+		return;
+	}
+
+	st->zerocopy = 1;
+#else
+	(void) st;
+#endif
+}
+
+int dnet_state_zerocopy_complete(struct dnet_net_state *st)
+{
+#ifdef DNET_HAVE_ZEROCOPY
+	struct dnet_io_req *r, *tmp;
+	struct sock_extended_err *ee;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[128];
+	socklen_t slen;
+	int status, err;
+
+	while (1) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		err = recvmsg(st->write_s, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			return -errno;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			ee = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				if (ee->ee_errno)
+					return -ee->ee_errno;
+				continue;
+			}
+
+			/* notification covers calls [@ee_info, @ee_data], TCP completes them in order */
+			if ((int32_t)(ee->ee_data + 1 - st->zerocopy_done) > 0)
+				st->zerocopy_done = ee->ee_data + 1;
+		}
+	}
+
+	list_for_each_entry_safe(r, tmp, &st->zerocopy_list, req_entry) {
+		if ((int32_t)(r->zerocopy_seq - st->zerocopy_done) > 0)
+			break;
+
+		list_del(&r->req_entry);
+		dnet_io_req_free(r);
+	}
+
+	slen = sizeof(status);
+	if (!getsockopt(st->write_s, SOL_SOCKET, SO_ERROR, &status, &slen) && status)
+		return -status;
+#else
+	(void) st;
+#endif
+	return 0;
+}
+
+static int dnet_local_socket_path(struct dnet_node *n, const struct dnet_addr *addr, struct sockaddr_un *sun)
+{
+	char addr_str[128];
+	int len;
+
+	memset(sun, 0, sizeof(struct sockaddr_un));
+	sun->sun_family = AF_UNIX;
+
+	len = snprintf(sun->sun_path, sizeof(sun->sun_path), "%s/%s", n->local_socket_dir,
+			dnet_addr_string_raw(addr, addr_str, sizeof(addr_str)));
+	if (len < 0 || len >= (int)sizeof(sun->sun_path))
+		return -ENAMETOOLONG;
+
+	return 0;
+}
+
+int dnet_local_socket_listen(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct sockaddr_un sun;
+	int s, err;
+
+	err = dnet_local_socket_path(n, addr, &sun);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: local socket path in '%s' is too long",
+				dnet_addr_string(addr), n->local_socket_dir);
+		return err;
+	}
+
+	s = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (s < 0) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to create local socket", sun.sun_path);
+		return err;
+	}
+
+	/* socket left by previous instance of the server */
+	unlink(sun.sun_path);
+
+	err = bind(s, (struct sockaddr *)&sun, sizeof(sun));
+	if (err) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to bind local socket", sun.sun_path);
+		goto err_out_close;
+	}
+
+	err = listen(s, 10240);
+	if (err) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to listen local socket", sun.sun_path);
+		goto err_out_unlink;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "Server is now listening at %s for %s.", sun.sun_path, dnet_addr_string(addr));
+	return s;
+
+err_out_unlink:
+	unlink(sun.sun_path);
+err_out_close:
+	close(s);
+	return err;
+}
+
+void dnet_local_socket_unlink(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct sockaddr_un sun;
+
+	if (!dnet_local_socket_path(n, addr, &sun))
+		unlink(sun.sun_path);
+}
+
+int dnet_local_socket_connect(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct sockaddr_un sun;
+	struct stat st;
+	int s, err;
+
+	/* server peers always talk over TCP, their accepted states must know real addresses */
+	if (!n->local_socket_dir || (n->flags & DNET_CFG_JOIN_NETWORK))
+		return -ENOENT;
+
+	err = dnet_local_socket_path(n, addr, &sun);
+	if (err)
+		return err;
+
+	if (stat(sun.sun_path, &st) || !S_ISSOCK(st.st_mode))
+		return -ENOENT;
+
+	s = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (s < 0)
+		return -errno;
+
+	/* unix socket is connected at once or fails at once, for example if it is left by stopped server */
+	err = connect(s, (struct sockaddr *)&sun, sizeof(sun));
+	if (err) {
+		err = -errno;
+		dnet_log(n, DNET_LOG_NOTICE, "%s: failed to connect local socket %s, falling back to TCP: %s [%d]",
+				dnet_addr_string(addr), sun.sun_path, strerror(-err), err);
+		close(s);
+		return err;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "%s: connected via local socket %s", dnet_addr_string(addr), sun.sun_path);
+	return s;
+}
 
-					ioflags = local_io->flags = recv_io->flags;
-					local_io->size = recv_io->size;
-					local_io->offset = recv_io->offset;
-					local_io->user_flags = recv_io->user_flags;
-					local_io->total_size = recv_io->total_size;
-					local_io->timestamp = recv_io->timestamp;
+static int dnet_lane_socket(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct dnet_addr sa_addr = *addr;
+	struct sockaddr *sa = (struct sockaddr *)&sa_addr;
+	int s, err;
 
-					dnet_convert_io_attr(local_io);
-				}
+	s = dnet_local_socket_connect(n, addr);
+	if (s >= 0)
+		return s;
 
-				if (st && !(flags & DNET_FLAGS_MORE)) {
-					struct timeval tv;
-					long diff;
+	sa->sa_family = addr->family;
 
-					gettimeofday(&tv, NULL);
-					diff = (tv.tv_sec - t->start.tv_sec) * 1000000 + (tv.tv_usec - t->start.tv_usec);
+	s = socket(sa->sa_family, SOCK_STREAM, IPPROTO_TCP);
+	if (s < 0) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to create lane socket", dnet_addr_string(addr));
+		return err;
+	}
 
-					dnet_update_backend_weight(st, cmd, ioflags, diff);
-				}
-			}
-			t->complete(dnet_state_addr(t->st), cmd, t->priv);
+	fcntl(s, F_SETFL, O_NONBLOCK);
+	fcntl(s, F_SETFD, FD_CLOEXEC);
+
+	/* connection is completed in background, requests are sent when socket becomes writable */
+	err = connect(s, sa, addr->addr_len);
+	if (err < 0 && errno != EINPROGRESS) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to connect lane socket", dnet_addr_string(addr));
+		close(s);
+		return err;
+	}
+
+	if (dnet_tls_match(n, addr)) {
+		err = dnet_tls_handshake_wait(n->tls_ctx, s, 0, DNET_TLS_HANDSHAKE_TIMEOUT_MS);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: TLS handshake of lane socket failed: %s: %s [%d]",
+					dnet_addr_string(addr), dnet_tls_error(), strerror(-err), err);
+			close(s);
+			return err;
 		}
+	}
 
-		dnet_trans_put(t);
-		if (!(flags & DNET_FLAGS_MORE)) {
-			memcpy(&t->cmd, cmd, sizeof(struct dnet_cmd));
-			dnet_trans_put(t);
-		} else {
-			/*
-			 * Put transaction back into the end of 'timer' tree with updated timestamp.
-			 * Transaction had been removed from timer tree in @dnet_update_trans_timestamp_network() in network
-			 * thread right after whole data was read.
-			 */
+	return s;
+}
 
-			pthread_mutex_lock(&st->trans_lock);
-			dnet_trans_update_timestamp(t);
-			dnet_trans_insert_timer_nolock(st, t);
-			pthread_mutex_unlock(&st->trans_lock);
+int dnet_state_add_lanes(struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_net_state **lanes, *lane;
+	int i, num = n->net_lanes - 1, added = 0, s, err = 0;
+
+	if (num <= 0)
+		return 0;
+
+	lanes = calloc(num, sizeof(struct dnet_net_state *));
+	if (!lanes)
+		return -ENOMEM;
+
+	for (i = 0; i < num; ++i) {
+		s = dnet_lane_socket(n, &st->addr);
+		if (s < 0) {
+			err = s;
+			break;
 		}
 
-		goto out;
-	}
+		/* lane is not a route table state, remote node sees it as one more client connection */
+		lane = dnet_state_create(n, NULL, 0, &st->addr, s, &err, 0, 0, st->idx, 0, NULL, 0);
+		if (!lane)
+			break;
 
-	err = dnet_process_control(st, cmd, r->data);
-	if (err != -ENOTSUP) {
-		goto out;
+		/*
+		 * Lane talks to the same peer, so it inherits what was negotiated with it.
+		 * Short headers are not inherited, they are framing of the particular connection
+		 * and remote node has not switched lane's socket to them.
+		 */
+		memcpy(lane->version, st->version, sizeof(lane->version));
+		lane->wire_compression = st->wire_compression;
+
+		lanes[added++] = lane;
 	}
 
-	if (!(cmd->flags & DNET_FLAGS_DIRECT)) {
-		forward_state = dnet_state_get_first(n, &cmd->id);
+	pthread_mutex_lock(&st->trans_lock);
+	if (!st->__need_exit && added) {
+		st->lanes = lanes;
+		st->lane_num = added;
+		lanes = NULL;
 	}
+	pthread_mutex_unlock(&st->trans_lock);
 
-	if (!forward_state || forward_state == st || forward_state == n->st) {
-		dnet_state_put(forward_state);
+	dnet_log(n, err ? DNET_LOG_ERROR : DNET_LOG_INFO, "%s: opened %d/%d additional connections: %d",
+			dnet_state_dump_addr(st), added, num, err);
 
-		HANDY_COUNTER_INCREMENT("io.cmds", 1);
-		err = dnet_process_cmd_raw(backend, st, cmd, r->data, 0);
-	} else {
-		if (!forward_state) {
-			err = -ENXIO;
-			goto err_out_put_forward;
+	if (lanes) {
+		for (i = 0; i < added; ++i) {
+			dnet_state_reset(lanes[i], -ECONNRESET);
+			dnet_state_put(lanes[i]);
 		}
-
-		HANDY_COUNTER_INCREMENT("io.forwards", 1);
-		err = dnet_trans_forward(r, st, forward_state);
-		if (err)
-			goto err_out_put_forward;
-
-		dnet_state_put(forward_state);
+		free(lanes);
 	}
 
-out:
 	return err;
+}
 
-err_out_put_forward:
-	dnet_state_put(forward_state);
-err_out_exit:
-	return err;
+static int dnet_cmd_is_striped(int cmd)
+{
+	switch (cmd) {
+	case DNET_CMD_READ:
+	case DNET_CMD_WRITE:
+	case DNET_CMD_LOOKUP:
+	case DNET_CMD_DEL:
+	case DNET_CMD_READ_RANGE:
+	case DNET_CMD_DEL_RANGE:
+	case DNET_CMD_BULK_READ:
+	case DNET_CMD_BULK_WRITE:
+	case DNET_CMD_ATOMIC_UPDATE:
+	case DNET_CMD_BULK_REMOVE:
+	case DNET_CMD_INDEXES_UPDATE:
+	case DNET_CMD_INDEXES_INTERNAL:
+	case DNET_CMD_INDEXES_FIND:
+		return 1;
+	default:
+		return 0;
+	}
 }
 
-void dnet_state_remove_nolock(struct dnet_net_state *st)
+/* shard of the calling thread, threads which have not submitted anything yet get the next one */
+static __thread int dnet_client_shard = -1;
+static int dnet_client_shard_next;
+
+void dnet_set_client_shard(int shard)
 {
-	list_del_init(&st->node_entry);
-	list_del_init(&st->storage_state_entry);
-	dnet_idc_destroy_nolock(st);
+	dnet_client_shard = shard;
 }
 
-static void dnet_state_remove(struct dnet_net_state *st)
+static int dnet_current_shard(int shards)
 {
-	struct dnet_node *n = st->n;
+	if (dnet_client_shard < 0)
+		dnet_client_shard = __sync_fetch_and_add(&dnet_client_shard_next, 1) & INT_MAX;
 
-	pthread_mutex_lock(&n->state_lock);
-	dnet_state_remove_nolock(st);
-	pthread_mutex_unlock(&n->state_lock);
+	return dnet_client_shard % shards;
 }
 
-static void dnet_state_remove_and_shutdown(struct dnet_net_state *st, int error)
+static int dnet_current_client_shard(struct dnet_node *n)
 {
-	int level = DNET_LOG_NOTICE;
-
-	if (error && (error != -EUCLEAN && error != -EEXIST))
-		level = DNET_LOG_ERROR;
+	return dnet_current_shard(n->client_shards);
+}
 
-	dnet_log(st->n, level, "%s: resetting state: %p: %s [%d], sockets: %d/%d",
-			dnet_state_dump_addr(st), st, strerror(-error), error,
-			st->read_s, st->write_s);
+/*
+ * In shard mode connection is chosen by shard of submitting thread: shard 0 is this state itself,
+ * others are its lanes, so requests and replies of one thread are served by the same net thread.
+ */
+static struct dnet_net_state *dnet_state_shard_lane(struct dnet_net_state *st)
+{
+	struct dnet_net_state *lane = NULL;
+	int idx = dnet_current_client_shard(st->n) - 1;
 
-	pthread_mutex_lock(&st->send_lock);
+	if (idx < 0)
+		return NULL;
 
-	dnet_state_remove_nolock(st);
+	pthread_mutex_lock(&st->trans_lock);
+	if (st->lane_num) {
+		idx %= st->lane_num;
+		if (!st->lanes[idx]->__need_exit)
+			lane = dnet_state_get(st->lanes[idx]);
+	}
+	pthread_mutex_unlock(&st->trans_lock);
 
-	if (!st->__need_exit) {
-		if (!error)
-			error = -123;
+	return lane;
+}
 
-		st->__need_exit = error;
+/*
+ * The first lane is dedicated to large requests and reads of large or unknown size,
+ * so that their data does not delay small requests. Small requests are spread
+ * over this state and the rest of lanes by transaction number.
+ * Lanes which have been reset are not used, this state takes their requests.
+ */
+struct dnet_net_state *dnet_state_lane(struct dnet_net_state *st, struct dnet_trans *t, struct dnet_io_req *req)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_net_state *lane = NULL;
+	int large, idx;
 
-		shutdown(st->read_s, SHUT_RDWR);
-		shutdown(st->write_s, SHUT_RDWR);
+	if (!st->lane_num || !dnet_cmd_is_striped(t->command))
+		return NULL;
 
-		//Wakes up sleeping threads and makes them exit because state is removed
-		if ((atomic_read(&st->send_queue_size) > 0))
-			pthread_cond_broadcast(&st->send_wait);
-	}
+	if (n->client_shards)
+		return dnet_state_shard_lane(st);
 
-	pthread_mutex_unlock(&st->send_lock);
-}
+	large = req->hsize + req->dsize + req->fsize >= n->large_request_size;
+	if (!large && t->command == DNET_CMD_READ &&
+			req->hsize >= sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr)) {
+		struct dnet_io_attr io = *(struct dnet_io_attr *)((struct dnet_cmd *)req->header + 1);
 
-int dnet_state_reset_nolock_noclean(struct dnet_net_state *st, int error, struct list_head *head)
-{
-	dnet_state_remove_and_shutdown(st, error);
+		dnet_convert_io_attr(&io);
+		large = !io.size || io.size >= n->large_request_size;
+	}
 
-	return dnet_trans_iterate_move_transaction(st, head);
-}
+	pthread_mutex_lock(&st->trans_lock);
+	if (st->lane_num) {
+		if (large)
+			idx = 0;
+		else if (st->lane_num > 1)
+			idx = t->trans % st->lane_num;
+		else
+			idx = -1;
 
-void dnet_state_reset(struct dnet_net_state *st, int error)
-{
-	LIST_HEAD(head);
+		/* index 0 of small requests stripe is this state itself */
+		if (idx == 0 && !large)
+			idx = -1;
 
-	/*
-	 * Prevent route table access and update, check given state, move and then drop all its transactions
-	 */
-	pthread_mutex_lock(&st->n->state_lock);
-	dnet_state_reset_nolock_noclean(st, error, &head);
-	pthread_mutex_unlock(&st->n->state_lock);
+		if (idx >= 0 && !st->lanes[idx]->__need_exit)
+			lane = dnet_state_get(st->lanes[idx]);
+	}
+	pthread_mutex_unlock(&st->trans_lock);
 
-	dnet_trans_clean_list(&head, error);
+	return lane;
 }
 
 
@@ -856,6 +2411,36 @@ void dnet_sock_close(struct dnet_node *n, int s)
 	close(s);
 }
 
+/*
+ * Window scale is negotiated at connect time, so buffer sizes are also set on listening
+ * and not yet connected sockets, accepted ones inherit them
+ */
+void dnet_set_socket_buffers(struct dnet_node *n, int s)
+{
+	if (n->socket_send_buffer)
+		setsockopt(s, SOL_SOCKET, SO_SNDBUF, &n->socket_send_buffer, 4);
+	if (n->socket_receive_buffer)
+		setsockopt(s, SOL_SOCKET, SO_RCVBUF, &n->socket_receive_buffer, 4);
+}
+
+/*
+ * Kernel hands connection to the listening socket of reuseport group whose CPU has received it,
+ * so every server shard serves connections whose packets are processed on its own CPU
+ */
+void dnet_set_incoming_cpu(struct dnet_node *n, int s, int shard)
+{
+#ifdef SO_INCOMING_CPU
+	int cpu = dnet_server_shard_cpu(shard);
+
+	if (cpu >= 0 && setsockopt(s, SOL_SOCKET, SO_INCOMING_CPU, &cpu, 4))
+		dnet_log_err(n, "server shard: %d: failed to set incoming cpu %d", shard, cpu);
+#else
+	(void) n;
+	(void) s;
+	(void) shard;
+#endif
+}
+
 void dnet_set_sockopt(struct dnet_node *n, int s)
 {
 	struct linger l;
@@ -875,10 +2460,38 @@ void dnet_set_sockopt(struct dnet_node *n, int s)
 
 	setsockopt(s, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
 
+	/* requests are sent with MSG_MORE while more data follows, the last part must leave at once */
+	opt = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, 4);
+
+	dnet_set_socket_buffers(n, s);
+
+#ifdef SO_BUSY_POLL
+	if (n->busy_poll_usecs)
+		setsockopt(s, SOL_SOCKET, SO_BUSY_POLL, &n->busy_poll_usecs, 4);
+#endif
+
 	fcntl(s, F_SETFD, FD_CLOEXEC);
 	fcntl(s, F_SETFL, O_NONBLOCK);
 }
 
+/*
+ * Route table state and its lanes are created one after another, so the number of live connections
+ * to the same address is the shard of the new one. Must be called with @n->state_lock held.
+ */
+static int dnet_state_shard_nolock(struct dnet_net_state *st)
+{
+	struct dnet_net_state *other;
+	int shard = 0;
+
+	list_for_each_entry(other, &st->n->storage_state_list, storage_state_entry) {
+		if (other != st && !other->__need_exit && dnet_addr_equal(&other->addr, &st->addr))
+			++shard;
+	}
+
+	return shard % st->n->io->net_thread_num;
+}
+
 int dnet_setup_control_nolock(struct dnet_net_state *st)
 {
 	struct dnet_node *n = st->n;
@@ -886,17 +2499,24 @@ int dnet_setup_control_nolock(struct dnet_net_state *st)
 	int err, pos;
 
 	if (st->epoll_fd == -1) {
-		pos = io->net_thread_pos;
-		if (++io->net_thread_pos >= io->net_thread_num)
-			io->net_thread_pos = 0;
+		if (n->client_shards) {
+			pos = dnet_state_shard_nolock(st);
+		} else if (n->server_shards) {
+			/* accepted connections stay in the shard of the listening socket which accepted them */
+			pos = dnet_current_shard(io->net_thread_num);
+		} else {
+			pos = io->net_thread_pos;
+			if (++io->net_thread_pos >= io->net_thread_num)
+				io->net_thread_pos = 0;
+		}
 		st->epoll_fd = io->net[pos].epoll_fd;
 
-		pthread_mutex_lock(&st->send_lock);
+		dnet_mutex_lock(&st->send_lock);
 		err = dnet_schedule_recv(st);
 		if (err) {
 			dnet_unschedule_all(st);
 		}
-		pthread_mutex_unlock(&st->send_lock);
+		dnet_mutex_unlock(&st->send_lock);
 		if (err)
 			goto err_out_exit;
 	}
@@ -919,6 +2539,36 @@ static int dnet_auth_complete(struct dnet_addr *addr, struct dnet_cmd *cmd, void
 
 	/* this means this callback at least has state and cmd */
 	if (!is_trans_destroyed(cmd)) {
+		if (cmd->status == 0 && cmd->size == sizeof(struct dnet_auth)) {
+			struct dnet_auth *a = (struct dnet_auth *)(cmd + 1);
+
+			dnet_convert_auth(a);
+			if (a->flags & DNET_AUTH_FLAGS_COMPRESSION) {
+				state = dnet_state_search_by_addr(n, addr);
+				if (state) {
+					int i;
+
+					state->wire_compression = 1;
+
+					/* lanes might have been opened before authentication has completed */
+					pthread_mutex_lock(&state->trans_lock);
+					for (i = 0; i < state->lane_num; ++i)
+						state->lanes[i]->wire_compression = 1;
+					pthread_mutex_unlock(&state->trans_lock);
+
+					dnet_state_put(state);
+				}
+
+				dnet_log(n, DNET_LOG_INFO, "%s: wire compression is enabled, state: %p",
+						dnet_addr_string(addr), state);
+			}
+
+			/* network thread has switched to short headers already, see dnet_process_recv_single() */
+			if (a->flags & DNET_AUTH_FLAGS_SHORT_HEADER)
+				dnet_log(n, DNET_LOG_INFO, "%s: short headers are enabled", dnet_addr_string(addr));
+			return 0;
+		}
+
 		if (cmd->status == 0) {
 			dnet_log(n, DNET_LOG_INFO, "%s: authentication request succeeded", dnet_addr_string(addr));
 			return 0;
@@ -947,6 +2597,12 @@ static int dnet_auth_send(struct dnet_net_state *st)
 	memset(&a, 0, sizeof(struct dnet_auth));
 
 	memcpy(a.cookie, n->cookie, DNET_AUTH_COOKIE_SIZE);
+	if (dnet_wire_compression_match(n, dnet_state_addr(st)))
+		a.flags |= DNET_AUTH_FLAGS_COMPRESSION;
+	if (n->short_header) {
+		a.flags |= DNET_AUTH_FLAGS_SHORT_HEADER;
+		st->short_header_asked = 1;
+	}
 	dnet_convert_auth(&a);
 
 	memset(&ctl, 0, sizeof(struct dnet_trans_control));
@@ -973,6 +2629,10 @@ int dnet_state_micro_init(struct dnet_net_state *st,
 
 	INIT_LIST_HEAD(&st->node_entry);
 	INIT_LIST_HEAD(&st->storage_state_entry);
+	INIT_LIST_HEAD(&st->recv_deferred_entry);
+	INIT_LIST_HEAD(&st->zerocopy_list);
+	st->stream_fd = -1;
+	st->stream_pipe[0] = st->stream_pipe[1] = -1;
 	st->idc_root = RB_ROOT;
 	err = pthread_rwlock_init(&st->idc_lock, NULL);
 	if (err) {
@@ -981,8 +2641,7 @@ int dnet_state_micro_init(struct dnet_net_state *st,
 		goto err_out;
 	}
 
-	st->trans_root = RB_ROOT;
-	st->timer_root = RB_ROOT;
+	dnet_state_trans_init(st);
 
 	st->epoll_fd = -1;
 
@@ -1034,11 +2693,11 @@ int dnet_state_move_to_dht(struct dnet_net_state *st, struct dnet_addr *addrs, i
 	struct dnet_node *n = st->n;
 	int err = 0;
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 
 	list_for_each_entry(other, &st->n->dht_state_list, node_entry) {
 		if (dnet_addr_equal(other->addrs, addrs)) {
-			pthread_mutex_unlock(&n->state_lock);
+			dnet_mutex_unlock(&n->state_lock);
 
 			dnet_state_reset(st, -EEXIST);
 
@@ -1054,7 +2713,7 @@ int dnet_state_move_to_dht(struct dnet_net_state *st, struct dnet_addr *addrs, i
 		list_move_tail(&st->storage_state_entry, &st->n->storage_state_list);
 	}
 
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	if (err) {
 		dnet_state_reset(st, err);
@@ -1151,6 +2810,10 @@ struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 		}
 	}
 
+	/* kernel TLS encrypts records from its own copy, zero-copy sends do not help there */
+	if (n->zerocopy_send_size && !accepting_state && !dnet_tls_match(n, addr))
+		dnet_state_zerocopy_init(st);
+
 	/*
 	 * it is possible that state can be removed after inserted into route table,
 	 * so we should grab a reference here and drop it after we are done
@@ -1170,11 +2833,11 @@ struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 			}
 		}
 
-		pthread_mutex_lock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
 		err = dnet_setup_control_nolock(st);
 		if (err)
 			goto err_out_unlock;
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 
 		if (!accepting_state && st->__join_state == DNET_JOIN) {
 			dnet_state_join(st);
@@ -1183,14 +2846,14 @@ struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 			dnet_state_set_server_prio(st);
 		}
 	} else {
-		pthread_mutex_lock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
 		list_add_tail(&st->node_entry, &n->empty_state_list);
 		list_add_tail(&st->storage_state_entry, &n->storage_state_list);
 
 		err = dnet_setup_control_nolock(st);
 		if (err)
 			goto err_out_unlock;
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 	}
 
 	if (atomic_read(&st->refcnt) == 1) {
@@ -1214,11 +2877,11 @@ struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 	return st;
 
 err_out_send_destroy:
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 err_out_unlock:
 	list_del_init(&st->node_entry);
 	list_del_init(&st->storage_state_entry);
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 	dnet_state_put(st);
 	pthread_mutex_destroy(&st->send_lock);
 	pthread_mutex_destroy(&st->trans_lock);
@@ -1246,11 +2909,11 @@ int dnet_node_state_num(struct dnet_node *n)
 	struct dnet_net_state *st;
 	int num = 0;
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	list_for_each_entry(st, &n->dht_state_list, node_entry) {
 		num++;
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	return num;
 }
@@ -1259,10 +2922,18 @@ static void dnet_state_send_clean(struct dnet_net_state *st)
 {
 	struct dnet_io_req *r, *tmp;
 
+	dnet_send_inbox_drain_nolock(st);
+
 	list_for_each_entry_safe(r, tmp, &st->send_list, req_entry) {
 		list_del(&r->req_entry);
 		dnet_io_req_free(r);
 	}
+
+	/* socket is closed, its pages are not transmitted anymore */
+	list_for_each_entry_safe(r, tmp, &st->zerocopy_list, req_entry) {
+		list_del(&r->req_entry);
+		dnet_io_req_free(r);
+	}
 }
 
 void dnet_state_destroy(struct dnet_net_state *st)
@@ -1281,12 +2952,19 @@ void dnet_state_destroy(struct dnet_net_state *st)
 	}
 
 	dnet_state_clean(st);
+	dnet_state_drop_lanes(st, -ECONNRESET);
 
 	dnet_state_send_clean(st);
 
+	if (st->stream_pipe[0] >= 0) {
+		close(st->stream_pipe[0]);
+		close(st->stream_pipe[1]);
+	}
+
 	pthread_rwlock_destroy(&st->idc_lock);
 	pthread_mutex_destroy(&st->send_lock);
 	pthread_mutex_destroy(&st->trans_lock);
+	dnet_state_trans_cleanup(st);
 
 	dnet_log(st->n, DNET_LOG_NOTICE, "Freeing state %s, socket: %d/%d, addr-num: %d.",
 		dnet_addr_string(&st->addr), st->read_s, st->write_s, st->addr_num);
@@ -1297,21 +2975,52 @@ void dnet_state_destroy(struct dnet_net_state *st)
 	free(st);
 }
 
-int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r)
+/* sends data segments of @r starting from @offset bytes into them */
+static int dnet_send_segments_nolock(struct dnet_net_state *st, struct dnet_io_req *r, size_t offset, int more)
+{
+	int i, err;
+
+	for (i = 0; i < r->iovcnt; ++i) {
+		struct iovec *seg = &r->iov[i];
+
+		if (offset >= seg->iov_len) {
+			offset -= seg->iov_len;
+			continue;
+		}
+
+		err = dnet_send_nolock_flags(st, seg->iov_base + offset, seg->iov_len - offset,
+				(more || i + 1 < r->iovcnt) ? MSG_MORE : 0);
+		if (err)
+			return err;
+
+		offset = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Sends (the rest of) request @r.
+ *
+ * Instead of toggling TCP_CORK around every request parts are sent with MSG_MORE
+ * while something else follows them: the rest of this request or, if @more is set,
+ * next request queued into the same state. The last part of the last queued request
+ * is sent without MSG_MORE and pushes everything into the wire.
+ * Thus there is no setsockopt() calls at all and small replies are coalesced into full segments.
+ */
+int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r, int more)
 {
-	int cork;
 	int err = 0;
 	size_t offset = st->send_offset;
+	const size_t start_offset = st->send_offset;
 	const size_t total_size = r->dsize + r->hsize + r->fsize;
+	int has_data = r->dsize && (r->data || r->iovcnt);
+	int has_fd = r->fd >= 0 && r->fsize;
+	struct dnet_cmd tmp, *cmd = dnet_io_req_cmd(r, &tmp);
 
-	if (total_size > sizeof(struct dnet_cmd)) {
-		/* Use TCP_CORK to send headers and packet body in one piece */
-		cork = 1;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_CORK, &cork, 4);
-	}
-
-	if (1) {
-		struct dnet_cmd *cmd = r->header ? r->header : r->data;
+	if (cmd) {
+		if (st->send_offset == 0)
+			DNET_PROBE_CMD(request__send, st, cmd, (unsigned long long)total_size);
 		dnet_node_set_trace_id(st->n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
 		dnet_log(st->n, st->send_offset == 0 ? DNET_LOG_INFO : DNET_LOG_DEBUG,
 			"%s: %s: sending trans: %lld -> %s/%d: size: %llu, cflags: %s, start-sent: %zd/%zd",
@@ -1322,40 +3031,44 @@ int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r)
 	}
 
 	if (r->hsize && r->header && st->send_offset < r->hsize) {
-		err = dnet_send_nolock(st, r->header + offset, r->hsize - offset);
+		err = dnet_send_nolock_flags(st, r->header + offset, r->hsize - offset,
+				(more || has_data || has_fd) ? MSG_MORE : 0);
 		if (err)
 			goto err_out_exit;
 	}
 
-	if (r->dsize && r->data && st->send_offset < (r->dsize + r->hsize)) {
+	if (has_data && st->send_offset < (r->dsize + r->hsize)) {
 		offset = st->send_offset - r->hsize;
-		err = dnet_send_nolock(st, r->data + offset, r->dsize - offset);
+		if (r->iovcnt)
+			err = dnet_send_segments_nolock(st, r, offset, more || has_fd);
+		else
+			err = dnet_send_nolock_flags(st, r->data + offset, r->dsize - offset,
+					(more || has_fd) ? MSG_MORE : 0);
 		if (err)
 			goto err_out_exit;
 	}
 
-	if (r->fd >= 0 && r->fsize && st->send_offset < total_size) {
+	if (has_fd && st->send_offset < total_size) {
 		offset = st->send_offset - r->dsize - r->hsize;
 		err = dnet_send_fd_nolock(st, r->fd, r->local_offset + offset, r->fsize - offset);
 		if (err)
 			goto err_out_exit;
 	}
 
-	if (r->hsize > sizeof(struct dnet_cmd)) {
-		struct dnet_cmd *cmd = r->header;
+	if (cmd && r->hsize > sizeof(struct dnet_cmd)) {
 		int nonblocking = !!(cmd->flags & DNET_FLAGS_NOLOCK);
 
 		dnet_log(st->n, DNET_LOG_DEBUG, "%s: %s: SENT %s cmd: %s: cmd-size: %llu, nonblocking: %d",
-			dnet_state_dump_addr(st), dnet_dump_id(r->header),
+			dnet_state_dump_addr(st), dnet_dump_id(&cmd->id),
 			nonblocking ? "nonblocking" : "blocking",
 			dnet_cmd_string(cmd->cmd),
 			(unsigned long long)cmd->size, nonblocking);
 	}
 
 err_out_exit:
+	__sync_add_and_fetch(&st->peer_stat.send_bytes, st->send_offset - start_offset);
 
-	if (1) {
-		struct dnet_cmd *cmd = r->header ? r->header : r->data;
+	if (cmd) {
 		dnet_log(st->n, st->send_offset == total_size ? DNET_LOG_INFO : DNET_LOG_DEBUG,
 			"%s: %s: sending trans: %lld -> %s/%d: size: %llu, cflags: %s, finish-sent: %zd/%zd",
 			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
@@ -1365,24 +3078,143 @@ err_out_exit:
 	}
 	dnet_node_unset_trace_id();
 
-	if (total_size > sizeof(struct dnet_cmd)) {
-		cork = 0;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_CORK, &cork, 4);
-	}
-
 	/*
-	 * Flush TCP output pipeline if we've sent whole request.
-	 *
 	 * We do not destroy request here, it is postponed to caller.
-	 * Function can be called without lock - default call path from network processing thread and dnet_process_send_single()
-	 * or under st->send_lock, if queue was empty and dnet_send*() caller directly invoked this function from dnet_io_req_queue()
-	 * instead of queueing.
+	 * Function is called without lock from network processing thread in dnet_process_send_single().
 	 */
-	if (st->send_offset == total_size) {
-		int nodelay = 1;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_NODELAY, &nodelay, 4);
+	return err;
+}
+
+ssize_t dnet_send_request_iov(struct dnet_net_state *st, struct dnet_io_req **reqs, int num, int more)
+{
+	struct iovec iov[DNET_SEND_IOV_MAX];
+	struct msghdr msg;
+	size_t skip = st->send_offset, size = 0;
+	int i, j, iovcnt = 0, flags = 0, truncated = 0;
+	ssize_t err;
+
+	for (i = 0; i < num; ++i) {
+		struct dnet_io_req *r = reqs[i];
+
+		/* the rest does not fit into @iov and will be sent by the next call */
+		if (iovcnt == DNET_SEND_IOV_MAX) {
+			truncated = 1;
+			break;
+		}
+
+		if (r->hsize && r->header) {
+			if (skip < r->hsize) {
+				iov[iovcnt].iov_base = r->header + skip;
+				iov[iovcnt].iov_len = r->hsize - skip;
+				size += iov[iovcnt].iov_len;
+				++iovcnt;
+				skip = 0;
+			} else {
+				skip -= r->hsize;
+			}
+		}
+
+		if (r->dsize && r->iovcnt) {
+			for (j = 0; j < r->iovcnt; ++j) {
+				struct iovec *seg = &r->iov[j];
+
+				if (skip >= seg->iov_len) {
+					skip -= seg->iov_len;
+					continue;
+				}
+
+				if (iovcnt == DNET_SEND_IOV_MAX) {
+					truncated = 1;
+					break;
+				}
+
+				iov[iovcnt].iov_base = seg->iov_base + skip;
+				iov[iovcnt].iov_len = seg->iov_len - skip;
+				size += iov[iovcnt].iov_len;
+				++iovcnt;
+				skip = 0;
+			}
+
+			if (truncated)
+				break;
+		} else if (r->dsize && r->data) {
+			if (iovcnt == DNET_SEND_IOV_MAX) {
+				truncated = 1;
+				break;
+			}
+
+			if (skip < r->dsize) {
+				iov[iovcnt].iov_base = r->data + skip;
+				iov[iovcnt].iov_len = r->dsize - skip;
+				size += iov[iovcnt].iov_len;
+				++iovcnt;
+				skip = 0;
+			} else {
+				skip -= r->dsize;
+			}
+		}
+
+		/* only the first request can be partially sent */
+		skip = 0;
+	}
+
+	if (!iovcnt)
+		return 0;
+
+	/* file part of the last request or next requests will follow */
+	if (more || truncated || (reqs[num - 1]->fd >= 0 && reqs[num - 1]->fsize))
+		flags |= MSG_MORE;
+
+#ifdef DNET_HAVE_ZEROCOPY
+	if (st->zerocopy && size >= st->n->zerocopy_send_size)
+		flags |= MSG_ZEROCOPY;
+#endif
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	do {
+		err = sendmsg(st->write_s, &msg, flags | MSG_NOSIGNAL);
+	} while (err < 0 && errno == EINTR);
+
+#ifdef DNET_HAVE_ZEROCOPY
+	if (flags & MSG_ZEROCOPY) {
+		if (err < 0 && errno == ENOBUFS) {
+			/* socket has run out of memory for pinned pages, this batch is copied */
+			flags &= ~MSG_ZEROCOPY;
+
+			do {
+				err = sendmsg(st->write_s, &msg, flags | MSG_NOSIGNAL);
+			} while (err < 0 && errno == EINTR);
+		} else if (err > 0) {
+			/* every successful call gets its own completion, requests wait for the latest one */
+			st->zerocopy_seq++;
+			for (i = 0; i < num; ++i)
+				reqs[i]->zerocopy = 1;
+		}
+	}
+#endif
+
+	if (err < 0) {
+		err = -errno;
+		if (err != -EAGAIN)
+			dnet_log_err(st->n, "Failed to send packet: size: %zu, requests: %d, socket: %d",
+					size, num, st->write_s);
+		return err;
+	}
+
+	if (err == 0) {
+		dnet_log(st->n, DNET_LOG_ERROR, "Peer %s has dropped the connection: socket: %d.",
+				dnet_state_dump_addr(st), st->write_s);
+		return -ECONNRESET;
 	}
 
+	__sync_add_and_fetch(&st->peer_stat.send_bytes, err);
+
+	dnet_log(st->n, DNET_LOG_DEBUG, "%s: sent %d requests at once: size: %zu, sent: %zd, iov: %d",
+			dnet_state_dump_addr(st), num, size, err, iovcnt);
+
 	return err;
 }
 
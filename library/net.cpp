@@ -32,12 +32,17 @@
 
 #include <netinet/tcp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "elliptics.h"
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
 #include "common.hpp"
+#include "tls.h"
 
 #undef dnet_log
 #undef dnet_log_error
@@ -51,6 +56,7 @@
 enum dnet_socket_state {
 	just_created = 0,
 	trying_to_connect,
+	tls_handshake,
 	started,
 	send_reverse,
 	recv_reverse,
@@ -60,6 +66,14 @@ enum dnet_socket_state {
 	failed
 };
 
+/*
+ * Reverse lookup request, generation is sent only if route cache is enabled
+ */
+struct dnet_reverse_lookup_request {
+	dnet_cmd cmd;
+	dnet_route_generation generation;
+} __attribute__ ((packed));
+
 /*
  * This is internal structure used to help batch socket creation.
  * Socket @s will be set to negative value in case of error.
@@ -67,21 +81,25 @@ enum dnet_socket_state {
  */
 struct dnet_addr_socket {
 	dnet_addr_socket(dnet_node *node, const dnet_addr *address, bool ask_route_list_arg)
-	: s(create_socket(node, address, 0)),
+	: local(false),
+	 s(create_socket(node, address, 0, &local)),
 	 ok(0),
 	 addr(*address),
 	 state(just_created),
-	 ask_route_list(ask_route_list_arg)
+	 cached_generation(0),
+	 ask_route_list(ask_route_list_arg),
+	 tls(NULL)
 	{}
 
 	~dnet_addr_socket() {
+		dnet_tls_free(tls);
 		close();
 	}
 
 	dnet_addr_socket(const dnet_addr_socket &) = delete;
 	dnet_addr_socket & operator = (const dnet_addr_socket &) = delete;
 
-	static int create_socket(dnet_node *node, const dnet_addr *address, int listening) {
+	static int create_socket(dnet_node *node, const dnet_addr *address, int listening, bool *local = NULL) {
 		socklen_t salen;
 		sockaddr *sa;
 		dnet_net_state *st;
@@ -98,6 +116,14 @@ struct dnet_addr_socket {
 			return err;
 		}
 
+		if (!listening) {
+			s = dnet_local_socket_connect(node, address);
+			if (s >= 0) {
+				*local = true;
+				return s;
+			}
+		}
+
 		salen = address->addr_len;
 		sa = (sockaddr *)address;
 
@@ -114,11 +140,24 @@ struct dnet_addr_socket {
 
 		fcntl(s, F_SETFL, O_NONBLOCK);
 		fcntl(s, F_SETFD, FD_CLOEXEC);
+		dnet_set_socket_buffers(node, s);
 
 		if (listening) {
 			err = 1;
 			setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &err, 4);
 
+			// every server shard listens the same port, kernel balances connections between them
+			if (node->server_shards) {
+				err = 1;
+				if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &err, 4)) {
+					err = -errno;
+					dnet_log_err(node, "Failed to enable port reuse for %s",
+						     dnet_addr_string(address));
+					::close(s);
+					return err;
+				}
+			}
+
 			err = bind(s, sa, salen);
 			if (err) {
 				err = -errno;
@@ -152,16 +191,24 @@ struct dnet_addr_socket {
 		}
 	}
 
+	// socket is already connected to unix socket of co-located server, see dnet_config::local_socket_dir
+	bool local;
 	int s;
 	int ok;
 	dnet_addr addr;
 	dnet_socket_state state;
 	dnet_cmd io_cmd;
+	dnet_reverse_lookup_request reverse_request;
+	// id container received from this node earlier and generation of its ids, see dnet_route_cache_load()
+	std::vector<char> cached_ids;
+	uint64_t cached_generation;
 	std::unique_ptr<char[]> buffer;
 	char *io_data;
 	size_t io_size;
 	int version[4];
 	bool ask_route_list;
+	// handshake in progress if connection is encrypted, see dnet_config::tls_networks
+	dnet_tls *tls;
 };
 
 typedef std::shared_ptr<dnet_addr_socket> dnet_addr_socket_ptr;
@@ -221,6 +268,8 @@ struct dnet_connect_state
 	size_t total_count;
 	dnet_addr_socket_set sockets_connected;
 	dnet_addr_socket_set sockets_queue;
+	// sockets waiting for a free slot if node's connect_concurrency is set
+	dnet_addr_socket_set sockets_pending;
 	bool finished;
 };
 
@@ -244,10 +293,11 @@ static void dnet_add_to_reconnect_list(dnet_node *node, const dnet_addr &addr, i
 
 	if ((error == -ENOMEM) ||
 		(error == -EBADF)) {
+		dnet_remove_reconnect_state(node, &addr);
 		return;
 	}
 
-	dnet_add_reconnect_state(node, &addr, join);
+	dnet_add_reconnect_state(node, &addr, join, 0);
 }
 
 /*!
@@ -263,6 +313,8 @@ static void dnet_fail_socket(const dnet_connect_state_ptr &state, dnet_addr_sock
 		epoll_ctl(state->epollfd, EPOLL_CTL_DEL, socket->s, NULL);
 
 	state->failed_count++;
+	dnet_tls_free(socket->tls);
+	socket->tls = NULL;
 	if (socket->s >= 0)
 		close(socket->s);
 	socket->s = error;
@@ -434,6 +486,113 @@ static void dnet_interrupt_epoll(dnet_connect_state &state)
 	(void) err;
 }
 
+#define DNET_ROUTE_CACHE_MAGIC	0x65726f7574656331ULL
+
+/*
+ * Route cache file starts with this header followed by @size bytes of id container
+ * exactly as it was received from the node, i.e. in network byte order
+ */
+struct dnet_route_cache_header {
+	uint64_t magic;
+	uint64_t generation;
+	uint64_t size;
+};
+
+static std::string dnet_route_cache_path(dnet_node *node, const dnet_addr *addr)
+{
+	char addr_str[128];
+
+	dnet_addr_string_raw(addr, addr_str, sizeof(addr_str));
+	return std::string(node->route_cache_dir) + "/" + addr_str;
+}
+
+/*
+ * Loads ids cached for @addr, returns their generation or 0 if there is no valid cache
+ */
+static uint64_t dnet_route_cache_load(dnet_node *node, const dnet_addr *addr, std::vector<char> &data)
+{
+	const std::string path = dnet_route_cache_path(node, addr);
+	dnet_route_cache_header header;
+	uint64_t generation = 0;
+	struct stat st;
+	int fd;
+
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(header))
+		goto err_out_close;
+
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header))
+		goto err_out_close;
+
+	if (header.magic != DNET_ROUTE_CACHE_MAGIC || header.size != st.st_size - sizeof(header) ||
+			header.size < sizeof(dnet_id_container))
+		goto err_out_close;
+
+	data.resize(header.size);
+	if (pread(fd, data.data(), header.size, sizeof(header)) != (ssize_t)header.size) {
+		data.clear();
+		goto err_out_close;
+	}
+
+	generation = header.generation;
+
+err_out_close:
+	::close(fd);
+
+	dnet_log(node, DNET_LOG_NOTICE, "%s: route cache: %s, generation: %llx",
+			dnet_addr_string(addr), generation ? "loaded" : "not found",
+			(unsigned long long)generation);
+	return generation;
+}
+
+/*
+ * Atomically replaces ids cached for @addr with @size bytes of id container in network byte order
+ */
+static void dnet_route_cache_store(dnet_node *node, const dnet_addr *addr, uint64_t generation, const void *data, size_t size)
+{
+	const std::string path = dnet_route_cache_path(node, addr);
+	static std::atomic<unsigned long> seq(0);
+	const std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(seq++);
+	dnet_route_cache_header header;
+	int fd, err = 0;
+
+	header.magic = DNET_ROUTE_CACHE_MAGIC;
+	header.generation = generation;
+	header.size = size;
+
+	fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		err = -errno;
+		goto err_out_exit;
+	}
+
+	if (write(fd, &header, sizeof(header)) != sizeof(header) || write(fd, data, size) != (ssize_t)size) {
+		err = -errno ? -errno : -ENOSPC;
+		::close(fd);
+		goto err_out_unlink;
+	}
+
+	::close(fd);
+
+	if (rename(tmp.c_str(), path.c_str())) {
+		err = -errno;
+		goto err_out_unlink;
+	}
+
+	dnet_log(node, DNET_LOG_NOTICE, "%s: route cache: stored %zu bytes, generation: %llx",
+			dnet_addr_string(addr), size, (unsigned long long)generation);
+	return;
+
+err_out_unlink:
+	unlink(tmp.c_str());
+err_out_exit:
+	dnet_log(node, DNET_LOG_ERROR, "%s: route cache: failed to store ids to %s: %d",
+			dnet_addr_string(addr), path.c_str(), err);
+}
+
 static int dnet_validate_route_list(const char *server_addr, dnet_node *node, struct dnet_cmd *cmd)
 {
 	dnet_addr_container *cnt;
@@ -620,24 +779,80 @@ static void dnet_request_route_list(const dnet_connect_state_ptr &state, dnet_ne
 	}
 }
 
+/*!
+ * Starts connection of \a socket and adds it to epoll
+ */
+static void dnet_socket_connect_one(const dnet_connect_state_ptr &state, const dnet_addr_socket_ptr &socket)
+{
+	socket->state = trying_to_connect;
+
+	socklen_t salen = socket->addr.addr_len;
+	sockaddr *sa = (sockaddr *)&socket->addr;
+
+	int err = socket->local ? 0 : connect(socket->s, sa, salen);
+	if (err < 0) {
+		err = -errno;
+		if (err != -EINPROGRESS) {
+			dnet_log_err(state->node, "Failed to connect to %s",
+				dnet_addr_string(&socket->addr));
+			dnet_fail_socket(state, socket.get(), err, false);
+			return;
+		}
+	}
+
+	if (dnet_epoll_ctl(state, socket.get(), EPOLL_CTL_ADD, EPOLLOUT)) {
+		state->sockets_connected.insert(socket);
+	}
+}
+
+/*!
+ * Returns true if one more socket may be connected according to node's connect_concurrency
+ */
+static bool dnet_socket_connect_allowed(const dnet_connect_state_ptr &state)
+{
+	const size_t limit = state->node->connect_concurrency;
+	if (!limit)
+		return true;
+
+	const size_t in_flight = state->total_count - state->succeed_count - state->failed_count -
+		state->sockets_pending.size();
+	return in_flight < limit;
+}
+
+/*!
+ * Connects pending sockets while there are free slots
+ */
+static void dnet_socket_connect_pending(const dnet_connect_state_ptr &state)
+{
+	while (!state->sockets_pending.empty() && dnet_socket_connect_allowed(state)) {
+		dnet_addr_socket_ptr socket = *state->sockets_pending.begin();
+		state->sockets_pending.erase(state->sockets_pending.begin());
+
+		dnet_socket_connect_one(state, socket);
+	}
+}
+
 /*!
  * Adds new sockets from \a list to connection queue and add all of them to epoll.
+ * If node's connect_concurrency is set, sockets above it wait for completion of others.
  *
  * If some addresses are already in the queue - they are skipped
  */
 static void dnet_socket_connect_new_sockets(const dnet_connect_state_ptr &state, dnet_addr_socket_set &list)
 {
-	state->total_count += list.size();
-
 	for (auto it = list.begin(); it != list.end(); ++it) {
 		const dnet_addr_socket_ptr &socket = *it;
 
+		// counted one by one, so that not yet processed sockets are not taken for connecting ones
+		state->total_count++;
+
 		if (socket->s < 0) {
 			state->failed_count++;
 			continue;
 		}
 
-		const bool already_exist = state->sockets_connected.find(socket) != state->sockets_connected.end();
+		const bool already_exist = state->sockets_connected.find(socket) != state->sockets_connected.end() ||
+			state->sockets_pending.find(socket) != state->sockets_pending.end();
 		if (already_exist) {
 			dnet_log(state->node, DNET_LOG_NOTICE, "we are already connected to %s",
 				dnet_addr_string(&socket->addr));
@@ -646,25 +861,12 @@ static void dnet_socket_connect_new_sockets(const dnet_connect_state_ptr &state,
 			continue;
 		}
 
-		socket->state = trying_to_connect;
-
-		socklen_t salen = socket->addr.addr_len;
-		sockaddr *sa = (sockaddr *)&socket->addr;
-
-		int err = connect(socket->s, sa, salen);
-		if (err < 0) {
-			err = -errno;
-			if (err != -EINPROGRESS) {
-				dnet_log_err(state->node, "Failed to connect to %s",
-					dnet_addr_string(&socket->addr));
-				dnet_fail_socket(state, socket.get(), err, false);
-				continue;
-			}
+		if (!dnet_socket_connect_allowed(state)) {
+			state->sockets_pending.insert(socket);
+			continue;
 		}
 
-		if (dnet_epoll_ctl(state, socket.get(), EPOLL_CTL_ADD, EPOLLOUT)) {
-			state->sockets_connected.insert(socket);
-		}
+		dnet_socket_connect_one(state, socket);
 	}
 }
 
@@ -722,27 +924,88 @@ static void dnet_process_socket(const dnet_connect_state_ptr &state, epoll_event
 			break;
 		}
 
+		if (!socket->local && dnet_tls_match(state->node, &socket->addr)) {
+			err = dnet_tls_start(state->node->tls_ctx, socket->s, 0, &socket->tls);
+			if (err) {
+				dnet_log(state->node, DNET_LOG_ERROR, "%s: failed to start TLS handshake: %s [%d]",
+					dnet_addr_string(&socket->addr), strerror(-err), err);
+				dnet_fail_socket(state, socket, err);
+				break;
+			}
+
+			dnet_log(state->node, DNET_LOG_NOTICE, "%s: successfully connected, starting TLS handshake",
+				dnet_addr_string(&socket->addr));
+
+			socket->state = tls_handshake;
+			goto tls_handshake;
+		}
+
 		dnet_log(state->node, DNET_LOG_NOTICE, "%s: successfully connected, sending reverse lookup command",
 			dnet_addr_string(&socket->addr));
 
+		socket->state = started;
+		goto started;
+	}
+	case tls_handshake:
+	tls_handshake: {
+		uint32_t events = 0;
+
+		// handshake frees its state both on success and on error
+		int err = dnet_tls_handshake(socket->tls, &events);
+		if (err == -EAGAIN) {
+			dnet_epoll_ctl(state, socket, EPOLL_CTL_MOD, events);
+			break;
+		}
+		socket->tls = NULL;
+
+		if (err) {
+			dnet_log(state->node, DNET_LOG_ERROR, "%s: TLS handshake failed: %s: %s [%d]",
+				dnet_addr_string(&socket->addr), dnet_tls_error(), strerror(-err), err);
+			dnet_fail_socket(state, socket, err);
+			break;
+		}
+
+		// reverse lookup is sent when socket becomes writable again
+		if (!dnet_epoll_ctl(state, socket, EPOLL_CTL_MOD, EPOLLOUT))
+			break;
+
+		dnet_log(state->node, DNET_LOG_NOTICE, "%s: connection is encrypted, sending reverse lookup command",
+			dnet_addr_string(&socket->addr));
+
 		socket->state = started;
 		// Fall through
 	}
 	case started:
-		memset(cmd, 0, sizeof(dnet_cmd));
+	started: {
+		dnet_reverse_lookup_request *req = &socket->reverse_request;
 
-		cmd->flags = DNET_FLAGS_DIRECT | DNET_FLAGS_NOLOCK;
-		cmd->cmd = DNET_CMD_REVERSE_LOOKUP;
+		memset(req, 0, sizeof(dnet_reverse_lookup_request));
 
-		dnet_version_encode(&cmd->id);
-		dnet_indexes_shard_count_encode(&cmd->id, state->node->indexes_shard_count);
-		dnet_convert_cmd(cmd);
+		req->cmd.flags = DNET_FLAGS_DIRECT | DNET_FLAGS_NOLOCK;
+		req->cmd.cmd = DNET_CMD_REVERSE_LOOKUP;
+
+		dnet_version_encode(&req->cmd.id);
+		dnet_indexes_shard_count_encode(&req->cmd.id, state->node->indexes_shard_count);
 
-		socket->state = send_reverse;
-		socket->io_data = reinterpret_cast<char*>(cmd);
 		socket->io_size = sizeof(dnet_cmd);
 
+		// server sends ids only if they differ from cached ones, even if there is no cache yet we ask for generation
+		if (state->node->route_cache_dir) {
+			socket->cached_generation = dnet_route_cache_load(state->node, &socket->addr, socket->cached_ids);
+
+			req->cmd.size = sizeof(dnet_route_generation);
+			req->generation.generation = socket->cached_generation;
+			dnet_convert_route_generation(&req->generation);
+
+			socket->io_size += sizeof(dnet_route_generation);
+		}
+
+		dnet_convert_cmd(&req->cmd);
+
+		socket->state = send_reverse;
+		socket->io_data = reinterpret_cast<char*>(req);
 		// Fall through
+	}
 	case send_reverse:
 		if (!dnet_send_nolock(state, socket))
 			break;
@@ -862,6 +1125,46 @@ static void dnet_process_socket(const dnet_connect_state_ptr &state, epoll_event
 		dnet_id_container *id_container = reinterpret_cast<dnet_id_container *>(
 			socket->buffer.get() + sizeof(dnet_addr) * cnt->addr_num + sizeof(dnet_addr_container)
 		);
+		uint64_t generation = 0;
+
+		if (cmd->flags & DNET_FLAGS_ROUTE_GENERATION) {
+			if (size < sizeof(dnet_id_container) + sizeof(dnet_route_generation)) {
+				err = -EINVAL;
+				dnet_log(state->node, DNET_LOG_ERROR, "%s: reverse lookup reply is too small for route generation: "
+						"size: %zu, err: %d", dnet_addr_string(&socket->addr), size, err);
+				dnet_fail_socket(state, socket, err);
+				break;
+			}
+
+			size -= sizeof(dnet_route_generation);
+
+			dnet_route_generation *gen = reinterpret_cast<dnet_route_generation *>(
+					reinterpret_cast<char *>(id_container) + size);
+			dnet_convert_route_generation(gen);
+			generation = gen->generation;
+
+			if (gen->flags & DNET_ROUTE_GENERATION_UNCHANGED) {
+				if (socket->cached_ids.empty() || generation != socket->cached_generation) {
+					err = -EPROTO;
+					dnet_log(state->node, DNET_LOG_ERROR, "%s: server reported unchanged route generation: %llx, "
+							"but cached one is: %llx, err: %d",
+							dnet_addr_string(&socket->addr), (unsigned long long)generation,
+							(unsigned long long)socket->cached_generation, err);
+					dnet_fail_socket(state, socket, err);
+					break;
+				}
+
+				id_container = reinterpret_cast<dnet_id_container *>(socket->cached_ids.data());
+				size = socket->cached_ids.size();
+			} else if (generation) {
+				dnet_route_cache_store(state->node, &socket->addr, generation, id_container, size);
+			}
+
+			dnet_log(state->node, DNET_LOG_INFO, "%s: route generation: %llx, cached: %llx, ids are %s",
+					dnet_addr_string(&socket->addr), (unsigned long long)generation,
+					(unsigned long long)socket->cached_generation,
+					(gen->flags & DNET_ROUTE_GENERATION_UNCHANGED) ? "taken from cache" : "received");
+		}
 
 		err = dnet_validate_id_container(id_container, size);
 		if (err) {
@@ -952,12 +1255,15 @@ static void dnet_process_socket(const dnet_connect_state_ptr &state, epoll_event
 
 		memcpy(st->version, socket->version, sizeof(st->version));
 
+		dnet_state_add_lanes(st);
+
 		dnet_log(state->node, DNET_LOG_INFO, "Connected to %s, backends-num: %d, addr-num: %d, idx: %d, socket: %d/%d",
 			dnet_addr_string(&socket->addr),
 			int(id_container->backends_count), int(cnt->addr_num), idx,
 			st->read_s, st->write_s);
 
 		socket->buffer.reset();
+		socket->cached_ids.clear();
 		state->succeed_count++;
 		socket->ok = 1;
 
@@ -1108,6 +1414,8 @@ static int dnet_socket_connect(dnet_node *node, dnet_addr_socket_set &original_l
 			dnet_process_socket(state, events[i]);
 		}
 
+		dnet_socket_connect_pending(state);
+
 		gettimeofday(&end, NULL);
 
 		timeout -= (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
@@ -1134,6 +1442,8 @@ static int dnet_socket_connect(dnet_node *node, dnet_addr_socket_set &original_l
 
 	state->sockets_connected.insert( state->sockets_queue.begin(), state->sockets_queue.end() );
 	state->sockets_queue.clear();
+	state->sockets_connected.insert( state->sockets_pending.begin(), state->sockets_pending.end() );
+	state->sockets_pending.clear();
 
 	pthread_mutex_unlock(&state->lock);
 
@@ -1197,7 +1507,7 @@ static net_state_list_ptr dnet_check_route_table_victims(struct dnet_node *node,
 	}
 
 	size_t groups_count = 0;
-	pthread_mutex_lock(&node->state_lock);
+	dnet_mutex_lock(&node->state_lock);
 
 	struct rb_node *it;
 	struct dnet_group *g;
@@ -1208,7 +1518,7 @@ static net_state_list_ptr dnet_check_route_table_victims(struct dnet_node *node,
 		if (groups_count >= groups_count_limit)
 			break;
 	}
-	pthread_mutex_unlock(&node->state_lock);
+	dnet_mutex_unlock(&node->state_lock);
 
 	struct dnet_id id;
 	memset(&id, 0, sizeof(id));
@@ -1250,34 +1560,75 @@ static net_state_list_ptr dnet_check_route_table_victims(struct dnet_node *node,
 	return route_list_states;
 }
 
+/*!
+ * Returns addresses whose reconnection backoff has expired and schedules their next attempts.
+ *
+ * Addresses which have been connected in the meantime are removed from the reconnect list.
+ * If node's connect_concurrency is set, at most that many addresses are returned, those
+ * which have served the biggest share of routes first, the rest are left due for the next pass.
+ */
 static net_addr_list dnet_reconnect_victims(struct dnet_node *node, int *flags)
 {
+	const long now = dnet_monotonic_usecs() / 1000000;
+	std::vector<dnet_addr_storage *> due;
 	net_addr_list addrs;
 
 	dnet_pthread_lock_guard locker(node->reconnect_lock);
 
-	addrs.reserve(node->reconnect_num);
-
 	struct dnet_addr_storage *ast, *tmp;
 	list_for_each_entry_safe(ast, tmp, &node->reconnect_list, reconnect_entry) {
-		list_del_init(&ast->reconnect_entry);
+		if (ast->next_attempt > now)
+			continue;
+
+		struct dnet_net_state *st = dnet_state_search_by_addr(node, &ast->addr);
+		if (st) {
+			dnet_state_put(st);
+
+			list_del_init(&ast->reconnect_entry);
+			node->reconnect_num--;
+			free(ast);
+			continue;
+		}
+
+		due.push_back(ast);
+	}
+
+	std::stable_sort(due.begin(), due.end(), [] (const dnet_addr_storage *first, const dnet_addr_storage *second) {
+		return first->route_share > second->route_share;
+	});
+
+	if (node->connect_concurrency > 0 && due.size() > static_cast<size_t>(node->connect_concurrency))
+		due.resize(node->connect_concurrency);
+
+	addrs.reserve(due.size());
+
+	const long check_timeout = node->check_timeout ? node->check_timeout : 10;
+	for (auto it = due.begin(); it != due.end(); ++it) {
+		ast = *it;
 		addrs.push_back(ast->addr);
 
 		if (ast->__join_state == DNET_JOIN)
 			(*flags) |= DNET_CFG_JOIN_NETWORK;
 
-		free(ast);
+		ast->reconnect_time = ast->reconnect_time ? std::min(ast->reconnect_time * 2, ast->reconnect_time_max) :
+			check_timeout;
+		ast->next_attempt = now + ast->reconnect_time / 2 + 1 + rand() % (ast->reconnect_time / 2 + 1);
+
+		dnet_log(node, DNET_LOG_INFO, "Reconnecting to %s, route share: %f, next attempt in %ld seconds",
+			dnet_addr_string(&ast->addr), ast->route_share, ast->next_attempt - now);
 	}
 
 	return addrs;
 }
 
-void dnet_reconnect_and_check_route_table(dnet_node *node)
+void dnet_reconnect_and_check_route_table(dnet_node *node, int check_route_table)
 {
 	size_t states_count = 0;
 	int flags = 0;
 
-	net_state_list_ptr states = dnet_check_route_table_victims(node, &states_count);
+	net_state_list_ptr states;
+	if (check_route_table)
+		states = dnet_check_route_table_victims(node, &states_count);
 	net_addr_list addrs = dnet_reconnect_victims(node, &flags);
 
 	dnet_join_state join = DNET_WANT_RECONNECT;
@@ -23,10 +23,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <signal.h>
 
 #include "elliptics.h"
 #include "elliptics/interface.h"
+#include "tls.h"
+#include "hugepage.h"
 #include "monitor/monitor.h"
 
 static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
@@ -51,10 +54,16 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 		goto err_out_free;
 	}
 
+	err = dnet_lock_init(&n->route_lock);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize route lock: err: %d", err);
+		goto err_out_destroy_state;
+	}
+
 	n->wait = dnet_wait_alloc(0);
 	if (!n->wait) {
 		dnet_log(n, DNET_LOG_ERROR, "Failed to allocate wait structure.");
-		goto err_out_destroy_state;
+		goto err_out_destroy_route_lock;
 	}
 
 	err = dnet_counter_init(n);
@@ -77,20 +86,42 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 		goto err_out_destroy_reconnect_lock;
 	}
 
+	err = dnet_node_trans_timer_init(n);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize transaction timer lock: err: %d", err);
+		goto err_out_destroy_test_settings;
+	}
+
 	err = pthread_attr_init(&n->attr);
 	if (err) {
 		err = -err;
 		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize pthread attributes: err: %d", err);
-		goto err_out_destroy_test_settings;
+		goto err_out_destroy_trans_timer;
 	}
 	pthread_attr_setdetachstate(&n->attr, PTHREAD_CREATE_DETACHED);
 
+	err = pthread_mutex_init(&n->update_filter_lock, NULL);
+	if (err) {
+		err = -err;
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize update filter lock: err: %d", err);
+		goto err_out_destroy_attr;
+	}
+
+	err = pthread_mutex_init(&n->recv_deferred_lock, NULL);
+	if (err) {
+		err = -err;
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize deferred receive lock: err: %d", err);
+		goto err_out_destroy_update_filter_lock;
+	}
+
 	n->group_root = RB_ROOT;
 	INIT_LIST_HEAD(&n->empty_state_list);
 	INIT_LIST_HEAD(&n->dht_state_list);
 	INIT_LIST_HEAD(&n->storage_state_list);
 	INIT_LIST_HEAD(&n->reconnect_list);
 	INIT_LIST_HEAD(&n->iterator_list);
+	INIT_LIST_HEAD(&n->update_filter_list);
+	INIT_LIST_HEAD(&n->recv_deferred_list);
 
 	INIT_LIST_HEAD(&n->check_entry);
 
@@ -98,6 +129,12 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 
 	return n;
 
+err_out_destroy_update_filter_lock:
+	pthread_mutex_destroy(&n->update_filter_lock);
+err_out_destroy_attr:
+	pthread_attr_destroy(&n->attr);
+err_out_destroy_trans_timer:
+	dnet_node_trans_timer_cleanup(n);
 err_out_destroy_test_settings:
 	pthread_rwlock_destroy(&n->test_settings_lock);
 err_out_destroy_reconnect_lock:
@@ -106,6 +143,8 @@ err_out_destroy_counter:
 	dnet_counter_destroy(n);
 err_out_destroy_wait:
 	dnet_wait_put(n->wait);
+err_out_destroy_route_lock:
+	dnet_lock_destroy(&n->route_lock);
 err_out_destroy_state:
 	pthread_mutex_destroy(&n->state_lock);
 err_out_free:
@@ -131,6 +170,7 @@ static struct dnet_group *dnet_group_create(struct dnet_node *n, unsigned int gr
 
 	g->id_num = 0;
 	g->ids = NULL;
+	g->id_prefixes = NULL;
 
 	return g;
 }
@@ -142,6 +182,7 @@ void dnet_group_destroy(struct dnet_group *g)
 		exit(-1);
 	}
 	rb_erase(&g->group_entry, &g->node->group_root);
+	free(g->id_prefixes);
 	free(g->ids);
 	free(g);
 }
@@ -199,6 +240,97 @@ static int dnet_idc_compare(const void *k1, const void *k2)
 	return dnet_id_cmp_str(id1->raw.id, id2->raw.id);
 }
 
+/*
+ * Rebuilds @g->id_prefixes, must be called every time @g->ids is changed
+ */
+static void dnet_group_update_prefixes(struct dnet_group *g)
+{
+	uint64_t *prefixes;
+	int i;
+
+	prefixes = realloc(g->id_prefixes, (g->id_num ? g->id_num : 1) * sizeof(uint64_t));
+	if (!prefixes) {
+		free(g->id_prefixes);
+		g->id_prefixes = NULL;
+		return;
+	}
+
+	for (i = 0; i < g->id_num; ++i)
+		prefixes[i] = dnet_id_prefix(g->ids[i].raw.id);
+
+	g->id_prefixes = prefixes;
+}
+
+/*
+ * Returns number of elements in sorted @a which are less than @key.
+ * Search is branchless, the only branch is loop condition which depends on @num only.
+ */
+static inline int dnet_prefix_lower_bound(const uint64_t *a, int num, uint64_t key)
+{
+	const uint64_t *base = a;
+	int half;
+
+	if (num == 0)
+		return 0;
+
+	while (num > 1) {
+		half = num / 2;
+		base = (base[half] < key) ? base + half : base;
+		num -= half;
+	}
+
+	return (base - a) + (*base < key);
+}
+
+#define DNET_IDS_RAW(ids, size, i)	((const struct dnet_raw_id *)((const char *)(ids) + (size) * (i)))
+
+/*
+ * Returns position of the last id not greater than @id (or the last one if there is no such id)
+ * in sorted array @ids of @id_num elements of @size bytes each, every element starts with dnet_raw_id.
+ * @prefixes is either NULL or array of big-endian first 8 bytes of every id.
+ */
+static int dnet_ids_search(const uint64_t *prefixes, const void *ids, size_t size, int id_num, const struct dnet_id *id)
+{
+	int low, high, i, cmp;
+
+	if (prefixes) {
+		const uint64_t prefix = dnet_id_prefix(id->id);
+
+		low = dnet_prefix_lower_bound(prefixes, id_num, prefix);
+		high = low;
+		while (high < id_num && prefixes[high] == prefix)
+			++high;
+
+		/* find the last id not greater than @id among ids with the same prefix */
+		for (i = low; i < high; ++i) {
+			if (dnet_id_cmp_str(DNET_IDS_RAW(ids, size, i)->id, id->id) > 0)
+				break;
+		}
+
+		i -= 1;
+		goto out;
+	}
+
+	for (low = -1, high = id_num; high-low > 1; ) {
+		i = low + (high - low)/2;
+
+		cmp = dnet_id_cmp_str(DNET_IDS_RAW(ids, size, i)->id, id->id);
+		if (cmp < 0)
+			low = i;
+		else if (cmp > 0)
+			high = i;
+		else
+			goto out;
+	}
+	i = high - 1;
+
+out:
+	if (i == -1)
+		i = id_num - 1;
+
+	return i;
+}
+
 static void dnet_idc_remove_nolock(struct dnet_idc *idc)
 {
 	int i, pos;
@@ -215,9 +347,10 @@ static void dnet_idc_remove_nolock(struct dnet_idc *idc)
 		}
 	}
 
+	/* compaction keeps the order, so there is nothing to sort */
 	g->id_num = pos;
-
-	qsort(g->ids,  g->id_num, sizeof(struct dnet_state_id), dnet_idc_compare);
+	g->route_changed = 1;
+	dnet_group_update_prefixes(g);
 
 	if (idc->state_entry.rb_parent_color) {
 		rb_erase(&idc->state_entry, &idc->st->idc_root);
@@ -272,7 +405,217 @@ int dnet_idc_insert_nolock(struct dnet_net_state *st, struct dnet_idc *idc_new)
 	return 0;
 }
 
-void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
+static int dnet_route_group_compare(const void *k1, const void *k2)
+{
+	const struct dnet_route_group *g1 = k1;
+	const struct dnet_route_group *g2 = k2;
+
+	if (g1->group_id < g2->group_id)
+		return -1;
+	if (g1->group_id > g2->group_id)
+		return 1;
+	return 0;
+}
+
+static void dnet_route_group_ids_put(struct dnet_route_group_ids *block)
+{
+	if (--block->refcnt == 0)
+		free(block);
+}
+
+/*
+ * Copies ids of @g into new block of @rg, returns 0 on success.
+ */
+static int dnet_route_group_build(struct dnet_route_group *rg, struct dnet_group *g)
+{
+	struct dnet_route_group_ids *block;
+	struct dnet_route_table_entry *entries;
+	uint64_t *prefixes;
+	int i;
+
+	block = malloc(sizeof(struct dnet_route_group_ids) +
+			g->id_num * (sizeof(struct dnet_route_table_entry) + sizeof(uint64_t)));
+	if (!block)
+		return -ENOMEM;
+
+	block->refcnt = 1;
+	entries = (struct dnet_route_table_entry *)(block + 1);
+	prefixes = (uint64_t *)(entries + g->id_num);
+
+	for (i = 0; i < g->id_num; ++i) {
+		const struct dnet_state_id *sid = &g->ids[i];
+
+		memcpy(&entries[i].raw, &sid->raw, sizeof(struct dnet_raw_id));
+		entries[i].st = sid->idc->st;
+		entries[i].backend_id = sid->idc->backend_id;
+		prefixes[i] = g->id_prefixes ? g->id_prefixes[i] : dnet_id_prefix(sid->raw.id);
+	}
+
+	rg->group_id = g->group_id;
+	rg->id_num = g->id_num;
+	rg->ids = entries;
+	rg->id_prefixes = prefixes;
+	rg->block = block;
+	return 0;
+}
+
+/*
+ * Builds snapshot of the current routing table. Groups which have not been changed since
+ * @old snapshot share their ids with it, only changed groups are copied. Must be called under @state_lock.
+ */
+static struct dnet_route_table *dnet_route_table_build_nolock(struct dnet_node *n, struct dnet_route_table *old)
+{
+	struct dnet_route_table *t;
+	struct dnet_route_group key;
+	const struct dnet_route_group *og;
+	struct rb_node *it;
+	struct dnet_group *g;
+	int group_num = 0, rebuilt = 0, i;
+
+	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
+		g = rb_entry(it, struct dnet_group, group_entry);
+		if (g->id_num)
+			group_num++;
+	}
+
+	t = malloc(sizeof(struct dnet_route_table) + group_num * sizeof(struct dnet_route_group));
+	if (!t)
+		return NULL;
+
+	atomic_init(&t->refcnt, 1);
+	t->version = old ? old->version + 1 : 1;
+	t->group_num = 0;
+	t->groups = (struct dnet_route_group *)(t + 1);
+
+	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
+		struct dnet_route_group *rg;
+
+		g = rb_entry(it, struct dnet_group, group_entry);
+		if (!g->id_num)
+			continue;
+
+		rg = &t->groups[t->group_num];
+
+		og = NULL;
+		if (old && !g->route_changed) {
+			key.group_id = g->group_id;
+			og = bsearch(&key, old->groups, old->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+		}
+
+		if (og) {
+			*rg = *og;
+			rg->block->refcnt++;
+		} else {
+			if (dnet_route_group_build(rg, g))
+				goto err_out_free;
+			rebuilt++;
+		}
+
+		t->group_num++;
+	}
+
+	qsort(t->groups, t->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+
+	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
+		g = rb_entry(it, struct dnet_group, group_entry);
+		g->route_changed = 0;
+	}
+
+	dnet_log(n, DNET_LOG_DEBUG, "Built routing table version: %llu, groups: %d, rebuilt groups: %d",
+			(unsigned long long)t->version, t->group_num, rebuilt);
+
+	return t;
+
+err_out_free:
+	for (i = 0; i < t->group_num; ++i)
+		dnet_route_group_ids_put(t->groups[i].block);
+	free(t);
+	return NULL;
+}
+
+/*
+ * Waits until all readers are gone and frees snapshot and its ids not shared with newer snapshot.
+ * Readers never block while holding snapshot, so the wait is short. Must be called under @state_lock.
+ */
+static void dnet_route_table_destroy(struct dnet_route_table *t)
+{
+	int i;
+
+	if (!t)
+		return;
+
+	while (atomic_read(&t->refcnt) > 1)
+		sched_yield();
+
+	for (i = 0; i < t->group_num; ++i)
+		dnet_route_group_ids_put(t->groups[i].block);
+
+	free(t);
+}
+
+/*
+ * Publishes new routing snapshot, must be called under @state_lock after every change of groups.
+ * If snapshot can not be allocated, no snapshot is published and readers fall back to @state_lock.
+ */
+static void dnet_route_table_update_nolock(struct dnet_node *n)
+{
+	struct dnet_route_table *t, *old;
+
+	/* snapshot pointer is only changed under @state_lock, so it can be read without @route_lock here */
+	t = dnet_route_table_build_nolock(n, n->route_table);
+	if (!t)
+		dnet_log(n, DNET_LOG_ERROR, "Failed to allocate routing table snapshot, lookups will use state lock");
+
+	dnet_lock_lock(&n->route_lock);
+	old = n->route_table;
+	n->route_table = t;
+	dnet_lock_unlock(&n->route_lock);
+
+	dnet_route_table_destroy(old);
+}
+
+struct dnet_route_table *dnet_route_table_get(struct dnet_node *n)
+{
+	struct dnet_route_table *t;
+
+	dnet_lock_lock(&n->route_lock);
+	t = n->route_table;
+	if (t)
+		atomic_inc(&t->refcnt);
+	dnet_lock_unlock(&n->route_lock);
+
+	return t;
+}
+
+static const struct dnet_route_table_entry *dnet_route_table_search_entry(struct dnet_route_table *t, const struct dnet_id *id)
+{
+	const struct dnet_route_group *g;
+	struct dnet_route_group key;
+	int pos;
+
+	key.group_id = id->group_id;
+	g = bsearch(&key, t->groups, t->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+	if (!g)
+		return NULL;
+
+	pos = dnet_ids_search(g->id_prefixes, g->ids, sizeof(struct dnet_route_table_entry), g->id_num, id);
+	return &g->ids[pos];
+}
+
+struct dnet_net_state *dnet_route_table_search(struct dnet_route_table *t, const struct dnet_id *id, int *backend_id)
+{
+	const struct dnet_route_table_entry *e = dnet_route_table_search_entry(t, id);
+
+	if (!e)
+		return NULL;
+
+	if (backend_id)
+		*backend_id = e->backend_id;
+
+	return dnet_state_get(e->st);
+}
+
+static void __dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
 {
 	struct dnet_idc *idc = dnet_idc_search_backend_nolock(st, backend_id);
 	if (idc) {
@@ -282,6 +625,12 @@ void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
 	}
 }
 
+void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
+{
+	__dnet_idc_remove_backend_nolock(st, backend_id);
+	dnet_route_table_update_nolock(st->n);
+}
+
 static void dnet_idc_remove_all(struct dnet_net_state *st)
 {
 	struct dnet_idc *idc;
@@ -323,6 +672,39 @@ int dnet_state_set_server_prio(struct dnet_net_state *st)
 	return err;
 }
 
+/*
+ * Merges sorted @add into sorted @ids of @num elements, which has room for all new ids.
+ * Ids from @add equal to ones already present in @ids are skipped, returns number of added ids.
+ */
+static int dnet_idc_merge_sorted(struct dnet_state_id *ids, int num, const struct dnet_state_id *add, int add_num)
+{
+	int i = num - 1, j = add_num - 1, k, cmp, added = 0;
+
+	for (k = 0; k < add_num; ++k) {
+		if (!bsearch(&add[k], ids, num, sizeof(struct dnet_state_id), dnet_idc_compare))
+			added++;
+	}
+
+	k = num + added - 1;
+	while (j >= 0) {
+		if (i >= 0) {
+			cmp = dnet_idc_compare(&ids[i], &add[j]);
+			if (cmp > 0) {
+				ids[k--] = ids[i--];
+				continue;
+			}
+			if (cmp == 0) {
+				j--;
+				continue;
+			}
+		}
+
+		ids[k--] = add[j--];
+	}
+
+	return added;
+}
+
 int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *backend)
 {
 	struct dnet_node *n = st->n;
@@ -340,9 +722,9 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 	const int remove_backend = (backend->flags & DNET_BACKEND_DISABLE);
 
 	if (remove_backend) {
-		pthread_mutex_lock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
 		dnet_idc_remove_backend_nolock(st, backend->backend_id);
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_unlock(&n->state_lock);
 
 		return 0;
 	}
@@ -361,7 +743,7 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 		sid->idc = idc;
 	}
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 
 	g = dnet_group_search(n, group_id);
 	if (!g) {
@@ -374,29 +756,31 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 			goto err_out_unlock_put;
 	}
 
-	dnet_idc_remove_backend_nolock(st, backend->backend_id);
+	__dnet_idc_remove_backend_nolock(st, backend->backend_id);
 
 	g->ids = realloc(g->ids, (g->id_num + id_num) * sizeof(struct dnet_state_id));
 	if (!g->ids) {
 		g->id_num = 0;
+		g->route_changed = 1;
+		dnet_group_update_prefixes(g);
 		goto err_out_unlock_put;
 	}
 
-	num = 0;
-	for (i=0; i<id_num; ++i) {
-		if (!bsearch(&idc->ids[i], g->ids, g->id_num, sizeof(struct dnet_state_id), dnet_idc_compare)) {
-			memcpy(&g->ids[g->id_num + num], &idc->ids[i], sizeof(struct dnet_state_id));
-			num++;
-		}
-	}
+	/*
+	 * Only received ids are sorted, then they are merged into already sorted @g->ids from the end,
+	 * ids which are already present in the group are skipped.
+	 */
+	qsort(idc->ids, id_num, sizeof(struct dnet_state_id), dnet_idc_compare);
 
+	num = dnet_idc_merge_sorted(g->ids, g->id_num, idc->ids, id_num);
 	if (!num) {
 		err = -EEXIST;
 		goto err_out_unlock_put;
 	}
 
 	g->id_num += num;
-	qsort(g->ids, g->id_num, sizeof(struct dnet_state_id), dnet_idc_compare);
+	g->route_changed = 1;
+	dnet_group_update_prefixes(g);
 
 	idc->id_num = id_num;
 	idc->st = st;
@@ -411,6 +795,8 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 
 	list_add_tail(&idc->group_entry, &g->idc_list);
 
+	dnet_route_table_update_nolock(n);
+
 	if (dnet_log_enabled(n->log, DNET_LOG_DEBUG)) {
 		for (i=0; i<g->id_num; ++i) {
 			struct dnet_state_id *id = &g->ids[i];
@@ -419,7 +805,7 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 		}
 	}
 
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	gettimeofday(&end, NULL);
 	diff = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
@@ -435,8 +821,10 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 
 err_out_unlock_put:
 	dnet_group_put(g);
+	/* old ids of this backend could be already removed */
+	dnet_route_table_update_nolock(n);
 err_out_unlock:
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 	free(idc);
 err_out_exit:
 	gettimeofday(&end, NULL);
@@ -449,32 +837,12 @@ err_out_exit:
 void dnet_idc_destroy_nolock(struct dnet_net_state *st)
 {
 	dnet_idc_remove_all(st);
+	dnet_route_table_update_nolock(st->n);
 }
 
 static int __dnet_idc_search(struct dnet_group *g, const struct dnet_id *id)
 {
-	int low, high, i, cmp;
-	struct dnet_state_id *sid;
-
-	for (low = -1, high = g->id_num; high-low > 1; ) {
-		i = low + (high - low)/2;
-		sid = &g->ids[i];
-
-		cmp = dnet_id_cmp_str(sid->raw.id, id->id);
-		if (cmp < 0)
-			low = i;
-		else if (cmp > 0)
-			high = i;
-		else
-			goto out;
-	}
-	i = high - 1;
-
-out:
-	if (i == -1)
-		i = g->id_num - 1;
-
-	return i;
+	return dnet_ids_search(g->id_prefixes, g->ids, sizeof(struct dnet_state_id), g->id_num, id);
 }
 
 static struct dnet_state_id *dnet_idc_search(struct dnet_group *g, const struct dnet_id *id)
@@ -508,11 +876,37 @@ static int dnet_search_range_nolock(struct dnet_node *n, struct dnet_id *id, str
 
 int dnet_search_range(struct dnet_node *n, struct dnet_id *id, struct dnet_raw_id *start, struct dnet_raw_id *next)
 {
+	struct dnet_route_table *t;
 	int err;
 
-	pthread_mutex_lock(&n->state_lock);
+	t = dnet_route_table_get(n);
+	if (t) {
+		const struct dnet_route_group *g;
+		struct dnet_route_group key;
+		int pos;
+
+		err = -ENXIO;
+
+		key.group_id = id->group_id;
+		g = bsearch(&key, t->groups, t->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+		if (g) {
+			pos = dnet_ids_search(g->id_prefixes, g->ids, sizeof(struct dnet_route_table_entry), g->id_num, id);
+			memcpy(start, &g->ids[pos].raw, sizeof(struct dnet_raw_id));
+
+			if (++pos >= g->id_num)
+				pos = 0;
+			memcpy(next, &g->ids[pos].raw, sizeof(struct dnet_raw_id));
+
+			err = 0;
+		}
+
+		dnet_route_table_put(t);
+		return err;
+	}
+
+	dnet_mutex_lock(&n->state_lock);
 	err = dnet_search_range_nolock(n, id, start, next);
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	return err;
 }
@@ -550,7 +944,7 @@ struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const stru
 {
 	struct dnet_net_state *st, *found = NULL;
 
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	list_for_each_entry(st, &n->dht_state_list, node_entry) {
 		if (dnet_addr_equal(&st->addr, addr)) {
 			found = st;
@@ -558,7 +952,7 @@ struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const stru
 			break;
 		}
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	return found;
 }
@@ -590,8 +984,20 @@ ssize_t dnet_state_search_backend(struct dnet_node *n, const struct dnet_id *id)
 {
 	ssize_t backend_id = -1;
 	struct dnet_state_id *sid;
+	struct dnet_route_table *t;
+
+	t = dnet_route_table_get(n);
+	if (t) {
+		const struct dnet_route_table_entry *e = dnet_route_table_search_entry(t, id);
+
+		if (e && e->st == n->st)
+			backend_id = e->backend_id;
 
-	pthread_mutex_lock(&n->state_lock);
+		dnet_route_table_put(t);
+		return backend_id;
+	}
+
+	dnet_mutex_lock(&n->state_lock);
 
 	sid = __dnet_state_search_id(n, id);
 	if (!sid) {
@@ -606,7 +1012,7 @@ ssize_t dnet_state_search_backend(struct dnet_node *n, const struct dnet_id *id)
 	if (sid && sid->idc->st == n->st)
 		backend_id = sid->idc->backend_id;
 
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 
 	return backend_id;
 }
@@ -663,13 +1069,271 @@ void dnet_update_backend_weight(struct dnet_net_state *st, const struct dnet_cmd
 	}
 }
 
+static inline int dnet_latency_bucket(long time)
+{
+	int bucket = 0;
+
+	while (time > 1 && bucket < DNET_LATENCY_BUCKETS - 1) {
+		time >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/*
+ * Accounts read which took @time microseconds.
+ * Values are updated without locks like weights above, races may only lose some samples.
+ */
+void dnet_update_backend_latency(struct dnet_net_state *st, int backend_id, long time)
+{
+	struct dnet_idc *idc;
+	int i;
+
+	if (!st)
+		return;
+
+	pthread_rwlock_rdlock(&st->idc_lock);
+	idc = dnet_idc_search_backend_nolock(st, backend_id);
+	if (idc) {
+		if (idc->latency_ewma)
+			idc->latency_ewma += ((double)time - idc->latency_ewma) / 8;
+		else
+			idc->latency_ewma = time;
+
+		atomic_inc(&idc->latency_hist[dnet_latency_bucket(time)]);
+
+		if (atomic_inc(&idc->latency_samples) >= DNET_LATENCY_WINDOW) {
+			atomic_set(&idc->latency_samples, DNET_LATENCY_WINDOW / 2);
+			for (i = 0; i < DNET_LATENCY_BUCKETS; ++i)
+				atomic_set(&idc->latency_hist[i], atomic_read(&idc->latency_hist[i]) / 2);
+		}
+	}
+	pthread_rwlock_unlock(&st->idc_lock);
+}
+
+int dnet_get_backend_latency(struct dnet_net_state *st, int backend_id, int percentile, struct dnet_backend_latency *latency)
+{
+	struct dnet_idc *idc;
+	long total = 0, sum = 0;
+	int i, err = -ENOENT;
+
+	pthread_rwlock_rdlock(&st->idc_lock);
+	idc = dnet_idc_search_backend_nolock(st, backend_id);
+	if (idc && idc->latency_ewma) {
+		err = 0;
+
+		latency->ewma = idc->latency_ewma;
+		latency->percentile = 0;
+		latency->outstanding = st->trans_table.used;
+
+		for (i = 0; i < DNET_LATENCY_BUCKETS; ++i)
+			total += atomic_read(&idc->latency_hist[i]);
+
+		for (i = 0; i < DNET_LATENCY_BUCKETS; ++i) {
+			sum += atomic_read(&idc->latency_hist[i]);
+			if (sum * 100 >= total * percentile) {
+				/* the upper bound of the bucket */
+				latency->percentile = 2L << i;
+				break;
+			}
+		}
+	}
+	pthread_rwlock_unlock(&st->idc_lock);
+
+	return err;
+}
+
+static int dnet_outlier_error(int status)
+{
+	return status == -ETIMEDOUT || status == -EIO || status == -ENOMEM;
+}
+
+static void dnet_outlier_eject(struct dnet_idc *idc, uint64_t now, const char *reason)
+{
+	if (idc->ejection_num < DNET_OUTLIER_MAX_EJECTIONS)
+		idc->ejection_num++;
+
+	idc->ejected_until = now + (uint64_t)DNET_OUTLIER_EJECTION_MS * 1000 * idc->ejection_num;
+	idc->recovery_until = idc->ejected_until + (uint64_t)DNET_OUTLIER_RECOVERY_MS * 1000;
+	atomic_set(&idc->consecutive_errors, 0);
+
+	dnet_log(idc->st->n, DNET_LOG_ERROR, "%s/%d: outlier: %s, backend is ejected for %d ms, ejections: %d",
+		dnet_state_dump_addr(idc->st), idc->backend_id, reason,
+		DNET_OUTLIER_EJECTION_MS * idc->ejection_num, idc->ejection_num);
+}
+
+/*
+ * Accounts completed request with @status, lock-free like the latency above.
+ */
+void dnet_update_backend_health(struct dnet_net_state *st, int backend_id, int status)
+{
+	struct dnet_idc *idc;
+	uint64_t now;
+
+	if (!st || !(st->n->flags & DNET_CFG_OUTLIER_STATES))
+		return;
+
+	pthread_rwlock_rdlock(&st->idc_lock);
+	idc = dnet_idc_search_backend_nolock(st, backend_id);
+	if (idc) {
+		atomic_inc(&idc->health_requests);
+
+		if (dnet_outlier_error(status)) {
+			atomic_inc(&idc->health_errors);
+
+			now = dnet_monotonic_usecs();
+			if (atomic_inc(&idc->consecutive_errors) >= DNET_OUTLIER_CONSECUTIVE_ERRORS &&
+					now >= idc->ejected_until)
+				dnet_outlier_eject(idc, now, "consecutive errors");
+		} else {
+			atomic_set(&idc->consecutive_errors, 0);
+		}
+	}
+	pthread_rwlock_unlock(&st->idc_lock);
+}
+
+int dnet_backend_deprioritized(struct dnet_net_state *st, int backend_id, uint64_t now)
+{
+	struct dnet_idc *idc;
+	int ret = 0;
+
+	pthread_rwlock_rdlock(&st->idc_lock);
+	idc = dnet_idc_search_backend_nolock(st, backend_id);
+	if (idc) {
+		if (now < idc->ejected_until)
+			ret = 1;
+		else if (now < idc->recovery_until)
+			ret = (uint64_t)rand() % ((uint64_t)DNET_OUTLIER_RECOVERY_MS * 1000) < idc->recovery_until - now;
+	}
+	pthread_rwlock_unlock(&st->idc_lock);
+
+	return ret;
+}
+
+static int dnet_outlier_latency_compare(const void *a, const void *b)
+{
+	const double first = *(const double *)a, second = *(const double *)b;
+
+	return (first > second) - (first < second);
+}
+
+/*
+ * Periodic check of error rates and latencies of all backends, resets their per-interval counters.
+ */
+void dnet_outlier_check(struct dnet_node *n)
+{
+	const uint64_t now = dnet_monotonic_usecs();
+	struct dnet_net_state *st;
+	struct dnet_idc *idc;
+	struct rb_node *it;
+	double *latencies = NULL, median = 0;
+	long requests, errors;
+	int total = 0, ejected = 0, num = 0, outlier;
+
+	dnet_mutex_lock(&n->state_lock);
+
+	list_for_each_entry(st, &n->dht_state_list, node_entry) {
+		pthread_rwlock_rdlock(&st->idc_lock);
+		for (it = rb_first(&st->idc_root); it; it = rb_next(it)) {
+			idc = rb_entry(it, struct dnet_idc, state_entry);
+
+			total++;
+			if (now < idc->ejected_until)
+				ejected++;
+		}
+		pthread_rwlock_unlock(&st->idc_lock);
+	}
+
+	if (total)
+		latencies = malloc(total * sizeof(double));
+
+	list_for_each_entry(st, &n->dht_state_list, node_entry) {
+		pthread_rwlock_rdlock(&st->idc_lock);
+		for (it = rb_first(&st->idc_root); it && latencies && num < total; it = rb_next(it)) {
+			idc = rb_entry(it, struct dnet_idc, state_entry);
+
+			if (atomic_read(&idc->health_requests) >= DNET_OUTLIER_MIN_REQUESTS && idc->latency_ewma)
+				latencies[num++] = idc->latency_ewma;
+		}
+		pthread_rwlock_unlock(&st->idc_lock);
+	}
+
+	/* latency is compared only when there are enough peers to tell an outlier */
+	if (num >= 3) {
+		qsort(latencies, num, sizeof(double), dnet_outlier_latency_compare);
+		median = latencies[num / 2];
+	}
+
+	list_for_each_entry(st, &n->dht_state_list, node_entry) {
+		pthread_rwlock_rdlock(&st->idc_lock);
+		for (it = rb_first(&st->idc_root); it; it = rb_next(it)) {
+			idc = rb_entry(it, struct dnet_idc, state_entry);
+
+			requests = atomic_read(&idc->health_requests);
+			errors = atomic_read(&idc->health_errors);
+			atomic_set(&idc->health_requests, 0);
+			atomic_set(&idc->health_errors, 0);
+
+			if (now < idc->ejected_until)
+				continue;
+
+			outlier = 0;
+			if (requests >= DNET_OUTLIER_MIN_REQUESTS) {
+				if (errors * 100 >= requests * DNET_OUTLIER_ERROR_PERCENT)
+					outlier = 1;
+				else if (median && idc->latency_ewma > median * DNET_OUTLIER_LATENCY_FACTOR)
+					outlier = 2;
+			}
+
+			if (outlier && (ejected + 1) * 100 <= total * DNET_OUTLIER_MAX_EJECTED_PERCENT) {
+				dnet_outlier_eject(idc, now, outlier == 1 ? "error rate" : "latency");
+				ejected++;
+			} else if (!outlier && idc->ejection_num && now >= idc->recovery_until) {
+				/* healthy interval makes the next ejection shorter */
+				idc->ejection_num--;
+			}
+		}
+		pthread_rwlock_unlock(&st->idc_lock);
+	}
+
+	dnet_mutex_unlock(&n->state_lock);
+
+	free(latencies);
+}
+
+int dnet_get_read_latency(struct dnet_node *n, struct dnet_id *id, int percentile, long *latency_us)
+{
+	struct dnet_backend_latency latency;
+	struct dnet_net_state *st;
+	int backend_id, err;
+
+	st = dnet_state_get_first_with_backend(n, id, &backend_id);
+	if (!st)
+		return -ENOENT;
+
+	err = dnet_get_backend_latency(st, backend_id, percentile, &latency);
+	if (!err)
+		*latency_us = latency.percentile;
+
+	dnet_state_put(st);
+	return err;
+}
+
 struct dnet_net_state *dnet_state_get_first_with_backend(struct dnet_node *n, const struct dnet_id *id, int *backend_id)
 {
 	struct dnet_net_state *found;
+	struct dnet_route_table *t;
 
-	pthread_mutex_lock(&n->state_lock);
-	found = dnet_state_search_nolock(n, id, backend_id);
-	pthread_mutex_unlock(&n->state_lock);
+	t = dnet_route_table_get(n);
+	if (t) {
+		found = dnet_route_table_search(t, id, backend_id);
+		dnet_route_table_put(t);
+	} else {
+		dnet_mutex_lock(&n->state_lock);
+		found = dnet_state_search_nolock(n, id, backend_id);
+		dnet_mutex_unlock(&n->state_lock);
+	}
 
 	if (!found) {
 		dnet_log(n, DNET_LOG_ERROR, "%s: could not find network state for request", dnet_dump_id(id));
@@ -728,6 +1392,20 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 		}
 	}
 
+	/* every shard is a net thread with its own connection to every server */
+	if (cfg->flags & DNET_CFG_JOIN_NETWORK)
+		cfg->client_shards = 0;
+	if (cfg->client_shards > 0) {
+		cfg->net_thread_num = cfg->client_shards;
+		cfg->connections_per_node = cfg->client_shards;
+	}
+
+	/* every server shard is a net thread with its own listening socket */
+	if (!(cfg->flags & DNET_CFG_JOIN_NETWORK))
+		cfg->server_shards = 0;
+	if (cfg->server_shards > 0)
+		cfg->net_thread_num = cfg->server_shards;
+
 	if (!cfg->net_thread_num) {
 		cfg->net_thread_num = 1;
 		if (cfg->flags & DNET_CFG_JOIN_NETWORK)
@@ -755,11 +1433,77 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 	n->notify_hash_size = cfg->hash_size;
 	n->check_timeout = cfg->check_timeout;
 	n->stall_count = cfg->stall_count;
+	n->net_lanes = cfg->connections_per_node;
+	n->large_request_size = cfg->large_request_size;
+	n->client_shards = cfg->client_shards > 0 ? cfg->client_shards : 0;
+	n->connect_concurrency = cfg->connect_concurrency > 0 ? cfg->connect_concurrency : 0;
+	n->server_shards = cfg->server_shards > 0 ? cfg->server_shards : 0;
+	n->recv_memory_limit = cfg->recv_memory_limit;
+	n->recv_connection_limit = cfg->recv_connection_limit;
+	n->memory.limit = cfg->memory_limit;
+	n->memory.budget[DNET_MEMORY_CACHE] = cfg->memory_cache_budget;
+	n->memory.budget[DNET_MEMORY_RECV] = cfg->memory_recv_budget;
+	n->memory.budget[DNET_MEMORY_SEND] = cfg->memory_send_budget;
+	n->stream_write_size = cfg->stream_write_size;
+	n->zerocopy_send_size = cfg->zerocopy_send_size;
+	n->nonblocking_io_steal = cfg->nonblocking_io_steal;
+	n->socket_send_buffer = cfg->socket_send_buffer;
+	n->socket_receive_buffer = cfg->socket_receive_buffer;
+	n->busy_poll_usecs = cfg->busy_poll_usecs;
+	if (cfg->route_cache_dir && *cfg->route_cache_dir) {
+		n->route_cache_dir = strdup(cfg->route_cache_dir);
+		if (!n->route_cache_dir) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+	}
+	if (cfg->local_socket_dir && *cfg->local_socket_dir) {
+		n->local_socket_dir = strdup(cfg->local_socket_dir);
+		if (!n->local_socket_dir) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+	}
+	n->wire_compression_threshold = cfg->wire_compression_threshold ? cfg->wire_compression_threshold : 4096;
+	n->short_header = cfg->short_header;
+	err = dnet_wire_compression_init(n, cfg->wire_compression_networks);
+	if (err) {
+		dnet_log_only_log(cfg->log, DNET_LOG_ERROR, "Invalid wire compression networks '%s': %d",
+				cfg->wire_compression_networks, err);
+		goto err_out_free;
+	}
+	err = dnet_net_prefix_parse(cfg->tls_networks, &n->tls_nets, &n->tls_net_num);
+	if (err) {
+		dnet_log_only_log(cfg->log, DNET_LOG_ERROR, "Invalid TLS networks '%s': %d", cfg->tls_networks, err);
+		goto err_out_free;
+	}
+	err = dnet_locality_parse(cfg->localities, &n->localities, &n->locality_num);
+	if (err) {
+		dnet_log_only_log(cfg->log, DNET_LOG_ERROR, "Invalid localities '%s': %d", cfg->localities, err);
+		goto err_out_free;
+	}
+	if (cfg->locality && *cfg->locality) {
+		n->locality = strdup(cfg->locality);
+		if (!n->locality) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+	}
+	if (n->tls_net_num) {
+		err = dnet_tls_context_create(cfg->tls_cert_file, cfg->tls_key_file, cfg->tls_ca_file, &n->tls_ctx);
+		if (err) {
+			dnet_log_only_log(cfg->log, DNET_LOG_ERROR, "Failed to create TLS context, cert: %s, key: %s, "
+					"ca: %s: %s [%d]", cfg->tls_cert_file, cfg->tls_key_file, cfg->tls_ca_file,
+					err == -EINVAL ? dnet_tls_error() : strerror(-err), err);
+			goto err_out_free;
+		}
+	}
 	n->bg_ionice_class = cfg->bg_ionice_class;
 	n->bg_ionice_prio = cfg->bg_ionice_prio;
 	n->removal_delay = cfg->removal_delay;
 	n->flags = cfg->flags;
 	n->indexes_shard_count = cfg->indexes_shard_count;
+	n->indexes_split_size = cfg->indexes_split_size;
 
 	if (!n->log)
 		dnet_log_init(n, cfg->log);
@@ -778,6 +1522,11 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 				n->check_timeout);
 	}
 
+	if (n->net_lanes < 1)
+		n->net_lanes = 1;
+	if (!n->large_request_size)
+		n->large_request_size = DNET_DEFAULT_LARGE_REQUEST_SIZE;
+
 	if (!n->stall_count) {
 		n->stall_count = DNET_DEFAULT_STALL_TRANSACTIONS;
 		dnet_log(n, DNET_LOG_NOTICE, "Using default stall count (%ld transactions).",
@@ -793,6 +1542,19 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 				n->indexes_shard_count);
 	}
 
+	if (cfg->huge_pages) {
+		/* huge pages mode is process-wide and has to be set before receive pools are created */
+		err = dnet_huge_pages_set_mode(cfg->huge_pages);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "Failed to enable huge pages mode '%s', current mode: '%s': %d",
+					dnet_huge_pages_mode_string(cfg->huge_pages),
+					dnet_huge_pages_mode_string(dnet_huge_pages_mode()), err);
+			goto err_out_free;
+		}
+
+		dnet_log(n, DNET_LOG_INFO, "Huge pages mode: %s", dnet_huge_pages_mode_string(cfg->huge_pages));
+	}
+
 	err = dnet_crypto_init(n);
 	if (err)
 		goto err_out_free;
@@ -815,6 +1577,13 @@ err_out_io_exit:
 err_out_crypto_cleanup:
 	dnet_crypto_cleanup(n);
 err_out_free:
+	dnet_tls_context_destroy(n->tls_ctx);
+	free(n->locality);
+	dnet_locality_free(n->localities, n->locality_num);
+	free(n->tls_nets);
+	free(n->wire_compression_nets);
+	free(n->route_cache_dir);
+	free(n->local_socket_dir);
 	free(n);
 err_out_exit:
 	pthread_sigmask(SIG_SETMASK, &previous_sigset, NULL);
@@ -847,10 +1616,16 @@ void dnet_node_cleanup_common_resources(struct dnet_node *n)
 {
 	struct dnet_addr_storage *it, *atmp;
 
+	dnet_recv_budget_cleanup(n);
 	dnet_io_cleanup(n);
 
 	pthread_attr_destroy(&n->attr);
+	pthread_mutex_destroy(&n->update_filter_lock);
+	pthread_mutex_destroy(&n->recv_deferred_lock);
 
+	dnet_route_table_destroy(n->route_table);
+	n->route_table = NULL;
+	dnet_lock_destroy(&n->route_lock);
 	pthread_mutex_destroy(&n->state_lock);
 	dnet_crypto_cleanup(n);
 
@@ -860,11 +1635,19 @@ void dnet_node_cleanup_common_resources(struct dnet_node *n)
 	}
 	pthread_rwlock_destroy(&n->test_settings_lock);
 	pthread_mutex_destroy(&n->reconnect_lock);
+	dnet_node_trans_timer_cleanup(n);
 
 	dnet_wait_put(n->wait);
 
 	free(n->test_settings);
 	free(n->route_addr);
+	free(n->route_cache_dir);
+	free(n->local_socket_dir);
+	free(n->wire_compression_nets);
+	dnet_tls_context_destroy(n->tls_ctx);
+	free(n->tls_nets);
+	free(n->locality);
+	dnet_locality_free(n->localities, n->locality_num);
 }
 
 void dnet_node_destroy(struct dnet_node *n)
@@ -909,6 +1692,13 @@ struct dnet_session *dnet_session_copy(struct dnet_session *s)
 	new_s->user_flags = s->user_flags;
 	new_s->direct_addr = s->direct_addr;
 	new_s->direct_backend = s->direct_backend;
+	new_s->hedge_percentile = s->hedge_percentile;
+	new_s->adaptive_percentile = s->adaptive_percentile;
+	new_s->adaptive_multiplier = s->adaptive_multiplier;
+	new_s->adaptive_min_ms = s->adaptive_min_ms;
+	new_s->background_rate_bytes = s->background_rate_bytes;
+	new_s->background_rate_keys = s->background_rate_keys;
+	new_s->iterator_threads = s->iterator_threads;
 
 	if (s->group_num > 0) {
 		err = dnet_session_set_groups(new_s, s->groups, s->group_num);
@@ -999,6 +1789,12 @@ void dnet_session_set_ioflags(struct dnet_session *s, uint32_t ioflags)
 	s->ioflags = ioflags;
 }
 
+const char *dnet_session_get_ns(struct dnet_session *s, int *nsize)
+{
+	*nsize = s->ns ? s->nsize : 0;
+	return s->ns;
+}
+
 int dnet_session_set_ns(struct dnet_session *s, const char *ns, int nsize)
 {
 	char *old = s->ns;
@@ -1055,11 +1851,76 @@ uint64_t dnet_session_get_user_flags(struct dnet_session *s)
 void dnet_session_set_timeout(struct dnet_session *s, long wait_timeout)
 {
 	s->wait_ts.tv_sec = wait_timeout;
+	s->wait_ts.tv_nsec = 0;
+}
+
+void dnet_session_set_timeout_ms(struct dnet_session *s, long wait_timeout_ms)
+{
+	s->wait_ts.tv_sec = wait_timeout_ms / 1000;
+	s->wait_ts.tv_nsec = (wait_timeout_ms % 1000) * 1000000;
+}
+
+void dnet_session_set_hedged_read(struct dnet_session *s, int percentile)
+{
+	s->hedge_percentile = percentile;
+}
+
+int dnet_session_get_hedged_read(struct dnet_session *s)
+{
+	return s->hedge_percentile;
+}
+
+void dnet_session_set_adaptive_timeout(struct dnet_session *s, int percentile, int multiplier, long min_timeout_ms)
+{
+	s->adaptive_percentile = percentile;
+	s->adaptive_multiplier = multiplier > 0 ? multiplier : 1;
+	s->adaptive_min_ms = min_timeout_ms > 0 ? min_timeout_ms : 0;
+}
+
+int dnet_session_get_adaptive_timeout_percentile(struct dnet_session *s)
+{
+	return s->adaptive_percentile;
+}
+
+int dnet_session_get_adaptive_timeout_multiplier(struct dnet_session *s)
+{
+	return s->adaptive_multiplier;
+}
+
+long dnet_session_get_adaptive_timeout_min_ms(struct dnet_session *s)
+{
+	return s->adaptive_min_ms;
+}
+
+void dnet_session_set_background_rate(struct dnet_session *s, uint64_t rate_bytes, uint64_t rate_keys)
+{
+	s->background_rate_bytes = rate_bytes;
+	s->background_rate_keys = rate_keys;
+}
+
+uint64_t dnet_session_get_background_rate_bytes(struct dnet_session *s)
+{
+	return s->background_rate_bytes;
+}
+
+uint64_t dnet_session_get_background_rate_keys(struct dnet_session *s)
+{
+	return s->background_rate_keys;
+}
+
+void dnet_session_set_iterator_threads(struct dnet_session *s, uint32_t threads)
+{
+	s->iterator_threads = threads;
+}
+
+uint32_t dnet_session_get_iterator_threads(struct dnet_session *s)
+{
+	return s->iterator_threads;
 }
 
 struct timespec *dnet_session_get_timeout(struct dnet_session *s)
 {
-	return s->wait_ts.tv_sec ? &s->wait_ts : &s->node->wait_ts;
+	return (s->wait_ts.tv_sec || s->wait_ts.tv_nsec) ? &s->wait_ts : &s->node->wait_ts;
 }
 
 void dnet_set_timeouts(struct dnet_node *n, long wait_timeout, long check_timeout)
@@ -1075,6 +1936,52 @@ void dnet_set_keepalive(struct dnet_node *n, int idle, int cnt, int interval)
 	n->keep_interval = interval;
 }
 
+void dnet_node_set_retry_budget(struct dnet_node *n, int percent)
+{
+	if (percent < 0)
+		percent = 0;
+
+	__sync_lock_test_and_set(&n->retry_tokens, DNET_RETRY_BUDGET_RESERVE * 100);
+	__sync_lock_test_and_set(&n->retry_budget_percent, percent);
+}
+
+int dnet_node_get_retry_budget(struct dnet_node *n)
+{
+	return n->retry_budget_percent;
+}
+
+void dnet_node_retry_budget_deposit(struct dnet_node *n)
+{
+	const int percent = n->retry_budget_percent;
+	long tokens;
+
+	if (!percent)
+		return;
+
+	/* unused budget is not accumulated above the reserve, so idle period does not allow retry storm */
+	do {
+		tokens = n->retry_tokens;
+		if (tokens >= DNET_RETRY_BUDGET_RESERVE * 100)
+			return;
+	} while (!__sync_bool_compare_and_swap(&n->retry_tokens, tokens, tokens + percent));
+}
+
+int dnet_node_retry_budget_withdraw(struct dnet_node *n)
+{
+	long tokens;
+
+	if (!n->retry_budget_percent)
+		return 0;
+
+	do {
+		tokens = n->retry_tokens;
+		if (tokens < 100)
+			return -EAGAIN;
+	} while (!__sync_bool_compare_and_swap(&n->retry_tokens, tokens, tokens - 100));
+
+	return 0;
+}
+
 struct dnet_node *dnet_session_get_node(struct dnet_session *s)
 {
 	return s->node;
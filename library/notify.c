@@ -44,52 +44,275 @@ struct dnet_notify_entry
 	struct dnet_net_state		*state;
 };
 
-static unsigned int dnet_notify_hash(struct dnet_id *id, unsigned int hash_size)
+struct dnet_notify_event
 {
-	unsigned int hash = 0xbb40e64d; /* 3.141592653 */
-	unsigned int i;
-	unsigned int *int_id = (unsigned int *)id->id;
+	struct list_head		event_entry;
+	struct dnet_id			id;
+	struct dnet_io_notification	notif;
+};
+
+/* replies to one state collected by the sender thread */
+struct dnet_notify_batch
+{
+	struct dnet_net_state		*state;
+	char				*data;
+	uint64_t			size;
+	uint64_t			capacity;
+};
+
+#define DNET_NOTIFY_MIN_BUCKETS		16
 
-	for (i=0; i<DNET_ID_SIZE / 4; ++i)
-		hash ^= int_id[i];
+static inline unsigned int dnet_notify_id_word(const struct dnet_id *id, int pos)
+{
+	unsigned int word;
 
-	hash %= hash_size;
-	return hash;
+	memcpy(&word, id->id + pos * sizeof(word), sizeof(word));
+	return word;
 }
 
-int dnet_update_notify(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+static struct dnet_notify_shard *dnet_notify_shard(struct dnet_notify_table *t, const struct dnet_id *id)
 {
-	HANDY_TIMER_SCOPE("io.notify.update");
+	return &t->shards[dnet_notify_id_word(id, 0) % DNET_NOTIFY_SHARDS];
+}
 
-	struct dnet_node *n = st->n;
-	unsigned int hash = dnet_notify_hash(&cmd->id, n->notify_hash_size);
-	struct dnet_notify_bucket *b = &n->notify_hash[hash];
+static struct list_head *dnet_notify_bucket(struct dnet_notify_shard *shard, const struct dnet_id *id)
+{
+	/* ids are uniformly distributed, so another word of id is already a good hash */
+	return &shard->buckets[dnet_notify_id_word(id, 1) & (shard->bucket_num - 1)];
+}
+
+static void dnet_notify_entry_destroy(struct dnet_notify_entry *e)
+{
+	dnet_state_put(e->state);
+	free(e);
+}
+
+/*
+ * Doubles number of buckets of the shard, must be called with shard lock held for writing.
+ * Failure to allocate new table is not an error, lists just become longer.
+ */
+static void dnet_notify_shard_grow_nolock(struct dnet_notify_shard *shard)
+{
+	unsigned int i, bucket_num = shard->bucket_num * 2;
+	struct dnet_notify_entry *e, *tmp;
+	struct list_head *buckets, *old = shard->buckets;
+
+	buckets = malloc(bucket_num * sizeof(struct list_head));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < bucket_num; ++i)
+		INIT_LIST_HEAD(&buckets[i]);
+
+	shard->buckets = buckets;
+	shard->bucket_num = bucket_num;
+
+	for (i = 0; i < bucket_num / 2; ++i) {
+		list_for_each_entry_safe(e, tmp, &old[i], notify_entry) {
+			list_move_tail(&e->notify_entry, dnet_notify_bucket(shard, &e->cmd.id));
+		}
+	}
+
+	free(old);
+}
+
+static int dnet_notify_batch_add(struct dnet_notify_batch **batchesp, int *num, int *capacity,
+		struct dnet_notify_entry *nt, struct dnet_io_notification *notif)
+{
+	struct dnet_notify_batch *batches = *batchesp, *b = NULL;
+	const uint64_t size = sizeof(struct dnet_cmd) + sizeof(struct dnet_io_notification);
+	struct dnet_cmd *c;
+	int i;
+
+	for (i = 0; i < *num; ++i) {
+		if (batches[i].state == nt->state) {
+			b = &batches[i];
+			break;
+		}
+	}
+
+	if (!b) {
+		if (*num == *capacity) {
+			int new_capacity = *capacity ? *capacity * 2 : 8;
+
+			batches = realloc(batches, new_capacity * sizeof(struct dnet_notify_batch));
+			if (!batches)
+				return -ENOMEM;
+
+			*batchesp = batches;
+			*capacity = new_capacity;
+		}
+
+		b = &batches[(*num)++];
+		memset(b, 0, sizeof(struct dnet_notify_batch));
+		b->state = dnet_state_get(nt->state);
+	}
+
+	if (b->size + size > b->capacity) {
+		uint64_t new_capacity = b->capacity ? b->capacity * 2 : size * 8;
+		char *data;
+
+		data = realloc(b->data, new_capacity);
+		if (!data)
+			return -ENOMEM;
+
+		b->data = data;
+		b->capacity = new_capacity;
+	}
+
+	/* the same as dnet_send_reply() with @more set */
+	c = (struct dnet_cmd *)(b->data + b->size);
+	*c = nt->cmd;
+	c->size = sizeof(struct dnet_io_notification);
+	c->flags |= DNET_FLAGS_MORE | DNET_FLAGS_REPLY;
+	c->flags &= ~DNET_FLAGS_NEED_ACK;
+	dnet_convert_cmd(c);
+
+	memcpy(c + 1, notif, sizeof(struct dnet_io_notification));
+
+	b->size += size;
+	return 0;
+}
+
+/*
+ * Removes subscriptions of states which have been reset, must be called with shard lock held for writing
+ */
+static void dnet_notify_shard_purge_nolock(struct dnet_notify_table *t, struct dnet_notify_shard *shard)
+{
+	struct dnet_notify_entry *e, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < shard->bucket_num; ++i) {
+		list_for_each_entry_safe(e, tmp, &shard->buckets[i], notify_entry) {
+			if (!e->state->__need_exit)
+				continue;
+
+			list_del(&e->notify_entry);
+			dnet_notify_entry_destroy(e);
+
+			shard->entry_num--;
+			atomic_dec(&t->entry_num);
+		}
+	}
+}
+
+static void dnet_notify_process_events(struct dnet_node *n, struct list_head *events)
+{
+	struct dnet_notify_table *t = n->notify;
+	struct dnet_notify_batch *batches = NULL;
+	struct dnet_notify_event *ev, *tmp;
 	struct dnet_notify_entry *nt;
-	struct dnet_io_attr *io = data;
-	struct dnet_io_notification notif;
+	int dirty[DNET_NOTIFY_SHARDS];
+	int i, num = 0, capacity = 0, err;
+
+	memset(dirty, 0, sizeof(dirty));
+
+	list_for_each_entry_safe(ev, tmp, events, event_entry) {
+		struct dnet_notify_shard *shard = dnet_notify_shard(t, &ev->id);
+
+		pthread_rwlock_rdlock(&shard->lock);
+		list_for_each_entry(nt, dnet_notify_bucket(shard, &ev->id), notify_entry) {
+			if (dnet_id_cmp(&ev->id, &nt->cmd.id))
+				continue;
+
+			if (nt->state->__need_exit) {
+				dirty[shard - t->shards] = 1;
+				continue;
+			}
+
+			err = dnet_notify_batch_add(&batches, &num, &capacity, nt, &ev->notif);
+			if (err)
+				dnet_log(n, DNET_LOG_ERROR, "%s: failed to queue notification: %d",
+						dnet_dump_id(&ev->id), err);
+		}
+		pthread_rwlock_unlock(&shard->lock);
+
+		list_del(&ev->event_entry);
+		free(ev);
+	}
 
-	memcpy(&notif.io, io, sizeof(struct dnet_io_attr));
-	dnet_convert_io_attr(&notif.io);
+	for (i = 0; i < num; ++i) {
+		struct dnet_notify_batch *b = &batches[i];
 
-	pthread_rwlock_rdlock(&b->notify_lock);
-	list_for_each_entry(nt, &b->notify_list, notify_entry) {
-		if (dnet_id_cmp(&cmd->id, &nt->cmd.id))
+		if (b->size) {
+			dnet_log(n, DNET_LOG_NOTICE, "sending %llu notifications to %s.",
+					(unsigned long long)(b->size / (sizeof(struct dnet_cmd) + sizeof(struct dnet_io_notification))),
+					dnet_state_dump_addr(b->state));
+			/* batch is handed over to send queue */
+			dnet_send_data_ref(b->state, NULL, 0, b->data, b->size, free, b->data);
+			b->data = NULL;
+		}
+
+		free(b->data);
+		dnet_state_put(b->state);
+	}
+	free(batches);
+
+	for (i = 0; i < DNET_NOTIFY_SHARDS; ++i) {
+		if (!dirty[i])
 			continue;
 
-		memcpy(&notif.addr, &st->addr, sizeof(struct dnet_addr));
+		pthread_rwlock_wrlock(&t->shards[i].lock);
+		dnet_notify_shard_purge_nolock(t, &t->shards[i]);
+		pthread_rwlock_unlock(&t->shards[i].lock);
+	}
+}
+
+static void *dnet_notify_sender(void *priv)
+{
+	struct dnet_node *n = priv;
+	struct dnet_notify_table *t = n->notify;
+	LIST_HEAD(events);
 
-		dnet_log(n, DNET_LOG_NOTICE, "%s: sending notification.", dnet_dump_id(&cmd->id));
-		dnet_send_reply(nt->state, &nt->cmd, &notif, sizeof(struct dnet_io_notification), 1);
+	dnet_set_name("dnet_notify");
+
+	pthread_mutex_lock(&t->queue_lock);
+	while (!t->need_exit) {
+		if (list_empty(&t->queue)) {
+			pthread_cond_wait(&t->queue_wait, &t->queue_lock);
+			continue;
+		}
+
+		/* take all queued events at once, so that replies to the same state are batched */
+		list_splice_init(&t->queue, &events);
+		pthread_mutex_unlock(&t->queue_lock);
+
+		dnet_notify_process_events(n, &events);
+
+		pthread_mutex_lock(&t->queue_lock);
 	}
-	pthread_rwlock_unlock(&b->notify_lock);
+	pthread_mutex_unlock(&t->queue_lock);
 
-	return 0;
+	return NULL;
 }
 
-static void dnet_notify_entry_destroy(struct dnet_notify_entry *e)
+int dnet_update_notify(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
 {
-	dnet_state_put(e->state);
-	free(e);
+	HANDY_TIMER_SCOPE("io.notify.update");
+
+	struct dnet_node *n = st->n;
+	struct dnet_notify_table *t = n->notify;
+	struct dnet_io_attr *io = data;
+	struct dnet_notify_event *ev;
+
+	if (!t || !atomic_read(&t->entry_num))
+		return 0;
+
+	ev = malloc(sizeof(struct dnet_notify_event));
+	if (!ev)
+		return -ENOMEM;
+
+	ev->id = cmd->id;
+	memcpy(&ev->notif.io, io, sizeof(struct dnet_io_attr));
+	dnet_convert_io_attr(&ev->notif.io);
+	memcpy(&ev->notif.addr, &st->addr, sizeof(struct dnet_addr));
+
+	pthread_mutex_lock(&t->queue_lock);
+	list_add_tail(&ev->event_entry, &t->queue);
+	pthread_cond_signal(&t->queue_wait);
+	pthread_mutex_unlock(&t->queue_lock);
+
+	return 0;
 }
 
 int dnet_notify_add(struct dnet_net_state *st, struct dnet_cmd *cmd)
@@ -97,9 +320,12 @@ int dnet_notify_add(struct dnet_net_state *st, struct dnet_cmd *cmd)
 	HANDY_TIMER_SCOPE("io.notify.add");
 
 	struct dnet_node *n = st->n;
+	struct dnet_notify_table *t = n->notify;
+	struct dnet_notify_shard *shard;
 	struct dnet_notify_entry *e;
-	unsigned int hash = dnet_notify_hash(&cmd->id, n->notify_hash_size);
-	struct dnet_notify_bucket *b = &n->notify_hash[hash];
+
+	if (!t)
+		return -ENOTSUP;
 
 	e = malloc(sizeof(struct dnet_notify_entry));
 	if (!e)
@@ -108,11 +334,19 @@ int dnet_notify_add(struct dnet_net_state *st, struct dnet_cmd *cmd)
 	e->state = dnet_state_get(st);
 	memcpy(&e->cmd, cmd, sizeof(struct dnet_cmd));
 
-	pthread_rwlock_wrlock(&b->notify_lock);
-	list_add_tail(&e->notify_entry, &b->notify_list);
-	pthread_rwlock_unlock(&b->notify_lock);
+	shard = dnet_notify_shard(t, &cmd->id);
+
+	pthread_rwlock_wrlock(&shard->lock);
+	if (shard->entry_num >= shard->bucket_num * 2)
+		dnet_notify_shard_grow_nolock(shard);
 
-	dnet_log(n, DNET_LOG_INFO, "%s: added notification, hash: 0x%x.", dnet_dump_id(&cmd->id), hash);
+	list_add_tail(&e->notify_entry, dnet_notify_bucket(shard, &cmd->id));
+	shard->entry_num++;
+	atomic_inc(&t->entry_num);
+	pthread_rwlock_unlock(&shard->lock);
+
+	dnet_log(n, DNET_LOG_INFO, "%s: added notification, shard: %ld.", dnet_dump_id(&cmd->id),
+			(long)(shard - t->shards));
 
 	return 0;
 }
@@ -122,90 +356,168 @@ int dnet_notify_remove(struct dnet_net_state *st, struct dnet_cmd *cmd)
 	HANDY_TIMER_SCOPE("io.notify.remove");
 
 	struct dnet_node *n = st->n;
-	struct dnet_notify_entry *e, *tmp;
-	unsigned int hash = dnet_notify_hash(&cmd->id, n->notify_hash_size);
-	struct dnet_notify_bucket *b = &n->notify_hash[hash];
+	struct dnet_notify_table *t = n->notify;
+	struct dnet_notify_shard *shard;
+	struct dnet_notify_entry *e, *tmp, *found = NULL;
 	int err = -ENXIO;
 
-	pthread_rwlock_wrlock(&b->notify_lock);
-	list_for_each_entry_safe(e, tmp, &b->notify_list, notify_entry) {
-		if (dnet_id_cmp(&e->cmd.id, &cmd->id))
-			continue;
+	if (!t)
+		return -ENOTSUP;
+
+	shard = dnet_notify_shard(t, &cmd->id);
 
-		e->cmd.flags = 0;
-		err = dnet_send_reply(e->state, &e->cmd, NULL, 0, 0);
+	pthread_rwlock_wrlock(&shard->lock);
+	list_for_each_entry_safe(e, tmp, dnet_notify_bucket(shard, &cmd->id), notify_entry) {
+		/* only subscriptions made over the same connection can be dropped */
+		if (e->state != st || dnet_id_cmp(&e->cmd.id, &cmd->id))
+			continue;
 
 		list_del(&e->notify_entry);
-		dnet_notify_entry_destroy(e);
+		shard->entry_num--;
+		atomic_dec(&t->entry_num);
 
-		dnet_log(n, DNET_LOG_INFO, "%s: removed notification.", dnet_dump_id(&cmd->id));
+		found = e;
 		break;
 	}
-	pthread_rwlock_unlock(&b->notify_lock);
+	pthread_rwlock_unlock(&shard->lock);
+
+	if (found) {
+		found->cmd.flags = 0;
+		err = dnet_send_reply(found->state, &found->cmd, NULL, 0, 0);
+
+		dnet_notify_entry_destroy(found);
+
+		dnet_log(n, DNET_LOG_INFO, "%s: removed notification.", dnet_dump_id(&cmd->id));
+	}
 
 	return err;
 }
 
-int dnet_notify_init(struct dnet_node *n)
+static void dnet_notify_table_destroy(struct dnet_notify_table *t, int shard_num)
 {
+	struct dnet_notify_entry *e, *tmp;
+	struct dnet_notify_event *ev, *etmp;
 	unsigned int i;
-	struct dnet_notify_bucket *b;
-	int err;
+	int s;
+
+	for (s = 0; s < shard_num; ++s) {
+		struct dnet_notify_shard *shard = &t->shards[s];
+
+		for (i = 0; i < shard->bucket_num; ++i) {
+			list_for_each_entry_safe(e, tmp, &shard->buckets[i], notify_entry) {
+				list_del(&e->notify_entry);
+				dnet_notify_entry_destroy(e);
+			}
+		}
+
+		free(shard->buckets);
+		pthread_rwlock_destroy(&shard->lock);
+	}
+
+	list_for_each_entry_safe(ev, etmp, &t->queue, event_entry) {
+		list_del(&ev->event_entry);
+		free(ev);
+	}
+
+	pthread_cond_destroy(&t->queue_wait);
+	pthread_mutex_destroy(&t->queue_lock);
+	free(t);
+}
+
+int dnet_notify_init(struct dnet_node *n)
+{
+	struct dnet_notify_table *t;
+	struct dnet_notify_shard *shard;
+	unsigned int i, bucket_num = DNET_NOTIFY_MIN_BUCKETS;
+	int s, err;
 
-	n->notify_hash = malloc(sizeof(struct dnet_notify_bucket) * n->notify_hash_size);
-	if (!n->notify_hash) {
+	while (bucket_num * DNET_NOTIFY_SHARDS < n->notify_hash_size)
+		bucket_num <<= 1;
+
+	t = calloc(1, sizeof(struct dnet_notify_table));
+	if (!t) {
 		errno = ENOMEM; /* Linux does not set errno when malloc fails */
-		dnet_log_err(n, "Failed to allocate %u notify hash buckets", n->notify_hash_size);
+		dnet_log_err(n, "Failed to allocate notify table");
 		err = -ENOMEM;
 		goto err_out_exit;
 	}
 
-	for (i=0; i<n->notify_hash_size; ++i) {
-		b = &n->notify_hash[i];
+	INIT_LIST_HEAD(&t->queue);
+
+	err = pthread_mutex_init(&t->queue_lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_free;
+	}
+
+	err = pthread_cond_init(&t->queue_wait, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_destroy_lock;
+	}
+
+	for (s = 0; s < DNET_NOTIFY_SHARDS; ++s) {
+		shard = &t->shards[s];
+
+		shard->buckets = malloc(bucket_num * sizeof(struct list_head));
+		if (!shard->buckets) {
+			err = -ENOMEM;
+			goto err_out_destroy_shards;
+		}
 
-		INIT_LIST_HEAD(&b->notify_list);
-		err = pthread_rwlock_init(&b->notify_lock, NULL);
+		err = pthread_rwlock_init(&shard->lock, NULL);
 		if (err) {
 			err = -err;
-			dnet_log(n, DNET_LOG_ERROR, "Failed to initialize %d'th bucket lock: err: %d", i, err);
-			goto err_out_free;
+			free(shard->buckets);
+			dnet_log(n, DNET_LOG_ERROR, "Failed to initialize %d'th shard lock: err: %d", s, err);
+			goto err_out_destroy_shards;
 		}
+
+		for (i = 0; i < bucket_num; ++i)
+			INIT_LIST_HEAD(&shard->buckets[i]);
+		shard->bucket_num = bucket_num;
 	}
 
-	dnet_log(n, DNET_LOG_INFO, "Successfully initialized notify hash table (%u entries).",
-			n->notify_hash_size);
+	n->notify = t;
+
+	err = pthread_create(&t->tid, NULL, dnet_notify_sender, n);
+	if (err) {
+		err = -err;
+		n->notify = NULL;
+		dnet_log(n, DNET_LOG_ERROR, "Failed to start notify sender thread: err: %d", err);
+		goto err_out_destroy_shards;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "Successfully initialized notify table (%d shards of %u buckets).",
+			DNET_NOTIFY_SHARDS, bucket_num);
 
 	return 0;
 
+err_out_destroy_shards:
+	dnet_notify_table_destroy(t, s);
+	goto err_out_exit;
+err_out_destroy_lock:
+	pthread_mutex_destroy(&t->queue_lock);
 err_out_free:
-	n->notify_hash_size = i;
-	for (i=0; i<n->notify_hash_size; ++i) {
-		b = &n->notify_hash[i];
-		pthread_rwlock_destroy(&b->notify_lock);
-	}
-	free(n->notify_hash);
+	free(t);
 err_out_exit:
 	return err;
 }
 
 void dnet_notify_exit(struct dnet_node *n)
 {
-	unsigned int i;
-	struct dnet_notify_bucket *b;
-	struct dnet_notify_entry *e, *tmp;
+	struct dnet_notify_table *t = n->notify;
 
-	for (i=0; i<n->notify_hash_size; ++i) {
-		b = &n->notify_hash[i];
+	if (!t)
+		return;
 
-		pthread_rwlock_wrlock(&b->notify_lock);
-		list_for_each_entry_safe(e, tmp, &b->notify_list, notify_entry) {
-			list_del(&e->notify_entry);
+	pthread_mutex_lock(&t->queue_lock);
+	t->need_exit = 1;
+	pthread_cond_signal(&t->queue_wait);
+	pthread_mutex_unlock(&t->queue_lock);
 
-			dnet_notify_entry_destroy(e);
-		}
-		pthread_rwlock_unlock(&b->notify_lock);
+	pthread_join(t->tid, NULL);
 
-		pthread_rwlock_destroy(&b->notify_lock);
-	}
-	free(n->notify_hash);
+	n->notify = NULL;
+	dnet_notify_table_destroy(t, DNET_NOTIFY_SHARDS);
 }
@@ -26,12 +26,35 @@
 #include <fcntl.h>
 #include <signal.h>
 
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
 #include "elliptics.h"
 #include "elliptics/interface.h"
+#include "tls.h"
 #include "../monitor/monitor.h"
 #include "../monitor/measure_points.h"
+#include "probes.h"
 #include "request_queue.h"
 
+/*
+ * Backend io pools are scaled between their min_num and num threads once per DNET_POOL_SCALE_INTERVAL_MS:
+ * pool is grown by a quarter when average queue wait time exceeds DNET_POOL_SCALE_UP_WAIT_US
+ * and none of its threads is idle, and shrunk by one thread when wait time is below
+ * DNET_POOL_SCALE_DOWN_WAIT_US and several threads are idle.
+ */
+#define DNET_POOL_SCALE_INTERVAL_MS	1000
+#define DNET_POOL_SCALE_UP_WAIT_US	5000
+#define DNET_POOL_SCALE_DOWN_WAIT_US	500
+
+/*
+ * Maximum number of queued requests per pool thread. Requests received from network
+ * for backend whose pool queue is longer are rejected with -EBUSY (background ones - at half of this limit),
+ * while overflow of system pools suspends receiving from all sockets.
+ */
+#define DNET_POOL_QUEUE_LIMIT_PER_THREAD	1000
+
 static char *dnet_work_io_mode_string[] = {
 	[DNET_WORK_IO_MODE_BLOCKING] = "BLOCKING",
 	[DNET_WORK_IO_MODE_NONBLOCKING] = "NONBLOCKING",
@@ -69,6 +92,10 @@ static void dnet_work_pool_cleanup(struct dnet_work_pool_place *place)
 
 	pthread_mutex_lock(&place->lock);
 
+	/* new requests are not stolen while the lock is held, but those already taken may be in progress */
+	while (__atomic_load_n(&place->pool->thieves, __ATOMIC_ACQUIRE))
+		usleep(1000);
+
 	for (i = 0; i < place->pool->num; ++i) {
 		wio = &place->pool->wio_list[i];
 
@@ -172,6 +199,34 @@ static void dnet_work_pool_place_cleanup(struct dnet_work_pool_place *pool)
 	pthread_mutex_destroy(&pool->lock);
 }
 
+static void dnet_work_pool_metrics_init(struct dnet_work_pool *pool)
+{
+	static const char *suffixes[__DNET_POOL_METRIC_MAX] = {
+		[DNET_POOL_METRIC_QUEUE_SIZE] = "queue.size",
+		[DNET_POOL_METRIC_QUEUE_WAIT_TIME] = "queue.wait_time",
+		[DNET_POOL_METRIC_ACTIVE_THREADS] = "active_threads",
+		[DNET_POOL_METRIC_REJECTED] = "rejected",
+		[DNET_POOL_METRIC_SEARCH_TRANS_TIME] = "search_trans_time",
+		[DNET_POOL_METRIC_STOLEN] = "stolen",
+	};
+	char pool_id[32];
+	int i;
+
+	/* Could have used dnet_work_io_mode_str() to get string name
+	 for the pool's mode, but for statistic lowercase names works better and
+	 dnet_work_io_mode_str() provides mode names in uppercase.
+	*/
+	const char *mode_marker = ((pool->mode == DNET_WORK_IO_MODE_BLOCKING) ? "blocking" : "nonblocking");
+	if (pool->io) {
+		snprintf(pool_id, sizeof(pool_id), "%zu.%s", pool->io->backend_id, mode_marker);
+	} else {
+		snprintf(pool_id, sizeof(pool_id), "sys.%s", mode_marker);
+	}
+
+	for (i = 0; i < __DNET_POOL_METRIC_MAX; ++i)
+		snprintf(pool->metrics[i], sizeof(pool->metrics[i]), "pool.%s.%s", pool_id, suffixes[i]);
+}
+
 int dnet_work_pool_alloc(struct dnet_work_pool_place *place, struct dnet_node *n,
 	struct dnet_backend_io *io, int num, int mode, void *(* process)(void *))
 {
@@ -193,12 +248,14 @@ int dnet_work_pool_alloc(struct dnet_work_pool_place *place, struct dnet_node *n
 	}
 
 	pool->num = 0;
+	pool->min_num = num;
 	pool->mode = mode;
 	pool->n = n;
 	pool->io = io;
+	dnet_work_pool_metrics_init(pool);
 
 	const int has_backend = io ? 1 : 0;
-	pool->request_queue = dnet_request_queue_create(has_backend);
+	pool->request_queue = dnet_request_queue_create(has_backend, num);
 	if (!pool->request_queue) {
 		err = -ENOMEM;
 		goto err_out_mutex_destroy;
@@ -221,6 +278,75 @@ err_out_exit:
 	return err;
 }
 
+void dnet_work_pool_set_min_threads(struct dnet_work_pool_place *place, int min_num)
+{
+	struct dnet_work_pool *pool;
+
+	pthread_mutex_lock(&place->lock);
+	pool = place->pool;
+	if (pool) {
+		if (min_num <= 0 || min_num > pool->num)
+			min_num = pool->num;
+
+		pool->min_num = min_num;
+	}
+	pthread_mutex_unlock(&place->lock);
+}
+
+static void dnet_work_pool_scale(struct dnet_backend_io *io, struct dnet_work_pool_place *place)
+{
+	struct dnet_work_pool *pool;
+	struct dnet_pool_load load;
+	int active;
+
+	pthread_mutex_lock(&place->lock);
+	pool = place->pool;
+	if (!pool || pool->min_num >= pool->num)
+		goto err_out_unlock;
+
+	dnet_get_pool_load(pool, &load);
+
+	active = load.active_threads;
+	if (load.requests && load.wait_time > DNET_POOL_SCALE_UP_WAIT_US && load.idle_threads == 0) {
+		active += (active / 4) ? : 1;
+		if (active > pool->num)
+			active = pool->num;
+	} else if (load.wait_time < DNET_POOL_SCALE_DOWN_WAIT_US && load.idle_threads > 1) {
+		if (active > pool->min_num)
+			active--;
+	}
+
+	if (active != load.active_threads) {
+		dnet_set_pool_active_threads(pool, active);
+
+		dnet_log(pool->n, DNET_LOG_INFO, "backend: %zu: scaled %s pool: %d -> %d active IO threads, "
+				"queue wait time: %llu usecs, idle threads: %d",
+				io->backend_id, dnet_work_io_mode_str(pool->mode), load.active_threads, active,
+				(unsigned long long)load.wait_time, load.idle_threads);
+	}
+
+err_out_unlock:
+	pthread_mutex_unlock(&place->lock);
+}
+
+static void dnet_io_scale_pools(void *priv, int err)
+{
+	struct dnet_node *n = priv;
+	size_t i;
+
+	if (err)
+		return;
+
+	for (i = 0; i < n->io->backends_count; ++i) {
+		struct dnet_backend_io *io = &n->io->backends[i];
+
+		dnet_work_pool_scale(io, &io->pool.recv_pool);
+		dnet_work_pool_scale(io, &io->pool.recv_pool_nb);
+	}
+
+	dnet_node_schedule_call(n, DNET_POOL_SCALE_INTERVAL_MS, dnet_io_scale_pools, n);
+}
+
 // Keep this enums in sync with enums from dnet_process_cmd_without_backend_raw
 static int dnet_cmd_needs_backend(int command)
 {
@@ -240,20 +366,6 @@ static int dnet_cmd_needs_backend(int command)
 	return 1;
 }
 
-static inline void make_thread_stat_id(char *buffer, int size, struct dnet_work_pool *pool)
-{
-	/* Could have used dnet_work_io_mode_str() to get string name
-	 for the pool's mode, but for statistic lowercase names works better and
-	 dnet_work_io_mode_str() provides mode names in uppercase.
-	*/
-	const char *mode_marker = ((pool->mode == DNET_WORK_IO_MODE_BLOCKING) ? "blocking" : "nonblocking");
-	if (pool->io) {
-		snprintf(buffer, size - 1, "%zu.%s", pool->io->backend_id, mode_marker);
-	} else {
-		snprintf(buffer, size - 1, "sys.%s", mode_marker);
-	}
-}
-
 static void dnet_update_trans_timestamp_network(struct dnet_io_req *r)
 {
 	struct dnet_net_state *st = r->st;
@@ -268,7 +380,7 @@ static void dnet_update_trans_timestamp_network(struct dnet_io_req *r)
 			dnet_trans_update_timestamp(t);
 
 			/*
-			 * Always remove transaction from 'timer' tree,
+			 * Always remove transaction from timer wheel,
 			 * thus it will not be found by checker thread and
 			 * its callback will not be called under us.
 			 */
@@ -280,16 +392,138 @@ static void dnet_update_trans_timestamp_network(struct dnet_io_req *r)
 	}
 }
 
-void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
+/*
+ * Replies with @err to request which was not queued and frees it
+ */
+static void dnet_io_req_reject(struct dnet_io_req *r, int err)
+{
+	struct dnet_net_state *st = r->st;
+	struct dnet_cmd *cmd = r->header;
+
+	// reply even if client has not asked for acknowledge, otherwise its transaction would wait for timeout
+	cmd->flags |= DNET_FLAGS_NEED_ACK;
+	dnet_send_ack(st, cmd, err, 0);
+
+	dnet_io_req_free(r);
+	dnet_state_put(st);
+}
+
+/*
+ * Returns true if backend pool @pool has no room for network request @cmd
+ */
+static int dnet_work_pool_overloaded(struct dnet_work_pool *pool, struct dnet_cmd *cmd)
+{
+	struct list_stat stats;
+	uint64_t limit = (uint64_t)pool->num * DNET_POOL_QUEUE_LIMIT_PER_THREAD;
+
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		return 0;
+
+	if (cmd->flags & DNET_FLAGS_BACKGROUND)
+		limit /= 2;
+
+	dnet_get_pool_list_stats(pool, &stats);
+	return stats.list_size >= limit;
+}
+
+static int dnet_io_numa_match(struct dnet_backend_io *io, struct dnet_backend_io *other)
+{
+	return io->numa_node < 0 || other->numa_node < 0 || io->numa_node == other->numa_node;
+}
+
+/*
+ * Calls @func for nonblocking pools of backends other than @io on the same numa node, starting from the next one,
+ * until it returns non-zero. Pools which are being stopped or are locked by others at the moment are skipped.
+ */
+static int dnet_io_for_each_sibling(struct dnet_node *n, struct dnet_backend_io *io,
+		int (* func)(struct dnet_work_pool *pool, void *priv), void *priv)
+{
+	size_t i;
+	int ret = 0;
+
+	for (i = 1; i < n->io->backends_count && !ret; ++i) {
+		struct dnet_backend_io *other = &n->io->backends[(io->backend_id + i) % n->io->backends_count];
+		struct dnet_work_pool_place *place = &other->pool.recv_pool_nb;
+
+		if (other->need_exit || !dnet_io_numa_match(io, other))
+			continue;
+
+		/* pool being stopped holds the lock while its threads are joined */
+		if (pthread_mutex_trylock(&place->lock))
+			continue;
+
+		if (place->pool)
+			ret = func(place->pool, priv);
+
+		pthread_mutex_unlock(&place->lock);
+	}
+
+	return ret;
+}
+
+static int dnet_io_wake_sibling(struct dnet_work_pool *pool, void *priv __unused)
+{
+	if (!dnet_pool_has_idle_threads(pool))
+		return 0;
+
+	dnet_wake_pool(pool);
+	return 1;
+}
+
+struct dnet_io_stolen {
+	struct dnet_io_req	*r;
+	struct dnet_work_pool	*owner;
+};
+
+static int dnet_io_steal_sibling(struct dnet_work_pool *pool, void *priv)
+{
+	struct dnet_io_stolen *stolen = priv;
+
+	stolen->r = dnet_steal_request(pool);
+	if (!stolen->r)
+		return 0;
+
+	/* pool is not destroyed until thief releases request, see dnet_work_pool_cleanup() */
+	__sync_add_and_fetch(&pool->thieves, 1);
+	stolen->owner = pool;
+	return 1;
+}
+
+/*
+ * Takes nonblocking request queued to busy nonblocking pool of other backend for idle thread @wio,
+ * @owner is set to the pool request has been taken from. Such requests do not lock keys,
+ * so any thread may process them, and CPU-bound commands are not limited by threads of single backend.
+ */
+static struct dnet_io_req *dnet_io_steal(struct dnet_work_io *wio, struct dnet_work_pool **owner)
+{
+	struct dnet_work_pool *pool = wio->pool;
+	struct dnet_io_stolen stolen = { NULL, NULL };
+
+	if (dnet_work_io_parked(wio))
+		return NULL;
+
+	if (dnet_io_for_each_sibling(pool->n, pool->io, dnet_io_steal_sibling, &stolen))
+		*owner = stolen.owner;
+
+	return stolen.r;
+}
+
+/*
+ * Puts request into the pool of its backend or into system pool.
+ * If @admit is set and backend pool is overloaded, request is rejected with -EBUSY, so one slow backend
+ * does not stall receiving requests for the others. Such requests are also rejected with -EAGAIN
+ * if their client exceeds its rate limits, see dnet_qos.
+ */
+static void dnet_schedule_io_raw(struct dnet_node *n, struct dnet_io_req *r, int admit)
 {
 	struct dnet_work_pool_place *place = NULL;
 	struct dnet_work_pool_place *backend_place = NULL;
 	struct dnet_work_pool *pool = NULL;
 	struct dnet_io_pool *io_pool = &n->io->pool;
+	struct dnet_backend_io *busy_io = NULL;
 	struct dnet_cmd *cmd = r->header;
 	int nonblocking = !!(cmd->flags & DNET_FLAGS_NOLOCK);
 	ssize_t backend_id = -1;
-	char thread_stat_id[255];
 
 	if (cmd->size > 0) {
 		dnet_log(r->st->n, DNET_LOG_DEBUG, "%s: %s: RECV cmd: %s: cmd-size: %llu, nonblocking: %d",
@@ -309,6 +543,19 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 
 	dnet_update_trans_timestamp_network(r);
 
+	if (admit && n->qos && !(cmd->flags & DNET_FLAGS_REPLY) && dnet_cmd_needs_backend(cmd->cmd)) {
+		const int err = dnet_qos_admit(n, r->st, cmd);
+		if (err) {
+			dnet_log(n, DNET_LOG_NOTICE, "%s: %s: throttling %s, size: %llu, rate limit of the client is reached",
+				dnet_state_dump_addr(r->st), dnet_dump_id(r->header), dnet_cmd_string(cmd->cmd),
+				(unsigned long long)cmd->size);
+			HANDY_COUNTER_INCREMENT("io.qos.throttled", 1);
+
+			dnet_io_req_reject(r, err);
+			return;
+		}
+	}
+
 	if (cmd->flags & DNET_FLAGS_DIRECT_BACKEND)
 		backend_id = cmd->backend_id;
 	else if (dnet_cmd_needs_backend(cmd->cmd))
@@ -346,7 +593,16 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 
 	pool = place->pool;
 
-	make_thread_stat_id(thread_stat_id, sizeof(thread_stat_id), pool);
+	if (admit && backend_place && dnet_work_pool_overloaded(pool, cmd)) {
+		pthread_mutex_unlock(&place->lock);
+
+		dnet_log(n, DNET_LOG_NOTICE, "%s: %s: backend_id: %zd: rejecting %s, io pool queue is full",
+			dnet_state_dump_addr(r->st), dnet_dump_id(r->header), backend_id, dnet_cmd_string(cmd->cmd));
+		HANDY_COUNTER_INCREMENT(dnet_pool_metric(pool, REJECTED), 1);
+
+		dnet_io_req_reject(r, -EBUSY);
+		return;
+	}
 
 	// If we are processing the command we should update cmd->backend_id to actual one
 	if (!(cmd->flags & DNET_FLAGS_REPLY)) {
@@ -354,6 +610,11 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 			cmd->backend_id = pool->io->backend_id;
 		else
 			cmd->backend_id = -1;
+
+		if (r->st) {
+			__sync_add_and_fetch(&r->st->peer_stat.inflight, 1);
+			r->peer_inflight = 1;
+		}
 	}
 
 	dnet_log(n, DNET_LOG_DEBUG, "%s: %s: backend_id: %zd, place: %p, backend_place: %p, "
@@ -362,36 +623,736 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 		backend_place && backend_place->pool->io ? (ssize_t)backend_place->pool->io->backend_id : (ssize_t)-1,
 		cmd->backend_id);
 
+	/* all threads of the backend are busy, idle thread of other backend may take the request */
+	if (nonblocking && backend_place && n->nonblocking_io_steal && !(cmd->flags & DNET_FLAGS_REPLY) &&
+	    !dnet_pool_has_idle_threads(pool))
+		busy_io = pool->io;
+
+	DNET_PROBE_CMD(request__queue, r->st, cmd, (int)(pool->io ? (ssize_t)pool->io->backend_id : (ssize_t)-1));
 	dnet_push_request(pool, r);
 
 	pthread_mutex_unlock(&place->lock);
 
-	FORMATTED(HANDY_TIMER_START, ("pool.%s.queue.wait_time", thread_stat_id), (unsigned long)&r->req_entry);
-	FORMATTED(HANDY_COUNTER_INCREMENT, ("pool.%s.queue.size", thread_stat_id), 1);
-	HANDY_COUNTER_INCREMENT("io.input.queue.size", 1);
-}
+	if (busy_io)
+		dnet_io_for_each_sibling(n, busy_io, dnet_io_wake_sibling, NULL);
+
+	HANDY_TIMER_START(dnet_pool_metric(pool, QUEUE_WAIT_TIME), (unsigned long)&r->req_entry);
+	HANDY_COUNTER_INCREMENT(dnet_pool_metric(pool, QUEUE_SIZE), 1);
+	HANDY_COUNTER_INCREMENT("io.input.queue.size", 1);
+}
+
+void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
+{
+	dnet_schedule_io_raw(n, r, 0);
+}
+
+/*
+ * Puts request created by server itself into pool of given backend.
+ * Returns -ENOENT if backend is being stopped and its pool does not exist anymore.
+ */
+int dnet_schedule_backend_io(struct dnet_backend_io *backend, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_work_pool_place *place;
+	struct dnet_work_pool *pool;
+
+	if (cmd->flags & DNET_FLAGS_NOLOCK)
+		place = &backend->pool.recv_pool_nb;
+	else
+		place = &backend->pool.recv_pool;
+
+	pthread_mutex_lock(&place->lock);
+	pool = place->pool;
+	if (!pool) {
+		pthread_mutex_unlock(&place->lock);
+		return -ENOENT;
+	}
+
+	cmd->backend_id = backend->backend_id;
+	dnet_push_request(pool, r);
+
+	pthread_mutex_unlock(&place->lock);
+
+	HANDY_TIMER_START(dnet_pool_metric(pool, QUEUE_WAIT_TIME), (unsigned long)&r->req_entry);
+	HANDY_COUNTER_INCREMENT(dnet_pool_metric(pool, QUEUE_SIZE), 1);
+	HANDY_COUNTER_INCREMENT("io.input.queue.size", 1);
+	return 0;
+}
+
+void dnet_schedule_command(struct dnet_net_state *st)
+{
+	st->rcv_flags = DNET_IO_CMD;
+	if (st->short_header_recv)
+		st->rcv_flags |= DNET_IO_SHORT;
+
+	if (st->stream_fd >= 0) {
+		/* interrupted stream leaves record uncommitted and may leave data in the pipe */
+		close(st->stream_fd);
+		st->stream_fd = -1;
+
+		if (st->stream_pipe[0] >= 0) {
+			close(st->stream_pipe[0]);
+			close(st->stream_pipe[1]);
+			st->stream_pipe[0] = st->stream_pipe[1] = -1;
+		}
+	}
+
+	if (st->rcv_data) {
+#if 0
+		struct dnet_cmd *c = &st->rcv_cmd;
+		unsigned long long tid = c->trans;
+		dnet_log(st->n, DNET_LOG_DEBUG, "freed: size: %llu, trans: %llu, reply: %d, ptr: %p.",
+						(unsigned long long)c->size, tid, tid != c->trans, st->rcv_data);
+#endif
+		dnet_io_req_free(st->rcv_data);
+		st->rcv_data = NULL;
+	}
+
+	st->rcv_end = st->short_header_recv ? DNET_SHORT_HEADER_MIN : sizeof(struct dnet_cmd);
+	st->rcv_offset = 0;
+}
+
+/*
+ * In client shard mode replies are completed by net thread which has received them,
+ * so callbacks run on the shard's CPU without queueing to io pool.
+ */
+static void dnet_process_reply_inline(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	int err;
+
+	dnet_update_trans_timestamp_network(r);
+
+	err = dnet_process_recv(NULL, st, r);
+
+	if (r->complete)
+		r->complete(r, err);
+
+	dnet_io_req_free(r);
+	dnet_state_put(st);
+}
+
+/* the largest request which server shard may process without queueing it to io pool */
+#define DNET_SERVER_SHARD_INLINE_SIZE	(64 * 1024)
+
+/*
+ * Returns true if request does not block and is cheap enough to be processed by net thread:
+ * nonblocking io served by the cache only, or lightweight command which does not need backend
+ */
+static int dnet_cmd_inline_allowed(struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		return 0;
+
+	switch (cmd->cmd) {
+	case DNET_CMD_STATUS:
+	case DNET_CMD_ROUTE_LIST:
+	case DNET_CMD_BACKEND_STATUS:
+		return 1;
+	case DNET_CMD_READ:
+	case DNET_CMD_WRITE:
+	case DNET_CMD_DEL:
+		if (!(cmd->flags & DNET_FLAGS_NOLOCK))
+			return 0;
+		if (cmd->size < sizeof(struct dnet_io_attr) || cmd->size > DNET_SERVER_SHARD_INLINE_SIZE)
+			return 0;
+		return !!(dnet_bswap64(io->flags) & DNET_IO_FLAGS_CACHE_ONLY);
+	}
+
+	return 0;
+}
+
+/*
+ * Processes request right in the net thread of server shard, which has received it.
+ * Returns false if request has to be queued to io pool as usual, since its backend
+ * is not enabled or is being reloaded.
+ */
+static int dnet_process_request_inline(struct dnet_node *n, struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_backend_io *backend = NULL;
+	ssize_t backend_id = -1;
+	int err;
+
+	if (dnet_cmd_needs_backend(cmd->cmd)) {
+		if (cmd->flags & DNET_FLAGS_DIRECT_BACKEND)
+			backend_id = cmd->backend_id;
+		else
+			backend_id = dnet_state_search_backend(n, &cmd->id);
+
+		if (backend_id < 0 || backend_id >= (ssize_t)n->io->backends_count)
+			return 0;
+
+		backend = &n->io->backends[backend_id];
+		if (backend->need_exit || !backend->cache)
+			return 0;
+
+		if (dnet_backend_gate_try_enter(&backend->gate))
+			return 0;
+	}
+
+	cmd->backend_id = backend_id;
+
+	err = dnet_process_recv(backend, st, r);
+
+	if (backend)
+		dnet_backend_gate_leave(&backend->gate);
+
+	if (r->complete)
+		r->complete(r, err);
+
+	dnet_io_req_free(r);
+	dnet_state_put(st);
+	return 1;
+}
+
+static int dnet_inline_budget_exhausted(struct dnet_inline_budget *b, uint64_t now)
+{
+	uint64_t window = now / 1000000;
+	uint64_t prev = b->window;
+
+	if (!b->limit)
+		return 1;
+
+	if (prev != window && __sync_bool_compare_and_swap(&b->window, prev, window))
+		b->used = 0;
+
+	return b->used >= b->limit;
+}
+
+/*
+ * Replies to nonblocking cache read right in net thread which has received it, while backend's budget allows.
+ * Returns false if request has to be queued to io pool: it is not a cache hit, the shard is locked by writer,
+ * backend is not available or someone else serves the key.
+ */
+static int dnet_process_cache_hit_inline(struct dnet_node *n, struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_io_attr *io = r->data;
+	struct dnet_backend_io *backend;
+	struct dnet_net_state *forward_state;
+	ssize_t backend_id;
+	uint64_t ioflags, start;
+	int err;
+
+	if (cmd->cmd != DNET_CMD_READ || (cmd->flags & DNET_FLAGS_REPLY) || !(cmd->flags & DNET_FLAGS_NOLOCK))
+		return 0;
+	if (cmd->size != sizeof(struct dnet_io_attr))
+		return 0;
+
+	ioflags = dnet_bswap64(io->flags);
+	if (!(ioflags & DNET_IO_FLAGS_CACHE) || (ioflags & DNET_IO_FLAGS_NOCACHE))
+		return 0;
+
+	if (cmd->flags & DNET_FLAGS_DIRECT_BACKEND)
+		backend_id = cmd->backend_id;
+	else
+		backend_id = dnet_state_search_backend(n, &cmd->id);
+
+	if (backend_id < 0 || backend_id >= (ssize_t)n->io->backends_count)
+		return 0;
+
+	backend = &n->io->backends[backend_id];
+	if (backend->need_exit || !backend->cache || backend->delay)
+		return 0;
+
+	start = dnet_monotonic_usecs();
+	if (dnet_inline_budget_exhausted(&backend->inline_budget, start))
+		return 0;
+
+	if (!(cmd->flags & DNET_FLAGS_DIRECT)) {
+		forward_state = dnet_state_get_first(n, &cmd->id);
+		dnet_state_put(forward_state);
+		if (!forward_state || (forward_state != st && forward_state != n->st))
+			return 0;
+	}
+
+	if (dnet_backend_gate_try_enter(&backend->gate))
+		return 0;
+
+	cmd->backend_id = backend_id;
+	err = dnet_process_cache_hit(backend, st, cmd, r->data);
+
+	dnet_backend_gate_leave(&backend->gate);
+
+	__sync_add_and_fetch(&backend->inline_budget.used, dnet_monotonic_usecs() - start);
+
+	if (err == -EAGAIN)
+		return 0;
+
+	HANDY_COUNTER_INCREMENT("io.cache_hits_inline", 1);
+
+	if (r->complete)
+		r->complete(r, 0);
+
+	dnet_io_req_free(r);
+	dnet_state_put(st);
+	return 1;
+}
+
+/*
+ * Replies -ENOENT to nonblocking read or lookup of the key which backend knows to be absent,
+ * so that misses do not wait in io pool queue behind requests which do touch the storage.
+ * Requests which may be served by backend's cache are queued as usual, cache may hold keys backend has not got yet.
+ */
+static int dnet_process_absent_inline(struct dnet_node *n, struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_io_attr *io = r->data;
+	struct dnet_backend_io *backend;
+	struct dnet_backend_callbacks *cb;
+	struct dnet_net_state *forward_state;
+	struct dnet_raw_id key;
+	ssize_t backend_id;
+	uint64_t ioflags = 0;
+	int absent;
+
+	if ((cmd->flags & DNET_FLAGS_REPLY) || !(cmd->flags & DNET_FLAGS_NOLOCK))
+		return 0;
+
+	if (cmd->cmd == DNET_CMD_READ) {
+		if (cmd->size < sizeof(struct dnet_io_attr))
+			return 0;
+
+		ioflags = dnet_bswap64(io->flags);
+		if (ioflags & DNET_IO_FLAGS_CACHE_ONLY)
+			return 0;
+
+		memcpy(key.id, io->id, DNET_ID_SIZE);
+	} else if (cmd->cmd == DNET_CMD_LOOKUP) {
+		memcpy(key.id, cmd->id.id, DNET_ID_SIZE);
+	} else {
+		return 0;
+	}
+
+	if (cmd->flags & DNET_FLAGS_DIRECT_BACKEND)
+		backend_id = cmd->backend_id;
+	else
+		backend_id = dnet_state_search_backend(n, &cmd->id);
+
+	if (backend_id < 0 || backend_id >= (ssize_t)n->io->backends_count)
+		return 0;
+
+	backend = &n->io->backends[backend_id];
+	if (backend->need_exit || backend->delay)
+		return 0;
+
+	if (backend->cache) {
+		if (cmd->cmd == DNET_CMD_READ && !(ioflags & DNET_IO_FLAGS_NOCACHE))
+			return 0;
+		if (cmd->cmd == DNET_CMD_LOOKUP && !(cmd->flags & DNET_FLAGS_NOCACHE))
+			return 0;
+	}
+
+	if (!(cmd->flags & DNET_FLAGS_DIRECT)) {
+		forward_state = dnet_state_get_first(n, &cmd->id);
+		dnet_state_put(forward_state);
+		if (!forward_state || (forward_state != st && forward_state != n->st))
+			return 0;
+	}
+
+	if (dnet_backend_gate_try_enter(&backend->gate))
+		return 0;
+
+	cb = backend->cb;
+	absent = cb && cb->key_absent && cb->key_absent(cb->command_private, &key);
+	if (absent) {
+		cmd->backend_id = backend_id;
+		dnet_process_absent_key(backend, st, cmd, r->data);
+	}
+
+	dnet_backend_gate_leave(&backend->gate);
+
+	if (!absent)
+		return 0;
+
+	HANDY_COUNTER_INCREMENT("io.absent_inline", 1);
+
+	if (r->complete)
+		r->complete(r, 0);
+
+	dnet_io_req_free(r);
+	dnet_state_put(st);
+	return 1;
+}
+
+/*
+ * Takes @size bytes of receive memory budget for the body of request received by @st.
+ * Returns -EAGAIN if the node or the connection already holds too much or memory governor
+ * reports critical pressure, state is not read until released memory lets it in.
+ * Request larger than the limit is received once nothing else is held.
+ */
+static int dnet_recv_budget_reserve(struct dnet_net_state *st, uint64_t size)
+{
+	struct dnet_node *n = st->n;
+	uint64_t used;
+
+	pthread_mutex_lock(&n->recv_deferred_lock);
+
+	used = n->recv_memory_used;
+	if (n->recv_memory_limit && used && used + size > n->recv_memory_limit)
+		goto err_out_defer;
+
+	used = st->recv_memory_used;
+	if (n->recv_connection_limit && used && used + size > n->recv_connection_limit)
+		goto err_out_defer;
+
+	/* released receive memory reschedules deferred states, so there has to be some */
+	if (n->recv_memory_used && dnet_memory_pressure(n, DNET_MEMORY_RECV) == DNET_MEMORY_PRESSURE_CRITICAL) {
+		__sync_add_and_fetch(&n->memory.recv_deferred, 1);
+		goto err_out_defer;
+	}
+
+	__sync_add_and_fetch(&n->recv_memory_used, size);
+	__sync_add_and_fetch(&st->recv_memory_used, size);
+	pthread_mutex_unlock(&n->recv_deferred_lock);
+	return 0;
+
+err_out_defer:
+	/* level-triggered socket is removed from epoll, otherwise net thread would spin on it */
+	if (st->read_s >= 0)
+		epoll_ctl(st->epoll_fd, EPOLL_CTL_DEL, st->read_s, NULL);
+
+	if (list_empty(&st->recv_deferred_entry)) {
+		list_add_tail(&st->recv_deferred_entry, &n->recv_deferred_list);
+		dnet_state_get(st);
+	}
+	pthread_mutex_unlock(&n->recv_deferred_lock);
+
+	HANDY_COUNTER_INCREMENT("io.recv_deferred", 1);
+	dnet_log(n, DNET_LOG_DEBUG, "%s: receive of %llu bytes is deferred, node holds: %llu, connection holds: %llu",
+			dnet_state_dump_addr(st), (unsigned long long)size,
+			(unsigned long long)n->recv_memory_used, (unsigned long long)st->recv_memory_used);
+	return -EAGAIN;
+}
+
+/*
+ * Moves all deferred states into @list, so they are scheduled without the lock being held
+ */
+static void dnet_recv_budget_take_deferred(struct dnet_node *n, struct list_head *list)
+{
+	pthread_mutex_lock(&n->recv_deferred_lock);
+	list_splice_init(&n->recv_deferred_list, list);
+	pthread_mutex_unlock(&n->recv_deferred_lock);
+}
+
+void dnet_recv_budget_release(struct dnet_io_req *r)
+{
+	struct dnet_net_state *st = r->recv_st, *tmp;
+	struct dnet_node *n = st->n;
+	LIST_HEAD(deferred);
+
+	pthread_mutex_lock(&n->recv_deferred_lock);
+	__sync_sub_and_fetch(&n->recv_memory_used, r->recv_reserved);
+	__sync_sub_and_fetch(&st->recv_memory_used, r->recv_reserved);
+	pthread_mutex_unlock(&n->recv_deferred_lock);
+
+	r->recv_st = NULL;
+	r->recv_reserved = 0;
+	dnet_state_put(st);
+
+	/* deferred states try to take memory again, those which still do not fit are deferred once more */
+	dnet_recv_budget_take_deferred(n, &deferred);
+
+	list_for_each_entry_safe(st, tmp, &deferred, recv_deferred_entry) {
+		list_del_init(&st->recv_deferred_entry);
+		dnet_schedule_recv(st);
+		dnet_state_put(st);
+	}
+}
+
+void dnet_recv_budget_cleanup(struct dnet_node *n)
+{
+	struct dnet_net_state *st, *tmp;
+	LIST_HEAD(deferred);
+
+	dnet_recv_budget_take_deferred(n, &deferred);
+
+	list_for_each_entry_safe(st, tmp, &deferred, recv_deferred_entry) {
+		list_del_init(&st->recv_deferred_entry);
+		dnet_state_put(st);
+	}
+}
+
+/*
+ * Write which is large enough to be streamed into the backend, whether it really is
+ * becomes known once its io attribute is received, see dnet_recv_stream_prepare()
+ */
+static int dnet_recv_stream_candidate(struct dnet_node *n, struct dnet_cmd *c)
+{
+	return n->stream_write_size && c->cmd == DNET_CMD_WRITE && !(c->flags & (DNET_FLAGS_REPLY | DNET_FLAGS_COMPRESSED)) &&
+		c->size > sizeof(struct dnet_io_attr) && c->size >= n->stream_write_size;
+}
+
+/*
+ * Asks backend to reserve space for the body of write @r and sets @st up to move it there.
+ * Only plain write of the whole record served by this node is streamed, and only into backend
+ * without cache and record filters: they need the data itself. Returns -ENOTSUP if write has to be buffered.
+ */
+static int dnet_recv_stream_prepare(struct dnet_node *n, struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	static const uint64_t unsupported = DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PREPARE | DNET_IO_FLAGS_COMMIT |
+		DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY |
+		DNET_IO_FLAGS_COMPARE_AND_SWAP | DNET_IO_FLAGS_CAS_TIMESTAMP;
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_io_attr io = *(struct dnet_io_attr *)r->data;
+	struct dnet_backend_io *backend;
+	struct dnet_net_state *forward_state;
+	ssize_t backend_id;
+	uint64_t offset;
+	int err, fd;
+
+	dnet_convert_io_attr(&io);
+
+	if (io.offset || (io.flags & unsupported) || io.size != cmd->size - sizeof(struct dnet_io_attr))
+		return -ENOTSUP;
+
+	if (cmd->flags & DNET_FLAGS_DIRECT_BACKEND)
+		backend_id = cmd->backend_id;
+	else
+		backend_id = dnet_state_search_backend(n, &cmd->id);
+
+	if (backend_id < 0 || backend_id >= (ssize_t)n->io->backends_count)
+		return -ENOTSUP;
+
+	backend = &n->io->backends[backend_id];
+	if (backend->need_exit || backend->read_only || backend->cache || backend->record_filters)
+		return -ENOTSUP;
+
+	if (!(cmd->flags & DNET_FLAGS_DIRECT)) {
+		forward_state = dnet_state_get_first(n, &cmd->id);
+		dnet_state_put(forward_state);
+		if (!forward_state || (forward_state != st && forward_state != n->st))
+			return -ENOTSUP;
+	}
+
+	if (dnet_backend_gate_try_enter(&backend->gate))
+		return -ENOTSUP;
+
+	err = -ENOTSUP;
+	if (backend->cb && backend->cb->write_stream_prepare)
+		err = backend->cb->write_stream_prepare(backend->cb->command_private, &io, &fd, &offset);
+
+	dnet_backend_gate_leave(&backend->gate);
+
+	if (err)
+		return err;
+
+	/* commit has to reach the same backend whatever routes are by then */
+	cmd->flags |= DNET_FLAGS_DIRECT_BACKEND;
+	cmd->backend_id = backend_id;
+
+	st->stream_fd = fd;
+	st->stream_offset = offset;
+	return 0;
+}
+
+/*
+ * Turns streamed write @r into commit of the data placed by the net thread
+ */
+static void dnet_recv_stream_commit(struct dnet_io_req *r)
+{
+	struct dnet_cmd *cmd = r->header;
+	struct dnet_io_attr *io = r->data;
+
+	dnet_convert_io_attr(io);
+	io->flags |= DNET_IO_FLAGS_PLAIN_WRITE | DNET_IO_FLAGS_COMMIT;
+	io->num = io->size;
+	io->size = 0;
+	dnet_convert_io_attr(io);
+
+	cmd->size = sizeof(struct dnet_io_attr);
+	r->dsize = sizeof(struct dnet_io_attr);
+}
+
+/*
+ * Moves body of streamed write into the backend's file, returns -EAGAIN until all of it is there
+ */
+static int dnet_recv_stream(struct dnet_net_state *st)
+{
+	int err;
+
+	while (st->rcv_offset != st->rcv_end) {
+		err = dnet_recvfile(st, st->stream_fd, &st->stream_offset, st->rcv_end - st->rcv_offset);
+		if (err < 0) {
+			if (err != -EAGAIN)
+				dnet_log(st->n, DNET_LOG_ERROR, "%s: failed to stream write body, socket: %d/%d: %s [%d]",
+						dnet_state_dump_addr(st), st->read_s, st->write_s, strerror(-err), err);
+			return err;
+		}
+
+		st->rcv_offset += err;
+		__sync_add_and_fetch(&st->peer_stat.recv_bytes, err);
+	}
+
+	close(st->stream_fd);
+	st->stream_fd = -1;
+	st->rcv_flags &= ~DNET_IO_STREAM;
+	return 0;
+}
+
+/*
+ * Write attribute is received: either starts streaming the body or continues receiving it into memory
+ */
+static int dnet_recv_stream_start(struct dnet_net_io *nio, struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_io_req *r = st->rcv_data, *full;
+	struct dnet_cmd *c = r->header;
+	int err;
+
+	st->rcv_flags &= ~DNET_IO_STREAM_ATTR;
+
+	err = dnet_recv_stream_prepare(n, st, r);
+	if (!err) {
+		/* body is not held in memory, other connections may take its budget */
+		if (r->recv_st)
+			dnet_recv_budget_release(r);
+
+		HANDY_COUNTER_INCREMENT("io.recv_streamed", 1);
+		st->rcv_flags |= DNET_IO_STREAM;
+		st->rcv_offset = 0;
+		st->rcv_end = c->size - sizeof(struct dnet_io_attr);
+		return 0;
+	}
+
+	/* failed write is buffered as usual, so that client gets the error from the backend */
+	if (err != -ENOTSUP)
+		dnet_log(n, DNET_LOG_NOTICE, "%s: %s: streaming is not available, write is buffered: %s [%d]",
+				dnet_dump_id(&c->id), dnet_state_dump_addr(st), strerror(-err), err);
+
+	full = dnet_slab_alloc(nio->recv_pool, c->size + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
+	if (!full)
+		return -ENOMEM;
+
+	memcpy(full, r, st->rcv_end);
+	full->header = full + 1;
+	full->data = full->header + sizeof(struct dnet_cmd);
+	full->dsize = c->size;
+
+	/* budget has been reserved for the whole body and moves to the new request */
+	r->recv_st = NULL;
+	dnet_io_req_free(r);
+
+	st->rcv_data = full;
+	st->rcv_end = sizeof(struct dnet_io_req) + sizeof(struct dnet_cmd) + full->dsize;
+	return 0;
+}
+
+/*
+ * Restores payload of command compressed by the peer, see DNET_FLAGS_COMPRESSED.
+ * Memory budget reserved for the compressed payload grows to its original size.
+ */
+static int dnet_recv_decompress(struct dnet_net_io *nio, struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_io_req *r = st->rcv_data;
+	struct dnet_cmd *c = r->header;
+#ifdef HAVE_LZ4
+	struct dnet_io_req *full;
+	uint64_t size;
+	int err;
+
+	if (c->size < sizeof(uint64_t))
+		goto err_out_corrupted;
+
+	memcpy(&size, r->data, sizeof(uint64_t));
+	size = dnet_bswap64(size);
+	if (size > LZ4_MAX_INPUT_SIZE)
+		goto err_out_corrupted;
+
+	full = dnet_slab_alloc(nio->recv_pool, size + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
+	if (!full)
+		return -ENOMEM;
+
+	memcpy(full, r, sizeof(struct dnet_io_req) + sizeof(struct dnet_cmd));
+	full->header = full + 1;
+	full->data = full->header + sizeof(struct dnet_cmd);
+	full->dsize = size;
+
+	err = LZ4_decompress_safe(r->data + sizeof(uint64_t), full->data, c->size - sizeof(uint64_t), size);
+	if (err < 0 || (uint64_t)err != size) {
+		dnet_slab_free(full);
+		goto err_out_corrupted;
+	}
+
+	__sync_add_and_fetch(&st->peer_stat.recv_compress_orig, size);
+	__sync_add_and_fetch(&st->peer_stat.recv_compress_wire, c->size);
+
+	c = full->header;
+	c->size = size;
+	c->flags &= ~DNET_FLAGS_COMPRESSED;
+
+	/* reservation moves to the new request, it is not deferred: compressed payload is received already */
+	if (full->recv_st && size > full->recv_reserved) {
+		pthread_mutex_lock(&n->recv_deferred_lock);
+		__sync_add_and_fetch(&n->recv_memory_used, size - full->recv_reserved);
+		__sync_add_and_fetch(&full->recv_st->recv_memory_used, size - full->recv_reserved);
+		pthread_mutex_unlock(&n->recv_deferred_lock);
+		full->recv_reserved = size;
+	}
+
+	r->recv_st = NULL;
+	dnet_io_req_free(r);
+
+	st->rcv_data = full;
+	return 0;
+
+err_out_corrupted:
+#else
+	(void) nio;
+#endif
+	dnet_log(n, DNET_LOG_ERROR, "%s: %s: failed to decompress payload of %llu bytes, trans: %llu",
+			dnet_state_dump_addr(st), dnet_cmd_string(c->cmd),
+			(unsigned long long)c->size, (unsigned long long)c->trans);
+	return -EPROTO;
+}
+
+/*
+ * Header of each message starts with length byte once short headers are enabled.
+ * The least header is read first, then either the rest of short header or ordinary command.
+ */
+static int dnet_recv_short_header(struct dnet_net_state *st)
+{
+	const unsigned int size = st->rcv_short[0];
+	int err;
+
+	if (!size) {
+		memcpy(&st->rcv_cmd, st->rcv_short + 1, DNET_SHORT_HEADER_MIN - 1);
+		st->rcv_flags &= ~DNET_IO_SHORT;
+		st->rcv_offset = DNET_SHORT_HEADER_MIN - 1;
+		st->rcv_end = sizeof(struct dnet_cmd);
+		return 0;
+	}
+
+	if (size < DNET_SHORT_HEADER_MIN - 1 || size >= DNET_SHORT_HEADER_MAX) {
+		err = -EPROTO;
+		goto err_out_exit;
+	}
+
+	if (st->rcv_end < 1 + size) {
+		st->rcv_end = 1 + size;
+		return 0;
+	}
 
+	err = dnet_short_header_decode(st->rcv_short + 1, size, &st->rcv_cmd, &st->rcv_short_key);
+	if (err)
+		goto err_out_exit;
 
-void dnet_schedule_command(struct dnet_net_state *st)
-{
-	st->rcv_flags = DNET_IO_CMD;
+	/* the same byte order as ordinary command has on the wire */
+	dnet_convert_cmd(&st->rcv_cmd);
 
-	if (st->rcv_data) {
-#if 0
-		struct dnet_cmd *c = &st->rcv_cmd;
-		unsigned long long tid = c->trans;
-		dnet_log(st->n, DNET_LOG_DEBUG, "freed: size: %llu, trans: %llu, reply: %d, ptr: %p.",
-						(unsigned long long)c->size, tid, tid != c->trans, st->rcv_data);
-#endif
-		free(st->rcv_data);
-		st->rcv_data = NULL;
-	}
+	st->rcv_flags &= ~DNET_IO_SHORT;
+	st->rcv_offset = st->rcv_end = sizeof(struct dnet_cmd);
+	return 0;
 
-	st->rcv_end = sizeof(struct dnet_cmd);
-	st->rcv_offset = 0;
+err_out_exit:
+	dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid short header: size: %u", dnet_state_dump_addr(st), size);
+	return err;
 }
 
-static int dnet_process_recv_single(struct dnet_net_state *st)
+static int dnet_process_recv_single(struct dnet_net_io *nio, struct dnet_net_state *st)
 {
 	struct dnet_node *n = st->n;
 	struct dnet_io_req *r;
@@ -401,10 +1362,21 @@ static int dnet_process_recv_single(struct dnet_net_state *st)
 
 	dnet_node_set_trace_id(n->log, st->rcv_cmd.trace_id, st->rcv_cmd.flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
 again:
+	if (st->rcv_flags & DNET_IO_STREAM) {
+		err = dnet_recv_stream(st);
+		if (err)
+			goto out;
+
+		dnet_recv_stream_commit(st->rcv_data);
+		goto out_schedule;
+	}
+
 	/*
 	 * Reading command first.
 	 */
-	if (st->rcv_flags & DNET_IO_CMD)
+	if (st->rcv_flags & DNET_IO_SHORT)
+		data = st->rcv_short;
+	else if (st->rcv_flags & DNET_IO_CMD)
 		data = &st->rcv_cmd;
 	else
 		data = st->rcv_data;
@@ -441,26 +1413,69 @@ again:
 	if (st->rcv_offset != st->rcv_end)
 		goto again;
 
+	if (st->rcv_flags & DNET_IO_SHORT) {
+		err = dnet_recv_short_header(st);
+		if (err)
+			goto out;
+
+		goto again;
+	}
+
 	if (st->rcv_flags & DNET_IO_CMD) {
 		unsigned long long tid;
 		struct dnet_cmd *c = &st->rcv_cmd;
+		uint64_t body = c->size;
+		int reserve;
+
+		/* deferred command has been converted already */
+		if (!(st->rcv_flags & DNET_IO_DEFERRED)) {
+			dnet_convert_cmd(c);
+
+			tid = c->trans;
 
-		dnet_convert_cmd(c);
+			dnet_log(n, DNET_LOG_DEBUG, "%s: %s: received trans: %llu <- %s/%d: "
+					"size: %llu, cflags: %s, status: %d.",
+					dnet_dump_id(&c->id), dnet_cmd_string(c->cmd), tid,
+					dnet_state_dump_addr(st), c->backend_id,
+					(unsigned long long)c->size, dnet_flags_dump_cflags(c->flags), c->status);
+		}
 
-		tid = c->trans;
+		/*
+		 * Replies are not limited: io threads which hold memory may wait for them
+		 */
+		reserve = c->size && !(c->flags & DNET_FLAGS_REPLY) &&
+			(n->recv_memory_limit || n->recv_connection_limit || dnet_memory_enabled(n));
+		if (reserve) {
+			err = dnet_recv_budget_reserve(st, c->size);
+			if (err) {
+				st->rcv_flags |= DNET_IO_DEFERRED;
+				goto out;
+			}
+		}
+		st->rcv_flags &= ~DNET_IO_DEFERRED;
 
-		dnet_log(n, DNET_LOG_DEBUG, "%s: %s: received trans: %llu <- %s/%d: "
-				"size: %llu, cflags: %s, status: %d.",
-				dnet_dump_id(&c->id), dnet_cmd_string(c->cmd), tid,
-				dnet_state_dump_addr(st), c->backend_id,
-				(unsigned long long)c->size, dnet_flags_dump_cflags(c->flags), c->status);
+		/* only io attribute is received until it is known whether the body may be streamed */
+		if (dnet_recv_stream_candidate(n, c)) {
+			body = sizeof(struct dnet_io_attr);
+			st->rcv_flags |= DNET_IO_STREAM_ATTR;
+		}
 
-		r = malloc(c->size + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
+		r = dnet_slab_alloc(nio->recv_pool, body + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
 		if (!r) {
+			if (reserve) {
+				__sync_sub_and_fetch(&n->recv_memory_used, c->size);
+				__sync_sub_and_fetch(&st->recv_memory_used, c->size);
+			}
 			err = -ENOMEM;
 			goto out;
 		}
 		memset(r, 0, sizeof(struct dnet_io_req));
+		r->slab = 1;
+
+		if (reserve) {
+			r->recv_reserved = c->size;
+			r->recv_st = dnet_state_get(st);
+		}
 
 		r->header = r + 1;
 		r->hsize = sizeof(struct dnet_cmd);
@@ -468,12 +1483,12 @@ again:
 
 		st->rcv_data = r;
 		st->rcv_offset = sizeof(struct dnet_io_req) + sizeof(struct dnet_cmd);
-		st->rcv_end = st->rcv_offset + c->size;
+		st->rcv_end = st->rcv_offset + body;
 		st->rcv_flags &= ~DNET_IO_CMD;
 
 		if (c->size) {
 			r->data = r->header + sizeof(struct dnet_cmd);
-			r->dsize = c->size;
+			r->dsize = body;
 
 			/*
 			 * We read the command header, now get the data.
@@ -482,14 +1497,46 @@ again:
 		}
 	}
 
+	if (st->rcv_flags & DNET_IO_STREAM_ATTR) {
+		err = dnet_recv_stream_start(nio, st);
+		if (err)
+			goto out;
+
+		goto again;
+	}
+
+out_schedule:
 	r = st->rcv_data;
+	__sync_add_and_fetch(&st->peer_stat.recv_bytes, r->hsize + r->dsize);
+
+	if (((struct dnet_cmd *)r->header)->flags & DNET_FLAGS_COMPRESSED) {
+		err = dnet_recv_decompress(nio, st);
+		if (err)
+			goto out;
+
+		r = st->rcv_data;
+	}
+
 	st->rcv_data = NULL;
 
+	/* the next header is short already, peer has switched right after this reply */
+	if (st->short_header_asked && !st->short_header_recv && dnet_short_header_confirmed(r->header, r->data)) {
+		st->short_header_recv = 1;
+		dnet_log(n, DNET_LOG_INFO, "%s: receiving short headers", dnet_state_dump_addr(st));
+	}
+
+	DNET_PROBE_CMD(request__receive, st, (struct dnet_cmd *)r->header, (unsigned long long)(r->hsize + r->dsize));
+
 	dnet_schedule_command(st);
 
 	r->st = dnet_state_get(st);
 
-	dnet_schedule_io(n, r);
+	if (n->client_shards && (((struct dnet_cmd *)r->header)->flags & DNET_FLAGS_REPLY))
+		dnet_process_reply_inline(st, r);
+	else if (!dnet_process_cache_hit_inline(n, st, r) && !dnet_process_absent_inline(n, st, r) &&
+			(!n->server_shards || !dnet_cmd_inline_allowed(r->header, r->data) ||
+			 !dnet_process_request_inline(n, st, r)))
+		dnet_schedule_io_raw(n, r, 1);
 	dnet_node_unset_trace_id();
 	return 0;
 
@@ -558,10 +1605,33 @@ int dnet_local_addr_index(struct dnet_node *n, struct dnet_addr *addr)
 	return -1;
 }
 
+/*
+ * Co-located clients connected to unix socket have no address, they are seen as loopback one
+ */
+static void dnet_loopback_addr(struct dnet_addr *addr, int family)
+{
+	memset(addr, 0, sizeof(struct dnet_addr));
+	addr->family = family;
+
+	if (family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr->addr;
+
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_addr = in6addr_loopback;
+		addr->addr_len = sizeof(struct sockaddr_in6);
+	} else {
+		struct sockaddr_in *sin = (struct sockaddr_in *)addr->addr;
+
+		sin->sin_family = AF_INET;
+		sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr->addr_len = sizeof(struct sockaddr_in);
+	}
+}
+
 int dnet_state_accept_process(struct dnet_net_state *orig, struct epoll_event *ev __unused)
 {
 	struct dnet_node *n = orig->n;
-	int err, cs, idx;
+	int err, cs, idx, local;
 	struct dnet_addr addr, saddr;
 	struct dnet_net_state *st;
 	socklen_t salen;
@@ -591,21 +1661,45 @@ int dnet_state_accept_process(struct dnet_net_state *orig, struct epoll_event *e
 		exit(err);
 	}
 
-	addr.family = orig->addr.family;
-	addr.addr_len = salen;
+	local = ((struct sockaddr *)addr.addr)->sa_family == AF_UNIX;
+	if (local) {
+		dnet_loopback_addr(&addr, orig->addr.family);
+	} else {
+		addr.family = orig->addr.family;
+		addr.addr_len = salen;
 
-	try_to_unmap_ipv4(&addr);
+		try_to_unmap_ipv4(&addr);
+	}
 
 	dnet_set_sockopt(n, cs);
 
-	err = dnet_socket_local_addr(cs, &saddr);
-	if (err) {
-		dnet_log(n, DNET_LOG_ERROR, "%s: failed to resolve server addr for connected client: %s [%d]",
-				dnet_addr_string_raw(&addr, client_addr, sizeof(client_addr)), strerror(-err), -err);
-		goto err_out_exit;
+	/* connections are long-lived, so handshake is made right here instead of being a state of every connection */
+	if (!local && dnet_tls_match(n, &addr)) {
+		err = dnet_tls_handshake_wait(n->tls_ctx, cs, 1, DNET_TLS_HANDSHAKE_TIMEOUT_MS);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: TLS handshake with client failed: %s: %s [%d]",
+					dnet_addr_string_raw(&addr, client_addr, sizeof(client_addr)),
+					dnet_tls_error(), strerror(-err), err);
+			close(cs);
+			err = -EAGAIN;
+			goto err_out_exit;
+		}
 	}
 
-	idx = dnet_local_addr_index(n, &saddr);
+	if (local) {
+		/* unix listening state is created for one of server addresses, see dnet_config::local_socket_dir */
+		saddr = orig->addr;
+		idx = orig->idx;
+	} else {
+		err = dnet_socket_local_addr(cs, &saddr);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: failed to resolve server addr for connected client: %s [%d]",
+					dnet_addr_string_raw(&addr, client_addr, sizeof(client_addr)), strerror(-err), -err);
+			goto err_out_exit;
+		}
+
+		idx = dnet_local_addr_index(n, &saddr);
+	}
 
 	st = dnet_state_create(n, NULL, 0, &addr, cs, &err, 0, 0, idx, 0, NULL, 0);
 	if (!st) {
@@ -646,53 +1740,169 @@ void dnet_unschedule_all(struct dnet_net_state *st)
 		epoll_ctl(st->epoll_fd, EPOLL_CTL_DEL, st->accept_s, NULL);
 }
 
+static void dnet_process_send_complete(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd tmp, *cmd = dnet_io_req_cmd(r, &tmp);
+
+	if (cmd) {
+		DNET_PROBE_CMD(request__sent, st, cmd, (unsigned long long)(r->hsize + r->dsize + r->fsize));
+
+		dnet_node_set_trace_id(st->n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
+		dnet_log(st->n, DNET_LOG_INFO, "%s: %s: sent trans: %lld -> %s/%d: size: %llu, cflags: %s, total-size: %zd",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
+			dnet_addr_string(&st->addr), cmd->backend_id,
+			(unsigned long long)cmd->size, dnet_flags_dump_cflags(cmd->flags),
+			r->hsize + r->dsize + r->fsize);
+
+		/* only replies are timed, they are the last stage of requests processed by this node */
+		if (r->queue_time && (cmd->flags & DNET_FLAGS_REPLY)) {
+			uint64_t stages[__DNET_IO_STAGE_MAX];
+			int i;
+
+			for (i = 0; i < __DNET_IO_STAGE_MAX; ++i)
+				stages[i] = DNET_IO_STAGE_NONE;
+			stages[DNET_IO_STAGE_SEND] = dnet_monotonic_usecs() - r->queue_time;
+
+			dnet_monitor_stages_update(st->n, cmd, stages);
+		}
+		dnet_node_unset_trace_id();
+	}
+
+	dnet_mutex_lock(&st->send_lock);
+	list_del(&r->req_entry);
+	dnet_mutex_unlock(&st->send_lock);
+
+	pthread_mutex_lock(&st->n->io->full_lock);
+	list_stat_size_decrease(&st->n->io->output_stats, 1);
+	pthread_mutex_unlock(&st->n->io->full_lock);
+	HANDY_COUNTER_DECREMENT("io.output.queue.size", 1);
+
+	if (atomic_read(&st->send_queue_size) > 0)
+		if (atomic_dec(&st->send_queue_size) == DNET_SEND_WATERMARK_LOW) {
+			dnet_log(st->n, DNET_LOG_DEBUG,
+					"State low_watermark reached: %s: %ld, waking up",
+					dnet_addr_string(&st->addr),
+					atomic_read(&st->send_queue_size));
+			pthread_cond_broadcast(&st->send_wait);
+		}
+
+	st->send_offset = 0;
+
+	/* kernel still references pages of the request, it is freed by dnet_state_zerocopy_complete() */
+	if (r->zerocopy) {
+		r->zerocopy_seq = st->zerocopy_seq;
+		list_add_tail(&r->req_entry, &st->zerocopy_list);
+		return;
+	}
+
+	dnet_io_req_free(r);
+}
+
+void dnet_output_stats_increase(struct dnet_node *n, int num)
+{
+	pthread_mutex_lock(&n->io->full_lock);
+	list_stat_size_increase(&n->io->output_stats, num);
+	pthread_mutex_unlock(&n->io->full_lock);
+	HANDY_COUNTER_INCREMENT("io.output.queue.size", num);
+}
+
+/*
+ * Sends queued requests: headers and data of several consecutive requests are gathered
+ * into single sendmsg() call, file parts are sent by sendfile().
+ *
+ * Network thread is the only one who removes requests from the send list,
+ * so requests collected under @send_lock stay valid after it is dropped.
+ *
+ * When the queue is empty, send event is unscheduled and @send_scheduled is cleared,
+ * inbox is checked once again after that, since producer could have pushed a request
+ * while the flag was still set.
+ */
 static int dnet_process_send_single(struct dnet_net_state *st)
 {
-	struct dnet_io_req *r = NULL;
+	struct dnet_io_req *reqs[DNET_SEND_BATCH_MAX];
+	struct dnet_io_req *r;
+	size_t mem_size, left;
+	ssize_t sent;
+	int num, more, i;
 	int err;
 
 	while (1) {
-		r = NULL;
+		num = 0;
+		more = 0;
+
+		dnet_mutex_lock(&st->send_lock);
+		dnet_send_inbox_drain_nolock(st);
+		list_for_each_entry(r, &st->send_list, req_entry) {
+			if (num == DNET_SEND_BATCH_MAX) {
+				more = 1;
+				break;
+			}
 
-		pthread_mutex_lock(&st->send_lock);
-		if (!list_empty(&st->send_list)) {
-			r = list_first_entry(&st->send_list, struct dnet_io_req, req_entry);
-		} else {
+			/* the rest of the queue waits until this piece is verified and released */
+			if (r->held)
+				break;
+
+			reqs[num++] = r;
+
+			/* file part is sent separately, it finishes the batch */
+			if (r->fd >= 0 && r->fsize) {
+				more = !list_is_last(&r->req_entry, &st->send_list);
+				break;
+			}
+		}
+
+		if (!num) {
 			dnet_unschedule_send(st);
+			__sync_lock_release(&st->send_scheduled);
+			__sync_synchronize();
+
+			if (st->send_inbox)
+				dnet_schedule_send_once_nolock(st);
 		}
-		pthread_mutex_unlock(&st->send_lock);
+		dnet_mutex_unlock(&st->send_lock);
 
-		if (!r) {
+		if (!num) {
 			err = -EAGAIN;
 			goto err_out_exit;
 		}
 
-		err = dnet_send_request(st, r);
-		if (st->send_offset == (r->dsize + r->hsize + r->fsize)) {
-			pthread_mutex_lock(&st->send_lock);
-			list_del(&r->req_entry);
-			pthread_mutex_unlock(&st->send_lock);
-
-			pthread_mutex_lock(&st->n->io->full_lock);
-			list_stat_size_decrease(&st->n->io->output_stats, 1);
-			pthread_mutex_unlock(&st->n->io->full_lock);
-			HANDY_COUNTER_DECREMENT("io.output.queue.size", 1);
-
-			if (atomic_read(&st->send_queue_size) > 0)
-				if (atomic_dec(&st->send_queue_size) == DNET_SEND_WATERMARK_LOW) {
-					dnet_log(st->n, DNET_LOG_DEBUG,
-							"State low_watermark reached: %s: %ld, waking up",
-							dnet_addr_string(&st->addr),
-							atomic_read(&st->send_queue_size));
-					pthread_cond_broadcast(&st->send_wait);
-				}
+		r = reqs[0];
+		if (st->send_offset >= r->hsize + r->dsize) {
+			/* only file part of the first request is left */
+			err = dnet_send_request(st, r, more);
+			if (st->send_offset == (r->dsize + r->hsize + r->fsize))
+				dnet_process_send_complete(st, r);
 
-			dnet_io_req_free(r);
-			st->send_offset = 0;
+			if (err)
+				goto err_out_exit;
+			continue;
 		}
 
-		if (err)
+		sent = dnet_send_request_iov(st, reqs, num, more);
+		if (sent < 0) {
+			err = sent;
 			goto err_out_exit;
+		}
+
+		for (i = 0; i < num; ++i) {
+			r = reqs[i];
+			mem_size = r->hsize + r->dsize;
+			left = mem_size - st->send_offset;
+
+			if ((size_t)sent < left) {
+				st->send_offset += sent;
+				break;
+			}
+
+			sent -= left;
+			st->send_offset = mem_size;
+
+			/* file part will be sent on the next iteration */
+			if (r->fd >= 0 && r->fsize)
+				break;
+
+			dnet_process_send_complete(st, r);
+		}
 	}
 
 err_out_exit:
@@ -716,11 +1926,6 @@ static int dnet_schedule_network_io(struct dnet_net_state *st, int send)
 	if (send) {
 		ev.events = EPOLLOUT;
 		fd = st->write_s;
-		pthread_mutex_lock(&st->n->io->full_lock);
-		list_stat_size_increase(&st->n->io->output_stats, 1);
-		pthread_mutex_unlock(&st->n->io->full_lock);
-		HANDY_COUNTER_INCREMENT("io.output.queue.size", 1);
-
 		ev.data.ptr = &st->write_data;
 	} else {
 		ev.events = EPOLLIN;
@@ -770,12 +1975,12 @@ int dnet_schedule_recv(struct dnet_net_state *st)
 	return dnet_schedule_network_io(st, 0);
 }
 
-static int dnet_state_net_process(struct dnet_net_state *st, struct epoll_event *ev)
+static int dnet_state_net_process(struct dnet_net_io *nio, struct dnet_net_state *st, struct epoll_event *ev)
 {
 	int err = -ECONNRESET;
 
 	if (ev->events & EPOLLIN) {
-		err = dnet_process_recv_single(st);
+		err = dnet_process_recv_single(nio, st);
 		if (err && (err != -EAGAIN))
 			goto err_out_exit;
 	}
@@ -786,6 +1991,13 @@ static int dnet_state_net_process(struct dnet_net_state *st, struct epoll_event
 	}
 
 	if (ev->events & (EPOLLHUP | EPOLLERR)) {
+		/* error queue of zero-copy socket also holds completions of its sends */
+		if (!(ev->events & EPOLLHUP) && st->zerocopy && !dnet_state_zerocopy_complete(st)) {
+			if (!(ev->events & (EPOLLIN | EPOLLOUT)))
+				err = 0;
+			goto err_out_exit;
+		}
+
 		dnet_log(st->n, DNET_LOG_ERROR, "%s: received error event mask 0x%x, socket: %d",
 				dnet_state_dump_addr(st), ev->events, ev->data.fd);
 		err = -ECONNRESET;
@@ -818,6 +2030,10 @@ static void dnet_check_io_pool(struct dnet_io_pool *io, uint64_t *list_size, uin
 	dnet_check_work_pool_place(&io->recv_pool_nb, list_size, threads_count);
 }
 
+/*
+ * Returns true if system pools have room for new requests,
+ * overflow of backend pools is handled by rejecting requests in dnet_schedule_io_raw()
+ */
 static int dnet_check_io(struct dnet_io *io)
 {
 	uint64_t list_size = 0;
@@ -825,14 +2041,7 @@ static int dnet_check_io(struct dnet_io *io)
 
 	dnet_check_io_pool(&io->pool, &list_size, &threads_count);
 
-	if (io->backends) {
-		size_t i;
-		for (i = 0; i < io->backends_count; ++i) {
-			dnet_check_io_pool(&io->backends[i].pool, &list_size, &threads_count);
-		}
-	}
-
-	if (list_size <= threads_count * 1000)
+	if (list_size <= threads_count * DNET_POOL_QUEUE_LIMIT_PER_THREAD)
 		return 1;
 
 	return 0;
@@ -855,6 +2064,35 @@ static void dnet_shuffle_epoll_events(struct epoll_event *evs, int size) {
 	}
 }
 
+int dnet_server_shard_cpu(int shard)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cpus > 0 ? shard % cpus : -1;
+}
+
+/*
+ * With busy polling net thread checks its sockets without sleeping for @busy_poll_usecs
+ * since it has run out of events, wakeup latency is traded for a spinning CPU
+ */
+static int dnet_net_epoll_wait(struct dnet_node *n, struct dnet_net_io *nio, struct epoll_event *evs, int evs_size)
+{
+	uint64_t deadline;
+	int err;
+
+	if (n->busy_poll_usecs > 0) {
+		deadline = dnet_monotonic_usecs() + n->busy_poll_usecs;
+
+		do {
+			err = epoll_wait(nio->epoll_fd, evs, evs_size, 0);
+			if (err != 0)
+				return err;
+		} while (!n->need_exit && dnet_monotonic_usecs() < deadline);
+	}
+
+	return epoll_wait(nio->epoll_fd, evs, evs_size, 1000);
+}
+
 static void *dnet_io_process_network(void *data_)
 {
 	struct dnet_net_io *nio = data_;
@@ -870,9 +2108,29 @@ static void *dnet_io_process_network(void *data_)
 	int num_events = 0;
 	int i = 0;
 	struct timeval prev_tv, curr_tv;
+	double route_share;
 
 	dnet_set_name("dnet_net");
 
+	if (n->client_shards || n->server_shards) {
+		int shard = nio - n->io->net;
+		int cpu = dnet_server_shard_cpu(shard);
+
+		/*
+		 * requests submitted from completion callbacks stay in this shard,
+		 * so do connections accepted by server shard
+		 */
+		dnet_set_client_shard(shard);
+
+		if (cpu >= 0) {
+			err = dnet_cpu_bind_thread(cpu);
+			if (err) {
+				dnet_log(n, DNET_LOG_ERROR, "net thread: shard: %d: could not bind to cpu %d: %s [%d]",
+					shard, cpu, strerror(-err), err);
+			}
+		}
+	}
+
 	dnet_log(n, DNET_LOG_NOTICE, "started net pool");
 
 	if (evs == NULL) {
@@ -894,7 +2152,7 @@ static void *dnet_io_process_network(void *data_)
 			}
 		}
 
-		err = epoll_wait(nio->epoll_fd, evs, evs_size, 1000);
+		err = dnet_net_epoll_wait(n, nio, evs, evs_size);
 		if (err == 0)
 			continue;
 
@@ -926,7 +2184,7 @@ static void *dnet_io_process_network(void *data_)
 			} else if ((evs[i].events & EPOLLOUT) || dnet_check_io(n->io)) {
 				// if this is sending event or io pool queues are not full then process it
 				++tmp;
-				err = dnet_state_net_process(st, &evs[i]);
+				err = dnet_state_net_process(nio, st, &evs[i]);
 			} else {
 				continue;
 			}
@@ -942,13 +2200,15 @@ static void *dnet_io_process_network(void *data_)
 				dnet_log(n, DNET_LOG_ERROR, "self: addr: %s, resetting state: %s (%p)",
 				         addr_str, dnet_state_dump_addr(st), st);
 
+				/* routes are removed by reset, so their share is taken before it */
+				route_share = dnet_state_route_share(st);
 				dnet_state_reset(st, err);
 
-				pthread_mutex_lock(&st->send_lock);
+				dnet_mutex_lock(&st->send_lock);
 				dnet_unschedule_all(st);
-				pthread_mutex_unlock(&st->send_lock);
+				dnet_mutex_unlock(&st->send_lock);
 
-				dnet_add_reconnect_state(st->n, &st->addr, st->__join_state);
+				dnet_add_reconnect_state(st->n, &st->addr, st->__join_state, route_share);
 
 				// state still contains a fair number of transactions in its queue
 				// they will not be cleaned up here - dnet_state_put() will only drop refctn by 1,
@@ -967,7 +2227,7 @@ static void *dnet_io_process_network(void *data_)
 			gettimeofday(&curr_tv, NULL);
 			// print log only if previous log was written more then 1 seconds ago
 			if ((curr_tv.tv_sec - prev_tv.tv_sec) > 1) {
-				dnet_log(n, DNET_LOG_INFO, "Net pool is suspended because io pool queues is full");
+				dnet_log(n, DNET_LOG_INFO, "Net pool is suspended because system io pool queues are full");
 				prev_tv = curr_tv;
 			}
 			// wait condition variable - io queues has a free slot or some socket has something to send
@@ -1008,16 +2268,124 @@ static void dnet_io_cleanup_states(struct dnet_node *n)
 	n->st = NULL;
 }
 
+static __thread int dnet_backend_gate_depth;
+
+int dnet_backend_gate_init(struct dnet_backend_gate *gate)
+{
+	int err;
+
+	memset(gate, 0, sizeof(struct dnet_backend_gate));
+
+	err = pthread_mutex_init(&gate->lock, NULL);
+	if (err)
+		return -err;
+
+	err = pthread_cond_init(&gate->wait, NULL);
+	if (err) {
+		pthread_mutex_destroy(&gate->lock);
+		return -err;
+	}
+
+	return 0;
+}
+
+void dnet_backend_gate_destroy(struct dnet_backend_gate *gate)
+{
+	pthread_cond_destroy(&gate->wait);
+	pthread_mutex_destroy(&gate->lock);
+}
+
+int dnet_backend_gate_enter(struct dnet_backend_gate *gate)
+{
+	int err = 0;
+
+	if (dnet_backend_gate_depth) {
+		++dnet_backend_gate_depth;
+		return 0;
+	}
+
+	pthread_mutex_lock(&gate->lock);
+	while (gate->closed)
+		pthread_cond_wait(&gate->wait, &gate->lock);
+
+	if (gate->failed) {
+		err = -ENXIO;
+	} else {
+		++gate->active;
+		dnet_backend_gate_depth = 1;
+	}
+	pthread_mutex_unlock(&gate->lock);
+
+	return err;
+}
+
+int dnet_backend_gate_try_enter(struct dnet_backend_gate *gate)
+{
+	int err = 0;
+
+	if (dnet_backend_gate_depth) {
+		++dnet_backend_gate_depth;
+		return 0;
+	}
+
+	pthread_mutex_lock(&gate->lock);
+	if (gate->closed) {
+		err = -EAGAIN;
+	} else if (gate->failed) {
+		err = -ENXIO;
+	} else {
+		++gate->active;
+		dnet_backend_gate_depth = 1;
+	}
+	pthread_mutex_unlock(&gate->lock);
+
+	return err;
+}
+
+void dnet_backend_gate_leave(struct dnet_backend_gate *gate)
+{
+	if (--dnet_backend_gate_depth)
+		return;
+
+	pthread_mutex_lock(&gate->lock);
+	if (--gate->active == 0)
+		pthread_cond_broadcast(&gate->wait);
+	pthread_mutex_unlock(&gate->lock);
+}
+
+void dnet_backend_gate_close(struct dnet_backend_gate *gate)
+{
+	pthread_mutex_lock(&gate->lock);
+	gate->closed = 1;
+	while (gate->active)
+		pthread_cond_wait(&gate->wait, &gate->lock);
+	pthread_mutex_unlock(&gate->lock);
+}
+
+void dnet_backend_gate_open(struct dnet_backend_gate *gate, int failed)
+{
+	pthread_mutex_lock(&gate->lock);
+	gate->closed = 0;
+	gate->failed = failed;
+	pthread_cond_broadcast(&gate->wait);
+	pthread_mutex_unlock(&gate->lock);
+}
+
 void *dnet_io_process(void *data_)
 {
 	struct dnet_work_io *wio = data_;
 	struct dnet_work_pool *pool = wio->pool;
+	/* pool request has been taken from, it differs from @pool for requests stolen from other backends */
+	struct dnet_work_pool *owner;
 	struct dnet_node *n = pool->n;
 	struct dnet_net_state *st;
 	struct dnet_io_req *r;
 	struct dnet_cmd *cmd;
 	int nonblocking = (pool->mode == DNET_WORK_IO_MODE_NONBLOCKING);
-	char thread_stat_id[255];
+	int steal = nonblocking && pool->io && n->nonblocking_io_steal;
+	uint64_t stages[__DNET_IO_STAGE_MAX];
+	uint64_t processed_time;
+	int err;
 
 	if (pool->io) {
 		dnet_set_name("dnet_%sio_%zu", nonblocking ? "nb_" : "", pool->io->backend_id);
@@ -1025,14 +2393,28 @@ void *dnet_io_process(void *data_)
 		dnet_set_name("dnet_%sio", nonblocking ? "nb_" : "");
 	}
 
-	make_thread_stat_id(thread_stat_id, sizeof(thread_stat_id), pool);
+	if (pool->io && pool->io->numa_node >= 0) {
+		err = dnet_numa_bind_thread(pool->io->numa_node);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "io thread: #%d, backend: %zu: could not bind to numa node %d: %s [%d]",
+				wio->thread_index, pool->io->backend_id, pool->io->numa_node, strerror(-err), err);
+		}
+	}
 
 	dnet_log(n, DNET_LOG_NOTICE, "started io thread: #%d, nonblocking: %d, backend: %zd",
 		wio->thread_index, nonblocking, pool->io ? (ssize_t)pool->io->backend_id : -1);
 
 
 	while (!n->need_exit && (!pool->io || !pool->io->need_exit)) {
-		r = dnet_pop_request(wio, thread_stat_id);
+		owner = pool;
+
+		/* own requests go first, thread looks into other backends before it waits for new ones */
+		r = dnet_pop_request(wio, dnet_pool_metric(pool, SEARCH_TRANS_TIME), !steal);
+		if (!r && steal) {
+			r = dnet_io_steal(wio, &owner);
+			if (!r)
+				r = dnet_pop_request(wio, dnet_pool_metric(pool, SEARCH_TRANS_TIME), 1);
+		}
 		if (!r)
 			continue;
 
@@ -1040,32 +2422,56 @@ void *dnet_io_process(void *data_)
 
 		HANDY_COUNTER_DECREMENT("io.input.queue.size", 1);
 
-		FORMATTED(HANDY_COUNTER_DECREMENT, ("pool.%s.queue.size", thread_stat_id), 1);
-		FORMATTED(HANDY_TIMER_STOP, ("pool.%s.queue.wait_time", thread_stat_id), (unsigned long)r);
+		HANDY_COUNTER_DECREMENT(dnet_pool_metric(owner, QUEUE_SIZE), 1);
+		HANDY_TIMER_STOP(dnet_pool_metric(owner, QUEUE_WAIT_TIME), (unsigned long)r);
 
-		FORMATTED(HANDY_COUNTER_INCREMENT, ("pool.%s.active_threads", thread_stat_id), 1);
+		HANDY_COUNTER_INCREMENT(dnet_pool_metric(owner, ACTIVE_THREADS), 1);
+		if (owner != pool) {
+			HANDY_COUNTER_INCREMENT(dnet_pool_metric(owner, STOLEN), 1);
+		}
 
 		st = r->st;
 		cmd = r->header;
 
-		dnet_node_set_trace_id(n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, pool->io ? (ssize_t)pool->io->backend_id : (ssize_t)-1);
+		processed_time = dnet_monotonic_usecs();
+		stages[DNET_IO_STAGE_QUEUE] = r->queue_time ? processed_time - r->queue_time : DNET_IO_STAGE_NONE;
+		stages[DNET_IO_STAGE_SEND] = DNET_IO_STAGE_NONE;
+		dnet_backend_stage_time = DNET_IO_STAGE_NONE;
+
+		dnet_node_set_trace_id(n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, owner->io ? (ssize_t)owner->io->backend_id : (ssize_t)-1);
 
-		dnet_log(n, DNET_LOG_DEBUG, "%s: %s: got IO event: %p: cmd: %s, hsize: %zu, dsize: %zu, mode: %s, backend_id: %zd",
+		dnet_log(n, DNET_LOG_DEBUG, "%s: %s: got IO event: %p: cmd: %s, hsize: %zu, dsize: %zu, mode: %s, backend_id: %zd, stolen: %d",
 			dnet_state_dump_addr(st), dnet_dump_id(r->header), r, dnet_cmd_string(cmd->cmd), r->hsize, r->dsize, dnet_work_io_mode_str(pool->mode),
-			pool->io ? (ssize_t)pool->io->backend_id : (ssize_t)-1);
+			owner->io ? (ssize_t)owner->io->backend_id : (ssize_t)-1, owner != pool);
 
-		dnet_process_recv(pool->io, st, r);
+		err = dnet_process_recv(owner->io, st, r);
 
-		dnet_log(n, DNET_LOG_DEBUG, "%s: %s: processed IO event: %p, cmd: %s",
-			dnet_state_dump_addr(st), dnet_dump_id(r->header), r, dnet_cmd_string(cmd->cmd));
+		dnet_log(n, DNET_LOG_DEBUG, "%s: %s: processed IO event: %p, cmd: %s, err: %d",
+			dnet_state_dump_addr(st), dnet_dump_id(r->header), r, dnet_cmd_string(cmd->cmd), err);
+
+		dnet_release_request(owner, r);
+
+		if (r->complete)
+			r->complete(r, err);
+
+		if (r->peer_inflight)
+			__sync_sub_and_fetch(&st->peer_stat.inflight, 1);
+
+		stages[DNET_IO_STAGE_PROCESS] = dnet_monotonic_usecs() - processed_time;
+		stages[DNET_IO_STAGE_BACKEND] = dnet_backend_stage_time;
+		dnet_monitor_stages_update(n, cmd, stages);
+		dnet_monitor_request_complete(n, st, owner->io ? (ssize_t)owner->io->backend_id : (ssize_t)-1,
+				cmd, stages, r->queue_depth, err);
 
 		dnet_node_unset_trace_id();
 
-		dnet_release_request(wio, r);
 		dnet_io_req_free(r);
 		dnet_state_put(st);
 
-		FORMATTED(HANDY_COUNTER_DECREMENT, ("pool.%s.active_threads", thread_stat_id), 1);
+		HANDY_COUNTER_DECREMENT(dnet_pool_metric(owner, ACTIVE_THREADS), 1);
+
+		if (owner != pool)
+			__sync_sub_and_fetch(&owner->thieves, 1);
 	}
 
 	dnet_log(n, DNET_LOG_NOTICE, "finished io thread: #%d, nonblocking: %d, backend: %zd",
@@ -1145,8 +2551,17 @@ int dnet_io_init(struct dnet_node *n, struct dnet_config *cfg)
 		fcntl(nio->epoll_fd, F_SETFD, FD_CLOEXEC);
 		fcntl(nio->epoll_fd, F_SETFL, O_NONBLOCK);
 
+		nio->recv_pool = dnet_slab_pool_create();
+		if (!nio->recv_pool) {
+			close(nio->epoll_fd);
+			err = -ENOMEM;
+			dnet_log(n, DNET_LOG_ERROR, "Failed to create network receive pool");
+			goto err_out_net_destroy;
+		}
+
 		err = pthread_create(&nio->tid, NULL, dnet_io_process_network, nio);
 		if (err) {
+			dnet_slab_pool_destroy(nio->recv_pool);
 			close(nio->epoll_fd);
 			err = -err;
 			dnet_log(n, DNET_LOG_ERROR, "Failed to create network processing thread: %d", err);
@@ -1161,6 +2576,7 @@ err_out_net_destroy:
 	while (--i >= 0) {
 		pthread_join(n->io->net[i].tid, NULL);
 		close(n->io->net[i].epoll_fd);
+		dnet_slab_pool_destroy(n->io->net[i].recv_pool);
 	}
 
 	dnet_work_pool_exit(&n->io->pool.recv_pool_nb);
@@ -1199,6 +2615,7 @@ int dnet_server_io_init(struct dnet_node *n)
 	for (j = 0; j < n->io->backends_count; ++j) {
 		struct dnet_backend_io *io = &n->io->backends[j];
 		io->backend_id = j;
+		io->numa_node = -1;
 
 		err = dnet_work_pool_place_init(&io->pool.recv_pool);
 		if (err) {
@@ -1210,7 +2627,37 @@ int dnet_server_io_init(struct dnet_node *n)
 			dnet_work_pool_place_cleanup(&io->pool.recv_pool);
 			goto err_out_free_backends_io;
 		}
+
+		err = dnet_throttle_init(&io->background_throttle, 0, 0);
+		if (err) {
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool_nb);
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool);
+			goto err_out_free_backends_io;
+		}
+
+		err = dnet_backend_gate_init(&io->gate);
+		if (err) {
+			dnet_throttle_destroy(&io->background_throttle);
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool_nb);
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool);
+			goto err_out_free_backends_io;
+		}
+
+		err = -pthread_mutex_init(&io->faults_lock, NULL);
+		if (err) {
+			dnet_backend_gate_destroy(&io->gate);
+			dnet_throttle_destroy(&io->background_throttle);
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool_nb);
+			dnet_work_pool_place_cleanup(&io->pool.recv_pool);
+			goto err_out_free_backends_io;
+		}
+	}
+
+	err = dnet_node_schedule_call(n, DNET_POOL_SCALE_INTERVAL_MS, dnet_io_scale_pools, n);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "Failed to schedule io pools scaling, pools will not be scaled: %d", err);
 	}
+
 	return 0;
 
 err_out_free_backends_io:
@@ -1222,6 +2669,9 @@ err_out_free_backends_io:
 		struct dnet_backend_io *io = &n->io->backends[k];
 		dnet_work_pool_exit(&io->pool.recv_pool);
 		dnet_work_pool_exit(&io->pool.recv_pool_nb);
+		dnet_throttle_destroy(&io->background_throttle);
+		dnet_backend_gate_destroy(&io->gate);
+		pthread_mutex_destroy(&io->faults_lock);
 	}
 	free(n->io->backends);
 err_out_exit:
@@ -1262,6 +2712,7 @@ void dnet_io_cleanup(struct dnet_node *n)
 {
 	struct dnet_io *io = n->io;
 	size_t i;
+	int j;
 
 	dnet_work_pool_cleanup(&io->pool.recv_pool_nb);
 	dnet_work_pool_place_cleanup(&io->pool.recv_pool_nb);
@@ -1277,10 +2728,21 @@ void dnet_io_cleanup(struct dnet_node *n)
 			dnet_work_pool_cleanup(&backend_io->pool.recv_pool_nb);
 		dnet_work_pool_place_cleanup(&backend_io->pool.recv_pool_nb);
 		dnet_work_pool_place_cleanup(&backend_io->pool.recv_pool);
+		dnet_throttle_destroy(&backend_io->background_throttle);
+		dnet_backend_gate_destroy(&backend_io->gate);
+		pthread_mutex_destroy(&backend_io->faults_lock);
+		free(backend_io->faults);
 	}
 
 	dnet_io_cleanup_states(n);
 
+	/*
+	 * Receive pools are reference counted by outstanding buffers,
+	 * they will be freed when the last request is released.
+	 */
+	for (j = 0; j < io->net_thread_num; ++j)
+		dnet_slab_pool_destroy(io->net[j].recv_pool);
+
 	free(io);
 	n->io = NULL;
 }
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2008+ Evgeniy Polyakov <zbr@ioremap.net>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_PROBES_H
+#define __DNET_PROBES_H
+
+/*
+ * Static USDT probes of request lifecycle, provider is "elliptics".
+ * Probe is a single nop in the code until a tracer (bpftrace, systemtap, perf) attaches to it,
+ * see example/bpftrace/ for scripts.
+ *
+ * Every probe of a request starts with the same arguments, so a request can be followed
+ * from one probe to another by (state, trans) pair:
+ *	arg0 - struct dnet_net_state * request was received from or is sent to
+ *	arg1 - command (enum dnet_commands)
+ *	arg2 - transaction number
+ *
+ * request__receive	(st, cmd, trans, flags, size): whole request is read from the socket
+ * request__queue	(st, cmd, trans, flags, backend_id): request is put into io pool queue
+ * cmd__start		(st, cmd, trans, flags, backend_id): io thread starts to process request
+ * cmd__done		(st, cmd, trans, flags, backend_id, err)
+ * cache__start		(st, cmd, trans, flags, backend_id): request is looked up in the cache
+ * cache__done		(st, cmd, trans, flags, backend_id, err): -ENOTSUP means it goes to backend
+ * backend__start	(st, cmd, trans, flags, backend_id): eblob backend starts to process request
+ * backend__done	(st, cmd, trans, flags, backend_id, err)
+ * request__send	(st, cmd, trans, flags, size): the first byte of request or reply is sent
+ * request__sent	(st, cmd, trans, flags, size): request or reply is sent completely,
+ *			replies have DNET_FLAGS_REPLY bit in @flags
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define DNET_PROBE(name, ...)	STAP_PROBEV(elliptics, name, ##__VA_ARGS__)
+#else
+#define DNET_PROBE(name, ...)	do {} while (0)
+#endif
+
+#define DNET_PROBE_CMD(name, st, cmd, ...) \
+	DNET_PROBE(name, (void *)(st), (int)(cmd)->cmd, (unsigned long long)(cmd)->trans, \
+			(unsigned long long)(cmd)->flags, ##__VA_ARGS__)
+
+#endif /* __DNET_PROBES_H */
@@ -0,0 +1,228 @@
+#include "elliptics.h"
+#include "../example/config.hpp"
+
+#include <algorithm>
+
+/* buckets of clients which have been idle for this long are forgotten */
+#define DNET_QOS_CLIENT_IDLE_SECONDS	60
+
+static dnet_qos_limit dnet_qos_limit_parse(const ioremap::elliptics::config::config &cfg, const dnet_qos_limit &defaults)
+{
+	dnet_qos_limit limit;
+
+	limit.rate_ops = cfg.at<uint64_t>("rate_ops", defaults.rate_ops);
+	limit.rate_bytes = cfg.at<uint64_t>("rate_bytes", defaults.rate_bytes);
+
+	return limit;
+}
+
+std::unique_ptr<dnet_qos_config> dnet_qos_config::parse(const ioremap::elliptics::config::config &cfg)
+{
+	std::unique_ptr<dnet_qos_config> result(new dnet_qos_config);
+
+	result->burst = cfg.at<double>("burst_seconds", 1);
+	result->defaults = dnet_qos_limit_parse(cfg, dnet_qos_limit{0, 0});
+
+	if (result->burst <= 0) {
+		throw ioremap::elliptics::config::config_error() << cfg.at("burst_seconds").path()
+			<< " must be positive";
+	}
+
+	if (cfg.has("tenants")) {
+		const ioremap::elliptics::config::config tenants = cfg.at("tenants");
+
+		for (size_t index = 0; index < tenants.size(); ++index) {
+			const ioremap::elliptics::config::config tenant = tenants.at(index);
+			const std::vector<std::string> networks = tenant.at<std::vector<std::string>>("networks");
+
+			dnet_qos_config::tenant value;
+			value.name = tenant.at<std::string>("name");
+			value.limit = dnet_qos_limit_parse(tenant, result->defaults);
+
+			for (auto it = networks.cbegin(); it != networks.cend(); ++it) {
+				if (!value.networks.empty())
+					value.networks += ",";
+				value.networks += *it;
+			}
+
+			dnet_net_prefix *nets = NULL;
+			int net_num = 0;
+			if (dnet_net_prefix_parse(value.networks.c_str(), &nets, &net_num)) {
+				throw ioremap::elliptics::config::config_error() << tenant.at("networks").path()
+					<< " must be a list of networks like \"10.0.0.0/8\"";
+			}
+			free(nets);
+
+			result->tenants.emplace_back(std::move(value));
+		}
+	}
+
+	return result;
+}
+
+dnet_qos::bucket::bucket(const std::string &name, const dnet_qos_limit &limit, double burst, clock::time_point now) :
+	name(name),
+	limit(limit),
+	ops_tokens(limit.rate_ops * burst),
+	bytes_tokens(limit.rate_bytes * burst),
+	refilled(now),
+	ops(0), bytes(0),
+	throttled_ops(0), throttled_bytes(0)
+{
+}
+
+bool dnet_qos::bucket::admit(uint64_t size, double burst, clock::time_point now)
+{
+	const double elapsed = std::chrono::duration<double>(now - refilled).count();
+	refilled = now;
+
+	ops_tokens = std::min<double>(limit.rate_ops * burst, ops_tokens + elapsed * limit.rate_ops);
+	bytes_tokens = std::min<double>(limit.rate_bytes * burst, bytes_tokens + elapsed * limit.rate_bytes);
+
+	if ((limit.rate_ops && ops_tokens < 1) || (limit.rate_bytes && bytes_tokens <= 0)) {
+		throttled_ops++;
+		throttled_bytes += size;
+		return false;
+	}
+
+	if (limit.rate_ops)
+		ops_tokens -= 1;
+	if (limit.rate_bytes)
+		bytes_tokens -= size;
+
+	ops++;
+	bytes += size;
+	return true;
+}
+
+dnet_qos::dnet_qos(const dnet_qos_config &config) :
+	m_burst(config.burst),
+	m_defaults(config.defaults),
+	m_swept(clock::now())
+{
+	const clock::time_point now = clock::now();
+
+	for (auto it = config.tenants.cbegin(); it != config.tenants.cend(); ++it) {
+		tenant value{NULL, 0, bucket(it->name, it->limit, m_burst, now)};
+
+		int err = dnet_net_prefix_parse(it->networks.c_str(), &value.nets, &value.net_num);
+		if (err)
+			throw std::runtime_error("failed to parse networks of tenant " + it->name);
+
+		m_tenants.emplace_back(std::move(value));
+	}
+}
+
+dnet_qos::~dnet_qos()
+{
+	for (auto it = m_tenants.begin(); it != m_tenants.end(); ++it)
+		free(it->nets);
+}
+
+bool dnet_qos::admit(const dnet_addr &addr, uint64_t size)
+{
+	const clock::time_point now = clock::now();
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	for (auto it = m_tenants.begin(); it != m_tenants.end(); ++it) {
+		if (dnet_net_prefix_match(it->nets, it->net_num, &addr))
+			return it->state.admit(size, m_burst, now);
+	}
+
+	if (!m_defaults.rate_ops && !m_defaults.rate_bytes)
+		return true;
+
+	std::string key(1, static_cast<char>(addr.family));
+	if (addr.family == AF_INET6)
+		key.append(reinterpret_cast<const char *>(addr.addr) + offsetof(struct sockaddr_in6, sin6_addr), 16);
+	else
+		key.append(reinterpret_cast<const char *>(addr.addr) + offsetof(struct sockaddr_in, sin_addr), 4);
+
+	auto it = m_clients.find(key);
+	if (it == m_clients.end()) {
+		sweep_nolock(now);
+		it = m_clients.emplace(key, bucket(dnet_addr_host_string(&addr), m_defaults, m_burst, now)).first;
+	}
+
+	return it->second.admit(size, m_burst, now);
+}
+
+void dnet_qos::sweep_nolock(clock::time_point now)
+{
+	if (now - m_swept < std::chrono::seconds(DNET_QOS_CLIENT_IDLE_SECONDS))
+		return;
+
+	m_swept = now;
+	for (auto it = m_clients.begin(); it != m_clients.end();) {
+		if (now - it->second.refilled >= std::chrono::seconds(DNET_QOS_CLIENT_IDLE_SECONDS))
+			it = m_clients.erase(it);
+		else
+			++it;
+	}
+}
+
+std::vector<dnet_qos_stat> dnet_qos::stats()
+{
+	std::vector<dnet_qos_stat> result;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	result.reserve(m_tenants.size() + m_clients.size());
+
+	auto add = [&result] (const bucket &state) {
+		result.push_back(dnet_qos_stat{state.name, state.limit, state.ops, state.bytes,
+			state.throttled_ops, state.throttled_bytes});
+	};
+
+	for (auto it = m_tenants.cbegin(); it != m_tenants.cend(); ++it)
+		add(it->state);
+	for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it)
+		add(it->second);
+
+	return result;
+}
+
+int dnet_qos_init(struct dnet_node *n)
+{
+	const auto &data = *static_cast<const ioremap::elliptics::config::config_data *>(n->config_data);
+	if (!data.qos_config)
+		return 0;
+
+	try {
+		n->qos = new dnet_qos(*data.qos_config);
+	} catch (const std::exception &e) {
+		dnet_log(n, DNET_LOG_ERROR, "qos: failed to initialize rate limits: %s", e.what());
+		return -ENOMEM;
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "qos: rate limits initialized: tenants: %zu, default limits: ops: %" PRIu64
+			", bytes: %" PRIu64 ", burst: %.3f seconds",
+			data.qos_config->tenants.size(), data.qos_config->defaults.rate_ops,
+			data.qos_config->defaults.rate_bytes, data.qos_config->burst);
+	return 0;
+}
+
+void dnet_qos_cleanup(struct dnet_node *n)
+{
+	delete n->qos;
+	n->qos = NULL;
+}
+
+int dnet_qos_admit(struct dnet_node *n, struct dnet_net_state *st, struct dnet_cmd *cmd)
+{
+	/*
+	 * Server peers have routes, their recovery and replication requests are not limited.
+	 * The root is read without @idc_lock, stale value only means one more or less limited request.
+	 */
+	if (!n->qos || !st || st->idc_root.rb_node)
+		return 0;
+
+	try {
+		if (n->qos->admit(st->addr, cmd->size))
+			return 0;
+	} catch (const std::exception &) {
+		return 0;
+	}
+
+	return -EAGAIN;
+}
@@ -0,0 +1,143 @@
+#ifndef IOREMAP_ELLIPTICS_QOS_H
+#define IOREMAP_ELLIPTICS_QOS_H
+
+#include <elliptics/packet.h>
+#include <elliptics/interface.h>
+
+#ifdef __cplusplus
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ioremap { namespace elliptics { namespace config {
+class config;
+}}}
+
+struct dnet_net_prefix;
+
+/*
+ * Requests and bytes per second of one tenant, 0 - unlimited
+ */
+struct dnet_qos_limit
+{
+	uint64_t	rate_ops;
+	uint64_t	rate_bytes;
+};
+
+/*
+ * Node options of per-client rate limits, "qos" section of the config.
+ *
+ * All clients connected from networks of a tenant share its limits, every other client address
+ * is a tenant of its own with @defaults limits. Requests of server peers are never limited.
+ */
+struct dnet_qos_config
+{
+	/* seconds of the rate which may be spent at once */
+	double			burst;
+	dnet_qos_limit		defaults;
+
+	struct tenant {
+		std::string	name;
+		/* comma separated list of networks, see dnet_net_prefix_parse() */
+		std::string	networks;
+		dnet_qos_limit	limit;
+	};
+	std::vector<tenant>	tenants;
+
+	static std::unique_ptr<dnet_qos_config> parse(const ioremap::elliptics::config::config &cfg);
+};
+
+/*
+ * Accounting of one tenant reported by monitor
+ */
+struct dnet_qos_stat
+{
+	std::string	name;
+	dnet_qos_limit	limit;
+	uint64_t	ops, bytes;
+	uint64_t	throttled_ops, throttled_bytes;
+};
+
+/*
+ * Token buckets of tenants. Bucket holds up to @burst seconds of its rates and starts full.
+ * Request is admitted if bucket has at least one request and any bytes left, so request bigger
+ * than the burst is not refused forever, instead it takes the following bytes in advance.
+ */
+class dnet_qos
+{
+public:
+	dnet_qos(const dnet_qos_config &config);
+	~dnet_qos();
+
+	dnet_qos(const dnet_qos &) = delete;
+	dnet_qos &operator =(const dnet_qos &) = delete;
+
+	/* Returns true and takes tokens if request of @size bytes from @addr fits into limits of its tenant */
+	bool admit(const dnet_addr &addr, uint64_t size);
+
+	std::vector<dnet_qos_stat> stats();
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct bucket {
+		bucket(const std::string &name, const dnet_qos_limit &limit, double burst, clock::time_point now);
+
+		bool admit(uint64_t size, double burst, clock::time_point now);
+
+		std::string		name;
+		dnet_qos_limit		limit;
+		double			ops_tokens;
+		double			bytes_tokens;
+		clock::time_point	refilled;
+		uint64_t		ops, bytes;
+		uint64_t		throttled_ops, throttled_bytes;
+	};
+
+	struct tenant {
+		dnet_net_prefix		*nets;
+		int			net_num;
+		bucket			state;
+	};
+
+	// drops buckets of clients which have not sent anything for a while, must be called with m_lock held
+	void sweep_nolock(clock::time_point now);
+
+	const double			m_burst;
+	const dnet_qos_limit		m_defaults;
+
+	std::mutex			m_lock;
+	std::vector<tenant>		m_tenants;
+	// buckets of clients outside of tenants' networks, keyed by family and address without port
+	std::unordered_map<std::string, bucket>	m_clients;
+	clock::time_point		m_swept;
+};
+
+extern "C" {
+#else // __cplusplus
+typedef struct dnet_qos_t dnet_qos;
+#endif // __cplusplus
+
+/*
+ * Creates rate limits of the node if they are configured
+ */
+int dnet_qos_init(struct dnet_node *n);
+/*
+ * Must be called after network and io threads are stopped
+ */
+void dnet_qos_cleanup(struct dnet_node *n);
+
+/*
+ * Returns -EAGAIN if request @cmd received from @st exceeds limits of its tenant, 0 otherwise.
+ * Client should retry throttled request later or in another group.
+ */
+int __attribute__((weak)) dnet_qos_admit(struct dnet_node *n, struct dnet_net_state *st, struct dnet_cmd *cmd);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // IOREMAP_ELLIPTICS_QOS_H
@@ -1,6 +1,9 @@
 #include "request_queue.h"
 #include "monitor/measure_points.h"
 
+#include <algorithm>
+#include <chrono>
+
 
 static size_t dnet_id_hash(const dnet_id &key)
 {
@@ -17,6 +20,11 @@ static bool dnet_id_comparator(const dnet_id &lhs, const dnet_id &rhs)
 	return !dnet_id_cmp(&lhs, &rhs);
 }
 
+static uint64_t dnet_queue_time_now()
+{
+	return dnet_monotonic_usecs();
+}
+
 static bool dnet_raw_id_comparator(const dnet_id &lhs, const dnet_id &rhs)
 {
 	return !dnet_id_cmp_str(reinterpret_cast<const unsigned char *>(&lhs.id),
@@ -24,62 +32,241 @@ static bool dnet_raw_id_comparator(const dnet_id &lhs, const dnet_id &rhs)
 }
 
 
-dnet_request_queue::dnet_request_queue(bool has_backend)
-: m_queue_size(0),
- m_locked_keys(1, has_backend ? &dnet_raw_id_hash : &dnet_id_hash,
-	       has_backend ? &dnet_raw_id_comparator : &dnet_id_comparator)
+dnet_request_queue::shard::shard()
 {
-	INIT_LIST_HEAD(&m_queue);
+	INIT_LIST_HEAD(&queue);
+	INIT_LIST_HEAD(&background_queue);
+}
+
+dnet_request_queue::stripe::stripe(hash_function_t hash, equal_function_t equal)
+: locked_keys(1, hash, equal)
+{
+}
+
+dnet_request_queue::dnet_request_queue(bool has_backend, int num_threads)
+: m_hash(has_backend ? &dnet_raw_id_hash : &dnet_id_hash),
+ m_threads_count(std::max(num_threads, 1)),
+ m_queue_size(0),
+ m_background_active(0),
+ m_interactive_served(0),
+ m_active_threads(m_threads_count),
+ m_wait_time(0),
+ m_wait_count(0),
+ m_generation(0),
+ m_waiters(0)
+{
+	const equal_function_t equal = has_backend ? &dnet_raw_id_comparator : &dnet_id_comparator;
+	const size_t shards_count = std::min(m_threads_count, DNET_REQUEST_QUEUE_MAX_SHARDS);
+
+	for (size_t i = 0; i < shards_count; ++i)
+		m_shards.emplace_back(new shard);
+
+	for (size_t i = 0; i < DNET_REQUEST_QUEUE_LOCK_STRIPES; ++i)
+		m_stripes.emplace_back(new stripe(m_hash, equal));
+
+	m_thread_locks.reset(new std::mutex[m_threads_count]);
 }
 
 dnet_request_queue::~dnet_request_queue()
 {
-	for (auto it = m_lock_pool.begin(); it != m_lock_pool.end(); ++it) {
-		delete *it;
+	for (auto &s : m_stripes) {
+		for (auto it = s->lock_pool.begin(); it != s->lock_pool.end(); ++it) {
+			delete *it;
+		}
 	}
 
-	struct dnet_io_req *r, *tmp;
-	list_for_each_entry_safe(r, tmp, &m_queue, req_entry) {
-		list_del(&r->req_entry);
-		dnet_io_req_free(r);
+	for (auto &s : m_shards) {
+		struct list_head *lists[] = { &s->queue, &s->background_queue };
+
+		for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i) {
+			struct dnet_io_req *r, *tmp;
+			list_for_each_entry_safe(r, tmp, lists[i], req_entry) {
+				list_del(&r->req_entry);
+				dnet_io_req_free(r);
+			}
+		}
+	}
+}
+
+bool dnet_request_queue::is_background(const dnet_cmd *cmd)
+{
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		return false;
+
+	return (cmd->flags & DNET_FLAGS_BACKGROUND) ||
+		cmd->cmd == DNET_CMD_ITERATOR ||
+		cmd->cmd == DNET_CMD_SEND;
+}
+
+bool dnet_request_queue::is_shared(const dnet_cmd *cmd)
+{
+	return cmd->cmd == DNET_CMD_READ ||
+		cmd->cmd == DNET_CMD_LOOKUP;
+}
+
+size_t dnet_request_queue::shard_index(const dnet_cmd *cmd) const
+{
+	if (m_shards.size() == 1)
+		return 0;
+
+	/*
+	 * All replies of the same transaction must live in the same shard,
+	 * since transaction is claimed by pool thread under shard lock.
+	 */
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		return MurmurHash64A(reinterpret_cast<const char *>(&cmd->trans), sizeof(cmd->trans), 0) % m_shards.size();
+
+	return m_hash(cmd->id) % m_shards.size();
+}
+
+dnet_request_queue::stripe &dnet_request_queue::key_stripe(const dnet_id &id)
+{
+	return *m_stripes[m_hash(id) % m_stripes.size()];
+}
+
+std::mutex &dnet_request_queue::thread_lock(const dnet_work_io *wio)
+{
+	return m_thread_locks[wio->thread_index % m_threads_count];
+}
+
+void dnet_request_queue::notify()
+{
+	++m_generation;
+	if (m_waiters.load() > 0) {
+		std::unique_lock<std::mutex> lock(m_wait_mutex);
+		m_wait.notify_one();
 	}
 }
 
 void dnet_request_queue::push_request(dnet_io_req *req)
 {
+	auto cmd = reinterpret_cast<const dnet_cmd *>(req->header);
+	shard &s = *m_shards[shard_index(cmd)];
+
+	req->queue_time = dnet_queue_time_now();
+	req->queue_depth = m_queue_size.load();
+
 	{
-		std::unique_lock<std::mutex> lock(m_queue_mutex);
-		list_add_tail(&req->req_entry, &m_queue);
+		dnet_site_lock_guard<std::mutex> lock(s.mutex, DNET_LOCK_SITE("shard.mutex"));
+		list_add_tail(&req->req_entry, is_background(cmd) ? &s.background_queue : &s.queue);
 		++m_queue_size;
 	}
-	m_queue_wait.notify_one();
+
+	notify();
+}
+
+dnet_io_req *dnet_request_queue::pop_request(dnet_work_io *wio, const char *search_time_metric, bool wait)
+{
+	if (is_parked(wio))
+		return take_parked_request(wio);
+
+	const unsigned long long generation = m_generation.load();
+
+	auto r = take_request(wio, search_time_metric);
+	if (!r && wait) {
+		{
+			std::unique_lock<std::mutex> lock(m_wait_mutex);
+			++m_waiters;
+			m_wait.wait_for(lock, std::chrono::seconds(1), [&] () {
+				return m_generation.load() != generation;
+			});
+			--m_waiters;
+		}
+
+		r = take_request(wio, search_time_metric);
+	}
+
+	if (r)
+		account_taken(r);
+
+	return r;
+}
+
+void dnet_request_queue::account_taken(const dnet_io_req *r)
+{
+	--m_queue_size;
+
+	m_wait_time += dnet_queue_time_now() - r->queue_time;
+	++m_wait_count;
+
+	/* background slot is claimed by the thread which takes the request */
+	if (is_background(reinterpret_cast<const dnet_cmd *>(r->header))) {
+		m_interactive_served = 0;
+	} else {
+		++m_interactive_served;
+	}
 }
 
-dnet_io_req *dnet_request_queue::pop_request(dnet_work_io *wio, const char *thread_stat_id)
+dnet_io_req *dnet_request_queue::steal_request()
 {
-	std::unique_lock<std::mutex> lock(m_queue_mutex);
+	/* threads of this pool are about to take its requests themselves */
+	if (has_idle_threads())
+		return nullptr;
+
+	for (auto &s : m_shards) {
+		dnet_site_lock_guard<std::mutex> lock(s->mutex, DNET_LOCK_SITE("shard.mutex"));
+		dnet_io_req *it;
 
-	auto r = take_request(wio, thread_stat_id);
-	if (!r) {
-		m_queue_wait.wait_for(lock, std::chrono::seconds(1));
-		r = take_request(wio, thread_stat_id);
+		list_for_each_entry(it, &s->queue, req_entry) {
+			auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
+
+			if ((cmd->flags & (DNET_FLAGS_REPLY | DNET_FLAGS_NOLOCK)) == DNET_FLAGS_NOLOCK) {
+				list_del_init(&it->req_entry);
+				account_taken(it);
+				return it;
+			}
+		}
 	}
 
+	return nullptr;
+}
+
+dnet_io_req *dnet_request_queue::take_parked_request(dnet_work_io *wio)
+{
+	/*
+	 * Parked thread does not claim new transactions, but other threads may have moved
+	 * replies or requests with keys locked by this thread into its lists just before it was parked.
+	 */
+	__atomic_store_n(&wio->trans, ~0ULL, __ATOMIC_RELEASE);
+
+	auto r = take_own_request(wio);
 	if (r) {
-		list_del_init(&r->req_entry);
 		--m_queue_size;
+		if (is_background(reinterpret_cast<const dnet_cmd *>(r->header)))
+			++m_background_active;
+		return r;
 	}
 
-	return r;
+	std::unique_lock<std::mutex> lock(m_wait_mutex);
+	m_parked_wait.wait_for(lock, std::chrono::milliseconds(100), [&] () {
+		return wio->thread_index < m_active_threads.load();
+	});
+
+	return nullptr;
 }
 
-dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thread_stat_id)
+dnet_io_req *dnet_request_queue::take_own_request(dnet_work_io *wio)
 {
-	FORMATTED(HANDY_TIMER_SCOPE, ("pool.%s.search_trans_time", thread_stat_id));
+	std::unique_lock<std::mutex> lock(thread_lock(wio));
+	struct list_head *lists[] = { &wio->reply_list, &wio->request_list };
 
-	dnet_work_pool *pool = wio->pool;
-	dnet_io_req *it, *tmp;
-	uint64_t trans;
+	for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i) {
+		if (!list_empty(lists[i])) {
+			auto it = list_first_entry(lists[i], struct dnet_io_req, req_entry);
+			auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
+
+			__atomic_store_n(&wio->trans, cmd->trans, __ATOMIC_RELEASE);
+			list_del_init(&it->req_entry);
+			return it;
+		}
+	}
+
+	return nullptr;
+}
+
+dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *search_time_metric)
+{
+	HANDY_TIMER_SCOPE(search_time_metric);
 
 	/*
 	 * Comment below is only related to client IO threads processing replies from the server.
@@ -99,47 +286,117 @@ dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thr
 	 * transactions they are assigned to, thus not allowing any further process, since no thread will be able to
 	 * process current request and move to the next one.
 	 */
-	wio->trans = ~0ULL;
+	__atomic_store_n(&wio->trans, ~0ULL, __ATOMIC_RELEASE);
 
-	if (!list_empty(&wio->reply_list)) {
-		it = list_first_entry(&wio->reply_list, struct dnet_io_req, req_entry);
-		auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
-		trans = cmd->trans;
-		wio->trans = trans;
-		return it;
+	auto r = take_own_request(wio);
+	if (r) {
+		if (is_background(reinterpret_cast<const dnet_cmd *>(r->header)))
+			++m_background_active;
+		return r;
 	}
 
-	if (!list_empty(&wio->request_list)) {
-		it = list_first_entry(&wio->request_list, struct dnet_io_req, req_entry);
-		auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
-		trans = cmd->trans;
-		wio->trans = trans;
-		return it;
+	/*
+	 * Background requests are taken only when there are threads left for interactive ones,
+	 * they go first only if interactive requests were served DNET_REQUEST_QUEUE_BACKGROUND_SHARE times in a row.
+	 * Single thread pool has no thread to spare and processes both.
+	 */
+	const int active_threads = m_active_threads.load();
+	const int background_limit = std::max(active_threads - std::max(active_threads / 4, 1), 1);
+
+	if (m_interactive_served.load() >= DNET_REQUEST_QUEUE_BACKGROUND_SHARE) {
+		r = take_background_request(wio, background_limit);
+		if (r)
+			return r;
+	}
+
+	r = take_class_request(wio, false);
+	if (r)
+		return r;
+
+	return take_background_request(wio, background_limit);
+}
+
+dnet_io_req *dnet_request_queue::take_background_request(dnet_work_io *wio, int limit)
+{
+	int active = m_background_active.load();
+
+	do {
+		if (active >= limit)
+			return nullptr;
+	} while (!m_background_active.compare_exchange_weak(active, active + 1));
+
+	auto r = take_class_request(wio, true);
+	if (!r)
+		--m_background_active;
+
+	return r;
+}
+
+dnet_io_req *dnet_request_queue::take_class_request(dnet_work_io *wio, bool background)
+{
+	const size_t home = wio->thread_index % m_shards.size();
+
+	for (size_t i = 0; i < m_shards.size(); ++i) {
+		shard &s = *m_shards[(home + i) % m_shards.size()];
+
+		auto r = take_shard_request(wio, s, background ? &s.background_queue : &s.queue);
+		if (r)
+			return r;
 	}
 
-	std::unique_lock<std::mutex> lock(m_locks_mutex);
+	return nullptr;
+}
+
+dnet_io_req *dnet_request_queue::take_shard_request(dnet_work_io *wio, shard &s, struct list_head *queue)
+{
+	dnet_work_pool *pool = wio->pool;
+	dnet_io_req *it, *tmp;
+	uint64_t trans;
+
+	dnet_site_lock_guard<std::mutex> lock(s.mutex, DNET_LOCK_SITE("shard.mutex"));
 
-	list_for_each_entry_safe(it, tmp, &m_queue, req_entry) {
+	list_for_each_entry_safe(it, tmp, queue, req_entry) {
 		auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
 
 		/* This is not a transaction reply, process it right now */
 		if (!(cmd->flags & DNET_FLAGS_REPLY)) {
-			if (cmd->flags & DNET_FLAGS_NOLOCK)
+			if (cmd->flags & DNET_FLAGS_NOLOCK) {
+				list_del_init(&it->req_entry);
 				return it;
+			}
+
+			stripe &ks = key_stripe(cmd->id);
+			dnet_site_lock_guard<std::mutex> stripe_lock(ks.mutex, DNET_LOCK_SITE("stripe.mutex"));
 
 			locked_keys_t::iterator it_lock;
 			bool inserted;
 			std::tie(it_lock, inserted) =
-				m_locked_keys.insert({cmd->id, reinterpret_cast<dnet_locks_entry *>(nullptr)});
+				ks.locked_keys.insert(std::make_pair(cmd->id, static_cast<dnet_locks_entry *>(nullptr)));
+			const bool shared = is_shared(cmd);
+
 			if (inserted) {
-				auto lock_entry = take_lock_entry(wio);
+				auto lock_entry = take_lock_entry(ks, shared ? nullptr : wio);
+				lock_entry->readers = shared ? 1 : 0;
 				it_lock->second = lock_entry;
+				list_del_init(&it->req_entry);
 				return it;
+			} else if (it_lock->second->readers) {
+				auto lock_entry = it_lock->second;
+				/* key is shared by readers, new reader joins them unless a writer waits for them */
+				if (shared && !lock_entry->writer_waiting) {
+					++lock_entry->readers;
+					list_del_init(&it->req_entry);
+					return it;
+				}
+
+				if (!shared)
+					lock_entry->writer_waiting = true;
 			} else {
 				auto lock_entry = it_lock->second;
 				dnet_work_io *owner = lock_entry->owner;
 				/* if key is already locked by other pool thread, then move it to request_list of this thread */
 				if (owner) {
+					std::unique_lock<std::mutex> owner_lock(thread_lock(owner));
 					list_move_tail(&it->req_entry, &owner->request_list);
 				}
 			}
@@ -148,16 +405,20 @@ dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thr
 			bool trans_in_process = false;
 
 			for (int i = 0; i < pool->num; ++i) {
+				dnet_work_io *other = &pool->wio_list[i];
+
 				/* Someone claimed transaction @tid */
-				if (pool->wio_list[i].trans == trans) {
-					list_move_tail(&it->req_entry, &pool->wio_list[i].reply_list);
+				if (__atomic_load_n(&other->trans, __ATOMIC_ACQUIRE) == trans) {
+					std::unique_lock<std::mutex> other_lock(thread_lock(other));
+					list_move_tail(&it->req_entry, &other->reply_list);
 					trans_in_process = true;
 					break;
 				}
 			}
 
 			if (!trans_in_process) {
-				wio->trans = trans;
+				__atomic_store_n(&wio->trans, trans, __ATOMIC_RELEASE);
+				list_del_init(&it->req_entry);
 				return it;
 			}
 		}
@@ -173,70 +434,127 @@ void dnet_request_queue::release_request(const dnet_io_req *req)
 	    !(cmd->flags & DNET_FLAGS_NOLOCK)) {
 		release_key(&cmd->id);
 	}
+
+	if (is_background(cmd)) {
+		--m_background_active;
+		/* background requests may wait in the queue for this thread */
+		notify();
+	}
 }
 
 void dnet_request_queue::lock_key(const dnet_id *id)
 {
-	std::unique_lock<std::mutex> lock(m_locks_mutex);
+	stripe &ks = key_stripe(*id);
+	std::unique_lock<std::mutex> lock(ks.mutex);
 	while (1) {
-		auto it = m_locked_keys.find(*id);
-		if (it == m_locked_keys.end())
+		auto it = ks.locked_keys.find(*id);
+		if (it == ks.locked_keys.end())
 			break;
 
 		auto lock_entry = it->second;
 		lock_entry->unlock_event.wait_for(lock, std::chrono::seconds(1));
 	}
-	auto lock_entry = take_lock_entry(nullptr);
-	m_locked_keys.insert(std::make_pair(*id, lock_entry));
+	auto lock_entry = take_lock_entry(ks, nullptr);
+	ks.locked_keys.insert(std::make_pair(*id, lock_entry));
 }
 
 void dnet_request_queue::unlock_key(const dnet_id *id)
 {
 	release_key(id);
-	m_queue_wait.notify_one();
 }
 
 void dnet_request_queue::release_key(const dnet_id *id)
 {
-	std::unique_lock<std::mutex> lock(m_locks_mutex);
-	auto it = m_locked_keys.find(*id);
-	if (it != m_locked_keys.end()) {
+	stripe &ks = key_stripe(*id);
+	{
+		dnet_site_lock_guard<std::mutex> lock(ks.mutex, DNET_LOCK_SITE("stripe.mutex"));
+		auto it = ks.locked_keys.find(*id);
+		if (it == ks.locked_keys.end())
+			return;
+
 		auto lock_entry = it->second;
-		const dnet_work_io *owner = lock_entry->owner;
+		dnet_work_io *owner = lock_entry->owner;
+		/* shared key is unlocked by its last reader */
+		if (lock_entry->readers && --lock_entry->readers)
+			return;
 		/*
 		 * Unlock key only if it was locked directly by dnet_oplock() (owner == 0) and
 		 * there is no scheduled keys (by take_request()) in request_list
 		 * (where all keys have same id as given in argument)
 		 * of pool thread (owner != 0).
 		 */
-		if (owner && !list_empty(&owner->request_list))
-			return;
-		m_locked_keys.erase(it);
-		put_lock_entry(lock_entry);
+		if (owner) {
+			std::unique_lock<std::mutex> owner_lock(thread_lock(owner));
+			if (!list_empty(&owner->request_list))
+				return;
+		}
+		ks.locked_keys.erase(it);
+		put_lock_entry(ks, lock_entry);
 		lock_entry->unlock_event.notify_one();
 	}
+
+	/* requests with this key may wait in the queue */
+	notify();
 }
 
-dnet_locks_entry *dnet_request_queue::take_lock_entry(dnet_work_io *wio)
+dnet_locks_entry *dnet_request_queue::take_lock_entry(stripe &s, dnet_work_io *wio)
 {
-	if (m_lock_pool.empty()) {
+	if (s.lock_pool.empty()) {
 		auto entry = new(std::nothrow) dnet_locks_entry;
-		m_lock_pool.push_back(entry);
+		s.lock_pool.push_back(entry);
 	}
-	auto entry = m_lock_pool.front();
-	m_lock_pool.pop_front();
+	auto entry = s.lock_pool.front();
+	s.lock_pool.pop_front();
 	entry->owner = wio;
+	entry->readers = 0;
+	entry->writer_waiting = false;
 	return entry;
 }
 
-void dnet_request_queue::put_lock_entry(dnet_locks_entry *entry)
+void dnet_request_queue::put_lock_entry(stripe &s, dnet_locks_entry *entry)
 {
-	m_lock_pool.push_back(entry);
+	s.lock_pool.push_back(entry);
 }
 
 void dnet_request_queue::get_list_stats(list_stat *stats) const
 {
 	stats->list_size = m_queue_size;
+	stats->active_threads = m_active_threads;
+}
+
+void dnet_request_queue::get_load(dnet_pool_load *load)
+{
+	const unsigned long long wait_time = m_wait_time.exchange(0);
+	const unsigned long long count = m_wait_count.exchange(0);
+
+	load->requests = count;
+	load->wait_time = count ? wait_time / count : 0;
+	load->idle_threads = m_waiters;
+	load->active_threads = m_active_threads;
+}
+
+bool dnet_request_queue::is_parked(const dnet_work_io *wio) const
+{
+	return wio->thread_index >= m_active_threads.load();
+}
+
+bool dnet_request_queue::has_idle_threads() const
+{
+	return m_waiters.load() > 0;
+}
+
+void dnet_request_queue::wake()
+{
+	notify();
+}
+
+void dnet_request_queue::set_active_threads(int num)
+{
+	num = std::max(1, std::min(num, m_threads_count));
+
+	std::unique_lock<std::mutex> lock(m_wait_mutex);
+	m_active_threads = num;
+	m_parked_wait.notify_all();
 }
 
 
@@ -246,19 +564,55 @@ void dnet_push_request(struct dnet_work_pool *pool, struct dnet_io_req *req)
 	queue->push_request(req);
 }
 
-struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *thread_stat_id)
+struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *search_time_metric, int wait)
 {
 	struct dnet_work_pool *pool = wio->pool;
 	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
-	return queue->pop_request(wio, thread_stat_id);
+	return queue->pop_request(wio, search_time_metric, wait != 0);
 }
 
-void dnet_release_request(struct dnet_work_io *wio, const struct dnet_io_req *req)
+struct dnet_io_req *dnet_steal_request(struct dnet_work_pool *pool)
 {
-	auto queue = reinterpret_cast<dnet_request_queue*>(wio->pool->request_queue);
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	return queue->steal_request();
+}
+
+void dnet_release_request(struct dnet_work_pool *pool, const struct dnet_io_req *req)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
 	queue->release_request(req);
 }
 
+void dnet_get_pool_load(struct dnet_work_pool *pool, struct dnet_pool_load *load)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	queue->get_load(load);
+}
+
+void dnet_set_pool_active_threads(struct dnet_work_pool *pool, int num)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	queue->set_active_threads(num);
+}
+
+int dnet_work_io_parked(struct dnet_work_io *wio)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(wio->pool->request_queue);
+	return queue->is_parked(wio);
+}
+
+int dnet_pool_has_idle_threads(struct dnet_work_pool *pool)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	return queue->has_idle_threads();
+}
+
+void dnet_wake_pool(struct dnet_work_pool *pool)
+{
+	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	queue->wake();
+}
+
 void dnet_oplock(struct dnet_backend_io *backend, const struct dnet_id *id)
 {
 	auto pool = backend->pool.recv_pool.pool;
@@ -279,9 +633,13 @@ void dnet_get_pool_list_stats(struct dnet_work_pool *pool, struct list_stat *sta
 	queue->get_list_stats(stats);
 }
 
-void *dnet_request_queue_create(int has_backend)
+void *dnet_request_queue_create(int has_backend, int num_threads)
 {
-	return new(std::nothrow) dnet_request_queue(has_backend != 0);
+	try {
+		return new dnet_request_queue(has_backend != 0, num_threads);
+	} catch (...) {
+		return NULL;
+	}
 }
 
 void dnet_request_queue_destroy(void *queue)
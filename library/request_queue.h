@@ -4,10 +4,36 @@
 #include "elliptics.h"
 #include "murmurhash.h"
 
+/*
+ * Maximum number of sub-queues in single request queue, actual number
+ * is the minimum of this value and number of pool threads.
+ */
+#define DNET_REQUEST_QUEUE_MAX_SHARDS	16
+/* Number of independently locked key tables */
+#define DNET_REQUEST_QUEUE_LOCK_STRIPES	64
+/*
+ * Background request is taken ahead of interactive ones once per this number
+ * of interactive requests, so background work is not starved by steady frontend load.
+ */
+#define DNET_REQUEST_QUEUE_BACKGROUND_SHARE	16
+
+struct dnet_pool_load {
+	/* average queue wait time of requests taken since previous measurement, usecs */
+	uint64_t	wait_time;
+	/* number of such requests */
+	uint64_t	requests;
+	/* active threads waiting for new requests */
+	int		idle_threads;
+	int		active_threads;
+};
+
 #ifdef __cplusplus
 #include <unordered_map>
 #include <condition_variable>
+#include <list>
+#include <memory>
 #include <mutex>
+#include <vector>
 #if __GNUC__ == 4 && __GNUC_MINOR__ < 5
 #  include <cstdatomic>
 #else
@@ -19,12 +45,41 @@ struct dnet_locks_entry
 {
 	std::condition_variable unlock_event;
 	dnet_work_io *owner;
+	/* number of requests holding the key in shared mode, key is locked exclusively if it is zero */
+	int readers;
+	/* exclusive request waits for readers, new readers are not let in until it takes the key */
+	bool writer_waiting;
 };
 
 /*
  * dnet_request_queue is queue of requests with specific key locking semantics: its pop_request()
  * lookups first request with non-locked key in queue, locks this key and returns the request.
  * Also it provides methods for specific key lock/unlock mechanism and provides internal statistics.
+ *
+ * Queue is split into several shards: requests are hashed into shards by key, replies - by transaction number.
+ * Every pool thread has its home shard and steals from others when home one has nothing to process.
+ * Locked keys are stored in striped tables, each stripe has its own lock, thus neither pop nor
+ * lock operations are serialized on single mutex for the whole pool.
+ *
+ * Requests which only read the key (see is_shared()) lock it in shared mode: any number of them
+ * are processed by different pool threads at the same time. Other requests lock the key exclusively,
+ * requests which come while it is locked exclusively are moved into the owner thread's list.
+ * Exclusive request waiting for readers stays in the queue and stops new readers of the key,
+ * so steady reads do not starve writes.
+ *
+ * Every shard keeps interactive and background requests (see is_background()) in separate lists.
+ * Background requests are taken only when there are no interactive requests available or once per
+ * DNET_REQUEST_QUEUE_BACKGROUND_SHARE interactive ones, and no more than 3/4 of pool threads
+ * and never all of them in pool of several threads process background requests at the same time,
+ * so interactive requests always have free threads.
+ *
+ * Only first set_active_threads() threads take requests from shards, the rest are parked:
+ * they finish requests already moved into their own lists and sleep until pool is grown.
+ *
+ * Nonblocking requests do not lock keys, so threads of other pools may take them by steal_request()
+ * when all threads of this pool are busy.
+ *
+ * Lock order is: shard -> stripe -> thread lists.
  */
 class dnet_request_queue
 {
@@ -32,32 +87,38 @@ public:
 	/*!
 	 * Constructor: initializes internal state properly
 	 */
-	dnet_request_queue(bool has_backend);
+	dnet_request_queue(bool has_backend, int num_threads);
 	/*!
-	 * Destructor: frees all dnet_locks_entry objects in /a m_lock_pool and destroys all requests in /a m_queue
+	 * Destructor: frees all dnet_locks_entry objects in stripes lock pools and destroys all requests in shards
 	 */
 	~dnet_request_queue();
 
 	/*!
-	 * Puts request \a req into /a m_queue
+	 * Puts request \a req into the shard it belongs to
 	 */
 	void push_request(dnet_io_req *req);
 	/*!
-	 * Tries to take first available request with non-locked key and removes it from /a m_queue
+	 * Tries to take first available request with non-locked key and removes it from the queue,
+	 * waits for new requests for a while if \a wait is set and there are no such requests
 	 */
-	dnet_io_req *pop_request(dnet_work_io *wio, const char *thread_stat_id);
+	dnet_io_req *pop_request(dnet_work_io *wio, const char *search_time_metric, bool wait);
 	/*!
-	 * Releases request's /a req key from /a m_locked_keys
+	 * Takes first interactive DNET_FLAGS_NOLOCK request for thread of other pool,
+	 * returns nullptr if there is no such request or this pool has idle threads
+	 */
+	dnet_io_req *steal_request();
+	/*!
+	 * Releases request's /a req key from locked keys
 	 */
 	void release_request(const dnet_io_req *req);
 
 	/*!
-	 * Saves key identified by /a id into /a m_locked_keys or waits until key will be unlocked (by calling release_request() or unlock_key())
-	 * and signalized using conditional var of dnet_locks_entry object associated with this key in /a m_locked_keys map.
+	 * Saves key identified by /a id into locked keys or waits until key will be unlocked (by calling release_request() or unlock_key())
+	 * and signalized using conditional var of dnet_locks_entry object associated with this key.
 	 */
 	void lock_key(const dnet_id *id);
 	/*!
-	 * Removes key identified by /a id from /a m_locked_keys and notifies waiting threads
+	 * Removes key identified by /a id from locked keys and notifies waiting threads
 	 */
 	void unlock_key(const dnet_id *id);
 
@@ -65,49 +126,171 @@ public:
 	 * Returns internal queue statistics
 	 */
 	void get_list_stats(list_stat *stats) const;
+	/*!
+	 * Returns queue wait time of requests taken since previous call and number of idle threads
+	 */
+	void get_load(dnet_pool_load *load);
+	/*!
+	 * Sets number of threads which take requests from the queue
+	 */
+	void set_active_threads(int num);
+	/*!
+	 * Returns true if thread \a wio is parked and does not take requests from shards
+	 */
+	bool is_parked(const dnet_work_io *wio) const;
+	/*!
+	 * Returns true if some threads wait for new requests
+	 */
+	bool has_idle_threads() const;
+	/*!
+	 * Wakes up thread waiting for new requests, so it may look for requests of other pools
+	 */
+	void wake();
 
 private:
+	typedef size_t (*hash_function_t)(const dnet_id &);
+	typedef bool (*equal_function_t)(const dnet_id &, const dnet_id &);
+	typedef std::unordered_map<dnet_id, dnet_locks_entry *, hash_function_t, equal_function_t> locked_keys_t;
+
+	struct shard
+	{
+		shard();
+
+		struct list_head	queue;
+		struct list_head	background_queue;
+		std::mutex		mutex;
+	};
+
+	struct stripe
+	{
+		stripe(hash_function_t hash, equal_function_t equal);
+
+		locked_keys_t			locked_keys;
+		std::list<dnet_locks_entry *>	lock_pool;
+		std::mutex			mutex;
+	};
+
+	/*
+	 * Returns true if request is processed with background priority: it has DNET_FLAGS_BACKGROUND
+	 * or it is iterator or server-side send which may take pool thread for a long time
+	 */
+	static bool is_background(const dnet_cmd *cmd);
 	/*
-	 * Returns first available request with non-locked key from /a m_queue and saves request's key into /a m_locked_keys
+	 * Returns true if request only reads the key, so it may share key's lock with other such requests
 	 */
-	dnet_io_req *take_request(dnet_work_io *wio, const char *thread_stat_id);
+	static bool is_shared(const dnet_cmd *cmd);
+	/*
+	 * Returns shard index which given command belongs to
+	 */
+	size_t shard_index(const dnet_cmd *cmd) const;
+	/*
+	 * Returns stripe of locked keys which contains key identified by \a id
+	 */
+	stripe &key_stripe(const dnet_id &id);
+	/*
+	 * Returns request from thread's own reply or request lists
+	 */
+	dnet_io_req *take_own_request(dnet_work_io *wio);
+	/*
+	 * Returns first available request with non-locked key from list \a queue of shard \a s and locks request's key
+	 */
+	dnet_io_req *take_shard_request(dnet_work_io *wio, shard &s, struct list_head *queue);
+	/*
+	 * Returns first available request of given class from home shard or any other shard
+	 */
+	dnet_io_req *take_class_request(dnet_work_io *wio, bool background);
+	/*
+	 * Takes background request if fewer than \a limit threads process them, the slot is claimed atomically
+	 */
+	dnet_io_req *take_background_request(dnet_work_io *wio, int limit);
+	/*
+	 * Returns first available request from thread's lists, home shard or any other shard
+	 */
+	dnet_io_req *take_request(dnet_work_io *wio, const char *search_time_metric);
+	/*
+	 * Returns request from lists of parked thread or waits until thread is activated
+	 */
+	dnet_io_req *take_parked_request(dnet_work_io *wio);
 	/*!
-	 * Removes key identified by /a id from /a m_locked_keys
+	 * Removes key identified by /a id from locked keys
 	 */
 	void release_key(const dnet_id *id);
 	/*!
-	 * Takes dnet_locks_entry object from /a m_lock_pool
+	 * Takes dnet_locks_entry object from lock pool of stripe /a s, it is locked exclusively by /a wio
 	 */
-	dnet_locks_entry *take_lock_entry(dnet_work_io *wio);
+	dnet_locks_entry *take_lock_entry(stripe &s, dnet_work_io *wio);
 	/*!
-	 * Puts back dnet_locks_entry into /a m_lock_pool
+	 * Puts back dnet_locks_entry into lock pool of stripe /a s
+	 */
+	void put_lock_entry(stripe &s, dnet_locks_entry *entry);
+	/*
+	 * Wakes up thread waiting for new requests
+	 */
+	void notify();
+	/*
+	 * Updates statistics by request \a r taken from the queue
 	 */
-	void put_lock_entry(dnet_locks_entry *entry);
+	void account_taken(const dnet_io_req *r);
+
+	std::mutex &thread_lock(const dnet_work_io *wio);
 
 private:
-	struct list_head m_queue;
-	std::mutex m_queue_mutex;
-	std::condition_variable m_queue_wait;
+	hash_function_t				m_hash;
+
+	std::vector<std::unique_ptr<shard>>	m_shards;
+	std::vector<std::unique_ptr<stripe>>	m_stripes;
+	/* guards reply_list and request_list of pool threads */
+	std::unique_ptr<std::mutex[]>		m_thread_locks;
+	int					m_threads_count;
+
+	std::atomic_ullong			m_queue_size;
+
+	/* number of threads processing background requests */
+	std::atomic_int				m_background_active;
+	/* interactive requests taken since the last background one */
+	std::atomic_int				m_interactive_served;
 
-	std::atomic_ullong m_queue_size;
+	/* number of threads taking requests from shards, threads with bigger index are parked */
+	std::atomic_int				m_active_threads;
+	std::condition_variable			m_parked_wait;
 
-	typedef std::unordered_map<dnet_id, dnet_locks_entry *, size_t(*)(const dnet_id&), bool(*)(const dnet_id&, const dnet_id&)> locked_keys_t;
-	locked_keys_t m_locked_keys;
-	std::list<dnet_locks_entry *> m_lock_pool;
-	std::mutex m_locks_mutex;
+	/* queue wait time of taken requests, usecs */
+	std::atomic_ullong			m_wait_time;
+	std::atomic_ullong			m_wait_count;
+
+	/* incremented every time new request can be processed, used to avoid lost wakeups */
+	std::atomic_ullong			m_generation;
+	std::atomic_int				m_waiters;
+	std::mutex				m_wait_mutex;
+	std::condition_variable			m_wait;
 };
 
 extern "C" {
 #endif // __cplusplus
 
-void *dnet_request_queue_create(int has_backend);
+void *dnet_request_queue_create(int has_backend, int num_threads);
 void dnet_request_queue_destroy(void *queue);
 
 void dnet_push_request(struct dnet_work_pool *pool, struct dnet_io_req *req);
-struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *thread_stat_id);
-void dnet_release_request(struct dnet_work_io *wio, const struct dnet_io_req *req);
+/*
+ * @search_time_metric is name of the timer of request search, see dnet_pool_metric()
+ */
+struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *search_time_metric, int wait);
+/*
+ * Takes nonblocking request of @pool for thread of other pool, see dnet_request_queue::steal_request()
+ */
+struct dnet_io_req *dnet_steal_request(struct dnet_work_pool *pool);
+/*
+ * @pool is the pool request has been taken from
+ */
+void dnet_release_request(struct dnet_work_pool *pool, const struct dnet_io_req *req);
 
 void dnet_get_pool_list_stats(struct dnet_work_pool *pool, struct list_stat *stats);
+void dnet_get_pool_load(struct dnet_work_pool *pool, struct dnet_pool_load *load);
+void dnet_set_pool_active_threads(struct dnet_work_pool *pool, int num);
+int dnet_work_io_parked(struct dnet_work_io *wio);
+int dnet_pool_has_idle_threads(struct dnet_work_pool *pool);
+void dnet_wake_pool(struct dnet_work_pool *pool);
 
 void dnet_oplock(struct dnet_backend_io *backend, const struct dnet_id *id);
 void dnet_opunlock(struct dnet_backend_io *backend, const struct dnet_id *id);
@@ -2,12 +2,13 @@
 #include "elliptics.h"
 #include <elliptics/utils.hpp>
 
-static int dnet_cmd_reverse_lookup(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data __unused)
+static int dnet_cmd_reverse_lookup(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
 {
 	struct dnet_node *n = st->n;
 	int err = -ENXIO;
 	int version[4] = {0, 0, 0, 0};
 	int indexes_shard_count = 0;
+	struct dnet_route_generation *known = NULL;
 
 	dnet_version_decode(&cmd->id, version);
 	dnet_indexes_shard_count_decode(&cmd->id, &indexes_shard_count);
@@ -22,15 +23,23 @@ static int dnet_cmd_reverse_lookup(struct dnet_net_state *st, struct dnet_cmd *c
 	dnet_version_encode(&cmd->id);
 	dnet_indexes_shard_count_encode(&cmd->id, n->indexes_shard_count);
 
-	dnet_log(n, DNET_LOG_INFO, "%s: reverse lookup command: client indexes shard count: %d, server indexes shard count: %d",
+	/* older clients do not send generation of their cached ids */
+	if (cmd->size >= sizeof(struct dnet_route_generation)) {
+		known = reinterpret_cast<struct dnet_route_generation *>(data);
+		dnet_convert_route_generation(known);
+	}
+
+	dnet_log(n, DNET_LOG_INFO, "%s: reverse lookup command: client indexes shard count: %d, server indexes shard count: %d, "
+			"client route generation: %llx",
 			dnet_state_dump_addr(st),
 			indexes_shard_count,
-			n->indexes_shard_count);
+			n->indexes_shard_count,
+			known ? (unsigned long long)known->generation : 0ULL);
 
 	{
-		pthread_mutex_lock(&n->state_lock);
-		err = dnet_route_list_send_all_ids_nolock(st, &cmd->id, cmd->trans, DNET_CMD_REVERSE_LOOKUP, 1, 0);
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_mutex_lock(&n->state_lock);
+		err = n->route->send_all_ids_nolock(st, &cmd->id, cmd->trans, DNET_CMD_REVERSE_LOOKUP, 1, 0, known);
+		dnet_mutex_unlock(&n->state_lock);
 	}
 
 err_out_exit:
@@ -143,9 +152,9 @@ static int dnet_cmd_join_client(struct dnet_net_state *st, struct dnet_cmd *cmd,
 	for (i = 0; i < id_container->backends_count; ++i) {
 		err = dnet_idc_update_backend(st, backends[i]);
 		if (err) {
-			pthread_mutex_lock(&n->state_lock);
+			dnet_mutex_lock(&n->state_lock);
 			dnet_idc_destroy_nolock(st);
-			pthread_mutex_unlock(&n->state_lock);
+			dnet_mutex_unlock(&n->state_lock);
 
 			goto err_out_move_back;
 		}
@@ -162,10 +171,10 @@ static int dnet_cmd_join_client(struct dnet_net_state *st, struct dnet_cmd *cmd,
 	goto err_out_free;
 
 err_out_move_back:
-	pthread_mutex_lock(&n->state_lock);
+	dnet_mutex_lock(&n->state_lock);
 	list_move_tail(&st->node_entry, &n->empty_state_list);
 	list_move_tail(&st->storage_state_entry, &n->storage_state_list);
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_mutex_unlock(&n->state_lock);
 err_out_free:
 	free(backends);
 err_out_exit:
@@ -211,8 +220,9 @@ err_out_exit:
 	return err;
 }
 
-dnet_route_list::dnet_route_list(dnet_node *node) : m_node(node)
+dnet_route_list::dnet_route_list(dnet_node *node) : m_node(node), m_generation(0)
 {
+	update_generation();
 }
 
 dnet_route_list::~dnet_route_list()
@@ -258,6 +268,7 @@ int dnet_route_list::enable_backend(size_t backend_id, int group_id, dnet_raw_id
 	backend.activated = true;
 	backend.group_id = group_id;
 	backend.ids.assign(ids, ids + ids_count);
+	update_generation();
 
 	int err = dnet_idc_update_backend(m_node->st, backend_ids);
 	send_update_to_states(cmd, backend_id);
@@ -274,9 +285,10 @@ int dnet_route_list::disable_backend(size_t backend_id)
 
 	backend_info &backend = m_backends[backend_id];
 	backend.activated = false;
+	update_generation();
 
 	{
-		dnet_pthread_lock_guard guard(m_node->state_lock);
+		dnet_pthread_lock_guard guard(m_node->state_lock, DNET_LOCK_SITE("m_node->state_lock"));
 		dnet_idc_remove_backend_nolock(m_node->st, backend_id);
 	}
 
@@ -311,13 +323,42 @@ int dnet_route_list::on_join(dnet_net_state *st, dnet_cmd *cmd, void *data)
 int dnet_route_list::join(dnet_net_state *st)
 {
 	std::lock_guard<std::mutex> lock_guard(m_mutex);
-	dnet_pthread_lock_guard guard(st->n->state_lock);
+	dnet_pthread_lock_guard guard(st->n->state_lock, DNET_LOCK_SITE("st->n->state_lock"));
 
 	return dnet_state_join_nolock(st);
 }
 
+/*
+ * FNV-1a of ids of all enabled backends: it is the same after restart of the node with the same ids,
+ * so ids cached by clients on disk stay valid, and changes with any backend.
+ */
+void dnet_route_list::update_generation()
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	auto update = [&hash] (const void *data, size_t size) {
+		const unsigned char *ptr = reinterpret_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= ptr[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	for (size_t backend_id = 0; backend_id < m_backends.size(); ++backend_id) {
+		const backend_info &backend = m_backends[backend_id];
+		if (!backend.activated)
+			continue;
+
+		const uint64_t header[2] = { backend_id, uint64_t(backend.group_id) };
+		update(header, sizeof(header));
+		update(backend.ids.data(), backend.ids.size() * sizeof(dnet_raw_id));
+	}
+
+	m_generation = hash ? hash : 1;
+}
+
 int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
-		uint64_t trans, unsigned int command, int reply, int direct)
+		uint64_t trans, unsigned int command, int reply, int direct, const dnet_route_generation *known)
 {
 	using namespace ioremap::elliptics;
 
@@ -332,9 +373,14 @@ int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 	size_t total_size = sizeof(dnet_addr_cmd) + m_node->addr_num * sizeof(dnet_addr) + sizeof(dnet_id_container);
 	size_t backends_count = 0;
 
+	// client has cached exactly these ids, only addresses and generation are sent
+	const bool unchanged = known && known->generation == m_generation;
+	if (known)
+		total_size += sizeof(dnet_route_generation);
+
 	for (auto it = m_backends.begin(); it != m_backends.end(); ++it) {
 		backend_info &backend = *it;
-		if (!backend.activated)
+		if (!backend.activated || unchanged)
 			continue;
 
 		++backends_count;
@@ -360,6 +406,8 @@ int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 		cmd->flags |= DNET_FLAGS_DIRECT;
 	if (reply)
 		cmd->flags |= DNET_FLAGS_REPLY;
+	if (known)
+		cmd->flags |= DNET_FLAGS_ROUTE_GENERATION;
 	cmd->size = total_size - sizeof(dnet_cmd);
 
 	dnet_addr_container *addr_container = reinterpret_cast<dnet_addr_container *>(cmd + 1);
@@ -375,7 +423,7 @@ int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 
 	for (size_t backend_id = 0; backend_id < m_backends.size(); ++backend_id) {
 		backend_info &backend = m_backends[backend_id];
-		if (!backend.activated)
+		if (!backend.activated || unchanged)
 			continue;
 
 		dnet_backend_ids *backend_ids = reinterpret_cast<dnet_backend_ids *>(ptr);
@@ -392,13 +440,22 @@ int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 		ptr += backend.ids.size() * sizeof(dnet_raw_id) + sizeof(dnet_backend_ids);
 	}
 
+	if (known) {
+		dnet_route_generation *generation = reinterpret_cast<dnet_route_generation *>(ptr);
+		generation->generation = m_generation;
+		generation->flags = unchanged ? DNET_ROUTE_GENERATION_UNCHANGED : 0;
+		dnet_convert_route_generation(generation);
+	}
+
 	dnet_log(st->n, DNET_LOG_INFO, "%s: sending ids: command: %s [%d], trans: %lld, "
 			"client (this node): %s -> %s, "
-			"address idx: %d, container addr-num: %d, local addr-num: %d, backends-num: %d",
+			"address idx: %d, container addr-num: %d, local addr-num: %d, backends-num: %d, "
+			"generation: %llx, unchanged: %d",
 			dnet_dump_id(&cmd->id),
 			dnet_cmd_string(command), command, (unsigned long long)trans,
 			client_addr, server_addr,
-			st->idx, addr_container->addr_num, st->n->addr_num, id_container->backends_count);
+			st->idx, addr_container->addr_num, st->n->addr_num, id_container->backends_count,
+			(unsigned long long)m_generation, unchanged);
 
 	dnet_convert_id_container(id_container);
 
@@ -409,7 +466,7 @@ int dnet_route_list::send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 void dnet_route_list::send_update_to_states(dnet_cmd *cmd, size_t backend_id)
 {
 	dnet_net_state *state;
-	dnet_pthread_lock_guard guard(m_node->state_lock);
+	dnet_pthread_lock_guard guard(m_node->state_lock, DNET_LOCK_SITE("m_node->state_lock"));
 
 	list_for_each_entry(state, &m_node->storage_state_list, storage_state_entry) {
 		if (!state->__ids_sent || state == m_node->st)
@@ -474,5 +531,6 @@ int dnet_route_list_disable_backend(dnet_route_list *route, size_t backend_id)
 int dnet_route_list_send_all_ids_nolock(dnet_net_state *st, dnet_id *id,
 		uint64_t trans, unsigned int command, int reply, int direct)
 {
-	return safe_call(st->n->route, &dnet_route_list::send_all_ids_nolock, st, id, trans, command, reply, direct);
+	return safe_call(st->n->route, &dnet_route_list::send_all_ids_nolock, st, id, trans, command, reply, direct,
+			static_cast<const dnet_route_generation *>(NULL));
 }
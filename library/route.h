@@ -22,10 +22,15 @@ public:
 	int on_join(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
 
 	int join(dnet_net_state *st);
+	/*
+	 * If @known is not NULL, reply is followed by generation of the ids and ids
+	 * are not sent at all if @known one is the same
+	 */
 	int send_all_ids_nolock(dnet_net_state *st, struct dnet_id *id, uint64_t trans,
-		unsigned int command, int reply, int direct);
+		unsigned int command, int reply, int direct, const dnet_route_generation *known = NULL);
 protected:
 	void send_update_to_states(dnet_cmd *cmd, size_t backend_id);
+	void update_generation();
 
 private:
 	dnet_node *m_node;
@@ -42,6 +47,8 @@ private:
 
 	std::mutex m_mutex;
 	std::vector<backend_info> m_backends;
+	// generation of ids of enabled @m_backends, guarded by @m_mutex
+	uint64_t m_generation;
 };
 
 extern "C" {
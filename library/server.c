@@ -79,6 +79,81 @@ err_out_exit:
 	return err;
 }
 
+/*
+ * Every server shard but the first one gets its own listening socket bound to the same port,
+ * they are kept in storage state list and are destroyed with the rest of states
+ */
+static int dnet_server_shards_listen(struct dnet_node *n, struct dnet_addr *la)
+{
+	struct dnet_net_state *st;
+	int i, s, err = 0;
+
+	for (i = 1; i < n->server_shards; ++i) {
+		s = dnet_socket_create_listening(n, la);
+		if (s < 0) {
+			err = s;
+			dnet_log(n, DNET_LOG_ERROR, "server shard: %d: failed to create listening socket: %s %d",
+					i, strerror(-err), err);
+			break;
+		}
+
+		dnet_set_incoming_cpu(n, s, i);
+		dnet_set_client_shard(i);
+
+		st = dnet_state_create(n, NULL, 0, n->addrs, s, &err, 0, 0, 0, 1, NULL, 0);
+		if (!st) {
+			dnet_log(n, DNET_LOG_ERROR, "server shard: %d: failed to create listening state: %s %d",
+					i, strerror(-err), err);
+			break;
+		}
+
+		dnet_state_put(st);
+	}
+
+	dnet_set_client_shard(-1);
+	return err;
+}
+
+/*
+ * Listens unix socket of every server address for co-located clients, see dnet_config::local_socket_dir
+ */
+static int dnet_server_local_listen(struct dnet_node *n)
+{
+	struct dnet_net_state *st;
+	int i, s, err = 0;
+
+	if (!n->local_socket_dir)
+		return 0;
+
+	for (i = 0; i < n->addr_num; ++i) {
+		s = dnet_local_socket_listen(n, &n->addrs[i]);
+		if (s < 0)
+			return s;
+
+		st = dnet_state_create(n, NULL, 0, &n->addrs[i], s, &err, 0, 0, i, 1, NULL, 0);
+		if (!st) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: failed to create local listening state: %s %d",
+					dnet_addr_string(&n->addrs[i]), strerror(-err), err);
+			return err;
+		}
+
+		dnet_state_put(st);
+	}
+
+	return 0;
+}
+
+static void dnet_server_local_unlink(struct dnet_node *n)
+{
+	int i;
+
+	if (!n->local_socket_dir)
+		return;
+
+	for (i = 0; i < n->addr_num; ++i)
+		dnet_local_socket_unlink(n, &n->addrs[i]);
+}
+
 struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 {
 	struct dnet_node *n;
@@ -117,14 +192,14 @@ struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 	if (!n->notify_hash_size) {
 		n->notify_hash_size = DNET_DEFAULT_NOTIFY_HASH_SIZE;
 
-		err = dnet_notify_init(n);
-		if (err)
-			goto err_out_monitor_destroy;
-
 		dnet_log(n, DNET_LOG_NOTICE, "No notify hash size provided, using default %d.",
 				n->notify_hash_size);
 	}
 
+	err = dnet_notify_init(n);
+	if (err)
+		goto err_out_monitor_destroy;
+
 	err = dnet_local_addr_add(n, addrs, addr_num);
 	if (err)
 		goto err_out_notify_exit;
@@ -158,6 +233,12 @@ struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 			goto err_out_route_list_destroy;
 		}
 
+		/* the first listening socket belongs to the first server shard */
+		if (n->server_shards) {
+			dnet_set_incoming_cpu(n, s, 0);
+			dnet_set_client_shard(0);
+		}
+
 		n->st = dnet_state_create(n, NULL, 0, n->addrs, s, &err, DNET_JOIN, 1, 0, 1, n->addrs, n->addr_num);
 
 		if (!n->st) {
@@ -170,6 +251,14 @@ struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 		// by network thread given state was attached to, and it can already release it.
 		dnet_state_put(n->st);
 
+		err = dnet_server_shards_listen(n, &la);
+		if (err)
+			goto err_out_state_destroy;
+
+		err = dnet_server_local_listen(n);
+		if (err)
+			goto err_out_state_destroy;
+
 		err = dnet_backend_init_all(n);
 		if (err) {
 			dnet_log(n, DNET_LOG_ERROR, "failed to init backends: %s %d", strerror(-err), err);
@@ -186,6 +275,24 @@ struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 				goto err_out_backends_cleanup;
 			}
 		}
+
+		err = dnet_defrag_scheduler_start(n);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "defrag: scheduler initialization failure: %s %d", strerror(-err), err);
+			goto err_out_srw_cleanup;
+		}
+
+		err = dnet_qos_init(n);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "qos: initialization failure: %s %d", strerror(-err), err);
+			goto err_out_defrag_stop;
+		}
+
+		err = dnet_capture_init(n);
+		if (err) {
+			dnet_log(n, DNET_LOG_ERROR, "capture: initialization failure: %s %d", strerror(-err), err);
+			goto err_out_qos_cleanup;
+		}
 	}
 
 	dnet_log(n, DNET_LOG_DEBUG, "New server node has been created at port %d.", cfg->port);
@@ -193,6 +300,11 @@ struct dnet_node *dnet_server_node_create(struct dnet_config_data *cfg_data)
 	pthread_sigmask(SIG_SETMASK, &previous_sigset, NULL);
 	return n;
 
+err_out_qos_cleanup:
+	dnet_qos_cleanup(n);
+err_out_defrag_stop:
+	dnet_defrag_scheduler_stop(n);
+err_out_srw_cleanup:
 	dnet_srw_cleanup(n);
 err_out_backends_cleanup:
 	dnet_set_need_exit(n);
@@ -219,6 +331,11 @@ void dnet_server_node_destroy(struct dnet_node *n)
 {
 	dnet_log(n, DNET_LOG_DEBUG, "Destroying server node.");
 
+	/*
+	 * Scheduler starts and stops defragmentation of backends, so it should be stopped before them
+	 */
+	dnet_defrag_scheduler_stop(n);
+
 	/*
 	 * Stop network and backend thread pools
 	 */
@@ -231,12 +348,21 @@ void dnet_server_node_destroy(struct dnet_node *n)
 	 */
 	dnet_monitor_exit(n);
 
+	/* network threads check requests against rate limits, so they are freed after threads are stopped */
+	dnet_qos_cleanup(n);
+
+	/* io threads record requests, pending records are flushed once they are stopped */
+	dnet_capture_cleanup(n);
+
+	dnet_server_local_unlink(n);
+
 	dnet_node_cleanup_common_resources(n);
 
 	dnet_route_list_destroy(n->route);
 	n->route = NULL;
 
 	dnet_backend_cleanup_all(n);
+	dnet_update_filters_unload(n);
 
 	dnet_srw_cleanup(n);
 
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2008+ Evgeniy Polyakov <zbr@ioremap.net>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+#include "hugepage.h"
+
+struct dnet_slab_chunk {
+	struct list_head	entry;
+	/* NULL for allocations which do not fit any class */
+	struct dnet_slab_pool	*pool;
+	int			class_idx;
+	/* chunk lives in a huge page region and must never be passed to free() */
+	int			huge;
+} __attribute__ ((aligned (16)));
+
+struct dnet_slab_batch {
+	struct list_head	entry;
+	void			*region;
+	size_t			size;
+	int			backing;
+};
+
+static int dnet_slab_class_index(size_t size)
+{
+	int idx = 0;
+	size_t class_size = 1UL << DNET_SLAB_MIN_SHIFT;
+
+	while (class_size < size) {
+		class_size <<= 1;
+		++idx;
+	}
+
+	return idx;
+}
+
+struct dnet_slab_pool *dnet_slab_pool_create(void)
+{
+	struct dnet_slab_pool *pool;
+	int i, err;
+
+	pool = calloc(1, sizeof(struct dnet_slab_pool));
+	if (!pool)
+		goto err_out_exit;
+
+	atomic_init(&pool->refcnt, 1);
+	atomic_init(&pool->large, 0);
+
+	for (i = 0; i < DNET_SLAB_CLASS_NUM; ++i) {
+		struct dnet_slab_class *c = &pool->classes[i];
+
+		err = dnet_lock_init(&c->lock);
+		if (err)
+			goto err_out_destroy;
+
+		INIT_LIST_HEAD(&c->free_list);
+		INIT_LIST_HEAD(&c->huge_batches);
+		c->size = 1UL << (DNET_SLAB_MIN_SHIFT + i);
+		c->free_max = DNET_SLAB_CLASS_CACHE_SIZE / c->size;
+		if (c->free_max < DNET_SLAB_CLASS_CACHE_MIN)
+			c->free_max = DNET_SLAB_CLASS_CACHE_MIN;
+	}
+
+	return pool;
+
+err_out_destroy:
+	while (--i >= 0)
+		dnet_lock_destroy(&pool->classes[i].lock);
+	free(pool);
+err_out_exit:
+	return NULL;
+}
+
+static void dnet_slab_pool_free(struct dnet_slab_pool *pool)
+{
+	struct dnet_slab_chunk *chunk, *tmp;
+	struct dnet_slab_batch *batch, *btmp;
+	int i;
+
+	for (i = 0; i < DNET_SLAB_CLASS_NUM; ++i) {
+		struct dnet_slab_class *c = &pool->classes[i];
+
+		list_for_each_entry_safe(chunk, tmp, &c->free_list, entry) {
+			list_del(&chunk->entry);
+			if (!chunk->huge)
+				free(chunk);
+		}
+
+		/* there are no outstanding buffers, so every huge chunk has just been unlinked above */
+		list_for_each_entry_safe(batch, btmp, &c->huge_batches, entry) {
+			list_del(&batch->entry);
+			dnet_huge_free(batch->region, batch->size, batch->backing);
+			free(batch);
+		}
+
+		dnet_lock_destroy(&c->lock);
+	}
+
+	free(pool);
+}
+
+static inline void dnet_slab_pool_put(struct dnet_slab_pool *pool)
+{
+	if (atomic_dec_and_test(&pool->refcnt))
+		dnet_slab_pool_free(pool);
+}
+
+void dnet_slab_pool_destroy(struct dnet_slab_pool *pool)
+{
+	if (pool)
+		dnet_slab_pool_put(pool);
+}
+
+/*
+ * Carves buffers of class @idx from a new huge page region, puts all of them but one
+ * into the free list and returns that one. Returns NULL if huge pages are off or not available.
+ */
+static struct dnet_slab_chunk *dnet_slab_class_refill_huge(struct dnet_slab_class *c, int idx)
+{
+	const size_t chunk_size = sizeof(struct dnet_slab_chunk) + c->size;
+	struct dnet_slab_chunk *chunk = NULL;
+	struct dnet_slab_batch *batch;
+	size_t i, num;
+	char *region;
+
+	if (dnet_huge_pages_mode() == DNET_HUGE_PAGES_NONE)
+		return NULL;
+
+	batch = malloc(sizeof(struct dnet_slab_batch));
+	if (!batch)
+		return NULL;
+
+	batch->size = DNET_SLAB_HUGE_BATCH_SIZE;
+	batch->region = dnet_huge_alloc(batch->size, &batch->backing);
+	if (!batch->region) {
+		free(batch);
+		return NULL;
+	}
+
+	region = batch->region;
+	num = batch->size / chunk_size;
+
+	dnet_lock_lock(&c->lock);
+	for (i = 0; i < num; ++i) {
+		chunk = (struct dnet_slab_chunk *)(region + i * chunk_size);
+		chunk->class_idx = idx;
+		chunk->huge = 1;
+
+		if (i == num - 1)
+			break;
+
+		list_add_tail(&chunk->entry, &c->free_list);
+		c->free_num++;
+	}
+
+	list_add(&batch->entry, &c->huge_batches);
+	c->huge_size += batch->size;
+	dnet_lock_unlock(&c->lock);
+
+	return chunk;
+}
+
+void *dnet_slab_alloc(struct dnet_slab_pool *pool, size_t size)
+{
+	struct dnet_slab_chunk *chunk = NULL;
+	struct dnet_slab_class *c;
+	int idx;
+
+	if (!pool || size > DNET_SLAB_MAX_SIZE) {
+		chunk = malloc(sizeof(struct dnet_slab_chunk) + size);
+		if (!chunk)
+			return NULL;
+
+		if (pool)
+			atomic_inc(&pool->large);
+
+		chunk->pool = NULL;
+		chunk->class_idx = -1;
+		chunk->huge = 0;
+		return chunk + 1;
+	}
+
+	idx = dnet_slab_class_index(size);
+	c = &pool->classes[idx];
+
+	dnet_lock_lock(&c->lock);
+	if (!list_empty(&c->free_list)) {
+		chunk = list_first_entry(&c->free_list, struct dnet_slab_chunk, entry);
+		list_del(&chunk->entry);
+		c->free_num--;
+		c->hits++;
+	} else {
+		c->misses++;
+	}
+	dnet_lock_unlock(&c->lock);
+
+	if (!chunk)
+		chunk = dnet_slab_class_refill_huge(c, idx);
+
+	if (!chunk) {
+		chunk = malloc(sizeof(struct dnet_slab_chunk) + c->size);
+		if (!chunk)
+			return NULL;
+
+		chunk->class_idx = idx;
+		chunk->huge = 0;
+	}
+
+	chunk->pool = pool;
+	atomic_inc(&pool->refcnt);
+
+	return chunk + 1;
+}
+
+void dnet_slab_free(void *ptr)
+{
+	struct dnet_slab_chunk *chunk;
+	struct dnet_slab_pool *pool;
+	struct dnet_slab_class *c;
+	int cached = 0;
+
+	if (!ptr)
+		return;
+
+	chunk = (struct dnet_slab_chunk *)ptr - 1;
+	pool = chunk->pool;
+
+	if (!pool) {
+		free(chunk);
+		return;
+	}
+
+	c = &pool->classes[chunk->class_idx];
+
+	/*
+	 * Pool is being destroyed when owner has dropped its reference,
+	 * there is no need to fill free list in this case.
+	 * Huge chunks are always returned to the list, their regions are unmapped with the pool.
+	 */
+	if (chunk->huge || atomic_read(&pool->refcnt) > 1) {
+		dnet_lock_lock(&c->lock);
+		if (chunk->huge || c->free_num < c->free_max) {
+			list_add(&chunk->entry, &c->free_list);
+			c->free_num++;
+			cached = 1;
+		}
+		dnet_lock_unlock(&c->lock);
+	}
+
+	if (!cached)
+		free(chunk);
+
+	dnet_slab_pool_put(pool);
+}
+
+void dnet_slab_pool_stat(struct dnet_slab_pool *pool, struct dnet_slab_stat *stat)
+{
+	int i;
+
+	memset(stat, 0, sizeof(struct dnet_slab_stat));
+
+	if (!pool)
+		return;
+
+	stat->large = atomic_read(&pool->large);
+
+	for (i = 0; i < DNET_SLAB_CLASS_NUM; ++i) {
+		struct dnet_slab_class *c = &pool->classes[i];
+
+		dnet_lock_lock(&c->lock);
+		stat->hits += c->hits;
+		stat->misses += c->misses;
+		stat->cached_num += c->free_num;
+		stat->cached_size += c->free_num * c->size;
+		stat->huge_size += c->huge_size;
+		dnet_lock_unlock(&c->lock);
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2008+ Evgeniy Polyakov <zbr@ioremap.net>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_SLAB_H
+#define __DNET_SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "elliptics/core.h"
+
+#include "atomic.h"
+#include "list.h"
+#include "lock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Size-classed pool of receive buffers.
+ *
+ * Every network thread owns one pool, inbound dnet_io_req together with command
+ * header and attached data are allocated from it. Buffers are returned by io threads
+ * into the free list of the class they were taken from, so there is no thread-local
+ * magic and the pool can be used from any thread.
+ *
+ * Allocations larger than the biggest class fall back to plain malloc().
+ *
+ * When huge pages are enabled (see hugepage.h), a class which has run out of buffers
+ * is refilled with a batch of them carved from a 2 MB huge page region. Such buffers
+ * are never freed one by one, they always go back to the free list and regions
+ * are unmapped together with the pool.
+ */
+
+/* The smallest class holds 512 bytes, every next one is twice as large */
+#define DNET_SLAB_MIN_SHIFT		9
+#define DNET_SLAB_CLASS_NUM		9
+#define DNET_SLAB_MAX_SIZE		(1UL << (DNET_SLAB_MIN_SHIFT + DNET_SLAB_CLASS_NUM - 1))
+
+/* Maximum number of bytes kept in the free list of a single class */
+#define DNET_SLAB_CLASS_CACHE_SIZE	(4 * 1024 * 1024)
+/* ... but never less than this number of buffers */
+#define DNET_SLAB_CLASS_CACHE_MIN	16
+
+/* Size of huge page region a class is refilled with */
+#define DNET_SLAB_HUGE_BATCH_SIZE	(2 * 1024 * 1024)
+
+struct dnet_slab_class {
+	struct dnet_lock	lock;
+	struct list_head	free_list;
+	size_t			size;
+	long			free_num, free_max;
+
+	/* allocations served from @free_list */
+	uint64_t		hits;
+	/* allocations which had to go to malloc() or to a new huge page region */
+	uint64_t		misses;
+
+	/* huge page regions buffers of this class are carved from */
+	struct list_head	huge_batches;
+	uint64_t		huge_size;
+};
+
+struct dnet_slab_pool {
+	/* one reference is held by owner, others by outstanding buffers */
+	atomic_t		refcnt;
+	atomic_t		large;
+	struct dnet_slab_class	classes[DNET_SLAB_CLASS_NUM];
+};
+
+struct dnet_slab_stat {
+	uint64_t		hits;
+	uint64_t		misses;
+	uint64_t		large;
+	uint64_t		cached_size;
+	uint64_t		cached_num;
+	/* bytes of huge page regions */
+	uint64_t		huge_size;
+};
+
+struct dnet_slab_pool *dnet_slab_pool_create(void);
+/* Drops owner's reference, pool is freed when the last outstanding buffer is returned */
+void dnet_slab_pool_destroy(struct dnet_slab_pool *pool);
+
+void *dnet_slab_alloc(struct dnet_slab_pool *pool, size_t size);
+void dnet_slab_free(void *ptr);
+
+void dnet_slab_pool_stat(struct dnet_slab_pool *pool, struct dnet_slab_stat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_SLAB_H */
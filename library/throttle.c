@@ -0,0 +1,203 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "elliptics.h"
+
+/* the longest single sleep, limits changed at runtime are picked up after it */
+#define DNET_THROTTLE_MAX_SLEEP_US	1000000ULL
+
+static uint64_t dnet_throttle_elapsed_us(const struct timespec *from, const struct timespec *to)
+{
+	if (to->tv_sec < from->tv_sec || (to->tv_sec == from->tv_sec && to->tv_nsec < from->tv_nsec))
+		return 0;
+
+	return (to->tv_sec - from->tv_sec) * 1000000ULL + to->tv_nsec / 1000 - from->tv_nsec / 1000;
+}
+
+static int dnet_rate_limit_init(struct dnet_rate_limit *l, uint64_t rate)
+{
+	int err;
+
+	memset(l, 0, sizeof(struct dnet_rate_limit));
+
+	err = pthread_mutex_init(&l->lock, NULL);
+	if (err)
+		return -err;
+
+	l->rate = rate;
+	l->tokens = rate;
+	clock_gettime(CLOCK_MONOTONIC, &l->last);
+	l->window_start = l->last;
+	return 0;
+}
+
+static void dnet_rate_limit_set(struct dnet_rate_limit *l, uint64_t rate)
+{
+	pthread_mutex_lock(&l->lock);
+	l->rate = rate;
+
+	/* debt made at the old rate is not paid longer than a second at the new one */
+	if (l->tokens > (int64_t)rate)
+		l->tokens = rate;
+	if (l->tokens < -(int64_t)rate)
+		l->tokens = -(int64_t)rate;
+	pthread_mutex_unlock(&l->lock);
+}
+
+/*
+ * Takes @units from the bucket and returns number of microseconds caller has to wait,
+ * bucket holds at most one second worth of tokens
+ */
+static uint64_t dnet_rate_limit_consume(struct dnet_rate_limit *l, uint64_t units)
+{
+	struct timespec now;
+	uint64_t elapsed, wait = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&l->lock);
+
+	l->window_units += units;
+	elapsed = dnet_throttle_elapsed_us(&l->window_start, &now);
+	if (elapsed >= 1000000) {
+		l->current = l->window_units * 1000000 / elapsed;
+		l->window_units = 0;
+		l->window_start = now;
+	}
+
+	if (l->rate) {
+		elapsed = dnet_throttle_elapsed_us(&l->last, &now);
+		if (elapsed > 1000000)
+			elapsed = 1000000;
+
+		l->tokens += l->rate * elapsed / 1000000;
+		if (l->tokens > (int64_t)l->rate)
+			l->tokens = l->rate;
+
+		l->tokens -= units;
+		if (l->tokens < 0)
+			wait = (uint64_t)(-l->tokens) * 1000000 / l->rate;
+	}
+	l->last = now;
+
+	pthread_mutex_unlock(&l->lock);
+
+	return wait;
+}
+
+static uint64_t dnet_rate_limit_current(struct dnet_rate_limit *l)
+{
+	struct timespec now;
+	uint64_t current;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&l->lock);
+	current = l->current;
+	/* nothing has been consumed for the whole last window */
+	if (dnet_throttle_elapsed_us(&l->window_start, &now) >= 2000000)
+		current = 0;
+	pthread_mutex_unlock(&l->lock);
+
+	return current;
+}
+
+int dnet_throttle_init(struct dnet_throttle *t, uint64_t rate_bytes, uint64_t rate_keys)
+{
+	int err;
+
+	err = dnet_rate_limit_init(&t->bytes, rate_bytes);
+	if (err)
+		return err;
+
+	err = dnet_rate_limit_init(&t->keys, rate_keys);
+	if (err) {
+		pthread_mutex_destroy(&t->bytes.lock);
+		return err;
+	}
+
+	return 0;
+}
+
+void dnet_throttle_destroy(struct dnet_throttle *t)
+{
+	pthread_mutex_destroy(&t->keys.lock);
+	pthread_mutex_destroy(&t->bytes.lock);
+}
+
+void dnet_throttle_set(struct dnet_throttle *t, uint64_t rate_bytes, uint64_t rate_keys)
+{
+	dnet_rate_limit_set(&t->bytes, rate_bytes);
+	dnet_rate_limit_set(&t->keys, rate_keys);
+}
+
+void dnet_throttle_get(struct dnet_throttle *t, uint64_t *rate_bytes, uint64_t *rate_keys)
+{
+	pthread_mutex_lock(&t->bytes.lock);
+	*rate_bytes = t->bytes.rate;
+	pthread_mutex_unlock(&t->bytes.lock);
+
+	pthread_mutex_lock(&t->keys.lock);
+	*rate_keys = t->keys.rate;
+	pthread_mutex_unlock(&t->keys.lock);
+}
+
+void dnet_throttle_current(struct dnet_throttle *t, uint64_t *rate_bytes, uint64_t *rate_keys)
+{
+	*rate_bytes = dnet_rate_limit_current(&t->bytes);
+	*rate_keys = dnet_rate_limit_current(&t->keys);
+}
+
+static uint64_t dnet_throttle_consume(struct dnet_throttle *t, uint64_t bytes, uint64_t keys)
+{
+	uint64_t wait_bytes, wait_keys;
+
+	if (!t)
+		return 0;
+
+	wait_bytes = dnet_rate_limit_consume(&t->bytes, bytes);
+	wait_keys = dnet_rate_limit_consume(&t->keys, keys);
+
+	return wait_bytes > wait_keys ? wait_bytes : wait_keys;
+}
+
+void dnet_throttle_wait(struct dnet_throttle *request, struct dnet_throttle *backend, uint64_t bytes, uint64_t keys)
+{
+	uint64_t wait, backend_wait;
+
+	wait = dnet_throttle_consume(request, bytes, keys);
+	backend_wait = dnet_throttle_consume(backend, bytes, keys);
+
+	while (wait || backend_wait) {
+		uint64_t sleep_us = wait > backend_wait ? wait : backend_wait;
+
+		if (sleep_us > DNET_THROTTLE_MAX_SLEEP_US)
+			sleep_us = DNET_THROTTLE_MAX_SLEEP_US;
+
+		usleep(sleep_us);
+
+		/* limits could be changed or removed while we were sleeping */
+		wait = dnet_throttle_consume(request, 0, 0);
+		backend_wait = dnet_throttle_consume(backend, 0, 0);
+	}
+}
@@ -0,0 +1,270 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+
+#include "tls.h"
+
+#ifdef HAVE_KTLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+/* OpenSSL built without kernel TLS can not keep sendfile() working on encrypted connections */
+#ifdef OPENSSL_NO_KTLS
+#undef HAVE_KTLS
+#endif
+#endif
+
+#ifdef HAVE_KTLS
+
+struct dnet_tls_context {
+	SSL_CTX			*ctx;
+};
+
+struct dnet_tls {
+	SSL			*ssl;
+};
+
+int dnet_tls_context_create(const char *cert_file, const char *key_file, const char *ca_file,
+		struct dnet_tls_context **ctxp)
+{
+	struct dnet_tls_context *ctx;
+	int err = -EINVAL;
+
+	if (!cert_file || !key_file || !ca_file)
+		return -EINVAL;
+
+	ctx = calloc(1, sizeof(struct dnet_tls_context));
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->ctx = SSL_CTX_new(TLS_method());
+	if (!ctx->ctx) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	SSL_CTX_set_min_proto_version(ctx->ctx, TLS1_2_VERSION);
+	/* kernel takes records right after the handshake, nothing may follow it in user space */
+	SSL_CTX_set_options(ctx->ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_TICKET | SSL_OP_NO_RENEGOTIATION);
+	SSL_CTX_set_num_tickets(ctx->ctx, 0);
+	SSL_CTX_set_mode(ctx->ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+	if (SSL_CTX_use_certificate_chain_file(ctx->ctx, cert_file) != 1 ||
+			SSL_CTX_use_PrivateKey_file(ctx->ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+			SSL_CTX_check_private_key(ctx->ctx) != 1 ||
+			SSL_CTX_load_verify_locations(ctx->ctx, ca_file, NULL) != 1)
+		goto err_out_free_ctx;
+
+	/* both client and server nodes have to present certificate signed by the same CA */
+	SSL_CTX_set_verify(ctx->ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+
+	*ctxp = ctx;
+	return 0;
+
+err_out_free_ctx:
+	SSL_CTX_free(ctx->ctx);
+err_out_free:
+	free(ctx);
+	return err;
+}
+
+void dnet_tls_context_destroy(struct dnet_tls_context *ctx)
+{
+	if (ctx) {
+		SSL_CTX_free(ctx->ctx);
+		free(ctx);
+	}
+}
+
+int dnet_tls_start(struct dnet_tls_context *ctx, int s, int server, struct dnet_tls **tlsp)
+{
+	struct dnet_tls *tls;
+
+	ERR_clear_error();
+
+	tls = calloc(1, sizeof(struct dnet_tls));
+	if (!tls)
+		return -ENOMEM;
+
+	tls->ssl = SSL_new(ctx->ctx);
+	if (!tls->ssl)
+		goto err_out_free;
+
+	if (SSL_set_fd(tls->ssl, s) != 1)
+		goto err_out_free_ssl;
+
+	if (server)
+		SSL_set_accept_state(tls->ssl);
+	else
+		SSL_set_connect_state(tls->ssl);
+
+	*tlsp = tls;
+	return 0;
+
+err_out_free_ssl:
+	SSL_free(tls->ssl);
+err_out_free:
+	free(tls);
+	return -ENOMEM;
+}
+
+void dnet_tls_free(struct dnet_tls *tls)
+{
+	if (tls) {
+		SSL_free(tls->ssl);
+		free(tls);
+	}
+}
+
+int dnet_tls_handshake(struct dnet_tls *tls, uint32_t *events)
+{
+	int ret, err;
+
+	ret = SSL_do_handshake(tls->ssl);
+	if (ret != 1) {
+		switch (SSL_get_error(tls->ssl, ret)) {
+		case SSL_ERROR_WANT_READ:
+			*events = EPOLLIN;
+			return -EAGAIN;
+		case SSL_ERROR_WANT_WRITE:
+			*events = EPOLLOUT;
+			return -EAGAIN;
+		case SSL_ERROR_SYSCALL:
+			err = errno ? -errno : -ECONNRESET;
+			break;
+		default:
+			err = -EPROTO;
+			break;
+		}
+
+		goto err_out_free;
+	}
+
+	/* records which have already been read by OpenSSL would be lost for the kernel */
+	if (!BIO_get_ktls_send(SSL_get_wbio(tls->ssl)) || !BIO_get_ktls_recv(SSL_get_rbio(tls->ssl)) ||
+			SSL_has_pending(tls->ssl)) {
+		err = -ENOTSUP;
+		goto err_out_free;
+	}
+
+	err = 0;
+
+err_out_free:
+	dnet_tls_free(tls);
+	return err;
+}
+
+const char *dnet_tls_error(void)
+{
+	unsigned long e = ERR_peek_last_error();
+	const char *reason = e ? ERR_reason_error_string(e) : NULL;
+
+	return reason ? reason : "no tls error";
+}
+
+#else
+
+int dnet_tls_context_create(const char *cert_file __attribute__ ((unused)), const char *key_file __attribute__ ((unused)),
+		const char *ca_file __attribute__ ((unused)), struct dnet_tls_context **ctx __attribute__ ((unused)))
+{
+	return -ENOTSUP;
+}
+
+void dnet_tls_context_destroy(struct dnet_tls_context *ctx __attribute__ ((unused)))
+{
+}
+
+int dnet_tls_start(struct dnet_tls_context *ctx __attribute__ ((unused)), int s __attribute__ ((unused)),
+		int server __attribute__ ((unused)), struct dnet_tls **tls __attribute__ ((unused)))
+{
+	return -ENOTSUP;
+}
+
+int dnet_tls_handshake(struct dnet_tls *tls __attribute__ ((unused)), uint32_t *events __attribute__ ((unused)))
+{
+	return -ENOTSUP;
+}
+
+void dnet_tls_free(struct dnet_tls *tls __attribute__ ((unused)))
+{
+}
+
+const char *dnet_tls_error(void)
+{
+	return "kernel TLS is not supported by the build";
+}
+
+#endif /* HAVE_KTLS */
+
+static long dnet_tls_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int dnet_tls_handshake_wait(struct dnet_tls_context *ctx, int s, int server, long timeout_ms)
+{
+	struct dnet_tls *tls;
+	struct pollfd pfd;
+	uint32_t events = 0;
+	long deadline = dnet_tls_now_ms() + timeout_ms, left;
+	int flags, err;
+
+	/* handshake is driven by poll(), so that it can not hang on a silent peer */
+	flags = fcntl(s, F_GETFL);
+	if (flags < 0)
+		return -errno;
+	if (!(flags & O_NONBLOCK) && fcntl(s, F_SETFL, flags | O_NONBLOCK) < 0)
+		return -errno;
+
+	err = dnet_tls_start(ctx, s, server, &tls);
+	if (err)
+		goto err_out_restore;
+
+	while ((err = dnet_tls_handshake(tls, &events)) == -EAGAIN) {
+		left = deadline - dnet_tls_now_ms();
+		if (left <= 0) {
+			dnet_tls_free(tls);
+			err = -ETIMEDOUT;
+			break;
+		}
+
+		pfd.fd = s;
+		pfd.events = (events & EPOLLIN) ? POLLIN : POLLOUT;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, left) < 0 && errno != EINTR) {
+			err = -errno;
+			dnet_tls_free(tls);
+			break;
+		}
+	}
+
+err_out_restore:
+	if (!(flags & O_NONBLOCK))
+		fcntl(s, F_SETFL, flags);
+	return err;
+}
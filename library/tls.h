@@ -0,0 +1,81 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_TLS_H
+#define __DNET_TLS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * TLS encryption of connections with record layer in the kernel.
+ *
+ * Handshake is made by OpenSSL in user space, once it is completed keys are passed to the kernel (kTLS),
+ * which encrypts and decrypts records itself or offloads it to NIC when the driver supports TLS offload.
+ * Socket is used as a plain one after that: send(), recv() and sendfile() from files just work.
+ * Session objects are freed right after the handshake, no post-handshake messages are sent,
+ * so connection which gets a control record (like key update) fails with -EIO and is reconnected.
+ */
+struct dnet_tls_context;
+struct dnet_tls;
+
+/* handshake which is made synchronously (accepted connections and lanes) is dropped after this time */
+#define DNET_TLS_HANDSHAKE_TIMEOUT_MS	1000
+
+/*
+ * Creates context which uses certificate @cert_file with key @key_file and verifies peer's certificate
+ * against @ca_file. Returns -ENOTSUP if the build has no kernel TLS support.
+ */
+int dnet_tls_context_create(const char *cert_file, const char *key_file, const char *ca_file,
+		struct dnet_tls_context **ctx);
+void dnet_tls_context_destroy(struct dnet_tls_context *ctx);
+
+/*
+ * Starts handshake on (probably not yet connected) nonblocking socket @s as a client or a server
+ */
+int dnet_tls_start(struct dnet_tls_context *ctx, int s, int server, struct dnet_tls **tls);
+
+/*
+ * Continues handshake. Returns -EAGAIN and sets @events to EPOLLIN or EPOLLOUT the socket has to wait for.
+ * Returns 0 once handshake is completed and both directions are moved into the kernel, or negative error
+ * if connection can not be encrypted. In both cases @tls is freed.
+ */
+int dnet_tls_handshake(struct dnet_tls *tls, uint32_t *events);
+
+/*
+ * Frees handshake which has not been completed, socket is not closed
+ */
+void dnet_tls_free(struct dnet_tls *tls);
+
+/*
+ * Makes the whole handshake on socket @s waiting for it at most @timeout_ms milliseconds
+ */
+int dnet_tls_handshake_wait(struct dnet_tls_context *ctx, int s, int server, long timeout_ms);
+
+/*
+ * Returns description of the last TLS error of the calling thread
+ */
+const char *dnet_tls_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_TLS_H */
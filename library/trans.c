@@ -31,58 +31,124 @@
 #include "elliptics/interface.h"
 
 /*
- * Ascending transaction order
+ * Transactions of the state are kept in open addressing hash table keyed by transaction number.
+ *
+ * Linear probing with backward shift deletion is used, so there are no tombstones and lookup
+ * stops at the first empty slot. Transaction number is stored next to the pointer, thus probing
+ * does not touch transactions themselves. Table is kept at most half full, so expected probe
+ * length is about one slot for lookup, insertion and removal.
  */
-static inline int dnet_trans_cmp(uint64_t t2, uint64_t t1)
+#define DNET_TRANS_TABLE_MIN_BITS	6
+
+static inline size_t dnet_trans_table_index(const struct dnet_trans_table *table, uint64_t trans)
 {
-	if (t1 > t2)
-		return 1;
-	if (t1 < t2)
-		return -1;
+	/* Fibonacci hashing spreads consecutive transaction numbers over the whole table */
+	return (trans * 0x9e3779b97f4a7c15ULL) >> (64 - table->bits);
+}
+
+static void dnet_trans_table_place(struct dnet_trans_table *table, uint64_t trans, struct dnet_trans *t)
+{
+	size_t mask = (1UL << table->bits) - 1;
+	size_t i = dnet_trans_table_index(table, trans);
+
+	while (table->slots[i].t)
+		i = (i + 1) & mask;
+
+	table->slots[i].trans = trans;
+	table->slots[i].t = t;
+}
+
+static int dnet_trans_table_resize(struct dnet_trans_table *table, unsigned int bits)
+{
+	struct dnet_trans_table_slot *old = table->slots;
+	size_t old_size = old ? (1UL << table->bits) : 0;
+	size_t i;
+
+	table->slots = calloc(1UL << bits, sizeof(struct dnet_trans_table_slot));
+	if (!table->slots) {
+		table->slots = old;
+		return -ENOMEM;
+	}
+
+	table->bits = bits;
+
+	for (i = 0; i < old_size; ++i) {
+		if (old[i].t)
+			dnet_trans_table_place(table, old[i].trans, old[i].t);
+	}
+
+	free(old);
 	return 0;
 }
 
-struct dnet_trans *dnet_trans_search(struct dnet_net_state *st, uint64_t trans)
+static long dnet_trans_table_find(const struct dnet_trans_table *table, uint64_t trans)
 {
-	struct rb_root *root = &st->trans_root;
-	struct rb_node *n = root->rb_node;
-	struct dnet_trans *t = NULL;
-	int cmp = 1;
+	size_t mask, i;
 
-	while (n) {
-		t = rb_entry(n, struct dnet_trans, trans_entry);
+	if (!table->used)
+		return -1;
+
+	mask = (1UL << table->bits) - 1;
+	i = dnet_trans_table_index(table, trans);
 
-		cmp = dnet_trans_cmp(t->trans, trans);
-		if (cmp < 0)
-			n = n->rb_left;
-		else if (cmp > 0)
-			n = n->rb_right;
-		else
-			return dnet_trans_get(t);
+	while (table->slots[i].t) {
+		if (table->slots[i].trans == trans)
+			return i;
+
+		i = (i + 1) & mask;
 	}
 
-	return NULL;
+	return -1;
 }
 
-int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a)
+static void dnet_trans_table_erase(struct dnet_trans_table *table, size_t i)
 {
-	struct rb_root *root = &st->trans_root;
-	struct rb_node **n = &root->rb_node, *parent = NULL;
-	struct dnet_trans *t;
-	int cmp;
+	size_t mask = (1UL << table->bits) - 1;
+	size_t j = i, home;
+
+	/*
+	 * Move following entries of the cluster into the hole,
+	 * unless their home slot lies between the hole and their current position
+	 */
+	while (1) {
+		j = (j + 1) & mask;
+		if (!table->slots[j].t)
+			break;
 
-	while (*n) {
-		parent = *n;
+		home = dnet_trans_table_index(table, table->slots[j].trans);
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			table->slots[i] = table->slots[j];
+			i = j;
+		}
+	}
+
+	table->slots[i].trans = 0;
+	table->slots[i].t = NULL;
+	table->used--;
+}
+
+struct dnet_trans *dnet_trans_search(struct dnet_net_state *st, uint64_t trans)
+{
+	long i = dnet_trans_table_find(&st->trans_table, trans);
+
+	if (i < 0)
+		return NULL;
 
-		t = rb_entry(parent, struct dnet_trans, trans_entry);
+	return dnet_trans_get(st->trans_table.slots[i].t);
+}
+
+int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a)
+{
+	struct dnet_trans_table *table = &st->trans_table;
+	int err;
+
+	if (dnet_trans_table_find(table, a->trans) >= 0)
+		return -EEXIST;
 
-		cmp = dnet_trans_cmp(t->trans, a->trans);
-		if (cmp < 0)
-			n = &parent->rb_left;
-		else if (cmp > 0)
-			n = &parent->rb_right;
-		else
-			return -EEXIST;
+	if (!table->slots || (table->used + 1) * 2 > (1UL << table->bits)) {
+		err = dnet_trans_table_resize(table, table->slots ? table->bits + 1 : DNET_TRANS_TABLE_MIN_BITS);
+		if (err)
+			return err;
 	}
 
 	if (a->st && a->st->n)
@@ -90,116 +156,191 @@ int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a)
 			dnet_dump_id(&a->cmd.id), dnet_cmd_string(a->cmd.cmd), (unsigned long long)a->trans,
 			dnet_addr_string(&a->st->addr), a->cmd.backend_id);
 
-	rb_link_node(&a->trans_entry, parent, n);
-	rb_insert_color(&a->trans_entry, root);
+	dnet_trans_table_place(table, a->trans, a);
+	table->used++;
+	a->in_trans_table = 1;
 	return 0;
 }
 
 /**
- * Timer functinos are used for timeout check.
- * We insert transaction into timer tree ordered/indexed by time-to-timeout-death.
+ * Timer functions are used for timeout check.
  *
- * Checking thread periodically looks at the begining of the timer tree and kills
- * those transactions which are past the deadline. When transaction reply has been
- * received transaction is removed from the timer tree, its time-to-timeout-death
- * is updated and transaction inserted into the timer tree again.
+ * Transactions are put into hashed timing wheel of their state: every slot covers DNET_TRANS_TIMER_TICK_MS
+ * milliseconds, transaction goes into the slot of its deadline tick. Deadlines further than
+ * one wheel rotation share slots with closer ones, so checking thread compares exact deadline
+ * of every transaction in the slots it scans.
  *
- * It is possible, that multiple transaction were created at the same time with
- * the same time-to-timeout-death, in this case we compare them additionaly using
- * transaction number, which is unique for node.
+ * States which have scheduled transactions are in turn put into node's wheel at the tick
+ * of their closest non-empty slot, thus checking thread wakes up every tick, but looks only
+ * at states which have something due instead of scanning all of them.
+ * State is removed from node's wheel when its last transaction is removed from its wheel,
+ * so every state found in node's wheel is referenced by some transaction.
  *
- * This particular trans2,trans1 order of arguments is very significant - argument order plus
- * the way they are compared below ends up with ascending timeout order, i.e. the smaller
- * timeout (the closer death-time) the closer transaction is to the begining of the timer tree
- * (do not confuse it with the tree root).
+ * When transaction reply has been received transaction is removed from the wheel,
+ * its time-to-timeout-death is updated and transaction is inserted into the wheel again.
  */
-static inline int dnet_trans_cmp_timer(struct dnet_trans *trans2, struct dnet_trans *trans1)
+static inline uint64_t dnet_trans_timer_tick(const struct timeval *tv)
 {
-	struct timeval *t1 = &trans1->time;
-	struct timeval *t2 = &trans2->time;
+	return ((uint64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000) / DNET_TRANS_TIMER_TICK_MS;
+}
 
-	if (t1->tv_sec > t2->tv_sec)
-		return 1;
-	if (t1->tv_sec < t2->tv_sec)
-		return -1;
-	if (t1->tv_usec > t2->tv_usec)
-		return 1;
-	if (t1->tv_usec < t2->tv_usec)
-		return -1;
+static void dnet_trans_timer_wheel_init(struct dnet_trans_timer_wheel *wheel)
+{
+	struct timeval tv;
+	int i;
 
-	return dnet_trans_cmp(trans2->trans, trans1->trans);
+	for (i = 0; i < DNET_TRANS_TIMER_SLOTS; ++i)
+		INIT_LIST_HEAD(&wheel->slots[i]);
+
+	gettimeofday(&tv, NULL);
+	wheel->current = dnet_trans_timer_tick(&tv);
+	wheel->num = 0;
 }
 
-struct dnet_trans *dnet_trans_search_timer(struct dnet_net_state *st, struct dnet_trans *trans)
+/*
+ * Puts @st into node's wheel at @tick, must be called under @st->trans_lock
+ */
+static void dnet_trans_schedule_state_nolock(struct dnet_net_state *st, uint64_t tick)
 {
-	struct rb_root *root = &st->timer_root;
-	struct rb_node *n = root->rb_node;
-	struct dnet_trans *t = NULL;
-	int cmp = 1;
+	struct dnet_node *n = st->n;
 
-	while (n) {
-		t = rb_entry(n, struct dnet_trans, timer_entry);
+	st->trans_check_next = tick;
 
-		cmp = dnet_trans_cmp_timer(t, trans);
-		if (cmp < 0)
-			n = n->rb_left;
-		else if (cmp > 0)
-			n = n->rb_right;
-		else
-			return dnet_trans_get(t);
-	}
+	pthread_mutex_lock(&n->trans_timer_lock);
+	/* slots before the current tick have already been checked */
+	if (tick < n->trans_timer.current)
+		tick = n->trans_timer.current;
 
-	return NULL;
+	st->trans_check_tick = tick;
+	list_move_tail(&st->trans_check_entry, &n->trans_timer.slots[tick % DNET_TRANS_TIMER_SLOTS]);
+	pthread_mutex_unlock(&n->trans_timer_lock);
+}
+
+static void dnet_trans_unschedule_state_nolock(struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+
+	st->trans_check_next = 0;
+
+	pthread_mutex_lock(&n->trans_timer_lock);
+	list_del_init(&st->trans_check_entry);
+	pthread_mutex_unlock(&n->trans_timer_lock);
 }
 
 int dnet_trans_insert_timer_nolock(struct dnet_net_state *st, struct dnet_trans *a)
 {
-	struct rb_root *root = &st->timer_root;
-	struct rb_node **n = &root->rb_node, *parent = NULL;
-	struct dnet_trans *t;
-	int cmp;
+	struct dnet_trans_timer_wheel *wheel = &st->timer_wheel;
+	uint64_t tick = dnet_trans_timer_tick(&a->time);
 
-	while (*n) {
-		parent = *n;
+	if (!list_empty(&a->timer_entry))
+		return -EEXIST;
 
-		t = rb_entry(parent, struct dnet_trans, timer_entry);
+	/* slots before the current tick have already been checked */
+	if (tick < wheel->current)
+		tick = wheel->current;
 
-		cmp = dnet_trans_cmp_timer(t, a);
-		if (cmp < 0)
-			n = &parent->rb_left;
-		else if (cmp > 0)
-			n = &parent->rb_right;
-		else
-			return -EEXIST;
-	}
+	list_add_tail(&a->timer_entry, &wheel->slots[tick % DNET_TRANS_TIMER_SLOTS]);
+	wheel->num++;
+
+	if (!st->trans_check_next || tick < st->trans_check_next)
+		dnet_trans_schedule_state_nolock(st, tick);
 
-	rb_link_node(&a->timer_entry, parent, n);
-	rb_insert_color(&a->timer_entry, root);
 	return 0;
 }
 
 void dnet_trans_remove_timer_nolock(struct dnet_net_state *st, struct dnet_trans *t)
 {
-	if (t->timer_entry.rb_parent_color) {
-		rb_erase(&t->timer_entry, &st->timer_root);
-		t->timer_entry.rb_parent_color = 0;
-	}
+	if (list_empty(&t->timer_entry))
+		return;
+
+	list_del_init(&t->timer_entry);
+
+	if (--st->timer_wheel.num == 0)
+		dnet_trans_unschedule_state_nolock(st);
 }
 
 void dnet_trans_remove_nolock(struct dnet_net_state *st, struct dnet_trans *t)
 {
-	if (!t->trans_entry.rb_parent_color) {
-		dnet_log(st->n, DNET_LOG_ERROR, "%s: trying to remove out-of-trans-tree transaction %llu.",
+	long i;
+
+	if (!t->in_trans_table) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: trying to remove out-of-trans-table transaction %llu.",
 			dnet_dump_id(&t->cmd.id), (unsigned long long)t->trans);
 		return;
 	}
 
-	rb_erase(&t->trans_entry, &st->trans_root);
-	t->trans_entry.rb_parent_color = 0;
+	i = dnet_trans_table_find(&st->trans_table, t->trans);
+	if (i >= 0)
+		dnet_trans_table_erase(&st->trans_table, i);
+	t->in_trans_table = 0;
 
 	dnet_trans_remove_timer_nolock(st, t);
 }
 
+void dnet_state_trans_init(struct dnet_net_state *st)
+{
+	memset(&st->trans_table, 0, sizeof(st->trans_table));
+	dnet_trans_timer_wheel_init(&st->timer_wheel);
+
+	INIT_LIST_HEAD(&st->trans_check_entry);
+	st->trans_check_tick = 0;
+	st->trans_check_next = 0;
+}
+
+int dnet_node_trans_timer_init(struct dnet_node *n)
+{
+	int err;
+
+	err = pthread_mutex_init(&n->trans_timer_lock, NULL);
+	if (err)
+		return -err;
+
+	dnet_trans_timer_wheel_init(&n->trans_timer);
+	dnet_trans_timer_wheel_init(&n->delayed_calls);
+	return 0;
+}
+
+void dnet_node_trans_timer_cleanup(struct dnet_node *n)
+{
+	pthread_mutex_destroy(&n->trans_timer_lock);
+}
+
+void dnet_state_trans_cleanup(struct dnet_net_state *st)
+{
+	dnet_trans_unschedule_state_nolock(st);
+
+	free(st->trans_table.slots);
+	memset(&st->trans_table, 0, sizeof(st->trans_table));
+}
+
+int dnet_state_trans_move_all(struct dnet_net_state *st, struct list_head *head)
+{
+	struct dnet_trans_table *table = &st->trans_table;
+	struct dnet_trans *t;
+	size_t i, size;
+	int num = 0;
+
+	pthread_mutex_lock(&st->trans_lock);
+
+	size = table->slots ? (1UL << table->bits) : 0;
+	for (i = 0; i < size; ) {
+		t = table->slots[i].t;
+		if (!t) {
+			++i;
+			continue;
+		}
+
+		/* removal may shift next entry into this slot, so it is checked again */
+		dnet_trans_remove_nolock(st, t);
+		list_move_tail(&t->trans_list_entry, head);
+		num++;
+	}
+
+	pthread_mutex_unlock(&st->trans_lock);
+
+	return num;
+}
+
 void dnet_trans_remove(struct dnet_trans *t)
 {
 	struct dnet_net_state *st = t->st;
@@ -225,6 +366,7 @@ struct dnet_trans *dnet_trans_alloc(struct dnet_node *n, uint64_t size)
 
 	atomic_init(&t->refcnt, 1);
 	INIT_LIST_HEAD(&t->trans_list_entry);
+	INIT_LIST_HEAD(&t->timer_entry);
 
 	gettimeofday(&t->start, NULL);
 
@@ -254,7 +396,7 @@ void dnet_trans_destroy(struct dnet_trans *t)
 		pthread_mutex_lock(&st->trans_lock);
 		list_del_init(&t->trans_list_entry);
 
-		if (t->trans_entry.rb_parent_color) {
+		if (t->in_trans_table) {
 			dnet_trans_remove_nolock(st, t);
 		}
 
@@ -291,7 +433,7 @@ void dnet_trans_destroy(struct dnet_trans *t)
 			struct dnet_io_attr *local_io = (struct dnet_io_attr *)(local_cmd + 1);
 			double backend_weight = 0.;
 
-			dnet_get_backend_weight(st, t->cmd.backend_id, local_io->flags, &backend_weight);
+			dnet_get_backend_weight(t->owner ? t->owner : st, t->cmd.backend_id, local_io->flags, &backend_weight);
 
 			snprintf(io_buf, sizeof(io_buf), ", weight: %f, %s",
 			         backend_weight, dnet_print_io(local_io));
@@ -310,6 +452,7 @@ void dnet_trans_destroy(struct dnet_trans *t)
 
 	dnet_state_put(t->st);
 	dnet_state_put(t->orig);
+	dnet_state_put(t->owner);
 
 	dnet_node_unset_trace_id();
 	free(t);
@@ -329,6 +472,34 @@ static void dnet_trans_control_fill_cmd(struct dnet_session *s, const struct dne
 	}
 }
 
+/*
+ * Shortens timeout of read or lookup @t to the adaptive timeout of @s for @backend_id of @t->st,
+ * see dnet_session_set_adaptive_timeout(). @t->wait_ts must already hold the session timeout.
+ */
+void dnet_trans_set_adaptive_timeout(struct dnet_session *s, struct dnet_trans *t, int backend_id)
+{
+	struct dnet_backend_latency latency;
+	long timeout_us, session_us;
+
+	if (!s->adaptive_percentile || !t->st)
+		return;
+	if (t->command != DNET_CMD_READ && t->command != DNET_CMD_LOOKUP)
+		return;
+	if (dnet_get_backend_latency(t->st, backend_id, s->adaptive_percentile, &latency))
+		return;
+
+	timeout_us = latency.percentile * s->adaptive_multiplier;
+	if (timeout_us < s->adaptive_min_ms * 1000)
+		timeout_us = s->adaptive_min_ms * 1000;
+
+	session_us = t->wait_ts.tv_sec * 1000000 + t->wait_ts.tv_nsec / 1000;
+	if (timeout_us >= session_us)
+		return;
+
+	t->wait_ts.tv_sec = timeout_us / 1000000;
+	t->wait_ts.tv_nsec = (timeout_us % 1000000) * 1000;
+}
+
 int dnet_trans_send_fail(struct dnet_session *s, struct dnet_addr *addr, struct dnet_trans_control *ctl, int err, int destroy)
 {
 	struct dnet_cmd cmd;
@@ -364,9 +535,10 @@ int dnet_trans_alloc_send_state(struct dnet_session *s, struct dnet_net_state *s
 	struct dnet_node *n = st->n;
 	struct dnet_cmd *cmd;
 	struct dnet_trans *t;
+	int ref = ctl->data_release && ctl->size;
 	int err;
 
-	t = dnet_trans_alloc(n, sizeof(struct dnet_cmd) + ctl->size);
+	t = dnet_trans_alloc(n, sizeof(struct dnet_cmd) + (ref ? 0 : ctl->size));
 	if (!t) {
 		err = dnet_trans_send_fail(s, dnet_state_addr(st), ctl, -ENOMEM, 1);
 		goto err_out_exit;
@@ -386,19 +558,32 @@ int dnet_trans_alloc_send_state(struct dnet_session *s, struct dnet_net_state *s
 
 	memcpy(&t->cmd, cmd, sizeof(struct dnet_cmd));
 
-	if (ctl->size && ctl->data)
+	if (!ref && ctl->size && ctl->data)
 		memcpy(cmd + 1, ctl->data, ctl->size);
 
 	dnet_convert_cmd(cmd);
 
 	t->st = dnet_state_get(st);
+	if (s)
+		dnet_trans_set_adaptive_timeout(s, t, t->cmd.backend_id);
 
 	memset(&req, 0, sizeof(req));
 	req.st = st;
 	req.header = cmd;
-	req.hsize = sizeof(struct dnet_cmd) + ctl->size;
+	req.hsize = sizeof(struct dnet_cmd);
 	req.fd = -1;
 
+	if (ref) {
+		if (ctl->data_acquire)
+			ctl->data_acquire(ctl->data_priv);
+		req.data = ctl->data;
+		req.dsize = ctl->size;
+		req.data_release = ctl->data_release;
+		req.data_priv = ctl->data_priv;
+	} else {
+		req.hsize += ctl->size;
+	}
+
 	dnet_log(n, DNET_LOG_INFO, "%s: %s: created %s",
 			dnet_dump_id(&cmd->id),
 			dnet_cmd_string(cmd->cmd),
@@ -477,7 +662,18 @@ void dnet_update_stall_backend_weights(struct list_head *stall_transactions)
 	int err;
 
 	list_for_each_entry_safe(t, tmp, stall_transactions, trans_list_entry) {
-		st = t->st;
+		st = t->owner ? t->owner : t->st;
+
+		dnet_update_backend_health(st, t->cmd.backend_id, -ETIMEDOUT);
+
+		/* timed out read is accounted as read which took the whole timeout */
+		if (t->command == DNET_CMD_READ) {
+			struct timeval tv;
+
+			gettimeofday(&tv, NULL);
+			dnet_update_backend_latency(st, t->cmd.backend_id,
+					(tv.tv_sec - t->start.tv_sec) * 1000000 + (tv.tv_usec - t->start.tv_usec));
+		}
 
 		err = dnet_get_backend_weight(st, t->cmd.backend_id, DNET_IO_FLAGS_CACHE, &old_cache_weight);
 		if (!err) {
@@ -505,88 +701,99 @@ void dnet_update_stall_backend_weights(struct list_head *stall_transactions)
 	}
 }
 
-int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_head *head)
+static int dnet_trans_timeouted(const struct dnet_trans *t, const struct timeval *tv)
+{
+	if (t->time.tv_sec < tv->tv_sec)
+		return 1;
+	if (t->time.tv_sec == tv->tv_sec)
+		return t->time.tv_usec <= tv->tv_usec;
+	return 0;
+}
+
+static void dnet_trans_move_timeouted_nolock(struct dnet_net_state *st, struct dnet_trans *t, struct list_head *head)
 {
-	struct dnet_trans *t;
-	struct rb_node *rb_node;
-	struct timeval tv;
-	int trans_moved = 0;
 	char str[64];
 	struct tm tm;
 
-	gettimeofday(&tv, NULL);
+	localtime_r((time_t *)&t->start.tv_sec, &tm);
+	strftime(str, sizeof(str), "%F %R:%S", &tm);
 
-	while (1) {
-		/* lock is being locked/unlocked to get a chance for IO thread to process other transactions
-		 * without being stalled for too long waiting for this checking thread to complete
-		 */
-		pthread_mutex_lock(&st->trans_lock);
-
-		t = NULL;
-		rb_node = rb_first(&st->timer_root);
-		if (!rb_node) {
-			pthread_mutex_unlock(&st->trans_lock);
-			break;
-		}
+	// TODO: We may use dnet_log_record_set_request_id here,
+	// but blackhole currently has higher priority for scoped attributes =(
+	dnet_node_set_trace_id(st->n->log, t->cmd.trace_id, t->cmd.flags & DNET_FLAGS_TRACE_BIT, -1);
 
-		t = rb_entry(rb_node, struct dnet_trans, timer_entry);
-		if (!st->__need_exit) {
-			int has_timeouted;
-			if (t->time.tv_sec < tv.tv_sec) {
-				has_timeouted = 1;
-			} else if (t->time.tv_sec == tv.tv_sec) {
-				has_timeouted = (t->time.tv_usec <= tv.tv_usec);
-			} else {
-				has_timeouted = 0;
-			}
-			if (!has_timeouted) {
-				pthread_mutex_unlock(&st->trans_lock);
-				break;
-			}
-		}
-
-		localtime_r((time_t *)&t->start.tv_sec, &tm);
-		strftime(str, sizeof(str), "%F %R:%S", &tm);
+	dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit %s, "
+			"need-exit: %d, started: %s.%06lu",
+			dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
+			dnet_print_trans(t),
+			st->__need_exit,
+			str, t->start.tv_usec);
 
-		// TODO: We may use dnet_log_record_set_request_id here,
-		// but blackhole currently has higher priority for scoped attributes =(
-		dnet_node_set_trace_id(st->n->log, t->cmd.trace_id, t->cmd.flags & DNET_FLAGS_TRACE_BIT, -1);
+	/*
+	 * Remove transaction from every table/list, so it could not be accessed and found while we deal with it.
+	 * In particular, we will call ->complete() callback, which must ensure that no other thread calls it.
+	 *
+	 * Memory allocation for every transaction is handled by reference counters, but callbacks must ensure,
+	 * that no calls are made after 'final' callback has been invoked. 'Final' means is_trans_destroyed() returns true.
+	 *
+	 * We can not destroy transaction right here since route table is locked above this function and transaction
+	 * destruction can lead to state destruction which in turn may kill state and remove it from route table,
+	 * which will deadlock.
+	 */
+	dnet_trans_remove_nolock(st, t);
 
-		dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit %s, "
+	if (!list_empty(&t->trans_list_entry)) {
+		list_del(&t->trans_list_entry);
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit: stall %s, "
+				"it was moved into some timeout list, but yet it exists in timer wheel, "
 				"need-exit: %d, started: %s.%06lu",
 				dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
 				dnet_print_trans(t),
 				st->__need_exit,
 				str, t->start.tv_usec);
+	}
+
+	list_add_tail(&t->trans_list_entry, head);
+	dnet_node_unset_trace_id();
+}
+
+int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_head *head)
+{
+	struct dnet_trans_timer_wheel *wheel = &st->timer_wheel;
+	struct dnet_trans *t, *tmp;
+	struct timeval tv;
+	uint64_t tick, first, last;
+	int trans_moved = 0;
+
+	gettimeofday(&tv, NULL);
+
+	pthread_mutex_lock(&st->trans_lock);
+	first = wheel->current;
+	last = dnet_trans_timer_tick(&tv);
 
-		trans_moved++;
-
-		/*
-		 * Remove transaction from every tree/list, so it could not be accessed and found while we deal with it.
-		 * In particular, we will call ->complete() callback, which must ensure that no other thread calls it.
-		 *
-		 * Memory allocation for every transaction is handled by reference counters, but callbacks must ensure,
-		 * that no calls are made after 'final' callback has been invoked. 'Final' means is_trans_destroyed() returns true.
-		 *
-		 * We can not destroy transaction right here since route table is locked above this function and transaction
-		 * destruction can lead to state destruction which in turn may kill state and remove it from route table,
-		 * which will deadlock.
+	/* current slot may also hold transactions which expire later within this tick, it is checked again next time */
+	if (last > wheel->current)
+		wheel->current = last;
+
+	/* the whole wheel is checked when state is going to exit or checking thread has not run for a full rotation */
+	if (st->__need_exit || last < first || last - first >= DNET_TRANS_TIMER_SLOTS) {
+		first = last - (DNET_TRANS_TIMER_SLOTS - 1);
+	}
+	pthread_mutex_unlock(&st->trans_lock);
+
+	for (tick = first; tick <= last; ++tick) {
+		/* lock is being locked/unlocked to get a chance for IO thread to process other transactions
+		 * without being stalled for too long waiting for this checking thread to complete
 		 */
-		dnet_trans_remove_nolock(st, t);
+		pthread_mutex_lock(&st->trans_lock);
 
-		if (!list_empty(&t->trans_list_entry)) {
-			list_del(&t->trans_list_entry);
-			dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit: stall %s, "
-					"it was moved into some timeout list, but yet it exists in timer tree, "
-					"need-exit: %d, started: %s.%06lu",
-					dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
-					dnet_print_trans(t),
-					st->__need_exit,
-					str, t->start.tv_usec);
-		}
+		list_for_each_entry_safe(t, tmp, &wheel->slots[tick % DNET_TRANS_TIMER_SLOTS], timer_entry) {
+			if (!st->__need_exit && !dnet_trans_timeouted(t, &tv))
+				continue;
 
-		list_add_tail(&t->trans_list_entry, head);
-		dnet_node_unset_trace_id();
+			dnet_trans_move_timeouted_nolock(st, t, head);
+			trans_moved++;
+		}
 
 		pthread_mutex_unlock(&st->trans_lock);
 	}
@@ -679,54 +886,168 @@ static int dnet_trans_check_stall(struct dnet_net_state *st, struct list_head *h
 	return is_stall_state;
 }
 
-static void dnet_check_all_states(struct dnet_node *n)
+struct dnet_delayed_call {
+	struct list_head	entry;
+	uint64_t		tick;
+	void			(*call)(void *priv, int err);
+	void			*priv;
+};
+
+int dnet_node_schedule_call(struct dnet_node *n, long delay_ms, void (*call)(void *priv, int err), void *priv)
+{
+	struct dnet_trans_timer_wheel *wheel = &n->delayed_calls;
+	struct dnet_delayed_call *c;
+	struct timeval tv;
+	uint64_t tick;
+
+	if (n->need_exit)
+		return -ECANCELED;
+
+	c = malloc(sizeof(struct dnet_delayed_call));
+	if (!c)
+		return -ENOMEM;
+
+	c->call = call;
+	c->priv = priv;
+
+	gettimeofday(&tv, NULL);
+	tick = dnet_trans_timer_tick(&tv) + (delay_ms + DNET_TRANS_TIMER_TICK_MS - 1) / DNET_TRANS_TIMER_TICK_MS;
+
+	pthread_mutex_lock(&n->trans_timer_lock);
+	if (tick < wheel->current)
+		tick = wheel->current;
+
+	c->tick = tick;
+	list_add_tail(&c->entry, &wheel->slots[tick % DNET_TRANS_TIMER_SLOTS]);
+	pthread_mutex_unlock(&n->trans_timer_lock);
+
+	return 0;
+}
+
+/*
+ * Runs calls which are due at @now tick, or all of them with @err if it is not zero
+ */
+static void dnet_run_delayed_calls(struct dnet_node *n, uint64_t now, int err)
 {
-	struct dnet_net_state *st, *tmp;
-	int i, err;
-	int num_stall_state = 0;
-	int max_state_count = 0;
-	struct dnet_net_state **stall_states = NULL;
+	struct dnet_trans_timer_wheel *wheel = &n->delayed_calls;
+	struct dnet_delayed_call *c, *tmp;
+	uint64_t tick, first;
 	LIST_HEAD(head);
 
-	pthread_mutex_lock(&n->state_lock);
-	/*
-	 * It isn't possible to send a ping transaction while checking stall transactions within dnet_trans_check_stall(),
-	 * because it may invoke callback directly, where dnet_state_reset() is called that will deadlock on state_lock mutex.
-	 */
-	list_for_each_entry_safe(st, tmp, &n->dht_state_list, node_entry) {
-		++max_state_count;
+	pthread_mutex_lock(&n->trans_timer_lock);
+
+	first = wheel->current;
+	if (err || now < first || now - first >= DNET_TRANS_TIMER_SLOTS)
+		first = now - (DNET_TRANS_TIMER_SLOTS - 1);
+
+	for (tick = first; tick <= now; ++tick) {
+		list_for_each_entry_safe(c, tmp, &wheel->slots[tick % DNET_TRANS_TIMER_SLOTS], entry) {
+			if (err || c->tick <= now)
+				list_move_tail(&c->entry, &head);
+		}
+	}
+
+	wheel->current = now;
+	pthread_mutex_unlock(&n->trans_timer_lock);
+
+	list_for_each_entry_safe(c, tmp, &head, entry) {
+		list_del(&c->entry);
+
+		c->call(c->priv, err);
+		free(c);
 	}
+}
 
-	if (max_state_count > 0) {
-		stall_states = malloc(max_state_count * sizeof(struct dnet_net_state *));
-		if (!stall_states) {
-			dnet_log(n, DNET_LOG_ERROR, "dnet_check_all_states: malloc failed for stall_states: %d", max_state_count);
-			pthread_mutex_unlock(&n->state_lock);
-			return;
+/*
+ * Takes the next state which is due to be checked at @now tick from node's wheel, NULL if there is no such state
+ */
+static struct dnet_net_state *dnet_trans_timer_pop_state(struct dnet_node *n, uint64_t now)
+{
+	struct dnet_trans_timer_wheel *wheel = &n->trans_timer;
+	struct dnet_net_state *st, *found = NULL;
+	uint64_t tick, first;
+
+	pthread_mutex_lock(&n->trans_timer_lock);
+
+	first = wheel->current;
+	if (now < first || now - first >= DNET_TRANS_TIMER_SLOTS)
+		first = now - (DNET_TRANS_TIMER_SLOTS - 1);
+
+	for (tick = first; tick <= now; ++tick) {
+		list_for_each_entry(st, &wheel->slots[tick % DNET_TRANS_TIMER_SLOTS], trans_check_entry) {
+			if (st->trans_check_tick <= now) {
+				/* state in the wheel always has transactions, which hold its references */
+				list_del_init(&st->trans_check_entry);
+				found = dnet_state_get(st);
+				goto err_out_unlock;
+			}
 		}
+
+		/* there is nothing due in this slot until the next rotation */
+		wheel->current = (tick < now) ? tick + 1 : now;
 	}
 
-	list_for_each_entry_safe(st, tmp, &n->dht_state_list, node_entry) {
-		if (dnet_trans_check_stall(st, &head)) {
-			dnet_state_get(st);
-			stall_states[num_stall_state++] = st;
+err_out_unlock:
+	pthread_mutex_unlock(&n->trans_timer_lock);
+	return found;
+}
+
+static void dnet_trans_check_state(struct dnet_net_state *st, uint64_t now)
+{
+	struct dnet_trans_timer_wheel *wheel = &st->timer_wheel;
+	uint64_t tick = 0;
+	int i, err, is_stall_state;
+	LIST_HEAD(head);
+
+	is_stall_state = dnet_trans_check_stall(st, &head);
+
+	/* put state back into node's wheel at its closest non-empty slot */
+	pthread_mutex_lock(&st->trans_lock);
+	if (wheel->num) {
+		for (i = 0; i < DNET_TRANS_TIMER_SLOTS; ++i) {
+			tick = wheel->current + i;
+			if (!list_empty(&wheel->slots[tick % DNET_TRANS_TIMER_SLOTS]))
+				break;
 		}
+
+		if (tick <= now)
+			tick = now + 1;
+
+		dnet_trans_schedule_state_nolock(st, tick);
 	}
-	pthread_mutex_unlock(&n->state_lock);
+	pthread_mutex_unlock(&st->trans_lock);
 
 	dnet_update_stall_backend_weights(&head);
 
-	for (i = 0; i < num_stall_state; ++i) {
-		st = stall_states[i];
+	if (is_stall_state) {
 		st->stall = 0;
 		err = dnet_ping_stall_node(st);
 		if (err)
 			dnet_log(st->n, DNET_LOG_ERROR, "dnet_ping_stall_node failed: %s [%d]", strerror(-err), err);
-		dnet_state_put(st);
 	}
 
 	dnet_trans_clean_list(&head, -ETIMEDOUT);
-	free(stall_states);
+}
+
+static void dnet_check_due_states(struct dnet_node *n)
+{
+	struct dnet_net_state *st;
+	struct timeval tv;
+	uint64_t now;
+
+	gettimeofday(&tv, NULL);
+	now = dnet_trans_timer_tick(&tv);
+
+	dnet_run_delayed_calls(n, now, 0);
+
+	/*
+	 * No locks are held while state is checked: ping of stall state and completion callbacks
+	 * may reset states, which takes @state_lock and @trans_lock.
+	 */
+	while ((st = dnet_trans_timer_pop_state(n, now)) != NULL) {
+		dnet_trans_check_state(st, now);
+		dnet_state_put(st);
+	}
 }
 
 static void *dnet_reconnect_process(void *data)
@@ -747,7 +1068,7 @@ static void *dnet_reconnect_process(void *data)
 		gettimeofday(&tv1, NULL);
 
 		dnet_log(n, DNET_LOG_INFO, "Started reconnection process");
-		dnet_reconnect_and_check_route_table(n);
+		dnet_reconnect_and_check_route_table(n, 1);
 		dnet_log(n, DNET_LOG_INFO, "Finished reconnection process");
 
 		gettimeofday(&tv2, NULL);
@@ -759,6 +1080,9 @@ static void *dnet_reconnect_process(void *data)
 				break;
 
 			sleep(1);
+
+			/* addresses are reconnected when their own backoff expires, not all at once */
+			dnet_reconnect_and_check_route_table(n, 0);
 		}
 	}
 
@@ -769,12 +1093,19 @@ static void *dnet_reconnect_process(void *data)
 static void *dnet_check_process(void *data)
 {
 	struct dnet_node *n = data;
+	long ticks = 0;
 
 	dnet_set_name("dnet_check");
 
 	while (!n->need_exit) {
-		dnet_check_all_states(n);
-		sleep(1);
+		dnet_check_due_states(n);
+
+		if ((n->flags & DNET_CFG_OUTLIER_STATES) && ++ticks * DNET_TRANS_TIMER_TICK_MS >= DNET_OUTLIER_INTERVAL_MS) {
+			dnet_outlier_check(n);
+			ticks = 0;
+		}
+
+		usleep(DNET_TRANS_TIMER_TICK_MS * 1000);
 	}
 
 	return NULL;
@@ -811,7 +1142,12 @@ err_out_exit:
 
 void dnet_check_thread_stop(struct dnet_node *n)
 {
+	struct timeval tv;
+
 	pthread_join(n->reconnect_tid, NULL);
 	pthread_join(n->check_tid, NULL);
+
+	gettimeofday(&tv, NULL);
+	dnet_run_delayed_calls(n, dnet_trans_timer_tick(&tv), -ECANCELED);
 	dnet_log(n, DNET_LOG_NOTICE, "Checking thread stopped.");
 }
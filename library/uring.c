@@ -0,0 +1,335 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#ifdef HAVE_IO_URING_SUPPORT
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct dnet_uring {
+	int			fd;
+
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_array;
+	struct io_uring_sqe	*sqes;
+
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_cqe	*cqes;
+
+	void			*sq_ptr;
+	size_t			sq_size;
+	void			*cq_ptr;
+	size_t			cq_size;
+	size_t			sqes_size;
+
+	/* protects submission queue and reads accounting */
+	pthread_mutex_t		lock;
+	pthread_cond_t		wait;
+	unsigned int		depth;
+	unsigned int		inflight;
+	int			need_exit;
+
+	pthread_t		tid;
+};
+
+static int dnet_uring_enter(struct dnet_uring *u, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/*
+ * Must be called with ring lock held, the only submitter is the one which holds the lock,
+ * so the kernel sees new entry only after io_uring_enter()
+ */
+static int dnet_uring_submit_nolock(struct dnet_uring *u, uint8_t opcode, int fd, struct dnet_uring_op *op, off_t offset)
+{
+	unsigned int tail = *u->sq_tail;
+	unsigned int idx = tail & *u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[idx];
+	int err;
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->off = offset;
+	if (op) {
+		sqe->addr = (unsigned long)&op->iov;
+		sqe->len = 1;
+	}
+	sqe->user_data = (unsigned long)op;
+
+	u->sq_array[idx] = idx;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	do {
+		err = dnet_uring_enter(u, 1, 0, 0);
+	} while (err < 0 && errno == EINTR);
+
+	if (err != 1) {
+		err = err < 0 ? -errno : -EAGAIN;
+
+		/* entry was not consumed, kernel reads submission queue only inside io_uring_enter() */
+		__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+		return err;
+	}
+
+	return 0;
+}
+
+static void *dnet_uring_process(void *data)
+{
+	struct dnet_uring *u = data;
+	struct io_uring_cqe *cqe;
+	struct dnet_uring_op *op;
+	unsigned int head, tail;
+	int res, need_exit = 0;
+
+	while (!need_exit) {
+		if (dnet_uring_enter(u, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN) {
+			/* can not happen with valid ring, do not spin if it does */
+			usleep(1000);
+			continue;
+		}
+
+		head = *u->cq_head;
+		tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+		while (head != tail) {
+			cqe = &u->cqes[head & *u->cq_mask];
+			op = (struct dnet_uring_op *)(unsigned long)cqe->user_data;
+			res = cqe->res;
+
+			/* completion slot is returned to the kernel before callback, it may submit new read */
+			__atomic_store_n(u->cq_head, ++head, __ATOMIC_RELEASE);
+
+			/* NOP without op is sent by dnet_uring_destroy() when all reads have been completed */
+			if (!op) {
+				need_exit = 1;
+				continue;
+			}
+
+			pthread_mutex_lock(&u->lock);
+			u->inflight--;
+			pthread_cond_broadcast(&u->wait);
+			pthread_mutex_unlock(&u->lock);
+
+			op->complete(op, res);
+		}
+	}
+
+	return NULL;
+}
+
+static void dnet_uring_unmap(struct dnet_uring *u)
+{
+	if (u->sqes)
+		munmap(u->sqes, u->sqes_size);
+	if (u->cq_ptr && u->cq_ptr != u->sq_ptr)
+		munmap(u->cq_ptr, u->cq_size);
+	if (u->sq_ptr)
+		munmap(u->sq_ptr, u->sq_size);
+}
+
+int dnet_uring_create(unsigned int depth, struct dnet_uring **ring)
+{
+	struct io_uring_params p;
+	struct dnet_uring *u;
+	void *ptr;
+	int err;
+
+	if (!depth)
+		return -EINVAL;
+
+	u = calloc(1, sizeof(struct dnet_uring));
+	if (!u)
+		return -ENOMEM;
+
+	memset(&p, 0, sizeof(p));
+	u->fd = syscall(__NR_io_uring_setup, depth, &p);
+	if (u->fd < 0) {
+		err = (errno == ENOSYS || errno == EPERM) ? -ENOTSUP : -errno;
+		goto err_out_free;
+	}
+
+	/* completion queue is at least as large as submission queue, so it never overflows */
+	u->depth = p.sq_entries < depth ? p.sq_entries : depth;
+
+	u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_size > u->sq_size)
+			u->sq_size = u->cq_size;
+		u->cq_size = u->sq_size;
+	}
+
+	ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED) {
+		err = -errno;
+		goto err_out_close;
+	}
+	u->sq_ptr = ptr;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		u->cq_ptr = u->sq_ptr;
+	} else {
+		ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED) {
+			err = -errno;
+			goto err_out_unmap;
+		}
+		u->cq_ptr = ptr;
+	}
+
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED) {
+		err = -errno;
+		goto err_out_unmap;
+	}
+	u->sqes = ptr;
+
+	u->sq_tail = u->sq_ptr + p.sq_off.tail;
+	u->sq_mask = u->sq_ptr + p.sq_off.ring_mask;
+	u->sq_array = u->sq_ptr + p.sq_off.array;
+
+	u->cq_head = u->cq_ptr + p.cq_off.head;
+	u->cq_tail = u->cq_ptr + p.cq_off.tail;
+	u->cq_mask = u->cq_ptr + p.cq_off.ring_mask;
+	u->cqes = u->cq_ptr + p.cq_off.cqes;
+
+	err = pthread_mutex_init(&u->lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_unmap;
+	}
+
+	err = pthread_cond_init(&u->wait, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_destroy_lock;
+	}
+
+	err = pthread_create(&u->tid, NULL, dnet_uring_process, u);
+	if (err) {
+		err = -err;
+		goto err_out_destroy_cond;
+	}
+
+	*ring = u;
+	return 0;
+
+err_out_destroy_cond:
+	pthread_cond_destroy(&u->wait);
+err_out_destroy_lock:
+	pthread_mutex_destroy(&u->lock);
+err_out_unmap:
+	dnet_uring_unmap(u);
+err_out_close:
+	close(u->fd);
+err_out_free:
+	free(u);
+	return err;
+}
+
+void dnet_uring_destroy(struct dnet_uring *u)
+{
+	int err;
+
+	if (!u)
+		return;
+
+	pthread_mutex_lock(&u->lock);
+	u->need_exit = 1;
+	while (u->inflight)
+		pthread_cond_wait(&u->wait, &u->lock);
+
+	err = dnet_uring_submit_nolock(u, IORING_OP_NOP, -1, NULL, 0);
+	pthread_mutex_unlock(&u->lock);
+
+	if (err)
+		pthread_cancel(u->tid);
+	pthread_join(u->tid, NULL);
+
+	pthread_cond_destroy(&u->wait);
+	pthread_mutex_destroy(&u->lock);
+	dnet_uring_unmap(u);
+	close(u->fd);
+	free(u);
+}
+
+int dnet_uring_read(struct dnet_uring *u, struct dnet_uring_op *op, int fd, void *buf, size_t size, off_t offset,
+		int wait)
+{
+	int err;
+
+	op->iov.iov_base = buf;
+	op->iov.iov_len = size;
+
+	pthread_mutex_lock(&u->lock);
+	while (u->inflight >= u->depth && !u->need_exit) {
+		if (!wait) {
+			pthread_mutex_unlock(&u->lock);
+			return -EAGAIN;
+		}
+
+		pthread_cond_wait(&u->wait, &u->lock);
+	}
+
+	if (u->need_exit) {
+		pthread_mutex_unlock(&u->lock);
+		return -ESHUTDOWN;
+	}
+
+	err = dnet_uring_submit_nolock(u, IORING_OP_READV, fd, op, offset);
+	if (!err)
+		u->inflight++;
+	pthread_mutex_unlock(&u->lock);
+
+	return err;
+}
+
+#else
+
+int dnet_uring_create(unsigned int depth __attribute__ ((unused)), struct dnet_uring **ring __attribute__ ((unused)))
+{
+	return -ENOTSUP;
+}
+
+void dnet_uring_destroy(struct dnet_uring *u __attribute__ ((unused)))
+{
+}
+
+int dnet_uring_read(struct dnet_uring *u __attribute__ ((unused)), struct dnet_uring_op *op __attribute__ ((unused)),
+		int fd __attribute__ ((unused)), void *buf __attribute__ ((unused)), size_t size __attribute__ ((unused)),
+		off_t offset __attribute__ ((unused)), int wait __attribute__ ((unused)))
+{
+	return -ENOTSUP;
+}
+
+#endif /* HAVE_IO_URING_SUPPORT */
@@ -0,0 +1,66 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_URING_H
+#define __DNET_URING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Asynchronous file reads submitted to the kernel through io_uring.
+ *
+ * Ring is shared by all io threads of the backend, reads are submitted without waiting
+ * for the disk and are completed by the ring's own thread which calls @complete of every op.
+ * Completion callbacks must not block, they may submit new reads with @wait set to 0.
+ */
+struct dnet_uring;
+
+struct dnet_uring_op {
+	/* @res is number of bytes read or negative error */
+	void			(*complete)(struct dnet_uring_op *op, int res);
+	struct iovec		iov;
+};
+
+/*
+ * Creates ring able to keep @depth reads in flight.
+ * Returns -ENOTSUP if io_uring is not supported by the build or by the kernel.
+ */
+int dnet_uring_create(unsigned int depth, struct dnet_uring **ring);
+
+/*
+ * Waits for all reads in flight to complete and frees the ring
+ */
+void dnet_uring_destroy(struct dnet_uring *ring);
+
+/*
+ * Submits read of @size bytes at @offset of @fd into @buf, @op must live until its completion.
+ * If ring is full, waits for a free slot when @wait is set or returns -EAGAIN otherwise.
+ */
+int dnet_uring_read(struct dnet_uring *ring, struct dnet_uring_op *op, int fd, void *buf, size_t size, off_t offset,
+		int wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_URING_H */
@@ -19,6 +19,8 @@
 
 #include "backends_stat_provider.hpp"
 #include "statistics.hpp"
+#include "heatmap.hpp"
+#include "monitor.hpp"
 
 #include "library/elliptics.h"
 #include "library/backend.h"
@@ -31,37 +33,138 @@
 
 namespace ioremap { namespace monitor {
 
-backends_stat_provider::backends_stat_provider(struct dnet_node *node)
+backends_stat_provider::backends_stat_provider(struct dnet_node *node, unsigned int sample_interval_ms)
 : m_node(node)
-{}
+{
+	if (sample_interval_ms) {
+		m_sampler.reset(new periodic_sampler("backends", sample_interval_ms,
+			std::bind(&backends_stat_provider::sample, this)));
+	}
+}
 
 /*
- * Gets statistics from lowlevel backend and writes it to "backend" section
+ * Gets statistics from lowlevel backend and parses them, returns NULL if backend does not provide them
  */
-static void fill_backend_backend(rapidjson::Value &stat_value,
-                                 rapidjson::Document::AllocatorType &allocator,
-                                 const struct dnet_backend_io &backend,
-                                 const dnet_backend_info &config_backend) {
+static std::shared_ptr<const rapidjson::Document> read_storage_stat(const struct dnet_backend_io &backend,
+                                                                    const dnet_backend_info &config_backend) {
+	std::shared_ptr<rapidjson::Document> result;
 	char *json_stat = NULL;
 	size_t size = 0;
 	struct dnet_backend_callbacks *cb = backend.cb;
 	if (cb->storage_stat_json) {
 		cb->storage_stat_json(cb->command_private, &json_stat, &size);
 		if (json_stat && size) {
-			rapidjson::Document backend_value(&allocator);
-			backend_value.Parse<0>(json_stat);
-			backend_value["config"].AddMember("group", config_backend.group, allocator);
-			stat_value.AddMember("backend",
-			                     static_cast<rapidjson::Value&>(backend_value),
-			                     allocator);
+			result = std::make_shared<rapidjson::Document>();
+			result->Parse<0>(json_stat);
+			(*result)["config"].AddMember("group", config_backend.group, result->GetAllocator());
 		}
 	}
 
 	free(json_stat);
+	return result;
+}
+
+std::shared_ptr<const rapidjson::Document> backends_stat_provider::storage_stat(size_t backend_id,
+                                                                                const dnet_backend_status &status) const {
+	if (m_sampler) {
+		std::lock_guard<std::mutex> guard(m_samples_lock);
+		auto it = m_samples.find(backend_id);
+		if (it != m_samples.end() && !dnet_time_cmp(&it->second.last_start, &status.last_start))
+			return it->second.stat;
+	}
+
+	// backend has been started after the last sample
+	auto stat = read_storage_stat(m_node->io->backends[backend_id],
+	                              m_node->config_data->backends->backends[backend_id]);
+
+	if (m_sampler) {
+		std::lock_guard<std::mutex> guard(m_samples_lock);
+		m_samples[backend_id] = storage_sample{status.last_start, stat};
+	}
+	return stat;
+}
+
+void backends_stat_provider::sample() {
+	const auto &backends = m_node->config_data->backends->backends;
+	for (size_t i = 0; i < backends.size(); ++i) {
+		dnet_backend_status status;
+		memset(&status, 0, sizeof(status));
+		std::shared_ptr<const rapidjson::Document> stat;
+
+		{
+			std::lock_guard<std::mutex> guard(*backends[i].state_mutex);
+			if (backends[i].state != DNET_BACKEND_UNITIALIZED)
+				backend_fill_status_nolock(m_node, &status, i);
+
+			if (status.state != DNET_BACKEND_ENABLED || !m_node->io) {
+				std::lock_guard<std::mutex> samples_guard(m_samples_lock);
+				m_samples.erase(i);
+				continue;
+			}
+
+			stat = read_storage_stat(m_node->io->backends[i], backends[i]);
+		}
+
+		std::lock_guard<std::mutex> guard(m_samples_lock);
+		m_samples[i] = storage_sample{status.last_start, stat};
+	}
+}
+
+/*
+ * Deep copy of @src, strings are copied into @allocator
+ */
+static void copy_value(const rapidjson::Value &src, rapidjson::Value &dst,
+                       rapidjson::Document::AllocatorType &allocator) {
+	if (src.IsObject()) {
+		dst.SetObject();
+		for (auto it = src.MemberBegin(); it != src.MemberEnd(); ++it) {
+			rapidjson::Value name(it->name.GetString(), it->name.GetStringLength(), allocator);
+			rapidjson::Value value;
+			copy_value(it->value, value, allocator);
+			dst.AddMember(name, value, allocator);
+		}
+	} else if (src.IsArray()) {
+		dst.SetArray();
+		for (auto it = src.Begin(); it != src.End(); ++it) {
+			rapidjson::Value value;
+			copy_value(*it, value, allocator);
+			dst.PushBack(value, allocator);
+		}
+	} else if (src.IsString()) {
+		dst.SetString(src.GetString(), src.GetStringLength(), allocator);
+	} else if (src.IsBool()) {
+		dst.SetBool(src.GetBool());
+	} else if (src.IsInt()) {
+		dst.SetInt(src.GetInt());
+	} else if (src.IsUint()) {
+		dst.SetUint(src.GetUint());
+	} else if (src.IsInt64()) {
+		dst.SetInt64(src.GetInt64());
+	} else if (src.IsUint64()) {
+		dst.SetUint64(src.GetUint64());
+	} else if (src.IsDouble()) {
+		dst.SetDouble(src.GetDouble());
+	} else {
+		dst.SetNull();
+	}
+}
+
+/*
+ * Writes statistics of lowlevel backend to "backend" section
+ */
+static void fill_backend_backend(rapidjson::Value &stat_value,
+                                 rapidjson::Document::AllocatorType &allocator,
+                                 const rapidjson::Document *storage_stat) {
+	if (storage_stat) {
+		rapidjson::Value backend_value;
+		copy_value(*storage_stat, backend_value, allocator);
+		stat_value.AddMember("backend", backend_value, allocator);
+	}
 }
 
 static void dump_list_stats(rapidjson::Value &stat, list_stat &list_stats, rapidjson::Document::AllocatorType &allocator) {
 	stat.AddMember("current_size", list_stats.list_size, allocator);
+	stat.AddMember("active_threads", list_stats.active_threads, allocator);
 }
 
 /*
@@ -84,9 +187,43 @@ static void fill_backend_io(rapidjson::Value &stat_value,
 	dump_list_stats(nonblocking_stat, stats, allocator);
 	io_value.AddMember("nonblocking", nonblocking_stat, allocator);
 
+	io_value.AddMember("numa_node", backend.numa_node, allocator);
+
 	stat_value.AddMember("io", io_value, allocator);
 }
 
+/*
+ * Fills record_filters section of one backend: per filter counters in order filters are applied
+ */
+static void fill_backend_record_filters(rapidjson::Value &stat_value,
+                                        rapidjson::Document::AllocatorType &allocator,
+                                        const struct dnet_backend_io &backend) {
+	if (!backend.record_filters)
+		return;
+
+	struct dnet_record_filters *filters = backend.record_filters;
+	rapidjson::Value filters_value(rapidjson::kObjectType);
+	rapidjson::Value plugins_value(rapidjson::kArrayType);
+
+	for (int i = 0; i < filters->num; ++i) {
+		struct dnet_record_filter_plugin &p = filters->plugins[i];
+		rapidjson::Value plugin_value(rapidjson::kObjectType);
+
+		plugin_value.AddMember("name", p.name, allocator);
+		plugin_value.AddMember("calls", (uint64_t)atomic_read(&p.calls), allocator);
+		plugin_value.AddMember("skipped", (uint64_t)atomic_read(&p.skipped), allocator);
+		plugin_value.AddMember("narrowed", (uint64_t)atomic_read(&p.narrowed), allocator);
+		plugin_value.AddMember("failed", (uint64_t)atomic_read(&p.failed), allocator);
+		plugin_value.AddMember("time", (uint64_t)atomic_read(&p.usecs), allocator);
+		plugins_value.PushBack(plugin_value, allocator);
+	}
+
+	filters_value.AddMember("budget", filters->budget.limit, allocator);
+	filters_value.AddMember("throttled", (uint64_t)atomic_read(&filters->throttled), allocator);
+	filters_value.AddMember("filters", plugins_value, allocator);
+	stat_value.AddMember("record_filters", filters_value, allocator);
+}
+
 /*
  * Fills cache section of one backend
  */
@@ -128,6 +265,18 @@ static void fill_backend_status(rapidjson::Value &stat_value,
 	status_value.AddMember("last_start_err", status.last_start_err, allocator);
 	status_value.AddMember("read_only", status.read_only == 1, allocator);
 	status_value.AddMember("delay", status.delay, allocator);
+	status_value.AddMember("faults_count", status.faults_count, allocator);
+	status_value.AddMember("cache_size", status.cache_size, allocator);
+
+	uint64_t current_bytes, current_keys;
+	dnet_throttle_current(&node->io->backends[backend_id].background_throttle, &current_bytes, &current_keys);
+
+	rapidjson::Value background_rate(rapidjson::kObjectType);
+	background_rate.AddMember("limit_bytes", status.rate_bytes, allocator);
+	background_rate.AddMember("limit_keys", status.rate_keys, allocator);
+	background_rate.AddMember("bytes", current_bytes, allocator);
+	background_rate.AddMember("keys", current_keys, allocator);
+	status_value.AddMember("background_rate", background_rate, allocator);
 
 	stat_value.AddMember("status", status_value, allocator);
 }
@@ -193,6 +342,7 @@ static void fill_disabled_backend_config(rapidjson::Value &stat_value,
 static rapidjson::Value& backend_stats_json(uint64_t categories,
                                             rapidjson::Value &stat_value,
                                             rapidjson::Document::AllocatorType &allocator,
+                                            const backends_stat_provider &provider,
                                             struct dnet_node *node,
                                             size_t backend_id) {
 	dnet_backend_status status;
@@ -213,7 +363,8 @@ static rapidjson::Value& backend_stats_json(uint64_t categories,
 		}
 
 		if (categories & DNET_MONITOR_BACKEND) {
-			fill_backend_backend(stat_value, allocator, backend, config_backend);
+			fill_backend_backend(stat_value, allocator, provider.storage_stat(backend_id, status).get());
+			fill_backend_record_filters(stat_value, allocator, backend);
 		}
 		if (categories & DNET_MONITOR_IO) {
 			fill_backend_io(stat_value, allocator, backend);
@@ -221,6 +372,11 @@ static rapidjson::Value& backend_stats_json(uint64_t categories,
 		if (categories & DNET_MONITOR_CACHE) {
 			fill_backend_cache(stat_value, allocator, backend);
 		}
+		if ((categories & DNET_MONITOR_HEATMAP) && backend.range_stats) {
+			const range_heatmap *heatmap = (range_heatmap *)(backend.range_stats);
+			rapidjson::Value heatmap_value(rapidjson::kObjectType);
+			stat_value.AddMember("heatmap", heatmap->report(heatmap_value, allocator), allocator);
+		}
 	} else if (categories & DNET_MONITOR_BACKEND) {
 		fill_disabled_backend_config(stat_value, allocator, config_backend);
 	}
@@ -238,6 +394,7 @@ static bool backend_check_state_nolock(struct dnet_node *node, size_t backend_id
 static void backends_stats_json(uint64_t categories,
                                 rapidjson::Value &stat_value,
                                 rapidjson::Document::AllocatorType &allocator,
+                                const backends_stat_provider &provider,
                                 struct dnet_node *node) {
 	const auto &backends = node->config_data->backends->backends;
 	for (size_t i = 0; i < backends.size(); ++i) {
@@ -247,7 +404,7 @@ static void backends_stats_json(uint64_t categories,
 		rapidjson::Value backend_stat(rapidjson::kObjectType);
 		stat_value.AddMember(std::to_string(static_cast<unsigned long long>(i)).c_str(),
 		                     allocator,
-		                     backend_stats_json(categories, backend_stat, allocator, node, i),
+		                     backend_stats_json(categories, backend_stat, allocator, provider, node, i),
 		                     allocator);
 	}
 }
@@ -258,14 +415,15 @@ static void backends_stats_json(uint64_t categories,
 std::string backends_stat_provider::json(uint64_t categories) const {
 	if (!(categories & DNET_MONITOR_IO) &&
 	    !(categories & DNET_MONITOR_CACHE) &&
-	    !(categories & DNET_MONITOR_BACKEND))
+	    !(categories & DNET_MONITOR_BACKEND) &&
+	    !(categories & DNET_MONITOR_HEATMAP))
 	    return std::string();
 
 	rapidjson::Document doc;
 	doc.SetObject();
 	auto &allocator = doc.GetAllocator();
 
-	backends_stats_json(categories, doc, allocator, m_node);
+	backends_stats_json(categories, doc, allocator, *this, m_node);
 
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -277,13 +435,21 @@ std::string backends_stat_provider::json(uint64_t categories) const {
 
 #include <fstream>
 
-int dnet_backend_command_stats_init(struct dnet_backend_io *backend_io)
+int dnet_backend_command_stats_init(struct dnet_node *node, struct dnet_backend_io *backend_io)
 {
 	int err = 0;
 
+	backend_io->command_stats = NULL;
+	backend_io->range_stats = NULL;
+
 	try {
 		backend_io->command_stats = (void *)(new ioremap::monitor::command_stats());
+
+		const auto monitor_cfg = ioremap::monitor::get_monitor_config(node);
+		if (monitor_cfg && monitor_cfg->heatmap_bits)
+			backend_io->range_stats = (void *)(new ioremap::monitor::range_heatmap(monitor_cfg->heatmap_bits));
 	} catch (...) {
+		delete (ioremap::monitor::command_stats *)backend_io->command_stats;
 		backend_io->command_stats = NULL;
 		err = -ENOMEM;
 	}
@@ -295,6 +461,8 @@ void dnet_backend_command_stats_cleanup(struct dnet_backend_io *backend_io)
 {
 	delete (ioremap::monitor::command_stats *)backend_io->command_stats;
 	backend_io->command_stats = NULL;
+	delete (ioremap::monitor::range_heatmap *)backend_io->range_stats;
+	backend_io->range_stats = NULL;
 }
 
 void dnet_backend_command_stats_update(struct dnet_node *node, struct dnet_backend_io *backend_io,
@@ -307,4 +475,7 @@ void dnet_backend_command_stats_update(struct dnet_node *node, struct dnet_backe
 	(void) node;
 
 	stats->command_counter(cmd->cmd, cmd->trans, err, handled_in_cache, size, diff);
+
+	if (backend_io->range_stats)
+		((ioremap::monitor::range_heatmap *)backend_io->range_stats)->update(cmd, size, err, diff);
 }
@@ -20,23 +20,49 @@
 #ifndef __DNET_MONITOR_BACKENDS_STAT_PROVIDER_HPP
 #define __DNET_MONITOR_BACKENDS_STAT_PROVIDER_HPP
 
-#include "stat_provider.hpp"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "rapidjson/document.h"
 
-struct dnet_node;
+#include "stat_provider.hpp"
+#include "sampler.hpp"
+#include "library/elliptics.h"
 
 namespace ioremap { namespace monitor {
 
 /*!
  * Provider for all backends statistics
+ * If \a sample_interval_ms is not zero, storage statistics of enabled backends are read and parsed
+ * by background sampler, reports copy the last sample. Other sections are always gathered by reports.
  */
 class backends_stat_provider : public stat_provider {
 public:
-	backends_stat_provider(struct dnet_node *node);
+	backends_stat_provider(struct dnet_node *node, unsigned int sample_interval_ms);
 
 	virtual std::string json(uint64_t categories) const;
 
+	/*!
+	 * Returns storage statistics of enabled backend \a backend_id taken after its last start,
+	 * reads them if there is no such sample yet. Must be called with backend's state_mutex held.
+	 */
+	std::shared_ptr<const rapidjson::Document> storage_stat(size_t backend_id, const dnet_backend_status &status) const;
+
 private:
+	void sample();
+
+	struct storage_sample {
+		dnet_time					last_start;
+		std::shared_ptr<const rapidjson::Document>	stat;
+	};
+
 	struct dnet_node *m_node;
+
+	mutable std::mutex m_samples_lock;
+	mutable std::unordered_map<size_t, storage_sample> m_samples;
+	// must be the last member: it is stopped before samples are destroyed
+	std::unique_ptr<periodic_sampler> m_sampler;
 };
 
 }} /* namespace ioremap::monitor */
@@ -27,6 +27,7 @@
 #include <functional> // not2
 #include <vector>
 #include <stack>
+#include <map>
 
 namespace ioremap { namespace monitor {
 
@@ -64,7 +65,7 @@ public:
 		auto it = m_treap.find(event.get_key());
 		if (it) {
 			update_weight(*it, time, m_period, event.get_weight());
-			update_frequency(*it, time, m_period, 1.);
+			update_frequency(*it, time, m_period, event.get_frequency());
 			it->set_time(time);
 			m_treap.decrease_key(it);
 		} else {
@@ -204,6 +205,93 @@ private:
 	std::mutex m_lock;
 };
 
+/*!
+ * \internal
+ *
+ * Space-Saving sketch of heaviest events: it keeps at most \a capacity distinct keys,
+ * new key replaces the lightest one and inherits its weight and frequency, so weights
+ * of kept keys are never underestimated and any key heavier than total weight / capacity is kept.
+ * It is not thread-safe, every thread updates its own sketch and they are drained to event_stats.
+ */
+template<typename E>
+class heavy_hitters
+{
+	typedef typename E::key_type key_type;
+public:
+	heavy_hitters(size_t capacity)
+	: m_capacity(capacity)
+	{}
+
+	/*!
+	 * \internal
+	 *
+	 * Adds weight and frequency of \a event to its key
+	 * Complexity: O(log K) if the key is kept, O(K) if the lightest key is replaced, where K - capacity
+	 */
+	void add(const E &event)
+	{
+		auto it = m_index.find(event.get_key());
+		if (it != m_index.end()) {
+			E &kept = m_events[it->second];
+			kept.set_weight(kept.get_weight() + event.get_weight());
+			kept.set_frequency(kept.get_frequency() + event.get_frequency());
+			kept.set_time(std::max(kept.get_time(), event.get_time()));
+			return;
+		}
+
+		// events are never reallocated, index refers to their keys
+		if (m_events.capacity() < m_capacity)
+			m_events.reserve(m_capacity);
+
+		if (m_events.size() < m_capacity) {
+			m_events.push_back(event);
+			m_index.insert(std::make_pair(m_events.back().get_key(), m_events.size() - 1));
+			return;
+		}
+
+		size_t lightest = 0;
+		for (size_t i = 1; i < m_events.size(); ++i) {
+			if (m_events[i].get_weight() < m_events[lightest].get_weight())
+				lightest = i;
+		}
+
+		E &replaced = m_events[lightest];
+		const uint64_t weight = replaced.get_weight();
+		const double frequency = replaced.get_frequency();
+
+		m_index.erase(replaced.get_key());
+		replaced = event;
+		replaced.set_weight(weight + event.get_weight());
+		replaced.set_frequency(frequency + event.get_frequency());
+		m_index.insert(std::make_pair(replaced.get_key(), lightest));
+	}
+
+	bool empty() const { return m_events.empty(); }
+
+	/*!
+	 * \internal
+	 *
+	 * Moves all kept events to \a events and clears the sketch
+	 */
+	void drain(std::vector<E> &events)
+	{
+		events.insert(events.end(), m_events.begin(), m_events.end());
+		m_index.clear();
+		m_events.clear();
+	}
+
+private:
+	struct key_less {
+		bool operator() (const key_type &lhs, const key_type &rhs) const {
+			return E::key_compare(lhs, rhs) < 0;
+		}
+	};
+
+	const size_t m_capacity;
+	std::vector<E> m_events;
+	std::map<key_type, size_t, key_less> m_index;
+};
+
 }}  /* namespace ioremap::monitor */
 
 #endif // __DNET_MONITOR_EVENT_STATS_HPP
@@ -0,0 +1,114 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heatmap.hpp"
+
+#include "elliptics/interface.h"
+
+namespace ioremap { namespace monitor {
+
+range_heatmap::range_heatmap(unsigned int bits)
+: m_bits(std::min<unsigned int>(bits, DNET_MONITOR_HEATMAP_MAX_BITS))
+, m_ranges(new range[size_t(1) << m_bits])
+{
+	for (size_t i = 0; i < (size_t(1) << m_bits); ++i) {
+		range &r = m_ranges[i];
+		r.reads = r.writes = r.read_bytes = r.write_bytes = r.errors = r.time = 0;
+	}
+}
+
+size_t range_heatmap::index(const dnet_id &id) const
+{
+	const size_t prefix = (size_t(id.id[0]) << 8) | id.id[1];
+	return prefix >> (DNET_MONITOR_HEATMAP_MAX_BITS - m_bits);
+}
+
+void range_heatmap::update(const dnet_cmd *cmd, uint64_t size, int err, long time)
+{
+	bool write;
+
+	switch (cmd->cmd) {
+	case DNET_CMD_READ:
+	case DNET_CMD_LOOKUP:
+		write = false;
+		break;
+	case DNET_CMD_WRITE:
+	case DNET_CMD_DEL:
+		write = true;
+		break;
+	default:
+		// iterators, range requests and service commands are not bound to one key
+		return;
+	}
+
+	range &r = m_ranges[index(cmd->id)];
+
+	if (write) {
+		r.writes.fetch_add(1, std::memory_order_relaxed);
+		r.write_bytes.fetch_add(size, std::memory_order_relaxed);
+	} else {
+		r.reads.fetch_add(1, std::memory_order_relaxed);
+		r.read_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	if (err)
+		r.errors.fetch_add(1, std::memory_order_relaxed);
+	if (time > 0)
+		r.time.fetch_add(time, std::memory_order_relaxed);
+}
+
+rapidjson::Value &range_heatmap::report(rapidjson::Value &stat_value,
+		rapidjson::Document::AllocatorType &allocator) const
+{
+	rapidjson::Value ranges(rapidjson::kArrayType);
+
+	for (size_t i = 0; i < (size_t(1) << m_bits); ++i) {
+		const range &r = m_ranges[i];
+		const uint64_t reads = r.reads.load(std::memory_order_relaxed);
+		const uint64_t writes = r.writes.load(std::memory_order_relaxed);
+
+		if (!reads && !writes)
+			continue;
+
+		// the first key of the range, so consumers may compare it with route ids
+		const size_t prefix = i << (DNET_MONITOR_HEATMAP_MAX_BITS - m_bits);
+		unsigned char begin[DNET_ID_SIZE];
+		memset(begin, 0, sizeof(begin));
+		begin[0] = prefix >> 8;
+		begin[1] = prefix & 0xff;
+
+		rapidjson::Value range_value(rapidjson::kObjectType);
+		range_value.AddMember("index", i, allocator);
+		rapidjson::Value begin_value;
+		begin_value.SetString(dnet_dump_id_str_full(begin), allocator);
+		range_value.AddMember("begin", begin_value, allocator);
+		range_value.AddMember("reads", reads, allocator);
+		range_value.AddMember("writes", writes, allocator);
+		range_value.AddMember("read_bytes", r.read_bytes.load(std::memory_order_relaxed), allocator);
+		range_value.AddMember("write_bytes", r.write_bytes.load(std::memory_order_relaxed), allocator);
+		range_value.AddMember("errors", r.errors.load(std::memory_order_relaxed), allocator);
+		range_value.AddMember("time_usecs", r.time.load(std::memory_order_relaxed), allocator);
+
+		ranges.PushBack(range_value, allocator);
+	}
+
+	stat_value.AddMember("bits", m_bits, allocator);
+	stat_value.AddMember("ranges", ranges, allocator);
+	return stat_value;
+}
+
+}} /* namespace ioremap::monitor */
@@ -0,0 +1,78 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_MONITOR_HEATMAP_HPP
+#define __DNET_MONITOR_HEATMAP_HPP
+
+#include <atomic>
+#include <memory>
+
+#include "rapidjson/document.h"
+#include "library/elliptics.h"
+
+/*
+ * Default number of leading bits of the key which select its range
+ */
+#define DNET_DEFAULT_MONITOR_HEATMAP_BITS 8
+
+/*
+ * Ranges are counted by at most 2^16 buckets, 48 bytes each
+ */
+#define DNET_MONITOR_HEATMAP_MAX_BITS 16
+
+namespace ioremap { namespace monitor {
+
+/*!
+ * Access counters of key ranges of one backend: ID space is split into 2^bits equal ranges
+ * by the leading bits of the key, every request adds to relaxed atomic counters of its range.
+ * Counters only grow since the backend is started, rates are found by consumers from two reports.
+ */
+class range_heatmap {
+public:
+	range_heatmap(unsigned int bits);
+
+	/*!
+	 * Counts \a cmd processed by the backend in \a time usecs, \a size is the number of bytes read or written
+	 */
+	void update(const dnet_cmd *cmd, uint64_t size, int err, long time);
+
+	unsigned int get_bits() const { return m_bits; }
+
+	/*!
+	 * Fills \a stat_value with ranges which have been accessed at least once
+	 */
+	rapidjson::Value &report(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const;
+
+private:
+	struct range {
+		std::atomic<uint64_t>	reads;
+		std::atomic<uint64_t>	writes;
+		std::atomic<uint64_t>	read_bytes;
+		std::atomic<uint64_t>	write_bytes;
+		std::atomic<uint64_t>	errors;
+		std::atomic<uint64_t>	time;
+	};
+
+	size_t index(const dnet_id &id) const;
+
+	const unsigned int m_bits;
+	std::unique_ptr<range[]> m_ranges;
+};
+
+}} /* namespace ioremap::monitor */
+
+#endif /* __DNET_MONITOR_HEATMAP_HPP */
@@ -23,6 +23,9 @@
 #include <string>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "statistics.hpp"
 
 namespace ioremap { namespace monitor {
 
@@ -30,6 +33,9 @@ namespace status_strings {
 const std::string not_found = "HTTP/1.1 404 Not Found\r\n";
 const std::string bad_request = "HTTP/1.1 400 Bad Request\r\n";
 const std::string ok = "HTTP/1.1 200 OK\r\n";
+const std::string forbidden = "HTTP/1.1 403 Forbidden\r\n";
+const std::string not_implemented = "HTTP/1.1 501 Not Implemented\r\n";
+const std::string service_unavailable = "HTTP/1.1 503 Service Unavailable\r\n";
 }
 
 namespace content_strings {
@@ -53,11 +59,37 @@ const std::string list = "<html>\n"
 	"GET <a href='/stats'>/stats</a> - Retrieves in-process runtime statistics<br/>\n"
 	"GET <a href='/procfs'>/procfs</a> - Retrieves system statistics about process<br/>\n"
 	"GET <a href='/top'>/top</a> - Retrieves statistics of top keys ordered by generated traffic<br/>\n"
+	"GET <a href='/slow'>/slow</a> - Retrieves the most recent slow requests of every backend<br/>\n"
+	"GET <a href='/locks'>/locks</a> - Retrieves wait and hold times of core locks<br/>\n"
+	"GET <a href='/metrics'>/metrics</a> - Retrieves commands metrics in OpenMetrics text format, "
+		"families can be selected by /metrics?families=commands,latencies,node,stages<br/>\n"
+	"GET <a href='/profile/cpu'>/profile/cpu</a> - Samples CPU of the process for 30 seconds "
+		"(or /profile/cpu?seconds=N) and returns pprof profile, requires \"profiling\" monitor option<br/>\n"
+	"GET <a href='/profile/heap'>/profile/heap</a> - Retrieves pprof heap profile of jemalloc or tcmalloc, "
+		"requires \"profiling\" monitor option<br/>\n"
 	"</body>\n"
 	"</html>\n";
 }
 
 const std::string categories_url = "/?categories=";
+const std::string generation_param = "generation=";
+const std::string metrics_url = "/metrics";
+const std::string metrics_families_query = "?families=";
+const std::string profile_cpu_url = "/profile/cpu";
+const std::string profile_heap_url = "/profile/heap";
+const std::string profile_seconds_query = "?seconds=";
+
+enum profile_kind {
+	profile_cpu = 1,
+	profile_heap
+};
+
+const std::map<std::string, uint64_t> metric_handlers = {
+	{"commands", metric_commands},
+	{"latencies", metric_latencies},
+	{"node", metric_node},
+	{"stages", metric_stages}
+};
 
 const std::map<std::string, uint64_t> handlers = {
 	{"/all", DNET_MONITOR_ALL},
@@ -67,7 +99,10 @@ const std::map<std::string, uint64_t> handlers = {
 	{"/backend", DNET_MONITOR_BACKEND},
 	{"/stats", DNET_MONITOR_STATS},
 	{"/procfs", DNET_MONITOR_PROCFS},
-	{"/top", DNET_MONITOR_TOP}
+	{"/top", DNET_MONITOR_TOP},
+	{"/slow", DNET_MONITOR_SLOW},
+	{"/locks", DNET_MONITOR_LOCKS},
+	{"/heatmap", DNET_MONITOR_HEATMAP}
 };
 
 /*!
@@ -95,31 +130,162 @@ std::string make_reply(uint64_t req, std::string content = "") {
 }
 
 /*!
- * Parses simple HTTP request and determines requested category
+ * Generates HTTP response with OpenMetrics text exposition @content
+ */
+std::string make_metrics_reply(const std::string &content) {
+	std::string ret;
+	ret.reserve(content.size() + 256);
+
+	ret.append(status_strings::ok)
+		.append("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n")
+		.append("Content-Length: ").append(std::to_string((long long unsigned int)content.size())).append("\r\n")
+		.append("Connection: close\r\n")
+		.append("\r\n")
+		.append(content);
+
+	return ret;
+}
+
+/*!
+ * Generates HTTP response with profile @content or with error message if @status is not ok
+ */
+std::string make_profile_reply(const std::string &status, const std::string &content) {
+	std::string ret;
+	ret.reserve(content.size() + 256);
+
+	ret.append(status)
+		.append("Content-Type: ").append(status == status_strings::ok ? "application/octet-stream" : "text/plain")
+		.append("\r\n")
+		.append("Content-Length: ").append(std::to_string((long long unsigned int)content.size())).append("\r\n")
+		.append("Connection: close\r\n")
+		.append("\r\n")
+		.append(content);
+
+	return ret;
+}
+
+/*!
+ * Finds url of simple HTTP request
  * @packet - HTTP request packet
  * @size - size of HTTP request packet
  */
-uint64_t parse(const char* packet, size_t size) {
+bool parse_url(const char *packet, size_t size, const char **url_begin, const char **url_end) {
 	const char* end = packet + size;
 	const char *method_end = std::find(packet, end, ' ');
 	if (method_end >= end || packet == method_end)
-		return 0;
+		return false;
+
+	*url_begin = method_end + 1;
+	*url_end = std::find(*url_begin, end, ' ');
+	return *url_end < end;
+}
+
+/*!
+ * Parses simple HTTP request and determines whether it is OpenMetrics scrape
+ * @families - metric families requested by comma separated list of their names,
+ * all families are requested if there is no list, unknown names are skipped
+ */
+bool parse_metrics(const char *packet, size_t size, uint64_t *families) {
+	const char *url_begin, *url_end;
+	if (!parse_url(packet, size, &url_begin, &url_end))
+		return false;
+
+	const std::string url(url_begin, url_end);
+	if (url.compare(0, metrics_url.size(), metrics_url) != 0)
+		return false;
+
+	const std::string query = url.substr(metrics_url.size());
+	if (query.empty()) {
+		*families = metric_all;
+		return true;
+	}
+
+	if (query.compare(0, metrics_families_query.size(), metrics_families_query) != 0)
+		return false;
+
+	std::vector<std::string> names;
+	boost::split(names, query.substr(metrics_families_query.size()), boost::is_any_of(","), boost::token_compress_on);
 
-	const char *url_begin = method_end + 1;
-	const char *url_end = std::find(url_begin, end, ' ');
-	if (url_end >= end)
+	*families = 0;
+	for (auto name = names.begin(); name != names.end(); ++name) {
+		auto it = metric_handlers.find(*name);
+		if (it != metric_handlers.end())
+			*families |= it->second;
+	}
+
+	return true;
+}
+
+/*!
+ * Parses simple HTTP request and determines whether it asks for profile
+ * @kind - one of profile_kind
+ * @seconds - length of CPU profile passed by "seconds" parameter, it stays untouched if there is no such parameter
+ */
+bool parse_profile(const char *packet, size_t size, int *kind, unsigned int *seconds) {
+	const char *url_begin, *url_end;
+	if (!parse_url(packet, size, &url_begin, &url_end))
+		return false;
+
+	const std::string url(url_begin, url_end);
+	if (url == profile_heap_url) {
+		*kind = profile_heap;
+		return true;
+	}
+
+	if (url.compare(0, profile_cpu_url.size(), profile_cpu_url) != 0)
+		return false;
+
+	const std::string query = url.substr(profile_cpu_url.size());
+	if (!query.empty()) {
+		if (query.compare(0, profile_seconds_query.size(), profile_seconds_query) != 0)
+			return false;
+
+		try {
+			*seconds = boost::lexical_cast<unsigned int>(query.substr(profile_seconds_query.size()));
+		} catch (...) {
+			return false;
+		}
+	}
+
+	*kind = profile_cpu;
+	return true;
+}
+
+/*!
+ * Parses simple HTTP request and determines requested category
+ * @packet - HTTP request packet
+ * @size - size of HTTP request packet
+ * @generation - generation of previous report of the client passed by "generation" parameter,
+ * for example /io?generation=10 or /?categories=12&generation=10, it stays 0 if there is no such parameter
+ */
+uint64_t parse(const char* packet, size_t size, uint64_t *generation) {
+	const char *url_begin, *url_end;
+	if (!parse_url(packet, size, &url_begin, &url_end))
 		return 0;
 
-	auto it = handlers.find(std::string(url_begin, url_end));
+	std::string url(url_begin, url_end);
+
+	const size_t generation_pos = url.find(generation_param);
+	if (generation_pos != std::string::npos && generation_pos > 0 &&
+	    (url[generation_pos - 1] == '?' || url[generation_pos - 1] == '&')) {
+		try {
+			*generation = boost::lexical_cast<uint64_t>(url.substr(generation_pos + generation_param.size()));
+		} catch(...) {
+			printf("Couldn't parse generation: %s\n", url.c_str() + generation_pos);
+			return 0;
+		}
+		url.resize(generation_pos - 1);
+	}
+
+	auto it = handlers.find(url);
 	if (it != handlers.end())
 		return it->second;
-	else if (ssize_t(categories_url.size()) < (url_end - url_begin) &&
-	         strncmp(url_begin, categories_url.c_str(), categories_url.size()) == 0) {
-		const char *categories = url_begin + categories_url.size();
+	else if (categories_url.size() < url.size() &&
+	         url.compare(0, categories_url.size(), categories_url) == 0) {
 		try {
-			return boost::lexical_cast<uint64_t>(std::string(categories, url_end));
+			return boost::lexical_cast<uint64_t>(url.substr(categories_url.size()));
 		} catch(...) {
-			printf("Couldn't parse categories: %s\n", categories);
+			printf("Couldn't parse categories: %s\n", url.c_str() + categories_url.size());
 		}
 	}
 
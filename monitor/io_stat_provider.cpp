@@ -29,6 +29,7 @@ namespace ioremap { namespace monitor {
 
 void dump_list_stats(rapidjson::Value &stat, list_stat &list_stats, rapidjson::Document::AllocatorType &allocator) {
 	stat.AddMember("current_size", list_stats.list_size, allocator);
+	stat.AddMember("active_threads", list_stats.active_threads, allocator);
 }
 
 void dump_states_stats(rapidjson::Value &stat, struct dnet_node *n, rapidjson::Document::AllocatorType &allocator) {
@@ -49,6 +50,22 @@ void dump_states_stats(rapidjson::Value &stat, struct dnet_node *n, rapidjson::D
 	pthread_mutex_unlock(&n->state_lock);
 }
 
+void dump_net_pools_stats(rapidjson::Value &stat, struct dnet_node *n, rapidjson::Document::AllocatorType &allocator) {
+	for (int i = 0; i < n->io->net_thread_num; ++i) {
+		struct dnet_slab_stat slab_stat;
+		dnet_slab_pool_stat(n->io->net[i].recv_pool, &slab_stat);
+
+		rapidjson::Value pool_value(rapidjson::kObjectType);
+		pool_value.AddMember("hits", slab_stat.hits, allocator)
+		          .AddMember("misses", slab_stat.misses, allocator)
+		          .AddMember("large", slab_stat.large, allocator)
+		          .AddMember("cached_size", slab_stat.cached_size, allocator)
+		          .AddMember("cached_num", slab_stat.cached_num, allocator)
+		          .AddMember("huge_size", slab_stat.huge_size, allocator);
+		stat.PushBack(pool_value, allocator);
+	}
+}
+
 std::string io_stat_provider::json(uint64_t categories) const {
 	if (!(categories & DNET_MONITOR_IO))
 		return std::string();
@@ -73,6 +90,10 @@ std::string io_stat_provider::json(uint64_t categories) const {
 	dump_list_stats(output_stat, m_node->io->output_stats, allocator);
 	doc.AddMember("output", output_stat, allocator);
 
+	rapidjson::Value net_pools_stat(rapidjson::kArrayType);
+	dump_net_pools_stats(net_pools_stat, m_node, allocator);
+	doc.AddMember("recv_pools", net_pools_stat, allocator);
+
 	rapidjson::Value states_stat(rapidjson::kObjectType);
 	dump_states_stats(states_stat, m_node, allocator);
 	doc.AddMember("states", states_stat, allocator);
@@ -0,0 +1,92 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "locks_provider.hpp"
+
+#include <string.h>
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include "library/elliptics.h"
+
+namespace ioremap { namespace monitor {
+
+static void fill_lock_histogram(const uint64_t *buckets, rapidjson::Value &histogram,
+		rapidjson::Document::AllocatorType &allocator) {
+	for (int i = 0; i < DNET_LOCK_STAT_BUCKETS; ++i) {
+		const uint64_t count = __atomic_load_n(&buckets[i], __ATOMIC_RELAXED);
+		if (!count)
+			continue;
+
+		// bucket is named by its upper bound in usecs
+		const std::string bound = i == DNET_LOCK_STAT_BUCKETS - 1 ? "inf" : std::to_string(1ULL << i);
+		rapidjson::Value name(bound.c_str(), allocator);
+		rapidjson::Value value(count);
+		histogram.AddMember(name, value, allocator);
+	}
+}
+
+static void fill_lock_site(const dnet_lock_site *site, rapidjson::Value &sites,
+		rapidjson::Document::AllocatorType &allocator) {
+	rapidjson::Value stat(rapidjson::kObjectType);
+
+	const char *file = strrchr(site->file, '/');
+	file = file ? file + 1 : site->file;
+
+	stat.AddMember("lock", site->name, allocator);
+	stat.AddMember("function", site->func, allocator);
+	stat.AddMember("acquired", __atomic_load_n(&site->acquired, __ATOMIC_RELAXED), allocator);
+	stat.AddMember("contended", __atomic_load_n(&site->contended, __ATOMIC_RELAXED), allocator);
+	stat.AddMember("wait_time_usecs", __atomic_load_n(&site->wait_time, __ATOMIC_RELAXED), allocator);
+	stat.AddMember("hold_time_usecs", __atomic_load_n(&site->hold_time, __ATOMIC_RELAXED), allocator);
+
+	rapidjson::Value wait(rapidjson::kObjectType);
+	fill_lock_histogram(site->wait, wait, allocator);
+	stat.AddMember("wait_usecs", wait, allocator);
+
+	rapidjson::Value hold(rapidjson::kObjectType);
+	fill_lock_histogram(site->hold, hold, allocator);
+	stat.AddMember("hold_usecs", hold, allocator);
+
+	const std::string key = std::string(file) + ":" + std::to_string(static_cast<long long>(site->line));
+	rapidjson::Value name(key.c_str(), allocator);
+	sites.AddMember(name, stat, allocator);
+}
+
+std::string locks_provider::json(uint64_t categories) const {
+	if (!(categories & DNET_MONITOR_LOCKS))
+		return std::string();
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	auto &allocator = doc.GetAllocator();
+
+	rapidjson::Value sites(rapidjson::kObjectType);
+	for (auto site = dnet_lock_stat_sites(); site; site = site->next)
+		fill_lock_site(site, sites, allocator);
+
+	doc.AddMember("enabled", dnet_lock_stat_enabled != 0, allocator);
+	doc.AddMember("sites", sites, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+	return buffer.GetString();
+}
+
+}} /* namespace ioremap::monitor */
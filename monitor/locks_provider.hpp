@@ -0,0 +1,35 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_MONITOR_LOCKS_PROVIDER_HPP
+#define __DNET_MONITOR_LOCKS_PROVIDER_HPP
+
+#include "stat_provider.hpp"
+
+namespace ioremap { namespace monitor {
+
+/*!
+ * Provider of wait and hold times of instrumented lock sites, see library/lock.h
+ */
+class locks_provider : public stat_provider {
+public:
+	virtual std::string json(uint64_t categories) const;
+};
+
+}} /* namespace ioremap::monitor */
+
+#endif /* __DNET_MONITOR_LOCKS_PROVIDER_HPP */
@@ -24,9 +24,14 @@
 #include <exception>
 
 #include "library/elliptics.h"
+#include "library/common.hpp"
 #include "io_stat_provider.hpp"
 #include "backends_stat_provider.hpp"
 #include "procfs_provider.hpp"
+#include "locks_provider.hpp"
+#include "heatmap.hpp"
+#include "profiler.hpp"
+#include "sampler.hpp"
 
 #include "../example/config.hpp"
 
@@ -54,6 +59,30 @@ std::unique_ptr<monitor_config> monitor_config::parse(const elliptics::config::c
 {
 	monitor_config cfg;
 	cfg.monitor_port = monitor.at<unsigned int>("port", 0);
+	cfg.report_cache_ms = monitor.at<unsigned int>("report_cache_ms", 0);
+	cfg.trace_sample_rate = monitor.at<unsigned int>("trace_sample_rate", 0);
+	cfg.lock_stats = monitor.at<bool>("lock_stats", false);
+	cfg.profiling = monitor.at<bool>("profiling", false);
+	cfg.profile_max_seconds = monitor.at<unsigned int>("profile_max_seconds", DNET_DEFAULT_MONITOR_PROFILE_MAX_SECONDS);
+	cfg.sample_interval_ms = monitor.at<unsigned int>("sample_interval_ms", DNET_DEFAULT_MONITOR_SAMPLE_INTERVAL_MS);
+	cfg.top_peers = monitor.at<size_t>("top_peers", DNET_DEFAULT_MONITOR_TOP_PEERS);
+
+	cfg.slow_threshold = DNET_DEFAULT_MONITOR_SLOW_THRESHOLD;
+	cfg.slow_size = DNET_DEFAULT_MONITOR_SLOW_SIZE;
+	if (monitor.has("slow_requests")) {
+		const elliptics::config::config slow = monitor.at("slow_requests");
+		cfg.slow_threshold = slow.at<uint64_t>("threshold_usecs", DNET_DEFAULT_MONITOR_SLOW_THRESHOLD);
+		cfg.slow_size = slow.at<size_t>("size", DNET_DEFAULT_MONITOR_SLOW_SIZE);
+	}
+
+	cfg.heatmap_bits = 0;
+	if (monitor.has("heatmap")) {
+		const elliptics::config::config heatmap = monitor.at("heatmap");
+		cfg.heatmap_bits = heatmap.at<unsigned int>("bits", DNET_DEFAULT_MONITOR_HEATMAP_BITS);
+		if (cfg.heatmap_bits > DNET_MONITOR_HEATMAP_MAX_BITS)
+			throw elliptics::config::config_error(heatmap.path() + ".bits must not exceed " +
+				std::to_string(DNET_MONITOR_HEATMAP_MAX_BITS));
+	}
 
 	cfg.has_top = monitor.has("top");
 	if (cfg.has_top) {
@@ -61,6 +90,8 @@ std::unique_ptr<monitor_config> monitor_config::parse(const elliptics::config::c
 		cfg.top_length = top.at<size_t>("top_length", DNET_DEFAULT_MONITOR_TOP_LENGTH);
 		cfg.events_size = top.at<size_t>("events_size", DNET_DEFAULT_MONITOR_TOP_EVENTS_SIZE);
 		cfg.period_in_seconds = top.at<int>("period_in_seconds", DNET_DEFAULT_MONITOR_TOP_PERIOD);
+		cfg.top_sample_rate = top.at<unsigned int>("sample_rate", DNET_DEFAULT_MONITOR_TOP_SAMPLE_RATE);
+		cfg.top_sketch_size = top.at<size_t>("sketch_size", DNET_DEFAULT_MONITOR_TOP_SKETCH_SIZE);
 		cfg.has_top = (cfg.top_length > 0) && (cfg.events_size > 0) && (cfg.period_in_seconds > 0);
 	}
 	return blackhole::utils::make_unique<monitor_config>(cfg);
@@ -130,7 +161,8 @@ static void init_io_stat_provider(struct dnet_node *n, struct dnet_config *cfg)
 
 static void init_backends_stat_provider(struct dnet_node *n, struct dnet_config *cfg) {
 	try {
-		add_provider(n, new backends_stat_provider(n), "backends");
+		const auto monitor_cfg = get_monitor_config(n);
+		add_provider(n, new backends_stat_provider(n, monitor_cfg ? monitor_cfg->sample_interval_ms : 0), "backends");
 	} catch (const std::exception &e) {
 		BH_LOG(*cfg->log, DNET_LOG_ERROR, "monitor: failed to initialize backends_stat_provider: %s.", e.what());
 	}
@@ -138,7 +170,8 @@ static void init_backends_stat_provider(struct dnet_node *n, struct dnet_config
 
 static void init_procfs_provider(struct dnet_node *n, struct dnet_config *cfg) {
 	try {
-		add_provider(n, new procfs_provider(n), "procfs");
+		const auto monitor_cfg = get_monitor_config(n);
+		add_provider(n, new procfs_provider(n, monitor_cfg ? monitor_cfg->sample_interval_ms : 0), "procfs");
 	} catch (const std::exception &e) {
 		BH_LOG(*cfg->log, DNET_LOG_ERROR, "monitor: failed to initialize procfs_stat_provider: %s.", e.what());
 	}
@@ -158,8 +191,10 @@ static void init_top_provider(struct dnet_node *n, struct dnet_config *cfg) {
 
 		const auto monitor_cfg = get_monitor_config(n);
 		if (top_loaded && monitor_cfg) {
-			BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: top provider loaded: top length: %lu, events size: %lu, period: %d",
-			       monitor_cfg->top_length, monitor_cfg->events_size, monitor_cfg->period_in_seconds);
+			BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: top provider loaded: top length: %lu, events size: %lu, period: %d, "
+			       "sample rate: %u, sketch size: %lu",
+			       monitor_cfg->top_length, monitor_cfg->events_size, monitor_cfg->period_in_seconds,
+			       monitor_cfg->top_sample_rate, monitor_cfg->top_sketch_size);
 		} else {
 			BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: top provider is disabled");
 		}
@@ -169,6 +204,37 @@ static void init_top_provider(struct dnet_node *n, struct dnet_config *cfg) {
 	}
 }
 
+static void init_locks_provider(struct dnet_node *n, struct dnet_config *cfg) {
+	try {
+		const auto monitor_cfg = get_monitor_config(n);
+		if (monitor_cfg && monitor_cfg->lock_stats)
+			dnet_lock_stat_enabled = 1;
+
+		add_provider(n, new locks_provider(), "locks");
+		BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: locks provider loaded: lock statistics: %s",
+		       dnet_lock_stat_enabled ? "enabled" : "disabled");
+	} catch (const std::exception &e) {
+		BH_LOG(*cfg->log, DNET_LOG_ERROR, "monitor: failed to initialize locks_provider: %s.", e.what());
+	}
+}
+
+static void init_slow_provider(struct dnet_node *n, struct dnet_config *cfg) {
+	try {
+		const auto monitor = get_monitor(n);
+		auto slow = monitor ? monitor->get_statistics().get_slow_requests() : nullptr;
+		if (!slow) {
+			BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: slow requests provider is disabled");
+			return;
+		}
+
+		add_provider(n, new slow_provider(slow), "slow");
+		BH_LOG(*cfg->log, DNET_LOG_INFO, "monitor: slow requests provider loaded: threshold: %llu usecs, size: %zu",
+		       (unsigned long long)slow->get_threshold(), slow->get_size());
+	} catch (const std::exception &e) {
+		BH_LOG(*cfg->log, DNET_LOG_ERROR, "monitor: failed to initialize slow_provider: %s.", e.what());
+	}
+}
+
 }} /* namespace ioremap::monitor */
 
 int dnet_monitor_init(struct dnet_node *n, struct dnet_config *cfg) {
@@ -189,6 +255,8 @@ int dnet_monitor_init(struct dnet_node *n, struct dnet_config *cfg) {
 	ioremap::monitor::init_backends_stat_provider(n, cfg);
 	ioremap::monitor::init_procfs_provider(n, cfg);
 	ioremap::monitor::init_top_provider(n, cfg);
+	ioremap::monitor::init_slow_provider(n, cfg);
+	ioremap::monitor::init_locks_provider(n, cfg);
 
 	return 0;
 }
@@ -232,6 +300,58 @@ void dnet_monitor_stats_update(struct dnet_node *n, const struct dnet_cmd *cmd,
 	}
 }
 
+void dnet_monitor_stages_update(struct dnet_node *n, const struct dnet_cmd *cmd, const uint64_t *stages) {
+	try {
+		auto real_monitor = ioremap::monitor::get_monitor(n);
+		if (!real_monitor)
+			return;
+
+		real_monitor->get_statistics().stages_counter(stages);
+
+		const auto monitor_cfg = ioremap::monitor::get_monitor_config(n);
+		const unsigned int sample_rate = monitor_cfg ? monitor_cfg->trace_sample_rate : 0;
+
+		// sampling by transaction number keeps request and its reply stages in the same span set
+		if (!(cmd->flags & DNET_FLAGS_TRACE_BIT) && !(sample_rate && cmd->trans % sample_rate == 0))
+			return;
+
+		char buffer[256];
+		int offset = 0;
+		for (int stage = 0; stage < __DNET_IO_STAGE_MAX && offset < (int)sizeof(buffer); ++stage) {
+			if (stages[stage] == DNET_IO_STAGE_NONE)
+				continue;
+
+			int size = snprintf(buffer + offset, sizeof(buffer) - offset, "%s%s: %llu",
+					offset ? ", " : "", ioremap::monitor::io_stage_string(stage),
+					(unsigned long long)stages[stage]);
+			if (size < 0)
+				break;
+			offset += size;
+		}
+		buffer[std::min<size_t>(offset, sizeof(buffer) - 1)] = '\0';
+
+		dnet_log(n, DNET_LOG_INFO, "%s: %s: span: trans: %llu, %s usecs",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans, buffer);
+	} catch (const std::exception &e) {
+		dnet_log(n, DNET_LOG_DEBUG, "monitor: failed to update stages stats: %s", e.what());
+	}
+}
+
+void dnet_monitor_request_complete(struct dnet_node *n, struct dnet_net_state *st, ssize_t backend_id,
+                                   const struct dnet_cmd *cmd, const uint64_t *stages, uint64_t queue_depth, int err) {
+	try {
+		auto real_monitor = ioremap::monitor::get_monitor(n);
+		if (!real_monitor)
+			return;
+
+		ioremap::monitor::slow_requests *slow = real_monitor->get_statistics().get_slow_requests_raw();
+		if (slow)
+			slow->update(n, st, backend_id, cmd, stages, queue_depth, err);
+	} catch (const std::exception &e) {
+		dnet_log(n, DNET_LOG_DEBUG, "monitor: failed to update slow requests: %s", e.what());
+	}
+}
+
 int dnet_monitor_process_cmd(struct dnet_net_state *orig, struct dnet_cmd *cmd __unused, void *data)
 {
 	if (cmd->size != sizeof(dnet_monitor_stat_request)) {
@@ -253,8 +373,8 @@ int dnet_monitor_process_cmd(struct dnet_net_state *orig, struct dnet_cmd *cmd _
 		return dnet_send_reply(orig, cmd, disabled_reply.c_str(), disabled_reply.size(), 0);
 
 	try {
-		auto json = real_monitor->get_statistics().report(req->categories);
-		return dnet_send_reply(orig, cmd, &*json.begin(), json.size(), 0);
+		auto json = real_monitor->get_statistics().report(req->categories, req->generation);
+		return dnet_send_reply_move(orig, cmd, std::move(json), 0);
 	} catch(const std::exception &e) {
 		const std::string rep = ioremap::monitor::compress("{\"monitor_status\":\"failed: " + std::string(e.what()) + "\"}");
 		dnet_log(orig->n, DNET_LOG_DEBUG, "monitor: failed to generate json: %s", e.what());
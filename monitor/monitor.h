@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,8 @@ extern "C" {
 
 struct dnet_node;
 struct dnet_config;
+struct dnet_cmd;
+struct dnet_net_state;
 
 /*!
  * \internal
@@ -110,6 +113,44 @@ void dnet_monitor_stats_update(struct dnet_node *n, const struct dnet_cmd *cmd,
                                const int err, const int cache,
                                const uint32_t size, const unsigned long time);
 
+/*!
+ * \internal
+ *
+ * Stages of request processing which are timed separately
+ */
+enum dnet_io_stage {
+	DNET_IO_STAGE_QUEUE = 0,	/* waiting in io pool queue */
+	DNET_IO_STAGE_PROCESS,		/* processing by io thread including backend and queueing of replies */
+	DNET_IO_STAGE_BACKEND,		/* backend or cache command handler */
+	DNET_IO_STAGE_SEND,		/* reply waiting in send queue and being written to socket */
+	__DNET_IO_STAGE_MAX
+};
+
+/*
+ * Stage which was not passed by the request
+ */
+#define DNET_IO_STAGE_NONE	(~0ULL)
+
+/*!
+ * \internal
+ *
+ * Adds \a stages timings in usecs of \a cmd to per-stage latency histograms,
+ * stages which were not passed are set to DNET_IO_STAGE_NONE.
+ * Requests with DNET_FLAGS_TRACE_BIT or sampled by monitor.trace_sample_rate
+ * are also logged as spans with their trace_id.
+ */
+void dnet_monitor_stages_update(struct dnet_node *n, const struct dnet_cmd *cmd, const uint64_t *stages);
+
+/*!
+ * \internal
+ *
+ * Puts \a cmd received from \a st and processed by backend \a backend_id (-1 for system pool)
+ * into ring of slow requests if its queue and process \a stages took longer than
+ * monitor.slow_requests.threshold_usecs. \a queue_depth is the size of io queue at request arrival.
+ */
+void dnet_monitor_request_complete(struct dnet_node *n, struct dnet_net_state *st, ssize_t backend_id,
+		const struct dnet_cmd *cmd, const uint64_t *stages, uint64_t queue_depth, int err);
+
 int dnet_monitor_process_cmd(struct dnet_net_state *orig, struct dnet_cmd *cmd, void *data);
 
 #ifdef __cplusplus
@@ -41,6 +41,25 @@ struct monitor_config
 	size_t		top_length;
 	size_t		events_size;
 	int		period_in_seconds;
+	unsigned int	top_sample_rate;
+	size_t		top_sketch_size;
+	unsigned int	report_cache_ms;
+	// every trace_sample_rate transaction is logged as span, 0 - only requests with trace bit
+	unsigned int	trace_sample_rate;
+	// requests which spent at least slow_threshold usecs are kept in per-backend rings of slow_size entries
+	uint64_t	slow_threshold;
+	size_t		slow_size;
+	// number of peers with the highest traffic put into commands statistics
+	size_t		top_peers;
+	// counts wait and hold times of instrumented lock sites
+	bool		lock_stats;
+	// enables /profile/cpu and /profile/heap, CPU profile can not be longer than profile_max_seconds
+	bool		profiling;
+	unsigned int	profile_max_seconds;
+	// period of background sampling of procfs and backends' storage statistics, 0 - read them on every report
+	unsigned int	sample_interval_ms;
+	// backends count requests of 2^heatmap_bits key ranges, 0 - disabled
+	unsigned int	heatmap_bits;
 
 	static std::unique_ptr<monitor_config> parse(const ioremap::elliptics::config::config &monitor);
 };
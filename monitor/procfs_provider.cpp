@@ -25,6 +25,7 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 #include "elliptics/interface.h"
+#include "library/hugepage.h"
 
 namespace ioremap { namespace monitor {
 
@@ -173,9 +174,59 @@ err_out_exit:
 	return err;
 }
 
-procfs_provider::procfs_provider(struct dnet_node *node)
+struct proc_huge_pages_stat {
+	uint64_t anon_huge_pages;
+	uint64_t huge_pages_total;
+	uint64_t huge_pages_free;
+	uint64_t huge_pages_rsvd;
+	uint64_t huge_page_size;
+};
+
+static int fill_proc_huge_pages_stat(dnet_logger *l, struct proc_huge_pages_stat &st)
+{
+	char buf[256];
+	char name[64];
+	uint64_t value;
+	FILE *f;
+
+	memset(&st, 0, sizeof(st));
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f) {
+		dnet_log_only_log(l, DNET_LOG_ERROR, "Failed to open '/proc/meminfo': %s [%d].",
+				  strerror(errno), errno);
+		return -errno;
+	}
+
+	// sizes are reported in kilobytes, page counters are plain numbers
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "%63s %" SCNu64, name, &value) != 2)
+			continue;
+
+		if (!strcmp(name, "AnonHugePages:"))
+			st.anon_huge_pages = value * 1024;
+		else if (!strcmp(name, "HugePages_Total:"))
+			st.huge_pages_total = value;
+		else if (!strcmp(name, "HugePages_Free:"))
+			st.huge_pages_free = value;
+		else if (!strcmp(name, "HugePages_Rsvd:"))
+			st.huge_pages_rsvd = value;
+		else if (!strcmp(name, "Hugepagesize:"))
+			st.huge_page_size = value * 1024;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+procfs_provider::procfs_provider(struct dnet_node *node, unsigned int sample_interval_ms)
 : m_node(node)
-{}
+{
+	if (sample_interval_ms) {
+		m_sampler.reset(new periodic_sampler("procfs", sample_interval_ms,
+			std::bind(&procfs_provider::sample, this)));
+	}
+}
 
 static void fill_vm(dnet_node *node,
                     rapidjson::Value &stat_value,
@@ -303,10 +354,58 @@ static void fill_net(dnet_node *node,
 	stat_value.AddMember("net", net_stat, allocator);
 }
 
+static void fill_huge_pages(dnet_node *node,
+                            rapidjson::Value &stat_value,
+                            rapidjson::Document::AllocatorType &allocator) {
+	rapidjson::Value huge_stat(rapidjson::kObjectType);
+	int err = 0;
+	proc_huge_pages_stat st;
+	struct dnet_huge_pages_stat pools;
+
+	dnet_huge_pages_stat(&pools);
+	huge_stat.AddMember("mode", dnet_huge_pages_mode_string(dnet_huge_pages_mode()), allocator);
+	huge_stat.AddMember("hugetlb_size", pools.hugetlb_size, allocator);
+	huge_stat.AddMember("madvise_size", pools.madvise_size, allocator);
+	huge_stat.AddMember("fallback_size", pools.fallback_size, allocator);
+
+	err = fill_proc_huge_pages_stat(node->log, st);
+	huge_stat.AddMember("error", err, allocator);
+
+	if (!err) {
+		huge_stat.AddMember("string_error", "", allocator);
+		huge_stat.AddMember("anon_huge_pages", st.anon_huge_pages, allocator);
+		huge_stat.AddMember("huge_pages_total", st.huge_pages_total, allocator);
+		huge_stat.AddMember("huge_pages_free", st.huge_pages_free, allocator);
+		huge_stat.AddMember("huge_pages_rsvd", st.huge_pages_rsvd, allocator);
+		huge_stat.AddMember("huge_page_size", st.huge_page_size, allocator);
+	} else
+		huge_stat.AddMember("string_error", strerror(-err), allocator);
+
+	stat_value.AddMember("huge_pages", huge_stat, allocator);
+}
+
 std::string procfs_provider::json(uint64_t categories) const {
 	if (!(categories & DNET_MONITOR_PROCFS))
 	    return std::string();
 
+	if (m_sampler) {
+		std::lock_guard<std::mutex> guard(m_sample_lock);
+		// report may come before the first sample is finished
+		if (!m_sample.empty())
+			return m_sample;
+	}
+
+	return collect();
+}
+
+void procfs_provider::sample() {
+	std::string sample = collect();
+
+	std::lock_guard<std::mutex> guard(m_sample_lock);
+	m_sample.swap(sample);
+}
+
+std::string procfs_provider::collect() const {
 	rapidjson::Document doc;
 	doc.SetObject();
 	auto &allocator = doc.GetAllocator();
@@ -315,6 +414,7 @@ std::string procfs_provider::json(uint64_t categories) const {
 	fill_io(m_node, doc, allocator);
 	fill_stat(m_node, doc, allocator);
 	fill_net(m_node, doc, allocator);
+	fill_huge_pages(m_node, doc, allocator);
 
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
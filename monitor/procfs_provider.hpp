@@ -21,20 +21,33 @@
 #define __DNET_MONITOR_PROCFS_PROVIDER_HPP
 
 #include "statistics.hpp"
+#include "sampler.hpp"
+
+#include <memory>
 
 namespace ioremap { namespace monitor {
 
 /*!
  * Provider statistics gethered from procfs
+ * If \a sample_interval_ms is not zero, procfs is read by background sampler
+ * and reports return json of the last sample.
  */
 class procfs_provider : public stat_provider {
 public:
-	procfs_provider(struct dnet_node *node);
+	procfs_provider(struct dnet_node *node, unsigned int sample_interval_ms);
 
 	virtual std::string json(uint64_t categories) const;
 
 private:
+	std::string collect() const;
+	void sample();
+
 	struct dnet_node *m_node;
+
+	mutable std::mutex m_sample_lock;
+	std::string m_sample;
+	// must be the last member: it is stopped before the sample is destroyed
+	std::unique_ptr<periodic_sampler> m_sampler;
 };
 
 }} /* namespace ioremap::monitor */
@@ -0,0 +1,271 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace ioremap { namespace monitor {
+
+namespace {
+
+// frames of signal handler and signal trampoline which precede interrupted code
+const int skip_frames = 2;
+const int max_depth = 64;
+// samples which do not fit are counted as dropped
+const size_t max_samples = 64 * 1024;
+
+struct sample {
+	int depth;
+	void *pcs[max_depth + skip_frames];
+};
+
+std::atomic_flag cpu_profile_busy = ATOMIC_FLAG_INIT;
+std::once_flag cpu_profile_handler_once;
+
+std::atomic<sample *> samples(nullptr);
+std::atomic<size_t> samples_num(0);
+std::atomic<int> handlers_running(0);
+
+void cpu_profile_handler(int)
+{
+	const int saved_errno = errno;
+
+	handlers_running.fetch_add(1, std::memory_order_acquire);
+
+	sample *buffer = samples.load(std::memory_order_acquire);
+	if (buffer) {
+		const size_t idx = samples_num.fetch_add(1, std::memory_order_relaxed);
+		if (idx < max_samples) {
+			sample &s = buffer[idx];
+			s.depth = backtrace(s.pcs, max_depth + skip_frames);
+		}
+	}
+
+	handlers_running.fetch_sub(1, std::memory_order_release);
+
+	errno = saved_errno;
+}
+
+/*
+ * Handler stays installed after profile is finished: SIGPROF which is already pending
+ * would terminate the process with the default action
+ */
+void install_cpu_profile_handler()
+{
+	// the first backtrace() loads unwinder, which is not allowed in signal handler
+	void *warmup[max_depth];
+	backtrace(warmup, max_depth);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = cpu_profile_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGPROF, &sa, nullptr))
+		throw profiler_error(std::string("could not install SIGPROF handler: ") + strerror(errno));
+}
+
+void set_profile_timer(unsigned int period_usecs)
+{
+	struct itimerval timer;
+	timer.it_interval.tv_sec = period_usecs / 1000000;
+	timer.it_interval.tv_usec = period_usecs % 1000000;
+	timer.it_value = timer.it_interval;
+
+	if (setitimer(ITIMER_PROF, &timer, nullptr))
+		throw profiler_error(std::string("could not set SIGPROF timer: ") + strerror(errno));
+}
+
+/*
+ * Stops sampling and waits until handlers which have already started are finished with the buffer
+ */
+class sampling_guard {
+public:
+	sampling_guard(sample *buffer) {
+		samples_num.store(0);
+		samples.store(buffer, std::memory_order_release);
+	}
+
+	~sampling_guard() {
+		struct itimerval timer;
+		memset(&timer, 0, sizeof(timer));
+		setitimer(ITIMER_PROF, &timer, nullptr);
+
+		samples.store(nullptr, std::memory_order_release);
+		while (handlers_running.load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+};
+
+class busy_guard {
+public:
+	busy_guard() {
+		if (cpu_profile_busy.test_and_set())
+			throw profiler_busy("another CPU profile is being taken");
+	}
+
+	~busy_guard() {
+		cpu_profile_busy.clear();
+	}
+};
+
+void append_word(std::string &out, uintptr_t word)
+{
+	out.append(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+std::string read_file(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+/*
+ * Legacy pprof CPU profile: header, records of (count, depth, pcs...), trailer, then /proc/self/maps
+ */
+std::string format_cpu_profile(const sample *buffer, size_t num, unsigned int period_usecs)
+{
+	std::map<std::vector<uintptr_t>, uintptr_t> stacks;
+
+	for (size_t i = 0; i < num; ++i) {
+		const sample &s = buffer[i];
+		if (s.depth <= skip_frames)
+			continue;
+
+		std::vector<uintptr_t> pcs(reinterpret_cast<const uintptr_t *>(s.pcs + skip_frames),
+				reinterpret_cast<const uintptr_t *>(s.pcs + s.depth));
+		++stacks[pcs];
+	}
+
+	std::string out;
+	append_word(out, 0);
+	append_word(out, 3);
+	append_word(out, 0);
+	append_word(out, period_usecs);
+	append_word(out, 0);
+
+	for (auto it = stacks.cbegin(); it != stacks.cend(); ++it) {
+		append_word(out, it->second);
+		append_word(out, it->first.size());
+		for (auto pc = it->first.cbegin(); pc != it->first.cend(); ++pc)
+			append_word(out, *pc);
+	}
+
+	append_word(out, 0);
+	append_word(out, 1);
+	append_word(out, 0);
+
+	out.append(read_file("/proc/self/maps"));
+	return out;
+}
+
+} /* namespace */
+
+std::string cpu_profile(unsigned int seconds, unsigned int frequency, const std::function<bool ()> &stop)
+{
+	busy_guard busy;
+
+	const unsigned int period_usecs = 1000000 / std::max(1u, std::min(frequency, 1000u));
+	std::unique_ptr<sample[]> buffer(new sample[max_samples]);
+
+	std::call_once(cpu_profile_handler_once, install_cpu_profile_handler);
+
+	{
+		sampling_guard sampling(buffer.get());
+		set_profile_timer(period_usecs);
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+		while (std::chrono::steady_clock::now() < deadline && !stop())
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	const size_t num = std::min(samples_num.load(), max_samples);
+	return format_cpu_profile(buffer.get(), num, period_usecs);
+}
+
+std::string heap_profile()
+{
+	typedef int (*mallctl_t)(const char *, void *, size_t *, void *, size_t);
+	typedef int (*is_heap_profiler_running_t)();
+	typedef char *(*get_heap_profile_t)();
+
+	auto mallctl = reinterpret_cast<mallctl_t>(dlsym(RTLD_DEFAULT, "mallctl"));
+	if (mallctl) {
+		bool enabled = false;
+		size_t size = sizeof(enabled);
+
+		if (!mallctl("opt.prof", &enabled, &size, nullptr, 0) && enabled) {
+			const char *tmpdir = getenv("TMPDIR");
+			std::string path = std::string(tmpdir ? tmpdir : "/tmp") + "/elliptics-heap-XXXXXX";
+
+			int fd = mkstemp(&path[0]);
+			if (fd < 0)
+				throw profiler_error(std::string("could not create heap profile file: ") + strerror(errno));
+			close(fd);
+
+			const char *filename = path.c_str();
+			int err = mallctl("prof.dump", nullptr, nullptr, &filename, sizeof(filename));
+			if (err) {
+				unlink(filename);
+				throw profiler_error(std::string("jemalloc could not dump heap profile: ") + strerror(err));
+			}
+
+			std::string result = read_file(path);
+			unlink(filename);
+			return result;
+		}
+	}
+
+	auto is_running = reinterpret_cast<is_heap_profiler_running_t>(dlsym(RTLD_DEFAULT, "IsHeapProfilerRunning"));
+	auto get_profile = reinterpret_cast<get_heap_profile_t>(dlsym(RTLD_DEFAULT, "GetHeapProfile"));
+	if (is_running && get_profile && is_running()) {
+		char *profile = get_profile();
+		if (!profile)
+			throw profiler_error("tcmalloc could not get heap profile");
+
+		std::string result(profile);
+		free(profile);
+		return result;
+	}
+
+	throw profiler_unavailable("heap profiling requires jemalloc running with MALLOC_CONF=prof:true "
+			"or tcmalloc running with HEAPPROFILE");
+}
+
+}} /* namespace ioremap::monitor */
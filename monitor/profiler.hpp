@@ -0,0 +1,74 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_MONITOR_PROFILER_HPP
+#define __DNET_MONITOR_PROFILER_HPP
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Default and maximum length of CPU profile taken through monitor server and its sampling frequency
+ */
+#define DNET_DEFAULT_MONITOR_PROFILE_SECONDS 30
+#define DNET_DEFAULT_MONITOR_PROFILE_MAX_SECONDS 300
+#define DNET_DEFAULT_MONITOR_PROFILE_FREQUENCY 100
+
+namespace ioremap { namespace monitor {
+
+class profiler_error : public std::runtime_error {
+public:
+	explicit profiler_error(const std::string &message) : std::runtime_error(message) {}
+};
+
+/*!
+ * Another CPU profile of the process is being taken
+ */
+class profiler_busy : public profiler_error {
+public:
+	explicit profiler_busy(const std::string &message) : profiler_error(message) {}
+};
+
+/*!
+ * Process runs without allocator which can profile heap
+ */
+class profiler_unavailable : public profiler_error {
+public:
+	explicit profiler_unavailable(const std::string &message) : profiler_error(message) {}
+};
+
+/*!
+ * Samples call stacks of the process for \a seconds by SIGPROF timer firing \a frequency times
+ * per second of consumed CPU time and returns them in legacy pprof CPU profile format
+ * (the one of gperftools), which is read by `pprof <binary> <profile>`.
+ * \a stop is checked every 100 milliseconds, profile is finished earlier if it returns true.
+ * Throws profiler_busy if another CPU profile is being taken, SIGPROF timer is process-wide.
+ */
+std::string cpu_profile(unsigned int seconds, unsigned int frequency, const std::function<bool ()> &stop);
+
+/*!
+ * Returns heap profile of jemalloc (prof.dump, process has to run with MALLOC_CONF=prof:true)
+ * or tcmalloc (GetHeapProfile(), process has to run with HEAPPROFILE) in pprof compatible format.
+ * Allocators are looked up at runtime, so nothing is required at build time.
+ * Throws profiler_unavailable if neither of them is profiling heap.
+ */
+std::string heap_profile();
+
+}} /* namespace ioremap::monitor */
+
+#endif /* __DNET_MONITOR_PROFILER_HPP */
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sampler.hpp"
+
+#include "library/elliptics.h"
+
+namespace ioremap { namespace monitor {
+
+periodic_sampler::periodic_sampler(const std::string &name, unsigned int interval_ms, std::function<void ()> sample)
+: m_name(name)
+, m_interval_ms(interval_ms)
+, m_sample(std::move(sample))
+, m_stopped(false)
+, m_thread(std::bind(&periodic_sampler::run, this))
+{}
+
+periodic_sampler::~periodic_sampler() {
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_stopped = true;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+}
+
+void periodic_sampler::run() {
+	dnet_set_name("dnet_sample_%s", m_name.c_str());
+
+	std::unique_lock<std::mutex> guard(m_lock);
+	while (!m_stopped) {
+		guard.unlock();
+		// provider logs its own errors, one failed sample must not stop the following ones
+		try {
+			m_sample();
+		} catch (...) {
+		}
+		guard.lock();
+
+		m_condition.wait_for(guard, std::chrono::milliseconds(m_interval_ms), [this] { return m_stopped; });
+	}
+}
+
+}} /* namespace ioremap::monitor */
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __DNET_MONITOR_SAMPLER_HPP
+#define __DNET_MONITOR_SAMPLER_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Default period in milliseconds of sampling procfs and backends' storage statistics,
+ * 0 makes every report gather them by itself
+ */
+#define DNET_DEFAULT_MONITOR_SAMPLE_INTERVAL_MS 1000
+
+namespace ioremap { namespace monitor {
+
+/*!
+ * \internal
+ *
+ * Background thread which calls \a sample every \a interval_ms milliseconds.
+ * Providers which statistics are costly to gather (procfs files, backends' storage stats)
+ * keep results of the last sample and reports only read them.
+ * First sample is taken right after the thread is started.
+ */
+class periodic_sampler {
+public:
+	periodic_sampler(const std::string &name, unsigned int interval_ms, std::function<void ()> sample);
+
+	/*!
+	 * \internal
+	 *
+	 * Destructor: stops the thread and waits until current sample is finished
+	 */
+	~periodic_sampler();
+
+	periodic_sampler(const periodic_sampler &) = delete;
+	periodic_sampler &operator =(const periodic_sampler &) = delete;
+
+private:
+	void run();
+
+	const std::string		m_name;
+	const unsigned int		m_interval_ms;
+	std::function<void ()>		m_sample;
+
+	std::mutex			m_lock;
+	std::condition_variable		m_condition;
+	bool				m_stopped;
+	std::thread			m_thread;
+};
+
+}} /* namespace ioremap::monitor */
+
+#endif /* __DNET_MONITOR_SAMPLER_HPP */
@@ -22,13 +22,15 @@
 
 #include "../library/elliptics.h"
 #include "http_miscs.hpp"
+#include "profiler.hpp"
 
 namespace ioremap { namespace monitor {
 
 class handler: public std::enable_shared_from_this<handler> {
 public:
-	handler(monitor &mon, boost::asio::io_service &io_service)
+	handler(monitor &mon, server &srv, boost::asio::io_service &io_service)
 	: m_monitor(mon)
+	, m_server(srv)
 	, m_socket(io_service)
 	, m_remote("")
 	{}
@@ -51,9 +53,12 @@ private:
 	void handle_write();
 	void close();
 
-	uint64_t parse_request(size_t size);
+	void handle_profile(int kind, unsigned int seconds);
+
+	uint64_t parse_request(size_t size, uint64_t *generation);
 
 	monitor							&m_monitor;
+	server							&m_server;
 	boost::asio::ip::tcp::socket	m_socket;
 	std::string						m_remote;
 	boost::array<char, 1024>		m_buffer;
@@ -66,13 +71,17 @@ static boost::asio::ip::tcp convert_family(int family) {
 
 server::server(monitor &mon, unsigned int port, int family)
 : m_monitor(mon)
-, m_acceptor(m_io_service, boost::asio::ip::tcp::endpoint(convert_family(family), port)) {
+, m_acceptor(m_io_service, boost::asio::ip::tcp::endpoint(convert_family(family), port))
+, m_stopped(false)
+, m_profiling(false) {
 	m_listen = std::thread(std::bind(&server::listen, this));
 }
 
 server::~server() {
 	stop();
 	m_listen.join();
+	if (m_profiler.joinable())
+		m_profiler.join();
 }
 
 void server::listen() {
@@ -89,7 +98,7 @@ void server::listen() {
 }
 
 void server::async_accept() {
-	auto h = std::make_shared<handler>(m_monitor, m_io_service);
+	auto h = std::make_shared<handler>(m_monitor, *this, m_io_service);
 	m_acceptor.async_accept(h->socket(),
 	                        std::bind(&server::handle_accept, this,
 	                                  h,
@@ -106,9 +115,33 @@ void server::handle_accept(std::shared_ptr<handler> h, const boost::system::erro
 
 
 void server::stop() {
+	m_stopped = true;
 	m_io_service.stop();
 }
 
+bool server::stopped() const {
+	return m_stopped;
+}
+
+void server::post(std::function<void ()> task) {
+	m_io_service.post(std::move(task));
+}
+
+bool server::run_profile(std::function<void ()> task) {
+	if (m_profiling.exchange(true))
+		return false;
+
+	// previous profile has finished, its thread only has to exit
+	if (m_profiler.joinable())
+		m_profiler.join();
+
+	m_profiler = std::thread([this, task] () {
+		task();
+		m_profiling = false;
+	});
+	return true;
+}
+
 void handler::async_read() {
 	auto self(shared_from_this());
 	m_socket.async_read_some(boost::asio::buffer(m_buffer),
@@ -123,20 +156,81 @@ void handler::handle_read(const boost::system::error_code &err, size_t size) {
 		return;
 	}
 
-	auto req = parse_request(size);
+	int profile = 0;
+	unsigned int seconds = DNET_DEFAULT_MONITOR_PROFILE_SECONDS;
+	if (parse_profile(m_buffer.data(), size, &profile, &seconds)) {
+		handle_profile(profile, seconds);
+		return;
+	}
+
+	uint64_t families;
+	if (parse_metrics(m_buffer.data(), size, &families)) {
+		dnet_log(m_monitor.node(), DNET_LOG_DEBUG,
+				"monitor: server: got metrics request for families: %llx from: %s:%d",
+				(unsigned long long)families, m_remote.c_str(), m_socket.remote_endpoint().port());
+		async_write(make_metrics_reply(m_monitor.get_statistics().metrics(families)));
+		return;
+	}
+
+	uint64_t generation = 0;
+	auto req = parse_request(size, &generation);
 	std::string content = "";
 
 	if (req > 0) {
 		dnet_log(m_monitor.node(), DNET_LOG_DEBUG,
-				"monitor: server: got statistics request for categories: %llx from: %s:%d",
-				(unsigned long long)req, m_remote.c_str(), m_socket.remote_endpoint().port());
-		content = m_monitor.get_statistics().report(req);
+				"monitor: server: got statistics request for categories: %llx, generation: %llu from: %s:%d",
+				(unsigned long long)req, (unsigned long long)generation,
+				m_remote.c_str(), m_socket.remote_endpoint().port());
+		content = m_monitor.get_statistics().report(req, generation);
 	}
 
 	std::string reply = make_reply(req, content);
 	async_write(reply);
 }
 
+void handler::handle_profile(int kind, unsigned int seconds) {
+	const monitor_config *cfg = get_monitor_config(m_monitor.node());
+	if (!cfg || !cfg->profiling) {
+		async_write(make_profile_reply(status_strings::forbidden,
+				"profiling is disabled, it is enabled by \"profiling\" monitor option\n"));
+		return;
+	}
+
+	dnet_log(m_monitor.node(), DNET_LOG_INFO, "monitor: server: got %s profile request from: %s:%d",
+			kind == profile_cpu ? "cpu" : "heap", m_remote.c_str(), m_socket.remote_endpoint().port());
+
+	if (kind == profile_heap) {
+		try {
+			async_write(make_profile_reply(status_strings::ok, heap_profile()));
+		} catch (const profiler_unavailable &e) {
+			async_write(make_profile_reply(status_strings::not_implemented, std::string(e.what()) + "\n"));
+		} catch (const std::exception &e) {
+			async_write(make_profile_reply(status_strings::service_unavailable, std::string(e.what()) + "\n"));
+		}
+		return;
+	}
+
+	seconds = std::max(1u, std::min(seconds, cfg->profile_max_seconds));
+
+	auto self(shared_from_this());
+	const bool started = m_server.run_profile([this, self, seconds] () {
+		std::string reply;
+		try {
+			reply = make_profile_reply(status_strings::ok, cpu_profile(seconds, DNET_DEFAULT_MONITOR_PROFILE_FREQUENCY,
+					[this] () { return m_server.stopped() || m_monitor.node()->need_exit; }));
+		} catch (const std::exception &e) {
+			reply = make_profile_reply(status_strings::service_unavailable, std::string(e.what()) + "\n");
+		}
+
+		m_server.post(std::bind(&handler::async_write, self, reply));
+	});
+
+	if (!started) {
+		async_write(make_profile_reply(status_strings::service_unavailable,
+				"another CPU profile is being taken\n"));
+	}
+}
+
 void handler::async_write(std::string data) {
 	auto self(shared_from_this());
 	m_report = std::move(data);
@@ -157,8 +251,8 @@ void handler::close() {
 	m_socket.shutdown(boost::asio::socket_base::shutdown_both, ec);
 }
 
-uint64_t handler::parse_request(size_t size) {
-	return parse(m_buffer.data(), size);
+uint64_t handler::parse_request(size_t size, uint64_t *generation) {
+	return parse(m_buffer.data(), size, generation);
 }
 
 }} /* namespace ioremap::monitor */
@@ -20,6 +20,8 @@
 #ifndef __DNET_MONITOR_SERVER_HPP
 #define __DNET_MONITOR_SERVER_HPP
 
+#include <atomic>
+#include <functional>
 #include <thread>
 
 #include <boost/asio.hpp>
@@ -54,6 +56,22 @@ public:
 	 */
 	void stop();
 
+	/*!
+	 * Returns true if server has been stopped
+	 */
+	bool stopped() const;
+
+	/*!
+	 * Runs \a task in profiler thread, so that monitor keeps serving other requests
+	 * while profile is being taken. Returns false if previous profile is not finished yet.
+	 */
+	bool run_profile(std::function<void ()> task);
+
+	/*!
+	 * Schedules \a task to be run by server thread
+	 */
+	void post(std::function<void ()> task);
+
 private:
 	/*!
 	 * Disabling default copy constructor
@@ -90,6 +108,13 @@ private:
 	 * Thread for executing boost::asio
 	 */
 	std::thread						m_listen;
+
+	std::atomic<bool>				m_stopped;
+	/*!
+	 * Thread which takes CPU profile, it is joined before the next profile or on destruction
+	 */
+	std::atomic<bool>				m_profiling;
+	std::thread						m_profiler;
 };
 
 }} /* namespace ioremap::monitor */
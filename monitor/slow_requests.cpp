@@ -0,0 +1,171 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slow_requests.hpp"
+#include "statistics.hpp"
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include "elliptics/interface.h"
+
+namespace ioremap { namespace monitor {
+
+slow_requests::slow_requests(uint64_t threshold, size_t size)
+: m_threshold(threshold)
+, m_size(std::max<size_t>(size, 1))
+{
+}
+
+void slow_requests::update(dnet_node *node, dnet_net_state *st, ssize_t backend_id, const dnet_cmd *cmd,
+		const uint64_t *stages, uint64_t queue_depth, int err)
+{
+	uint64_t total = 0;
+	for (int stage = DNET_IO_STAGE_QUEUE; stage <= DNET_IO_STAGE_PROCESS; ++stage) {
+		if (stages[stage] != DNET_IO_STAGE_NONE)
+			total += stages[stage];
+	}
+
+	if (total < m_threshold)
+		return;
+
+	slow_request request;
+	memset(&request, 0, sizeof(request));
+
+	request.id = cmd->id;
+	/* requests which are not bound to a connection, e.g. local ones, have no peer */
+	if (st)
+		request.peer = *dnet_state_addr(st);
+	dnet_current_time(&request.time);
+	request.cmd = cmd->cmd;
+	request.err = err;
+	request.trans = cmd->trans;
+	request.size = cmd->size;
+	request.queue_depth = queue_depth;
+	memcpy(request.stages, stages, sizeof(request.stages));
+	request.total = total;
+
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		ring &r = m_rings[backend_id];
+
+		if (r.requests.size() < m_size) {
+			r.requests.push_back(request);
+		} else {
+			r.requests[r.next] = request;
+		}
+		r.next = (r.next + 1) % m_size;
+	}
+
+	dnet_log(node, DNET_LOG_WARNING, "%s: %s: slow request: client: %s, trans: %llu, backend: %zd, "
+			"size: %llu, queue-depth: %llu, queue: %llu, process: %llu, backend-time: %llu usecs, err: %d",
+			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), dnet_addr_string(&request.peer),
+			(unsigned long long)cmd->trans, backend_id,
+			(unsigned long long)request.size, (unsigned long long)queue_depth,
+			(unsigned long long)stages[DNET_IO_STAGE_QUEUE], (unsigned long long)stages[DNET_IO_STAGE_PROCESS],
+			stages[DNET_IO_STAGE_BACKEND] == DNET_IO_STAGE_NONE ? 0ULL : (unsigned long long)stages[DNET_IO_STAGE_BACKEND],
+			err);
+}
+
+std::map<ssize_t, std::vector<slow_request>> slow_requests::get() const
+{
+	std::map<ssize_t, std::vector<slow_request>> ret;
+
+	std::unique_lock<std::mutex> guard(m_lock);
+	for (auto it = m_rings.begin(); it != m_rings.end(); ++it) {
+		const ring &r = it->second;
+		std::vector<slow_request> &requests = ret[it->first];
+
+		requests.reserve(r.requests.size());
+		for (size_t i = 1; i <= r.requests.size(); ++i)
+			requests.push_back(r.requests[(r.next + r.requests.size() - i) % r.requests.size()]);
+	}
+
+	return ret;
+}
+
+slow_provider::slow_provider(std::shared_ptr<slow_requests> slow)
+: m_slow(slow)
+{
+}
+
+static void fill_slow_request(const slow_request &request, rapidjson::Value &stat_array,
+		rapidjson::Document::AllocatorType &allocator) {
+	rapidjson::Value request_stat(rapidjson::kObjectType);
+
+	request_stat.AddMember("group", request.id.group_id, allocator);
+	rapidjson::Value id;
+	id.SetString(dnet_dump_id_str_full(request.id.id), allocator);
+	request_stat.AddMember("id", id, allocator);
+	request_stat.AddMember("cmd", dnet_cmd_string(request.cmd), allocator);
+	rapidjson::Value peer;
+	peer.SetString(dnet_addr_string(&request.peer), allocator);
+	request_stat.AddMember("peer", peer, allocator);
+	request_stat.AddMember("trans", request.trans, allocator);
+	request_stat.AddMember("error", request.err, allocator);
+	request_stat.AddMember("size", request.size, allocator);
+	request_stat.AddMember("queue_depth", request.queue_depth, allocator);
+
+	rapidjson::Value timestamp(rapidjson::kObjectType);
+	timestamp.AddMember("tv_sec", request.time.tsec, allocator);
+	timestamp.AddMember("tv_usec", request.time.tnsec / 1000, allocator);
+	request_stat.AddMember("timestamp", timestamp, allocator);
+
+	rapidjson::Value stages(rapidjson::kObjectType);
+	for (int stage = 0; stage < __DNET_IO_STAGE_MAX; ++stage) {
+		if (request.stages[stage] != DNET_IO_STAGE_NONE)
+			stages.AddMember(io_stage_string(stage), request.stages[stage], allocator);
+	}
+	request_stat.AddMember("stages_usecs", stages, allocator);
+	request_stat.AddMember("total_usecs", request.total, allocator);
+
+	stat_array.PushBack(request_stat, allocator);
+}
+
+std::string slow_provider::json(uint64_t categories) const {
+	if (!(categories & DNET_MONITOR_SLOW))
+		return std::string();
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	auto &allocator = doc.GetAllocator();
+
+	const auto rings = m_slow->get();
+
+	rapidjson::Value backends(rapidjson::kObjectType);
+	for (auto it = rings.begin(); it != rings.end(); ++it) {
+		rapidjson::Value requests(rapidjson::kArrayType);
+		requests.Reserve(it->second.size(), allocator);
+
+		for (auto request = it->second.begin(); request != it->second.end(); ++request)
+			fill_slow_request(*request, requests, allocator);
+
+		const std::string backend_id = std::to_string(static_cast<long long>(it->first));
+		backends.AddMember(backend_id.c_str(), allocator, requests, allocator);
+	}
+
+	doc.AddMember("threshold_usecs", m_slow->get_threshold(), allocator);
+	doc.AddMember("size", m_slow->get_size(), allocator);
+	doc.AddMember("backends", backends, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+	return buffer.GetString();
+}
+
+}} /* namespace ioremap::monitor */
@@ -0,0 +1,113 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_MONITOR_SLOW_REQUESTS_HPP
+#define __DNET_MONITOR_SLOW_REQUESTS_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "stat_provider.hpp"
+#include "monitor.h"
+#include "library/elliptics.h"
+
+/*
+ * Default time in usecs of queueing and processing of a request which makes it slow
+ */
+#define DNET_DEFAULT_MONITOR_SLOW_THRESHOLD 500000
+
+/*
+ * Default number of slow requests kept for every backend
+ */
+#define DNET_DEFAULT_MONITOR_SLOW_SIZE 64
+
+namespace ioremap { namespace monitor {
+
+/*!
+ * Properties of request whose queueing and processing took longer than threshold
+ */
+struct slow_request {
+	struct dnet_id		id;
+	struct dnet_addr	peer;
+	struct dnet_time	time;
+	int			cmd;
+	int			err;
+	uint64_t		trans;
+	uint64_t		size;
+	uint64_t		queue_depth;
+	uint64_t		stages[__DNET_IO_STAGE_MAX];
+	uint64_t		total;
+};
+
+/*!
+ * Rings of the most recent slow requests of every backend, requests which are not
+ * in any backend pool are kept with backend -1. Fast requests are rejected
+ * by the single comparison, lock is taken only for slow ones.
+ */
+class slow_requests {
+public:
+	slow_requests(uint64_t threshold, size_t size);
+
+	/*!
+	 * Records request processed by \a backend_id pool if its queueing and processing
+	 * took longer than threshold, \a st is the peer sent the request
+	 */
+	void update(dnet_node *node, dnet_net_state *st, ssize_t backend_id, const dnet_cmd *cmd,
+	            const uint64_t *stages, uint64_t queue_depth, int err);
+
+	uint64_t get_threshold() const { return m_threshold; }
+	size_t get_size() const { return m_size; }
+
+	/*!
+	 * Returns copy of rings indexed by backend, requests of every ring are ordered from the newest
+	 */
+	std::map<ssize_t, std::vector<slow_request>> get() const;
+
+private:
+	struct ring {
+		std::vector<slow_request>	requests;
+		// position of the next request to be replaced
+		size_t				next;
+
+		ring() : next(0) {}
+	};
+
+	const uint64_t m_threshold;
+	const size_t m_size;
+
+	mutable std::mutex m_lock;
+	std::map<ssize_t, ring> m_rings;
+};
+
+/*!
+ * Provider of slow requests statistics
+ */
+class slow_provider : public stat_provider {
+public:
+	slow_provider(std::shared_ptr<slow_requests> slow);
+
+	virtual std::string json(uint64_t categories) const;
+
+private:
+	std::shared_ptr<slow_requests> m_slow;
+};
+
+}} /* namespace ioremap::monitor */
+
+#endif /* __DNET_MONITOR_SLOW_REQUESTS_HPP */
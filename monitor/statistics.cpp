@@ -19,6 +19,9 @@
 
 #include "statistics.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "monitor.hpp"
 #include "cache/cache.hpp"
 #include "elliptics/backends.h"
@@ -45,6 +48,81 @@ static void ext_stat_json(const ext_counter &ext_stat,
 	stat_value.AddMember("time", ext_stat.time, allocator);
 }
 
+/*
+ * Log-linear histogram of latencies in usecs: values below latency_sub_buckets are counted exactly,
+ * every next power of two is split into latency_sub_buckets buckets, so relative error is below 1/8.
+ * Buckets do not depend on data, histograms of different commands, backends and nodes
+ * are merged by adding counts of buckets with the same lower bounds.
+ */
+enum {
+	latency_sub_bits = 3,
+	latency_sub_buckets = 1 << latency_sub_bits,
+	latency_max_bits = 40,
+	latency_buckets = latency_sub_buckets * (latency_max_bits - latency_sub_bits + 1)
+};
+
+static inline size_t latency_bucket(uint64_t value) {
+	if (value < latency_sub_buckets)
+		return value;
+
+	const int msb = 63 - __builtin_clzll(value);
+	if (msb >= latency_max_bits)
+		return latency_buckets - 1;
+
+	const int shift = msb - latency_sub_bits;
+	return (shift + 1) * latency_sub_buckets + ((value >> shift) & (latency_sub_buckets - 1));
+}
+
+static inline uint64_t latency_bucket_lower(size_t bucket) {
+	if (bucket < latency_sub_buckets)
+		return bucket;
+
+	const size_t shift = bucket / latency_sub_buckets - 1;
+	return (uint64_t(latency_sub_buckets) | (bucket % latency_sub_buckets)) << shift;
+}
+
+/*
+ * Returns upper bound of the bucket which contains @p part of all values
+ */
+static uint64_t latency_percentile(const std::vector<uint64_t> &latencies, uint64_t total, double p) {
+	const uint64_t rank = std::max<uint64_t>(1, std::ceil(p * total));
+	uint64_t count = 0;
+
+	for (size_t i = 0; i < latencies.size(); ++i) {
+		count += latencies[i];
+		if (count >= rank)
+			return i + 1 < latencies.size() ? latency_bucket_lower(i + 1) - 1 : latency_bucket_lower(i);
+	}
+
+	return 0;
+}
+
+static void latency_stat_json(const std::vector<uint64_t> &latencies, rapidjson::Value &stat_value,
+		rapidjson::Document::AllocatorType &allocator) {
+	uint64_t total = 0;
+	rapidjson::Value buckets(rapidjson::kArrayType);
+
+	for (size_t i = 0; i < latencies.size(); ++i) {
+		if (!latencies[i])
+			continue;
+
+		rapidjson::Value bucket(rapidjson::kArrayType);
+		bucket.PushBack(latency_bucket_lower(i), allocator);
+		bucket.PushBack(latencies[i], allocator);
+		buckets.PushBack(bucket, allocator);
+
+		total += latencies[i];
+	}
+
+	stat_value.AddMember("sub_buckets", latency_sub_buckets, allocator);
+	stat_value.AddMember("count", total, allocator);
+	stat_value.AddMember("p50", latency_percentile(latencies, total, 0.5), allocator);
+	stat_value.AddMember("p90", latency_percentile(latencies, total, 0.9), allocator);
+	stat_value.AddMember("p99", latency_percentile(latencies, total, 0.99), allocator);
+	stat_value.AddMember("p999", latency_percentile(latencies, total, 0.999), allocator);
+	stat_value.AddMember("buckets", buckets, allocator);
+}
+
 static void source_stat_json(const source_counter &source_stat, rapidjson::Value &stat_value,
 		rapidjson::Document::AllocatorType &allocator) {
 	rapidjson::Value outside_stat(rapidjson::kObjectType);
@@ -54,6 +132,12 @@ static void source_stat_json(const source_counter &source_stat, rapidjson::Value
 	rapidjson::Value internal_stat(rapidjson::kObjectType);
 	ext_stat_json(source_stat.internal, internal_stat, allocator);
 	stat_value.AddMember("internal", internal_stat, allocator);
+
+	if (!source_stat.latencies.empty()) {
+		rapidjson::Value latency_stat(rapidjson::kObjectType);
+		latency_stat_json(source_stat.latencies, latency_stat, allocator);
+		stat_value.AddMember("latency_usecs", latency_stat, allocator);
+	}
 }
 
 static void dnet_stat_count_json(const dnet_stat_count &counter, rapidjson::Value &stat_value,
@@ -93,44 +177,224 @@ static void cmd_stat_json(dnet_node *node, int cmd, const command_counters &cmd_
 	}
 }
 
-static void single_client_stat_json(dnet_net_state *st, rapidjson::Value &stat_value,
+static void single_client_stat_json(const peer_snapshot &client, rapidjson::Value &stat_value,
 		rapidjson::Document::AllocatorType &allocator) {
 	for (int i = 1; i < __DNET_CMD_MAX; ++i) {
-		if (st->stat[i].count != 0 || st->stat[i].err != 0) {
+		if (client.stat[i].count != 0 || client.stat[i].err != 0) {
 			rapidjson::Value cmd_stat(rapidjson::kObjectType);
-			dnet_stat_count_json(st->stat[i], cmd_stat, allocator);
+			dnet_stat_count_json(client.stat[i], cmd_stat, allocator);
 			stat_value.AddMember(dnet_cmd_string(i), allocator, cmd_stat, allocator);
 		}
 	}
 }
 
-static void clients_stat_json(dnet_node *n, rapidjson::Value &stat_value,
+static void clients_stat_json(const std::vector<peer_snapshot> &peers, rapidjson::Value &stat_value,
 		rapidjson::Document::AllocatorType &allocator) {
+	for (auto it = peers.begin(); it != peers.end(); ++it) {
+		if (!it->client)
+			continue;
+
+		rapidjson::Value client_stat(rapidjson::kObjectType);
+		single_client_stat_json(*it, client_stat, allocator);
+		stat_value.AddMember(dnet_addr_string(&it->addr), allocator, client_stat, allocator);
+	}
+}
+
+/*
+ * Requests admitted and throttled by rate limits of every tenant, see dnet_qos
+ */
+static void qos_stat_json(dnet_qos &qos, rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) {
+	const std::vector<dnet_qos_stat> stats = qos.stats();
+
+	for (auto it = stats.begin(); it != stats.end(); ++it) {
+		rapidjson::Value tenant_stat(rapidjson::kObjectType);
+		tenant_stat.AddMember("rate_ops", it->limit.rate_ops, allocator);
+		tenant_stat.AddMember("rate_bytes", it->limit.rate_bytes, allocator);
+		tenant_stat.AddMember("ops", it->ops, allocator);
+		tenant_stat.AddMember("bytes", it->bytes, allocator);
+		tenant_stat.AddMember("throttled_ops", it->throttled_ops, allocator);
+		tenant_stat.AddMember("throttled_bytes", it->throttled_bytes, allocator);
+		stat_value.AddMember(it->name.c_str(), allocator, tenant_stat, allocator);
+	}
+}
+
+static void memory_stat_json(dnet_node *n, rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) {
+	stat_value.AddMember("limit", n->memory.limit, allocator);
+	stat_value.AddMember("used", dnet_memory_total(n), allocator);
+
+	rapidjson::Value subsystems(rapidjson::kObjectType);
+	for (int i = 0; i < DNET_MEMORY_SUBSYSTEMS; ++i) {
+		const dnet_memory_subsystem subsystem = static_cast<dnet_memory_subsystem>(i);
+
+		rapidjson::Value subsystem_stat(rapidjson::kObjectType);
+		subsystem_stat.AddMember("budget", n->memory.budget[i], allocator);
+		subsystem_stat.AddMember("used", dnet_memory_used(n, subsystem), allocator);
+		subsystem_stat.AddMember("pressure", dnet_memory_pressure_string(dnet_memory_pressure(n, subsystem)), allocator);
+		subsystems.AddMember(dnet_memory_subsystem_string(subsystem), subsystem_stat, allocator);
+	}
+	stat_value.AddMember("subsystems", subsystems, allocator);
+
+	stat_value.AddMember("recv_deferred", n->memory.recv_deferred, allocator);
+	stat_value.AddMember("iterator_pauses", n->memory.iterator_pauses, allocator);
+	stat_value.AddMember("cache_shrunk_bytes", n->memory.cache_shrunk, allocator);
+}
+
+static void snapshot_state_list(struct list_head *head, bool client, std::vector<peer_snapshot> &peers) {
 	struct dnet_net_state *st;
 
-	pthread_mutex_lock(&n->state_lock);
+	list_for_each_entry(st, head, node_entry) {
+		peers.emplace_back();
+		peer_snapshot &peer = peers.back();
+
+		peer.addr = st->addr;
+		peer.client = client;
+		peer.wire_compression = st->wire_compression;
+		memcpy(peer.stat, st->stat, sizeof(peer.stat));
+		memcpy(&peer.peer, &st->peer_stat, sizeof(peer.peer));
+	}
+}
+
+/*
+ * Copies counters of all client and server states, @state_lock is held only for copying
+ */
+static void collect_peers(dnet_node *n, std::vector<peer_snapshot> &peers) {
 	try {
-		list_for_each_entry(st, &n->empty_state_list, node_entry) {
-			rapidjson::Value client_stat(rapidjson::kObjectType);
-			single_client_stat_json(st, client_stat, allocator);
-			stat_value.AddMember(dnet_addr_string(&st->addr), allocator, client_stat, allocator);
-		}
-	} catch(std::exception &e) {
-		pthread_mutex_unlock(&n->state_lock);
+		dnet_pthread_lock_guard guard(n->state_lock, DNET_LOCK_SITE("n->state_lock"));
+
+		snapshot_state_list(&n->empty_state_list, true, peers);
+		snapshot_state_list(&n->dht_state_list, false, peers);
+	} catch (std::exception &e) {
 		dnet_log(n, DNET_LOG_ERROR, "monitor: failed collecting client state stats: %s", e.what());
 		throw;
-	} catch(...) {
-		pthread_mutex_unlock(&n->state_lock);
-		dnet_log(n, DNET_LOG_ERROR, "monitor: failed collecting client state stats: unknown exception");
-		throw;
 	}
-	pthread_mutex_unlock(&n->state_lock);
 }
 
+/*
+ * Returns upper bound in usecs of log2 bucket which contains @p part of peer's requests
+ */
+static uint64_t peer_latency_percentile(const dnet_peer_stat &peer, uint64_t total, double p) {
+	const uint64_t rank = std::max<uint64_t>(1, std::ceil(p * total));
+	uint64_t count = 0;
+
+	for (int i = 0; i < DNET_PEER_LATENCY_BUCKETS; ++i) {
+		count += peer.latency[i];
+		if (count >= rank)
+			return i ? (1ULL << i) - 1 : 0;
+	}
+
+	return 0;
+}
+
+static void peer_latency_json(const dnet_peer_stat &peer, rapidjson::Value &stat_value,
+		rapidjson::Document::AllocatorType &allocator) {
+	uint64_t total = 0;
+	for (int i = 0; i < DNET_PEER_LATENCY_BUCKETS; ++i)
+		total += peer.latency[i];
+
+	stat_value.AddMember("count", total, allocator);
+	stat_value.AddMember("p50", peer_latency_percentile(peer, total, 0.5), allocator);
+	stat_value.AddMember("p90", peer_latency_percentile(peer, total, 0.9), allocator);
+	stat_value.AddMember("p99", peer_latency_percentile(peer, total, 0.99), allocator);
+	stat_value.AddMember("max", peer_latency_percentile(peer, total, 1), allocator);
+}
+
+/*
+ * Original and on-wire bytes of payloads compressed for the peer and by it,
+ * ratio is original size divided by wire size, 0 if nothing has been compressed
+ */
+static void peer_compression_json(const peer_snapshot &peer, rapidjson::Value &stat_value,
+		rapidjson::Document::AllocatorType &allocator) {
+	const dnet_peer_stat &stat = peer.peer;
+
+	stat_value.AddMember("enabled", peer.wire_compression, allocator);
+	stat_value.AddMember("send_orig_bytes", stat.send_compress_orig, allocator);
+	stat_value.AddMember("send_wire_bytes", stat.send_compress_wire, allocator);
+	stat_value.AddMember("send_ratio",
+			stat.send_compress_wire ? double(stat.send_compress_orig) / stat.send_compress_wire : 0., allocator);
+	stat_value.AddMember("recv_orig_bytes", stat.recv_compress_orig, allocator);
+	stat_value.AddMember("recv_wire_bytes", stat.recv_compress_wire, allocator);
+	stat_value.AddMember("recv_ratio",
+			stat.recv_compress_wire ? double(stat.recv_compress_orig) / stat.recv_compress_wire : 0., allocator);
+}
+
+
+enum {
+	command_successes,
+	command_failures,
+	command_size,
+	command_time,
+	command_counters_count
+};
+
+struct latency_histogram {
+	std::atomic<uint64_t> buckets[latency_buckets];
+};
+
+/*
+ * Counters of all commands indexed by command, cache flag and transaction flag,
+ * latency histograms are indexed by command and cache flag, they are allocated by the first command
+ */
+struct command_stats::slab {
+	std::atomic<uint64_t> counters[__DNET_CMD_MAX][2][2][command_counters_count];
+	std::atomic<latency_histogram *> latencies[__DNET_CMD_MAX][2];
+	// stages are not split by commands, their histograms are always allocated
+	latency_histogram stages[__DNET_IO_STAGE_MAX];
+	std::atomic<uint64_t> stages_time[__DNET_IO_STAGE_MAX];
+
+	~slab() {
+		for (int cmd = 0; cmd < __DNET_CMD_MAX; ++cmd) {
+			delete latencies[cmd][0].load(std::memory_order_relaxed);
+			delete latencies[cmd][1].load(std::memory_order_relaxed);
+		}
+	}
+
+	latency_histogram *histogram(int cmd, int cache) {
+		std::atomic<latency_histogram *> &place = latencies[cmd][cache];
+
+		latency_histogram *current = place.load(std::memory_order_acquire);
+		if (current)
+			return current;
+
+		latency_histogram *allocated = new latency_histogram();
+		if (place.compare_exchange_strong(current, allocated, std::memory_order_acq_rel))
+			return allocated;
+
+		delete allocated;
+		return current;
+	}
+};
 
 command_stats::command_stats()
 {
-	m_cmd_stats.resize(__DNET_CMD_MAX);
+	for (int i = 0; i < slabs_count; ++i)
+		m_slabs[i].store(nullptr, std::memory_order_relaxed);
+}
+
+command_stats::~command_stats()
+{
+	for (int i = 0; i < slabs_count; ++i)
+		delete m_slabs[i].load(std::memory_order_relaxed);
+}
+
+command_stats::slab *command_stats::thread_slab()
+{
+	static std::atomic<int> next_slot(0);
+	static __thread int slot = -1;
+
+	if (slot < 0)
+		slot = next_slot.fetch_add(1, std::memory_order_relaxed) % slabs_count;
+
+	slab *current = m_slabs[slot].load(std::memory_order_acquire);
+	if (current)
+		return current;
+
+	// value-initialization zeroes all counters
+	slab *allocated = new slab();
+	if (m_slabs[slot].compare_exchange_strong(current, allocated, std::memory_order_acq_rel))
+		return allocated;
+
+	delete allocated;
+	return current;
 }
 
 void command_stats::command_counter(const int orig_cmd,
@@ -145,21 +409,149 @@ void command_stats::command_counter(const int orig_cmd,
 	if (cmd >= __DNET_CMD_MAX || cmd <= 0)
 		cmd = DNET_CMD_UNKNOWN;
 
-	std::unique_lock<std::mutex> guard(m_cmd_stats_mutex);
-	auto &place = cache ? m_cmd_stats[cmd].cache : m_cmd_stats[cmd].disk;
-	auto &source = trans ? place.outside : place.internal;
-	auto &counter = err ? source.counter.failures : source.counter.successes;
+	slab *current = thread_slab();
+	auto &counters = current->counters[cmd][cache ? 1 : 0][trans ? 1 : 0];
+
+	counters[err ? command_failures : command_successes].fetch_add(1, std::memory_order_relaxed);
+	counters[command_size].fetch_add(size, std::memory_order_relaxed);
+	counters[command_time].fetch_add(time, std::memory_order_relaxed);
+
+	current->histogram(cmd, cache ? 1 : 0)->buckets[latency_bucket(time)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void command_stats::stage_counter(const int stage, const uint64_t time)
+{
+	if (stage < 0 || stage >= __DNET_IO_STAGE_MAX)
+		return;
+
+	slab *current = thread_slab();
+
+	current->stages[stage].buckets[latency_bucket(time)].fetch_add(1, std::memory_order_relaxed);
+	current->stages_time[stage].fetch_add(time, std::memory_order_relaxed);
+}
+
+const char *io_stage_string(int stage)
+{
+	// indexed by enum dnet_io_stage
+	static const char *names[__DNET_IO_STAGE_MAX] = {
+		"queue",
+		"process",
+		"backend",
+		"send"
+	};
+
+	if (stage < 0 || stage >= __DNET_IO_STAGE_MAX)
+		return "unknown";
+
+	return names[stage];
+}
+
+static void latency_add(std::vector<uint64_t> &latencies, const latency_histogram *histogram)
+{
+	if (!histogram)
+		return;
+
+	if (latencies.empty())
+		latencies.resize(latency_buckets);
+
+	for (size_t i = 0; i < latencies.size(); ++i)
+		latencies[i] += histogram->buckets[i].load(std::memory_order_relaxed);
+}
+
+static void ext_counter_add(ext_counter &counter, const std::atomic<uint64_t> *counters)
+{
+	counter.counter.successes += counters[command_successes].load(std::memory_order_relaxed);
+	counter.counter.failures += counters[command_failures].load(std::memory_order_relaxed);
+	counter.size += counters[command_size].load(std::memory_order_relaxed);
+	counter.time += counters[command_time].load(std::memory_order_relaxed);
+}
+
+void command_stats::collect(std::vector<command_counters> &stats) const
+{
+	stats.resize(__DNET_CMD_MAX);
+
+	for (int i = 0; i < slabs_count; ++i) {
+		const slab *current = m_slabs[i].load(std::memory_order_acquire);
+		if (!current)
+			continue;
+
+		for (int cmd = 0; cmd < __DNET_CMD_MAX; ++cmd) {
+			ext_counter_add(stats[cmd].cache.outside, current->counters[cmd][1][1]);
+			ext_counter_add(stats[cmd].cache.internal, current->counters[cmd][1][0]);
+			ext_counter_add(stats[cmd].disk.outside, current->counters[cmd][0][1]);
+			ext_counter_add(stats[cmd].disk.internal, current->counters[cmd][0][0]);
+
+			latency_add(stats[cmd].cache.latencies, current->latencies[cmd][1].load(std::memory_order_acquire));
+			latency_add(stats[cmd].disk.latencies, current->latencies[cmd][0].load(std::memory_order_acquire));
+		}
+	}
+}
+
+void command_stats::collect_stages(std::vector<std::vector<uint64_t>> &latencies, std::vector<uint64_t> &times) const
+{
+	latencies.resize(__DNET_IO_STAGE_MAX);
+	times.resize(__DNET_IO_STAGE_MAX);
+
+	for (int i = 0; i < slabs_count; ++i) {
+		const slab *current = m_slabs[i].load(std::memory_order_acquire);
+		if (!current)
+			continue;
+
+		for (int stage = 0; stage < __DNET_IO_STAGE_MAX; ++stage) {
+			latency_add(latencies[stage], &current->stages[stage]);
+			times[stage] += current->stages_time[stage].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+uint64_t command_stats::disk_latency_percentile(double p, std::vector<uint64_t> &previous) const
+{
+	std::vector<command_counters> stats;
+	collect(stats);
+
+	std::vector<uint64_t> current(latency_buckets);
+	for (auto it = stats.begin(); it != stats.end(); ++it) {
+		for (size_t i = 0; i < it->disk.latencies.size(); ++i)
+			current[i] += it->disk.latencies[i];
+	}
+
+	previous.resize(latency_buckets);
+
+	std::vector<uint64_t> latencies(latency_buckets);
+	uint64_t total = 0;
+	for (size_t i = 0; i < latency_buckets; ++i) {
+		latencies[i] = current[i] >= previous[i] ? current[i] - previous[i] : 0;
+		total += latencies[i];
+	}
+
+	previous.swap(current);
 
-	++counter;
-	source.size += size;
-	source.time += time;
+	return total ? latency_percentile(latencies, total, p) : 0;
+}
+
+rapidjson::Value& command_stats::stages_report(rapidjson::Value &stat_value,
+		rapidjson::Document::AllocatorType &allocator) const {
+	std::vector<std::vector<uint64_t>> latencies;
+	std::vector<uint64_t> times;
+	collect_stages(latencies, times);
+
+	for (int stage = 0; stage < __DNET_IO_STAGE_MAX; ++stage) {
+		if (std::all_of(latencies[stage].begin(), latencies[stage].end(), [] (uint64_t count) { return count == 0; }))
+			continue;
+
+		rapidjson::Value stage_stat(rapidjson::kObjectType);
+		latency_stat_json(latencies[stage], stage_stat, allocator);
+		stage_stat.AddMember("time", times[stage], allocator);
+		stat_value.AddMember(io_stage_string(stage), stage_stat, allocator);
+	}
+
+	return stat_value;
 }
 
 rapidjson::Value& command_stats::commands_report(dnet_node *node, rapidjson::Value &stat_value,
 		rapidjson::Document::AllocatorType &allocator) const {
-	std::unique_lock<std::mutex> guard(m_cmd_stats_mutex);
-	std::vector<command_counters> tmp_stats = m_cmd_stats;
-	guard.unlock();
+	std::vector<command_counters> tmp_stats;
+	collect(tmp_stats);
 
 	for (int i = 1; i < __DNET_CMD_MAX; ++i) {
 		if (tmp_stats[i].has_data()) {
@@ -172,6 +564,180 @@ rapidjson::Value& command_stats::commands_report(dnet_node *node, rapidjson::Val
 	return stat_value;
 }
 
+/*
+ * OpenMetrics samples are formatted right into the output, samples of every family
+ * are written together after its TYPE and HELP lines. Command names and label values
+ * never contain characters which must be escaped.
+ */
+static void metric_family(std::string &out, const char *name, const char *type, const char *help)
+{
+	out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+	out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+}
+
+static void metric_labeled_sample(std::string &out, const char *name, const char *key, const char *key_value,
+		const char *labels, uint64_t value)
+{
+	char buffer[256];
+	int size = snprintf(buffer, sizeof(buffer), "%s{%s=\"%s\"%s} %llu\n",
+			name, key, key_value, labels, (unsigned long long)value);
+	if (size > 0)
+		out.append(buffer, std::min<size_t>(size, sizeof(buffer) - 1));
+}
+
+static void metric_sample(std::string &out, const char *name, const char *cmd, const char *labels, uint64_t value)
+{
+	metric_labeled_sample(out, name, "cmd", cmd, labels, value);
+}
+
+static void source_metrics(std::string &out, const char *name, const char *cmd, const char *source,
+		const source_counter &counter, int field)
+{
+	const struct {
+		const char		*name;
+		const ext_counter	*counter;
+	} origins[] = {
+		{"outside", &counter.outside},
+		{"internal", &counter.internal}
+	};
+	char labels[96];
+
+	for (size_t i = 0; i < sizeof(origins) / sizeof(origins[0]); ++i) {
+		const ext_counter &c = *origins[i].counter;
+		if (!c.has_data())
+			continue;
+
+		if (field == command_size || field == command_time) {
+			snprintf(labels, sizeof(labels), ",source=\"%s\",origin=\"%s\"", source, origins[i].name);
+			metric_sample(out, name, cmd, labels, field == command_size ? c.size : c.time);
+			continue;
+		}
+
+		snprintf(labels, sizeof(labels), ",source=\"%s\",origin=\"%s\",result=\"success\"",
+				source, origins[i].name);
+		metric_sample(out, name, cmd, labels, c.counter.successes);
+		snprintf(labels, sizeof(labels), ",source=\"%s\",origin=\"%s\",result=\"failure\"",
+				source, origins[i].name);
+		metric_sample(out, name, cmd, labels, c.counter.failures);
+	}
+}
+
+/*
+ * Only buckets which have ever counted a command are written, counts never decrease,
+ * so set of bucket bounds of every histogram only grows from scrape to scrape
+ */
+static void histogram_metrics(std::string &out, const char *name, const char *key, const char *key_value,
+		const char *labels, const std::vector<uint64_t> &latencies, uint64_t sum)
+{
+	const std::string bucket = std::string(name) + "_bucket";
+	uint64_t total = 0;
+	char bucket_labels[128];
+
+	if (latencies.empty())
+		return;
+
+	for (size_t i = 0; i + 1 < latencies.size(); ++i) {
+		if (!latencies[i])
+			continue;
+
+		total += latencies[i];
+		snprintf(bucket_labels, sizeof(bucket_labels), "%s,le=\"%llu\"",
+				labels, (unsigned long long)latency_bucket_lower(i + 1) - 1);
+		metric_labeled_sample(out, bucket.c_str(), key, key_value, bucket_labels, total);
+	}
+	total += latencies.back();
+
+	snprintf(bucket_labels, sizeof(bucket_labels), "%s,le=\"+Inf\"", labels);
+	metric_labeled_sample(out, bucket.c_str(), key, key_value, bucket_labels, total);
+
+	metric_labeled_sample(out, (std::string(name) + "_count").c_str(), key, key_value, labels, total);
+	metric_labeled_sample(out, (std::string(name) + "_sum").c_str(), key, key_value, labels, sum);
+}
+
+static void latency_metrics(std::string &out, const char *cmd, const char *source, const source_counter &counter)
+{
+	char labels[96];
+
+	snprintf(labels, sizeof(labels), ",source=\"%s\"", source);
+	histogram_metrics(out, "elliptics_command_latency_usecs", "cmd", cmd, labels, counter.latencies,
+			counter.outside.time + counter.internal.time);
+}
+
+static void node_metrics(std::string &out, const char *cmd, const char *target, const dnet_stat_count &counter)
+{
+	char labels[96];
+
+	if (counter.count == 0 && counter.err == 0)
+		return;
+
+	snprintf(labels, sizeof(labels), ",target=\"%s\",result=\"success\"", target);
+	metric_sample(out, "elliptics_node_commands_total", cmd, labels, counter.count);
+	snprintf(labels, sizeof(labels), ",target=\"%s\",result=\"failure\"", target);
+	metric_sample(out, "elliptics_node_commands_total", cmd, labels, counter.err);
+}
+
+void command_stats::commands_metrics(dnet_node *node, uint64_t families, std::string &out) const
+{
+	std::vector<command_counters> stats;
+
+	if (families & (metric_commands | metric_latencies))
+		collect(stats);
+
+	if (families & metric_commands) {
+		const struct {
+			const char	*family;
+			const char	*type;
+			const char	*help;
+			int		field;
+		} counters[] = {
+			{"elliptics_commands", "counter", "Commands executed by the node", command_successes},
+			{"elliptics_command_bytes", "counter", "Size of data processed by commands", command_size},
+			{"elliptics_command_time_usecs", "counter", "Time spent on commands execution", command_time}
+		};
+
+		for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); ++c) {
+			const std::string name = std::string(counters[c].family) + "_total";
+
+			metric_family(out, counters[c].family, counters[c].type, counters[c].help);
+			for (int i = 1; i < __DNET_CMD_MAX; ++i) {
+				source_metrics(out, name.c_str(), dnet_cmd_string(i), "cache", stats[i].cache, counters[c].field);
+				source_metrics(out, name.c_str(), dnet_cmd_string(i), "disk", stats[i].disk, counters[c].field);
+			}
+		}
+	}
+
+	if (families & metric_latencies) {
+		metric_family(out, "elliptics_command_latency_usecs", "histogram", "Latencies of commands execution");
+		for (int i = 1; i < __DNET_CMD_MAX; ++i) {
+			latency_metrics(out, dnet_cmd_string(i), "cache", stats[i].cache);
+			latency_metrics(out, dnet_cmd_string(i), "disk", stats[i].disk);
+		}
+	}
+
+	if (families & metric_stages) {
+		std::vector<std::vector<uint64_t>> latencies;
+		std::vector<uint64_t> times;
+		collect_stages(latencies, times);
+
+		metric_family(out, "elliptics_stage_latency_usecs", "histogram",
+				"Latencies of request processing stages: queue, process, backend and send");
+		for (int stage = 0; stage < __DNET_IO_STAGE_MAX; ++stage) {
+			if (std::all_of(latencies[stage].begin(), latencies[stage].end(), [] (uint64_t count) { return count == 0; }))
+				continue;
+
+			histogram_metrics(out, "elliptics_stage_latency_usecs", "stage", io_stage_string(stage), "",
+					latencies[stage], times[stage]);
+		}
+	}
+
+	if ((families & metric_node) && node) {
+		metric_family(out, "elliptics_node_commands", "counter", "Commands handled by the node as storage or proxy");
+		for (int i = 1; i < __DNET_CMD_MAX; ++i) {
+			node_metrics(out, dnet_cmd_string(i), "storage", node->counters[i]);
+			node_metrics(out, dnet_cmd_string(i), "proxy", node->counters[i + __DNET_CMD_MAX]);
+		}
+	}
+}
 
 void statistics::command_counter(const int cmd,
                                  const uint64_t trans,
@@ -183,14 +749,126 @@ void statistics::command_counter(const int cmd,
 	m_command_stats.command_counter(cmd, trans, err, cache, size, time);
 }
 
-statistics::statistics(monitor& mon, struct dnet_config *cfg) : m_monitor(mon)
+void statistics::stages_counter(const uint64_t *stages)
+{
+	for (int stage = 0; stage < __DNET_IO_STAGE_MAX; ++stage) {
+		if (stages[stage] != DNET_IO_STAGE_NONE)
+			m_command_stats.stage_counter(stage, stages[stage]);
+	}
+}
+
+statistics::statistics(monitor& mon, struct dnet_config *cfg)
+: m_monitor(mon)
+, m_report_cache_ms(0)
+, m_generation(0)
 {
 	(void) cfg;
 	const auto monitor_cfg = get_monitor_config(mon.node());
+	if (monitor_cfg)
+		m_report_cache_ms = monitor_cfg->report_cache_ms;
 	if (monitor_cfg && monitor_cfg->has_top) {
 		m_top_stats = std::make_shared<top_stats>(monitor_cfg->top_length,
-				monitor_cfg->events_size, monitor_cfg->period_in_seconds);
+				monitor_cfg->events_size, monitor_cfg->period_in_seconds,
+				monitor_cfg->top_sample_rate, monitor_cfg->top_sketch_size);
+	}
+	m_top_peers = monitor_cfg ? monitor_cfg->top_peers : DNET_DEFAULT_MONITOR_TOP_PEERS;
+	if (monitor_cfg && monitor_cfg->slow_threshold > 0 && monitor_cfg->slow_size > 0) {
+		m_slow_requests = std::make_shared<slow_requests>(monitor_cfg->slow_threshold,
+				monitor_cfg->slow_size);
+	}
+}
+
+void statistics::peers_report(const std::vector<peer_snapshot> &peers, rapidjson::Value &stat_value,
+                              rapidjson::Document::AllocatorType &allocator)
+{
+	struct peer_rate {
+		const peer_snapshot	*peer;
+		std::string		addr;
+		double			recv_rate;
+		double			send_rate;
+		double			ops_rate;
+	};
+
+	const auto now = std::chrono::steady_clock::now();
+	std::vector<peer_rate> rates;
+	rates.reserve(peers.size());
+
+	{
+		std::unique_lock<std::mutex> guard(m_peers_mutex);
+		std::map<std::string, peer_rate_point> current;
+
+		for (auto it = peers.begin(); it != peers.end(); ++it) {
+			peer_rate rate = {&*it, dnet_addr_string(&it->addr), 0, 0, 0};
+
+			auto previous = m_peers_previous.find(rate.addr);
+			if (previous != m_peers_previous.end()) {
+				const double seconds = std::chrono::duration<double>(now - previous->second.time).count();
+				// reconnected peer starts its counters from zero
+				auto delta = [] (uint64_t current, uint64_t previous) {
+					return current >= previous ? current - previous : current;
+				};
+
+				if (seconds > 0) {
+					rate.recv_rate = delta(it->peer.recv_bytes, previous->second.recv_bytes) / seconds;
+					rate.send_rate = delta(it->peer.send_bytes, previous->second.send_bytes) / seconds;
+					rate.ops_rate = delta(it->peer.ops, previous->second.ops) / seconds;
+				}
+			}
+
+			peer_rate_point &point = current[rate.addr];
+			point.time = now;
+			point.recv_bytes = it->peer.recv_bytes;
+			point.send_bytes = it->peer.send_bytes;
+			point.ops = it->peer.ops;
+
+			rates.emplace_back(std::move(rate));
+		}
+
+		// peers which have gone are forgotten
+		m_peers_previous.swap(current);
 	}
+
+	// until the second report rates are zero and peers are ordered by their total traffic
+	const size_t top = std::min(m_top_peers, rates.size());
+	std::partial_sort(rates.begin(), rates.begin() + top, rates.end(),
+		[] (const peer_rate &lhs, const peer_rate &rhs) {
+			const double lhs_rate = lhs.recv_rate + lhs.send_rate;
+			const double rhs_rate = rhs.recv_rate + rhs.send_rate;
+			if (lhs_rate != rhs_rate)
+				return lhs_rate > rhs_rate;
+			return lhs.peer->peer.recv_bytes + lhs.peer->peer.send_bytes >
+				rhs.peer->peer.recv_bytes + rhs.peer->peer.send_bytes;
+		});
+
+	rapidjson::Value top_stat(rapidjson::kArrayType);
+	for (size_t i = 0; i < top; ++i) {
+		const peer_snapshot &peer = *rates[i].peer;
+		rapidjson::Value peer_stat(rapidjson::kObjectType);
+
+		rapidjson::Value addr(rates[i].addr.c_str(), allocator);
+		peer_stat.AddMember("addr", addr, allocator);
+		peer_stat.AddMember("client", peer.client, allocator);
+		peer_stat.AddMember("recv_bytes", peer.peer.recv_bytes, allocator);
+		peer_stat.AddMember("send_bytes", peer.peer.send_bytes, allocator);
+		peer_stat.AddMember("ops", peer.peer.ops, allocator);
+		peer_stat.AddMember("inflight", peer.peer.inflight, allocator);
+		peer_stat.AddMember("recv_bytes_rate", rates[i].recv_rate, allocator);
+		peer_stat.AddMember("send_bytes_rate", rates[i].send_rate, allocator);
+		peer_stat.AddMember("ops_rate", rates[i].ops_rate, allocator);
+
+		rapidjson::Value latency_stat(rapidjson::kObjectType);
+		peer_latency_json(peer.peer, latency_stat, allocator);
+		peer_stat.AddMember("latency_usecs", latency_stat, allocator);
+
+		rapidjson::Value compression_stat(rapidjson::kObjectType);
+		peer_compression_json(peer, compression_stat, allocator);
+		peer_stat.AddMember("compression", compression_stat, allocator);
+
+		top_stat.PushBack(peer_stat, allocator);
+	}
+
+	stat_value.AddMember("count", peers.size(), allocator);
+	stat_value.AddMember("top", top_stat, allocator);
 }
 
 void statistics::add_provider(stat_provider *stat, const std::string &name)
@@ -203,6 +881,36 @@ void statistics::remove_provider(const std::string &name)
 {
 	std::unique_lock<std::mutex> guard(m_provider_mutex);
 	m_stat_providers.erase(name);
+
+	auto begin = m_provider_reports.lower_bound(std::make_pair(name, uint64_t(0)));
+	auto end = begin;
+	while (end != m_provider_reports.end() && end->first.first == name)
+		++end;
+	m_provider_reports.erase(begin, end);
+	m_reports.clear();
+}
+
+static bool cached_report_fresh(const cached_report &report, unsigned int cache_ms)
+{
+	return !report.json.empty() &&
+		std::chrono::steady_clock::now() - report.generated < std::chrono::milliseconds(cache_ms);
+}
+
+const cached_report &statistics::provider_json(const std::string &name, const stat_provider &provider,
+		uint64_t categories)
+{
+	cached_report &report = m_provider_reports[std::make_pair(name, categories)];
+	if (m_report_cache_ms && cached_report_fresh(report, m_report_cache_ms))
+		return report;
+
+	std::string json = provider.json(categories);
+	if (json != report.json || !report.generation) {
+		report.json = std::move(json);
+		report.generation = ++m_generation;
+	}
+	report.generated = std::chrono::steady_clock::now();
+
+	return report;
 }
 
 inline std::string convert_report(const rapidjson::Document &report)
@@ -213,10 +921,23 @@ inline std::string convert_report(const rapidjson::Document &report)
 	return compress(buffer.GetString());
 }
 
-std::string statistics::report(uint64_t categories)
+std::string statistics::report(uint64_t categories, uint64_t generation)
 {
+	/*
+	 * Complete reports are cached too, so repeated polls within staleness bound
+	 * do not even sum up commands counters or compress the report.
+	 * Delta reports depend on generation of the client and are always generated.
+	 */
+	if (m_report_cache_ms && !generation) {
+		std::unique_lock<std::mutex> guard(m_provider_mutex);
+		const cached_report &cached = m_reports[categories];
+		if (cached_report_fresh(cached, m_report_cache_ms))
+			return cached.json;
+	}
+
 	rapidjson::Document report;
-	dnet_log(m_monitor.node(), DNET_LOG_INFO, "monitor: collecting statistics for categories: %llx", (unsigned long long)categories);
+	dnet_log(m_monitor.node(), DNET_LOG_INFO, "monitor: collecting statistics for categories: %llx, generation: %llu",
+			(unsigned long long)categories, (unsigned long long)generation);
 	report.SetObject();
 	auto &allocator = report.GetAllocator();
 
@@ -235,10 +956,33 @@ std::string statistics::report(uint64_t categories)
 		rapidjson::Value commands_value(rapidjson::kObjectType);
 		m_command_stats.commands_report(m_monitor.node(), commands_value, allocator);
 
+		std::vector<peer_snapshot> peers;
+		collect_peers(m_monitor.node(), peers);
+
 		rapidjson::Value clients_stat(rapidjson::kObjectType);
-		clients_stat_json(m_monitor.node(), clients_stat, allocator);
+		clients_stat_json(peers, clients_stat, allocator);
 		commands_value.AddMember("clients", clients_stat, allocator);
 
+		rapidjson::Value peers_stat(rapidjson::kObjectType);
+		peers_report(peers, peers_stat, allocator);
+		commands_value.AddMember("peers", peers_stat, allocator);
+
+		if (m_monitor.node()->qos) {
+			rapidjson::Value qos_stat(rapidjson::kObjectType);
+			qos_stat_json(*m_monitor.node()->qos, qos_stat, allocator);
+			commands_value.AddMember("qos", qos_stat, allocator);
+		}
+
+		if (dnet_memory_enabled(m_monitor.node())) {
+			rapidjson::Value memory_stat(rapidjson::kObjectType);
+			memory_stat_json(m_monitor.node(), memory_stat, allocator);
+			commands_value.AddMember("memory", memory_stat, allocator);
+		}
+
+		rapidjson::Value stages_stat(rapidjson::kObjectType);
+		m_command_stats.stages_report(stages_stat, allocator);
+		commands_value.AddMember("stages", stages_stat, allocator);
+
 		report.AddMember("commands", commands_value, allocator);
 	}
 
@@ -253,21 +997,52 @@ std::string statistics::report(uint64_t categories)
 	}
 
 	std::unique_lock<std::mutex> guard(m_provider_mutex);
+	rapidjson::Value unchanged(rapidjson::kArrayType);
 	for (auto it = m_stat_providers.cbegin(), end = m_stat_providers.cend(); it != end; ++it) {
-		auto json = it->second->json(categories);
-		if (json.empty())
+		const cached_report &provider = provider_json(it->first, *it->second, categories);
+		if (provider.json.empty())
+			continue;
+
+		if (generation && provider.generation <= generation) {
+			unchanged.PushBack(it->first.c_str(), allocator);
 			continue;
+		}
+
 		rapidjson::Document value_doc(&allocator);
-		value_doc.Parse<0>(json.c_str());
+		value_doc.Parse<0>(provider.json.c_str());
 		report.AddMember(it->first.c_str(),
 		                 allocator,
 		                 static_cast<rapidjson::Value&>(value_doc),
 		                 allocator);
 	}
 
+	report.AddMember("generation", m_generation, allocator);
+	if (generation)
+		report.AddMember("unchanged_providers", unchanged, allocator);
+
 	dnet_log(m_monitor.node(), DNET_LOG_DEBUG,
 			"monitor: finished generating json statistics for categories: %llx", (unsigned long long)categories);
-	return convert_report(report);
+
+	std::string json = convert_report(report);
+	if (m_report_cache_ms && !generation) {
+		cached_report &cached = m_reports[categories];
+		cached.json = json;
+		cached.generated = std::chrono::steady_clock::now();
+	}
+
+	return json;
+}
+
+std::string statistics::metrics(uint64_t families)
+{
+	std::string metrics;
+
+	dnet_log(m_monitor.node(), DNET_LOG_INFO, "monitor: collecting metrics for families: %llx", (unsigned long long)families);
+
+	m_command_stats.commands_metrics(m_monitor.node(), families, metrics);
+	metrics.append("# EOF\n");
+
+	return metrics;
 }
 
 }} /* namespace ioremap::monitor */
@@ -25,10 +25,13 @@
 #else
 #  include <atomic>
 #endif
+#include <chrono>
 #include <mutex>
 #include <sstream>
 #include <thread>
 #include <map>
+#include <string>
+#include <vector>
 
 #include "rapidjson/document.h"
 
@@ -37,12 +40,35 @@
 #include "monitor.h"
 #include "stat_provider.hpp"
 #include "top.hpp"
+#include "slow_requests.hpp"
+
+#define DNET_DEFAULT_MONITOR_TOP_PEERS	16
 
 
 namespace ioremap { namespace monitor {
 
 class monitor;
 
+/*!
+ * \internal
+ *
+ * Metric families which can be selected in OpenMetrics exposition
+ */
+enum metric_families {
+	metric_commands		= 1 << 0,	// counters of commands executed by this node
+	metric_latencies	= 1 << 1,	// latency histograms of commands
+	metric_node		= 1 << 2,	// storage and proxy counters of the node
+	metric_stages		= 1 << 3,	// latency histograms of request processing stages
+	metric_all		= metric_commands | metric_latencies | metric_node | metric_stages
+};
+
+/*!
+ * \internal
+ *
+ * Returns name of request processing \a stage (enum dnet_io_stage)
+ */
+const char *io_stage_string(int stage);
+
 /*!
  * \internal
  *
@@ -110,6 +136,8 @@ struct ext_counter {
 struct source_counter {
 	ext_counter	outside;
 	ext_counter	internal;
+	// counts of latency histogram buckets, empty if there were no commands
+	std::vector<uint64_t>	latencies;
 
 	bool has_data() const {
 		return outside.has_data() || internal.has_data();
@@ -141,6 +169,10 @@ struct command_counters {
 class command_stats {
 public:
 	command_stats();
+	~command_stats();
+
+	command_stats(const command_stats &) = delete;
+	command_stats &operator =(const command_stats &) = delete;
 
 	/*!
 	 * Adds executed command properties to different command statistics
@@ -154,6 +186,17 @@ public:
 	void command_counter(const int cmd, const uint64_t trans, const int err, const int cache,
 	                     const uint64_t size, const unsigned long time);
 
+	/*!
+	 * Adds \a time in usecs spent by a request in \a stage (enum dnet_io_stage)
+	 */
+	void stage_counter(const int stage, const uint64_t time);
+
+	/*!
+	 * Fills \a stat_value by latency histograms of request processing stages and returns it
+	 */
+	rapidjson::Value& stages_report(rapidjson::Value &stat_value,
+	                                rapidjson::Document::AllocatorType &allocator) const;
+
 	/*!
 	 * Fills \a a stat_value by commands statistics and returns it
 	 * \a allocator - document allocator that is required by rapidjson
@@ -161,20 +204,91 @@ public:
 	rapidjson::Value& commands_report(dnet_node *node, rapidjson::Value &stat_value,
 	                                  rapidjson::Document::AllocatorType &allocator) const;
 
+	/*!
+	 * Appends OpenMetrics text samples of selected \a families to \a out
+	 * \a node - if set, its storage and proxy counters are appended too
+	 */
+	void commands_metrics(dnet_node *node, uint64_t families, std::string &out) const;
+
+	/*!
+	 * Returns \a p (0..1) percentile in usecs of commands executed not by cache since \a previous
+	 * histogram was taken, \a previous is replaced by the current one. Returns 0 if nothing was executed.
+	 */
+	uint64_t disk_latency_percentile(double p, std::vector<uint64_t> &previous) const;
+
 private:
+	enum { slabs_count = 16 };
+
+	/*!
+	 * \internal
+	 *
+	 * Sums up counters and histograms of all slabs into \a stats indexed by command
+	 */
+	void collect(std::vector<command_counters> &stats) const;
+
+	/*!
+	 * \internal
+	 *
+	 * Sums up stage histograms and total stage times of all slabs indexed by stage
+	 */
+	void collect_stages(std::vector<std::vector<uint64_t>> &latencies, std::vector<uint64_t> &times) const;
+
+	struct slab;
+
 	/*!
 	 * \internal
 	 *
-	 * Lock for controlling access to commands statistics
+	 * Returns slab of the calling thread, it is allocated by the first command of any its thread
 	 */
-	mutable std::mutex m_cmd_stats_mutex;
+	slab *thread_slab();
 
 	/*!
 	 * \internal
 	 *
-	 * Commands statistics
+	 * Commands statistics split by threads which update them, so counted commands
+	 * do not share locks or cache lines. Slabs are summed up only by report.
 	 */
-	std::vector<command_counters> m_cmd_stats;
+	std::atomic<slab *> m_slabs[slabs_count];
+};
+
+/*!
+ * \internal
+ *
+ * Generated json report or its part kept for serving repeated requests
+ */
+/*!
+ * \internal
+ *
+ * Counters of one peer copied from its state under \a state_lock,
+ * so json is built after the lock is released
+ */
+struct peer_snapshot {
+	dnet_addr		addr;
+	bool			client;
+	bool			wire_compression;
+	dnet_stat_count		stat[__DNET_CMD_MAX];
+	dnet_peer_stat		peer;
+};
+
+/*!
+ * \internal
+ *
+ * Totals of peer at the previous report which are used for rates calculation
+ */
+struct peer_rate_point {
+	std::chrono::steady_clock::time_point	time;
+	uint64_t				recv_bytes;
+	uint64_t				send_bytes;
+	uint64_t				ops;
+};
+
+struct cached_report {
+	std::string				json;
+	std::chrono::steady_clock::time_point	generated;
+	// generation of the last change of json
+	uint64_t				generation;
+
+	cached_report() : generation(0) {}
 };
 
 /*!
@@ -200,8 +314,18 @@ public:
 	 * Generates and returns json statistics for specified \a category
 	 * For that statistics will interview all external statistics provider
 	 * which supports \a categories
+	 * \a generation - if non zero, providers whose statistics has not been changed
+	 * since report of this generation are omitted and listed in "unchanged_providers"
+	 */
+	std::string report(uint64_t categories, uint64_t generation = 0);
+
+	/*!
+	 * \internal
+	 *
+	 * Generates and returns OpenMetrics text exposition of selected metric \a families,
+	 * it is written directly from the counters and is not compressed
 	 */
-	std::string report(uint64_t categories);
+	std::string metrics(uint64_t families);
 
 	/*!
 	 * \internal
@@ -217,6 +341,14 @@ public:
 	void command_counter(const int cmd, const uint64_t trans, const int err, const int cache,
 	                     const uint64_t size, const unsigned long time);
 
+	/*!
+	 * \internal
+	 *
+	 * Adds timings of request processing \a stages indexed by enum dnet_io_stage,
+	 * stages set to DNET_IO_STAGE_NONE are skipped
+	 */
+	void stages_counter(const uint64_t *stages);
+
 	/*!
 	 * \internal
 	 *
@@ -228,6 +360,11 @@ public:
 
 	typedef std::shared_ptr<top_stats> top_stats_ptr;
 	top_stats_ptr get_top_stats() const { return m_top_stats; }
+
+	typedef std::shared_ptr<slow_requests> slow_requests_ptr;
+	slow_requests_ptr get_slow_requests() const { return m_slow_requests; }
+	/* the same without reference counting, for per-request updates, lives as long as statistics */
+	slow_requests *get_slow_requests_raw() const { return m_slow_requests.get(); }
 private:
 	/*!
 	 * \internal
@@ -243,6 +380,15 @@ private:
 	rapidjson::Value& proc_stat(rapidjson::Value &stat_value,
 	                            rapidjson::Document::AllocatorType &allocator);
 
+	/*!
+	 * \internal
+	 *
+	 * Fills \a stat_value by traffic of \a m_top_peers peers with the highest byte rates
+	 * since the previous report
+	 */
+	void peers_report(const std::vector<peer_snapshot> &peers, rapidjson::Value &stat_value,
+	                  rapidjson::Document::AllocatorType &allocator);
+
 	/*!
 	 * \internal
 	 *
@@ -264,16 +410,72 @@ private:
 	 */
 	monitor &m_monitor;
 
+	/*!
+	 * \internal
+	 *
+	 * Returns cached json of provider \a name for \a categories,
+	 * it is regenerated if it is older than \a m_report_cache_ms
+	 * Must be called with \a m_provider_mutex held
+	 */
+	const struct cached_report &provider_json(const std::string &name, const stat_provider &provider,
+	                                          uint64_t categories);
+
 	/*!
 	 * \internal
 	 *
 	 * Lock for controlling access to vector of external statistics provider
+	 * and to cached reports
 	 */
 	std::mutex m_provider_mutex;
 
 	std::map<std::string, std::shared_ptr<stat_provider>> m_stat_providers;
 
+	/*!
+	 * \internal
+	 *
+	 * How long in milliseconds generated reports are served from the cache, 0 disables caching
+	 */
+	unsigned int m_report_cache_ms;
+
+	/*!
+	 * \internal
+	 *
+	 * Generation of the last change of any provider statistics, it is increased every time
+	 * regenerated statistics of a provider differs from the previous one
+	 */
+	uint64_t m_generation;
+
+	/*!
+	 * \internal
+	 *
+	 * Cached json of providers indexed by provider name and requested categories
+	 */
+	std::map<std::pair<std::string, uint64_t>, cached_report> m_provider_reports;
+
+	/*!
+	 * \internal
+	 *
+	 * Cached complete compressed reports indexed by requested categories
+	 */
+	std::map<uint64_t, cached_report> m_reports;
+
 	top_stats_ptr m_top_stats;
+	slow_requests_ptr m_slow_requests;
+
+	/*!
+	 * \internal
+	 *
+	 * Number of the heaviest peers put into the report
+	 */
+	size_t m_top_peers;
+
+	/*!
+	 * \internal
+	 *
+	 * Totals of peers at the previous report indexed by peer's address
+	 */
+	std::mutex m_peers_mutex;
+	std::map<std::string, peer_rate_point> m_peers_previous;
 };
 
 }} /* namespace ioremap::monitor */
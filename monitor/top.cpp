@@ -19,6 +19,8 @@
 
 #include "top.hpp"
 
+#include <atomic>
+
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -26,18 +28,85 @@
 
 namespace ioremap { namespace monitor {
 
-top_stats::top_stats(size_t top_length, size_t events_size, int period_in_seconds)
+top_stats::top_stats(size_t top_length, size_t events_size, int period_in_seconds,
+                     unsigned int sample_rate, size_t sketch_size)
 : m_stats(events_size, period_in_seconds),
  m_top_length(top_length),
- m_period_in_seconds(period_in_seconds)
-{}
+ m_period_in_seconds(period_in_seconds),
+ m_sample_rate(std::max(sample_rate, 1u))
+{
+	for (int i = 0; i < sketches_count; ++i)
+		m_sketches[i] = new sketch(std::max<size_t>(sketch_size, 1));
+}
+
+top_stats::~top_stats()
+{
+	for (int i = 0; i < sketches_count; ++i)
+		delete m_sketches[i];
+}
+
+/*
+ * Per-thread xorshift generator, so sampling neither locks nor aliases with access patterns
+ */
+static bool top_sampled(unsigned int sample_rate)
+{
+	static __thread uint32_t state = 0;
+
+	if (sample_rate <= 1)
+		return true;
+
+	if (!state)
+		state = (uint32_t)(uintptr_t)&state ^ (uint32_t)time(nullptr) ^ 0x9e3779b9;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state % sample_rate == 0;
+}
 
 void top_stats::update_stats(const struct dnet_cmd *cmd, uint64_t size)
 {
-	if (size > 0 && cmd->cmd == DNET_CMD_READ) {
-		key_stat_event event(cmd->id, size, 1., time(nullptr));
-		m_stats.add_event(event, event.get_time());
+	static std::atomic<int> next_slot(0);
+	static __thread int slot = -1;
+
+	if (size == 0 || cmd->cmd != DNET_CMD_READ || !top_sampled(m_sample_rate))
+		return;
+
+	if (slot < 0)
+		slot = next_slot.fetch_add(1, std::memory_order_relaxed) % sketches_count;
+
+	const time_t now = time(nullptr);
+	sketch &s = *m_sketches[slot];
+
+	{
+		std::unique_lock<std::mutex> guard(s.lock);
+		s.events.add(key_stat_event(cmd->id, size * m_sample_rate, m_sample_rate, now));
+		if (now == s.merged)
+			return;
 	}
+
+	merge(s);
+}
+
+void top_stats::merge(sketch &s)
+{
+	std::vector<key_stat_event> events;
+
+	{
+		std::unique_lock<std::mutex> guard(s.lock);
+		s.events.drain(events);
+		s.merged = time(nullptr);
+	}
+
+	for (auto it = events.begin(); it != events.end(); ++it)
+		m_stats.add_event(*it, it->get_time());
+}
+
+void top_stats::merge()
+{
+	for (int i = 0; i < sketches_count; ++i)
+		merge(*m_sketches[i]);
 }
 
 top_provider::top_provider(std::shared_ptr<top_stats> top_stats)
@@ -68,6 +137,8 @@ std::string top_provider::json(uint64_t categories) const {
 	doc.SetObject();
 	auto &allocator = doc.GetAllocator();
 
+	m_top_stats->merge();
+
 	std::vector<key_stat_event> top_size_keys;
 	auto& event_stats = m_top_stats->get_stats();
 	event_stats.get_top(m_top_stats->get_top_length(), time(nullptr), top_size_keys);
@@ -82,6 +153,7 @@ std::string top_provider::json(uint64_t categories) const {
 
 	doc.AddMember("top_result_limit", m_top_stats->get_top_length(), allocator);
 	doc.AddMember("period_in_seconds", m_top_stats->get_period(), allocator);
+	doc.AddMember("sample_rate", m_top_stats->get_sample_rate(), allocator);
 	doc.AddMember("top_by_size", stat_array, allocator);
 
 	rapidjson::StringBuffer buffer;
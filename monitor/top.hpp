@@ -40,6 +40,16 @@
  */
 #define DNET_DEFAULT_MONITOR_TOP_PERIOD 300
 
+/*
+ * Default sampling of reads for top keys statistics, 1 means every read is counted
+ */
+#define DNET_DEFAULT_MONITOR_TOP_SAMPLE_RATE 1
+
+/*
+ * Default number of keys kept by every per-thread heavy hitters sketch
+ */
+#define DNET_DEFAULT_MONITOR_TOP_SKETCH_SIZE 256
+
 namespace ioremap { namespace monitor {
 
 class key_stat_event;
@@ -105,22 +115,52 @@ private:
 	time_t		m_last_access;
 };
 
+/*!
+ * Top keys statistics: reads are counted in per-thread heavy hitters sketches,
+ * only every \a sample_rate read on average is counted with its size and frequency
+ * scaled by \a sample_rate. Sketches are merged into shared event_stats every second
+ * and before top keys are reported, so event_stats lock is not taken for every read.
+ */
 class top_stats {
 public:
-	top_stats(size_t top_length, size_t events_size, int period_in_seconds);
+	top_stats(size_t top_length, size_t events_size, int period_in_seconds,
+	          unsigned int sample_rate = DNET_DEFAULT_MONITOR_TOP_SAMPLE_RATE,
+	          size_t sketch_size = DNET_DEFAULT_MONITOR_TOP_SKETCH_SIZE);
+	~top_stats();
 
 	void update_stats(const struct dnet_cmd *cmd, uint64_t size);
 
+	/*!
+	 * Merges all per-thread sketches into event_stats
+	 */
+	void merge();
+
 	size_t get_top_length() const { return m_top_length; }
 	int get_period() const { return m_period_in_seconds; }
+	unsigned int get_sample_rate() const { return m_sample_rate; }
 
 	typedef event_stats<key_stat_event> event_stats_t;
 	event_stats_t& get_stats() { return m_stats; }
 
 private:
+	enum { sketches_count = 16 };
+
+	struct sketch {
+		std::mutex			lock;
+		heavy_hitters<key_stat_event>	events;
+		time_t				merged;
+
+		sketch(size_t size) : events(size), merged(0) {}
+	};
+
+	void merge(sketch &s);
+
 	event_stats_t m_stats;
 	const size_t m_top_length;
 	const int m_period_in_seconds;
+	const unsigned int m_sample_rate;
+	// sketches are split by threads the same way as command statistics slabs
+	sketch *m_sketches[sketches_count];
 };
 
 /*!
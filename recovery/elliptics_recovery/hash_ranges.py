@@ -0,0 +1,138 @@
+# =============================================================================
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# =============================================================================
+
+"""
+Top-down comparison of key ranges between replicas.
+
+Every replica summarizes requested ranges by hash iterator (elliptics.iterator_types.hash),
+which doesn't send keys but only a hash of (key, timestamp, size) of records in every range.
+Ranges with equal hashes on all replicas are dropped, differing ranges are split into
+smaller ones and compared again, so only keys of differing leaf ranges have to be iterated.
+"""
+
+import logging
+import struct
+import traceback
+
+import elliptics
+
+from .range import IdRange
+
+log = logging.getLogger(__name__)
+
+# offset of hash, keys and size in struct dnet_iterator_range_hash, they follow two 64-byte keys
+RANGE_HASH_FORMAT = '<QQQ'
+RANGE_HASH_OFFSET = 2 * 64
+
+
+def id_to_int(eid):
+    return int(''.join('{0:02x}'.format(b) for b in eid.id), 16)
+
+
+def split_range(rng, fanout):
+    """
+    Splits @rng into at most @fanout adjacent ranges which keep range_id of @rng
+    """
+    start = id_to_int(rng.start)
+    stop = id_to_int(rng.stop)
+    step = (stop - start) / fanout
+    if step == 0:
+        return [rng]
+
+    bounds = [start + i * step for i in xrange(fanout)] + [stop]
+    return [IdRange(elliptics.Id(bounds[i], 0), elliptics.Id(bounds[i + 1], 0), range_id=rng.range_id)
+            for i in xrange(fanout)]
+
+
+def range_hashes(session, eid, ranges, flags, timestamp_range):
+    """
+    Returns dict (start, stop) -> (hash, keys, size) computed by backend @eid for @ranges
+    """
+    rngs = sorted(ranges, key=lambda r: r.start)
+    records = session.start_iterator(eid,
+                                     [IdRange.elliptics_range(r.start, r.stop) for r in rngs],
+                                     elliptics.iterator_types.hash,
+                                     flags,
+                                     timestamp_range[0],
+                                     timestamp_range[1])
+    summaries = []
+    for record in records:
+        if record.status != 0:
+            raise RuntimeError("Hash iteration status check failed: {0}".format(record.status))
+        if record.response.status != 0:
+            continue
+        summaries.append(struct.unpack_from(RANGE_HASH_FORMAT, record.response_data, RANGE_HASH_OFFSET))
+
+    if len(summaries) != len(rngs):
+        raise RuntimeError("Hash iterator returned {0} ranges instead of {1}".format(len(summaries), len(rngs)))
+
+    # server replies in order of range start as they have been sent
+    return dict(((tuple(r.start), tuple(r.stop)), s) for r, s in zip(rngs, summaries))
+
+
+def filter_equal_ranges(ctx, node, address_ranges, flags, timestamp_range):
+    """
+    Takes dict (address, backend_id) -> [IdRange] and returns the same dict
+    with ranges which differ between replicas sharing the same range_id.
+    Ranges are not filtered if some replica failed to compute hashes.
+    """
+    result = dict((addr, []) for addr in address_ranges)
+    current = dict((addr, list(ranges)) for addr, ranges in address_ranges.iteritems())
+
+    for level in xrange(ctx.hash_depth + 1):
+        # (range_id, start, stop) -> [summary of every replica]
+        summaries = dict()
+        owners = dict()
+        for addr, ranges in current.iteritems():
+            if not ranges:
+                continue
+
+            try:
+                eid = ctx.routes.get_address_backend_route_id(addr[0], addr[1])
+                session = elliptics.Session(node)
+                session.groups = [eid.group_id]
+                session.trace_id = ctx.trace_id
+                hashes = range_hashes(session, eid, ranges, flags, timestamp_range)
+            except Exception as e:
+                log.error("Hash iteration on node: {0}/{1} failed: {2}, traceback: {3}"
+                          .format(addr[0], addr[1], repr(e), traceback.format_exc()))
+                hashes = dict()
+
+            for r in ranges:
+                key = (r.range_id, tuple(r.start), tuple(r.stop))
+                summaries.setdefault(key, []).append(hashes.get((tuple(r.start), tuple(r.stop))))
+                owners.setdefault(key, (r, []))[1].append(addr)
+
+        current = dict((addr, []) for addr in address_ranges)
+        equal = 0
+        for key, hashes in summaries.iteritems():
+            rng, addrs = owners[key]
+            if None not in hashes and len(set(hashes)) == 1:
+                equal += 1
+                continue
+
+            if level == ctx.hash_depth or None in hashes:
+                for addr in addrs:
+                    result[addr].append(rng)
+                continue
+
+            for sub in split_range(rng, ctx.hash_fanout):
+                for addr in addrs:
+                    current[addr].append(sub)
+
+        log.info("Hash level {0}: {1} of {2} ranges are equal on all replicas"
+                 .format(level, equal, len(summaries)))
+
+    for ranges in result.itervalues():
+        ranges.sort(key=lambda r: r.start)
+
+    return dict((addr, ranges) for addr, ranges in result.iteritems() if ranges)
@@ -18,6 +18,8 @@
 Wrappers for iterator and it's result container
 """
 
+import errno
+import json
 import logging
 import os
 
@@ -30,6 +32,9 @@ import time
 
 log = logging.getLogger(__name__)
 
+# status of iterator responses which carry checkpoint (DNET_ITERATOR_STATUS_CHECKPOINT)
+CHECKPOINT_STATUS = 2
+
 
 @logged_class
 class IteratorResult(object):
@@ -90,6 +95,13 @@ class IteratorResult(object):
         """Sorts results"""
         self.container.sort()
 
+    def sync(self):
+        """Flushes results to disk and returns size of the container file"""
+        if not self.__file:
+            return 0
+        os.fsync(self.__file.fileno())
+        return os.fstat(self.__file.fileno()).st_size
+
     def diff(self, other):
         """
         Computes diff between two sorted results. Returns container that consists of difference.
@@ -211,6 +223,21 @@ class IteratorResult(object):
         result.__file = container_file  # Save it from python's gc
         return result
 
+    @classmethod
+    def resume_filename(cls, filename, size, tmp_dir="", **kwargs):
+        """
+        Reopens container of interrupted iteration, records saved after its checkpoint are dropped
+        """
+        container_file = open(filename, 'r+')
+        container_file.truncate(size)
+        result = cls.from_info(container_file.fileno(),
+                               False,
+                               size,
+                               tmp_dir=tmp_dir,
+                               filename=filename, **kwargs)
+        result.__file = container_file  # Save it from python's gc
+        return result
+
     @classmethod
     def from_info(cls, fd, is_sorted, position, **kwargs):
         result = cls(**kwargs)
@@ -268,40 +295,67 @@ class Iterator(object):
               backend_id=0,
               group_id=0,
               leave_file=False,
-              batch_size=1024):
+              batch_size=1024,
+              resumable=False):
         assert flags & elliptics.iterator_flags.data == 0, "Only metadata iterator is supported for now"
         assert len(key_ranges) > 0, "There should be at least one iteration range."
         self.ranges = key_ranges
 
         try:
+            checkpoint_file = None
+            resume = None
+            if resumable:
+                checkpoint_file = os.path.join(tmp_dir, mk_container_name(address, backend_id, 'checkpoint_'))
+                resume = self._load_checkpoint(checkpoint_file, key_ranges, flags)
+                if resume:
+                    timestamp_range = tuple(elliptics.Time(*t) for t in resume['timestamp_range'])
+
             results = dict()
             if self.separately:
                 for range in key_ranges:
+                    # ranges split by hash comparison share range_id of their parent
+                    if range.range_id in results:
+                        continue
                     prefix = 'iterator_{0}_'.format(range.range_id)
                     filename = os.path.join(tmp_dir,
                                             mk_container_name(address=address,
                                                               backend_id=backend_id,
                                                               prefix=prefix))
-                    results[range.range_id] = IteratorResult.from_filename(filename=filename,
-                                                                           address=address,
-                                                                           backend_id=backend_id,
-                                                                           group_id=group_id,
-                                                                           tmp_dir=tmp_dir,
-                                                                           leave_file=leave_file)
+                    results[range.range_id] = self._open_result(resume,
+                                                                range.range_id,
+                                                                filename=filename,
+                                                                address=address,
+                                                                backend_id=backend_id,
+                                                                group_id=group_id,
+                                                                tmp_dir=tmp_dir,
+                                                                leave_file=leave_file)
             else:
                 filename = os.path.join(tmp_dir, mk_container_name(address, backend_id))
-                results[0] = IteratorResult.from_filename(filename=filename,
-                                                          address=address,
-                                                          backend_id=backend_id,
-                                                          group_id=group_id,
-                                                          tmp_dir=tmp_dir,
-                                                          leave_file=leave_file)
+                results[0] = self._open_result(resume,
+                                               0,
+                                               filename=filename,
+                                               address=address,
+                                               backend_id=backend_id,
+                                               group_id=group_id,
+                                               tmp_dir=tmp_dir,
+                                               leave_file=leave_file)
 
             ranges = [IdRange.elliptics_range(start, stop) for start, stop in key_ranges]
-            records = self._start_iterator(eid,
-                                           ranges,
-                                           flags,
-                                           timestamp_range)
+            if resumable:
+                if resume:
+                    self.log.info("Resuming iteration on node: {0}/{1} from checkpoint: {2}"
+                                  .format(address, backend_id, resume['checkpoint']))
+                records = self.session.start_resumable_iterator(eid,
+                                                                ranges,
+                                                                flags,
+                                                                timestamp_range[0],
+                                                                timestamp_range[1],
+                                                                resume['checkpoint'].decode('hex') if resume else '')
+            else:
+                records = self._start_iterator(eid,
+                                               ranges,
+                                               flags,
+                                               timestamp_range)
 
             iterated_keys = 0
             total_keys = 0
@@ -312,17 +366,28 @@ class Iterator(object):
                 end = time.time()
                 # TODO: Here we can add throttling
                 if record.status != 0:
+                    # checkpoint refers to removed or rewritten blob, next attempt will start over
+                    if resumable and record.status == -errno.ESTALE:
+                        self._remove_checkpoint(checkpoint_file)
                     raise RuntimeError("Iteration status check failed: {0}".format(record.status))
 
                 iterated_keys = record.response.iterated_keys
                 total_keys = record.response.total_keys
 
+                if resumable and record.response.status == CHECKPOINT_STATUS:
+                    self._save_checkpoint(checkpoint_file, key_ranges, flags, timestamp_range,
+                                          results, record.response_data)
+                    continue
+
                 if iterated_keys % batch_size == 0:
                     yield (iterated_keys, total_keys, start, end)
 
                 self._on_key_response(results, record)
             end = time.time()
 
+            if resumable:
+                self._remove_checkpoint(checkpoint_file)
+
             elapsed_time = records.elapsed_time()
             self.log.debug("Time spended for iterator: {0}/{1}".format(elapsed_time.tsec, elapsed_time.tnsec))
             yield (iterated_keys, total_keys, start, end)
@@ -343,6 +408,67 @@ class Iterator(object):
                                            timestamp_range[0],
                                            timestamp_range[1])
 
+    def _open_result(self, resume, range_id, filename, **kwargs):
+        if resume:
+            container = resume['containers'].get(str(range_id))
+            if container and container[0] == filename:
+                return IteratorResult.resume_filename(filename, container[1], **kwargs)
+        return IteratorResult.from_filename(filename=filename, **kwargs)
+
+    @staticmethod
+    def _checkpoint_ranges(key_ranges):
+        return [[list(r.start), list(r.stop), r.range_id] for r in key_ranges]
+
+    def _load_checkpoint(self, checkpoint_file, key_ranges, flags):
+        """
+        Returns state saved by interrupted iteration with the same ranges and flags or None
+        """
+        if not os.path.exists(checkpoint_file):
+            return None
+
+        try:
+            with open(checkpoint_file) as f:
+                state = json.load(f)
+            if state['ranges'] != self._checkpoint_ranges(key_ranges) or state['flags'] != flags:
+                self.log.info("Checkpoint {0} is made for another iteration, starting over".format(checkpoint_file))
+                return None
+            for filename, size in state['containers'].itervalues():
+                if not os.path.exists(filename) or os.path.getsize(filename) < size:
+                    self.log.info("Container {0} of checkpoint {1} is missing or truncated, starting over"
+                                  .format(filename, checkpoint_file))
+                    return None
+            return state
+        except Exception as e:
+            self.log.error("Can't load checkpoint: {0}: {1}, traceback: {2}"
+                           .format(checkpoint_file, repr(e), traceback.format_exc()))
+            return None
+
+    def _save_checkpoint(self, checkpoint_file, key_ranges, flags, timestamp_range, results, checkpoint):
+        """
+        Saves @checkpoint with sizes of containers, keys received before it are already in containers
+        """
+        state = {'ranges': self._checkpoint_ranges(key_ranges),
+                 'flags': flags,
+                 'timestamp_range': [(t.tsec, t.tnsec) for t in timestamp_range],
+                 'checkpoint': checkpoint.encode('hex'),
+                 'containers': dict((str(range_id), (result.filename, result.sync()))
+                                    for range_id, result in results.iteritems())}
+
+        # checkpoint is replaced atomically, interrupted save leaves the previous one
+        tmp_file = checkpoint_file + '.tmp'
+        with open(tmp_file, 'w') as f:
+            json.dump(state, f)
+            f.flush()
+            os.fsync(f.fileno())
+        os.rename(tmp_file, checkpoint_file)
+
+    def _remove_checkpoint(self, checkpoint_file):
+        try:
+            os.unlink(checkpoint_file)
+        except OSError as e:
+            if e.errno != errno.ENOENT:
+                raise
+
     def _on_key_response(self, results, record):
         if record.response.status == 0:
             self._save_record(results, record)
@@ -352,7 +478,7 @@ class Iterator(object):
 
     def iterate_with_stats(self, eid, timestamp_range,
                            key_ranges, tmp_dir, address, group_id, backend_id, batch_size,
-                           stats, flags, leave_file=False):
+                           stats, flags, leave_file=False, resumable=False):
         result = self.start(eid=eid,
                             flags=flags,
                             key_ranges=key_ranges,
@@ -362,7 +488,8 @@ class Iterator(object):
                             backend_id=backend_id,
                             group_id=group_id,
                             leave_file=leave_file,
-                            batch_size=batch_size,)
+                            batch_size=batch_size,
+                            resumable=resumable)
         result_len = 0
         for it in result:
             if it is None:
@@ -43,13 +43,17 @@ TYPE_MERGE = 'merge'
 TYPE_DC = 'dc'
 ALLOWED_TYPES = (TYPE_MERGE, TYPE_DC)
 
-TMP_FILE_PREFIXES = ['iterator_', 'diff_', 'merge', 'stat']
+TMP_FILE_PREFIXES = ['iterator_', 'checkpoint_', 'diff_', 'merge', 'stat']
+# containers of interrupted iterations and their checkpoints are kept for --resume
+RESUME_FILE_PREFIXES = ['iterator_', 'checkpoint_']
 
 
-def cleanup(path):
+def cleanup(path, resume=False):
     for file_name in os.listdir(path):
         if not os.path.isfile(file_name):
             continue
+        if resume and any(file_name.startswith(prefix) for prefix in RESUME_FILE_PREFIXES):
+            continue
         for prefix in TMP_FILE_PREFIXES:
             if file_name.startswith(prefix):
                 log.debug("Cleanup: removing stale file: {0}".format(file_name))
@@ -94,6 +98,7 @@ def main(options, args):
     ctx.custom_recover = options.custom_recover
     ctx.no_meta = options.no_meta and (options.timestamp is None)
     ctx.no_server_send = options.no_server_send
+    ctx.resume = options.resume
     ctx.user_flags_set = frozenset(int(user_flags) for user_flags in options.user_flags_set)
 
     try:
@@ -234,6 +239,17 @@ def main(options, args):
                          .format(options.batch_size, repr(e), traceback.format_exc()))
     log.info("Using batch_size: {0}".format(ctx.batch_size))
 
+    try:
+        ctx.hash_depth = int(options.hash_depth)
+        ctx.hash_fanout = int(options.hash_fanout)
+        if ctx.hash_depth < 0 or ctx.hash_fanout < 2:
+            raise ValueError("Hash depth should be non-negative and fanout should be at least 2: {0}/{1}"
+                             .format(ctx.hash_depth, ctx.hash_fanout))
+    except Exception as e:
+        raise ValueError("Can't parse hash depth/fanout: '{0}/{1}': {2}, traceback: {3}"
+                         .format(options.hash_depth, options.hash_fanout, repr(e), traceback.format_exc()))
+    log.info("Using hash depth: {0}, fanout: {1}".format(ctx.hash_depth, ctx.hash_fanout))
+
     try:
         ctx.nprocess = int(options.nprocess)
         if ctx.nprocess <= 0:
@@ -288,7 +304,7 @@ def main(options, args):
 
     try:
         log.info("Starting cleanup...")
-        cleanup(ctx.tmp_dir)
+        cleanup(ctx.tmp_dir, ctx.resume)
     except Exception as e:
         log.error("Cleanup failed: {0}, traceback: {1}"
                   .format(repr(e), traceback.format_exc()))
@@ -415,6 +431,16 @@ def run(args=None):
                       help='Marks all recovery commands by trace_id at both recovery and server logs. This option accepts hex strings. [default: %default]')
     parser.add_option('-U', '--no-server-send', action="store", dest="no_server_send", default=False,
                       help='Do not use server-send for recovery. Disabling recovery via server-send useful if there is no network connection between groups')
+    parser.add_option('--hash-depth', action='store', dest='hash_depth', default='2',
+                      help='Number of levels of range splitting by dc recovery, which compares hashes of ranges '
+                      'between replicas and iterates keys only in differing ranges, 0 disables comparison '
+                      '[default: %default]')
+    parser.add_option('--hash-fanout', action='store', dest='hash_fanout', default='16',
+                      help='Number of parts differing range is split into at every hash level [default: %default]')
+    parser.add_option('--resume', action='store_true', dest='resume', default=False,
+                      help='Iterator of dc recovery periodically saves checkpoints into tmp directory, '
+                      'interrupted iterations are continued from them by the next run with this option '
+                      '[default: %default]')
     parser.add_option('--user-flags', action='append', dest='user_flags_set', default=[],
                       help='Recover key if at least one replica has user_flags from specified user_flags_set')
     return main(*parser.parse_args(args))
@@ -20,6 +20,7 @@ from ..range import IdRange
 from ..etime import Time
 from ..iterator import Iterator, MergeData, IteratorResult
 from ..dc_recovery import recover
+from ..hash_ranges import filter_equal_ranges
 
 import os
 import traceback
@@ -29,6 +30,16 @@ import elliptics
 log = logging.getLogger(__name__)
 
 
+def iterator_flags(ctx):
+    flags = elliptics.iterator_flags.key_range
+    timestamp_range = ctx.timestamp.to_etime(), Time.time_max().to_etime()
+    if ctx.no_meta:
+        flags |= elliptics.iterator_flags.no_meta
+    else:
+        flags |= elliptics.iterator_flags.ts_range
+    return flags, timestamp_range
+
+
 def iterate_node(arg):
     ctx, address, backend_id, ranges = arg
     elog = elliptics.Logger(ctx.log_file, int(ctx.log_level))
@@ -49,12 +60,7 @@ def iterate_node(arg):
                                  io_thread_num=1)
 
     try:
-        flags = elliptics.iterator_flags.key_range
-        timestamp_range = ctx.timestamp.to_etime(), Time.time_max().to_etime()
-        if ctx.no_meta:
-            flags |= elliptics.iterator_flags.no_meta
-        else:
-            flags |= elliptics.iterator_flags.ts_range
+        flags, timestamp_range = iterator_flags(ctx)
 
         log.debug("Running iterator on node: {0}/{1}".format(address, backend_id))
         iterator = Iterator(node, node_id.group_id, separately=True, trace_id=ctx.trace_id)
@@ -69,7 +75,8 @@ def iterate_node(arg):
             batch_size=ctx.batch_size,
             stats=stats,
             flags=flags,
-            leave_file=True)
+            leave_file=True,
+            resumable=ctx.resume)
         if results is None or results_len == 0:
             return None
 
@@ -322,6 +329,19 @@ def main(ctx):
     log.debug("Ranges: {0}".format(ranges))
     results = None
 
+    if ctx.hash_depth:
+        ctx.stats.timer('main', 'hash_ranges')
+        log.info("Comparing range hashes of {0} nodes".format(len(ranges)))
+        node = elliptics_create_node(address=ctx.address,
+                                     elog=elliptics.Logger(ctx.log_file, int(ctx.log_level)),
+                                     wait_timeout=ctx.wait_timeout,
+                                     net_thread_num=4,
+                                     io_thread_num=1,
+                                     remotes=ctx.remotes)
+        flags, timestamp_range = iterator_flags(ctx)
+        ranges = filter_equal_ranges(ctx, node, ranges, flags, timestamp_range)
+        log.debug("Differing ranges: {0}".format(ranges))
+
     try:
         ctx.stats.timer('main', 'iterating')
         log.info("Start iterating {0} nodes in the pool".format(len(ranges)))
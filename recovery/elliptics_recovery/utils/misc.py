@@ -78,7 +78,8 @@ def elliptics_create_session(node=None, group=None, cflags=elliptics.command_fla
     log.debug("Creating session: {0}@{1}.{2}".format(node, group, cflags))
     session = elliptics.Session(node)
     session.groups = [group]
-    session.cflags = cflags
+    # recovery must not steal io pool capacity from frontend requests
+    session.cflags = cflags | elliptics.command_flags.background
     session.trace_id = trace_id
     return session
 
@@ -28,7 +28,10 @@
 
 #ifdef HAVE_COCAINE_SUPPORT
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include <functional>
@@ -68,6 +71,119 @@ struct sph_wrapper
 	}
 };
 
+namespace {
+
+/*
+ * Reducers of broadcast execs, registered ones can not be removed
+ */
+typedef std::map<std::string, dnet_exec_reducer> reducers_map_t;
+
+static int reduce_join(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size,
+		const std::string &separator)
+{
+	std::string joined;
+	for (int i = 0; i < num; ++i) {
+		if (i)
+			joined += separator;
+		joined.append((const char *)parts[i].data, parts[i].size);
+	}
+
+	*size = joined.size();
+	*result = malloc(joined.size() + 1);
+	if (!*result)
+		return -ENOMEM;
+
+	memcpy(*result, joined.data(), joined.size());
+	return 0;
+}
+
+static int reduce_concat(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size)
+{
+	return reduce_join(parts, num, result, size, std::string());
+}
+
+static int reduce_lines(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size)
+{
+	return reduce_join(parts, num, result, size, "\n");
+}
+
+/*
+ * Combines decimal integers by @op, empty parts are skipped
+ */
+template <typename Op>
+static int reduce_numbers(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size, Op op)
+{
+	bool found = false;
+	long long value = 0;
+
+	for (int i = 0; i < num; ++i) {
+		if (!parts[i].size)
+			continue;
+
+		const std::string text((const char *)parts[i].data, parts[i].size);
+		char *end;
+
+		errno = 0;
+		const long long part = strtoll(text.c_str(), &end, 10);
+		while (*end && isspace(*end))
+			++end;
+		if (errno || end == text.c_str() || *end)
+			return -EINVAL;
+
+		value = found ? op(value, part) : part;
+		found = true;
+	}
+
+	const std::string reply = found ? std::to_string(value) : std::string();
+	const struct dnet_exec_partial part = { reply.data(), reply.size() };
+	return reduce_join(&part, 1, result, size, std::string());
+}
+
+static int reduce_sum(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size)
+{
+	return reduce_numbers(parts, num, result, size, [] (long long a, long long b) { return a + b; });
+}
+
+static int reduce_min(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size)
+{
+	return reduce_numbers(parts, num, result, size, [] (long long a, long long b) { return std::min(a, b); });
+}
+
+static int reduce_max(const struct dnet_exec_partial *parts, int num, void **result, uint64_t *size)
+{
+	return reduce_numbers(parts, num, result, size, [] (long long a, long long b) { return std::max(a, b); });
+}
+
+struct reducers_registry {
+	std::mutex	lock;
+	reducers_map_t	reducers;
+
+	reducers_registry() {
+		reducers["concat"] = reduce_concat;
+		reducers["lines"] = reduce_lines;
+		reducers["sum"] = reduce_sum;
+		reducers["min"] = reduce_min;
+		reducers["max"] = reduce_max;
+	}
+};
+
+static reducers_registry &get_reducers()
+{
+	static reducers_registry registry;
+	return registry;
+}
+
+static dnet_exec_reducer find_reducer(const std::string &name)
+{
+	reducers_registry &registry = get_reducers();
+
+	std::lock_guard<std::mutex> guard(registry.lock);
+	auto it = registry.reducers.find(name);
+	return it != registry.reducers.end() ? it->second : NULL;
+}
+
+}
+
 /**
  * This class handles reply stream from worker.
  * Function write() accepts string from worker and sends it to the client
@@ -77,19 +193,25 @@ struct sph_wrapper
  *  - do some useful job
  *  - send reply via response stream
  * Chunked replies are allowed by protocol.
+ *
+ * Replies of jobs started by broadcast exec are not sent but collected,
+ * collector gets all of them at once when the job completes.
  */
 class dnet_upstream_t: public cocaine::api::stream_t
 {
 	public:
+		typedef std::function<void (int err, std::string &&data)> collector_t;
+
 		dnet_upstream_t(struct dnet_node *node, struct dnet_net_state *state, struct dnet_cmd *cmd,
-				const sph_wrapper &sph, std::function<void()> deleter):
+				const sph_wrapper &sph, std::function<void()> deleter, collector_t collector = collector_t()):
 		m_completed(false),
 		m_node(node),
 		m_state(dnet_state_get(state)),
 		m_cmd(*cmd),
 		m_sph(sph),
 		m_deleter(deleter),
-		m_error(0) {
+		m_error(0),
+		m_collector(collector) {
 		}
 
 		~dnet_upstream_t() {
@@ -123,22 +245,19 @@ class dnet_upstream_t: public cocaine::api::stream_t
 				return;
 			}
 
-			/* Make SPH reply for client */
-			size_t data_size = sizeof(sph) +  m_sph.event.size() + obj.via.raw.size;
-			ioremap::elliptics::data_buffer data(data_size);
-
-			data.write(&m_sph.sph, sizeof(sph));
-			data.write(m_sph.event.data(), m_sph.event.size());
-			data.write(obj.via.raw.ptr, obj.via.raw.size);
-
-			/* Fix SPH sizes */
-			ioremap::elliptics::data_pointer data_ptr(std::move(data));
+			/*
+			 * Make SPH reply for client, worker's data is copied only once
+			 * right into the send queue after SPH header and event
+			 */
+			std::string header(sizeof(struct sph) + m_sph.event.size(), '\0');
 
-			sph * sph_p = (sph*)(data_ptr.data());
+			sph *sph_p = (sph *)&header[0];
+			*sph_p = m_sph.sph;
 			sph_p->event_size = m_sph.event.size();
 			sph_p->data_size = obj.via.raw.size;
+			memcpy(sph_p + 1, m_sph.event.data(), m_sph.event.size());
 
-			reply(false, data_ptr.data<const char>(), data_ptr.size());
+			reply(false, header.data(), header.size(), obj.via.raw.ptr, obj.via.raw.size);
 		}
 
 		virtual void close(void) {
@@ -153,17 +272,38 @@ class dnet_upstream_t: public cocaine::api::stream_t
 		}
 
 		void reply(bool completed, const char *reply, size_t size) {
+			this->reply(completed, reply, size, NULL, 0);
+		}
+
+		/*
+		 * Sends @reply followed by @data as a single reply packet
+		 */
+		void reply(bool completed, const char *reply, size_t size, const char *data, size_t data_size) {
 			std::unique_lock<std::mutex> guard(m_lock);
 			if (m_completed)
 				return;
 
 			m_completed = completed;
 
+			if (m_collector) {
+				if (data && data_size)
+					m_collected.append(data, data_size);
+				if (!completed)
+					return;
+
+				collector_t collector;
+				std::swap(collector, m_collector);
+				guard.unlock();
+
+				collector(m_error, std::move(m_collected));
+				return;
+			}
+
 			if ((m_sph.sph.flags & DNET_SPH_FLAGS_SRC_BLOCK) || (reply && size)) {
 				if (reply && size) {
 					if (completed)
 						m_cmd.flags &= ~DNET_FLAGS_NEED_ACK;
-					dnet_send_reply(m_state, &m_cmd, (void *)reply, size, !completed);
+					dnet_send_reply_split(m_state, &m_cmd, reply, size, data, data_size, !completed);
 				} else if (completed) {
 					m_cmd.flags |= DNET_FLAGS_NEED_ACK;
 					dnet_send_ack(m_state, &m_cmd, m_error, 0);
@@ -181,8 +321,148 @@ class dnet_upstream_t: public cocaine::api::stream_t
 		std::function<void()> m_deleter;
 		int m_error;
 		msgpack::zone m_zone;
+		collector_t m_collector;
+		std::string m_collected;
+};
+
+/*
+ * Broadcast exec processed by this node: waits for the local job and for every subtree
+ * it has been forwarded to, combines their results by reducer and replies once
+ */
+class broadcast_job
+{
+	public:
+		broadcast_job(struct dnet_node *node, struct dnet_net_state *state, struct dnet_cmd *cmd,
+				const struct sph *sph, const std::string &event, dnet_exec_reducer reducer, int pending):
+		m_node(node),
+		m_state(dnet_state_get(state)),
+		m_cmd(*cmd),
+		m_sph(*sph),
+		m_event(event),
+		m_reducer(reducer),
+		m_pending(pending),
+		m_nodes(0),
+		m_status(0) {
+		}
+
+		~broadcast_job() {
+			dnet_state_put(m_state);
+		}
+
+		/*
+		 * Adds result of @nodes nodes, failed part has zero @nodes
+		 */
+		void complete(int err, std::string &&data, int nodes) {
+			std::unique_lock<std::mutex> guard(m_lock);
+
+			if (nodes > 0) {
+				m_parts.emplace_back(std::move(data));
+				m_nodes += nodes;
+			}
+			if (err && !m_status)
+				m_status = err;
+
+			if (--m_pending)
+				return;
+
+			guard.unlock();
+			finish();
+		}
+
+	private:
+		struct dnet_node *m_node;
+		struct dnet_net_state *m_state;
+		struct dnet_cmd m_cmd;
+		struct sph m_sph;
+		std::string m_event;
+		dnet_exec_reducer m_reducer;
+
+		std::mutex m_lock;
+		int m_pending;
+		int m_nodes;
+		int m_status;
+		std::vector<std::string> m_parts;
+
+		void finish() {
+			std::vector<struct dnet_exec_partial> parts;
+			parts.reserve(m_parts.size());
+			for (auto it = m_parts.begin(); it != m_parts.end(); ++it)
+				parts.push_back(dnet_exec_partial{it->data(), it->size()});
+
+			void *result = NULL;
+			uint64_t size = 0;
+			int err = m_reducer(parts.data(), parts.size(), &result, &size);
+			if (err) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: broadcast: reducer failed to combine %zu parts: %d",
+						dnet_dump_id(&m_cmd.id), m_event.c_str(), parts.size(), err);
+				m_status = err;
+				size = 0;
+			}
+
+			std::string header(sizeof(struct sph) + m_event.size(), '\0');
+
+			struct sph *reply = (struct sph *)&header[0];
+			*reply = m_sph;
+			reply->flags |= DNET_SPH_FLAGS_FINISH;
+			reply->event_size = m_event.size();
+			reply->data_size = size;
+			reply->status = m_status;
+			reply->broadcast_nodes = err ? 0 : m_nodes;
+			memcpy(&reply->addr, &m_node->addrs[0], sizeof(struct dnet_addr));
+			memcpy(reply + 1, m_event.data(), m_event.size());
+
+			m_cmd.flags |= DNET_FLAGS_NEED_ACK;
+			dnet_send_reply_split(m_state, &m_cmd, header.data(), header.size(), (const char *)result, size, 1);
+			dnet_send_ack(m_state, &m_cmd, reply->broadcast_nodes ? 0 : (m_status ? m_status : -ENOENT), 0);
+
+			dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: broadcast: completed: nodes: %d, size: %llu, status: %d",
+					dnet_dump_id(&m_cmd.id), m_event.c_str(), reply->broadcast_nodes,
+					(unsigned long long)size, m_status);
+
+			free(result);
+		}
+};
+
+/*
+ * Subtree broadcast exec has been forwarded to, it replies once with results of all its nodes
+ */
+struct broadcast_child
+{
+	std::shared_ptr<broadcast_job> job;
+	std::string data;
+	int nodes;
+	int status;
+
+	broadcast_child(const std::shared_ptr<broadcast_job> &job) : job(job), nodes(0), status(0) {
+	}
 };
 
+static int broadcast_child_complete(struct dnet_addr *addr __attribute__ ((unused)), struct dnet_cmd *cmd, void *priv)
+{
+	broadcast_child *child = (broadcast_child *)priv;
+
+	if (is_trans_destroyed(cmd)) {
+		const int err = cmd ? cmd->status : -ECONNRESET;
+
+		child->job->complete(child->status ? child->status : err, std::move(child->data), child->nodes);
+		delete child;
+		return 0;
+	}
+
+	if (cmd->size >= sizeof(struct sph)) {
+		const struct sph *reply = (const struct sph *)(cmd + 1);
+
+		if (cmd->size == sizeof(struct sph) + reply->event_size + reply->data_size) {
+			child->data.append((const char *)(reply + 1) + reply->event_size, reply->data_size);
+			child->nodes += reply->broadcast_nodes;
+			if (reply->status && !child->status)
+				child->status = reply->status;
+		}
+	}
+
+	return 0;
+}
+
 typedef std::shared_ptr<dnet_upstream_t> dnet_shared_upstream_t;
 typedef std::map<int, dnet_shared_upstream_t> jobs_map_t;
 
@@ -232,6 +512,7 @@ class dnet_app_t : public cocaine::app_t {
 		Json::Value counters(void) {
 			Json::Value info(Json::objectValue);
 
+			std::unique_lock<std::mutex> guard(m_lock);
 			for (auto it = m_counters.begin(); it != m_counters.end(); ++it) {
 				Json::Value obj(Json::objectValue);
 
@@ -289,6 +570,8 @@ class dnet_app_t : public cocaine::app_t {
 };
 
 typedef std::map<std::string, std::shared_ptr<dnet_app_t> > eng_map_t;
+/* applications are looked up by every event, the table is replaced as a whole when task starts or stops */
+typedef std::shared_ptr<const eng_map_t> eng_map_ptr_t;
 
 namespace {
 
@@ -347,7 +630,8 @@ class srw {
 	public:
 		srw(struct dnet_node *n, const std::string &config) :
 		m_node(n),
-		m_ctx(config, blackhole::utils::make_unique<dnet_sink_t>(m_node))
+		m_ctx(config, blackhole::utils::make_unique<dnet_sink_t>(m_node)),
+		m_map(std::make_shared<eng_map_t>())
 		{
 			atomic_set(&m_src_key, 1);
 
@@ -390,8 +674,7 @@ class srw {
 
 			if ((ev == "start-task") || (ev == "start-multiple-task")) {
 				std::unique_lock<std::mutex> guard(m_lock);
-				eng_map_t::iterator it = m_map.find(app);
-				if (it == m_map.end()) {
+				if (!find_app(app)) {
 					std::shared_ptr<dnet_app_t> eng(new dnet_app_t(m_ctx, app, app));
 					eng->start();
 
@@ -424,7 +707,9 @@ class srw {
 						}
 					}
 
-					m_map.insert(std::make_pair(app, eng));
+					std::shared_ptr<eng_map_t> apps = std::make_shared<eng_map_t>(*apps_snapshot());
+					apps->insert(std::make_pair(app, eng));
+					std::atomic_store(&m_map, eng_map_ptr_t(apps));
 					dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: started", id_str, sph_str, event.c_str());
 				} else {
 					dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: was already started",
@@ -433,26 +718,23 @@ class srw {
 
 			} else if (ev == "stop-task") {
 				std::unique_lock<std::mutex> guard(m_lock);
-				eng_map_t::iterator it = m_map.find(app);
-				/* destructor stops engine */
-				if (it != m_map.end())
-					m_map.erase(it);
+				std::shared_ptr<eng_map_t> apps = std::make_shared<eng_map_t>(*apps_snapshot());
+				/* destructor stops engine when the last event which has found it in the old table completes */
+				if (apps->erase(app))
+					std::atomic_store(&m_map, eng_map_ptr_t(apps));
 				guard.unlock();
 
 				dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: stopped", id_str, sph_str, event.c_str());
 
 			} else if (ev == "info") {
-				std::unique_lock<std::mutex> guard(m_lock);
-				eng_map_t::iterator it = m_map.find(app);
-				if (it == m_map.end()) {
+				std::shared_ptr<dnet_app_t> eng = find_app(app);
+				if (!eng) {
 					dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: no task", id_str, sph_str, event.c_str());
 					return -ENOENT;
 				}
 
-				Json::Value info = it->second->info();
-				info["counters"] = it->second->counters();
-
-				guard.unlock();
+				Json::Value info = eng->info();
+				info["counters"] = eng->counters();
 
 				std::string s = Json::StyledWriter().write(info);
 
@@ -469,13 +751,16 @@ class srw {
 				tmp += event;
 				tmp += s;
 
-				err = dnet_send_reply(st, cmd, (void *)tmp.data(), tmp.size(), 0);
+				/* reply is handed over to send queue instead of being copied */
+				std::string *holder = new std::string(std::move(tmp));
+				err = dnet_send_reply_ref(st, cmd, holder->data(), holder->size(),
+						[] (void *priv) { delete static_cast<std::string *>(priv); }, holder, 0);
 				dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: info request complete", id_str, sph_str, event.c_str());
 
 			} else if (sph->flags & (DNET_SPH_FLAGS_REPLY | DNET_SPH_FLAGS_FINISH)) {
 				bool final = !!(sph->flags & DNET_SPH_FLAGS_FINISH);
 
-				std::unique_lock<std::mutex> guard(m_lock);
+				std::unique_lock<std::mutex> guard(m_jobs_lock);
 
 				jobs_map_t::iterator it = m_jobs.find(sph->src_key);
 				if (it == m_jobs.end()) {
@@ -488,98 +773,298 @@ class srw {
 				if (final)
 					m_jobs.erase(it);
 
-				eng_map_t::iterator appit = m_map.find(app);
-				if (appit != m_map.end())
-					appit->second->update(event, sph);
-
 				guard.unlock();
 
-				upstream->reply(final, (char *)sph, sizeof(struct sph) + sph->event_size + sph->data_size);
+				std::shared_ptr<dnet_app_t> eng = find_app(app);
+				if (eng)
+					eng->update(event, sph);
+
+				upstream->reply(final, (char *)sph, sizeof(struct sph) + sph->event_size,
+						data + sph->event_size, sph->data_size);
 
 				memcpy(&sph->addr, &st->n->addrs[0], sizeof(struct dnet_addr));
 				dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: completed: job: %d, total-size: %zd, finish: %d",
 						id_str, sph_str, event.c_str(), sph->src_key, total_size(sph), final);
 
+			} else if (sph->flags & DNET_SPH_FLAGS_BROADCAST) {
+				err = broadcast(st, cmd, sph, app, ev, event, id_str, sph_str);
 			} else {
-				/*
-				 * src_key can be used as index within named workers,
-				 * but src_key is also an index in jobs map, save it here
-				 * and use to find worker name later
-				 */
-				int src_key = sph->src_key;
+				err = start_job(st, cmd, sph, app, ev, event, id_str, sph_str, dnet_upstream_t::collector_t());
+			}
 
-				if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
-					sph->src_key = atomic_inc(&m_src_key);
-					memcpy(sph->src.id, cmd->id.id, sizeof(sph->src.id));
-				}
+			return err;
+		}
 
-				cocaine::api::event_t cevent(ev);
+		/*
+		 * Starts @event on a worker, its replies are sent to the client or given to @collector if it is set
+		 */
+		int start_job(struct dnet_net_state *st, struct dnet_cmd *cmd, struct sph *sph, std::string app,
+				const std::string &ev, const std::string &event, const char *id_str, const char *sph_str,
+				const dnet_upstream_t::collector_t &collector) {
+			/*
+			 * src_key can be used as index within named workers,
+			 * but src_key is also an index in jobs map, save it here
+			 * and use to find worker name later
+			 */
+			int src_key = sph->src_key;
 
-				std::unique_lock<std::mutex> guard(m_lock);
-				eng_map_t::iterator it = m_map.find(app);
-				if (it == m_map.end()) {
-					dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: no task", id_str, sph_str, event.c_str());
-					return -ENOENT;
-				}
+			if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
+				sph->src_key = atomic_inc(&m_src_key);
+				memcpy(sph->src.id, cmd->id.id, sizeof(sph->src.id));
+			}
 
-				it->second->update(event, sph);
+			cocaine::api::event_t cevent(ev);
 
-				dnet_shared_upstream_t upstream(std::make_shared<dnet_upstream_t>(m_node, st, cmd, sph,
-												std::bind(&srw::complete_job, this, id_str, sph_wrapper(sph))));
+			std::shared_ptr<dnet_app_t> eng = find_app(app);
+			if (!eng) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: no task", id_str, sph_str, event.c_str());
+				return -ENOENT;
+			}
 
-				if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
-					m_jobs.insert(std::make_pair((int)sph->src_key, upstream));
-				}
+			eng->update(event, sph);
 
-				std::shared_ptr<dnet_app_t> eng = it->second;
-				guard.unlock();
+			dnet_shared_upstream_t upstream(std::make_shared<dnet_upstream_t>(m_node, st, cmd, sph,
+											std::bind(&srw::complete_job, this, id_str, sph_wrapper(sph)), collector));
 
-				int index = eng->get_index(src_key);
-				std::shared_ptr<cocaine::api::stream_t> stream;
+			if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
+				std::lock_guard<std::mutex> guard(m_jobs_lock);
+				m_jobs.insert(std::make_pair((int)sph->src_key, upstream));
+			}
 
-				try {
-					if (index == -1) {
-						stream = eng->enqueue(cevent, upstream);
-					} else {
-						app = eng->get_task_id() + "-" + app + "-" + ioremap::elliptics::lexical_cast(index);
-						stream = eng->enqueue(cevent, upstream, app);
-					}
+			int index = eng->get_index(src_key);
+			std::shared_ptr<cocaine::api::stream_t> stream;
 
-					stream->write((const char *)sph, total_size(sph) + sizeof(struct sph));
-					/*
-					 * Request stream should be closed after all data was sent to prevent resource leackage.
-					 */
-					stream->close();
-
-				} catch (const std::exception &e) {
-					dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: enqueue/write-exception: queue: %s, src-key-orig: %d, "
-							"job: %d, total-size: %zd, block: %d: %s",
-							id_str, sph_str, event.c_str(),
-							app.c_str(),
-							src_key, sph->src_key, total_size(sph),
-							!!(sph->flags & DNET_SPH_FLAGS_SRC_BLOCK),
-							e.what());
-					return -EXFULL;
+			try {
+				if (index == -1) {
+					stream = eng->enqueue(cevent, upstream);
+				} else {
+					app = eng->get_task_id() + "-" + app + "-" + ioremap::elliptics::lexical_cast(index);
+					stream = eng->enqueue(cevent, upstream, app);
 				}
 
-				dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: started: queue: %s, src-key-orig: %d, "
-						"job: %d, total-size: %zd, block: %d",
+				stream->write((const char *)sph, total_size(sph) + sizeof(struct sph));
+				/*
+				 * Request stream should be closed after all data was sent to prevent resource leackage.
+				 */
+				stream->close();
+
+			} catch (const std::exception &e) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: enqueue/write-exception: queue: %s, src-key-orig: %d, "
+						"job: %d, total-size: %zd, block: %d: %s",
 						id_str, sph_str, event.c_str(),
 						app.c_str(),
 						src_key, sph->src_key, total_size(sph),
-						!!(sph->flags & DNET_SPH_FLAGS_SRC_BLOCK));
+						!!(sph->flags & DNET_SPH_FLAGS_SRC_BLOCK),
+						e.what());
+				return -EXFULL;
+			}
+
+			dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: started: queue: %s, src-key-orig: %d, "
+					"job: %d, total-size: %zd, block: %d",
+					id_str, sph_str, event.c_str(),
+					app.c_str(),
+					src_key, sph->src_key, total_size(sph),
+					!!(sph->flags & DNET_SPH_FLAGS_SRC_BLOCK));
+
+			if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
+				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			}
+
+			return 0;
+		}
+
+		/*
+		 * Runs broadcast @event locally and forwards it to subtrees listed in its header,
+		 * the only reply combines results of this node and of all subtrees
+		 */
+		int broadcast(struct dnet_net_state *st, struct dnet_cmd *cmd, struct sph *sph, const std::string &app,
+				const std::string &ev, const std::string &event, const char *id_str, const char *sph_str) {
+			const char *data = (const char *)(sph + 1) + sph->event_size;
+
+			if (sph->data_size < sizeof(struct dnet_exec_broadcast)) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: broadcast: data is too small for header: %llu",
+						id_str, sph_str, event.c_str(), (unsigned long long)sph->data_size);
+				return -EINVAL;
+			}
+
+			struct dnet_exec_broadcast header = *(const struct dnet_exec_broadcast *)data;
+			dnet_convert_exec_broadcast(&header);
+
+			const uint64_t header_size = sizeof(struct dnet_exec_broadcast) +
+				(uint64_t)header.addr_num * sizeof(struct dnet_addr);
+			if (sph->data_size < header_size) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: broadcast: data is too small for %u addresses: %llu",
+						id_str, sph_str, event.c_str(), header.addr_num, (unsigned long long)sph->data_size);
+				return -EINVAL;
+			}
+
+			const std::string reducer_name(header.reducer, strnlen(header.reducer, sizeof(header.reducer)));
+			dnet_exec_reducer reducer = find_reducer(reducer_name);
+			if (!reducer) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: %s: broadcast: no reducer: '%s'",
+						id_str, sph_str, event.c_str(), reducer_name.c_str());
+				return -ENOENT;
+			}
+
+			std::vector<struct dnet_addr> addrs(header.addr_num);
+			memcpy(addrs.data(), data + sizeof(struct dnet_exec_broadcast), addrs.size() * sizeof(struct dnet_addr));
+			for (auto it = addrs.begin(); it != addrs.end(); ++it)
+				dnet_convert_addr(&*it);
 
-				if (sph->flags & DNET_SPH_FLAGS_SRC_BLOCK) {
-					cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			const char *app_data = data + header_size;
+			const uint64_t app_size = sph->data_size - header_size;
+
+			const size_t fanout = std::max(header.fanout, 1U);
+			const size_t children = std::min(fanout, addrs.size());
+
+			auto job = std::make_shared<broadcast_job>(m_node, st, cmd, sph, event, reducer, children + 1);
+
+			dnet_log(m_node, DNET_LOG_INFO, "%s: sph: %s: %s: broadcast: reducer: %s, addresses: %zu, "
+					"children: %zu, timeout: %llu ms",
+					id_str, sph_str, event.c_str(), reducer_name.c_str(), addrs.size(), children,
+					(unsigned long long)header.timeout_ms);
+
+			for (size_t i = 0; i < children; ++i) {
+				const size_t begin = addrs.size() * i / children;
+				const size_t end = addrs.size() * (i + 1) / children;
+
+				forward(cmd, sph, event, header, addrs, begin, end, app_data, app_size, job);
+			}
+
+			/*
+			 * Local part is an ordinary blocked exec with the same data, but without broadcast header
+			 */
+			std::string local(sizeof(struct sph) + sph->event_size + app_size, '\0');
+			struct sph *local_sph = (struct sph *)&local[0];
+			*local_sph = *sph;
+			local_sph->flags &= ~DNET_SPH_FLAGS_BROADCAST;
+			local_sph->flags |= DNET_SPH_FLAGS_SRC_BLOCK;
+			local_sph->data_size = app_size;
+			memcpy(local_sph + 1, sph + 1, sph->event_size);
+			memcpy((char *)(local_sph + 1) + sph->event_size, app_data, app_size);
+
+			/* job completes either by collector or by failed start, but only once */
+			auto done = std::make_shared<std::atomic<bool>>(false);
+
+			int err = start_job(st, cmd, local_sph, app, ev, event, id_str, sph_str,
+				[job, done] (int err, std::string &&data) {
+					if (!done->exchange(true))
+						job->complete(err, std::move(data), err ? 0 : 1);
+				});
+			if (err && !done->exchange(true))
+				job->complete(err, std::string(), 0);
+
+			cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+			return 0;
+		}
+
+		/*
+		 * Forwards broadcast to the first reachable node of addresses [@begin, @end),
+		 * the rest of them become its subtree
+		 */
+		void forward(struct dnet_cmd *cmd, const struct sph *sph, const std::string &event,
+				const struct dnet_exec_broadcast &header, const std::vector<struct dnet_addr> &addrs,
+				size_t begin, size_t end, const char *app_data, uint64_t app_size,
+				const std::shared_ptr<broadcast_job> &job) {
+			struct dnet_net_state *child = NULL;
+			struct dnet_id id;
+			const size_t num = end - begin;
+
+			for (; begin < end; ++begin) {
+				child = dnet_state_search_by_addr(m_node, &addrs[begin]);
+				if (!child)
+					continue;
+
+				/* workers of the child send their replies to this id, so it has to belong to the child */
+				int found = 0;
+				pthread_rwlock_rdlock(&child->idc_lock);
+				struct rb_node *it = rb_first(&child->idc_root);
+				if (it) {
+					struct dnet_idc *idc = rb_entry(it, struct dnet_idc, state_entry);
+					dnet_setup_id(&id, idc->group->group_id, idc->ids[0].raw.id);
+					found = 1;
 				}
+				pthread_rwlock_unlock(&child->idc_lock);
+
+				if (found)
+					break;
+
+				dnet_state_put(child);
+				child = NULL;
 			}
 
-			return err;
+			if (!child) {
+				dnet_log(m_node, DNET_LOG_ERROR, "%s: sph: %s: broadcast: no reachable node among %zu addresses",
+						dnet_dump_id(&cmd->id), event.c_str(), num);
+				job->complete(-ENXIO, std::string(), 0);
+				return;
+			}
+
+			const size_t subtree = end - begin - 1;
+			const uint64_t header_size = sizeof(struct dnet_exec_broadcast) + subtree * sizeof(struct dnet_addr);
+
+			std::string request(sizeof(struct sph) + sph->event_size + header_size + app_size, '\0');
+			char *ptr = &request[0];
+
+			struct sph *child_sph = (struct sph *)ptr;
+			*child_sph = *sph;
+			child_sph->data_size = header_size + app_size;
+			child_sph->src_key = 0;
+			child_sph->broadcast_nodes = 0;
+			memcpy(child_sph->src.id, id.id, sizeof(child_sph->src.id));
+			dnet_convert_sph(child_sph);
+			ptr += sizeof(struct sph);
+
+			memcpy(ptr, event.data(), sph->event_size);
+			ptr += sph->event_size;
+
+			struct dnet_exec_broadcast *child_header = (struct dnet_exec_broadcast *)ptr;
+			*child_header = header;
+			child_header->addr_num = subtree;
+			/* subtree has to reply before this node runs out of its own time */
+			child_header->timeout_ms = header.timeout_ms / 10 * 9;
+			dnet_convert_exec_broadcast(child_header);
+			for (size_t i = 0; i < subtree; ++i) {
+				child_header->addrs[i] = addrs[begin + 1 + i];
+				dnet_convert_addr(&child_header->addrs[i]);
+			}
+			ptr += header_size;
+
+			memcpy(ptr, app_data, app_size);
+
+			struct dnet_trans_control ctl;
+			memset(&ctl, 0, sizeof(ctl));
+			ctl.id = id;
+			ctl.cmd = DNET_CMD_EXEC;
+			ctl.cflags = DNET_FLAGS_NEED_ACK;
+			ctl.data = &request[0];
+			ctl.size = request.size();
+			ctl.complete = broadcast_child_complete;
+			ctl.priv = new broadcast_child(job);
+
+			struct dnet_session *s = dnet_session_create(m_node);
+			if (!s) {
+				delete (broadcast_child *)ctl.priv;
+				dnet_state_put(child);
+				job->complete(-ENOMEM, std::string(), 0);
+				return;
+			}
+
+			dnet_session_set_trace_id(s, cmd->trace_id);
+			dnet_session_set_trace_bit(s, !!(cmd->flags & DNET_FLAGS_TRACE_BIT));
+			if (header.timeout_ms)
+				dnet_session_set_timeout_ms(s, header.timeout_ms / 10 * 9);
+
+			/* request is copied into transaction, failed transaction is completed by callback */
+			dnet_trans_alloc_send_state(s, child, &ctl);
+
+			dnet_session_destroy(s);
+			dnet_state_put(child);
 		}
 
 		void complete_job(std::string id, sph_wrapper sph)
 		{
-			std::unique_lock<std::mutex> guard(m_lock);
+			std::unique_lock<std::mutex> guard(m_jobs_lock);
 
 			jobs_map_t::iterator it = m_jobs.find(sph.sph.src_key);
 			if (it == m_jobs.end()) {
@@ -594,11 +1079,23 @@ class srw {
 	private:
 		struct dnet_node		*m_node;
 		cocaine::context_t		m_ctx;
+		/* serializes starts and stops of tasks, lookups don't take it */
 		std::mutex			m_lock;
-		eng_map_t			m_map;
+		eng_map_ptr_t			m_map;
+		std::mutex			m_jobs_lock;
 		jobs_map_t			m_jobs;
 		atomic_t			m_src_key;
 
+		eng_map_ptr_t apps_snapshot() const {
+			return std::atomic_load(&m_map);
+		}
+
+		std::shared_ptr<dnet_app_t> find_app(const std::string &app) const {
+			eng_map_ptr_t apps = apps_snapshot();
+			eng_map_t::const_iterator it = apps->find(app);
+			return it != apps->end() ? it->second : std::shared_ptr<dnet_app_t>();
+		}
+
 		std::string dnet_get_event(const struct sph *sph, const char *data) {
 			return std::string(data, sph->event_size);
 		}
@@ -661,6 +1158,18 @@ int dnet_srw_update(struct dnet_node *, int )
 {
 	return 0;
 }
+
+int dnet_srw_register_reducer(const char *name, dnet_exec_reducer reducer)
+{
+	if (!name || !reducer || strlen(name) >= DNET_EXEC_REDUCER_SIZE)
+		return -EINVAL;
+
+	reducers_registry &registry = get_reducers();
+
+	std::lock_guard<std::mutex> guard(registry.lock);
+	registry.reducers[name] = reducer;
+	return 0;
+}
 #else
 #include <errno.h>
 
@@ -684,4 +1193,9 @@ int dnet_srw_update(struct dnet_node *, int)
 {
 	return 0;
 }
+
+int dnet_srw_register_reducer(const char *, dnet_exec_reducer)
+{
+	return -ENOTSUP;
+}
 #endif
@@ -401,6 +401,77 @@ static void test_make_backend_writeable(session &sess)
 	ELLIPTICS_REQUIRE_ERROR(second_async_readonly_result, sess.make_writable(node.remote(), 4), -EALREADY);
 }
 
+static void test_resize_cache(session &sess)
+{
+	server_node &node = global_data->nodes.back();
+	const key id = std::string("resize_cache_key");
+	const std::string data = "resize_cache_data";
+	const uint64_t size = 512 * 1024 * 1024;
+
+	session cache_sess = sess.clone();
+	cache_sess.set_direct_id(node.remote(), 4);
+	cache_sess.set_ioflags(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY);
+
+	ELLIPTICS_REQUIRE(write_result, cache_sess.write_data(id, data, 0));
+
+	ELLIPTICS_REQUIRE(async_grow_result, sess.resize_cache(node.remote(), 4, size));
+
+	backend_status_result_entry result = async_grow_result.get_one();
+	BOOST_REQUIRE(result.is_valid());
+	BOOST_REQUIRE_EQUAL(result.count(), 1);
+	BOOST_REQUIRE_EQUAL(result.backend(0)->cache_size, size);
+
+	ELLIPTICS_COMPARE_REQUIRE(grown_read_result, cache_sess.read_data(id, 0, 0), data);
+
+	// cache has only one page
+	ELLIPTICS_REQUIRE_ERROR(async_invalid_result, sess.resize_cache(node.remote(), 4, size, {1, 1}), -EINVAL);
+
+	ELLIPTICS_REQUIRE(async_shrink_result, sess.resize_cache(node.remote(), 4, size / 2, {1}));
+	BOOST_REQUIRE_EQUAL(async_shrink_result.get_one().backend(0)->cache_size, size / 2);
+
+	ELLIPTICS_COMPARE_REQUIRE(shrunk_read_result, cache_sess.read_data(id, 0, 0), data);
+}
+
+static void test_reload_backend(session &sess)
+{
+	server_node &node = global_data->nodes.back();
+	const uint32_t backend_id = 4;
+	const key id = std::string("reload_key");
+	const std::string data = "reload_data";
+
+	session new_sess = sess.clone();
+	new_sess.set_direct_id(node.remote(), backend_id);
+
+	ELLIPTICS_REQUIRE(write_result, new_sess.write_data(id, data, 0));
+
+	// requests sent during reload must wait for it instead of failing
+	std::vector<async_read_result> reads;
+	for (int i = 0; i < 16; ++i)
+		reads.emplace_back(new_sess.read_data(id, 0, 0));
+
+	ELLIPTICS_REQUIRE(reload_result, sess.reload_backend(node.remote(), backend_id));
+
+	backend_status_result_entry result = reload_result.get_one();
+	BOOST_REQUIRE(result.is_valid());
+	BOOST_REQUIRE_EQUAL(result.count(), 1);
+
+	dnet_backend_status *status = result.backend(0);
+	BOOST_REQUIRE_EQUAL(status->backend_id, backend_id);
+	BOOST_REQUIRE_EQUAL(status->state, DNET_BACKEND_ENABLED);
+	BOOST_REQUIRE_EQUAL(status->last_start_err, 0);
+
+	for (auto it = reads.begin(); it != reads.end(); ++it) {
+		it->wait();
+		BOOST_REQUIRE_EQUAL(it->error().code(), 0);
+		BOOST_REQUIRE_EQUAL(it->get_one().file().to_string(), data);
+	}
+
+	ELLIPTICS_REQUIRE(read_result, new_sess.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+
+	ELLIPTICS_REQUIRE_ERROR(disabled_reload_result, sess.reload_backend(node.remote(), 5), -ENOENT);
+}
+
 static void test_change_group(session &sess)
 {
 	server_node &node = global_data->nodes.back();
@@ -455,6 +526,8 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_set_backend_ids_for_enabled, create_session(n, { 0 }, 0, 0));
 	ELLIPTICS_TEST_CASE(test_make_backend_readonly, create_session(n, { 0 }, 0, 0));
 	ELLIPTICS_TEST_CASE(test_make_backend_writeable, create_session(n, { 0 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_resize_cache, create_session(n, { 0 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_reload_backend, create_session(n, { 0 }, 0, 0));
 	ELLIPTICS_TEST_CASE(test_change_group, create_session(n, { 0 }, 0, 0));
 
 	return true;
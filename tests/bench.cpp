@@ -0,0 +1,629 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+/*
+ * dnet_bench - load generator which either starts local servers the same way tests do
+ * or connects to remote ones, runs configurable mix of operations from many threads
+ * and prints throughput and latency percentiles of every operation as JSON.
+ */
+
+#include "test_base.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+using namespace ioremap::elliptics;
+
+namespace {
+
+enum bench_op {
+	op_write = 0,
+	op_read,
+	op_lookup,
+	op_bulk_write,
+	op_bulk_read,
+	op_index,
+	__op_max
+};
+
+const char *op_names[__op_max] = { "write", "read", "lookup", "bulk_write", "bulk_read", "index" };
+
+/*
+ * Log-linear latency histogram: values are grouped by their highest bit and every such group is split
+ * into 2^sub_bits equal buckets, so relative error of any percentile is below 1/2^sub_bits.
+ */
+class latency_histogram
+{
+public:
+	static const int sub_bits = 5;
+	static const int sub_count = 1 << sub_bits;
+
+	latency_histogram() : m_counts((64 - sub_bits + 1) * sub_count, 0), m_total(0), m_sum(0), m_min(UINT64_MAX), m_max(0)
+	{}
+
+	void record(uint64_t value) {
+		++m_counts[index(value)];
+		++m_total;
+		m_sum += value;
+		m_min = std::min(m_min, value);
+		m_max = std::max(m_max, value);
+	}
+
+	void merge(const latency_histogram &other) {
+		for (size_t i = 0; i < m_counts.size(); ++i)
+			m_counts[i] += other.m_counts[i];
+		m_total += other.m_total;
+		m_sum += other.m_sum;
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+	}
+
+	uint64_t count() const { return m_total; }
+	uint64_t min() const { return m_total ? m_min : 0; }
+	uint64_t max() const { return m_max; }
+	double mean() const { return m_total ? double(m_sum) / m_total : 0; }
+
+	/* returns upper bound of the bucket which contains @percentile of values */
+	uint64_t percentile(double percentile) const {
+		const uint64_t rank = std::ceil(m_total * percentile / 100.);
+		uint64_t seen = 0;
+
+		for (size_t i = 0; i < m_counts.size(); ++i) {
+			seen += m_counts[i];
+			if (seen >= rank && seen)
+				return std::min(upper_bound(i), m_max);
+		}
+
+		return m_max;
+	}
+
+private:
+	static size_t index(uint64_t value) {
+		if (value < sub_count)
+			return value;
+
+		const int bits = 64 - __builtin_clzll(value);
+		const int shift = bits - sub_bits;
+		return (shift + 1) * sub_count + ((value >> shift) - sub_count);
+	}
+
+	static uint64_t upper_bound(size_t index) {
+		if (index < sub_count)
+			return index;
+
+		const int shift = index / sub_count - 1;
+		const uint64_t base = sub_count + index % sub_count;
+		return ((base + 1) << shift) - 1;
+	}
+
+	std::vector<uint64_t> m_counts;
+	uint64_t m_total;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
+
+struct op_stats
+{
+	op_stats() : errors(0), bytes(0) {}
+
+	void merge(const op_stats &other) {
+		latencies.merge(other.latencies);
+		errors += other.errors;
+		bytes += other.bytes;
+	}
+
+	latency_histogram latencies;
+	uint64_t errors;
+	uint64_t bytes;
+};
+
+struct bench_config
+{
+	std::vector<int> groups;
+	std::vector<std::pair<bench_op, double>> mix;
+	uint64_t keys;
+	double zipf;
+	std::string size_dist;
+	uint64_t size_min;
+	uint64_t size_max;
+	size_t bulk;
+	size_t indexes;
+	size_t threads;
+	uint64_t operations;
+	double duration;
+	bool prefill;
+	std::string prefix;
+};
+
+/*
+ * Picks keys from [0, @keys) with Zipf distribution of exponent @s, uniformly if @s is 0
+ */
+class key_generator
+{
+public:
+	key_generator(uint64_t keys, double s) : m_keys(keys) {
+		if (s <= 0)
+			return;
+
+		m_cdf.resize(keys);
+		double sum = 0;
+		for (uint64_t i = 0; i < keys; ++i) {
+			sum += 1. / std::pow(double(i + 1), s);
+			m_cdf[i] = sum;
+		}
+		for (auto &p : m_cdf)
+			p /= sum;
+	}
+
+	template <typename Random>
+	uint64_t next(Random &random) const {
+		if (m_cdf.empty())
+			return std::uniform_int_distribution<uint64_t>(0, m_keys - 1)(random);
+
+		const double p = std::uniform_real_distribution<double>(0, 1)(random);
+		auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), p);
+		return std::min<uint64_t>(it - m_cdf.begin(), m_keys - 1);
+	}
+
+private:
+	uint64_t m_keys;
+	std::vector<double> m_cdf;
+};
+
+class bench_worker
+{
+public:
+	bench_worker(const bench_config &config, const key_generator &keys, session sess, unsigned seed)
+	: m_config(config), m_keys(keys), m_session(sess.clone()), m_random(seed), m_stats(__op_max)
+	{
+		m_session.set_groups(m_config.groups);
+		m_session.set_exceptions_policy(session::no_exceptions);
+	}
+
+	const std::vector<op_stats> &stats() const { return m_stats; }
+
+	void run(std::atomic<uint64_t> &issued, std::chrono::steady_clock::time_point deadline) {
+		std::uniform_real_distribution<double> pick(0, 1);
+
+		while (std::chrono::steady_clock::now() < deadline) {
+			if (m_config.operations && issued++ >= m_config.operations)
+				break;
+
+			double p = pick(m_random);
+			bench_op op = m_config.mix.back().first;
+			for (auto it = m_config.mix.begin(); it != m_config.mix.end(); ++it) {
+				if (p < it->second) {
+					op = it->first;
+					break;
+				}
+				p -= it->second;
+			}
+
+			execute(op);
+		}
+	}
+
+	void write(uint64_t key) {
+		const std::string data = make_data();
+		auto result = m_session.write_data(key_name(key), data, 0);
+		result.wait();
+	}
+
+private:
+	std::string key_name(uint64_t key) const {
+		return m_config.prefix + boost::lexical_cast<std::string>(key);
+	}
+
+	std::string make_data() {
+		uint64_t size = m_config.size_min;
+
+		if (m_config.size_dist == "uniform") {
+			size = std::uniform_int_distribution<uint64_t>(m_config.size_min, m_config.size_max)(m_random);
+		} else if (m_config.size_dist == "exponential") {
+			const double mean = (m_config.size_min + m_config.size_max) / 2.;
+			size = std::exponential_distribution<double>(1. / mean)(m_random);
+			size = std::max(m_config.size_min, std::min<uint64_t>(size, m_config.size_max));
+		}
+
+		return std::string(size, 'a' + m_random() % 26);
+	}
+
+	std::vector<std::string> bulk_keys() {
+		std::vector<std::string> keys;
+		keys.reserve(m_config.bulk);
+		for (size_t i = 0; i < m_config.bulk; ++i)
+			keys.push_back(key_name(m_keys.next(m_random)));
+		return keys;
+	}
+
+	void execute(bench_op op) {
+		op_stats &stats = m_stats[op];
+		uint64_t bytes = 0;
+		error_info error;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		switch (op) {
+		case op_write: {
+			const std::string data = make_data();
+			auto result = m_session.write_data(key_name(m_keys.next(m_random)), data, 0);
+			result.wait();
+			error = result.error();
+			bytes = data.size();
+			break;
+		}
+		case op_read: {
+			auto result = m_session.read_data(key_name(m_keys.next(m_random)), 0, 0);
+			result.wait();
+			error = result.error();
+			if (!error)
+				bytes = result.get_one().file().size();
+			break;
+		}
+		case op_lookup: {
+			auto result = m_session.lookup(key_name(m_keys.next(m_random)));
+			result.wait();
+			error = result.error();
+			break;
+		}
+		case op_bulk_write: {
+			std::vector<dnet_io_attr> ios;
+			std::vector<std::string> data;
+			for (auto &name : bulk_keys()) {
+				dnet_io_attr io;
+				dnet_id id;
+				memset(&io, 0, sizeof(io));
+				m_session.transform(name, id);
+				memcpy(io.id, id.id, sizeof(io.id));
+				data.push_back(make_data());
+				io.size = data.back().size();
+				bytes += io.size;
+				ios.push_back(io);
+			}
+			auto result = m_session.bulk_write(ios, data);
+			result.wait();
+			error = result.error();
+			break;
+		}
+		case op_bulk_read: {
+			auto result = m_session.bulk_read(bulk_keys());
+			result.wait();
+			error = result.error();
+			for (auto it = result.get().begin(); it != result.get().end(); ++it)
+				bytes += it->file().size();
+			break;
+		}
+		case op_index: {
+			const std::string name = key_name(m_keys.next(m_random));
+			std::vector<std::string> indexes;
+			std::vector<data_pointer> data;
+			indexes.push_back(m_config.prefix + "index-" +
+					boost::lexical_cast<std::string>(m_random() % std::max<size_t>(m_config.indexes, 1)));
+			data.push_back(data_pointer::copy(name));
+			auto result = m_session.update_indexes(name, indexes, data);
+			result.wait();
+			error = result.error();
+			break;
+		}
+		case __op_max:
+			break;
+		}
+
+		const auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count();
+
+		stats.latencies.record(usecs);
+		if (error)
+			++stats.errors;
+		stats.bytes += bytes;
+	}
+
+	const bench_config &m_config;
+	const key_generator &m_keys;
+	session m_session;
+	std::mt19937_64 m_random;
+	std::vector<op_stats> m_stats;
+};
+
+std::vector<std::pair<bench_op, double>> parse_mix(const std::string &mix)
+{
+	std::vector<std::pair<bench_op, double>> result;
+	std::vector<std::string> parts;
+	double total = 0;
+
+	boost::split(parts, mix, boost::is_any_of(","));
+	for (auto it = parts.begin(); it != parts.end(); ++it) {
+		std::vector<std::string> pair;
+		boost::split(pair, *it, boost::is_any_of(":"));
+		if (pair.size() != 2)
+			throw std::invalid_argument("invalid mix entry: " + *it);
+
+		auto name = std::find(op_names, op_names + __op_max, pair[0]);
+		if (name == op_names + __op_max)
+			throw std::invalid_argument("unknown operation: " + pair[0]);
+
+		const double weight = boost::lexical_cast<double>(pair[1]);
+		if (weight <= 0)
+			continue;
+
+		result.emplace_back(bench_op(name - op_names), weight);
+		total += weight;
+	}
+
+	if (result.empty())
+		throw std::invalid_argument("operations mix is empty");
+
+	for (auto &entry : result)
+		entry.second /= total;
+
+	return result;
+}
+
+void write_stats(rapidjson::Value &value, const op_stats &stats, double seconds,
+		rapidjson::Document::AllocatorType &allocator)
+{
+	const latency_histogram &l = stats.latencies;
+
+	value.SetObject();
+	value.AddMember("count", l.count(), allocator);
+	value.AddMember("errors", stats.errors, allocator);
+	value.AddMember("bytes", stats.bytes, allocator);
+	value.AddMember("ops_per_sec", seconds > 0 ? l.count() / seconds : 0., allocator);
+	value.AddMember("bytes_per_sec", seconds > 0 ? stats.bytes / seconds : 0., allocator);
+
+	rapidjson::Value latency(rapidjson::kObjectType);
+	latency.AddMember("min", l.min(), allocator);
+	latency.AddMember("mean", l.mean(), allocator);
+	latency.AddMember("p50", l.percentile(50), allocator);
+	latency.AddMember("p90", l.percentile(90), allocator);
+	latency.AddMember("p99", l.percentile(99), allocator);
+	latency.AddMember("p999", l.percentile(99.9), allocator);
+	latency.AddMember("p9999", l.percentile(99.99), allocator);
+	latency.AddMember("max", l.max(), allocator);
+	value.AddMember("latency_usecs", latency, allocator);
+}
+
+/*
+ * Applies name=value server options, value is a number, true/false or a string
+ */
+void apply_server_options(tests::server_config &server, const std::vector<std::string> &options)
+{
+	for (auto it = options.begin(); it != options.end(); ++it) {
+		const size_t pos = it->find('=');
+		if (pos == std::string::npos || pos == 0)
+			throw std::invalid_argument("invalid server option: " + *it);
+
+		const std::string name = it->substr(0, pos);
+		const std::string value = it->substr(pos + 1);
+
+		if (value == "true" || value == "false") {
+			server.options(name, value == "true");
+			continue;
+		}
+
+		try {
+			server.options(name, boost::lexical_cast<int64_t>(value));
+		} catch (const boost::bad_lexical_cast &) {
+			server.options(name, value);
+		}
+	}
+}
+
+tests::server_config bench_server_config(int group, size_t backends, const std::vector<std::string> &options)
+{
+	tests::server_config server = tests::server_config::default_value();
+	apply_server_options(server, options);
+	server.backends[0]("enable", true)("group", group);
+	server.backends.resize(backends, server.backends.front());
+	return server;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bench_config config;
+	std::vector<std::string> remotes, server_options;
+	std::string groups, mix, path, output;
+	size_t servers, backends;
+
+	bpo::options_description generic("Benchmark options");
+	generic.add_options()
+		("help", "This help message")
+		("remote", bpo::value(&remotes), "Remote node (host:port:family) to benchmark, "
+			"local servers are started if no remotes are given")
+		("servers", bpo::value(&servers)->default_value(2), "Number of local servers")
+		("backends", bpo::value(&backends)->default_value(1), "Number of backends of every local server")
+		("server-option", bpo::value(&server_options), "Option of local servers as name=value, "
+			"for example server_shards=2 or busy_poll_usecs=50, may be repeated")
+		("path", bpo::value(&path)->default_value("bench"), "Directory of local servers' data")
+		("groups", bpo::value(&groups)->default_value("1,2"), "Comma separated groups, "
+			"local servers are spread over them")
+		("mix", bpo::value(&mix)->default_value("write:30,read:60,lookup:10"),
+			"Comma separated operation:weight pairs, operations: write, read, lookup, bulk_write, bulk_read, index")
+		("keys", bpo::value(&config.keys)->default_value(10000), "Number of distinct keys")
+		("zipf", bpo::value(&config.zipf)->default_value(0), "Exponent of Zipf popularity of keys, 0 - uniform")
+		("size-dist", bpo::value(&config.size_dist)->default_value("fixed"),
+			"Object size distribution: fixed (size-min), uniform or exponential within [size-min, size-max]")
+		("size-min", bpo::value(&config.size_min)->default_value(4096), "Minimal object size")
+		("size-max", bpo::value(&config.size_max)->default_value(4096), "Maximal object size")
+		("bulk", bpo::value(&config.bulk)->default_value(16), "Number of keys in every bulk operation")
+		("indexes", bpo::value(&config.indexes)->default_value(16), "Number of distinct indexes")
+		("threads", bpo::value(&config.threads)->default_value(16), "Number of operations in flight")
+		("operations", bpo::value(&config.operations)->default_value(0), "Total number of operations, 0 - unlimited")
+		("duration", bpo::value(&config.duration)->default_value(30), "Duration in seconds")
+		("no-prefill", "Do not write all keys before the benchmark")
+		("prefix", bpo::value(&config.prefix)->default_value("bench-"), "Prefix of keys and indexes")
+		("output", bpo::value(&output), "File to write JSON results to instead of stdout")
+		;
+
+	bpo::variables_map vm;
+	try {
+		bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+		bpo::notify(vm);
+	} catch (std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << std::endl << generic;
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return 0;
+	}
+
+	try {
+		std::vector<std::string> parts;
+		boost::split(parts, groups, boost::is_any_of(","));
+		for (auto it = parts.begin(); it != parts.end(); ++it)
+			config.groups.push_back(boost::lexical_cast<int>(*it));
+
+		config.mix = parse_mix(mix);
+		config.prefill = !vm.count("no-prefill");
+		config.size_max = std::max(config.size_max, config.size_min);
+		config.threads = std::max<size_t>(config.threads, 1);
+		config.keys = std::max<uint64_t>(config.keys, 1);
+	} catch (std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << std::endl;
+		return 1;
+	}
+
+	tests::nodes_data::ptr nodes;
+	try {
+		if (remotes.empty()) {
+			std::vector<tests::server_config> configs;
+			for (size_t i = 0; i < servers; ++i)
+				configs.push_back(bench_server_config(config.groups[i % config.groups.size()], backends,
+							server_options));
+
+			tests::start_nodes_config start_config(std::cerr, std::move(configs), path);
+			start_config.fork = true;
+			nodes = tests::start_nodes(start_config);
+		} else {
+			nodes = tests::start_nodes(std::cerr, remotes, path);
+		}
+	} catch (std::exception &e) {
+		std::cerr << "Failed to start nodes: " << e.what() << std::endl;
+		return 1;
+	}
+
+	session sess(*nodes->node);
+	key_generator keys(config.keys, config.zipf);
+
+	std::vector<std::unique_ptr<bench_worker>> workers;
+	std::random_device seed;
+	for (size_t i = 0; i < config.threads; ++i)
+		workers.emplace_back(new bench_worker(config, keys, sess, seed()));
+
+	if (config.prefill) {
+		std::atomic<uint64_t> next(0);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < workers.size(); ++i) {
+			threads.emplace_back([&, i] () {
+				for (uint64_t key = next++; key < config.keys; key = next++)
+					workers[i]->write(key);
+			});
+		}
+		for (auto &t : threads)
+			t.join();
+	}
+
+	std::atomic<uint64_t> issued(0);
+	const auto start = std::chrono::steady_clock::now();
+	const auto deadline = start + std::chrono::microseconds(uint64_t(config.duration * 1000000));
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < workers.size(); ++i)
+		threads.emplace_back(&bench_worker::run, workers[i].get(), std::ref(issued), deadline);
+	for (auto &t : threads)
+		t.join();
+
+	const double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count() / 1000000.;
+
+	std::vector<op_stats> stats(__op_max);
+	op_stats total;
+	for (auto &worker : workers) {
+		for (int op = 0; op < __op_max; ++op)
+			stats[op].merge(worker->stats()[op]);
+	}
+	for (int op = 0; op < __op_max; ++op)
+		total.merge(stats[op]);
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	auto &allocator = doc.GetAllocator();
+
+	rapidjson::Value config_value(rapidjson::kObjectType);
+	config_value.AddMember("mix", mix.c_str(), allocator);
+	config_value.AddMember("keys", config.keys, allocator);
+	config_value.AddMember("zipf", config.zipf, allocator);
+	config_value.AddMember("size_dist", config.size_dist.c_str(), allocator);
+	config_value.AddMember("size_min", config.size_min, allocator);
+	config_value.AddMember("size_max", config.size_max, allocator);
+	config_value.AddMember("threads", (uint64_t)config.threads, allocator);
+	config_value.AddMember("groups", groups.c_str(), allocator);
+	config_value.AddMember("remote", !remotes.empty(), allocator);
+	const std::string server_options_str = boost::algorithm::join(server_options, ",");
+	config_value.AddMember("server_options", server_options_str.c_str(), allocator);
+	doc.AddMember("config", config_value, allocator);
+	doc.AddMember("duration", seconds, allocator);
+
+	rapidjson::Value ops_value(rapidjson::kObjectType);
+	for (int op = 0; op < __op_max; ++op) {
+		if (!stats[op].latencies.count())
+			continue;
+
+		rapidjson::Value op_value;
+		write_stats(op_value, stats[op], seconds, allocator);
+		ops_value.AddMember(op_names[op], op_value, allocator);
+	}
+	doc.AddMember("operations", ops_value, allocator);
+
+	rapidjson::Value total_value;
+	write_stats(total_value, total, seconds, allocator);
+	doc.AddMember("total", total_value, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+	doc.Accept(writer);
+
+	if (output.empty()) {
+		std::cout << buffer.GetString() << std::endl;
+	} else {
+		std::ofstream out(output.c_str(), std::ofstream::trunc);
+		out << buffer.GetString() << std::endl;
+		if (!out) {
+			std::cerr << "Failed to write results to " << output << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
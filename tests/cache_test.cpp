@@ -39,12 +39,16 @@ static void destroy_global_data()
 
 static void configure_nodes(const std::string &path)
 {
+	server_config server = server_config::default_value().apply_options(config_data()
+		("group", 5)
+		("cache_size", 100000)
+		("cache_shards", 1)
+	);
+	// records are checksummed by CRC32C, see test_cache_cas_crc32c
+	server.backends.front()("checksum_type", "crc32c");
+
 	start_nodes_config start_config(results_reporter::get_stream(), std::vector<server_config>({
-		server_config::default_value().apply_options(config_data()
-			("group", 5)
-			("cache_size", 100000)
-			("cache_shards", 1)
-		)
+		server
 	}), path);
 
 	global_data = start_nodes(start_config);
@@ -81,6 +85,39 @@ static void test_cache_timestamp(session &sess)
 	BOOST_REQUIRE_EQUAL(io->timestamp.tnsec, ctl.io.timestamp.tnsec);
 }
 
+/*
+ * Object read into the cache from a record checksummed by CRC32C is compare-and-swapped
+ * against its CRC32C checksum, the one the backend reports in read replies
+ */
+static void test_cache_cas_crc32c(session &sess)
+{
+	const std::string key = "this is a cache cas test key";
+	const std::string data1 = "cache cas data first";
+	const std::string data2 = "cache cas data second";
+
+	session disk = sess.clone();
+	disk.set_ioflags(DNET_IO_FLAGS_NOCACHE);
+	ELLIPTICS_REQUIRE(write_result, disk.write_data(key, data1, 0));
+
+	disk.set_ioflags(DNET_IO_FLAGS_NOCACHE | DNET_IO_FLAGS_CHECKSUM);
+	ELLIPTICS_REQUIRE(disk_read_result, disk.read_data(key, 0, 0));
+	const dnet_io_attr *io = disk_read_result.get_one().io_attribute();
+	BOOST_REQUIRE_EQUAL((int)io->csum_type, DNET_CHECKSUM_CRC32C);
+
+	dnet_id csum;
+	memset(&csum, 0, sizeof(csum));
+	memcpy(csum.id, io->parent, DNET_ID_SIZE);
+
+	// object is read from disk into the cache
+	ELLIPTICS_COMPARE_REQUIRE(cache_read_result, sess.read_data(key, 0, 0), data1);
+
+	ELLIPTICS_REQUIRE(write_cas_result, sess.write_cas(key, data2, csum, 0));
+	ELLIPTICS_COMPARE_REQUIRE(second_read_result, sess.read_data(key, 0, 0), data2);
+
+	// checksum of the replaced data does not match anymore
+	ELLIPTICS_REQUIRE_ERROR(stale_cas_result, sess.write_cas(key, data1, csum, 0), -EBADFD);
+}
+
 static void test_cache_records_sizes(session &sess)
 {
 	dnet_node *node = global_data->nodes[0].get_native();
@@ -295,6 +332,7 @@ std::string generate_data(size_t length)
 bool register_tests(test_suite *suite, node n)
 {
 	ELLIPTICS_TEST_CASE(test_cache_timestamp, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_cas_crc32c, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
 	ELLIPTICS_TEST_CASE(test_cache_records_sizes, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
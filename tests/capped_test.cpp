@@ -96,9 +96,57 @@ static void test_capped_collection(session &sess, const std::string &collection_
 	}
 }
 
+/*
+ * Readded object becomes the newest one, so the next added object displaces the object which follows it
+ */
+static void test_capped_collection_readd(session &sess, const std::string &collection_name)
+{
+	key collection = collection_name;
+	sess.transform(collection);
+
+	index_entry index(collection.raw_id(), data_pointer());
+
+	std::vector<std::string> objects;
+	for (int i = 0; i < 4; ++i)
+		objects.push_back("capped_readd_obj_" + boost::lexical_cast<std::string>(i));
+
+	for (int i = 0; i < 3; ++i) {
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(objects[i], objects[i], 0));
+		ELLIPTICS_REQUIRE(add_result, sess.add_to_capped_collection(objects[i], index, 3, true));
+	}
+
+	ELLIPTICS_REQUIRE(readd_result, sess.add_to_capped_collection(objects[0], index, 3, true));
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(objects[3], objects[3], 0));
+	ELLIPTICS_REQUIRE(add_result, sess.add_to_capped_collection(objects[3], index, 3, true));
+
+	ELLIPTICS_REQUIRE_ERROR(read_result, sess.read_data(objects[1], 0, 0), -ENOENT);
+	ELLIPTICS_REQUIRE(first_read_result, sess.read_data(objects[0], 0, 0));
+
+	ELLIPTICS_REQUIRE(find_result, sess.find_any_indexes(std::vector<std::string>(1, collection_name)));
+	sync_find_indexes_result results = find_result;
+	BOOST_REQUIRE_EQUAL(results.size(), 3);
+
+	std::set<key> expected;
+	for (size_t i = 0; i < objects.size(); ++i) {
+		if (i == 1)
+			continue;
+
+		key id = objects[i];
+		sess.transform(id);
+		expected.insert(id.id());
+	}
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		key id = results[i].id;
+		BOOST_REQUIRE(expected.find(id) != expected.end());
+	}
+}
+
 bool register_tests(test_suite *suite, node n)
 {
 	ELLIPTICS_TEST_CASE(test_capped_collection, create_session(n, {5}, 0, 0), "capped-collection");
+	ELLIPTICS_TEST_CASE(test_capped_collection_readd, create_session(n, {5}, 0, 0), "capped-collection-readd");
 
 	return true;
 }
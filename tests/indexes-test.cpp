@@ -127,7 +127,8 @@ index_entry sorted<index_entry>(const index_entry &c)
 template <>
 find_indexes_result_entry sorted<find_indexes_result_entry>(const find_indexes_result_entry &c)
 {
-	find_indexes_result_entry copy = { c.id, sorted(c.indexes) };
+	find_indexes_result_entry copy = c;
+	copy.indexes = sorted(c.indexes);
 	return copy;
 }
 
@@ -0,0 +1,82 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test DNET_ITYPE_FILTER filter: counts keys and their total size,
+ * emits them as two little-endian 64-bit numbers when iteration completes
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elliptics/iterator_filter.h"
+
+struct test_count {
+	uint64_t	keys;
+	uint64_t	size;
+};
+
+static int test_count_init(void **priv, const void *arg, uint64_t arg_size)
+{
+	(void) arg;
+	(void) arg_size;
+
+	*priv = calloc(1, sizeof(struct test_count));
+	if (!*priv)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int test_count_process(void *priv, const struct dnet_iterator_filter_record *rec,
+		dnet_iterator_filter_emit_t emit, void *emit_priv)
+{
+	struct test_count *count = priv;
+
+	(void) emit;
+	(void) emit_priv;
+
+	__sync_fetch_and_add(&count->keys, 1);
+	__sync_fetch_and_add(&count->size, rec->size);
+	return 0;
+}
+
+static int test_count_finish(void *priv, dnet_iterator_filter_emit_t emit, void *emit_priv)
+{
+	struct test_count *count = priv;
+	struct test_count result;
+	struct dnet_raw_id key;
+
+	memset(&key, 0, sizeof(struct dnet_raw_id));
+	result.keys = dnet_bswap64(count->keys);
+	result.size = dnet_bswap64(count->size);
+
+	return emit(emit_priv, &key, &result, sizeof(result));
+}
+
+static void test_count_cleanup(void *priv)
+{
+	free(priv);
+}
+
+const struct dnet_iterator_filter dnet_iterator_filter = {
+	.init = test_count_init,
+	.process = test_count_process,
+	.finish = test_count_finish,
+	.cleanup = test_count_cleanup,
+};
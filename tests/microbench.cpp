@@ -0,0 +1,931 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+/*
+ * dnet_microbench - measures core data structures in isolation, without servers and network:
+ * request queue of pool threads, transaction table of the state, route table search,
+ * cache structures and sort of iterator results.
+ *
+ * Every benchmark runs increasing number of iterations until it takes at least --time seconds,
+ * then time per operation and throughput of all threads are printed, and written as JSON if --output is set.
+ */
+
+#include "library/request_queue.h"
+#include "cache/cache.hpp"
+#include "cache/treap.hpp"
+#include "cache/frequency_sketch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+using namespace ioremap;
+
+namespace {
+
+/*
+ * Precomputed sequence of key indexes from [0, @keys), Zipf distributed with exponent @s or uniform if @s is 0,
+ * so random number generation is not measured together with the structure.
+ */
+std::vector<uint32_t> key_sequence(uint32_t keys, double s, size_t count, unsigned seed)
+{
+	std::mt19937_64 random(seed);
+	std::vector<uint32_t> sequence(count);
+
+	if (s <= 0) {
+		std::uniform_int_distribution<uint32_t> dist(0, keys - 1);
+		for (auto &key : sequence)
+			key = dist(random);
+		return sequence;
+	}
+
+	std::vector<double> cdf(keys);
+	double sum = 0;
+	for (uint32_t i = 0; i < keys; ++i) {
+		sum += 1. / std::pow(double(i + 1), s);
+		cdf[i] = sum;
+	}
+
+	std::uniform_real_distribution<double> dist(0, sum);
+	for (auto &key : sequence) {
+		auto it = std::lower_bound(cdf.begin(), cdf.end(), dist(random));
+		key = std::min<uint32_t>(it - cdf.begin(), keys - 1);
+	}
+
+	/* the hottest keys should not be neighbours in the id space */
+	std::vector<uint32_t> permutation(keys);
+	for (uint32_t i = 0; i < keys; ++i)
+		permutation[i] = i;
+	std::shuffle(permutation.begin(), permutation.end(), random);
+	for (auto &key : sequence)
+		key = permutation[key];
+
+	return sequence;
+}
+
+std::vector<dnet_raw_id> random_ids(size_t count, unsigned seed)
+{
+	std::mt19937_64 random(seed);
+	std::vector<dnet_raw_id> ids(count);
+
+	for (auto &id : ids) {
+		for (size_t i = 0; i < DNET_ID_SIZE; i += sizeof(uint64_t)) {
+			const uint64_t value = random();
+			memcpy(id.id + i, &value, std::min(sizeof(value), DNET_ID_SIZE - i));
+		}
+	}
+
+	return ids;
+}
+
+static const size_t sequence_size = 1 << 16;
+
+/*
+ * Benchmark is created anew for every measurement, setup() is called before threads are started
+ * and run() is called by every thread with the same number of iterations
+ */
+class benchmark
+{
+public:
+	virtual ~benchmark() {}
+	virtual void setup(size_t threads) { (void) threads; }
+	virtual void run(size_t thread, size_t iterations) = 0;
+};
+
+struct benchmark_entry
+{
+	std::string name;
+	std::function<benchmark *()> create;
+	std::vector<size_t> threads;
+};
+
+/*
+ * Push, pop and release of requests with keys from the sequence, every thread keeps @depth requests in the queue.
+ * Popped request may belong to another thread, it is pushed again by the thread which has popped it.
+ * Read requests share locks of their keys, write requests lock them exclusively.
+ */
+class request_queue_benchmark : public benchmark
+{
+public:
+	request_queue_benchmark(uint32_t keys, double zipf, int command)
+	: m_keys(keys), m_zipf(zipf), m_command(command), m_queue(nullptr) {}
+
+	~request_queue_benchmark() {
+		drain();
+		dnet_request_queue_destroy(m_queue);
+		for (auto r : m_requests)
+			free(r);
+	}
+
+	void setup(size_t threads) {
+		memset(&m_pool, 0, sizeof(m_pool));
+		m_wio.resize(threads);
+		m_pool.num = threads;
+		m_pool.wio_list = m_wio.data();
+		m_pool.request_queue = m_queue = dnet_request_queue_create(1, threads);
+		if (!m_queue)
+			throw std::bad_alloc();
+
+		m_ids = random_ids(m_keys, 1);
+		m_free.resize(threads);
+
+		for (size_t i = 0; i < threads; ++i) {
+			dnet_work_io &wio = m_wio[i];
+			memset(&wio, 0, sizeof(wio));
+			INIT_LIST_HEAD(&wio.reply_list);
+			INIT_LIST_HEAD(&wio.request_list);
+			wio.thread_index = i;
+			wio.trans = ~0ULL;
+			wio.pool = &m_pool;
+
+			m_sequences.push_back(key_sequence(m_keys, m_zipf, sequence_size, i + 1));
+
+			for (size_t j = 0; j < depth; ++j) {
+				auto r = static_cast<request *>(calloc(1, sizeof(request)));
+				if (!r)
+					throw std::bad_alloc();
+
+				INIT_LIST_HEAD(&r->req.req_entry);
+				r->req.header = &r->cmd;
+				r->req.hsize = sizeof(r->cmd);
+				r->cmd.cmd = m_command;
+				m_requests.push_back(r);
+				m_free[i].push_back(r);
+			}
+
+			/* the last one is pushed by run() before every pop */
+			for (size_t j = 1; j < depth; ++j)
+				push(i, j);
+		}
+	}
+
+	void run(size_t thread, size_t iterations) {
+		dnet_work_io *wio = &m_wio[thread];
+		std::vector<request *> &free_requests = m_free[thread];
+
+		for (size_t i = 0; i < iterations; ++i) {
+			push(thread, i);
+
+			/*
+			 * Pop may find nothing if other threads have taken all requests or keys are locked,
+			 * they push new requests, so the next try succeeds
+			 */
+			dnet_io_req *req;
+			while (!(req = dnet_pop_request(wio, "microbench")))
+				;
+
+			dnet_release_request(wio, req);
+			free_requests.push_back(reinterpret_cast<request *>(req));
+		}
+
+		/*
+		 * Requests moved into this thread's lists are waiting for it to release their keys,
+		 * nobody else will take them after this thread has finished
+		 */
+		while (!list_empty(&wio->request_list) || !list_empty(&wio->reply_list)) {
+			dnet_io_req *req = dnet_pop_request(wio, "microbench");
+			if (req) {
+				dnet_release_request(wio, req);
+				free_requests.push_back(reinterpret_cast<request *>(req));
+			}
+		}
+	}
+
+private:
+	struct request {
+		dnet_io_req	req;
+		dnet_cmd	cmd;
+	};
+
+	static const size_t depth = 4;
+
+	void push(size_t thread, size_t i) {
+		request *r = m_free[thread].back();
+		m_free[thread].pop_back();
+
+		memcpy(r->cmd.id.id, m_ids[m_sequences[thread][i % sequence_size]].id, DNET_ID_SIZE);
+		dnet_push_request(&m_pool, &r->req);
+	}
+
+	/*
+	 * Takes all requests left in the queue, so queue does not free them,
+	 * threads have already taken requests from their own lists
+	 */
+	void drain() {
+		if (!m_queue)
+			return;
+
+		list_stat stats;
+		for (dnet_get_pool_list_stats(&m_pool, &stats); stats.list_size; dnet_get_pool_list_stats(&m_pool, &stats)) {
+			dnet_io_req *req = dnet_pop_request(&m_wio[0], "microbench");
+			if (req)
+				dnet_release_request(&m_wio[0], req);
+		}
+	}
+
+	uint32_t m_keys;
+	double m_zipf;
+	int m_command;
+	void *m_queue;
+	dnet_work_pool m_pool;
+	std::vector<dnet_work_io> m_wio;
+	std::vector<dnet_raw_id> m_ids;
+	std::vector<std::vector<uint32_t>> m_sequences;
+	std::vector<request *> m_requests;
+	std::vector<std::vector<request *>> m_free;
+};
+
+/*
+ * Lookups of in-flight transactions and insert/remove cycles of the state's transaction table,
+ * callers hold st->trans_lock, so it is measured by single thread
+ */
+class trans_table_benchmark : public benchmark
+{
+public:
+	trans_table_benchmark(size_t in_flight, bool lookup) : m_in_flight(in_flight), m_lookup(lookup), m_next(0) {
+		m_state = static_cast<dnet_net_state *>(calloc(1, sizeof(dnet_net_state)));
+		if (!m_state)
+			throw std::bad_alloc();
+
+		dnet_state_trans_init(m_state);
+	}
+
+	~trans_table_benchmark() {
+		for (auto t : m_trans) {
+			if (t->in_trans_table)
+				dnet_trans_remove_nolock(m_state, t);
+			free(t);
+		}
+		free(m_state->trans_table.slots);
+		free(m_state);
+	}
+
+	void setup(size_t threads) {
+		(void) threads;
+
+		for (size_t i = 0; i < m_in_flight; ++i) {
+			auto t = static_cast<dnet_trans *>(calloc(1, sizeof(dnet_trans)));
+			if (!t)
+				throw std::bad_alloc();
+
+			INIT_LIST_HEAD(&t->timer_entry);
+			atomic_init(&t->refcnt, 1);
+			m_trans.push_back(t);
+			insert(t);
+		}
+
+		m_sequence = key_sequence(m_in_flight, 0, sequence_size, 1);
+	}
+
+	void run(size_t thread, size_t iterations) {
+		(void) thread;
+
+		for (size_t i = 0; i < iterations; ++i) {
+			dnet_trans *t = m_trans[m_sequence[i % sequence_size]];
+
+			if (m_lookup) {
+				dnet_trans_put(dnet_trans_search(m_state, t->trans));
+			} else {
+				/* transaction completes and the next one is sent with new number */
+				dnet_trans_remove_nolock(m_state, t);
+				insert(t);
+			}
+		}
+	}
+
+private:
+	void insert(dnet_trans *t) {
+		t->trans = m_next++;
+		if (dnet_trans_insert_nolock(m_state, t))
+			throw std::runtime_error("failed to insert transaction");
+	}
+
+	size_t m_in_flight;
+	bool m_lookup;
+	uint64_t m_next;
+	dnet_net_state *m_state;
+	std::vector<dnet_trans *> m_trans;
+	std::vector<uint32_t> m_sequence;
+};
+
+/*
+ * dnet_route_table_search() over @groups groups of @ids ids each, it shares dnet_ids_search()
+ * with dnet_idc_search() of the states' groups
+ */
+class route_search_benchmark : public benchmark
+{
+public:
+	route_search_benchmark(int groups, int ids) : m_groups(groups), m_ids(ids) {
+		m_state = static_cast<dnet_net_state *>(calloc(1, sizeof(dnet_net_state)));
+		if (!m_state)
+			throw std::bad_alloc();
+
+		atomic_init(&m_state->refcnt, 1);
+	}
+
+	~route_search_benchmark() {
+		free(m_state);
+	}
+
+	void setup(size_t threads) {
+		m_entries.resize(m_groups);
+		m_prefixes.resize(m_groups);
+		m_table_groups.resize(m_groups);
+
+		for (int g = 0; g < m_groups; ++g) {
+			auto ids = random_ids(m_ids, g + 1);
+			std::sort(ids.begin(), ids.end(), [] (const dnet_raw_id &a, const dnet_raw_id &b) {
+				return dnet_id_cmp_str(a.id, b.id) < 0;
+			});
+
+			m_entries[g].resize(m_ids);
+			m_prefixes[g].resize(m_ids);
+			for (int i = 0; i < m_ids; ++i) {
+				m_entries[g][i].raw = ids[i];
+				m_entries[g][i].st = m_state;
+				m_entries[g][i].backend_id = i % 16;
+				m_prefixes[g][i] = dnet_id_prefix(ids[i].id);
+			}
+
+			dnet_route_group &group = m_table_groups[g];
+			memset(&group, 0, sizeof(group));
+			group.group_id = g + 1;
+			group.id_num = m_ids;
+			group.ids = m_entries[g].data();
+			group.id_prefixes = m_prefixes[g].data();
+		}
+
+		memset(&m_table, 0, sizeof(m_table));
+		m_table.group_num = m_groups;
+		m_table.groups = m_table_groups.data();
+
+		for (size_t i = 0; i < threads; ++i)
+			m_keys.push_back(random_ids(sequence_size, 1000 + i));
+	}
+
+	void run(size_t thread, size_t iterations) {
+		const std::vector<dnet_raw_id> &keys = m_keys[thread];
+		dnet_id id;
+		int backend_id;
+
+		memset(&id, 0, sizeof(id));
+
+		for (size_t i = 0; i < iterations; ++i) {
+			memcpy(id.id, keys[i % sequence_size].id, DNET_ID_SIZE);
+			id.group_id = i % m_groups + 1;
+
+			dnet_net_state *st = dnet_route_table_search(&m_table, &id, &backend_id);
+			if (st)
+				atomic_dec(&st->refcnt);
+		}
+	}
+
+private:
+	int m_groups;
+	int m_ids;
+	dnet_net_state *m_state;
+	dnet_route_table m_table;
+	std::vector<dnet_route_group> m_table_groups;
+	std::vector<std::vector<dnet_route_table_entry>> m_entries;
+	std::vector<std::vector<uint64_t>> m_prefixes;
+	std::vector<std::vector<dnet_raw_id>> m_keys;
+};
+
+struct treap_bench_node
+{
+	typedef uint64_t key_type;
+	typedef uint64_t priority_type;
+
+	treap_bench_node(uint64_t key, uint64_t priority) : l(NULL), r(NULL), key(key), priority(priority) {}
+
+	key_type get_key() const { return key; }
+	priority_type get_priority() const { return priority; }
+
+	static int key_compare(const key_type &lhs, const key_type &rhs) {
+		return (lhs < rhs) ? -1 : (lhs > rhs);
+	}
+
+	static int priority_compare(const priority_type &lhs, const priority_type &rhs) {
+		return (lhs < rhs) ? -1 : (lhs > rhs);
+	}
+
+	treap_bench_node *l;
+	treap_bench_node *r;
+	uint64_t key;
+	uint64_t priority;
+};
+
+/*
+ * cache::treap lookups or priority updates (decrease_key()) of @keys nodes, treap is not thread-safe
+ */
+class treap_benchmark : public benchmark
+{
+public:
+	treap_benchmark(uint32_t keys, double zipf, bool update) : m_keys(keys), m_zipf(zipf), m_update(update) {}
+
+	void setup(size_t threads) {
+		(void) threads;
+
+		std::mt19937_64 random(1);
+		for (uint32_t i = 0; i < m_keys; ++i) {
+			m_nodes.push_back(new treap_bench_node(i, random()));
+			m_treap.insert(m_nodes.back());
+		}
+
+		m_sequence = key_sequence(m_keys, m_zipf, sequence_size, 1);
+	}
+
+	void run(size_t thread, size_t iterations) {
+		(void) thread;
+
+		for (size_t i = 0; i < iterations; ++i) {
+			const uint32_t key = m_sequence[i % sequence_size];
+
+			if (m_update) {
+				treap_bench_node *node = m_nodes[key];
+				m_treap.erase(node);
+				node->priority = (node->priority >> 1) + i;
+				m_treap.insert(node);
+			} else if (!m_treap.find(key)) {
+				throw std::logic_error("treap: key not found");
+			}
+		}
+	}
+
+private:
+	uint32_t m_keys;
+	double m_zipf;
+	bool m_update;
+	/* owns the nodes */
+	cache::treap<treap_bench_node> m_treap;
+	std::vector<treap_bench_node *> m_nodes;
+	std::vector<uint32_t> m_sequence;
+};
+
+/*
+ * Operations of slru_cache_t on its in-memory structures: read hit takes shared lock, looks up the index,
+ * marks object referenced, counts it in admission sketch and promotes it into hotter page if exclusive lock
+ * is free; write takes exclusive lock, inserts missed objects into the coldest page and evicts from pages
+ * which have overflowed. The cache itself requires running backend, so its structures are driven
+ * the way slru_cache_t drives them, disk IO and replies are not included.
+ */
+class slru_benchmark : public benchmark
+{
+public:
+	slru_benchmark(uint32_t keys, double zipf, bool write) :
+	m_keys(keys), m_zipf(zipf), m_write(write), m_sketch(keys), m_pages(pages_number), m_pages_sizes(pages_number, 0) {}
+
+	~slru_benchmark() {
+		for (auto &page : m_pages) {
+			while (!page.empty()) {
+				data_t *obj = &page.front();
+				page.pop_front();
+				obj->set_removed_from_page(true);
+				delete obj;
+			}
+		}
+	}
+
+	void setup(size_t threads) {
+		m_ids = random_ids(m_keys, 1);
+		m_value.reset(new cache::raw_data_t(std::string(object_size, 'a').data(), object_size));
+
+		/* cache fits a half of all keys */
+		const size_t capacity = m_keys / 2 * object_size;
+		for (size_t i = 0; i < pages_number; ++i)
+			m_pages_max_sizes.push_back(capacity / pages_number);
+
+		for (uint32_t i = 0; i < m_keys; ++i)
+			write(m_ids[i].id);
+
+		for (size_t i = 0; i < threads; ++i)
+			m_sequences.push_back(key_sequence(m_keys, m_zipf, sequence_size, i + 1));
+	}
+
+	void run(size_t thread, size_t iterations) {
+		const std::vector<uint32_t> &sequence = m_sequences[thread];
+
+		for (size_t i = 0; i < iterations; ++i) {
+			const unsigned char *id = m_ids[sequence[i % sequence_size]].id;
+
+			if (m_write || !read_hit(id)) {
+				std::unique_lock<cache::rw_mutex> guard(m_lock);
+				write(id);
+			}
+		}
+	}
+
+private:
+	typedef cache::data_t data_t;
+
+	static const size_t pages_number = 2;
+	static const size_t object_size = 1024;
+
+	bool read_hit(const unsigned char *id) {
+		bool need_promote;
+		{
+			cache::shared_lock_guard guard(m_lock);
+
+			auto it = m_index.find(id);
+			if (it == m_index.end())
+				return false;
+
+			data_t *obj = it->second;
+			obj->set_referenced();
+			m_sketch.increment(id);
+
+			std::shared_ptr<cache::raw_data_t> data = obj->data();
+			need_promote = obj->cache_page_number() != 0;
+		}
+
+		if (need_promote) {
+			std::unique_lock<cache::rw_mutex> guard(m_lock, std::try_to_lock);
+			if (guard.owns_lock()) {
+				auto it = m_index.find(id);
+				if (it != m_index.end() && !it->second->is_removed_from_page()) {
+					data_t *obj = it->second;
+					const size_t page = obj->cache_page_number();
+
+					obj->clear_referenced();
+					remove_from_page(obj);
+					insert_into_page(obj, page - 1);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/* must be called under exclusive lock */
+	void write(const unsigned char *id) {
+		m_sketch.increment(id);
+
+		auto it = m_index.find(id);
+		data_t *obj;
+		size_t page = pages_number - 1;
+
+		if (it == m_index.end()) {
+			obj = new data_t(id);
+			obj->set_data(m_value, false);
+			m_index.insert(std::make_pair(obj->id().id, obj));
+		} else {
+			obj = it->second;
+			page = obj->cache_page_number() ? obj->cache_page_number() - 1 : 0;
+			remove_from_page(obj);
+		}
+
+		insert_into_page(obj, page);
+	}
+
+	void remove_from_page(data_t *obj) {
+		const size_t page = obj->cache_page_number();
+
+		m_pages_sizes[page] -= obj->size();
+		m_pages[page].erase(m_pages[page].iterator_to(*obj));
+		obj->set_removed_from_page(true);
+	}
+
+	/* objects pushed out of the coldest page are evicted from the cache, others move into colder page */
+	void insert_into_page(data_t *obj, size_t page) {
+		while (m_pages_sizes[page] + obj->size() > m_pages_max_sizes[page] && !m_pages[page].empty()) {
+			data_t *victim = &m_pages[page].front();
+
+			remove_from_page(victim);
+			if (page + 1 < pages_number) {
+				insert_into_page(victim, page + 1);
+			} else {
+				m_index.erase(victim->id().id);
+				delete victim;
+			}
+		}
+
+		obj->set_cache_page_number(page);
+		m_pages[page].push_back(*obj);
+		m_pages_sizes[page] += obj->size();
+	}
+
+	uint32_t m_keys;
+	double m_zipf;
+	bool m_write;
+	cache::rw_mutex m_lock;
+	cache::frequency_sketch m_sketch;
+	cache::data_index_t m_index;
+	std::vector<cache::lru_list_t> m_pages;
+	std::vector<size_t> m_pages_sizes;
+	std::vector<size_t> m_pages_max_sizes;
+	std::shared_ptr<cache::raw_data_t> m_value;
+	std::vector<dnet_raw_id> m_ids;
+	std::vector<std::vector<uint32_t>> m_sequences;
+};
+
+/*
+ * dnet_iterator_response_container_sort() of @count unsorted responses, every iteration
+ * rewrites the file with the same unsorted responses first
+ */
+class iterator_sort_benchmark : public benchmark
+{
+public:
+	iterator_sort_benchmark(size_t count) : m_count(count), m_file(nullptr) {}
+
+	~iterator_sort_benchmark() {
+		if (m_file)
+			fclose(m_file);
+	}
+
+	void setup(size_t threads) {
+		(void) threads;
+
+		m_file = tmpfile();
+		if (!m_file)
+			throw std::runtime_error("failed to create temporary file");
+
+		auto ids = random_ids(m_count, 1);
+		m_responses.resize(m_count);
+		for (size_t i = 0; i < m_count; ++i) {
+			memset(&m_responses[i], 0, sizeof(m_responses[i]));
+			m_responses[i].key = ids[i];
+			m_responses[i].size = i;
+		}
+	}
+
+	void run(size_t thread, size_t iterations) {
+		(void) thread;
+
+		const int fd = fileno(m_file);
+		const size_t size = m_responses.size() * sizeof(dnet_iterator_response);
+
+		for (size_t i = 0; i < iterations; ++i) {
+			if (pwrite(fd, m_responses.data(), size, 0) != (ssize_t)size)
+				throw std::runtime_error("failed to write responses");
+
+			int err = dnet_iterator_response_container_sort(fd, size);
+			if (err)
+				throw std::runtime_error("sort failed: " + boost::lexical_cast<std::string>(err));
+		}
+	}
+
+private:
+	size_t m_count;
+	FILE *m_file;
+	std::vector<dnet_iterator_response> m_responses;
+};
+
+struct measurement
+{
+	size_t iterations;
+	double seconds;
+};
+
+measurement measure(const benchmark_entry &entry, size_t threads, double min_time)
+{
+	measurement result;
+	size_t iterations = 1;
+
+	while (1) {
+		std::unique_ptr<benchmark> bench(entry.create());
+		bench->setup(threads);
+
+		std::atomic<size_t> ready(0);
+		std::atomic<bool> go(false);
+		std::vector<std::thread> workers;
+
+		for (size_t i = 0; i < threads; ++i) {
+			workers.emplace_back([&, i] () {
+				++ready;
+				while (!go.load())
+					std::this_thread::yield();
+				bench->run(i, iterations);
+			});
+		}
+
+		while (ready.load() != threads)
+			std::this_thread::yield();
+
+		const auto start = std::chrono::steady_clock::now();
+		go = true;
+		for (auto &t : workers)
+			t.join();
+		const auto end = std::chrono::steady_clock::now();
+
+		result.iterations = iterations;
+		result.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+
+		if (result.seconds >= min_time || iterations >= (1ULL << 32))
+			return result;
+
+		/* aim a bit above the minimal time, like google benchmark does */
+		double multiplier = result.seconds > 0 ? min_time * 1.4 / result.seconds : 10;
+		multiplier = std::max(2., std::min(multiplier, 10.));
+		iterations *= multiplier;
+	}
+}
+
+std::vector<benchmark_entry> benchmarks(const std::vector<size_t> &threads)
+{
+	std::vector<benchmark_entry> result;
+	const std::vector<size_t> single(1, 1);
+
+	const struct {
+		const char *name;
+		double zipf;
+	} distributions[] = {
+		{ "uniform", 0 },
+		{ "zipf", 0.99 },
+	};
+
+	for (auto &d : distributions) {
+		const double zipf = d.zipf;
+
+		for (uint32_t keys : { 1024, 1 << 20 }) {
+			const std::string suffix = std::string("/") + d.name + "/keys:" + boost::lexical_cast<std::string>(keys);
+
+			result.push_back({ "request_queue/read" + suffix, [=] () -> benchmark * {
+				return new request_queue_benchmark(keys, zipf, DNET_CMD_READ);
+			}, threads });
+			result.push_back({ "request_queue/write" + suffix, [=] () -> benchmark * {
+				return new request_queue_benchmark(keys, zipf, DNET_CMD_WRITE);
+			}, threads });
+			result.push_back({ "treap/find" + suffix, [=] () -> benchmark * {
+				return new treap_benchmark(keys, zipf, false);
+			}, single });
+			result.push_back({ "treap/update" + suffix, [=] () -> benchmark * {
+				return new treap_benchmark(keys, zipf, true);
+			}, single });
+			result.push_back({ "slru/read" + suffix, [=] () -> benchmark * {
+				return new slru_benchmark(keys, zipf, false);
+			}, threads });
+			result.push_back({ "slru/write" + suffix, [=] () -> benchmark * {
+				return new slru_benchmark(keys, zipf, true);
+			}, threads });
+		}
+	}
+
+	for (size_t in_flight : { 64, 4096, 262144 }) {
+		const std::string suffix = "/in_flight:" + boost::lexical_cast<std::string>(in_flight);
+
+		result.push_back({ "trans_table/search" + suffix, [=] () -> benchmark * {
+			return new trans_table_benchmark(in_flight, true);
+		}, single });
+		result.push_back({ "trans_table/insert_remove" + suffix, [=] () -> benchmark * {
+			return new trans_table_benchmark(in_flight, false);
+		}, single });
+	}
+
+	for (int groups : { 1, 16 }) {
+		for (int ids : { 1024, 65536 }) {
+			result.push_back({ "route_search/groups:" + boost::lexical_cast<std::string>(groups) +
+					"/ids:" + boost::lexical_cast<std::string>(ids), [=] () -> benchmark * {
+				return new route_search_benchmark(groups, ids);
+			}, threads });
+		}
+	}
+
+	for (size_t count : { 100000, 1000000 }) {
+		result.push_back({ "iterator_sort/responses:" + boost::lexical_cast<std::string>(count), [=] () -> benchmark * {
+			return new iterator_sort_benchmark(count);
+		}, single });
+	}
+
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	std::string filter, threads_list, output;
+	double min_time;
+
+	bpo::options_description generic("Microbenchmark options");
+	generic.add_options()
+		("help", "This help message")
+		("list", "List benchmarks and exit")
+		("filter", bpo::value(&filter), "Run only benchmarks which names contain this substring")
+		("threads", bpo::value(&threads_list)->default_value("1,4,16"),
+			"Comma separated numbers of threads for thread-safe structures")
+		("time", bpo::value(&min_time)->default_value(0.5), "Minimal time of every measurement in seconds")
+		("output", bpo::value(&output), "File to write JSON results to")
+		;
+
+	bpo::variables_map vm;
+	try {
+		bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+		bpo::notify(vm);
+	} catch (std::exception &e) {
+		std::cerr << "Invalid options: " << e.what() << std::endl << generic;
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return 0;
+	}
+
+	std::vector<size_t> threads;
+	try {
+		std::vector<std::string> parts;
+		boost::split(parts, threads_list, boost::is_any_of(","));
+		for (auto it = parts.begin(); it != parts.end(); ++it)
+			threads.push_back(std::max<size_t>(boost::lexical_cast<size_t>(*it), 1));
+	} catch (std::exception &e) {
+		std::cerr << "Invalid threads: " << e.what() << std::endl;
+		return 1;
+	}
+
+	const std::vector<benchmark_entry> entries = benchmarks(threads);
+
+	if (vm.count("list")) {
+		for (auto &entry : entries)
+			std::cout << entry.name << std::endl;
+		return 0;
+	}
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	auto &allocator = doc.GetAllocator();
+	rapidjson::Value results(rapidjson::kObjectType);
+	bool failed = false;
+
+	std::cout << std::left << std::setw(56) << "Benchmark"
+		<< std::right << std::setw(14) << "ns/op"
+		<< std::setw(16) << "ops/s"
+		<< std::setw(14) << "iterations" << std::endl;
+
+	for (auto &entry : entries) {
+		if (!filter.empty() && entry.name.find(filter) == std::string::npos)
+			continue;
+
+		for (size_t thread_count : entry.threads) {
+			const std::string name = entry.name + "/threads:" + boost::lexical_cast<std::string>(thread_count);
+
+			try {
+				const measurement m = measure(entry, thread_count, min_time);
+				const double ops = double(m.iterations) * thread_count;
+
+				/* time per operation of single thread, throughput of all threads */
+				std::cout << std::left << std::setw(56) << name
+					<< std::right << std::fixed << std::setprecision(1)
+					<< std::setw(14) << m.seconds * 1e9 / m.iterations
+					<< std::setw(16) << std::setprecision(0) << ops / m.seconds
+					<< std::setw(14) << m.iterations << std::endl;
+
+				rapidjson::Value result(rapidjson::kObjectType);
+				result.AddMember("ns_per_op", m.seconds * 1e9 / m.iterations, allocator);
+				result.AddMember("ops_per_sec", ops / m.seconds, allocator);
+				result.AddMember("iterations", (uint64_t)m.iterations, allocator);
+				result.AddMember("threads", (uint64_t)thread_count, allocator);
+
+				rapidjson::Value key(name.c_str(), allocator);
+				results.AddMember(key, result, allocator);
+			} catch (std::exception &e) {
+				std::cout << std::left << std::setw(56) << name << " failed: " << e.what() << std::endl;
+				failed = true;
+			}
+		}
+	}
+
+	doc.AddMember("benchmarks", results, allocator);
+
+	if (!output.empty()) {
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		doc.Accept(writer);
+
+		std::ofstream out(output.c_str(), std::ofstream::trunc);
+		out << buffer.GetString() << std::endl;
+		if (!out) {
+			std::cerr << "Failed to write results to " << output << std::endl;
+			return 1;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
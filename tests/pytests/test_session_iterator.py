@@ -14,6 +14,7 @@
 # =============================================================================
 
 import sys
+import struct
 sys.path.insert(0, "")  # for running from cmake
 from conftest import make_session
 import pytest
@@ -254,3 +255,325 @@ class TestSession:
             time_end=end_time)
 
         check_iterator_results(node, backend, iterator, session, node_id, True)
+
+    def test_iterate_hash_ranges(self, server, simple_node):
+        '''
+        Runs hash iterator on first node/backend from route-list with using all ranges covered by it.
+        Checks that it returns one summary per range, that summaries count the same keys
+        as network iterator and that they don't change between runs.
+        '''
+        import struct
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_hash_ranges')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+        node_ranges = session.routes.get_address_backend_ranges(node, backend)
+
+        def summaries():
+            iterator = session.start_iterator(
+                id=node_id,
+                ranges=convert_ranges(node_ranges),
+                type=elliptics.iterator_types.hash,
+                flags=elliptics.iterator_flags.key_range,
+                time_begin=elliptics.Time(0, 0),
+                time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+            # hash, keys and size follow key_begin and key_end of struct dnet_iterator_range_hash
+            return [struct.unpack_from('<QQQ', r.response_data, 128)
+                    for r in iterator if r.status == 0 and r.response.status == 0]
+
+        first = summaries()
+        assert len(first) == len(node_ranges)
+        assert first == summaries()
+
+        iterator = session.start_iterator(
+            id=node_id,
+            ranges=convert_ranges(node_ranges),
+            type=elliptics.iterator_types.network,
+            flags=elliptics.iterator_flags.key_range,
+            time_begin=elliptics.Time(0, 0),
+            time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+        keys = len([r for r in iterator if r.response.status == 0])
+
+        assert sum(s[1] for s in first) == keys
+
+    def test_iterate_filter(self, server, simple_node):
+        '''
+        Runs test_count native filter on first node/backend from route-list with using all ranges covered by it.
+        Checks that only its single result is returned and that it counts the same keys as network iterator.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_filter')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+        node_ranges = session.routes.get_address_backend_ranges(node, backend)
+
+        iterator = session.start_filter_iterator(
+            id=node_id,
+            ranges=convert_ranges(node_ranges),
+            filter='test_count',
+            flags=elliptics.iterator_flags.key_range,
+            time_begin=elliptics.Time(0, 0),
+            time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+        results = [r for r in iterator if r.status == 0 and r.response.status == 0]
+        assert len(results) == 1
+        filtered_keys, filtered_size = struct.unpack('<QQ', results[0].response_data)
+
+        iterator = session.start_iterator(
+            id=node_id,
+            ranges=convert_ranges(node_ranges),
+            type=elliptics.iterator_types.network,
+            flags=elliptics.iterator_flags.key_range,
+            time_begin=elliptics.Time(0, 0),
+            time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+        responses = [r.response for r in iterator if r.response.status == 0]
+
+        assert filtered_keys == len(responses)
+        assert filtered_size == sum(r.size for r in responses)
+
+    def test_iterate_copy_diff(self, server, simple_node):
+        '''
+        Runs copy iterator with diff flag on first node/backend from route-list to its own group.
+        Since the group already has every key with the same timestamp, nothing should be sent
+        and iterator should return keepalives only.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_copy_diff')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+        node_ranges = session.routes.get_address_backend_ranges(node, backend)
+
+        iterator = session.start_copy_iterator(
+            node_id,
+            convert_ranges(node_ranges),
+            [node_id.group_id],
+            elliptics.iterator_flags.key_range | elliptics.iterator_flags.diff,
+            elliptics.Time(0, 0),
+            elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+
+        for result in iterator:
+            assert result.status == 0
+            assert result.response.status != 0, "key {0} has been sent to the group which has it".format(
+                result.response.key)
+
+    def test_iterate_copy_bulk_write(self, server, simple_node):
+        '''
+        Runs copy iterator with bulk_write flag on first node/backend from route-list to its own group.
+        Every key is still replied separately and rejected by timestamp check since group has the same key.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_copy_bulk_write')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+        node_ranges = session.routes.get_address_backend_ranges(node, backend)
+
+        iterator = session.start_iterator(
+            id=node_id,
+            ranges=convert_ranges(node_ranges),
+            type=elliptics.iterator_types.network,
+            flags=elliptics.iterator_flags.key_range,
+            time_begin=elliptics.Time(0, 0),
+            time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+        keys = set(str(r.response.key) for r in iterator if r.response.status == 0)
+
+        iterator = session.start_copy_iterator(
+            node_id,
+            convert_ranges(node_ranges),
+            [node_id.group_id],
+            elliptics.iterator_flags.key_range | elliptics.iterator_flags.bulk_write,
+            elliptics.Time(0, 0),
+            elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+        results = [r for r in iterator]
+
+        assert all(r.status == 0 for r in results)
+        # status 1 marks keepalive responses
+        assert set(str(r.response.key) for r in results if r.response.status != 1) == keys
+
+    def test_iterate_parallel(self, server, simple_node):
+        '''
+        Runs iterator on first node/backend from route-list in one and in several threads.
+        Both iterations should return the same keys.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_parallel')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+
+        def iterate(threads):
+            session.iterator_threads = threads
+            iterator = session.start_iterator(
+                id=node_id,
+                ranges=[],
+                type=elliptics.iterator_types.network,
+                flags=elliptics.iterator_flags.default,
+                time_begin=elliptics.Time(0, 0),
+                time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+            results = [r for r in iterator]
+            assert all(r.status == 0 for r in results)
+            return sorted(str(r.response.key) for r in results if r.response.status == 0)
+
+        keys = iterate(1)
+        assert iterate(4) == keys
+
+    def test_iterate_compact(self, server, simple_node):
+        '''
+        Runs iterator on first node/backend from route-list with and without compact flag.
+        Unpacked compact responses should be equal to ordinary ones.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_compact')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+
+        def iterate(flags):
+            iterator = session.start_iterator(
+                id=node_id,
+                ranges=[],
+                type=elliptics.iterator_types.network,
+                flags=flags,
+                time_begin=elliptics.Time(0, 0),
+                time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+            results = [r for r in iterator]
+            assert all(r.status == 0 for r in results)
+            return sorted((str(r.response.key), r.response.timestamp, r.response.size, r.response.user_flags)
+                          for r in results if r.response.status == 0)
+
+        assert iterate(elliptics.iterator_flags.compact) == iterate(elliptics.iterator_flags.default)
+
+    def test_iterate_changes(self, server, simple_node):
+        '''
+        Writes and removes a key and iterates changes of its backend since the last change before the write.
+        Only these two changes should be returned in order they have been made.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_changes')
+        group = session.routes.groups()[0]
+        session.groups = [group]
+        key = 'test_iterate_changes'
+
+        result = session.write_data(key, 'change').get()[0]
+        node_id = session.routes.get_address_backend_route_id(result.address, result.backend_id)
+
+        def changes(since):
+            results = [r for r in session.start_changes_iterator(node_id, [], since)]
+            assert all(r.status == 0 for r in results)
+            return [r.response for r in results if r.response.status == 0]
+
+        all_changes = changes(0)
+        assert all_changes
+        assert str(all_changes[-1].key) == str(session.transform(key))
+        cursor = all_changes[-1].change_time
+
+        session.remove(key).get()
+        session.write_data(key, 'change again').get()
+
+        new_changes = changes(cursor)
+        assert [str(r.key) for r in new_changes] == [str(session.transform(key))] * 2
+        assert new_changes[0].record_flags & 1, "removal is marked by DNET_RECORD_FLAGS_REMOVE"
+        assert new_changes[0].change_time > cursor
+        assert new_changes[1].change_time > new_changes[0].change_time
+        assert new_changes[1].size == len('change again')
+
+    def test_iterate_resumable(self, server, simple_node):
+        '''
+        Runs resumable iterator on first node/backend from route-list from the beginning,
+        it should return the same keys as ordinary iterator. Checkpoint which refers
+        to unknown blob should fail iteration.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_resumable')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+        time_begin, time_end = elliptics.Time(0, 0), elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1)
+
+        def keys(iterator):
+            results = [r for r in iterator]
+            assert all(r.status == 0 for r in results)
+            return sorted(str(r.response.key) for r in results if r.response.status == 0)
+
+        expected = keys(session.start_iterator(id=node_id,
+                                               ranges=[],
+                                               type=elliptics.iterator_types.network,
+                                               flags=elliptics.iterator_flags.default,
+                                               time_begin=time_begin,
+                                               time_end=time_end))
+        assert keys(session.start_resumable_iterator(node_id, [], elliptics.iterator_flags.default,
+                                                     time_begin, time_end)) == expected
+
+        # blob, position, iterated_keys and reserved fields of struct dnet_iterator_checkpoint
+        checkpoint = struct.pack('<5Q', 2 ** 63 + 1, 1, 0, 0, 0)
+        with pytest.raises(elliptics.Error):
+            session.start_resumable_iterator(node_id, [], elliptics.iterator_flags.default,
+                                             time_begin, time_end, checkpoint).get()
+
+    def test_iterate_ordered(self, server, simple_node):
+        '''
+        Runs ordered iterator on first node/backend from route-list, it should return the same keys
+        as ordinary iterator sorted by key. Merged results of two ordered iterators of the same backend
+        should contain every key from both of them.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_ordered')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+
+        def start(flags):
+            return session.start_iterator(
+                id=node_id,
+                ranges=[],
+                type=elliptics.iterator_types.network,
+                flags=flags,
+                time_begin=elliptics.Time(0, 0),
+                time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+
+        def keys(iterator):
+            results = [r for r in iterator]
+            assert all(r.status == 0 for r in results)
+            return [str(r.response.key) for r in results if r.response.status == 0]
+
+        expected = sorted(keys(start(elliptics.iterator_flags.default)))
+        ordered = keys(start(elliptics.iterator_flags.ordered))
+        assert sorted(ordered) == expected
+        # keys are ordered by raw id, its hex representation keeps the order
+        assert ordered == sorted(ordered)
+
+        merger = elliptics.IteratorResultMerger()
+        merger.add(start(elliptics.iterator_flags.ordered))
+        merger.add(start(elliptics.iterator_flags.ordered | elliptics.iterator_flags.compact))
+        merged = [responses for responses in merger]
+        assert [str(responses[0][1].key) for responses in merged] == ordered
+        assert all([index for index, response in responses] == [0, 1] for responses in merged)
+        assert merger.error(0).code == 0 and merger.error(1).code == 0
+
+    def test_iterate_columns(self, server, simple_node):
+        '''
+        Reads iterator result by columnar batches, they should hold the same keys and sizes
+        as ordinary iterator returns.
+        '''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_iterate_columns')
+        session.groups = session.routes.groups()
+        node_id, node, backend = iter(session.routes.get_unique_routes()[0])
+
+        def start():
+            return session.start_iterator(
+                id=node_id,
+                ranges=[],
+                type=elliptics.iterator_types.network,
+                flags=elliptics.iterator_flags.default,
+                time_begin=elliptics.Time(0, 0),
+                time_end=elliptics.Time(2 ** 64 - 1, 2 ** 64 - 1))
+
+        expected = sorted((bytes(bytearray(r.response.key.id)), r.response.size)
+                          for r in start() if r.response.status == 0)
+
+        columns = []
+        for batch in elliptics.IteratorResultColumns(start(), 3):
+            count = batch['count']
+            assert 0 < count <= 3
+            key = batch['key'].tobytes()
+            id_size = len(key) // count
+            sizes = struct.unpack('<{0}Q'.format(count), batch['size'].tobytes())
+            assert len(batch['timestamp'].tobytes()) == count * 8
+            columns += [(key[i * id_size:(i + 1) * id_size], sizes[i]) for i in range(count)]
+
+        assert sorted(columns) == expected
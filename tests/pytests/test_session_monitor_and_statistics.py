@@ -20,6 +20,14 @@ from datetime import datetime, timedelta
 from conftest import make_session
 
 import elliptics
+import json
+import zlib
+try:
+    import urllib.request as urllib_req
+    import urllib.error as urllib_err
+except ImportError:
+    import urllib2 as urllib_req
+    import urllib2 as urllib_err
 
 class MonitorStatsChecker:
     def __init__(self, address, session, categories):
@@ -237,6 +245,16 @@ class MonitorStatsChecker:
             assert global_stats['datasort_completion_time'] >= 0
             assert global_stats['datasort_completion_status'] >= 0
 
+            compression = backend['compression']
+            assert compression['codec'] in ('none', 'lz4')
+            assert compression['threshold'] >= 0
+            assert compression['compressed'] >= 0
+            assert compression['incompressible'] >= 0
+            assert compression['input_bytes'] >= compression['output_bytes'] >= 0
+            assert compression['decompressed'] >= 0
+            assert compression['decompress_errors'] == 0
+            assert compression['sent_compressed'] >= 0
+
             def check_base_stat(json):
                 '''checks one base statistics'''
                 assert json['records_total'] >= 0
@@ -268,6 +286,7 @@ class MonitorStatsChecker:
             assert config['blob_size_limit'] >= 0
             assert config['defrag_time'] >= 0
             assert config['defrag_splay'] >= 0
+            assert config['checksum_type'] in ('sha512', 'crc32c')
             assert config['group'] >= 0
             assert config['group'] == self.session.routes.get_address_backend_group(self.address, int(backend_id))
 
@@ -331,6 +350,15 @@ class MonitorStatsChecker:
             assert stat['mcode'] >= 0
             assert stat['mdata'] >= 0
 
+        huge_pages = procfs['huge_pages']
+        assert huge_pages['mode'] in ('none', 'madvise', '2m', '1g')
+        assert huge_pages['hugetlb_size'] >= 0
+        assert huge_pages['madvise_size'] >= 0
+        assert huge_pages['fallback_size'] >= 0
+        if huge_pages['error'] == 0:
+            assert huge_pages['anon_huge_pages'] >= 0
+            assert 0 <= huge_pages['huge_pages_free'] <= huge_pages['huge_pages_total']
+
 def categories_combination():
     '''generates different combination of elliptics.monitor_stat_categories for future use'''
     import itertools
@@ -366,3 +394,144 @@ class TestMonitor:
                                       session=session,
                                       categories=categories)
         checker.get_and_check()
+
+    def test_monitor_metrics(self, server, simple_node):
+        '''Scrapes OpenMetrics exposition of every node and checks selection of its families'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_metrics')
+        session.groups = session.routes.groups()
+        session.write_data('metrics_key', 'metrics_data').get()
+
+        for remote, port in zip(server.remotes, server.monitors):
+            url = 'http://' + remote.split(':')[0] + ':' + port + '/metrics'
+
+            metrics = urllib_req.urlopen(url).read().decode()
+            assert metrics.endswith('# EOF\n')
+            assert '# TYPE elliptics_commands counter' in metrics
+            assert '# TYPE elliptics_command_latency_usecs histogram' in metrics
+            assert '# TYPE elliptics_node_commands counter' in metrics
+
+            metrics = urllib_req.urlopen(url + '?families=latencies').read().decode()
+            assert '# TYPE elliptics_commands counter' not in metrics
+            assert '# TYPE elliptics_node_commands counter' not in metrics
+            for line in metrics.splitlines():
+                if line.startswith('elliptics_command_latency_usecs_bucket'):
+                    assert 'le="' in line
+
+    def test_monitor_profile(self, server, simple_node):
+        '''Takes short CPU profile and heap profile of every node'''
+        import struct
+        for remote, port in zip(server.remotes, server.monitors):
+            url = 'http://' + remote.split(':')[0] + ':' + port
+
+            profile = urllib_req.urlopen(url + '/profile/cpu?seconds=1').read()
+            word = struct.calcsize('P')
+            # legacy pprof header: 0, 3 header words, version 0, sampling period, padding
+            header = struct.unpack('5P', profile[:5 * word])
+            assert header[:3] == (0, 3, 0)
+            assert header[3] > 0
+            # address space map follows samples
+            assert b'r-xp' in profile
+
+            # heap profile is available only with profiling allocator
+            try:
+                assert urllib_req.urlopen(url + '/profile/heap').read()
+            except urllib_err.HTTPError as e:
+                assert e.code == 501
+
+    def test_monitor_generation(self, server, simple_node):
+        '''Requests report and then delta report since its generation'''
+        for remote, port in zip(server.remotes, server.monitors):
+            url = 'http://' + remote.split(':')[0] + ':' + port + '/procfs'
+
+            report = json.loads(zlib.decompress(urllib_req.urlopen(url).read()))
+            assert report['generation'] > 0
+            assert 'unchanged_providers' not in report
+
+            delta = json.loads(zlib.decompress(urllib_req.urlopen(url + '?generation=' + str(report['generation'])).read()))
+            assert delta['generation'] >= report['generation']
+            # every provider is either sent or listed as unchanged
+            for name in delta['unchanged_providers']:
+                assert name not in delta
+
+    def test_monitor_stages(self, server, simple_node):
+        '''Checks that processing stages of executed commands are counted by every node'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_stages')
+        session.groups = session.routes.groups()
+        session.write_data('stages_key', 'stages_data').get()
+
+        commands = elliptics.monitor_stat_categories.commands
+        for entry in session.monitor_stat(categories=commands).get():
+            stages = entry.statistics['commands']['stages']
+            for stage in ('queue', 'process', 'send'):
+                assert stages[stage]['count'] > 0
+                assert stages[stage]['p50'] <= stages[stage]['p99']
+
+    def test_monitor_slow_requests(self, server, simple_node):
+        '''Checks that every node reports ring of its slow requests'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_slow_requests')
+        session.groups = session.routes.groups()
+
+        slow = elliptics.monitor_stat_categories.slow
+        for entry in session.monitor_stat(categories=slow).get():
+            stat = entry.statistics['slow']
+            assert stat['threshold_usecs'] > 0
+            assert stat['size'] > 0
+            for requests in stat['backends'].values():
+                assert len(requests) <= stat['size']
+                for request in requests:
+                    assert request['total_usecs'] >= stat['threshold_usecs']
+
+    def test_monitor_locks(self, server, simple_node):
+        '''Checks that every node reports statistics of its lock sites'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_locks')
+        session.groups = session.routes.groups()
+
+        locks = elliptics.monitor_stat_categories.locks
+        for entry in session.monitor_stat(categories=locks).get():
+            stat = entry.statistics['locks']
+            assert 'enabled' in stat
+            for site in stat['sites'].values():
+                assert site['contended'] <= site['acquired']
+                assert sum(site['wait_usecs'].values()) == site['acquired']
+
+    def test_monitor_heatmap(self, server, simple_node):
+        '''Checks that backends count requests of key ranges which were written'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_heatmap')
+        session.groups = session.routes.groups()
+        for i in range(10):
+            session.write_data('heatmap_key_{0}'.format(i), 'heatmap_data').get()
+
+        writes = 0
+        heatmap = elliptics.monitor_stat_categories.heatmap
+        for entry in session.monitor_stat(categories=heatmap).get():
+            for backend in entry.statistics['backends'].values():
+                stat = backend['heatmap']
+                assert stat['bits'] == 8
+                for r in stat['ranges']:
+                    assert r['index'] < 2 ** stat['bits']
+                    assert int(r['begin'], 16) >> (512 - stat['bits']) == r['index']
+                    assert r['reads'] + r['writes'] > 0
+                    writes += r['writes']
+        assert writes >= 10 * len(session.groups)
+
+    def test_monitor_peers(self, server, simple_node):
+        '''Checks that every node reports traffic of its heaviest peers'''
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_monitor_peers')
+        session.groups = session.routes.groups()
+        session.write_data('peers_key', 'peers_data').get()
+
+        commands = elliptics.monitor_stat_categories.commands
+        for entry in session.monitor_stat(categories=commands).get():
+            peers = entry.statistics['commands']['peers']
+            assert len(peers['top']) <= peers['count']
+            for peer in peers['top']:
+                assert peer['latency_usecs']['p50'] <= peer['latency_usecs']['max']
+                # test servers do not configure wire compression
+                assert not peer['compression']['enabled']
+                assert peer['compression']['send_wire_bytes'] == 0
@@ -38,7 +38,8 @@ command_flags = set((elliptics.command_flags.default,
                      elliptics.command_flags.direct,
                      elliptics.command_flags.nolock,
                      elliptics.command_flags.checksum,
-                     elliptics.command_flags.nocache))
+                     elliptics.command_flags.nocache,
+                     elliptics.command_flags.no_file_path))
 
 exceptions_policy = set((elliptics.exceptions_policy.no_exceptions,
                          elliptics.exceptions_policy.throw_at_start,
@@ -15,6 +15,8 @@
 
 import os
 import sys
+import json
+import struct
 sys.path.insert(0, "")  # for running from cmake
 import pytest
 from conftest import make_session
@@ -199,6 +201,43 @@ class TestSession:
         checked_bulk_write(session, dict.fromkeys(keys, 'data'), data)
         checked_bulk_read(session, keys, data)
 
+    def test_read_data_view(self, server, simple_node):
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_read_data_view')
+        session.groups = session.routes.groups()
+
+        key = 'data view key'
+        data = 'data view data'
+        checked_write(session, key, data)
+
+        result = session.read_data(key).get()[0]
+        view = result.data_view
+        del result
+
+        assert type(view) == memoryview
+        assert view.readonly
+        assert view.tobytes() == data
+        assert view[5:9].tobytes() == 'view'
+
+    def test_write_no_file_path(self, server, simple_node):
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_write_no_file_path')
+        session.groups = session.routes.groups()
+
+        key = 'no file path key'
+        data = 'no file path data'
+        checked_write(session, key, data)
+        assert session.lookup(key).get()[0].filepath != ''
+
+        session.cflags = elliptics.command_flags.no_file_path
+        results = session.write_data(key, data).get()
+        check_write_results(results, len(session.groups), data, session)
+        assert all(r.filepath == '' for r in results)
+
+        results = session.lookup(key).get()
+        assert results[0].size == len(data)
+        assert results[0].filepath == ''
+
     def test_write_cas(self, server, simple_node):
         session = make_session(node=simple_node,
                                test_name='TestSession.test_write_cas')
@@ -221,6 +260,58 @@ class TestSession:
         check_write_results(results, len(session.groups), ndata, session)
         checked_read(session, key, ndata)
 
+    def test_atomic_increment(self, server, simple_node):
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_atomic_increment')
+        session.groups = session.routes.groups()
+
+        key = 'atomic counter key'
+        results = [session.atomic_increment(key, delta) for delta in [5] + [1] * 20 + [-3]]
+        for r in results:
+            check_write_results(r.get(), len(session.groups), struct.pack('<q', 0), session)
+
+        checked_read(session, key, struct.pack('<q', 22))
+
+        checked_write(session, key, 'not a counter')
+        with pytest.raises(elliptics.Error):
+            session.atomic_increment(key, 1).get()
+
+    def test_atomic_json_merge(self, server, simple_node):
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_atomic_json_merge')
+        session.groups = session.routes.groups()
+
+        key = 'atomic json key'
+        checked_write(session, key, json.dumps({'title': 'a', 'tags': ['x'], 'author': {'name': 'n', 'email': 'e'}}))
+
+        session.atomic_json_merge(key, json.dumps({'title': 'b', 'author': {'email': None}, 'views': 1})).wait()
+        session.atomic_json_merge(key, json.dumps({'tags': ['y', 'z']})).wait()
+
+        document = json.loads(session.read_data(key).get()[0].data)
+        assert document == {'title': 'b', 'tags': ['y', 'z'], 'author': {'name': 'n'}, 'views': 1}
+
+        with pytest.raises(elliptics.Error):
+            session.atomic_json_merge(key, 'not a json').get()
+
+    def test_atomic_append_if_version(self, server, simple_node):
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_atomic_append_if_version')
+        session.groups = [session.routes.groups()[0]]
+
+        key = 'atomic append key'
+        checked_write(session, key, 'head')
+        version = session.lookup(key).get()[0].timestamp
+
+        session.atomic_append(key, '-tail', version).wait()
+        checked_read(session, key, 'head-tail')
+
+        with pytest.raises(elliptics.Error):
+            session.atomic_append(key, '-again', version).get()
+        checked_read(session, key, 'head-tail')
+
+        session.atomic_append(key, '-again').wait()
+        checked_read(session, key, 'head-tail-again')
+
     def test_prepare_write_commit(self, server, simple_node):
         session = make_session(node=simple_node,
                                test_name='TestSession.test_prepare_write_commit')
@@ -367,3 +458,38 @@ class TestSession:
         assert results[0].backend_id == test_backend
 
         checked_read(session, test_key, test_data3)
+
+    def test_fault_injection(self, server, simple_node):
+        '''
+        Injects error into reads of the backend holding the key and removes it.
+        Servers built without fault injection refuse rules.
+        '''
+        import errno
+        session = make_session(node=simple_node,
+                               test_name='TestSession.test_fault_injection')
+        session.groups = [session.routes.groups()[0]]
+        test_key = 'test_fault_injection_key'
+        test_data = 'fault injection data'
+        session.write_data(test_key, test_data).get()
+
+        result = session.lookup(test_key).get()[0]
+        address, backend = result.address, result.backend_id
+
+        # 5 = DNET_CMD_READ
+        rules = [{'cmd': 5, 'error': -errno.EIO, 'delay_min': 1000}]
+        try:
+            status = session.set_faults(address, backend, rules).get()[0].backends[0]
+        except elliptics.Error:
+            pytest.skip('servers are built without fault injection')
+        assert status.faults_count == 1
+
+        try:
+            with pytest.raises(elliptics.Error):
+                session.read_data(test_key).get()
+            # other commands are not affected
+            session.lookup(test_key).get()
+        finally:
+            status = session.set_faults(address, backend, []).get()[0].backends[0]
+            assert status.faults_count == 0
+
+        checked_read(session, test_key, test_data)
@@ -82,3 +82,73 @@ class TestSpecificCases:
 
         session1.set_backend_ids(address1, backend_id1, old_ids1).get()
         session2.set_backend_ids(address2, backend_id2, old_ids2).get()
+
+    def test_route_cache(self, servers, tmpdir):
+        '''
+        Checks that ids received from a server node are cached in route_cache_dir and
+        the next client node connected to the same server takes unchanged ids from the cache.
+        '''
+        address = elliptics.Address.from_host_port_family(servers.remotes[0])
+
+        def connect():
+            config = elliptics.Config()
+            config.route_cache_dir = str(tmpdir)
+            session = elliptics.Session(elliptics.Node(elliptics.Logger("client.log", elliptics.log_level.debug),
+                                                       config))
+            session._node.add_remotes(address)
+            return session, sorted((str(r.id), r.backend_id) for r in session.routes.filter_by_address(address))
+
+        session1, routes1 = connect()
+        assert routes1
+        assert len(tmpdir.listdir()) == 1
+
+        session2, routes2 = connect()
+        assert routes2 == routes1
+
+    def test_local_socket(self, servers):
+        '''
+        Checks that servers listen unix sockets in local_socket_dir and client node configured
+        with this directory works via them, while the server keeps its TCP address in routes.
+        '''
+        import os
+        import stat
+
+        address = elliptics.Address.from_host_port_family(servers.remotes[0])
+
+        sockets = [os.path.join(servers.path, name) for name in os.listdir(servers.path)]
+        sockets = [path for path in sockets if stat.S_ISSOCK(os.stat(path).st_mode)]
+        assert len(sockets) == len(servers.remotes)
+
+        config = elliptics.Config()
+        config.local_socket_dir = os.path.abspath(servers.path)
+        session = elliptics.Session(elliptics.Node(elliptics.Logger("client.log", elliptics.log_level.debug),
+                                                   config))
+        session._node.add_remotes(address)
+        assert session.routes.addresses() == (address, )
+
+        session.groups = session.routes.groups()
+        session.write_data('local socket key', 'local socket data').get()
+        assert session.read_data('local socket key').get()[0].data == 'local socket data'
+
+    def test_zerocopy_send(self, servers):
+        '''
+        Checks that large writes sent with MSG_ZEROCOPY by client node reach the server intact
+        and small ones which are copied as usual are not delayed by pending completions.
+        '''
+        address = elliptics.Address.from_host_port_family(servers.remotes[0])
+
+        config = elliptics.Config()
+        config.zerocopy_send_size = 64 * 1024
+        session = elliptics.Session(elliptics.Node(elliptics.Logger("client.log", elliptics.log_level.debug),
+                                                   config))
+        session._node.add_remotes(address)
+        session.groups = session.routes.groups()
+
+        data = ''.join(chr(i % 251) for i in xrange(4 * 1024 * 1024))
+        for i in xrange(8):
+            session.write_data('zerocopy key {}'.format(i), data).get()
+            session.write_data('small key {}'.format(i), 'small data').get()
+
+        for i in xrange(8):
+            assert session.read_data('zerocopy key {}'.format(i)).get()[0].data == data
+            assert session.read_data('small key {}'.format(i)).get()[0].data == 'small data'
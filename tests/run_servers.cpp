@@ -322,8 +322,13 @@ static int run_servers(const rapidjson::Value &doc)
 				("events_size", top_events_size)
 				("period_in_seconds", top_period);
 			config("monitor_top", top_params);
+			config("monitor_profiling", true);
+			config("monitor_heatmap", tests::config_data()("bits", 8));
 		}
 
+		// clients of python tests may connect to the servers via unix sockets
+		config("local_socket_dir", std::string(path.GetString(), path.GetStringLength()));
+
 		configs[i].apply_options(config);
 
 		for (size_t j = 0; j < configs[i].backends.size(); ++j) {
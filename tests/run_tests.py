@@ -5,6 +5,7 @@ import tarfile
 import os
 import sys
 import shutil
+import json
 
 
 def run_test(path, test):
@@ -24,7 +25,137 @@ def force_mkdir(path):
     os.mkdir(path)
 
 
+def flatten_results(target, results):
+    """
+    Flattens JSON results of benchmark @target into {metric: value}.
+    Metrics ending with '.ops_per_sec' are better when higher, with '.p99' - when lower.
+    """
+    metrics = dict()
+
+    if target == 'dnet_bench':
+        operations = dict(results['operations'])
+        operations['total'] = results['total']
+        for name, stats in operations.items():
+            metrics[name + '.ops_per_sec'] = stats['ops_per_sec']
+            metrics[name + '.p99'] = stats['latency_usecs']['p99']
+    else:
+        for name, stats in results['benchmarks'].items():
+            metrics[name + '.ops_per_sec'] = stats['ops_per_sec']
+
+    return metrics
+
+
+def compare_metrics(baseline, metrics, tolerance):
+    """
+    Returns list of regressions of @metrics against @baseline:
+    throughput dropped or p99 latency grew by more than relative @tolerance.
+    Metrics which are missing in the baseline are not checked.
+    """
+    regressions = list()
+
+    for name, value in sorted(metrics.items()):
+        if name not in baseline or not baseline[name]:
+            continue
+
+        base = float(baseline[name])
+        change = (value - base) / base
+
+        if name.endswith('.ops_per_sec') and change < -tolerance['ops_per_sec']:
+            regressions.append('{0}: {1:.0f} -> {2:.0f} ops/s ({3:+.1%})'
+                               .format(name, base, value, change))
+        elif name.endswith('.p99') and change > tolerance['p99']:
+            regressions.append('{0}: {1:.0f} -> {2:.0f} usecs ({3:+.1%})'
+                               .format(name, base, value, change))
+
+    return regressions
+
+
+def current_commit(source_dir):
+    try:
+        return subprocess.check_output(['git', 'rev-parse', 'HEAD'],
+                                       cwd=source_dir).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+
+def perf_main(source_dir, binary_dir, update_baseline):
+    """
+    Runs benchmarks listed in perf_baseline.json, compares their results with the baseline
+    stored in the same file and archives them into perf_results/COMMIT.json of binary dir.
+    With @update_baseline measured results replace the stored baseline instead.
+    """
+    baseline_path = os.path.join(source_dir, 'perf_baseline.json')
+    with open(baseline_path) as f:
+        config = json.load(f)
+
+    tolerance = config['tolerance']
+    baseline = config.get('results', dict())
+
+    perf_dir = binary_dir + '/result/perf'
+    force_mkdir(binary_dir + '/result')
+    os.mkdir(perf_dir)
+
+    archive_dir = os.path.join(binary_dir, 'perf_results')
+    if not os.path.exists(archive_dir):
+        os.mkdir(archive_dir)
+
+    commit = current_commit(source_dir)
+    archive = {'commit': commit, 'time': time.time(), 'results': dict()}
+
+    all_ok = True
+    for benchmark in config['benchmarks']:
+        name = benchmark['name']
+        path = os.path.join(perf_dir, name)
+        output = path + '.json'
+        os.mkdir(path)
+
+        command = [os.path.join(binary_dir, benchmark['target'])] + benchmark['args']
+        command += ['--output', output]
+        if benchmark['target'] == 'dnet_bench':
+            command += ['--path', path]
+
+        print('# Benchmark {0}: {1}'.format(name, ' '.join(command)))
+        result = subprocess.call(command, stdout=sys.stdout,
+                                 stderr=subprocess.STDOUT, cwd=path)
+        if result != 0 or not os.path.exists(output):
+            print('# Result: Failed ({0})\n'.format(result))
+            all_ok = False
+            continue
+
+        with open(output) as f:
+            metrics = flatten_results(benchmark['target'], json.load(f))
+        archive['results'][name] = metrics
+
+        regressions = compare_metrics(baseline.get(name, dict()), metrics, tolerance)
+        for regression in regressions:
+            print('# Regression: {0}: {1}'.format(name, regression))
+
+        if regressions and not update_baseline:
+            all_ok = False
+            print('# Result: Regressed\n')
+        else:
+            print('# Result: Passed\n')
+
+    archive_path = os.path.join(archive_dir, commit + '.json')
+    with open(archive_path, 'w') as f:
+        json.dump(archive, f, indent=4, sort_keys=True)
+    print('Results are archived to {0}'.format(archive_path))
+
+    if update_baseline:
+        config['commit'] = commit
+        config['results'] = archive['results']
+        with open(baseline_path, 'w') as f:
+            json.dump(config, f, indent=4, sort_keys=True)
+            f.write('\n')
+        print('Baseline {0} is updated'.format(baseline_path))
+
+    exit(0 if all_ok else 1)
+
+
 def main():
+    if sys.argv[1] in ('--perf', '--perf-update'):
+        perf_main(sys.argv[2], sys.argv[3], sys.argv[1] == '--perf-update')
+
     source_dir = sys.argv[1]
     binary_dir = sys.argv[2]
 
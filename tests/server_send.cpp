@@ -16,6 +16,7 @@
 #include "test_base.hpp"
 #include "../library/elliptics.h"
 #include <algorithm>
+#include <set>
 
 #define BOOST_TEST_NO_MAIN
 #include <boost/test/included/unit_test.hpp>
@@ -44,9 +45,10 @@ static std::string print_groups(const std::vector<int> &groups) {
 
 static tests::server_config ssend_server_config(int group)
 {
-	// Minimize number of threads
+	// Minimize number of threads, replies of server-send go between servers with short headers
 	tests::server_config server = tests::server_config::default_value();
 	server.options
+		("short_header", true)
 		("io_thread_num", 4)
 		("nonblocking_io_thread_num", 4)
 		("net_thread_num", 1)
@@ -232,12 +234,17 @@ static void ssend_test_server_send(session &s, int num, const std::string &id_pr
 
 	s.set_trace_id(rand());
 	std::vector<std::string> keys;
+	std::set<std::string> raw_keys;
 	for (int i = 0; i < num; ++i) {
 		std::string id = id_prefix + lexical_cast(i);
 		std::string data = data_prefix + lexical_cast(i);
 
 		ELLIPTICS_REQUIRE(res, s.write_data(id, data, 0));
 
+		key k(id);
+		s.transform(k);
+		raw_keys.insert(std::string((const char *)k.raw_id().id, DNET_ID_SIZE));
+
 		keys.push_back(id);
 	}
 
@@ -268,6 +275,10 @@ static void ssend_test_server_send(session &s, int num, const std::string &id_pr
 		BOOST_REQUIRE_EQUAL(it->command()->status, 0);
 		BOOST_REQUIRE_EQUAL(it->reply()->status, status);
 
+		// every key is answered once with its own key, not the key of server-send request
+		const std::string raw_key((const char *)it->reply()->key.id, DNET_ID_SIZE);
+		BOOST_REQUIRE_EQUAL(raw_keys.erase(raw_key), 1);
+
 		copied++;
 	}
 
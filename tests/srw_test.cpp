@@ -82,6 +82,26 @@ static void send_response(session &sess, const std::string &app_name, const std:
 	BOOST_REQUIRE_EQUAL(result[0].context().data().to_string(), data);
 }
 
+/**
+ * This test checks broadcast exec: every node responds with the same data
+ * and only one reply with all of them joined by "lines" reducer reaches the client.
+ */
+static void send_broadcast(session &sess, const std::string &app_name, const std::string &data)
+{
+	ELLIPTICS_REQUIRE(exec_result, sess.exec_broadcast(app_name + "@response", data, "lines", 1));
+
+	sync_exec_result result = exec_result;
+	BOOST_REQUIRE_EQUAL(result.size(), 1);
+
+	const exec_context context = result[0].context();
+	BOOST_REQUIRE_GT(context.broadcast_nodes(), 0);
+
+	std::string expected = data;
+	for (int i = 1; i < context.broadcast_nodes(); ++i)
+		expected += "\n" + data;
+	BOOST_REQUIRE_EQUAL(context.data().to_string(), expected);
+}
+
 /*
  * This funky thread is needed to periodically 'ping' network connection to given node,
  * since otherwise 3 timed out transaction in a row will force elliptics client to kill
@@ -189,6 +209,7 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(send_echo, create_session(n, { 1 }, 0, 0), application_name(), "some-data and long-data.. like this");
 	ELLIPTICS_TEST_CASE(send_response, create_session(n, { 1 }, 0, 0), application_name(), "some-data");
 	ELLIPTICS_TEST_CASE(send_response, create_session(n, { 1 }, 0, 0), application_name(), "some-data and long-data.. like this");
+	ELLIPTICS_TEST_CASE(send_broadcast, create_session(n, { 1 }, 0, 0), application_name(), "some-data");
 	ELLIPTICS_TEST_CASE(timeout_test, create_session(n, { 1 }, 0, 0), application_name());
 
 	return true;
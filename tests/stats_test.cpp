@@ -431,6 +431,61 @@ static void test_frequent_access()
 			      "then keys with more frequent access must be in top");
 }
 
+/*********************
+ Test heavy_hitters sketch
+ *********************/
+typedef ioremap::monitor::heavy_hitters<test_event> sketch_t;
+
+static void test_sketch_keeps_heavy_keys()
+{
+	const size_t default_size = 100;
+	const size_t sketch_size = 16;
+	const time_t default_time = time(nullptr);
+	sketch_t sketch(sketch_size);
+	std::vector<test_event> result;
+
+	// every 4-th event accesses the "same" key, others access distinct keys and do not fit into sketch
+	for (int i = 0; i < 100 * static_cast<int>(sketch_size); ++i) {
+		std::string key = (i % 4) ? std::to_string(static_cast<long long>(i)) : std::string("same");
+		test_event e{key, default_size, 1., default_time};
+		sketch.add(e);
+	}
+
+	sketch.drain(result);
+	BOOST_REQUIRE_MESSAGE(sketch.empty(), "sketch must be empty after drain");
+	BOOST_REQUIRE_EQUAL(result.size(), sketch_size);
+
+	auto it = std::find_if(result.begin(), result.end(), [] (const test_event &e) {
+		return *e.get_key() == "same";
+	});
+	BOOST_REQUIRE_MESSAGE(it != result.end(), "key heavier than total weight / sketch size must be kept");
+	BOOST_CHECK_MESSAGE(it->get_weight() >= 25 * sketch_size * default_size,
+			    "weight of kept key must not be underestimated");
+}
+
+static void test_sketch_drain_to_top()
+{
+	const size_t default_size = 100;
+	const time_t default_time = time(nullptr);
+	sketch_t sketch(TOP_LENGTH);
+	stats_t stats(EVENTS_SIZE, PERIOD_IN_SECONDS);
+	std::vector<test_event> events, result;
+
+	for (int i = 0; i < TOP_LENGTH; ++i) {
+		test_event e{"same", default_size, 1., default_time};
+		sketch.add(e);
+	}
+
+	sketch.drain(events);
+	for (auto it = events.begin(); it != events.end(); ++it)
+		stats.add_event(*it, it->get_time());
+
+	stats.get_top(TOP_LENGTH, default_time, result);
+	BOOST_REQUIRE_MESSAGE(result.size() == 1, "one and only one element must be in top");
+	BOOST_REQUIRE_EQUAL(result.back().get_weight(), TOP_LENGTH * default_size);
+	BOOST_REQUIRE_EQUAL(result.back().get_frequency(), TOP_LENGTH);
+}
+
 bool register_tests(test_suite *suite)
 {
 	ELLIPTICS_TEST_CASE_NOARGS(test_top_statistics_existence);
@@ -446,6 +501,8 @@ bool register_tests(test_suite *suite)
 	ELLIPTICS_TEST_CASE_NOARGS(test_event_weight_attenuation);
 	ELLIPTICS_TEST_CASE_NOARGS(test_frequent_access_among_heavy_keys);
 	ELLIPTICS_TEST_CASE_NOARGS(test_frequent_access);
+	ELLIPTICS_TEST_CASE_NOARGS(test_sketch_keeps_heavy_keys);
+	ELLIPTICS_TEST_CASE_NOARGS(test_sketch_drain_to_top);
 
 	return true;
 }
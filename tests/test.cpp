@@ -16,6 +16,9 @@
 
 #include "test_base.hpp"
 #include <algorithm>
+#include <endian.h>
+#include <future>
+#include <set>
 
 #define BOOST_TEST_NO_MAIN
 #include <boost/test/included/unit_test.hpp>
@@ -29,22 +32,42 @@ namespace tests {
 
 static std::shared_ptr<nodes_data> global_data;
 
+/*
+ * backend of the third group keeps records written with lifetime in buckets of a second, see test_ttl_expire,
+ * and deduplicates records of at least 256 KiB, see test_dedup
+ */
+static server_config ttl_server_config(int group)
+{
+	server_config config = server_config::default_value();
+	config.apply_options(config_data()
+		("group", group)
+	);
+	config.backends.front()("ttl_bucket_seconds", 1);
+	config.backends.front()("dedup_threshold", 256 * 1024);
+	config.backends.front()("dedup_chunk_size", 16 * 1024);
+	return config;
+}
+
+/* servers of the first two groups write their logs by the background writer, see test_async_log_node_destroy */
+static server_config async_log_server_config(int group)
+{
+	server_config config = server_config::default_value();
+	config.apply_options(config_data()
+		("group", group)
+		("cache_hotset_interval", 1)
+	);
+	config.log_async_ring_size = 1024;
+	return config;
+}
+
 static void configure_nodes(const std::vector<std::string> &remotes, const std::string &path)
 {
 #ifndef NO_SERVER
 	if (remotes.empty()) {
 		start_nodes_config start_config(results_reporter::get_stream(), std::vector<server_config>({
-			server_config::default_value().apply_options(config_data()
-				("group", 1)
-			),
-
-			server_config::default_value().apply_options(config_data()
-				("group", 2)
-			),
-
-			server_config::default_value().apply_options(config_data()
-				("group", 3)
-			)
+			async_log_server_config(1),
+			async_log_server_config(2),
+			ttl_server_config(3)
 		}), path);
 
 		global_data = start_nodes(start_config);
@@ -173,6 +196,114 @@ static void test_write(session &sess, const std::string &id, const std::string &
 	BOOST_REQUIRE_EQUAL(result.file().to_string(), data);
 }
 
+// The test checks write with quorum completion succeeds as soon as majority of groups
+// have replied, while the rest of replicas are written in background
+static void test_quorum_write(session &sess, const std::string &id, const std::string &data)
+{
+	std::vector<int> groups = sess.get_groups();
+
+	sess.set_checker(checkers::quorum);
+	sess.set_quorum_completion(true);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+	sync_write_result result = write_result.get();
+	BOOST_REQUIRE_GE(result.size(), groups.size() / 2 + 1);
+
+	// We need to give the slowest replica time to finish the write in background
+	usleep(100 * 1000);
+
+	for (size_t i = 0; i < groups.size(); ++i) {
+		std::vector<int> current_groups(1, groups[i]);
+		ELLIPTICS_REQUIRE(read_result, sess.read_data(id, current_groups, 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+	}
+}
+
+// The test checks write replicated by the node of the first group reports result of every group
+// and every replica is readable afterwards
+static void test_primary_replication_write(session &sess, const std::string &id, const std::string &data)
+{
+	std::vector<int> groups = sess.get_groups();
+
+	sess.set_checker(checkers::all);
+	sess.set_primary_replication(true);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+	sync_write_result result = write_result.get();
+	BOOST_REQUIRE_EQUAL(result.size(), groups.size());
+
+	for (size_t i = 0; i < groups.size(); ++i) {
+		std::vector<int> current_groups(1, groups[i]);
+		ELLIPTICS_REQUIRE(read_result, sess.read_data(id, current_groups, 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+	}
+}
+
+// The test checks erasure coded object is read back after loss of parity_chunks of its chunks
+// and recovery rewrites lost chunks
+static void test_erasure_coding(session &sess, const std::string &id)
+{
+	std::string data;
+	for (size_t i = 0; i < 100000; ++i)
+		data.push_back('a' + i % 23);
+
+	sess.set_erasure_coding(2, 1);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_erasure(id, data));
+	BOOST_REQUIRE_EQUAL(write_result.get().size(), 3);
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_erasure(id));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+
+	key chunk = sess.get_erasure_chunk_key(id, 0);
+	session chunk_sess = sess.clone();
+	chunk_sess.set_groups(std::vector<int>(1, chunk.id().group_id));
+	ELLIPTICS_REQUIRE(remove_result, chunk_sess.remove(chunk));
+
+	ELLIPTICS_REQUIRE(degraded_result, sess.read_erasure(id));
+	BOOST_REQUIRE_EQUAL(degraded_result.get_one().file().to_string(), data);
+
+	ELLIPTICS_REQUIRE(recover_result, sess.recover_erasure(id));
+	BOOST_REQUIRE_EQUAL(recover_result.get().size(), 1);
+
+	ELLIPTICS_REQUIRE(chunk_result, chunk_sess.read_data(chunk, 0, 0));
+	BOOST_REQUIRE_EQUAL(std::string(chunk_result.get_one().file().to_string(), 40), data.substr(0, data.size() / 2));
+
+	ELLIPTICS_REQUIRE(erasure_remove_result, sess.remove_erasure(id));
+	ELLIPTICS_REQUIRE_ERROR(missing_result, sess.read_erasure(id), -ENOENT);
+}
+
+// The test checks object written by chunks with several of them in flight is read back intact
+static void test_chunked_write(session &sess, const std::string &id, size_t window)
+{
+	const size_t chunk_size = 1024;
+	std::string data;
+	for (size_t i = 0; i < 10 * chunk_size + 17; ++i)
+		data.push_back('a' + i % 26);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data_pointer::copy(data), 0, chunk_size, window));
+	ELLIPTICS_REQUIRE(read_result, sess.read_data(id, 0, 0));
+	read_result_entry result = read_result.get_one();
+
+	BOOST_REQUIRE_EQUAL(result.file().to_string(), data);
+}
+
+// The test checks object written from several segments is read back as their concatenation
+static void test_segmented_write(session &sess, const std::string &id)
+{
+	std::vector<data_pointer> segments;
+	segments.push_back(data_pointer::copy(std::string("header:")));
+	segments.push_back(data_pointer());
+	segments.push_back(data_pointer::copy(std::string(100000, 'b')));
+	segments.push_back(data_pointer::copy(std::string(":trailer")));
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, segments, 0));
+	ELLIPTICS_REQUIRE(read_result, sess.read_data(id, 0, 0));
+	read_result_entry result = read_result.get_one();
+
+	BOOST_REQUIRE_EQUAL(result.file().to_string(), "header:" + std::string(100000, 'b') + ":trailer");
+}
+
 static void test_recovery(session &sess, const std::string &id, const std::string &data)
 {
 	std::vector<int> groups = sess.get_groups();
@@ -270,6 +401,212 @@ static void test_more_indexes(session &sess)
 	BOOST_CHECK_EQUAL(all_result[0].indexes.size(), indexes.size());
 }
 
+/*!
+ * \brief Tests paginated find of indexes
+ * Test workflow:
+ * - Add 256 keys to two indexes
+ * - Read both intersection and union by pages of 50 objects
+ * - Check that pages are sorted, do not overlap and cover all keys
+ */
+static void test_indexes_pagination(session &sess)
+{
+	const std::vector<std::string> indexes = {
+		"page-index-1",
+		"page-index-2"
+	};
+
+	std::vector<data_pointer> data(indexes.size());
+
+	for (size_t i = 0; i < 256; ++i) {
+		std::string key = "page-key-" + boost::lexical_cast<std::string>(i);
+		ELLIPTICS_REQUIRE(set_indexes_result, sess.set_indexes(key, indexes, data));
+	}
+
+	const uint64_t limit = 50;
+
+	for (int intersect = 0; intersect < 2; ++intersect) {
+		std::set<std::string> found;
+		std::string cursor;
+
+		for (;;) {
+			sync_find_indexes_result page;
+			if (intersect) {
+				ELLIPTICS_REQUIRE(find_result, sess.find_all_indexes(indexes, limit, cursor));
+				page = find_result.get();
+			} else {
+				ELLIPTICS_REQUIRE(find_result, sess.find_any_indexes(indexes, limit, cursor));
+				page = find_result.get();
+			}
+
+			BOOST_REQUIRE_LE(page.size(), limit);
+
+			for (auto it = page.begin(); it != page.end(); ++it) {
+				std::string id = session::find_indexes_cursor(*it);
+
+				BOOST_REQUIRE(cursor.empty() || cursor < id);
+				BOOST_REQUIRE_EQUAL(it->indexes.size(), indexes.size());
+				BOOST_REQUIRE(found.insert(id).second);
+				cursor = id;
+			}
+
+			if (page.size() < limit)
+				break;
+		}
+
+		BOOST_REQUIRE_EQUAL(found.size(), 256);
+	}
+}
+
+/*!
+ * \brief Tests paginated find of indexes together with the objects
+ * Test workflow:
+ * - Write 64 keys and add them to two indexes
+ * - Read intersection of indexes by pages of 20 objects with whole objects and with their first bytes
+ * - Check that every object is returned with its data
+ */
+static void test_indexes_read(session &sess)
+{
+	const std::vector<std::string> indexes = {
+		"read-index-1",
+		"read-index-2"
+	};
+
+	std::vector<data_pointer> index_data(indexes.size());
+	std::map<dnet_raw_id, std::string, dnet_raw_id_less_than<>> all_data;
+
+	for (size_t i = 0; i < 64; ++i) {
+		const std::string name = "read-key-" + boost::lexical_cast<std::string>(i);
+		const std::string data = "read-data-" + boost::lexical_cast<std::string>(i);
+
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(name, data, 0));
+		ELLIPTICS_REQUIRE(set_indexes_result, sess.set_indexes(name, indexes, index_data));
+
+		key id(name);
+		id.transform(sess);
+		all_data[id.raw_id()] = data;
+	}
+
+	const uint64_t limit = 20;
+	const uint64_t sizes[] = { 0, 4 };
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		size_t found = 0;
+		std::string cursor;
+
+		for (;;) {
+			ELLIPTICS_REQUIRE(find_result, sess.find_all_indexes_read(indexes, limit, cursor, sizes[i]));
+			sync_find_indexes_result page = find_result.get();
+
+			BOOST_REQUIRE_LE(page.size(), limit);
+
+			for (auto it = page.begin(); it != page.end(); ++it) {
+				std::string data = all_data[it->id];
+				if (sizes[i])
+					data.resize(sizes[i]);
+
+				BOOST_REQUIRE_EQUAL(it->status, 0);
+				BOOST_REQUIRE_EQUAL(it->data.to_string(), data);
+				BOOST_REQUIRE_EQUAL(it->indexes.size(), indexes.size());
+				cursor = session::find_indexes_cursor(*it);
+				++found;
+			}
+
+			if (page.size() < limit)
+				break;
+		}
+
+		BOOST_REQUIRE_EQUAL(found, all_data.size());
+	}
+}
+
+/*!
+ * \brief Tests bulk update of indexes
+ * Test workflow:
+ * - Add 256 keys to two indexes by single bulk_update_indexes call
+ * - Check that intersection of indexes contains all keys
+ * - Check that lists of indexes of keys are updated too
+ */
+static void test_bulk_indexes(session &sess)
+{
+	const std::vector<std::string> indexes = {
+		"bulk-index-1",
+		"bulk-index-2"
+	};
+
+	std::vector<key> keys;
+	std::vector<std::vector<std::string> > keys_indexes;
+	std::vector<std::vector<data_pointer> > keys_data;
+	for (size_t i = 0; i < 256; ++i) {
+		keys.push_back(std::string("bulk-key-") + boost::lexical_cast<std::string>(i));
+		keys_indexes.push_back(indexes);
+		keys_data.push_back(std::vector<data_pointer>(indexes.size(), data_pointer::copy("data", 4)));
+	}
+
+	ELLIPTICS_REQUIRE(bulk_result, sess.bulk_update_indexes(keys, keys_indexes, keys_data));
+
+	ELLIPTICS_REQUIRE(all_indexes_result, sess.find_all_indexes(indexes));
+	sync_find_indexes_result all_result = all_indexes_result.get();
+
+	BOOST_REQUIRE_EQUAL(all_result.size(), 256);
+	for (auto it = all_result.begin(); it != all_result.end(); ++it) {
+		BOOST_REQUIRE_EQUAL(it->indexes.size(), indexes.size());
+		BOOST_CHECK_EQUAL(it->indexes[0].data.to_string(), "data");
+	}
+
+	ELLIPTICS_REQUIRE(list_indexes_result, sess.list_indexes(keys[0]));
+	sync_list_indexes_result list_result = list_indexes_result;
+
+	BOOST_REQUIRE_EQUAL(list_result.size(), indexes.size());
+}
+
+/*!
+ * \brief Tests range and prefix queries of index data
+ * Test workflow:
+ * - Add 64 keys to index with big-endian numbers as data and to index with string data
+ * - Check that range query returns only keys with numbers within the range
+ * - Check that prefix query returns only keys with data starting with the prefix
+ */
+static void test_indexes_range(session &sess)
+{
+	const std::string range_index = "range-index";
+	const std::string prefix_index = "prefix-index";
+
+	for (uint64_t i = 0; i < 64; ++i) {
+		std::string key = "range-key-" + boost::lexical_cast<std::string>(i);
+
+		const uint64_t number = htobe64(i);
+		std::vector<std::string> indexes = { range_index, prefix_index };
+		std::vector<data_pointer> data = {
+			data_pointer::copy(&number, sizeof(number)),
+			data_pointer::copy("group-" + boost::lexical_cast<std::string>(i % 4) + "-" + boost::lexical_cast<std::string>(i))
+		};
+
+		ELLIPTICS_REQUIRE(set_indexes_result, sess.set_indexes(key, indexes, data));
+	}
+
+	const uint64_t start = htobe64(10);
+	const uint64_t end = htobe64(19);
+
+	ELLIPTICS_REQUIRE(range_result, sess.find_indexes_range(range_index,
+		data_pointer::copy(&start, sizeof(start)), data_pointer::copy(&end, sizeof(end))));
+	sync_find_indexes_result range = range_result.get();
+
+	BOOST_REQUIRE_EQUAL(range.size(), 10);
+	for (auto it = range.begin(); it != range.end(); ++it) {
+		BOOST_REQUIRE_EQUAL(it->indexes.size(), 1);
+
+		const uint64_t number = be64toh(*it->indexes[0].data.data<uint64_t>());
+		BOOST_CHECK(number >= 10 && number <= 19);
+	}
+
+	ELLIPTICS_REQUIRE(prefix_result, sess.find_indexes_prefix(prefix_index, data_pointer::copy(std::string("group-1-"))));
+	sync_find_indexes_result prefix = prefix_result.get();
+
+	BOOST_REQUIRE_EQUAL(prefix.size(), 16);
+	for (auto it = prefix.begin(); it != prefix.end(); ++it)
+		BOOST_CHECK_EQUAL(it->indexes[0].data.to_string().compare(0, 8, "group-1-"), 0);
+}
+
 /*!
  * \brief Tests correctness of get_index_metadata function
  * Test workflow:
@@ -421,6 +758,103 @@ static void test_append(session &sess)
 	}
 }
 
+/*
+ * Plain appends are buffered by the cache, writers are acked once their appends are flushed
+ * either because the buffer is full or by age.
+ */
+static void test_append_buffer(session &sess, const std::string &id)
+{
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, "head", 0));
+
+	session sa = sess.clone();
+	sa.set_ioflags(sa.get_ioflags() | DNET_IO_FLAGS_APPEND);
+
+	std::string full = "head";
+	for (int i = 0; i < 500; ++i) {
+		std::ostringstream str;
+		str << " | part " << i;
+		ELLIPTICS_REQUIRE(append_result, sa.write_data(id, str.str(), 0));
+		full.append(str.str());
+	}
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), full);
+
+	// nothing reads the key now, so this writer is acked only after its append is flushed by age
+	ELLIPTICS_REQUIRE(tail_result, sa.write_data(id, " | tail", 0));
+	BOOST_REQUIRE_EQUAL(tail_result.get_one().file_info()->size, strlen(" | tail"));
+
+	ELLIPTICS_REQUIRE(tail_read_result, sess.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(tail_read_result.get_one().file().to_string(), full + " | tail");
+}
+
+/*
+ * Keys written past the cache are loaded into it by prefetch hint in background,
+ * so cache-only reads find them soon after the hint is acknowledged.
+ */
+static void test_cache_prefetch(session &sess)
+{
+	std::vector<key> keys;
+	for (int i = 0; i < 8; ++i) {
+		std::string k = "cache-prefetch-key." + lexical_cast(i) + "." + lexical_cast(rand());
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(k, "prefetch data " + lexical_cast(i), 0));
+		keys.emplace_back(k);
+	}
+
+	ELLIPTICS_REQUIRE(prefetch_result, sess.prefetch(keys));
+
+	session cache_sess = sess.clone();
+	cache_sess.set_ioflags(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY);
+	cache_sess.set_exceptions_policy(session::no_exceptions);
+
+	for (size_t i = 0; i < keys.size(); ++i) {
+		bool cached = false;
+		for (int attempt = 0; attempt < 50 && !cached; ++attempt) {
+			auto read_result = cache_sess.read_data(keys[i], 0, 0);
+			read_result.wait();
+			cached = !read_result.error();
+			if (!cached)
+				usleep(100 * 1000);
+		}
+
+		BOOST_REQUIRE_MESSAGE(cached, "key " << i << " is not prefetched");
+	}
+}
+
+/*
+ * Key cached by reads from the first group becomes cached in the second one too,
+ * since servers of both groups send their hot keys to replicas every second.
+ */
+static void test_cache_hotset(session &sess)
+{
+	const std::vector<int> groups = sess.get_groups();
+	const std::string k = "cache-hotset-key." + lexical_cast(rand());
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(k, "hotset data", 0));
+
+	session first_sess = sess.clone();
+	first_sess.set_groups(std::vector<int>(1, groups.front()));
+	first_sess.set_ioflags(DNET_IO_FLAGS_CACHE);
+
+	ELLIPTICS_REQUIRE(read_result, first_sess.read_data(k, 0, 0));
+
+	session second_sess = sess.clone();
+	second_sess.set_groups(std::vector<int>(1, groups.back()));
+	second_sess.set_ioflags(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY);
+	second_sess.set_exceptions_policy(session::no_exceptions);
+
+	bool cached = false;
+	for (int attempt = 0; attempt < 100 && !cached; ++attempt) {
+		auto cache_result = second_sess.read_data(k, 0, 0);
+		cache_result.wait();
+		cached = !cache_result.error();
+		if (!cached)
+			usleep(100 * 1000);
+	}
+
+	BOOST_REQUIRE_MESSAGE(cached, "hot key is not cached in group " << groups.back());
+}
+
 /*
  * Simultaneously set PREPARE/PLAIN_WRITE/COMMIT flags.
  * Data read must be equal to what was written.
@@ -616,6 +1050,58 @@ static void test_bulk_write(session &sess, size_t test_count)
 	}
 }
 
+/*
+ * Keys written without file info get their statuses in one reply of every backend
+ */
+static void test_bulk_write_statuses(session &sess, size_t test_count)
+{
+	std::vector<struct dnet_io_attr> ios;
+	std::vector<std::string> data;
+
+	sess.set_ioflags(DNET_IO_FLAGS_WRITE_NO_FILE_INFO);
+	// keys are acked without file info, so results are acks
+	sess.set_checker(checkers::no_check);
+	sess.set_filter(filters::all_with_ack);
+
+	for (size_t i = 0; i < test_count; ++i) {
+		struct dnet_io_attr io;
+		struct dnet_id id;
+
+		std::ostringstream os;
+		os << "bulk_write_statuses" << i;
+
+		memset(&io, 0, sizeof(io));
+		memset(&id, 0, sizeof(id));
+
+		sess.transform(os.str(), id);
+		memcpy(io.id, id.id, DNET_ID_SIZE);
+		io.size = os.str().size();
+
+		ios.push_back(io);
+		data.push_back(os.str());
+	}
+
+	ELLIPTICS_REQUIRE(write_result, sess.bulk_write(ios, data));
+
+	sync_write_result result = write_result.get();
+
+	size_t count = 0;
+	for (auto it = result.begin(); it != result.end(); ++it) {
+		count += (it->status() == 0);
+		BOOST_WARN_EQUAL(it->status(), 0);
+	}
+
+	BOOST_REQUIRE_EQUAL(count, test_count * 2);
+
+	sess.set_ioflags(0);
+	sess.set_checker(checkers::at_least_one);
+	sess.set_filter(filters::positive);
+	for (size_t i = 0; i < test_count; ++i) {
+		ELLIPTICS_REQUIRE(read_result, sess.read_data(data[i], 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data[i]);
+	}
+}
+
 static void test_bulk_read(session &sess, size_t test_count)
 {
 	std::vector<std::string> keys;
@@ -683,6 +1169,150 @@ static void test_bulk_remove(session &sess, size_t test_count)
 	}
 }
 
+/*
+ * Keys which do not exist get their own -ENOENT, the rest of the bulk is removed
+ */
+static void test_bulk_remove_missing(session &sess, size_t test_count)
+{
+	std::vector<key> keys;
+	std::set<dnet_raw_id> written;
+
+	for (size_t i = 0; i < test_count; ++i) {
+		std::ostringstream os;
+		os << "bulk_remove_missing" << i;
+
+		key id(os.str());
+		id.transform(sess);
+		keys.push_back(id);
+
+		if (i % 2 == 0) {
+			ELLIPTICS_REQUIRE(write_result, sess.write_data(id, os.str(), 0));
+			written.insert(id.raw_id());
+		}
+	}
+
+	sess.set_checker(checkers::no_check);
+	sess.set_filter(filters::all_with_ack);
+
+	ELLIPTICS_REQUIRE(remove_result, sess.bulk_remove(keys));
+
+	sync_remove_result result = remove_result.get();
+	BOOST_REQUIRE_EQUAL(result.size(), test_count * 2);
+
+	for (auto it = result.begin(); it != result.end(); ++it) {
+		key id(it->command()->id);
+		const bool exists = written.count(id.raw_id()) > 0;
+
+		BOOST_REQUIRE_EQUAL(it->status(), exists ? 0 : -ENOENT);
+	}
+}
+
+/*
+ * Record written with lifetime is found until it expires,
+ * rewrite of the record without lifetime keeps it forever
+ */
+static void test_ttl_expire(session &sess)
+{
+	const std::string expiring = "ttl-expiring-key", persistent = "ttl-persistent-key";
+	const std::string data = "ttl-data";
+
+	auto write = [&sess, &data] (const std::string &id, uint64_t lifetime) {
+		dnet_io_attr io;
+		memset(&io, 0, sizeof(io));
+		dnet_current_time(&io.timestamp);
+		io.start = lifetime;
+
+		key kid(id);
+		kid.transform(sess);
+		memcpy(io.id, kid.raw_id().id, DNET_ID_SIZE);
+
+		return sess.write_data(io, data);
+	};
+
+	ELLIPTICS_REQUIRE(expiring_result, write(expiring, 2));
+	ELLIPTICS_REQUIRE(persistent_result, write(persistent, 2));
+	ELLIPTICS_REQUIRE(persistent_rewrite_result, write(persistent, 0));
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_data(expiring, 0, 0));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+
+	sleep(4);
+
+	ELLIPTICS_REQUIRE_ERROR(expired_result, sess.read_data(expiring, 0, 0), -ENOENT);
+	ELLIPTICS_REQUIRE(persistent_read_result, sess.read_data(persistent, 0, 0));
+	BOOST_REQUIRE_EQUAL(persistent_read_result.get_one().file().to_string(), data);
+}
+
+/*
+ * Records with the same content share chunks: both are read back whole and by parts,
+ * removal of one of them keeps the other readable and partial rewrite is refused
+ */
+static void test_dedup(session &sess)
+{
+	const std::string first = "dedup-first-key", second = "dedup-second-key";
+
+	std::string data(1024 * 1024, '\0');
+	uint64_t state = 1;
+	for (size_t i = 0; i < data.size(); ++i) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		data[i] = static_cast<char>(state >> 56);
+	}
+
+	ELLIPTICS_REQUIRE(first_write_result, sess.write_data(first, data, 0));
+	ELLIPTICS_REQUIRE(second_write_result, sess.write_data(second, data, 0));
+
+	ELLIPTICS_REQUIRE(first_read_result, sess.read_data(first, 0, 0));
+	BOOST_REQUIRE(first_read_result.get_one().file().to_string() == data);
+
+	ELLIPTICS_REQUIRE(part_read_result, sess.read_data(second, 100000, 300000));
+	BOOST_REQUIRE(part_read_result.get_one().file().to_string() == data.substr(100000, 300000));
+
+	ELLIPTICS_REQUIRE(remove_result, sess.remove(first));
+
+	ELLIPTICS_REQUIRE(second_read_result, sess.read_data(second, 0, 0));
+	BOOST_REQUIRE(second_read_result.get_one().file().to_string() == data);
+
+	ELLIPTICS_REQUIRE_ERROR(partial_write_result, sess.write_data(second, std::string("overwrite"), 100), -ENOTSUP);
+
+	ELLIPTICS_REQUIRE(last_read_result, sess.read_data(second, 0, 0));
+	BOOST_REQUIRE(last_read_result.get_one().file().to_string() == data);
+}
+
+// This test checks that backend lists its sealed files and refuses to send files which are not listed.
+static void test_blob_files(session &sess)
+{
+	std::vector<dnet_route_entry> routes = sess.get_routes();
+	BOOST_REQUIRE(!routes.empty());
+
+	session direct = sess.clone();
+	direct.set_direct_id(address(routes.front().addr), routes.front().backend_id);
+
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
+
+	dnet_blob_file_request request;
+	memset(&request, 0, sizeof(request));
+
+	transport_control control(id, DNET_CMD_BLOB_FILES,
+		DNET_FLAGS_DIRECT | DNET_FLAGS_DIRECT_BACKEND | DNET_FLAGS_NEED_ACK);
+	control.set_data(&request, sizeof(request));
+
+	ELLIPTICS_REQUIRE(list_result, direct.request_single_cmd(control));
+
+	size_t lists = 0;
+	sync_generic_result list = list_result.get();
+	for (auto it = list.begin(); it != list.end(); ++it) {
+		if (it->is_ack())
+			continue;
+
+		BOOST_REQUIRE_EQUAL(it->data().to_string().compare(0, 11, "{\"files\": ["), 0);
+		++lists;
+	}
+	BOOST_REQUIRE_EQUAL(lists, 1);
+
+	snprintf(request.name, sizeof(request.name), "../log.log");
+	ELLIPTICS_REQUIRE_ERROR(read_result, direct.request_single_cmd(control), -ENOENT);
+}
 
 static void test_range_request_prepare(session &sess, size_t item_count)
 {
@@ -1194,6 +1824,190 @@ static void test_read_latest_non_existing(session &sess, const std::string &id)
 	ELLIPTICS_REQUIRE_ERROR(read_data, sess.read_latest(id, 0, 0), -ENOENT);
 }
 
+#ifndef NO_SERVER
+// This test checks that background add_remote() calls ready callback after the route table is fetched,
+// so the node knows servers which it has not been given explicitly.
+static void test_add_remote_ready(const address &remote)
+{
+	dnet_config config;
+	memset(&config, 0, sizeof(config));
+	config.wait_timeout = 60;
+	config.connect_concurrency = 1;
+
+	node client(logger(*global_data->logger, blackhole::log::attributes_t()), config);
+
+	std::promise<error_info> ready;
+	client.add_remote(std::vector<address>(1, remote), [&ready] (const error_info &error) {
+		ready.set_value(error);
+	});
+
+	auto future = ready.get_future();
+	BOOST_REQUIRE(future.wait_for(std::chrono::seconds(60)) == std::future_status::ready);
+	BOOST_REQUIRE_EQUAL(future.get().code(), 0);
+
+	session sess = create_session(client, {1, 2}, 0, 0);
+	std::vector<dnet_route_entry> routes = sess.get_routes();
+
+	std::set<std::string> addresses;
+	for (auto it = routes.begin(); it != routes.end(); ++it)
+		addresses.insert(dnet_addr_string(&it->addr));
+
+	BOOST_REQUIRE_EQUAL(addresses.size(), global_data->nodes.size());
+}
+#endif
+
+// This test checks that speculative read_latest returns data of the latest group even if it is not the first one.
+static void test_speculative_read_latest(session &sess, const std::string &id)
+{
+	sess.set_speculative_read_latest(true);
+
+	ELLIPTICS_REQUIRE_ERROR(missing_result, sess.read_latest(id + "-missing", 0, 0), -ENOENT);
+
+	ELLIPTICS_REQUIRE(first_write_result, sess.write_data(id, "first", 0));
+
+	for (int group : {1, 2}) {
+		session group_sess = sess.clone();
+		group_sess.set_groups({group});
+
+		std::string data = "latest in group " + std::to_string(group);
+		ELLIPTICS_REQUIRE(write_result, group_sess.write_data(id, data, 0));
+
+		ELLIPTICS_REQUIRE(read_result, sess.read_latest(id, 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+	}
+}
+
+// This test checks that read_latest with read-repair copies the latest replica to the group which misses it.
+static void test_read_repair(session &sess, const std::string &id)
+{
+	const std::string data = "read repair test data";
+
+	session first_sess = sess.clone();
+	first_sess.set_groups({1});
+	ELLIPTICS_REQUIRE(write_result, first_sess.write_data(id, data, 0));
+
+	sess.set_read_repair(100);
+	BOOST_REQUIRE_EQUAL(sess.get_read_repair(), 100);
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_latest(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+
+	session second_sess = sess.clone();
+	second_sess.set_groups({2});
+	second_sess.set_exceptions_policy(session::no_exceptions);
+
+	// repair is made in background
+	bool repaired = false;
+	for (int i = 0; i < 500 && !repaired; ++i) {
+		auto result = second_sess.read_data(id, 0, 0);
+		result.wait();
+		repaired = !result.error() && result.get_one().file().to_string() == data;
+		if (!repaired)
+			usleep(10 * 1000);
+	}
+
+	BOOST_REQUIRE(repaired);
+}
+
+// This test checks that transformed key is reused only in the same namespace, with and without transform cache.
+static void test_key_transform_namespace(session &sess, const std::string &id)
+{
+	session first = sess.clone();
+	first.set_namespace("transform-first");
+	session second = sess.clone();
+	second.set_namespace("transform-second");
+
+	for (size_t cache_size : {0, 100}) {
+		key::set_transform_cache_size(cache_size);
+		BOOST_REQUIRE_EQUAL(key::get_transform_cache_size(), cache_size);
+
+		dnet_raw_id first_id, second_id;
+		first.transform(id, first_id);
+		second.transform(id, second_id);
+		BOOST_REQUIRE(!(first_id == second_id));
+
+		key k(id);
+		first.transform(k);
+		BOOST_REQUIRE(k.raw_id() == first_id);
+
+		key copy(k);
+		second.transform(copy);
+		BOOST_REQUIRE(copy.raw_id() == second_id);
+
+		std::vector<key> keys(2, k);
+		second.transform(keys);
+		BOOST_REQUIRE(keys[0].raw_id() == second_id);
+		first.transform(k);
+		BOOST_REQUIRE(k.raw_id() == first_id);
+	}
+
+	key::set_transform_cache_size(0);
+}
+
+// This test checks that clone shares native session until it is changed and changes do not leak between clones.
+static void test_session_clone_copy_on_write(session &sess)
+{
+	session clone = sess.clone();
+	BOOST_REQUIRE_EQUAL(clone.get_native_shared(), sess.get_native_shared());
+
+	clone.set_groups({3});
+	clone.set_namespace("clone-namespace");
+	BOOST_REQUIRE(clone.get_native_shared() != sess.get_native_shared());
+
+	BOOST_REQUIRE_EQUAL(clone.get_groups().size(), 1U);
+	BOOST_REQUIRE_EQUAL(clone.get_groups().front(), 3);
+	BOOST_REQUIRE_EQUAL(sess.get_groups().size(), 2U);
+	BOOST_REQUIRE_EQUAL(sess.get_namespace(), "");
+
+	// copy of the session is not a clone, it sees the changes
+	session copy = sess;
+	copy.set_cflags(DNET_FLAGS_NOLOCK);
+	BOOST_REQUIRE_EQUAL(sess.get_cflags(), static_cast<uint64_t>(DNET_FLAGS_NOLOCK));
+	BOOST_REQUIRE_EQUAL(clone.get_cflags(), 0U);
+}
+
+// This test checks that retries in the next group stop once the retry budget of the node is spent
+// and that reads with adaptive timeout still succeed.
+static void test_retry_budget(session &sess, const std::string &id)
+{
+	std::string data = "retry budget test data";
+	node n = node::from_raw(sess.get_native_node());
+
+	session second = sess.clone();
+	second.set_groups({2});
+	ELLIPTICS_REQUIRE(write_result, second.write_data(id, data, 0));
+
+	// every read fails in group 1 and is retried in group 2, 10% budget does not cover it
+	n.set_retry_budget(10);
+	BOOST_REQUIRE_EQUAL(n.get_retry_budget(), 10);
+
+	session reader = sess.clone();
+	reader.set_groups({1, 2});
+	reader.set_exceptions_policy(session::no_exceptions);
+
+	int succeeded = 0;
+	for (int i = 0; i < 2 * DNET_RETRY_BUDGET_RESERVE; ++i) {
+		async_read_result result = reader.read_data(id, 0, 0);
+		result.wait();
+		if (!result.error())
+			++succeeded;
+	}
+
+	BOOST_REQUIRE_GE(succeeded, DNET_RETRY_BUDGET_RESERVE);
+	BOOST_REQUIRE_LT(succeeded, 2 * DNET_RETRY_BUDGET_RESERVE);
+
+	n.set_retry_budget(0);
+
+	reader.set_adaptive_timeout(99, 4, 100);
+	BOOST_REQUIRE_EQUAL(reader.get_adaptive_timeout_percentile(), 99);
+	BOOST_REQUIRE_EQUAL(reader.get_adaptive_timeout_multiplier(), 4);
+	BOOST_REQUIRE_EQUAL(reader.get_adaptive_timeout_min_ms(), 100);
+
+	reader.set_exceptions_policy(session::default_exceptions);
+	ELLIPTICS_REQUIRE(read_result, reader.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+}
+
 // This test checks that read with DNET_IO_FLAGS_MIX_STATES succeeds and doesn't lock up.
 static void test_read_mix_states_ioflags(session &sess, const std::string &id)
 {
@@ -1208,6 +2022,95 @@ static void test_read_mix_states_ioflags(session &sess, const std::string &id)
 	BOOST_REQUIRE_EQUAL(result.file().to_string(), data);
 }
 
+// This test checks that concurrent reads of the same key with read collapsing enabled all get the data.
+static void test_read_collapsing(session &sess, const std::string &id)
+{
+	std::string data = "read collapsing test data";
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+
+	sess.set_read_collapsing(true);
+
+	std::vector<async_read_result> results;
+	for (int i = 0; i < 10; ++i) {
+		session clone = sess.clone();
+		results.emplace_back(clone.read_data(id, 0, 0));
+	}
+
+	for (auto it = results.begin(); it != results.end(); ++it) {
+		ELLIPTICS_REQUIRE(read_result, std::move(*it));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), data);
+	}
+}
+
+// This test checks that reads coalesced into bulk reads by read batching get their own data or errors.
+static void test_read_batching(session &sess, const std::string &id)
+{
+	const int count = 8;
+
+	for (int i = 0; i < count; ++i) {
+		std::string key = id + "-" + std::to_string(i);
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(key, "read batching data " + key, 0));
+	}
+
+	sess.set_read_batching(1000, 4);
+	BOOST_REQUIRE_EQUAL(sess.get_read_batching_delay(), 1000);
+
+	std::vector<async_read_result> results;
+	for (int i = 0; i < count; ++i) {
+		session clone = sess.clone();
+		results.emplace_back(clone.read_data(id + "-" + std::to_string(i), 0, 0));
+	}
+
+	for (int i = 0; i < count; ++i) {
+		std::string key = id + "-" + std::to_string(i);
+		ELLIPTICS_REQUIRE(read_result, std::move(results[i]));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), "read batching data " + key);
+	}
+
+	ELLIPTICS_REQUIRE_ERROR(missing_result, sess.read_data(id + "-missing", 0, 0), -ENOENT);
+
+	sess.set_read_batching(0, 0);
+	BOOST_REQUIRE_EQUAL(sess.get_read_batching_delay(), 0);
+}
+
+// This test checks that near cache serves reads and is invalidated by writes done through another session.
+static void test_near_cache(session &sess, const std::string &id)
+{
+	std::string first = "near cache first data";
+	std::string second = "near cache second data";
+
+	session writer = sess.clone();
+
+	ELLIPTICS_REQUIRE(first_write_result, writer.write_data(id, first, 0));
+
+	sess.set_near_cache(1024 * 1024, 10000);
+
+	ELLIPTICS_REQUIRE(first_read_result, sess.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(first_read_result.get_one().file().to_string(), first);
+	BOOST_REQUIRE_EQUAL(sess.get_near_cache_hits(), 0u);
+
+	// the first reply is cached once it completes, now the same read must not reach the storage
+	ELLIPTICS_REQUIRE(cached_read_result, sess.read_data(id, 0, 0));
+	BOOST_REQUIRE_EQUAL(cached_read_result.get_one().file().to_string(), first);
+	BOOST_REQUIRE_EQUAL(sess.get_near_cache_hits(), 1u);
+
+	ELLIPTICS_REQUIRE(second_write_result, writer.write_data(id, second, 0));
+
+	// notification is delivered asynchronously
+	std::string data;
+	for (int i = 0; i < 100; ++i) {
+		ELLIPTICS_REQUIRE(read_result, sess.read_data(id, 0, 0));
+		data = read_result.get_one().file().to_string();
+		if (data == second)
+			break;
+
+		usleep(10 * 1000);
+	}
+
+	BOOST_REQUIRE_EQUAL(data, second);
+}
+
 /*!
  * \brief test_merge_indexes
  *
@@ -1435,6 +2338,40 @@ static void test_requests_to_own_server(session &sess)
 
 	BOOST_REQUIRE_EQUAL(result.size(), 3);
 }
+
+/*
+ * Nodes of one process share the background log writer: node destroyed while the others keep logging
+ * has its queued records written before its logger is freed, later start does not stop the writer of others
+ */
+static void test_async_log_node_destroy(session &sess)
+{
+	server_config config = server_config::default_value();
+	config.apply_options(config_data()
+		("group", 11)
+	);
+	config.log_async_ring_size = 16;
+
+	start_nodes_config start_config(results_reporter::get_stream(), std::vector<server_config>({
+		config
+	}), std::string());
+	start_config.monitor = false;
+
+	nodes_data::ptr extra = start_nodes(start_config);
+	server_node &server = extra->nodes.front();
+
+	ELLIPTICS_REQUIRE(extra_write, create_session(*extra->node, {11}, 0, 0).write_data(std::string("async-log-extra"), "data", 0));
+
+	server.stop();
+	server.wait_to_stop();
+
+	const std::string log = read_file(server.config().log_path.c_str());
+	BOOST_REQUIRE(log.find("Destroying node.") != std::string::npos);
+
+	extra.reset();
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(std::string("async-log-key"), "async-log-data", 0));
+	ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(std::string("async-log-key"), 0, 0), "async-log-data");
+}
 #endif
 
 /* Check that lookup doesn't validate records if checksum isn't requested and does if not:
@@ -1482,9 +2419,20 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_write, create_session(n, {1, 2}, 0, 0), "new-id-real", "new-data-long");
 	ELLIPTICS_TEST_CASE(test_write, create_session(n, {1, 2}, 0, 0), "new-id-real", "short");
 	ELLIPTICS_TEST_CASE(test_remove, create_session(n, {1, 2}, 0, 0), "new-id-real");
+	ELLIPTICS_TEST_CASE(test_quorum_write, create_session(n, {1, 2, 3}, 0, 0), "quorum-write-id", "quorum-data");
+	ELLIPTICS_TEST_CASE(test_primary_replication_write, create_session(n, {1, 2, 3}, 0, 0),
+		"primary-replication-write-id", "primary-replication-data");
+	ELLIPTICS_TEST_CASE(test_erasure_coding, create_session(n, {1, 2, 3}, 0, 0), "erasure-coding-id");
+	ELLIPTICS_TEST_CASE(test_chunked_write, create_session(n, {1, 2}, 0, 0), "chunked-write-id", 1);
+	ELLIPTICS_TEST_CASE(test_chunked_write, create_session(n, {1, 2}, 0, 0), "parallel-chunked-write-id", 4);
+	ELLIPTICS_TEST_CASE(test_segmented_write, create_session(n, {1, 2}, 0, 0), "segmented-write-id");
 	ELLIPTICS_TEST_CASE(test_recovery, create_session(n, {1, 2}, 0, 0), "recovery-id", "recovered-data");
 	ELLIPTICS_TEST_CASE(test_indexes, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_more_indexes, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_indexes_pagination, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_indexes_read, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_bulk_indexes, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_indexes_range, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_indexes_metadata, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_error, create_session(n, {99}, 0, 0), "non-existen-key", -ENXIO);
 	ELLIPTICS_TEST_CASE(test_error, create_session(n, {1, 2}, 0, 0), "non-existen-key", -ENOENT);
@@ -1492,6 +2440,9 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_lookup, create_session(n, {1, 2}, 0, DNET_IO_FLAGS_CACHE), "cache-2.xml", "lookup data");
 	ELLIPTICS_TEST_CASE(test_cas, create_session(n, {1, 2}, 0, DNET_IO_FLAGS_CHECKSUM));
 	ELLIPTICS_TEST_CASE(test_append, create_session(n, {1, 2}, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_append_buffer, create_session(n, {1, 2}, 0, 0), "append-buffer-test");
+	ELLIPTICS_TEST_CASE(test_cache_prefetch, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_cache_hotset, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_read_write_offsets, create_session(n, {1, 2}, 0, DNET_IO_FLAGS_CACHE));
 	ELLIPTICS_TEST_CASE(test_commit, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_prepare_commit, create_session(n, {1, 2}, 0, 0), "prepare-commit-test-1", 0, 0);
@@ -1500,8 +2451,13 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_prepare_commit, create_session(n, {1, 2}, 0, 0), "prepare-commit-test-4", 1, 1);
 	ELLIPTICS_TEST_CASE(test_prepare_commit_simultaneously, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_bulk_write, create_session(n, {1, 2}, 0, 0), 1000);
+	ELLIPTICS_TEST_CASE(test_bulk_write_statuses, create_session(n, {1, 2}, 0, 0), 1000);
 	ELLIPTICS_TEST_CASE(test_bulk_read, create_session(n, {1, 2}, 0, 0), 1000);
 	ELLIPTICS_TEST_CASE(test_bulk_remove, create_session(n, {1, 2}, 0, 0), 1000);
+	ELLIPTICS_TEST_CASE(test_bulk_remove_missing, create_session(n, {1, 2}, 0, 0), 100);
+	ELLIPTICS_TEST_CASE(test_blob_files, create_session(n, {1}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_ttl_expire, create_session(n, {3}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_dedup, create_session(n, {3}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_range_request, create_session(n, {2}, 0, 0), 0, 255, 2);
 	ELLIPTICS_TEST_CASE(test_range_request, create_session(n, {2}, 0, 0), 3, 14, 2);
 	ELLIPTICS_TEST_CASE(test_range_request, create_session(n, {2}, 0, 0), 7, 3, 2);
@@ -1519,6 +2475,11 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_fail_quorum_lookup, create_session(n, {1, 2, 3}, 0, 0), -ENOENT);
 	ELLIPTICS_TEST_CASE(test_fail_quorum_lookup, create_session(n, {91, 92, 93}, 0, 0), -ENXIO);
 	ELLIPTICS_TEST_CASE(test_read_latest_non_existing, create_session(n, {1, 2}, 0, 0), "read-latest-non-existing");
+	ELLIPTICS_TEST_CASE(test_speculative_read_latest, create_session(n, {1, 2}, 0, 0), "speculative-read-latest");
+	ELLIPTICS_TEST_CASE(test_read_repair, create_session(n, {1, 2}, 0, 0), "read-repair");
+	ELLIPTICS_TEST_CASE(test_key_transform_namespace, create_session(n, {1, 2}, 0, 0), "key-transform-namespace");
+	ELLIPTICS_TEST_CASE(test_session_clone_copy_on_write, create_session(n, {1, 2}, 0, 0));
+	ELLIPTICS_TEST_CASE(test_retry_budget, create_session(n, {1, 2}, 0, 0), "retry-budget");
 	ELLIPTICS_TEST_CASE(test_merge_indexes, create_session(n, { 1, 2 }, 0, 0), "one", checkers::at_least_one);
 	ELLIPTICS_TEST_CASE(test_merge_indexes, create_session(n, { 1, 2 }, 0, 0), "quorum", checkers::quorum);
 	ELLIPTICS_TEST_CASE(test_merge_indexes, create_session(n, { 1, 2 }, 0, 0), "all", checkers::all);
@@ -1527,8 +2488,13 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_lookup_non_existing, create_session(n, { 1 }, 0, 0), -ENOENT);
 	ELLIPTICS_TEST_CASE(test_lookup_non_existing, create_session(n, { 99 }, 0, 0), -ENXIO);
 	ELLIPTICS_TEST_CASE(test_read_mix_states_ioflags, create_session(n, {1, 2}, 0, 0), "read-mix-states-ioflags");
+	ELLIPTICS_TEST_CASE(test_read_collapsing, create_session(n, {1, 2}, 0, 0), "read-collapsing");
+	ELLIPTICS_TEST_CASE(test_read_batching, create_session(n, {1, 2}, 0, 0), "read-batching");
+	ELLIPTICS_TEST_CASE(test_near_cache, create_session(n, {1, 2}, 0, 0), "near-cache");
 #ifndef NO_SERVER
 	ELLIPTICS_TEST_CASE(test_requests_to_own_server, create_session(node::from_raw(global_data->nodes.front().get_native()), { 1, 2, 3 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_add_remote_ready, global_data->nodes.front().remote());
+	ELLIPTICS_TEST_CASE(test_async_log_node_destroy, create_session(n, {1, 2}, 0, 0));
 #endif
 	ELLIPTICS_TEST_CASE(test_lookup_corrupted, create_session(n, {1}, 0, 0), "lookup corrupted test key", "lookup corrupted test data");
 
@@ -43,6 +43,12 @@ static std::string cocaine_config_plugins()
 	return result;
 }
 
+/* directory of native iterator filters built for tests, they are disabled if it isn't set */
+static const char *iterator_filter_dir()
+{
+	return getenv("TEST_ITERATOR_FILTER_DIR");
+}
+
 static const char *ioserv_path()
 {
 	char *result = getenv("TEST_IOSERV_PATH");
@@ -207,6 +213,7 @@ const config_data::variant *config_data::value_impl(const std::string &name) con
 server_config server_config::default_value()
 {
 	server_config data;
+	data.log_async_ring_size = 0;
 	data.options
 			("join", true)
 			("flags", 4)
@@ -214,6 +221,8 @@ server_config server_config::default_value()
 			("check_timeout", 60)
 			("io_thread_num", 2)
 			("nonblocking_io_thread_num", 2)
+			("nonblocking_io_steal", true)
+			("short_header", true)
 			("net_thread_num", 1)
 			("indexes_shard_count", 16)
 			("daemon", false)
@@ -222,7 +231,10 @@ server_config server_config::default_value()
 			("server_net_prio", 1)
 			("client_net_prio", 6)
 			("cache_size", 1024 * 1024 * 256)
-			("caches_number", 16);
+			("caches_number", 16)
+			("cache_append_buffer_size", 4096)
+			("cache_append_buffer_age", 100)
+			("cache_append_buffer_ack", "flush");
 	data.backends.resize(1);
 	data.backends[0]
 			("type", "blob")
@@ -231,7 +243,12 @@ server_config server_config::default_value()
 			("blob_size", "10M")
 			("records_in_blob", 10000000)
 			("defrag_timeout", 3600)
-			("defrag_percentage", 25);
+			("defrag_percentage", 25)
+			("change_log", true)
+			("inline_cache_budget", 100000);
+
+	if (const char *filter_dir = iterator_filter_dir())
+		data.options("iterator_filter_dir", filter_dir);
 	return data;
 }
 
@@ -339,6 +356,11 @@ void server_config::write(const std::string &path)
 	logger.SetObject();
 	logger.AddMember("level", log_level, allocator);
 	logger.AddMember("frontends", frontends, allocator);
+	if (log_async_ring_size) {
+		rapidjson::Value ring_size;
+		ring_size.SetUint64(log_async_ring_size);
+		logger.AddMember("async_ring_size", ring_size, allocator);
+	}
 
 	rapidjson::Value server;
 	server.SetObject();
@@ -186,6 +186,8 @@ public:
 	config_data options;
 	std::vector<config_data> backends;
 	std::string log_path;
+	// logger.async_ring_size, records are written by background thread if it is not zero
+	int64_t log_async_ring_size;
 };
 
 class server_node